@@ -0,0 +1,372 @@
+/**
+ * @file
+ * @brief Placement of the reactors in the arena by the messages that they exchange.
+ *
+ * See arena_placement.h. The allocations are numbered in the order in which they are made, and
+ * the file gives the size and the offset in the block of the placement of each of them.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena_placement.h"
+#include "environment.h"
+#include "low_level_platform.h"
+#include "reactor_common.h"
+#include "util.h"
+#ifdef LF_REACTION_PROFILE
+#include "reaction_profile.h"
+#endif
+
+/** The first field of a placement file. */
+#define PLACEMENT_MAGIC "LFP1"
+
+/** @brief An allocation recorded on a list. */
+typedef struct allocation_t {
+  void* mem;
+  size_t bytes;
+  size_t owner; // The index of the allocation of the self struct on which it is recorded, or SIZE_MAX.
+} allocation_t;
+
+/** @brief An edge between two reactors, given by the indices of their allocations. */
+typedef struct edge_t {
+  size_t from;
+  size_t to;
+  size_t weight;
+} edge_t;
+
+/** The state of the placement. */
+static struct {
+  allocation_t* allocations; // The allocations, in the order in which they were made.
+  size_t num_allocations;
+  size_t capacity;
+  size_t* reactors; // The indices of the allocations of self structs, in the order of creation.
+  size_t num_reactors;
+  size_t reactor_capacity;
+  size_t cursor; // The index in `reactors` of the last owner found.
+  bool loaded;   // Whether the file has been read.
+  size_t* plan;  // The sizes and offsets of the first `plan_size` allocations, from the file.
+  size_t plan_size;
+  size_t block_size; // The size of the block of the placement.
+  char* block;       // The block, or NULL before the first placed allocation.
+} placement;
+
+/** Whether an allocation is being recorded. */
+static int32_t placing = 0;
+
+/** @brief Read the placement file, if there is one. */
+static void load_plan(void) {
+  placement.loaded = true;
+  FILE* file = fopen(LF_ARENA_PLACEMENT_FILE, "r");
+  if (file == NULL) {
+    LF_PRINT_LOG("No arena placement in %s. Reactors are placed in the order of creation.", LF_ARENA_PLACEMENT_FILE);
+    return;
+  }
+  char magic[5];
+  size_t n, block_size;
+  bool valid = fscanf(file, "%4s %zu %zu", magic, &n, &block_size) == 3 && strcmp(magic, PLACEMENT_MAGIC) == 0;
+  size_t* plan = valid ? (size_t*)calloc(2 * n + 1, sizeof(size_t)) : NULL;
+  for (size_t i = 0; plan != NULL && i < n && valid; i++) {
+    valid = fscanf(file, "%zu %zu", &plan[2 * i], &plan[2 * i + 1]) == 2 && plan[2 * i] % sizeof(max_align_t) == 0 &&
+            plan[2 * i + 1] % sizeof(max_align_t) == 0 && plan[2 * i + 1] + plan[2 * i] <= block_size;
+  }
+  fclose(file);
+  if (!valid || plan == NULL) {
+    lf_print_warning("The arena placement in %s is not valid. Reactors are placed in the order of creation.",
+                     LF_ARENA_PLACEMENT_FILE);
+    free(plan);
+    return;
+  }
+  placement.plan = plan;
+  placement.plan_size = n;
+  placement.block_size = block_size;
+}
+
+/** @brief Return the index of the allocation of the self struct on which `head` is recorded, or SIZE_MAX. */
+static size_t owner_of(struct allocation_record_t** head) {
+  if (head == &_lf_reactors_to_free) {
+    return placement.num_allocations;
+  }
+  void* self = (char*)head - offsetof(self_base_t, allocations);
+  // Reactors are mostly given their memory in the order of creation, so search from the last owner outward.
+  size_t n = placement.num_reactors;
+  for (size_t d = 0; d < n; d++) {
+    size_t after = placement.cursor + d;
+    if (after < n && placement.allocations[placement.reactors[after]].mem == self) {
+      placement.cursor = after;
+      return placement.reactors[after];
+    }
+    if (d <= placement.cursor && placement.allocations[placement.reactors[placement.cursor - d]].mem == self) {
+      placement.cursor -= d;
+      return placement.reactors[placement.cursor];
+    }
+  }
+  return SIZE_MAX;
+}
+
+void* _lf_arena_placement_allocate(size_t bytes, struct allocation_record_t** head,
+                                   void* (*carve)(size_t count, size_t size)) {
+  while (!lf_atomic_bool_compare_and_swap32(&placing, 0, 1)) {
+    LF_CPU_RELAX();
+  }
+  if (!placement.loaded) {
+    load_plan();
+  }
+  size_t index = placement.num_allocations;
+  void* mem;
+  if (index < placement.plan_size && placement.plan[2 * index] == bytes) {
+    if (placement.block == NULL) {
+      placement.block = (char*)carve(1, placement.block_size);
+    }
+    mem = placement.block + placement.plan[2 * index + 1];
+  } else {
+    if (index < placement.plan_size) {
+      lf_print_warning("Allocation %zu of the reactors has %zu bytes rather than the %zu of the arena placement in %s. "
+                       "It and the later allocations are not placed.",
+                       index, bytes, placement.plan[2 * index], LF_ARENA_PLACEMENT_FILE);
+      placement.plan_size = 0;
+    }
+    mem = carve(1, bytes);
+  }
+  if (placement.num_allocations == placement.capacity) {
+    placement.capacity = placement.capacity == 0 ? 64 : 2 * placement.capacity;
+    placement.allocations =
+        (allocation_t*)realloc(placement.allocations, placement.capacity * sizeof(allocation_t));
+    LF_ASSERT_NON_NULL(placement.allocations);
+  }
+  size_t owner = owner_of(head);
+  placement.allocations[index] = (allocation_t){.mem = mem, .bytes = bytes, .owner = owner};
+  placement.num_allocations++;
+  if (owner == index) {
+    if (placement.num_reactors == placement.reactor_capacity) {
+      placement.reactor_capacity = placement.reactor_capacity == 0 ? 64 : 2 * placement.reactor_capacity;
+      placement.reactors = (size_t*)realloc(placement.reactors, placement.reactor_capacity * sizeof(size_t));
+      LF_ASSERT_NON_NULL(placement.reactors);
+    }
+    placement.cursor = placement.num_reactors;
+    placement.reactors[placement.num_reactors++] = index;
+  }
+  lf_atomic_bool_compare_and_swap32(&placing, 1, 0);
+  return mem;
+}
+
+
+#ifdef LF_REACTION_PROFILE
+
+/** The edges between the reactors, in each direction, while the placement is computed. */
+static edge_t* edges;
+static size_t num_edges;
+static size_t edge_capacity;
+
+/** The reactors, in the order of the addresses of their self structs, while the placement is computed. */
+static size_t* sorted_reactors;
+
+static int compare_addresses(const void* a, const void* b) {
+  uintptr_t x = (uintptr_t)placement.allocations[*(const size_t*)a].mem;
+  uintptr_t y = (uintptr_t)placement.allocations[*(const size_t*)b].mem;
+  return (x > y) - (x < y);
+}
+
+/** @brief Return the index of the allocation of the given self struct, or SIZE_MAX if it was not allocated here. */
+static size_t reactor_of(void* self) {
+  size_t low = 0;
+  size_t high = placement.num_reactors;
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    uintptr_t address = (uintptr_t)placement.allocations[sorted_reactors[middle]].mem;
+    if (address == (uintptr_t)self) {
+      return sorted_reactors[middle];
+    } else if (address < (uintptr_t)self) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return SIZE_MAX;
+}
+
+/** @brief Add an edge in each direction between the reactor of a reaction and those of the reactions it triggers. */
+static void add_edges(reaction_t* reaction, reaction_t* const* downstream, int count) {
+  size_t from = reactor_of(reaction->self);
+  for (int k = 0; k < count && from != SIZE_MAX; k++) {
+    size_t to = downstream[k] != NULL ? reactor_of(downstream[k]->self) : SIZE_MAX;
+    if (to == SIZE_MAX || to == from) {
+      continue;
+    }
+    if (num_edges + 2 > edge_capacity) {
+      edge_capacity = edge_capacity == 0 ? 64 : 2 * edge_capacity;
+      edges = (edge_t*)realloc(edges, edge_capacity * sizeof(edge_t));
+      LF_ASSERT_NON_NULL(edges);
+    }
+    edges[num_edges++] = (edge_t){.from = from, .to = to, .weight = lf_reaction_profile_count(reaction)};
+    edges[num_edges++] = (edge_t){.from = to, .to = from, .weight = lf_reaction_profile_count(reaction)};
+  }
+}
+
+static int compare_edges(const void* a, const void* b) {
+  const edge_t* x = (const edge_t*)a;
+  const edge_t* y = (const edge_t*)b;
+  if (x->from != y->from) {
+    return (x->from > y->from) - (x->from < y->from);
+  }
+  // The heaviest edges of a reactor come first.
+  return (x->weight < y->weight) - (x->weight > y->weight);
+}
+
+/** The total weight of the edges of each allocation, while the reactors are ordered. */
+static size_t* total_weights;
+
+static int compare_roots(const void* a, const void* b) {
+  size_t x = *(const size_t*)a;
+  size_t y = *(const size_t*)b;
+  if (total_weights[x] != total_weights[y]) {
+    return (total_weights[x] < total_weights[y]) - (total_weights[x] > total_weights[y]);
+  }
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Order the reactors so that those joined by the heaviest edges are adjacent.
+ * @param envs The environments, whose profiled reactions give the edges.
+ * @param num_envs The number of environments.
+ * @param order Where to store the indices of the allocations of the reactors in their new order.
+ */
+static void order_reactors(environment_t* envs, int num_envs, size_t* order) {
+  size_t n = placement.num_reactors;
+  size_t num_allocations = placement.num_allocations;
+  sorted_reactors = (size_t*)malloc(n * sizeof(size_t));
+  LF_ASSERT_NON_NULL(sorted_reactors);
+  memcpy(sorted_reactors, placement.reactors, n * sizeof(size_t));
+  qsort(sorted_reactors, n, sizeof(size_t), compare_addresses);
+  for (int e = 0; e < num_envs; e++) {
+    for (size_t i = 0; i < vector_size(&envs[e].profiled_reactions); i++) {
+      reaction_t* reaction = VECTOR_GET(&envs[e].profiled_reactions, i, reaction_t*);
+      if (reaction->fanout != NULL) {
+        add_edges(reaction, reaction->fanout->reactions, reaction->fanout->offsets[reaction->num_outputs]);
+        continue;
+      }
+      for (size_t j = 0; reaction->triggers != NULL && j < reaction->num_outputs; j++) {
+        for (int k = 0; k < reaction->triggered_sizes[j]; k++) {
+          trigger_t* trigger = reaction->triggers[j][k];
+          if (trigger != NULL) {
+            add_edges(reaction, trigger->reactions, trigger->number_of_reactions);
+          }
+        }
+      }
+    }
+  }
+  qsort(edges, num_edges, sizeof(edge_t), compare_edges);
+  // The edges of allocation i are edges[first[i]] to edges[first[i + 1] - 1].
+  size_t* first = (size_t*)calloc(num_allocations + 1, sizeof(size_t));
+  total_weights = (size_t*)calloc(num_allocations, sizeof(size_t));
+  bool* placed = (bool*)calloc(num_allocations, sizeof(bool));
+  size_t* roots = (size_t*)malloc(n * sizeof(size_t));
+  size_t* stack = (size_t*)malloc((num_edges + 1) * sizeof(size_t));
+  LF_ASSERT(first != NULL && total_weights != NULL && placed != NULL && roots != NULL && stack != NULL,
+            "Out of memory");
+  for (size_t i = 0; i < num_edges; i++) {
+    first[edges[i].from + 1]++;
+    total_weights[edges[i].from] += edges[i].weight;
+  }
+  for (size_t i = 0; i < num_allocations; i++) {
+    first[i + 1] += first[i];
+  }
+  // Start from the reactor with the heaviest edges, and keep the order of creation among the others.
+  memcpy(roots, placement.reactors, n * sizeof(size_t));
+  qsort(roots, n, sizeof(size_t), compare_roots);
+  size_t count = 0;
+  for (size_t r = 0; r < n; r++) {
+    size_t depth = 0;
+    stack[depth++] = roots[r];
+    while (depth > 0) {
+      size_t reactor = stack[--depth];
+      if (placed[reactor]) {
+        continue;
+      }
+      placed[reactor] = true;
+      order[count++] = reactor;
+      // Push the lightest edge first, so that the heaviest is followed first. Each edge is pushed at most once.
+      for (size_t i = first[reactor + 1]; i > first[reactor]; i--) {
+        if (!placed[edges[i - 1].to]) {
+          stack[depth++] = edges[i - 1].to;
+        }
+      }
+    }
+  }
+  free(stack);
+  free(roots);
+  free(placed);
+  free(total_weights);
+  free(first);
+  free(sorted_reactors);
+  free(edges);
+  edges = NULL;
+  num_edges = edge_capacity = 0;
+}
+
+#endif // LF_REACTION_PROFILE
+
+/** The rank of the owner of each allocation in the new order, while the allocations are sorted. */
+static size_t* ranks;
+
+static int compare_allocations(const void* a, const void* b) {
+  size_t x = *(const size_t*)a;
+  size_t y = *(const size_t*)b;
+  if (ranks[x] != ranks[y]) {
+    return (ranks[x] > ranks[y]) - (ranks[x] < ranks[y]);
+  }
+  // A self struct comes first, followed by the memory recorded on it in the order of allocation.
+  return (x > y) - (x < y);
+}
+
+void _lf_arena_placement_write(environment_t* envs, int num_envs) {
+  size_t n = placement.num_allocations;
+  if (n == 0) {
+    return;
+  }
+  size_t* order = (size_t*)malloc(placement.num_reactors * sizeof(size_t));
+  ranks = (size_t*)malloc(n * sizeof(size_t));
+  size_t* sorted = (size_t*)malloc(n * sizeof(size_t));
+  size_t* offsets = (size_t*)malloc(n * sizeof(size_t));
+  LF_ASSERT(order != NULL && ranks != NULL && sorted != NULL && offsets != NULL, "Out of memory");
+#ifdef LF_REACTION_PROFILE
+  order_reactors(envs, num_envs, order);
+#else
+  (void)envs;
+  (void)num_envs;
+  memcpy(order, placement.reactors, placement.num_reactors * sizeof(size_t));
+#endif
+  for (size_t r = 0; r < placement.num_reactors; r++) {
+    ranks[order[r]] = r;
+  }
+  // An allocation follows its owner, which was allocated before it, and the others come last.
+  for (size_t i = 0; i < n; i++) {
+    size_t owner = placement.allocations[i].owner;
+    ranks[i] = owner != SIZE_MAX ? ranks[owner] : placement.num_reactors;
+    sorted[i] = i;
+  }
+  qsort(sorted, n, sizeof(size_t), compare_allocations);
+  size_t block_size = 0;
+  for (size_t i = 0; i < n; i++) {
+    offsets[sorted[i]] = block_size;
+    block_size += placement.allocations[sorted[i]].bytes;
+  }
+  FILE* file = fopen(LF_ARENA_PLACEMENT_FILE, "w");
+  if (file == NULL) {
+    lf_print_warning("Could not write the arena placement to %s.", LF_ARENA_PLACEMENT_FILE);
+  } else {
+    fprintf(file, "%s %zu %zu\n", PLACEMENT_MAGIC, n, block_size);
+    for (size_t i = 0; i < n; i++) {
+      fprintf(file, "%zu %zu\n", placement.allocations[i].bytes, offsets[i]);
+    }
+    fclose(file);
+    LF_PRINT_LOG("Wrote the arena placement of %zu allocations of %zu reactors to %s.", n, placement.num_reactors,
+                 LF_ARENA_PLACEMENT_FILE);
+  }
+  free(offsets);
+  free(sorted);
+  free(ranks);
+  free(order);
+}
@@ -0,0 +1,456 @@
+/**
+ * @file
+ * @brief Checkpoints of the state of a running program, from which a new run can resume.
+ *
+ * See checkpoint.h.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "lf_token.h"
+#include "reactor_common.h"
+#include "util.h"
+#include "vector.h"
+
+/** The first field of a checkpoint ("LFC1"). */
+#define CHECKPOINT_MAGIC 0x3143464c
+
+/** The length of a checkpoint event that has no token. */
+#define CHECKPOINT_NO_TOKEN UINT64_MAX
+
+/** @brief A reactor registered with lf_checkpoint_register(). */
+typedef struct checkpoint_reactor_t {
+  self_base_t* self;
+  size_t self_size;
+  lf_checkpoint_save_t save;
+  lf_checkpoint_restore_t restore;
+  uint32_t index; // The order of registration.
+} checkpoint_reactor_t;
+
+/**
+ * @brief The start of a checkpoint, which is followed by the state of each registered reactor
+ * and then by the pending events.
+ */
+typedef struct checkpoint_header_t {
+  uint32_t magic;
+  uint32_t env_id;
+  uint64_t size; // The size of the checkpoint in bytes.
+  uint32_t num_reactors;
+  uint32_t num_events;
+} checkpoint_header_t;
+
+/** @brief A pending event, which is followed by its payload. */
+typedef struct checkpoint_event_t {
+  uint32_t reactor;   // The index of the registered reactor whose self struct contains the trigger.
+  uint32_t microstep; // The microstep, which is relative to that of the checkpoint if the delay is 0.
+  uint64_t offset;    // The offset of the trigger in the self struct.
+  int64_t delay;      // The logical time after the tag of the checkpoint.
+  uint64_t length;    // The length of the token, or CHECKPOINT_NO_TOKEN.
+  uint64_t bytes;     // The size of the payload.
+} checkpoint_event_t;
+
+/** @brief Return `size` rounded up to a multiple of 8, so that every record is aligned. */
+static size_t padded(size_t size) { return (size + 7) & ~(size_t)7; }
+
+void lf_checkpoint_register(self_base_t* self, size_t self_size, lf_checkpoint_save_t save,
+                            lf_checkpoint_restore_t restore) {
+  environment_t* env = self->environment;
+  checkpoint_reactor_t* reactor = (checkpoint_reactor_t*)malloc(sizeof(checkpoint_reactor_t));
+  LF_ASSERT_NON_NULL(reactor);
+  *reactor = (checkpoint_reactor_t){.self = self,
+                                    .self_size = self_size,
+                                    .save = save,
+                                    .restore = restore,
+                                    .index = (uint32_t)vector_size(&env->checkpoint_reactors)};
+  vector_push(&env->checkpoint_reactors, reactor);
+}
+
+static int compare_reactors(const void* a, const void* b) {
+  uintptr_t x = (uintptr_t)(*(checkpoint_reactor_t* const*)a)->self;
+  uintptr_t y = (uintptr_t)(*(checkpoint_reactor_t* const*)b)->self;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Return the registered reactor whose self struct contains the trigger, or NULL if there is none.
+ * @param sorted The registered reactors in the order of the addresses of their self structs.
+ * @param count The number of registered reactors.
+ * @param trigger The trigger.
+ */
+static checkpoint_reactor_t* find_reactor(checkpoint_reactor_t** sorted, size_t count, trigger_t* trigger) {
+  uintptr_t address = (uintptr_t)trigger;
+  size_t low = 0;
+  size_t high = count;
+  // Find the last self struct that starts at or before the trigger.
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    if ((uintptr_t)sorted[middle]->self <= address) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low == 0) {
+    return NULL;
+  }
+  checkpoint_reactor_t* reactor = sorted[low - 1];
+  uintptr_t start = (uintptr_t)reactor->self;
+  return address + sizeof(trigger_t) <= start + reactor->self_size ? reactor : NULL;
+}
+
+/**
+ * @brief Return the size of the checkpoint of the environment, or 0 if it cannot be saved,
+ * which has been reported.
+ * @param env The environment.
+ * @param events The pending events.
+ * @param event_reactors Where to put the registered reactor of each pending event.
+ * @param state_sizes Where to put the size of the state of each registered reactor.
+ */
+static size_t checkpoint_size(environment_t* env, vector_t* events, checkpoint_reactor_t** event_reactors,
+                              size_t* state_sizes) {
+  size_t num_reactors = vector_size(&env->checkpoint_reactors);
+  checkpoint_reactor_t** sorted = (checkpoint_reactor_t**)calloc(num_reactors + 1, sizeof(checkpoint_reactor_t*));
+  LF_ASSERT_NON_NULL(sorted);
+  size_t size = sizeof(checkpoint_header_t);
+  for (size_t i = 0; i < num_reactors; i++) {
+    checkpoint_reactor_t* reactor = VECTOR_GET(&env->checkpoint_reactors, i, checkpoint_reactor_t*);
+    sorted[i] = reactor;
+    state_sizes[i] = reactor->save != NULL ? reactor->save(reactor->self, NULL, 0) : 0;
+    size += sizeof(uint64_t) + padded(state_sizes[i]);
+  }
+  qsort(sorted, num_reactors, sizeof(checkpoint_reactor_t*), compare_reactors);
+  for (size_t i = 0; i < vector_size(events) && size > 0; i++) {
+    event_t* event = VECTOR_GET(events, i, event_t*);
+    event_reactors[i] = find_reactor(sorted, num_reactors, event->trigger);
+    lf_token_t* token = event->token;
+    if (event_reactors[i] == NULL) {
+      lf_print_error("Checkpoint: the trigger of a pending event is not in a registered reactor.");
+      size = 0;
+    } else if (token != NULL && token->value != NULL &&
+               (token->type->destructor != NULL || token->type->copy_constructor != NULL)) {
+      lf_print_error("Checkpoint: the payload of a pending event is not plain data.");
+      size = 0;
+    } else {
+      size += sizeof(checkpoint_event_t);
+      if (token != NULL && token->value != NULL) {
+        size += padded(token->length * token->type->element_size);
+      }
+    }
+  }
+  free(sorted);
+  return size;
+}
+
+/**
+ * @brief Write the checkpoint of the environment to `block`.
+ * @param env The environment.
+ * @param events The pending events.
+ * @param event_reactors The registered reactor of each pending event.
+ * @param state_sizes The size of the state of each registered reactor.
+ * @param block The memory to write to, of the size returned by checkpoint_size().
+ * @param size The size of `block`.
+ * @return 0 on success or -1 if the state of a reactor has changed size, which has been reported.
+ */
+static int write_checkpoint(environment_t* env, vector_t* events, checkpoint_reactor_t** event_reactors,
+                            size_t* state_sizes, char* block, size_t size) {
+  size_t num_reactors = vector_size(&env->checkpoint_reactors);
+  *(checkpoint_header_t*)block = (checkpoint_header_t){.magic = CHECKPOINT_MAGIC,
+                                                       .env_id = (uint32_t)env->id,
+                                                       .size = size,
+                                                       .num_reactors = (uint32_t)num_reactors,
+                                                       .num_events = (uint32_t)vector_size(events)};
+  char* p = block + sizeof(checkpoint_header_t);
+  for (size_t i = 0; i < num_reactors; i++) {
+    checkpoint_reactor_t* reactor = VECTOR_GET(&env->checkpoint_reactors, i, checkpoint_reactor_t*);
+    *(uint64_t*)p = state_sizes[i];
+    p += sizeof(uint64_t);
+    if (reactor->save != NULL && reactor->save(reactor->self, p, state_sizes[i]) != state_sizes[i]) {
+      lf_print_error("Checkpoint: the size of the state of a reactor changed while it was saved.");
+      return -1;
+    }
+    p += padded(state_sizes[i]);
+  }
+  tag_t now = env->current_tag;
+  for (size_t i = 0; i < vector_size(events); i++) {
+    event_t* event = VECTOR_GET(events, i, event_t*);
+    checkpoint_event_t* record = (checkpoint_event_t*)p;
+    p += sizeof(checkpoint_event_t);
+    tag_t tag = event->base.tag;
+    *record = (checkpoint_event_t){.reactor = event_reactors[i]->index,
+                                   .microstep = tag.time == now.time ? tag.microstep - now.microstep : tag.microstep,
+                                   .offset = (uint64_t)((char*)event->trigger - (char*)event_reactors[i]->self),
+                                   .delay = tag.time - now.time,
+                                   .length = CHECKPOINT_NO_TOKEN,
+                                   .bytes = 0};
+    lf_token_t* token = event->token;
+    if (token != NULL) {
+      record->length = token->length;
+      if (token->value != NULL) {
+        record->bytes = token->length * token->type->element_size;
+        memcpy(p, token->value, record->bytes);
+        p += padded(record->bytes);
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Return the pending events of the environment that are saved in a checkpoint.
+ * Dummy events have no trigger and are never saved.
+ * @param env The environment.
+ * @param keep Function that returns whether the events of a trigger are saved, or NULL to save all.
+ */
+static vector_t collect_events(environment_t* env, bool (*keep)(trigger_t*)) {
+  // The event queue cannot be traversed, so the events are taken off it and put back afterwards.
+  vector_t popped = vector_new(pqueue_tag_size(env->event_q) + 1);
+  event_t* event;
+  while ((event = (event_t*)pqueue_tag_pop(env->event_q)) != NULL) {
+    vector_push(&popped, event);
+  }
+  vector_t events = vector_new(vector_size(&popped) + vector_size(&env->next_microstep_events) + 1);
+  for (size_t i = 0; i < vector_size(&popped); i++) {
+    event = VECTOR_GET(&popped, i, event_t*);
+    pqueue_tag_insert(env->event_q, &event->base);
+    if (event->trigger != NULL && (keep == NULL || keep(event->trigger))) {
+      vector_push(&events, event);
+    }
+  }
+  vector_free(&popped);
+  for (size_t i = 0; i < vector_size(&env->next_microstep_events); i++) {
+    event = VECTOR_GET(&env->next_microstep_events, i, event_t*);
+    if (event->trigger != NULL && (keep == NULL || keep(event->trigger))) {
+      vector_push(&events, event);
+    }
+  }
+  return events;
+}
+
+/**
+ * @brief Restore the state of the registered reactors from a checkpoint and schedule its events.
+ * @param env The environment.
+ * @param block The checkpoint, whose header has been checked.
+ * @param size The size of the checkpoint.
+ * @param origin The tag at which the checkpoint was taken, relative to which the events are scheduled.
+ * @param source The name of the checkpoint in error messages.
+ * @return The number of events.
+ */
+static uint32_t restore_block(environment_t* env, const char* block, size_t size, tag_t origin, const char* source) {
+  const checkpoint_header_t* header = (const checkpoint_header_t*)block;
+  size_t num_reactors = vector_size(&env->checkpoint_reactors);
+  if (header->num_reactors != num_reactors) {
+    lf_print_error_and_exit("The checkpoint %s has %u reactors, but %zu are registered.", source, header->num_reactors,
+                            num_reactors);
+  }
+  const char* p = block + sizeof(checkpoint_header_t);
+  const char* end = block + size;
+  for (size_t i = 0; i < num_reactors; i++) {
+    checkpoint_reactor_t* reactor = VECTOR_GET(&env->checkpoint_reactors, i, checkpoint_reactor_t*);
+    uint64_t state_size = (size_t)(end - p) >= sizeof(uint64_t) ? *(const uint64_t*)p : UINT64_MAX;
+    p += sizeof(uint64_t);
+    if (state_size > (uint64_t)(end - p) ||
+        (reactor->restore != NULL ? reactor->restore(reactor->self, p, state_size) != 0 : state_size != 0)) {
+      lf_print_error_and_exit("Failed to restore the state of a reactor from %s.", source);
+    }
+    p += padded(state_size);
+  }
+  for (uint32_t i = 0; i < header->num_events; i++) {
+    const checkpoint_event_t* record = (const checkpoint_event_t*)p;
+    p += sizeof(checkpoint_event_t);
+    if (p > end || record->reactor >= num_reactors || record->delay < 0 || record->bytes > (uint64_t)(end - p)) {
+      lf_print_error_and_exit("The checkpoint %s is corrupt.", source);
+    }
+    checkpoint_reactor_t* reactor = VECTOR_GET(&env->checkpoint_reactors, record->reactor, checkpoint_reactor_t*);
+    if (record->offset + sizeof(trigger_t) > reactor->self_size) {
+      lf_print_error_and_exit("The checkpoint %s is corrupt.", source);
+    }
+    trigger_t* trigger = (trigger_t*)((char*)reactor->self + record->offset);
+    tag_t tag = record->delay == 0 ? (tag_t){.time = origin.time, .microstep = origin.microstep + record->microstep}
+                                   : (tag_t){.time = origin.time + record->delay, .microstep = record->microstep};
+    lf_token_t* token = NULL;
+    if (record->length != CHECKPOINT_NO_TOKEN) {
+      if (record->bytes > 0) {
+        token = _lf_initialize_token(&trigger->tmplt, record->length);
+        if (record->bytes != record->length * token->type->element_size) {
+          lf_print_error_and_exit("The checkpoint %s is corrupt.", source);
+        }
+        memcpy(token->value, p, record->bytes);
+      } else {
+        token = _lf_new_token((token_type_t*)trigger, NULL, record->length);
+      }
+    }
+    p += padded(record->bytes);
+    _lf_schedule_at_tag(env, trigger, tag, token);
+  }
+  return header->num_events;
+}
+
+#ifdef LF_CHECKPOINT
+void lf_checkpoint(environment_t* env, const char* file) {
+  char* copy = strdup(file);
+  LF_ASSERT_NON_NULL(copy);
+  LF_CRITICAL_SECTION_ENTER(env);
+  free(env->checkpoint_file);
+  env->checkpoint_file = copy;
+  LF_CRITICAL_SECTION_EXIT(env);
+}
+
+/**
+ * @brief Save the checkpoint of the environment to its file.
+ * It is written to a temporary file, which replaces the file only once it is complete.
+ * @param env The environment.
+ * @param events The pending events.
+ * @return 0 on success or -1 on failure, which has been reported.
+ */
+static int save(environment_t* env, vector_t* events) {
+  size_t num_reactors = vector_size(&env->checkpoint_reactors);
+  checkpoint_reactor_t** event_reactors =
+      (checkpoint_reactor_t**)calloc(vector_size(events) + 1, sizeof(checkpoint_reactor_t*));
+  size_t* state_sizes = (size_t*)calloc(num_reactors + 1, sizeof(size_t));
+  size_t name_size = strlen(env->checkpoint_file) + sizeof(".tmp");
+  char* temporary = (char*)malloc(name_size);
+  LF_ASSERT_NON_NULL(event_reactors);
+  LF_ASSERT_NON_NULL(state_sizes);
+  LF_ASSERT_NON_NULL(temporary);
+  snprintf(temporary, name_size, "%s.tmp", env->checkpoint_file);
+
+  int result = -1;
+  size_t size = checkpoint_size(env, events, event_reactors, state_sizes);
+  int fd = size > 0 ? open(temporary, O_CREAT | O_TRUNC | O_RDWR, 0644) : -1;
+  if (fd >= 0) {
+    void* block = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) {
+      block = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (block == MAP_FAILED) {
+      lf_print_error("Checkpoint: failed to map %s.", temporary);
+    } else {
+      if (write_checkpoint(env, events, event_reactors, state_sizes, (char*)block, size) == 0 &&
+          msync(block, size, MS_SYNC) == 0) {
+        result = 0;
+      }
+      munmap(block, size);
+    }
+    close(fd);
+    if (result == 0 && rename(temporary, env->checkpoint_file) != 0) {
+      result = -1;
+    }
+    if (result != 0) {
+      unlink(temporary);
+    }
+  } else if (size > 0) {
+    lf_print_error("Checkpoint: failed to create %s.", temporary);
+  }
+  if (result == 0) {
+    LF_PRINT_LOG("Saved a checkpoint with %zu reactors and %zu events to %s at elapsed tag " PRINTF_TAG ".",
+                 num_reactors, vector_size(events), env->checkpoint_file, lf_time_logical_elapsed(env),
+                 env->current_tag.microstep);
+  }
+  free(temporary);
+  free(state_sizes);
+  free(event_reactors);
+  return result;
+}
+
+void _lf_checkpoint_save_if_requested(environment_t* env) {
+  if (env->checkpoint_file == NULL) {
+    return;
+  }
+  vector_t events = collect_events(env, NULL);
+  if (save(env, &events) != 0) {
+    lf_print_warning("Failed to save a checkpoint to %s.", env->checkpoint_file);
+  }
+  vector_free(&events);
+  free(env->checkpoint_file);
+  env->checkpoint_file = NULL;
+}
+
+bool _lf_checkpoint_restore(environment_t* env) {
+  if (_lf_checkpoint_restore_file == NULL) {
+    return false;
+  }
+  int fd = open(_lf_checkpoint_restore_file, O_RDONLY);
+  struct stat status;
+  if (fd < 0 || fstat(fd, &status) != 0) {
+    lf_print_error_and_exit("Failed to open the checkpoint %s.", _lf_checkpoint_restore_file);
+  }
+  size_t size = (size_t)status.st_size;
+  void* block = size >= sizeof(checkpoint_header_t) ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  const checkpoint_header_t* header = (const checkpoint_header_t*)block;
+  if (block == MAP_FAILED || header->magic != CHECKPOINT_MAGIC || header->size != size) {
+    lf_print_error_and_exit("%s is not a checkpoint.", _lf_checkpoint_restore_file);
+  }
+  if (header->env_id != (uint32_t)env->id) {
+    // The checkpoint is of another environment, which starts afresh.
+    munmap(block, size);
+    return false;
+  }
+  // The tag of the checkpoint becomes the current tag, which is the start tag.
+  uint32_t num_events = restore_block(env, (const char*)block, size, env->current_tag, _lf_checkpoint_restore_file);
+  munmap(block, size);
+  // Trigger the reactions of the events at the tag of the checkpoint, which is the current tag.
+  _lf_pop_events(env);
+  lf_print("---- Resuming from the checkpoint %s with %u pending events.", _lf_checkpoint_restore_file, num_events);
+  return true;
+}
+#endif // LF_CHECKPOINT
+
+#ifdef LF_FEDERATED_OPTIMISTIC
+int _lf_checkpoint_to_memory(environment_t* env, bool (*keep)(trigger_t*), lf_checkpoint_memory_t* checkpoint) {
+  vector_t events = collect_events(env, keep);
+  size_t num_reactors = vector_size(&env->checkpoint_reactors);
+  checkpoint_reactor_t** event_reactors =
+      (checkpoint_reactor_t**)calloc(vector_size(&events) + 1, sizeof(checkpoint_reactor_t*));
+  size_t* state_sizes = (size_t*)calloc(num_reactors + 1, sizeof(size_t));
+  LF_ASSERT_NON_NULL(event_reactors);
+  LF_ASSERT_NON_NULL(state_sizes);
+  int result = -1;
+  size_t size = checkpoint_size(env, &events, event_reactors, state_sizes);
+  if (size > 0) {
+    if (size > checkpoint->capacity) {
+      free(checkpoint->block);
+      checkpoint->block = (char*)malloc(size);
+      LF_ASSERT_NON_NULL(checkpoint->block);
+      checkpoint->capacity = size;
+    }
+    if (write_checkpoint(env, &events, event_reactors, state_sizes, checkpoint->block, size) == 0) {
+      checkpoint->size = size;
+      checkpoint->tag = env->current_tag;
+      result = 0;
+    }
+  }
+  free(state_sizes);
+  free(event_reactors);
+  vector_free(&events);
+  return result;
+}
+
+void _lf_checkpoint_from_memory(environment_t* env, const lf_checkpoint_memory_t* checkpoint) {
+  restore_block(env, checkpoint->block, checkpoint->size, checkpoint->tag, "in memory");
+}
+
+void _lf_checkpoint_free_memory(lf_checkpoint_memory_t* checkpoint) {
+  free(checkpoint->block);
+  *checkpoint = (lf_checkpoint_memory_t){.block = NULL, .size = 0, .capacity = 0, .tag = NEVER_TAG};
+}
+#endif // LF_FEDERATED_OPTIMISTIC
+
+void _lf_checkpoint_free(environment_t* env) {
+  for (size_t i = 0; i < vector_size(&env->checkpoint_reactors); i++) {
+    free(VECTOR_GET(&env->checkpoint_reactors, i, checkpoint_reactor_t*));
+  }
+  vector_free(&env->checkpoint_reactors);
+#ifdef LF_CHECKPOINT
+  free(env->checkpoint_file);
+  env->checkpoint_file = NULL;
+#endif
+}
@@ -6,7 +6,9 @@
  * @brief Implementations of functions in clock.h.
  */
 #include "clock.h"
+#include "environment.h"
 #include "low_level_platform.h"
+#include "util.h"
 
 // If we are federated, include clock-sync API (and implementation)
 #if defined(FEDERATED)
@@ -17,34 +19,104 @@ void clock_sync_add_offset(instant_t* t) { (void)t; }
 void clock_sync_subtract_offset(instant_t* t) { (void)t; }
 #endif // defined(FEDERATED)
 
-static instant_t last_read_physical_time = NEVER;
+// Per-thread state. The single-threaded runtime has only one thread and may lack thread_local.
+#if defined(LF_SINGLE_THREADED)
+#define CLOCK_THREAD_LOCAL
+#else
+#define CLOCK_THREAD_LOCAL thread_local
+#endif
+
+// The last time read by lf_clock_gettime_fenced. It is only written by fenced reads,
+// so the other reads only load it and its cache line is not bounced between cores.
+static instant_t last_fenced_physical_time = NEVER;
+
+// The last time read by this thread.
+static CLOCK_THREAD_LOCAL instant_t last_read_physical_time = NEVER;
 
 int lf_clock_gettime(instant_t* now) {
-  instant_t last_read_local;
   int res = _lf_clock_gettime(now);
   if (res != 0) {
     return -1;
   }
   clock_sync_add_offset(now);
+
+  // Ensure monotonicity with respect to this thread and to the fenced reads.
+  // This is done with atomics to guarantee that it works on 32bit platforms as well.
+  instant_t last_read_local = lf_atomic_load64(&last_fenced_physical_time);
+  if (last_read_local < last_read_physical_time) {
+    last_read_local = last_read_physical_time;
+  }
+  if (*now < last_read_local) {
+    *now = last_read_local + 1;
+  }
+  last_read_physical_time = *now;
+  return 0;
+}
+
+int lf_clock_gettime_fenced(instant_t* now) {
+  if (lf_clock_gettime(now) != 0) {
+    return -1;
+  }
+  instant_t last_fenced_local;
   do {
-    // Atomically fetch the last read value. This is done with
-    // atomics to guarantee that it works on 32bit platforms as well.
-    last_read_local = lf_atomic_fetch_add64(&last_read_physical_time, 0);
+    last_fenced_local = lf_atomic_load64(&last_fenced_physical_time);
 
     // Ensure monotonicity.
-    if (*now < last_read_local) {
-      *now = last_read_local + 1;
+    if (*now < last_fenced_local) {
+      *now = last_fenced_local + 1;
+    } else if (*now == last_fenced_local) {
+      break;
     }
 
-    // Update the last read value, atomically and also make sure that another
-    // thread has not been here in between and changed it. If so. We must redo
+    // Update the last fenced value, atomically and also make sure that another
+    // thread has not been here in between and changed it. If so, we must redo
     // the monotonicity calculation.
-  } while (!lf_atomic_bool_compare_and_swap64(&last_read_physical_time, last_read_local, *now));
+  } while (!lf_atomic_bool_compare_and_swap64(&last_fenced_physical_time, last_fenced_local, *now));
+
+  last_read_physical_time = *now;
+  return 0;
+}
+
+void lf_clock_set_timer_slack(interval_t slack) {
+#ifdef PLATFORM_Linux
+  // The slack last set on this thread, so that the system is only called when it changes.
+  static CLOCK_THREAD_LOCAL interval_t thread_timer_slack = -1;
+  if (slack >= 0 && slack != thread_timer_slack) {
+    if (lf_thread_set_timer_slack(slack) != 0) {
+      lf_print_warning("Failed to set the timer slack to " PRINTF_TIME " ns.", slack);
+    }
+    thread_timer_slack = slack;
+  }
+#else
+  (void)slack;
+#endif
+}
 
+int lf_clock_spin_until(instant_t wakeup_time, int32_t* changes, int32_t seen) {
+  instant_t now;
+  while (lf_clock_gettime(&now) == 0 && now < wakeup_time) {
+    if (changes != NULL && lf_atomic_fetch_add32(changes, 0) != seen) {
+      return -1;
+    }
+    LF_CPU_RELAX();
+  }
   return 0;
 }
 
 int lf_clock_interruptable_sleep_until_locked(environment_t* env, instant_t wakeup_time) {
+  lf_clock_set_timer_slack(env->timer_slack);
+  if (env->spin_wait_threshold > 0) {
+    // Sleep until the threshold before the wakeup time and spin for the rest.
+    instant_t sleep_until_time = wakeup_time - env->spin_wait_threshold;
+    instant_t now;
+    if (lf_clock_gettime(&now) == 0 && now < sleep_until_time) {
+      clock_sync_subtract_offset(&sleep_until_time);
+      if (_lf_interruptable_sleep_until_locked(env, sleep_until_time) != 0) {
+        return -1;
+      }
+    }
+    return lf_clock_spin_until(wakeup_time, NULL, 0);
+  }
   // Remove any clock sync offset and call the Platform API.
   clock_sync_subtract_offset(&wakeup_time);
   return _lf_interruptable_sleep_until_locked(env, wakeup_time);
@@ -54,6 +126,14 @@ int lf_clock_interruptable_sleep_until_locked(environment_t* env, instant_t wake
 int lf_clock_cond_timedwait(lf_cond_t* cond, instant_t wakeup_time) {
   // Remove any clock sync offset and call the Platform API.
   clock_sync_subtract_offset(&wakeup_time);
+#ifdef LF_LOCK_PROFILE
+  // The wait releases the mutex and reacquires it.
+  _lf_lock_profile_released(cond->mutex);
+  int result = _lf_cond_timedwait(cond, wakeup_time);
+  _lf_lock_profile_acquired(cond->mutex, __FILE__, __LINE__, NEVER);
+  return result;
+#else
   return _lf_cond_timedwait(cond, wakeup_time);
+#endif
 }
 #endif // !defined(LF_SINGLE_THREADED)
@@ -0,0 +1,116 @@
+/**
+ * @file
+ * @brief Energy-aware scaling of the CPU frequency from the utilization and the deadline slack.
+ *
+ * See dvfs.h.
+ */
+
+#include "dvfs.h"
+#include "low_level_platform.h"
+#include "util.h"
+
+/** The period at which the performance is adjusted to the utilization. */
+#ifndef LF_DVFS_PERIOD
+#define LF_DVFS_PERIOD MSEC(100)
+#endif
+
+/** The percentage of the time that the busiest environment should be busy. */
+#ifndef LF_DVFS_TARGET_UTILIZATION
+#define LF_DVFS_TARGET_UTILIZATION 70
+#endif
+
+/** The lowest performance, in percent of the maximum. */
+#ifndef LF_DVFS_MIN_PERFORMANCE
+#define LF_DVFS_MIN_PERFORMANCE 30
+#endif
+
+/** The slack, in percent of the deadline, below which the performance is raised to the maximum. */
+#ifndef LF_DVFS_SLACK_LOW
+#define LF_DVFS_SLACK_LOW 25
+#endif
+
+/** The performance that was last set, in percent of the maximum. */
+static int performance = 100;
+
+/** Whether setting the performance failed, in which case it is not tried again. */
+static bool unavailable = false;
+
+/** Taken by the thread that sets the performance. */
+static int32_t setting = 0;
+
+/**
+ * @brief Set the performance, unless it is already set or cannot be set.
+ * @param percent The performance in percent of the maximum.
+ */
+static void set_performance(int percent) {
+  while (!lf_atomic_bool_compare_and_swap32(&setting, 0, 1)) {
+    LF_CPU_RELAX();
+  }
+  if (percent != performance && !unavailable) {
+    if (lf_cpu_set_performance(percent) == 0) {
+      LF_PRINT_LOG("DVFS: performance set to %d%%.", percent);
+      performance = percent;
+    } else {
+      lf_print_warning("DVFS: the CPU frequency cannot be set or clamped. The CPUs run as the governor decides.");
+      unavailable = true;
+    }
+  }
+  lf_atomic_bool_compare_and_swap32(&setting, 1, 0);
+}
+
+void lf_dvfs_tag_started(environment_t* env) { env->dvfs_busy_since = lf_time_physical(); }
+
+void lf_dvfs_tag_completed(environment_t* env) {
+  instant_t now = lf_time_physical();
+  if (env->dvfs_busy_since != NEVER) {
+    env->dvfs_busy += now - env->dvfs_busy_since;
+    env->dvfs_busy_since = NEVER;
+  }
+  if (env->dvfs_period_start == NEVER) {
+    env->dvfs_period_start = now;
+    return;
+  }
+  interval_t elapsed = now - env->dvfs_period_start;
+  if (elapsed < LF_DVFS_PERIOD) {
+    return;
+  }
+  // Busy time is taken to scale with the inverse of the performance.
+  int current = performance;
+  int64_t utilization = env->dvfs_busy * 100 / elapsed;
+  int required = (int)((current * utilization + LF_DVFS_TARGET_UTILIZATION - 1) / LF_DVFS_TARGET_UTILIZATION);
+  required = LF_MAX(LF_DVFS_MIN_PERFORMANCE, LF_MIN(100, required));
+  if (required < current && env->dvfs_min_slack < 2 * LF_DVFS_SLACK_LOW) {
+    required = current;
+  }
+  LF_PRINT_DEBUG("DVFS: environment %u was busy %lld%% of the last period and requires %d%%.", env->id,
+                 (long long)utilization, required);
+  env->dvfs_required = required;
+  env->dvfs_busy = 0;
+  env->dvfs_min_slack = 100;
+  env->dvfs_period_start = now;
+
+  // The CPUs are shared, so the busiest environment decides.
+  environment_t* envs;
+  int num_envs = _lf_get_environments(&envs);
+  for (int i = 0; i < num_envs; i++) {
+    required = LF_MAX(required, envs[i].dvfs_required);
+  }
+  set_performance(required);
+}
+
+void lf_dvfs_reaction_ended(environment_t* env, reaction_t* reaction, instant_t end) {
+  if (reaction->deadline <= 0) {
+    return;
+  }
+  int slack = (int)LF_MAX((env->current_tag.time + reaction->deadline - end) * 100 / reaction->deadline, -1);
+  // Workers may race to lower the minimum, which at worst keeps a higher one for a period.
+  if (slack < env->dvfs_min_slack) {
+    env->dvfs_min_slack = slack;
+  }
+  if (slack < LF_DVFS_SLACK_LOW && performance < 100) {
+    env->dvfs_required = 100;
+    set_performance(100);
+  }
+}
+
+void lf_dvfs_terminate(void) { set_performance(100); }
@@ -12,9 +12,25 @@
 #include "util.h"
 #include "lf_types.h"
 #include <string.h>
+#include <stddef.h> // Defines max_align_t
+#include <assert.h>
 #include "tracepoint.h"
+#include "memory_accounting.h"
 #if !defined(LF_SINGLE_THREADED)
 #include "scheduler.h"
+#include "enclave_channel.h"
+#endif
+#ifdef LF_STATIC_SCHEDULE
+#include "static_schedule.h"
+#endif
+#ifdef LF_REACTION_PROFILE
+#include "reaction_profile.h"
+#endif
+#if defined(LF_CHECKPOINT) || defined(LF_FEDERATED_OPTIMISTIC)
+#include "checkpoint.h"
+#endif
+#ifdef LF_TAG_PIPELINING
+#include "pipeline.h"
 #endif
 
 //////////////////
@@ -42,21 +58,124 @@ static void print_event(void* event) {
                  (void*)e->trigger, (void*)e->token);
 }
 
+/**
+ * @brief A block of memory from which the arrays of an environment are carved.
+ * While `base` is NULL, carving only adds up the size that the block needs.
+ */
+typedef struct environment_block_t {
+  char* base;
+  size_t size;
+} environment_block_t;
+
+/**
+ * @brief Carve an array of `count` elements of `size` bytes from the block.
+ * Each array starts at a multiple of sizeof(max_align_t) from the base of the block.
+ * @return The array, or NULL if `count` is zero or the block is only being measured.
+ */
+static void* environment_carve(environment_block_t* block, size_t count, size_t size) {
+  if (count == 0) {
+    return NULL;
+  }
+  void* array = (block->base == NULL) ? NULL : block->base + block->size;
+  block->size += (count * size + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+  return array;
+}
+
+/**
+ * @brief Carve the arrays of the environment whose sizes are known at initialization from the block.
+ * This is called twice by environment_init, first to measure the block and then to assign the arrays,
+ * so that an environment costs one allocation however many arrays it has. The sizes of the environment
+ * must be set.
+ */
+static void environment_carve_arrays(environment_t* env, environment_block_t* block, const char* name,
+                                     int num_workers, int num_modes, int num_state_resets) {
+  size_t num_fields = (size_t)env->is_present_fields_size;
+  env->name = (char*)environment_carve(block, strlen(name) + 1, 1);
+#ifndef LF_STATIC_TOPOLOGY
+  env->timer_triggers = (trigger_t**)environment_carve(block, env->timer_triggers_size, sizeof(trigger_t*));
+  env->startup_reactions = (reaction_t**)environment_carve(block, env->startup_reactions_size, sizeof(reaction_t*));
+  env->shutdown_reactions = (reaction_t**)environment_carve(block, env->shutdown_reactions_size, sizeof(reaction_t*));
+  env->reset_reactions = (reaction_t**)environment_carve(block, env->reset_reactions_size, sizeof(reaction_t*));
+  env->is_present_fields = (bool**)environment_carve(block, num_fields, sizeof(bool*));
+#else
+  // The tables are given by lf_environment_set_topology.
+  env->timer_triggers = NULL;
+  env->startup_reactions = NULL;
+  env->shutdown_reactions = NULL;
+  env->reset_reactions = NULL;
+  env->is_present_fields = NULL;
+#endif
+  env->is_present_fields_abbreviated = (bool**)environment_carve(block, num_fields, sizeof(bool*));
+  env->watchdogs = (watchdog_t**)environment_carve(block, env->watchdogs_size, sizeof(watchdog_t*));
+#ifdef FEDERATED_DECENTRALIZED
+  env->_lf_intended_tag_fields = (tag_t**)environment_carve(block, num_fields, sizeof(tag_t*));
+  env->_lf_intended_tag_fields_size = (int)num_fields;
+#endif
+#if !defined(LF_SINGLE_THREADED)
+  env->thread_ids = (lf_thread_t*)environment_carve(block, num_workers, sizeof(lf_thread_t));
+  env->worker_present_fields = (lf_present_list_t*)environment_carve(block, num_workers, sizeof(lf_present_list_t));
+  // Each list can hold all is_present fields, so that the lists never overflow.
+  for (int i = 0; i < num_workers; i++) {
+    bool** fields = (bool**)environment_carve(block, num_fields, sizeof(bool*));
+    if (block->base != NULL) {
+      env->worker_present_fields[i].fields = fields;
+    }
+  }
+#else
+  (void)num_workers;
+#endif
+#ifdef MODAL_REACTORS
+  env->modes = (mode_environment_t*)environment_carve(block, num_modes > 0 ? 1 : 0, sizeof(mode_environment_t));
+  if (num_modes > 0) {
+    reactor_mode_state_t** states =
+        (reactor_mode_state_t**)environment_carve(block, num_modes, sizeof(reactor_mode_state_t*));
+    mode_state_variable_reset_data_t* resets = (mode_state_variable_reset_data_t*)environment_carve(
+        block, num_state_resets, sizeof(mode_state_variable_reset_data_t));
+    if (block->base != NULL) {
+      env->modes->modal_reactor_states = states;
+      env->modes->modal_reactor_states_size = num_modes;
+      env->modes->state_resets = resets;
+      env->modes->state_resets_size = num_state_resets;
+    }
+  }
+#else
+  (void)num_modes;
+  (void)num_state_resets;
+#endif
+}
+
 /**
  * @brief Initialize the threaded part of the environment struct.
  */
 static void environment_init_threaded(environment_t* env, int num_workers) {
 #if !defined(LF_SINGLE_THREADED)
   env->num_workers = num_workers;
-  env->thread_ids = (lf_thread_t*)calloc(num_workers, sizeof(lf_thread_t));
-  LF_ASSERT_NON_NULL(env->thread_ids);
   env->barrier.requestors = 0;
   env->barrier.horizon = FOREVER_TAG;
 
   // Initialize synchronization objects.
   LF_MUTEX_INIT(&env->mutex);
+  LF_LOCK_PROFILE_NAME(&env->mutex, env->name);
   LF_COND_INIT(&env->event_q_changed, &env->mutex);
+  env->event_q_changes = 0;
+  env->ingress = NULL;
+  env->ingress_pending = NULL;
+  env->ingress_pending_last = NULL;
+  env->ingress_count = 0;
+  env->ingress_capacity = 0;
+  env->ingress_max_tag_lag = FOREVER;
+  env->ingress_shedding = false;
+  env->ingress_overloaded = false;
+  env->ingress_limits = NULL;
+  env->ingress_rejected = 0;
+  env->ingress_shed = 0;
+  env->enclave_channels = NULL;
   LF_COND_INIT(&env->global_tag_barrier_requestors_reached_zero, &env->mutex);
+#ifdef _PYTHON_TARGET_ENABLED
+  LF_MUTEX_INIT(&env->python_mutex);
+  env->python_worker_busy = false;
+  env->python_reactions = vector_new(num_workers);
+#endif
 #else
   (void)env;
   (void)num_workers;
@@ -71,71 +190,42 @@ static void environment_init_single_threaded(environment_t* env) {
   // Reaction queue ordered first by deadline, then by level.
   // The index of the reaction holds the deadline in the 48 most significant bits,
   // the level in the 16 least significant bits.
-  env->reaction_q = pqueue_init(INITIAL_REACT_QUEUE_SIZE, in_reverse_order, get_reaction_index, get_reaction_position,
-                                set_reaction_position, reaction_matches, print_reaction);
-
-#else
-  (void)env;
-#endif
-}
-
-/**
- * @brief Initialize the modal-specific parts of the environment struct.
- */
-static void environment_init_modes(environment_t* env, int num_modes, int num_state_resets) {
-#ifdef MODAL_REACTORS
-  if (num_modes > 0) {
-    mode_environment_t* modes = (mode_environment_t*)calloc(1, sizeof(mode_environment_t));
-    LF_ASSERT_NON_NULL(modes);
-    modes->modal_reactor_states = (reactor_mode_state_t**)calloc(num_modes, sizeof(reactor_mode_state_t*));
-    LF_ASSERT_NON_NULL(modes->modal_reactor_states);
-    modes->modal_reactor_states_size = num_modes;
-    modes->triggered_reactions_request = 0;
-
-    modes->state_resets_size = num_state_resets;
-    if (modes->state_resets_size > 0) {
-      modes->state_resets =
-          (mode_state_variable_reset_data_t*)calloc(modes->state_resets_size, sizeof(mode_state_variable_reset_data_t));
-      LF_ASSERT_NON_NULL(modes->state_resets);
-    } else {
-      modes->state_resets = NULL;
-    }
-
-    env->modes = modes;
-
-  } else {
-    env->modes = NULL;
-  }
+#ifdef LF_STATIC_MEMORY
+  env->reaction_q = reaction_queue_init(LF_MAX_REACTIONS);
 #else
-  (void)env;
-  (void)num_modes;
-  (void)num_state_resets;
+  env->reaction_q = reaction_queue_init(INITIAL_REACT_QUEUE_SIZE);
 #endif
-}
+  env->isr_rings = NULL;
 
-/**
- * @brief Initialize the federation-specific parts of the environment struct.
- */
-static void environment_init_federated(environment_t* env, int num_is_present_fields) {
-#ifdef FEDERATED_DECENTRALIZED
-  if (num_is_present_fields > 0) {
-    env->_lf_intended_tag_fields = (tag_t**)calloc(num_is_present_fields, sizeof(tag_t*));
-    LF_ASSERT_NON_NULL(env->_lf_intended_tag_fields);
-    env->_lf_intended_tag_fields_size = num_is_present_fields;
-  } else {
-    env->_lf_intended_tag_fields = NULL;
-    env->_lf_intended_tag_fields_size = 0;
-  }
 #else
   (void)env;
-  (void)num_is_present_fields;
 #endif
 }
 
 static void environment_free_threaded(environment_t* env) {
 #if !defined(LF_SINGLE_THREADED)
-  free(env->thread_ids);
+  // Free the physical action events staged after the last tag.
+  lf_ingress_event_t* lists[2] = {env->ingress, env->ingress_pending};
+  for (int i = 0; i < 2; i++) {
+    while (lists[i] != NULL) {
+      lf_ingress_event_t* staged = lists[i];
+      lists[i] = staged->next;
+      _lf_done_using(staged->token);
+      free(staged);
+    }
+  }
+  env->ingress = NULL;
+  env->ingress_pending = NULL;
+  while (env->ingress_limits != NULL) {
+    lf_ingress_limit_t* limit = env->ingress_limits;
+    env->ingress_limits = limit->next;
+    free(limit);
+  }
+  _lf_enclave_channels_free(env);
   lf_sched_free(env->scheduler);
+#ifdef _PYTHON_TARGET_ENABLED
+  vector_free(&env->python_reactions);
+#endif
 #else
   (void)env;
 #endif
@@ -143,7 +233,14 @@ static void environment_free_threaded(environment_t* env) {
 
 static void environment_free_single_threaded(environment_t* env) {
 #ifdef LF_SINGLE_THREADED
-  pqueue_free(env->reaction_q);
+  reaction_queue_free(env->reaction_q);
+  while (env->isr_rings != NULL) {
+    lf_isr_ring_t* ring = env->isr_rings;
+    env->isr_rings = ring->next;
+    ring->action->trigger->isr_ring = NULL;
+    free(ring->slots);
+    free(ring);
+  }
 #else
   (void)env;
 #endif
@@ -152,42 +249,84 @@ static void environment_free_single_threaded(environment_t* env) {
 static void environment_free_modes(environment_t* env) {
 #ifdef MODAL_REACTORS
   if (env->modes) {
-    free(env->modes->modal_reactor_states);
-    free(env->modes->state_resets);
-    free(env->modes);
+    free(env->modes->grouped_state_resets);
+    free(env->modes->one_shot_timers);
   }
 #else
   (void)env;
 #endif
 }
 
-static void environment_free_federated(environment_t* env) {
-#ifdef FEDERATED_DECENTRALIZED
-  free(env->_lf_intended_tag_fields);
-#else
-  (void)env;
-#endif
-}
-
 //////////////////
 // Functions defined in environment.h.
 
 void environment_free(environment_t* env) {
-  free(env->name);
-  free(env->timer_triggers);
-  free(env->startup_reactions);
-  free(env->shutdown_reactions);
-  free(env->reset_reactions);
-  free(env->is_present_fields);
-  free(env->is_present_fields_abbreviated);
   pqueue_tag_free(env->event_q);
-  pqueue_tag_free(env->recycle_q);
+  vector_free(&env->events_at_current_tag);
+  vector_free(&env->next_microstep_events);
+  vector_free(&env->deadline_missed_reactions);
+  for (size_t i = 0; i < vector_size(&env->event_chunks); i++) {
+    free(VECTOR_GET(&env->event_chunks, i, void*));
+  }
+  vector_free(&env->event_chunks);
+  LF_MEMORY_FREED(lf_memory_events, env->events_allocated * sizeof(event_t));
 
   environment_free_threaded(env);
   environment_free_single_threaded(env);
   environment_free_modes(env);
-  environment_free_federated(env);
+#ifdef LF_STATIC_SCHEDULE
+  lf_static_schedule_free(env);
+#endif
+#ifdef LF_REACTION_PROFILE
+  lf_reaction_profile_free(env);
+#endif
+#if defined(LF_CHECKPOINT) || defined(LF_FEDERATED_OPTIMISTIC)
+  _lf_checkpoint_free(env);
+#endif
+#ifdef LF_TAG_PIPELINING
+  lf_pipeline_free(env);
+#endif
+  free(env->block);
+  env->block = NULL;
+}
+
+void environment_allocate_events(environment_t* env, size_t count) {
+  if (count == 0) {
+    return;
+  }
+  event_t* events = (event_t*)calloc(count, sizeof(event_t));
+  LF_ASSERT_NON_NULL(events);
+  vector_push(&env->event_chunks, events);
+  LF_MEMORY_ALLOCATED(lf_memory_events, count * sizeof(event_t));
+  env->events_allocated += count;
+  env->events_free += count;
+  for (size_t i = 0; i < count; i++) {
+#ifdef FEDERATED_DECENTRALIZED
+    events[i].intended_tag = (tag_t){.time = NEVER, .microstep = 0u};
+#endif
+    events[i].next_free = (i + 1 < count) ? &events[i + 1] : env->free_events;
+  }
+  env->free_events = events;
+}
+
+#ifdef LF_STATIC_TOPOLOGY
+void lf_environment_set_topology(environment_t* env, const lf_static_topology_t* topology) {
+  assert(env != GLOBAL_ENVIRONMENT);
+  if (topology->timer_triggers_size != env->timer_triggers_size ||
+      topology->startup_reactions_size != env->startup_reactions_size ||
+      topology->shutdown_reactions_size != env->shutdown_reactions_size ||
+      topology->reset_reactions_size != env->reset_reactions_size ||
+      topology->is_present_fields_size != env->is_present_fields_size) {
+    lf_print_error_and_exit("The static topology of environment %s does not match its sizes.", env->name);
+  }
+  // The runtime never writes these tables, so they can be const.
+  env->timer_triggers = (trigger_t**)topology->timer_triggers;
+  env->startup_reactions = (reaction_t**)topology->startup_reactions;
+  env->shutdown_reactions = (reaction_t**)topology->shutdown_reactions;
+  env->reset_reactions = (reaction_t**)topology->reset_reactions;
+  env->is_present_fields = (bool**)topology->is_present_fields;
 }
+#endif // LF_STATIC_TOPOLOGY
 
 void environment_init_tags(environment_t* env, instant_t start_time, interval_t duration) {
   env->current_tag = (tag_t){.time = start_time, .microstep = 0u};
@@ -201,82 +340,120 @@ void environment_init_tags(environment_t* env, instant_t start_time, interval_t
   env->stop_tag = stop_tag;
 }
 
+void lf_environment_set_spin_wait(environment_t* env, interval_t threshold) {
+  assert(env != GLOBAL_ENVIRONMENT);
+  env->spin_wait_threshold = threshold > 0 ? threshold : 0;
+}
+
+void lf_environment_set_timer_slack(environment_t* env, interval_t slack) {
+  assert(env != GLOBAL_ENVIRONMENT);
+  env->timer_slack = slack;
+}
+
+void lf_environment_set_ingress_limits(environment_t* env, size_t capacity, interval_t max_tag_lag) {
+  assert(env != GLOBAL_ENVIRONMENT);
+#if !defined(LF_SINGLE_THREADED)
+  env->ingress_capacity = (int64_t)capacity;
+  env->ingress_max_tag_lag = max_tag_lag;
+#else
+  (void)env;
+  (void)capacity;
+  (void)max_tag_lag;
+#endif
+}
+
 int environment_init(environment_t* env, const char* name, int id, int num_workers, int num_timers,
                      int num_startup_reactions, int num_shutdown_reactions, int num_reset_reactions,
                      int num_is_present_fields, int num_modes, int num_state_resets, int num_watchdogs,
                      const char* trace_file_name) {
   (void)trace_file_name; // Will be used with future enclave support.
 
-  env->name = malloc(strlen(name) + 1); // +1 for the null terminator
-  LF_ASSERT_NON_NULL(env->name);
-  strcpy(env->name, name);
-
   env->id = id;
   env->stop_tag = FOREVER_TAG;
+  env->spin_wait_threshold = LF_SPIN_WAIT_THRESHOLD;
+  env->timer_slack = LF_TIMER_SLACK;
 
   env->timer_triggers_size = num_timers;
-  if (env->timer_triggers_size > 0) {
-    env->timer_triggers = (trigger_t**)calloc(num_timers, sizeof(trigger_t));
-    LF_ASSERT_NON_NULL(env->timer_triggers);
-  } else {
-    env->timer_triggers = NULL;
-  }
-
   env->startup_reactions_size = num_startup_reactions;
-  if (env->startup_reactions_size > 0) {
-    env->startup_reactions = (reaction_t**)calloc(num_startup_reactions, sizeof(reaction_t));
-    LF_ASSERT_NON_NULL(env->startup_reactions);
-  } else {
-    env->startup_reactions = NULL;
-  }
-
   env->shutdown_reactions_size = num_shutdown_reactions;
-  if (env->shutdown_reactions_size > 0) {
-    env->shutdown_reactions = (reaction_t**)calloc(num_shutdown_reactions, sizeof(reaction_t));
-    LF_ASSERT_NON_NULL(env->shutdown_reactions);
-  } else {
-    env->shutdown_reactions = NULL;
-  }
-
   env->reset_reactions_size = num_reset_reactions;
-  if (env->reset_reactions_size > 0) {
-    env->reset_reactions = (reaction_t**)calloc(num_reset_reactions, sizeof(reaction_t));
-    LF_ASSERT_NON_NULL(env->reset_reactions);
-  } else {
-    env->reset_reactions = NULL;
-  }
-
   env->is_present_fields_size = num_is_present_fields;
   env->is_present_fields_abbreviated_size = 0;
-
-  if (env->is_present_fields_size > 0) {
-    env->is_present_fields = (bool**)calloc(num_is_present_fields, sizeof(bool*));
-    LF_ASSERT_NON_NULL(env->is_present_fields);
-    env->is_present_fields_abbreviated = (bool**)calloc(num_is_present_fields, sizeof(bool*));
-    LF_ASSERT_NON_NULL(env->is_present_fields_abbreviated);
-  } else {
-    env->is_present_fields = NULL;
-    env->is_present_fields_abbreviated = NULL;
-  }
-
+  env->is_present_fields_full_resets = 0;
   env->watchdogs_size = num_watchdogs;
-  if (env->watchdogs_size > 0) {
-    env->watchdogs = (watchdog_t**)calloc(env->watchdogs_size, sizeof(watchdog_t*));
-    LF_ASSERT(env->watchdogs, "Out of memory");
-  }
+
+  // Measure the arrays, then carve them from a single zeroed block.
+  environment_block_t block = {.base = NULL, .size = 0};
+  environment_carve_arrays(env, &block, name, num_workers, num_modes, num_state_resets);
+  env->block = calloc(1, block.size);
+  LF_ASSERT_NON_NULL(env->block);
+  block = (environment_block_t){.base = (char*)env->block, .size = 0};
+  environment_carve_arrays(env, &block, name, num_workers, num_modes, num_state_resets);
+  strcpy(env->name, name);
 
   env->_lf_handle = 1;
 
   // Initialize our priority queues.
+#ifdef LF_STATIC_MEMORY
+  // Every event on the queues and vectors below comes from the pool, which never grows,
+  // so none of them has to grow either.
+  env->event_q = pqueue_tag_init_customize(LF_MAX_EVENTS, pqueue_tag_compare, event_matches, print_event);
+  env->events_at_current_tag = vector_new(LF_MAX_EVENTS);
+  env->next_microstep_events = vector_new(LF_MAX_EVENTS);
+  env->deadline_missed_reactions = vector_new(LF_MAX_REACTIONS);
+#else
   env->event_q = pqueue_tag_init_customize(INITIAL_EVENT_QUEUE_SIZE, pqueue_tag_compare, event_matches, print_event);
-  env->recycle_q =
-      pqueue_tag_init_customize(INITIAL_EVENT_QUEUE_SIZE, in_no_particular_order, event_matches, print_event);
+  vector_init_with_buffer(&env->events_at_current_tag, env->events_at_current_tag_buffer,
+                          LF_EVENTS_AT_CURRENT_TAG_BUFFER_SIZE);
+  env->next_microstep_events = vector_new(1);
+  env->deadline_missed_reactions = vector_new(1);
+#endif
+
+  // Preallocate events, including one for each timer so that timer-driven programs
+  // do not allocate memory at runtime.
+  env->free_events = NULL;
+  env->event_chunks = vector_new(1);
+  env->events_allocated = 0;
+  env->events_free = 0;
+#ifdef LF_STATIC_MEMORY
+  if (num_timers + 1 > LF_MAX_EVENTS) {
+    lf_print_error_and_exit("%d timers need more than LF_MAX_EVENTS (%d) events.", num_timers, LF_MAX_EVENTS);
+  }
+  environment_allocate_events(env, LF_MAX_EVENTS);
+#else
+  environment_allocate_events(env, INITIAL_EVENT_FREE_LIST_SIZE + (num_timers > 0 ? num_timers + 1 : 0));
+#endif
+#ifdef LF_STATIC_SCHEDULE
+  env->static_schedule = NULL;
+#endif
+#ifdef LF_REACTION_PROFILE
+  env->profiled_reactions = vector_new(1);
+#endif
+#ifdef LF_DVFS
+  env->dvfs_busy_since = NEVER;
+  env->dvfs_period_start = NEVER;
+  env->dvfs_busy = 0;
+  env->dvfs_min_slack = 100;
+  env->dvfs_required = 100;
+#endif
+#ifdef LF_LATENCY
+  env->latency_origin = NEVER;
+  memset(env->latency_chains, 0, sizeof(env->latency_chains));
+  env->latency_registering = 0;
+#endif
+#if defined(LF_CHECKPOINT) || defined(LF_FEDERATED_OPTIMISTIC)
+  env->checkpoint_reactors = vector_new(1);
+#endif
+#ifdef LF_CHECKPOINT
+  env->checkpoint_file = NULL;
+#endif
+#ifdef LF_TAG_PIPELINING
+  env->pipeline = NULL;
+#endif
 
   // Initialize functionality depending on target properties.
   environment_init_threaded(env, num_workers);
   environment_init_single_threaded(env);
-  environment_init_modes(env, num_modes, num_state_resets);
-  environment_init_federated(env, num_is_present_fields);
 
   env->initialized = true;
   return 0;
@@ -136,6 +136,10 @@ void usage(int argc, const char* argv[]) {
   lf_print("          clock sync attempt (default is 10). Applies to 'init' and 'on'.\n");
   lf_print("  -a, --auth Turn on HMAC authentication options.\n");
   lf_print("  -t, --tracing Turn on tracing.\n");
+  lf_print("  -e, --event_loop Handle all federates on one thread instead of one thread per federate.\n");
+  lf_print("  -tt, --time_triggered <n>");
+  lf_print("   Let federates that support it advance time without grants, once their clocks are n nanoseconds");
+  lf_print("   past the times at which messages may be sent to them.\n");
 
   lf_print("Command given:");
   for (int i = 0; i < argc; i++) {
@@ -253,7 +257,8 @@ int process_args(int argc, const char* argv[]) {
         return 0;
       }
       i++;
-      i += process_clock_sync_args((argc - i), &argv[i]);
+      // The loop increment moves past the last clock sync argument.
+      i += process_clock_sync_args((argc - i), &argv[i]) - 1;
     } else if (strcmp(argv[i], "-a") == 0 || strcmp(argv[i], "--auth") == 0) {
 #ifndef __RTI_AUTH__
       lf_print_error("--auth requires the RTI to be built with the -DAUTH=ON option.");
@@ -263,6 +268,22 @@ int process_args(int argc, const char* argv[]) {
       rti.authentication_enabled = true;
     } else if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--tracing") == 0) {
       rti.base.tracing_enabled = true;
+    } else if (strcmp(argv[i], "-e") == 0 || strcmp(argv[i], "--event_loop") == 0) {
+      rti.event_loop = true;
+    } else if (strcmp(argv[i], "-tt") == 0 || strcmp(argv[i], "--time_triggered") == 0) {
+      if (argc < i + 2) {
+        lf_print_error("--time_triggered needs a window in nanoseconds.");
+        usage(argc, argv);
+        return 0;
+      }
+      i++;
+      long long window = strtoll(argv[i], NULL, 10);
+      if (window < 0LL || window == LLONG_MAX) {
+        lf_print_error("--time_triggered needs a valid non-negative window in nanoseconds.");
+        usage(argc, argv);
+        return 0;
+      }
+      rti.time_triggered_window = (interval_t)window;
     } else if (strcmp(argv[i], " ") == 0) {
       // Tolerate spaces
       continue;
@@ -335,6 +356,9 @@ int main(int argc, const char* argv[]) {
     }
   }
 
+#ifdef LF_LOCK_PROFILE
+  lf_lock_profile_print();
+#endif
   lf_print("RTI is exiting."); // Do this before freeing scheduling nodes.
   free_scheduling_nodes(rti.base.scheduling_nodes, rti.base.number_of_scheduling_nodes);
 
@@ -8,7 +8,12 @@
  * License in [BSD 2-clause](https://github.com/lf-lang/reactor-c/blob/main/LICENSE.md)
  */
 #if defined STANDALONE_RTI || defined LF_ENCLAVES
+#include <string.h>
+
 #include "rti_common.h"
+#ifdef STANDALONE_RTI
+#include "net_common.h"
+#endif
 
 /**
  * Local reference to rti_common_t instance.
@@ -23,6 +28,7 @@ void initialize_rti_common(rti_common_t* _rti_common) {
   rti_common->max_stop_tag = NEVER_TAG;
   rti_common->number_of_scheduling_nodes = 0;
   rti_common->num_scheduling_nodes_handling_stop = 0;
+  rti_common->eimt_dependents_valid = true;
 }
 
 // FIXME: Should scheduling_nodes tracing use the same mechanism as federates?
@@ -39,6 +45,11 @@ void invalidate_min_delays_upstream(scheduling_node_t* node) {
   node->min_delays = NULL;
   node->num_min_delays = 0;
   node->flags = 0; // All flags cleared because they get set lazily.
+  node->eimt_valid = false;
+  // The eimt_dependents of the nodes upstream of this one may now be wrong.
+  if (rti_common != NULL) {
+    rti_common->eimt_dependents_valid = false;
+  }
 }
 
 void initialize_scheduling_node(scheduling_node_t* e, uint16_t id) {
@@ -54,6 +65,10 @@ void initialize_scheduling_node(scheduling_node_t* e, uint16_t id) {
   e->downstream = NULL;
   e->num_downstream = 0;
   e->mode = REALTIME;
+  e->eimt_dependents = NULL;
+  e->num_eimt_dependents = 0;
+  e->eimt = NEVER_TAG;
+  e->eimt_registered = false;
   invalidate_min_delays_upstream(e);
 }
 
@@ -68,25 +83,88 @@ void _logical_tag_complete(scheduling_node_t* enclave, tag_t completed) {
                enclave->completed.time - start_time, enclave->completed.microstep);
 
   // Check downstream scheduling_nodes to see whether they should now be granted a TAG.
+  bool visited[rti_common->number_of_scheduling_nodes];
   for (int i = 0; i < enclave->num_downstream; i++) {
     scheduling_node_t* downstream = rti_common->scheduling_nodes[enclave->downstream[i]];
     // Notify downstream enclave if appropriate.
     notify_advance_grant_if_safe(downstream);
-    bool* visited = (bool*)calloc(rti_common->number_of_scheduling_nodes, sizeof(bool)); // Initializes to 0.
+    memset(visited, 0, sizeof(visited));
     // Notify scheduling_nodes downstream of downstream if appropriate.
     notify_downstream_advance_grant_if_safe(downstream, visited);
-    free(visited);
   }
 
   LF_MUTEX_UNLOCK(rti_common->mutex);
 }
 
+/**
+ * If the min_delays of some node have been invalidated since the eimt_dependents were filled,
+ * empty the eimt_dependents and discard all cached EIMTs. These get filled again on demand.
+ */
+static void reset_eimt_dependents_if_stale() {
+  if (rti_common->eimt_dependents_valid) {
+    return;
+  }
+  for (int i = 0; i < rti_common->number_of_scheduling_nodes; i++) {
+    scheduling_node_t* node = rti_common->scheduling_nodes[i];
+    node->num_eimt_dependents = 0;
+    node->eimt_valid = false;
+    node->eimt_registered = false;
+  }
+  rti_common->eimt_dependents_valid = true;
+}
+
+/**
+ * Add e to the eimt_dependents of every node in its min_delays.
+ */
+static void register_eimt_dependent(scheduling_node_t* e) {
+  for (size_t i = 0; i < e->num_min_delays; i++) {
+    scheduling_node_t* upstream = rti_common->scheduling_nodes[e->min_delays[i].id];
+    upstream->eimt_dependents = (minimum_delay_t*)realloc(
+        upstream->eimt_dependents, (upstream->num_eimt_dependents + 1) * sizeof(minimum_delay_t));
+    LF_ASSERT_NON_NULL(upstream->eimt_dependents);
+    minimum_delay_t dependent = {.id = e->id, .min_delay = e->min_delays[i].min_delay};
+    upstream->eimt_dependents[upstream->num_eimt_dependents++] = dependent;
+  }
+  e->eimt_registered = true;
+}
+
+void set_next_event_tag(scheduling_node_t* e, tag_t next_event_tag) {
+  tag_t previous = e->next_event;
+  e->next_event = next_event_tag;
+  if (_lf_tag_compare(previous, next_event_tag) == 0) {
+    return;
+  }
+  reset_eimt_dependents_if_stale();
+  for (size_t i = 0; i < e->num_eimt_dependents; i++) {
+    scheduling_node_t* dependent = rti_common->scheduling_nodes[e->eimt_dependents[i].id];
+    if (!dependent->eimt_valid) {
+      continue;
+    }
+    tag_t delay = e->eimt_dependents[i].min_delay;
+    int comparison = _lf_tag_compare(_lf_tag_add(next_event_tag, delay), dependent->eimt);
+    if (comparison < 0) {
+      // The cached EIMT is a minimum, so a smaller candidate replaces it.
+      dependent->eimt = _lf_tag_add(next_event_tag, delay);
+    } else if (comparison > 0 && (_lf_tag_compare(previous, NEVER_TAG) == 0 ||
+                                  _lf_tag_compare(_lf_tag_add(previous, delay), dependent->eimt) == 0)) {
+      // The previous NET of e may have been the minimum. Recompute the EIMT when it is needed.
+      dependent->eimt_valid = false;
+    }
+  }
+}
+
 tag_t earliest_future_incoming_message_tag(scheduling_node_t* e) {
   // First, we need to find the shortest path (minimum delay) path to each upstream node
   // and then find the minimum of the node's recorded NET plus the minimum path delay.
   // Update the shortest paths, if necessary.
   update_min_delays_upstream(e);
 
+  // Use the cached result, if set_next_event_tag() has kept it up to date.
+  reset_eimt_dependents_if_stale();
+  if (e->eimt_valid) {
+    return e->eimt;
+  }
+
   // Next, find the tag of the earliest possible incoming message from upstream enclaves or
   // federates, which will be the smallest upstream NET plus the least delay.
   // This could be NEVER_TAG if the RTI has not seen a NET from some upstream node.
@@ -95,16 +173,16 @@ tag_t earliest_future_incoming_message_tag(scheduling_node_t* e) {
     // Node e->min_delays[i].id is upstream of e with min delay e->min_delays[i].min_delay.
     scheduling_node_t* upstream = rti_common->scheduling_nodes[e->min_delays[i].id];
     // If we haven't heard from the upstream node, then assume it can send an event at the start time.
-    if (lf_tag_compare(upstream->next_event, NEVER_TAG) == 0) {
+    if (_lf_tag_compare(upstream->next_event, NEVER_TAG) == 0) {
       tag_t start_tag = {.time = start_time, .microstep = 0};
-      upstream->next_event = start_tag;
+      set_next_event_tag(upstream, start_tag);
     }
     // The min_delay here is a tag_t, not an interval_t because it may account for more than
     // one connection. No delay at all is represented by (0,0). A delay of 0 is represented
     // by (0,1). If the time part of the delay is greater than 0, then we want to ignore
     // the microstep in upstream->next_event because that microstep will have been lost.
     // Otherwise, we want preserve it and add to it. This is handled by lf_tag_add().
-    tag_t earliest_tag_from_upstream = lf_tag_add(upstream->next_event, e->min_delays[i].min_delay);
+    tag_t earliest_tag_from_upstream = _lf_tag_add(upstream->next_event, e->min_delays[i].min_delay);
 
     /* Following debug message is too verbose for normal use:
     LF_PRINT_DEBUG("RTI: Earliest next event upstream of fed/encl %d at fed/encl %d has tag " PRINTF_TAG ".",
@@ -112,10 +190,15 @@ tag_t earliest_future_incoming_message_tag(scheduling_node_t* e) {
             upstream->id,
             earliest_tag_from_upstream.time - start_time, earliest_tag_from_upstream.microstep);
     */
-    if (lf_tag_compare(earliest_tag_from_upstream, t_d) < 0) {
+    if (_lf_tag_compare(earliest_tag_from_upstream, t_d) < 0) {
       t_d = earliest_tag_from_upstream;
     }
   }
+  if (!e->eimt_registered) {
+    register_eimt_dependent(e);
+  }
+  e->eimt = t_d;
+  e->eimt_valid = true;
   return t_d;
 }
 
@@ -131,31 +214,32 @@ tag_t eimt_strict(scheduling_node_t* e) {
     if (is_in_zero_delay_cycle(upstream))
       continue;
     // If we haven't heard from the upstream node, then assume it can send an event at the start time.
-    if (lf_tag_compare(upstream->next_event, NEVER_TAG) == 0) {
+    if (_lf_tag_compare(upstream->next_event, NEVER_TAG) == 0) {
       tag_t start_tag = {.time = start_time, .microstep = 0};
-      upstream->next_event = start_tag;
+      set_next_event_tag(upstream, start_tag);
     }
     // Need to consider nodes that are upstream of the upstream node because those
     // nodes may send messages to the upstream node.
     tag_t earliest = earliest_future_incoming_message_tag(upstream);
     // If the next event of the upstream node is earlier, then use that.
-    if (lf_tag_compare(upstream->next_event, earliest) < 0) {
+    if (_lf_tag_compare(upstream->next_event, earliest) < 0) {
       earliest = upstream->next_event;
     }
-    tag_t earliest_tag_from_upstream = lf_delay_tag(earliest, e->upstream_delay[i]);
+    tag_t earliest_tag_from_upstream = _lf_delay_tag(earliest, e->upstream_delay[i]);
     LF_PRINT_DEBUG("RTI: Strict EIMT of fed/encl %d at fed/encl %d has tag " PRINTF_TAG ".", e->id, upstream->id,
                    earliest_tag_from_upstream.time - start_time, earliest_tag_from_upstream.microstep);
-    if (lf_tag_compare(earliest_tag_from_upstream, t_d) < 0) {
+    if (_lf_tag_compare(earliest_tag_from_upstream, t_d) < 0) {
       t_d = earliest_tag_from_upstream;
     }
   }
   return t_d;
 }
 
-tag_advance_grant_t tag_advance_grant_if_safe(scheduling_node_t* e) {
-  tag_advance_grant_t result = {.tag = NEVER_TAG, .is_provisional = false};
-
-  // Find the earliest LTC of upstream scheduling_nodes (M).
+/**
+ * Return the earliest LTC of the nodes immediately upstream of e that are connected,
+ * each adjusted by the after delay of its connection to e.
+ */
+static tag_t earliest_upstream_completed(scheduling_node_t* e) {
   tag_t min_upstream_completed = FOREVER_TAG;
 
   for (int j = 0; j < e->num_upstream; j++) {
@@ -170,14 +254,22 @@ tag_advance_grant_t tag_advance_grant_if_safe(scheduling_node_t* e) {
     // whereas one microstep delay is encoded as 0LL.
     tag_t candidate = lf_delay_strict(upstream->completed, e->upstream_delay[j]);
 
-    if (lf_tag_compare(candidate, min_upstream_completed) < 0) {
+    if (_lf_tag_compare(candidate, min_upstream_completed) < 0) {
       min_upstream_completed = candidate;
     }
   }
+  return min_upstream_completed;
+}
+
+tag_advance_grant_t tag_advance_grant_if_safe(scheduling_node_t* e) {
+  tag_advance_grant_t result = {.tag = NEVER_TAG, .is_provisional = false};
+
+  // Find the earliest LTC of upstream scheduling_nodes (M).
+  tag_t min_upstream_completed = earliest_upstream_completed(e);
   LF_PRINT_LOG("RTI: Minimum upstream LTC for federate/enclave %d is " PRINTF_TAG "(adjusted by after delay).", e->id,
                min_upstream_completed.time - start_time, min_upstream_completed.microstep);
-  if (lf_tag_compare(min_upstream_completed, e->last_granted) > 0 &&
-      lf_tag_compare(min_upstream_completed, e->next_event) >= 0 // The enclave has to advance its tag
+  if (_lf_tag_compare(min_upstream_completed, e->last_granted) > 0 &&
+      _lf_tag_compare(min_upstream_completed, e->next_event) >= 0 // The enclave has to advance its tag
   ) {
     result.tag = min_upstream_completed;
     return result;
@@ -204,12 +296,12 @@ tag_advance_grant_t tag_advance_grant_if_safe(scheduling_node_t* e) {
   //  3) Otherwise, grant nothing and wait for further updates.
 
   if (                                                           // Scenario (1) above
-      lf_tag_compare(t_d, e->next_event) > 0                     // EIMT greater than NET
-      && lf_tag_compare(e->next_event, NEVER_TAG) > 0            // NET is not NEVER_TAG
-      && lf_tag_compare(t_d, e->last_provisionally_granted) >= 0 // The grant is not redundant
+      _lf_tag_compare(t_d, e->next_event) > 0                     // EIMT greater than NET
+      && _lf_tag_compare(e->next_event, NEVER_TAG) > 0            // NET is not NEVER_TAG
+      && _lf_tag_compare(t_d, e->last_provisionally_granted) >= 0 // The grant is not redundant
                                                                  // (equal is important to override any previous
                                                                  // PTAGs).
-      && lf_tag_compare(t_d, e->last_granted) > 0                // The grant is not redundant.
+      && _lf_tag_compare(t_d, e->last_granted) > 0                // The grant is not redundant.
   ) {
     // No upstream node can send events that will be received with a tag less than or equal to
     // e->next_event, so it is safe to send a TAG.
@@ -219,11 +311,11 @@ tag_advance_grant_t tag_advance_grant_if_safe(scheduling_node_t* e) {
                  e->next_event.microstep);
     result.tag = e->next_event;
   } else if (                                                   // Scenario (2) above
-      lf_tag_compare(t_d, e->next_event) == 0                   // EIMT equal to NET
+      _lf_tag_compare(t_d, e->next_event) == 0                   // EIMT equal to NET
       && is_in_zero_delay_cycle(e)                              // The node is part of a ZDC
-      && lf_tag_compare(t_d_strict, e->next_event) > 0          // The strict EIMT is greater than the NET
-      && lf_tag_compare(t_d, e->last_provisionally_granted) > 0 // The grant is not redundant
-      && lf_tag_compare(t_d, e->last_granted) > 0               // The grant is not redundant.
+      && _lf_tag_compare(t_d_strict, e->next_event) > 0          // The strict EIMT is greater than the NET
+      && _lf_tag_compare(t_d, e->last_provisionally_granted) > 0 // The grant is not redundant
+      && _lf_tag_compare(t_d, e->last_granted) > 0               // The grant is not redundant.
   ) {
     // Some upstream node may send an event that has the same tag as this node's next event,
     // so we can only grant a PTAG.
@@ -248,8 +340,28 @@ void notify_downstream_advance_grant_if_safe(scheduling_node_t* e, bool visited[
   }
 }
 
+tag_t cluster_next_event_tag(scheduling_node_t* boundary) { return earliest_future_incoming_message_tag(boundary); }
+
+tag_t cluster_completed_tag(scheduling_node_t* boundary) { return earliest_upstream_completed(boundary); }
+
+void cluster_granted_locked(scheduling_node_t* boundary, tag_advance_grant_t grant) {
+  if (grant.is_provisional) {
+    // Messages from other clusters may still have the granted tag.
+    set_next_event_tag(boundary, grant.tag);
+  } else {
+    // Messages from other clusters will be later than the granted tag.
+    boundary->completed = grant.tag;
+    set_next_event_tag(boundary, _lf_delay_tag(grant.tag, 0));
+  }
+  LF_PRINT_LOG("RTI: Cluster granted " PRINTF_TAG " (provisional: %d) by the parent RTI.",
+               grant.tag.time - start_time, grant.tag.microstep, grant.is_provisional);
+  bool visited[rti_common->number_of_scheduling_nodes];
+  memset(visited, 0, sizeof(visited));
+  notify_downstream_advance_grant_if_safe(boundary, visited);
+}
+
 void update_scheduling_node_next_event_tag_locked(scheduling_node_t* e, tag_t next_event_tag) {
-  e->next_event = next_event_tag;
+  set_next_event_tag(e, next_event_tag);
 
   LF_PRINT_DEBUG("RTI: Updated the recorded next event tag for federate/enclave %d to " PRINTF_TAG, e->id,
                  next_event_tag.time - lf_time_start(), next_event_tag.microstep);
@@ -266,14 +378,14 @@ void update_scheduling_node_next_event_tag_locked(scheduling_node_t* e, tag_t ne
   // Check downstream scheduling_nodes to see whether they should now be granted a TAG.
   // To handle cycles, need to create a boolean array to keep
   // track of which downstream scheduling_nodes have been visited.
-  bool* visited = (bool*)calloc(rti_common->number_of_scheduling_nodes, sizeof(bool)); // Initializes to 0.
+  bool visited[rti_common->number_of_scheduling_nodes];
+  memset(visited, 0, sizeof(visited));
   notify_downstream_advance_grant_if_safe(e, visited);
-  free(visited);
 }
 
 void notify_advance_grant_if_safe(scheduling_node_t* e) {
   tag_advance_grant_t grant = tag_advance_grant_if_safe(e);
-  if (lf_tag_compare(grant.tag, NEVER_TAG) != 0) {
+  if (_lf_tag_compare(grant.tag, NEVER_TAG) != 0) {
     if (grant.is_provisional) {
       notify_provisional_tag_advance_grant(e, grant.tag);
     } else {
@@ -282,99 +394,145 @@ void notify_advance_grant_if_safe(scheduling_node_t* e) {
   }
 }
 
-// Local function used recursively to find minimum delays upstream.
-// Return in count the number of non-FOREVER_TAG entries in path_delays[].
-static void _update_min_delays_upstream(scheduling_node_t* end, scheduling_node_t* intermediate, tag_t path_delays[],
-                                        size_t* count) {
-  // On first call, intermediate will be NULL, so the path delay is initialized to zero.
-  tag_t delay_from_intermediate_so_far = ZERO_TAG;
-  if (intermediate == NULL) {
-    intermediate = end;
-  } else {
-    // Not the first call, so intermediate is upstream of end.
-    delay_from_intermediate_so_far = path_delays[intermediate->id];
+/** An upstream node on the heap of update_min_delays_upstream(), with its path delay. */
+typedef struct path_delay_t {
+  tag_t delay;
+  int id;
+} path_delay_t;
+
+/** Add an entry to a binary min-heap of path delays. */
+static void path_delay_push(path_delay_t* heap, size_t* size, path_delay_t entry) {
+  size_t i = (*size)++;
+  while (i > 0 && _lf_tag_compare(entry.delay, heap[(i - 1) / 2].delay) < 0) {
+    heap[i] = heap[(i - 1) / 2];
+    i = (i - 1) / 2;
   }
-  if (intermediate->state == NOT_CONNECTED) {
-    // Enclave or federate is not connected.
-    // No point in checking upstream scheduling_nodes.
-    return;
-  }
-  // Check nodes upstream of intermediate (or end on first call).
-  // NOTE: It would be better to iterate through these sorted by minimum delay,
-  // but for most programs, the gain might be negligible since there are relatively few
-  // upstream nodes.
-  for (int i = 0; i < intermediate->num_upstream; i++) {
-    // Add connection delay to path delay so far. Because tag addition is not commutative,
-    // the calculation order should be carefully handled. Specifically, we should calculate
-    // intermediate->upstream_delay[i] + delay_from_intermediate_so_far,
-    // NOT delay_from_intermediate_so_far + intermediate->upstream_delay[i].
-    // Before calculating path delay, convert intermediate->upstream_delay[i] to a tag
-    // cause there is no function that adds a tag to an interval.
-    tag_t connection_delay = lf_delay_tag(ZERO_TAG, intermediate->upstream_delay[i]);
-    tag_t path_delay = lf_tag_add(connection_delay, delay_from_intermediate_so_far);
-    // If the path delay is less than the so-far recorded path delay from upstream, update upstream.
-    if (lf_tag_compare(path_delay, path_delays[intermediate->upstream[i]]) < 0) {
-      if (path_delays[intermediate->upstream[i]].time == FOREVER) {
-        // Found a finite path.
-        *count = *count + 1;
-      }
-      path_delays[intermediate->upstream[i]] = path_delay;
-      // Since the path delay to upstream has changed, recursively update those upstream of it.
-      // Do not do this, however, if the upstream node is the end node because this means we have
-      // completed a cycle.
-      if (end->id != intermediate->upstream[i]) {
-        _update_min_delays_upstream(end, rti_common->scheduling_nodes[intermediate->upstream[i]], path_delays, count);
-      } else {
-        // Found a cycle.
-        end->flags = end->flags | IS_IN_CYCLE;
-        // Is it a zero-delay cycle?
-        if (lf_tag_compare(path_delay, ZERO_TAG) == 0 && intermediate->upstream_delay[i] < 0) {
-          end->flags = end->flags | IS_IN_ZERO_DELAY_CYCLE;
-        } else {
-          // Clear the flag.
-          end->flags = end->flags & ~IS_IN_ZERO_DELAY_CYCLE;
-        }
-      }
+  heap[i] = entry;
+}
+
+/** Remove and return the entry with the least delay from a binary min-heap of path delays. */
+static path_delay_t path_delay_pop(path_delay_t* heap, size_t* size) {
+  path_delay_t result = heap[0];
+  path_delay_t last = heap[--(*size)];
+  size_t i = 0;
+  while (2 * i + 1 < *size) {
+    size_t child = 2 * i + 1;
+    if (child + 1 < *size && _lf_tag_compare(heap[child + 1].delay, heap[child].delay) < 0) {
+      child++;
     }
+    if (_lf_tag_compare(heap[child].delay, last.delay) >= 0) {
+      break;
+    }
+    heap[i] = heap[child];
+    i = child;
   }
+  heap[i] = last;
+  return result;
 }
 
 void update_min_delays_upstream(scheduling_node_t* node) {
   // Check whether cached result is valid.
-  if (node->min_delays == NULL) {
-
-    // This is not Dijkstra's algorithm, but rather one optimized for sparse upstream nodes.
-    // There must be a name for this algorithm.
-
-    // Array of results on the stack:
-    tag_t path_delays[rti_common->number_of_scheduling_nodes];
-    // This will be the number of non-FOREVER entries put into path_delays.
-    size_t count = 0;
-
-    for (int i = 0; i < rti_common->number_of_scheduling_nodes; i++) {
-      path_delays[i] = FOREVER_TAG;
+  if (node->min_delays != NULL) {
+    return;
+  }
+  // Dijkstra's algorithm over the upstream connections, starting from node. Adding the delay of
+  // a connection further upstream never decreases a path delay and preserves the order of path
+  // delays, so the first time a node is taken from the heap, its path delay is the least.
+  // If node is in a cycle, its entry is the least delay around the cycle, and it is not
+  // expanded further.
+  int n = rti_common->number_of_scheduling_nodes;
+  tag_t* path_delays = (tag_t*)malloc(n * sizeof(tag_t));
+  bool* done = (bool*)calloc(n, sizeof(bool));
+  size_t heap_capacity = 1;
+  for (int i = 0; i < n; i++) {
+    path_delays[i] = FOREVER_TAG;
+    heap_capacity += rti_common->scheduling_nodes[i]->num_upstream;
+  }
+  path_delay_t* heap = (path_delay_t*)malloc(heap_capacity * sizeof(path_delay_t));
+  LF_ASSERT_NON_NULL(path_delays);
+  LF_ASSERT_NON_NULL(done);
+  LF_ASSERT_NON_NULL(heap);
+  size_t heap_size = 0;
+  // This will be the number of non-FOREVER entries put into path_delays.
+  size_t count = 0;
+  // Whether the least delay around a cycle through node has no delay at all.
+  bool zero_delay_cycle = false;
+
+  path_delay_push(heap, &heap_size, (path_delay_t){.delay = ZERO_TAG, .id = -1});
+  while (heap_size > 0) {
+    path_delay_t entry = path_delay_pop(heap, &heap_size);
+    scheduling_node_t* intermediate = entry.id < 0 ? node : rti_common->scheduling_nodes[entry.id];
+    if (entry.id >= 0) {
+      if (done[entry.id]) {
+        continue;
+      }
+      done[entry.id] = true;
+      if (entry.id == node->id) {
+        // Completed a cycle, which is not followed further.
+        continue;
+      }
     }
-    _update_min_delays_upstream(node, NULL, path_delays, &count);
-
-    // Put the results onto the node's struct.
-    node->num_min_delays = count;
-    node->min_delays = (minimum_delay_t*)calloc(count, sizeof(minimum_delay_t));
-    LF_PRINT_DEBUG("++++ Node %hu is in ZDC: %d", node->id, is_in_zero_delay_cycle(node));
-    int k = 0;
-    for (int i = 0; i < rti_common->number_of_scheduling_nodes; i++) {
-      if (lf_tag_compare(path_delays[i], FOREVER_TAG) < 0) {
-        // Node i is upstream.
-        if (k >= count) {
-          lf_print_error_and_exit("Internal error! Count of upstream nodes %zu for node %d is wrong!", count, i);
+    if (intermediate->state == NOT_CONNECTED) {
+      // Enclave or federate is not connected.
+      // No point in checking upstream scheduling_nodes.
+      continue;
+    }
+    for (int i = 0; i < intermediate->num_upstream; i++) {
+      // Add connection delay to path delay so far. Because tag addition is not commutative,
+      // the calculation order should be carefully handled. Specifically, we should calculate
+      // intermediate->upstream_delay[i] + entry.delay, NOT entry.delay + intermediate->upstream_delay[i].
+      // Before calculating path delay, convert intermediate->upstream_delay[i] to a tag
+      // cause there is no function that adds a tag to an interval.
+      int upstream = intermediate->upstream[i];
+      tag_t connection_delay = _lf_delay_tag(ZERO_TAG, intermediate->upstream_delay[i]);
+      tag_t path_delay = _lf_tag_add(connection_delay, entry.delay);
+      // If the path delay is less than the so-far recorded path delay from upstream, update upstream.
+      if (!done[upstream] && _lf_tag_compare(path_delay, path_delays[upstream]) < 0) {
+        if (path_delays[upstream].time == FOREVER) {
+          // Found a finite path.
+          count++;
+        }
+        path_delays[upstream] = path_delay;
+        if (upstream == node->id) {
+          // Found a cycle. Is it a zero-delay cycle?
+          zero_delay_cycle = _lf_tag_compare(path_delay, ZERO_TAG) == 0 && intermediate->upstream_delay[i] < 0;
         }
-        minimum_delay_t min_delay = {.id = i, .min_delay = path_delays[i]};
-        node->min_delays[k++] = min_delay;
-        // N^2 debug statement could be a problem with large benchmarks.
-        // LF_PRINT_DEBUG("++++    Node %hu is upstream with delay" PRINTF_TAG "\n", i, path_delays[i].time,
-        // path_delays[i].microstep);
+        path_delay_push(heap, &heap_size, (path_delay_t){.delay = path_delay, .id = upstream});
       }
     }
   }
+  if (_lf_tag_compare(path_delays[node->id], FOREVER_TAG) < 0) {
+    node->flags |= IS_IN_CYCLE;
+    if (zero_delay_cycle) {
+      node->flags |= IS_IN_ZERO_DELAY_CYCLE;
+    }
+  }
+
+  // Put the results onto the node's struct.
+  node->num_min_delays = count;
+  node->min_delays = (minimum_delay_t*)calloc(count > 0 ? count : 1, sizeof(minimum_delay_t));
+  LF_ASSERT_NON_NULL(node->min_delays);
+  LF_PRINT_DEBUG("++++ Node %hu is in ZDC: %d", node->id, (node->flags & IS_IN_ZERO_DELAY_CYCLE) != 0);
+  size_t k = 0;
+  for (int i = 0; i < n; i++) {
+    if (_lf_tag_compare(path_delays[i], FOREVER_TAG) < 0) {
+      // Node i is upstream.
+      minimum_delay_t min_delay = {.id = i, .min_delay = path_delays[i]};
+      node->min_delays[k++] = min_delay;
+      // N^2 debug statement could be a problem with large benchmarks.
+      // LF_PRINT_DEBUG("++++    Node %hu is upstream with delay" PRINTF_TAG "\n", i, path_delays[i].time,
+      // path_delays[i].microstep);
+    }
+  }
+  free(path_delays);
+  free(done);
+  free(heap);
+}
+
+void update_all_min_delays_upstream() {
+  for (int i = 0; i < rti_common->number_of_scheduling_nodes; i++) {
+    update_min_delays_upstream(rti_common->scheduling_nodes[i]);
+  }
 }
 
 bool is_in_zero_delay_cycle(scheduling_node_t* node) {
@@ -387,4 +545,119 @@ bool is_in_cycle(scheduling_node_t* node) {
   return node->flags & IS_IN_CYCLE;
 }
 
+#ifdef STANDALONE_RTI
+/**
+ * @brief Add a time to a set of times unless it is already there.
+ * @return true if the time has been added.
+ */
+static bool time_slots_insert(time_slots_t* slots, interval_t time) {
+  size_t low = 0;
+  size_t high = slots->size;
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    if (slots->offsets[middle] < time) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low < slots->size && slots->offsets[low] == time) {
+    return false;
+  }
+  if (slots->size == slots->capacity) {
+    slots->capacity = slots->capacity == 0 ? 16 : 2 * slots->capacity;
+    slots->offsets = (interval_t*)realloc(slots->offsets, slots->capacity * sizeof(interval_t));
+    LF_ASSERT_NON_NULL(slots->offsets);
+  }
+  memmove(&slots->offsets[low + 1], &slots->offsets[low], (slots->size - low) * sizeof(interval_t));
+  slots->offsets[low] = time;
+  slots->size++;
+  return true;
+}
+
+static interval_t gcd(interval_t a, interval_t b) {
+  while (b != 0) {
+    interval_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+interval_t time_triggered_schedule(const interval_t* hyperperiods, const time_slots_t* timers, time_slots_t* inbound) {
+  int n = rti_common->number_of_scheduling_nodes;
+  interval_t hyperperiod = 0;
+  for (int i = 0; i < n; i++) {
+    if (is_in_zero_delay_cycle(rti_common->scheduling_nodes[i])) {
+      LF_PRINT_LOG("RTI: Node %d is in a zero-delay cycle, which cannot be time triggered.", i);
+      return 0;
+    }
+    if (hyperperiods[i] <= 0) {
+      continue;
+    }
+    interval_t factor = hyperperiod == 0 ? hyperperiods[i] : hyperperiods[i] / gcd(hyperperiod, hyperperiods[i]);
+    if (hyperperiod > FOREVER / factor) {
+      return 0;
+    }
+    hyperperiod = hyperperiod == 0 ? factor : hyperperiod * factor;
+  }
+  if (hyperperiod == 0) {
+    return 0;
+  }
+
+  // The times at which each node may send messages, which grow until no node receives more.
+  time_slots_t* outbound = (time_slots_t*)calloc(n, sizeof(time_slots_t));
+  LF_ASSERT_NON_NULL(outbound);
+  for (int i = 0; i < n; i++) {
+    inbound[i] = (time_slots_t){.offsets = NULL, .size = 0, .capacity = 0};
+  }
+  bool fits = true;
+  for (int i = 0; fits && i < n; i++) {
+    time_slots_insert(&outbound[i], 0);
+    if (hyperperiods[i] > 0) {
+      fits = (hyperperiod / hyperperiods[i]) * timers[i].size <= TIME_TRIGGERED_MAX_SLOTS;
+      for (interval_t start = 0; fits && start < hyperperiod; start += hyperperiods[i]) {
+        for (size_t j = 0; j < timers[i].size; j++) {
+          time_slots_insert(&outbound[i], start + timers[i].offsets[j]);
+        }
+      }
+    }
+  }
+  bool changed = fits;
+  while (changed) {
+    changed = false;
+    for (int i = 0; fits && i < n; i++) {
+      scheduling_node_t* node = rti_common->scheduling_nodes[i];
+      for (int j = 0; j < node->num_upstream; j++) {
+        // Microsteps are not part of the schedule, so a microstep delay is no delay.
+        interval_t delay = node->upstream_delay[j] > 0 ? node->upstream_delay[j] % hyperperiod : 0;
+        time_slots_t* upstream = &outbound[node->upstream[j]];
+        for (size_t k = 0; k < upstream->size; k++) {
+          time_slots_insert(&inbound[i], (upstream->offsets[k] + delay) % hyperperiod);
+        }
+      }
+      for (size_t k = 0; k < inbound[i].size; k++) {
+        changed = time_slots_insert(&outbound[i], inbound[i].offsets[k]) || changed;
+      }
+      fits = outbound[i].size <= TIME_TRIGGERED_MAX_SLOTS;
+    }
+    changed = changed && fits;
+  }
+  for (int i = 0; i < n; i++) {
+    free(outbound[i].offsets);
+    if (!fits) {
+      free(inbound[i].offsets);
+      inbound[i] = (time_slots_t){.offsets = NULL, .size = 0, .capacity = 0};
+    }
+  }
+  free(outbound);
+  if (!fits) {
+    LF_PRINT_LOG("RTI: Messages may be sent at more than %d times per hyperperiod of " PRINTF_TIME ".",
+                 TIME_TRIGGERED_MAX_SLOTS, hyperperiod);
+    return 0;
+  }
+  return hyperperiod;
+}
+#endif // STANDALONE_RTI
+
 #endif
@@ -64,6 +64,12 @@ typedef struct scheduling_node_t {
   minimum_delay_t* min_delays;      // Array of minimum delays from upstream nodes, not including this node.
   size_t num_min_delays;            // Size of min_delays array.
   int flags;                        // Or of IS_IN_ZERO_DELAY_CYCLE, IS_IN_CYCLE
+  minimum_delay_t* eimt_dependents; // Nodes whose cached EIMT includes the next_event of this node, with their
+                                    // minimum delay from this node.
+  size_t num_eimt_dependents;       // Size of eimt_dependents array.
+  tag_t eimt;                       // Cached result of earliest_future_incoming_message_tag().
+  bool eimt_valid;                  // Whether eimt is up to date.
+  bool eimt_registered;             // Whether this node is in the eimt_dependents of its upstream nodes.
 } scheduling_node_t;
 
 /**
@@ -89,8 +95,18 @@ typedef struct rti_common_t {
 
   // The RTI mutex for making thread-safe access to the shared state.
   lf_mutex_t* mutex;
+
+  // False if the min_delays of some node have been invalidated since the eimt_dependents were filled.
+  bool eimt_dependents_valid;
 } rti_common_t;
 
+/** A set of times within a hyperperiod. */
+typedef struct time_slots_t {
+  interval_t* offsets; // Offsets from the start of the hyperperiod, sorted.
+  size_t size;         // Number of offsets.
+  size_t capacity;     // Allocated length of offsets.
+} time_slots_t;
+
 typedef struct {
   tag_t tag;           // NEVER if there is no tag advance grant.
   bool is_provisional; // True for PTAG, false for TAG.
@@ -223,11 +239,28 @@ tag_advance_grant_t tag_advance_grant_if_safe(scheduling_node_t* e);
  */
 void update_scheduling_node_next_event_tag_locked(scheduling_node_t* e, tag_t next_event_tag);
 
+/**
+ * @brief Record the next event tag of a scheduling node without notifying any node.
+ *
+ * This updates the cached EIMTs of the nodes downstream of e, so all changes to the
+ * `next_event` field after initialization must go through this function.
+ *
+ * This function assumes that the caller is holding the RTI mutex.
+ *
+ * @param e The scheduling node.
+ * @param next_event_tag The next event tag for e.
+ */
+void set_next_event_tag(scheduling_node_t* e, tag_t next_event_tag);
+
 /**
  * Given a node (enclave or federate), find the tag of the earliest possible incoming
  * message (EIMT) from upstream enclaves or federates, which will be the smallest upstream NET
  * plus the least delay. This could be NEVER_TAG if the RTI has not seen a NET from some
  * upstream node.
+ *
+ * The result is cached on the node. set_next_event_tag() lowers the cached value when an
+ * upstream NET decreases and discards it when the NET that determined it increases,
+ * so that the upstream nodes are only visited again in the latter case.
  * @param e The target node.
  * @return The earliest possible incoming message tag.
  */
@@ -245,6 +278,50 @@ tag_t earliest_future_incoming_message_tag(scheduling_node_t* e);
  */
 tag_t eimt_strict(scheduling_node_t* e);
 
+/**
+ * @brief Return the tag of the NET that summarizes a cluster of scheduling nodes for a parent RTI.
+ *
+ * In a hierarchical federation, the nodes of an RTI form a cluster that a parent RTI coordinates
+ * as a single node. Within the cluster, the rest of the federation is represented by the node
+ * `boundary`. The connections that leave the cluster are the upstream connections of `boundary`,
+ * with their after delays, and the connections that enter the cluster are its downstream
+ * connections, with no delay because the delay is applied by the sending cluster. The parent
+ * RTI connects clusters without delays too. The node `boundary` is not granted tags, so its
+ * `last_granted` must be FOREVER_TAG.
+ *
+ * The summarized NET is the earliest tag at which the cluster may send a message out of it,
+ * which is the EIMT of `boundary`.
+ *
+ * This function assumes that the caller is holding the RTI mutex.
+ * @param boundary The node that represents the rest of the federation.
+ */
+tag_t cluster_next_event_tag(scheduling_node_t* boundary);
+
+/**
+ * @brief Return the tag of the LTC that summarizes a cluster of scheduling nodes for a parent RTI.
+ *
+ * This is the earliest LTC of the nodes that have connections leaving the cluster, adjusted by
+ * the after delays of those connections. See cluster_next_event_tag().
+ *
+ * This function assumes that the caller is holding the RTI mutex.
+ * @param boundary The node that represents the rest of the federation.
+ */
+tag_t cluster_completed_tag(scheduling_node_t* boundary);
+
+/**
+ * @brief Record a TAG or PTAG that a parent RTI has granted to a cluster of scheduling nodes.
+ *
+ * A TAG means that messages from other clusters will have tags later than the granted tag, and
+ * a PTAG that they will not have earlier tags. This is recorded as the NET and LTC of `boundary`,
+ * and the nodes of the cluster are notified with a TAG or PTAG if appropriate.
+ * See cluster_next_event_tag().
+ *
+ * This function assumes that the caller is holding the RTI mutex.
+ * @param boundary The node that represents the rest of the federation.
+ * @param grant The grant of the parent RTI.
+ */
+void cluster_granted_locked(scheduling_node_t* boundary, tag_advance_grant_t grant);
+
 /**
  * Return true if the node is in a zero-delay cycle.
  * @param node The node.
@@ -266,6 +343,14 @@ bool is_in_cycle(scheduling_node_t* node);
  */
 void update_min_delays_upstream(scheduling_node_t* node);
 
+/**
+ * Update the `min_delays`, `num_min_delays`, and the fields that indicate cycles of all
+ * scheduling nodes as update_min_delays_upstream() does. This is called once the connections
+ * between all of them are known, so that the RTI does not find the minimum delays while
+ * deciding on grants.
+ */
+void update_all_min_delays_upstream();
+
 /**
  * For the given scheduling node (enclave or federate), invalidate the `min_delays`,
  * `num_min_delays`, and the fields that indicate cycles.
@@ -275,6 +360,28 @@ void update_min_delays_upstream(scheduling_node_t* node);
  */
 void invalidate_min_delays_upstream(scheduling_node_t* node);
 
+/**
+ * @brief Find the times at which messages may be sent to each scheduling node under time-triggered
+ * coordination, in which nodes advance to a tag once physical time has passed it by a window
+ * rather than waiting for grants.
+ *
+ * A node may send messages at the start time, when its periodic timers fire, and when it receives
+ * messages, which arrive at the times of the messages of its upstream nodes plus the delays of the
+ * connections. All of these are periodic with a common hyperperiod, the least common multiple of the
+ * hyperperiods of the timers of the nodes. The times of other events that may lead to messages,
+ * such as logical actions, are not known to the RTI. Messages at such times are violations of the
+ * schedule.
+ * @param hyperperiods The hyperperiod of the timers of each node, or 0 if it has no periodic timers.
+ * @param timers The times at which the timers of each node fire within its hyperperiod.
+ * @param inbound Sets of times that are filled in with the times within the common hyperperiod at which
+ * messages may be sent to each node. The caller frees their offsets if the result is positive.
+ * @return The common hyperperiod, or 0 if there is none, if there are too many times for
+ * TIME_TRIGGERED_MAX_SLOTS, or if some node is in a zero-delay cycle.
+ */
+#ifdef STANDALONE_RTI
+interval_t time_triggered_schedule(const interval_t* hyperperiods, const time_slots_t* timers, time_slots_t* inbound);
+#endif
+
 /**
  * Free dynamically allocated memory on the scheduling nodes and the scheduling node array itself.
  */
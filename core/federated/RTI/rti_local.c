@@ -59,6 +59,9 @@ void initialize_local_rti(environment_t* envs, int num_envs) {
 
     enclave_info->base.state = GRANTED;
   }
+  // The connections between enclaves do not change, so find the minimum delays from
+  // the transitive upstream enclaves now rather than on the first NET under the RTI mutex.
+  update_all_min_delays_upstream();
 }
 
 void free_local_rti() {
@@ -71,11 +74,34 @@ void initialize_enclave_info(enclave_info_t* enclave, int idx, environment_t* en
 
   env->enclave_info = enclave;
   enclave->env = env;
+  enclave->completed_time = NEVER;
 
   // Initialize the next event condition variable.
   LF_COND_INIT(&enclave->next_event_condition, &rti_mutex);
 }
 
+/**
+ * Return true if the specified NET can be granted to the enclave without acquiring the RTI mutex.
+ * This is the case if no other enclave uses the NET of this one to compute its grants, and every
+ * upstream enclave has completed a tag that, adjusted by the delay of the connection, is no earlier
+ * than the NET. The microsteps of the completed tags are taken to be 0, which can only make the
+ * test more conservative.
+ */
+static bool can_grant_without_rti(enclave_info_t* e, tag_t next_event_tag) {
+  if (e->base.num_downstream > 0) {
+    return false;
+  }
+  for (int i = 0; i < e->base.num_upstream; i++) {
+    enclave_info_t* upstream = (enclave_info_t*)rti_local->base.scheduling_nodes[e->base.upstream[i]];
+    tag_t completed = {.time = lf_atomic_load64(&upstream->completed_time), .microstep = 0};
+    if (completed.time == NEVER ||
+        lf_tag_compare(lf_delay_strict(completed, e->base.upstream_delay[i]), next_event_tag) < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
 tag_t rti_next_event_tag_locked(enclave_info_t* e, tag_t next_event_tag) {
   LF_PRINT_LOG("RTI: enclave %u sends NET of " PRINTF_TAG " ", e->base.id, next_event_tag.time - lf_time_start(),
                next_event_tag.microstep);
@@ -84,6 +110,10 @@ tag_t rti_next_event_tag_locked(enclave_info_t* e, tag_t next_event_tag) {
   if (rti_local->base.number_of_scheduling_nodes == 1) {
     return next_event_tag;
   }
+  // Return early, without tracing the NET and TAG, if the NET is known to be safe.
+  if (can_grant_without_rti(e, next_event_tag)) {
+    return next_event_tag;
+  }
   // This is called from a critical section within the source enclave. Leave
   // this critical section and acquire the RTI mutex.
   LF_MUTEX_UNLOCK(&e->env->mutex);
@@ -150,6 +180,9 @@ void rti_logical_tag_complete_locked(enclave_info_t* enclave, tag_t completed) {
   LF_MUTEX_UNLOCK(&enclave->env->mutex);
   tracepoint_federate_to_rti(send_LTC, enclave->base.id, &completed);
   _logical_tag_complete(&enclave->base, completed);
+  // Publish the completed tag to the downstream enclaves that test their NETs without the RTI mutex.
+  // This enclave is the only writer, so the swap always succeeds.
+  lf_atomic_bool_compare_and_swap64(&enclave->completed_time, enclave->completed_time, completed.time);
   // Acquire the enclave mutex again before returning.
   LF_MUTEX_LOCK(&enclave->env->mutex);
 }
@@ -162,7 +195,7 @@ void rti_update_other_net_locked(enclave_info_t* src, enclave_info_t* target, ta
 
   // If our proposed NET is less than the current NET, update it.
   if (lf_tag_compare(net, target->base.next_event) < 0) {
-    target->base.next_event = net;
+    set_next_event_tag(&target->base, net);
   }
   LF_MUTEX_UNLOCK(rti_local->base.mutex);
 }
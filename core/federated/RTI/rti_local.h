@@ -32,6 +32,8 @@ typedef struct enclave_info_t {
   environment_t* env;             // A pointer to the environment of the enclave
   lf_cond_t next_event_condition; // Condition variable used by scheduling_nodes to notify an enclave
                                   // that it's call to next_event_tag() should unblock.
+  instant_t completed_time;       // Time of base.completed, which is read without the RTI mutex.
+                                  // Only written by the enclave itself, with atomic operations.
 } enclave_info_t;
 
 /**
@@ -73,6 +75,10 @@ void initialize_enclave_info(enclave_info_t* enclave, int idx, environment_t* en
  * This function call will block until the enclave has been granted a TAG,
  * which might not be the tag requested.
  *
+ * If no other enclave depends on the next event tag of this one, and the upstream
+ * enclaves have completed tags that make the NET safe, the TAG is given without
+ * acquiring the RTI mutex.
+ *
  * This assumes the caller is holding the environment mutex of the source enclave.
  *
  * @param enclave The enclave requesting to advance to the NET.
@@ -10,9 +10,11 @@
  * @brief Runtime infrastructure (RTI) for distributed Lingua Franca programs.
  *
  * This implementation creates one thread per federate so as to be able
- * to take advantage of multiple cores. It may be more efficient, however,
- * to use select() instead to read from the multiple socket connections
- * to each federate.
+ * to take advantage of multiple cores. With the --event_loop option, it
+ * instead handles all federates on one thread that uses poll() to wait
+ * for any of their sockets to become readable. That thread handles the
+ * messages that have arrived from all federates in one pass, and the
+ * NET, LTC, and port absent messages under one acquisition of the mutex.
  *
  * This implementation sends messages in little endian order
  * because Intel, RISC V, and Arm processors are little endian.
@@ -28,6 +30,7 @@
 
 #include "rti_remote.h"
 #include "net_util.h"
+#include <poll.h> // Defines poll()
 #include <string.h>
 
 // Global variables defined in tag.c:
@@ -44,6 +47,41 @@ bool _lf_federate_reports_error = false;
 // and casting it.
 #define GET_FED_INFO(_idx) (federate_info_t*)rti_remote->base.scheduling_nodes[_idx]
 
+/**
+ * The bytes of the receive buffer of the UDP socket per federate, which the kernel
+ * needs to queue one T3 message.
+ */
+#define CLOCK_SYNC_RECEIVE_BUFFER_PER_FEDERATE 2048
+
+/** The size of the buffer into which the event loop receives the bytes sent by a federate. */
+#define RTI_INPUT_BUFFER_SIZE 4096
+
+/**
+ * Read bytes sent by federate `_fed` as read_from_socket_fail_on_error() does, taking first
+ * the bytes that the event loop has already received from its socket.
+ */
+#define READ_FROM_FEDERATE_FAIL_ON_ERROR(_fed, _num_bytes, _buffer, ...)                                               \
+  do {                                                                                                                 \
+    size_t _buffered = take_buffered_input(_fed, _num_bytes, _buffer);                                                 \
+    if (_buffered < (_num_bytes)) {                                                                                    \
+      read_from_socket_fail_on_error(&(_fed)->socket, (_num_bytes) - _buffered, (_buffer) + _buffered, NULL,           \
+                                     __VA_ARGS__);                                                                     \
+    }                                                                                                                  \
+  } while (0)
+
+/**
+ * Write to the socket of federate `_fed` as write_to_socket_fail_on_error() does, holding its
+ * send mutex so that the bytes do not land in the middle of a message being forwarded to it,
+ * after the messages posted to it.
+ */
+#define WRITE_TO_FEDERATE_FAIL_ON_ERROR(_fed, _num_bytes, _buffer, _mutex, ...)                                        \
+  do {                                                                                                                 \
+    LF_MUTEX_LOCK(&(_fed)->send_mutex);                                                                                \
+    send_posted_messages_of(_fed);                                                                                     \
+    write_to_socket_fail_on_error(&(_fed)->socket, _num_bytes, _buffer, _mutex, __VA_ARGS__);                          \
+    LF_MUTEX_UNLOCK(&(_fed)->send_mutex);                                                                              \
+  } while (0)
+
 lf_mutex_t rti_mutex;
 lf_cond_t received_start_times;
 lf_cond_t sent_start_time;
@@ -52,6 +90,153 @@ extern int lf_critical_section_enter(environment_t* env) { return lf_mutex_lock(
 
 extern int lf_critical_section_exit(environment_t* env) { return lf_mutex_unlock(&rti_mutex); }
 
+/**
+ * @brief Move up to `num_bytes` of the bytes that the event loop has received from
+ * the federate into `buffer`.
+ * @return The number of bytes moved, which is 0 if the event loop is not used.
+ */
+static size_t take_buffered_input(federate_info_t* fed, size_t num_bytes, unsigned char* buffer) {
+  size_t available = fed->input_end - fed->input_start;
+  if (available > num_bytes) {
+    available = num_bytes;
+  }
+  if (available > 0) {
+    memcpy(buffer, fed->input + fed->input_start, available);
+    fed->input_start += available;
+  }
+  return available;
+}
+
+/**
+ * The federates with messages in their outbox that have not yet been taken for sending
+ * by unlock_and_send_posted_messages(). This is guarded by the mutex.
+ */
+static federate_info_t** posted_federates = NULL;
+static int number_of_posted_federates = 0;
+
+/**
+ * @brief Post a message to a federate, to be sent when the mutex is released.
+ *
+ * Grants and port absent messages are decided under the mutex, but the system calls that
+ * send them would block all other federates if they were made under the mutex too. Posted
+ * messages go out in the order in which they are posted and before any other message that is
+ * later sent to the federate. This function assumes the caller holds the mutex.
+ */
+static void post_to_federate_locked(federate_info_t* fed, size_t num_bytes, unsigned char* buffer) {
+  LF_MUTEX_LOCK(&fed->outbox_mutex);
+  if (fed->outbox_size + num_bytes > fed->outbox_capacity) {
+    fed->outbox_capacity = LF_MAX(2 * fed->outbox_capacity, fed->outbox_size + num_bytes);
+    fed->outbox = (unsigned char*)realloc(fed->outbox, fed->outbox_capacity);
+    LF_ASSERT_NON_NULL(fed->outbox);
+  }
+  memcpy(fed->outbox + fed->outbox_size, buffer, num_bytes);
+  fed->outbox_size += num_bytes;
+  LF_MUTEX_UNLOCK(&fed->outbox_mutex);
+  if (!fed->outbox_posted) {
+    fed->outbox_posted = true;
+    if (posted_federates == NULL) {
+      posted_federates =
+          (federate_info_t**)calloc(rti_remote->base.number_of_scheduling_nodes, sizeof(federate_info_t*));
+      LF_ASSERT_NON_NULL(posted_federates);
+    }
+    posted_federates[number_of_posted_federates++] = fed;
+  }
+}
+
+/**
+ * @brief Take the messages posted to a federate for sending. This assumes the caller holds its send mutex.
+ * @param num_bytes Where to put the number of bytes taken.
+ * @return The bytes, which remain valid until the next call.
+ */
+static unsigned char* take_posted_messages_of(federate_info_t* fed, size_t* num_bytes) {
+  // Swap the outbox with the buffer being sent, so that messages can be posted meanwhile.
+  LF_MUTEX_LOCK(&fed->outbox_mutex);
+  unsigned char* bytes = fed->outbox;
+  size_t capacity = fed->outbox_capacity;
+  *num_bytes = fed->outbox_size;
+  fed->outbox = fed->outbox_sending;
+  fed->outbox_capacity = fed->outbox_sending_capacity;
+  fed->outbox_size = 0;
+  fed->outbox_sending = bytes;
+  fed->outbox_sending_capacity = capacity;
+  LF_MUTEX_UNLOCK(&fed->outbox_mutex);
+  return bytes;
+}
+
+/**
+ * @brief Send the messages posted to a federate. This assumes the caller holds its send mutex.
+ * @return 0 for success, -1 if the socket failed.
+ */
+static int send_posted_messages_of(federate_info_t* fed) {
+  while (true) {
+    size_t num_bytes;
+    unsigned char* bytes = take_posted_messages_of(fed, &num_bytes);
+    if (num_bytes == 0) {
+      return 0;
+    }
+    if (write_to_socket(fed->socket, num_bytes, bytes)) {
+      return -1;
+    }
+  }
+}
+
+/**
+ * @brief Send the messages posted to a federate followed by the specified bytes, with one
+ * system call. This assumes the caller holds its send mutex.
+ * @return 0 for success, -1 if the socket failed.
+ */
+static int send_posted_messages_of_with(federate_info_t* fed, size_t num_bytes, unsigned char* buffer) {
+  size_t num_posted;
+  unsigned char* posted = take_posted_messages_of(fed, &num_posted);
+  struct iovec buffers[] = {{.iov_base = posted, .iov_len = num_posted}, {.iov_base = buffer, .iov_len = num_bytes}};
+  if (num_posted == 0) {
+    return write_to_socket(fed->socket, num_bytes, buffer);
+  }
+  return writev_to_socket(fed->socket, buffers, 2);
+}
+
+/**
+ * @brief Release the mutex and send the messages that have been posted to federates, except
+ * to the specified one, whose messages remain posted.
+ *
+ * This function assumes the caller holds the mutex.
+ * @param kept The federate whose messages are sent later by the caller, or NULL.
+ */
+static void unlock_and_send_posted_messages_except(federate_info_t* kept) {
+  int number_posted = number_of_posted_federates;
+  federate_info_t* posted[number_posted > 0 ? number_posted : 1];
+  for (int i = 0; i < number_posted; i++) {
+    posted[i] = posted_federates[i];
+    posted[i]->outbox_posted = false;
+  }
+  number_of_posted_federates = 0;
+  LF_MUTEX_UNLOCK(&rti_mutex);
+  for (int i = 0; i < number_posted; i++) {
+    federate_info_t* fed = posted[i];
+    if (fed == kept) {
+      continue;
+    }
+    LF_MUTEX_LOCK(&fed->send_mutex);
+    int failed = send_posted_messages_of(fed);
+    LF_MUTEX_UNLOCK(&fed->send_mutex);
+    if (failed) {
+      // The socket might close while grants are decided. Consider this a soft failure.
+      lf_print_error("RTI failed to send tag advance grant to federate %d.", fed->enclave.id);
+      LF_MUTEX_LOCK(&rti_mutex);
+      fed->enclave.state = NOT_CONNECTED;
+      LF_MUTEX_UNLOCK(&rti_mutex);
+    }
+  }
+}
+
+/**
+ * @brief Release the mutex and send the messages that have been posted to federates.
+ *
+ * This function assumes the caller holds the mutex. It is used instead of releasing the mutex
+ * wherever grants or port absent messages may have been posted.
+ */
+static void unlock_and_send_posted_messages() { unlock_and_send_posted_messages_except(NULL); }
+
 /**
  * Create a server and enable listening for socket connections.
  * If the specified port if it is non-zero, it will attempt to acquire that port.
@@ -179,8 +364,9 @@ static int create_rti_server(uint16_t port, socket_type_t socket_type) {
 }
 
 void notify_tag_advance_grant(scheduling_node_t* e, tag_t tag) {
+  // Time-triggered federates advance without grants.
   if (e->state == NOT_CONNECTED || lf_tag_compare(tag, e->last_granted) <= 0 ||
-      lf_tag_compare(tag, e->last_provisionally_granted) < 0) {
+      lf_tag_compare(tag, e->last_provisionally_granted) < 0 || rti_remote->time_triggered_hyperperiod > 0) {
     return;
   }
   // Need to make sure that the destination federate's thread has already
@@ -199,21 +385,17 @@ void notify_tag_advance_grant(scheduling_node_t* e, tag_t tag) {
     tracepoint_rti_to_federate(send_TAG, e->id, &tag);
   }
   // This function is called in notify_advance_grant_if_safe(), which is a long
-  // function. During this call, the socket might close, causing the following write_to_socket
-  // to fail. Consider a failure here a soft failure and update the federate's status.
-  if (write_to_socket(((federate_info_t*)e)->socket, message_length, buffer)) {
-    lf_print_error("RTI failed to send tag advance grant to federate %d.", e->id);
-    e->state = NOT_CONNECTED;
-  } else {
-    e->last_granted = tag;
-    LF_PRINT_LOG("RTI sent to federate %d the tag advance grant (TAG) " PRINTF_TAG ".", e->id, tag.time - start_time,
-                 tag.microstep);
-  }
+  // function, so the grant is sent once the mutex is released. If the socket fails by then,
+  // the federate is marked as not connected.
+  post_to_federate_locked((federate_info_t*)e, message_length, buffer);
+  e->last_granted = tag;
+  LF_PRINT_LOG("RTI sent to federate %d the tag advance grant (TAG) " PRINTF_TAG ".", e->id, tag.time - start_time,
+               tag.microstep);
 }
 
 void notify_provisional_tag_advance_grant(scheduling_node_t* e, tag_t tag) {
   if (e->state == NOT_CONNECTED || lf_tag_compare(tag, e->last_granted) <= 0 ||
-      lf_tag_compare(tag, e->last_provisionally_granted) <= 0) {
+      lf_tag_compare(tag, e->last_provisionally_granted) <= 0 || rti_remote->time_triggered_hyperperiod > 0) {
     return;
   }
   // Need to make sure that the destination federate's thread has already
@@ -231,43 +413,37 @@ void notify_provisional_tag_advance_grant(scheduling_node_t* e, tag_t tag) {
   if (rti_remote->base.tracing_enabled) {
     tracepoint_rti_to_federate(send_PTAG, e->id, &tag);
   }
-  // This function is called in notify_advance_grant_if_safe(), which is a long
-  // function. During this call, the socket might close, causing the following write_to_socket
-  // to fail. Consider a failure here a soft failure and update the federate's status.
-  if (write_to_socket(((federate_info_t*)e)->socket, message_length, buffer)) {
-    lf_print_error("RTI failed to send tag advance grant to federate %d.", e->id);
-    e->state = NOT_CONNECTED;
-  } else {
-    e->last_provisionally_granted = tag;
-    LF_PRINT_LOG("RTI sent to federate %d the Provisional Tag Advance Grant (PTAG) " PRINTF_TAG ".", e->id,
-                 tag.time - start_time, tag.microstep);
-
-    // Send PTAG to all upstream federates, if they have not had
-    // a later or equal PTAG or TAG sent previously and if their transitive
-    // NET is greater than or equal to the tag.
-    // This is needed to stimulate absent messages from upstream and break deadlocks.
-    // The scenario this deals with is illustrated in `test/C/src/federated/FeedbackDelay2.lf`
-    // and `test/C/src/federated/FeedbackDelay4.lf`.
-    // Note that this is transitive.
-    // NOTE: This is not needed for enclaves because zero-delay loops are prohibited.
-    // It's only needed for federates, which is why this is implemented here.
-    for (int j = 0; j < e->num_upstream; j++) {
-      scheduling_node_t* upstream = rti_remote->base.scheduling_nodes[e->upstream[j]];
-
-      // Ignore this federate if it has resigned.
-      if (upstream->state == NOT_CONNECTED)
-        continue;
+  // See notify_tag_advance_grant.
+  post_to_federate_locked((federate_info_t*)e, message_length, buffer);
+  e->last_provisionally_granted = tag;
+  LF_PRINT_LOG("RTI sent to federate %d the Provisional Tag Advance Grant (PTAG) " PRINTF_TAG ".", e->id,
+               tag.time - start_time, tag.microstep);
+
+  // Send PTAG to all upstream federates, if they have not had
+  // a later or equal PTAG or TAG sent previously and if their transitive
+  // NET is greater than or equal to the tag.
+  // This is needed to stimulate absent messages from upstream and break deadlocks.
+  // The scenario this deals with is illustrated in `test/C/src/federated/FeedbackDelay2.lf`
+  // and `test/C/src/federated/FeedbackDelay4.lf`.
+  // Note that this is transitive.
+  // NOTE: This is not needed for enclaves because zero-delay loops are prohibited.
+  // It's only needed for federates, which is why this is implemented here.
+  for (int j = 0; j < e->num_upstream; j++) {
+    scheduling_node_t* upstream = rti_remote->base.scheduling_nodes[e->upstream[j]];
+
+    // Ignore this federate if it has resigned.
+    if (upstream->state == NOT_CONNECTED)
+      continue;
 
-      tag_t earliest = earliest_future_incoming_message_tag(upstream);
-      tag_t strict_earliest = eimt_strict(upstream); // Non-ZDC version.
+    tag_t earliest = earliest_future_incoming_message_tag(upstream);
+    tag_t strict_earliest = eimt_strict(upstream); // Non-ZDC version.
 
-      // If these tags are equal, then a TAG or PTAG should have already been granted,
-      // in which case, another will not be sent. But it may not have been already granted.
-      if (lf_tag_compare(earliest, tag) > 0) {
-        notify_tag_advance_grant(upstream, tag);
-      } else if (lf_tag_compare(earliest, tag) == 0 && lf_tag_compare(strict_earliest, tag) > 0) {
-        notify_provisional_tag_advance_grant(upstream, tag);
-      }
+    // If these tags are equal, then a TAG or PTAG should have already been granted,
+    // in which case, another will not be sent. But it may not have been already granted.
+    if (lf_tag_compare(earliest, tag) > 0) {
+      notify_tag_advance_grant(upstream, tag);
+    } else if (lf_tag_compare(earliest, tag) == 0 && lf_tag_compare(strict_earliest, tag) > 0) {
+      notify_provisional_tag_advance_grant(upstream, tag);
     }
   }
 }
@@ -281,31 +457,53 @@ void update_federate_next_event_tag_locked(uint16_t federate_id, tag_t next_even
   update_scheduling_node_next_event_tag_locked(&(fed->enclave), next_event_tag);
 }
 
-void handle_port_absent_message(federate_info_t* sending_federate, unsigned char* buffer) {
-  size_t message_size = sizeof(uint16_t) + sizeof(uint16_t) + sizeof(int64_t) + sizeof(uint32_t);
+/**
+ * @brief Return the length of a MSG_TYPE_PORT_ABSENT or MSG_TYPE_PORT_ABSENT_RANGES message,
+ * including its first byte, given at least the header of the message.
+ */
+static size_t port_absent_message_length(unsigned char* buffer) {
+  if (buffer[0] == MSG_TYPE_PORT_ABSENT_RANGES) {
+    uint16_t num_ranges = extract_uint16(&(buffer[MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE - sizeof(uint16_t)]));
+    return MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE + num_ranges * PORT_ABSENT_RANGE_SIZE;
+  }
+  return 1 + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(int64_t) + sizeof(uint32_t);
+}
 
-  read_from_socket_fail_on_error(&sending_federate->socket, message_size, &(buffer[1]), NULL,
-                                 " RTI failed to read port absent message from federate %u.",
-                                 sending_federate->enclave.id);
+/**
+ * @brief Exit if the header of a MSG_TYPE_PORT_ABSENT_RANGES message from a federate has more
+ * than PORT_ABSENT_MAX_RANGES ranges, in which case the rest of its messages cannot be found.
+ */
+static void check_port_absent_ranges(federate_info_t* sending_federate, unsigned char* buffer) {
+  uint16_t num_ranges = extract_uint16(&(buffer[MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE - sizeof(uint16_t)]));
+  if (num_ranges > PORT_ABSENT_MAX_RANGES) {
+    lf_print_error_and_exit("RTI received from federate %d a port absent message with %u ranges, more than %d.",
+                            sending_federate->enclave.id, num_ranges, PORT_ABSENT_MAX_RANGES);
+  }
+}
 
-  uint16_t reactor_port_id = extract_uint16(&(buffer[1]));
-  uint16_t federate_id = extract_uint16(&(buffer[1 + sizeof(uint16_t)]));
-  tag_t tag = extract_tag(&(buffer[1 + 2 * sizeof(uint16_t)]));
+/**
+ * @brief Forward a MSG_TYPE_PORT_ABSENT or MSG_TYPE_PORT_ABSENT_RANGES message, including
+ * its first byte, to its destination federate.
+ *
+ * This function assumes the caller holds the mutex.
+ */
+static void forward_port_absent_message_locked(federate_info_t* sending_federate, unsigned char* buffer) {
+  size_t message_size = port_absent_message_length(buffer) - 1;
+
+  // A message for several ports has no port id.
+  bool ranges = buffer[0] == MSG_TYPE_PORT_ABSENT_RANGES;
+  uint16_t reactor_port_id = ranges ? 0 : extract_uint16(&(buffer[1]));
+  uint16_t federate_id = extract_uint16(&(buffer[ranges ? 1 : 1 + sizeof(uint16_t)]));
+  tag_t tag = extract_tag(&(buffer[ranges ? 1 + sizeof(uint16_t) : 1 + 2 * sizeof(uint16_t)]));
 
   if (rti_remote->base.tracing_enabled) {
     tracepoint_rti_from_federate(receive_PORT_ABS, sending_federate->enclave.id, &tag);
   }
 
-  // Need to acquire the mutex lock to ensure that the thread handling
-  // messages coming from the socket connected to the destination does not
-  // issue a TAG before this message has been forwarded.
-  LF_MUTEX_LOCK(&rti_mutex);
-
   // If the destination federate is no longer connected, issue a warning
   // and return.
   federate_info_t* fed = GET_FED_INFO(federate_id);
   if (fed->enclave.state == NOT_CONNECTED) {
-    LF_MUTEX_UNLOCK(&rti_mutex);
     lf_print_warning("RTI: Destination federate %d is no longer connected. Dropping message.", federate_id);
     LF_PRINT_LOG("Fed status: next_event " PRINTF_TAG ", "
                  "completed " PRINTF_TAG ", "
@@ -319,7 +517,12 @@ void handle_port_absent_message(federate_info_t* sending_federate, unsigned char
     return;
   }
 
-  LF_PRINT_LOG("RTI forwarding port absent message for port %u to federate %u.", reactor_port_id, federate_id);
+  if (ranges) {
+    LF_PRINT_LOG("RTI forwarding port absent message for %zu ranges of ports to federate %u.",
+                 (message_size + 1 - MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE) / PORT_ABSENT_RANGE_SIZE, federate_id);
+  } else {
+    LF_PRINT_LOG("RTI forwarding port absent message for port %u to federate %u.", reactor_port_id, federate_id);
+  }
 
   // Need to make sure that the destination federate's thread has already
   // sent the starting MSG_TYPE_TIMESTAMP message.
@@ -332,18 +535,104 @@ void handle_port_absent_message(federate_info_t* sending_federate, unsigned char
     tracepoint_rti_to_federate(send_PORT_ABS, federate_id, &tag);
   }
 
-  // Forward the message.
-  write_to_socket_fail_on_error(&fed->socket, message_size + 1, buffer, &rti_mutex,
-                                "RTI failed to forward message to federate %d.", federate_id);
+  // Forward the message once the mutex is released.
+  post_to_federate_locked(fed, message_size + 1, buffer);
+}
 
-  LF_MUTEX_UNLOCK(&rti_mutex);
+void handle_port_absent_message(federate_info_t* sending_federate, unsigned char* buffer) {
+  // The ranges of a message for several ports may not fit in the buffer.
+  unsigned char
+      ranges_message[MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE + PORT_ABSENT_MAX_RANGES * PORT_ABSENT_RANGE_SIZE];
+  if (buffer[0] == MSG_TYPE_PORT_ABSENT_RANGES) {
+    ranges_message[0] = buffer[0];
+    buffer = ranges_message;
+    READ_FROM_FEDERATE_FAIL_ON_ERROR(sending_federate, MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE - 1, &(buffer[1]),
+                                     " RTI failed to read port absent message from federate %u.",
+                                     sending_federate->enclave.id);
+    check_port_absent_ranges(sending_federate, buffer);
+  }
+  size_t message_size = port_absent_message_length(buffer);
+  size_t header_size = buffer[0] == MSG_TYPE_PORT_ABSENT_RANGES ? MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE : 1;
+
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(sending_federate, message_size - header_size, &(buffer[header_size]),
+                                   " RTI failed to read port absent message from federate %u.",
+                                   sending_federate->enclave.id);
+
+  // Need to acquire the mutex lock to ensure that the thread handling
+  // messages coming from the socket connected to the destination does not
+  // issue a TAG before this message has been forwarded.
+  LF_MUTEX_LOCK(&rti_mutex);
+  forward_port_absent_message_locked(sending_federate, buffer);
+  unlock_and_send_posted_messages();
+}
+
+static int compare_intervals(const void* a, const void* b) {
+  interval_t x = *(const interval_t*)a;
+  interval_t y = *(const interval_t*)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Count and report a message in a time-triggered federation whose tag is not one at which
+ * messages may be sent to the destination or which reaches the RTI after the window.
+ *
+ * This function assumes the caller holds the mutex.
+ */
+static void check_time_triggered_message_locked(federate_info_t* sending_federate, federate_info_t* fed, tag_t tag) {
+  interval_t offset = (tag.time - start_time) % rti_remote->time_triggered_hyperperiod;
+  bool scheduled = bsearch(&offset, fed->inbound_slots.offsets, fed->inbound_slots.size, sizeof(interval_t),
+                           compare_intervals) != NULL;
+  interval_t lateness = lf_time_physical() - (tag.time + rti_remote->time_triggered_window);
+  if (!scheduled) {
+    rti_remote->time_triggered_violations++;
+    lf_print_warning("RTI: Message from federate %d to federate %d with tag " PRINTF_TAG " is not in the schedule.",
+                     sending_federate->enclave.id, fed->enclave.id, tag.time - start_time, tag.microstep);
+  } else if (lateness > 0) {
+    rti_remote->time_triggered_violations++;
+    lf_print_warning("RTI: Message from federate %d to federate %d with tag " PRINTF_TAG
+                     " arrived " PRINTF_TIME " ns after the window.",
+                     sending_federate->enclave.id, fed->enclave.id, tag.time - start_time, tag.microstep, lateness);
+  }
+}
+
+/**
+ * @brief Account for a message with the specified tag that is about to be forwarded to a federate,
+ * so that the federate is not granted a tag past it before it has been handled.
+ *
+ * This function assumes the caller holds the mutex.
+ */
+static void record_in_transit_message_locked(federate_info_t* sending_federate, federate_info_t* fed,
+                                             tag_t intended_tag) {
+  uint16_t federate_id = fed->enclave.id;
+  if (rti_remote->time_triggered_hyperperiod > 0) {
+    // No grants depend on the message, so it is not recorded.
+    check_time_triggered_message_locked(sending_federate, fed, intended_tag);
+  } else if (lf_tag_compare(fed->enclave.completed, intended_tag) < 0) {
+    // Add a record of this message to the list of in-transit messages to this federate.
+    pqueue_tag_insert_if_no_match(fed->in_transit_message_tags, intended_tag);
+    LF_PRINT_DEBUG("RTI: Adding a message with tag " PRINTF_TAG " to the list of in-transit messages for federate %d.",
+                   intended_tag.time - lf_time_start(), intended_tag.microstep, federate_id);
+  } else {
+    lf_print_error("RTI: Federate %d has already completed tag " PRINTF_TAG
+                   ", but there is an in-transit message with tag " PRINTF_TAG " from federate %hu. "
+                   "This is going to cause an STP violation under centralized coordination.",
+                   federate_id, fed->enclave.completed.time - lf_time_start(), fed->enclave.completed.microstep,
+                   intended_tag.time - lf_time_start(), intended_tag.microstep, sending_federate->enclave.id);
+    // FIXME: Drop the federate?
+  }
+
+  // If the message tag is less than the most recently received NET from the federate,
+  // then update the federate's next event tag to match the message tag.
+  if (rti_remote->time_triggered_hyperperiod == 0 && lf_tag_compare(intended_tag, fed->enclave.next_event) < 0) {
+    update_federate_next_event_tag_locked(federate_id, intended_tag);
+  }
 }
 
 void handle_timed_message(federate_info_t* sending_federate, unsigned char* buffer) {
   size_t header_size = 1 + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(int64_t) + sizeof(uint32_t);
   // Read the header, minus the first byte which has already been read.
-  read_from_socket_fail_on_error(&sending_federate->socket, header_size - 1, &(buffer[1]), NULL,
-                                 "RTI failed to read the timed message header from remote federate.");
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(sending_federate, header_size - 1, &(buffer[1]),
+                                   "RTI failed to read the timed message header from remote federate.");
   // Extract the header information. of the sender
   uint16_t reactor_port_id;
   uint16_t federate_id;
@@ -352,38 +641,24 @@ void handle_timed_message(federate_info_t* sending_federate, unsigned char* buff
   // Extract information from the header.
   extract_timed_header(&(buffer[1]), &reactor_port_id, &federate_id, &length, &intended_tag);
 
-  size_t total_bytes_to_read = length + header_size;
-  size_t bytes_to_read = length;
-
   if (FED_COM_BUFFER_SIZE < header_size + 1) {
     lf_print_error_and_exit("Buffer size (%d) is not large enough to "
                             "read the header plus one byte.",
                             FED_COM_BUFFER_SIZE);
   }
 
-  // Cut up the payload in chunks.
-  if (bytes_to_read > FED_COM_BUFFER_SIZE - header_size) {
-    bytes_to_read = FED_COM_BUFFER_SIZE - header_size;
-  }
-
   LF_PRINT_LOG("RTI received message from federate %d for federate %u port %u with intended tag " PRINTF_TAG
                ". Forwarding.",
                sending_federate->enclave.id, federate_id, reactor_port_id, intended_tag.time - lf_time_start(),
                intended_tag.microstep);
 
-  read_from_socket_fail_on_error(&sending_federate->socket, bytes_to_read, &(buffer[header_size]), NULL,
-                                 "RTI failed to read timed message from federate %d.", federate_id);
-  size_t bytes_read = bytes_to_read + header_size;
-  // Following only works for string messages.
-  // LF_PRINT_DEBUG("Message received by RTI: %s.", buffer + header_size);
-
   if (rti_remote->base.tracing_enabled) {
     tracepoint_rti_from_federate(receive_TAGGED_MSG, sending_federate->enclave.id, &intended_tag);
   }
 
   // Need to acquire the mutex lock to ensure that the thread handling
   // messages coming from the socket connected to the destination does not
-  // issue a TAG before this message has been forwarded.
+  // issue a TAG before this message has been accounted for.
   LF_MUTEX_LOCK(&rti_mutex);
 
   // If the destination federate is no longer connected, issue a warning,
@@ -400,15 +675,14 @@ void handle_timed_message(federate_info_t* sending_federate, unsigned char* buff
                  fed->enclave.last_granted.time - start_time, fed->enclave.last_granted.microstep,
                  fed->enclave.last_provisionally_granted.time - start_time,
                  fed->enclave.last_provisionally_granted.microstep);
-    // If the message was larger than the buffer, we must empty out the remainder also.
-    size_t total_bytes_read = bytes_read;
-    while (total_bytes_read < total_bytes_to_read) {
-      bytes_to_read = total_bytes_to_read - total_bytes_read;
+    // Empty out the payload.
+    size_t total_bytes_read = 0;
+    while (total_bytes_read < length) {
+      size_t bytes_to_read = length - total_bytes_read;
       if (bytes_to_read > FED_COM_BUFFER_SIZE) {
         bytes_to_read = FED_COM_BUFFER_SIZE;
       }
-      read_from_socket_fail_on_error(&sending_federate->socket, bytes_to_read, buffer, NULL,
-                                     "RTI failed to clear message chunks.");
+      READ_FROM_FEDERATE_FAIL_ON_ERROR(sending_federate, bytes_to_read, buffer, "RTI failed to clear message chunks.");
       total_bytes_read += bytes_to_read;
     }
     LF_MUTEX_UNLOCK(&rti_mutex);
@@ -429,59 +703,118 @@ void handle_timed_message(federate_info_t* sending_federate, unsigned char* buff
     tracepoint_rti_to_federate(send_TAGGED_MSG, federate_id, &intended_tag);
   }
 
-  write_to_socket_fail_on_error(&fed->socket, bytes_read, buffer, &rti_mutex,
-                                "RTI failed to forward message to federate %d.", federate_id);
-
-  // The message length may be longer than the buffer,
-  // in which case we have to handle it in chunks.
-  size_t total_bytes_read = bytes_read;
-  while (total_bytes_read < total_bytes_to_read) {
-    LF_PRINT_DEBUG("Forwarding message in chunks.");
-    bytes_to_read = total_bytes_to_read - total_bytes_read;
-    if (bytes_to_read > FED_COM_BUFFER_SIZE) {
-      bytes_to_read = FED_COM_BUFFER_SIZE;
+  record_in_transit_message_locked(sending_federate, fed, intended_tag);
+
+  // The payload is copied without the mutex. Holding the send mutex of the destination keeps
+  // other messages to it, which are sent later, from being interleaved with this one. It is
+  // taken only after the posted messages are sent, so no thread holds two send mutexes.
+  // The grants and port absent messages posted to the destination go out in the same system
+  // call as the header of the message.
+  unlock_and_send_posted_messages_except(fed);
+  LF_MUTEX_LOCK(&fed->send_mutex);
+
+  // Send the header with the part of the payload that the event loop has already received, if any.
+  size_t bytes_to_send = header_size;
+  size_t bytes_remaining = length;
+  size_t buffered;
+  bool first = true;
+  do {
+    buffered = take_buffered_input(sending_federate, LF_MIN(bytes_remaining, FED_COM_BUFFER_SIZE - bytes_to_send),
+                                   &(buffer[bytes_to_send]));
+    bytes_to_send += buffered;
+    bytes_remaining -= buffered;
+    if (first && send_posted_messages_of_with(fed, bytes_to_send, buffer)) {
+      LF_MUTEX_UNLOCK(&fed->send_mutex);
+      lf_print_error_system_failure("RTI failed to forward message to federate %d.", federate_id);
+    } else if (!first && bytes_to_send > 0) {
+      write_to_socket_fail_on_error(&fed->socket, bytes_to_send, buffer, &fed->send_mutex,
+                                    "RTI failed to forward message to federate %d.", federate_id);
     }
-    read_from_socket_fail_on_error(&sending_federate->socket, bytes_to_read, buffer, NULL,
-                                   "RTI failed to read message chunks.");
-    total_bytes_read += bytes_to_read;
+    bytes_to_send = 0;
+    first = false;
+  } while (buffered > 0 && bytes_remaining > 0);
+  // Move the rest from socket to socket.
+  if (bytes_remaining > 0 && forward_between_sockets(sending_federate->socket, fed->socket, bytes_remaining) != 0) {
+    LF_MUTEX_UNLOCK(&fed->send_mutex);
+    lf_print_error_system_failure("RTI failed to forward message from federate %d to federate %d.",
+                                  sending_federate->enclave.id, federate_id);
+  }
+  LF_MUTEX_UNLOCK(&fed->send_mutex);
+}
 
-    // FIXME: a mutex needs to be held for this so that other threads
-    // do not write to destination_socket and cause interleaving. However,
-    // holding the rti_mutex might be very expensive. Instead, each outgoing
-    // socket should probably have its own mutex.
-    write_to_socket_fail_on_error(&fed->socket, bytes_to_read, buffer, &rti_mutex,
-                                  "RTI failed to send message chunks.");
-  }
+void handle_multicast_tagged_message(federate_info_t* sending_federate, unsigned char* buffer) {
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(sending_federate, MSG_TYPE_MULTICAST_TAGGED_MESSAGE_HEADER_SIZE - 1, &(buffer[1]),
+                                   "RTI failed to read the multicast message header from federate %d.",
+                                   sending_federate->enclave.id);
+  uint16_t number_of_destinations = extract_uint16(&(buffer[1]));
+  size_t length = extract_uint32(&(buffer[1 + sizeof(uint16_t)]));
+  tag_t intended_tag = extract_tag(&(buffer[1 + sizeof(uint16_t) + sizeof(uint32_t)]));
 
-  // Record this in-transit message in federate's in-transit message queue.
-  if (lf_tag_compare(fed->enclave.completed, intended_tag) < 0) {
-    // Add a record of this message to the list of in-transit messages to this federate.
-    pqueue_tag_insert_if_no_match(fed->in_transit_message_tags, intended_tag);
-    LF_PRINT_DEBUG("RTI: Adding a message with tag " PRINTF_TAG " to the list of in-transit messages for federate %d.",
-                   intended_tag.time - lf_time_start(), intended_tag.microstep, federate_id);
-  } else {
-    lf_print_error("RTI: Federate %d has already completed tag " PRINTF_TAG
-                   ", but there is an in-transit message with tag " PRINTF_TAG " from federate %hu. "
-                   "This is going to cause an STP violation under centralized coordination.",
-                   federate_id, fed->enclave.completed.time - lf_time_start(), fed->enclave.completed.microstep,
-                   intended_tag.time - lf_time_start(), intended_tag.microstep, sending_federate->enclave.id);
-    // FIXME: Drop the federate?
+  // The payload is read once and follows, in the same buffer, the header of the tagged message
+  // that is written for each destination in turn.
+  size_t header_size = 1 + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(int64_t) + sizeof(uint32_t);
+  unsigned char* destinations = (unsigned char*)malloc(number_of_destinations * MULTICAST_DESTINATION_SIZE + 1);
+  unsigned char* message = (unsigned char*)malloc(header_size + length);
+  LF_ASSERT_NON_NULL(destinations);
+  LF_ASSERT_NON_NULL(message);
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(sending_federate, number_of_destinations * MULTICAST_DESTINATION_SIZE, destinations,
+                                   "RTI failed to read the destinations of a multicast message from federate %d.",
+                                   sending_federate->enclave.id);
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(sending_federate, length, &(message[header_size]),
+                                   "RTI failed to read the payload of a multicast message from federate %d.",
+                                   sending_federate->enclave.id);
+
+  LF_PRINT_LOG("RTI received message from federate %d for %u ports with intended tag " PRINTF_TAG ". Forwarding.",
+               sending_federate->enclave.id, number_of_destinations, intended_tag.time - lf_time_start(),
+               intended_tag.microstep);
+  if (rti_remote->base.tracing_enabled) {
+    tracepoint_rti_from_federate(receive_TAGGED_MSG, sending_federate->enclave.id, &intended_tag);
   }
 
-  // If the message tag is less than the most recently received NET from the federate,
-  // then update the federate's next event tag to match the message tag.
-  if (lf_tag_compare(intended_tag, fed->enclave.next_event) < 0) {
-    update_federate_next_event_tag_locked(federate_id, intended_tag);
+  for (uint16_t i = 0; i < number_of_destinations; i++) {
+    uint16_t reactor_port_id = extract_uint16(&(destinations[i * MULTICAST_DESTINATION_SIZE]));
+    uint16_t federate_id = extract_uint16(&(destinations[i * MULTICAST_DESTINATION_SIZE + sizeof(uint16_t)]));
+    if (federate_id >= rti_remote->base.number_of_scheduling_nodes) {
+      lf_print_warning("RTI: Multicast message from federate %d to unknown federate %d. Dropping it.",
+                       sending_federate->enclave.id, federate_id);
+      continue;
+    }
+    LF_MUTEX_LOCK(&rti_mutex);
+    federate_info_t* fed = GET_FED_INFO(federate_id);
+    if (fed->enclave.state == NOT_CONNECTED) {
+      lf_print_warning("RTI: Destination federate %d is no longer connected. Dropping message.", federate_id);
+      LF_MUTEX_UNLOCK(&rti_mutex);
+      continue;
+    }
+    while (fed->enclave.state == PENDING) {
+      lf_cond_wait(&sent_start_time);
+    }
+    if (rti_remote->base.tracing_enabled) {
+      tracepoint_rti_to_federate(send_TAGGED_MSG, federate_id, &intended_tag);
+    }
+    record_in_transit_message_locked(sending_federate, fed, intended_tag);
+
+    unlock_and_send_posted_messages_except(fed);
+    LF_MUTEX_LOCK(&fed->send_mutex);
+    message[0] = MSG_TYPE_TAGGED_MESSAGE;
+    encode_timed_header(&(message[1]), reactor_port_id, federate_id, (uint32_t)length, intended_tag);
+    if (send_posted_messages_of_with(fed, header_size + length, message)) {
+      LF_MUTEX_UNLOCK(&fed->send_mutex);
+      lf_print_error_system_failure("RTI failed to forward message to federate %d.", federate_id);
+    }
+    LF_MUTEX_UNLOCK(&fed->send_mutex);
   }
-
-  LF_MUTEX_UNLOCK(&rti_mutex);
+  free(destinations);
+  free(message);
 }
 
-void handle_latest_tag_complete(federate_info_t* fed) {
-  unsigned char buffer[sizeof(int64_t) + sizeof(uint32_t)];
-  read_from_socket_fail_on_error(&fed->socket, sizeof(int64_t) + sizeof(uint32_t), buffer, NULL,
-                                 "RTI failed to read the content of the logical tag complete from federate %d.",
-                                 fed->enclave.id);
+/**
+ * @brief Handle the tag of a latest tag complete (LTC) message.
+ *
+ * The caller may hold the mutex only if no federate is waiting to be sent its start time
+ * because a grant to such a federate waits on a condition variable.
+ */
+static void latest_tag_complete(federate_info_t* fed, unsigned char* buffer) {
   tag_t completed = extract_tag(buffer);
   if (rti_remote->base.tracing_enabled) {
     tracepoint_rti_from_federate(receive_LTC, fed->enclave.id, &completed);
@@ -492,20 +825,23 @@ void handle_latest_tag_complete(federate_info_t* fed) {
   LF_MUTEX_LOCK(&rti_mutex);
   // See if we can remove any of the recorded in-transit messages for this.
   pqueue_tag_remove_up_to(fed->in_transit_message_tags, completed);
-  LF_MUTEX_UNLOCK(&rti_mutex);
+  unlock_and_send_posted_messages();
 }
 
-void handle_next_event_tag(federate_info_t* fed) {
+void handle_latest_tag_complete(federate_info_t* fed) {
   unsigned char buffer[sizeof(int64_t) + sizeof(uint32_t)];
-  read_from_socket_fail_on_error(&fed->socket, sizeof(int64_t) + sizeof(uint32_t), buffer, NULL,
-                                 "RTI failed to read the content of the next event tag from federate %d.",
-                                 fed->enclave.id);
-
-  // Acquire a mutex lock to ensure that this state does not change while a
-  // message is in transport or being used to determine a TAG.
-  LF_MUTEX_LOCK(&rti_mutex); // FIXME: Instead of using a mutex, it might be more efficient to use a
-                             // select() mechanism to read and process federates' buffers in an orderly fashion.
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(fed, sizeof(int64_t) + sizeof(uint32_t), buffer,
+                                   "RTI failed to read the content of the logical tag complete from federate %d.",
+                                   fed->enclave.id);
+  latest_tag_complete(fed, buffer);
+}
 
+/**
+ * @brief Handle the tag of a next event tag (NET) message.
+ *
+ * This function assumes the caller holds the mutex.
+ */
+static void next_event_tag_locked(federate_info_t* fed, unsigned char* buffer) {
   tag_t intended_tag = extract_tag(buffer);
   if (rti_remote->base.tracing_enabled) {
     tracepoint_rti_from_federate(receive_NET, fed->enclave.id, &intended_tag);
@@ -513,7 +849,19 @@ void handle_next_event_tag(federate_info_t* fed) {
   LF_PRINT_LOG("RTI received from federate %d the Next Event Tag (NET) " PRINTF_TAG, fed->enclave.id,
                intended_tag.time - start_time, intended_tag.microstep);
   update_federate_next_event_tag_locked(fed->enclave.id, intended_tag);
-  LF_MUTEX_UNLOCK(&rti_mutex);
+}
+
+void handle_next_event_tag(federate_info_t* fed) {
+  unsigned char buffer[sizeof(int64_t) + sizeof(uint32_t)];
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(fed, sizeof(int64_t) + sizeof(uint32_t), buffer,
+                                   "RTI failed to read the content of the next event tag from federate %d.",
+                                   fed->enclave.id);
+
+  // Acquire a mutex lock to ensure that this state does not change while a
+  // message is in transport or being used to determine a TAG.
+  LF_MUTEX_LOCK(&rti_mutex);
+  next_event_tag_locked(fed, buffer);
+  unlock_and_send_posted_messages();
 }
 
 /////////////////// STOP functions ////////////////////
@@ -550,13 +898,14 @@ static void broadcast_stop_time_to_federates_locked() {
     }
     if (lf_tag_compare(fed->enclave.next_event, rti_remote->base.max_stop_tag) >= 0) {
       // Need the next_event to be no greater than the stop tag.
-      fed->enclave.next_event = rti_remote->base.max_stop_tag;
+      set_next_event_tag(&(fed->enclave), rti_remote->base.max_stop_tag);
     }
     if (rti_remote->base.tracing_enabled) {
       tracepoint_rti_to_federate(send_STOP_GRN, fed->enclave.id, &rti_remote->base.max_stop_tag);
     }
-    write_to_socket_fail_on_error(&fed->socket, MSG_TYPE_STOP_GRANTED_LENGTH, outgoing_buffer, &rti_mutex,
-                                  "RTI failed to send MSG_TYPE_STOP_GRANTED message to federate %d.", fed->enclave.id);
+    WRITE_TO_FEDERATE_FAIL_ON_ERROR(fed, MSG_TYPE_STOP_GRANTED_LENGTH, outgoing_buffer, &rti_mutex,
+                                    "RTI failed to send MSG_TYPE_STOP_GRANTED message to federate %d.",
+                                    fed->enclave.id);
   }
 
   LF_PRINT_LOG("RTI sent to federates MSG_TYPE_STOP_GRANTED with tag " PRINTF_TAG,
@@ -608,9 +957,9 @@ void handle_stop_request_message(federate_info_t* fed) {
 
   size_t bytes_to_read = MSG_TYPE_STOP_REQUEST_LENGTH - 1;
   unsigned char buffer[bytes_to_read];
-  read_from_socket_fail_on_error(&fed->socket, bytes_to_read, buffer, NULL,
-                                 "RTI failed to read the MSG_TYPE_STOP_REQUEST payload from federate %d.",
-                                 fed->enclave.id);
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(fed, bytes_to_read, buffer,
+                                   "RTI failed to read the MSG_TYPE_STOP_REQUEST payload from federate %d.",
+                                   fed->enclave.id);
 
   // Extract the proposed stop tag for the federate
   tag_t proposed_stop_tag = extract_tag(buffer);
@@ -633,7 +982,7 @@ void handle_stop_request_message(federate_info_t* fed) {
     if (rti_remote->stop_in_progress) {
       mark_federate_requesting_stop(fed);
     }
-    LF_MUTEX_UNLOCK(&rti_mutex);
+    unlock_and_send_posted_messages();
     return;
   }
 
@@ -645,7 +994,7 @@ void handle_stop_request_message(federate_info_t* fed) {
   // If all federates have replied, send stop request granted.
   if (mark_federate_requesting_stop(fed)) {
     // Have send stop request granted to all federates. Nothing more to do.
-    LF_MUTEX_UNLOCK(&rti_mutex);
+    unlock_and_send_posted_messages();
     return;
   }
 
@@ -657,7 +1006,7 @@ void handle_stop_request_message(federate_info_t* fed) {
   // Iterate over federates and send each the MSG_TYPE_STOP_REQUEST message
   // if we do not have a stop_time already for them. Do not do this more than once.
   if (rti_remote->stop_in_progress) {
-    LF_MUTEX_UNLOCK(&rti_mutex);
+    unlock_and_send_posted_messages();
     return;
   }
   rti_remote->stop_in_progress = true;
@@ -675,22 +1024,22 @@ void handle_stop_request_message(federate_info_t* fed) {
       if (rti_remote->base.tracing_enabled) {
         tracepoint_rti_to_federate(send_STOP_REQ, f->enclave.id, &rti_remote->base.max_stop_tag);
       }
-      write_to_socket_fail_on_error(&f->socket, MSG_TYPE_STOP_REQUEST_LENGTH, stop_request_buffer, &rti_mutex,
-                                    "RTI failed to forward MSG_TYPE_STOP_REQUEST message to federate %d.",
-                                    f->enclave.id);
+      WRITE_TO_FEDERATE_FAIL_ON_ERROR(f, MSG_TYPE_STOP_REQUEST_LENGTH, stop_request_buffer, &rti_mutex,
+                                      "RTI failed to forward MSG_TYPE_STOP_REQUEST message to federate %d.",
+                                      f->enclave.id);
     }
   }
   LF_PRINT_LOG("RTI forwarded to federates MSG_TYPE_STOP_REQUEST with tag (" PRINTF_TIME ", %u).",
                rti_remote->base.max_stop_tag.time - start_time, rti_remote->base.max_stop_tag.microstep);
-  LF_MUTEX_UNLOCK(&rti_mutex);
+  unlock_and_send_posted_messages();
 }
 
 void handle_stop_request_reply(federate_info_t* fed) {
   size_t bytes_to_read = MSG_TYPE_STOP_REQUEST_REPLY_LENGTH - 1;
   unsigned char buffer_stop_time[bytes_to_read];
-  read_from_socket_fail_on_error(&fed->socket, bytes_to_read, buffer_stop_time, NULL,
-                                 "RTI failed to read the reply to MSG_TYPE_STOP_REQUEST message from federate %d.",
-                                 fed->enclave.id);
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(fed, bytes_to_read, buffer_stop_time,
+                                   "RTI failed to read the reply to MSG_TYPE_STOP_REQUEST message from federate %d.",
+                                   fed->enclave.id);
 
   tag_t federate_stop_tag = extract_tag(buffer_stop_time);
 
@@ -708,18 +1057,15 @@ void handle_stop_request_reply(federate_info_t* fed) {
     rti_remote->base.max_stop_tag = federate_stop_tag;
   }
   mark_federate_requesting_stop(fed);
-  LF_MUTEX_UNLOCK(&rti_mutex);
+  unlock_and_send_posted_messages();
 }
 
 //////////////////////////////////////////////////
 
 void handle_address_query(uint16_t fed_id) {
   federate_info_t* fed = GET_FED_INFO(fed_id);
-  // Use buffer both for reading and constructing the reply.
-  // The length is what is needed for the reply.
-  unsigned char buffer[1 + sizeof(int32_t)];
-  read_from_socket_fail_on_error(&fed->socket, sizeof(uint16_t), (unsigned char*)buffer, NULL,
-                                 "Failed to read address query.");
+  unsigned char buffer[sizeof(uint16_t)];
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(fed, sizeof(uint16_t), (unsigned char*)buffer, "Failed to read address query.");
   uint16_t remote_fed_id = extract_uint16(buffer);
 
   if (rti_remote->base.tracing_enabled) {
@@ -732,24 +1078,19 @@ void handle_address_query(uint16_t fed_id) {
   // the port number because it has not yet received an MSG_TYPE_ADDRESS_ADVERTISEMENT message
   // from this federate. In that case, it will respond by sending -1.
 
-  // Response message is MSG_TYPE_ADDRESS_QUERY_REPLY.
-  buffer[0] = MSG_TYPE_ADDRESS_QUERY_REPLY;
-
-  // Encode the port number.
+  // Response message is MSG_TYPE_ADDRESS_QUERY_REPLY, followed by the port number (which could
+  // be -1) and the IP address of the server of the remote federate.
+  unsigned char reply[1 + sizeof(int32_t) + sizeof(struct in_addr)];
+  reply[0] = MSG_TYPE_ADDRESS_QUERY_REPLY;
   federate_info_t* remote_fed = GET_FED_INFO(remote_fed_id);
-
-  // Send the port number (which could be -1).
   LF_MUTEX_LOCK(&rti_mutex);
-  encode_int32(remote_fed->server_port, (unsigned char*)&buffer[1]);
-  write_to_socket_fail_on_error(&fed->socket, sizeof(int32_t) + 1, (unsigned char*)buffer, &rti_mutex,
-                                "Failed to write port number to socket of federate %d.", fed_id);
-
-  // Send the server IP address to federate.
-  write_to_socket_fail_on_error(&fed->socket, sizeof(remote_fed->server_ip_addr),
-                                (unsigned char*)&remote_fed->server_ip_addr, &rti_mutex,
-                                "Failed to write ip address to socket of federate %d.", fed_id);
+  encode_int32(remote_fed->server_port, &reply[1]);
+  memcpy(&reply[1 + sizeof(int32_t)], &remote_fed->server_ip_addr, sizeof(struct in_addr));
   LF_MUTEX_UNLOCK(&rti_mutex);
 
+  WRITE_TO_FEDERATE_FAIL_ON_ERROR(fed, sizeof(reply), reply, NULL,
+                                  "Failed to write address query reply to socket of federate %d.", fed_id);
+
   LF_PRINT_DEBUG("Replied to address query from federate %d with address %s:%d.", fed_id, remote_fed->server_hostname,
                  remote_fed->server_port);
 }
@@ -760,8 +1101,8 @@ void handle_address_ad(uint16_t federate_id) {
   // connections to other federates
   int32_t server_port = -1;
   unsigned char buffer[sizeof(int32_t)];
-  read_from_socket_fail_on_error(&fed->socket, sizeof(int32_t), (unsigned char*)buffer, NULL,
-                                 "Error reading port data from federate %d.", federate_id);
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(fed, sizeof(int32_t), (unsigned char*)buffer,
+                                   "Error reading port data from federate %d.", federate_id);
 
   server_port = extract_int32(buffer);
 
@@ -777,38 +1118,128 @@ void handle_address_ad(uint16_t federate_id) {
   }
 }
 
-void handle_timestamp(federate_info_t* my_fed) {
-  unsigned char buffer[sizeof(int64_t)];
-  // Read bytes from the socket. We need 8 bytes.
-  read_from_socket_fail_on_error(&my_fed->socket, sizeof(int64_t), (unsigned char*)&buffer, NULL,
-                                 "ERROR reading timestamp from federate %d.\n", my_fed->enclave.id);
+void handle_time_triggered_schedule(federate_info_t* fed) {
+  unsigned char buffer[MSG_TYPE_TIME_TRIGGERED_SCHEDULE_HEADER_SIZE - 1];
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(fed, sizeof(buffer), buffer,
+                                   "RTI failed to read the time-triggered schedule of federate %d.", fed->enclave.id);
+  interval_t hyperperiod = extract_int64(buffer);
+  uint32_t size = extract_uint32(&buffer[sizeof(int64_t)]);
+  if (size > TIME_TRIGGERED_MAX_SLOTS) {
+    lf_print_error_and_exit("RTI received %u times of timers from federate %d, which is more than %d.", size,
+                            fed->enclave.id, TIME_TRIGGERED_MAX_SLOTS);
+  }
+  unsigned char* offsets = (unsigned char*)malloc(size * sizeof(int64_t) + 1);
+  LF_ASSERT_NON_NULL(offsets);
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(fed, size * sizeof(int64_t), offsets,
+                                   "RTI failed to read the time-triggered schedule of federate %d.", fed->enclave.id);
 
-  int64_t timestamp = swap_bytes_if_big_endian_int64(*((int64_t*)(&buffer)));
-  if (rti_remote->base.tracing_enabled) {
-    tag_t tag = {.time = timestamp, .microstep = 0};
-    tracepoint_rti_from_federate(receive_TIMESTAMP, my_fed->enclave.id, &tag);
+  LF_MUTEX_LOCK(&rti_mutex);
+  fed->time_triggered = true;
+  fed->timer_hyperperiod = hyperperiod;
+  fed->timer_slots = (time_slots_t){.offsets = NULL, .size = 0, .capacity = 0};
+  if (size > 0) {
+    fed->timer_slots.offsets = (interval_t*)malloc(size * sizeof(interval_t));
+    LF_ASSERT_NON_NULL(fed->timer_slots.offsets);
+    fed->timer_slots.size = fed->timer_slots.capacity = size;
+  }
+  for (uint32_t i = 0; i < size; i++) {
+    fed->timer_slots.offsets[i] = extract_int64(&offsets[i * sizeof(int64_t)]);
+    if (fed->timer_slots.offsets[i] < 0 || fed->timer_slots.offsets[i] >= hyperperiod ||
+        (i > 0 && fed->timer_slots.offsets[i] <= fed->timer_slots.offsets[i - 1])) {
+      lf_print_warning("RTI: The times of the timers of federate %d are not sorted within their hyperperiod.",
+                       fed->enclave.id);
+      fed->timer_hyperperiod = -1;
+      break;
+    }
   }
-  LF_PRINT_DEBUG("RTI received timestamp message with time: " PRINTF_TIME ".", timestamp);
+  LF_MUTEX_UNLOCK(&rti_mutex);
+  free(offsets);
+  LF_PRINT_LOG("RTI received the times of %u timer firings per hyperperiod of " PRINTF_TIME " from federate %d.",
+               size, hyperperiod, fed->enclave.id);
+}
 
-  LF_MUTEX_LOCK(&rti_mutex);
-  rti_remote->num_feds_proposed_start++;
-  if (timestamp > rti_remote->max_start_time) {
-    rti_remote->max_start_time = timestamp;
+/**
+ * @brief Decide whether the federation is time triggered once all federates have proposed a
+ * start time, and if it is, find the times at which messages may be sent to each federate.
+ *
+ * A federation is time triggered if the RTI has been given a window and all federates can be
+ * time triggered. Otherwise, the federates that can be are told to use grants instead.
+ * This function assumes the caller holds the mutex.
+ */
+static void decide_time_triggered_locked() {
+  rti_remote->time_triggered_hyperperiod = 0;
+  if (rti_remote->time_triggered_window < 0) {
+    return;
   }
-  if (rti_remote->num_feds_proposed_start == rti_remote->base.number_of_scheduling_nodes) {
-    // All federates have proposed a start time.
-    lf_cond_broadcast(&received_start_times);
-  } else {
-    // Some federates have not yet proposed a start time.
-    // wait for a notification.
-    while (rti_remote->num_feds_proposed_start < rti_remote->base.number_of_scheduling_nodes) {
-      // FIXME: Should have a timeout here?
-      lf_cond_wait(&received_start_times);
+  int n = rti_remote->base.number_of_scheduling_nodes;
+  interval_t* hyperperiods = (interval_t*)calloc(n, sizeof(interval_t));
+  time_slots_t* timers = (time_slots_t*)calloc(n, sizeof(time_slots_t));
+  time_slots_t* inbound = (time_slots_t*)calloc(n, sizeof(time_slots_t));
+  LF_ASSERT_NON_NULL(hyperperiods);
+  LF_ASSERT_NON_NULL(timers);
+  LF_ASSERT_NON_NULL(inbound);
+  bool possible = true;
+  for (int i = 0; possible && i < n; i++) {
+    federate_info_t* fed = GET_FED_INFO(i);
+    possible = fed->time_triggered && fed->timer_hyperperiod >= 0;
+    if (!possible) {
+      lf_print_warning("RTI: Federate %d cannot be time triggered, so the federation uses tag advance grants.", i);
     }
+    hyperperiods[i] = fed->timer_hyperperiod;
+    timers[i] = fed->timer_slots;
+  }
+  if (possible) {
+    rti_remote->time_triggered_hyperperiod = time_triggered_schedule(hyperperiods, timers, inbound);
+    if (rti_remote->time_triggered_hyperperiod == 0) {
+      lf_print_warning("RTI: The federation has no time-triggered schedule, so it uses tag advance grants.");
+    }
+  }
+  for (int i = 0; rti_remote->time_triggered_hyperperiod > 0 && i < n; i++) {
+    federate_info_t* fed = GET_FED_INFO(i);
+    fed->inbound_slots = inbound[i];
   }
+  if (rti_remote->time_triggered_hyperperiod > 0) {
+    lf_print("RTI: The federation is time triggered with a hyperperiod of " PRINTF_TIME " ns and a window of "
+             PRINTF_TIME " ns.",
+             rti_remote->time_triggered_hyperperiod, rti_remote->time_triggered_window);
+  }
+  free(hyperperiods);
+  free(timers);
+  free(inbound);
+}
 
-  LF_MUTEX_UNLOCK(&rti_mutex);
+/**
+ * @brief Send the slots of a time-triggered federation to a federate that has sent its schedule.
+ *
+ * This function assumes the caller does not hold the mutex and that the federate is not yet
+ * sent any other message after its start time.
+ */
+static void send_time_triggered_slots(federate_info_t* fed) {
+  size_t size = rti_remote->time_triggered_hyperperiod > 0 ? fed->inbound_slots.size : 0;
+  size_t length = MSG_TYPE_TIME_TRIGGERED_SLOTS_HEADER_SIZE + size * sizeof(int64_t);
+  unsigned char* buffer = (unsigned char*)malloc(length);
+  LF_ASSERT_NON_NULL(buffer);
+  buffer[0] = MSG_TYPE_TIME_TRIGGERED_SLOTS;
+  encode_int64(rti_remote->time_triggered_hyperperiod > 0 ? rti_remote->time_triggered_window : -1, &buffer[1]);
+  encode_int64(rti_remote->time_triggered_hyperperiod, &buffer[1 + sizeof(int64_t)]);
+  encode_uint32((uint32_t)size, &buffer[1 + 2 * sizeof(int64_t)]);
+  unsigned char* slots = &buffer[MSG_TYPE_TIME_TRIGGERED_SLOTS_HEADER_SIZE];
+  for (size_t i = 0; i < size; i++) {
+    encode_int64(fed->inbound_slots.offsets[i], &slots[i * sizeof(int64_t)]);
+  }
+  if (write_to_socket(fed->socket, length, buffer)) {
+    lf_print_error("Failed to send the time-triggered slots to federate %d.", fed->enclave.id);
+  }
+  free(buffer);
+}
 
+/**
+ * @brief Send the start time to the federate on a MSG_TYPE_TIMESTAMP message once all
+ * federates have proposed a start time.
+ *
+ * This function assumes the caller does not hold the mutex.
+ */
+static void send_start_time(federate_info_t* my_fed) {
   // Send back to the federate the maximum time plus an offset on a TIMESTAMP
   // message.
   unsigned char start_time_buffer[MSG_TYPE_TIMESTAMP_LENGTH];
@@ -825,6 +1256,9 @@ void handle_timestamp(federate_info_t* my_fed) {
   if (write_to_socket(my_fed->socket, MSG_TYPE_TIMESTAMP_LENGTH, start_time_buffer)) {
     lf_print_error("Failed to send the starting time to federate %d.", my_fed->enclave.id);
   }
+  if (my_fed->time_triggered) {
+    send_time_triggered_slots(my_fed);
+  }
 
   LF_MUTEX_LOCK(&rti_mutex);
   // Update state for the federate to indicate that the MSG_TYPE_TIMESTAMP
@@ -836,6 +1270,57 @@ void handle_timestamp(federate_info_t* my_fed) {
   LF_MUTEX_UNLOCK(&rti_mutex);
 }
 
+void handle_timestamp(federate_info_t* my_fed) {
+  unsigned char buffer[sizeof(int64_t)];
+  // Read bytes from the socket. We need 8 bytes.
+  READ_FROM_FEDERATE_FAIL_ON_ERROR(my_fed, sizeof(int64_t), (unsigned char*)&buffer,
+                                   "ERROR reading timestamp from federate %d.\n", my_fed->enclave.id);
+
+  int64_t timestamp = swap_bytes_if_big_endian_int64(*((int64_t*)(&buffer)));
+  if (rti_remote->base.tracing_enabled) {
+    tag_t tag = {.time = timestamp, .microstep = 0};
+    tracepoint_rti_from_federate(receive_TIMESTAMP, my_fed->enclave.id, &tag);
+  }
+  LF_PRINT_DEBUG("RTI received timestamp message with time: " PRINTF_TIME ".", timestamp);
+
+  LF_MUTEX_LOCK(&rti_mutex);
+  rti_remote->num_feds_proposed_start++;
+  if (timestamp > rti_remote->max_start_time) {
+    rti_remote->max_start_time = timestamp;
+  }
+  if (rti_remote->event_loop) {
+    // The event loop cannot wait for the other federates, so the last federate to propose
+    // a start time triggers sending it to all of them.
+    bool all_proposed = rti_remote->num_feds_proposed_start == rti_remote->base.number_of_scheduling_nodes;
+    if (all_proposed) {
+      decide_time_triggered_locked();
+    }
+    LF_MUTEX_UNLOCK(&rti_mutex);
+    for (int i = 0; all_proposed && i < rti_remote->base.number_of_scheduling_nodes; i++) {
+      federate_info_t* fed = GET_FED_INFO(i);
+      if (fed->enclave.state != NOT_CONNECTED) {
+        send_start_time(fed);
+      }
+    }
+    return;
+  }
+  if (rti_remote->num_feds_proposed_start == rti_remote->base.number_of_scheduling_nodes) {
+    // All federates have proposed a start time.
+    decide_time_triggered_locked();
+    lf_cond_broadcast(&received_start_times);
+  } else {
+    // Some federates have not yet proposed a start time.
+    // wait for a notification.
+    while (rti_remote->num_feds_proposed_start < rti_remote->base.number_of_scheduling_nodes) {
+      // FIXME: Should have a timeout here?
+      lf_cond_wait(&received_start_times);
+    }
+  }
+
+  LF_MUTEX_UNLOCK(&rti_mutex);
+  send_start_time(my_fed);
+}
+
 void send_physical_clock(unsigned char message_type, federate_info_t* fed, socket_type_t socket_type) {
   if (fed->enclave.state == NOT_CONNECTED) {
     lf_print_warning("Clock sync: RTI failed to send physical time to federate %d. Socket not connected.\n",
@@ -860,19 +1345,16 @@ void send_physical_clock(unsigned char message_type, federate_info_t* fed, socke
     }
   } else if (socket_type == TCP) {
     LF_PRINT_DEBUG("Clock sync:  RTI sending TCP message type %u.", buffer[0]);
-    LF_MUTEX_LOCK(&rti_mutex);
-    write_to_socket_fail_on_error(&fed->socket, 1 + sizeof(int64_t), buffer, &rti_mutex,
-                                  "Clock sync: RTI failed to send physical time to federate %d.", fed->enclave.id);
-    LF_MUTEX_UNLOCK(&rti_mutex);
+    WRITE_TO_FEDERATE_FAIL_ON_ERROR(fed, 1 + sizeof(int64_t), buffer, NULL,
+                                    "Clock sync: RTI failed to send physical time to federate %d.", fed->enclave.id);
   }
   LF_PRINT_DEBUG("Clock sync: RTI sent PHYSICAL_TIME_SYNC_MESSAGE with timestamp " PRINTF_TIME " to federate %d.",
                  current_physical_time, fed->enclave.id);
 }
 
 void handle_physical_clock_sync_message(federate_info_t* my_fed, socket_type_t socket_type) {
-  // Lock the mutex to prevent interference between sending the two
-  // coded probe messages.
-  LF_MUTEX_LOCK(&rti_mutex);
+  // The mutex is not needed to keep the two coded probe messages together because only the
+  // clock synchronization thread sends messages on the UDP socket.
   // Reply with a T4 type message
   send_physical_clock(MSG_TYPE_CLOCK_SYNC_T4, my_fed, socket_type);
   // Send the corresponding coded probe immediately after,
@@ -880,7 +1362,6 @@ void handle_physical_clock_sync_message(federate_info_t* my_fed, socket_type_t s
   if (socket_type == UDP) {
     send_physical_clock(MSG_TYPE_CLOCK_SYNC_CODED_PROBE, my_fed, socket_type);
   }
-  LF_MUTEX_UNLOCK(&rti_mutex);
 }
 
 void* clock_synchronization_thread(void* noargs) {
@@ -901,14 +1382,27 @@ void* clock_synchronization_thread(void* noargs) {
     lf_sleep(ns_to_wait);
   }
 
+  // Whether a T3 message is expected from each federate in the current round.
+  int number_of_federates = rti_remote->base.number_of_scheduling_nodes;
+  bool* awaiting_T3 = (bool*)calloc(number_of_federates, sizeof(bool));
+  LF_ASSERT_NON_NULL(awaiting_T3);
+  // The replies arrive all at once, so make room for them in the socket buffer.
+  int receive_buffer_size = number_of_federates * CLOCK_SYNC_RECEIVE_BUFFER_PER_FEDERATE;
+  if (setsockopt(rti_remote->socket_descriptor_UDP, SOL_SOCKET, SO_RCVBUF, &receive_buffer_size,
+                 sizeof(receive_buffer_size)) < 0) {
+    lf_print_warning("Clock sync: Failed to enlarge the UDP receive buffer: %s.", strerror(errno));
+  }
+
   // Initiate a clock synchronization every rti->clock_sync_period_ns
   bool any_federates_connected = true;
   while (any_federates_connected) {
     // Sleep
     lf_sleep(rti_remote->clock_sync_period_ns); // Can be interrupted
     any_federates_connected = false;
-    for (int fed_id = 0; fed_id < rti_remote->base.number_of_scheduling_nodes; fed_id++) {
+    int number_awaited = 0;
+    for (int fed_id = 0; fed_id < number_of_federates; fed_id++) {
       federate_info_t* fed = GET_FED_INFO(fed_id);
+      awaiting_T3[fed_id] = false;
       if (fed->enclave.state == NOT_CONNECTED) {
         // FIXME: We need better error handling here, but clock sync failure
         // should not stop execution.
@@ -919,55 +1413,63 @@ void* clock_synchronization_thread(void* noargs) {
       }
       // Send the RTI's current physical time to the federate
       // Send on UDP.
-      LF_PRINT_DEBUG("RTI sending T1 message to initiate clock sync round.");
+      LF_PRINT_DEBUG("RTI sending T1 message to federate %d to initiate clock sync round.", fed_id);
       send_physical_clock(MSG_TYPE_CLOCK_SYNC_T1, fed, UDP);
+      awaiting_T3[fed_id] = true;
+      number_awaited++;
+      any_federates_connected = true;
+    }
 
-      // Listen for reply message, which should be T3.
+    // Handle the T3 replies in the order in which they arrive, until all have arrived
+    // or the round times out.
+    instant_t deadline = lf_time_physical() + rti_remote->clock_sync_period_ns;
+    while (number_awaited > 0) {
+      interval_t remaining = deadline - lf_time_physical();
+      if (remaining <= 0) {
+        break;
+      }
+      struct pollfd udp = {.fd = rti_remote->socket_descriptor_UDP, .events = POLLIN};
+      int ready = poll(&udp, 1, (int)((remaining + MSEC(1) - 1) / MSEC(1)));
+      if (ready < 0 && errno != EINTR) {
+        lf_print_warning("Clock sync: Waiting on the UDP socket failed: %s. Ending the clock sync round.",
+                         strerror(errno));
+        break;
+      } else if (ready <= 0) {
+        continue;
+      }
       size_t message_size = 1 + sizeof(int32_t);
       unsigned char buffer[message_size];
-      // Maximum number of messages that we discard before giving up on this cycle.
-      // If the T3 message from this federate does not arrive and we keep receiving
-      // other messages, then give up on this federate and move to the next federate.
-      int remaining_attempts = 5;
-      while (remaining_attempts > 0) {
-        remaining_attempts--;
-        int read_failed = read_from_socket(rti_remote->socket_descriptor_UDP, message_size, buffer);
-        // If any errors occur, either discard the message or the clock sync round.
-        if (!read_failed) {
-          if (buffer[0] == MSG_TYPE_CLOCK_SYNC_T3) {
-            int32_t fed_id_2 = extract_int32(&(buffer[1]));
-            // Check that this message came from the correct federate.
-            if (fed_id_2 != fed->enclave.id) {
-              // Message is from the wrong federate. Discard the message.
-              lf_print_warning("Clock sync: Received T3 message from federate %d, "
-                               "but expected one from %d. Discarding message.",
-                               fed_id_2, fed->enclave.id);
-              continue;
-            }
-            LF_PRINT_DEBUG("Clock sync: RTI received T3 message from federate %d.", fed_id_2);
-            handle_physical_clock_sync_message(GET_FED_INFO(fed_id_2), UDP);
-            break;
-          } else {
-            // The message is not a T3 message. Discard the message and
-            // continue waiting for the T3 message. This is possibly a message
-            // from a previous cycle that was discarded.
-            lf_print_warning("Clock sync: Unexpected UDP message %u. Expected %u from federate %d. "
-                             "Discarding message.",
-                             buffer[0], MSG_TYPE_CLOCK_SYNC_T3, fed->enclave.id);
-            continue;
-          }
-        } else {
-          lf_print_warning("Clock sync: Read from UDP socket failed: %s. "
-                           "Skipping clock sync round for federate %d.",
-                           strerror(errno), fed->enclave.id);
-          remaining_attempts = -1;
+      ssize_t bytes_read = recv(rti_remote->socket_descriptor_UDP, buffer, message_size, MSG_DONTWAIT);
+      if (bytes_read < (ssize_t)message_size) {
+        if (bytes_read >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+          lf_print_warning("Clock sync: Discarding a malformed UDP message or failed read.");
         }
+        continue;
       }
-      if (remaining_attempts > 0) {
-        any_federates_connected = true;
+      if (buffer[0] != MSG_TYPE_CLOCK_SYNC_T3) {
+        // The message is not a T3 message. Discard the message and
+        // continue waiting for T3 messages.
+        lf_print_warning("Clock sync: Unexpected UDP message %u. Expected %u. Discarding message.", buffer[0],
+                         MSG_TYPE_CLOCK_SYNC_T3);
+        continue;
       }
+      int32_t fed_id = extract_int32(&(buffer[1]));
+      if (fed_id < 0 || fed_id >= number_of_federates || !awaiting_T3[fed_id]) {
+        // This is possibly a message from a previous round that timed out.
+        lf_print_warning("Clock sync: Received unexpected T3 message from federate %d. Discarding message.", fed_id);
+        continue;
+      }
+      LF_PRINT_DEBUG("Clock sync: RTI received T3 message from federate %d.", fed_id);
+      handle_physical_clock_sync_message(GET_FED_INFO(fed_id), UDP);
+      awaiting_T3[fed_id] = false;
+      number_awaited--;
+    }
+    if (number_awaited > 0) {
+      lf_print_warning("Clock sync: %d federates did not reply in time. Skipping this round for them.",
+                       number_awaited);
     }
   }
+  free(awaiting_T3);
   return NULL;
 }
 
@@ -995,8 +1497,19 @@ static void handle_federate_failed(federate_info_t* my_fed) {
   my_fed->enclave.state = NOT_CONNECTED;
 
   // Indicate that there will no further events from this federate.
-  my_fed->enclave.next_event = FOREVER_TAG;
+  set_next_event_tag(&(my_fed->enclave), FOREVER_TAG);
+
+  // Check downstream federates to see whether they should now be granted a TAG.
+  // To handle cycles, need to create a boolean array to keep
+  // track of which upstream federates have been visited.
+  bool visited[rti_remote->base.number_of_scheduling_nodes];
+  memset(visited, 0, sizeof(visited));
+  notify_downstream_advance_grant_if_safe(&(my_fed->enclave), visited);
 
+  unlock_and_send_posted_messages();
+
+  // The send mutex keeps the socket from being closed while a message is forwarded to it.
+  LF_MUTEX_LOCK(&my_fed->send_mutex);
   // According to this: https://stackoverflow.com/questions/4160347/close-vs-shutdown-socket,
   // the close should happen when receiving a 0 length message from the other end.
   // Here, we just signal the other side that no further writes to the socket are
@@ -1005,15 +1518,7 @@ static void handle_federate_failed(federate_info_t* my_fed) {
 
   // We can now safely close the socket.
   close(my_fed->socket); //  from unistd.h
-
-  // Check downstream federates to see whether they should now be granted a TAG.
-  // To handle cycles, need to create a boolean array to keep
-  // track of which upstream federates have been visited.
-  bool* visited = (bool*)calloc(rti_remote->base.number_of_scheduling_nodes, sizeof(bool)); // Initializes to 0.
-  notify_downstream_advance_grant_if_safe(&(my_fed->enclave), visited);
-  free(visited);
-
-  LF_MUTEX_UNLOCK(&rti_mutex);
+  LF_MUTEX_UNLOCK(&my_fed->send_mutex);
 }
 
 /**
@@ -1041,7 +1546,21 @@ static void handle_federate_resign(federate_info_t* my_fed) {
   my_fed->enclave.state = NOT_CONNECTED;
 
   // Indicate that there will no further events from this federate.
-  my_fed->enclave.next_event = FOREVER_TAG;
+  set_next_event_tag(&(my_fed->enclave), FOREVER_TAG);
+
+  // Check downstream federates to see whether they should now be granted a TAG.
+  // To handle cycles, need to create a boolean array to keep
+  // track of which upstream federates have been visited.
+  bool visited[rti_remote->base.number_of_scheduling_nodes];
+  memset(visited, 0, sizeof(visited));
+  notify_downstream_advance_grant_if_safe(&(my_fed->enclave), visited);
+
+  unlock_and_send_posted_messages();
+
+  // The send mutex keeps the socket from being closed while a message is forwarded to it.
+  LF_MUTEX_LOCK(&my_fed->send_mutex);
+  // Messages posted to the federate before it resigned are still delivered.
+  send_posted_messages_of(my_fed);
 
   // According to this: https://stackoverflow.com/questions/4160347/close-vs-shutdown-socket,
   // the close should happen when receiving a 0 length message from the other end.
@@ -1058,15 +1577,72 @@ static void handle_federate_resign(federate_info_t* my_fed) {
 
   // We can now safely close the socket.
   close(my_fed->socket); //  from unistd.h
+  LF_MUTEX_UNLOCK(&my_fed->send_mutex);
+}
 
-  // Check downstream federates to see whether they should now be granted a TAG.
-  // To handle cycles, need to create a boolean array to keep
-  // track of which upstream federates have been visited.
-  bool* visited = (bool*)calloc(rti_remote->base.number_of_scheduling_nodes, sizeof(bool)); // Initializes to 0.
-  notify_downstream_advance_grant_if_safe(&(my_fed->enclave), visited);
-  free(visited);
-
-  LF_MUTEX_UNLOCK(&rti_mutex);
+/**
+ * @brief Handle a message from a federate whose first byte, the message type, has been read.
+ *
+ * This function assumes the caller does not hold the mutex.
+ *
+ * @param my_fed The federate sending the message.
+ * @param buffer A buffer of FED_COM_BUFFER_SIZE bytes whose first byte is the message type.
+ * @return false if the federate has resigned or failed, true otherwise.
+ */
+static bool handle_federate_message(federate_info_t* my_fed, unsigned char* buffer) {
+  LF_PRINT_DEBUG("RTI: Received message type %u from federate %d.", buffer[0], my_fed->enclave.id);
+  switch (buffer[0]) {
+case MSG_TYPE_TIMESTAMP:
+    handle_timestamp(my_fed);
+    break;
+  case MSG_TYPE_TIME_TRIGGERED_SCHEDULE:
+    handle_time_triggered_schedule(my_fed);
+    break;
+  case MSG_TYPE_ADDRESS_QUERY:
+    handle_address_query(my_fed->enclave.id);
+    break;
+  case MSG_TYPE_ADDRESS_ADVERTISEMENT:
+    handle_address_ad(my_fed->enclave.id);
+    break;
+  case MSG_TYPE_TAGGED_MESSAGE:
+    handle_timed_message(my_fed, buffer);
+    break;
+  case MSG_TYPE_MULTICAST_TAGGED_MESSAGE:
+    handle_multicast_tagged_message(my_fed, buffer);
+    break;
+  case MSG_TYPE_RESIGN:
+    handle_federate_resign(my_fed);
+    return false;
+  case MSG_TYPE_NEXT_EVENT_TAG:
+    handle_next_event_tag(my_fed);
+    break;
+  case MSG_TYPE_LATEST_TAG_COMPLETE:
+    handle_latest_tag_complete(my_fed);
+    break;
+  case MSG_TYPE_STOP_REQUEST:
+    handle_stop_request_message(my_fed); // FIXME: Reviewed until here.
+                                         // Need to also look at
+                                         // notify_advance_grant_if_safe()
+                                         // and notify_downstream_advance_grant_if_safe()
+    break;
+  case MSG_TYPE_STOP_REQUEST_REPLY:
+    handle_stop_request_reply(my_fed);
+    break;
+  case MSG_TYPE_PORT_ABSENT:
+  case MSG_TYPE_PORT_ABSENT_RANGES:
+    handle_port_absent_message(my_fed, buffer);
+    break;
+  case MSG_TYPE_FAILED:
+    handle_federate_failed(my_fed);
+    return false;
+  default:
+    lf_print_error("RTI received from federate %d an unrecognized TCP message type: %u.", my_fed->enclave.id,
+                   buffer[0]);
+    if (rti_remote->base.tracing_enabled) {
+      tracepoint_rti_from_federate(receive_UNIDENTIFIED, my_fed->enclave.id, NULL);
+    }
+  }
+  return true;
 }
 
 void* federate_info_thread_TCP(void* fed) {
@@ -1078,6 +1654,10 @@ void* federate_info_thread_TCP(void* fed) {
   // are forwarded piece by piece.
   unsigned char buffer[FED_COM_BUFFER_SIZE];
 
+  // Read the socket in large chunks rather than field by field.
+  socket_receive_buffer_t receive_buffer;
+  start_buffered_reads_from_socket(my_fed->socket, &receive_buffer);
+
   // Listen for messages from the federate.
   while (my_fed->enclave.state != NOT_CONNECTED) {
     // Read no more than one byte to get the message type.
@@ -1090,61 +1670,203 @@ void* federate_info_thread_TCP(void* fed) {
       // FIXME: We need better error handling here, but do not stop execution here.
       break;
     }
-    LF_PRINT_DEBUG("RTI: Received message type %u from federate %d.", buffer[0], my_fed->enclave.id);
-    switch (buffer[0]) {
-    case MSG_TYPE_TIMESTAMP:
-      handle_timestamp(my_fed);
-      break;
-    case MSG_TYPE_ADDRESS_QUERY:
-      handle_address_query(my_fed->enclave.id);
-      break;
-    case MSG_TYPE_ADDRESS_ADVERTISEMENT:
-      handle_address_ad(my_fed->enclave.id);
-      break;
-    case MSG_TYPE_TAGGED_MESSAGE:
-      handle_timed_message(my_fed, buffer);
-      break;
-    case MSG_TYPE_RESIGN:
-      handle_federate_resign(my_fed);
+    if (!handle_federate_message(my_fed, buffer)) {
       return NULL;
-    case MSG_TYPE_NEXT_EVENT_TAG:
-      handle_next_event_tag(my_fed);
-      break;
-    case MSG_TYPE_LATEST_TAG_COMPLETE:
-      handle_latest_tag_complete(my_fed);
-      break;
-    case MSG_TYPE_STOP_REQUEST:
-      handle_stop_request_message(my_fed); // FIXME: Reviewed until here.
-                                           // Need to also look at
-                                           // notify_advance_grant_if_safe()
-                                           // and notify_downstream_advance_grant_if_safe()
-      break;
-    case MSG_TYPE_STOP_REQUEST_REPLY:
-      handle_stop_request_reply(my_fed);
-      break;
-    case MSG_TYPE_PORT_ABSENT:
-      handle_port_absent_message(my_fed, buffer);
-      break;
-    case MSG_TYPE_FAILED:
-      handle_federate_failed(my_fed);
-      return NULL;
-    default:
-      lf_print_error("RTI received from federate %d an unrecognized TCP message type: %u.", my_fed->enclave.id,
-                     buffer[0]);
-      if (rti_remote->base.tracing_enabled) {
-        tracepoint_rti_from_federate(receive_UNIDENTIFIED, my_fed->enclave.id, NULL);
-      }
     }
   }
 
   // Nothing more to do. Close the socket and exit.
   // Prevent multiple threads from closing the same socket at the same time.
-  LF_MUTEX_LOCK(&rti_mutex);
+  end_buffered_reads_from_socket();
+  LF_MUTEX_LOCK(&my_fed->send_mutex);
   close(my_fed->socket); //  from unistd.h
-  LF_MUTEX_UNLOCK(&rti_mutex);
+  LF_MUTEX_UNLOCK(&my_fed->send_mutex);
   return NULL;
 }
 
+/**
+ * @brief Return the number of bytes of a message from a federate that have to be received
+ * before it is handled by the event loop. For a tagged message, this is its header, and the
+ * handler reads the payload as it arrives. A port absent message for several ports is handled
+ * once all of it has been received, which takes less than RTI_INPUT_BUFFER_SIZE bytes.
+ * @param fed The federate, whose input buffer starts with the message.
+ */
+static size_t message_length_to_handle(federate_info_t* fed) {
+  unsigned char* message = fed->input + fed->input_start;
+  switch (message[0]) {
+  case MSG_TYPE_PORT_ABSENT_RANGES:
+    if (fed->input_end - fed->input_start < MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE) {
+      return MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE;
+    }
+    check_port_absent_ranges(fed, message);
+    return port_absent_message_length(message);
+  case MSG_TYPE_TIMESTAMP:
+    return MSG_TYPE_TIMESTAMP_LENGTH;
+  case MSG_TYPE_TIME_TRIGGERED_SCHEDULE:
+    // The times may not fit in the input buffer, so the handler reads them from the socket.
+    return MSG_TYPE_TIME_TRIGGERED_SCHEDULE_HEADER_SIZE;
+  case MSG_TYPE_ADDRESS_QUERY:
+    return 1 + sizeof(uint16_t);
+  case MSG_TYPE_ADDRESS_ADVERTISEMENT:
+    return 1 + sizeof(int32_t);
+  case MSG_TYPE_TAGGED_MESSAGE:
+    return 1 + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(int64_t) + sizeof(uint32_t);
+  case MSG_TYPE_MULTICAST_TAGGED_MESSAGE:
+    // The destinations and the payload are read by the handler as they arrive.
+    return MSG_TYPE_MULTICAST_TAGGED_MESSAGE_HEADER_SIZE;
+  case MSG_TYPE_NEXT_EVENT_TAG:
+  case MSG_TYPE_LATEST_TAG_COMPLETE:
+    return 1 + sizeof(int64_t) + sizeof(uint32_t);
+  case MSG_TYPE_STOP_REQUEST:
+    return MSG_TYPE_STOP_REQUEST_LENGTH;
+  case MSG_TYPE_STOP_REQUEST_REPLY:
+    return MSG_TYPE_STOP_REQUEST_REPLY_LENGTH;
+  case MSG_TYPE_PORT_ABSENT:
+    return 1 + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(int64_t) + sizeof(uint32_t);
+  default:
+    return 1;
+  }
+}
+
+/**
+ * @brief Receive the bytes that have arrived on the socket of a federate into its input buffer.
+ * @return false if the socket is closed, in which case the federate is marked as not connected.
+ */
+static bool receive_federate_input(federate_info_t* fed) {
+  // Move the bytes of a partially received message to the start of the buffer.
+  size_t pending = fed->input_end - fed->input_start;
+  memmove(fed->input, fed->input + fed->input_start, pending);
+  fed->input_start = 0;
+  fed->input_end = pending;
+  ssize_t received = read(fed->socket, fed->input + pending, RTI_INPUT_BUFFER_SIZE - pending);
+  if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+    return true;
+  }
+  if (received <= 0) {
+    lf_print_error("RTI: Socket to federate %d is closed.", fed->enclave.id);
+    LF_MUTEX_LOCK(&rti_mutex);
+    fed->enclave.state = NOT_CONNECTED;
+    LF_MUTEX_UNLOCK(&rti_mutex);
+    LF_MUTEX_LOCK(&fed->send_mutex);
+    close(fed->socket);
+    fed->socket = -1;
+    LF_MUTEX_UNLOCK(&fed->send_mutex);
+    return false;
+  }
+  fed->input_end += (size_t)received;
+  return true;
+}
+
+/**
+ * @brief Handle the NET, LTC, and port absent messages at the start of the input buffer of a federate,
+ * stopping at the first message of another type so that the messages are handled in order.
+ *
+ * This function assumes the caller holds the mutex. The messages can be handled under the mutex
+ * because all federates are sent their start time at once, so no grant waits for it.
+ */
+static void handle_buffered_tag_messages_locked(federate_info_t* fed) {
+  while (fed->input_end > fed->input_start) {
+    unsigned char* message = fed->input + fed->input_start;
+    size_t length = message_length_to_handle(fed);
+    if (fed->input_end - fed->input_start < length) {
+      return;
+    }
+    if (message[0] == MSG_TYPE_NEXT_EVENT_TAG) {
+      next_event_tag_locked(fed, message + 1);
+    } else if (message[0] == MSG_TYPE_LATEST_TAG_COMPLETE) {
+      latest_tag_complete(fed, message + 1);
+    } else if (message[0] == MSG_TYPE_PORT_ABSENT || message[0] == MSG_TYPE_PORT_ABSENT_RANGES) {
+      forward_port_absent_message_locked(fed, message);
+    } else {
+      return;
+    }
+    fed->input_start += length;
+  }
+}
+
+/**
+ * @brief Handle the messages in the input buffer of a federate that have been received
+ * far enough to be handled.
+ *
+ * This function assumes the caller does not hold the mutex.
+ */
+static void handle_buffered_messages(federate_info_t* fed) {
+  unsigned char buffer[FED_COM_BUFFER_SIZE];
+  while (fed->enclave.state != NOT_CONNECTED && fed->input_end > fed->input_start) {
+    if (fed->input_end - fed->input_start < message_length_to_handle(fed)) {
+      return;
+    }
+    // The handler takes the rest of the message from the buffer.
+    buffer[0] = fed->input[fed->input_start++];
+    if (!handle_federate_message(fed, buffer)) {
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Handle the messages from all federates on the calling thread until all of them
+ * have resigned, failed, or disconnected.
+ */
+static void handle_federates_in_event_loop() {
+  int number_of_federates = rti_remote->base.number_of_scheduling_nodes;
+  struct pollfd* sockets = (struct pollfd*)calloc(number_of_federates, sizeof(struct pollfd));
+  federate_info_t** ready = (federate_info_t**)calloc(number_of_federates, sizeof(federate_info_t*));
+  LF_ASSERT_NON_NULL(sockets);
+  LF_ASSERT_NON_NULL(ready);
+  for (int i = 0; i < number_of_federates; i++) {
+    federate_info_t* fed = GET_FED_INFO(i);
+    fed->input = (unsigned char*)malloc(RTI_INPUT_BUFFER_SIZE);
+    LF_ASSERT_NON_NULL(fed->input);
+  }
+  while (true) {
+    int number_of_sockets = 0;
+    for (int i = 0; i < number_of_federates; i++) {
+      federate_info_t* fed = GET_FED_INFO(i);
+      if (fed->enclave.state != NOT_CONNECTED) {
+        sockets[number_of_sockets].fd = fed->socket;
+        sockets[number_of_sockets].events = POLLIN;
+        ready[number_of_sockets++] = fed;
+      }
+    }
+    if (number_of_sockets == 0) {
+      break;
+    }
+    if (poll(sockets, number_of_sockets, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      lf_print_error_system_failure("RTI failed to wait for messages from federates.");
+    }
+    for (int i = 0; i < number_of_sockets; i++) {
+      if (sockets[i].revents == 0 || !receive_federate_input(ready[i])) {
+        ready[i] = NULL;
+      }
+    }
+    LF_MUTEX_LOCK(&rti_mutex);
+    for (int i = 0; i < number_of_sockets; i++) {
+      if (ready[i] != NULL) {
+        handle_buffered_tag_messages_locked(ready[i]);
+      }
+    }
+    unlock_and_send_posted_messages();
+    for (int i = 0; i < number_of_sockets; i++) {
+      if (ready[i] != NULL) {
+        handle_buffered_messages(ready[i]);
+      }
+    }
+  }
+  for (int i = 0; i < number_of_federates; i++) {
+    federate_info_t* fed = GET_FED_INFO(i);
+    free(fed->input);
+    fed->input = NULL;
+    fed->input_start = 0;
+    fed->input_end = 0;
+  }
+  free(sockets);
+  free(ready);
+}
+
 void send_reject(int* socket_id, unsigned char error_code) {
   LF_PRINT_DEBUG("RTI sending MSG_TYPE_REJECT.");
   unsigned char response[2];
@@ -1582,8 +2304,11 @@ void lf_connect_to_federates(int socket_descriptor) {
       // This has to be done after clock synchronization is finished
       // or that thread may end up attempting to handle incoming clock
       // synchronization messages.
+      // With the event loop, the messages are handled once all federates have connected.
       federate_info_t* fed = GET_FED_INFO(fed_id);
-      lf_thread_create(&(fed->thread_id), federate_info_thread_TCP, fed);
+      if (!rti_remote->event_loop) {
+        lf_thread_create(&(fed->thread_id), federate_info_thread_TCP, fed);
+      }
     } else {
       // Received message was rejected. Try again.
       i--;
@@ -1650,6 +2375,21 @@ void initialize_federate(federate_info_t* fed, uint16_t id) {
   strncpy(fed->server_hostname, "localhost", INET_ADDRSTRLEN);
   fed->server_ip_addr.s_addr = 0;
   fed->server_port = -1;
+  fed->input = NULL;
+  fed->input_start = 0;
+  fed->input_end = 0;
+  LF_MUTEX_INIT(&fed->send_mutex);
+  LF_MUTEX_INIT(&fed->outbox_mutex);
+  fed->outbox = NULL;
+  fed->outbox_size = 0;
+  fed->outbox_capacity = 0;
+  fed->outbox_sending = NULL;
+  fed->outbox_sending_capacity = 0;
+  fed->outbox_posted = false;
+  fed->time_triggered = false;
+  fed->timer_hyperperiod = -1;
+  fed->timer_slots = (time_slots_t){.offsets = NULL, .size = 0, .capacity = 0};
+  fed->inbound_slots = (time_slots_t){.offsets = NULL, .size = 0, .capacity = 0};
 }
 
 int32_t start_rti_server(uint16_t port) {
@@ -1672,6 +2412,19 @@ void wait_for_federates(int socket_descriptor) {
   // All federates have connected.
   lf_print("RTI: All expected federates have connected. Starting execution.");
 
+  // Now that the connections between all federates are known, find the minimum delays from
+  // their transitive upstream federates rather than on the first NETs. Delays that were found
+  // before some federates connected are found again.
+  LF_MUTEX_LOCK(&rti_mutex);
+  instant_t min_delays_start = lf_time_physical();
+  for (int i = 0; i < rti_remote->base.number_of_scheduling_nodes; i++) {
+    invalidate_min_delays_upstream(rti_remote->base.scheduling_nodes[i]);
+  }
+  update_all_min_delays_upstream();
+  LF_PRINT_LOG("RTI: Found the minimum delays between %d federates in " PRINTF_TIME " ns.",
+               rti_remote->base.number_of_scheduling_nodes, lf_time_physical() - min_delays_start);
+  LF_MUTEX_UNLOCK(&rti_mutex);
+
   // The socket server will not continue to accept connections after all the federates
   // have joined.
   // In case some other federation's federates are trying to join the wrong
@@ -1679,15 +2432,35 @@ void wait_for_federates(int socket_descriptor) {
   lf_thread_t responder_thread;
   lf_thread_create(&responder_thread, respond_to_erroneous_connections, NULL);
 
-  // Wait for federate threads to exit.
-  void* thread_exit_status;
+  if (rti_remote->event_loop) {
+    handle_federates_in_event_loop();
+    for (int i = 0; i < rti_remote->base.number_of_scheduling_nodes; i++) {
+      federate_info_t* fed = GET_FED_INFO(i);
+      pqueue_tag_free(fed->in_transit_message_tags);
+    }
+  } else {
+    // Wait for federate threads to exit.
+    void* thread_exit_status;
+    for (int i = 0; i < rti_remote->base.number_of_scheduling_nodes; i++) {
+      federate_info_t* fed = GET_FED_INFO(i);
+      lf_print("RTI: Waiting for thread handling federate %d.", fed->enclave.id);
+      lf_thread_join(fed->thread_id, &thread_exit_status);
+      pqueue_tag_free(fed->in_transit_message_tags);
+      lf_print("RTI: Federate %d thread exited.", fed->enclave.id);
+    }
+  }
   for (int i = 0; i < rti_remote->base.number_of_scheduling_nodes; i++) {
     federate_info_t* fed = GET_FED_INFO(i);
-    lf_print("RTI: Waiting for thread handling federate %d.", fed->enclave.id);
-    lf_thread_join(fed->thread_id, &thread_exit_status);
-    pqueue_tag_free(fed->in_transit_message_tags);
-    lf_print("RTI: Federate %d thread exited.", fed->enclave.id);
+    free(fed->outbox);
+    free(fed->outbox_sending);
+    free(fed->timer_slots.offsets);
+    free(fed->inbound_slots.offsets);
+  }
+  if (rti_remote->time_triggered_violations > 0) {
+    lf_print_warning("RTI: %zu messages violated the time-triggered schedule.", rti_remote->time_triggered_violations);
   }
+  free(posted_federates);
+  posted_federates = NULL;
 
   rti_remote->all_federates_exited = true;
 
@@ -1717,6 +2490,7 @@ void initialize_RTI(rti_remote_t* rti) {
 
   // Initialize thread synchronization primitives
   LF_MUTEX_INIT(&rti_mutex);
+  LF_LOCK_PROFILE_NAME(&rti_mutex, "rti_mutex");
   LF_COND_INIT(&received_start_times, &rti_mutex);
   LF_COND_INIT(&sent_start_time, &rti_mutex);
 
@@ -1739,6 +2513,10 @@ void initialize_RTI(rti_remote_t* rti) {
   rti_remote->authentication_enabled = false;
   rti_remote->base.tracing_enabled = false;
   rti_remote->stop_in_progress = false;
+  rti_remote->event_loop = false;
+  rti_remote->time_triggered_window = -1;
+  rti_remote->time_triggered_hyperperiod = 0;
+  rti_remote->time_triggered_violations = 0;
 }
 
 // The RTI includes clock.c, which requires the following functions that are defined
@@ -1757,6 +2535,9 @@ void free_scheduling_nodes(scheduling_node_t** scheduling_nodes, uint16_t number
     if (node->min_delays != NULL) {
       free(node->min_delays);
     }
+    if (node->eimt_dependents != NULL) {
+      free(node->eimt_dependents);
+    }
     if (node->downstream != NULL) {
       free(node->downstream);
     }
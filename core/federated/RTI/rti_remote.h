@@ -68,6 +68,25 @@ typedef struct federate_info_t {
                                          // RTI has not been informed of the port number.
   struct in_addr server_ip_addr;         // Information about the IP address of the socket
                                          // server of the federate.
+  unsigned char* input;                  // Bytes received from the federate by the event loop
+  size_t input_start;                    // (see rti_remote_t) that have not yet been handled, which
+  size_t input_end;                      // are input[input_start] to input[input_end - 1].
+  lf_mutex_t send_mutex;                 // Held while writing to the socket. If the mutex of the RTI
+                                         // is also held, it must be acquired first. No thread holds
+                                         // the send mutexes of two federates.
+  lf_mutex_t outbox_mutex;               // Guards the outbox, which holds grants and port absent
+  unsigned char* outbox;                 // messages that are decided under the mutex of the RTI
+  size_t outbox_size;                    // but sent after it is released. The bytes are
+  size_t outbox_capacity;                // outbox[0] to outbox[outbox_size - 1].
+  unsigned char* outbox_sending;         // The previous outbox, which holds the bytes being sent.
+  size_t outbox_sending_capacity;
+  bool outbox_posted;                    // Whether the federate is in the list of federates to send
+                                         // posted messages to. Guarded by the mutex of the RTI.
+  bool time_triggered;                   // Whether the federate has sent a MSG_TYPE_TIME_TRIGGERED_SCHEDULE
+  interval_t timer_hyperperiod;          // with this hyperperiod and these times of its timers.
+  time_slots_t timer_slots;
+  time_slots_t inbound_slots;            // Times at which messages may be sent to the federate if the
+                                         // federation is time triggered (see rti_remote_t).
 } federate_info_t;
 
 /**
@@ -158,6 +177,28 @@ typedef struct rti_remote_t {
    * Boolean indicating that a stop request is already in progress.
    */
   bool stop_in_progress;
+
+  /**
+   * Boolean indicating that messages from all federates are handled by one thread that
+   * waits for any of their sockets to become readable, instead of by one thread per federate.
+   */
+  bool event_loop;
+
+  /**
+   * The time after a tag by which all messages with that tag reach their destination, which is
+   * set with the -tt option, or -1 if the federation is not to be time triggered. In a
+   * time-triggered federation, federates advance to a tag once their physical clock has passed
+   * the last time before it at which messages may be sent to them plus this window. They send
+   * no NET or LTC messages, and the RTI sends no grants. The RTI only checks the tags and the
+   * arrival times of the messages it forwards against the schedule.
+   */
+  interval_t time_triggered_window;
+
+  /** The hyperperiod of the schedule of the federation, or 0 if it is not time triggered. */
+  interval_t time_triggered_hyperperiod;
+
+  /** Number of messages that violated the schedule of a time-triggered federation. */
+  size_t time_triggered_violations;
 } rti_remote_t;
 
 /**
@@ -206,6 +247,16 @@ void update_federate_next_event_tag_locked(uint16_t federate_id, tag_t next_even
  */
 void handle_port_absent_message(federate_info_t* sending_federate, unsigned char* buffer);
 
+/**
+ * Handle a MSG_TYPE_TIME_TRIGGERED_SCHEDULE message, which a federate sends before its
+ * MSG_TYPE_TIMESTAMP if it can be time triggered.
+ *
+ * This function assumes the caller does not hold the mutex.
+ *
+ * @param fed The federate that sent the message.
+ */
+void handle_time_triggered_schedule(federate_info_t* fed);
+
 /**
  * Handle a timed message being received from a federate by the RTI to relay to another federate.
  *
@@ -216,6 +267,17 @@ void handle_port_absent_message(federate_info_t* sending_federate, unsigned char
  */
 void handle_timed_message(federate_info_t* sending_federate, unsigned char* buffer);
 
+/**
+ * Handle a MSG_TYPE_MULTICAST_TAGGED_MESSAGE from a federate, whose payload the RTI reads once
+ * and forwards to each destination port as a MSG_TYPE_TAGGED_MESSAGE.
+ *
+ * This function assumes the caller does not hold the mutex.
+ *
+ * @param sending_federate The sending federate.
+ * @param buffer The buffer to read into (the first byte is already there).
+ */
+void handle_multicast_tagged_message(federate_info_t* sending_federate, unsigned char* buffer);
+
 /**
  * Handle a latest tag complete (LTC) message. @see
  * MSG_TYPE_LATEST_TAG_COMPLETE in rti.h.
@@ -323,13 +385,14 @@ void handle_physical_clock_sync_message(federate_info_t* my_fed, socket_type_t s
 /**
  * A (quasi-)periodic thread that performs clock synchronization with each
  * federate. It starts by waiting a time given by _RTI.clock_sync_period_ns
- * and then iterates over the federates, performing a complete clock synchronization
- * interaction with each federate before proceeding to the next federate.
- * The interaction starts with this RTI sending a snapshot of its physical clock
- * to the federate (message T1). It then waits for a reply and then sends another
- * snapshot of its physical clock (message T4).  It then follows that T4 message
- * with a coded probe message that the federate can use to discard the session if
- * the network is congested.
+ * and then performs rounds of clock synchronization with all federates at once.
+ * A round starts with this RTI sending a snapshot of its physical clock
+ * to every federate (message T1). As the replies (message T3) arrive on the UDP
+ * socket, in any order, the RTI answers each with another snapshot of its physical
+ * clock (message T4), followed by a coded probe message that the federate can use to
+ * discard the session if the network is congested. The round ends when all federates
+ * have replied or after _RTI.clock_sync_period_ns, so it takes about the longest round
+ * trip time rather than the sum of all of them.
  */
 void* clock_synchronization_thread(void* noargs);
 
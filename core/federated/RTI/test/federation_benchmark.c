@@ -0,0 +1,512 @@
+/**
+ * @file federation_benchmark.c
+ * @brief Benchmark of the latency and throughput of a federation connected through an RTI.
+ *
+ * This program launches the RTI as a separate process, or uses one that is already running
+ * on another host, and connects simulated federates to it over TCP. The federates speak the
+ * protocol of net_common.h, as generated federates do, but have no reactions, so what is
+ * measured is the cost of the RTI and of the network. The federates form a ring, in which
+ * each federate is connected to the next one with an after delay.
+ *
+ * Each federate goes through the following phases:
+ * - Startup: it connects to the RTI, sends its neighbor structure and proposes a start time.
+ *   The startup time is the time from the launch of the RTI until the last federate of this
+ *   process receives the start time.
+ * - Tags: it advances through `tags` tags. With centralized coordination, it sends a NET for
+ *   each tag, waits for the TAG that grants it and sends an LTC. With decentralized
+ *   coordination (`-d`), or if it is alone, it sends the NET and the LTC without waiting for
+ *   the grant.
+ * - Ping-pong: federate 0 sends `pings` tagged messages to federate 1, one at a time, each of
+ *   which federate 1 returns, which gives the round-trip times through the RTI.
+ * - Burst: every federate sends `messages` tagged messages to the next one as fast as it can.
+ *   The throughput is the number of messages received by the federates of this process per
+ *   second between the first one sent and the last one received.
+ *
+ * The federates then resign, and, if it launched the RTI, the program waits for it to exit
+ * and reports the CPU time that it used. The results are written as JSON.
+ *
+ * To spread a federation over several hosts, run the RTI on one host and this program on each
+ * host with `-h` giving the host of the RTI and `-f` and `-l` giving the federates that it
+ * simulates, so that together they simulate the `-n` federates of the federation.
+ *
+ * Usage: federation_benchmark [-r rti_path | -h rti_host] [-p port] [-n federates] [-f first]
+ *   [-l local_federates] [-t tags] [-P pings] [-m messages] [-s payload_bytes] [-d] [-j json_file]
+ *   [-- rti_options...]
+ */
+
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "benchmark.h"
+#include "low_level_platform.h"
+#include "net_common.h"
+#include "net_util.h"
+#include "util.h"
+
+/** The ports of the tagged messages of each phase. */
+#define PING_PORT 0
+#define PONG_PORT 1
+#define BURST_PORT 2
+
+/** The after delay of the connections of the ring. */
+#define RING_DELAY MSEC(1)
+
+/** The length of the header of a tagged message. */
+#define TAGGED_HEADER_LENGTH                                                                                           \
+  (1 + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(int64_t) + sizeof(uint32_t))
+
+/** The length of a message that carries a tag. */
+#define TAG_MESSAGE_LENGTH (1 + sizeof(int64_t) + sizeof(uint32_t))
+
+/** A simulated federate. */
+typedef struct {
+  uint16_t id;
+  int socket;
+  lf_thread_t thread;
+  lf_thread_t reader;
+  lf_mutex_t send_mutex; // Held while writing a message to the socket.
+  lf_mutex_t mutex;      // Protects the fields below, which the reader updates.
+  lf_cond_t changed;     // Broadcast when the reader updates the fields below.
+  int64_t granted;       // Time of the last TAG.
+  int pongs;
+  int pings;
+  int bursts;
+  instant_t last_burst_received;
+  // Measurements of the federate.
+  instant_t started;
+  interval_t tags_time;
+  instant_t burst_start;
+  interval_t* rtts;
+} federate_t;
+
+static const char* rti_path = RTI_PATH;
+static const char* rti_host = NULL;
+static uint16_t port = DEFAULT_PORT;
+static int number_of_federates = 2;
+static int first_federate = 0;
+static int local_federates = -1;
+static int tags = 10000;
+static int pings = 1000;
+static int messages = 10000;
+static int payload_size = 8;
+static bool decentralized = false;
+static const char* json_file = NULL;
+
+static federate_t* federates;
+static instant_t launched;
+static unsigned char* payload;
+
+/** @brief Write a message to the federate's socket, or exit if that fails. */
+static void send_to_rti(federate_t* fed, size_t length, unsigned char* buffer) {
+  LF_MUTEX_LOCK(&fed->send_mutex);
+  if (write_to_socket(fed->socket, length, buffer)) {
+    lf_print_error_and_exit("Federate %d failed to write to the RTI.", fed->id);
+  }
+  LF_MUTEX_UNLOCK(&fed->send_mutex);
+}
+
+/** @brief Send a message that carries a tag, such as a NET or an LTC. */
+static void send_tag(federate_t* fed, unsigned char message_type, tag_t tag) {
+  unsigned char buffer[TAG_MESSAGE_LENGTH];
+  buffer[0] = message_type;
+  encode_tag(&buffer[1], tag);
+  send_to_rti(fed, sizeof(buffer), buffer);
+}
+
+/** @brief Send a tagged message with the payload to the given port of the given federate. */
+static void send_tagged_message(federate_t* fed, uint16_t port_id, uint16_t destination, tag_t tag) {
+  unsigned char* buffer = (unsigned char*)malloc(TAGGED_HEADER_LENGTH + payload_size);
+  LF_ASSERT_NON_NULL(buffer);
+  buffer[0] = MSG_TYPE_TAGGED_MESSAGE;
+  encode_timed_header(&buffer[1], port_id, destination, (uint32_t)payload_size, tag);
+  memcpy(&buffer[TAGGED_HEADER_LENGTH], payload, payload_size);
+  send_to_rti(fed, TAGGED_HEADER_LENGTH + payload_size, buffer);
+  free(buffer);
+}
+
+/** @brief Read from the federate's socket, or exit if that fails. */
+static void receive_from_rti(federate_t* fed, size_t length, unsigned char* buffer) {
+  if (read_from_socket(fed->socket, length, buffer)) {
+    lf_print_error_and_exit("Federate %d failed to read from the RTI.", fed->id);
+  }
+}
+
+/** @brief Handle a tagged message, whose type has been read. */
+static void receive_tagged_message(federate_t* fed, unsigned char* buffer) {
+  receive_from_rti(fed, TAGGED_HEADER_LENGTH - 1, &buffer[1]);
+  uint16_t port_id;
+  uint16_t destination;
+  size_t length;
+  tag_t tag;
+  extract_timed_header(&buffer[1], &port_id, &destination, &length, &tag);
+  for (size_t received = 0; received < length;) {
+    size_t chunk = LF_MIN(length - received, (size_t)FED_COM_BUFFER_SIZE);
+    receive_from_rti(fed, chunk, buffer);
+    received += chunk;
+  }
+  if (port_id == PING_PORT) {
+    send_tagged_message(fed, PONG_PORT, 0, tag);
+  }
+  instant_t now = lf_time_physical();
+  LF_MUTEX_LOCK(&fed->mutex);
+  if (port_id == PING_PORT) {
+    fed->pings++;
+  } else if (port_id == PONG_PORT) {
+    fed->pongs++;
+  } else {
+    fed->bursts++;
+    fed->last_burst_received = now;
+  }
+  lf_cond_broadcast(&fed->changed);
+  LF_MUTEX_UNLOCK(&fed->mutex);
+}
+
+/** @brief The thread that reads the messages that the RTI sends to a federate until it closes the socket. */
+static void* reader(void* arg) {
+  federate_t* fed = (federate_t*)arg;
+  unsigned char* buffer = (unsigned char*)malloc(FED_COM_BUFFER_SIZE);
+  LF_ASSERT_NON_NULL(buffer);
+  while (read_from_socket(fed->socket, 1, buffer) == 0) {
+    switch (buffer[0]) {
+    case MSG_TYPE_TAG_ADVANCE_GRANT:
+      receive_from_rti(fed, TAG_MESSAGE_LENGTH - 1, &buffer[1]);
+      LF_MUTEX_LOCK(&fed->mutex);
+      fed->granted = extract_tag(&buffer[1]).time;
+      lf_cond_broadcast(&fed->changed);
+      LF_MUTEX_UNLOCK(&fed->mutex);
+      break;
+    case MSG_TYPE_PROVISIONAL_TAG_ADVANCE_GRANT:
+    case MSG_TYPE_STOP_REQUEST:
+    case MSG_TYPE_STOP_GRANTED:
+      receive_from_rti(fed, TAG_MESSAGE_LENGTH - 1, &buffer[1]);
+      break;
+    case MSG_TYPE_TAGGED_MESSAGE:
+      receive_tagged_message(fed, buffer);
+      break;
+    default:
+      lf_print_error_and_exit("Federate %d received unexpected message %u (see net_common.h).", fed->id, buffer[0]);
+    }
+  }
+  free(buffer);
+  return NULL;
+}
+
+/** @brief Connect to the RTI, retrying until it accepts connections or CONNECT_TIMEOUT elapses. */
+static int connect_to_rti(void) {
+  struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+  struct addrinfo* address;
+  char service[8];
+  snprintf(service, sizeof(service), "%u", port);
+  if (getaddrinfo(rti_host == NULL ? "localhost" : rti_host, service, &hints, &address) != 0) {
+    lf_print_error_and_exit("Could not find the address of %s.", rti_host);
+  }
+  instant_t deadline = lf_time_physical() + CONNECT_TIMEOUT;
+  int socket_id = -1;
+  while (socket_id < 0) {
+    socket_id = create_real_time_tcp_socket_errexit();
+    if (connect(socket_id, address->ai_addr, address->ai_addrlen) != 0) {
+      close(socket_id);
+      socket_id = -1;
+      if (lf_time_physical() > deadline) {
+        lf_print_error_and_exit("Could not connect to the RTI on port %u.", port);
+      }
+      lf_sleep(MSEC(10));
+    }
+  }
+  freeaddrinfo(address);
+  return socket_id;
+}
+
+/** @brief Connect a federate to the RTI and wait for the start time. */
+static void start(federate_t* fed) {
+  fed->socket = connect_to_rti();
+  const char* federation_id = "Unidentified Federation";
+  size_t id_length = strlen(federation_id);
+  unsigned char buffer[MSG_TYPE_NEIGHBOR_STRUCTURE_HEADER_SIZE + sizeof(uint16_t) + sizeof(int64_t) + sizeof(uint16_t)];
+  buffer[0] = MSG_TYPE_FED_IDS;
+  encode_uint16(fed->id, &buffer[1]);
+  buffer[1 + sizeof(uint16_t)] = (unsigned char)id_length;
+  send_to_rti(fed, 1 + sizeof(uint16_t) + 1, buffer);
+  send_to_rti(fed, id_length, (unsigned char*)federation_id);
+  receive_from_rti(fed, 1, buffer);
+  if (buffer[0] != MSG_TYPE_ACK) {
+    lf_print_error_and_exit("The RTI rejected federate %d.", fed->id);
+  }
+
+  // The federate is downstream of the previous federate of the ring and upstream of the next one.
+  int32_t neighbors = (number_of_federates > 1) ? 1 : 0;
+  buffer[0] = MSG_TYPE_NEIGHBOR_STRUCTURE;
+  encode_int32(neighbors, &buffer[1]);
+  encode_int32(neighbors, &buffer[1 + sizeof(int32_t)]);
+  size_t length = MSG_TYPE_NEIGHBOR_STRUCTURE_HEADER_SIZE;
+  if (neighbors > 0) {
+    encode_uint16((fed->id + number_of_federates - 1) % number_of_federates, &buffer[length]);
+    encode_int64(RING_DELAY, &buffer[length + sizeof(uint16_t)]);
+    encode_uint16((fed->id + 1) % number_of_federates, &buffer[length + sizeof(uint16_t) + sizeof(int64_t)]);
+    length += sizeof(uint16_t) + sizeof(int64_t) + sizeof(uint16_t);
+  }
+  send_to_rti(fed, length, buffer);
+
+  // No clock synchronization.
+  buffer[0] = MSG_TYPE_UDP_PORT;
+  encode_uint16(UINT16_MAX, &buffer[1]);
+  send_to_rti(fed, 1 + sizeof(uint16_t), buffer);
+
+  buffer[0] = MSG_TYPE_TIMESTAMP;
+  encode_int64(lf_time_physical(), &buffer[1]);
+  send_to_rti(fed, MSG_TYPE_TIMESTAMP_LENGTH, buffer);
+  receive_from_rti(fed, MSG_TYPE_TIMESTAMP_LENGTH, buffer);
+  if (buffer[0] != MSG_TYPE_TIMESTAMP) {
+    lf_print_error_and_exit("Federate %d expected the start time. Got %u.", fed->id, buffer[0]);
+  }
+  fed->started = lf_time_physical();
+}
+
+/** @brief Advance a federate through the tags. */
+static void advance_tags(federate_t* fed) {
+  instant_t begin = lf_time_physical();
+  for (int k = 1; k <= tags; k++) {
+    tag_t tag = {.time = MSEC(k), .microstep = 0};
+    send_tag(fed, MSG_TYPE_NEXT_EVENT_TAG, tag);
+    // As in federate.c, a federate without upstream federates does not wait for grants.
+    if (!decentralized && number_of_federates > 1) {
+      LF_MUTEX_LOCK(&fed->mutex);
+      while (fed->granted < tag.time) {
+        lf_cond_wait(&fed->changed);
+      }
+      LF_MUTEX_UNLOCK(&fed->mutex);
+    }
+    send_tag(fed, MSG_TYPE_LATEST_TAG_COMPLETE, tag);
+  }
+  fed->tags_time = lf_time_physical() - begin;
+}
+
+/** @brief Exchange the pings and pongs, if the federate is one of the first two. */
+static void ping_pong(federate_t* fed) {
+  // The messages are later than the tags of the previous phase, which have completed.
+  tag_t tag = {.time = MSEC(tags + 1), .microstep = 0};
+  if (fed->id == 0) {
+    for (int i = 0; i < pings; i++) {
+      instant_t sent = lf_time_physical();
+      send_tagged_message(fed, PING_PORT, 1, tag);
+      LF_MUTEX_LOCK(&fed->mutex);
+      while (fed->pongs <= i) {
+        lf_cond_wait(&fed->changed);
+      }
+      LF_MUTEX_UNLOCK(&fed->mutex);
+      fed->rtts[i] = lf_time_physical() - sent;
+      tag.microstep++;
+    }
+  } else if (fed->id == 1) {
+    LF_MUTEX_LOCK(&fed->mutex);
+    while (fed->pings < pings) {
+      lf_cond_wait(&fed->changed);
+    }
+    LF_MUTEX_UNLOCK(&fed->mutex);
+  }
+}
+
+/** @brief Send the burst of messages to the next federate and wait for the burst of the previous one. */
+static void burst(federate_t* fed) {
+  tag_t tag = {.time = MSEC(tags + 2), .microstep = 0};
+  uint16_t next = (fed->id + 1) % number_of_federates;
+  fed->burst_start = lf_time_physical();
+  for (int i = 0; i < messages; i++) {
+    send_tagged_message(fed, BURST_PORT, next, tag);
+    tag.microstep++;
+  }
+  LF_MUTEX_LOCK(&fed->mutex);
+  while (fed->bursts < messages) {
+    lf_cond_wait(&fed->changed);
+  }
+  LF_MUTEX_UNLOCK(&fed->mutex);
+}
+
+/** @brief The simulated federate. */
+static void* federate(void* arg) {
+  federate_t* fed = (federate_t*)arg;
+  start(fed);
+  lf_thread_create(&fed->reader, reader, fed);
+  advance_tags(fed);
+  if (number_of_federates > 1) {
+    ping_pong(fed);
+    burst(fed);
+  }
+  unsigned char resign = MSG_TYPE_RESIGN;
+  send_to_rti(fed, 1, &resign);
+  shutdown(fed->socket, SHUT_WR);
+  // The reader returns when the RTI closes the socket.
+  lf_thread_join(fed->reader, NULL);
+  close(fed->socket);
+  return NULL;
+}
+
+/** @brief Launch the RTI with the given extra options and return its process ID. */
+static pid_t launch_rti(int argc, const char* argv[]) {
+  char federates_option[8];
+  char port_option[8];
+  snprintf(federates_option, sizeof(federates_option), "%d", number_of_federates);
+  snprintf(port_option, sizeof(port_option), "%u", port);
+  const char** rti_argv = (const char**)calloc(argc + 8, sizeof(char*));
+  LF_ASSERT_NON_NULL(rti_argv);
+  int n = 0;
+  rti_argv[n++] = rti_path;
+  rti_argv[n++] = "-n";
+  rti_argv[n++] = federates_option;
+  rti_argv[n++] = "-p";
+  rti_argv[n++] = port_option;
+  rti_argv[n++] = "-c";
+  rti_argv[n++] = "off";
+  for (int i = 0; i < argc; i++) {
+    rti_argv[n++] = argv[i];
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    // The RTI reports every federate that joins and resigns.
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    execv(rti_path, (char* const*)rti_argv);
+    lf_print_error_and_exit("Could not run the RTI at %s.", rti_path);
+  } else if (pid < 0) {
+    lf_print_error_and_exit("Could not fork the RTI.");
+  }
+  free(rti_argv);
+  return pid;
+}
+
+/** @brief Write the measurements as JSON. */
+static void report(interval_t rti_cpu, interval_t rti_wall) {
+  instant_t started = launched;
+  interval_t tags_time = 0;
+  instant_t burst_start = FOREVER;
+  instant_t burst_end = launched;
+  for (int i = 0; i < local_federates; i++) {
+    federate_t* fed = &federates[i];
+    started = LF_MAX(started, fed->started);
+    tags_time = LF_MAX(tags_time, fed->tags_time);
+    burst_start = LF_MIN(burst_start, fed->burst_start);
+    burst_end = LF_MAX(burst_end, fed->last_burst_received);
+  }
+  FILE* output = benchmark_open_output(json_file);
+  fprintf(output, "{\"coordination\": \"%s\", \"federates\": %d, \"local_federates\": %d, ",
+          decentralized ? "decentralized" : "centralized", number_of_federates, local_federates);
+  fprintf(output, "\"tags\": %d, \"pings\": %d, \"messages\": %d, \"payload_bytes\": %d, ", tags, pings, messages,
+          payload_size);
+  fprintf(output, "\"startup_ns\": %lld, \"tags_per_second\": %.1f", (long long)(started - launched),
+          tags_time > 0 ? tags * 1e9 / (double)tags_time : 0.0);
+  if (number_of_federates > 1) {
+    federate_t* pinger = (first_federate == 0) ? &federates[0] : NULL;
+    if (pinger != NULL && pings > 0) {
+      qsort(pinger->rtts, pings, sizeof(interval_t), benchmark_compare_intervals);
+      fprintf(output, ", \"rtt_p50_ns\": %lld, \"rtt_p99_ns\": %lld, \"rtt_max_ns\": %lld",
+              (long long)pinger->rtts[pings / 2], (long long)pinger->rtts[(pings * 99) / 100],
+              (long long)pinger->rtts[pings - 1]);
+    }
+    double seconds = (double)(burst_end - burst_start) / 1e9;
+    double received = (double)local_federates * messages;
+    fprintf(output, ", \"messages_per_second\": %.1f, \"megabytes_per_second\": %.2f",
+            seconds > 0 ? received / seconds : 0.0, seconds > 0 ? received * payload_size / seconds / 1e6 : 0.0);
+  }
+  if (rti_cpu >= 0) {
+    fprintf(output, ", \"rti_cpu_ns\": %lld, \"rti_cpu_utilization\": %.3f", (long long)rti_cpu,
+            rti_wall > 0 ? (double)rti_cpu / (double)rti_wall : 0.0);
+  }
+  fprintf(output, "}\n");
+  benchmark_close_output(output);
+}
+
+int main(int argc, const char* argv[]) {
+  int rti_options = argc;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-r") == 0) {
+      rti_path = benchmark_option_value(argc, argv, i++);
+    } else if (strcmp(argv[i], "-h") == 0) {
+      rti_host = benchmark_option_value(argc, argv, i++);
+    } else if (strcmp(argv[i], "-p") == 0) {
+      port = (uint16_t)atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-n") == 0) {
+      number_of_federates = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-f") == 0) {
+      first_federate = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-l") == 0) {
+      local_federates = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-t") == 0) {
+      tags = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-P") == 0) {
+      pings = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-m") == 0) {
+      messages = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-s") == 0) {
+      payload_size = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-d") == 0) {
+      decentralized = true;
+    } else if (strcmp(argv[i], "-j") == 0) {
+      json_file = benchmark_option_value(argc, argv, i++);
+    } else if (strcmp(argv[i], "--") == 0) {
+      rti_options = i + 1;
+      break;
+    } else {
+      lf_print_error_and_exit("Usage: federation_benchmark [-r rti_path | -h rti_host] [-p port] [-n federates] "
+                              "[-f first] [-l local_federates] [-t tags] [-P pings] [-m messages] "
+                              "[-s payload_bytes] [-d] [-j json_file] [-- rti_options...]");
+    }
+  }
+  if (local_federates < 0) {
+    local_federates = number_of_federates - first_federate;
+  }
+  if (number_of_federates < 1 || first_federate < 0 || local_federates < 1 ||
+      first_federate + local_federates > number_of_federates || tags < 1 || pings < 0 || messages < 0 ||
+      payload_size < 0) {
+    lf_print_error_and_exit("The local federates must be among the federates, and the tags must be positive.");
+  }
+  payload = (unsigned char*)calloc(payload_size + 1, 1);
+  federates = (federate_t*)calloc(local_federates, sizeof(federate_t));
+  LF_ASSERT_NON_NULL(payload);
+  LF_ASSERT_NON_NULL(federates);
+
+  launched = lf_time_physical();
+  pid_t rti = (rti_host == NULL) ? launch_rti(argc - rti_options, &argv[rti_options]) : -1;
+  for (int i = 0; i < local_federates; i++) {
+    federate_t* fed = &federates[i];
+    fed->id = (uint16_t)(first_federate + i);
+    fed->granted = NEVER;
+    fed->rtts = (interval_t*)calloc(pings + 1, sizeof(interval_t));
+    LF_ASSERT_NON_NULL(fed->rtts);
+    LF_ASSERTN(lf_mutex_init(&fed->send_mutex), "Mutex init failed.");
+    LF_ASSERTN(lf_mutex_init(&fed->mutex), "Mutex init failed.");
+    LF_ASSERTN(lf_cond_init(&fed->changed, &fed->mutex), "Condition variable init failed.");
+    lf_thread_create(&fed->thread, federate, fed);
+  }
+  for (int i = 0; i < local_federates; i++) {
+    lf_thread_join(federates[i].thread, NULL);
+  }
+
+  interval_t rti_cpu = -1;
+  interval_t rti_wall = 0;
+  if (rti > 0) {
+    int status;
+    if (waitpid(rti, &status, 0) != rti || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      lf_print_error_and_exit("The RTI did not exit normally.");
+    }
+    rti_wall = lf_time_physical() - launched;
+    struct rusage usage;
+    getrusage(RUSAGE_CHILDREN, &usage);
+    rti_cpu = SEC(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+              USEC(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+  }
+  report(rti_cpu, rti_wall);
+
+  for (int i = 0; i < local_federates; i++) {
+    free(federates[i].rtts);
+  }
+  free(federates);
+  free(payload);
+  return 0;
+}
@@ -26,6 +26,9 @@ void delete_scheduling_node(scheduling_node_t* node) {
   if (node->downstream != NULL) {
     free(node->downstream);
   }
+  if (node->eimt_dependents != NULL) {
+    free(node->eimt_dependents);
+  }
   invalidate_min_delays_upstream(node);
 }
 
@@ -245,6 +248,143 @@ static void multiple_nodes() {
   assert(lf_tag_compare(test_rti.scheduling_nodes[3]->min_delays[0].min_delay, (tag_t){NSEC(3), 0}) == 0);
 }
 
+/**
+ * Compute the EIMT of a node without its cache.
+ * @param node The node.
+ */
+static tag_t uncached_eimt(scheduling_node_t* node) {
+  update_min_delays_upstream(node);
+  tag_t result = FOREVER_TAG;
+  for (size_t i = 0; i < node->num_min_delays; i++) {
+    scheduling_node_t* upstream = test_rti.scheduling_nodes[node->min_delays[i].id];
+    tag_t candidate = lf_tag_add(upstream->next_event, node->min_delays[i].min_delay);
+    if (lf_tag_compare(candidate, result) < 0) {
+      result = candidate;
+    }
+  }
+  return result;
+}
+
+static void cached_eimt() {
+  // A random graph with mostly forward connections and some delayed backward ones, which make cycles.
+  const uint16_t n = 40;
+  const interval_t delays[] = {NEVER, 0, NSEC(1), NSEC(3)};
+  set_common_RTI(n);
+  srand(25);
+  for (int id = 0; id < n; id++) {
+    int upstream[3];
+    interval_t upstream_delay[3];
+    int num_upstream = id == 0 ? 0 : rand() % 4;
+    for (int i = 0; i < num_upstream; i++) {
+      upstream[i] = rand() % id;
+      upstream_delay[i] = delays[rand() % 4];
+      if (rand() % 10 == 0) {
+        upstream[i] = id + rand() % (n - id);
+        upstream_delay[i] = NSEC(2);
+      }
+    }
+    set_scheduling_node(id, num_upstream, 0, upstream, upstream_delay, NULL);
+  }
+  set_state_of_nodes(GRANTED);
+  for (int id = 0; id < n; id++) {
+    set_next_event_tag(test_rti.scheduling_nodes[id], (tag_t){.time = NSEC(rand() % 20), .microstep = 0});
+  }
+
+  // After every NET, the cached EIMTs of all nodes must equal the ones computed from scratch.
+  for (int round = 0; round < 2000; round++) {
+    scheduling_node_t* node = test_rti.scheduling_nodes[rand() % n];
+    tag_t next_event = {.time = NSEC(rand() % 20), .microstep = (microstep_t)(rand() % 3)};
+    if (rand() % 50 == 0) {
+      next_event = FOREVER_TAG;
+    }
+    set_next_event_tag(node, next_event);
+    if (round == 1000) {
+      // The cache must also be discarded when the connections change.
+      invalidate_min_delays_upstream(test_rti.scheduling_nodes[n - 1]);
+    }
+    for (int id = 0; id < n; id++) {
+      scheduling_node_t* e = test_rti.scheduling_nodes[id];
+      assert(lf_tag_compare(earliest_future_incoming_message_tag(e), uncached_eimt(e)) == 0);
+    }
+  }
+}
+
+static void cluster_summary() {
+  set_common_RTI(4);
+
+  // Construct the structure illustrated below, where node[3] stands for the rest of the federation.
+  // node[3] --> node[0] --> node[1] --(10 ns)--> node[3]
+  //                         node[2] --(5 ns)---> node[3]
+  set_scheduling_node(0, 1, 1, (int[]){3}, (interval_t[]){NEVER}, (int[]){1});
+  set_scheduling_node(1, 1, 1, (int[]){0}, (interval_t[]){NEVER}, (int[]){3});
+  set_scheduling_node(2, 0, 1, NULL, NULL, (int[]){3});
+  set_scheduling_node(3, 2, 1, (int[]){1, 2}, (interval_t[]){NSEC(10), NSEC(5)}, (int[]){0});
+  set_state_of_nodes(GRANTED);
+  // No grants are sent in this test.
+  for (int id = 0; id < 4; id++) {
+    test_rti.scheduling_nodes[id]->last_granted = FOREVER_TAG;
+  }
+  scheduling_node_t* boundary = test_rti.scheduling_nodes[3];
+
+  // Messages into the cluster may also leave it, so they count as well once they are possible.
+  set_next_event_tag(boundary, (tag_t){.time = NSEC(1000), .microstep = 0});
+  // The earliest message out of the cluster comes from node[0] through node[1].
+  set_next_event_tag(test_rti.scheduling_nodes[0], (tag_t){.time = NSEC(50), .microstep = 0});
+  set_next_event_tag(test_rti.scheduling_nodes[1], (tag_t){.time = NSEC(100), .microstep = 0});
+  set_next_event_tag(test_rti.scheduling_nodes[2], (tag_t){.time = NSEC(200), .microstep = 0});
+  assert(lf_tag_compare(cluster_next_event_tag(boundary), (tag_t){.time = NSEC(60), .microstep = 0}) == 0);
+  set_next_event_tag(test_rti.scheduling_nodes[0], (tag_t){.time = NSEC(300), .microstep = 0});
+  assert(lf_tag_compare(cluster_next_event_tag(boundary), (tag_t){.time = NSEC(110), .microstep = 0}) == 0);
+
+  // The LTCs of the nodes with connections leaving the cluster are adjusted by the delays.
+  test_rti.scheduling_nodes[1]->completed = (tag_t){.time = NSEC(90), .microstep = 0};
+  test_rti.scheduling_nodes[2]->completed = (tag_t){.time = NSEC(90), .microstep = 0};
+  assert(lf_tag_compare(cluster_completed_tag(boundary), lf_delay_strict(test_rti.scheduling_nodes[2]->completed,
+                                                                         NSEC(5))) == 0);
+
+  // A TAG from the parent RTI excludes messages into the cluster up to the granted tag,
+  // and a PTAG only earlier ones.
+  tag_t granted = {.time = NSEC(150), .microstep = 0};
+  cluster_granted_locked(boundary, (tag_advance_grant_t){.tag = granted, .is_provisional = true});
+  assert(lf_tag_compare(boundary->next_event, granted) == 0);
+  cluster_granted_locked(boundary, (tag_advance_grant_t){.tag = granted, .is_provisional = false});
+  assert(lf_tag_compare(boundary->next_event, granted) > 0);
+  assert(lf_tag_compare(boundary->completed, granted) == 0);
+}
+
+static void time_triggered() {
+  set_common_RTI(3);
+
+  // Construct the structure illustrated below, where node[0] has a timer with a period of 10 ms
+  // and node[1] one with a period of 4 ms and an offset of 1 ms.
+  // node[0] --(3 ms)--> node[1] --> node[2]
+  set_scheduling_node(0, 0, 1, NULL, NULL, (int[]){1});
+  set_scheduling_node(1, 1, 1, (int[]){0}, (interval_t[]){MSEC(3)}, (int[]){2});
+  set_scheduling_node(2, 1, 0, (int[]){1}, (interval_t[]){NEVER}, NULL);
+  interval_t hyperperiods[3] = {MSEC(10), MSEC(4), 0};
+  time_slots_t timers[3] = {{.offsets = (interval_t[]){0}, .size = 1},
+                            {.offsets = (interval_t[]){MSEC(1)}, .size = 1},
+                            {.offsets = NULL, .size = 0}};
+  time_slots_t inbound[3];
+  assert(time_triggered_schedule(hyperperiods, timers, inbound) == MSEC(20));
+  assert(inbound[0].size == 0);
+  interval_t inbound_1[] = {MSEC(3), MSEC(13)};
+  assert(inbound[1].size == 2 && memcmp(inbound[1].offsets, inbound_1, sizeof(inbound_1)) == 0);
+  // Messages from node[1] are sent at the start, when its timer fires and when it receives messages.
+  interval_t inbound_2[] = {0, MSEC(1), MSEC(3), MSEC(5), MSEC(9), MSEC(13), MSEC(17)};
+  assert(inbound[2].size == 7 && memcmp(inbound[2].offsets, inbound_2, sizeof(inbound_2)) == 0);
+  for (int id = 0; id < 3; id++) {
+    free(inbound[id].offsets);
+  }
+
+  // A zero-delay cycle cannot be time triggered.
+  set_common_RTI(2);
+  set_scheduling_node(0, 1, 1, (int[]){1}, (interval_t[]){NEVER}, (int[]){1});
+  set_scheduling_node(1, 1, 1, (int[]){0}, (interval_t[]){NEVER}, (int[]){0});
+  set_state_of_nodes(GRANTED);
+  assert(time_triggered_schedule(hyperperiods, timers, inbound) == 0);
+}
+
 int main() {
   initialize_rti_common(&test_rti);
 
@@ -255,4 +395,13 @@ int main() {
   two_nodes_zero_delay();
   two_nodes_normal_delay();
   multiple_nodes();
+
+  // Tests for the cache of earliest_future_incoming_message_tag()
+  cached_eimt();
+
+  // Tests for the summaries of a cluster of nodes for a parent RTI
+  cluster_summary();
+
+  // Tests for the schedule of a time-triggered federation
+  time_triggered();
 }
@@ -0,0 +1,162 @@
+/**
+ * @file rti_eimt_benchmark.c
+ * @brief Benchmark of the earliest future incoming message tag (EIMT) computation of the RTI.
+ *
+ * This program builds synthetic topologies of scheduling nodes and feeds them a stream of
+ * increasing NETs, as federates that advance time would. After each NET, the EIMT of every node
+ * downstream of the sender is needed, which is what the RTI computes when deciding on grants.
+ * The cached EIMTs are compared against the computation from scratch over min_delays,
+ * which the RTI used to do on every NET and LTC.
+ *
+ * Usage: rti_eimt_benchmark [number_of_nodes [number_of_nets]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rti_common.h"
+#include "tag.h"
+
+static rti_common_t rti;
+
+/** Topologies to benchmark. */
+typedef enum { CHAIN, FAN_IN, LAYERED, RANDOM } topology_t;
+static const char* topology_names[] = {"chain", "fan-in", "layered", "random"};
+
+/** @brief Add a connection with the given delay from node `from` to node `to`. */
+static void connect_nodes(int from, int to, interval_t delay) {
+  scheduling_node_t* up = rti.scheduling_nodes[from];
+  scheduling_node_t* down = rti.scheduling_nodes[to];
+  down->upstream = (uint16_t*)realloc(down->upstream, (down->num_upstream + 1) * sizeof(uint16_t));
+  down->upstream_delay = (interval_t*)realloc(down->upstream_delay, (down->num_upstream + 1) * sizeof(interval_t));
+  down->upstream[down->num_upstream] = (uint16_t)from;
+  down->upstream_delay[down->num_upstream++] = delay;
+  up->downstream = (uint16_t*)realloc(up->downstream, (up->num_downstream + 1) * sizeof(uint16_t));
+  up->downstream[up->num_downstream++] = (uint16_t)to;
+}
+
+static void build(topology_t topology, int n) {
+  rti.number_of_scheduling_nodes = n;
+  rti.scheduling_nodes = (scheduling_node_t**)calloc(n, sizeof(scheduling_node_t*));
+  for (int i = 0; i < n; i++) {
+    rti.scheduling_nodes[i] = (scheduling_node_t*)calloc(1, sizeof(scheduling_node_t));
+    initialize_scheduling_node(rti.scheduling_nodes[i], (uint16_t)i);
+    rti.scheduling_nodes[i]->state = GRANTED;
+  }
+  srand(0);
+  for (int i = 1; i < n; i++) {
+    switch (topology) {
+    case CHAIN:
+      connect_nodes(i - 1, i, MSEC(1));
+      break;
+    case FAN_IN:
+      // Every node feeds the last one, which has n - 1 upstream nodes.
+      if (i < n - 1) {
+        connect_nodes(i, n - 1, MSEC(1 + rand() % 5));
+      } else {
+        connect_nodes(0, i, MSEC(1));
+      }
+      break;
+    case LAYERED:
+      // Layers of ten nodes, each connected to all nodes of the previous layer.
+      for (int j = (i / 10 - 1) * 10; j >= 0 && j < (i / 10) * 10; j++) {
+        connect_nodes(j, i, MSEC(1 + rand() % 5));
+      }
+      break;
+    case RANDOM:
+      for (int k = 0; k < 3; k++) {
+        connect_nodes(rand() % i, i, MSEC(rand() % 5));
+      }
+      break;
+    }
+  }
+}
+
+static tag_t uncached_eimt(scheduling_node_t* e) {
+  tag_t result = FOREVER_TAG;
+  for (size_t i = 0; i < e->num_min_delays; i++) {
+    tag_t candidate = lf_tag_add(rti.scheduling_nodes[e->min_delays[i].id]->next_event, e->min_delays[i].min_delay);
+    if (lf_tag_compare(candidate, result) < 0) {
+      result = candidate;
+    }
+  }
+  return result;
+}
+
+/** @brief Put the nodes downstream of `e` into `nodes` and return how many there are. */
+static int downstream_of(scheduling_node_t* e, bool visited[], int nodes[], int count) {
+  for (int i = 0; i < e->num_downstream; i++) {
+    if (!visited[e->downstream[i]]) {
+      visited[e->downstream[i]] = true;
+      nodes[count++] = e->downstream[i];
+      count = downstream_of(rti.scheduling_nodes[e->downstream[i]], visited, nodes, count);
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Send `number_of_nets` NETs and compute the EIMTs downstream of each.
+ * @param checksum Where to put a sum of the EIMTs, which must not depend on `cached`.
+ * @return The elapsed physical time.
+ */
+static interval_t run(int number_of_nets, bool cached, uint64_t* checksum) {
+  int n = rti.number_of_scheduling_nodes;
+  int** downstream = (int**)calloc(n, sizeof(int*));
+  int* number_downstream = (int*)calloc(n, sizeof(int));
+  for (int i = 0; i < n; i++) {
+    bool visited[n];
+    memset(visited, 0, sizeof(visited));
+    downstream[i] = (int*)calloc(n, sizeof(int));
+    number_downstream[i] = downstream_of(rti.scheduling_nodes[i], visited, downstream[i], 0);
+    set_next_event_tag(rti.scheduling_nodes[i], ZERO_TAG);
+    update_min_delays_upstream(rti.scheduling_nodes[i]);
+  }
+  srand(1);
+  *checksum = 0;
+  instant_t start = lf_time_physical();
+  for (int k = 0; k < number_of_nets; k++) {
+    scheduling_node_t* e = rti.scheduling_nodes[rand() % n];
+    set_next_event_tag(e, lf_delay_tag(e->next_event, MSEC(rand() % 10)));
+    for (int i = 0; i < number_downstream[e->id]; i++) {
+      scheduling_node_t* d = rti.scheduling_nodes[downstream[e->id][i]];
+      tag_t eimt = cached ? earliest_future_incoming_message_tag(d) : uncached_eimt(d);
+      *checksum += (uint64_t)eimt.time;
+    }
+  }
+  interval_t elapsed = lf_time_physical() - start;
+  for (int i = 0; i < n; i++) {
+    free(downstream[i]);
+  }
+  free(downstream);
+  free(number_downstream);
+  return elapsed;
+}
+
+int main(int argc, char* argv[]) {
+  int number_of_nodes = (argc > 1) ? atoi(argv[1]) : 500;
+  int number_of_nets = (argc > 2) ? atoi(argv[2]) : 2000;
+  if (number_of_nodes < 2) {
+    fprintf(stderr, "At least two nodes are needed.\n");
+    return 1;
+  }
+  initialize_rti_common(&rti);
+  for (topology_t topology = CHAIN; topology <= RANDOM; topology++) {
+    interval_t elapsed[2];
+    uint64_t checksum[2];
+    for (int cached = 0; cached < 2; cached++) {
+      build(topology, number_of_nodes);
+      elapsed[cached] = run(number_of_nets, cached, &checksum[cached]);
+      free_scheduling_nodes(rti.scheduling_nodes, (uint16_t)number_of_nodes);
+    }
+    if (checksum[0] != checksum[1]) {
+      fprintf(stderr, "%s: the cached EIMTs differ from the uncached ones.\n", topology_names[topology]);
+      return 1;
+    }
+    printf("%s: %d nodes, %d NETs, %.1f us per NET uncached, %.1f us per NET cached.\n", topology_names[topology],
+           number_of_nodes, number_of_nets, (double)elapsed[0] / number_of_nets / 1000.0,
+           (double)elapsed[1] / number_of_nets / 1000.0);
+  }
+  return 0;
+}
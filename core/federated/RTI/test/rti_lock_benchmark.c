@@ -0,0 +1,134 @@
+/**
+ * @file rti_lock_benchmark.c
+ * @brief Benchmark of the throughput of grants of the RTI with many federates.
+ *
+ * This program runs the threads that the RTI uses to handle federates, each connected to a
+ * simulated federate by a socket pair. The federates form independent pairs, each of which is
+ * a cycle of two federates connected to each other with after delays. Every federate
+ * repeatedly sends a NET, waits for the TAG that grants it, and sends an LTC, as a federate
+ * that advances time would. The grants of all pairs are decided under the mutex of the RTI,
+ * so this measures how much the handling of one pair slows down the others.
+ *
+ * Usage: rti_lock_benchmark [number_of_federates [number_of_tags]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "rti_remote.h"
+#include "net_util.h"
+
+static rti_remote_t rti;
+
+/** The number of tags that each federate advances through. */
+static int number_of_tags;
+
+/** The ends of the socket pairs of the simulated federates. */
+static int* federate_sockets;
+
+/** @brief Add a connection with the given delay from federate `from` to federate `to`. */
+static void connect_federates(int from, int to, interval_t delay) {
+  scheduling_node_t* up = rti.base.scheduling_nodes[from];
+  scheduling_node_t* down = rti.base.scheduling_nodes[to];
+  down->upstream = (uint16_t*)realloc(down->upstream, (down->num_upstream + 1) * sizeof(uint16_t));
+  down->upstream_delay = (interval_t*)realloc(down->upstream_delay, (down->num_upstream + 1) * sizeof(interval_t));
+  down->upstream[down->num_upstream] = (uint16_t)from;
+  down->upstream_delay[down->num_upstream++] = delay;
+  up->downstream = (uint16_t*)realloc(up->downstream, (up->num_downstream + 1) * sizeof(uint16_t));
+  up->downstream[up->num_downstream++] = (uint16_t)to;
+}
+
+/** @brief Send a NET or an LTC with the given tag. */
+static void send_tag(int socket, unsigned char message_type, tag_t tag) {
+  unsigned char buffer[1 + sizeof(int64_t) + sizeof(uint32_t)];
+  buffer[0] = message_type;
+  encode_int64(tag.time, &buffer[1]);
+  encode_uint32(tag.microstep, &buffer[1 + sizeof(int64_t)]);
+  if (write_to_socket(socket, sizeof(buffer), buffer)) {
+    lf_print_error_and_exit("Failed to send a tag to the RTI.");
+  }
+}
+
+/** @brief The simulated federate, whose argument is its ID. */
+static void* federate(void* id) {
+  int socket = federate_sockets[(intptr_t)id];
+  unsigned char buffer[1 + sizeof(int64_t) + sizeof(uint32_t)];
+  for (int k = 1; k <= number_of_tags; k++) {
+    tag_t tag = {.time = MSEC(k), .microstep = 0};
+    send_tag(socket, MSG_TYPE_NEXT_EVENT_TAG, tag);
+    // Grants are all of the same length. Provisional grants are ignored.
+    do {
+      if (read_from_socket(socket, sizeof(buffer), buffer)) {
+        lf_print_error_and_exit("Failed to receive a grant from the RTI.");
+      }
+    } while (buffer[0] != MSG_TYPE_TAG_ADVANCE_GRANT || extract_int64(&buffer[1]) < tag.time);
+    send_tag(socket, MSG_TYPE_LATEST_TAG_COMPLETE, tag);
+  }
+  buffer[0] = MSG_TYPE_RESIGN;
+  write_to_socket(socket, 1, buffer);
+  // Wait for the RTI to close the socket.
+  while (read(socket, buffer, sizeof(buffer)) > 0)
+    ;
+  close(socket);
+  return NULL;
+}
+
+int main(int argc, char* argv[]) {
+  int number_of_federates = (argc > 1) ? atoi(argv[1]) : 100;
+  number_of_tags = (argc > 2) ? atoi(argv[2]) : 200;
+  if (number_of_federates < 2 || number_of_federates % 2 != 0) {
+    fprintf(stderr, "The number of federates must be even and at least two.\n");
+    return 1;
+  }
+  initialize_RTI(&rti);
+  rti.base.number_of_scheduling_nodes = (uint16_t)number_of_federates;
+  rti.base.scheduling_nodes = (scheduling_node_t**)calloc(number_of_federates, sizeof(scheduling_node_t*));
+  federate_sockets = (int*)calloc(number_of_federates, sizeof(int));
+  for (int i = 0; i < number_of_federates; i++) {
+    federate_info_t* fed = (federate_info_t*)calloc(1, sizeof(federate_info_t));
+    initialize_federate(fed, (uint16_t)i);
+    fed->enclave.state = GRANTED;
+    rti.base.scheduling_nodes[i] = &fed->enclave;
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+      lf_print_error_system_failure("Failed to create a socket pair.");
+    }
+    fed->socket = sockets[0];
+    federate_sockets[i] = sockets[1];
+  }
+  for (int i = 1; i < number_of_federates; i += 2) {
+    connect_federates(i - 1, i, MSEC(1));
+    connect_federates(i, i - 1, MSEC(1));
+  }
+  for (int i = 0; i < number_of_federates; i++) {
+    update_min_delays_upstream(rti.base.scheduling_nodes[i]);
+  }
+
+  lf_thread_t* federates = (lf_thread_t*)calloc(number_of_federates, sizeof(lf_thread_t));
+  instant_t start = lf_time_physical();
+  for (int i = 0; i < number_of_federates; i++) {
+    federate_info_t* fed = (federate_info_t*)rti.base.scheduling_nodes[i];
+    lf_thread_create(&fed->thread_id, federate_info_thread_TCP, fed);
+    lf_thread_create(&federates[i], federate, (void*)(intptr_t)i);
+  }
+  for (int i = 0; i < number_of_federates; i++) {
+    federate_info_t* fed = (federate_info_t*)rti.base.scheduling_nodes[i];
+    lf_thread_join(federates[i], NULL);
+    lf_thread_join(fed->thread_id, NULL);
+    pqueue_tag_free(fed->in_transit_message_tags);
+    free(fed->outbox);
+    free(fed->outbox_sending);
+  }
+  interval_t elapsed = lf_time_physical() - start;
+
+  printf("%d federates, %d tags: %.0f grants per second, %.1f us per grant.\n", number_of_federates, number_of_tags,
+         (double)number_of_federates * number_of_tags * BILLION / elapsed,
+         (double)elapsed / 1000.0 / number_of_federates / number_of_tags);
+  free_scheduling_nodes(rti.base.scheduling_nodes, rti.base.number_of_scheduling_nodes);
+  free(federates);
+  free(federate_sockets);
+  return 0;
+}
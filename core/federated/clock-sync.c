@@ -44,6 +44,18 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "net_util.h"
 #include "util.h"
 
+// The kernel timestamps the UDP messages of the runtime clock synchronization, which are not
+// exchanged unless LF_CLOCK_SYNC is LF_CLOCK_SYNC_ON.
+#if LF_CLOCK_SYNC_TIMESTAMPING != LF_CLOCK_SYNC_TIMESTAMPING_OFF && (LF_CLOCK_SYNC >= LF_CLOCK_SYNC_ON)
+#define KERNEL_TIMESTAMPS
+#endif
+
+#ifdef KERNEL_TIMESTAMPS
+#include <linux/errqueue.h>   // Defines struct scm_timestamping and struct sock_extended_err.
+#include <linux/net_tstamp.h> // Defines the SOF_TIMESTAMPING_* flags.
+#include <poll.h>
+#endif
+
 /** Offset calculated by the clock synchronization algorithm. */
 interval_t _lf_clock_sync_offset = NSEC(0);
 /** Offset used to test clock synchronization (clock sync should largely remove this offset). */
@@ -76,6 +88,137 @@ instant_t _lf_last_clock_sync_instant = 0LL;
  */
 int _lf_rti_socket_UDP = -1;
 
+#ifdef KERNEL_TIMESTAMPS
+/** Whether the kernel timestamps the datagrams received and sent on _lf_rti_socket_UDP. */
+static bool kernel_timestamps = false;
+
+/** The number of datagrams sent on _lf_rti_socket_UDP, which the kernel uses as IDs of their timestamps. */
+static uint32_t datagrams_sent = 0;
+
+/** How long to wait, in milliseconds, for the kernel to report the time at which a datagram was sent. */
+#define TRANSMIT_TIMESTAMP_TIMEOUT_MS 1
+
+/**
+ * Ask the kernel to timestamp the datagrams received and sent on the specified socket.
+ * If this fails, the physical clock is read instead.
+ */
+static void enable_kernel_timestamps(int socket) {
+#if LF_CLOCK_SYNC_TIMESTAMPING == LF_CLOCK_SYNC_TIMESTAMPING_HARDWARE
+  int flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+#else
+  int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+#endif
+  flags |= SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+  if (setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+    lf_print_warning("Clock sync: Failed to enable kernel timestamps on the UDP socket: %s. "
+                     "Using the physical clock instead.",
+                     strerror(errno));
+    return;
+  }
+  kernel_timestamps = true;
+}
+
+/**
+ * Return the timestamp in the control messages of a message received from the kernel,
+ * with the clock synchronization offset added, as lf_time_physical() does, or NEVER if there is none.
+ */
+static instant_t kernel_timestamp(struct msghdr* message) {
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(message); cmsg != NULL; cmsg = CMSG_NXTHDR(message, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPING) {
+      struct scm_timestamping timestamps;
+      memcpy(&timestamps, CMSG_DATA(cmsg), sizeof(timestamps));
+      // The first timestamp is the software one and the third one the raw hardware one.
+#if LF_CLOCK_SYNC_TIMESTAMPING == LF_CLOCK_SYNC_TIMESTAMPING_HARDWARE
+      struct timespec ts = timestamps.ts[2];
+#else
+      struct timespec ts = timestamps.ts[0];
+#endif
+      if (ts.tv_sec == 0 && ts.tv_nsec == 0) {
+        return NEVER;
+      }
+      instant_t result = (instant_t)ts.tv_sec * BILLION + ts.tv_nsec;
+      clock_sync_add_offset(&result);
+      return result;
+    }
+  }
+  return NEVER;
+}
+
+/**
+ * Return the time at which the last datagram written to _lf_rti_socket_UDP was sent,
+ * as reported by the kernel on the error queue of the socket, or NEVER if it is not reported in time.
+ */
+static instant_t transmit_time_of_last_datagram(void) {
+  uint32_t id = datagrams_sent++;
+  struct pollfd poll_fd = {.fd = _lf_rti_socket_UDP, .events = 0};
+  while (poll(&poll_fd, 1, TRANSMIT_TIMESTAMP_TIMEOUT_MS) > 0 && (poll_fd.revents & POLLERR)) {
+    char control[CMSG_SPACE(sizeof(struct scm_timestamping)) + CMSG_SPACE(sizeof(struct sock_extended_err) + 64)];
+    struct msghdr message = {.msg_control = control, .msg_controllen = sizeof(control)};
+    if (recvmsg(_lf_rti_socket_UDP, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      break;
+    }
+    // Timestamps of earlier datagrams that were not reported in time are discarded.
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+      if (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) {
+        struct sock_extended_err error;
+        memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+        if (error.ee_origin == SO_EE_ORIGIN_TIMESTAMPING && error.ee_data == id) {
+          return kernel_timestamp(&message);
+        }
+      }
+    }
+  }
+  return NEVER;
+}
+#endif // KERNEL_TIMESTAMPS
+
+/**
+ * Receive a clock synchronization message from the RTI on _lf_rti_socket_UDP.
+ * @param buffer The buffer into which to read the message.
+ * @param message_size The size of the message.
+ * @param address Where to record the address of the RTI, or NULL.
+ * @param address_length The length of the address, or NULL if address is NULL.
+ * @param receive_time Where to put the physical time at which the message was received.
+ * @return The number of bytes read, which is less than message_size on failure.
+ */
+static ssize_t receive_clock_sync_message(unsigned char* buffer, size_t message_size, struct sockaddr_in* address,
+                                          socklen_t* address_length, instant_t* receive_time) {
+  ssize_t bytes_read = 0;
+  instant_t timestamp = NEVER;
+  do {
+    struct iovec iov = {.iov_base = &buffer[bytes_read], .iov_len = message_size - (size_t)bytes_read};
+    struct msghdr message = {.msg_name = address,
+                             .msg_namelen = (address_length != NULL) ? *address_length : 0,
+                             .msg_iov = &iov,
+                             .msg_iovlen = 1};
+#ifdef KERNEL_TIMESTAMPS
+    char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+    if (kernel_timestamps) {
+      message.msg_control = control;
+      message.msg_controllen = sizeof(control);
+    }
+#endif
+    ssize_t bytes = recvmsg(_lf_rti_socket_UDP, &message, MSG_WAITALL);
+    // Try reading again if errno indicates the need to try again and there are more
+    // bytes to read.
+    if (bytes > 0) {
+      bytes_read += bytes;
+      if (address_length != NULL) {
+        *address_length = message.msg_namelen;
+      }
+#ifdef KERNEL_TIMESTAMPS
+      if (kernel_timestamps) {
+        timestamp = kernel_timestamp(&message);
+      }
+#endif
+    }
+  } while ((errno == EAGAIN || errno == EWOULDBLOCK) && bytes_read < (ssize_t)message_size);
+
+  // Get local physical time before doing anything else.
+  *receive_time = (timestamp != NEVER) ? timestamp : lf_time_physical();
+  return bytes_read;
+}
+
 /**
  * Atomically add an adjustment to the clock sync offset.
  * This needs to be atomic to be thread safe, particularly on 32-bit platforms.
@@ -163,30 +306,14 @@ void reset_socket_stat(struct socket_stat_t* socket_stat) {
 uint16_t setup_clock_synchronization_with_rti() {
   uint16_t port_to_return = UINT16_MAX; // Default if clock sync is off.
 #if (LF_CLOCK_SYNC >= LF_CLOCK_SYNC_ON)
-  // Initialize the UDP socket
-  _lf_rti_socket_UDP = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-  // Initialize the necessary information for the UDP address
-  struct sockaddr_in federate_UDP_addr;
-  federate_UDP_addr.sin_family = AF_INET;
-  federate_UDP_addr.sin_port = htons(0u); // Port 0 indicates to bind that
-                                          // it can assign any port to this
-                                          // socket. This is okay because
-                                          // the port number is then sent
-                                          // to the RTI.
-  federate_UDP_addr.sin_addr.s_addr = INADDR_ANY;
-  if (bind(_lf_rti_socket_UDP, (struct sockaddr*)&federate_UDP_addr, sizeof(federate_UDP_addr)) < 0) {
-    lf_print_error_system_failure("Failed to bind its UDP socket.");
-  }
-  // Retrieve the port number that was assigned by the operating system
-  socklen_t addr_length = sizeof(federate_UDP_addr);
-  if (getsockname(_lf_rti_socket_UDP, (struct sockaddr*)&federate_UDP_addr, &addr_length) == -1) {
+  // Initialize the UDP socket. The port chosen for it is sent to the RTI.
+  _lf_rti_socket_UDP = create_UDP_socket(&port_to_return);
+  if (_lf_rti_socket_UDP < 0) {
     // FIXME: Send 0 UDP_PORT message instead of exiting.
     // That will disable clock synchronization.
-    lf_print_error_system_failure("Failed to retrieve UDP port.");
+    lf_print_error_system_failure("Failed to create its UDP socket.");
   }
-  LF_PRINT_DEBUG("Assigned UDP port number %u to its socket.", ntohs(federate_UDP_addr.sin_port));
-
-  port_to_return = ntohs(federate_UDP_addr.sin_port);
+  LF_PRINT_DEBUG("Assigned UDP port number %u to its socket.", port_to_return);
 
   // Set the option for this socket to reuse the same address
   int option_value = 1;
@@ -201,6 +328,9 @@ uint16_t setup_clock_synchronization_with_rti() {
   if (setsockopt(_lf_rti_socket_UDP, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout_time, sizeof(timeout_time)) < 0) {
     lf_print_error("Failed to set SO_SNDTIMEO option on the socket: %s.", strerror(errno));
   }
+#ifdef KERNEL_TIMESTAMPS
+  enable_kernel_timestamps(_lf_rti_socket_UDP);
+#endif
 #elif (LF_CLOCK_SYNC == LF_CLOCK_SYNC_INIT)
   port_to_return = 0u;
 #endif // (LF_CLOCK_SYNC >= LF_CLOCK_SYNC_ON)
@@ -286,10 +416,19 @@ int handle_T1_clock_sync_message(unsigned char* buffer, int socket, instant_t t2
     return -1;
   }
 
-  // Measure the time _after_ the write on the assumption that the read
-  // from the socket, which occurs before this function is called, takes
-  // about the same amount of time as the write of the reply.
-  _lf_rti_socket_stat.local_delay = lf_time_physical() - t2;
+  instant_t t3 = NEVER;
+#ifdef KERNEL_TIMESTAMPS
+  if (kernel_timestamps && socket == _lf_rti_socket_UDP) {
+    t3 = transmit_time_of_last_datagram();
+  }
+#endif
+  if (t3 == NEVER) {
+    // Measure the time _after_ the write on the assumption that the read
+    // from the socket, which occurs before this function is called, takes
+    // about the same amount of time as the write of the reply.
+    t3 = lf_time_physical();
+  }
+  _lf_rti_socket_stat.local_delay = t3 - t2;
   return 0;
 }
 
@@ -344,9 +483,9 @@ void handle_T4_clock_sync_message(unsigned char* buffer, int socket, instant_t r
   if (socket == _lf_rti_socket_UDP) {
     // Read the coded probe message.
     // We can reuse the same buffer.
-    int read_failed = read_from_socket(socket, 1 + sizeof(instant_t), buffer);
-
-    instant_t r5 = lf_time_physical();
+    instant_t r5;
+    bool read_failed =
+        receive_clock_sync_message(buffer, 1 + sizeof(instant_t), NULL, NULL, &r5) < (ssize_t)(1 + sizeof(instant_t));
 
     if (read_failed || buffer[0] != MSG_TYPE_CLOCK_SYNC_CODED_PROBE) {
       lf_print_warning("Clock sync: Did not get the expected coded probe message from the RTI. "
@@ -456,24 +595,10 @@ void* listen_to_rti_UDP_thread(void* args) {
   while (1) {
     struct sockaddr_in RTI_UDP_addr;
     socklen_t RTI_UDP_addr_length = sizeof(RTI_UDP_addr);
-    ssize_t bytes_read = 0;
     // Read from the UDP socket
-    do {
-      ssize_t bytes = recvfrom(_lf_rti_socket_UDP,                // The UDP socket
-                               &buffer[bytes_read],               // The buffer to read into
-                               message_size - (size_t)bytes_read, // Number of bytes to read
-                               MSG_WAITALL,                       // Read the entire datagram
-                               (struct sockaddr*)&RTI_UDP_addr,   // Record the RTI's address
-                               &RTI_UDP_addr_length);             // The RTI's address length
-      // Try reading again if errno indicates the need to try again and there are more
-      // bytes to read.
-      if (bytes > 0) {
-        bytes_read += bytes;
-      }
-    } while ((errno == EAGAIN || errno == EWOULDBLOCK) && bytes_read < (ssize_t)message_size);
-
-    // Get local physical time before doing anything else.
-    instant_t receive_time = lf_time_physical();
+    instant_t receive_time;
+    ssize_t bytes_read =
+        receive_clock_sync_message(buffer, message_size, &RTI_UDP_addr, &RTI_UDP_addr_length, &receive_time);
 
     if (bytes_read < (ssize_t)message_size) {
       // Either the socket has closed or the RTI has sent EOF.
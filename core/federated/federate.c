@@ -17,6 +17,7 @@
 #include <arpa/inet.h>  // inet_ntop & inet_pton
 #include <netdb.h>      // Defines getaddrinfo(), freeaddrinfo() and struct addrinfo.
 #include <netinet/in.h> // Defines struct sockaddr_in
+#include <poll.h>       // Defines poll()
 #include <sys/socket.h>
 #include <unistd.h> // Defines read(), write(), and close()
 #include <string.h> // Defines memset(), strnlen(), strncmp(), strncpy()
@@ -28,6 +29,8 @@
 
 #include "clock-sync.h"
 #include "federate.h"
+#include "lz_block.h"
+#include "memory_accounting.h"
 #include "net_common.h"
 #include "net_util.h"
 #include "reactor.h"
@@ -35,13 +38,158 @@
 #include "reactor_threaded.h"
 #include "api/schedule.h"
 #include "scheduler.h"
+#include "startup_report.h"
 #include "tracepoint.h"
+#ifdef LF_METRICS
+#include "metrics.h"
+#endif
+#ifdef LF_TIME_TRIGGERED
+#include "static_schedule.h"
+#endif
+#ifdef LF_FEDERATED_RDMA
+#include "rdma.h"
+#endif
+#ifdef LF_FEDERATED_OPTIMISTIC
+#include "checkpoint.h"
+#endif
 
 #ifdef FEDERATED_AUTHENTICATED
 #include <openssl/rand.h> // For secure random number generation.
 #include <openssl/hmac.h> // For HMAC-based authentication of federates.
 #endif
 
+/**
+ * The number of payloads of each length class that are kept for reuse for each network input port.
+ * Zero means that the payloads of incoming messages are allocated and freed one by one.
+ */
+#ifndef LF_FEDERATED_RECEIVE_POOL_SIZE
+#define LF_FEDERATED_RECEIVE_POOL_SIZE 4
+#endif
+
+/**
+ * The minimum physical time between two NETs that only increase the tag while this federate waits
+ * for a TAG. A larger NET within this interval is held back and replaced by any that follow it,
+ * and the latest is sent when the interval has elapsed. Zero means that every such NET is sent
+ * right away.
+ */
+#ifndef LF_FEDERATED_NET_INTERVAL
+#define LF_FEDERATED_NET_INTERVAL 0
+#endif
+
+/**
+ * The maximum number of threads that lf_connect_to_federates() uses to connect to other
+ * federates at the same time.
+ */
+#ifndef LF_FEDERATED_CONNECT_THREADS
+#define LF_FEDERATED_CONNECT_THREADS 16
+#endif
+
+/**
+ * If LF_ADAPTIVE_STAA is defined, a federate with decentralized coordination adapts the STAA
+ * offsets of its network input ports to the arrival times of their messages. Each tagged
+ * message that would have arrived after the STAA offset of its port expired, which is an STP
+ * violation, raises the offset by LF_ADAPTIVE_STAA_STEP * (1 - LF_ADAPTIVE_STAA_TARGET), and
+ * each other message lowers it by LF_ADAPTIVE_STAA_STEP * LF_ADAPTIVE_STAA_TARGET, so that the
+ * offset settles where about a fraction LF_ADAPTIVE_STAA_TARGET of the messages violate it.
+ * The offsets generated for the program are the initial values. With LF_TRACE, each change is
+ * traced as a user value "STAA of port <ID>" for the first port of the STAA record.
+ */
+#ifndef LF_ADAPTIVE_STAA_TARGET
+#define LF_ADAPTIVE_STAA_TARGET 0.01
+#endif
+#ifndef LF_ADAPTIVE_STAA_STEP
+#define LF_ADAPTIVE_STAA_STEP USEC(10)
+#endif
+
+/**
+ * If LF_FEDERATED_COMPRESSION_THRESHOLD is defined, the payloads of tagged messages of at least
+ * that many bytes that this federate sends directly to other federates are compressed, provided
+ * that this makes them smaller and that the receiving federate accepted compressed messages when
+ * the connection was set up. Messages received compressed are decompressed whether or not it is
+ * defined.
+ */
+
+/**
+ * If LF_FEDERATED_DATAGRAM_SIZE is defined, messages on physical connections whose payloads have
+ * at most that many bytes are sent as UDP datagrams, provided that the receiving federate accepted
+ * them when the connection was set up. Datagrams that are lost are not sent again, and those that
+ * arrive after a later one are dropped, so a lost message does not delay the messages after it.
+ * Larger messages are still sent on the TCP connection and are not ordered with the datagrams.
+ * Datagrams are accepted whether or not it is defined.
+ */
+#if defined(LF_FEDERATED_DATAGRAM_SIZE) && LF_FEDERATED_DATAGRAM_SIZE > 65000
+#error "LF_FEDERATED_DATAGRAM_SIZE must be at most 65000 so that the messages fit in UDP datagrams."
+#endif
+
+/**
+ * If LF_FEDERATED_IO_URING is defined, which requires Linux and LF_FEDERATED_BATCH_SIZE, batches of
+ * messages for several destinations that are written at the same time are submitted to an io_uring
+ * together, so that they take one system call rather than one per destination. If the io_uring
+ * cannot be created, the batches are written one by one.
+ */
+#if defined(LF_FEDERATED_IO_URING) && !defined(LF_FEDERATED_BATCH_SIZE)
+#error "LF_FEDERATED_IO_URING requires LF_FEDERATED_BATCH_SIZE."
+#endif
+
+/**
+ * If LF_FEDERATED_RDMA is defined, which requires Linux and the ibverbs library, the bytes sent on
+ * a connection to another federate are carried by RDMA if both federates have an RDMA device and
+ * reach each other through it (see rdma.h). Otherwise, the connection uses TCP. Other federates
+ * that do not define it still connect to this federate using TCP. The io_uring of
+ * LF_FEDERATED_IO_URING writes to the sockets directly, so the two cannot be combined.
+ */
+#if defined(LF_FEDERATED_RDMA) && !defined(PLATFORM_Linux)
+#error "LF_FEDERATED_RDMA is only supported on Linux."
+#endif
+#if defined(LF_FEDERATED_RDMA) && defined(LF_FEDERATED_IO_URING)
+#error "LF_FEDERATED_RDMA cannot be combined with LF_FEDERATED_IO_URING."
+#endif
+
+/**
+ * If LF_TIME_TRIGGERED is defined, which requires centralized coordination, this federate tells
+ * the RTI at startup when its periodic timers fire. If the RTI is started with a window (see its
+ * -tt option) and all federates do so, the RTI computes from these times and the delays of the
+ * connections the times within a common hyperperiod at which messages may be sent to each federate.
+ * This federate then advances to a tag without sending NET and LTC messages and without waiting
+ * for a TAG, except that it waits for physical time to pass each of those times by the window,
+ * which must bound the latency of messages, including the clock synchronization error between
+ * hosts. A message that arrives after its tag has been passed is handled at the next microstep
+ * with a warning, and the RTI counts it as a violation. Otherwise, the federate uses TAGs as usual.
+ */
+#if defined(LF_TIME_TRIGGERED) && !defined(FEDERATED_CENTRALIZED)
+#error "LF_TIME_TRIGGERED requires centralized coordination."
+#endif
+
+/**
+ * If LF_FEDERATED_OPTIMISTIC is defined, which requires decentralized coordination, this federate
+ * executes ahead of its network inputs: at a tag where the status of an input port is unknown, it
+ * saves the state of the reactors registered with lf_checkpoint_register() and their pending events
+ * in memory (see checkpoint.h) and then assumes the port absent without waiting for its STAA offset
+ * to expire. At most LF_FEDERATED_OPTIMISTIC tags are speculative at once. Beyond that, tags wait for
+ * the STAA offsets as usual. A speculative tag is committed once the STAA offsets of its ports have
+ * expired, or their statuses at the tag have become known from messages. A message that arrives for
+ * an uncommitted tag that has already been executed is a straggler: at the end of the current tag,
+ * execution rolls back to the checkpoint of the latest tag before the message and executes again
+ * from there, with the message and with the events of physical actions and of other messages that
+ * had been handled since. The messages that this federate sends to other federates at a speculative
+ * tag, and the tags that it reports complete to the RTI, are held until the tag is committed, so
+ * no other federate sees an execution that is rolled back. The reactions of speculative tags may
+ * execute more than once, so their effects other than on registered state and on messages to
+ * other federates are repeated. At the stop tag, execution waits for all tags to be committed.
+ */
+#if defined(LF_FEDERATED_OPTIMISTIC) && !defined(FEDERATED_DECENTRALIZED)
+#error "LF_FEDERATED_OPTIMISTIC requires decentralized coordination."
+#endif
+#if defined(LF_FEDERATED_OPTIMISTIC) && LF_FEDERATED_OPTIMISTIC < 1
+#error "LF_FEDERATED_OPTIMISTIC must be the number of tags that may be speculative at once, at least 1."
+#endif
+#if defined(LF_FEDERATED_OPTIMISTIC) && (defined(LF_ENCLAVES) || defined(MODAL_REACTORS))
+#error "LF_FEDERATED_OPTIMISTIC cannot be combined with enclaves or modal reactors."
+#endif
+
+/** The maximum length of a UDP datagram. */
+#define MAX_DATAGRAM_LENGTH 65536
+
 // Global variables defined in tag.c:
 extern instant_t start_time;
 
@@ -82,23 +230,503 @@ federate_instance_t _fed = {.socket_TCP_RTI = -1,
                             .number_of_outbound_p2p_connections = 0,
                             .inbound_p2p_handling_thread_id = 0,
                             .server_socket = -1,
+                            .local_server_socket = -1,
+                            .datagram_socket = -1,
                             .server_port = -1,
                             .last_TAG = {.time = NEVER, .microstep = 0u},
                             .is_last_TAG_provisional = false,
                             .has_upstream = false,
                             .has_downstream = false,
                             .received_stop_request_from_rti = false,
+                            .stop_request_pipe = {-1, -1},
                             .last_sent_LTC = {.time = NEVER, .microstep = 0u},
                             .last_sent_NET = {.time = NEVER, .microstep = 0u},
-                            .min_delay_from_physical_action_to_federate_output = NEVER};
+                            .last_sent_NET_physical_time = NEVER,
+                            .NETs_sent = 0,
+                            .NETs_coalesced = 0,
+                            .NETs_suppressed = 0,
+                            .min_delay_from_physical_action_to_federate_output = NEVER,
+#ifdef LF_TIME_TRIGGERED
+                            .time_triggered_window = -1,
+#endif
+};
 
 federation_metadata_t federation_metadata = {
     .federation_id = "Unidentified Federation", .rti_host = NULL, .rti_port = -1, .rti_user = NULL};
 
+/** The CPUs to which the listener threads are pinned, as given by lf_set_listener_pinning(), or NULL. */
+static const char* listener_pinning = NULL;
+
 //////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 // Static functions (used only internally)
 
+/**
+ * Pin the calling listener thread to a CPU of the list given by lf_set_listener_pinning(), if any.
+ * @param index The index of the listener, which picks the CPU round robin: 0 for the thread
+ *  that listens to the RTI and 1 + the ID of the federate for the thread that listens to it.
+ */
+static void pin_listener(int index) {
+  if (listener_pinning == NULL) {
+    return;
+  }
+  int count = 1;
+  for (const char* c = listener_pinning; *c != '\0'; c++) {
+    if (*c == ',') {
+      count++;
+    }
+  }
+  const char* entry = listener_pinning;
+  for (int i = index % count; i > 0; i--) {
+    entry = strchr(entry, ',') + 1;
+  }
+  int cpu = atoi(entry);
+  if (lf_thread_set_cpu(lf_thread_self(), (size_t)cpu) != 0) {
+    lf_print_warning("Failed to pin listener thread %d to CPU %d.", index, cpu);
+  } else {
+    LF_PRINT_LOG("Listener thread %d pinned to CPU %d.", index, cpu);
+  }
+}
+
+/**
+ * Allocate a buffer for a message that is sent or received, counted as network memory.
+ * @param size The size of the buffer in bytes.
+ */
+static unsigned char* network_buffer_new(size_t size) {
+  unsigned char* buffer = (unsigned char*)malloc(size);
+  LF_ASSERT_NON_NULL(buffer);
+  LF_MEMORY_ALLOCATED(lf_memory_network, size);
+  return buffer;
+}
+
+/**
+ * Free a buffer allocated by network_buffer_new().
+ * @param buffer The buffer, or NULL to do nothing.
+ * @param size The size with which it was allocated.
+ */
+static void network_buffer_free(unsigned char* buffer, size_t size) {
+  if (buffer != NULL) {
+    free(buffer);
+    LF_MEMORY_FREED(lf_memory_network, size);
+  }
+  (void)size;
+}
+
+/**
+ * Write a message, given as its header and its payload, to the specified socket.
+ * @param socket Pointer to the socket, which is closed on failure.
+ * @param header_length The length of the header.
+ * @param header The header.
+ * @param length The length of the payload.
+ * @param message The payload, or NULL if it is serialized from the value.
+ * @param type The type of the value, if the payload is serialized from it (@see token_type_t), or NULL.
+ * @param value The value, if the payload is serialized from it.
+ * @return 0 for success, -1 for failure.
+ */
+static int write_message(int* socket, size_t header_length, unsigned char* header, size_t length,
+                         unsigned char* message, token_type_t* type, void* value) {
+  if (type != NULL) {
+    // Serialize the value right after the header, so that both are written at once.
+    unsigned char* buffer = network_buffer_new(header_length + length);
+    memcpy(buffer, header, header_length);
+    type->serialize_into(value, &buffer[header_length]);
+    int result = write_to_socket_close_on_error(socket, header_length + length, buffer);
+    network_buffer_free(buffer, header_length + length);
+    return result;
+  }
+  struct iovec buffers[] = {{.iov_base = header, .iov_len = header_length}, {.iov_base = message, .iov_len = length}};
+  return writev_to_socket_close_on_error(socket, buffers, 2);
+}
+
+#ifdef LF_FEDERATED_BATCH_SIZE
+/**
+ * @brief Tagged messages for one destination that have been sent but not yet written to its socket.
+ * The messages are written together when the batch would otherwise exceed LF_FEDERATED_BATCH_SIZE
+ * bytes, at the end of the tag, before any other message is written, and before this federate
+ * waits for the status of its input ports, which may depend on the messages. A NET or LTC sent
+ * while the batch for the RTI has messages is added to it, and so takes no write of its own.
+ */
+typedef struct outbound_batch_t {
+  int* socket;  // The socket to which to write the messages.
+  bool to_rti;  // Whether the socket is the one to the RTI, in which case a failure is fatal.
+  size_t size;  // The number of bytes in the batch.
+  // If the batch ends with a MSG_TYPE_PORT_ABSENT_RANGES message, its offset and the size of the batch.
+  size_t port_absent_offset;
+  size_t port_absent_end;
+  unsigned char bytes[LF_FEDERATED_BATCH_SIZE];
+} outbound_batch_t;
+
+/** One batch for each peer federate and, at index NUMBER_OF_FEDERATES, one for the RTI. */
+static outbound_batch_t outbound_batches[NUMBER_OF_FEDERATES + 1];
+
+/**
+ * Report that the messages of the specified batch could not be written, which is fatal if
+ * they are for the RTI.
+ */
+static void report_failed_outbound_batch(outbound_batch_t* batch) {
+  if (batch->to_rti) {
+    lf_print_error_system_failure("Failed to send messages with error code %d (%s). Connection lost to the RTI.", errno,
+                                  strerror(errno));
+  } else {
+    lf_print_warning("Failed to send messages to a federate. Dropping the messages.");
+  }
+}
+
+/**
+ * Write the messages of the specified batch to its socket.
+ * This assumes the caller holds the lf_outbound_socket_mutex.
+ */
+static void flush_outbound_batch_locked(outbound_batch_t* batch) {
+  if (batch->size == 0) {
+    return;
+  }
+  int result = write_to_socket_close_on_error(batch->socket, batch->size, batch->bytes);
+  batch->size = 0;
+  batch->port_absent_end = 0;
+  if (result != 0) {
+    report_failed_outbound_batch(batch);
+  }
+}
+
+/**
+ * Add to the specified batch that a port of a federate is absent at a tag. If the batch ends with
+ * a MSG_TYPE_PORT_ABSENT_RANGES message for the same federate and tag, the port is added to it,
+ * which takes no bytes if the port follows the last range in it. Otherwise, such a message is started.
+ * This assumes the caller holds the lf_outbound_socket_mutex.
+ * @param batch The batch for the socket on which the message is sent.
+ * @param fed_ID The ID of the destination federate.
+ * @param port_ID The ID of the absent port.
+ * @param tag The tag at which the port is absent.
+ */
+static void batch_port_absent_locked(outbound_batch_t* batch, uint16_t fed_ID, uint16_t port_ID, tag_t tag) {
+  if (batch->size > 0 && batch->port_absent_end == batch->size) {
+    unsigned char* message = &batch->bytes[batch->port_absent_offset];
+    uint16_t num_ranges = extract_uint16(&message[MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE - sizeof(uint16_t)]);
+    if (extract_uint16(&message[1]) == fed_ID &&
+        lf_tag_compare(extract_tag(&message[1 + sizeof(uint16_t)]), tag) == 0) {
+      unsigned char* last_range = &batch->bytes[batch->size - PORT_ABSENT_RANGE_SIZE];
+      uint16_t num_ports = extract_uint16(&last_range[sizeof(uint16_t)]);
+      if (num_ports < UINT16_MAX && port_ID == extract_uint16(last_range) + num_ports) {
+        encode_uint16(num_ports + 1, &last_range[sizeof(uint16_t)]);
+        return;
+      }
+      if (num_ranges < PORT_ABSENT_MAX_RANGES && batch->size + PORT_ABSENT_RANGE_SIZE <= LF_FEDERATED_BATCH_SIZE) {
+        encode_uint16(num_ranges + 1, &message[MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE - sizeof(uint16_t)]);
+        encode_uint16(port_ID, &batch->bytes[batch->size]);
+        encode_uint16(1, &batch->bytes[batch->size + sizeof(uint16_t)]);
+        batch->size += PORT_ABSENT_RANGE_SIZE;
+        batch->port_absent_end = batch->size;
+        return;
+      }
+    }
+  }
+  if (batch->size + MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE + PORT_ABSENT_RANGE_SIZE > LF_FEDERATED_BATCH_SIZE) {
+    flush_outbound_batch_locked(batch);
+  }
+  unsigned char* message = &batch->bytes[batch->size];
+  message[0] = MSG_TYPE_PORT_ABSENT_RANGES;
+  encode_uint16(fed_ID, &message[1]);
+  encode_tag(&message[1 + sizeof(uint16_t)], tag);
+  encode_uint16(1, &message[MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE - sizeof(uint16_t)]);
+  encode_uint16(port_ID, &message[MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE]);
+  encode_uint16(1, &message[MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE + sizeof(uint16_t)]);
+  batch->port_absent_offset = batch->size;
+  batch->size += MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE + PORT_ABSENT_RANGE_SIZE;
+  batch->port_absent_end = batch->size;
+}
+
+#ifdef LF_FEDERATED_IO_URING
+/** The io_uring through which the batches are written, with their bytes as registered buffers. */
+static socket_write_ring_t outbound_batch_ring;
+
+/** Whether outbound_batch_ring has been created (1), could not be created (-1), or has not been tried (0). */
+static int outbound_batch_ring_state = 0;
+
+/**
+ * Write the messages of all batches that have messages with one system call through outbound_batch_ring,
+ * creating it the first time.
+ * This assumes the caller holds the lf_outbound_socket_mutex.
+ * @return false if the ring could not be created, in which case no batch has been written.
+ */
+static bool flush_outbound_batches_through_ring_locked() {
+  if (outbound_batch_ring_state == 0) {
+    struct iovec buffers[NUMBER_OF_FEDERATES + 1];
+    for (int i = 0; i <= NUMBER_OF_FEDERATES; i++) {
+      buffers[i] = (struct iovec){.iov_base = outbound_batches[i].bytes, .iov_len = LF_FEDERATED_BATCH_SIZE};
+    }
+    if (socket_write_ring_init(&outbound_batch_ring, NUMBER_OF_FEDERATES + 1, buffers, NUMBER_OF_FEDERATES + 1) == 0) {
+      outbound_batch_ring_state = 1;
+    } else {
+      lf_print_warning("Failed to create an io_uring: %s. Batches of messages will be written one by one.",
+                       strerror(errno));
+      outbound_batch_ring_state = -1;
+    }
+  }
+  if (outbound_batch_ring_state < 0) {
+    return false;
+  }
+  socket_write_t writes[NUMBER_OF_FEDERATES + 1];
+  size_t num_writes = 0;
+  for (int i = 0; i <= NUMBER_OF_FEDERATES; i++) {
+    outbound_batch_t* batch = &outbound_batches[i];
+    if (batch->size > 0 && *batch->socket < 0) {
+      // The socket is closed. This reports the failure.
+      flush_outbound_batch_locked(batch);
+    } else if (batch->size > 0) {
+      writes[num_writes++] = (socket_write_t){
+          .socket = *batch->socket, .buffer_index = (unsigned)i, .bytes = batch->bytes, .length = batch->size};
+    }
+  }
+  socket_write_ring_write_all(&outbound_batch_ring, writes, num_writes);
+  for (size_t i = 0; i < num_writes; i++) {
+    outbound_batch_t* batch = &outbound_batches[writes[i].buffer_index];
+    batch->size = 0;
+    batch->port_absent_end = 0;
+    if (writes[i].error != 0) {
+      // See write_to_socket_close_on_error.
+      shutdown(*batch->socket, SHUT_RDWR);
+      close(*batch->socket);
+      *batch->socket = -1;
+      errno = writes[i].error;
+      report_failed_outbound_batch(batch);
+    }
+  }
+  return true;
+}
+#endif // LF_FEDERATED_IO_URING
+
+/**
+ * Write the messages of all batches. With LF_FEDERATED_IO_URING, if more than one batch has messages,
+ * they are written with one system call.
+ * This assumes the caller holds the lf_outbound_socket_mutex.
+ */
+static void flush_outbound_batches_locked() {
+#ifdef LF_FEDERATED_IO_URING
+  int nonempty = 0;
+  for (int i = 0; i <= NUMBER_OF_FEDERATES && nonempty < 2; i++) {
+    nonempty += outbound_batches[i].size > 0;
+  }
+  if (nonempty > 1 && flush_outbound_batches_through_ring_locked()) {
+    return;
+  }
+#endif // LF_FEDERATED_IO_URING
+  for (int i = 0; i <= NUMBER_OF_FEDERATES; i++) {
+    flush_outbound_batch_locked(&outbound_batches[i]);
+  }
+}
+#else
+#define flush_outbound_batches_locked()
+#endif // LF_FEDERATED_BATCH_SIZE
+
+#ifdef LF_FEDERATED_SEND_QUEUE
+#ifdef LF_FEDERATED_BATCH_SIZE
+#error "LF_FEDERATED_SEND_QUEUE and LF_FEDERATED_BATCH_SIZE cannot both be defined."
+#endif
+/**
+ * @brief Messages for a peer federate that have been sent but not yet written to its socket.
+ * A thread of its own writes them, as many as have been queued with each system call, so that the
+ * workers that send messages only copy them and a slow peer only holds up the workers that send
+ * to it once its queue, which is bounded by LF_FEDERATED_SEND_QUEUE bytes, is full. Messages to a
+ * peer federate do not take the lf_outbound_socket_mutex, as the queue has a lock of its own.
+ */
+typedef struct send_queue_t {
+  unsigned short federate;
+  bool started;  // Whether the thread that writes the messages has been started.
+  bool closed;   // Whether the thread should exit once the queue is empty.
+  bool writing;  // Whether the thread is writing bytes taken from the queue.
+  size_t size;   // The number of bytes queued.
+  size_t waits;  // The number of times that a sender waited for the queue to have room.
+  unsigned char* bytes;   // The queued bytes, of which there is room for LF_FEDERATED_SEND_QUEUE.
+  unsigned char* written; // The bytes being written, which are swapped with the queued bytes.
+  lf_mutex_t mutex;
+  lf_cond_t queued;  // Signaled when bytes are queued or the queue is closed.
+  lf_cond_t drained; // Signaled when the thread takes the queued bytes or has written them.
+  lf_thread_t thread;
+} send_queue_t;
+
+/** The queue for each peer federate. */
+static send_queue_t send_queues[NUMBER_OF_FEDERATES];
+
+/**
+ * Thread that writes the messages of a send queue to the socket of its federate until the queue is closed.
+ * @param arg The queue.
+ */
+static void* write_send_queue(void* arg) {
+  initialize_lf_thread_id();
+  send_queue_t* queue = (send_queue_t*)arg;
+  int* socket = &_fed.sockets_for_outbound_p2p_connections[queue->federate];
+  LF_MUTEX_LOCK(&queue->mutex);
+  while (true) {
+    while (queue->size == 0 && !queue->closed) {
+      LF_COND_WAIT(&queue->queued);
+    }
+    if (queue->size == 0) {
+      break;
+    }
+    // Take the queued bytes, so that senders can queue more while they are written.
+    unsigned char* bytes = queue->bytes;
+    size_t size = queue->size;
+    queue->bytes = queue->written;
+    queue->written = bytes;
+    queue->size = 0;
+    queue->writing = true;
+    LF_COND_BROADCAST(&queue->drained);
+    LF_MUTEX_UNLOCK(&queue->mutex);
+    if (*socket < 0 || write_to_socket_close_on_error(socket, size, bytes) != 0) {
+      lf_print_warning("Failed to send messages to federate %d. Dropping the messages.", queue->federate);
+    }
+    LF_MUTEX_LOCK(&queue->mutex);
+    queue->writing = false;
+    LF_COND_BROADCAST(&queue->drained);
+  }
+  LF_MUTEX_UNLOCK(&queue->mutex);
+  return NULL;
+}
+
+/**
+ * Start the thread that writes the messages queued for the specified federate, once connected to it.
+ * @param federate The ID of the federate.
+ */
+static void start_send_queue(unsigned short federate) {
+  send_queue_t* queue = &send_queues[federate];
+  queue->federate = federate;
+  queue->bytes = network_buffer_new(LF_FEDERATED_SEND_QUEUE);
+  queue->written = network_buffer_new(LF_FEDERATED_SEND_QUEUE);
+  LF_MUTEX_INIT(&queue->mutex);
+  LF_COND_INIT(&queue->queued, &queue->mutex);
+  LF_COND_INIT(&queue->drained, &queue->mutex);
+  queue->started = true;
+  if (lf_thread_create(&queue->thread, write_send_queue, queue) != 0) {
+    lf_print_error_system_failure("Failed to create the thread that sends messages to federate %d.", federate);
+  }
+}
+
+/**
+ * Write the messages queued for the specified federate and stop the thread that writes them.
+ * On abnormal termination, the thread is not waited for.
+ * @param federate The ID of the federate.
+ */
+static void close_send_queue(unsigned short federate) {
+  send_queue_t* queue = &send_queues[federate];
+  if (!queue->started) {
+    return;
+  }
+  LF_MUTEX_LOCK(&queue->mutex);
+  queue->closed = true;
+  LF_COND_SIGNAL(&queue->queued);
+  LF_MUTEX_UNLOCK(&queue->mutex);
+  if (_lf_normal_termination) {
+    lf_thread_join(queue->thread, NULL);
+    network_buffer_free(queue->bytes, LF_FEDERATED_SEND_QUEUE);
+    network_buffer_free(queue->written, LF_FEDERATED_SEND_QUEUE);
+  }
+  queue->started = false;
+  LF_PRINT_LOG("Senders waited %zu times for room in the queue for federate %d.", queue->waits, federate);
+}
+
+/**
+ * Queue a message, given as its header and its payload, to be written to the socket of the federate
+ * of the specified queue, waiting for room if the queue is full. A message that is larger than the
+ * queue is written once the queue is empty, by the caller.
+ * @param queue The queue.
+ * @param header_length The length of the header.
+ * @param header The header.
+ * @param length The length of the payload.
+ * @param message The payload, or NULL if it is serialized from the value.
+ * @param type The type of the value, if the payload is serialized from it (@see token_type_t), or NULL.
+ * @param value The value, if the payload is serialized from it.
+ * @return 0 for success, -1 if the connection is closed or the message could not be written.
+ */
+static int enqueue_message(send_queue_t* queue, size_t header_length, unsigned char* header, size_t length,
+                           unsigned char* message, token_type_t* type, void* value) {
+  int* socket = &_fed.sockets_for_outbound_p2p_connections[queue->federate];
+  size_t total = header_length + length;
+  int result = 0;
+  LF_MUTEX_LOCK(&queue->mutex);
+  // A message larger than the queue waits for the queued messages, which must be written first, to be written.
+  size_t room = total > LF_FEDERATED_SEND_QUEUE ? 0 : LF_FEDERATED_SEND_QUEUE - total;
+  bool waited = false;
+  while (queue->started && *socket >= 0 && (queue->size > room || (room == 0 && queue->writing))) {
+    queue->waits += !waited;
+    waited = true;
+    LF_COND_WAIT(&queue->drained);
+  }
+  if (!queue->started || *socket < 0) {
+    result = -1;
+  } else if (total > LF_FEDERATED_SEND_QUEUE) {
+    // The thread is not writing and cannot start to while the mutex is held.
+    result = write_message(socket, header_length, header, length, message, type, value);
+  } else {
+    unsigned char* bytes = &queue->bytes[queue->size];
+    memcpy(bytes, header, header_length);
+    if (type != NULL) {
+      type->serialize_into(value, &bytes[header_length]);
+    } else if (length > 0) {
+      memcpy(&bytes[header_length], message, length);
+    }
+    queue->size += total;
+    LF_COND_SIGNAL(&queue->queued);
+  }
+  LF_MUTEX_UNLOCK(&queue->mutex);
+  return result;
+}
+#endif // LF_FEDERATED_SEND_QUEUE
+
+/**
+ * Acquire the lock under which messages are sent to the specified destination, which is the
+ * lf_outbound_socket_mutex unless messages to it are queued.
+ * @param destination The ID of the destination federate, or NUMBER_OF_FEDERATES for the RTI.
+ */
+static void lock_outbound(size_t destination) {
+#ifdef LF_FEDERATED_SEND_QUEUE
+  if (destination < NUMBER_OF_FEDERATES) {
+    return;
+  }
+#else
+  (void)destination;
+#endif
+  LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+}
+
+/** Release the lock acquired by lock_outbound(). */
+static void unlock_outbound(size_t destination) {
+#ifdef LF_FEDERATED_SEND_QUEUE
+  if (destination < NUMBER_OF_FEDERATES) {
+    return;
+  }
+#else
+  (void)destination;
+#endif
+  LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+}
+
+#ifdef LF_FEDERATED_COMPRESSION_THRESHOLD
+/** Whether each peer federate accepted compressed messages on the connection to it. */
+static bool compressed_outbound_p2p_connections[NUMBER_OF_FEDERATES];
+#endif // LF_FEDERATED_COMPRESSION_THRESHOLD
+
+#ifdef LF_FEDERATED_DATAGRAM_SIZE
+/** The UDP socket from which datagrams are sent to other federates, or -1 if it has not been created. */
+static int outbound_datagram_socket = -1;
+
+/** The address to send datagrams to each peer federate, whose port is 0 if the federate does not accept them. */
+static struct sockaddr_in outbound_datagram_addresses[NUMBER_OF_FEDERATES];
+
+/** The sequence number of the last datagram sent to each peer federate. */
+static uint32_t outbound_datagram_sequences[NUMBER_OF_FEDERATES];
+#endif // LF_FEDERATED_DATAGRAM_SIZE
+
+/** Whether each peer federate has been allowed to send datagrams to this federate. */
+static bool datagram_senders[NUMBER_OF_FEDERATES];
+
+/** The sequence number of the last datagram received from each peer federate. */
+static uint32_t inbound_datagram_sequences[NUMBER_OF_FEDERATES];
+
+/** Statistics of the datagrams received, which are only accessed by the thread listening for them. */
+static size_t datagrams_received = 0;
+static size_t datagrams_missed = 0;
+static size_t datagrams_dropped = 0;
+
 /**
  * Send a time to the RTI. This acquires the lf_outbound_socket_mutex.
  * @param type The message type (MSG_TYPE_TIMESTAMP).
@@ -116,6 +744,7 @@ static void send_time(unsigned char type, instant_t time) {
   tracepoint_federate_to_rti(send_TIMESTAMP, _lf_my_fed_id, &tag);
 
   LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+  flush_outbound_batches_locked();
   write_to_socket_fail_on_error(&_fed.socket_TCP_RTI, bytes_to_write, buffer, &lf_outbound_socket_mutex,
                                 "Failed to send time " PRINTF_TIME " to the RTI.", time - start_time);
   LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
@@ -143,11 +772,63 @@ static void send_tag(unsigned char type, tag_t tag) {
   trace_event_t event_type = (type == MSG_TYPE_NEXT_EVENT_TAG) ? send_NET : send_LTC;
   // Trace the event when tracing is enabled
   tracepoint_federate_to_rti(event_type, _lf_my_fed_id, &tag);
+#ifdef LF_FEDERATED_BATCH_SIZE
+  // If tagged messages to the RTI are waiting in their batch, send the tag with them rather
+  // than with a write of its own.
+  outbound_batch_t* batch = &outbound_batches[NUMBER_OF_FEDERATES];
+  if (batch->size > 0 && batch->size + bytes_to_write <= LF_FEDERATED_BATCH_SIZE) {
+    memcpy(&batch->bytes[batch->size], buffer, bytes_to_write);
+    batch->size += bytes_to_write;
+    flush_outbound_batches_locked();
+    LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+    return;
+  }
+#endif // LF_FEDERATED_BATCH_SIZE
+  // Messages at earlier tags must arrive first.
+  flush_outbound_batches_locked();
   write_to_socket_fail_on_error(&_fed.socket_TCP_RTI, bytes_to_write, buffer, &lf_outbound_socket_mutex,
                                 "Failed to send tag " PRINTF_TAG " to the RTI.", tag.time - start_time, tag.microstep);
   LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
 }
 
+/**
+ * Send a NET to the RTI unless the RTI already has it, that is, unless it equals the last NET sent
+ * and the RTI has not since lowered its record of it, which it does when it forwards a message.
+ * If `may_defer` is true, LF_FEDERATED_NET_INTERVAL has not elapsed since the last NET, and this
+ * NET is larger, then it is not sent either. The caller must then call this function again, with the
+ * tag that is current by then, once `_fed.last_sent_NET_physical_time + LF_FEDERATED_NET_INTERVAL`
+ * is reached. This assumes the caller holds the environment mutex.
+ * @param tag The next event tag.
+ * @param may_defer Whether the NET may be held back.
+ * @return false if the NET was held back, true otherwise.
+ */
+static bool send_net_if_needed(tag_t tag, bool may_defer) {
+  if (lf_tag_compare(tag, _fed.last_sent_NET) == 0) {
+    _fed.NETs_suppressed++;
+    LF_PRINT_DEBUG("Not sending NET " PRINTF_TAG " because the RTI already has it.", tag.time - start_time,
+                   tag.microstep);
+    return true;
+  }
+#if LF_FEDERATED_NET_INTERVAL > 0
+  if (may_defer && lf_tag_compare(tag, _fed.last_sent_NET) > 0 &&
+      lf_time_physical() < _fed.last_sent_NET_physical_time + LF_FEDERATED_NET_INTERVAL) {
+    _fed.NETs_coalesced++;
+    LF_PRINT_DEBUG("Holding back NET " PRINTF_TAG " because the last NET was sent less than " PRINTF_TIME
+                   " ns ago.",
+                   tag.time - start_time, tag.microstep, (interval_t)LF_FEDERATED_NET_INTERVAL);
+    return false;
+  }
+#else
+  (void)may_defer;
+#endif
+  send_tag(MSG_TYPE_NEXT_EVENT_TAG, tag);
+  _fed.last_sent_NET = tag;
+  _fed.last_sent_NET_physical_time = lf_time_physical();
+  _fed.NETs_sent++;
+  LF_PRINT_LOG("Sent next event tag (NET) " PRINTF_TAG " to RTI.", tag.time - start_time, tag.microstep);
+  return true;
+}
+
 /**
  * Return true if either the socket to the RTI is broken or the socket is
  * alive and the first unread byte on the socket's queue is MSG_TYPE_FAILED.
@@ -233,7 +914,23 @@ static void update_last_known_status_on_input_ports(tag_t tag) {
 }
 
 /**
- * @brief Update the last known status tag of a network input port.
+ * Notify the threads waiting for the status of network input ports that it has changed.
+ * This function assumes the caller holds the mutex on the top-level environment.
+ */
+static void notify_input_port_status_changed() {
+  // Check whether this port update implies a change to MLAA, which may unblock reactions.
+  // For decentralized coordination, the first argument is NEVER, so it has no effect.
+  // For centralized, the arguments probably also have no effect, but the port update may.
+  // Note that it would not be correct to pass `tag` as the first argument because
+  // there is no guarantee that there is either a TAG or a PTAG for this time.
+  // The message that triggered this to be called could be from an upstream
+  // federate that is far ahead of other upstream federates in logical time.
+  lf_update_max_level(_fed.last_TAG, _fed.is_last_TAG_provisional);
+  lf_cond_broadcast(&lf_port_status_changed);
+}
+
+/**
+ * @brief Set the last known status tag of a network input port.
  *
  * First, if the specified tag is less than the current_tag of the top-level
  * environment, then ignore the specified tag and use the current_tag. This
@@ -252,14 +949,14 @@ static void update_last_known_status_on_input_ports(tag_t tag) {
  * which uses physical time to determine when an input port can be assumed to be absent
  * if a message has not been received.
  *
- * This function assumes the caller holds the mutex on the top-level environment,
- * and, if the tag actually increases, it broadcasts on `lf_port_status_changed`.
+ * This function assumes the caller holds the mutex on the top-level environment.
  *
  * @param env The top-level environment, whose mutex is assumed to be held.
  * @param tag The tag on which the latest status of the specified network input port is known.
  * @param portID The port ID.
+ * @return true if the last known status tag of the port changed.
  */
-static void update_last_known_status_on_input_port(environment_t* env, tag_t tag, int port_id) {
+static bool set_last_known_status_on_input_port(environment_t* env, tag_t tag, int port_id) {
   if (lf_tag_compare(tag, env->current_tag) < 0)
     tag = env->current_tag;
   trigger_t* input_port_action = action_for_port(port_id)->trigger;
@@ -271,21 +968,29 @@ static void update_last_known_status_on_input_port(environment_t* env, tag_t tag
                  input_port_action->last_known_status_tag.time - lf_time_start(),
                  input_port_action->last_known_status_tag.microstep, tag.time - lf_time_start(), tag.microstep);
     input_port_action->last_known_status_tag = tag;
+    return true;
+  }
+  // Message arrivals should be monotonic, so this should not occur.
+  lf_print_warning("Attempt to update the last known status tag "
+                   "of network input port %d to an earlier tag was ignored.",
+                   port_id);
+  return false;
+}
 
-    // Check whether this port update implies a change to MLAA, which may unblock reactions.
-    // For decentralized coordination, the first argument is NEVER, so it has no effect.
-    // For centralized, the arguments probably also have no effect, but the port update may.
-    // Note that it would not be correct to pass `tag` as the first argument because
-    // there is no guarantee that there is either a TAG or a PTAG for this time.
-    // The message that triggered this to be called could be from an upstream
-    // federate that is far ahead of other upstream federates in logical time.
-    lf_update_max_level(_fed.last_TAG, _fed.is_last_TAG_provisional);
-    lf_cond_broadcast(&lf_port_status_changed);
-  } else {
-    // Message arrivals should be monotonic, so this should not occur.
-    lf_print_warning("Attempt to update the last known status tag "
-                     "of network input port %d to an earlier tag was ignored.",
-                     port_id);
+/**
+ * @brief Update the last known status tag of a network input port with
+ * set_last_known_status_on_input_port() and, if the tag actually increases, broadcast
+ * on `lf_port_status_changed`.
+ *
+ * This function assumes the caller holds the mutex on the top-level environment.
+ *
+ * @param env The top-level environment, whose mutex is assumed to be held.
+ * @param tag The tag on which the latest status of the specified network input port is known.
+ * @param portID The port ID.
+ */
+static void update_last_known_status_on_input_port(environment_t* env, tag_t tag, int port_id) {
+  if (set_last_known_status_on_input_port(env, tag, port_id)) {
+    notify_input_port_status_changed();
   }
 }
 
@@ -308,6 +1013,7 @@ static void set_network_port_status(int portID, port_status_t status) {
  * It is also responsible for setting the intended tag of the
  * network message based on the calculated delay.
  * This function assumes that the caller holds the mutex lock.
+ * It does not notify the workers that the event queue changed. See handle_tagged_message().
  *
  * This is used for handling incoming timed messages to a federate.
  *
@@ -340,6 +1046,19 @@ static trigger_handle_t schedule_message_received_from_network_locked(environmen
   interval_t extra_delay = tag.time - env->current_tag.time;
   if (!message_tag_is_in_the_future && env->execution_started) {
 #ifdef FEDERATED_CENTRALIZED
+#ifdef LF_TIME_TRIGGERED
+    if (_fed.time_triggered_window >= 0) {
+      // The message arrived after the window, which the RTI also reports.
+      lf_print_warning("Received a message at tag " PRINTF_TAG " that has a tag " PRINTF_TAG
+                       " and arrived after the window of the time-triggered schedule."
+                       " Handling it at the next microstep.",
+                       env->current_tag.time - start_time, env->current_tag.microstep, tag.time - start_time,
+                       tag.microstep);
+      return_value = lf_schedule_trigger(env, trigger, 0LL, token);
+      trigger->intended_tag = previous_intended_tag;
+      return return_value;
+    }
+#endif
     // If the coordination is centralized, receiving a message
     // that does not carry a timestamp that is in the future
     // would indicate a critical condition, showing that the
@@ -365,12 +1084,26 @@ static trigger_handle_t schedule_message_received_from_network_locked(environmen
     return_value = _lf_schedule_at_tag(env, trigger, tag, token);
   }
   trigger->intended_tag = previous_intended_tag;
-  // Notify the main thread in case it is waiting for physical time to elapse.
-  LF_PRINT_DEBUG("Broadcasting notification that event queue changed.");
-  lf_cond_broadcast(&env->event_q_changed);
   return return_value;
 }
 
+/**
+ * Notify the workers that the event queue changed if messages have been scheduled by
+ * handle_tagged_message() without notifying them, and clear the flag that says so.
+ * @param notify_pending The flag passed to handle_tagged_message().
+ */
+static void notify_of_scheduled_messages(bool* notify_pending) {
+  if (*notify_pending) {
+    environment_t* env;
+    _lf_get_environments(&env);
+    LF_MUTEX_LOCK(&env->mutex);
+    LF_PRINT_DEBUG("Broadcasting notification that event queue changed.");
+    _lf_notify_event_q_changed_locked(env, true);
+    LF_MUTEX_UNLOCK(&env->mutex);
+    *notify_pending = false;
+  }
+}
+
 /**
  * Close the socket that receives incoming messages from the
  * specified federate ID. This function should be called when a read
@@ -385,6 +1118,10 @@ static trigger_handle_t schedule_message_received_from_network_locked(environmen
 static void close_inbound_socket(int fed_id, int flag) {
   LF_MUTEX_LOCK(&socket_mutex);
   if (_fed.sockets_for_inbound_p2p_connections[fed_id] >= 0) {
+#ifdef LF_FEDERATED_RDMA
+    // The thread listening to the federate wakes up when the socket is shut down and then sees the end of the stream.
+    rdma_detach_socket(_fed.sockets_for_inbound_p2p_connections[fed_id]);
+#endif
     if (flag >= 0) {
       if (flag > 0) {
         shutdown(_fed.sockets_for_inbound_p2p_connections[fed_id], SHUT_RDWR);
@@ -443,28 +1180,109 @@ static bool handle_message_now(environment_t* env, trigger_t* trigger, tag_t int
 }
 
 /**
- * Handle a message being received from a remote federate.
- *
- * This function assumes the caller does not hold the mutex lock.
- * @param socket Pointer to the socket to read the message from.
- * @param fed_id The sending federate ID or -1 if the centralized coordination.
- * @return 0 for success, -1 for failure.
+ * Read the compressed payload of a MSG_TYPE_P2P_COMPRESSED_TAGGED_MESSAGE, which follows its header,
+ * and decompress it into the specified buffer of `length` bytes.
+ * @param socket Pointer to the socket to read the payload from.
+ * @param payload The buffer for the uncompressed payload.
+ * @param length The length of the uncompressed payload.
+ * @return 0 on success, -1 if the socket was closed.
  */
-static int handle_message(int* socket, int fed_id) {
-  (void)fed_id;
-  // Read the header.
-  size_t bytes_to_read = sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t);
-  unsigned char buffer[bytes_to_read];
-  if (read_from_socket_close_on_error(socket, bytes_to_read, buffer)) {
-    // Read failed, which means the socket has been closed between reading the
-    // message ID byte and here.
+static int read_compressed_payload(int* socket, unsigned char* payload, size_t length) {
+  unsigned char buffer[sizeof(uint32_t)];
+  if (read_from_socket_close_on_error(socket, sizeof(uint32_t), buffer)) {
+    return -1;
+  }
+  size_t compressed_length = extract_uint32(buffer);
+  unsigned char* compressed = network_buffer_new(compressed_length);
+  if (read_from_socket_close_on_error(socket, compressed_length, compressed)) {
+    network_buffer_free(compressed, compressed_length);
     return -1;
   }
+  if (lz_block_decompress(compressed, compressed_length, payload, length) != 0) {
+    lf_print_error_and_exit("Received a compressed message that does not decompress to %zu bytes.", length);
+  }
+  network_buffer_free(compressed, compressed_length);
+  return 0;
+}
 
-  // Extract the header information.
-  unsigned short port_id;
-  unsigned short federate_id;
-  size_t length;
+/**
+ * Create a token for a network input port whose type deserializes its values (@see token_type_t),
+ * with a value of one element that is deserialized from the specified bytes.
+ * @param type The type of the port.
+ * @param bytes The serialized value.
+ * @param length The number of bytes.
+ */
+static lf_token_t* deserialize_token(token_type_t* type, const unsigned char* bytes, size_t length) {
+  lf_token_t* token = _lf_new_token_with_payload(type, 1);
+  if (type->deserialize_from(bytes, length, token->value) != 0) {
+    lf_print_error_and_exit("Received a message of %zu bytes that cannot be deserialized.", length);
+  }
+  return token;
+}
+
+/**
+ * Read the payload of a message, which follows its header, into a new token for a network input port.
+ * If the type of the port deserializes its values, the value is deserialized straight out of the
+ * receive buffer of the thread if the whole payload is in it. Otherwise, the payload is read directly
+ * into the value of the token.
+ * @param socket Pointer to the socket to read the payload from.
+ * @param action The action of the port.
+ * @param length The length of the payload, uncompressed.
+ * @param compressed Whether the payload is compressed (@see read_compressed_payload()).
+ * @return The token, or NULL if the socket was closed.
+ */
+static lf_token_t* read_payload_into_token(int* socket, lf_action_base_t* action, size_t length, bool compressed) {
+  token_type_t* type = (token_type_t*)action;
+  if (type->deserialize_from == NULL) {
+    lf_token_t* token = _lf_new_token_with_payload(type, length);
+    int read_failed = compressed ? read_compressed_payload(socket, (unsigned char*)token->value, length)
+                                 : read_from_socket_close_on_error(socket, length, (unsigned char*)token->value);
+    if (read_failed) {
+      _lf_free_token(token);
+      return NULL;
+    }
+    return token;
+  }
+  unsigned char* bytes = compressed ? NULL : take_buffered_bytes_from_socket(*socket, length);
+  unsigned char* allocated = NULL;
+  size_t allocated_length = length > 0 ? length : 1;
+  if (bytes == NULL) {
+    bytes = allocated = network_buffer_new(allocated_length);
+    int read_failed = compressed ? read_compressed_payload(socket, allocated, length)
+                                 : read_from_socket_close_on_error(socket, length, allocated);
+    if (read_failed) {
+      network_buffer_free(allocated, allocated_length);
+      return NULL;
+    }
+  }
+  lf_token_t* token = deserialize_token(type, bytes, length);
+  network_buffer_free(allocated, allocated_length);
+  return token;
+}
+
+/**
+ * Handle a message being received from a remote federate.
+ *
+ * This function assumes the caller does not hold the mutex lock.
+ * @param socket Pointer to the socket to read the message from.
+ * @param fed_id The sending federate ID or -1 if the centralized coordination.
+ * @return 0 for success, -1 for failure.
+ */
+static int handle_message(int* socket, int fed_id) {
+  (void)fed_id;
+  // Read the header.
+  size_t bytes_to_read = sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t);
+  unsigned char buffer[bytes_to_read];
+  if (read_from_socket_close_on_error(socket, bytes_to_read, buffer)) {
+    // Read failed, which means the socket has been closed between reading the
+    // message ID byte and here.
+    return -1;
+  }
+
+  // Extract the header information.
+  unsigned short port_id;
+  unsigned short federate_id;
+  size_t length;
   extract_header(buffer, &port_id, &federate_id, &length);
   // Check if the message is intended for this federate
   assert(_lf_my_fed_id == federate_id);
@@ -473,21 +1291,345 @@ static int handle_message(int* socket, int fed_id) {
   // Get the triggering action for the corresponding port
   lf_action_base_t* action = action_for_port(port_id);
 
-  // Read the payload.
-  // Allocate memory for the message contents.
-  unsigned char* message_contents = (unsigned char*)malloc(length);
-  if (read_from_socket_close_on_error(socket, length, message_contents)) {
+  lf_token_t* message_token = read_payload_into_token(socket, action, length, false);
+  if (message_token == NULL) {
     return -1;
   }
   // Trace the event when tracing is enabled
   tracepoint_federate_from_federate(receive_P2P_MSG, _lf_my_fed_id, federate_id, NULL);
-  LF_PRINT_LOG("Message received by federate: %s. Length: %zu.", message_contents, length);
+  LF_PRINT_LOG("Message received by federate: %s. Length: %zu.", (char*)message_token->value, length);
 
   LF_PRINT_DEBUG("Calling schedule for message received on a physical connection.");
-  lf_schedule_value(action, 0, message_contents, length);
+  lf_schedule_token(action, 0, message_token);
   return 0;
 }
 
+/**
+ * Handle a message on a physical connection that was received as a datagram (@see P2P_OPTION_DATAGRAMS).
+ * Datagrams that are malformed, that are from a federate that has not been allowed to send them,
+ * or that are not newer than the last one received from the same federate are dropped.
+ * This is called only by the thread listening for datagrams.
+ * @param datagram The datagram.
+ * @param length The length of the datagram.
+ */
+static void handle_datagram(unsigned char* datagram, size_t length) {
+  const size_t header_length = 1 + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t);
+  if (length < P2P_DATAGRAM_HEADER_LENGTH + header_length ||
+      datagram[P2P_DATAGRAM_HEADER_LENGTH] != MSG_TYPE_P2P_MESSAGE) {
+    LF_PRINT_DEBUG("Ignoring a malformed datagram.");
+    return;
+  }
+  uint16_t sender = extract_uint16(datagram);
+  uint32_t sequence = extract_uint32(&datagram[sizeof(uint16_t)]);
+  uint16_t port_id;
+  uint16_t federate_id;
+  size_t message_length;
+  extract_header(&datagram[P2P_DATAGRAM_HEADER_LENGTH + 1], &port_id, &federate_id, &message_length);
+  if (sender >= NUMBER_OF_FEDERATES || !datagram_senders[sender] || federate_id != _lf_my_fed_id ||
+      port_id >= _lf_action_table_size || !_lf_action_table[port_id]->trigger->is_physical ||
+      message_length != length - P2P_DATAGRAM_HEADER_LENGTH - header_length) {
+    LF_PRINT_DEBUG("Ignoring an unexpected datagram.");
+    return;
+  }
+  int32_t distance = (int32_t)(sequence - inbound_datagram_sequences[sender]);
+  if (distance <= 0) {
+    datagrams_dropped++;
+    LF_PRINT_DEBUG("Dropping datagram %u from federate %d, which is not newer than datagram %u.", sequence, sender,
+                   inbound_datagram_sequences[sender]);
+    return;
+  }
+  datagrams_received++;
+  datagrams_missed += (size_t)(distance - 1);
+  inbound_datagram_sequences[sender] = sequence;
+
+  lf_action_base_t* action = _lf_action_table[port_id];
+  unsigned char* payload = &datagram[P2P_DATAGRAM_HEADER_LENGTH + header_length];
+  lf_token_t* message_token;
+  if (((token_type_t*)action)->deserialize_from != NULL) {
+    message_token = deserialize_token((token_type_t*)action, payload, message_length);
+  } else {
+    message_token = _lf_new_token_with_payload((token_type_t*)action, message_length);
+    memcpy(message_token->value, payload, message_length);
+  }
+  // Trace the event when tracing is enabled
+  tracepoint_federate_from_federate(receive_P2P_MSG, _lf_my_fed_id, sender, NULL);
+  LF_PRINT_LOG("Datagram %u received from federate %d. Length: %zu.", sequence, sender, message_length);
+  lf_schedule_token(action, 0, message_token);
+}
+
+/**
+ * Thread listening for datagrams on _fed.datagram_socket until lf_terminate_execution() closes it.
+ * @param socket_arg The socket, cast to void*.
+ */
+static void* listen_to_datagrams(void* socket_arg) {
+  initialize_lf_thread_id();
+  int socket = (int)(intptr_t)socket_arg;
+  unsigned char* datagram = network_buffer_new(MAX_DATAGRAM_LENGTH);
+  while (true) {
+    ssize_t bytes = recv(socket, datagram, MAX_DATAGRAM_LENGTH, 0);
+    if (_fed.datagram_socket < 0) {
+      break; // The socket has been shut down.
+    }
+    if (bytes < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+      lf_print_error("Failed to receive datagrams: %s. No more datagrams will be received.", strerror(errno));
+      break;
+    }
+    if (bytes > 0) {
+      handle_datagram(datagram, (size_t)bytes);
+    }
+  }
+  network_buffer_free(datagram, MAX_DATAGRAM_LENGTH);
+  return NULL;
+}
+
+/**
+ * Allow the specified federate to send datagrams to this federate, creating the UDP socket
+ * on which they are received and the thread listening to it if they do not exist yet.
+ * This is called only by the thread accepting connections from other federates.
+ * @param fed_id The ID of the federate.
+ * @return The UDP port to which to send the datagrams, or 0 if the socket could not be created.
+ */
+static uint16_t accept_datagrams_from(uint16_t fed_id) {
+  static uint16_t port = 0;
+  if (_fed.datagram_socket < 0) {
+    int socket = create_UDP_socket(&port);
+    if (socket < 0) {
+      lf_print_warning("Failed to create a UDP socket for datagrams: %s. Messages will be sent over TCP.",
+                       strerror(errno));
+      return 0;
+    }
+    _fed.datagram_socket = socket;
+    if (lf_thread_create(&_fed.datagram_listener, listen_to_datagrams, (void*)(intptr_t)socket) != 0) {
+      lf_print_error_and_exit("Failed to create a thread to listen for datagrams.");
+    }
+    LF_PRINT_LOG("Receiving datagrams on UDP port %u.", port);
+  }
+  datagram_senders[fed_id] = true;
+  return port;
+}
+
+#ifdef LF_FEDERATED_OPTIMISTIC
+/** @brief A tag that is executed speculatively, to the start of which execution can roll back. */
+typedef struct speculation_t {
+  lf_checkpoint_memory_t checkpoint; // Taken at the start of the tag, which is its tag.
+  tag_t previous;                    // The tag completed before it, which is current after a rollback to it.
+} speculation_t;
+
+/** @brief An event from outside the federate that has been handled at a tag that may be rolled back. */
+typedef struct handled_event_t {
+  trigger_t* trigger;
+  tag_t tag;          // The tag at which it was handled.
+  tag_t intended_tag; // The intended tag of a message, or NEVER_TAG.
+  lf_token_t* token;  // The payload, of which a reference is held.
+} handled_event_t;
+
+/** @brief A message to another federate that is held until the tag at which it was sent is committed. */
+typedef struct held_message_t {
+  struct held_message_t* next;
+  tag_t tag;             // The tag at which it was sent.
+  size_t destination;    // The ID of the destination federate, or NUMBER_OF_FEDERATES for the RTI.
+  int* socket;           // The socket to send it on.
+  size_t size;           // The number of bytes of the header and the payload.
+  unsigned char bytes[]; // The header, followed by the payload.
+} held_message_t;
+
+/**
+ * The speculative tags that have not been committed, oldest first, as a ring. These and the other
+ * variables of the speculation that are not said otherwise are protected by the mutex of the
+ * top-level environment.
+ */
+static speculation_t speculations[LF_FEDERATED_OPTIMISTIC];
+static size_t first_speculation = 0;
+static size_t num_speculations = 0;
+
+/** The earliest tag of the stragglers that arrived since the last rollback, or FOREVER if there is none. */
+static tag_t straggler_tag = {.time = FOREVER, .microstep = 0u};
+
+/** Whether speculation has stopped because the state of the federate could not be saved. */
+static bool speculation_disabled = false;
+
+/** For each network input port, the latest tag at which its status is known from the messages received on it. */
+static tag_t* confirmed_tags = NULL;
+
+/** The events from outside the federate that have been handled at speculative tags. */
+static handled_event_t* handled_events = NULL;
+static size_t num_handled_events = 0;
+static size_t handled_events_capacity = 0;
+
+/** Broadcast, with the mutex of the top-level environment, when `speculation_changes` is incremented. */
+static lf_cond_t speculation_changed;
+
+/** The number of times that a tag has been speculated, committed, confirmed or found to be rolled back. */
+static size_t speculation_changes = 0;
+
+/** Counts of the tags that have been speculated and of the rollbacks, which are logged at the end. */
+static size_t speculated_tags = 0;
+static size_t rollbacks = 0;
+
+/** Protects the held messages and `final_tag`, which are used by the threads that send messages. */
+static lf_mutex_t held_mutex;
+
+/** The messages held, in the order in which they were sent. */
+static held_message_t* held_messages = NULL;
+static held_message_t** held_messages_end = &held_messages;
+
+/**
+ * The latest tag that will not be rolled back, or FOREVER while no tag is speculative. It is
+ * changed with both `held_mutex` and the mutex of the top-level environment held.
+ */
+static tag_t final_tag = {.time = FOREVER, .microstep = 0u};
+
+/** The latest tag completed, which is reported to the RTI once it is final. */
+static tag_t completed_tag = {.time = NEVER, .microstep = 0u};
+
+/** @brief Wake up the threads that wait for the speculation to change. */
+static void notify_speculation_changed_locked(void) {
+  speculation_changes++;
+  lf_cond_broadcast(&speculation_changed);
+}
+
+/**
+ * @brief Return whether the current tag is speculative, so that unknown ports are assumed absent without waiting.
+ * @param env The top-level environment, whose mutex is held.
+ */
+static bool speculating_locked(environment_t* env) {
+  if (num_speculations == 0) {
+    return false;
+  }
+  speculation_t* newest = &speculations[(first_speculation + num_speculations - 1) % LF_FEDERATED_OPTIMISTIC];
+  return lf_tag_compare(newest->checkpoint.tag, env->current_tag) == 0;
+}
+
+/**
+ * @brief Record that the status of a network input port is known at a tag from a message received on it.
+ * The caller must hold the mutex of the top-level environment.
+ * @param port_id The ID of the port.
+ * @param tag The tag of the message.
+ */
+static void confirm_port_status_locked(int port_id, tag_t tag) {
+  if (confirmed_tags != NULL && lf_tag_compare(tag, confirmed_tags[port_id]) > 0) {
+    confirmed_tags[port_id] = tag;
+    if (num_speculations > 0) {
+      notify_speculation_changed_locked();
+    }
+  }
+}
+
+/**
+ * @brief Record an event from outside the federate that is handled at a tag that may be rolled back,
+ * so that it is handled again after a rollback.
+ * The caller must hold the mutex of the top-level environment.
+ * @param trigger The trigger of the event.
+ * @param tag The tag at which it is handled.
+ * @param intended_tag The intended tag of a message, or NEVER_TAG.
+ * @param token The payload, or NULL.
+ */
+static void record_handled_event_locked(trigger_t* trigger, tag_t tag, tag_t intended_tag, lf_token_t* token) {
+  if (num_handled_events == handled_events_capacity) {
+    handled_events_capacity = handled_events_capacity > 0 ? 2 * handled_events_capacity : 16;
+    handled_events = (handled_event_t*)realloc(handled_events, handled_events_capacity * sizeof(handled_event_t));
+    LF_ASSERT_NON_NULL(handled_events);
+  }
+  if (token != NULL) {
+    _lf_token_add_reference(token);
+  }
+  handled_events[num_handled_events++] =
+      (handled_event_t){.trigger = trigger, .tag = tag, .intended_tag = intended_tag, .token = token};
+}
+
+/**
+ * @brief If a message arrived for a tag that has been executed speculatively, record it and request
+ * a rollback to before that tag.
+ * The caller must hold the mutex of the top-level environment.
+ * @param env The top-level environment.
+ * @param trigger The trigger of the network input port.
+ * @param intended_tag The tag of the message.
+ * @param token The payload of the message.
+ * @return true if the message is a straggler, which is handled at its tag after the rollback.
+ */
+static bool roll_back_for_message_locked(environment_t* env, trigger_t* trigger, tag_t intended_tag,
+                                         lf_token_t* token) {
+  if (num_speculations == 0 || lf_tag_compare(intended_tag, env->current_tag) > 0 ||
+      lf_tag_compare(intended_tag, final_tag) <= 0) {
+    return false;
+  }
+  LF_PRINT_LOG("Received a message with tag " PRINTF_TAG " after executing speculatively up to tag " PRINTF_TAG ".",
+               intended_tag.time - start_time, intended_tag.microstep, env->current_tag.time - start_time,
+               env->current_tag.microstep);
+  record_handled_event_locked(trigger, intended_tag, intended_tag, token);
+  if (lf_tag_compare(intended_tag, straggler_tag) < 0) {
+    straggler_tag = intended_tag;
+  }
+  notify_speculation_changed_locked();
+  return true;
+}
+
+/**
+ * @brief Return whether messages to other federates are held, which they are at a speculative tag
+ * and while earlier messages are held, which must be sent first.
+ * The caller must hold `held_mutex`.
+ * @param env The top-level environment.
+ */
+static bool holds_messages_locked(environment_t* env) {
+  return held_messages != NULL || lf_tag_compare(env->current_tag, final_tag) > 0;
+}
+
+/**
+ * @brief Hold a message, given as its header and its payload, as send_tagged_message_locked() would send it.
+ * The caller must hold `held_mutex`.
+ * @param env The top-level environment.
+ * @param socket Pointer to the socket to send it on.
+ * @param destination The ID of the destination federate, or NUMBER_OF_FEDERATES for the RTI.
+ * @param header_length The length of the header.
+ * @param header The header.
+ * @param length The length of the payload.
+ * @param message The payload, or NULL if it is serialized from the value.
+ * @param type The type of the value, if the payload is serialized from it (@see token_type_t), or NULL.
+ * @param value The value, if the payload is serialized from it.
+ */
+static void append_held_message_locked(environment_t* env, int* socket, size_t destination, size_t header_length,
+                                       unsigned char* header, size_t length, unsigned char* message,
+                                       token_type_t* type, void* value) {
+  held_message_t* held = (held_message_t*)network_buffer_new(sizeof(held_message_t) + header_length + length);
+  held->next = NULL;
+  held->tag = env->current_tag;
+  held->destination = destination;
+  held->socket = socket;
+  held->size = header_length + length;
+  memcpy(held->bytes, header, header_length);
+  if (type != NULL) {
+    type->serialize_into(value, &held->bytes[header_length]);
+  } else if (length > 0) {
+    memcpy(&held->bytes[header_length], message, length);
+  }
+  *held_messages_end = held;
+  held_messages_end = &held->next;
+}
+
+/**
+ * @brief Hold a message if messages to other federates are held (see append_held_message_locked()).
+ * This must be called before the lock of lock_outbound() is acquired.
+ * @return true if the message is held, in which case it is sent once the current tag is committed.
+ */
+static bool hold_message(environment_t* env, int* socket, size_t destination, size_t header_length,
+                         unsigned char* header, size_t length, unsigned char* message, token_type_t* type,
+                         void* value) {
+  LF_MUTEX_LOCK(&held_mutex);
+  bool hold = holds_messages_locked(env);
+  if (hold) {
+    append_held_message_locked(env, socket, destination, header_length, header, length, message, type, value);
+  }
+  LF_MUTEX_UNLOCK(&held_mutex);
+  return hold;
+}
+
+#endif // LF_FEDERATED_OPTIMISTIC
+
+#if defined(FEDERATED_DECENTRALIZED) && defined(LF_ADAPTIVE_STAA)
+// Defined below with the other functions for STAA offsets.
+static void adapt_staa_offset(environment_t* env, int port_id, tag_t intended_tag, instant_t time_of_arrival);
+#endif
+
 /**
  * Handle a tagged message being received from a remote federate via the RTI
  * or directly from other federates.
@@ -502,9 +1644,15 @@ static int handle_message(int* socket, int fed_id) {
  * now or in the past.
  * @param socket Pointer to the socket to read the message from.
  * @param fed_id The sending federate ID or -1 if the centralized coordination.
+ * @param compressed Whether the message is a MSG_TYPE_P2P_COMPRESSED_TAGGED_MESSAGE.
+ * @param notify_pending Whether messages have been put on the event queue without notifying the workers.
+ *  If more bytes are already available on the socket when this message is scheduled, the notification
+ *  is left to the handling of a later message and this is set to true. Otherwise, the workers are
+ *  notified and this is cleared. A listener thread thus wakes up the workers once per batch of messages
+ *  that arrive together, and must call notify_of_scheduled_messages() before it waits for more bytes.
  * @return 0 on successfully reading the message, -1 on failure (e.g. due to socket closed).
  */
-static int handle_tagged_message(int* socket, int fed_id) {
+static int handle_tagged_message(int* socket, int fed_id, bool compressed, bool* notify_pending) {
   // Environment is always the one corresponding to the top-level scheduling enclave.
   environment_t* env;
   _lf_get_environments(&env);
@@ -559,10 +1707,8 @@ static int handle_tagged_message(int* socket, int fed_id) {
                intended_tag.time - start_time, intended_tag.microstep, lf_time_logical_elapsed(env),
                env->current_tag.microstep);
 
-  // Read the payload.
-  // Allocate memory for the message contents.
-  unsigned char* message_contents = (unsigned char*)malloc(length);
-  if (read_from_socket_close_on_error(socket, length, message_contents)) {
+  lf_token_t* message_token = read_payload_into_token(socket, action, length, compressed);
+  if (message_token == NULL) {
 #ifdef FEDERATED_DECENTRALIZED
     _lf_decrement_tag_barrier_locked(env);
 #endif
@@ -570,14 +1716,27 @@ static int handle_tagged_message(int* socket, int fed_id) {
   }
 
   // The following is only valid for string messages.
-  // LF_PRINT_DEBUG("Message received: %s.", message_contents);
+  // LF_PRINT_DEBUG("Message received: %s.", (char*)message_token->value);
+
+  // Whether another message follows, checked before acquiring the mutex because it may take a system call.
+  unsigned char next_byte;
+  bool more_bytes = peek_from_socket(*socket, &next_byte) == 1;
 
   LF_MUTEX_LOCK(&env->mutex);
 
+#ifdef FEDERATED_CENTRALIZED
+  // The RTI has lowered its record of the NET of this federate if it is later than the message.
+  _fed.last_sent_NET = NEVER_TAG;
+#endif
+
   action->trigger->physical_time_of_arrival = time_of_arrival;
 
-  // Create a token for the message
-  lf_token_t* message_token = _lf_new_token((token_type_t*)action, message_contents, length);
+#if defined(FEDERATED_DECENTRALIZED) && defined(LF_ADAPTIVE_STAA)
+  adapt_staa_offset(env, port_id, intended_tag, time_of_arrival);
+#endif
+#ifdef LF_FEDERATED_OPTIMISTIC
+  confirm_port_status_locked(port_id, intended_tag);
+#endif
 
   if (handle_message_now(env, action->trigger, intended_tag)) {
     // Since the message is intended for the current tag and a port absent reaction
@@ -594,6 +1753,11 @@ static int handle_tagged_message(int* socket, int fed_id) {
     // of the trigger.
     action->trigger->intended_tag = intended_tag;
 
+#ifdef LF_FEDERATED_OPTIMISTIC
+    if (num_speculations > 0) {
+      record_handled_event_locked(action->trigger, intended_tag, intended_tag, message_token);
+    }
+#endif
     // This will mark the STP violation in the reaction if the message is tardy.
     _lf_insert_reactions_for_trigger(env, action->trigger, message_token);
 
@@ -602,6 +1766,11 @@ static int handle_tagged_message(int* socket, int fed_id) {
     // that is because the network receiver reaction is now in the reaction queue
     // keeping the precedence order intact.
     set_network_port_status(port_id, present);
+#ifdef LF_FEDERATED_OPTIMISTIC
+  } else if (roll_back_for_message_locked(env, action->trigger, intended_tag, message_token)) {
+    // Execution has speculated past the tag of the message, and rolls back to handle it at that tag.
+    *notify_pending = true;
+#endif
   } else {
     // If no port absent reaction is waiting for this message, or if the intended
     // tag is in the future, or the message is tardy, use schedule functions to process the message.
@@ -640,9 +1809,17 @@ static int handle_tagged_message(int* socket, int fed_id) {
       // Need to use intended_tag here, not actual_tag, so that STP violations are detected.
       // It will become actual_tag (that is when the reactions will be invoked).
       schedule_message_received_from_network_locked(env, action->trigger, intended_tag, message_token);
+      *notify_pending = true;
     }
   }
 
+  if (*notify_pending && !more_bytes) {
+    // Notify the main thread in case it is waiting for physical time to elapse.
+    LF_PRINT_DEBUG("Broadcasting notification that event queue changed.");
+    _lf_notify_event_q_changed_locked(env, true);
+    *notify_pending = false;
+  }
+
 #ifdef FEDERATED_DECENTRALIZED
   // Only applicable for federated programs with decentralized coordination
   // Finally, decrement the barrier to allow the execution to continue
@@ -696,6 +1873,70 @@ static int handle_port_absent_message(int* socket, int fed_id) {
 
   LF_MUTEX_LOCK(&env->mutex);
   update_last_known_status_on_input_port(env, intended_tag, port_id);
+#ifdef LF_FEDERATED_OPTIMISTIC
+  confirm_port_status_locked(port_id, intended_tag);
+#endif
+  LF_MUTEX_UNLOCK(&env->mutex);
+
+  return 0;
+}
+
+/**
+ * Handle a MSG_TYPE_PORT_ABSENT_RANGES message received from a remote federate.
+ * This sets the last known status tag of all the ports in the message and then
+ * notifies the threads waiting for the status of ports once.
+ *
+ * @param socket Pointer to the socket to read the message from
+ * @param fed_id The sending federate ID or -1 if the centralized coordination.
+ * @return 0 for success, -1 for failure to complete the read.
+ */
+static int handle_port_absent_ranges_message(int* socket, int fed_id) {
+  unsigned char buffer[MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE - 1 + PORT_ABSENT_MAX_RANGES * PORT_ABSENT_RANGE_SIZE];
+  size_t header_length = MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE - 1;
+  if (read_from_socket_close_on_error(socket, header_length, buffer)) {
+    return -1;
+  }
+  // The first part of the message is the destination federate_id, but we don't need it.
+  tag_t intended_tag = extract_tag(&buffer[sizeof(uint16_t)]);
+  uint16_t num_ranges = extract_uint16(&buffer[header_length - sizeof(uint16_t)]);
+  if (num_ranges > PORT_ABSENT_MAX_RANGES) {
+    lf_print_error("Received a port absent message with %hu ranges of ports, more than %d.", num_ranges,
+                   PORT_ABSENT_MAX_RANGES);
+    return -1;
+  }
+  unsigned char* ranges = &buffer[header_length];
+  if (read_from_socket_close_on_error(socket, num_ranges * PORT_ABSENT_RANGE_SIZE, ranges)) {
+    return -1;
+  }
+
+  // Trace the event when tracing is enabled
+  if (fed_id == -1) {
+    tracepoint_federate_from_rti(receive_PORT_ABS, _lf_my_fed_id, &intended_tag);
+  } else {
+    tracepoint_federate_from_federate(receive_PORT_ABS, _lf_my_fed_id, fed_id, &intended_tag);
+  }
+  LF_PRINT_LOG("Handling port absent for tag " PRINTF_TAG " for %hu ranges of ports of fed %d.",
+               intended_tag.time - lf_time_start(), intended_tag.microstep, num_ranges, fed_id);
+
+  // Environment is always the one corresponding to the top-level scheduling enclave.
+  environment_t* env;
+  _lf_get_environments(&env);
+
+  LF_MUTEX_LOCK(&env->mutex);
+  bool changed = false;
+  for (uint16_t i = 0; i < num_ranges; i++) {
+    int first_port_id = extract_uint16(&ranges[i * PORT_ABSENT_RANGE_SIZE]);
+    int num_ports = extract_uint16(&ranges[i * PORT_ABSENT_RANGE_SIZE + sizeof(uint16_t)]);
+    for (int port_id = first_port_id; port_id < first_port_id + num_ports; port_id++) {
+      changed |= set_last_known_status_on_input_port(env, intended_tag, port_id);
+#ifdef LF_FEDERATED_OPTIMISTIC
+      confirm_port_status_locked(port_id, intended_tag);
+#endif
+    }
+  }
+  if (changed) {
+    notify_input_port_status_changed();
+  }
   LF_MUTEX_UNLOCK(&env->mutex);
 
   return 0;
@@ -717,6 +1958,7 @@ static int handle_port_absent_message(int* socket, int fed_id) {
 static void* listen_to_federates(void* _args) {
   initialize_lf_thread_id();
   uint16_t fed_id = (uint16_t)(uintptr_t)_args;
+  pin_listener(1 + fed_id);
 
   LF_PRINT_LOG("Listening to federate %d.", fed_id);
 
@@ -727,6 +1969,13 @@ static void* listen_to_federates(void* _args) {
   // because the message will be put into malloc'd memory.
   unsigned char buffer[FED_COM_BUFFER_SIZE];
 
+  // Read the socket in large chunks rather than field by field.
+  socket_receive_buffer_t receive_buffer;
+  start_buffered_reads_from_socket(*socket_id, &receive_buffer);
+
+  // Whether tagged messages have been scheduled without notifying the workers. See handle_tagged_message().
+  bool notify_pending = false;
+
   // Listen for messages from the federate.
   while (1) {
     bool socket_closed = false;
@@ -751,8 +2000,10 @@ static void* listen_to_federates(void* _args) {
       }
       break;
     case MSG_TYPE_P2P_TAGGED_MESSAGE:
+    case MSG_TYPE_P2P_COMPRESSED_TAGGED_MESSAGE:
       LF_PRINT_LOG("Received tagged message from federate %d.", fed_id);
-      if (handle_tagged_message(socket_id, fed_id)) {
+      if (handle_tagged_message(socket_id, fed_id, buffer[0] == MSG_TYPE_P2P_COMPRESSED_TAGGED_MESSAGE,
+                                &notify_pending)) {
         // P2P tagged messages are only used in decentralized coordination, and
         // it is not a fatal error if the socket is closed before the whole message is read.
         // But this thread should exit.
@@ -761,8 +2012,10 @@ static void* listen_to_federates(void* _args) {
       }
       break;
     case MSG_TYPE_PORT_ABSENT:
+    case MSG_TYPE_PORT_ABSENT_RANGES:
       LF_PRINT_LOG("Received port absent message from federate %d.", fed_id);
-      if (handle_port_absent_message(socket_id, fed_id)) {
+      if (buffer[0] == MSG_TYPE_PORT_ABSENT ? handle_port_absent_message(socket_id, fed_id)
+                                            : handle_port_absent_ranges_message(socket_id, fed_id)) {
         // P2P tagged messages are only used in decentralized coordination, and
         // it is not a fatal error if the socket is closed before the whole message is read.
         // But this thread should exit.
@@ -773,6 +2026,11 @@ static void* listen_to_federates(void* _args) {
     default:
       bad_message = true;
     }
+    unsigned char next_byte;
+    if (bad_message || socket_closed || (notify_pending && peek_from_socket(*socket_id, &next_byte) != 1)) {
+      // A batch of tagged messages ended with a message of another type.
+      notify_of_scheduled_messages(&notify_pending);
+    }
     if (bad_message) {
       lf_print_error("Received erroneous message type: %d. Closing the socket.", buffer[0]);
       // Trace the event when tracing is enabled
@@ -790,6 +2048,7 @@ static void* listen_to_federates(void* _args) {
       break; // while loop
     }
   }
+  end_buffered_reads_from_socket();
   return NULL;
 }
 
@@ -803,12 +2062,25 @@ static void* listen_to_federates(void* _args) {
  */
 static void close_outbound_socket(int fed_id, int flag) {
   assert(fed_id >= 0 && fed_id < NUMBER_OF_FEDERATES);
+#ifdef LF_FEDERATED_SEND_QUEUE
+  // The queued messages are written before the socket is closed.
+  close_send_queue((unsigned short)fed_id);
+#endif
   if (_lf_normal_termination) {
     LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+    flush_outbound_batches_locked();
   }
   if (_fed.sockets_for_outbound_p2p_connections[fed_id] >= 0) {
     // Close the socket by sending a FIN packet indicating that no further writes
     // are expected.  Then read until we get an EOF indication.
+#ifdef LF_FEDERATED_RDMA
+    rdma_channel_t* channel = rdma_channel_of_socket(_fed.sockets_for_outbound_p2p_connections[fed_id]);
+    if (channel != NULL && flag >= 0) {
+      // The end of the stream, which the socket signals, must follow the last bytes sent on the channel.
+      rdma_channel_flush(channel);
+    }
+    rdma_detach_socket(_fed.sockets_for_outbound_p2p_connections[fed_id]);
+#endif
     if (flag >= 0) {
       // SHUT_WR indicates no further outgoing messages.
       shutdown(_fed.sockets_for_outbound_p2p_connections[fed_id], SHUT_WR);
@@ -944,6 +2216,145 @@ static void rti_address(const char* hostname, uint16_t port, struct addrinfo** r
   }
 }
 
+#ifdef LF_TIME_TRIGGERED
+/**
+ * Send to the RTI the times at which the periodic timers of this federate fire on a
+ * MSG_TYPE_TIME_TRIGGERED_SCHEDULE message, with a negative hyperperiod if this
+ * federate cannot be time triggered.
+ */
+static void send_time_triggered_schedule(void) {
+  environment_t* env;
+  _lf_get_environments(&env);
+  interval_t hyperperiod = -1;
+  size_t size = 0;
+  interval_t* offsets = NULL;
+  if (fast) {
+    lf_print_warning("This federate cannot be time triggered because it executes in fast mode.");
+  } else if (_fed.min_delay_from_physical_action_to_federate_output >= 0LL) {
+    lf_print_warning("This federate cannot be time triggered because a physical action may lead to an output.");
+  } else {
+    offsets = lf_static_schedule_offsets(env, &hyperperiod, &size);
+    if (hyperperiod < 0 || size > TIME_TRIGGERED_MAX_SLOTS) {
+      lf_print_warning("This federate cannot be time triggered because its timers have no static schedule.");
+      hyperperiod = -1;
+      size = 0;
+    }
+  }
+  size_t length = MSG_TYPE_TIME_TRIGGERED_SCHEDULE_HEADER_SIZE + size * sizeof(int64_t);
+  unsigned char* buffer = network_buffer_new(length);
+  buffer[0] = MSG_TYPE_TIME_TRIGGERED_SCHEDULE;
+  encode_int64(hyperperiod, &buffer[1]);
+  encode_uint32((uint32_t)size, &buffer[1 + sizeof(int64_t)]);
+  for (size_t i = 0; i < size; i++) {
+    encode_int64(offsets[i], &buffer[MSG_TYPE_TIME_TRIGGERED_SCHEDULE_HEADER_SIZE + i * sizeof(int64_t)]);
+  }
+  LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+  write_to_socket_fail_on_error(&_fed.socket_TCP_RTI, length, buffer, &lf_outbound_socket_mutex,
+                                "Failed to send the time-triggered schedule to the RTI.");
+  LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+  network_buffer_free(buffer, length);
+  free(offsets);
+}
+
+/**
+ * Read the MSG_TYPE_TIME_TRIGGERED_SLOTS message that the RTI sends after the start time
+ * and record whether, and at which times, this federate is time triggered.
+ */
+static void receive_time_triggered_slots(void) {
+  unsigned char header[MSG_TYPE_TIME_TRIGGERED_SLOTS_HEADER_SIZE];
+  read_from_socket_fail_on_error(&_fed.socket_TCP_RTI, sizeof(header), header, NULL,
+                                 "Failed to read the time-triggered slots from the RTI.");
+  if (header[0] != MSG_TYPE_TIME_TRIGGERED_SLOTS) {
+    lf_print_error_and_exit("Expected a MSG_TYPE_TIME_TRIGGERED_SLOTS message from the RTI. Got %u (see net_common.h).",
+                            header[0]);
+  }
+  interval_t window = extract_int64(&header[1]);
+  interval_t hyperperiod = extract_int64(&header[1 + sizeof(int64_t)]);
+  uint32_t size = extract_uint32(&header[1 + 2 * sizeof(int64_t)]);
+  if (size > TIME_TRIGGERED_MAX_SLOTS) {
+    lf_print_error_and_exit("Received %u time-triggered slots from the RTI, which is more than %d.", size,
+                            TIME_TRIGGERED_MAX_SLOTS);
+  }
+  unsigned char* slots = network_buffer_new(size * sizeof(int64_t) + 1);
+  _fed.time_triggered_slots = (interval_t*)malloc(size * sizeof(interval_t) + 1);
+  LF_ASSERT_NON_NULL(_fed.time_triggered_slots);
+  read_from_socket_fail_on_error(&_fed.socket_TCP_RTI, size * sizeof(int64_t), slots, NULL,
+                                 "Failed to read the time-triggered slots from the RTI.");
+  for (uint32_t i = 0; i < size; i++) {
+    _fed.time_triggered_slots[i] = extract_int64(&slots[i * sizeof(int64_t)]);
+  }
+  network_buffer_free(slots, size * sizeof(int64_t) + 1);
+  _fed.time_triggered_number_of_slots = size;
+  _fed.time_triggered_hyperperiod = hyperperiod;
+  if (window >= 0 && hyperperiod > 0) {
+    _fed.time_triggered_window = window;
+    lf_print("Time triggered with %u slots per hyperperiod of " PRINTF_TIME " ns and a window of " PRINTF_TIME " ns.",
+             size, hyperperiod, window);
+  } else {
+    LF_PRINT_LOG("The federation is not time triggered. Using tag advance grants.");
+  }
+}
+
+/**
+ * Return the earliest time after `time` at which a message may be sent to this federate
+ * in a time-triggered federation, or FOREVER if there is none.
+ */
+static instant_t next_time_triggered_slot(instant_t time) {
+  size_t size = _fed.time_triggered_number_of_slots;
+  if (size == 0) {
+    return FOREVER;
+  }
+  if (time < start_time) {
+    return start_time + _fed.time_triggered_slots[0];
+  }
+  interval_t offset = (time - start_time) % _fed.time_triggered_hyperperiod;
+  instant_t hyperperiod_start = time - offset;
+  size_t low = 0;
+  size_t high = size;
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    if (_fed.time_triggered_slots[middle] <= offset) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low == size) {
+    return hyperperiod_start + _fed.time_triggered_hyperperiod + _fed.time_triggered_slots[0];
+  }
+  return hyperperiod_start + _fed.time_triggered_slots[low];
+}
+
+/**
+ * In a time-triggered federation, return `tag` if no message may be sent to this federate
+ * at a time up to that of `tag` that has not yet been waited for. Otherwise, wait until physical
+ * time passes the earliest such time by the window and return the last tag at that time, up to
+ * which all messages have then arrived. Return earlier, with the last tag waited for, if an
+ * earlier event appears on the event queue. This assumes the caller holds the environment mutex.
+ * @param env The environment of this federate.
+ * @param tag The tag to advance to.
+ * @param wait_for_reply Whether to wait, or to return `tag` right away.
+ */
+static tag_t time_triggered_advance(environment_t* env, tag_t tag, bool wait_for_reply) {
+  instant_t slot = next_time_triggered_slot(_fed.last_TAG.time);
+  if (tag.time < slot || !wait_for_reply) {
+    return tag;
+  }
+  instant_t wait_until_time = slot + _fed.time_triggered_window;
+  while (lf_time_physical() < wait_until_time) {
+    lf_clock_cond_timedwait(&env->event_q_changed, wait_until_time);
+    if (get_next_event_tag(env).time < slot) {
+      return _fed.last_TAG;
+    }
+  }
+  _fed.last_TAG = (tag_t){.time = slot, .microstep = FOREVER_MICROSTEP};
+  _fed.is_last_TAG_provisional = false;
+  update_last_known_status_on_input_ports(_fed.last_TAG);
+  LF_PRINT_LOG("Advanced past time-triggered slot " PRINTF_TIME ".", slot - start_time);
+  return _fed.last_TAG;
+}
+#endif // LF_TIME_TRIGGERED
+
 /**
  * Send the specified timestamp to the RTI and wait for a response.
  * The specified timestamp should be current physical time of the
@@ -954,6 +2365,9 @@ static void rti_address(const char* hostname, uint16_t port, struct addrinfo** r
  * @return The designated start time for the federate.
  */
 static instant_t get_start_time_from_rti(instant_t my_physical_time) {
+#ifdef LF_TIME_TRIGGERED
+  send_time_triggered_schedule();
+#endif
   // Send the timestamp marker first.
   send_time(MSG_TYPE_TIMESTAMP, my_physical_time);
 
@@ -982,6 +2396,9 @@ static instant_t get_start_time_from_rti(instant_t my_physical_time) {
   tracepoint_federate_from_rti(receive_TIMESTAMP, _lf_my_fed_id, &tag);
   lf_print("Starting timestamp is: " PRINTF_TIME ".", timestamp);
   LF_PRINT_LOG("Current physical time is: " PRINTF_TIME ".", lf_time_physical());
+#ifdef LF_TIME_TRIGGERED
+  receive_time_triggered_slots();
+#endif
 
   return timestamp;
 }
@@ -1029,6 +2446,11 @@ static void handle_tag_advance_grant(void) {
     _fed.is_last_TAG_provisional = false;
     LF_PRINT_LOG("Received Time Advance Grant (TAG): " PRINTF_TAG ".", _fed.last_TAG.time - start_time,
                  _fed.last_TAG.microstep);
+#ifdef LF_METRICS
+    if (_fed.last_sent_NET_physical_time != NEVER && lf_tag_compare(TAG, _fed.last_sent_NET) >= 0) {
+      lf_metrics_net_granted(_fed.last_sent_NET_physical_time);
+    }
+#endif
   } else {
     LF_MUTEX_UNLOCK(&env->mutex);
     lf_print_error("Received a TAG " PRINTF_TAG " that wasn't larger "
@@ -1037,7 +2459,7 @@ static void handle_tag_advance_grant(void) {
     return;
   }
   // Notify everything that is blocked.
-  lf_cond_broadcast(&env->event_q_changed);
+  _lf_notify_event_q_changed_locked(env, true);
 
   LF_MUTEX_UNLOCK(&env->mutex);
 }
@@ -1073,127 +2495,176 @@ static int id_of_action(lf_action_base_t* input_port_action) {
 
 #endif
 
+#ifdef FEDERATED_DECENTRALIZED
+/** The tag at which the pending STAA offsets below were determined. */
+static tag_t staa_tag = {.time = NEVER, .microstep = 0u};
+
+/** The index in `staa_lst` of the first STAA offset that has not yet expired at `staa_tag`. */
+static size_t staa_next = 0;
+
 /**
- * @brief Thread handling setting the known absent status of input ports.
- * For the code-generated array of staa offsets `staa_lst`, which is sorted by STAA offset,
- * wait for physical time to advance to the current time plus the STAA offset,
- * then set the absent status of the input ports associated with the STAA.
- * Then wait for current time to advance and start over.
+ * @brief Return the physical time at which the unknown ports of an STAA record are assumed absent
+ * at a tag.
+ *
+ * The staa_elem is adjusted in the code generator to have subtracted the delay on the connection.
+ * Like wait_until(), this adds the STA offset except at the start time.
+ * @param time The time of the tag, which is usually the current one.
+ * @param staa_elem The STAA record.
  */
-#ifdef FEDERATED_DECENTRALIZED
-static void* update_ports_from_staa_offsets(void* args) {
-  (void)args;
-  initialize_lf_thread_id();
-  if (staa_lst_size == 0)
-    return NULL; // Nothing to do.
-  // NOTE: Using only the top-level environment, which is the one that deals with network
-  // input ports.
-  environment_t* env;
-  _lf_get_environments(&env);
-  LF_MUTEX_LOCK(&env->mutex);
-  while (1) {
-    LF_PRINT_DEBUG("**** (update thread) starting");
-    tag_t tag_when_started_waiting = lf_tag(env);
-    for (size_t i = 0; i < staa_lst_size; ++i) {
-      staa_t* staa_elem = staa_lst[i];
-      // The staa_elem is adjusted in the code generator to have subtracted the delay on the connection.
-      // The list is sorted in increasing order of adjusted STAA offsets.
-      // The wait_until function automatically adds the lf_fed_STA_offset to the wait time.
-      interval_t wait_until_time = env->current_tag.time + staa_elem->STAA;
-      LF_PRINT_DEBUG("**** (update thread) original wait_until_time: " PRINTF_TIME, wait_until_time - lf_time_start());
-
-      // The wait_until call will release the env->mutex while it is waiting.
-      // However, it will not release the env->mutex if the wait time is too small.
-      // At the cost of a small additional delay in deciding a port is absent,
-      // we require a minimum wait time here.  Otherwise, if both the STAA and STA are
-      // zero, this thread will fail to ever release the environment mutex.
-      // This causes chaos.  The MIN_SLEEP_DURATION is the smallest amount of time
-      // that wait_until will actually wait. Note that this strategy does not
-      // block progress of any execution that is actually processing events.
-      // It only slightly delays the decision that an event is absent, and only
-      // if the STAA and STA are extremely small.
-      if (lf_fed_STA_offset + staa_elem->STAA < 5 * MIN_SLEEP_DURATION) {
-        wait_until_time += 5 * MIN_SLEEP_DURATION;
+static instant_t staa_deadline(instant_t time, staa_t* staa_elem) {
+  instant_t deadline = time + (interval_t)staa_elem->STAA;
+  if (deadline != start_time && deadline < FOREVER - lf_fed_STA_offset) {
+    deadline += lf_fed_STA_offset;
+  }
+  // If both the STAA and STA are extremely small, leave a small margin before deciding that a
+  // port is absent, as the thread that used to do this did.
+  if (lf_fed_STA_offset + (interval_t)staa_elem->STAA < 5 * MIN_SLEEP_DURATION) {
+    deadline += 5 * MIN_SLEEP_DURATION;
+  }
+  return deadline;
+}
+
+#if defined(LF_ADAPTIVE_STAA) || defined(LF_FEDERATED_OPTIMISTIC)
+/** For each network input port, the STAA record that it belongs to, or NULL if it has none. */
+static staa_t** staa_of_port = NULL;
+
+#if defined(LF_ADAPTIVE_STAA) && defined(LF_TRACE)
+/** For each network input port with an STAA record, the description under which the offset is traced. */
+static char** staa_descriptions = NULL;
+#endif
+
+/**
+ * @brief Find the STAA record of each network input port, and register the traced offsets.
+ */
+static void initialize_staa_of_port(void) {
+  staa_of_port = (staa_t**)calloc(_lf_action_table_size + 1, sizeof(staa_t*));
+  LF_ASSERT_NON_NULL(staa_of_port);
+#if defined(LF_ADAPTIVE_STAA) && defined(LF_TRACE)
+  staa_descriptions = (char**)calloc(_lf_action_table_size, sizeof(char*));
+  LF_ASSERT_NON_NULL(staa_descriptions);
+#endif
+  for (size_t i = 0; i < staa_lst_size; i++) {
+    staa_t* staa_elem = staa_lst[i];
+#if defined(LF_ADAPTIVE_STAA) && defined(LF_TRACE)
+    char* description = NULL;
+#endif
+    for (size_t j = 0; j < staa_elem->num_actions; j++) {
+      int port_id = id_of_action(staa_elem->actions[j]);
+      if (port_id < 0) {
+        continue;
       }
-      while (a_port_is_unknown(staa_elem)) {
-        LF_PRINT_DEBUG("**** (update thread) waiting until: " PRINTF_TIME, wait_until_time - lf_time_start());
-        if (wait_until(wait_until_time, &lf_port_status_changed)) {
-          if (lf_tag_compare(lf_tag(env), tag_when_started_waiting) != 0) {
-            break;
-          }
-          /* Possibly useful for debugging:
-          tag_t current_tag = lf_tag(env);
-          LF_PRINT_DEBUG("**** (update thread) Assuming absent! " PRINTF_TAG, current_tag.time - lf_time_start(),
-          current_tag.microstep); LF_PRINT_DEBUG("**** (update thread) Lag is " PRINTF_TIME, current_tag.time -
-          lf_time_physical()); LF_PRINT_DEBUG("**** (update thread) Wait until time is " PRINTF_TIME, wait_until_time -
-          lf_time_start());
-          */
-
-          for (size_t j = 0; j < staa_elem->num_actions; ++j) {
-            lf_action_base_t* input_port_action = staa_elem->actions[j];
-            if (input_port_action->trigger->status == unknown) {
-              input_port_action->trigger->status = absent;
-              LF_PRINT_DEBUG("**** (update thread) Assuming port absent at time " PRINTF_TIME,
-                             lf_tag(env).time - start_time);
-              update_last_known_status_on_input_port(env, lf_tag(env), id_of_action(input_port_action));
-              lf_cond_broadcast(&lf_port_status_changed);
-            }
-          }
-        }
-        // If the tag has advanced, start over.
-        if (lf_tag_compare(lf_tag(env), tag_when_started_waiting) != 0)
-          break;
+      staa_of_port[port_id] = staa_elem;
+#if defined(LF_ADAPTIVE_STAA) && defined(LF_TRACE)
+      if (description == NULL) {
+        description = (char*)malloc(32);
+        LF_ASSERT_NON_NULL(description);
+        snprintf(description, 32, "STAA of port %d", port_id);
+        register_user_trace_event(staa_elem, description);
       }
-      // If the tag has advanced, start over.
-      if (lf_tag_compare(lf_tag(env), tag_when_started_waiting) != 0)
-        break;
+      staa_descriptions[port_id] = description;
+#endif
     }
-    // If the tag has advanced, start over.
-    if (lf_tag_compare(lf_tag(env), tag_when_started_waiting) != 0)
-      continue;
+  }
+}
+#endif // LF_ADAPTIVE_STAA || LF_FEDERATED_OPTIMISTIC
 
-    // At this point, the current tag is the same as when we started waiting
-    // and all ports should be known, and hence max_level_allowed_to_advance
-    // should be INT_MAX.  Check this to prevent an infinite wait.
-    if (max_level_allowed_to_advance != INT_MAX) {
-      // If this occurs, then the current tag advanced during a wait.
-      // Some ports may have been reset to uknown during that wait, in which case,
-      // it would be huge mistake to enter the wait for a new tag below because the
-      // program will freeze.  First, check whether any ports are unknown:
-      bool port_unkonwn = false;
-      for (size_t i = 0; i < staa_lst_size; ++i) {
-        staa_t* staa_elem = staa_lst[i];
-        if (a_port_is_unknown(staa_elem)) {
-          port_unkonwn = true;
-          break;
-        }
-      }
-      if (!port_unkonwn) {
-        // If this occurs, then there is a race condition that can lead to deadlocks.
-        lf_print_error_and_exit("**** (update thread) Inconsistency: All ports are known, but MLAA is blocking.");
-      }
+#ifdef LF_ADAPTIVE_STAA
+/**
+ * @brief Adapt the STAA offset of a port to the arrival of a tagged message on it.
+ *
+ * The offset moves up a large step if the message arrived after the offset expired, and down a
+ * small step otherwise (see LF_ADAPTIVE_STAA). `staa_lst` is kept sorted by offset.
+ * The caller must hold the mutex of the top-level environment.
+ * @param env The top-level environment.
+ * @param port_id The ID of the port.
+ * @param intended_tag The tag of the message.
+ * @param time_of_arrival The physical time at which the message arrived.
+ */
+static void adapt_staa_offset(environment_t* env, int port_id, tag_t intended_tag, instant_t time_of_arrival) {
+  staa_t* staa_elem = staa_of_port[port_id];
+  if (staa_elem == NULL || intended_tag.time == NEVER || intended_tag.time == FOREVER) {
+    return;
+  }
+  // The smallest offset with which the port would not have been assumed absent before the message arrived.
+  interval_t needed = time_of_arrival - intended_tag.time - lf_fed_STA_offset;
+  interval_t staa = (interval_t)staa_elem->STAA;
+  interval_t down = (interval_t)((double)LF_ADAPTIVE_STAA_STEP * LF_ADAPTIVE_STAA_TARGET);
+  if (needed > staa) {
+    LF_PRINT_LOG("STP violation on port %d by " PRINTF_TIME " ns raises its STAA offset.", port_id, needed - staa);
+    staa += LF_ADAPTIVE_STAA_STEP - down;
+  } else {
+    staa = (staa > down) ? staa - down : 0;
+  }
+  if (staa == (interval_t)staa_elem->STAA) {
+    return;
+  }
+  staa_elem->STAA = (size_t)staa;
 
-      // Since max_level_allowed_to_advance will block advancement of time, we cannot follow
-      // through to the next step without deadlocking.  Wait some time, then continue.
-      // The wait is necessary to prevent a busy wait.
-      lf_sleep(2 * MIN_SLEEP_DURATION);
+  // Move the record to its place in `staa_lst`, and check the pending offsets again from the first.
+  size_t i = 0;
+  while (staa_lst[i] != staa_elem) {
+    i++;
+  }
+  for (; i > 0 && staa_lst[i - 1]->STAA > staa_elem->STAA; i--) {
+    staa_lst[i] = staa_lst[i - 1];
+  }
+  for (; i + 1 < staa_lst_size && staa_lst[i + 1]->STAA < staa_elem->STAA; i++) {
+    staa_lst[i] = staa_lst[i + 1];
+  }
+  staa_lst[i] = staa_elem;
+  staa_next = 0;
+#ifdef LF_TRACE
+  tracepoint_runtime_value(env, staa_descriptions[port_id], staa);
+#else
+  (void)env;
+#endif
+}
+#endif // LF_ADAPTIVE_STAA
+
+/**
+ * @brief Set absent the unknown input ports whose STAA offset has expired at the current tag.
+ *
+ * The code-generated array `staa_lst` is sorted by STAA offset, so at any tag the pending
+ * offsets are a suffix of it, and only the first of them has to be checked. When the tag
+ * advances, the ports have been reset to unknown, and all offsets are pending again.
+ * This is called by the threads that are stalled waiting for the port statuses, which
+ * replaces a thread dedicated to waking up at each offset.
+ * The caller must hold the mutex of the top-level environment.
+ * @param env The top-level environment.
+ * @return The physical time at which the next pending offset expires, or FOREVER if there is none.
+ */
+static instant_t update_ports_from_staa_offsets(environment_t* env) {
+  if (lf_tag_compare(env->current_tag, staa_tag) != 0) {
+    staa_tag = env->current_tag;
+    staa_next = 0;
+  }
+  instant_t now = lf_time_physical();
+  for (; staa_next < staa_lst_size; staa_next++) {
+    staa_t* staa_elem = staa_lst[staa_next];
+    if (!a_port_is_unknown(staa_elem)) {
       continue;
     }
-
-    // Wait until we progress to a new tag.
-    while (lf_tag_compare(lf_tag(env), tag_when_started_waiting) == 0) {
-      // The following will release the env->mutex while waiting.
-      LF_PRINT_DEBUG("**** (update thread) Waiting for tags to not match: " PRINTF_TAG ", " PRINTF_TAG,
-                     lf_tag(env).time - lf_time_start(), lf_tag(env).microstep,
-                     tag_when_started_waiting.time - lf_time_start(), tag_when_started_waiting.microstep);
-      // Ports are reset to unknown at the start of new tag, so that will wake this up.
-      lf_cond_wait(&lf_port_status_changed);
+    instant_t deadline = staa_deadline(env->current_tag.time, staa_elem);
+    bool wait = !fast && deadline > now;
+#ifdef LF_FEDERATED_OPTIMISTIC
+    // At a speculative tag, the port is assumed absent at once, as execution can roll back.
+    wait = wait && !speculating_locked(env);
+#endif
+    if (wait) {
+      return deadline;
+    }
+    for (size_t j = 0; j < staa_elem->num_actions; ++j) {
+      lf_action_base_t* input_port_action = staa_elem->actions[j];
+      if (input_port_action->trigger->status == unknown) {
+        input_port_action->trigger->status = absent;
+        LF_PRINT_DEBUG("Assuming port absent at time " PRINTF_TIME " because its STAA has expired.",
+                       lf_tag(env).time - start_time);
+        update_last_known_status_on_input_port(env, lf_tag(env), id_of_action(input_port_action));
+        lf_cond_broadcast(&lf_port_status_changed);
+      }
     }
-    LF_PRINT_DEBUG("**** (update thread) Tags after wait: " PRINTF_TAG ", " PRINTF_TAG,
-                   lf_tag(env).time - lf_time_start(), lf_tag(env).microstep,
-                   tag_when_started_waiting.time - lf_time_start(), tag_when_started_waiting.microstep);
   }
-  LF_MUTEX_UNLOCK(&env->mutex);
+  return FOREVER;
 }
 #endif // FEDERATED_DECENTRALIZED
 
@@ -1249,7 +2720,7 @@ static void handle_provisional_tag_advance_grant() {
 
   // Even if we don't modify the event queue, we need to broadcast a change
   // because we do not need to continue to wait for a TAG.
-  lf_cond_broadcast(&env->event_q_changed);
+  _lf_notify_event_q_changed_locked(env, true);
   // Notify level advance thread which is blocked.
   lf_update_max_level(_fed.last_TAG, _fed.is_last_TAG_provisional);
   lf_cond_broadcast(&lf_port_status_changed);
@@ -1339,10 +2810,12 @@ static void handle_stop_granted_message() {
     lf_set_stop_tag(&env[i], received_stop_tag);
     LF_PRINT_DEBUG("Setting the stop tag to " PRINTF_TAG ".", env[i].stop_tag.time - start_time,
                    env[i].stop_tag.microstep);
+    // The RTI has lowered its record of the NET of this federate if it is later than the stop tag.
+    _fed.last_sent_NET = NEVER_TAG;
 
     if (env[i].barrier.requestors)
       _lf_decrement_tag_barrier_locked(&env[i]);
-    lf_cond_broadcast(&env[i].event_q_changed);
+    _lf_notify_event_q_changed_locked(&env[i], true);
     LF_MUTEX_UNLOCK(&env[i].mutex);
   }
 }
@@ -1362,25 +2835,21 @@ static void handle_stop_request_message() {
   LF_PRINT_LOG("Received from RTI a MSG_TYPE_STOP_REQUEST signal with tag " PRINTF_TAG ".",
                tag_to_stop.time - start_time, tag_to_stop.microstep);
 
-  extern lf_mutex_t global_mutex;
-  extern bool lf_stop_requested;
+  extern int32_t lf_stop_requested;
   bool already_blocked = false;
 
-  LF_MUTEX_LOCK(&global_mutex);
-  if (lf_stop_requested) {
+  // Treat the stop request from the RTI as if a local stop request had been received.
+  if (!lf_atomic_bool_compare_and_swap32(&lf_stop_requested, 0, 1)) {
     LF_PRINT_LOG("Ignoring MSG_TYPE_STOP_REQUEST from RTI because lf_request_stop has been called locally.");
     already_blocked = true;
   }
-  // Treat the stop request from the RTI as if a local stop request had been received.
-  lf_stop_requested = true;
-  LF_MUTEX_UNLOCK(&global_mutex);
 
   // If we have previously received from the RTI a stop request,
   // or we have previously sent a stop request to the RTI,
   // then we have already blocked tag advance in enclaves.
   // Do not do this twice. The record of whether the first has occurred
   // is guarded by the outbound socket mutex.
-  // The second is guarded by the global mutex.
+  // The second is recorded atomically in lf_stop_requested.
   // Note that the RTI should not send stop requests more than once to federates.
   LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
   if (_fed.received_stop_request_from_rti) {
@@ -1426,6 +2895,7 @@ static void handle_stop_request_message() {
 
   // Send the current logical time to the RTI.
   LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+  flush_outbound_batches_locked();
   write_to_socket_fail_on_error(&_fed.socket_TCP_RTI, MSG_TYPE_STOP_REQUEST_REPLY_LENGTH, outgoing_buffer,
                                 &lf_outbound_socket_mutex,
                                 "Failed to send the answer to MSG_TYPE_STOP_REQUEST to RTI.");
@@ -1435,6 +2905,73 @@ static void handle_stop_request_message() {
                  tag_to_stop.microstep);
 }
 
+/**
+ * Block tag advancement in every environment at its current tag and send a stop request
+ * for the maximum of these tags to the RTI, on behalf of lf_request_stop().
+ */
+static void send_local_stop_request(void) {
+  // Iterate over scheduling enclaves to find their maximum current tag
+  // and set a barrier for tag advancement for each enclave.
+  tag_t max_current_tag = NEVER_TAG;
+  environment_t* env;
+  int num_environments = _lf_get_environments(&env);
+  for (int i = 0; i < num_environments; i++) {
+    LF_MUTEX_LOCK(&env[i].mutex);
+    if (lf_tag_compare(env[i].current_tag, max_current_tag) > 0) {
+      max_current_tag = env[i].current_tag;
+    }
+    // Set a barrier to prevent the enclave from advancing past the so-far maximum current tag.
+    _lf_increment_tag_barrier_locked(&env[i], max_current_tag);
+    LF_MUTEX_UNLOCK(&env[i].mutex);
+  }
+  // The above code has raised a barrier no greater than max_current_tag.
+  if (lf_send_stop_request_to_rti(max_current_tag) != 0) {
+    // Message was not sent to the RTI.
+    // Decrement the barriers to reverse our previous increment.
+    for (int i = 0; i < num_environments; i++) {
+      LF_MUTEX_LOCK(&env[i].mutex);
+      _lf_decrement_tag_barrier_locked(&env[i]);
+      LF_MUTEX_UNLOCK(&env[i].mutex);
+    }
+  }
+}
+
+/**
+ * Wait until there are bytes to read from the RTI, handling the stop requests handed off
+ * by lf_hand_off_stop_request() in the meantime. With LF_FEDERATED_SPIN_RECEIVE, this busy waits.
+ */
+static void wait_for_rti_or_stop_request(void) {
+  struct pollfd fds[2] = {{.fd = _fed.socket_TCP_RTI, .events = POLLIN},
+                          {.fd = _fed.stop_request_pipe[0], .events = POLLIN}};
+#ifdef LF_FEDERATED_SPIN_RECEIVE
+  int timeout = 0;
+#else
+  int timeout = -1;
+#endif
+  while (true) {
+    int ready = poll(fds, 2, timeout);
+    if (ready == 0) {
+      LF_CPU_RELAX();
+      continue;
+    }
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // Let the read report the problem.
+      return;
+    }
+    // A pending stop request is sent before any message from the RTI is handled.
+    unsigned char request;
+    if ((fds[1].revents & POLLIN) && read(fds[1].fd, &request, 1) == 1) {
+      send_local_stop_request();
+    }
+    if (fds[0].revents != 0) {
+      return;
+    }
+  }
+}
+
 /**
  * Send a resign signal to the RTI.
  */
@@ -1443,6 +2980,7 @@ static void send_resign_signal() {
   unsigned char buffer[bytes_to_write];
   buffer[0] = MSG_TYPE_RESIGN;
   LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+  flush_outbound_batches_locked();
   write_to_socket_fail_on_error(&_fed.socket_TCP_RTI, bytes_to_write, &(buffer[0]), &lf_outbound_socket_mutex,
                                 "Failed to send MSG_TYPE_RESIGN.");
   LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
@@ -1477,11 +3015,20 @@ static void handle_rti_failed_message(void) { exit(1); }
 static void* listen_to_rti_TCP(void* args) {
   (void)args;
   initialize_lf_thread_id();
+  pin_listener(0);
   // Buffer for incoming messages.
   // This does not constrain the message size
   // because the message will be put into malloc'd memory.
   unsigned char buffer[FED_COM_BUFFER_SIZE];
 
+  // Read the socket in large chunks rather than field by field.
+  // This thread is the only one that reads from the RTI from now on.
+  socket_receive_buffer_t receive_buffer;
+  start_buffered_reads_from_socket(_fed.socket_TCP_RTI, &receive_buffer);
+
+  // Whether tagged messages have been scheduled without notifying the workers. See handle_tagged_message().
+  bool notify_pending = false;
+
   // Listen for messages from the federate.
   while (1) {
     // Check whether the RTI socket is still valid
@@ -1489,6 +3036,9 @@ static void* listen_to_rti_TCP(void* args) {
       lf_print_warning("Socket to the RTI unexpectedly closed.");
       return NULL;
     }
+    if (receive_buffer.start == receive_buffer.end) {
+      wait_for_rti_or_stop_request();
+    }
     // Read one byte to get the message type.
     // This will exit if the read fails.
     int read_failed = read_from_socket(_fed.socket_TCP_RTI, 1, buffer);
@@ -1516,7 +3066,7 @@ static void* listen_to_rti_TCP(void* args) {
     }
     switch (buffer[0]) {
     case MSG_TYPE_TAGGED_MESSAGE:
-      if (handle_tagged_message(&_fed.socket_TCP_RTI, -1)) {
+      if (handle_tagged_message(&_fed.socket_TCP_RTI, -1, false, &notify_pending)) {
         // Failures to complete the read of messages from the RTI are fatal.
         lf_print_error_and_exit("Failed to complete the reading of a message from the RTI.");
       }
@@ -1539,6 +3089,12 @@ static void* listen_to_rti_TCP(void* args) {
         lf_print_error_and_exit("Failed to complete the reading of an absent message from the RTI.");
       }
       break;
+    case MSG_TYPE_PORT_ABSENT_RANGES:
+      if (handle_port_absent_ranges_message(&_fed.socket_TCP_RTI, -1)) {
+        // Failures to complete the read of absent messages from the RTI are fatal.
+        lf_print_error_and_exit("Failed to complete the reading of an absent message from the RTI.");
+      }
+      break;
     case MSG_TYPE_FAILED:
       handle_rti_failed_message();
       break;
@@ -1551,6 +3107,11 @@ static void* listen_to_rti_TCP(void* args) {
       // Trace the event when tracing is enabled
       tracepoint_federate_from_rti(receive_UNIDENTIFIED, _lf_my_fed_id, NULL);
     }
+    unsigned char next_byte;
+    if (notify_pending && peek_from_socket(_fed.socket_TCP_RTI, &next_byte) != 1) {
+      // A batch of tagged messages ended with a message of another type.
+      notify_of_scheduled_messages(&notify_pending);
+    }
   }
   return NULL;
 }
@@ -1590,8 +3151,10 @@ static bool bounded_NET(tag_t* tag) {
   if (_fed.min_delay_from_physical_action_to_federate_output >= 0LL && _fed.has_downstream) {
     // There is a physical action upstream of some output from this
     // federate, and there is at least one downstream federate.
-    // Compare the tag to the current physical time.
-    instant_t physical_time = lf_time_physical();
+    // Compare the tag to the current physical time. The tags of physical actions,
+    // which are scheduled by other threads, must not go behind this promise.
+    instant_t physical_time;
+    LF_ASSERTN(lf_clock_gettime_fenced(&physical_time), "Failed to read physical clock.");
     if (physical_time + _fed.min_delay_from_physical_action_to_federate_output < tag->time) {
       // Can only promise up and not including this new time:
       tag->time = physical_time + _fed.min_delay_from_physical_action_to_federate_output - 1L;
@@ -1603,11 +3166,166 @@ static bool bounded_NET(tag_t* tag) {
   return false;
 }
 
+/**
+ * Return the options (@see MSG_TYPE_P2P_SENDING_FED_ID_WITH_OPTIONS) to request for connections to
+ * other federates, creating the UDP socket from which to send datagrams if they are requested.
+ */
+static unsigned char requested_p2p_options() {
+  unsigned char options = 0;
+#ifdef LF_FEDERATED_COMPRESSION_THRESHOLD
+  options |= P2P_OPTION_COMPRESSION;
+#endif
+#ifdef LF_FEDERATED_DATAGRAM_SIZE
+  LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+  if (outbound_datagram_socket < 0) {
+    uint16_t port;
+    outbound_datagram_socket = create_UDP_socket(&port);
+    if (outbound_datagram_socket < 0) {
+      lf_print_warning("Failed to create a UDP socket for datagrams: %s. Messages will be sent over TCP.",
+                       strerror(errno));
+    }
+  }
+  if (outbound_datagram_socket >= 0) {
+    options |= P2P_OPTION_DATAGRAMS;
+  }
+  LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+#endif
+#ifdef LF_FEDERATED_RDMA
+  options |= P2P_OPTION_RDMA;
+#endif
+  return options;
+}
+
+/**
+ * Read the options accepted by a federate, which follow its MSG_TYPE_ACK in response to
+ * MSG_TYPE_P2P_SENDING_FED_ID_WITH_OPTIONS, and record them for the connection to it.
+ * @param socket_id Pointer to the socket connected to the federate.
+ * @param remote_federate_id The ID of the federate.
+ * @param address The IP address of the federate.
+ * @param requested The options requested.
+ * @param rdma_endpoint Where to store the description of the end of the RDMA channel of the
+ *  federate, of P2P_RDMA_ENDPOINT_LENGTH bytes, if it accepts P2P_OPTION_RDMA.
+ * @return The options accepted.
+ */
+static unsigned char read_accepted_p2p_options(int* socket_id, uint16_t remote_federate_id, struct in_addr address,
+                                               unsigned char requested, unsigned char* rdma_endpoint) {
+  unsigned char buffer[sizeof(uint16_t)];
+  read_from_socket_fail_on_error(socket_id, 1, buffer, NULL, "Failed to read the options accepted by federate %d.",
+                                 remote_federate_id);
+  unsigned char accepted = buffer[0] & requested;
+  LF_PRINT_LOG("Federate %d accepted options %u of the connection.", remote_federate_id, accepted);
+#ifdef LF_FEDERATED_COMPRESSION_THRESHOLD
+  compressed_outbound_p2p_connections[remote_federate_id] = (accepted & P2P_OPTION_COMPRESSION) != 0;
+#endif
+  if (accepted & P2P_OPTION_DATAGRAMS) {
+    read_from_socket_fail_on_error(socket_id, sizeof(uint16_t), buffer, NULL,
+                                   "Failed to read the UDP port of federate %d.", remote_federate_id);
+#ifdef LF_FEDERATED_DATAGRAM_SIZE
+    outbound_datagram_addresses[remote_federate_id] = (struct sockaddr_in){
+        .sin_family = AF_INET, .sin_port = htons(extract_uint16(buffer)), .sin_addr = address};
+#endif
+  }
+#ifndef LF_FEDERATED_DATAGRAM_SIZE
+  (void)address; // Suppress unused parameter warning.
+#endif
+  if (accepted & P2P_OPTION_RDMA) {
+    read_from_socket_fail_on_error(socket_id, P2P_RDMA_ENDPOINT_LENGTH, rdma_endpoint, NULL,
+                                   "Failed to read the RDMA endpoint of federate %d.", remote_federate_id);
+  }
+  return accepted;
+}
+
+#ifdef LF_FEDERATED_RDMA
+/**
+ * Connect the sending end of the RDMA channel of a connection to a federate that accepted
+ * P2P_OPTION_RDMA, check that bytes reach the federate through it, and tell the federate whether
+ * the connection uses it. If it does, the I/O of the socket is diverted to the channel.
+ * Otherwise, the channel is freed and the connection uses TCP.
+ * @param socket_id Pointer to the socket connected to the federate.
+ * @param remote_federate_id The ID of the federate.
+ * @param channel The channel.
+ * @param endpoint The description of the end of the channel of the federate.
+ */
+static void use_rdma_channel(int* socket_id, uint16_t remote_federate_id, rdma_channel_t* channel,
+                             const unsigned char* endpoint) {
+  unsigned char works = rdma_channel_connect(channel, *socket_id, endpoint) == 0 && rdma_channel_probe(channel) == 0;
+  write_to_socket_fail_on_error(socket_id, 1, &works, NULL, "Failed to confirm the RDMA channel to federate %d.",
+                                remote_federate_id);
+  LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+  if (works) {
+    rdma_channel_attach(channel);
+  } else {
+    rdma_channel_free(channel);
+  }
+  LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+  LF_PRINT_LOG("The connection to federate %d uses %s.", remote_federate_id, works ? "RDMA" : "TCP");
+}
+
+/**
+ * Free a channel that a connection does not use. This acquires the lf_outbound_socket_mutex.
+ * @param channel The channel, or NULL.
+ */
+static void free_rdma_channel(rdma_channel_t* channel) {
+  LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+  rdma_channel_free(channel);
+  LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+}
+#endif // LF_FEDERATED_RDMA
+
+#ifdef LF_FEDERATED_DATAGRAM_SIZE
+/**
+ * Send a message on a physical connection as a datagram (@see P2P_OPTION_DATAGRAMS).
+ * This acquires the lf_outbound_socket_mutex so that the datagrams are sent in the order of their sequence numbers.
+ * @param federate The ID of the destination federate, which accepts datagrams.
+ * @param next_destination_str The name of the destination (for reporting).
+ * @param header The header of the MSG_TYPE_P2P_MESSAGE.
+ * @param header_length The length of the header.
+ * @param length The length of the message.
+ * @param message The message.
+ * @return 0 if the datagram has been sent, -1 otherwise.
+ */
+static int send_datagram(unsigned short federate, const char* next_destination_str, unsigned char* header,
+                         size_t header_length, size_t length, unsigned char* message) {
+  unsigned char prefix[P2P_DATAGRAM_HEADER_LENGTH];
+  encode_uint16((uint16_t)_lf_my_fed_id, prefix);
+  struct iovec buffers[] = {{.iov_base = prefix, .iov_len = sizeof(prefix)},
+                            {.iov_base = header, .iov_len = header_length},
+                            {.iov_base = message, .iov_len = length}};
+  struct msghdr datagram = {.msg_name = &outbound_datagram_addresses[federate],
+                            .msg_namelen = sizeof(struct sockaddr_in),
+                            .msg_iov = buffers,
+                            .msg_iovlen = 3};
+  LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+  if (_fed.sockets_for_outbound_p2p_connections[federate] < 0) {
+    // The connection to the federate has been closed.
+    LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+    return -1;
+  }
+  encode_uint32(++outbound_datagram_sequences[federate], &prefix[sizeof(uint16_t)]);
+  // Trace the event when tracing is enabled
+  tracepoint_federate_to_federate(send_P2P_MSG, _lf_my_fed_id, federate, NULL);
+  ssize_t result = sendmsg(outbound_datagram_socket, &datagram, 0);
+  LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+  if (result < 0) {
+    lf_print_warning("Failed to send a datagram to %s: %s. Dropping the message.", next_destination_str,
+                     strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+#endif // LF_FEDERATED_DATAGRAM_SIZE
+
 //////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 // Public functions (declared in reactor.h)
 // An empty version of this function is code generated for unfederated execution.
 
+#ifdef LF_FEDERATED_OPTIMISTIC
+// Defined below with the other functions for optimistic execution.
+static void start_speculation(environment_t* env);
+static void stop_speculation(environment_t* env);
+#endif
+
 /**
  * Close sockets used to communicate with other federates, if they are open,
  * and send a MSG_TYPE_RESIGN message to the RTI. This implements the function
@@ -1618,6 +3336,12 @@ static bool bounded_NET(tag_t* tag) {
 void lf_terminate_execution(environment_t* env) {
   assert(env != GLOBAL_ENVIRONMENT);
 
+  LF_PRINT_LOG("NETs to the RTI: %zu sent, %zu coalesced, %zu suppressed.", _fed.NETs_sent, _fed.NETs_coalesced,
+               _fed.NETs_suppressed);
+#ifdef LF_FEDERATED_OPTIMISTIC
+  stop_speculation(env);
+#endif
+
   // For an abnormal termination (e.g. a SIGINT), we need to send a
   // MSG_TYPE_FAILED message to the RTI, but we should not acquire a mutex.
   if (_fed.socket_TCP_RTI >= 0) {
@@ -1638,6 +3362,23 @@ void lf_terminate_execution(environment_t* env) {
     _fed.sockets_for_inbound_p2p_connections[i] = -1;
   }
 
+  if (_fed.datagram_socket >= 0) {
+    // Shutting down the socket wakes up the thread listening for datagrams, which then sees that it is closed.
+    int datagram_socket = _fed.datagram_socket;
+    _fed.datagram_socket = -1;
+    shutdown(datagram_socket, SHUT_RDWR);
+    lf_thread_join(_fed.datagram_listener, NULL);
+    close(datagram_socket);
+    LF_PRINT_LOG("Datagrams from other federates: %zu received, %zu missed, %zu dropped out of order.",
+                 datagrams_received, datagrams_missed, datagrams_dropped);
+  }
+#ifdef LF_FEDERATED_DATAGRAM_SIZE
+  if (outbound_datagram_socket >= 0) {
+    close(outbound_datagram_socket);
+    outbound_datagram_socket = -1;
+  }
+#endif
+
   // Check for all outgoing physical connections in
   // _fed.sockets_for_outbound_p2p_connections and
   // if the socket ID is not -1, the connection is still open.
@@ -1665,6 +3406,12 @@ void lf_terminate_execution(environment_t* env) {
   LF_PRINT_DEBUG("Waiting for RTI's socket listener threads.");
   // Wait for the thread listening for messages from the RTI to close.
   lf_thread_join(_fed.RTI_socket_listener, NULL);
+  if (_fed.stop_request_pipe[0] >= 0) {
+    close(_fed.stop_request_pipe[0]);
+    close(_fed.stop_request_pipe[1]);
+    _fed.stop_request_pipe[0] = -1;
+    _fed.stop_request_pipe[1] = -1;
+  }
 
   // For abnormal termination, there is no need to free memory.
   if (_lf_normal_termination) {
@@ -1672,71 +3419,171 @@ void lf_terminate_execution(environment_t* env) {
     free(_fed.inbound_socket_listeners);
     free(federation_metadata.rti_host);
     free(federation_metadata.rti_user);
+#ifdef LF_FEDERATED_RDMA
+    // The threads that read from the channels have exited.
+    rdma_free_channels();
+#endif
   }
 }
 
-//////////////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////////////
-// Public functions (declared in federate.h, in alphabetical order)
+/**
+ * @brief Open a connection to the socket server of a remote federate.
+ * If the remote federate runs on this host, connect through its local socket server,
+ * which bypasses the TCP stack, and fall back to TCP if that fails.
+ * @param address The IP address of the remote federate, received from the RTI.
+ * @param port The port of the socket server of the remote federate.
+ * @return The socket ID, or -1 if the connection failed.
+ */
+static int connect_to_federate_server(struct in_addr address, uint16_t port) {
+#ifndef LF_FEDERATED_TCP_ONLY
+  if (is_local_address(address)) {
+    int socket_id = connect_to_local_server_socket(port);
+    if (socket_id >= 0) {
+      LF_PRINT_LOG("Connected through the local socket of the federate on port %d.", port);
+      return socket_id;
+    }
+  }
+#endif
+  // Create an IPv4 socket for TCP (not UDP) communication over IP (0).
+  int socket_id = create_real_time_tcp_socket_errexit();
 
-void lf_connect_to_federate(uint16_t remote_federate_id) {
-  int result = -1;
+  // Server file descriptor.
+  struct sockaddr_in server_fd;
+  // Zero out the server_fd struct.
+  bzero((char*)&server_fd, sizeof(server_fd));
 
-  // Ask the RTI for port number of the remote federate.
-  // The buffer is used for both sending and receiving replies.
-  // The size is what is needed for receiving replies.
-  unsigned char buffer[sizeof(int32_t) + INET_ADDRSTRLEN + 1];
-  int port = -1;
-  struct in_addr host_ip_addr;
-  instant_t start_connect = lf_time_physical();
-  while (port == -1 && !_lf_termination_executed) {
-    buffer[0] = MSG_TYPE_ADDRESS_QUERY;
-    // NOTE: Sending messages in little endian.
-    encode_uint16(remote_federate_id, &(buffer[1]));
+  // Set up the server_fd fields.
+  server_fd.sin_family = AF_INET; // IPv4
+  server_fd.sin_addr = address;   // Received from the RTI
 
-    LF_PRINT_DEBUG("Sending address query for federate %d.", remote_federate_id);
-    // Trace the event when tracing is enabled
-    tracepoint_federate_to_rti(send_ADR_QR, _lf_my_fed_id, NULL);
+  // Convert the port number from host byte order to network byte order.
+  server_fd.sin_port = htons(port);
+  if (connect(socket_id, (struct sockaddr*)&server_fd, sizeof(server_fd)) != 0) {
+    close(socket_id);
+    return -1;
+  }
+  return socket_id;
+}
+
+/**
+ * @brief Wait for and accept a connection request on the socket server of this federate
+ * or on its local socket server.
+ * @return The socket ID, or -1 with errno set if accepting failed.
+ */
+static int accept_federate_connection() {
+  int server_socket = _fed.server_socket;
+  if (_fed.local_server_socket >= 0) {
+    struct pollfd servers[2] = {{.fd = _fed.server_socket, .events = POLLIN},
+                                {.fd = _fed.local_server_socket, .events = POLLIN}};
+    if (poll(servers, 2, -1) < 0) {
+      return -1;
+    }
+    if (servers[1].revents & POLLIN) {
+      server_socket = _fed.local_server_socket;
+    }
+  }
+  return accept(server_socket, NULL, NULL);
+}
 
+/**
+ * Ask the RTI for the addresses of the specified federates. The queries for all of them are sent
+ * before any reply is read, so that they take one round trip to the RTI rather than one each.
+ * The queries that the RTI cannot answer yet, because the federate has not yet sent its
+ * MSG_TYPE_ADDRESS_ADVERTISEMENT, are sent again after ADDRESS_QUERY_RETRY_INTERVAL.
+ * This exits if the addresses are not all known within CONNECT_TIMEOUT.
+ * It must be called before the thread listening to the RTI is started.
+ * @param remote_federate_ids The IDs of the federates.
+ * @param num_federates The number of federates.
+ * @param hosts Where to put the IP address of each federate.
+ * @param ports Where to put the port of the socket server of each federate.
+ * @return false if execution terminated before all addresses were known.
+ */
+static bool query_federate_addresses(const uint16_t* remote_federate_ids, size_t num_federates, struct in_addr* hosts,
+                                     uint16_t* ports) {
+  if (num_federates == 0) {
+    return true;
+  }
+  bool pending[num_federates];
+  for (size_t i = 0; i < num_federates; i++) {
+    pending[i] = true;
+  }
+  size_t num_pending = num_federates;
+  instant_t start_connect = lf_time_physical();
+  while (num_pending > 0 && !_lf_termination_executed) {
+    unsigned char queries[num_pending * (1 + sizeof(uint16_t))];
+    size_t length = 0;
+    for (size_t i = 0; i < num_federates; i++) {
+      if (pending[i]) {
+        queries[length] = MSG_TYPE_ADDRESS_QUERY;
+        // NOTE: Sending messages in little endian.
+        encode_uint16(remote_federate_ids[i], &queries[length + 1]);
+        length += 1 + sizeof(uint16_t);
+        LF_PRINT_DEBUG("Sending address query for federate %d.", remote_federate_ids[i]);
+        // Trace the event when tracing is enabled
+        tracepoint_federate_to_rti(send_ADR_QR, _lf_my_fed_id, NULL);
+      }
+    }
     LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
-    write_to_socket_fail_on_error(&_fed.socket_TCP_RTI, sizeof(uint16_t) + 1, buffer, &lf_outbound_socket_mutex,
-                                  "Failed to send address query for federate %d to RTI.", remote_federate_id);
+    write_to_socket_fail_on_error(&_fed.socket_TCP_RTI, length, queries, &lf_outbound_socket_mutex,
+                                  "Failed to send address queries for %zu federates to RTI.", num_pending);
     LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
 
-    // Read RTI's response.
-    read_from_socket_fail_on_error(&_fed.socket_TCP_RTI, sizeof(int32_t) + 1, buffer, NULL,
-                                   "Failed to read the requested port number for federate %d from RTI.",
-                                   remote_federate_id);
-
-    if (buffer[0] != MSG_TYPE_ADDRESS_QUERY_REPLY) {
-      // Unexpected reply. Could be that RTI has failed and sent a resignation.
-      if (buffer[0] == MSG_TYPE_FAILED) {
-        lf_print_error_and_exit("RTI has failed.");
-      } else {
-        lf_print_error_and_exit("Unexpected reply of type %hhu from RTI (see net_common.h).", buffer[0]);
+    // The RTI answers the queries in the order in which they were sent.
+    for (size_t i = 0; i < num_federates; i++) {
+      if (!pending[i]) {
+        continue;
+      }
+      unsigned char buffer[1 + sizeof(int32_t)];
+      read_from_socket_fail_on_error(&_fed.socket_TCP_RTI, sizeof(buffer), buffer, NULL,
+                                     "Failed to read the requested port number for federate %d from RTI.",
+                                     remote_federate_ids[i]);
+      if (buffer[0] != MSG_TYPE_ADDRESS_QUERY_REPLY) {
+        // Unexpected reply. Could be that RTI has failed and sent a resignation.
+        if (buffer[0] == MSG_TYPE_FAILED) {
+          lf_print_error_and_exit("RTI has failed.");
+        } else {
+          lf_print_error_and_exit("Unexpected reply of type %hhu from RTI (see net_common.h).", buffer[0]);
+        }
+      }
+      int32_t port = extract_int32(&buffer[1]);
+      read_from_socket_fail_on_error(&_fed.socket_TCP_RTI, sizeof(hosts[i]), (unsigned char*)&hosts[i], NULL,
+                                     "Failed to read the IP address for federate %d from RTI.", remote_federate_ids[i]);
+      // A reply of -1 for the port means that the RTI does not know
+      // the port number of the remote federate, presumably because the
+      // remote federate has not yet sent an MSG_TYPE_ADDRESS_ADVERTISEMENT message to the RTI.
+      if (port != -1) {
+        assert(port < 65536);
+        assert(port > 0);
+        ports[i] = (uint16_t)port;
+        pending[i] = false;
+        num_pending--;
       }
     }
-    port = extract_int32(&buffer[1]);
-
-    read_from_socket_fail_on_error(&_fed.socket_TCP_RTI, sizeof(host_ip_addr), (unsigned char*)&host_ip_addr, NULL,
-                                   "Failed to read the IP address for federate %d from RTI.", remote_federate_id);
-
-    // A reply of -1 for the port means that the RTI does not know
-    // the port number of the remote federate, presumably because the
-    // remote federate has not yet sent an MSG_TYPE_ADDRESS_ADVERTISEMENT message to the RTI.
-    // Sleep for some time before retrying.
-    if (port == -1) {
+    if (num_pending > 0) {
       if (CHECK_TIMEOUT(start_connect, CONNECT_TIMEOUT)) {
-        lf_print_error_and_exit("TIMEOUT obtaining IP/port for federate %d from the RTI.", remote_federate_id);
+        for (size_t i = 0; i < num_federates; i++) {
+          if (pending[i]) {
+            lf_print_error_and_exit("TIMEOUT obtaining IP/port for federate %d from the RTI.", remote_federate_ids[i]);
+          }
+        }
       }
       // Wait ADDRESS_QUERY_RETRY_INTERVAL nanoseconds.
       lf_sleep(ADDRESS_QUERY_RETRY_INTERVAL);
     }
   }
-  assert(port < 65536);
-  assert(port > 0);
-  uint16_t uport = (uint16_t)port;
+  return num_pending == 0;
+}
 
+/**
+ * Connect to the socket server of the specified federate and send it the ID of this federate.
+ * On success, this sets element [remote_federate_id] of _fed.sockets_for_outbound_p2p_connections.
+ * This only uses state that belongs to the connection to the specified federate, so connections
+ * to different federates can be made at the same time.
+ * @param remote_federate_id The ID of the federate.
+ * @param host_ip_addr The IP address of the federate, received from the RTI.
+ * @param uport The port of the socket server of the federate, received from the RTI.
+ */
+static void connect_to_federate_at(uint16_t remote_federate_id, struct in_addr host_ip_addr, uint16_t uport) {
 #if LOG_LEVEL > 3
   // Print the received IP address in a human readable format
   // Create the human readable format of the received address.
@@ -1748,24 +3595,13 @@ void lf_connect_to_federate(uint16_t remote_federate_id) {
 #endif
 
   // Iterate until we either successfully connect or we exceed the CONNECT_TIMEOUT
-  start_connect = lf_time_physical();
+  int result = -1;
+  instant_t start_connect = lf_time_physical();
   int socket_id = -1;
+  unsigned char options = requested_p2p_options();
   while (result < 0 && !_lf_termination_executed) {
-    // Create an IPv4 socket for TCP (not UDP) communication over IP (0).
-    socket_id = create_real_time_tcp_socket_errexit();
-
-    // Server file descriptor.
-    struct sockaddr_in server_fd;
-    // Zero out the server_fd struct.
-    bzero((char*)&server_fd, sizeof(server_fd));
-
-    // Set up the server_fd fields.
-    server_fd.sin_family = AF_INET;    // IPv4
-    server_fd.sin_addr = host_ip_addr; // Received from the RTI
-
-    // Convert the port number from host byte order to network byte order.
-    server_fd.sin_port = htons(uport);
-    result = connect(socket_id, (struct sockaddr*)&server_fd, sizeof(server_fd));
+    socket_id = connect_to_federate_server(host_ip_addr, uport);
+    result = socket_id < 0 ? -1 : 0;
 
     if (result != 0) {
       lf_print_error("Failed to connect to federate %d on port %d.", remote_federate_id, uport);
@@ -1792,9 +3628,23 @@ void lf_connect_to_federate(uint16_t remote_federate_id) {
       lf_sleep(ADDRESS_QUERY_RETRY_INTERVAL);
     } else {
       // Connect was successful.
+      unsigned char requested = options;
+#ifdef LF_FEDERATED_RDMA
+      // The end of the RDMA channel of this connection, which is described to the federate after the options.
+      unsigned char endpoint[P2P_RDMA_ENDPOINT_LENGTH];
+      rdma_channel_t* channel = NULL;
+      if (requested & P2P_OPTION_RDMA) {
+        LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+        channel = rdma_channel_create(false, endpoint);
+        LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+        if (channel == NULL) {
+          requested &= (unsigned char)~P2P_OPTION_RDMA;
+        }
+      }
+#endif
       size_t buffer_length = 1 + sizeof(uint16_t) + 1;
       unsigned char buffer[buffer_length];
-      buffer[0] = MSG_TYPE_P2P_SENDING_FED_ID;
+      buffer[0] = options != 0 ? MSG_TYPE_P2P_SENDING_FED_ID_WITH_OPTIONS : MSG_TYPE_P2P_SENDING_FED_ID;
       if (_lf_my_fed_id > UINT16_MAX) {
         // This error is very unlikely to occur.
         lf_print_error_and_exit("Too many federates! More than %d.", UINT16_MAX);
@@ -1810,20 +3660,55 @@ void lf_connect_to_federate(uint16_t remote_federate_id) {
                                     remote_federate_id);
       write_to_socket_fail_on_error(&socket_id, federation_id_length, (unsigned char*)federation_metadata.federation_id,
                                     NULL, "Failed to send federation id to federate %d.", remote_federate_id);
+      if (options != 0) {
+        write_to_socket_fail_on_error(&socket_id, 1, &requested, NULL, "Failed to send options to federate %d.",
+                                      remote_federate_id);
+      }
+#ifdef LF_FEDERATED_RDMA
+      if (channel != NULL) {
+        write_to_socket_fail_on_error(&socket_id, P2P_RDMA_ENDPOINT_LENGTH, endpoint, NULL,
+                                      "Failed to send the RDMA endpoint to federate %d.", remote_federate_id);
+      }
+#endif
 
       read_from_socket_fail_on_error(&socket_id, 1, (unsigned char*)buffer, NULL,
                                      "Failed to read MSG_TYPE_ACK from federate %d in response to sending fed_id.",
                                      remote_federate_id);
       if (buffer[0] != MSG_TYPE_ACK) {
+#ifdef LF_FEDERATED_RDMA
+        free_rdma_channel(channel);
+#endif
         // Get the error code.
         read_from_socket_fail_on_error(&socket_id, 1, (unsigned char*)buffer, NULL,
                                        "Failed to read error code from federate %d in response to sending fed_id.",
                                        remote_federate_id);
+        if (options != 0 && buffer[0] == WRONG_SERVER) {
+          // The remote federate does not know the options. Connect again without them.
+          LF_PRINT_LOG("Federate %d does not accept options of the connection.", remote_federate_id);
+          close(socket_id);
+          options = 0;
+          result = -1;
+          continue;
+        }
         lf_print_error("Received MSG_TYPE_REJECT message from remote federate (%d).", buffer[0]);
         result = -1;
         continue;
       } else {
-        lf_print("Connected to federate %d, port %d.", remote_federate_id, port);
+        unsigned char remote_endpoint[P2P_RDMA_ENDPOINT_LENGTH];
+        unsigned char accepted =
+            options != 0 ? read_accepted_p2p_options(&socket_id, remote_federate_id, host_ip_addr, requested,
+                                                     remote_endpoint)
+                         : 0;
+#ifdef LF_FEDERATED_RDMA
+        if (accepted & P2P_OPTION_RDMA) {
+          use_rdma_channel(&socket_id, remote_federate_id, channel, remote_endpoint);
+        } else {
+          free_rdma_channel(channel);
+        }
+#else
+        (void)accepted; // Suppress unused variable warning.
+#endif
+        lf_print("Connected to federate %d, port %d.", remote_federate_id, uport);
         // Trace the event when tracing is enabled
         tracepoint_federate_to_federate(receive_ACK, _lf_my_fed_id, remote_federate_id, NULL);
       }
@@ -1832,10 +3717,79 @@ void lf_connect_to_federate(uint16_t remote_federate_id) {
   // Once we set this variable, then all future calls to close() on this
   // socket ID should reset it to -1 within a critical section.
   _fed.sockets_for_outbound_p2p_connections[remote_federate_id] = socket_id;
+#ifdef LF_FEDERATED_SEND_QUEUE
+  start_send_queue(remote_federate_id);
+#endif
+}
+
+/** The federates to which lf_connect_to_federates() connects, shared by the threads that connect to them. */
+typedef struct outbound_connections_t {
+  const uint16_t* remote_federate_ids;
+  const struct in_addr* hosts;
+  const uint16_t* ports;
+  int32_t count; // The number of federates.
+  int32_t next;  // The index of the next federate to connect to.
+} outbound_connections_t;
+
+/**
+ * Thread that connects to the federates of an outbound_connections_t, one at a time, until
+ * there is none left.
+ * @param arg The outbound_connections_t.
+ */
+static void* connect_to_federates(void* arg) {
+  outbound_connections_t* connections = (outbound_connections_t*)arg;
+  int32_t i;
+  while ((i = lf_atomic_fetch_add32(&connections->next, 1)) < connections->count && !_lf_termination_executed) {
+    connect_to_federate_at(connections->remote_federate_ids[i], connections->hosts[i], connections->ports[i]);
+  }
+  return NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+// Public functions (declared in federate.h, in alphabetical order)
+
+void lf_connect_to_federate(uint16_t remote_federate_id) { lf_connect_to_federates(&remote_federate_id, 1); }
+
+void lf_connect_to_federates(const uint16_t* remote_federate_ids, size_t num_federates) {
+  if (num_federates == 0) {
+    return;
+  }
+  LF_STARTUP_BEGIN(lf_startup_federation);
+  instant_t start = lf_time_physical();
+  struct in_addr hosts[num_federates];
+  uint16_t ports[num_federates];
+  if (!query_federate_addresses(remote_federate_ids, num_federates, hosts, ports)) {
+    LF_STARTUP_END(lf_startup_federation);
+    return;
+  }
+  instant_t addresses_known = lf_time_physical();
+  LF_PRINT_LOG("Startup: obtained the addresses of %zu federates from the RTI in " PRINTF_TIME " ns.", num_federates,
+               addresses_known - start);
+
+  outbound_connections_t connections = {
+      .remote_federate_ids = remote_federate_ids, .hosts = hosts, .ports = ports, .count = (int32_t)num_federates};
+  size_t num_threads = num_federates < LF_FEDERATED_CONNECT_THREADS ? num_federates : LF_FEDERATED_CONNECT_THREADS;
+  // This thread is one of the threads that connect.
+  lf_thread_t threads[num_threads];
+  size_t num_started = 0;
+  while (num_started + 1 < num_threads &&
+         lf_thread_create(&threads[num_started], connect_to_federates, &connections) == 0) {
+    num_started++;
+  }
+  connect_to_federates(&connections);
+  for (size_t i = 0; i < num_started; i++) {
+    lf_thread_join(threads[i], NULL);
+  }
+  LF_PRINT_LOG("Startup: connected to %zu federates with %zu threads in " PRINTF_TIME " ns.", num_federates,
+               num_started + 1, lf_time_physical() - addresses_known);
+  LF_STARTUP_END(lf_startup_federation);
 }
 
 void lf_connect_to_rti(const char* hostname, int port) {
   LF_PRINT_LOG("Connecting to the RTI.");
+  LF_STARTUP_BEGIN(lf_startup_federation);
+  instant_t start = lf_time_physical();
 
   // Override passed hostname and port if passed as runtime arguments.
   hostname = federation_metadata.rti_host ? federation_metadata.rti_host : hostname;
@@ -1997,12 +3951,15 @@ void lf_connect_to_rti(const char* hostname, int port) {
                                 "Failed to send the UDP port number to the RTI.");
 
   lf_print("Connected to RTI at %s:%d.", hostname, uport);
+  LF_PRINT_LOG("Startup: connected to the RTI in " PRINTF_TIME " ns.", lf_time_physical() - start);
+  LF_STARTUP_END(lf_startup_federation);
 }
 
 void lf_create_server(int specified_port) {
   assert(specified_port <= UINT16_MAX && specified_port >= 0);
   uint16_t port = (uint16_t)specified_port;
   LF_PRINT_LOG("Creating a socket server on port %d.", port);
+  LF_STARTUP_BEGIN(lf_startup_federation);
   // Create an IPv4 socket for TCP (not UDP) communication over IP (0).
   int socket_descriptor = create_real_time_tcp_socket_errexit();
 
@@ -2046,6 +4003,12 @@ void lf_create_server(int specified_port) {
 
   LF_PRINT_LOG("Server for communicating with other federates started using port %d.", _fed.server_port);
 
+#ifndef LF_FEDERATED_TCP_ONLY
+  // Federates on this host connect through a local socket server, which must exist
+  // before the port is advertised.
+  _fed.local_server_socket = create_local_server_socket(_fed.server_port);
+#endif
+
   // Send the server port number to the RTI
   // on an MSG_TYPE_ADDRESS_ADVERTISEMENT message (@see net_common.h).
   unsigned char buffer[sizeof(int32_t) + 1];
@@ -2063,6 +4026,7 @@ void lf_create_server(int specified_port) {
 
   // Set the global server socket
   _fed.server_socket = socket_descriptor;
+  LF_STARTUP_END(lf_startup_federation);
 }
 
 void lf_enqueue_port_absent_reactions(environment_t* env) {
@@ -2091,14 +4055,13 @@ void lf_enqueue_port_absent_reactions(environment_t* env) {
 
 void* lf_handle_p2p_connections_from_federates(void* env_arg) {
   LF_ASSERT_NON_NULL(env_arg);
+  instant_t start = lf_time_physical();
   size_t received_federates = 0;
   // Allocate memory to store thread IDs.
   _fed.inbound_socket_listeners = (lf_thread_t*)calloc(_fed.number_of_inbound_p2p_connections, sizeof(lf_thread_t));
   while (received_federates < _fed.number_of_inbound_p2p_connections && !_lf_termination_executed) {
     // Wait for an incoming connection request.
-    struct sockaddr client_fd;
-    uint32_t client_length = sizeof(client_fd);
-    int socket_id = accept(_fed.server_socket, &client_fd, &client_length);
+    int socket_id = accept_federate_connection();
 
     if (socket_id < 0) {
       if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
@@ -2117,7 +4080,8 @@ void* lf_handle_p2p_connections_from_federates(void* env_arg) {
     size_t header_length = 1 + sizeof(uint16_t) + 1;
     unsigned char buffer[header_length];
     int read_failed = read_from_socket(socket_id, header_length, (unsigned char*)&buffer);
-    if (read_failed || buffer[0] != MSG_TYPE_P2P_SENDING_FED_ID) {
+    if (read_failed ||
+        (buffer[0] != MSG_TYPE_P2P_SENDING_FED_ID && buffer[0] != MSG_TYPE_P2P_SENDING_FED_ID_WITH_OPTIONS)) {
       lf_print_warning("Federate received invalid first message on P2P socket. Closing socket.");
       if (read_failed == 0) {
         // Wrong message received.
@@ -2153,6 +4117,34 @@ void* lf_handle_p2p_connections_from_federates(void* env_arg) {
       continue;
     }
 
+    // Read the requested options of the connection, if any.
+    unsigned char options = 0;
+    if (buffer[0] == MSG_TYPE_P2P_SENDING_FED_ID_WITH_OPTIONS && read_from_socket(socket_id, 1, &options)) {
+      lf_print_warning("Failed to read the options of a P2P connection. Closing socket.");
+      close(socket_id);
+      continue;
+    }
+    unsigned char remote_endpoint[P2P_RDMA_ENDPOINT_LENGTH];
+    if ((options & P2P_OPTION_RDMA) && read_from_socket(socket_id, P2P_RDMA_ENDPOINT_LENGTH, remote_endpoint)) {
+      lf_print_warning("Failed to read the RDMA endpoint of a P2P connection. Closing socket.");
+      close(socket_id);
+      continue;
+    }
+#ifdef LF_FEDERATED_RDMA
+    // The receiving end of the RDMA channel of this connection, which must be ready before the ACK is sent.
+    unsigned char endpoint[P2P_RDMA_ENDPOINT_LENGTH];
+    rdma_channel_t* channel = NULL;
+    if (options & P2P_OPTION_RDMA) {
+      LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+      channel = rdma_channel_create(true, endpoint);
+      if (channel != NULL && rdma_channel_connect(channel, socket_id, remote_endpoint) != 0) {
+        rdma_channel_free(channel);
+        channel = NULL;
+      }
+      LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+    }
+#endif
+
     // Extract the ID of the sending federate.
     uint16_t remote_fed_id = extract_uint16((unsigned char*)&(buffer[1]));
     LF_PRINT_DEBUG("Received sending federate ID %d.", remote_fed_id);
@@ -2167,18 +4159,66 @@ void* lf_handle_p2p_connections_from_federates(void* env_arg) {
     // two threads attempt to simultaneously close the socket.
     _fed.sockets_for_inbound_p2p_connections[remote_fed_id] = socket_id;
 
-    // Send an MSG_TYPE_ACK message.
-    unsigned char response = MSG_TYPE_ACK;
+    // Send an MSG_TYPE_ACK message, followed by the accepted options if options were requested.
+    unsigned char response[2 + sizeof(uint16_t) + P2P_RDMA_ENDPOINT_LENGTH] = {MSG_TYPE_ACK};
+    size_t response_length = 1;
+    unsigned char accepted = 0;
+    if (buffer[0] == MSG_TYPE_P2P_SENDING_FED_ID_WITH_OPTIONS) {
+      accepted = options & (P2P_OPTION_COMPRESSION | P2P_OPTION_DATAGRAMS);
+      uint16_t datagram_port = (accepted & P2P_OPTION_DATAGRAMS) ? accept_datagrams_from(remote_fed_id) : 0;
+      if (datagram_port == 0) {
+        accepted &= (unsigned char)~P2P_OPTION_DATAGRAMS;
+      }
+#ifdef LF_FEDERATED_RDMA
+      if (channel != NULL) {
+        accepted |= P2P_OPTION_RDMA;
+      }
+#endif
+      response[response_length++] = accepted;
+      if (accepted & P2P_OPTION_DATAGRAMS) {
+        encode_uint16(datagram_port, &response[response_length]);
+        response_length += sizeof(uint16_t);
+      }
+#ifdef LF_FEDERATED_RDMA
+      if (accepted & P2P_OPTION_RDMA) {
+        memcpy(&response[response_length], endpoint, P2P_RDMA_ENDPOINT_LENGTH);
+        response_length += P2P_RDMA_ENDPOINT_LENGTH;
+      }
+#endif
+    }
 
     // Trace the event when tracing is enabled
     tracepoint_federate_to_federate(send_ACK, _lf_my_fed_id, remote_fed_id, NULL);
 
     LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
-    write_to_socket_fail_on_error(&_fed.sockets_for_inbound_p2p_connections[remote_fed_id], 1,
-                                  (unsigned char*)&response, &lf_outbound_socket_mutex,
+    write_to_socket_fail_on_error(&_fed.sockets_for_inbound_p2p_connections[remote_fed_id], response_length, response,
+                                  &lf_outbound_socket_mutex,
                                   "Failed to write MSG_TYPE_ACK in response to federate %d.", remote_fed_id);
     LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
 
+#ifdef LF_FEDERATED_RDMA
+    if (accepted & P2P_OPTION_RDMA) {
+      // The federate tells whether its first message on the channel was delivered.
+      unsigned char works;
+      read_from_socket_fail_on_error(&_fed.sockets_for_inbound_p2p_connections[remote_fed_id], 1, &works, NULL,
+                                     "Failed to read whether the RDMA channel from federate %d works.", remote_fed_id);
+      if (works && rdma_channel_probe(channel) != 0) {
+        lf_print_error_and_exit("Failed to receive the first message on the RDMA channel from federate %d.",
+                                remote_fed_id);
+      }
+      LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+      if (works) {
+        rdma_channel_attach(channel);
+      } else {
+        rdma_channel_free(channel);
+      }
+      LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+      LF_PRINT_LOG("The connection from federate %d uses %s.", remote_fed_id, works ? "RDMA" : "TCP");
+    } else {
+      free_rdma_channel(channel);
+    }
+#endif
+
     // Start a thread to listen for incoming messages from other federates.
     // The fed_id is a uint16_t, which we assume can be safely cast to and from void*.
     void* fed_id_arg = (void*)(uintptr_t)remote_fed_id;
@@ -2198,21 +4238,55 @@ void* lf_handle_p2p_connections_from_federates(void* env_arg) {
     received_federates++;
   }
 
-  LF_PRINT_LOG("All %zu remote federates are connected.", _fed.number_of_inbound_p2p_connections);
+  if (_fed.local_server_socket >= 0) {
+    close_local_server_socket(_fed.local_server_socket, (uint16_t)_fed.server_port);
+    _fed.local_server_socket = -1;
+  }
+  LF_PRINT_LOG("Startup: all %zu remote federates connected in " PRINTF_TIME " ns.",
+               _fed.number_of_inbound_p2p_connections, lf_time_physical() - start);
   return NULL;
 }
 
+void lf_flush_outbound_messages() {
+#ifdef LF_FEDERATED_BATCH_SIZE
+  LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+  flush_outbound_batches_locked();
+  LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+#endif
+}
+
 void lf_latest_tag_complete(tag_t tag_to_send) {
-  int compare_with_last_tag = lf_tag_compare(_fed.last_sent_LTC, tag_to_send);
-  if (compare_with_last_tag >= 0) {
+#ifdef LF_TIME_TRIGGERED
+  if (_fed.time_triggered_window >= 0) {
+    // The RTI issues no grants, so it does not need to know the completed tags.
     return;
   }
-  LF_PRINT_LOG("Sending Latest Tag Complete (LTC) " PRINTF_TAG " to the RTI.", tag_to_send.time - start_time,
-               tag_to_send.microstep);
+#endif
+#ifdef LF_FEDERATED_OPTIMISTIC
+  // A speculative tag is completed only once it is final.
+  if (lf_tag_compare(tag_to_send, completed_tag) > 0) {
+    completed_tag = tag_to_send;
+  }
+  LF_MUTEX_LOCK(&held_mutex);
+  if (lf_tag_compare(tag_to_send, final_tag) > 0) {
+    tag_to_send = final_tag;
+  }
+  LF_MUTEX_UNLOCK(&held_mutex);
+#endif // LF_FEDERATED_OPTIMISTIC
+  int compare_with_last_tag = lf_tag_compare(_fed.last_sent_LTC, tag_to_send);
+  if (compare_with_last_tag >= 0) {
+    return;
+  }
+  LF_PRINT_LOG("Sending Latest Tag Complete (LTC) " PRINTF_TAG " to the RTI.", tag_to_send.time - start_time,
+               tag_to_send.microstep);
   send_tag(MSG_TYPE_LATEST_TAG_COMPLETE, tag_to_send);
   _fed.last_sent_LTC = tag_to_send;
 }
 
+size_t lf_max_level_allowed_to_advance_locked(void) {
+  return max_level_allowed_to_advance < 0 ? 0 : (size_t)max_level_allowed_to_advance;
+}
+
 parse_rti_code_t lf_parse_rti_addr(const char* rti_addr) {
   rti_addr_info_t rti_addr_info = {0};
   extract_rti_addr_info(rti_addr, &rti_addr_info);
@@ -2287,24 +4361,44 @@ int lf_send_message(int message_type, unsigned short port, unsigned short federa
   // Header:  message_type + port_id + federate_id + length of message + timestamp + microstep
   const int header_length = 1 + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t);
 
+#ifdef LF_FEDERATED_OPTIMISTIC
+  // A held message is sent on the TCP connection once the current tag is committed.
+  environment_t* env;
+  _lf_get_environments(&env);
+  if (hold_message(env, &_fed.sockets_for_outbound_p2p_connections[federate], federate, header_length, header_buffer,
+                   length, message, NULL, NULL)) {
+    return 0;
+  }
+#endif // LF_FEDERATED_OPTIMISTIC
+
+#ifdef LF_FEDERATED_DATAGRAM_SIZE
+  if (length <= LF_FEDERATED_DATAGRAM_SIZE && outbound_datagram_addresses[federate].sin_port != 0) {
+    return send_datagram(federate, next_destination_str, header_buffer, header_length, length, message);
+  }
+#endif // LF_FEDERATED_DATAGRAM_SIZE
+
   // Use a mutex lock to prevent multiple threads from simultaneously sending.
-  LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+  lock_outbound(federate);
 
   int* socket = &_fed.sockets_for_outbound_p2p_connections[federate];
 
   // Trace the event when tracing is enabled
   tracepoint_federate_to_federate(send_P2P_MSG, _lf_my_fed_id, federate, NULL);
 
-  int result = write_to_socket_close_on_error(socket, header_length, header_buffer);
-  if (result == 0) {
-    // Header sent successfully. Send the body.
-    result = write_to_socket_close_on_error(socket, length, message);
-  }
+#ifdef LF_FEDERATED_SEND_QUEUE
+  (void)socket;
+  int result = enqueue_message(&send_queues[federate], header_length, header_buffer, length, message, NULL, NULL);
+#else
+  flush_outbound_batches_locked();
+  struct iovec buffers[] = {{.iov_base = header_buffer, .iov_len = header_length},
+                            {.iov_base = message, .iov_len = length}};
+  int result = writev_to_socket_close_on_error(socket, buffers, 2);
+#endif // LF_FEDERATED_SEND_QUEUE
   if (result != 0) {
     // Message did not send. Since this is used for physical connections, this is not critical.
     lf_print_warning("Failed to send message to %s. Dropping the message.", next_destination_str);
   }
-  LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+  unlock_outbound(federate);
   return result;
 }
 
@@ -2338,6 +4432,12 @@ tag_t lf_send_next_event_tag(environment_t* env, tag_t tag, bool wait_for_reply)
       return _fed.last_TAG;
     }
 
+#ifdef LF_TIME_TRIGGERED
+    if (_fed.time_triggered_window >= 0) {
+      return time_triggered_advance(env, tag, wait_for_reply);
+    }
+#endif
+
     // Copy the tag because bounded_NET() may modify it.
     tag_t original_tag = tag;
 
@@ -2356,9 +4456,8 @@ tag_t lf_send_next_event_tag(environment_t* env, tag_t tag, bool wait_for_reply)
       // This if statement does not fall through but rather returns.
       // NET is not bounded by physical time or has no downstream federates.
       // Normal case.
-      send_tag(MSG_TYPE_NEXT_EVENT_TAG, tag);
-      _fed.last_sent_NET = tag;
-      LF_PRINT_LOG("Sent next event tag (NET) " PRINTF_TAG " to RTI.", tag.time - start_time, tag.microstep);
+      // A NET held back here is sent from the loop below, where this federate waits for a TAG.
+      bool held_back = !send_net_if_needed(tag, wait_for_reply && _fed.has_upstream);
 
       if (!wait_for_reply) {
         LF_PRINT_LOG("Not waiting for reply to NET.");
@@ -2383,7 +4482,10 @@ tag_t lf_send_next_event_tag(environment_t* env, tag_t tag, bool wait_for_reply)
         // the RTI has responded with a TAG.
         LF_PRINT_DEBUG("Waiting for a TAG from the RTI with _fed.last_TAG= " PRINTF_TAG " and net=" PRINTF_TAG,
                        _fed.last_TAG.time - start_time, _fed.last_TAG.microstep, tag.time - start_time, tag.microstep);
-        if (lf_cond_wait(&env->event_q_changed) != 0) {
+        if (held_back) {
+          lf_clock_cond_timedwait(&env->event_q_changed,
+                                  _fed.last_sent_NET_physical_time + LF_FEDERATED_NET_INTERVAL);
+        } else if (lf_cond_wait(&env->event_q_changed) != 0) {
           lf_print_error("Wait error.");
         }
         // Check whether the new event on the event queue requires sending a new NET.
@@ -2391,11 +4493,8 @@ tag_t lf_send_next_event_tag(environment_t* env, tag_t tag, bool wait_for_reply)
         if (lf_tag_compare(_fed.last_TAG, next_tag) >= 0 || lf_tag_compare(_fed.last_TAG, tag) >= 0) {
           return _fed.last_TAG;
         }
-        if (lf_tag_compare(next_tag, tag) != 0) {
-          send_tag(MSG_TYPE_NEXT_EVENT_TAG, next_tag);
-          _fed.last_sent_NET = next_tag;
-          LF_PRINT_LOG("Sent next event tag (NET) " PRINTF_TAG " to RTI from loop.", next_tag.time - lf_time_start(),
-                       next_tag.microstep);
+        if (held_back || lf_tag_compare(next_tag, tag) != 0) {
+          held_back = !send_net_if_needed(next_tag, true);
         }
       }
     }
@@ -2479,9 +4578,33 @@ void lf_send_port_absent_to_federate(environment_t* env, interval_t additional_d
     tracepoint_federate_to_federate(send_PORT_ABS, _lf_my_fed_id, fed_ID, &current_message_intended_tag);
   }
 
-  LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+  size_t destination = socket == &_fed.socket_TCP_RTI ? NUMBER_OF_FEDERATES : fed_ID;
+#ifdef LF_FEDERATED_OPTIMISTIC
+  if (hold_message(env, socket, destination, message_length, buffer, 0, NULL, NULL, NULL)) {
+    return;
+  }
+#endif
+  lock_outbound(destination);
+#ifdef LF_FEDERATED_BATCH_SIZE
+  if (MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE + PORT_ABSENT_RANGE_SIZE <= LF_FEDERATED_BATCH_SIZE) {
+    // Send the absent message with the next batch, together with those for the same federate and tag.
+    outbound_batch_t* batch = &outbound_batches[destination];
+    batch->socket = socket;
+    batch->to_rti = (socket == &_fed.socket_TCP_RTI);
+    batch_port_absent_locked(batch, fed_ID, port_ID, current_message_intended_tag);
+    LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+    return;
+  }
+#endif // LF_FEDERATED_BATCH_SIZE
+  flush_outbound_batches_locked();
+#ifdef LF_FEDERATED_SEND_QUEUE
+  int result = destination < NUMBER_OF_FEDERATES
+                   ? enqueue_message(&send_queues[destination], message_length, buffer, 0, NULL, NULL, NULL)
+                   : write_to_socket_close_on_error(socket, message_length, buffer);
+#else
   int result = write_to_socket_close_on_error(socket, message_length, buffer);
-  LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+#endif // LF_FEDERATED_SEND_QUEUE
+  unlock_outbound(destination);
 
   if (result != 0) {
     // Write failed. Response depends on whether coordination is centralized.
@@ -2496,6 +4619,14 @@ void lf_send_port_absent_to_federate(environment_t* env, interval_t additional_d
   }
 }
 
+void lf_hand_off_stop_request(void) {
+  unsigned char request = 1;
+  if (_fed.stop_request_pipe[1] < 0 || _fed.socket_TCP_RTI < 0 || write(_fed.stop_request_pipe[1], &request, 1) != 1) {
+    // The thread listening to the RTI is not running.
+    send_local_stop_request();
+  }
+}
+
 int lf_send_stop_request_to_rti(tag_t stop_tag) {
 
   // Send a stop request with the specified tag to the RTI
@@ -2517,6 +4648,7 @@ int lf_send_stop_request_to_rti(tag_t stop_tag) {
     }
     // Trace the event when tracing is enabled
     tracepoint_federate_to_rti(send_STOP_REQ, _lf_my_fed_id, &stop_tag);
+    flush_outbound_batches_locked();
 
     write_to_socket_fail_on_error(&_fed.socket_TCP_RTI, MSG_TYPE_STOP_REQUEST_LENGTH, buffer, &lf_outbound_socket_mutex,
                                   "Failed to send stop time " PRINTF_TIME " to the RTI.", stop_tag.time - start_time);
@@ -2531,37 +4663,103 @@ int lf_send_stop_request_to_rti(tag_t stop_tag) {
   }
 }
 
-int lf_send_tagged_message(environment_t* env, interval_t additional_delay, int message_type, unsigned short port,
-                           unsigned short federate, const char* next_destination_str, size_t length,
-                           unsigned char* message) {
+/**
+ * Send a tagged message, given as its header and its payload, on the specified socket, or add
+ * it to the batch for the destination if LF_FEDERATED_BATCH_SIZE is defined and it fits, or
+ * to the queue for the destination if LF_FEDERATED_SEND_QUEUE is defined and it is a federate.
+ * This assumes the caller holds the lock of lock_outbound(destination).
+ * @param socket Pointer to the socket, which is closed on failure.
+ * @param destination The ID of the destination federate, or NUMBER_OF_FEDERATES for the RTI.
+ * @param header_length The length of the header.
+ * @param header The header.
+ * @param length The length of the payload.
+ * @param message The payload, or NULL if it is serialized from the value.
+ * @param type The type of the value, if the payload is serialized from it (@see token_type_t), or NULL.
+ * @param value The value, if the payload is serialized from it.
+ * @return 0 for success, -1 for failure.
+ */
+static int send_tagged_message_locked(int* socket, size_t destination, size_t header_length, unsigned char* header,
+                                      size_t length, unsigned char* message, token_type_t* type, void* value) {
+#ifdef LF_FEDERATED_BATCH_SIZE
+  outbound_batch_t* batch = &outbound_batches[destination];
+  batch->socket = socket;
+  batch->to_rti = (socket == &_fed.socket_TCP_RTI);
+  if (batch->size + header_length + length > LF_FEDERATED_BATCH_SIZE) {
+    flush_outbound_batch_locked(batch);
+  }
+  if (header_length + length <= LF_FEDERATED_BATCH_SIZE) {
+    // Send the message with the next batch. Larger messages are written directly.
+    memcpy(&batch->bytes[batch->size], header, header_length);
+    if (type != NULL) {
+      // Serialize the value straight into the batch.
+      type->serialize_into(value, &batch->bytes[batch->size + header_length]);
+    } else {
+      memcpy(&batch->bytes[batch->size + header_length], message, length);
+    }
+    batch->size += header_length + length;
+    return 0;
+  }
+#elif defined(LF_FEDERATED_SEND_QUEUE)
+  if (destination < NUMBER_OF_FEDERATES) {
+    return enqueue_message(&send_queues[destination], header_length, header, length, message, type, value);
+  }
+#else
+  (void)destination; // Suppress unused variable warning.
+#endif // LF_FEDERATED_BATCH_SIZE
+  return write_message(socket, header_length, header, length, message, type, value);
+}
+
+#ifdef LF_FEDERATED_OPTIMISTIC
+/**
+ * @brief Send the held messages that were sent at tags that are final, in the order in which they were sent.
+ * The caller must not hold the mutex of the top-level environment.
+ */
+static void release_held_messages(void) {
+  LF_MUTEX_LOCK(&held_mutex);
+  bool released = false;
+  while (held_messages != NULL && lf_tag_compare(held_messages->tag, final_tag) <= 0) {
+    held_message_t* held = held_messages;
+    held_messages = held->next;
+    if (held_messages == NULL) {
+      held_messages_end = &held_messages;
+    }
+    lock_outbound(held->destination);
+    if (send_tagged_message_locked(held->socket, held->destination, held->size, held->bytes, 0,
+                                   held->bytes + held->size, NULL, NULL) != 0) {
+      lf_print_warning("Failed to send a held message to federate %zu.", held->destination);
+    }
+    unlock_outbound(held->destination);
+    network_buffer_free((unsigned char*)held, sizeof(held_message_t) + held->size);
+    released = true;
+  }
+  LF_MUTEX_UNLOCK(&held_mutex);
+  if (released) {
+    lf_flush_outbound_messages();
+  }
+}
+#endif // LF_FEDERATED_OPTIMISTIC
+
+/**
+ * Send a tagged message as lf_send_tagged_message() does, with a payload that is either given
+ * or serialized from a value (@see lf_send_tagged_value()).
+ * @param type The type of the value, if the payload is serialized from it, or NULL.
+ * @param value The value, if the payload is serialized from it.
+ */
+static int send_tagged_message(environment_t* env, interval_t additional_delay, int message_type, unsigned short port,
+                               unsigned short federate, const char* next_destination_str, size_t length,
+                               unsigned char* message, token_type_t* type, void* value) {
   assert(env != GLOBAL_ENVIRONMENT);
 
   size_t header_length =
       1 + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(instant_t) + sizeof(microstep_t);
-  unsigned char header_buffer[header_length];
+  // A compressed message also has the length of the compressed payload in its header.
+  unsigned char header_buffer[header_length + sizeof(uint32_t)];
 
   if (message_type != MSG_TYPE_TAGGED_MESSAGE && message_type != MSG_TYPE_P2P_TAGGED_MESSAGE) {
     lf_print_error("lf_send_message: Unsupported message type (%d).", message_type);
     return -1;
   }
 
-  size_t buffer_head = 0;
-  // First byte is the message type.
-  header_buffer[buffer_head] = (unsigned char)message_type;
-  buffer_head += sizeof(unsigned char);
-  // Next two bytes identify the destination port.
-  // NOTE: Send messages little endian, not big endian.
-  encode_uint16(port, &(header_buffer[buffer_head]));
-  buffer_head += sizeof(uint16_t);
-
-  // Next two bytes identify the destination federate.
-  encode_uint16(federate, &(header_buffer[buffer_head]));
-  buffer_head += sizeof(uint16_t);
-
-  // The next four bytes are the message length.
-  encode_uint32((uint32_t)length, &(header_buffer[buffer_head]));
-  buffer_head += sizeof(uint32_t);
-
   // Apply the additional delay to the current tag and use that as the intended
   // tag of the outgoing message.
   tag_t current_message_intended_tag = lf_delay_tag(env->current_tag, additional_delay);
@@ -2572,15 +4770,42 @@ int lf_send_tagged_message(environment_t* env, interval_t additional_delay, int
     return -1;
   }
 
-  // Next 8 + 4 will be the tag (timestamp, microstep)
-  encode_tag(&(header_buffer[buffer_head]), current_message_intended_tag);
+  // First byte is the message type. It is followed by the IDs of the destination port
+  // and federate, the message length and the tag (timestamp, microstep).
+  // NOTE: Send messages little endian, not big endian.
+  header_buffer[0] = (unsigned char)message_type;
+  encode_timed_header(&header_buffer[1], port, federate, (uint32_t)length, current_message_intended_tag);
 
   LF_PRINT_LOG("Sending message with tag " PRINTF_TAG " to %s.", current_message_intended_tag.time - start_time,
                current_message_intended_tag.microstep, next_destination_str);
 
-  // Use a mutex lock to prevent multiple threads from simultaneously sending.
-  LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+#ifdef LF_FEDERATED_COMPRESSION_THRESHOLD
+  // Compress the payload before acquiring the mutex. It is sent compressed only if that saves bytes.
+  unsigned char* compressed = NULL;
+  unsigned char* serialized = NULL;
+  size_t uncompressed_length = length;
+  if (message_type == MSG_TYPE_P2P_TAGGED_MESSAGE && length >= LF_FEDERATED_COMPRESSION_THRESHOLD &&
+      length > sizeof(uint32_t) && compressed_outbound_p2p_connections[federate]) {
+    if (type != NULL) {
+      // The serialized bytes are needed to compress them.
+      message = serialized = network_buffer_new(length);
+      type->serialize_into(value, serialized);
+      type = NULL;
+    }
+    compressed = network_buffer_new(length);
+    size_t compressed_length = lz_block_compress(message, length, compressed, length - sizeof(uint32_t) - 1);
+    if (compressed_length > 0) {
+      header_buffer[0] = MSG_TYPE_P2P_COMPRESSED_TAGGED_MESSAGE;
+      encode_uint32((uint32_t)compressed_length, &(header_buffer[header_length]));
+      header_length += sizeof(uint32_t);
+      message = compressed;
+      length = compressed_length;
+    }
+  }
+#endif // LF_FEDERATED_COMPRESSION_THRESHOLD
 
+  // Use a mutex lock to prevent multiple threads from simultaneously sending.
+  size_t destination = message_type == MSG_TYPE_P2P_TAGGED_MESSAGE ? federate : NUMBER_OF_FEDERATES;
   int* socket;
   if (message_type == MSG_TYPE_P2P_TAGGED_MESSAGE) {
     socket = &_fed.sockets_for_outbound_p2p_connections[federate];
@@ -2589,12 +4814,19 @@ int lf_send_tagged_message(environment_t* env, interval_t additional_delay, int
     socket = &_fed.socket_TCP_RTI;
     tracepoint_federate_to_rti(send_TAGGED_MSG, _lf_my_fed_id, &current_message_intended_tag);
   }
-
-  int result = write_to_socket_close_on_error(socket, header_length, header_buffer);
-  if (result == 0) {
-    // Header sent successfully. Send the body.
-    result = write_to_socket_close_on_error(socket, length, message);
+#ifdef LF_FEDERATED_OPTIMISTIC
+  if (hold_message(env, socket, destination, header_length, header_buffer, length, message, type, value)) {
+#ifdef LF_FEDERATED_COMPRESSION_THRESHOLD
+    network_buffer_free(compressed, uncompressed_length);
+    network_buffer_free(serialized, uncompressed_length);
+#endif
+    return 0;
   }
+#endif // LF_FEDERATED_OPTIMISTIC
+  lock_outbound(destination);
+
+  int result =
+      send_tagged_message_locked(socket, destination, header_length, header_buffer, length, message, type, value);
   if (result != 0) {
     // Message did not send. Handling depends on message type.
     if (message_type == MSG_TYPE_P2P_TAGGED_MESSAGE) {
@@ -2604,20 +4836,190 @@ int lf_send_tagged_message(environment_t* env, interval_t additional_delay, int
                                     next_destination_str, errno, strerror(errno));
     }
   }
-  LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+  unlock_outbound(destination);
+#ifdef LF_FEDERATED_COMPRESSION_THRESHOLD
+  network_buffer_free(compressed, uncompressed_length);
+  network_buffer_free(serialized, uncompressed_length);
+#endif
+  return result;
+}
+
+int lf_send_tagged_message(environment_t* env, interval_t additional_delay, int message_type, unsigned short port,
+                           unsigned short federate, const char* next_destination_str, size_t length,
+                           unsigned char* message) {
+  return send_tagged_message(env, additional_delay, message_type, port, federate, next_destination_str, length,
+                             message, NULL, NULL);
+}
+
+int lf_send_tagged_value(environment_t* env, interval_t additional_delay, int message_type, unsigned short port,
+                         unsigned short federate, const char* next_destination_str, token_type_t* type, void* value,
+                         size_t length) {
+  if (type->serialize_into == NULL) {
+    return send_tagged_message(env, additional_delay, message_type, port, federate, next_destination_str,
+                               type->element_size * length, (unsigned char*)value, NULL, NULL);
+  }
+  return send_tagged_message(env, additional_delay, message_type, port, federate, next_destination_str,
+                             type->serialized_size(value), NULL, type, value);
+}
+
+int lf_send_tagged_message_to_many(environment_t* env, interval_t additional_delay, int message_type,
+                                   size_t num_destinations, const unsigned short* ports,
+                                   const unsigned short* federates, size_t length, unsigned char* message) {
+  assert(env != GLOBAL_ENVIRONMENT);
+
+  if (message_type != MSG_TYPE_TAGGED_MESSAGE && message_type != MSG_TYPE_P2P_TAGGED_MESSAGE) {
+    lf_print_error("lf_send_tagged_message_to_many: Unsupported message type (%d).", message_type);
+    return -1;
+  }
+  if (num_destinations > UINT16_MAX) {
+    lf_print_error("lf_send_tagged_message_to_many: Too many destinations (%zu).", num_destinations);
+    return -1;
+  }
+  tag_t intended_tag = lf_delay_tag(env->current_tag, additional_delay);
+  if (lf_is_tag_after_stop_tag(env, intended_tag)) {
+    LF_PRINT_LOG("Dropping message because it will be after the timeout time.");
+    return -1;
+  }
+  LF_PRINT_LOG("Sending message with tag " PRINTF_TAG " to %zu ports.", intended_tag.time - start_time,
+               intended_tag.microstep, num_destinations);
+
+  int result = 0;
+  if (message_type == MSG_TYPE_TAGGED_MESSAGE) {
+    // The RTI is sent the payload once, with all destinations, and forwards it to each of them.
+    size_t header_length = MSG_TYPE_MULTICAST_TAGGED_MESSAGE_HEADER_SIZE;
+    unsigned char* header = network_buffer_new(header_length + num_destinations * MULTICAST_DESTINATION_SIZE);
+    header[0] = MSG_TYPE_MULTICAST_TAGGED_MESSAGE;
+    encode_uint16((uint16_t)num_destinations, &header[1]);
+    encode_uint32((uint32_t)length, &header[1 + sizeof(uint16_t)]);
+    encode_tag(&header[1 + sizeof(uint16_t) + sizeof(uint32_t)], intended_tag);
+    for (size_t i = 0; i < num_destinations; i++) {
+      encode_uint16(ports[i], &header[header_length]);
+      encode_uint16(federates[i], &header[header_length + sizeof(uint16_t)]);
+      header_length += MULTICAST_DESTINATION_SIZE;
+    }
+    tracepoint_federate_to_rti(send_TAGGED_MSG, _lf_my_fed_id, &intended_tag);
+#ifdef LF_FEDERATED_OPTIMISTIC
+    if (hold_message(env, &_fed.socket_TCP_RTI, NUMBER_OF_FEDERATES, header_length, header, length, message, NULL,
+                     NULL)) {
+      network_buffer_free(header, header_length);
+      return 0;
+    }
+#endif // LF_FEDERATED_OPTIMISTIC
+    LF_MUTEX_LOCK(&lf_outbound_socket_mutex);
+    result = send_tagged_message_locked(&_fed.socket_TCP_RTI, NUMBER_OF_FEDERATES, header_length, header, length,
+                                        message, NULL, NULL);
+    if (result != 0) {
+      lf_print_error_system_failure("Failed to send message with error code %d (%s). Connection lost to the RTI.",
+                                    errno, strerror(errno));
+    }
+    LF_MUTEX_UNLOCK(&lf_outbound_socket_mutex);
+    network_buffer_free(header, header_length); // The header length now includes the destinations.
+    return result;
+  }
+
+  size_t header_length =
+      1 + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(instant_t) + sizeof(microstep_t);
+  unsigned char header_buffer[header_length + sizeof(uint32_t)];
+#ifdef LF_FEDERATED_COMPRESSION_THRESHOLD
+  // The payload is compressed at most once, for all the destinations whose connections accept it.
+  unsigned char* compressed = NULL;
+  size_t compressed_length = 0;
+  if (length >= LF_FEDERATED_COMPRESSION_THRESHOLD && length > sizeof(uint32_t)) {
+    for (size_t i = 0; i < num_destinations && compressed == NULL; i++) {
+      if (compressed_outbound_p2p_connections[federates[i]]) {
+        compressed = network_buffer_new(length);
+        compressed_length = lz_block_compress(message, length, compressed, length - sizeof(uint32_t) - 1);
+      }
+    }
+  }
+#endif // LF_FEDERATED_COMPRESSION_THRESHOLD
+
+  // The mutex is held for all destinations, so that the copies are not interleaved with other messages.
+  // Queued messages are not, as each destination has its own queue.
+#ifdef LF_FEDERATED_OPTIMISTIC
+  // Held messages are all held at once, under the mutex of the held messages instead.
+  LF_MUTEX_LOCK(&held_mutex);
+  bool held = holds_messages_locked(env);
+  if (!held) {
+    LF_MUTEX_UNLOCK(&held_mutex);
+    lock_outbound(0);
+  }
+#else
+  lock_outbound(0); // All the destinations are federates.
+#endif // LF_FEDERATED_OPTIMISTIC
+  for (size_t i = 0; i < num_destinations; i++) {
+    unsigned short federate = federates[i];
+    unsigned char* payload = message;
+    size_t payload_length = length;
+    header_buffer[0] = MSG_TYPE_P2P_TAGGED_MESSAGE;
+#ifdef LF_FEDERATED_COMPRESSION_THRESHOLD
+    if (compressed_length > 0 && compressed_outbound_p2p_connections[federate]) {
+      header_buffer[0] = MSG_TYPE_P2P_COMPRESSED_TAGGED_MESSAGE;
+      encode_uint32((uint32_t)compressed_length, &(header_buffer[header_length]));
+      payload = compressed;
+      payload_length = compressed_length;
+    }
+#endif // LF_FEDERATED_COMPRESSION_THRESHOLD
+    encode_timed_header(&header_buffer[1], ports[i], federate, (uint32_t)length, intended_tag);
+    tracepoint_federate_to_federate(send_P2P_TAGGED_MSG, _lf_my_fed_id, federate, &intended_tag);
+    size_t this_header_length =
+        header_buffer[0] == MSG_TYPE_P2P_TAGGED_MESSAGE ? header_length : header_length + sizeof(uint32_t);
+#ifdef LF_FEDERATED_OPTIMISTIC
+    if (held) {
+      append_held_message_locked(env, &_fed.sockets_for_outbound_p2p_connections[federate], federate,
+                                 this_header_length, header_buffer, payload_length, payload, NULL, NULL);
+      continue;
+    }
+#endif // LF_FEDERATED_OPTIMISTIC
+    if (send_tagged_message_locked(&_fed.sockets_for_outbound_p2p_connections[federate], federate, this_header_length,
+                                   header_buffer, payload_length, payload, NULL, NULL) != 0) {
+      lf_print_warning("Failed to send message to federate %d. Dropping the message.", federate);
+      result = -1;
+    }
+  }
+#ifdef LF_FEDERATED_OPTIMISTIC
+  if (held) {
+    LF_MUTEX_UNLOCK(&held_mutex);
+  } else {
+    unlock_outbound(0);
+  }
+#else
+  unlock_outbound(0);
+#endif // LF_FEDERATED_OPTIMISTIC
+#ifdef LF_FEDERATED_COMPRESSION_THRESHOLD
+  network_buffer_free(compressed, length);
+#endif
   return result;
 }
 
 void lf_set_federation_id(const char* fid) { federation_metadata.federation_id = fid; }
 
-#ifdef FEDERATED_DECENTRALIZED
-void lf_spawn_staa_thread() { lf_thread_create(&_fed.staaSetter, update_ports_from_staa_offsets, NULL); }
-#endif // FEDERATED_DECENTRALIZED
+void lf_set_listener_pinning(const char* cpus) { listener_pinning = cpus; }
 
 void lf_stall_advance_level_federation_locked(size_t level) {
   LF_PRINT_DEBUG("Waiting for MLAA %d to exceed level %zu.", max_level_allowed_to_advance, level);
+  if (((int)level) >= max_level_allowed_to_advance) {
+    // The status of the ports may depend on messages that have not been written yet.
+    lf_flush_outbound_messages();
+  }
+#ifdef FEDERATED_DECENTRALIZED
+  environment_t* env;
+  _lf_get_environments(&env);
+#endif // FEDERATED_DECENTRALIZED
   while (((int)level) >= max_level_allowed_to_advance) {
-    lf_cond_wait(&lf_port_status_changed);
+#ifdef FEDERATED_DECENTRALIZED
+    // Ports whose STAA has expired are assumed absent, which may raise the MLAA.
+    // Otherwise, wait no longer than until the next STAA expires.
+    instant_t deadline = update_ports_from_staa_offsets(env);
+    if (((int)level) < max_level_allowed_to_advance) {
+      break;
+    }
+    if (deadline != FOREVER) {
+      lf_clock_cond_timedwait(&lf_port_status_changed, deadline);
+      continue;
+    }
+#endif // FEDERATED_DECENTRALIZED
+    LF_COND_WAIT(&lf_port_status_changed);
   };
   LF_PRINT_DEBUG("Exiting wait with MLAA %d and level %zu.", max_level_allowed_to_advance, level);
 }
@@ -2632,21 +5034,91 @@ void lf_stall_advance_level_federation(environment_t* env, size_t level) {
 void lf_synchronize_with_other_federates(void) {
 
   LF_PRINT_DEBUG("Synchronizing with other federates.");
+  LF_STARTUP_BEGIN(lf_startup_federation);
+
+#if LF_FEDERATED_RECEIVE_POOL_SIZE > 0
+  // Draw the payloads of incoming messages from pools so that receiving them does not allocate memory.
+  for (size_t i = 0; i < _lf_action_table_size; i++) {
+    token_type_t* type = (token_type_t*)_lf_action_table[i];
+    if (type->destructor == NULL && type->copy_constructor == NULL && type->element_size > 0) {
+      lf_token_pool_enable(type, LF_FEDERATED_RECEIVE_POOL_SIZE);
+    }
+  }
+#endif
+
+#if defined(FEDERATED_DECENTRALIZED) && (defined(LF_ADAPTIVE_STAA) || defined(LF_FEDERATED_OPTIMISTIC))
+  initialize_staa_of_port();
+#endif
 
   // Reset the start time to the coordinated start time for all federates.
   // Note that this does not grant execution to this federate.
-  start_time = get_start_time_from_rti(lf_time_physical());
+  instant_t start = lf_time_physical();
+  start_time = get_start_time_from_rti(start);
   lf_tracing_set_start_time(start_time);
+  LF_PRINT_LOG("Startup: agreed on the start time with the RTI in " PRINTF_TIME " ns.", lf_time_physical() - start);
+#ifdef LF_FEDERATED_OPTIMISTIC
+  environment_t* env;
+  _lf_get_environments(&env);
+  start_speculation(env);
+#endif
 
   // Start a thread to listen for incoming TCP messages from the RTI.
   // @note Up until this point, the federate has been listening for messages
   //  from the RTI in a sequential manner in the main thread. From now on, a
   //  separate thread is created to allow for asynchronous communication.
+  if (pipe(_fed.stop_request_pipe) != 0) {
+    lf_print_error_system_failure("Failed to create the pipe for stop requests.");
+  }
   lf_thread_create(&_fed.RTI_socket_listener, listen_to_rti_TCP, NULL);
   lf_thread_t thread_id;
   if (create_clock_sync_thread(&thread_id)) {
     lf_print_warning("Failed to create thread to handle clock synchronization.");
   }
+  LF_STARTUP_END(lf_startup_federation);
+}
+
+/**
+ * The indices, in the table of network input ports that lf_update_max_level() checks, of the ports
+ * that are not physical, sorted by the level of their reactions. This is NULL until it is built.
+ */
+static size_t* ports_by_level = NULL;
+static size_t ports_by_level_size = 0;
+
+/** The tag at which the ports before `ports_by_level_next` were found not to block. */
+static tag_t ports_by_level_tag = {.time = NEVER, .microstep = 0u};
+
+/**
+ * The position in `ports_by_level` of the first port that may block at `ports_by_level_tag`.
+ * The last known status tags of the ports only increase, so a port that does not block at a tag
+ * does not block later at the same tag.
+ */
+static size_t ports_by_level_next = 0;
+
+/** @brief Return the level of the reaction triggered by a network input port. */
+static int level_of_port(lf_action_base_t* input_port_action) {
+  return (int)LF_LEVEL(input_port_action->trigger->reactions[0]->index);
+}
+
+/**
+ * @brief Build `ports_by_level` for a table of network input ports.
+ * @param action_table The table.
+ * @param action_table_size The number of ports in the table.
+ */
+static void sort_ports_by_level(lf_action_base_t** action_table, size_t action_table_size) {
+  ports_by_level = (size_t*)calloc(action_table_size > 0 ? action_table_size : 1, sizeof(size_t));
+  LF_ASSERT_NON_NULL(ports_by_level);
+  for (size_t i = 0; i < action_table_size; i++) {
+    if (action_table[i]->trigger->is_physical) {
+      continue;
+    }
+    // Insertion sort, which is done once.
+    int level = level_of_port(action_table[i]);
+    size_t j = ports_by_level_size++;
+    for (; j > 0 && level_of_port(action_table[ports_by_level[j - 1]]) > level; j--) {
+      ports_by_level[j] = ports_by_level[j - 1];
+    }
+    ports_by_level[j] = i;
+  }
 }
 
 bool lf_update_max_level(tag_t tag, bool is_provisional) {
@@ -2673,7 +5145,16 @@ bool lf_update_max_level(tag_t tag, bool is_provisional) {
   size_t action_table_size = _lf_zero_delay_cycle_action_table_size;
   lf_action_base_t** action_table = _lf_zero_delay_cycle_action_table;
 #endif // FEDERATED_DECENTRALIZED
-  for (size_t i = 0; i < action_table_size; i++) {
+  if (ports_by_level == NULL) {
+    sort_ports_by_level(action_table, action_table_size);
+  }
+  if (lf_tag_compare(env->current_tag, ports_by_level_tag) != 0) {
+    ports_by_level_tag = env->current_tag;
+    ports_by_level_next = 0;
+  }
+  // The MLAA is the level of the first port, in order of level, that blocks.
+  for (; ports_by_level_next < ports_by_level_size; ports_by_level_next++) {
+    size_t i = ports_by_level[ports_by_level_next];
     lf_action_base_t* input_port_action = action_table[i];
 #ifdef FEDERATED_DECENTRALIZED
     // In decentralized execution, if the current_tag is close enough to the
@@ -2689,15 +5170,13 @@ bool lf_update_max_level(tag_t tag, bool is_provisional) {
     }
 #endif // FEDERATED_DECENTRALIZED
        // If the current tag is greater than the last known status tag of the input port,
-       // and the input port is not physical, then block on that port by ensuring
-       // the MLAA is no greater than the level of that port.
+       // then block on that port by ensuring the MLAA is no greater than the level of that port.
        // For centralized coordination, this is applied only to input ports coming from
        // federates that are in a ZDC.  For decentralized coordination, this is applied
        // to all input ports.
-    if (lf_tag_compare(env->current_tag, input_port_action->trigger->last_known_status_tag) > 0 &&
-        !input_port_action->trigger->is_physical) {
-      max_level_allowed_to_advance =
-          LF_MIN(max_level_allowed_to_advance, ((int)LF_LEVEL(input_port_action->trigger->reactions[0]->index)));
+    if (lf_tag_compare(env->current_tag, input_port_action->trigger->last_known_status_tag) > 0) {
+      max_level_allowed_to_advance = level_of_port(input_port_action);
+      break;
     }
   }
   LF_PRINT_DEBUG("Updated MLAA to %d at time " PRINTF_TIME ".", max_level_allowed_to_advance,
@@ -2705,4 +5184,348 @@ bool lf_update_max_level(tag_t tag, bool is_provisional) {
   return (prev_max_level_allowed_to_advance != max_level_allowed_to_advance);
 }
 
+
+#ifdef LF_FEDERATED_OPTIMISTIC
+/** The triggers of the network input ports, sorted by address. */
+static trigger_t** network_input_triggers = NULL;
+
+/** The tag that was started last, or NEVER before the first. */
+static tag_t started_tag = {.time = NEVER, .microstep = 0u};
+
+/** The thread that commits the speculative tags as their deadlines pass, and whether it should stop. */
+static lf_thread_t committer;
+static bool committer_done = false;
+
+/** @brief Compare the addresses of two triggers for sorting and searching `network_input_triggers`. */
+static int compare_triggers(const void* a, const void* b) {
+  uintptr_t x = (uintptr_t)(*(trigger_t* const*)a);
+  uintptr_t y = (uintptr_t)(*(trigger_t* const*)b);
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Return whether events of a trigger come from outside the federate, which are the
+ * physical actions and the network input ports. These are not saved in the checkpoints, but
+ * recorded as they are handled.
+ */
+static bool is_external(trigger_t* trigger) {
+  return trigger->is_physical || bsearch(&trigger, network_input_triggers, _lf_action_table_size, sizeof(trigger_t*),
+                                         compare_triggers) != NULL;
+}
+
+/** @brief Return whether events of a trigger are saved in the checkpoints (see is_external()). */
+static bool is_internal(trigger_t* trigger) { return !is_external(trigger); }
+
+/**
+ * @brief Return the physical time after which no message for a tag is expected on the ports
+ * whose status at that tag is not confirmed, which is when the STAA offsets of the ports
+ * expire, or NEVER if the status of every port is confirmed.
+ * @param tag The tag.
+ */
+static instant_t commit_deadline(tag_t tag) {
+  staa_t none = {.STAA = 0};
+  instant_t deadline = NEVER;
+  for (size_t i = 0; i < _lf_action_table_size; i++) {
+    if (_lf_action_table[i]->trigger->is_physical || lf_tag_compare(confirmed_tags[i], tag) >= 0) {
+      continue;
+    }
+    staa_t* staa_elem = staa_of_port[i] != NULL ? staa_of_port[i] : &none;
+    deadline = LF_MAX(deadline, staa_deadline(tag.time, staa_elem));
+  }
+  return deadline;
+}
+
+/**
+ * @brief Commit the oldest speculative tags whose deadlines have passed, so that they are not rolled back.
+ * The caller must hold the mutex of the top-level environment.
+ * @param now The current physical time.
+ * @return The physical time at which the oldest remaining speculative tag can be committed, or FOREVER.
+ */
+static instant_t commit_speculations_locked(instant_t now) {
+  if (straggler_tag.time != FOREVER) {
+    // The rollback comes first.
+    return FOREVER;
+  }
+  instant_t deadline = FOREVER;
+  size_t committed = 0;
+  while (num_speculations > 0) {
+    deadline = commit_deadline(speculations[first_speculation].checkpoint.tag);
+    if (deadline > now) {
+      break;
+    }
+    first_speculation = (first_speculation + 1) % LF_FEDERATED_OPTIMISTIC;
+    num_speculations--;
+    committed++;
+    deadline = FOREVER;
+  }
+  if (committed == 0) {
+    return deadline;
+  }
+  LF_MUTEX_LOCK(&held_mutex);
+  final_tag = num_speculations > 0 ? speculations[first_speculation].previous : FOREVER_TAG;
+  LF_MUTEX_UNLOCK(&held_mutex);
+  // The events handled at tags that are final are not handled again.
+  size_t kept = 0;
+  for (size_t i = 0; i < num_handled_events; i++) {
+    if (lf_tag_compare(handled_events[i].tag, final_tag) <= 0) {
+      _lf_done_using(handled_events[i].token);
+    } else {
+      handled_events[kept++] = handled_events[i];
+    }
+  }
+  num_handled_events = kept;
+  notify_speculation_changed_locked();
+  return deadline;
+}
+
+/**
+ * @brief The thread that commits the speculative tags as their deadlines pass, sends the
+ * messages held until then, and reports the completed tags that are final to the RTI.
+ */
+static void* commit_speculations(void* ignored) {
+  (void)ignored;
+  environment_t* env;
+  _lf_get_environments(&env);
+  LF_MUTEX_LOCK(&env->mutex);
+  while (!committer_done) {
+    instant_t deadline = commit_speculations_locked(lf_time_physical());
+    size_t changes = speculation_changes;
+    LF_MUTEX_UNLOCK(&env->mutex);
+    release_held_messages();
+    LF_MUTEX_LOCK(&env->mutex);
+    lf_latest_tag_complete(completed_tag);
+    if (committer_done || changes != speculation_changes) {
+      continue;
+    }
+    if (deadline == FOREVER) {
+      LF_COND_WAIT(&speculation_changed);
+    } else {
+      lf_clock_cond_timedwait(&speculation_changed, deadline);
+    }
+  }
+  LF_MUTEX_UNLOCK(&env->mutex);
+  return NULL;
+}
+
+/**
+ * @brief Prepare for optimistic execution once the start time is known, and start the committer.
+ * @param env The top-level environment.
+ */
+static void start_speculation(environment_t* env) {
+  LF_MUTEX_INIT(&held_mutex);
+  LF_COND_INIT(&speculation_changed, &env->mutex);
+  tag_t* confirmed = (tag_t*)malloc((_lf_action_table_size + 1) * sizeof(tag_t));
+  network_input_triggers = (trigger_t**)calloc(_lf_action_table_size + 1, sizeof(trigger_t*));
+  LF_ASSERT_NON_NULL(confirmed);
+  LF_ASSERT_NON_NULL(network_input_triggers);
+  for (size_t i = 0; i < _lf_action_table_size; i++) {
+    confirmed[i] = NEVER_TAG;
+    network_input_triggers[i] = _lf_action_table[i]->trigger;
+  }
+  qsort(network_input_triggers, _lf_action_table_size, sizeof(trigger_t*), compare_triggers);
+  for (size_t i = 0; i < LF_FEDERATED_OPTIMISTIC; i++) {
+    speculations[i].checkpoint = (lf_checkpoint_memory_t){.block = NULL, .size = 0, .capacity = 0, .tag = NEVER_TAG};
+  }
+  // The threads that receive messages already confirm port statuses once this is set.
+  LF_MUTEX_LOCK(&env->mutex);
+  confirmed_tags = confirmed;
+  LF_MUTEX_UNLOCK(&env->mutex);
+  if (lf_thread_create(&committer, commit_speculations, NULL) != 0) {
+    lf_print_error_and_exit("Failed to create the thread that commits speculative tags.");
+  }
+}
+
+/**
+ * @brief Stop the committer and free the state of the speculation, on normal termination.
+ * @param env The top-level environment.
+ */
+static void stop_speculation(environment_t* env) {
+  if (confirmed_tags == NULL || !_lf_normal_termination) {
+    return;
+  }
+  LF_MUTEX_LOCK(&env->mutex);
+  committer_done = true;
+  lf_cond_broadcast(&speculation_changed);
+  LF_MUTEX_UNLOCK(&env->mutex);
+  lf_thread_join(committer, NULL);
+  release_held_messages();
+  for (size_t i = 0; i < LF_FEDERATED_OPTIMISTIC; i++) {
+    _lf_checkpoint_free_memory(&speculations[i].checkpoint);
+  }
+  num_speculations = 0;
+  for (size_t i = 0; i < num_handled_events; i++) {
+    _lf_done_using(handled_events[i].token);
+  }
+  free(handled_events);
+  handled_events = NULL;
+  num_handled_events = 0;
+  while (held_messages != NULL) {
+    held_message_t* held = held_messages;
+    held_messages = held->next;
+    network_buffer_free((unsigned char*)held, sizeof(held_message_t) + held->size);
+  }
+  held_messages_end = &held_messages;
+  free(confirmed_tags);
+  confirmed_tags = NULL;
+  free(network_input_triggers);
+  network_input_triggers = NULL;
+  LF_PRINT_LOG("Optimistic execution: %zu tags speculated, %zu rollbacks.", speculated_tags, rollbacks);
+}
+
+void lf_optimistic_tag_started_locked(environment_t* env) {
+  tag_t previous = started_tag;
+  started_tag = env->current_tag;
+  if (confirmed_tags == NULL || previous.time == NEVER) {
+    // Execution has not started, or this is the start tag, before which there is nothing to roll back to.
+    return;
+  }
+  commit_speculations_locked(lf_time_physical());
+  if (speculation_disabled || fast || num_speculations == LF_FEDERATED_OPTIMISTIC) {
+    return;
+  }
+  // Speculate only if the status of a port is not known, which would make the tag wait.
+  bool unknown = false;
+  for (size_t i = 0; i < _lf_action_table_size && !unknown; i++) {
+    trigger_t* trigger = _lf_action_table[i]->trigger;
+    unknown = !trigger->is_physical && lf_tag_compare(trigger->last_known_status_tag, env->current_tag) < 0;
+  }
+  if (!unknown) {
+    return;
+  }
+  speculation_t* speculation = &speculations[(first_speculation + num_speculations) % LF_FEDERATED_OPTIMISTIC];
+  if (_lf_checkpoint_to_memory(env, is_internal, &speculation->checkpoint) != 0) {
+    lf_print_warning("Failed to save the state of the federate. Optimistic execution stops.");
+    speculation_disabled = true;
+    return;
+  }
+  speculation->previous = previous;
+  if (num_speculations++ == 0) {
+    LF_MUTEX_LOCK(&held_mutex);
+    final_tag = previous;
+    LF_MUTEX_UNLOCK(&held_mutex);
+  }
+  speculated_tags++;
+  notify_speculation_changed_locked();
+}
+
+void lf_optimistic_event_popped_locked(environment_t* env, event_t* event) {
+  (void)env;
+  if (num_speculations > 0 && is_external(event->trigger)) {
+    record_handled_event_locked(event->trigger, event->base.tag, event->intended_tag, event->token);
+  }
+}
+
+bool lf_optimistic_rollback_pending_locked(void) { return straggler_tag.time != FOREVER; }
+
+/**
+ * @brief Discard the events of the triggers that are saved in the checkpoints, which a rollback restores.
+ * @param env The top-level environment.
+ */
+static void discard_internal_events_locked(environment_t* env) {
+  vector_t kept = vector_new(pqueue_tag_size(env->event_q) + vector_size(&env->next_microstep_events) + 1);
+  event_t* event;
+  while ((event = (event_t*)pqueue_tag_pop(env->event_q)) != NULL) {
+    vector_push(&kept, event);
+  }
+  vector_pushall(&kept, env->next_microstep_events.start, vector_size(&env->next_microstep_events));
+  vector_clear(&env->next_microstep_events);
+  for (size_t i = 0; i < vector_size(&kept); i++) {
+    event = VECTOR_GET(&kept, i, event_t*);
+    if (event->trigger == NULL || is_external(event->trigger)) {
+      pqueue_tag_insert(env->event_q, &event->base);
+    } else {
+      _lf_forget_pending_event(event);
+      _lf_done_using(event->token);
+      lf_recycle_event(env, event);
+    }
+  }
+  vector_free(&kept);
+}
+
+bool lf_optimistic_roll_back_locked(environment_t* env, bool settle) {
+  if (settle) {
+    // Wait until the speculative tags are committed or a straggler arrives.
+    while (num_speculations > 0 && straggler_tag.time == FOREVER) {
+      LF_COND_WAIT(&speculation_changed);
+    }
+    if (straggler_tag.time == FOREVER) {
+      LF_MUTEX_UNLOCK(&env->mutex);
+      release_held_messages();
+      LF_MUTEX_LOCK(&env->mutex);
+      lf_latest_tag_complete(env->current_tag);
+      return false;
+    }
+  }
+  if (straggler_tag.time == FOREVER) {
+    return false;
+  }
+  // Roll back to the start of the latest speculative tag that is not later than the straggler.
+  size_t target = num_speculations;
+  while (target > 0 &&
+         lf_tag_compare(speculations[(first_speculation + target - 1) % LF_FEDERATED_OPTIMISTIC].previous,
+                        straggler_tag) >= 0) {
+    target--;
+  }
+  LF_ASSERT(target > 0, "A straggler arrived for a tag that is final.");
+  speculation_t* speculation = &speculations[(first_speculation + target - 1) % LF_FEDERATED_OPTIMISTIC];
+  tag_t previous = speculation->previous;
+  LF_PRINT_LOG("Rolling back from tag " PRINTF_TAG " to tag " PRINTF_TAG " for a straggler with tag " PRINTF_TAG ".",
+               env->current_tag.time - start_time, env->current_tag.microstep, previous.time - start_time,
+               previous.microstep, straggler_tag.time - start_time, straggler_tag.microstep);
+
+  discard_internal_events_locked(env);
+  env->current_tag = previous;
+  _lf_checkpoint_from_memory(env, &speculation->checkpoint);
+
+  // The events from outside the federate that were handled since are handled again.
+  size_t kept = 0;
+  for (size_t i = 0; i < num_handled_events; i++) {
+    handled_event_t* handled = &handled_events[i];
+    if (lf_tag_compare(handled->tag, previous) <= 0) {
+      handled_events[kept++] = *handled;
+      continue;
+    }
+    tag_t intended_tag = handled->trigger->intended_tag;
+    handled->trigger->intended_tag = handled->intended_tag;
+    _lf_schedule_at_tag(env, handled->trigger, handled->tag, handled->token);
+    handled->trigger->intended_tag = intended_tag;
+    _lf_done_using(handled->token);
+  }
+  num_handled_events = kept;
+
+  // The ports are known only as far as the messages received on them tell.
+  for (size_t i = 0; i < _lf_action_table_size; i++) {
+    _lf_action_table[i]->trigger->last_known_status_tag = confirmed_tags[i];
+  }
+  staa_tag = NEVER_TAG;
+  ports_by_level_tag = NEVER_TAG;
+
+  started_tag = previous;
+  num_speculations = target - 1;
+  straggler_tag = FOREVER_TAG;
+
+  // The messages sent at the tags rolled back are not sent.
+  LF_MUTEX_LOCK(&held_mutex);
+  held_message_t** link = &held_messages;
+  while (*link != NULL && lf_tag_compare((*link)->tag, previous) <= 0) {
+    link = &(*link)->next;
+  }
+  while (*link != NULL) {
+    held_message_t* held = *link;
+    *link = held->next;
+    network_buffer_free((unsigned char*)held, sizeof(held_message_t) + held->size);
+  }
+  held_messages_end = link;
+  if (num_speculations == 0) {
+    final_tag = FOREVER_TAG;
+  }
+  LF_MUTEX_UNLOCK(&held_mutex);
+  completed_tag = previous;
+
+  rollbacks++;
+  notify_speculation_changed_locked();
+  return true;
+}
+#endif // LF_FEDERATED_OPTIMISTIC
+
 #endif
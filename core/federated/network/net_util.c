@@ -30,6 +30,10 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * Utility functions for a federate in a federated execution.
  */
 
+#if defined(PLATFORM_Linux)
+#define _GNU_SOURCE // Needed for splice()
+#endif
+
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
@@ -47,12 +51,29 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 // Define socket functions only for federated execution.
 #ifdef FEDERATED
-#include <unistd.h> // Defines read(), write(), and close()
+#include <unistd.h>  // Defines read(), write(), and close()
+#include <ifaddrs.h> // Defines getifaddrs()
+#include <sys/uio.h> // Defines writev()
+#include <sys/un.h>  // Defines struct sockaddr_un
+#include <poll.h>    // Defines poll()
+#if defined(PLATFORM_Linux)
+#include <fcntl.h> // Defines splice()
+#endif
+#ifdef LF_FEDERATED_RDMA
+#include "rdma.h"
+#endif
+#ifdef LF_FEDERATED_IO_URING
+#include <sys/mman.h>    // Defines mmap()
+#include <sys/syscall.h> // Defines the numbers of the io_uring system calls
+#endif
 
 #ifndef NUMBER_OF_FEDERATES
 #define NUMBER_OF_FEDERATES 1
 #endif
 
+/** The size of the chunks in which forward_between_sockets() copies bytes through user space. */
+#define FORWARD_BUFFER_SIZE 4096
+
 /** Number of nanoseconds to sleep before retrying a socket read. */
 #define SOCKET_READ_RETRY_INTERVAL 1000000
 
@@ -85,18 +106,155 @@ int create_real_time_tcp_socket_errexit() {
   }
 #endif // Linux
 
+#if defined(LF_FEDERATED_BUSY_POLL) && defined(PLATFORM_Linux)
+  int busy_poll = LF_FEDERATED_BUSY_POLL;
+  if (setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(int)) < 0) {
+    lf_print_warning("Failed to busy poll socket %d for %d usec: %s.", sock, busy_poll, strerror(errno));
+  }
+#ifdef SO_PREFER_BUSY_POLL
+  if (setsockopt(sock, SOL_SOCKET, SO_PREFER_BUSY_POLL, &flag, sizeof(int)) < 0) {
+    lf_print_warning("Failed to prefer busy polling on socket %d: %s.", sock, strerror(errno));
+  }
+#endif
+#endif // LF_FEDERATED_BUSY_POLL
+#ifdef LF_FEDERATED_SEND_BUFFER_SIZE
+  int send_buffer_size = LF_FEDERATED_SEND_BUFFER_SIZE;
+  if (setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &send_buffer_size, sizeof(int)) < 0) {
+    lf_print_warning("Failed to set the send buffer of socket %d to %d bytes: %s.", sock, send_buffer_size,
+                     strerror(errno));
+  }
+#endif
+#ifdef LF_FEDERATED_RECEIVE_BUFFER_SIZE
+  int receive_buffer_size = LF_FEDERATED_RECEIVE_BUFFER_SIZE;
+  if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &receive_buffer_size, sizeof(int)) < 0) {
+    lf_print_warning("Failed to set the receive buffer of socket %d to %d bytes: %s.", sock, receive_buffer_size,
+                     strerror(errno));
+  }
+#endif
+
   return sock;
 }
 
-int read_from_socket(int socket, size_t num_bytes, unsigned char* buffer) {
-  if (socket < 0) {
-    // Socket is not open.
-    errno = EBADF;
+int create_UDP_socket(uint16_t* port) {
+  int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock < 0) {
+    return -1;
+  }
+  // Port 0 lets bind choose any port, which is then retrieved and returned.
+  struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(0u), .sin_addr.s_addr = INADDR_ANY};
+  socklen_t address_length = sizeof(address);
+  if (bind(sock, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+      getsockname(sock, (struct sockaddr*)&address, &address_length) < 0) {
+    close(sock);
+    return -1;
+  }
+  *port = ntohs(address.sin_port);
+  return sock;
+}
+
+bool is_local_address(struct in_addr address) {
+  if ((ntohl(address.s_addr) >> 24) == 127) {
+    return true;
+  }
+  struct ifaddrs* interfaces;
+  if (getifaddrs(&interfaces) != 0) {
+    return false;
+  }
+  bool result = false;
+  for (struct ifaddrs* i = interfaces; i != NULL && !result; i = i->ifa_next) {
+    if (i->ifa_addr != NULL && i->ifa_addr->sa_family == AF_INET) {
+      result = ((struct sockaddr_in*)i->ifa_addr)->sin_addr.s_addr == address.s_addr;
+    }
+  }
+  freeifaddrs(interfaces);
+  return result;
+}
+
+/** @brief Set up the address of the Unix domain socket server for the given TCP port. */
+static void local_socket_address(uint16_t port, struct sockaddr_un* address) {
+  memset(address, 0, sizeof(struct sockaddr_un));
+  address->sun_family = AF_UNIX;
+  snprintf(address->sun_path, sizeof(address->sun_path), LOCAL_SOCKET_PATH_FORMAT, port);
+}
+
+int create_local_server_socket(uint16_t port) {
+  struct sockaddr_un address;
+  local_socket_address(port, &address);
+  int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0) {
+    lf_print_warning("Could not open local socket. Federates on this host will connect using TCP.");
+    return -1;
+  }
+  // A path left behind by an earlier execution that used the same port is stale
+  // because this federate now holds the port.
+  unlink(address.sun_path);
+  if (bind(sock, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(sock, 128) < 0) {
+    lf_print_warning("Failed to bind local socket %s. Federates on this host will connect using TCP.",
+                     address.sun_path);
+    close(sock);
+    return -1;
+  }
+  LF_PRINT_LOG("Local socket server for federates on this host started at %s.", address.sun_path);
+  return sock;
+}
+
+int connect_to_local_server_socket(uint16_t port) {
+  struct sockaddr_un address;
+  local_socket_address(port, &address);
+  int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0) {
+    return -1;
+  }
+  if (connect(sock, (struct sockaddr*)&address, sizeof(address)) < 0) {
+    LF_PRINT_DEBUG("Failed to connect to local socket %s: %s.", address.sun_path, strerror(errno));
+    close(sock);
     return -1;
   }
-  ssize_t bytes_read = 0;
-  while (bytes_read < (ssize_t)num_bytes) {
-    ssize_t more = read(socket, buffer + bytes_read, num_bytes - (size_t)bytes_read);
+  return sock;
+}
+
+void close_local_server_socket(int socket, uint16_t port) {
+  struct sockaddr_un address;
+  local_socket_address(port, &address);
+  close(socket);
+  unlink(address.sun_path);
+}
+
+/** The buffer through which the calling thread reads, if any. See start_buffered_reads_from_socket(). */
+static thread_local socket_receive_buffer_t* receive_buffer = NULL;
+
+void start_buffered_reads_from_socket(int socket, socket_receive_buffer_t* buffer) {
+  buffer->socket = socket;
+  buffer->start = 0;
+  buffer->end = 0;
+  receive_buffer = buffer;
+}
+
+void end_buffered_reads_from_socket(void) { receive_buffer = NULL; }
+
+/** Shut down and close a socket on which I/O failed, detaching its RDMA channel if it has one. */
+static void close_socket_on_error(int socket) {
+#ifdef LF_FEDERATED_RDMA
+  rdma_detach_socket(socket);
+#endif
+  shutdown(socket, SHUT_RDWR);
+  close(socket);
+}
+
+/**
+ * Read at least one and at most the specified number of bytes from the specified socket,
+ * retrying as read_from_socket() does.
+ * @return The number of bytes read, 0 for EOF, and -1 for an error.
+ */
+static ssize_t read_available_from_socket(int socket, size_t max_bytes, unsigned char* buffer) {
+#ifdef LF_FEDERATED_RDMA
+  rdma_channel_t* channel = rdma_channel_of_socket(socket);
+  if (channel != NULL) {
+    return rdma_channel_read(channel, max_bytes, buffer);
+  }
+#endif
+  while (true) {
+    ssize_t more = read(socket, buffer, max_bytes);
     if (more < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
       // Those error codes set by the socket indicates
       // that we should try again (@see man errno).
@@ -106,16 +264,81 @@ int read_from_socket(int socket, size_t num_bytes, unsigned char* buffer) {
     } else if (more < 0) {
       // A more serious error occurred.
       lf_print_error("Reading from socket %d failed. With error: `%s`", socket, strerror(errno));
+    }
+    return more;
+  }
+}
+
+#ifdef LF_FEDERATED_SPIN_RECEIVE
+/**
+ * Busy wait until the specified socket has bytes to read, has been closed or has failed, so that the
+ * read that follows does not sleep.
+ */
+static void spin_until_readable(int socket) {
+#ifdef LF_FEDERATED_RDMA
+  if (rdma_channel_of_socket(socket) != NULL) {
+    return; // The channel has a receive path of its own.
+  }
+#endif
+  struct pollfd fd = {.fd = socket, .events = POLLIN};
+  while (poll(&fd, 1, 0) == 0) {
+    LF_CPU_RELAX();
+  }
+}
+#endif // LF_FEDERATED_SPIN_RECEIVE
+
+int read_from_socket(int socket, size_t num_bytes, unsigned char* buffer) {
+  if (socket < 0) {
+    // Socket is not open.
+    errno = EBADF;
+    return -1;
+  }
+  socket_receive_buffer_t* buffered =
+      (receive_buffer != NULL && receive_buffer->socket == socket) ? receive_buffer : NULL;
+  size_t bytes_read = 0;
+  while (bytes_read < num_bytes) {
+    ssize_t more;
+    if (buffered != NULL && buffered->start < buffered->end) {
+      // Take what is left in the buffer.
+      more = (ssize_t)LF_MIN(buffered->end - buffered->start, num_bytes - bytes_read);
+      memcpy(buffer + bytes_read, buffered->bytes + buffered->start, (size_t)more);
+      buffered->start += (size_t)more;
+    } else if (buffered != NULL && num_bytes - bytes_read < SOCKET_RECEIVE_BUFFER_SIZE) {
+      // Refill the buffer, then take from it in the next iteration.
+#ifdef LF_FEDERATED_SPIN_RECEIVE
+      spin_until_readable(socket);
+#endif
+      more = read_available_from_socket(socket, SOCKET_RECEIVE_BUFFER_SIZE, buffered->bytes);
+      if (more > 0) {
+        buffered->start = 0;
+        buffered->end = (size_t)more;
+        continue;
+      }
+    } else {
+      // Large reads go directly to the destination.
+      more = read_available_from_socket(socket, num_bytes - bytes_read, buffer + bytes_read);
+    }
+    if (more < 0) {
       return -1;
     } else if (more == 0) {
       // EOF received.
       return 1;
     }
-    bytes_read += more;
+    bytes_read += (size_t)more;
   }
   return 0;
 }
 
+unsigned char* take_buffered_bytes_from_socket(int socket, size_t num_bytes) {
+  if (receive_buffer == NULL || receive_buffer->socket != socket ||
+      receive_buffer->end - receive_buffer->start < num_bytes) {
+    return NULL;
+  }
+  unsigned char* bytes = receive_buffer->bytes + receive_buffer->start;
+  receive_buffer->start += num_bytes;
+  return bytes;
+}
+
 int read_from_socket_close_on_error(int* socket, size_t num_bytes, unsigned char* buffer) {
   assert(socket);
   int read_failed = read_from_socket(*socket, num_bytes, buffer);
@@ -123,8 +346,7 @@ int read_from_socket_close_on_error(int* socket, size_t num_bytes, unsigned char
     // Read failed.
     // Socket has probably been closed from the other side.
     // Shut down and close the socket from this side.
-    shutdown(*socket, SHUT_RDWR);
-    close(*socket);
+    close_socket_on_error(*socket);
     // Mark the socket closed.
     *socket = -1;
     return -1;
@@ -153,6 +375,16 @@ void read_from_socket_fail_on_error(int* socket, size_t num_bytes, unsigned char
 }
 
 ssize_t peek_from_socket(int socket, unsigned char* result) {
+  if (receive_buffer != NULL && receive_buffer->socket == socket && receive_buffer->start < receive_buffer->end) {
+    *result = receive_buffer->bytes[receive_buffer->start];
+    return 1;
+  }
+#ifdef LF_FEDERATED_RDMA
+  rdma_channel_t* channel = rdma_channel_of_socket(socket);
+  if (channel != NULL) {
+    return rdma_channel_peek(channel, result);
+  }
+#endif
   ssize_t bytes_read = recv(socket, result, 1, MSG_DONTWAIT | MSG_PEEK);
   if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
     return 0;
@@ -166,6 +398,13 @@ int write_to_socket(int socket, size_t num_bytes, unsigned char* buffer) {
     errno = EBADF;
     return -1;
   }
+#ifdef LF_FEDERATED_RDMA
+  rdma_channel_t* channel = rdma_channel_of_socket(socket);
+  if (channel != NULL) {
+    struct iovec bytes = {.iov_base = buffer, .iov_len = num_bytes};
+    return rdma_channel_write(channel, &bytes, 1);
+  }
+#endif
   ssize_t bytes_written = 0;
   while (bytes_written < (ssize_t)num_bytes) {
     ssize_t more = write(socket, buffer + bytes_written, num_bytes - (size_t)bytes_written);
@@ -186,6 +425,62 @@ int write_to_socket(int socket, size_t num_bytes, unsigned char* buffer) {
   return 0;
 }
 
+int writev_to_socket(int socket, struct iovec* buffers, int num_buffers) {
+  if (socket < 0) {
+    // Socket is not open.
+    errno = EBADF;
+    return -1;
+  }
+#ifdef LF_FEDERATED_RDMA
+  rdma_channel_t* channel = rdma_channel_of_socket(socket);
+  if (channel != NULL) {
+    return rdma_channel_write(channel, buffers, num_buffers);
+  }
+#endif
+  while (true) {
+    // Skip what has been written, including empty buffers.
+    while (num_buffers > 0 && buffers->iov_len == 0) {
+      buffers++;
+      num_buffers--;
+    }
+    if (num_buffers == 0) {
+      return 0;
+    }
+    ssize_t more = writev(socket, buffers, num_buffers);
+    if (more <= 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      // See write_to_socket.
+      LF_PRINT_DEBUG("Writing to socket %d was blocked. Will try again.", socket);
+      lf_sleep(DELAY_BETWEEN_SOCKET_RETRIES);
+      continue;
+    } else if (more < 0) {
+      // A more serious error occurred.
+      lf_print_error("Writing to socket %d failed. With error: `%s`", socket, strerror(errno));
+      return -1;
+    }
+    // The write may end in the middle of a buffer.
+    for (size_t written = (size_t)more; written > 0; buffers++, num_buffers--) {
+      size_t part = written < buffers->iov_len ? written : buffers->iov_len;
+      buffers->iov_base = (unsigned char*)buffers->iov_base + part;
+      buffers->iov_len -= part;
+      written -= part;
+      if (buffers->iov_len > 0) {
+        break;
+      }
+    }
+  }
+}
+
+int writev_to_socket_close_on_error(int* socket, struct iovec* buffers, int num_buffers) {
+  assert(socket);
+  int result = writev_to_socket(*socket, buffers, num_buffers);
+  if (result) {
+    // Write failed. See write_to_socket_close_on_error.
+    close_socket_on_error(*socket);
+    *socket = -1;
+  }
+  return result;
+}
+
 int write_to_socket_close_on_error(int* socket, size_t num_bytes, unsigned char* buffer) {
   assert(socket);
   int result = write_to_socket(*socket, num_bytes, buffer);
@@ -193,8 +488,7 @@ int write_to_socket_close_on_error(int* socket, size_t num_bytes, unsigned char*
     // Write failed.
     // Socket has probably been closed from the other side.
     // Shut down and close the socket from this side.
-    shutdown(*socket, SHUT_RDWR);
-    close(*socket);
+    close_socket_on_error(*socket);
     // Mark the socket closed.
     *socket = -1;
   }
@@ -221,43 +515,302 @@ void write_to_socket_fail_on_error(int* socket, size_t num_bytes, unsigned char*
   }
 }
 
+#if defined(PLATFORM_Linux)
+/** The pipe through which the calling thread splices bytes between sockets, or -1s if it has none. */
+static thread_local int splice_pipe[2] = {-1, -1};
+
+/** @brief Close the pipe of the calling thread, discarding any bytes left in it. */
+static void close_splice_pipe(void) {
+  close(splice_pipe[0]);
+  close(splice_pipe[1]);
+  splice_pipe[0] = -1;
+  splice_pipe[1] = -1;
+}
+
+/**
+ * Move the specified number of bytes from one socket to another through the pipe of the
+ * calling thread, creating it if needed, without copying them to user space.
+ * @return 0 for success, 1 for EOF, -1 for an error, and -2 if splice() cannot be used, in
+ *  which case no bytes have been moved.
+ */
+static int splice_between_sockets(int source, int destination, size_t num_bytes) {
+  if (splice_pipe[0] < 0 && pipe(splice_pipe) != 0) {
+    splice_pipe[0] = -1;
+    splice_pipe[1] = -1;
+    return -2;
+  }
+  bool first = true;
+  while (num_bytes > 0) {
+    ssize_t in_pipe = splice(source, NULL, splice_pipe[1], NULL, num_bytes, SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (in_pipe < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      // See read_from_socket.
+      lf_sleep(DELAY_BETWEEN_SOCKET_RETRIES);
+      continue;
+    } else if (in_pipe < 0 && first && errno == EINVAL) {
+      // The socket does not support splicing.
+      return -2;
+    } else if (in_pipe <= 0) {
+      if (in_pipe < 0) {
+        lf_print_error("Reading from socket %d failed. With error: `%s`", source, strerror(errno));
+      }
+      close_splice_pipe();
+      return in_pipe == 0 ? 1 : -1;
+    }
+    first = false;
+    num_bytes -= (size_t)in_pipe;
+    while (in_pipe > 0) {
+      // Let the kernel hold back a partial segment while more of the message follows.
+      ssize_t more = splice(splice_pipe[0], NULL, destination, NULL, (size_t)in_pipe,
+                            SPLICE_F_MOVE | (num_bytes > 0 ? SPLICE_F_MORE : 0));
+      if (more < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        // See write_to_socket.
+        lf_sleep(DELAY_BETWEEN_SOCKET_RETRIES);
+        continue;
+      } else if (more <= 0) {
+        lf_print_error("Writing to socket %d failed. With error: `%s`", destination, strerror(errno));
+        close_splice_pipe();
+        return -1;
+      }
+      in_pipe -= more;
+    }
+  }
+  return 0;
+}
+#endif // PLATFORM_Linux
+
+int forward_between_sockets(int source, int destination, size_t num_bytes) {
+  if (source < 0 || destination < 0) {
+    // Socket is not open.
+    errno = EBADF;
+    return -1;
+  }
+  // The bytes that the calling thread has already read from the source go first.
+  if (receive_buffer != NULL && receive_buffer->socket == source && receive_buffer->start < receive_buffer->end) {
+    size_t buffered = LF_MIN(receive_buffer->end - receive_buffer->start, num_bytes);
+    if (write_to_socket(destination, buffered, receive_buffer->bytes + receive_buffer->start)) {
+      return -1;
+    }
+    receive_buffer->start += buffered;
+    num_bytes -= buffered;
+  }
+  if (num_bytes == 0) {
+    return 0;
+  }
+#if defined(PLATFORM_Linux)
+  int result = splice_between_sockets(source, destination, num_bytes);
+  if (result != -2) {
+    return result;
+  }
+#endif
+  // Copy through user space.
+  unsigned char buffer[FORWARD_BUFFER_SIZE];
+  while (num_bytes > 0) {
+    size_t chunk = LF_MIN(num_bytes, sizeof(buffer));
+    int read_failed = read_from_socket(source, chunk, buffer);
+    if (read_failed) {
+      return read_failed;
+    }
+    if (write_to_socket(destination, chunk, buffer)) {
+      return -1;
+    }
+    num_bytes -= chunk;
+  }
+  return 0;
+}
+
+#ifdef LF_FEDERATED_IO_URING
+int socket_write_ring_init(socket_write_ring_t* ring, unsigned entries, struct iovec* buffers, unsigned num_buffers) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  memset(ring, 0, sizeof(socket_write_ring_t));
+  ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0) {
+    return -1;
+  }
+  ring->entries = params.sq_entries;
+  ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    // Both queues are in one mapping.
+    if (ring->cq_ring_size > ring->sq_ring_size) {
+      ring->sq_ring_size = ring->cq_ring_size;
+    }
+    ring->cq_ring_size = ring->sq_ring_size;
+  }
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                       IORING_OFF_SQ_RING);
+  ring->cq_ring = ring->sq_ring;
+  if (ring->sq_ring != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+    ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_CQ_RING);
+  }
+  ring->sqes = MAP_FAILED;
+  if (ring->cq_ring != MAP_FAILED) {
+    ring->sqes =
+        mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  }
+  if (ring->sqes == MAP_FAILED ||
+      syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, buffers, num_buffers) < 0) {
+    int error = errno;
+    socket_write_ring_free(ring);
+    errno = error;
+    return -1;
+  }
+  unsigned char* sq = (unsigned char*)ring->sq_ring;
+  ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+  ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+  unsigned char* cq = (unsigned char*)ring->cq_ring;
+  ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+  return 0;
+}
+
+/** @brief Add a write of the rest of the bytes of the write with the specified index to the submission queue. */
+static void submit_socket_write(socket_write_ring_t* ring, socket_write_t* write, size_t index, size_t written) {
+  unsigned tail = *ring->sq_tail;
+  unsigned slot = tail & *ring->sq_mask;
+  struct io_uring_sqe* sqe = &ring->sqes[slot];
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->opcode = IORING_OP_WRITE_FIXED;
+  sqe->fd = write->socket;
+  sqe->addr = (uint64_t)(uintptr_t)(write->bytes + written);
+  sqe->len = (uint32_t)(write->length - written);
+  sqe->buf_index = (uint16_t)write->buffer_index;
+  sqe->user_data = index;
+  ring->sq_array[slot] = slot;
+  // The kernel must see the entry before the new tail.
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+void socket_write_ring_write_all(socket_write_ring_t* ring, socket_write_t* writes, size_t num_writes) {
+  if (num_writes == 0) {
+    return;
+  }
+  size_t next = 0;
+  size_t in_flight = 0;
+  unsigned to_submit = 0;
+  size_t written[num_writes]; // The number of bytes written of each write.
+  for (size_t i = 0; i < num_writes; i++) {
+    written[i] = 0;
+    writes[i].error = 0;
+  }
+  while (next < num_writes || in_flight > 0) {
+    // Fill the submission queue with the writes that have not started yet.
+    while (next < num_writes && in_flight < ring->entries) {
+      if (writes[next].length > 0) {
+        submit_socket_write(ring, &writes[next], next, 0);
+        to_submit++;
+        in_flight++;
+      }
+      next++;
+    }
+    if (in_flight == 0) {
+      break;
+    }
+    // Submit the new entries and wait for at least one completion.
+    int result = (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (result < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+        continue;
+      }
+      lf_print_error_system_failure("Failed to submit writes to the io_uring.");
+    }
+    to_submit -= (unsigned)result;
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+      size_t index = (size_t)cqe->user_data;
+      int res = cqe->res;
+      in_flight--;
+      if (res == -EAGAIN || res == -EINTR) {
+        res = 0; // Try again below.
+      } else if (res < 0) {
+        writes[index].error = -res;
+        lf_print_error("Writing to socket %d failed. With error: `%s`", writes[index].socket, strerror(-res));
+        continue;
+      } else if (res == 0) {
+        writes[index].error = EPIPE;
+        continue;
+      }
+      written[index] += (size_t)res;
+      if (written[index] < writes[index].length) {
+        // A partial write. Submit the rest.
+        submit_socket_write(ring, &writes[index], index, written[index]);
+        to_submit++;
+        in_flight++;
+      }
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+  }
+}
+
+void socket_write_ring_free(socket_write_ring_t* ring) {
+  if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+  if (ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  }
+  if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED) {
+    munmap(ring->sq_ring, ring->sq_ring_size);
+  }
+  // Closing the ring also unregisters its buffers.
+  close(ring->fd);
+  memset(ring, 0, sizeof(socket_write_ring_t));
+  ring->fd = -1;
+}
+#endif // LF_FEDERATED_IO_URING
+
 #endif // FEDERATED
 
 // Below are more generally useful functions.
 
-void encode_int64(int64_t data, unsigned char* buffer) {
-  // This strategy is fairly brute force, but it avoids potential
-  // alignment problems.
-  int shift = 0;
-  for (size_t i = 0; i < sizeof(int64_t); i++) {
-    buffer[i] = (unsigned char)((data & (0xffLL << shift)) >> shift);
-    shift += 8;
-  }
+/**
+ * Whether the host is big endian. Compilers that say so make it a constant,
+ * so that the byte swaps below compile to nothing on little-endian hosts.
+ */
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+#define HOST_IS_BIG_ENDIAN (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#else
+#define HOST_IS_BIG_ENDIAN host_is_big_endian()
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define bswap16(x) __builtin_bswap16(x)
+#define bswap32(x) __builtin_bswap32(x)
+#define bswap64(x) __builtin_bswap64(x)
+#else
+static inline uint16_t bswap16(uint16_t x) { return (uint16_t)((x << 8) | (x >> 8)); }
+static inline uint32_t bswap32(uint32_t x) {
+  return (x << 24) | ((x << 8) & 0xff0000u) | ((x >> 8) & 0xff00u) | (x >> 24);
 }
+static inline uint64_t bswap64(uint64_t x) { return ((uint64_t)bswap32((uint32_t)x) << 32) | bswap32(x >> 32); }
+#endif
+
+// The encoded values are little endian. They are copied a word at a time, which avoids
+// alignment problems because memcpy of a constant size compiles to an unaligned move.
 
-void encode_int32(int32_t data, unsigned char* buffer) {
-  // This strategy is fairly brute force, but it avoids potential
-  // alignment problems.  Note that this assumes an int32_t is four bytes.
-  buffer[0] = (unsigned char)(data & 0xff);
-  buffer[1] = (unsigned char)((data & 0xff00) >> 8);
-  buffer[2] = (unsigned char)((data & 0xff0000) >> 16);
-  buffer[3] = (unsigned char)((data & (int32_t)0xff000000) >> 24);
+void encode_int64(int64_t data, unsigned char* buffer) {
+  uint64_t x = HOST_IS_BIG_ENDIAN ? bswap64((uint64_t)data) : (uint64_t)data;
+  memcpy(buffer, &x, sizeof(x));
 }
 
+void encode_int32(int32_t data, unsigned char* buffer) { encode_uint32((uint32_t)data, buffer); }
+
 void encode_uint32(uint32_t data, unsigned char* buffer) {
-  // This strategy is fairly brute force, but it avoids potential
-  // alignment problems.  Note that this assumes a uint32_t is four bytes.
-  buffer[0] = (unsigned char)(data & 0xff);
-  buffer[1] = (unsigned char)((data & 0xff00) >> 8);
-  buffer[2] = (unsigned char)((data & 0xff0000) >> 16);
-  buffer[3] = (unsigned char)((data & (uint32_t)0xff000000) >> 24);
+  uint32_t x = HOST_IS_BIG_ENDIAN ? bswap32(data) : data;
+  memcpy(buffer, &x, sizeof(x));
 }
 
 void encode_uint16(uint16_t data, unsigned char* buffer) {
-  // This strategy is fairly brute force, but it avoids potential
-  // alignment problems. Note that this assumes a short is two bytes.
-  buffer[0] = (unsigned char)(data & 0xff);
-  buffer[1] = (unsigned char)((data & 0xff00) >> 8);
+  uint16_t x = HOST_IS_BIG_ENDIAN ? bswap16(data) : data;
+  memcpy(buffer, &x, sizeof(x));
 }
 
 int host_is_big_endian() {
@@ -275,134 +828,39 @@ int host_is_big_endian() {
 }
 
 int32_t swap_bytes_if_big_endian_int32(int32_t src) {
-  union {
-    int32_t uint;
-    unsigned char c[sizeof(int32_t)];
-  } x;
-  if (!host_is_big_endian())
-    return src;
-  // printf("DEBUG: Host is little endian.\n");
-  x.uint = src;
-  // printf("DEBUG: Before swapping bytes: %lld.\n", x.ull);
-  unsigned char c;
-  // Swap bytes.
-  c = x.c[0];
-  x.c[0] = x.c[3];
-  x.c[3] = c;
-  c = x.c[1];
-  x.c[1] = x.c[2];
-  x.c[2] = c;
-  // printf("DEBUG: After swapping bytes: %lld.\n", x.ull);
-  return x.uint;
-}
-
-uint32_t swap_bytes_if_big_endian_uint32(uint32_t src) {
-  union {
-    uint32_t uint;
-    unsigned char c[sizeof(uint32_t)];
-  } x;
-  if (!host_is_big_endian())
-    return src;
-  // printf("DEBUG: Host is little endian.\n");
-  x.uint = src;
-  // printf("DEBUG: Before swapping bytes: %lld.\n", x.ull);
-  unsigned char c;
-  // Swap bytes.
-  c = x.c[0];
-  x.c[0] = x.c[3];
-  x.c[3] = c;
-  c = x.c[1];
-  x.c[1] = x.c[2];
-  x.c[2] = c;
-  // printf("DEBUG: After swapping bytes: %lld.\n", x.ull);
-  return x.uint;
+  return HOST_IS_BIG_ENDIAN ? (int32_t)bswap32((uint32_t)src) : src;
 }
 
+uint32_t swap_bytes_if_big_endian_uint32(uint32_t src) { return HOST_IS_BIG_ENDIAN ? bswap32(src) : src; }
+
 int64_t swap_bytes_if_big_endian_int64(int64_t src) {
-  union {
-    int64_t ull;
-    unsigned char c[sizeof(int64_t)];
-  } x;
-  if (!host_is_big_endian())
-    return src;
-  // printf("DEBUG: Host is little endian.\n");
-  x.ull = src;
-  // printf("DEBUG: Before swapping bytes: %lld.\n", x.ull);
-  unsigned char c;
-  // Swap bytes.
-  c = x.c[0];
-  x.c[0] = x.c[7];
-  x.c[7] = c;
-  c = x.c[1];
-  x.c[1] = x.c[6];
-  x.c[6] = c;
-  c = x.c[2];
-  x.c[2] = x.c[5];
-  x.c[5] = c;
-  c = x.c[3];
-  x.c[3] = x.c[4];
-  x.c[4] = c;
-  // printf("DEBUG: After swapping bytes: %lld.\n", x.ull);
-  return x.ull;
-}
-
-uint16_t swap_bytes_if_big_endian_uint16(uint16_t src) {
-  union {
-    uint16_t uint;
-    unsigned char c[sizeof(uint16_t)];
-  } x;
-  if (!host_is_big_endian())
-    return src;
-  // printf("DEBUG: Host is little endian.\n");
-  x.uint = src;
-  // printf("DEBUG: Before swapping bytes: %lld.\n", x.ull);
-  unsigned char c;
-  // Swap bytes.
-  c = x.c[0];
-  x.c[0] = x.c[1];
-  x.c[1] = c;
-  // printf("DEBUG: After swapping bytes: %lld.\n", x.ull);
-  return x.uint;
+  return HOST_IS_BIG_ENDIAN ? (int64_t)bswap64((uint64_t)src) : src;
 }
 
+uint16_t swap_bytes_if_big_endian_uint16(uint16_t src) { return HOST_IS_BIG_ENDIAN ? bswap16(src) : src; }
+
 int32_t extract_int32(unsigned char* bytes) {
-  // Use memcpy to prevent possible alignment problems on some processors.
-  union {
-    int32_t uint;
-    unsigned char c[sizeof(int32_t)];
-  } result;
-  memcpy(&result.c, bytes, sizeof(int32_t));
-  return swap_bytes_if_big_endian_int32(result.uint);
+  int32_t result;
+  memcpy(&result, bytes, sizeof(result));
+  return swap_bytes_if_big_endian_int32(result);
 }
 
 uint32_t extract_uint32(unsigned char* bytes) {
-  // Use memcpy to prevent possible alignment problems on some processors.
-  union {
-    uint32_t uint;
-    unsigned char c[sizeof(uint32_t)];
-  } result;
-  memcpy(&result.c, bytes, sizeof(uint32_t));
-  return swap_bytes_if_big_endian_uint32(result.uint);
+  uint32_t result;
+  memcpy(&result, bytes, sizeof(result));
+  return swap_bytes_if_big_endian_uint32(result);
 }
 
 int64_t extract_int64(unsigned char* bytes) {
-  // Use memcpy to prevent possible alignment problems on some processors.
-  union {
-    int64_t ull;
-    unsigned char c[sizeof(int64_t)];
-  } result;
-  memcpy(&result.c, bytes, sizeof(int64_t));
-  return swap_bytes_if_big_endian_int64(result.ull);
+  int64_t result;
+  memcpy(&result, bytes, sizeof(result));
+  return swap_bytes_if_big_endian_int64(result);
 }
 
 uint16_t extract_uint16(unsigned char* bytes) {
-  // Use memcpy to prevent possible alignment problems on some processors.
-  union {
-    uint16_t ushort;
-    unsigned char c[sizeof(uint16_t)];
-  } result;
-  memcpy(&result.c, bytes, sizeof(uint16_t));
-  return swap_bytes_if_big_endian_uint16(result.ushort);
+  uint16_t result;
+  memcpy(&result, bytes, sizeof(result));
+  return swap_bytes_if_big_endian_uint16(result);
 }
 
 #ifdef FEDERATED
@@ -425,11 +883,23 @@ void extract_header(unsigned char* buffer, uint16_t* port_id, uint16_t* federate
 }
 
 void extract_timed_header(unsigned char* buffer, uint16_t* port_id, uint16_t* federate_id, size_t* length, tag_t* tag) {
-  extract_header(buffer, port_id, federate_id, length);
+  // The whole header is read with one copy.
+  lf_timed_header_t header;
+  memcpy(&header, buffer, sizeof(header));
+  *port_id = swap_bytes_if_big_endian_uint16(header.port_id);
+  *federate_id = swap_bytes_if_big_endian_uint16(header.federate_id);
+  *length = (size_t)swap_bytes_if_big_endian_uint32(header.length);
+  tag->time = swap_bytes_if_big_endian_int64(header.time);
+  tag->microstep = swap_bytes_if_big_endian_uint32(header.microstep);
+}
 
-  tag_t temporary_tag = extract_tag(&(buffer[sizeof(uint16_t) + sizeof(uint16_t) + sizeof(int32_t)]));
-  tag->time = temporary_tag.time;
-  tag->microstep = temporary_tag.microstep;
+void encode_timed_header(unsigned char* buffer, uint16_t port_id, uint16_t federate_id, uint32_t length, tag_t tag) {
+  lf_timed_header_t header = {.port_id = swap_bytes_if_big_endian_uint16(port_id),
+                              .federate_id = swap_bytes_if_big_endian_uint16(federate_id),
+                              .length = swap_bytes_if_big_endian_uint32(length),
+                              .time = swap_bytes_if_big_endian_int64(tag.time),
+                              .microstep = swap_bytes_if_big_endian_uint32(tag.microstep)};
+  memcpy(buffer, &header, sizeof(header));
 }
 
 tag_t extract_tag(unsigned char* buffer) {
@@ -0,0 +1,507 @@
+/**
+ * @file
+ * @brief Connections between federates whose bytes are carried by RDMA (ibverbs) rather than TCP.
+ *
+ * Each end of a channel has its own completion queue, with a completion channel on which a
+ * thread waits when there is nothing to poll, and a pool of LF_FEDERATED_RDMA_BUFFERS buffers
+ * of LF_FEDERATED_RDMA_BUFFER_SIZE bytes in one registered memory region. The sending end copies
+ * the bytes of each write into its buffers, in turn, and sends each as one message. The receiving
+ * end keeps all of its buffers posted to receive, and posts each again once it has been read.
+ * Sends complete in order, so the sending end only counts those in flight. If the receiving end
+ * has no buffer posted, the adapter retries the send without limit, which holds back the sender
+ * as a full TCP window would.
+ *
+ * See rdma.h.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <infiniband/verbs.h>
+
+#include "rdma.h"
+#include "net_util.h"
+#include "util.h"
+
+/** The size of each send and receive buffer of a channel, which is the largest message sent on it. */
+#ifndef LF_FEDERATED_RDMA_BUFFER_SIZE
+#define LF_FEDERATED_RDMA_BUFFER_SIZE 16384
+#endif
+
+/** The number of send and receive buffers of each end of a channel. */
+#ifndef LF_FEDERATED_RDMA_BUFFERS
+#define LF_FEDERATED_RDMA_BUFFERS 64
+#endif
+
+/** The index of the GID of the port, which selects the RoCE version and IP address on Ethernet fabrics. */
+#ifndef LF_FEDERATED_RDMA_GID_INDEX
+#define LF_FEDERATED_RDMA_GID_INDEX 0
+#endif
+
+/** The port of the RDMA device that is used. */
+#define RDMA_PORT 1
+
+/** The number of bytes that are sent inline, in the work request, rather than read from the buffer. */
+#define RDMA_MAX_INLINE 64
+
+/** The sockets with IDs below this can have a channel. */
+#define RDMA_MAX_SOCKETS 1024
+
+/** The value of rdma_channel_t.current when no receive buffer is being read. */
+#define NO_BUFFER SIZE_MAX
+
+struct rdma_channel_t {
+  bool receiver;                   // Whether this is the receiving end.
+  int socket;                      // The socket of the connection, or -1 if it is not connected.
+  bool closed;                     // Whether the socket has been detached.
+  struct ibv_comp_channel* events; // The completion channel of cq.
+  struct ibv_cq* cq;               // The completion queue of the sends or receives.
+  struct ibv_qp* qp;               // The queue pair.
+  unsigned char* buffers;          // The send or receive buffers, one after the other.
+  struct ibv_mr* mr;               // The registration of buffers.
+  size_t buffer_size;              // The number of bytes sent in each buffer.
+  uint32_t max_inline;             // The largest message that is sent inline.
+  size_t current;                  // The receive buffer being read, or NO_BUFFER.
+  size_t start;                    // The index of the next byte of the current receive buffer.
+  size_t end;                      // The number of bytes in the current receive buffer.
+  size_t next;                     // The send buffer to fill next.
+  size_t in_flight;                // The number of sends that have not completed.
+  bool failed;                     // Whether a send failed.
+  rdma_channel_t* next_attached;   // The next channel in the list of attached channels.
+};
+
+/** Whether the device has been opened (1), has not been (0), or cannot be (-1). */
+static int device_state = 0;
+static struct ibv_context* device = NULL;
+static struct ibv_pd* protection_domain = NULL;
+static struct ibv_port_attr port_attributes;
+static union ibv_gid port_gid;
+
+/** The channel attached to each socket. */
+static rdma_channel_t* channels_of_sockets[RDMA_MAX_SOCKETS];
+
+/** The list of channels that have been attached, which rdma_free_channels() frees. */
+static rdma_channel_t* attached_channels = NULL;
+
+/**
+ * Open the first RDMA device whose port is active, if that has not been tried yet.
+ * @return 1 if the device is open, -1 if there is none.
+ */
+static int open_device(void) {
+  if (device_state != 0) {
+    return device_state;
+  }
+  device_state = -1;
+  int num_devices = 0;
+  struct ibv_device** devices = ibv_get_device_list(&num_devices);
+  for (int i = 0; devices != NULL && i < num_devices && device == NULL; i++) {
+    struct ibv_context* context = ibv_open_device(devices[i]);
+    if (context == NULL) {
+      continue;
+    }
+    if (ibv_query_port(context, RDMA_PORT, &port_attributes) == 0 && port_attributes.state == IBV_PORT_ACTIVE) {
+      device = context;
+      LF_PRINT_LOG("Using RDMA device %s for connections to other federates.", ibv_get_device_name(devices[i]));
+    } else {
+      ibv_close_device(context);
+    }
+  }
+  if (devices != NULL) {
+    ibv_free_device_list(devices);
+  }
+  if (device == NULL) {
+    lf_print_warning("No RDMA device has an active port. Connections to other federates use TCP.");
+    return device_state;
+  }
+  protection_domain = ibv_alloc_pd(device);
+  if (protection_domain == NULL) {
+    lf_print_warning("Failed to allocate an RDMA protection domain. Connections to other federates use TCP.");
+    ibv_close_device(device);
+    device = NULL;
+    return device_state;
+  }
+  if (ibv_query_gid(device, RDMA_PORT, LF_FEDERATED_RDMA_GID_INDEX, &port_gid) != 0) {
+    // Without a GID, only a fabric that routes by LID can be used.
+    memset(&port_gid, 0, sizeof(port_gid));
+  }
+  device_state = 1;
+  return device_state;
+}
+
+/**
+ * Post the specified receive buffer of the receiving end of a channel.
+ * @return 0 for success, -1 for failure.
+ */
+static int post_receive(rdma_channel_t* channel, size_t index) {
+  struct ibv_sge sge = {.addr = (uintptr_t)(channel->buffers + index * channel->buffer_size),
+                        .length = (uint32_t)channel->buffer_size,
+                        .lkey = channel->mr->lkey};
+  struct ibv_recv_wr request = {.wr_id = index, .sg_list = &sge, .num_sge = 1};
+  struct ibv_recv_wr* bad_request;
+  return ibv_post_recv(channel->qp, &request, &bad_request) == 0 ? 0 : -1;
+}
+
+rdma_channel_t* rdma_channel_create(bool receiver, unsigned char* endpoint) {
+  if (open_device() < 0) {
+    return NULL;
+  }
+  rdma_channel_t* channel = (rdma_channel_t*)calloc(1, sizeof(rdma_channel_t));
+  LF_ASSERT_NON_NULL(channel);
+  channel->receiver = receiver;
+  channel->socket = -1;
+  channel->buffer_size = LF_FEDERATED_RDMA_BUFFER_SIZE;
+  channel->current = NO_BUFFER;
+  size_t bytes = (size_t)LF_FEDERATED_RDMA_BUFFERS * LF_FEDERATED_RDMA_BUFFER_SIZE;
+  channel->buffers = (unsigned char*)malloc(bytes);
+  LF_ASSERT_NON_NULL(channel->buffers);
+
+  channel->events = ibv_create_comp_channel(device);
+  if (channel->events != NULL) {
+    // The sending end also completes the empty message of rdma_channel_probe().
+    channel->cq = ibv_create_cq(device, LF_FEDERATED_RDMA_BUFFERS + 1, NULL, channel->events, 0);
+  }
+  if (channel->cq != NULL) {
+    channel->mr = ibv_reg_mr(protection_domain, channel->buffers, bytes, IBV_ACCESS_LOCAL_WRITE);
+  }
+  if (channel->mr != NULL) {
+    struct ibv_qp_init_attr attributes = {.send_cq = channel->cq,
+                                          .recv_cq = channel->cq,
+                                          .qp_type = IBV_QPT_RC,
+                                          .cap = {.max_send_wr = receiver ? 1 : LF_FEDERATED_RDMA_BUFFERS + 1,
+                                                  .max_recv_wr = receiver ? LF_FEDERATED_RDMA_BUFFERS : 1,
+                                                  .max_send_sge = 1,
+                                                  .max_recv_sge = 1,
+                                                  .max_inline_data = receiver ? 0 : RDMA_MAX_INLINE}};
+    channel->qp = ibv_create_qp(protection_domain, &attributes);
+    channel->max_inline = attributes.cap.max_inline_data;
+  }
+  struct ibv_qp_attr init = {.qp_state = IBV_QPS_INIT, .pkey_index = 0, .port_num = RDMA_PORT};
+  if (channel->qp == NULL ||
+      ibv_modify_qp(channel->qp, &init, IBV_QP_STATE | IBV_QP_PKEY_INDEX | IBV_QP_PORT | IBV_QP_ACCESS_FLAGS) != 0) {
+    lf_print_warning("Failed to create an RDMA queue pair: %s. The connection uses TCP.", strerror(errno));
+    rdma_channel_free(channel);
+    return NULL;
+  }
+  for (size_t i = 0; receiver && i < LF_FEDERATED_RDMA_BUFFERS; i++) {
+    if (post_receive(channel, i) != 0) {
+      lf_print_warning("Failed to post RDMA receive buffers. The connection uses TCP.");
+      rdma_channel_free(channel);
+      return NULL;
+    }
+  }
+
+  encode_uint32(channel->qp->qp_num, endpoint);
+  encode_uint16(port_attributes.lid, &endpoint[sizeof(uint32_t)]);
+  memcpy(&endpoint[sizeof(uint32_t) + sizeof(uint16_t)], port_gid.raw, sizeof(port_gid.raw));
+  encode_uint32(receiver ? (uint32_t)channel->buffer_size : 0u, &endpoint[P2P_RDMA_ENDPOINT_LENGTH - sizeof(uint32_t)]);
+  return channel;
+}
+
+int rdma_channel_connect(rdma_channel_t* channel, int socket, const unsigned char* endpoint) {
+  if (socket < 0 || socket >= RDMA_MAX_SOCKETS) {
+    return -1;
+  }
+  channel->socket = socket;
+  unsigned char remote[P2P_RDMA_ENDPOINT_LENGTH];
+  memcpy(remote, endpoint, sizeof(remote));
+  union ibv_gid remote_gid;
+  memcpy(remote_gid.raw, &remote[sizeof(uint32_t) + sizeof(uint16_t)], sizeof(remote_gid.raw));
+  if (!channel->receiver) {
+    // Messages must fit in the receive buffers of the other end.
+    size_t remote_size = extract_uint32(&remote[P2P_RDMA_ENDPOINT_LENGTH - sizeof(uint32_t)]);
+    if (remote_size == 0) {
+      return -1;
+    }
+    channel->buffer_size = LF_MIN(channel->buffer_size, remote_size);
+  }
+
+  struct ibv_qp_attr rtr = {.qp_state = IBV_QPS_RTR,
+                            .path_mtu = port_attributes.active_mtu,
+                            .dest_qp_num = extract_uint32(remote),
+                            .rq_psn = 0,
+                            .max_dest_rd_atomic = 1,
+                            .min_rnr_timer = 1, // 10 microseconds before a send is retried.
+                            .ah_attr = {.dlid = extract_uint16(&remote[sizeof(uint32_t)]), .port_num = RDMA_PORT}};
+  if (remote_gid.global.interface_id != 0 || remote_gid.global.subnet_prefix != 0) {
+    // Route by GID, which RoCE requires.
+    rtr.ah_attr.is_global = 1;
+    rtr.ah_attr.grh.dgid = remote_gid;
+    rtr.ah_attr.grh.sgid_index = LF_FEDERATED_RDMA_GID_INDEX;
+    rtr.ah_attr.grh.hop_limit = 1;
+  }
+  struct ibv_qp_attr rts = {.qp_state = IBV_QPS_RTS,
+                            .timeout = 14, // 67 milliseconds before a lost packet is sent again.
+                            .retry_cnt = 7,
+                            .rnr_retry = 7, // Retry without limit while the receiver has no buffer posted.
+                            .sq_psn = 0,
+                            .max_rd_atomic = 1};
+  if (ibv_modify_qp(channel->qp, &rtr,
+                    IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU | IBV_QP_DEST_QPN | IBV_QP_RQ_PSN |
+                        IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER) != 0 ||
+      ibv_modify_qp(channel->qp, &rts,
+                    IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT | IBV_QP_RNR_RETRY | IBV_QP_SQ_PSN |
+                        IBV_QP_MAX_QP_RD_ATOMIC) != 0) {
+    LF_PRINT_LOG("Failed to connect an RDMA queue pair: %s.", strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Poll the completion queue of a channel for at most `max` completions. If there is none and `wait`
+ * is true, wait for one. While waiting, also watch the socket of the channel, which has no bytes to
+ * read unless it has been closed or shut down by either federate.
+ * @return The number of completions, 0 if there is none and either `wait` is false or the socket
+ *  has been closed, or -1 for an error.
+ */
+static int poll_completions(rdma_channel_t* channel, struct ibv_wc* completions, int max, bool wait) {
+  while (true) {
+    int count = ibv_poll_cq(channel->cq, max, completions);
+    if (count != 0 || !wait) {
+      return count < 0 ? -1 : count;
+    }
+    if (ibv_req_notify_cq(channel->cq, 0) != 0) {
+      return -1;
+    }
+    // A completion may have been added before the notification was requested.
+    count = ibv_poll_cq(channel->cq, max, completions);
+    if (count != 0) {
+      return count < 0 ? -1 : count;
+    }
+    if (__atomic_load_n(&channel->closed, __ATOMIC_ACQUIRE)) {
+      return 0;
+    }
+    struct pollfd fds[2] = {{.fd = channel->events->fd, .events = POLLIN}, {.fd = channel->socket, .events = POLLIN}};
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (fds[0].revents & POLLIN) {
+      struct ibv_cq* cq;
+      void* context;
+      if (ibv_get_cq_event(channel->events, &cq, &context) == 0) {
+        ibv_ack_cq_events(cq, 1);
+      }
+    } else if (fds[1].revents != 0) {
+      // The socket has been closed, after the completions of all bytes sent on the channel.
+      count = ibv_poll_cq(channel->cq, max, completions);
+      return count < 0 ? -1 : count;
+    }
+  }
+}
+
+/**
+ * Account for the completed sends of the sending end of a channel, waiting for at least one if `wait` is true.
+ * @return 0 for success, -1 if a send failed or the socket has been closed.
+ */
+static int complete_sends(rdma_channel_t* channel, bool wait) {
+  struct ibv_wc completions[LF_FEDERATED_RDMA_BUFFERS + 1];
+  int count = poll_completions(channel, completions, LF_FEDERATED_RDMA_BUFFERS + 1, wait);
+  if (count < 0 || (count == 0 && wait)) {
+    channel->failed = true;
+    return -1;
+  }
+  for (int i = 0; i < count; i++) {
+    if (completions[i].status != IBV_WC_SUCCESS) {
+      LF_PRINT_LOG("RDMA send failed: %s.", ibv_wc_status_str(completions[i].status));
+      channel->failed = true;
+    }
+  }
+  channel->in_flight -= (size_t)count;
+  return channel->failed ? -1 : 0;
+}
+
+/**
+ * Send the specified number of bytes, which have been copied into the next send buffer of a channel.
+ * @return 0 for success, -1 for failure.
+ */
+static int post_send(rdma_channel_t* channel, size_t length) {
+  struct ibv_sge sge = {.addr = (uintptr_t)(channel->buffers + channel->next * channel->buffer_size),
+                        .length = (uint32_t)length,
+                        .lkey = channel->mr->lkey};
+  unsigned int flags = IBV_SEND_SIGNALED | (length <= channel->max_inline ? IBV_SEND_INLINE : 0);
+  struct ibv_send_wr request = {
+      .wr_id = channel->next, .sg_list = &sge, .num_sge = length > 0 ? 1 : 0, .opcode = IBV_WR_SEND, .send_flags = flags};
+  struct ibv_send_wr* bad_request;
+  if (ibv_post_send(channel->qp, &request, &bad_request) != 0) {
+    channel->failed = true;
+    return -1;
+  }
+  channel->in_flight++;
+  channel->next = (channel->next + 1) % LF_FEDERATED_RDMA_BUFFERS;
+  return 0;
+}
+
+int rdma_channel_probe(rdma_channel_t* channel) {
+  if (!channel->receiver) {
+    if (post_send(channel, 0) != 0) {
+      return -1;
+    }
+    return rdma_channel_flush(channel);
+  }
+  struct ibv_wc completion;
+  if (poll_completions(channel, &completion, 1, true) != 1 || completion.status != IBV_WC_SUCCESS ||
+      completion.byte_len != 0) {
+    return -1;
+  }
+  return post_receive(channel, (size_t)completion.wr_id);
+}
+
+void rdma_channel_attach(rdma_channel_t* channel) {
+  channel->next_attached = attached_channels;
+  attached_channels = channel;
+  __atomic_store_n(&channels_of_sockets[channel->socket], channel, __ATOMIC_RELEASE);
+}
+
+void rdma_channel_free(rdma_channel_t* channel) {
+  if (channel == NULL) {
+    return;
+  }
+  if (channel->qp != NULL) {
+    ibv_destroy_qp(channel->qp);
+  }
+  if (channel->mr != NULL) {
+    ibv_dereg_mr(channel->mr);
+  }
+  if (channel->cq != NULL) {
+    ibv_destroy_cq(channel->cq);
+  }
+  if (channel->events != NULL) {
+    ibv_destroy_comp_channel(channel->events);
+  }
+  free(channel->buffers);
+  free(channel);
+}
+
+rdma_channel_t* rdma_channel_of_socket(int socket) {
+  if (socket < 0 || socket >= RDMA_MAX_SOCKETS) {
+    return NULL;
+  }
+  return __atomic_load_n(&channels_of_sockets[socket], __ATOMIC_ACQUIRE);
+}
+
+void rdma_detach_socket(int socket) {
+  if (socket < 0 || socket >= RDMA_MAX_SOCKETS) {
+    return;
+  }
+  rdma_channel_t* channel = __atomic_exchange_n(&channels_of_sockets[socket], NULL, __ATOMIC_ACQ_REL);
+  if (channel != NULL) {
+    __atomic_store_n(&channel->closed, true, __ATOMIC_RELEASE);
+  }
+}
+
+/**
+ * Make the next received bytes of the receiving end of a channel the current buffer, posting the buffer
+ * that has been read again, and waiting for bytes if `wait` is true.
+ * @return 1 if there are bytes to read, 0 if there are none and either `wait` is false or the
+ *  socket has been closed, or -1 for an error.
+ */
+static int next_receive_buffer(rdma_channel_t* channel, bool wait) {
+  while (channel->start == channel->end) {
+    if (channel->current != NO_BUFFER) {
+      if (post_receive(channel, channel->current) != 0) {
+        return -1;
+      }
+      channel->current = NO_BUFFER;
+    }
+    struct ibv_wc completion;
+    int count = poll_completions(channel, &completion, 1, wait);
+    if (count <= 0) {
+      return count;
+    }
+    if (completion.status != IBV_WC_SUCCESS) {
+      lf_print_error("RDMA receive failed: %s.", ibv_wc_status_str(completion.status));
+      return -1;
+    }
+    channel->current = (size_t)completion.wr_id;
+    channel->start = 0;
+    channel->end = completion.byte_len;
+  }
+  return 1;
+}
+
+ssize_t rdma_channel_read(rdma_channel_t* channel, size_t max_bytes, unsigned char* buffer) {
+  int available = next_receive_buffer(channel, true);
+  if (available <= 0) {
+    return available;
+  }
+  size_t bytes = LF_MIN(channel->end - channel->start, max_bytes);
+  memcpy(buffer, channel->buffers + channel->current * channel->buffer_size + channel->start, bytes);
+  channel->start += bytes;
+  return (ssize_t)bytes;
+}
+
+ssize_t rdma_channel_peek(rdma_channel_t* channel, unsigned char* result) {
+  int available = next_receive_buffer(channel, false);
+  if (available == 1) {
+    *result = channel->buffers[channel->current * channel->buffer_size + channel->start];
+  }
+  return available;
+}
+
+int rdma_channel_write(rdma_channel_t* channel, const struct iovec* buffers, int num_buffers) {
+  size_t offset = 0; // The number of bytes of buffers[0] that have been sent.
+  while (num_buffers > 0) {
+    if (channel->failed || (channel->in_flight == LF_FEDERATED_RDMA_BUFFERS && complete_sends(channel, true) != 0)) {
+      errno = EPIPE;
+      return -1;
+    }
+    unsigned char* message = channel->buffers + channel->next * channel->buffer_size;
+    size_t length = 0;
+    while (num_buffers > 0 && length < channel->buffer_size) {
+      size_t part = LF_MIN(buffers->iov_len - offset, channel->buffer_size - length);
+      memcpy(message + length, (unsigned char*)buffers->iov_base + offset, part);
+      length += part;
+      offset += part;
+      if (offset == buffers->iov_len) {
+        buffers++;
+        num_buffers--;
+        offset = 0;
+      }
+    }
+    if (length > 0 && post_send(channel, length) != 0) {
+      errno = EPIPE;
+      return -1;
+    }
+  }
+  // Account for completed sends without waiting, so that the completion queue does not fill up.
+  if (complete_sends(channel, false) != 0) {
+    errno = EPIPE;
+    return -1;
+  }
+  return 0;
+}
+
+int rdma_channel_flush(rdma_channel_t* channel) {
+  while (channel->in_flight > 0) {
+    if (complete_sends(channel, true) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void rdma_free_channels(void) {
+  while (attached_channels != NULL) {
+    rdma_channel_t* channel = attached_channels;
+    attached_channels = channel->next_attached;
+    // The socket may have been closed and its ID reused for another connection.
+    rdma_channel_t* expected = channel;
+    __atomic_compare_exchange_n(&channels_of_sockets[channel->socket], &expected, NULL, false, __ATOMIC_ACQ_REL,
+                                __ATOMIC_ACQUIRE);
+    rdma_channel_free(channel);
+  }
+  if (protection_domain != NULL) {
+    ibv_dealloc_pd(protection_domain);
+    protection_domain = NULL;
+  }
+  if (device != NULL) {
+    ibv_close_device(device);
+    device = NULL;
+  }
+  device_state = 0;
+}
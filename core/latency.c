@@ -0,0 +1,128 @@
+/**
+ * @file
+ * @brief End-to-end latency from the arrival of events of physical actions to the reactions that act on them.
+ *
+ * See latency.h. The origins of events are set in lf_schedule_trigger and merged into the origin
+ * of the tag in _lf_pop_events.
+ */
+
+#include <string.h>
+
+#include "latency.h"
+#include "environment.h"
+#include "low_level_platform.h"
+#include "util.h"
+
+/** Whether the warning that an environment has too many chains has been printed. */
+static int32_t chains_warned = 0;
+
+/** @brief Return the index of the bucket of latency `latency`, which is not negative. */
+static int bucket_of(interval_t latency) {
+  int bucket = 0;
+  while (bucket < LF_LATENCY_BUCKETS - 1 && latency > (USEC(1) << bucket)) {
+    bucket++;
+  }
+  return bucket;
+}
+
+/** @brief Return an estimate of the given percentile of the latencies of a chain. */
+static interval_t percentile(const lf_latency_chain_t* chain, int percent) {
+  // The rank of the latency that is the percentile, counting from 1.
+  int64_t rank = (chain->count * percent + 99) / 100;
+  int64_t seen = 0;
+  for (int i = 0; i < LF_LATENCY_BUCKETS - 1; i++) {
+    seen += chain->buckets[i];
+    if (seen >= rank) {
+      return LF_MIN(USEC(1) << i, chain->max);
+    }
+  }
+  return chain->max;
+}
+
+/** @brief Return whether the chain has the given name. */
+static bool is_named(const lf_latency_chain_t* chain, const char* name) {
+  return chain->name == name || strcmp(chain->name, name) == 0;
+}
+
+/**
+ * @brief Return the chain of the environment with the given name, which is added if it does
+ * not exist yet, or NULL if the environment has no room for it.
+ */
+static lf_latency_chain_t* chain_of(environment_t* env, const char* name) {
+  lf_latency_chain_t* chains = env->latency_chains;
+  int i = 0;
+  for (; i < LF_LATENCY_MAX_CHAINS && chains[i].name != NULL; i++) {
+    if (is_named(&chains[i], name)) {
+      return &chains[i];
+    }
+  }
+  // Add the chain, unless another sink adds it first.
+  while (!lf_atomic_bool_compare_and_swap32(&env->latency_registering, 0, 1)) {
+    LF_CPU_RELAX();
+  }
+  lf_latency_chain_t* found = NULL;
+  for (; i < LF_LATENCY_MAX_CHAINS; i++) {
+    if (chains[i].name == NULL) {
+      chains[i].name = name;
+    }
+    if (is_named(&chains[i], name)) {
+      found = &chains[i];
+      break;
+    }
+  }
+  lf_atomic_bool_compare_and_swap32(&env->latency_registering, 1, 0);
+  if (found == NULL && lf_atomic_bool_compare_and_swap32(&chains_warned, 0, 1)) {
+    lf_print_warning("Environment %d has more than %d latency chains. The latency of %s is not recorded.", env->id,
+                     LF_LATENCY_MAX_CHAINS, name);
+  }
+  return found;
+}
+
+interval_t lf_latency_record(void* self, const char* chain) {
+  environment_t* env = ((self_base_t*)self)->environment;
+  if (env->latency_origin == NEVER) {
+    return NEVER;
+  }
+  interval_t latency = LF_MAX(lf_time_physical() - env->latency_origin, 0);
+  lf_latency_chain_t* statistics = chain_of(env, chain);
+  if (statistics == NULL) {
+    return latency;
+  }
+  // Sinks of the same chain may run at once on different workers.
+  lf_atomic_fetch_add64(&statistics->buckets[bucket_of(latency)], 1);
+  lf_atomic_fetch_add64(&statistics->total, latency);
+  int64_t max = statistics->max;
+  while (latency > max && !lf_atomic_bool_compare_and_swap64(&statistics->max, max, latency)) {
+    max = statistics->max;
+  }
+  lf_atomic_fetch_add64(&statistics->count, 1);
+  return latency;
+}
+
+void lf_latency_print(environment_t* env) {
+  if (env->latency_chains[0].name == NULL) {
+    return;
+  }
+  lf_print("---- End-to-end latencies of environment %d (nsec):", env->id);
+  for (int i = 0; i < LF_LATENCY_MAX_CHAINS && env->latency_chains[i].name != NULL; i++) {
+    lf_latency_chain_t* chain = &env->latency_chains[i];
+    if (chain->count == 0) {
+      continue;
+    }
+    lf_print("---- %s: count %lld, mean " PRINTF_TIME ", p50 " PRINTF_TIME ", p99 " PRINTF_TIME ", max " PRINTF_TIME,
+             chain->name, (long long)chain->count, chain->total / chain->count, percentile(chain, 50),
+             percentile(chain, 99), chain->max);
+  }
+}
+
+void lf_latency_write(environment_t* env, FILE* file) {
+  for (int i = 0; i < LF_LATENCY_MAX_CHAINS && env->latency_chains[i].name != NULL; i++) {
+    lf_latency_chain_t* chain = &env->latency_chains[i];
+    if (chain->count == 0) {
+      continue;
+    }
+    fprintf(file, "latency,%s,%lld," PRINTF_TIME "," PRINTF_TIME "," PRINTF_TIME "," PRINTF_TIME "\n", chain->name,
+            (long long)chain->count, chain->total / chain->count, percentile(chain, 50), percentile(chain, 99),
+            chain->max);
+  }
+}
@@ -16,6 +16,8 @@ int _lf_count_token_allocations;
 #endif
 
 #include <stdbool.h>
+#include <stddef.h> // Defines max_align_t
+#include <stdint.h>
 #include <assert.h>
 #include <string.h> // Defines memcpy
 #include "lf_token.h"
@@ -25,23 +27,148 @@ int _lf_count_token_allocations;
 #include "util.h"
 #include "platform.h" // Enter/exit critical sections
 #include "port.h"     // Defines lf_port_base_t.
+#include "memory_accounting.h"
 
 lf_token_t* _lf_tokens_allocated_in_reactions = NULL;
 
 ////////////////////////////////////////////////////////////////////
 //// Global variables not visible outside this file.
 
+/**
+ * To allow a system to recover from burst of activity, the token recycling
+ * bins have a limited size. When they become full, token are freed using free().
+ * Each thread keeps up to _LF_TOKEN_CACHE_SIZE_LIMIT tokens in its own cache and
+ * the global overflow stack holds up to _LF_TOKEN_RECYCLING_BIN_SIZE_LIMIT tokens.
+ */
+#define _LF_TOKEN_RECYCLING_BIN_SIZE_LIMIT 512
+#ifdef LF_STATIC_MEMORY
+// All tokens come from _lf_static_tokens and stay in the cache once freed.
+#define _LF_TOKEN_CACHE_SIZE_LIMIT LF_MAX_TOKENS
+#else
+#define _LF_TOKEN_CACHE_SIZE_LIMIT 64
+#endif
+
+/**
+ * Number of threads that get their own token cache. Threads with an ID (see lf_thread_id())
+ * outside of this range use the global overflow stack only.
+ */
+#if defined(LF_SINGLE_THREADED)
+#define _LF_TOKEN_CACHE_THREADS 1
+#else
+#define _LF_TOKEN_CACHE_THREADS 64
+#endif
+
 /**
  * Tokens always have the same size in memory so they are easily recycled.
- * When a token is freed, it is inserted into this recycling bin.
+ * When a token is freed, it is pushed on the cache of the calling thread.
+ * Each cache is only accessed by the thread whose ID is its index, so no lock is needed.
+ * The cache is padded to a cache line to avoid false sharing between threads.
  */
-static hashset_t _lf_token_recycling_bin = NULL;
+typedef struct _lf_token_cache_t {
+  lf_token_t* head; // Singly-linked list through the token's next field.
+  size_t count;     // Number of tokens on the list.
+  size_t hits;      // Number of token allocations served from the recycling bins.
+  size_t misses;    // Number of token allocations that needed calloc().
+  int32_t token_allocations;   // Token allocations minus frees by the thread, in the threaded runtime.
+  int32_t payload_allocations; // Payload allocations minus frees by the thread, in the threaded runtime.
+  char padding[64 - 3 * sizeof(size_t) - sizeof(lf_token_t*) - 2 * sizeof(int32_t)];
+} _lf_token_cache_t;
+
+static _lf_token_cache_t _lf_token_caches[_LF_TOKEN_CACHE_THREADS];
 
 /**
- * To allow a system to recover from burst of activity, the token recycling
- * bin has a limited size. When it becomes full, token are freed using free().
+ * Lock-free stack of tokens that did not fit in the cache of the freeing thread.
+ * Tokens are pushed individually and popped all at once, which avoids the ABA problem.
  */
-#define _LF_TOKEN_RECYCLING_BIN_SIZE_LIMIT 512
+static lf_token_t* volatile _lf_token_overflow_stack = NULL;
+
+/** Approximate number of tokens on the overflow stack. Never smaller than the actual number. */
+static volatile int32_t _lf_token_overflow_count = 0;
+
+/** Number of token allocations by threads without a cache. These never hit. */
+static volatile int32_t _lf_token_uncached_misses = 0;
+
+#ifdef LF_STATIC_MEMORY
+/** The tokens of a program built with LF_STATIC_MEMORY, and the number of them handed out so far. */
+static lf_token_t _lf_static_tokens[LF_MAX_TOKENS];
+static size_t _lf_static_tokens_used = 0;
+#endif
+
+#if defined(LF_ASYNC_TOKEN_RELEASE) && !defined(LF_SINGLE_THREADED)
+/**
+ * Lock-free stack of token copies whose last reference was released at the start of a tag.
+ * They are freed by the reclaimer thread, off the path that advances the tag.
+ * Lists are pushed whole and popped all at once.
+ */
+static lf_token_t* volatile _lf_token_retired = NULL;
+
+/** The reclaimer thread and the mutex and condition variable on which it waits for retired tokens. */
+static lf_thread_t _lf_token_reclaimer;
+static lf_mutex_t _lf_token_reclaimer_mutex;
+static lf_cond_t _lf_token_reclaimer_cond;
+
+/** Whether the reclaimer thread runs, and whether it should stop. Both are only changed by the thread advancing tags. */
+static bool _lf_token_reclaimer_running = false;
+static bool _lf_token_reclaimer_stop = false;
+#endif
+
+/**
+ * In the single-threaded runtime, interrupt service routines may allocate and free tokens,
+ * so the one cache is protected by disabling interrupts. In the threaded runtime, no
+ * protection is needed.
+ */
+#if defined(LF_SINGLE_THREADED)
+#define _LF_TOKEN_CACHE_ENTER() LF_CRITICAL_SECTION_ENTER(GLOBAL_ENVIRONMENT)
+#define _LF_TOKEN_CACHE_EXIT() LF_CRITICAL_SECTION_EXIT(GLOBAL_ENVIRONMENT)
+#else
+#define _LF_TOKEN_CACHE_ENTER()
+#define _LF_TOKEN_CACHE_EXIT()
+#endif
+
+#if !defined NDEBUG
+static void _lf_count_allocations(int tokens, int payloads);
+#endif
+
+/**
+ * Header of a payload drawn from a token pool. The payload follows the header,
+ * which is padded to the maximum alignment so that the payload is suitably aligned.
+ */
+typedef union _lf_token_pool_block_t {
+  struct {
+    union {
+      union _lf_token_pool_block_t* next; // Next block on the free list, while the block is free.
+      struct lf_token_pool_t* pool;       // Pool of the block, while it is in use.
+    } link;
+    size_t size_class; // Length class of the block.
+  } header;
+  max_align_t alignment;
+} _lf_token_pool_block_t;
+
+/**
+ * Pool of payloads for one token type, with one free list per length class.
+ */
+struct lf_token_pool_t {
+  token_type_t* type;
+  size_t max_cached_per_class;
+  _lf_token_pool_block_t* free_blocks[LF_TOKEN_POOL_NUM_CLASSES];
+  size_t num_free_blocks[LF_TOKEN_POOL_NUM_CLASSES];
+  lf_token_pool_stats_t stats;
+  lf_token_pool_t* next; // Next pool in _lf_token_pools.
+#if !defined(LF_SINGLE_THREADED)
+  lf_mutex_t mutex;
+#endif
+};
+
+/** List of all token pools so that they can be freed at the end of execution. */
+static lf_token_pool_t* _lf_token_pools = NULL;
+
+#if defined(LF_SINGLE_THREADED)
+#define _LF_TOKEN_POOL_LOCK(pool) LF_CRITICAL_SECTION_ENTER(GLOBAL_ENVIRONMENT)
+#define _LF_TOKEN_POOL_UNLOCK(pool) LF_CRITICAL_SECTION_EXIT(GLOBAL_ENVIRONMENT)
+#else
+#define _LF_TOKEN_POOL_LOCK(pool) LF_MUTEX_LOCK(&(pool)->mutex)
+#define _LF_TOKEN_POOL_UNLOCK(pool) LF_MUTEX_UNLOCK(&(pool)->mutex)
+#endif
 
 /**
  * Set of token templates (trigger_t or port_base_t objects) that
@@ -52,6 +179,24 @@ static hashset_t _lf_token_templates = NULL;
 
 // Forward declarations
 static lf_token_t* _lf_writable_copy_locked(lf_port_base_t* port);
+#if defined(LF_ASYNC_TOKEN_RELEASE) && !defined(LF_SINGLE_THREADED)
+static void _lf_stop_token_reclaimer(void);
+#endif
+
+/**
+ * Count the value of a token as payload memory, if the memory is accounted for.
+ * @param token The token, whose value is not counted yet.
+ * @param size The size of the value in bytes.
+ */
+static void _lf_payload_attached(lf_token_t* token, size_t size) {
+#ifdef LF_MEMORY_ACCOUNTING
+  token->payload_size = size;
+  LF_MEMORY_ALLOCATED(lf_memory_payloads, size);
+#else
+  (void)token;
+  (void)size;
+#endif
+}
 
 ////////////////////////////////////////////////////////////////////
 //// Functions that users may call.
@@ -67,9 +212,134 @@ lf_token_t* lf_writable_copy(lf_port_base_t* port) {
   return token;
 }
 
+lf_token_t* lf_writable_region(lf_port_base_t* port, size_t offset, size_t length) {
+  LF_CRITICAL_SECTION_ENTER(port->source_reactor->environment);
+  lf_token_t* token = port->tmplt.token;
+  if (token != NULL && (offset > token->length || length > token->length - offset)) {
+    LF_CRITICAL_SECTION_EXIT(port->source_reactor->environment);
+    lf_print_error("lf_writable_region: Region [%zu, %zu) exceeds the length %zu of the payload.", offset,
+                   offset + length, token->length);
+    return NULL;
+  }
+  token = _lf_writable_copy_locked(port);
+  LF_CRITICAL_SECTION_EXIT(port->source_reactor->environment);
+#ifdef PLATFORM_Linux
+  if (token != NULL && token->destructor == lf_cow_free) {
+    size_t element_size = port->tmplt.type.element_size;
+    lf_cow_unshare(token->value, offset * element_size, length * element_size);
+  }
+#endif
+  return token;
+}
+
+int lf_token_pool_enable(void* port_or_action, size_t max_cached_per_class) {
+  token_type_t* type = (token_type_t*)port_or_action;
+  if (type->destructor != NULL || type->copy_constructor != NULL || type->element_size == 0) {
+    lf_print_warning("lf_token_pool_enable: Payloads of this type cannot be pooled.");
+    return -1;
+  }
+  if (type->pool != NULL) {
+    return 0;
+  }
+  lf_token_pool_t* pool = (lf_token_pool_t*)calloc(1, sizeof(lf_token_pool_t));
+  LF_ASSERT_NON_NULL(pool);
+  pool->type = type;
+  pool->max_cached_per_class = max_cached_per_class;
+#if !defined(LF_SINGLE_THREADED)
+  LF_MUTEX_INIT(&pool->mutex);
+#endif
+  LF_CRITICAL_SECTION_ENTER(GLOBAL_ENVIRONMENT);
+  pool->next = _lf_token_pools;
+  _lf_token_pools = pool;
+  LF_CRITICAL_SECTION_EXIT(GLOBAL_ENVIRONMENT);
+  type->pool = pool;
+  return 0;
+}
+
+void lf_token_pool_get_stats(void* port_or_action, lf_token_pool_stats_t* stats) {
+  lf_token_pool_t* pool = ((token_type_t*)port_or_action)->pool;
+  if (pool == NULL) {
+    memset(stats, 0, sizeof(lf_token_pool_stats_t));
+    return;
+  }
+  _LF_TOKEN_POOL_LOCK(pool);
+  *stats = pool->stats;
+  _LF_TOKEN_POOL_UNLOCK(pool);
+}
+
+static void* _lf_token_pool_alloc(lf_token_pool_t* pool, size_t length);
+static void _lf_token_pool_free(lf_token_pool_t* pool, void* value);
+
+void* lf_token_pool_alloc(void* port_or_action, size_t length) {
+  lf_token_pool_t* pool = ((token_type_t*)port_or_action)->pool;
+  return (pool == NULL) ? NULL : _lf_token_pool_alloc(pool, length);
+}
+
+void lf_token_pool_free(void* value) {
+  _lf_token_pool_block_t* block = ((_lf_token_pool_block_t*)value) - 1;
+  _lf_token_pool_free(block->header.link.pool, value);
+}
+
 ////////////////////////////////////////////////////////////////////
 //// Internal functions.
 
+/**
+ * Draw a payload for `length` elements from the pool or return NULL if the length
+ * is zero or exceeds the largest length class. The payload is not initialized.
+ */
+static void* _lf_token_pool_alloc(lf_token_pool_t* pool, size_t length) {
+  if (length == 0) {
+    return NULL;
+  }
+  size_t size_class = 0;
+  while (((size_t)1 << size_class) < length) {
+    if (++size_class == LF_TOKEN_POOL_NUM_CLASSES) {
+      return NULL;
+    }
+  }
+  _LF_TOKEN_POOL_LOCK(pool);
+  _lf_token_pool_block_t* block = pool->free_blocks[size_class];
+  if (block != NULL) {
+    pool->free_blocks[size_class] = block->header.link.next;
+    pool->num_free_blocks[size_class]--;
+    pool->stats.cached--;
+    pool->stats.hits++;
+  }
+  pool->stats.allocations++;
+  pool->stats.in_use++;
+  if (pool->stats.in_use > pool->stats.high_watermark) {
+    pool->stats.high_watermark = pool->stats.in_use;
+  }
+  _LF_TOKEN_POOL_UNLOCK(pool);
+  if (block == NULL) {
+    block = (_lf_token_pool_block_t*)malloc(sizeof(_lf_token_pool_block_t) +
+                                            (pool->type->element_size << size_class));
+    LF_ASSERT_NON_NULL(block);
+    block->header.size_class = size_class;
+  }
+  block->header.link.pool = pool;
+  return block + 1;
+}
+
+/**
+ * Return a payload drawn from the pool, freeing it if its free list is full.
+ */
+static void _lf_token_pool_free(lf_token_pool_t* pool, void* value) {
+  _lf_token_pool_block_t* block = ((_lf_token_pool_block_t*)value) - 1;
+  size_t size_class = block->header.size_class;
+  _LF_TOKEN_POOL_LOCK(pool);
+  pool->stats.in_use--;
+  if (pool->num_free_blocks[size_class] < pool->max_cached_per_class) {
+    block->header.link.next = pool->free_blocks[size_class];
+    pool->free_blocks[size_class] = block;
+    pool->num_free_blocks[size_class]++;
+    pool->stats.cached++;
+    block = NULL;
+  }
+  _LF_TOKEN_POOL_UNLOCK(pool);
+  free(block);
+}
+
 static lf_token_t* _lf_writable_copy_locked(lf_port_base_t* port) {
   assert(port != NULL);
 
@@ -86,14 +356,31 @@ static lf_token_t* _lf_writable_copy_locked(lf_port_base_t* port) {
   }
   LF_PRINT_DEBUG("lf_writable_copy: Copying value. Reference count is %zu.", token->ref_count);
   // Copy the payload.
-  void* copy;
-  if (port->tmplt.type.copy_constructor == NULL) {
+  void* copy = NULL;
+  bool from_pool = false;
+  void (*destructor)(void* value) = NULL;
+#ifdef PLATFORM_Linux
+  if (token->destructor == lf_cow_free) {
+    // The copy shares the pages of the payload, and only those that are written get duplicated.
+    copy = lf_cow_clone(token->value);
+    destructor = (copy != NULL) ? lf_cow_free : NULL;
+  }
+#endif
+  if (copy != NULL) {
+    LF_PRINT_DEBUG("lf_writable_copy: Sharing the pages of the payload until they are written.");
+  } else if (port->tmplt.type.copy_constructor == NULL) {
     LF_PRINT_DEBUG("lf_writable_copy: Copy constructor is NULL. Using default strategy.");
     size_t size = port->tmplt.type.element_size * token->length;
     if (size == 0) {
       return token;
     }
-    copy = malloc(size);
+    if (port->tmplt.type.pool != NULL) {
+      copy = _lf_token_pool_alloc(port->tmplt.type.pool, token->length);
+      from_pool = copy != NULL;
+    }
+    if (copy == NULL) {
+      copy = malloc(size);
+    }
     LF_PRINT_DEBUG("Allocating memory for writable copy %p.", copy);
     memcpy(copy, token->value, size);
   } else {
@@ -108,13 +395,13 @@ static lf_token_t* _lf_writable_copy_locked(lf_port_base_t* port) {
 
 // Count allocations to issue a warning if this is never freed.
 #if !defined NDEBUG
-  LF_CRITICAL_SECTION_ENTER(GLOBAL_ENVIRONMENT);
-  _lf_count_payload_allocations++;
-  LF_CRITICAL_SECTION_EXIT(GLOBAL_ENVIRONMENT);
+  _lf_count_allocations(0, 1);
 #endif
 
   // Create a new, dynamically allocated token.
   lf_token_t* result = _lf_new_token((token_type_t*)port, copy, token->length);
+  result->value_from_pool = from_pool;
+  result->destructor = destructor;
   result->ref_count = 1;
   // Arrange for the token to be released (and possibly freed) at
   // the start of the next time step.
@@ -124,19 +411,125 @@ static lf_token_t* _lf_writable_copy_locked(lf_port_base_t* port) {
   return result;
 }
 
+/**
+ * Return the token cache of the calling thread or NULL if the thread does not have one.
+ */
+static inline _lf_token_cache_t* _lf_token_cache() {
+#if defined(LF_SINGLE_THREADED)
+  return &_lf_token_caches[0];
+#else
+  int id = lf_thread_id();
+  if (id < 0 || id >= _LF_TOKEN_CACHE_THREADS) {
+    return NULL;
+  }
+  return &_lf_token_caches[id];
+#endif
+}
+
+#if !defined NDEBUG
+/**
+ * Count token and payload allocations (or frees, if negative) to issue a warning if memory is never freed.
+ * In the threaded runtime, a thread with a token cache counts on its cache, which no other thread writes.
+ * Other threads, and interrupt service routines in the single-threaded runtime, count atomically on the
+ * global counters.
+ */
+static void _lf_count_allocations(int tokens, int payloads) {
+#if !defined(LF_SINGLE_THREADED)
+  _lf_token_cache_t* cache = _lf_token_cache();
+  if (cache != NULL) {
+    cache->token_allocations += tokens;
+    cache->payload_allocations += payloads;
+    return;
+  }
+#endif
+  if (tokens != 0) {
+    lf_atomic_fetch_add32((int32_t*)&_lf_count_token_allocations, tokens);
+  }
+  if (payloads != 0) {
+    lf_atomic_fetch_add32((int32_t*)&_lf_count_payload_allocations, payloads);
+  }
+}
+
+void _lf_count_payload_allocation(int delta) { _lf_count_allocations(0, delta); }
+
+void _lf_get_unfreed_allocations(int* tokens, int* payloads) {
+  *tokens = _lf_count_token_allocations;
+  *payloads = _lf_count_payload_allocations;
+  for (int i = 0; i < _LF_TOKEN_CACHE_THREADS; i++) {
+    *tokens += _lf_token_caches[i].token_allocations;
+    *payloads += _lf_token_caches[i].payload_allocations;
+  }
+}
+#endif // NDEBUG
+
+/**
+ * Atomically replace the head of the specified lock-free stack if it is equal to `old_head`.
+ */
+static inline bool _lf_token_stack_cas(lf_token_t* volatile* stack, lf_token_t* old_head, lf_token_t* new_head) {
+#if UINTPTR_MAX == UINT64_MAX
+  return lf_atomic_bool_compare_and_swap64((int64_t*)stack, (int64_t)(intptr_t)old_head, (int64_t)(intptr_t)new_head);
+#else
+  return lf_atomic_bool_compare_and_swap32((int32_t*)stack, (int32_t)(intptr_t)old_head, (int32_t)(intptr_t)new_head);
+#endif
+}
+
+/**
+ * Push a token on the overflow stack, or free it if the stack is full.
+ */
+static void _lf_token_overflow_push(lf_token_t* token) {
+  if (lf_atomic_add_fetch32((int32_t*)&_lf_token_overflow_count, 1) > _LF_TOKEN_RECYCLING_BIN_SIZE_LIMIT) {
+    // Recycling bin is full.
+    lf_atomic_fetch_add32((int32_t*)&_lf_token_overflow_count, -1);
+    LF_PRINT_DEBUG("_lf_free_token: Freeing allocated memory for token: %p", (void*)token);
+    free(token);
+    LF_MEMORY_FREED(lf_memory_tokens, sizeof(lf_token_t));
+    return;
+  }
+  LF_PRINT_DEBUG("_lf_free_token: Putting token on the overflow stack: %p", (void*)token);
+  lf_token_t* head;
+  do {
+    head = _lf_token_overflow_stack;
+    token->next = head;
+  } while (!_lf_token_stack_cas(&_lf_token_overflow_stack, head, token));
+}
+
+/**
+ * Take all tokens from the overflow stack and return them as a list.
+ * @param count Where to store the number of tokens taken.
+ */
+static lf_token_t* _lf_token_overflow_take_all(size_t* count) {
+  lf_token_t* head;
+  do {
+    head = _lf_token_overflow_stack;
+    if (head == NULL) {
+      *count = 0;
+      return NULL;
+    }
+  } while (!_lf_token_stack_cas(&_lf_token_overflow_stack, head, NULL));
+  size_t n = 0;
+  for (lf_token_t* t = head; t != NULL; t = t->next) {
+    n++;
+  }
+  lf_atomic_fetch_add32((int32_t*)&_lf_token_overflow_count, -(int32_t)n);
+  *count = n;
+  return head;
+}
+
 static void _lf_free_token_value(lf_token_t* token) {
   if (token->value != NULL) {
 // Count frees to issue a warning if this is never freed.
 #if !defined NDEBUG
-    LF_CRITICAL_SECTION_ENTER(GLOBAL_ENVIRONMENT);
-    _lf_count_payload_allocations--;
-    LF_CRITICAL_SECTION_EXIT(GLOBAL_ENVIRONMENT);
+    _lf_count_allocations(0, -1);
 #endif
     // Free the value field (the payload).
     LF_PRINT_DEBUG("_lf_free_token_value: Freeing allocated memory for payload (token value): %p", token->value);
-    // First check the token's destructor field and invoke it if it is not NULL.
-    if (token->type->destructor != NULL) {
+    // First check the destructor of the token and that of its type and invoke it if it is not NULL.
+    if (token->destructor != NULL) {
+      token->destructor(token->value);
+    } else if (token->type->destructor != NULL) {
       token->type->destructor(token->value);
+    } else if (token->value_from_pool) {
+      _lf_token_pool_free(token->type->pool, token->value);
     }
     // If Python Target is not enabled and destructor is NULL
     // Token values should be freed
@@ -146,6 +539,12 @@ static void _lf_free_token_value(lf_token_t* token) {
 #endif
     }
     token->value = NULL;
+    token->value_from_pool = false;
+    token->destructor = NULL;
+#ifdef LF_MEMORY_ACCOUNTING
+    LF_MEMORY_FREED(lf_memory_payloads, token->payload_size);
+    token->payload_size = 0;
+#endif
   }
 }
 
@@ -159,30 +558,26 @@ token_freed _lf_free_token(lf_token_t* token) {
 
   // Tokens that are created at the start of execution and associated with
   // output ports or actions persist until they are overwritten.
-  // Need to acquire a mutex to access the recycle bin.
-  LF_CRITICAL_SECTION_ENTER(GLOBAL_ENVIRONMENT);
-  if (_lf_token_recycling_bin == NULL) {
-    _lf_token_recycling_bin = hashset_create(4); // Initial size is 16.
-    if (_lf_token_recycling_bin == NULL) {
-      LF_CRITICAL_SECTION_EXIT(GLOBAL_ENVIRONMENT);
-      lf_print_error_and_exit("Out of memory: failed to setup _lf_token_recycling_bin");
+  _lf_token_cache_t* cache = _lf_token_cache();
+  bool cached = false;
+  if (cache != NULL) {
+    _LF_TOKEN_CACHE_ENTER();
+    if (cache->count < _LF_TOKEN_CACHE_SIZE_LIMIT) {
+      // Recycle instead of freeing.
+      LF_PRINT_DEBUG("_lf_free_token: Putting token on the recycling bin: %p", (void*)token);
+      token->next = cache->head;
+      cache->head = token;
+      cache->count++;
+      cached = true;
     }
+    _LF_TOKEN_CACHE_EXIT();
   }
-  if (hashset_num_items(_lf_token_recycling_bin) < _LF_TOKEN_RECYCLING_BIN_SIZE_LIMIT) {
-    // Recycle instead of freeing.
-    LF_PRINT_DEBUG("_lf_free_token: Putting token on the recycling bin: %p", (void*)token);
-    if (!hashset_add(_lf_token_recycling_bin, token)) {
-      lf_print_warning("Putting token %p on the recycling bin, but it is already there!", (void*)token);
-    }
-  } else {
-    // Recycling bin is full.
-    LF_PRINT_DEBUG("_lf_free_token: Freeing allocated memory for token: %p", (void*)token);
-    free(token);
+  if (!cached) {
+    _lf_token_overflow_push(token);
   }
 #if !defined NDEBUG
-  _lf_count_token_allocations--;
+  _lf_count_allocations(-1, 0);
 #endif
-  LF_CRITICAL_SECTION_EXIT(GLOBAL_ENVIRONMENT);
   result &= TOKEN_FREED;
 
   return result;
@@ -190,34 +585,83 @@ token_freed _lf_free_token(lf_token_t* token) {
 
 lf_token_t* _lf_new_token(token_type_t* type, void* value, size_t length) {
   lf_token_t* result = NULL;
-  // Check the recycling bin.
-  LF_CRITICAL_SECTION_ENTER(GLOBAL_ENVIRONMENT);
-  if (_lf_token_recycling_bin != NULL) {
-    hashset_itr_t iterator = hashset_iterator(_lf_token_recycling_bin);
-    if (hashset_iterator_next(iterator) >= 0) {
-      result = hashset_iterator_value(iterator);
-      hashset_remove(_lf_token_recycling_bin, result);
+  // Check the recycling bin of the calling thread, refilling it from the overflow stack if it is empty.
+  _lf_token_cache_t* cache = _lf_token_cache();
+  if (cache != NULL) {
+    _LF_TOKEN_CACHE_ENTER();
+    if (cache->head == NULL) {
+      cache->head = _lf_token_overflow_take_all(&cache->count);
+    }
+    if (cache->head != NULL) {
+      result = cache->head;
+      cache->head = result->next;
+      cache->count--;
+      cache->hits++;
       LF_PRINT_DEBUG("_lf_new_token: Retrieved token from the recycling bin: %p", (void*)result);
+    } else {
+      cache->misses++;
     }
-    free(iterator);
+    _LF_TOKEN_CACHE_EXIT();
+  } else {
+    lf_atomic_fetch_add32((int32_t*)&_lf_token_uncached_misses, 1);
   }
 
 // Count the token allocation to catch memory leaks.
 #if !defined NDEBUG
-  _lf_count_token_allocations++;
+  _lf_count_allocations(1, 0);
 #endif
 
-  LF_CRITICAL_SECTION_EXIT(GLOBAL_ENVIRONMENT);
-
   if (result == NULL) {
     // Nothing found on the recycle bin.
+#ifdef LF_STATIC_MEMORY
+    _LF_TOKEN_CACHE_ENTER();
+    if (_lf_static_tokens_used == LF_MAX_TOKENS) {
+      lf_print_error_and_exit("All %d tokens are in use. Increase LF_MAX_TOKENS.", LF_MAX_TOKENS);
+    }
+    result = &_lf_static_tokens[_lf_static_tokens_used++];
+    _LF_TOKEN_CACHE_EXIT();
+#else
     result = (lf_token_t*)calloc(1, sizeof(lf_token_t));
+    LF_MEMORY_ALLOCATED(lf_memory_tokens, sizeof(lf_token_t));
+#endif
     LF_PRINT_DEBUG("_lf_new_token: Allocated memory for token: %p", (void*)result);
   }
   result->type = type;
   result->length = length;
   result->value = value;
   result->ref_count = 0;
+  result->next = NULL;
+  result->value_from_pool = false;
+  result->destructor = NULL;
+  if (value != NULL) {
+    _lf_payload_attached(result, length * type->element_size);
+  }
+  return result;
+}
+
+lf_token_t* _lf_new_token_with_payload(token_type_t* type, size_t length) {
+  void* value = NULL;
+  if (type->pool != NULL && length > 0) {
+    // The pool counts in elements.
+    value = _lf_token_pool_alloc(type->pool, (length + type->element_size - 1) / type->element_size);
+  }
+  bool from_pool = value != NULL;
+  if (!from_pool && length > 0) {
+    value = malloc(length);
+    LF_ASSERT_NON_NULL(value);
+  }
+#if !defined NDEBUG
+  if (value != NULL) {
+    _lf_count_allocations(0, 1);
+  }
+#endif
+  // The length is in bytes, so the payload is counted here.
+  lf_token_t* result = _lf_new_token(type, NULL, length);
+  result->value = value;
+  result->value_from_pool = from_pool;
+  if (value != NULL) {
+    _lf_payload_attached(result, length);
+  }
   return result;
 }
 
@@ -272,25 +716,42 @@ lf_token_t* _lf_initialize_token_with_value(token_template_t* tmplt, void* value
 
   lf_token_t* result = _lf_get_token(tmplt);
   result->value = value;
+  result->value_from_pool = false;
+  result->destructor = NULL;
 // Count allocations to issue a warning if this is never freed.
 #if !defined NDEBUG
-  LF_CRITICAL_SECTION_ENTER(GLOBAL_ENVIRONMENT);
-  _lf_count_payload_allocations++;
-  LF_CRITICAL_SECTION_EXIT(GLOBAL_ENVIRONMENT);
+  _lf_count_allocations(0, 1);
 #endif
   result->length = length;
+  if (value != NULL) {
+    _lf_payload_attached(result, length * tmplt->type.element_size);
+  }
   return result;
 }
 
 lf_token_t* _lf_initialize_token(token_template_t* tmplt, size_t length) {
   assert(tmplt != NULL);
   // Allocate memory for storing the array.
-  void* value = calloc(length, tmplt->type.element_size);
+  void* value = NULL;
+  if (tmplt->type.pool != NULL) {
+    value = _lf_token_pool_alloc(tmplt->type.pool, length);
+    if (value != NULL) {
+      memset(value, 0, length * tmplt->type.element_size);
+    }
+  }
+  bool from_pool = value != NULL;
+  if (!from_pool) {
+    value = calloc(length, tmplt->type.element_size);
+  }
   lf_token_t* result = _lf_initialize_token_with_value(tmplt, value, length);
+  result->value_from_pool = from_pool;
   return result;
 }
 
 void _lf_free_all_tokens() {
+#if defined(LF_ASYNC_TOKEN_RELEASE) && !defined(LF_SINGLE_THREADED)
+  _lf_stop_token_reclaimer();
+#endif
   // Free template tokens.
   LF_CRITICAL_SECTION_ENTER(GLOBAL_ENVIRONMENT);
   // It is possible for a token to be a template token for more than one port
@@ -306,17 +767,49 @@ void _lf_free_all_tokens() {
     hashset_destroy(_lf_token_templates);
     _lf_token_templates = NULL;
   }
-  if (_lf_token_recycling_bin != NULL) {
-    hashset_itr_t iterator = hashset_iterator(_lf_token_recycling_bin);
-    while (hashset_iterator_next(iterator) >= 0) {
-      void* token = hashset_iterator_value(iterator);
-      LF_PRINT_DEBUG("Freeing token from _lf_token_recycling_bin: %p", token);
-      // Payload should already be freed, so we just free the token:
-      free(token);
+  // Payloads should already be freed, so we just free the tokens.
+#ifdef LF_STATIC_MEMORY
+  _lf_token_caches[0].head = NULL;
+  _lf_static_tokens_used = 0;
+#endif
+  for (int i = 0; i < _LF_TOKEN_CACHE_THREADS; i++) {
+    while (_lf_token_caches[i].head != NULL) {
+      lf_token_t* next = _lf_token_caches[i].head->next;
+      LF_PRINT_DEBUG("Freeing token from the recycling bin: %p", (void*)_lf_token_caches[i].head);
+      free(_lf_token_caches[i].head);
+      LF_MEMORY_FREED(lf_memory_tokens, sizeof(lf_token_t));
+      _lf_token_caches[i].head = next;
+    }
+    _lf_token_caches[i].count = 0;
+  }
+  size_t count;
+  lf_token_t* token = _lf_token_overflow_take_all(&count);
+  while (token != NULL) {
+    lf_token_t* next = token->next;
+    LF_PRINT_DEBUG("Freeing token from the overflow stack: %p", (void*)token);
+    free(token);
+    LF_MEMORY_FREED(lf_memory_tokens, sizeof(lf_token_t));
+    token = next;
+  }
+  // All payloads drawn from the pools should now be returned.
+  while (_lf_token_pools != NULL) {
+    lf_token_pool_t* pool = _lf_token_pools;
+    _lf_token_pools = pool->next;
+    LF_PRINT_LOG("Token pool for element size %zu: %zu allocations, %zu reused, high watermark %zu, %zu in use.",
+                 pool->type->element_size, pool->stats.allocations, pool->stats.hits, pool->stats.high_watermark,
+                 pool->stats.in_use);
+    for (int i = 0; i < LF_TOKEN_POOL_NUM_CLASSES; i++) {
+      while (pool->free_blocks[i] != NULL) {
+        _lf_token_pool_block_t* next = pool->free_blocks[i]->header.link.next;
+        free(pool->free_blocks[i]);
+        pool->free_blocks[i] = next;
+      }
+    }
+    // Payloads that are still in use refer to the pool, so keep it in that case.
+    if (pool->stats.in_use == 0) {
+      pool->type->pool = NULL;
+      free(pool);
     }
-    free(iterator);
-    hashset_destroy(_lf_token_recycling_bin);
-    _lf_token_recycling_bin = NULL;
   }
   LF_CRITICAL_SECTION_EXIT(GLOBAL_ENVIRONMENT);
 }
@@ -329,7 +822,7 @@ void _lf_replace_template_token(token_template_t* tmplt, lf_token_t* newtoken) {
       _lf_done_using(tmplt->token);
     }
     if (newtoken != NULL) {
-      newtoken->ref_count++;
+      _lf_token_add_reference(newtoken);
       LF_PRINT_DEBUG("_lf_replace_template_token: Incremented ref_count of %p to %zu.", (void*)newtoken,
                      newtoken->ref_count);
     }
@@ -337,6 +830,26 @@ void _lf_replace_template_token(token_template_t* tmplt, lf_token_t* newtoken) {
   }
 }
 
+/**
+ * Atomically add `delta` to the reference count of the specified token and return the result.
+ * The atomic operation is a full barrier, so the holder that releases the last reference sees
+ * every write to the payload that the other holders made before releasing theirs.
+ */
+static size_t _lf_token_add_fetch_ref_count(lf_token_t* token, int64_t delta) {
+  if (sizeof(size_t) == sizeof(int64_t)) {
+    return (size_t)lf_atomic_add_fetch64((int64_t*)&token->ref_count, delta);
+  }
+  return (size_t)lf_atomic_add_fetch32((int32_t*)&token->ref_count, (int32_t)delta);
+}
+
+void lf_token_broadcast(lf_token_t* token, size_t count) {
+  if (token != NULL && count > 0) {
+    _lf_token_add_fetch_ref_count(token, (int64_t)count);
+  }
+}
+
+void _lf_token_add_reference(lf_token_t* token) { _lf_token_add_fetch_ref_count(token, 1); }
+
 token_freed _lf_done_using(lf_token_t* token) {
   if (token == NULL) {
     return NOT_FREED;
@@ -346,10 +859,138 @@ token_freed _lf_done_using(lf_token_t* token) {
     lf_print_warning("Token being freed that has already been freed: %p", (void*)token);
     return NOT_FREED;
   }
-  token->ref_count--;
+  // Only the holder that releases the last reference frees the token, without a lock.
+  if (_lf_token_add_fetch_ref_count(token, -1) > 0) {
+    return NOT_FREED;
+  }
   return _lf_free_token(token);
 }
 
+void _lf_get_token_recycling_stats(size_t* hits, size_t* misses) {
+  *hits = 0;
+  *misses = (size_t)_lf_token_uncached_misses;
+  for (int i = 0; i < _LF_TOKEN_CACHE_THREADS; i++) {
+    *hits += _lf_token_caches[i].hits;
+    *misses += _lf_token_caches[i].misses;
+  }
+}
+
+size_t _lf_token_recycling_bin_size(void) {
+  // The overflow count is never smaller than the actual number, so this is an upper bound.
+  size_t size = (size_t)_lf_token_overflow_count;
+  for (int i = 0; i < _LF_TOKEN_CACHE_THREADS; i++) {
+    size += _lf_token_caches[i].count;
+  }
+  return size;
+}
+
+#if defined(LF_ASYNC_TOKEN_RELEASE) && !defined(LF_SINGLE_THREADED)
+/**
+ * Free the tokens on the specified list, whose reference counts are zero.
+ */
+static void _lf_free_retired_tokens(lf_token_t* token) {
+  while (token != NULL) {
+    lf_token_t* next = token->next;
+    _lf_free_token(token);
+    token = next;
+  }
+}
+
+/**
+ * Take all tokens from the stack of retired tokens and return them as a list.
+ */
+static lf_token_t* _lf_take_retired_tokens(void) {
+  lf_token_t* head;
+  do {
+    head = _lf_token_retired;
+  } while (head != NULL && !_lf_token_stack_cas(&_lf_token_retired, head, NULL));
+  return head;
+}
+
+/** Body of the reclaimer thread. */
+static void* _lf_token_reclaim(void* ignored) {
+  (void)ignored;
+  LF_MUTEX_LOCK(&_lf_token_reclaimer_mutex);
+  while (!_lf_token_reclaimer_stop) {
+    lf_token_t* retired = _lf_take_retired_tokens();
+    if (retired == NULL) {
+      LF_COND_WAIT(&_lf_token_reclaimer_cond);
+      continue;
+    }
+    LF_MUTEX_UNLOCK(&_lf_token_reclaimer_mutex);
+    _lf_free_retired_tokens(retired);
+    LF_MUTEX_LOCK(&_lf_token_reclaimer_mutex);
+  }
+  LF_MUTEX_UNLOCK(&_lf_token_reclaimer_mutex);
+  return NULL;
+}
+
+/**
+ * Hand the list from `first` to `last` over to the reclaimer thread, starting it if necessary.
+ * If it cannot be started, free the tokens right away.
+ */
+static void _lf_retire_tokens(lf_token_t* first, lf_token_t* last) {
+  if (!_lf_token_reclaimer_running && !_lf_token_reclaimer_stop) {
+    LF_MUTEX_INIT(&_lf_token_reclaimer_mutex);
+    LF_COND_INIT(&_lf_token_reclaimer_cond, &_lf_token_reclaimer_mutex);
+    _lf_token_reclaimer_running = lf_thread_create(&_lf_token_reclaimer, _lf_token_reclaim, NULL) == 0;
+    _lf_token_reclaimer_stop = !_lf_token_reclaimer_running;
+  }
+  if (!_lf_token_reclaimer_running) {
+    _lf_free_retired_tokens(first);
+    return;
+  }
+  lf_token_t* head;
+  do {
+    head = _lf_token_retired;
+    last->next = head;
+  } while (!_lf_token_stack_cas(&_lf_token_retired, head, first));
+  // The reclaimer only waits when the stack is empty, so it needs a signal only then.
+  if (head == NULL) {
+    LF_MUTEX_LOCK(&_lf_token_reclaimer_mutex);
+    LF_COND_SIGNAL(&_lf_token_reclaimer_cond);
+    LF_MUTEX_UNLOCK(&_lf_token_reclaimer_mutex);
+  }
+}
+
+/**
+ * Stop the reclaimer thread, if it runs, and free the tokens that it has not freed.
+ */
+static void _lf_stop_token_reclaimer(void) {
+  if (_lf_token_reclaimer_running) {
+    LF_MUTEX_LOCK(&_lf_token_reclaimer_mutex);
+    _lf_token_reclaimer_stop = true;
+    LF_COND_SIGNAL(&_lf_token_reclaimer_cond);
+    LF_MUTEX_UNLOCK(&_lf_token_reclaimer_mutex);
+    lf_thread_join(_lf_token_reclaimer, NULL);
+    _lf_token_reclaimer_running = false;
+  }
+  _lf_free_retired_tokens(_lf_take_retired_tokens());
+}
+
+void _lf_free_token_copies() {
+  // Only the references are released here. The copies that this frees are freed by the reclaimer thread.
+  lf_token_t* first = NULL;
+  lf_token_t* last = NULL;
+  while (_lf_tokens_allocated_in_reactions != NULL) {
+    lf_token_t* token = _lf_tokens_allocated_in_reactions;
+    _lf_tokens_allocated_in_reactions = token->next;
+    if (token->ref_count != 1) {
+      _lf_done_using(token);
+      continue;
+    }
+    token->ref_count = 0;
+    token->next = first;
+    first = token;
+    if (last == NULL) {
+      last = token;
+    }
+  }
+  if (first != NULL) {
+    _lf_retire_tokens(first, last);
+  }
+}
+#else
 void _lf_free_token_copies() {
   while (_lf_tokens_allocated_in_reactions != NULL) {
     lf_token_t* next = _lf_tokens_allocated_in_reactions->next;
@@ -357,3 +998,4 @@ void _lf_free_token_copies() {
     _lf_tokens_allocated_in_reactions = next;
   }
 }
+#endif // defined(LF_ASYNC_TOKEN_RELEASE) && !defined(LF_SINGLE_THREADED)
@@ -0,0 +1,67 @@
+/**
+ * @file
+ * @brief Accounting of the memory that the runtime allocates, by subsystem.
+ *
+ * See memory_accounting.h.
+ */
+
+#include "memory_accounting.h"
+#include "low_level_platform.h"
+#include "tag.h"
+#include "tracepoint.h"
+#include "util.h"
+
+/** The statistics of a subsystem, in a cache line of its own because workers update them at once. */
+typedef struct account_t {
+  lf_memory_account_t account;
+  char padding[64 - sizeof(lf_memory_account_t)];
+} account_t;
+
+static account_t accounts[lf_memory_num_subsystems];
+
+/** The names of the subsystems in the report. */
+static const char* subsystem_names[lf_memory_num_subsystems] = {"events",  "tokens",    "payloads", "reactors",
+                                                                "trace",   "scheduler", "network"};
+
+void _lf_memory_allocated(lf_memory_subsystem_t subsystem, size_t bytes) {
+  lf_memory_account_t* a = &accounts[subsystem].account;
+  int64_t live = lf_atomic_add_fetch64(&a->live, (int64_t)bytes);
+  int64_t high_water = a->high_water;
+  while (live > high_water && !lf_atomic_bool_compare_and_swap64(&a->high_water, high_water, live)) {
+    high_water = a->high_water;
+  }
+  lf_atomic_fetch_add64(&a->allocations, 1);
+  lf_atomic_fetch_add64(&a->allocated, (int64_t)bytes);
+}
+
+void _lf_memory_freed(lf_memory_subsystem_t subsystem, size_t bytes) {
+  lf_atomic_fetch_add64(&accounts[subsystem].account.live, -(int64_t)bytes);
+}
+
+void lf_memory_get_accounts(lf_memory_account_t* result) {
+  // The tracing module allocates its buffers itself, so its memory is sampled.
+  lf_memory_account_t* trace = &accounts[lf_memory_trace].account;
+  trace->live = (int64_t)tracepoint_memory_size();
+  trace->high_water = LF_MAX(trace->high_water, trace->live);
+  trace->allocated = LF_MAX(trace->allocated, trace->live);
+  for (int i = 0; i < lf_memory_num_subsystems; i++) {
+    result[i] = accounts[i].account;
+  }
+}
+
+void _lf_memory_print(void) {
+  lf_memory_account_t result[lf_memory_num_subsystems];
+  lf_memory_get_accounts(result);
+  double seconds = (double)lf_time_physical_elapsed() / (double)SEC(1);
+  lf_print("---- Memory by subsystem (bytes):");
+  for (int i = 0; i < lf_memory_num_subsystems; i++) {
+    lf_memory_account_t* a = &result[i];
+    if (a->high_water == 0) {
+      continue;
+    }
+    lf_print("---- %s: live %lld, high water %lld, %lld allocations of %lld (%.0f/s, %.0f bytes/s)",
+             subsystem_names[i], (long long)a->live, (long long)a->high_water, (long long)a->allocations,
+             (long long)a->allocated, seconds > 0 ? (double)a->allocations / seconds : 0.0,
+             seconds > 0 ? (double)a->allocated / seconds : 0.0);
+  }
+}
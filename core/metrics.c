@@ -0,0 +1,174 @@
+/**
+ * @file
+ * @brief Live metrics of the health of a running program, published in shared memory.
+ *
+ * See metrics.h.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "low_level_platform.h"
+#include "lf_token.h"
+#include "util.h"
+
+/** The metrics block, or NULL if it could not be created. */
+static lf_metrics_t* metrics = NULL;
+
+/** The size of the metrics block in bytes. */
+static size_t metrics_size = 0;
+
+/** The name of the metrics block. */
+static char metrics_name[64];
+
+/** The environments, whose order is that of the block. */
+static environment_t* metrics_envs = NULL;
+
+/** The physical time at which the statistics of the token recycling bins were last gathered. */
+static instant_t metrics_tokens_time = NEVER;
+
+/** The physical time at which the last NET whose round trip has been recorded was sent. */
+static instant_t metrics_net_time = NEVER;
+
+void lf_metrics_init(environment_t* envs, int num_envs) {
+  snprintf(metrics_name, sizeof(metrics_name), "/lf-metrics-%ld", (long)getpid());
+  metrics_size = sizeof(lf_metrics_t) + (size_t)num_envs * sizeof(lf_metrics_environment_t);
+  // A block left behind by a process that had the same ID is replaced.
+  shm_unlink(metrics_name);
+  int fd = shm_open(metrics_name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    lf_print_warning("Failed to create the metrics block %s. No metrics are published.", metrics_name);
+    return;
+  }
+  void* block = MAP_FAILED;
+  if (ftruncate(fd, (off_t)metrics_size) == 0) {
+    block = mmap(NULL, metrics_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  // The mapping keeps the memory alive.
+  close(fd);
+  if (block == MAP_FAILED) {
+    shm_unlink(metrics_name);
+    lf_print_warning("Failed to map the metrics block %s. No metrics are published.", metrics_name);
+    return;
+  }
+  // The memory of a new block is zero.
+  lf_metrics_t* m = (lf_metrics_t*)block;
+  m->num_environments = num_envs;
+  for (int i = 0; i < num_envs; i++) {
+    lf_metrics_environment_t* e = &m->environments[i];
+    if (envs[i].name != NULL) {
+      strncpy(e->name, envs[i].name, LF_METRICS_NAME_LENGTH - 1);
+    }
+    e->id = envs[i].id;
+#if defined(LF_SINGLE_THREADED)
+    e->num_workers = 1;
+#else
+    e->num_workers = LF_MIN(envs[i].num_workers, LF_METRICS_MAX_WORKERS);
+#endif
+  }
+  // Readers check the magic number, which is written last, with a full barrier.
+  lf_atomic_bool_compare_and_swap32((int32_t*)&m->magic, 0, (int32_t)LF_METRICS_MAGIC);
+  metrics_envs = envs;
+  metrics = m;
+  LF_PRINT_LOG("Publishing metrics in the shared memory block %s.", metrics_name);
+}
+
+void lf_metrics_free(void) {
+  if (metrics == NULL) {
+    return;
+  }
+  lf_metrics_t* m = metrics;
+  metrics = NULL;
+  munmap(m, metrics_size);
+  shm_unlink(metrics_name);
+}
+
+void lf_metrics_reaction_invoked(environment_t* env, int worker, instant_t start) {
+  if (metrics == NULL || worker < 0 || worker >= LF_METRICS_MAX_WORKERS) {
+    return;
+  }
+  // Only the worker writes its cache line.
+  lf_metrics_worker_t* w = &metrics->environments[env - metrics_envs].workers[worker];
+  w->busy += lf_time_physical() - start;
+  w->reactions++;
+}
+
+void lf_metrics_tag_started(environment_t* env) {
+  if (metrics == NULL) {
+    return;
+  }
+  instant_t now = lf_time_physical();
+  lf_metrics_environment_t* e = &metrics->environments[env - metrics_envs];
+  e->tag_lag = now - env->current_tag.time;
+  e->max_tag_lag = LF_MAX(e->max_tag_lag, e->tag_lag);
+  e->event_q_size = (int64_t)(pqueue_tag_size(env->event_q) + vector_size(&env->next_microstep_events));
+  e->free_events = (int64_t)env->events_free;
+  e->events_allocated = (int64_t)env->events_allocated;
+#if !defined(LF_SINGLE_THREADED)
+  e->ingress_count = lf_atomic_load64(&env->ingress_count);
+  e->ingress_rejected = lf_atomic_load64(&env->ingress_rejected);
+  e->ingress_shed = env->ingress_shed;
+#endif
+  e->tags++;
+#ifdef LF_LATENCY
+  if (now - e->latency_time >= LF_METRICS_PERIOD) {
+    for (int i = 0; i < LF_LATENCY_MAX_CHAINS && env->latency_chains[i].name != NULL; i++) {
+      lf_latency_chain_t* chain = &env->latency_chains[i];
+      lf_metrics_latency_t* l = &e->latency[i];
+      if (l->chain[0] == '\0') {
+        strncpy(l->chain, chain->name, LF_METRICS_NAME_LENGTH - 1);
+      }
+      memcpy(l->buckets, chain->buckets, sizeof(l->buckets));
+      l->total = chain->total;
+      l->max = chain->max;
+      l->count = chain->count;
+    }
+    e->latency_time = now;
+  }
+#endif
+  // The statistics of the recycling bins are shared, so the first environment updates them.
+  if (env == metrics_envs && (metrics_tokens_time == NEVER || now - metrics_tokens_time >= LF_METRICS_PERIOD)) {
+    size_t hits, misses;
+    _lf_get_token_recycling_stats(&hits, &misses);
+    metrics->token_bin_size = (int64_t)_lf_token_recycling_bin_size();
+    metrics->token_hits = (int64_t)hits;
+    metrics->token_misses = (int64_t)misses;
+#ifdef LF_MEMORY_ACCOUNTING
+    lf_memory_get_accounts(metrics->memory);
+    metrics->memory_time = now;
+#endif
+#ifdef LF_USER_METRICS
+    lf_user_metric_t user[LF_USER_METRICS_MAX];
+    int num_user = lf_user_metrics_get(user);
+    for (int i = 0; i < num_user; i++) {
+      lf_metrics_user_t* u = &metrics->user[i];
+      if (u->name[0] == '\0') {
+        strncpy(u->name, user[i].name, LF_METRICS_NAME_LENGTH - 1);
+        u->kind = user[i].kind;
+      }
+      memcpy(u->buckets, user[i].buckets, sizeof(u->buckets));
+      u->total = user[i].total;
+      u->max = user[i].max;
+      u->count = user[i].count;
+    }
+    metrics->user_time = now;
+#endif
+    metrics_tokens_time = now;
+  }
+}
+
+void lf_metrics_net_granted(instant_t net_time) {
+  if (metrics == NULL || net_time == metrics_net_time) {
+    return;
+  }
+  metrics_net_time = net_time;
+  interval_t round_trip = lf_time_physical() - net_time;
+  metrics->net_round_trip_last = round_trip;
+  metrics->net_round_trip_max = LF_MAX(metrics->net_round_trip_max, round_trip);
+  metrics->net_round_trip_total += round_trip;
+  metrics->net_round_trips++;
+}
@@ -84,3 +84,61 @@ int mixed_radix_parent(mixed_radix_int_t* mixed, int n) {
  * @param mixed A pointer to the mixed-radix number.
  */
 int mixed_radix_to_int(mixed_radix_int_t* mixed) { return mixed_radix_parent(mixed, 0); }
+
+mixed_radix_table_t* mixed_radix_table_new(mixed_radix_int_t* mixed) {
+  assert(mixed != NULL);
+  assert(mixed->size > 0);
+  int count = 1;
+  for (int i = 0; i < mixed->size; i++) {
+    assert(mixed->radixes[i] > 0);
+    count *= mixed->radixes[i];
+  }
+  mixed_radix_table_t* table = (mixed_radix_table_t*)calloc(1, sizeof(mixed_radix_table_t));
+  int* digits = (int*)calloc(mixed->size, sizeof(int));
+  size_t entries = (size_t)(mixed->size + 1) * count;
+  if (table != NULL && digits != NULL) {
+    if (count <= UINT16_MAX + 1) {
+      table->narrow = (uint16_t*)malloc(entries * sizeof(uint16_t));
+    } else {
+      table->wide = (uint32_t*)malloc(entries * sizeof(uint32_t));
+    }
+  }
+  if (table == NULL || digits == NULL || (table->narrow == NULL && table->wide == NULL)) {
+    free(digits);
+    mixed_radix_table_free(table);
+    return NULL;
+  }
+  table->size = mixed->size;
+  table->count = count;
+
+  // Enumerate the numbers in the order in which they are incremented, starting from zero.
+  mixed_radix_int_t x = {mixed->size, digits, mixed->radixes, mixed->permutation};
+  for (int position = 0; position < count; position++) {
+    for (int n = 0; n < mixed->size; n++) {
+      size_t index = (size_t)n * count + position;
+      int parent = mixed_radix_parent(&x, n);
+      if (table->narrow != NULL) {
+        table->narrow[index] = (uint16_t)parent;
+      } else {
+        table->wide[index] = (uint32_t)parent;
+      }
+    }
+    size_t index = (size_t)mixed->size * count + mixed_radix_to_int(&x);
+    if (table->narrow != NULL) {
+      table->narrow[index] = (uint16_t)position;
+    } else {
+      table->wide[index] = (uint32_t)position;
+    }
+    mixed_radix_incr(&x);
+  }
+  free(digits);
+  return table;
+}
+
+void mixed_radix_table_free(mixed_radix_table_t* table) {
+  if (table != NULL) {
+    free(table->narrow);
+    free(table->wide);
+    free(table);
+  }
+}
@@ -37,6 +37,8 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #ifdef MODAL_REACTORS
 
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "low_level_platform.h"
@@ -46,12 +48,6 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "reactor_common.h"
 #include "api/schedule.h"
 
-// Bit masks for the internally used flags on modes
-#define _LF_MODE_FLAG_MASK_ACTIVE (1 << 0)
-#define _LF_MODE_FLAG_MASK_NEEDS_STARTUP (1 << 1)
-#define _LF_MODE_FLAG_MASK_HAD_STARTUP (1 << 2)
-#define _LF_MODE_FLAG_MASK_NEEDS_RESET (1 << 3)
-
 // ----------------------------------------------------------------------------
 
 // Forward declaration of functions and variables supplied by reactor_common.c
@@ -60,9 +56,14 @@ event_t* _lf_create_dummy_events(environment_t* env, tag_t tag);
 
 // ----------------------------------------------------------------------------
 
-// Linked list element for suspended events in inactive modes
+// Linked list element for suspended events in inactive modes.
+// Each element is both in the list of all suspended events and in the list of the mode
+// of the trigger of its event, so that entering a mode only visits the events of that mode.
 typedef struct _lf_suspended_event {
-  struct _lf_suspended_event* next;
+  struct _lf_suspended_event* next;      // Next element in the list of all suspended events.
+  struct _lf_suspended_event* prev;      // Previous element in the list of all suspended events.
+  struct _lf_suspended_event* next_mode; // Next element in the list of the mode.
+  struct _lf_suspended_event* prev_mode; // Previous element in the list of the mode.
   event_t* event;
 } _lf_suspended_event_t;
 _lf_suspended_event_t* _lf_suspended_events_head =
@@ -73,6 +74,7 @@ _lf_suspended_event_t* _lf_unsused_suspended_events_head =
 
 /**
  * Save the given event as suspended.
+ * The mode of its trigger is inactive and hence not NULL.
  */
 void _lf_add_suspended_event(event_t* event) {
   _lf_suspended_event_t* new_suspended_event;
@@ -84,64 +86,61 @@ void _lf_add_suspended_event(event_t* event) {
   }
 
   new_suspended_event->event = event;
+  new_suspended_event->prev = NULL;
   new_suspended_event->next = _lf_suspended_events_head; // prepend
+  if (_lf_suspended_events_head != NULL) {
+    _lf_suspended_events_head->prev = new_suspended_event;
+  }
+  _lf_suspended_events_head = new_suspended_event;
   _lf_suspended_events_num++;
 
-  _lf_suspended_events_head = new_suspended_event;
+  reactor_mode_t* mode = event->trigger->mode;
+  new_suspended_event->prev_mode = NULL;
+  new_suspended_event->next_mode = mode->suspended_events; // prepend
+  if (mode->suspended_events != NULL) {
+    mode->suspended_events->prev_mode = new_suspended_event;
+  }
+  mode->suspended_events = new_suspended_event;
 }
 
 /**
- * Remove the given node from the list of suspended events and
- * Returns the next element in the list.
+ * Remove the given node from the list of suspended events and from the list of the given mode.
+ * Returns the next element in the list of the mode.
  */
-_lf_suspended_event_t* _lf_remove_suspended_event(_lf_suspended_event_t* event) {
-  _lf_suspended_event_t* next = event->next;
-
-  // Clear content
-  event->event = NULL;
-  event->next = NULL;
-  _lf_suspended_events_num--;
+_lf_suspended_event_t* _lf_remove_suspended_event(reactor_mode_t* mode, _lf_suspended_event_t* event) {
+  _lf_suspended_event_t* next_mode = event->next_mode;
 
-  // Store for recycling
-  if (_lf_unsused_suspended_events_head == NULL) {
-    _lf_unsused_suspended_events_head = event;
+  if (event->prev != NULL) {
+    event->prev->next = event->next;
   } else {
-    event->next = _lf_unsused_suspended_events_head;
-    _lf_unsused_suspended_events_head = event;
+    _lf_suspended_events_head = event->next; // Adjust head
   }
-
-  if (_lf_suspended_events_head == event) {
-    _lf_suspended_events_head = next; // Adjust head
+  if (event->next != NULL) {
+    event->next->prev = event->prev;
+  }
+  if (event->prev_mode != NULL) {
+    event->prev_mode->next_mode = next_mode;
   } else {
-    _lf_suspended_event_t* predecessor = _lf_suspended_events_head;
-    while (predecessor->next != event && predecessor != NULL) {
-      predecessor = predecessor->next;
-    }
-    if (predecessor != NULL) {
-      predecessor->next = next; // Remove from linked list
-    }
+    mode->suspended_events = next_mode; // Adjust head
+  }
+  if (next_mode != NULL) {
+    next_mode->prev_mode = event->prev_mode;
   }
+  _lf_suspended_events_num--;
 
-  return next;
+  // Clear content and store for recycling
+  event->event = NULL;
+  event->prev = NULL;
+  event->prev_mode = NULL;
+  event->next_mode = NULL;
+  event->next = _lf_unsused_suspended_events_head;
+  _lf_unsused_suspended_events_head = event;
+
+  return next_mode;
 }
 
 // ----------------------------------------------------------------------------
 
-/**
- * Return true if the given mode is active.
- * This includes checking all enclosing modes.
- * If any of those is inactive, then so is this one.
- *
- * @param mode The mode instance to check.
- */
-bool _lf_mode_is_active(reactor_mode_t* mode) {
-  if (mode != NULL) {
-    // Use cached value (redundant data structure)
-    return mode->flags & _LF_MODE_FLAG_MASK_ACTIVE;
-  }
-  return true;
-}
-
 /**
  * Fallback implementation of _lf_mode_is_active.
  * Does not rely on cached activity flag.
@@ -317,6 +316,102 @@ void _lf_handle_mode_shutdown_reactions(environment_t* env, reaction_t** shutdow
   }
 }
 
+/** Order state resets by mode and then by target. */
+static int compare_state_resets(const void* a, const void* b) {
+  const mode_state_variable_reset_data_t* x = (const mode_state_variable_reset_data_t*)a;
+  const mode_state_variable_reset_data_t* y = (const mode_state_variable_reset_data_t*)b;
+  if (x->mode != y->mode) {
+    return ((uintptr_t)x->mode < (uintptr_t)y->mode) ? -1 : 1;
+  }
+  return ((uintptr_t)x->target > (uintptr_t)y->target) - ((uintptr_t)x->target < (uintptr_t)y->target);
+}
+
+/** Order timers by mode. */
+static int compare_timer_modes(const void* a, const void* b) {
+  uintptr_t x = (uintptr_t)(*(trigger_t* const*)a)->mode;
+  uintptr_t y = (uintptr_t)(*(trigger_t* const*)b)->mode;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Sort the state resets and the timers with a period of 0 by mode, once, so that entering a mode
+ * only visits its own, rather than all of them. State resets of the same mode of which both the
+ * targets and the sources are adjacent in memory are merged, so that the state variables of a
+ * reactor are usually reset with one copy rather than one per variable.
+ */
+static void group_by_mode(mode_environment_t* modes, mode_state_variable_reset_data_t reset_data[],
+                          int reset_data_size, trigger_t* timer_triggers[], int timer_triggers_size) {
+  modes->grouped_state_resets = NULL;
+  modes->grouped_state_resets_size = 0;
+  if (reset_data_size > 0) {
+    mode_state_variable_reset_data_t* resets =
+        (mode_state_variable_reset_data_t*)malloc(reset_data_size * sizeof(mode_state_variable_reset_data_t));
+    LF_ASSERT_NON_NULL(resets);
+    memcpy(resets, reset_data, reset_data_size * sizeof(mode_state_variable_reset_data_t));
+    qsort(resets, reset_data_size, sizeof(mode_state_variable_reset_data_t), compare_state_resets);
+    int size = 0;
+    for (int i = 0; i < reset_data_size; i++) {
+      mode_state_variable_reset_data_t* last = (size > 0) ? &resets[size - 1] : NULL;
+      if (last != NULL && last->mode == resets[i].mode && (char*)last->target + last->size == resets[i].target &&
+          (char*)last->source + last->size == resets[i].source) {
+        last->size += resets[i].size;
+      } else {
+        resets[size++] = resets[i];
+      }
+    }
+    modes->grouped_state_resets = resets;
+    modes->grouped_state_resets_size = size;
+  }
+
+  modes->one_shot_timers = NULL;
+  modes->one_shot_timers_size = 0;
+  for (int i = 0; i < timer_triggers_size; i++) {
+    trigger_t* timer = timer_triggers[i];
+    if (timer->period == 0 && timer->mode != NULL) {
+      if (modes->one_shot_timers == NULL) {
+        modes->one_shot_timers = (trigger_t**)malloc(timer_triggers_size * sizeof(trigger_t*));
+        LF_ASSERT_NON_NULL(modes->one_shot_timers);
+      }
+      modes->one_shot_timers[modes->one_shot_timers_size++] = timer;
+    }
+  }
+  // A stable order is not needed, since all the timers of a mode are scheduled at the same step.
+  if (modes->one_shot_timers_size > 1) {
+    qsort(modes->one_shot_timers, modes->one_shot_timers_size, sizeof(trigger_t*), compare_timer_modes);
+  }
+  modes->grouped_by_mode = true;
+}
+
+/** Return the index of the first grouped state reset of the mode, or of a later mode if it has none. */
+static int first_state_reset_of(mode_environment_t* modes, reactor_mode_t* mode) {
+  int low = 0;
+  int high = modes->grouped_state_resets_size;
+  while (low < high) {
+    int middle = low + (high - low) / 2;
+    if ((uintptr_t)modes->grouped_state_resets[middle].mode < (uintptr_t)mode) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+/** Return the index of the first timer of the mode with a period of 0, or of a later mode if it has none. */
+static int first_one_shot_timer_of(mode_environment_t* modes, reactor_mode_t* mode) {
+  int low = 0;
+  int high = modes->one_shot_timers_size;
+  while (low < high) {
+    int middle = low + (high - low) / 2;
+    if ((uintptr_t)modes->one_shot_timers[middle]->mode < (uintptr_t)mode) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
 /**
  * Perform transitions in all modal reactors.
  *
@@ -332,6 +427,10 @@ void _lf_process_mode_changes(environment_t* env, reactor_mode_state_t* states[]
                               mode_state_variable_reset_data_t reset_data[], int reset_data_size,
                               trigger_t* timer_triggers[], int timer_triggers_size) {
   bool transition = false; // any mode change in this step
+  mode_environment_t* modes = env->modes;
+  if (!modes->grouped_by_mode) {
+    group_by_mode(modes, reset_data, reset_data_size, timer_triggers, timer_triggers_size);
+  }
 
   // Detect mode changes (top down for hierarchical reset)
   for (int i = 0; i < states_size; i++) {
@@ -359,31 +458,29 @@ void _lf_process_mode_changes(environment_t* env, reactor_mode_state_t* states[]
           // Reset state variables (if explicitly requested for automatic reset).
           // The generated code will not register all state variables by default.
           // Usually the reset trigger is used.
-          for (int j = 0; j < reset_data_size; j++) {
-            mode_state_variable_reset_data_t data = reset_data[j];
-            if (data.mode == state->next_mode) {
-              LF_PRINT_DEBUG("Modes: Reseting state variable.");
-              memcpy(data.target, data.source, data.size);
-            }
+          for (int j = first_state_reset_of(modes, state->next_mode);
+               j < modes->grouped_state_resets_size && modes->grouped_state_resets[j].mode == state->next_mode; j++) {
+            mode_state_variable_reset_data_t* data = &modes->grouped_state_resets[j];
+            LF_PRINT_DEBUG("Modes: Reseting state variables.");
+            memcpy(data->target, data->source, data->size);
           }
 
           // Handle timers that have a period of 0. These timers will only trigger
           // once and will not be on the event_q after their initial triggering.
           // Therefore, the logic above cannot handle these timers. We need
           // to trigger these timers manually if there is a reset transition.
-          for (int j = 0; j < timer_triggers_size; j++) {
-            trigger_t* timer = timer_triggers[j];
-            if (timer->period == 0 && timer->mode == state->next_mode) {
-              lf_schedule_trigger(env, timer, timer->offset, NULL);
-            }
+          for (int j = first_one_shot_timer_of(modes, state->next_mode);
+               j < modes->one_shot_timers_size && modes->one_shot_timers[j]->mode == state->next_mode; j++) {
+            trigger_t* timer = modes->one_shot_timers[j];
+            lf_schedule_trigger(env, timer, timer->offset, NULL);
           }
         }
 
         // Reset/Reactivate previously suspended events of next state
-        _lf_suspended_event_t* suspended_event = _lf_suspended_events_head;
+        _lf_suspended_event_t* suspended_event = state->next_mode->suspended_events;
         while (suspended_event != NULL) {
           event_t* event = suspended_event->event;
-          if (event != NULL && event->trigger != NULL && event->trigger->mode == state->next_mode) {
+          if (event != NULL && event->trigger != NULL) {
             if (state->mode_change == reset_transition) { // Reset transition
               if (event->trigger->is_timer) {             // Only reset timers
                 trigger_t* timer = event->trigger;
@@ -415,9 +512,9 @@ void _lf_process_mode_changes(environment_t* env, reactor_mode_state_t* states[]
             lf_recycle_event(env, event);
 
             // Remove suspended event and continue
-            suspended_event = _lf_remove_suspended_event(suspended_event);
+            suspended_event = _lf_remove_suspended_event(state->next_mode, suspended_event);
           } else {
-            suspended_event = suspended_event->next;
+            suspended_event = suspended_event->next_mode;
           }
         }
       }
@@ -482,10 +579,13 @@ void _lf_process_mode_changes(environment_t* env, reactor_mode_state_t* states[]
       if (q_size > 0) {
         event_t** delayed_removal = (event_t**)calloc(q_size, sizeof(event_t*));
         size_t delayed_removal_count = 0;
+        pqueue_tag_element_t** elements = (pqueue_tag_element_t**)calloc(q_size, sizeof(pqueue_tag_element_t*));
+        LF_ASSERT_NON_NULL(elements);
+        pqueue_tag_elements(env->event_q, elements);
 
         // Find events
         for (size_t i = 0; i < q_size; i++) {
-          event_t* event = (event_t*)env->event_q->d[i + 1]; // internal queue data structure omits index 0
+          event_t* event = (event_t*)elements[i];
           if (event != NULL && event->trigger != NULL && !_lf_mode_is_active(event->trigger->mode)) {
             delayed_removal[delayed_removal_count++] = event;
             // This will store the event including possibly those chained up in super dense time
@@ -498,8 +598,10 @@ void _lf_process_mode_changes(environment_t* env, reactor_mode_state_t* states[]
                        delayed_removal_count, _lf_suspended_events_num);
         for (size_t i = 0; i < delayed_removal_count; i++) {
           pqueue_tag_remove(env->event_q, (pqueue_tag_element_t*)(delayed_removal[i]));
+          _lf_forget_pending_event(delayed_removal[i]);
         }
 
+        free(elements);
         free(delayed_removal);
       }
     }
@@ -520,6 +622,7 @@ void _lf_process_mode_changes(environment_t* env, reactor_mode_state_t* states[]
 void _lf_terminate_modal_reactors(environment_t* env) {
   _lf_suspended_event_t* suspended_event = _lf_suspended_events_head;
   while (suspended_event != NULL) {
+    suspended_event->event->trigger->mode->suspended_events = NULL;
     lf_recycle_event(env, suspended_event->event);
     _lf_suspended_event_t* next = suspended_event->next;
     free(suspended_event);
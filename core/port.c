@@ -30,10 +30,13 @@
  * Header file for macros, functions, and structs for optimized sparse I/O
  * through multiports.
  */
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "port.h"
 #include "vector.h"
+#include "low_level_platform.h"
 
 /**
  * Compare two non-negative integers pointed to. Return -1 if a < b, 0 if a == b,
@@ -51,6 +54,129 @@ int compare_sizes(const void* a, const void* b) {
   }
 }
 
+/** @brief Return the index of the lowest set bit of `bits`, which is not zero. */
+static int lowest_bit(uint64_t bits) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(bits);
+#else
+  int result = 0;
+  for (; !(bits & 1); bits >>= 1) {
+    result++;
+  }
+  return result;
+#endif
+}
+
+/**
+ * @brief Sort the present channels of a sparse record in increasing order and remove duplicates.
+ *
+ * A channel appears more than once if it was set more than once at the current tag.
+ * A few channels are sorted by insertion. More of them are marked in a bitmap of the
+ * width of the multiport, which is then scanned a word at a time, unless the multiport
+ * is wider than LF_SPARSE_BITMAP_MAX_WIDTH.
+ * @param record The sparse record, with a size greater than 1.
+ * @param width The width of the multiport.
+ */
+static void sort_present_channels(lf_sparse_io_record_t* record, int width) {
+  size_t* channels = lf_sparse_io_record_channels(record);
+  size_t size = (size_t)record->size;
+  size_t i = 1;
+  while (i < size && channels[i - 1] < channels[i]) {
+    i++;
+  }
+  if (i == size) {
+    // Already sorted, for example by an earlier iteration at this tag.
+    return;
+  }
+  size_t count = 0;
+  if (size <= LF_SPARSE_INSERTION_SORT_THRESHOLD || width > LF_SPARSE_BITMAP_MAX_WIDTH) {
+    if (size <= LF_SPARSE_INSERTION_SORT_THRESHOLD) {
+      for (; i < size; i++) {
+        size_t channel = channels[i];
+        size_t j = i;
+        for (; j > 0 && channels[j - 1] > channel; j--) {
+          channels[j] = channels[j - 1];
+        }
+        channels[j] = channel;
+      }
+    } else {
+      qsort(channels, size, sizeof(size_t), &compare_sizes);
+    }
+    for (i = 0; i < size; i++) {
+      if (count == 0 || channels[i] != channels[count - 1]) {
+        channels[count++] = channels[i];
+      }
+    }
+  } else {
+    size_t words = ((size_t)width + 63) / 64;
+    uint64_t bitmap[words];
+    memset(bitmap, 0, sizeof(bitmap));
+    for (i = 0; i < size; i++) {
+      bitmap[channels[i] / 64] |= (uint64_t)1 << (channels[i] % 64);
+    }
+    for (size_t word = 0; word < words; word++) {
+      for (uint64_t bits = bitmap[word]; bits != 0; bits &= bits - 1) {
+        channels[count++] = word * 64 + (size_t)lowest_bit(bits);
+      }
+    }
+  }
+  record->size = (int)count;
+}
+
+void lf_sparse_io_record_set_present(lf_sparse_io_record_t* record, size_t channel) {
+  if (record->present_bits == NULL || channel >= (size_t)record->width) {
+    return;
+  }
+  uint64_t* word = &record->present_bits[channel / 64];
+  uint64_t bit = (uint64_t)1 << (channel % 64);
+#ifdef LF_SINGLE_THREADED
+  *word |= bit;
+#else
+  // Channels of the multiport may be set present by reactions executing in parallel.
+  uint64_t old = *word;
+  while (!(old & bit) && !lf_atomic_bool_compare_and_swap64((int64_t*)word, (int64_t)old, (int64_t)(old | bit))) {
+    old = *word;
+  }
+#endif
+}
+
+/**
+ * @brief Return the first channel from `start` that is present according to the bitmap of
+ * the sparse record, or -1 if there is none.
+ */
+static int next_present_bit(lf_sparse_io_record_t* record, int start) {
+  if (start >= record->width) {
+    return -1;
+  }
+  size_t word = (size_t)start / 64;
+  uint64_t bits = record->present_bits[word] & (~(uint64_t)0 << (start % 64));
+  size_t words = ((size_t)record->width + 63) / 64;
+  while (bits == 0) {
+    if (++word >= words) {
+      return -1;
+    }
+    bits = record->present_bits[word];
+  }
+  return (int)(word * 64) + lowest_bit(bits);
+}
+
+/**
+ * @brief Return whether iteration over the present channels of `port` should use the bitmap of
+ * its sparse record. The first time a sparse record that has overflowed is iterated over, this
+ * records the width of the multiport, so that the bitmap is allocated at the start of the next tag.
+ */
+static bool use_present_bits(lf_port_base_t** port, int width) {
+  lf_sparse_io_record_t* record = port[0]->sparse_record;
+  if (record == NULL || record->size >= 0) {
+    return false;
+  }
+  if (record->present_bits == NULL) {
+    record->width = width;
+    return false;
+  }
+  return record->width == width;
+}
+
 /**
  * Given an array of pointers to port structs, return an iterator
  * that can be used to iterate over the present channels.
@@ -73,14 +199,17 @@ lf_multiport_iterator_t _lf_multiport_iterator_impl(lf_port_base_t** port, int w
     if (port[0]->sparse_record->size > 0) {
       // Need to sort it first (if the length is greater than 1).
       if (port[0]->sparse_record->size > 1) {
-        qsort(&port[0]->sparse_record->present_channels[0], (size_t)port[0]->sparse_record->size, sizeof(size_t),
-              &compare_sizes);
+        sort_present_channels(port[0]->sparse_record, width);
       }
       // NOTE: Following cast is unsafe if there more than 2^31 channels.
-      result.next = (int)port[0]->sparse_record->present_channels[0];
+      result.next = (int)lf_sparse_io_record_channels(port[0]->sparse_record)[0];
     }
     return result;
   }
+  if (use_present_bits(port, width)) {
+    result.next = next_present_bit(port[0]->sparse_record, 0);
+    return result;
+  }
   // Fallback is to iterate over all port structs representing channels.
   int start = 0;
   while (start < width) {
@@ -117,9 +246,13 @@ int lf_multiport_next(lf_multiport_iterator_t* iterator) {
       iterator->next = -1;
     } else {
       // NOTE: Following cast is unsafe if there more than 2^31 channels.
-      iterator->next = (int)sparse_record->present_channels[iterator->idx];
+      iterator->next = (int)lf_sparse_io_record_channels(sparse_record)[iterator->idx];
     }
     return iterator->next;
+  } else if (sparse_record && sparse_record->present_bits != NULL && sparse_record->width == iterator->width) {
+    // The record overflowed, but it has a bitmap of the present channels.
+    iterator->next = next_present_bit(sparse_record, iterator->next + 1);
+    return iterator->next;
   } else {
     // Fall back to iterate over all port structs representing channels.
     int start = iterator->next + 1;
@@ -135,3 +268,40 @@ int lf_multiport_next(lf_multiport_iterator_t* iterator) {
     return iterator->next;
   }
 }
+
+void lf_sparse_io_record_start_tag(lf_sparse_io_record_t* record) {
+  if (record->present_bits != NULL && record->size != 0) {
+    // Some channels were set present.
+    memset(record->present_bits, 0, ((size_t)record->width + 63) / 64 * sizeof(uint64_t));
+  } else if (record->present_bits == NULL && record->width > 0) {
+    // The record overflowed and was iterated over. If there is no memory, iteration keeps
+    // falling back to checking every channel.
+    record->present_bits = (uint64_t*)calloc(((size_t)record->width + 63) / 64, sizeof(uint64_t));
+  }
+  if (record->size < 0) {
+    record->window_overflows++;
+  }
+  record->size = 0;
+  if (record->window_overflows >= LF_SPARSE_OVERFLOWS_TO_GROW) {
+    size_t capacity = record->capacity > 0 ? 2 * record->capacity : 1;
+    size_t* channels = (size_t*)malloc(capacity * sizeof(size_t));
+    // If there is no memory, iteration keeps falling back to checking every channel.
+    if (channels != NULL) {
+      free(record->channels);
+      record->channels = channels;
+      record->capacity = capacity;
+    }
+    record->window_tags = 0;
+    record->window_overflows = 0;
+  } else if (++record->window_tags >= LF_SPARSE_OVERFLOW_WINDOW) {
+    record->window_tags = 0;
+    record->window_overflows = 0;
+  }
+}
+
+void lf_sparse_io_record_free(lf_sparse_io_record_t* record) {
+  free(record->channels);
+  record->channels = NULL;
+  free(record->present_bits);
+  record->present_bits = NULL;
+}
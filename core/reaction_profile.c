@@ -0,0 +1,282 @@
+/**
+ * @file
+ * @brief Execution-time statistics of reactions, collected by the runtime.
+ *
+ * See reaction_profile.h.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "reaction_profile.h"
+#ifdef LF_DVFS
+#include "dvfs.h"
+#endif
+#ifdef LF_LATENCY
+#include "latency.h"
+#endif
+#include "low_level_platform.h"
+#include "util.h"
+
+/**
+ * The histogram has 2^SUB_BUCKET_BITS buckets per power of two, so a percentile is
+ * estimated within a factor of 1 + 2^-SUB_BUCKET_BITS.
+ */
+#define SUB_BUCKET_BITS 3
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+#define NUMBER_OF_BUCKETS ((64 - SUB_BUCKET_BITS) * SUB_BUCKETS)
+
+/** The weight of each new execution time in the estimate is 2^-LF_REACTION_PROFILE_EWMA_SHIFT. */
+#ifndef LF_REACTION_PROFILE_EWMA_SHIFT
+#define LF_REACTION_PROFILE_EWMA_SHIFT 3
+#endif
+
+struct lf_reaction_profile_t {
+  size_t count;           // Number of invocations.
+  interval_t min;         // Minimum execution time.
+  interval_t max;         // Maximum execution time.
+  interval_t total;       // Sum of the execution times.
+  interval_t estimate;    // Exponentially weighted moving average of the execution times.
+  size_t deadline_count;  // Number of invocations of a reaction with a deadline.
+  interval_t min_slack;   // Minimum slack.
+  interval_t total_slack; // Sum of the slacks.
+  uint32_t buckets[NUMBER_OF_BUCKETS];
+  size_t index;           // The index of the reaction in the file written by lf_reaction_profile_write.
+#ifdef LF_REACTION_PROFILE_COUNTERS
+  size_t counted_count;                      // Number of invocations for which the counters were read.
+  uint64_t counter_totals[LF_PERF_COUNTERS]; // Sums of the increments of the counters.
+#endif
+};
+
+#ifdef LF_REACTION_PROFILE_COUNTERS
+/** The counter group of this thread, -1 if it could not be opened, or -2 if it has not been opened yet. */
+#ifdef LF_SINGLE_THREADED
+static int counter_group = -2;
+#else
+static thread_local int counter_group = -2;
+#endif
+
+/** Whether the warning that the counters are not available has been printed. */
+static int32_t counters_warned = 0;
+#endif
+
+/** @brief Return the index of the bucket of execution time `t`, which is not negative. */
+static size_t bucket_of(uint64_t t) {
+  if (t < SUB_BUCKETS) {
+    return (size_t)t;
+  }
+  int bits = 64;
+#if defined(__GNUC__)
+  bits -= __builtin_clzll(t);
+#else
+  for (uint64_t u = t; !(u & (1ULL << 63)); u <<= 1) {
+    bits--;
+  }
+#endif
+  // The most significant bit selects the power of two and the next bits select the sub-bucket.
+  int shift = bits - 1 - SUB_BUCKET_BITS;
+  return (size_t)(shift + 1) * SUB_BUCKETS + (size_t)((t >> shift) & (SUB_BUCKETS - 1));
+}
+
+/** @brief Return the largest execution time in the bucket with the given index. */
+static interval_t bucket_max(size_t bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return (interval_t)bucket;
+  }
+  int shift = (int)(bucket / SUB_BUCKETS) - 1;
+  uint64_t lowest = (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+  return (interval_t)(lowest + (1ULL << shift) - 1);
+}
+
+/** @brief Return an estimate of the given percentile of the execution times. */
+static interval_t percentile(struct lf_reaction_profile_t* profile, int percent) {
+  // The rank of the invocation that is the percentile, counting from 1.
+  size_t rank = (profile->count * (size_t)percent + 99) / 100;
+  size_t seen = 0;
+  for (size_t i = 0; i < NUMBER_OF_BUCKETS; i++) {
+    seen += profile->buckets[i];
+    if (seen >= rank) {
+      return LF_MIN(bucket_max(i), profile->max);
+    }
+  }
+  return profile->max;
+}
+
+void lf_reaction_profile_start(lf_reaction_profile_sample_t* sample) {
+#ifdef LF_REACTION_PROFILE_COUNTERS
+  if (counter_group == -2) {
+    counter_group = lf_perf_counters_open();
+    if (counter_group < 0 && lf_atomic_bool_compare_and_swap32(&counters_warned, 0, 1)) {
+      lf_print_warning("Hardware performance counters are not available. Only execution times are profiled.");
+    }
+  }
+#endif
+  // The counters are read after the clock and before it at the end, so they exclude the clock reads.
+  sample->start = lf_time_physical();
+#ifdef LF_REACTION_PROFILE_COUNTERS
+  sample->counted = counter_group >= 0 && lf_perf_counters_read(counter_group, sample->counters) == 0;
+#endif
+}
+
+void lf_reaction_profile_record(environment_t* env, reaction_t* reaction, const lf_reaction_profile_sample_t* sample) {
+#ifdef LF_REACTION_PROFILE_COUNTERS
+  uint64_t counters[LF_PERF_COUNTERS];
+  bool counted = sample->counted && lf_perf_counters_read(counter_group, counters) == 0;
+#endif
+  instant_t start = sample->start;
+  instant_t end = lf_time_physical();
+  struct lf_reaction_profile_t* profile = reaction->profile;
+  if (profile == NULL) {
+    profile = (struct lf_reaction_profile_t*)calloc(1, sizeof(struct lf_reaction_profile_t));
+    LF_ASSERT_NON_NULL(profile);
+    reaction->profile = profile;
+    LF_CRITICAL_SECTION_ENTER(env);
+    vector_push(&env->profiled_reactions, reaction);
+    LF_CRITICAL_SECTION_EXIT(env);
+  }
+  interval_t t = LF_MAX(end - start, (interval_t)0);
+  if (profile->count == 0 || t < profile->min) {
+    profile->min = t;
+  }
+  if (profile->count == 0) {
+    profile->estimate = t;
+  } else {
+    profile->estimate += (t - profile->estimate) / (1 << LF_REACTION_PROFILE_EWMA_SHIFT);
+  }
+  profile->max = LF_MAX(profile->max, t);
+  profile->total += t;
+  profile->count++;
+  profile->buckets[bucket_of((uint64_t)t)]++;
+  if (reaction->deadline >= 0) {
+    interval_t slack = env->current_tag.time + reaction->deadline - start;
+    if (profile->deadline_count == 0 || slack < profile->min_slack) {
+      profile->min_slack = slack;
+    }
+    profile->total_slack += slack;
+    profile->deadline_count++;
+#ifdef LF_DVFS
+    lf_dvfs_reaction_ended(env, reaction, end);
+#endif
+  }
+#ifdef LF_REACTION_PROFILE_COUNTERS
+  if (counted) {
+    for (int i = 0; i < LF_PERF_COUNTERS; i++) {
+      profile->counter_totals[i] += counters[i] - sample->counters[i];
+    }
+    profile->counted_count++;
+  }
+#endif
+}
+
+interval_t lf_reaction_profile_estimate(reaction_t* reaction) {
+  struct lf_reaction_profile_t* profile = reaction->profile;
+  return profile == NULL ? 0 : profile->estimate;
+}
+
+size_t lf_reaction_profile_count(reaction_t* reaction) {
+  struct lf_reaction_profile_t* profile = reaction->profile;
+  return profile == NULL ? 0 : profile->count;
+}
+
+void lf_reaction_profile_print(environment_t* env) {
+  size_t n = vector_size(&env->profiled_reactions);
+  if (n == 0) {
+    return;
+  }
+  lf_print("---- Execution times of the reactions of environment %d (nsec):", env->id);
+  for (size_t i = 0; i < n; i++) {
+    reaction_t* reaction = VECTOR_GET(&env->profiled_reactions, i, reaction_t*);
+    struct lf_reaction_profile_t* profile = reaction->profile;
+    // Reaction names are only set if logging is enabled.
+    const char* name = reaction->name != NULL ? reaction->name : "(unnamed)";
+    lf_print("---- %s: count %zu, min " PRINTF_TIME ", mean " PRINTF_TIME ", p50 " PRINTF_TIME ", p99 " PRINTF_TIME
+             ", max " PRINTF_TIME,
+             name, profile->count, profile->min, profile->total / (interval_t)profile->count, percentile(profile, 50),
+             percentile(profile, 99), profile->max);
+    if (profile->deadline_count > 0) {
+      lf_print("---- %s: deadline slack min " PRINTF_TIME ", mean " PRINTF_TIME, name, profile->min_slack,
+               profile->total_slack / (interval_t)profile->deadline_count);
+    }
+#ifdef LF_REACTION_PROFILE_COUNTERS
+    if (profile->counted_count > 0) {
+      uint64_t* totals = profile->counter_totals;
+      uint64_t n_counted = (uint64_t)profile->counted_count;
+      lf_print("---- %s: cycles mean %" PRIu64 ", instructions per cycle %.2f, LLC misses mean %" PRIu64
+               ", branch misses mean %" PRIu64,
+               name, totals[0] / n_counted, totals[0] > 0 ? (double)totals[1] / (double)totals[0] : 0.0,
+               totals[2] / n_counted, totals[3] / n_counted);
+    }
+#endif
+  }
+}
+
+/**
+ * @brief Write an edge to each of the reactions with statistics that are triggered by a reaction.
+ * @param file The file.
+ * @param reaction The reaction, which has statistics.
+ * @param downstream The reactions triggered by it.
+ * @param count The number of them.
+ */
+static void write_edges(FILE* file, reaction_t* reaction, reaction_t* const* downstream, int count) {
+  for (int k = 0; k < count; k++) {
+    if (downstream[k] != NULL && downstream[k]->profile != NULL) {
+      fprintf(file, "edge,%zu,%zu,%zu\n", reaction->profile->index, downstream[k]->profile->index,
+              reaction->profile->count);
+    }
+  }
+}
+
+void lf_reaction_profile_write(environment_t* env, const char* path) {
+  size_t n = vector_size(&env->profiled_reactions);
+  if (n == 0) {
+    return;
+  }
+  FILE* file = fopen(path, "w");
+  if (file == NULL) {
+    lf_print_warning("Could not write the reaction profile to %s.", path);
+    return;
+  }
+  fprintf(file, "# reaction,index,reactor,number,name,count,mean,p99\n# edge,from,to,invocations\n");
+#ifdef LF_LATENCY
+  fprintf(file, "# latency,chain,count,mean,p50,p99,max\n");
+#endif
+  for (size_t i = 0; i < n; i++) {
+    reaction_t* reaction = VECTOR_GET(&env->profiled_reactions, i, reaction_t*);
+    struct lf_reaction_profile_t* profile = reaction->profile;
+    profile->index = i;
+    fprintf(file, "reaction,%zu,%p,%d,%s,%zu," PRINTF_TIME "," PRINTF_TIME "\n", i, reaction->self, reaction->number,
+            reaction->name != NULL ? reaction->name : "", profile->count, profile->total / (interval_t)profile->count,
+            percentile(profile, 99));
+  }
+  for (size_t i = 0; i < n; i++) {
+    reaction_t* reaction = VECTOR_GET(&env->profiled_reactions, i, reaction_t*);
+    if (reaction->fanout != NULL) {
+      write_edges(file, reaction, reaction->fanout->reactions, reaction->fanout->offsets[reaction->num_outputs]);
+      continue;
+    }
+    for (size_t j = 0; reaction->triggers != NULL && j < reaction->num_outputs; j++) {
+      for (int k = 0; k < reaction->triggered_sizes[j]; k++) {
+        trigger_t* trigger = reaction->triggers[j][k];
+        if (trigger != NULL) {
+          write_edges(file, reaction, trigger->reactions, trigger->number_of_reactions);
+        }
+      }
+    }
+  }
+#ifdef LF_LATENCY
+  lf_latency_write(env, file);
+#endif
+  fclose(file);
+  lf_print("---- Wrote the reaction profile of environment %d to %s.", env->id, path);
+}
+
+void lf_reaction_profile_free(environment_t* env) {
+  for (size_t i = 0; i < vector_size(&env->profiled_reactions); i++) {
+    reaction_t* reaction = VECTOR_GET(&env->profiled_reactions, i, reaction_t*);
+    free(reaction->profile);
+    reaction->profile = NULL;
+  }
+  vector_free(&env->profiled_reactions);
+}
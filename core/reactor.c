@@ -17,6 +17,13 @@
 #include "low_level_platform.h"
 #include "reactor_common.h"
 #include "environment.h"
+#include "startup_report.h"
+#ifdef LF_CHECKPOINT
+#include "checkpoint.h"
+#endif
+#ifdef LF_DVFS
+#include "dvfs.h"
+#endif
 
 // Embedded platforms with no command line interface shouldnt have signals
 #if !defined(NO_CLI)
@@ -49,20 +56,26 @@ void lf_set_present(lf_port_base_t* port) {
     return;
   environment_t* env = port->source_reactor->environment;
   bool* is_present_field = &port->is_present;
-  if (env->is_present_fields_abbreviated_size < env->is_present_fields_size) {
-    env->is_present_fields_abbreviated[env->is_present_fields_abbreviated_size] = is_present_field;
+  // A port that is already present is already on the abbreviated list.
+  if (!*is_present_field) {
+    if (env->is_present_fields_abbreviated_size < env->is_present_fields_size) {
+      env->is_present_fields_abbreviated[env->is_present_fields_abbreviated_size] = is_present_field;
+    }
+    env->is_present_fields_abbreviated_size++;
   }
-  env->is_present_fields_abbreviated_size++;
   *is_present_field = true;
 
   // Support for sparse destination multiports.
+  if (port->sparse_record && port->destination_channel >= 0) {
+    lf_sparse_io_record_set_present(port->sparse_record, (size_t)port->destination_channel);
+  }
   if (port->sparse_record && port->destination_channel >= 0 && port->sparse_record->size >= 0) {
     size_t next = port->sparse_record->size++;
     if (next >= port->sparse_record->capacity) {
       // Buffer is full. Have to revert to the classic iteration.
       port->sparse_record->size = -1;
     } else {
-      port->sparse_record->present_channels[next] = port->destination_channel;
+      lf_sparse_io_record_channels(port->sparse_record)[next] = port->destination_channel;
     }
   }
 }
@@ -86,7 +99,7 @@ int wait_until(environment_t* env, instant_t wakeup_time) {
 void lf_print_snapshot(environment_t* env) {
   if (LOG_LEVEL > LOG_LEVEL_LOG) {
     LF_PRINT_DEBUG(">>> START Snapshot");
-    pqueue_dump(env->reaction_q, env->reaction_q->prt);
+    reaction_queue_dump(env->reaction_q);
     LF_PRINT_DEBUG(">>> END Snapshot");
   }
 }
@@ -114,12 +127,17 @@ void _lf_trigger_reaction(environment_t* env, reaction_t* reaction, int worker_n
     LF_PRINT_DEBUG("Enqueueing downstream reaction %s, which has level %lld.", reaction->name,
                    reaction->index & 0xffffLL);
     reaction->status = queued;
-    if (pqueue_insert(env->reaction_q, reaction) != 0) {
-      lf_print_error_and_exit("Could not insert reaction into reaction_q");
-    }
+    reaction_queue_insert(env->reaction_q, reaction);
   }
 }
 
+bool _lf_has_earlier_deadline(environment_t* env, reaction_t* reaction) {
+  assert(env != GLOBAL_ENVIRONMENT);
+  // The reaction queue is sorted by index, which has the deadline in its high-order bits.
+  reaction_t* head = reaction_queue_peek(env->reaction_q);
+  return head != NULL && (head->index >> 16) < (reaction->index >> 16);
+}
+
 /**
  * Execute all the reactions in the reaction queue at the current tag.
  *
@@ -131,9 +149,9 @@ int _lf_do_step(environment_t* env) {
   assert(env != GLOBAL_ENVIRONMENT);
 
   // Invoke reactions.
-  while (pqueue_size(env->reaction_q) > 0) {
+  reaction_t* reaction;
+  while ((reaction = reaction_queue_pop(env->reaction_q)) != NULL) {
     // lf_print_snapshot();
-    reaction_t* reaction = (reaction_t*)pqueue_pop(env->reaction_q);
     reaction->status = running;
 
     LF_PRINT_LOG("Invoking reaction %s at elapsed logical tag " PRINTF_TAG ".", reaction->name,
@@ -161,6 +179,7 @@ int _lf_do_step(environment_t* env) {
       if (reaction->deadline == 0 || physical_time > env->current_tag.time + reaction->deadline) {
         LF_PRINT_LOG("Deadline violation. Invoking deadline handler.");
         tracepoint_reaction_deadline_missed(env, reaction, 0);
+        _lf_record_deadline_miss(env, reaction);
         // Deadline violation has occurred.
         violation = true;
         // Invoke the local handler, if there is one.
@@ -222,8 +241,12 @@ int next(environment_t* env) {
   // Enter the critical section and do not leave until we have
   // determined which tag to commit to and start invoking reactions for.
   LF_CRITICAL_SECTION_ENTER(env);
-  event_t* event = (event_t*)pqueue_tag_peek(env->event_q);
-  // pqueue_dump(event_q, event_q->prt);
+#ifdef LF_DVFS
+  lf_dvfs_tag_completed(env);
+#endif
+  // Move the events that interrupts pushed since the last look, including during the last sleep.
+  _lf_isr_rings_drain_locked(env);
+  event_t* event = _lf_peek_next_event(env);
   // If there is no next event and -keepalive has been specified
   // on the command line, then we will wait the maximum time possible.
   tag_t next_tag = FOREVER_TAG_INITIALIZER;
@@ -308,6 +331,7 @@ int lf_reactor_c_main(int argc, const char* argv[]) {
   LF_PRINT_DEBUG("Processing command line arguments.");
   if (process_args(default_argc, default_argv) && process_args(argc, argv)) {
     LF_PRINT_DEBUG("Processed command line arguments.");
+    _lf_lock_memory();
     LF_PRINT_DEBUG("Registering the termination function.");
     if (atexit(termination) != 0) {
       lf_print_warning("Failed to register termination function!");
@@ -320,7 +344,9 @@ int lf_reactor_c_main(int argc, const char* argv[]) {
     signal(SIGINT, exit);
 #endif
     // Create and initialize the environment
+    LF_STARTUP_BEGIN(lf_startup_environments);
     lf_create_environments(); // code-generated function
+    LF_STARTUP_END(lf_startup_environments);
     environment_t* env;
     int num_environments = _lf_get_environments(&env);
     LF_ASSERT(num_environments == 1, "Found %d environments. Only 1 can be used with the single-threaded runtime",
@@ -342,8 +368,18 @@ int lf_reactor_c_main(int argc, const char* argv[]) {
     // Set up modal infrastructure
     _lf_initialize_modes(env);
 #endif
-    _lf_trigger_startup_reactions(env);
-    _lf_initialize_timers(env);
+#ifdef LF_CHECKPOINT
+    bool restored = _lf_checkpoint_restore(env);
+#else
+    bool restored = false;
+#endif
+    // A program that resumes from a checkpoint has already started up.
+    if (!restored) {
+      LF_STARTUP_BEGIN(lf_startup_start_tag);
+      _lf_trigger_startup_reactions(env);
+      _lf_initialize_timers(env);
+      LF_STARTUP_END(lf_startup_start_tag);
+    }
     // If the stop_tag is (0,0), also insert the shutdown
     // reactions. This can only happen if the timeout time
     // was set to 0.
@@ -352,6 +388,8 @@ int lf_reactor_c_main(int argc, const char* argv[]) {
     }
     LF_PRINT_DEBUG("Running the program's main loop.");
     // Handle reactions triggered at time (T,m).
+    LF_STARTUP_PRINT();
+    _lf_memory_startup_complete();
     env->execution_started = true;
     if (_lf_do_step(env)) {
       while (next(env) != 0)
@@ -11,6 +11,8 @@
  * @brief Runtime infrastructure common to the threaded and single-threaded versions of the C runtime.
  */
 #include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
@@ -26,6 +28,8 @@
 #include "port.h"
 #include "pqueue.h"
 #include "reactor.h"
+#include "startup_report.h"
+#include "memory_accounting.h"
 #include "tracepoint.h"
 #include "util.h"
 #include "vector.h"
@@ -37,6 +41,37 @@
 
 #if !defined(LF_SINGLE_THREADED)
 #include "watchdog.h"
+#include "async_work.h"
+#include "scheduler.h"
+#endif
+
+#ifdef LF_STATIC_SCHEDULE
+#include "static_schedule.h"
+#endif
+#ifdef LF_REACTION_PROFILE
+#include "reaction_profile.h"
+#endif
+#ifdef LF_METRICS
+#include "metrics.h"
+#endif
+#ifdef LF_CHECKPOINT
+#include "checkpoint.h"
+#endif
+#ifdef LF_RECORD_REPLAY
+#include "replay.h"
+#endif
+#ifdef LF_DVFS
+#include "dvfs.h"
+#endif
+#ifdef LF_LATENCY
+#include "latency.h"
+#include "user_metrics.h"
+#endif
+#ifdef LF_ARENA_PLACEMENT
+#include "arena_placement.h"
+#endif
+#ifdef LF_TAG_PIPELINING
+#include "pipeline.h"
 #endif
 
 // Global variable defined in tag.c:
@@ -77,6 +112,59 @@ bool fast = false;
  */
 unsigned int _lf_number_of_workers = 0u;
 
+/**
+ * The policy for pinning worker threads to CPUs, as given by the --pin
+ * command-line argument. This is NULL or "none" for no pinning, "compact"
+ * to pin consecutive workers to consecutive CPUs, "scatter" to spread the
+ * workers evenly over the available CPUs, or a comma-separated list of CPU
+ * numbers to be assigned round-robin to the workers.
+ */
+const char* _lf_worker_pinning = NULL;
+
+/**
+ * The file in which the adaptive scheduler keeps what it has learned across runs,
+ * as given by the --sched-state command-line argument, or NULL for none.
+ */
+const char* _lf_sched_state_file = NULL;
+
+/**
+ * The checkpoint from which to resume, as given by the --restore command-line argument,
+ * or NULL to start afresh. See checkpoint.h.
+ */
+const char* _lf_checkpoint_restore_file = NULL;
+
+/**
+ * The file to log the events of physical actions to, as given by the --record command-line
+ * argument, or NULL to not record them. See replay.h.
+ */
+const char* _lf_replay_record_file = NULL;
+
+/**
+ * The file to replay the events of physical actions from, as given by the --replay command-line
+ * argument, or NULL to not replay them. See replay.h.
+ */
+const char* _lf_replay_file = NULL;
+
+/**
+ * The number of bytes of heap to prefault and lock in memory at startup, as given by
+ * the --lock-memory command-line argument, or 0 to not lock memory.
+ */
+size_t _lf_memory_lock_budget = 0;
+
+/**
+ * Whether the heap locked by --lock-memory should be backed by huge pages, as given
+ * by the --huge-pages command-line argument.
+ */
+bool _lf_huge_pages = false;
+
+#ifdef PLATFORM_Linux
+/**
+ * The number of page faults taken when startup completed, 0 if memory is locked but
+ * startup has not completed, or -1 if memory is not locked.
+ */
+static long _lf_startup_page_faults = -1;
+#endif
+
 /**
  * The logical time to elapse during execution, or -1 if no timeout time has
  * been given. When the logical equal to start_time + duration has been
@@ -87,7 +175,101 @@ instant_t duration = -1LL;
 /** Indicator of whether the keepalive command-line option was given. */
 bool keepalive_specified = false;
 
+#ifdef LF_ARENA_ALLOCATION
+
+#ifndef LF_ARENA_BLOCK_SIZE
+#define LF_ARENA_BLOCK_SIZE (64 * 1024)
+#endif
+
+/**
+ * @brief Header of a block of memory from which lf_allocate and lf_new_reactor carve allocations.
+ * The union with max_align_t keeps the memory that follows the header suitably aligned.
+ */
+typedef union _lf_arena_block_t {
+  struct {
+    union _lf_arena_block_t* next; // Next block of the arena, allocated earlier.
+    size_t size;                   // Number of bytes after the header.
+    size_t used;                   // Number of those bytes that have been handed out.
+  } header;
+  max_align_t alignment;
+} _lf_arena_block_t;
+
+/** The arena, a list of blocks whose head is the block currently being carved. */
+static _lf_arena_block_t* _lf_arena = NULL;
+
+/**
+ * @brief Allocate zeroed memory from the arena.
+ * Allocations larger than a quarter of a block get their own block so that the rest of the current
+ * block is not wasted.
+ */
+static void* _lf_arena_allocate(size_t count, size_t size) {
+  if (size != 0 && count > SIZE_MAX / size)
+    lf_print_error_and_exit("Out of memory!");
+  size_t bytes = (count * size + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+  void* mem = NULL;
+  LF_CRITICAL_SECTION_ENTER(GLOBAL_ENVIRONMENT);
+  _lf_arena_block_t* block = _lf_arena;
+  if (block == NULL || block->header.size - block->header.used < bytes) {
+    size_t block_size = (bytes > LF_ARENA_BLOCK_SIZE / 4) ? bytes : LF_ARENA_BLOCK_SIZE;
+    _lf_arena_block_t* new_block = (_lf_arena_block_t*)calloc(1, sizeof(_lf_arena_block_t) + block_size);
+    if (new_block == NULL)
+      lf_print_error_and_exit("Out of memory!");
+    LF_MEMORY_ALLOCATED(lf_memory_reactors, sizeof(_lf_arena_block_t) + block_size);
+    new_block->header.size = block_size;
+    if (block_size == bytes && block != NULL) {
+      // Keep carving the current block.
+      new_block->header.next = block->header.next;
+      block->header.next = new_block;
+    } else {
+      new_block->header.next = block;
+      _lf_arena = new_block;
+    }
+    block = new_block;
+  }
+  mem = (char*)(block + 1) + block->header.used;
+  block->header.used += bytes;
+  LF_CRITICAL_SECTION_EXIT(GLOBAL_ENVIRONMENT);
+  return mem;
+}
+
+/** @brief Return true if the specified memory was allocated from the arena. */
+static bool _lf_arena_contains(void* mem) {
+  for (_lf_arena_block_t* block = _lf_arena; block != NULL; block = block->header.next) {
+    if ((char*)mem >= (char*)(block + 1) && (char*)mem < (char*)(block + 1) + block->header.size)
+      return true;
+  }
+  return false;
+}
+
+/** @brief Free all blocks of the arena at once. */
+static void _lf_arena_free(void) {
+  _lf_arena_block_t* block = _lf_arena;
+  while (block != NULL) {
+    _lf_arena_block_t* next = block->header.next;
+    LF_MEMORY_FREED(lf_memory_reactors, sizeof(_lf_arena_block_t) + block->header.size);
+    free(block);
+    block = next;
+  }
+  _lf_arena = NULL;
+}
+
+#endif // LF_ARENA_ALLOCATION
+
 void* lf_allocate(size_t count, size_t size, struct allocation_record_t** head) {
+#ifdef LF_ARENA_ALLOCATION
+  // Recorded memory is freed together with the arena, so it needs no allocation record.
+#ifdef LF_ARENA_PLACEMENT
+  if (head != NULL) {
+    if (size != 0 && count > SIZE_MAX / size)
+      lf_print_error_and_exit("Out of memory!");
+    size_t bytes = (count * size + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+    return _lf_arena_placement_allocate(bytes, head, _lf_arena_allocate);
+  }
+#else
+  if (head != NULL)
+    return _lf_arena_allocate(count, size);
+#endif
+#endif
   void* mem = calloc(count, size);
   if (mem == NULL)
     lf_print_error_and_exit("Out of memory!");
@@ -96,6 +278,10 @@ void* lf_allocate(size_t count, size_t size, struct allocation_record_t** head)
     if (record == NULL)
       lf_print_error_and_exit("Out of memory!");
     record->allocated = mem;
+#ifdef LF_MEMORY_ACCOUNTING
+    record->size = count * size + sizeof(allocation_record_t);
+    LF_MEMORY_ALLOCATED(lf_memory_reactors, record->size);
+#endif
     allocation_record_t* tmp = *head; // Previous head of the list or NULL.
     *head = record;                   // New head of the list.
     record->next = tmp;
@@ -109,7 +295,13 @@ void* lf_allocate(size_t count, size_t size, struct allocation_record_t** head)
  */
 struct allocation_record_t* _lf_reactors_to_free = NULL;
 
-self_base_t* lf_new_reactor(size_t size) { return (self_base_t*)lf_allocate(1, size, &_lf_reactors_to_free); }
+self_base_t* lf_new_reactor(size_t size) {
+  self_base_t* self = (self_base_t*)lf_allocate(1, size, &_lf_reactors_to_free);
+#ifdef LF_RECORD_REPLAY
+  _lf_replay_register_reactor(self, size);
+#endif
+  return self;
+}
 
 void lf_free(struct allocation_record_t** head) {
   if (head == NULL)
@@ -119,6 +311,9 @@ void lf_free(struct allocation_record_t** head) {
     LF_PRINT_DEBUG("Freeing memory at %p", record->allocated);
     free(record->allocated);
     struct allocation_record_t* tmp = record->next;
+#ifdef LF_MEMORY_ACCOUNTING
+    LF_MEMORY_FREED(lf_memory_reactors, record->size);
+#endif
     LF_PRINT_DEBUG("Freeing allocation record at %p", (void*)record);
     free(record);
     record = tmp;
@@ -128,6 +323,11 @@ void lf_free(struct allocation_record_t** head) {
 
 void lf_free_reactor(self_base_t* self) {
   lf_free(&self->allocations);
+#ifdef LF_ARENA_ALLOCATION
+  // The arena memory is only released by lf_free_all_reactors.
+  if (_lf_arena_contains(self))
+    return;
+#endif
   free(self);
 }
 
@@ -136,10 +336,16 @@ void lf_free_all_reactors(void) {
   while (head != NULL) {
     lf_free_reactor((self_base_t*)head->allocated);
     struct allocation_record_t* tmp = head->next;
+#ifdef LF_MEMORY_ACCOUNTING
+    LF_MEMORY_FREED(lf_memory_reactors, head->size);
+#endif
     free(head);
     head = tmp;
   }
   _lf_reactors_to_free = NULL;
+#ifdef LF_ARENA_ALLOCATION
+  _lf_arena_free();
+#endif
 }
 
 void lf_set_stop_tag(environment_t* env, tag_t tag) {
@@ -178,23 +384,46 @@ void _lf_start_time_step(environment_t* env) {
   if (env->is_present_fields_abbreviated_size > env->is_present_fields_size) {
     size = env->is_present_fields_size;
     is_present_fields = env->is_present_fields;
+    env->is_present_fields_full_resets++;
   }
   for (int i = 0; i < size; i++) {
     *is_present_fields[i] = false;
   }
-  // Reset sparse IO record sizes to 0, if any.
+#if !defined(LF_SINGLE_THREADED)
+  // Merge in the lists of the workers, which are not counted in is_present_fields_abbreviated_size.
+  for (int w = 0; w < env->num_workers; w++) {
+    lf_present_list_t* list = &env->worker_present_fields[w];
+    for (int i = 0; i < list->size; i++) {
+      *list->fields[i] = false;
+    }
+    list->size = 0;
+  }
+#endif
+  // Reset sparse IO record sizes to 0, if any. The size is the first field of the record.
   if (env->sparse_io_record_sizes.start != NULL) {
     for (size_t i = 0; i < vector_size(&env->sparse_io_record_sizes); i++) {
-      // NOTE: vector_at does not return the element at
-      // the index, but rather returns a pointer to that element, which is
-      // itself a pointer.
-      int** sizep = (int**)vector_at(&env->sparse_io_record_sizes, i);
-      if (sizep != NULL && *sizep != NULL) {
-        **sizep = 0;
+      int* record_size = VECTOR_GET(&env->sparse_io_record_sizes, i, int*);
+      if (record_size != NULL) {
+        lf_sparse_io_record_start_tag((lf_sparse_io_record_t*)record_size);
       }
     }
   }
   env->is_present_fields_abbreviated_size = 0;
+#ifdef LF_LATENCY
+  env->latency_origin = NEVER;
+#endif
+#ifdef LF_METRICS
+  lf_metrics_tag_started(env);
+#endif
+#ifdef LF_USER_METRICS
+  lf_user_metrics_tag_started(env);
+#endif
+#ifdef LF_DVFS
+  lf_dvfs_tag_started(env);
+#endif
+#ifdef LF_CHECKPOINT
+  _lf_checkpoint_save_if_requested(env);
+#endif
 
 #ifdef FEDERATED
   // If the environment is the top-level one, we have some work to do.
@@ -209,6 +438,9 @@ void _lf_start_time_step(environment_t* env) {
       *env->_lf_intended_tag_fields[i] = NEVER_TAG;
     }
 #endif // FEDERATED_DECENTRALIZED
+#ifdef LF_FEDERATED_OPTIMISTIC
+    lf_optimistic_tag_started_locked(env);
+#endif
 
     // Reset absent fields on network ports because
     // their status is unknown
@@ -224,125 +456,349 @@ bool lf_is_tag_after_stop_tag(environment_t* env, tag_t tag) {
   return (lf_tag_compare(tag, env->stop_tag) > 0);
 }
 
-void _lf_pop_events(environment_t* env) {
-  assert(env != GLOBAL_ENVIRONMENT);
-#ifdef MODAL_REACTORS
-  _lf_handle_mode_triggered_reactions(env);
-#endif
+/**
+ * @brief Move the events at the specified tag, which is the current tag or the next one, from
+ * the events at the next microstep and from the event queue, to `events`, and return their number.
+ */
+static size_t pop_events_at_tag(environment_t* env, tag_t tag, vector_t* events) {
+  size_t count = vector_size(&env->next_microstep_events);
+  if (count > 0) {
+    event_t* first = *(event_t**)vector_at(&env->next_microstep_events, 0);
+    if (lf_tag_compare(first->base.tag, tag) != 0) {
+      // Not reached yet. The current tag only advances to the tag of these events.
+      count = 0;
+    } else {
+      vector_pushall(events, env->next_microstep_events.start, count);
+      vector_clear(&env->next_microstep_events);
+    }
+  }
+  return count + pqueue_tag_pop_all_with_tag(env->event_q, tag, events);
+}
 
-  event_t* event = (event_t*)pqueue_tag_peek(env->event_q);
-  while (event != NULL && lf_tag_compare(event->base.tag, env->current_tag) == 0) {
-    event = (event_t*)pqueue_tag_pop(env->event_q);
+#ifdef LF_BATCH_REACTIONS
+/** The maximum number of batches that a reaction_batcher_t forms at once. */
+#define BATCHER_LEADERS 4
 
-    if (event->trigger == NULL) {
-      LF_PRINT_DEBUG("Popped dummy event from the event queue.");
-      lf_recycle_event(env, event);
-      // Peek at the next event in the event queue.
-      event = (event_t*)pqueue_tag_peek(env->event_q);
-      continue;
+/**
+ * Triggered reactions that have a batch function join the batch of a reaction with the same
+ * batch function and level, which leads the batch. Only the leader is triggered through the
+ * scheduler, and the worker that gets it executes the whole batch. A leader is marked running
+ * until the batch is complete, so that it is not handed to a worker before then.
+ */
+typedef struct reaction_batcher_t {
+  reaction_t* leaders[BATCHER_LEADERS];
+  size_t sizes[BATCHER_LEADERS];
+  int num_leaders;
+} reaction_batcher_t;
+
+/** @brief Trigger `reaction`, or add it to a batch if it has a batch function. */
+static void batcher_trigger(environment_t* env, reaction_batcher_t* batcher, reaction_t* reaction, int worker) {
+  if (reaction->batch_function == NULL || reaction->mode != NULL || reaction->is_an_input_reaction ||
+      ((self_base_t*)reaction->self)->reactor_mutex != NULL) {
+    _lf_trigger_reaction(env, reaction, worker);
+    return;
+  }
+  for (int i = 0; i < batcher->num_leaders; i++) {
+    reaction_t* leader = batcher->leaders[i];
+    if (leader->batch_function == reaction->batch_function && LF_LEVEL(leader->index) == LF_LEVEL(reaction->index) &&
+        batcher->sizes[i] < LF_REACTION_BATCH_SIZE) {
+      // If the reaction has already been triggered, it executes on its own.
+      if (lf_atomic_bool_compare_and_swap32((int32_t*)&reaction->status, inactive, queued)) {
+        reaction->next_in_batch = leader->next_in_batch;
+        leader->next_in_batch = reaction;
+        batcher->sizes[i]++;
+      }
+      return;
     }
+  }
+  if (batcher->num_leaders < BATCHER_LEADERS &&
+      lf_atomic_bool_compare_and_swap32((int32_t*)&reaction->status, inactive, running)) {
+    reaction->next_in_batch = NULL;
+    batcher->leaders[batcher->num_leaders] = reaction;
+    batcher->sizes[batcher->num_leaders++] = 1;
+    return;
+  }
+  _lf_trigger_reaction(env, reaction, worker);
+}
+
+/** @brief Trigger the leaders of the batches formed by `batcher`. */
+static void batcher_flush(environment_t* env, reaction_batcher_t* batcher, int worker) {
+  for (int i = 0; i < batcher->num_leaders; i++) {
+    // The batch is complete, so the leader can be triggered like any other reaction.
+    lf_atomic_bool_compare_and_swap32((int32_t*)&batcher->leaders[i]->status, running, inactive);
+    _lf_trigger_reaction(env, batcher->leaders[i], worker);
+  }
+  batcher->num_leaders = 0;
+}
+#define BATCHER_DECLARE(batcher)                                                                                       \
+  reaction_batcher_t batcher##_instance = {.num_leaders = 0};                                                          \
+  reaction_batcher_t* batcher = &batcher##_instance
+#define BATCHER_TRIGGER(env, batcher, reaction, worker) batcher_trigger(env, batcher, reaction, worker)
+#define BATCHER_FLUSH(env, batcher, worker) batcher_flush(env, batcher, worker)
+#else
+typedef struct reaction_batcher_t reaction_batcher_t;
+#define BATCHER_DECLARE(batcher) reaction_batcher_t* batcher = NULL
+#define BATCHER_TRIGGER(env, batcher, reaction, worker) ((void)(batcher), _lf_trigger_reaction(env, reaction, worker))
+#define BATCHER_FLUSH(env, batcher, worker) (void)(batcher)
+#endif // LF_BATCH_REACTIONS
 
+/**
+ * @brief Trigger the reactions of an event popped at the current tag and mark its trigger present.
+ *
+ * This only touches the trigger of the event, the timers grouped with it and its reactions, and
+ * inserts the reactions with the scheduler, so the events of a tag, which have distinct triggers,
+ * can be activated by several threads at once.
+ * @param env The environment.
+ * @param event The event.
+ * @param batcher The batcher of the calling thread.
+ * @param worker The number of the calling worker, or -1.
+ */
+static void activate_event(environment_t* env, event_t* event, reaction_batcher_t* batcher, int worker) {
 #ifdef MODAL_REACTORS
-    // If this event is associated with an inactive mode it should haven been suspended and no longer on the event
-    // queue. NOTE: This should not be possible
-    if (!_lf_mode_is_active(event->trigger->mode)) {
-      lf_print_warning(
-          "Assumption violated. There is an event on the event queue that is associated to an inactive mode.");
-    }
+  // If this event is associated with an inactive mode it should haven been suspended and no longer on the event
+  // queue. NOTE: This should not be possible
+  if (!_lf_mode_is_active(event->trigger->mode)) {
+    lf_print_warning(
+        "Assumption violated. There is an event on the event queue that is associated to an inactive mode.");
+  }
 #endif
 
-    lf_token_t* token = event->token;
-
-    // Put the corresponding reactions onto the reaction queue.
-    for (int i = 0; i < event->trigger->number_of_reactions; i++) {
-      reaction_t* reaction = event->trigger->reactions[i];
-      // Do not enqueue this reaction twice.
-      if (reaction->status == inactive) {
+  // Put the corresponding reactions onto the reaction queue.
+  for (int i = 0; i < event->trigger->number_of_reactions; i++) {
+    reaction_t* reaction = event->trigger->reactions[i];
+    // Do not enqueue this reaction twice.
+    if (reaction->status == inactive) {
 #ifdef FEDERATED_DECENTRALIZED
-        // In federated execution, an intended tag that is not (NEVER, 0)
-        // indicates that this particular event is triggered by a network message.
-        // The intended tag is set in handle_tagged_message in federate.c whenever
-        // a tagged message arrives from another federate.
-        if (event->intended_tag.time != NEVER) {
-          // If the intended tag of the event is actually set,
-          // transfer the intended tag to the trigger so that
-          // the reaction can access the value.
-          event->trigger->intended_tag = event->intended_tag;
-          // And check if it is in the past compared to the current tag.
-          if (lf_tag_compare(event->intended_tag, env->current_tag) < 0) {
-            // Mark the triggered reaction with a STP violation
-            reaction->is_STP_violated = true;
-            LF_PRINT_LOG("Trigger %p has violated the reaction's STP offset. Intended tag: " PRINTF_TAG
-                         ". Current tag: " PRINTF_TAG,
-                         (void*)event->trigger, event->intended_tag.time - start_time, event->intended_tag.microstep,
-                         env->current_tag.time - start_time, env->current_tag.microstep);
-            // Need to update the last_known_status_tag of the port because otherwise,
-            // the MLAA could get stuck, causing the program to lock up.
-            // This should not call update_last_known_status_on_input_port because we
-            // are starting a new tag step execution, so there are no reactions blocked on this input.
-            if (lf_tag_compare(env->current_tag, event->trigger->last_known_status_tag) > 0) {
-              event->trigger->last_known_status_tag = env->current_tag;
-            }
+      // In federated execution, an intended tag that is not (NEVER, 0)
+      // indicates that this particular event is triggered by a network message.
+      // The intended tag is set in handle_tagged_message in federate.c whenever
+      // a tagged message arrives from another federate.
+      if (event->intended_tag.time != NEVER) {
+        // If the intended tag of the event is actually set,
+        // transfer the intended tag to the trigger so that
+        // the reaction can access the value.
+        event->trigger->intended_tag = event->intended_tag;
+        // And check if it is in the past compared to the current tag.
+        if (lf_tag_compare(event->intended_tag, env->current_tag) < 0) {
+          // Mark the triggered reaction with a STP violation
+          reaction->is_STP_violated = true;
+          LF_PRINT_LOG("Trigger %p has violated the reaction's STP offset. Intended tag: " PRINTF_TAG
+                       ". Current tag: " PRINTF_TAG,
+                       (void*)event->trigger, event->intended_tag.time - start_time, event->intended_tag.microstep,
+                       env->current_tag.time - start_time, env->current_tag.microstep);
+          // Need to update the last_known_status_tag of the port because otherwise,
+          // the MLAA could get stuck, causing the program to lock up.
+          // This should not call update_last_known_status_on_input_port because we
+          // are starting a new tag step execution, so there are no reactions blocked on this input.
+          if (lf_tag_compare(env->current_tag, event->trigger->last_known_status_tag) > 0) {
+            event->trigger->last_known_status_tag = env->current_tag;
           }
         }
+      }
 #endif
 
 #ifdef MODAL_REACTORS
-        // Check if reaction is disabled by mode inactivity
-        if (!_lf_mode_is_active(reaction->mode)) {
-          LF_PRINT_DEBUG("Suppressing reaction %s due inactive mode.", reaction->name);
-          continue; // Suppress reaction by preventing entering reaction queue
-        }
-#endif
-        LF_PRINT_DEBUG("Triggering reaction %s.", reaction->name);
-        _lf_trigger_reaction(env, reaction, -1);
-      } else {
-        LF_PRINT_DEBUG("Reaction is already triggered: %s", reaction->name);
+      // Check if reaction is disabled by mode inactivity
+      if (!_lf_mode_is_active(reaction->mode)) {
+        LF_PRINT_DEBUG("Suppressing reaction %s due inactive mode.", reaction->name);
+        continue; // Suppress reaction by preventing entering reaction queue
       }
+#endif
+      LF_PRINT_DEBUG("Triggering reaction %s.", reaction->name);
+      BATCHER_TRIGGER(env, batcher, reaction, worker);
+    } else {
+      LF_PRINT_DEBUG("Reaction is already triggered: %s", reaction->name);
     }
+  }
 
-    // Mark the trigger present.
-    event->trigger->status = present;
+  // Mark the trigger present.
+  event->trigger->status = present;
 
-    // If the trigger is a periodic timer, create a new event for its next execution.
-    if (event->trigger->is_timer && event->trigger->period > 0LL) {
-      // Reschedule the trigger.
-      lf_schedule_trigger(env, event->trigger, event->trigger->period, NULL);
+  // The timers grouped with this one fire along with it.
+  for (trigger_t* timer = event->trigger->next_in_timer_group; timer != NULL; timer = timer->next_in_timer_group) {
+    for (int i = 0; i < timer->number_of_reactions; i++) {
+      if (timer->reactions[i]->status == inactive) {
+        LF_PRINT_DEBUG("Triggering reaction %s.", timer->reactions[i]->name);
+        BATCHER_TRIGGER(env, batcher, timer->reactions[i], worker);
+      }
     }
+    timer->status = present;
+  }
+}
 
-    // Copy the token pointer into the trigger struct so that the
-    // reactions can access it. This overwrites the previous template token,
-    // for which we decrement the reference count.
-    _lf_replace_template_token((token_template_t*)event->trigger, token);
+/**
+ * @brief Finish with an event that has been activated: reschedule a periodic timer, hand the
+ * payload to the trigger, and recycle the event.
+ */
+static void finish_event(environment_t* env, event_t* event) {
+  // If the trigger is a periodic timer, create a new event for its next execution.
+  if (event->trigger->is_timer && event->trigger->period > 0LL) {
+    // Reschedule the trigger.
+    lf_schedule_trigger(env, event->trigger, event->trigger->period, NULL);
+  }
 
-    // Decrement the reference count because the event queue no longer needs this token.
-    // This has to be done after the above call to _lf_replace_template_token because
-    // that call will increment the reference count and we need to not let the token be
-    // freed prematurely.
-    _lf_done_using(token);
+  lf_token_t* token = event->token;
 
-    // Mark the trigger present.
-    event->trigger->status = present;
+  // Copy the token pointer into the trigger struct so that the
+  // reactions can access it. This overwrites the previous template token,
+  // for which we decrement the reference count.
+  _lf_replace_template_token((token_template_t*)event->trigger, token);
+
+  // Decrement the reference count because the event queue no longer needs this token.
+  // This has to be done after the above call to _lf_replace_template_token because
+  // that call will increment the reference count and we need to not let the token be
+  // freed prematurely.
+  _lf_done_using(token);
 
+  // Mark the trigger present.
+  event->trigger->status = present;
+
+  lf_recycle_event(env, event);
+}
+
+/**
+ * @brief Prepare an event popped at the current tag for activation, and return false if it has
+ * been disposed of instead, which happens to dummy events and to events that the static schedule handles.
+ */
+static bool accept_event(environment_t* env, event_t* event) {
+#ifdef LF_STATIC_SCHEDULE
+  if (lf_static_schedule_handle_event(env, event)) {
+    return false;
+  }
+#endif
+  if (event->trigger == NULL) {
+    LF_PRINT_DEBUG("Popped dummy event from the event queue.");
     lf_recycle_event(env, event);
+    return false;
+  }
+#if defined(FEDERATED) && defined(LF_FEDERATED_OPTIMISTIC)
+  lf_optimistic_event_popped_locked(env, event);
+#endif
+#ifdef LF_LATENCY
+  if (event->origin != NEVER && (env->latency_origin == NEVER || event->origin < env->latency_origin)) {
+    env->latency_origin = event->origin;
+  }
+#endif
+  return true;
+}
 
-    // Peek at the next event in the event queue.
-    event = (event_t*)pqueue_tag_peek(env->event_q);
-  };
+#if defined(LF_PARALLEL_POP) && !defined(LF_SINGLE_THREADED)
+/** @brief The events that lf_sched_parallel_for() activates. */
+typedef struct activation_t {
+  environment_t* env;
+  event_t** events;
+} activation_t;
+
+/** @brief Activate the events from `begin` to `end`, which is the body of the parallel loop. */
+static void activate_events(void* arg, size_t begin, size_t end) {
+  activation_t* activation = (activation_t*)arg;
+  BATCHER_DECLARE(batcher);
+  for (size_t i = begin; i < end; i++) {
+    activate_event(activation->env, activation->events[i], batcher, -1);
+  }
+  BATCHER_FLUSH(activation->env, batcher, -1);
 }
 
+/**
+ * @brief Handle the events popped at the current tag, activating them with the help of the
+ * idle workers (see LF_PARALLEL_POP). The rest of the handling of each event is done by the
+ * calling thread before and after.
+ */
+static void pop_events_in_parallel(environment_t* env, vector_t* events) {
+  event_t** accepted = (event_t**)events->start;
+  size_t count = 0;
+  for (void** popped = events->start; popped < events->next; popped++) {
+    if (accept_event(env, (event_t*)*popped)) {
+      accepted[count++] = (event_t*)*popped;
+    }
+  }
+  activation_t activation = {.env = env, .events = accepted};
+  lf_sched_parallel_for(env->scheduler, count, activate_events, &activation);
+  for (size_t i = 0; i < count; i++) {
+    finish_event(env, accepted[i]);
+  }
+  vector_clear(events);
+}
+#endif // LF_PARALLEL_POP && !LF_SINGLE_THREADED
+
+void _lf_pop_events(environment_t* env) {
+  assert(env != GLOBAL_ENVIRONMENT);
+#ifdef MODAL_REACTORS
+  _lf_handle_mode_triggered_reactions(env);
+#endif
+
+  // Pop all events at the current tag at once. Handling an event may schedule another one
+  // at the current tag, so repeat until there are none left.
+  vector_t* events = &env->events_at_current_tag;
+  BATCHER_DECLARE(batcher);
+  while (pop_events_at_tag(env, env->current_tag, events) > 0) {
+    vector_vote(events);
+    for (void** popped = events->start; popped < events->next; popped++) {
+      _lf_forget_pending_event((event_t*)*popped);
+#ifdef LF_TAG_PIPELINING
+      _lf_pipeline_explore_trigger_locked(env, ((event_t*)*popped)->trigger);
+#endif
+    }
+#if defined(LF_PARALLEL_POP) && !defined(LF_SINGLE_THREADED)
+    if (vector_size(events) >= LF_PARALLEL_POP) {
+      pop_events_in_parallel(env, events);
+      continue;
+    }
+#endif
+    event_t* event;
+    while ((event = (event_t*)vector_pop(events)) != NULL) {
+      if (accept_event(env, event)) {
+        activate_event(env, event, batcher, -1);
+        finish_event(env, event);
+      }
+    }
+  }
+  BATCHER_FLUSH(env, batcher, -1);
+}
+
+#ifdef LF_TAG_PIPELINING
+size_t _lf_pop_events_ahead(environment_t* env, tag_t tag) {
+  assert(env != GLOBAL_ENVIRONMENT);
+  vector_t* events = &env->events_at_current_tag;
+  BATCHER_DECLARE(batcher);
+  size_t activated = 0;
+  pop_events_at_tag(env, tag, events);
+  event_t* event;
+  while ((event = (event_t*)vector_pop(events)) != NULL) {
+    if (!_lf_pipeline_event_is_ahead(env, event)) {
+      // Left for the ordinary advancement of the tag. The event is still pending on its trigger.
+      pqueue_tag_insert(env->event_q, (pqueue_tag_element_t*)event);
+    } else {
+      _lf_forget_pending_event(event);
+      if (accept_event(env, event)) {
+        activate_event(env, event, batcher, -1);
+        finish_event(env, event);
+        activated++;
+      }
+    }
+  }
+  BATCHER_FLUSH(env, batcher, -1);
+  return activated;
+}
+#endif // LF_TAG_PIPELINING
+
 event_t* lf_get_new_event(environment_t* env) {
   assert(env != GLOBAL_ENVIRONMENT);
-  // Recycle event_t structs, if possible.
-  event_t* e = (event_t*)pqueue_tag_pop(env->recycle_q);
-  if (e == NULL) {
-    e = (event_t*)calloc(1, sizeof(struct event_t));
-    if (e == NULL)
-      lf_print_error_and_exit("Out of memory!");
-#ifdef FEDERATED_DECENTRALIZED
-    e->intended_tag = (tag_t){.time = NEVER, .microstep = 0u};
+  if (env->free_events == NULL) {
+#ifdef LF_STATIC_MEMORY
+    lf_print_error_and_exit("All %zu events are in use. Increase LF_MAX_EVENTS.", env->events_allocated);
+#else
+    // Double the number of events.
+    environment_allocate_events(env, (env->events_allocated > 0) ? env->events_allocated : 1);
 #endif
   }
+  event_t* e = env->free_events;
+  env->free_events = e->next_free;
+  env->events_free--;
+  e->next_free = NULL;
+#ifdef LF_LATENCY
+  e->origin = NEVER;
+#endif
   return e;
 }
 
@@ -364,9 +820,11 @@ void _lf_initialize_timer(environment_t* env, trigger_t* timer) {
   }
 #endif
   if (timer->offset == 0) {
-    for (int i = 0; i < timer->number_of_reactions; i++) {
-      _lf_trigger_reaction(env, timer->reactions[i], -1);
-      tracepoint_schedule(env, timer, 0LL); // Trace even though schedule is not called.
+    for (trigger_t* member = timer; member != NULL; member = member->next_in_timer_group) {
+      for (int i = 0; i < member->number_of_reactions; i++) {
+        _lf_trigger_reaction(env, member->reactions[i], -1);
+        tracepoint_schedule(env, member, 0LL); // Trace even though schedule is not called.
+      }
     }
     if (timer->period == 0) {
       return;
@@ -385,24 +843,59 @@ void _lf_initialize_timer(environment_t* env, trigger_t* timer) {
   e->trigger = timer;
   e->base.tag = (tag_t){.time = lf_time_logical(env) + delay, .microstep = 0};
   // NOTE: No lock is being held. Assuming this only happens at startup.
-  pqueue_tag_insert(env->event_q, (pqueue_tag_element_t*)e);
+  _lf_enqueue_event(env, e);
   tracepoint_schedule(env, timer, delay); // Trace even though schedule is not called.
 }
 
+/** @brief Order timers by offset, then by period. */
+static int compare_timers(const void* a, const void* b) {
+  const trigger_t* x = *(trigger_t* const*)a;
+  const trigger_t* y = *(trigger_t* const*)b;
+  if (x->offset != y->offset) {
+    return x->offset < y->offset ? -1 : 1;
+  }
+  return (x->period > y->period) - (x->period < y->period);
+}
+
 void _lf_initialize_timers(environment_t* env) {
   assert(env != GLOBAL_ENVIRONMENT);
+#ifdef LF_STATIC_SCHEDULE
+  lf_static_schedule_init(env);
+#endif
+  // Periodic timers with the same offset and period are grouped so that one event on the
+  // event queue stands for the whole group. Timers in modes are suspended and reset one by one,
+  // so they are not grouped.
+  trigger_t** periodic = (trigger_t**)calloc(env->timer_triggers_size + 1, sizeof(trigger_t*));
+  LF_ASSERT_NON_NULL(periodic);
+  int num_periodic = 0;
   for (int i = 0; i < env->timer_triggers_size; i++) {
-    if (env->timer_triggers[i] != NULL) {
-      _lf_initialize_timer(env, env->timer_triggers[i]);
+    trigger_t* timer = env->timer_triggers[i];
+    if (timer != NULL) {
+#ifdef LF_STATIC_SCHEDULE
+      if (lf_static_schedule_covers(env, timer)) {
+        continue;
+      }
+#endif
+      timer->next_in_timer_group = NULL;
+      if (timer->period > 0 && timer->mode == NULL) {
+        periodic[num_periodic++] = timer;
+      } else {
+        _lf_initialize_timer(env, timer);
+      }
     }
   }
-
-  // To avoid runtime memory allocations for timer-driven programs
-  // the recycle queue is initialized with a single event.
-  if (env->timer_triggers_size > 0) {
-    event_t* e = lf_get_new_event(env);
-    lf_recycle_event(env, e);
+  qsort(periodic, num_periodic, sizeof(trigger_t*), compare_timers);
+  for (int i = 0; i + 1 < num_periodic; i++) {
+    if (compare_timers(&periodic[i], &periodic[i + 1]) == 0) {
+      periodic[i]->next_in_timer_group = periodic[i + 1];
+    }
   }
+  for (int i = 0; i < num_periodic; i++) {
+    if (i == 0 || periodic[i - 1]->next_in_timer_group != periodic[i]) {
+      _lf_initialize_timer(env, periodic[i]);
+    }
+  }
+  free(periodic);
 }
 
 void _lf_trigger_startup_reactions(environment_t* env) {
@@ -450,7 +943,9 @@ void lf_recycle_event(environment_t* env, event_t* e) {
 #ifdef FEDERATED_DECENTRALIZED
   e->intended_tag = (tag_t){.time = NEVER, .microstep = 0u};
 #endif
-  pqueue_tag_insert(env->recycle_q, (pqueue_tag_element_t*)e);
+  e->next_free = env->free_events;
+  env->free_events = e;
+  env->events_free++;
 }
 
 event_t* _lf_create_dummy_events(environment_t* env, tag_t tag) {
@@ -470,6 +965,69 @@ void lf_replace_token(event_t* event, lf_token_t* token) {
   event->token = token;
 }
 
+void _lf_enqueue_event(environment_t* env, event_t* e) {
+  trigger_t* trigger = e->trigger;
+  if (trigger != NULL) {
+    // Find the last pending event with a tag no larger than that of e, searching from the end.
+    event_t* earlier = trigger->last_pending;
+    event_t* later = NULL;
+    while (earlier != NULL && lf_tag_compare(earlier->base.tag, e->base.tag) > 0) {
+      later = earlier;
+      earlier = earlier->earlier_pending;
+    }
+    e->earlier_pending = earlier;
+    e->later_pending = later;
+    if (earlier != NULL) {
+      earlier->later_pending = e;
+    }
+    if (later != NULL) {
+      later->earlier_pending = e;
+    } else {
+      trigger->last_pending = e;
+    }
+  }
+#ifndef MODAL_REACTORS
+  if (e->base.tag.time == env->current_tag.time && e->base.tag.microstep == env->current_tag.microstep + 1) {
+    vector_push(&env->next_microstep_events, e);
+    return;
+  }
+#endif
+  pqueue_tag_insert(env->event_q, (pqueue_tag_element_t*)e);
+}
+
+event_t* _lf_peek_next_event(environment_t* env) {
+  if (vector_size(&env->next_microstep_events) > 0) {
+    return *(event_t**)vector_at(&env->next_microstep_events, 0);
+  }
+  return (event_t*)pqueue_tag_peek(env->event_q);
+}
+
+void _lf_forget_pending_event(event_t* e) {
+  if (e->trigger == NULL) {
+    return;
+  }
+  if (e->earlier_pending != NULL) {
+    e->earlier_pending->later_pending = e->later_pending;
+  }
+  if (e->later_pending != NULL) {
+    e->later_pending->earlier_pending = e->earlier_pending;
+  } else if (e->trigger->last_pending == e) {
+    e->trigger->last_pending = e->earlier_pending;
+  }
+  e->earlier_pending = NULL;
+  e->later_pending = NULL;
+}
+
+event_t* _lf_find_pending_event(trigger_t* trigger, tag_t tag) {
+  for (event_t* e = trigger->last_pending; e != NULL; e = e->earlier_pending) {
+    int comparison = lf_tag_compare(e->base.tag, tag);
+    if (comparison <= 0) {
+      return comparison == 0 ? e : NULL;
+    }
+  }
+  return NULL;
+}
+
 trigger_handle_t _lf_schedule_at_tag(environment_t* env, trigger_t* trigger, tag_t tag, lf_token_t* token) {
   assert(env != GLOBAL_ENVIRONMENT);
   tag_t current_logical_tag = env->current_tag;
@@ -483,7 +1041,7 @@ trigger_handle_t _lf_schedule_at_tag(environment_t* env, trigger_t* trigger, tag
 
   // Increment the reference count of the token.
   if (token != NULL) {
-    token->ref_count++;
+    _lf_token_add_reference(token);
     LF_PRINT_DEBUG("_lf_schedule_at_tag: Incremented ref_count of %p to %zu.", (void*)token, token->ref_count);
   }
 
@@ -512,7 +1070,7 @@ trigger_handle_t _lf_schedule_at_tag(environment_t* env, trigger_t* trigger, tag
   e->intended_tag = trigger->intended_tag;
 #endif
 
-  event_t* found = (event_t*)pqueue_tag_find_equal_same_tag(env->event_q, (pqueue_tag_element_t*)e);
+  event_t* found = _lf_find_pending_event(trigger, tag);
   if (found != NULL) {
     switch (trigger->policy) {
     case drop:
@@ -542,7 +1100,7 @@ trigger_handle_t _lf_schedule_at_tag(environment_t* env, trigger_t* trigger, tag
       }
     }
   }
-  pqueue_tag_insert(env->event_q, (pqueue_tag_element_t*)e);
+  _lf_enqueue_event(env, e);
   trigger_handle_t return_value = env->_lf_handle++;
   if (env->_lf_handle < 0) {
     env->_lf_handle = 1;
@@ -660,6 +1218,15 @@ void _lf_advance_tag(environment_t* env, tag_t next_tag) {
                env->current_tag.microstep, lf_time_physical_elapsed());
 }
 
+void _lf_record_deadline_miss(environment_t* env, reaction_t* reaction) {
+  // A reaction is executed by one worker at a time, so the count needs no lock.
+  if (++reaction->deadline_misses == 1) {
+    LF_CRITICAL_SECTION_ENTER(env);
+    vector_push(&env->deadline_missed_reactions, reaction);
+    LF_CRITICAL_SECTION_EXIT(env);
+  }
+}
+
 /**
 
  * Invoke the given reaction
@@ -673,33 +1240,144 @@ void _lf_invoke_reaction(environment_t* env, reaction_t* reaction, int worker) {
 
 #if !defined(LF_SINGLE_THREADED)
   if (((self_base_t*)reaction->self)->reactor_mutex != NULL) {
-    LF_MUTEX_LOCK((lf_mutex_t*)((self_base_t*)reaction->self)->reactor_mutex);
+    _lf_reactor_lock((self_base_t*)reaction->self);
   }
 #endif
 
   tracepoint_reaction_starts(env, reaction, worker);
   ((self_base_t*)reaction->self)->executing_reaction = reaction;
+#ifdef LF_METRICS
+  instant_t metrics_start = lf_time_physical();
+#endif
+#ifdef LF_REACTION_PROFILE
+  lf_reaction_profile_sample_t profile_sample;
+  lf_reaction_profile_start(&profile_sample);
+  reaction->function(reaction->self);
+  lf_reaction_profile_record(env, reaction, &profile_sample);
+#else
   reaction->function(reaction->self);
+#endif
+#ifdef LF_METRICS
+  lf_metrics_reaction_invoked(env, worker, metrics_start);
+#endif
   ((self_base_t*)reaction->self)->executing_reaction = NULL;
   tracepoint_reaction_ends(env, reaction, worker);
 
 #if !defined(LF_SINGLE_THREADED)
   if (((self_base_t*)reaction->self)->reactor_mutex != NULL) {
-    LF_MUTEX_UNLOCK((lf_mutex_t*)((self_base_t*)reaction->self)->reactor_mutex);
+    _lf_reactor_unlock((self_base_t*)reaction->self);
   }
 #endif
 }
 
+void _lf_invoke_reaction_batch(environment_t* env, reaction_t** reactions, size_t count, int worker) {
+  assert(env != GLOBAL_ENVIRONMENT);
+  void* selves[LF_REACTION_BATCH_SIZE];
+  for (size_t i = 0; i < count; i++) {
+    tracepoint_reaction_starts(env, reactions[i], worker);
+    ((self_base_t*)reactions[i]->self)->executing_reaction = reactions[i];
+    selves[i] = reactions[i]->self;
+  }
+#ifdef LF_METRICS
+  instant_t metrics_start = lf_time_physical();
+#endif
+#ifdef LF_REACTION_PROFILE
+  // The whole batch is recorded as one execution of the first reaction.
+  lf_reaction_profile_sample_t profile_sample;
+  lf_reaction_profile_start(&profile_sample);
+  reactions[0]->batch_function(selves, count);
+  lf_reaction_profile_record(env, reactions[0], &profile_sample);
+#else
+  reactions[0]->batch_function(selves, count);
+#endif
+#ifdef LF_METRICS
+  // The time of the batch is counted once, and each reaction of the batch counts as invoked.
+  lf_metrics_reaction_invoked(env, worker, metrics_start);
+  instant_t metrics_end = lf_time_physical();
+  for (size_t i = 1; i < count; i++) {
+    lf_metrics_reaction_invoked(env, worker, metrics_end);
+  }
+#endif
+  for (size_t i = 0; i < count; i++) {
+    ((self_base_t*)reactions[i]->self)->executing_reaction = NULL;
+    tracepoint_reaction_ends(env, reactions[i], worker);
+  }
+}
+
 /**
- * For the specified reaction, if it has produced outputs, insert the
- * resulting triggered reactions into the reaction queue.
- * This procedure assumes the mutex lock is NOT held and grabs
- * the lock only when it actually inserts something onto the reaction queue.
- * @param env Environment in which we are executing.
- * @param reaction The reaction that has just executed.
- * @param worker The thread number of the worker thread or 0 for single-threaded execution (for tracing).
+ * The maximum number of uniquely enabled downstream reactions that a worker executes in a chain
+ * directly after a reaction, without going through the reaction queue. 0 disables this optimization.
  */
-void schedule_output_reactions(environment_t* env, reaction_t* reaction, int worker) {
+#ifndef LF_CHAIN_FUSION_MAX_HOPS
+#define LF_CHAIN_FUSION_MAX_HOPS 16
+#endif
+
+#ifdef LF_STATIC_TOPOLOGY
+/**
+ * @brief Return the downstream reactions of the outputs of `reaction` in one array, which the
+ * generated code gives as a constant table.
+ */
+static inline const lf_fanout_t* fanout_of(environment_t* env, reaction_t* reaction) {
+  (void)env;
+  LF_ASSERT(reaction->fanout != NULL, "Reaction %s has outputs but no fanout table.", reaction->name);
+  return reaction->fanout;
+}
+#elif !defined(LF_STATIC_MEMORY)
+/**
+ * @brief Return the downstream reactions of the outputs of `reaction` in one array, building it
+ * the first time. The array is freed with the reactor. This replaces three dependent loads per
+ * downstream reaction with one. With LF_STATIC_MEMORY, which allocates no memory after startup,
+ * the runtime follows the triggers instead.
+ *
+ * A reaction propagates its outputs on one worker at a time, so only that worker reads or
+ * writes its `fanout` field.
+ */
+static const lf_fanout_t* fanout_of(environment_t* env, reaction_t* reaction) {
+  if (reaction->fanout != NULL) {
+    return reaction->fanout;
+  }
+  size_t count = 0;
+  for (size_t i = 0; i < reaction->num_outputs; i++) {
+    for (int j = 0; j < reaction->triggered_sizes[i]; j++) {
+      trigger_t* trigger = reaction->triggers[i][j];
+      for (int k = 0; trigger != NULL && k < trigger->number_of_reactions; k++) {
+        count += trigger->reactions[k] != NULL;
+      }
+    }
+  }
+  self_base_t* self = (self_base_t*)reaction->self;
+  size_t size = sizeof(lf_fanout_t) + count * sizeof(reaction_t*) + (reaction->num_outputs + 1) * sizeof(int);
+  // Reactions of the same reactor may record their arrays on its list of allocations at the same time.
+  LF_CRITICAL_SECTION_ENTER(env);
+  lf_fanout_t* fanout = (lf_fanout_t*)lf_allocate(1, size, self != NULL ? &self->allocations : NULL);
+  LF_CRITICAL_SECTION_EXIT(env);
+  reaction_t** reactions = (reaction_t**)(fanout + 1);
+  int* offsets = (int*)&reactions[count];
+  int offset = 0;
+  for (size_t i = 0; i < reaction->num_outputs; i++) {
+    offsets[i] = offset;
+    for (int j = 0; j < reaction->triggered_sizes[i]; j++) {
+      trigger_t* trigger = reaction->triggers[i][j];
+      for (int k = 0; trigger != NULL && k < trigger->number_of_reactions; k++) {
+        if (trigger->reactions[k] != NULL) {
+          reactions[offset++] = trigger->reactions[k];
+        }
+      }
+    }
+  }
+  offsets[reaction->num_outputs] = offset;
+  fanout->reactions = reactions;
+  fanout->offsets = offsets;
+  reaction->fanout = fanout;
+  return fanout;
+}
+#endif // LF_STATIC_TOPOLOGY
+
+/**
+ * @brief Implementation of schedule_output_reactions() for a reaction that was itself executed
+ * inline at the end of a chain of `hops` uniquely enabled reactions.
+ */
+static void schedule_output_reactions_after_hops(environment_t* env, reaction_t* reaction, int worker, int hops) {
   assert(env != GLOBAL_ENVIRONMENT);
 
   // If the reaction produced outputs, put the resulting triggered
@@ -716,58 +1394,84 @@ void schedule_output_reactions(environment_t* env, reaction_t* reaction, int wor
   LF_PRINT_DEBUG("Reaction %s has STP violation status: %d.", reaction->name, reaction->is_STP_violated);
 #endif
   LF_PRINT_DEBUG("There are %zu outputs from reaction %s.", reaction->num_outputs, reaction->name);
+  BATCHER_DECLARE(batcher);
+#if defined(LF_STATIC_TOPOLOGY) || !defined(LF_STATIC_MEMORY)
+  const lf_fanout_t* fanout = reaction->num_outputs > 0 ? fanout_of(env, reaction) : NULL;
+#endif
   for (size_t i = 0; i < reaction->num_outputs; i++) {
     if (reaction->output_produced[i] != NULL && *(reaction->output_produced[i])) {
       LF_PRINT_DEBUG("Output %zu has been produced.", i);
+#if defined(LF_STATIC_MEMORY) && !defined(LF_STATIC_TOPOLOGY)
       trigger_t** triggerArray = (reaction->triggers)[i];
       LF_PRINT_DEBUG("There are %d trigger arrays associated with output %zu.", reaction->triggered_sizes[i], i);
       for (int j = 0; j < reaction->triggered_sizes[i]; j++) {
         trigger_t* trigger = triggerArray[j];
-        if (trigger != NULL) {
-          LF_PRINT_DEBUG("Trigger %p lists %d reactions.", (void*)trigger, trigger->number_of_reactions);
-          for (int k = 0; k < trigger->number_of_reactions; k++) {
-            reaction_t* downstream_reaction = trigger->reactions[k];
+        if (trigger == NULL) {
+          continue;
+        }
+        LF_PRINT_DEBUG("Trigger %p lists %d reactions.", (void*)trigger, trigger->number_of_reactions);
+        reaction_t** downstream = trigger->reactions;
+        int count = trigger->number_of_reactions;
+#else
+      {
+        reaction_t* const* downstream = &fanout->reactions[fanout->offsets[i]];
+        int count = fanout->offsets[i + 1] - fanout->offsets[i];
+        LF_PRINT_DEBUG("Output %zu triggers %d reactions.", i, count);
+        // Fetch the status words of the downstream reactions while the first ones are triggered.
+        for (int k = 0; k < count; k++) {
+          LF_PREFETCH_FOR_WRITE(downstream[k]);
+        }
+#endif
+        for (int k = 0; k < count; k++) {
+          reaction_t* downstream_reaction = downstream[k];
 #ifdef FEDERATED_DECENTRALIZED // Only pass down tardiness for federated LF programs
-            // Set the is_STP_violated for the downstream reaction
-            if (downstream_reaction != NULL) {
-              downstream_reaction->is_STP_violated = inherited_STP_violation;
-              LF_PRINT_DEBUG("Passing is_STP_violated of %d to the downstream reaction: %s",
-                             downstream_reaction->is_STP_violated, downstream_reaction->name);
-            }
+          // Set the is_STP_violated for the downstream reaction
+          if (downstream_reaction != NULL) {
+            downstream_reaction->is_STP_violated = inherited_STP_violation;
+            LF_PRINT_DEBUG("Passing is_STP_violated of %d to the downstream reaction: %s",
+                           downstream_reaction->is_STP_violated, downstream_reaction->name);
+          }
 #endif
-            if (downstream_reaction != NULL && downstream_reaction != downstream_to_execute_now) {
-              num_downstream_reactions++;
-              // If there is exactly one downstream reaction that is enabled by this
-              // reaction, then we can execute that reaction immediately without
-              // going through the reaction queue. In multithreaded execution, this
-              // avoids acquiring a mutex lock.
-              // FIXME: Check the earliest deadline on the reaction queue.
-              // This optimization could violate EDF scheduling otherwise.
-              if (num_downstream_reactions == 1 && downstream_reaction->last_enabling_reaction == reaction) {
-                // So far, this downstream reaction is a candidate to execute now.
-                downstream_to_execute_now = downstream_reaction;
-              } else {
-                // If there is a previous candidate reaction to execute now,
-                // it is no longer a candidate.
-                if (downstream_to_execute_now != NULL) {
-                  // More than one downstream reaction is enabled.
-                  // In this case, if we were to execute the downstream reaction
-                  // immediately without changing any queues, then the second
-                  // downstream reaction would be blocked because this reaction
-                  // remains on the executing queue. Hence, the optimization
-                  // is not valid. Put the candidate reaction on the queue.
-                  _lf_trigger_reaction(env, downstream_to_execute_now, worker);
-                  downstream_to_execute_now = NULL;
-                }
-                // Queue the reaction.
-                _lf_trigger_reaction(env, downstream_reaction, worker);
+          if (downstream_reaction != NULL && downstream_reaction != downstream_to_execute_now) {
+            num_downstream_reactions++;
+            // If there is exactly one downstream reaction that is enabled by this
+            // reaction, then we can execute that reaction immediately without
+            // going through the reaction queue. In multithreaded execution, this
+            // avoids acquiring a mutex lock. Whether this preserves EDF order
+            // is checked below.
+            if (num_downstream_reactions == 1 && downstream_reaction->last_enabling_reaction == reaction) {
+              // So far, this downstream reaction is a candidate to execute now.
+              downstream_to_execute_now = downstream_reaction;
+            } else {
+              // If there is a previous candidate reaction to execute now,
+              // it is no longer a candidate.
+              if (downstream_to_execute_now != NULL) {
+                // More than one downstream reaction is enabled.
+                // In this case, if we were to execute the downstream reaction
+                // immediately without changing any queues, then the second
+                // downstream reaction would be blocked because this reaction
+                // remains on the executing queue. Hence, the optimization
+                // is not valid. Put the candidate reaction on the queue.
+                BATCHER_TRIGGER(env, batcher, downstream_to_execute_now, worker);
+                downstream_to_execute_now = NULL;
               }
+              // Queue the reaction.
+              BATCHER_TRIGGER(env, batcher, downstream_reaction, worker);
             }
           }
         }
       }
     }
   }
+  BATCHER_FLUSH(env, batcher, worker);
+  if (downstream_to_execute_now != NULL &&
+      (hops >= LF_CHAIN_FUSION_MAX_HOPS || _lf_has_earlier_deadline(env, downstream_to_execute_now))) {
+    // Executing the downstream reaction now would make the chain too long or violate EDF order.
+    LF_PRINT_DEBUG("Worker %d: Queueing downstream reaction %s after %d hops.", worker, downstream_to_execute_now->name,
+                   hops);
+    _lf_trigger_reaction(env, downstream_to_execute_now, worker);
+    downstream_to_execute_now = NULL;
+  }
   if (downstream_to_execute_now != NULL) {
     LF_PRINT_LOG("Worker %d: Optimizing and executing downstream reaction now: %s", worker,
                  downstream_to_execute_now->name);
@@ -804,7 +1508,7 @@ void schedule_output_reactions(environment_t* env, reaction_t* reaction, int wor
 
         // If the reaction produced outputs, put the resulting
         // triggered reactions into the queue or execute them directly if possible.
-        schedule_output_reactions(env, downstream_to_execute_now, worker);
+        schedule_output_reactions_after_hops(env, downstream_to_execute_now, worker, hops + 1);
 
         // Reset the tardiness because it has been dealt with in the
         // STP handler
@@ -831,7 +1535,7 @@ void schedule_output_reactions(environment_t* env, reaction_t* reaction, int wor
 
           // If the reaction produced outputs, put the resulting
           // triggered reactions into the queue or execute them directly if possible.
-          schedule_output_reactions(env, downstream_to_execute_now, worker);
+          schedule_output_reactions_after_hops(env, downstream_to_execute_now, worker, hops + 1);
         }
         tracepoint_reaction_ends(env, downstream_to_execute_now, worker);
       }
@@ -842,7 +1546,7 @@ void schedule_output_reactions(environment_t* env, reaction_t* reaction, int wor
 
       // If the downstream_reaction produced outputs, put the resulting triggered
       // reactions into the queue (or execute them directly, if possible).
-      schedule_output_reactions(env, downstream_to_execute_now, worker);
+      schedule_output_reactions_after_hops(env, downstream_to_execute_now, worker, hops + 1);
     }
 
     // Reset the is_STP_violated because it has been passed
@@ -852,6 +1556,19 @@ void schedule_output_reactions(environment_t* env, reaction_t* reaction, int wor
   }
 }
 
+/**
+ * For the specified reaction, if it has produced outputs, insert the
+ * resulting triggered reactions into the reaction queue.
+ * This procedure assumes the mutex lock is NOT held and grabs
+ * the lock only when it actually inserts something onto the reaction queue.
+ * @param env Environment in which we are executing.
+ * @param reaction The reaction that has just executed.
+ * @param worker The thread number of the worker thread or 0 for single-threaded execution (for tracing).
+ */
+void schedule_output_reactions(environment_t* env, reaction_t* reaction, int worker) {
+  schedule_output_reactions_after_hops(env, reaction, worker, 0);
+}
+
 /**
  * Print a usage message.
  * TODO: This is not necessary for NO_CLI
@@ -867,6 +1584,33 @@ void usage(int argc, const char* argv[]) {
   printf("   Whether continue execution even when there are no events to process.\n\n");
   printf("  -w, --workers <n>\n");
   printf("   Executed in <n> threads if possible (optional feature).\n\n");
+  printf("  -p, --pin <none | compact | scatter | cpu,cpu,...>\n");
+  printf("   How to pin worker threads to CPUs, if supported by the platform.\n\n");
+  printf("  -s, --sched-state <file>\n");
+  printf("   Where the adaptive scheduler saves what it learns and restores it from on the next run.\n\n");
+  printf("  -m, --lock-memory <bytes>[K|M|G]\n");
+  printf("   Prefault a heap of the given size and lock all memory, reporting page faults after startup.\n\n");
+  printf("  --huge-pages\n");
+  printf("   Back the heap locked by --lock-memory with huge pages, if supported by the platform.\n\n");
+#ifdef LF_CHECKPOINT
+  printf("  --restore <file>\n");
+  printf("   Resume from the checkpoint saved in the given file instead of starting afresh.\n\n");
+#endif
+#ifdef LF_RECORD_REPLAY
+  printf("  --record <file>\n");
+  printf("   Log the events of physical actions to the given file.\n\n");
+  printf("  --replay <file>\n");
+  printf("   Replay the events of physical actions logged with --record, at their pace unless -f is given.\n\n");
+#endif
+#ifdef LF_TRACE
+  printf("  --trace-events <group,...>\n");
+  printf("   Trace only the listed groups of events, or all but those prefixed with '-', from reactions,\n");
+  printf("   deadlines, schedule, user, workers, scheduler, locks, federated, all and none.\n\n");
+  printf("  --trace-filter <reactor[.reaction],...>\n");
+  printf("   Trace only the reactions of the listed reactors (by full name) and the reactors they contain.\n\n");
+  printf("  --trace-sample <n>\n");
+  printf("   Trace one in every <n> invocations of the reactions of each reactor.\n\n");
+#endif
   printf("  -i, --id <n>\n");
   printf("   The ID of the federation that this reactor will join.\n\n");
 #ifdef FEDERATED
@@ -874,6 +1618,8 @@ void usage(int argc, const char* argv[]) {
   printf("   The address of the RTI, which can be in the form of user@host:port or ip:port.\n\n");
   printf("  -l\n");
   printf("   Send stdout to individual log files for each federate.\n\n");
+  printf("  --pin-listeners <cpu,cpu,...>\n");
+  printf("   Pin the threads that listen to the RTI and to each other federate to these CPUs.\n\n");
 #endif
 
   printf("Command given:\n");
@@ -984,7 +1730,125 @@ int process_args(int argc, const char* argv[]) {
         num_workers = 1;
       }
       _lf_number_of_workers = (unsigned int)num_workers;
+    } else if (strcmp(arg, "-p") == 0 || strcmp(arg, "--pin") == 0) {
+      if (argc < i + 1) {
+        lf_print_error("--pin needs an argument.");
+        usage(argc, argv);
+        return 0;
+      }
+      const char* pin_spec = argv[i++];
+      if (strcmp(pin_spec, "none") != 0 && strcmp(pin_spec, "compact") != 0 && strcmp(pin_spec, "scatter") != 0 &&
+          (pin_spec[0] == '\0' || strspn(pin_spec, "0123456789,") != strlen(pin_spec))) {
+        lf_print_error("Invalid value for --pin: %s", pin_spec);
+        usage(argc, argv);
+        return 0;
+      }
+      _lf_worker_pinning = pin_spec;
+    } else if (strcmp(arg, "-s") == 0 || strcmp(arg, "--sched-state") == 0) {
+      if (argc < i + 1) {
+        lf_print_error("--sched-state needs a file name argument.");
+        usage(argc, argv);
+        return 0;
+      }
+      _lf_sched_state_file = argv[i++];
+    } else if (strcmp(arg, "-m") == 0 || strcmp(arg, "--lock-memory") == 0) {
+      if (argc < i + 1) {
+        lf_print_error("--lock-memory needs a size argument.");
+        usage(argc, argv);
+        return 0;
+      }
+      const char* budget_spec = argv[i++];
+      char* units;
+      unsigned long long budget = strtoull(budget_spec, &units, 10);
+      if (units == budget_spec || budget_spec[0] == '-' || (units[0] != '\0' && units[1] != '\0')) {
+        lf_print_error("Invalid value for --lock-memory: %s", budget_spec);
+        usage(argc, argv);
+        return 0;
+      }
+      switch (units[0]) {
+      case 'G':
+        budget *= 1024;
+        // fall through
+      case 'M':
+        budget *= 1024;
+        // fall through
+      case 'K':
+        budget *= 1024;
+        // fall through
+      case '\0':
+        break;
+      default:
+        lf_print_error("Invalid units for --lock-memory: %s", budget_spec);
+        usage(argc, argv);
+        return 0;
+      }
+      _lf_memory_lock_budget = (size_t)budget;
+    } else if (strcmp(arg, "--huge-pages") == 0) {
+      _lf_huge_pages = true;
     }
+#ifdef LF_CHECKPOINT
+    else if (strcmp(arg, "--restore") == 0) {
+      if (argc < i + 1) {
+        lf_print_error("--restore needs a file name argument.");
+        usage(argc, argv);
+        return 0;
+      }
+      _lf_checkpoint_restore_file = argv[i++];
+    }
+#endif
+#ifdef LF_RECORD_REPLAY
+    else if (strcmp(arg, "--record") == 0) {
+      if (argc < i + 1) {
+        lf_print_error("--record needs a file name argument.");
+        usage(argc, argv);
+        return 0;
+      }
+      _lf_replay_record_file = argv[i++];
+    } else if (strcmp(arg, "--replay") == 0) {
+      if (argc < i + 1) {
+        lf_print_error("--replay needs a file name argument.");
+        usage(argc, argv);
+        return 0;
+      }
+      _lf_replay_file = argv[i++];
+    }
+#endif
+#ifdef LF_TRACE
+    else if (strcmp(arg, "--trace-events") == 0) {
+      if (argc < i + 1) {
+        lf_print_error("--trace-events needs a list of event groups.");
+        usage(argc, argv);
+        return 0;
+      }
+      const char* events_spec = argv[i++];
+      if (!_lf_trace_set_events(events_spec)) {
+        lf_print_error("Invalid value for --trace-events: %s", events_spec);
+        usage(argc, argv);
+        return 0;
+      }
+    } else if (strcmp(arg, "--trace-filter") == 0) {
+      if (argc < i + 1) {
+        lf_print_error("--trace-filter needs a list of reactor names.");
+        usage(argc, argv);
+        return 0;
+      }
+      _lf_trace_set_filter(argv[i++]);
+    } else if (strcmp(arg, "--trace-sample") == 0) {
+      if (argc < i + 1) {
+        lf_print_error("--trace-sample needs an integer argument.");
+        usage(argc, argv);
+        return 0;
+      }
+      const char* sample_spec = argv[i++];
+      int period = atoi(sample_spec);
+      if (period <= 0) {
+        lf_print_error("Invalid value for --trace-sample: %s", sample_spec);
+        usage(argc, argv);
+        return 0;
+      }
+      _lf_trace_set_sample_period(period);
+    }
+#endif
 #ifdef FEDERATED
     else if (strcmp(arg, "-i") == 0 || strcmp(arg, "--id") == 0) {
       if (argc < i + 1) {
@@ -1022,6 +1886,19 @@ int process_args(int argc, const char* argv[]) {
         usage(argc, argv);
         return 0;
       }
+    } else if (strcmp(arg, "--pin-listeners") == 0) {
+      if (argc < i + 1) {
+        lf_print_error("--pin-listeners needs a list of CPUs.");
+        usage(argc, argv);
+        return 0;
+      }
+      const char* cpus = argv[i++];
+      if (cpus[0] == '\0' || strspn(cpus, "0123456789,") != strlen(cpus)) {
+        lf_print_error("Invalid value for --pin-listeners: %s", cpus);
+        usage(argc, argv);
+        return 0;
+      }
+      lf_set_listener_pinning(cpus);
     }
 #endif
     else if (strcmp(arg, "--ros-args") == 0) {
@@ -1035,6 +1912,30 @@ int process_args(int argc, const char* argv[]) {
   return 1;
 }
 
+void _lf_lock_memory(void) {
+  if (_lf_memory_lock_budget == 0) {
+    return;
+  }
+#ifdef PLATFORM_Linux
+  if (lf_memory_lock(_lf_memory_lock_budget, _lf_huge_pages) != 0) {
+    lf_print_warning("Failed to lock %zu bytes of memory. Is RLIMIT_MEMLOCK large enough?", _lf_memory_lock_budget);
+    return;
+  }
+  _lf_startup_page_faults = 0;
+  LF_PRINT_LOG("Locked memory with a prefaulted heap of %zu bytes.", _lf_memory_lock_budget);
+#else
+  lf_print_warning("--lock-memory is not supported on this platform.");
+#endif
+}
+
+void _lf_memory_startup_complete(void) {
+#ifdef PLATFORM_Linux
+  if (_lf_startup_page_faults >= 0) {
+    _lf_startup_page_faults = lf_page_faults();
+  }
+#endif
+}
+
 /**
  * @brief Check that the provided version information is consistent with the
  * core runtime.
@@ -1087,13 +1988,23 @@ void initialize_global(void) {
   // -- threads are spawned to listen to upstream federates. Add 1 for the
   // clock sync thread and add 1 for the staa thread
   max_threads_tracing += NUMBER_OF_FEDERATES + 2;
+  LF_STARTUP_BEGIN(lf_startup_tracing);
   lf_tracing_global_init(envs[0].name, _LF_FEDERATE_NAMES_COMMA_SEPARATED, FEDERATE_ID, max_threads_tracing);
 #else
+  LF_STARTUP_BEGIN(lf_startup_tracing);
   lf_tracing_global_init("main", NULL, 0, max_threads_tracing);
 #endif
+  LF_STARTUP_END(lf_startup_tracing);
   // Call the code-generated function to initialize all actions, timers, and ports
   // This is done for all environments/enclaves at the same time.
+  LF_STARTUP_BEGIN(lf_startup_reactors);
   _lf_initialize_trigger_objects();
+  LF_STARTUP_END(lf_startup_reactors);
+#ifdef LF_METRICS
+  environment_t* metrics_envs;
+  int metrics_num_envs = _lf_get_environments(&metrics_envs);
+  lf_metrics_init(metrics_envs, metrics_num_envs);
+#endif
 }
 
 /**
@@ -1119,6 +2030,15 @@ void termination(void) {
   // Invoke the code generated termination function. It terminates the federated related services.
   // It should only be called for the top-level environment, which, by convention, is the first environment.
   lf_terminate_execution(env);
+#ifdef LF_RECORD_REPLAY
+  // Stop staging events of physical actions before the environments are torn down.
+  _lf_replay_terminate();
+#endif
+
+#if !defined(LF_SINGLE_THREADED)
+  // Stop the asynchronous work, whose results would be scheduled on actions of the environments.
+  _lf_async_work_terminate();
+#endif
 
   // In order to free tokens, we perform the same actions we would have for a new time step.
   for (int i = 0; i < num_envs; i++) {
@@ -1136,16 +2056,35 @@ void termination(void) {
     // Skip most cleanup on abnormal termination.
     if (_lf_normal_termination) {
       _lf_start_time_step(&env[i]);
+      LF_PRINT_LOG("---- Reset all is_present fields instead of the abbreviated list %d times.",
+                   env[i].is_present_fields_full_resets);
+      for (size_t j = 0; j < vector_size(&env[i].deadline_missed_reactions); j++) {
+        reaction_t* reaction = VECTOR_GET(&env[i].deadline_missed_reactions, j, reaction_t*);
+        // Reaction names are only set if logging is enabled.
+        lf_print_warning("---- Reaction %s missed its deadline %zu times.",
+                         reaction->name != NULL ? reaction->name : "(unnamed)", reaction->deadline_misses);
+      }
+#ifdef LF_REACTION_PROFILE
+      lf_reaction_profile_print(&env[i]);
+#ifdef LF_REACTION_PROFILE_WRITE
+      char profile_path[strlen(env[i].name) + sizeof("_profile.csv")];
+      snprintf(profile_path, sizeof(profile_path), "%s_profile.csv", env[i].name);
+      lf_reaction_profile_write(&env[i], profile_path);
+#endif
+#endif
+#ifdef LF_LATENCY
+      lf_latency_print(&env[i]);
+#endif
 
 #ifdef MODAL_REACTORS
       // Free events and tokens suspended by modal reactors.
       _lf_terminate_modal_reactors(&env[i]);
 #endif
       // If the event queue still has events on it, report that.
-      if (env[i].event_q != NULL && pqueue_tag_size(env[i].event_q) > 0) {
+      if (env[i].event_q != NULL && _lf_peek_next_event(&env[i]) != NULL) {
         lf_print_warning("---- There are %zu unprocessed future events on the event queue.",
-                         pqueue_tag_size(env[i].event_q));
-        event_t* event = (event_t*)pqueue_tag_peek(env[i].event_q);
+                         pqueue_tag_size(env[i].event_q) + vector_size(&env[i].next_microstep_events));
+        event_t* event = _lf_peek_next_event(&env[i]);
         lf_print_warning("---- The first future event has timestamp " PRINTF_TAG " after start tag.",
                          event->base.tag.time - start_time, event->base.tag.microstep);
       }
@@ -1166,19 +2105,59 @@ void termination(void) {
       }
     }
   }
+#ifdef PLATFORM_Linux
+  if (_lf_startup_page_faults > 0) {
+    long page_faults = lf_page_faults() - _lf_startup_page_faults;
+    if (page_faults > 0) {
+      lf_print_warning("---- %ld page faults after startup. Memory was allocated beyond the budget of --lock-memory.",
+                       page_faults);
+    }
+  }
+#endif
+#ifdef LF_ARENA_PLACEMENT
+  if (_lf_normal_termination) {
+    _lf_arena_placement_write(env, num_envs);
+  }
+#endif
+#ifdef LF_LOCK_PROFILE
+  lf_lock_profile_print();
+#endif
+#ifdef LF_MEMORY_ACCOUNTING
+  _lf_memory_print();
+#endif
+#ifdef LF_USER_METRICS
+  lf_user_metrics_print();
+#endif
   lf_tracing_global_shutdown();
+#ifdef LF_METRICS
+  lf_metrics_free();
+#endif
+#ifdef LF_DVFS
+  lf_dvfs_terminate();
+#endif
   // Skip most cleanup on abnormal termination.
   if (_lf_normal_termination) {
+    size_t token_hits, token_misses;
+    _lf_get_token_recycling_stats(&token_hits, &token_misses);
+    LF_PRINT_LOG("Token recycling: %zu allocations served from the recycling bins, %zu new allocations.", token_hits,
+                 token_misses);
+#if defined(LF_FAST_EXIT) && defined(NDEBUG)
+    // The process is about to exit, which reclaims all of its memory at once.
+    LF_PRINT_LOG("Fast exit: leaving the tokens, reactors and environments to process teardown.");
+    return;
+#endif
     _lf_free_all_tokens(); // Must be done before freeing reactors.
 #if !defined NDEBUG
     // Issue a warning if a memory leak has been detected.
-    if (_lf_count_payload_allocations > 0) {
+    int unfreed_tokens, unfreed_payloads;
+    _lf_get_unfreed_allocations(&unfreed_tokens, &unfreed_payloads);
+    if (unfreed_payloads > 0) {
       lf_print_warning("Memory allocated for messages has not been freed.");
-      lf_print_warning("Number of unfreed messages: %d.", _lf_count_payload_allocations);
+      lf_print_warning("Number of unfreed messages: %d.", unfreed_payloads);
     }
-    if (_lf_count_token_allocations > 0) {
+    if (unfreed_tokens > 0) {
       lf_print_warning("Memory allocated for tokens has not been freed!");
-      lf_print_warning("Number of unfreed tokens: %d.", _lf_count_token_allocations);
+      lf_print_warning("Number of unfreed tokens: %d.", unfreed_tokens);
     }
 #endif
 #if !defined(LF_SINGLE_THREADED)
@@ -1188,6 +2167,16 @@ void termination(void) {
       }
     }
 #endif
+    // The sparse records are allocated with the reactors.
+    for (int i = 0; i < num_envs; i++) {
+      vector_t* record_sizes = &env[i].sparse_io_record_sizes;
+      for (size_t j = 0; record_sizes->start != NULL && j < vector_size(record_sizes); j++) {
+        int* record_size = VECTOR_GET(record_sizes, j, int*);
+        if (record_size != NULL) {
+          lf_sparse_io_record_free((lf_sparse_io_record_t*)record_size);
+        }
+      }
+    }
     lf_free_all_reactors();
 
     // Free up memory associated with environment.
@@ -0,0 +1,273 @@
+/**
+ * @file
+ * @brief Recording of the events of physical actions and their deterministic replay.
+ *
+ * See replay.h.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+#include "lf_token.h"
+#include "clock.h"
+#include "low_level_platform.h"
+#include "reactor_common.h"
+#include "util.h"
+
+/** The first field of a log ("LFR1"). */
+#define REPLAY_MAGIC 0x3152464c
+
+/** The length of a logged event that has no token. */
+#define REPLAY_NO_TOKEN UINT64_MAX
+
+/** @brief A reactor registered with _lf_replay_register_reactor(). */
+typedef struct replay_reactor_t {
+  self_base_t* self;
+  size_t self_size;
+  uint32_t index; // The order of registration.
+} replay_reactor_t;
+
+/** @brief An event in the log, which is followed by `length * element_size` bytes of payload. */
+typedef struct replay_event_t {
+  uint32_t reactor;      // The registration index of the reactor of the action.
+  uint32_t offset;       // The offset of the action in the self struct of the reactor.
+  int64_t time;          // The physical time at which the event was staged, relative to the start time.
+  int64_t extra_delay;   // The extra delay of the event.
+  uint64_t length;       // The length of the token, or REPLAY_NO_TOKEN.
+  uint64_t element_size; // The size of an element of the payload.
+} replay_event_t;
+
+/** The state of the recording or the replay. */
+static struct {
+  replay_reactor_t* reactors; // The registered reactors, in the order of registration.
+  replay_reactor_t** sorted;  // The registered reactors, in the order of the addresses of their self structs.
+  size_t num_reactors;
+  size_t capacity;
+  lf_mutex_t mutex;      // Protects `file`, `terminate` and `warned_not_plain`.
+  lf_cond_t changed;     // Signaled at termination.
+  FILE* file;            // The log, or NULL if it is closed.
+  lf_thread_t thread;    // The thread that stages the logged events.
+  bool started;          // Whether _lf_replay_start() has been called.
+  bool replaying;        // Whether the replay thread has been started.
+  bool terminate;        // Whether the replay thread should terminate.
+  bool warned_not_plain; // Whether an event with a payload that is not plain data has been reported.
+} replay;
+
+void _lf_replay_register_reactor(self_base_t* self, size_t self_size) {
+  if (replay.num_reactors == replay.capacity) {
+    replay.capacity = replay.capacity == 0 ? 16 : 2 * replay.capacity;
+    replay.reactors = (replay_reactor_t*)realloc(replay.reactors, replay.capacity * sizeof(replay_reactor_t));
+    LF_ASSERT_NON_NULL(replay.reactors);
+  }
+  replay.reactors[replay.num_reactors] =
+      (replay_reactor_t){.self = self, .self_size = self_size, .index = (uint32_t)replay.num_reactors};
+  replay.num_reactors++;
+}
+
+static int compare_reactors(const void* a, const void* b) {
+  uintptr_t x = (uintptr_t)(*(replay_reactor_t* const*)a)->self;
+  uintptr_t y = (uintptr_t)(*(replay_reactor_t* const*)b)->self;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Return the registered reactor whose self struct contains the action, or NULL if there is none.
+ * @param action The action.
+ */
+static replay_reactor_t* find_reactor(lf_action_base_t* action) {
+  uintptr_t address = (uintptr_t)action;
+  size_t low = 0;
+  size_t high = replay.num_reactors;
+  // Find the last self struct that starts at or before the action.
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    if ((uintptr_t)replay.sorted[middle]->self <= address) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low == 0) {
+    return NULL;
+  }
+  replay_reactor_t* reactor = replay.sorted[low - 1];
+  uintptr_t start = (uintptr_t)reactor->self;
+  return address + sizeof(lf_action_base_t) <= start + reactor->self_size ? reactor : NULL;
+}
+
+void _lf_replay_record(lf_action_base_t* action, instant_t time, interval_t extra_delay, lf_token_t* token) {
+  if (_lf_replay_record_file == NULL || !replay.started) {
+    return;
+  }
+  size_t payload_size = token != NULL && token->value != NULL ? token->length * token->type->element_size : 0;
+  LF_MUTEX_LOCK(&replay.mutex);
+  // The log is closed at termination or after a failed write, which stops the recording.
+  replay_reactor_t* reactor = replay.file != NULL ? find_reactor(action) : NULL;
+  if (reactor == NULL) {
+    if (replay.file != NULL) {
+      lf_print_warning("Record: a physical action is not in a reactor created with lf_new_reactor(). Not recorded.");
+    }
+  } else if (payload_size > 0 && (token->type->destructor != NULL || token->type->copy_constructor != NULL)) {
+    if (!replay.warned_not_plain) {
+      lf_print_warning("Record: the payload of a physical action is not plain data. Such events are not recorded.");
+      replay.warned_not_plain = true;
+    }
+  } else {
+    replay_event_t event = {.reactor = reactor->index,
+                            .offset = (uint32_t)((uintptr_t)action - (uintptr_t)reactor->self),
+                            .time = time - lf_time_start(),
+                            .extra_delay = extra_delay,
+                            .length = token != NULL ? (token->value != NULL ? token->length : 0) : REPLAY_NO_TOKEN,
+                            .element_size = token != NULL ? token->type->element_size : 0};
+    if (fwrite(&event, sizeof(event), 1, replay.file) != 1 ||
+        (payload_size > 0 && fwrite(token->value, payload_size, 1, replay.file) != 1)) {
+      lf_print_error("Record: failed to write to %s. Recording stops.", _lf_replay_record_file);
+      fclose(replay.file);
+      replay.file = NULL;
+    }
+  }
+  LF_MUTEX_UNLOCK(&replay.mutex);
+}
+
+/**
+ * @brief Return the physical action of a logged event, or exit if the log does not match the program.
+ * @param event The logged event.
+ */
+static lf_action_base_t* logged_action(const replay_event_t* event) {
+  if (event->reactor >= replay.num_reactors) {
+    lf_print_error_and_exit("Replay: %s refers to reactor %u, but only %zu were created.", _lf_replay_file,
+                            event->reactor, replay.num_reactors);
+  }
+  replay_reactor_t* reactor = &replay.reactors[event->reactor];
+  if ((size_t)event->offset + sizeof(lf_action_base_t) > reactor->self_size) {
+    lf_print_error_and_exit("Replay: %s does not match the program.", _lf_replay_file);
+  }
+  lf_action_base_t* action = (lf_action_base_t*)((char*)reactor->self + event->offset);
+  if (action->parent != reactor->self || action->trigger == NULL || !action->trigger->is_physical) {
+    lf_print_error_and_exit("Replay: %s does not match the program.", _lf_replay_file);
+  }
+  if (event->length != REPLAY_NO_TOKEN && event->length > 0 &&
+      event->element_size != ((token_template_t*)action)->type.element_size) {
+    lf_print_error_and_exit("Replay: %s has a payload of another type than its action.", _lf_replay_file);
+  }
+  return action;
+}
+
+/**
+ * @brief Stage the logged events in the order of the log.
+ *
+ * Unless the program runs with `-f`, wait until physical time reaches the time of each event
+ * before staging it, or until termination is requested.
+ */
+static void stage_logged_events(void) {
+  instant_t start = lf_time_start();
+  replay_event_t event;
+  size_t count = 0;
+  while (fread(&event, sizeof(event), 1, replay.file) == 1) {
+    lf_action_base_t* action = logged_action(&event);
+    instant_t time = start + event.time;
+    LF_MUTEX_LOCK(&replay.mutex);
+    while (!fast && !replay.terminate && lf_time_physical() < time) {
+      lf_clock_cond_timedwait(&replay.changed, time);
+    }
+    bool terminate = replay.terminate;
+    LF_MUTEX_UNLOCK(&replay.mutex);
+    if (terminate) {
+      break;
+    }
+    lf_token_t* token = NULL;
+    if (event.length != REPLAY_NO_TOKEN) {
+      token_template_t* template = (token_template_t*)action;
+      size_t payload_size = (size_t)(event.length * event.element_size);
+      token = _lf_new_token_with_payload(&template->type, payload_size);
+      token->length = (size_t)event.length;
+      if (payload_size > 0 && fread(token->value, payload_size, 1, replay.file) != 1) {
+        lf_print_error_and_exit("Replay: %s is truncated.", _lf_replay_file);
+      }
+    }
+    _lf_ingress_push_at(action->parent->environment, action->trigger, event.extra_delay, token, time);
+    count++;
+  }
+  LF_PRINT_LOG("Replay: staged %zu events from %s.", count, _lf_replay_file);
+}
+
+/**
+ * @brief Thread function of the thread that stages the logged events at their pace.
+ * @param arg Ignored.
+ * @return NULL
+ */
+static void* replay_main(void* arg) {
+  (void)arg;
+  initialize_lf_thread_id();
+  stage_logged_events();
+  return NULL;
+}
+
+void _lf_replay_start(void) {
+  if (replay.started || (_lf_replay_record_file == NULL && _lf_replay_file == NULL)) {
+    return;
+  }
+  if (_lf_replay_record_file != NULL && _lf_replay_file != NULL) {
+    lf_print_error_and_exit("--record and --replay cannot be given together.");
+  }
+  replay.sorted = (replay_reactor_t**)malloc((replay.num_reactors + 1) * sizeof(replay_reactor_t*));
+  LF_ASSERT_NON_NULL(replay.sorted);
+  for (size_t i = 0; i < replay.num_reactors; i++) {
+    replay.sorted[i] = &replay.reactors[i];
+  }
+  qsort(replay.sorted, replay.num_reactors, sizeof(replay_reactor_t*), compare_reactors);
+  LF_MUTEX_INIT(&replay.mutex);
+  LF_COND_INIT(&replay.changed, &replay.mutex);
+  uint32_t magic = REPLAY_MAGIC;
+  if (_lf_replay_record_file != NULL) {
+    replay.file = fopen(_lf_replay_record_file, "wb");
+    if (replay.file == NULL || fwrite(&magic, sizeof(magic), 1, replay.file) != 1) {
+      lf_print_error_and_exit("Failed to create the log %s.", _lf_replay_record_file);
+    }
+  } else {
+    replay.file = fopen(_lf_replay_file, "rb");
+    if (replay.file == NULL || fread(&magic, sizeof(magic), 1, replay.file) != 1 || magic != REPLAY_MAGIC) {
+      lf_print_error_and_exit("%s is not a log of physical actions.", _lf_replay_file);
+    }
+  }
+  replay.started = true;
+  if (_lf_replay_file != NULL && fast) {
+    // Logical time does not wait for physical time, so the events must be staged before the
+    // first tag is processed lest the program advance past them.
+    stage_logged_events();
+  } else if (_lf_replay_file != NULL) {
+    replay.replaying = true;
+    int ret = lf_thread_create(&replay.thread, replay_main, NULL);
+    LF_ASSERTN(ret, "Could not create the replay thread");
+  }
+}
+
+void _lf_replay_terminate(void) {
+  if (replay.started) {
+    if (replay.replaying) {
+      LF_MUTEX_LOCK(&replay.mutex);
+      replay.terminate = true;
+      LF_COND_SIGNAL(&replay.changed);
+      LF_MUTEX_UNLOCK(&replay.mutex);
+      void* thread_ret;
+      lf_thread_join(replay.thread, &thread_ret);
+      replay.replaying = false;
+    }
+    LF_MUTEX_LOCK(&replay.mutex);
+    if (replay.file != NULL) {
+      fclose(replay.file);
+      replay.file = NULL;
+    }
+    LF_MUTEX_UNLOCK(&replay.mutex);
+  }
+  // Recording stops when the log is closed, so nothing looks up the reactors any more.
+  free(replay.sorted);
+  replay.sorted = NULL;
+  free(replay.reactors);
+  replay.reactors = NULL;
+  replay.num_reactors = 0;
+  replay.capacity = 0;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file
+ * @brief A report of the time spent in each phase of the startup of the program.
+ *
+ * See startup_report.h. Phases are only begun and ended by the main thread, so no lock is needed.
+ */
+
+#include "startup_report.h"
+#include "low_level_platform.h"
+#include "util.h"
+
+/** The deepest that phases are nested. */
+#define MAX_NESTED_PHASES 8
+
+/** The names of the phases in the report. */
+static const char* phase_names[lf_startup_num_phases] = {"environments", "reactors", "connections", "scheduler",
+                                                         "tracing",      "federation", "start tag", "workers"};
+
+/** The time spent in each phase, excluding the phases nested in it. */
+static interval_t phase_times[lf_startup_num_phases];
+
+/** Whether each phase has begun at least once. */
+static bool phase_measured[lf_startup_num_phases];
+
+/** The phases that have begun and not ended, innermost last. */
+static lf_startup_phase_t nested[MAX_NESTED_PHASES];
+static int depth = 0;
+
+/** When the innermost phase began or the phase nested in it ended. */
+static instant_t since = NEVER;
+
+/** When the first phase began. */
+static instant_t first = NEVER;
+
+/** Whether the report has been printed. */
+static bool reported = false;
+
+/** @brief Charge the time since `since` to the innermost phase and return the current time. */
+static instant_t charge(void) {
+  instant_t now = lf_time_physical();
+  if (depth > 0) {
+    phase_times[nested[depth - 1]] += now - since;
+  }
+  since = now;
+  return now;
+}
+
+void lf_startup_begin(lf_startup_phase_t phase) {
+  instant_t now = charge();
+  if (first == NEVER) {
+    first = now;
+  }
+  LF_ASSERT(depth < MAX_NESTED_PHASES, "Startup phases are nested too deeply.");
+  nested[depth++] = phase;
+  phase_measured[phase] = true;
+}
+
+void lf_startup_end(lf_startup_phase_t phase) {
+  LF_ASSERT(depth > 0 && nested[depth - 1] == phase, "Startup phase %s ends out of order.", phase_names[phase]);
+  (void)phase;
+  charge();
+  depth--;
+}
+
+void lf_startup_report(void) {
+  if (reported || first == NEVER) {
+    return;
+  }
+  reported = true;
+  lf_print("---- Startup took %lld usec:", (long long)((lf_time_physical() - first) / USEC(1)));
+  for (int i = 0; i < lf_startup_num_phases; i++) {
+    if (phase_measured[i]) {
+      lf_print("---- %s: %lld usec", phase_names[i], (long long)(phase_times[i] / USEC(1)));
+    }
+  }
+}
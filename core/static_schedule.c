@@ -0,0 +1,266 @@
+/**
+ * @file
+ * @brief Precomputed schedule of the periodic timers of an environment.
+ *
+ * See static_schedule.h.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "static_schedule.h"
+#include "reactor_common.h"
+#include "tracepoint.h"
+#include "util.h"
+
+/** The timers that fire at one time within the hyperperiod. */
+typedef struct {
+  interval_t offset;       // Time of the slot relative to the start of the hyperperiod.
+  size_t first_timer;      // Index in `timers` of the first timer of the slot.
+  size_t number_of_timers; // Number of timers of the slot.
+} static_slot_t;
+
+struct lf_static_schedule_t {
+  instant_t start_time;        // Logical time at which the timers were initialized.
+  instant_t hyperperiod_start; // Start of the current hyperperiod.
+  interval_t hyperperiod;      // Least common multiple of the periods of the timers.
+  static_slot_t* slots;        // Slots sorted by offset.
+  size_t number_of_slots;      // Number of slots.
+  size_t next_slot;            // Index of the slot that `event` stands for.
+  trigger_t** timers;          // The timers of all slots, slot by slot.
+  event_t* event;              // The event on the event queue that stands for the next slot.
+};
+
+/** A single firing of a timer, used while building the schedule. */
+typedef struct {
+  interval_t offset;
+  int index; // Index of the timer in the timers of the environment.
+  trigger_t* timer;
+} static_firing_t;
+
+static int static_firing_compare(const void* a, const void* b) {
+  const static_firing_t* x = (const static_firing_t*)a;
+  const static_firing_t* y = (const static_firing_t*)b;
+  if (x->offset != y->offset) {
+    return (x->offset > y->offset) ? 1 : -1;
+  }
+  return x->index - y->index;
+}
+
+static interval_t gcd(interval_t a, interval_t b) {
+  while (b != 0) {
+    interval_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/**
+ * @brief Return the hyperperiod of the periodic timers of the environment and set
+ * `firings` to their number of firings in a hyperperiod, or return 0 if the
+ * hyperperiod would have more than LF_STATIC_SCHEDULE_MAX_FIRINGS firings.
+ */
+static interval_t static_schedule_hyperperiod(environment_t* env, size_t* firings) {
+  interval_t hyperperiod = 0;
+  for (int i = 0; i < env->timer_triggers_size; i++) {
+    trigger_t* timer = env->timer_triggers[i];
+    if (timer == NULL || timer->period <= 0) {
+      continue;
+    }
+    if (hyperperiod == 0) {
+      hyperperiod = timer->period;
+      continue;
+    }
+    interval_t factor = timer->period / gcd(hyperperiod, timer->period);
+    // A factor this large means too many firings of the timers seen so far.
+    if (factor > LF_STATIC_SCHEDULE_MAX_FIRINGS || hyperperiod > FOREVER / factor) {
+      return 0;
+    }
+    hyperperiod *= factor;
+  }
+  *firings = 0;
+  for (int i = 0; hyperperiod > 0 && i < env->timer_triggers_size; i++) {
+    trigger_t* timer = env->timer_triggers[i];
+    if (timer != NULL && timer->period > 0) {
+      *firings += (size_t)(hyperperiod / timer->period);
+      if (*firings > LF_STATIC_SCHEDULE_MAX_FIRINGS) {
+        return 0;
+      }
+    }
+  }
+  return hyperperiod;
+}
+
+/**
+ * @brief Trigger the reactions of the timers of the slot that have started by the current tag.
+ */
+static void static_schedule_fire_slot(environment_t* env, struct lf_static_schedule_t* schedule, size_t slot) {
+  static_slot_t* s = &schedule->slots[slot];
+  for (size_t i = s->first_timer; i < s->first_timer + s->number_of_timers; i++) {
+    trigger_t* timer = schedule->timers[i];
+    // A timer with an offset larger than its period does not fire in the first hyperperiods.
+    if (env->current_tag.time < schedule->start_time + timer->offset) {
+      continue;
+    }
+    for (int j = 0; j < timer->number_of_reactions; j++) {
+      reaction_t* reaction = timer->reactions[j];
+      // Do not enqueue this reaction twice.
+      if (reaction->status == inactive) {
+        LF_PRINT_DEBUG("Triggering reaction %s from the static schedule.", reaction->name);
+        _lf_trigger_reaction(env, reaction, -1);
+      }
+    }
+    timer->status = present;
+    tracepoint_schedule(env, timer, timer->period); // Trace even though schedule is not called.
+  }
+}
+
+/**
+ * @brief Put the event of the schedule on the event queue at the time of the next slot.
+ */
+static void static_schedule_advance(environment_t* env, struct lf_static_schedule_t* schedule) {
+  schedule->next_slot++;
+  if (schedule->next_slot == schedule->number_of_slots) {
+    schedule->next_slot = 0;
+    schedule->hyperperiod_start += schedule->hyperperiod;
+  }
+  instant_t time = schedule->hyperperiod_start + schedule->slots[schedule->next_slot].offset;
+  schedule->event->base.tag = (tag_t){.time = time, .microstep = 0};
+  pqueue_tag_insert(env->event_q, (pqueue_tag_element_t*)schedule->event);
+}
+
+/**
+ * @brief Return the firings of the periodic timers of the environment in a hyperperiod,
+ * sorted by offset, in memory that the caller frees, and set `hyperperiod` and `number_of_firings`.
+ * Return NULL if there is no static schedule for the timers.
+ */
+static static_firing_t* static_schedule_firings(environment_t* env, interval_t* hyperperiod,
+                                                size_t* number_of_firings) {
+  *number_of_firings = 0;
+#ifdef MODAL_REACTORS
+  // Timers in inactive modes are suspended, which the schedule does not take into account.
+  return NULL;
+#endif
+  *hyperperiod = static_schedule_hyperperiod(env, number_of_firings);
+  if (*hyperperiod == 0) {
+    if (*number_of_firings > 0) {
+      LF_PRINT_LOG("Timers have too many firings per hyperperiod for a static schedule.");
+    }
+    return NULL;
+  }
+
+  static_firing_t* firings = (static_firing_t*)malloc(*number_of_firings * sizeof(static_firing_t));
+  LF_ASSERT_NON_NULL(firings);
+  size_t n = 0;
+  for (int i = 0; i < env->timer_triggers_size; i++) {
+    trigger_t* timer = env->timer_triggers[i];
+    if (timer == NULL || timer->period <= 0) {
+      continue;
+    }
+    for (interval_t offset = timer->offset % timer->period; offset < *hyperperiod; offset += timer->period) {
+      firings[n++] = (static_firing_t){.offset = offset, .index = i, .timer = timer};
+    }
+  }
+  assert(n == *number_of_firings);
+  // Timers that fire in the same slot keep their order, so that behavior is reproducible.
+  qsort(firings, n, sizeof(static_firing_t), static_firing_compare);
+  return firings;
+}
+
+void lf_static_schedule_init(environment_t* env) {
+  assert(env != GLOBAL_ENVIRONMENT);
+  env->static_schedule = NULL;
+  interval_t hyperperiod = 0;
+  size_t n = 0;
+  static_firing_t* firings = static_schedule_firings(env, &hyperperiod, &n);
+  if (firings == NULL) {
+    return;
+  }
+
+  struct lf_static_schedule_t* schedule = (struct lf_static_schedule_t*)calloc(1, sizeof(struct lf_static_schedule_t));
+  LF_ASSERT_NON_NULL(schedule);
+  schedule->timers = (trigger_t**)malloc(n * sizeof(trigger_t*));
+  schedule->slots = (static_slot_t*)malloc(n * sizeof(static_slot_t));
+  LF_ASSERT_NON_NULL(schedule->timers);
+  LF_ASSERT_NON_NULL(schedule->slots);
+  for (size_t i = 0; i < n; i++) {
+    schedule->timers[i] = firings[i].timer;
+    if (schedule->number_of_slots == 0 || schedule->slots[schedule->number_of_slots - 1].offset != firings[i].offset) {
+      schedule->slots[schedule->number_of_slots++] =
+          (static_slot_t){.offset = firings[i].offset, .first_timer = i, .number_of_timers = 0};
+    }
+    schedule->slots[schedule->number_of_slots - 1].number_of_timers++;
+  }
+  free(firings);
+
+  schedule->hyperperiod = hyperperiod;
+  schedule->start_time = lf_time_logical(env);
+  schedule->hyperperiod_start = schedule->start_time;
+  schedule->event = lf_get_new_event(env);
+  schedule->event->trigger = NULL;
+  schedule->event->token = NULL;
+  env->static_schedule = schedule;
+  LF_PRINT_LOG("Static schedule with %zu slots for %zu timer firings per hyperperiod of " PRINTF_TIME ".",
+               schedule->number_of_slots, n, hyperperiod);
+
+  // NOTE: No lock is being held. Assuming this only happens at startup.
+  if (schedule->slots[0].offset == 0) {
+    // Timers with no offset fire at the start tag.
+    static_schedule_fire_slot(env, schedule, 0);
+  } else {
+    // Make the first slot the next one.
+    schedule->next_slot = schedule->number_of_slots - 1;
+    schedule->hyperperiod_start -= hyperperiod;
+  }
+  static_schedule_advance(env, schedule);
+}
+
+interval_t* lf_static_schedule_offsets(environment_t* env, interval_t* hyperperiod, size_t* number_of_offsets) {
+  *number_of_offsets = 0;
+  size_t n;
+  static_firing_t* firings = static_schedule_firings(env, hyperperiod, &n);
+  if (firings == NULL) {
+    bool periodic = false;
+    for (int i = 0; i < env->timer_triggers_size; i++) {
+      periodic = periodic || (env->timer_triggers[i] != NULL && env->timer_triggers[i]->period > 0);
+    }
+    *hyperperiod = periodic ? -1 : 0;
+    return NULL;
+  }
+  interval_t* offsets = (interval_t*)malloc(n * sizeof(interval_t));
+  LF_ASSERT_NON_NULL(offsets);
+  for (size_t i = 0; i < n; i++) {
+    if (*number_of_offsets == 0 || offsets[*number_of_offsets - 1] != firings[i].offset) {
+      offsets[(*number_of_offsets)++] = firings[i].offset;
+    }
+  }
+  free(firings);
+  return offsets;
+}
+
+bool lf_static_schedule_covers(environment_t* env, trigger_t* timer) {
+  return env->static_schedule != NULL && timer->period > 0;
+}
+
+bool lf_static_schedule_handle_event(environment_t* env, event_t* event) {
+  struct lf_static_schedule_t* schedule = env->static_schedule;
+  if (schedule == NULL || event != schedule->event) {
+    return false;
+  }
+  static_schedule_fire_slot(env, schedule, schedule->next_slot);
+  static_schedule_advance(env, schedule);
+  return true;
+}
+
+void lf_static_schedule_free(environment_t* env) {
+  struct lf_static_schedule_t* schedule = env->static_schedule;
+  if (schedule == NULL) {
+    return;
+  }
+  // The event belongs to the events of the environment, which are freed with it.
+  free(schedule->slots);
+  free(schedule->timers);
+  free(schedule);
+  env->static_schedule = NULL;
+}
@@ -21,6 +21,9 @@
 #include "util.h"
 #include "lf_types.h"
 #include "clock.h"
+#ifdef LF_TAG_PIPELINING
+#include "pipeline.h"
+#endif
 
 /**
  * An enum for specifying the desired tag when calling "lf_time"
@@ -32,88 +35,30 @@ typedef enum _lf_time_type { LF_LOGICAL, LF_PHYSICAL, LF_ELAPSED_LOGICAL, LF_ELA
 // Global variables declared in tag.h:
 instant_t start_time = NEVER;
 
+#ifdef LF_TAG_PIPELINING
+// Declared in pipeline.h.
+thread_local tag_t _lf_pipeline_reaction_tag = NEVER_TAG_INITIALIZER;
+#endif
+
 ////////////////  Functions declared in tag.h
 
 tag_t lf_tag(void* env) {
   assert(env != GLOBAL_ENVIRONMENT);
+#ifdef LF_TAG_PIPELINING
+  // A reaction executed ahead sees the tag that it executes at.
+  return lf_pipeline_tag((environment_t*)env);
+#else
   return ((environment_t*)env)->current_tag;
+#endif
 }
 
-instant_t lf_time_add(instant_t a, interval_t b) {
-  if (a == NEVER || b == NEVER) {
-    return NEVER;
-  }
-  if (a == FOREVER || b == FOREVER) {
-    return FOREVER;
-  }
-  instant_t res = a + b;
-  // Check for overflow
-  if (res < a && b > 0) {
-    return FOREVER;
-  }
-  // Check for underflow
-  if (res > a && b < 0) {
-    return NEVER;
-  }
-  return res;
-}
+instant_t lf_time_add(instant_t a, interval_t b) { return _lf_time_add(a, b); }
 
-tag_t lf_tag_add(tag_t a, tag_t b) {
-  instant_t res = lf_time_add(a.time, b.time);
-  if (res == FOREVER) {
-    return FOREVER_TAG;
-  }
-  if (res == NEVER) {
-    return NEVER_TAG;
-  }
+tag_t lf_tag_add(tag_t a, tag_t b) { return _lf_tag_add(a, b); }
 
-  if (b.time > 0) {
-    // NOTE: The reason for handling this case is to "reset" the microstep counter at each after delay.
-    a.microstep = 0; // Ignore microstep of first arg if time of second is > 0.
-  }
-  tag_t result = {.time = res, .microstep = a.microstep + b.microstep};
+int lf_tag_compare(tag_t tag1, tag_t tag2) { return _lf_tag_compare(tag1, tag2); }
 
-  // If microsteps overflows
-  // FIXME: What should be the resulting tag in case of microstep overflow.
-  //  see https://github.com/lf-lang/reactor-c/issues/430
-  if (result.microstep < a.microstep) {
-    return FOREVER_TAG;
-  }
-  return result;
-}
-
-int lf_tag_compare(tag_t tag1, tag_t tag2) {
-  if (tag1.time < tag2.time) {
-    return -1;
-  } else if (tag1.time > tag2.time) {
-    return 1;
-  } else if (tag1.microstep < tag2.microstep) {
-    return -1;
-  } else if (tag1.microstep > tag2.microstep) {
-    return 1;
-  } else {
-    return 0;
-  }
-}
-
-tag_t lf_delay_tag(tag_t tag, interval_t interval) {
-  if (tag.time == NEVER || interval < 0LL)
-    return tag;
-  // Note that overflow in C is undefined for signed variables.
-  if (tag.time >= FOREVER - interval)
-    return FOREVER_TAG; // Overflow.
-  tag_t result = tag;
-  if (interval == 0LL) {
-    // Note that unsigned variables will wrap on overflow.
-    // This is probably the only reasonable thing to do with overflowing
-    // microsteps.
-    result.microstep++;
-  } else {
-    result.time += interval;
-    result.microstep = 0;
-  }
-  return result;
-}
+tag_t lf_delay_tag(tag_t tag, interval_t interval) { return _lf_delay_tag(tag, interval); }
 
 tag_t lf_delay_strict(tag_t tag, interval_t interval) {
   tag_t result = lf_delay_tag(tag, interval);
@@ -126,7 +71,11 @@ tag_t lf_delay_strict(tag_t tag, interval_t interval) {
 
 instant_t lf_time_logical(void* env) {
   assert(env != GLOBAL_ENVIRONMENT);
+#ifdef LF_TAG_PIPELINING
+  return lf_pipeline_tag((environment_t*)env).time;
+#else
   return ((environment_t*)env)->current_tag.time;
+#endif
 }
 
 interval_t lf_time_logical_elapsed(void* env) { return lf_time_logical(env) - start_time; }
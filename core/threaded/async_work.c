@@ -0,0 +1,154 @@
+/**
+ * @file
+ * @copyright (c) 2024, The University of California at Berkeley.
+ * License: <a href="https://github.com/lf-lang/reactor-c/blob/main/LICENSE.md">BSD 2-clause</a>
+ * @brief Definitions for work that reactions start and that finishes in a reaction to a physical action.
+ *
+ * The work of all environments waits in one queue, in the order in which it was started, for the
+ * threads of one pool. A thread is started when work arrives while there are fewer idle threads
+ * than waiting work, up to LF_ASYNC_WORKERS threads, which then stay until termination.
+ * The result of the work is scheduled without the mutex of the pool, which is never taken while a
+ * mutex of an environment is held, so the two never wait for each other.
+ */
+
+#include <stdlib.h>
+#include "async_work.h"
+#include "api/schedule.h"
+#include "low_level_platform.h"
+#include "util.h"
+
+#ifndef LF_ASYNC_WORKERS
+#define LF_ASYNC_WORKERS 4
+#endif
+
+/** @brief Work that has been started with lf_async_start() and is waiting for a thread. */
+typedef struct async_job_t {
+  struct async_job_t* next;
+  lf_action_base_t* action;
+  lf_async_work_t work;
+  void* arg;
+} async_job_t;
+
+/** The state of the pool of threads that does the work. */
+static struct {
+  lf_mutex_t mutex;                        // Protects the fields below.
+  lf_cond_t arrived;                       // Signaled when work arrives and broadcast at termination.
+  async_job_t* head;                       // The first waiting work, or NULL.
+  async_job_t* tail;                       // The last waiting work.
+  int queued;                              // The number of waiting work items.
+  int idle;                                // The number of threads waiting for work.
+  int started;                             // The number of threads started.
+  lf_thread_t threads[LF_ASYNC_WORKERS];   // The threads.
+  bool initialized;                        // Whether the mutex has been initialized.
+  bool terminate;                          // Whether the threads should terminate.
+} pool;
+
+/**
+ * @brief Thread function of the threads of the pool.
+ * Each thread takes the first waiting work, does it, and schedules its result on its action,
+ * unless the program is terminating, until termination is requested.
+ * @param arg Ignored.
+ * @return NULL
+ */
+static void* async_worker(void* arg) {
+  (void)arg;
+  initialize_lf_thread_id();
+  LF_MUTEX_LOCK(&pool.mutex);
+  while (true) {
+    while (pool.head == NULL && !pool.terminate) {
+      pool.idle++;
+      LF_COND_WAIT(&pool.arrived);
+      pool.idle--;
+    }
+    if (pool.terminate) {
+      break;
+    }
+    async_job_t* job = pool.head;
+    pool.head = job->next;
+    pool.queued--;
+    LF_MUTEX_UNLOCK(&pool.mutex);
+
+    void* result = job->work(job->arg);
+
+    LF_MUTEX_LOCK(&pool.mutex);
+    bool terminating = pool.terminate;
+    LF_MUTEX_UNLOCK(&pool.mutex);
+    // Termination joins this thread, so the environment is not freed while this schedules.
+    if (terminating) {
+      free(result);
+    } else if (result == NULL) {
+      lf_schedule(job->action, 0);
+    } else {
+      lf_schedule_value(job->action, 0, result, 1);
+    }
+    free(job);
+    LF_MUTEX_LOCK(&pool.mutex);
+  }
+  LF_MUTEX_UNLOCK(&pool.mutex);
+  return NULL;
+}
+
+void _lf_async_work_initialize(void) {
+  if (!pool.initialized) {
+    LF_MUTEX_INIT(&pool.mutex);
+    LF_COND_INIT(&pool.arrived, &pool.mutex);
+    pool.initialized = true;
+  }
+}
+
+int lf_async_start(void* action, lf_async_work_t work, void* arg) {
+  lf_action_base_t* base = (lf_action_base_t*)action;
+  if (!base->trigger->is_physical) {
+    lf_print_error("lf_async_start: the action is not physical.");
+    return -1;
+  }
+  async_job_t* job = (async_job_t*)malloc(sizeof(async_job_t));
+  LF_ASSERT_NON_NULL(job);
+  *job = (async_job_t){.next = NULL, .action = base, .work = work, .arg = arg};
+
+  LF_MUTEX_LOCK(&pool.mutex);
+  if (pool.terminate) {
+    LF_MUTEX_UNLOCK(&pool.mutex);
+    free(job);
+    return -1;
+  }
+  if (pool.head == NULL) {
+    pool.head = job;
+  } else {
+    pool.tail->next = job;
+  }
+  pool.tail = job;
+  pool.queued++;
+  if (pool.queued > pool.idle && pool.started < LF_ASYNC_WORKERS &&
+      lf_thread_create(&pool.threads[pool.started], async_worker, NULL) == 0) {
+    pool.started++;
+  } else {
+    LF_COND_SIGNAL(&pool.arrived);
+  }
+  LF_MUTEX_UNLOCK(&pool.mutex);
+  return 0;
+}
+
+void _lf_async_work_terminate(void) {
+  if (!pool.initialized) {
+    return;
+  }
+  LF_MUTEX_LOCK(&pool.mutex);
+  pool.terminate = true;
+  if (pool.queued > 0) {
+    lf_print_warning("Dropping %d items of asynchronous work that did not start before termination.", pool.queued);
+  }
+  while (pool.head != NULL) {
+    async_job_t* job = pool.head;
+    pool.head = job->next;
+    free(job);
+  }
+  pool.queued = 0;
+  LF_COND_BROADCAST(&pool.arrived);
+  LF_MUTEX_UNLOCK(&pool.mutex);
+  for (int i = 0; i < pool.started; i++) {
+    void* thread_ret;
+    lf_thread_join(pool.threads[i], &thread_ret);
+  }
+  pool.started = 0;
+}
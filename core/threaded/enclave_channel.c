@@ -0,0 +1,116 @@
+/**
+ * @file
+ * @brief Channels that carry messages between environments.
+ *
+ * See enclave_channel.h. The producer appends a message and then increments `pending`.
+ * The consumer moves the number of messages that it reads from `pending` and then
+ * subtracts that number, repeating until `pending` is 0. Hence, if the producer finds
+ * `pending` to be 0, the consumer may have missed the message and must be notified;
+ * otherwise, the consumer will move the message before it next waits.
+ */
+
+#include <stdlib.h>
+#include "enclave_channel.h"
+#include "reactor_common.h"
+#include "rti_local.h"
+#include "util.h"
+
+lf_enclave_channel_t* lf_enclave_channel_create(environment_t* source, environment_t* destination,
+                                                trigger_t* trigger, size_t capacity) {
+  lf_enclave_channel_t* channel = (lf_enclave_channel_t*)calloc(1, sizeof(lf_enclave_channel_t));
+  LF_ASSERT_NON_NULL(channel);
+  channel->capacity = 1;
+  while (channel->capacity < capacity) {
+    channel->capacity <<= 1;
+  }
+  channel->messages = (lf_enclave_message_t*)calloc(channel->capacity, sizeof(lf_enclave_message_t));
+  LF_ASSERT_NON_NULL(channel->messages);
+  channel->source = source;
+  channel->destination = destination;
+  channel->trigger = trigger;
+  channel->next = destination->enclave_channels;
+  destination->enclave_channels = channel;
+  return channel;
+}
+
+/**
+ * Move the messages on the specified channel to the event queue of its destination, whose
+ * mutex must be held.
+ */
+static void drain_locked(lf_enclave_channel_t* channel) {
+  int32_t count = lf_atomic_fetch_add32(&channel->pending, 0);
+  while (count > 0) {
+    for (int32_t i = 0; i < count; i++) {
+      lf_enclave_message_t* message = &channel->messages[(channel->head + i) & (channel->capacity - 1)];
+      _lf_schedule_at_tag(channel->destination, channel->trigger, message->tag, message->token);
+      // The event now holds its own reference.
+      _lf_done_using(message->token);
+    }
+    // Hand the slots back to the producer.
+    lf_atomic_fetch_add64(&channel->head, count);
+    count = lf_atomic_add_fetch32(&channel->pending, -count);
+  }
+}
+
+/**
+ * Send a message on the specified channel, whose reference to the token has already been taken.
+ */
+static void send_referenced(lf_enclave_channel_t* channel, tag_t tag, lf_token_t* token) {
+  environment_t* destination = channel->destination;
+  if (channel->tail - lf_atomic_load64(&channel->head) == (int64_t)channel->capacity) {
+    // The ring is full. Move its messages, and this one, to the event queue.
+    LF_MUTEX_LOCK(&destination->mutex);
+    drain_locked(channel);
+    _lf_schedule_at_tag(destination, channel->trigger, tag, token);
+    _lf_done_using(token);
+    lf_notify_of_event(destination);
+    LF_MUTEX_UNLOCK(&destination->mutex);
+    return;
+  }
+  lf_enclave_message_t* message = &channel->messages[channel->tail & (channel->capacity - 1)];
+  message->tag = tag;
+  message->token = token;
+  channel->tail++;
+  if (lf_atomic_fetch_add32(&channel->pending, 1) == 0) {
+    // The destination may be waiting for an event, and may have reported a later next event tag.
+    LF_MUTEX_LOCK(&destination->mutex);
+#if defined(LF_ENCLAVES)
+    rti_update_other_net_locked(channel->source->enclave_info, destination->enclave_info, tag);
+#endif
+    lf_notify_of_event(destination);
+    LF_MUTEX_UNLOCK(&destination->mutex);
+  }
+}
+
+void lf_enclave_channel_send(lf_enclave_channel_t* channel, tag_t tag, lf_token_t* token) {
+  if (token != NULL) {
+    _lf_token_add_reference(token);
+  }
+  send_referenced(channel, tag, token);
+}
+
+void lf_enclave_channel_broadcast(lf_enclave_channel_t** channels, size_t count, tag_t tag, lf_token_t* token) {
+  // One atomic step takes the references of all channels, which release them independently.
+  lf_token_broadcast(token, count);
+  for (size_t i = 0; i < count; i++) {
+    send_referenced(channels[i], tag, token);
+  }
+}
+
+void _lf_enclave_channels_drain_locked(environment_t* env) {
+  for (lf_enclave_channel_t* channel = env->enclave_channels; channel != NULL; channel = channel->next) {
+    drain_locked(channel);
+  }
+}
+
+void _lf_enclave_channels_free(environment_t* env) {
+  while (env->enclave_channels != NULL) {
+    lf_enclave_channel_t* channel = env->enclave_channels;
+    env->enclave_channels = channel->next;
+    for (int64_t i = channel->head; i < channel->tail; i++) {
+      _lf_done_using(channel->messages[i & (channel->capacity - 1)].token);
+    }
+    free(channel->messages);
+    free(channel);
+  }
+}
@@ -0,0 +1,278 @@
+/**
+ * @file
+ * @brief Overlap of consecutive tags in reactors that do not depend on each other.
+ *
+ * See pipeline.h.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "pipeline.h"
+#include "low_level_platform.h"
+#include "reactor_common.h"
+#include "reactor_threaded.h"
+#include "lf_token.h"
+#include "util.h"
+
+/** Return the components of the environment, which are created when they are first needed. */
+static lf_pipeline_t* _lf_pipeline_of(environment_t* env) {
+  if (env->pipeline == NULL) {
+    lf_pipeline_t* pipeline = (lf_pipeline_t*)calloc(1, sizeof(lf_pipeline_t));
+    LF_ASSERT_NON_NULL(pipeline);
+    pipeline->found = vector_new(64);
+    pipeline->frontier = vector_new(16);
+    pipeline->next_tag = NEVER_TAG;
+    pipeline->tag = NEVER_TAG;
+    env->pipeline = pipeline;
+  }
+  return env->pipeline;
+}
+
+/**
+ * Return the root of the component of a reactor, and make the reactors on the way point to it.
+ * Once all reactions are explored, the reactors of the reactions point to their root, so this
+ * only reads them.
+ */
+static self_base_t* _lf_pipeline_root(self_base_t* reactor) {
+  self_base_t* root = reactor;
+  while (root->pipeline_parent != NULL) {
+    root = root->pipeline_parent;
+  }
+  while (reactor != root) {
+    self_base_t* parent = reactor->pipeline_parent;
+    if (parent != root) {
+      reactor->pipeline_parent = root;
+    }
+    reactor = parent;
+  }
+  return root;
+}
+
+/** Put two reactors in the same component. */
+static void _lf_pipeline_join(self_base_t* reactor, self_base_t* other) {
+  self_base_t* root = _lf_pipeline_root(reactor);
+  self_base_t* other_root = _lf_pipeline_root(other);
+  if (root != other_root) {
+    root->pipeline_parent = other_root;
+  }
+}
+
+/** Return whether the component of a reactor lags, that is, has reactions queued at the current tag. */
+static bool _lf_pipeline_lags(lf_pipeline_t* pipeline, self_base_t* reactor) {
+  return _lf_pipeline_root(reactor)->pipeline_lag == pipeline->epoch;
+}
+
+/** Return the reactor that provides data to the port of the specified is_present field. */
+static self_base_t* _lf_pipeline_port_source(bool* is_present) {
+  return ((lf_port_base_t*)((char*)is_present - offsetof(lf_port_base_t, is_present)))->source_reactor;
+}
+
+/** Add a reaction to the ones to explore, unless it has been already. */
+static void _lf_pipeline_visit(lf_pipeline_t* pipeline, reaction_t* reaction) {
+  if (!reaction->pipeline_explored) {
+    reaction->pipeline_explored = true;
+    pipeline->explored++;
+    vector_push(&pipeline->found, reaction);
+    vector_push(&pipeline->frontier, reaction);
+  }
+}
+
+/** Join the reactor of a reaction with that of a downstream reaction, which is then explored. */
+static void _lf_pipeline_follow(lf_pipeline_t* pipeline, reaction_t* reaction, reaction_t* downstream) {
+  _lf_pipeline_join((self_base_t*)reaction->self, (self_base_t*)downstream->self);
+  _lf_pipeline_visit(pipeline, downstream);
+}
+
+/** Explore the reactions to explore and the reactions that they may trigger. */
+static void _lf_pipeline_explore(lf_pipeline_t* pipeline) {
+  reaction_t* reaction;
+  while ((reaction = (reaction_t*)vector_pop(&pipeline->frontier)) != NULL) {
+    for (size_t i = 0; i < reaction->num_outputs; i++) {
+      if (reaction->output_produced[i] != NULL) {
+        self_base_t* source = _lf_pipeline_port_source(reaction->output_produced[i]);
+        if (source != NULL) {
+          _lf_pipeline_join((self_base_t*)reaction->self, source);
+        }
+      }
+      if (reaction->triggers == NULL) {
+        continue;
+      }
+      for (int j = 0; j < reaction->triggered_sizes[i]; j++) {
+        trigger_t* trigger = reaction->triggers[i][j];
+        for (int k = 0; trigger != NULL && k < trigger->number_of_reactions; k++) {
+          _lf_pipeline_follow(pipeline, reaction, trigger->reactions[k]);
+        }
+      }
+    }
+    // With LF_STATIC_TOPOLOGY, only the table of the downstream reactions may be given.
+    if (reaction->triggers == NULL && reaction->fanout != NULL) {
+      const lf_fanout_t* fanout = reaction->fanout;
+      for (int k = fanout->offsets[0]; k < fanout->offsets[reaction->num_outputs]; k++) {
+        _lf_pipeline_follow(pipeline, reaction, fanout->reactions[k]);
+      }
+    }
+  }
+}
+
+/** Visit the reactions of a trigger and of the timers grouped with it. */
+static void _lf_pipeline_visit_trigger(lf_pipeline_t* pipeline, trigger_t* trigger) {
+  for (; trigger != NULL; trigger = trigger->next_in_timer_group) {
+    for (int i = 0; i < trigger->number_of_reactions; i++) {
+      _lf_pipeline_visit(pipeline, trigger->reactions[i]);
+    }
+  }
+}
+
+/**
+ * Return whether all the reactions of the environment have been explored, after exploring those
+ * that are not triggered by events, the first time.
+ */
+static bool _lf_pipeline_complete(environment_t* env, lf_pipeline_t* pipeline) {
+  if (pipeline->complete) {
+    return true;
+  }
+  if (!pipeline->seeded) {
+    pipeline->seeded = true;
+    reaction_t** lists[] = {env->startup_reactions, env->shutdown_reactions, env->reset_reactions};
+    int sizes[] = {env->startup_reactions_size, env->shutdown_reactions_size, env->reset_reactions_size};
+    for (int l = 0; l < 3; l++) {
+      for (int i = 0; i < sizes[l]; i++) {
+        _lf_pipeline_visit(pipeline, lists[l][i]);
+      }
+    }
+    for (int i = 0; i < env->timer_triggers_size; i++) {
+      _lf_pipeline_visit_trigger(pipeline, env->timer_triggers[i]);
+    }
+    _lf_pipeline_explore(pipeline);
+  }
+  if (pipeline->reactions == 0 || pipeline->explored < pipeline->reactions) {
+    return false;
+  }
+  // Make the reactors of the reactions point to their root, which the workers then only read.
+  for (size_t i = 0; i < vector_size(&pipeline->found); i++) {
+    _lf_pipeline_root((self_base_t*)VECTOR_GET(&pipeline->found, i, reaction_t*)->self);
+  }
+  pipeline->complete = true;
+  LF_PRINT_LOG("Environment %d: All %zu reactions are explored, so tags can be overlapped.", env->id,
+               pipeline->reactions);
+  return true;
+}
+
+/** Reset the present ports of the components that do not lag, and return the number of the others. */
+static int _lf_pipeline_reset_ports(lf_pipeline_t* pipeline, bool** fields, int size) {
+  int kept = 0;
+  for (int i = 0; i < size; i++) {
+    if (_lf_pipeline_lags(pipeline, _lf_pipeline_port_source(fields[i]))) {
+      fields[kept++] = fields[i];
+    } else {
+      *fields[i] = false;
+    }
+  }
+  return kept;
+}
+
+void lf_pipeline_init(environment_t* env, size_t reactions) { _lf_pipeline_of(env)->reactions = reactions; }
+
+void lf_pipeline_free(environment_t* env) {
+  lf_pipeline_t* pipeline = env->pipeline;
+  if (pipeline == NULL) {
+    return;
+  }
+  LF_PRINT_LOG("Environment %d: Overlapped %zu tags.", env->id, pipeline->overlapped);
+  vector_free(&pipeline->found);
+  vector_free(&pipeline->frontier);
+  free(pipeline);
+  env->pipeline = NULL;
+}
+
+void lf_pipeline_add_reaction(environment_t* env, reaction_t* reaction) {
+  lf_pipeline_t* pipeline = _lf_pipeline_of(env);
+  _lf_pipeline_visit(pipeline, reaction);
+  _lf_pipeline_explore(pipeline);
+}
+
+void lf_pipeline_depend(self_base_t* reactor, self_base_t* other) { _lf_pipeline_join(reactor, other); }
+
+void _lf_pipeline_explore_trigger_locked(environment_t* env, trigger_t* trigger) {
+  lf_pipeline_t* pipeline = _lf_pipeline_of(env);
+  if (!pipeline->complete) {
+    _lf_pipeline_visit_trigger(pipeline, trigger);
+    _lf_pipeline_explore(pipeline);
+  }
+}
+
+bool _lf_pipeline_begin_locked(environment_t* env) {
+  lf_pipeline_t* pipeline = env->pipeline;
+  if (pipeline == NULL || lf_tag_compare(pipeline->tag, env->current_tag) > 0 ||
+      !_lf_pipeline_complete(env, pipeline) || env->watchdogs_size > 0 ||
+      vector_size(&env->sparse_io_record_sizes) > 0 ||
+      env->is_present_fields_abbreviated_size > env->is_present_fields_size || env->barrier.requestors > 0) {
+    return false;
+  }
+  tag_t next_tag = get_next_event_tag(env);
+  if (next_tag.time == FOREVER || lf_tag_compare(next_tag, env->stop_tag) >= 0 ||
+      (!fast && lf_time_physical() < next_tag.time)) {
+    return false;
+  }
+  pipeline->next_tag = next_tag;
+  pipeline->epoch++;
+  return true;
+}
+
+void _lf_pipeline_lag(environment_t* env, reaction_t* reaction) {
+  _lf_pipeline_root((self_base_t*)reaction->self)->pipeline_lag = env->pipeline->epoch;
+}
+
+bool _lf_pipeline_event_is_ahead(environment_t* env, event_t* event) {
+  // Dummy events and events that trigger no reaction are left to the ordinary advancement of the tag.
+  bool triggers = false;
+  for (trigger_t* trigger = event->trigger; trigger != NULL; trigger = trigger->next_in_timer_group) {
+    for (int i = 0; i < trigger->number_of_reactions; i++) {
+      if (_lf_pipeline_lags(env->pipeline, (self_base_t*)trigger->reactions[i]->self)) {
+        return false;
+      }
+      triggers = true;
+    }
+  }
+  return triggers;
+}
+
+bool _lf_pipeline_start_locked(environment_t* env) {
+  lf_pipeline_t* pipeline = env->pipeline;
+  // Timers that fire are rescheduled from the next tag.
+  _lf_pipeline_reaction_tag = pipeline->next_tag;
+  size_t popped = _lf_pop_events_ahead(env, pipeline->next_tag);
+  _lf_pipeline_reaction_tag = NEVER_TAG;
+  if (popped == 0) {
+    return false;
+  }
+  pipeline->tag = pipeline->next_tag;
+  pipeline->overlap = true;
+  pipeline->overlapped++;
+  // The ports of the lagging components are reset when the current tag is complete.
+  env->is_present_fields_abbreviated_size =
+      _lf_pipeline_reset_ports(pipeline, env->is_present_fields_abbreviated, env->is_present_fields_abbreviated_size);
+  for (int w = 0; w < env->num_workers; w++) {
+    lf_present_list_t* list = &env->worker_present_fields[w];
+    list->size = _lf_pipeline_reset_ports(pipeline, list->fields, list->size);
+  }
+  LF_PRINT_DEBUG("Environment %d: Started tag " PRINTF_TAG " ahead with %zu events.", env->id,
+                 pipeline->tag.time - lf_time_start(), pipeline->tag.microstep, popped);
+  return true;
+}
+
+void _lf_pipeline_tag_completed_locked(environment_t* env) {
+  if (env->pipeline != NULL) {
+    env->pipeline->overlap = false;
+  }
+}
+
+void _lf_pipeline_reaction_starts(environment_t* env, reaction_t* reaction) {
+  lf_pipeline_t* pipeline = env->pipeline;
+  if (pipeline != NULL && pipeline->overlap && !_lf_pipeline_lags(pipeline, (self_base_t*)reaction->self)) {
+    _lf_pipeline_reaction_tag = pipeline->tag;
+  }
+}
+
+void _lf_pipeline_reaction_ends(void) { _lf_pipeline_reaction_tag = NEVER_TAG; }
@@ -27,10 +27,25 @@
 #include "rti_local.h"
 #include "reactor_common.h"
 #include "watchdog.h"
+#include "async_work.h"
+#include "enclave_channel.h"
+#include "startup_report.h"
 
 #ifdef FEDERATED
 #include "federate.h"
 #endif
+#ifdef LF_CHECKPOINT
+#include "checkpoint.h"
+#endif
+#ifdef LF_RECORD_REPLAY
+#include "replay.h"
+#endif
+#ifdef LF_DVFS
+#include "dvfs.h"
+#endif
+#ifdef LF_TAG_PIPELINING
+#include "pipeline.h"
+#endif
 
 // Global variables defined in tag.c and shared across environments:
 extern instant_t start_time;
@@ -159,7 +174,7 @@ int _lf_wait_on_tag_barrier(environment_t* env, tag_t proposed_tag) {
     result = 1;
     LF_PRINT_LOG("Waiting on barrier for tag " PRINTF_TAG ".", proposed_tag.time - start_time, proposed_tag.microstep);
     // Wait until no requestor remains for the barrier on logical time
-    lf_cond_wait(&env->global_tag_barrier_requestors_reached_zero);
+    LF_COND_WAIT(&env->global_tag_barrier_requestors_reached_zero);
 
     // The stop tag may have changed during the wait.
     if (lf_is_tag_after_stop_tag(env, proposed_tag)) {
@@ -171,25 +186,45 @@ int _lf_wait_on_tag_barrier(environment_t* env, tag_t proposed_tag) {
   return result;
 }
 
+/**
+ * The environment and number of the worker that runs on the calling thread, or NULL and -1
+ * if the thread is not a worker. Ports are set present on the list of the worker.
+ */
+static thread_local environment_t* _lf_worker_env = NULL;
+static thread_local int _lf_worker_number = -1;
+
 void lf_set_present(lf_port_base_t* port) {
   if (!port->source_reactor)
     return;
   environment_t* env = port->source_reactor->environment;
   bool* is_present_field = &port->is_present;
-  int ipfas = lf_atomic_fetch_add32(&env->is_present_fields_abbreviated_size, 1);
-  if (ipfas < env->is_present_fields_size) {
-    env->is_present_fields_abbreviated[ipfas] = is_present_field;
+  // A port that is already present is already on an abbreviated list. Reactions that
+  // can write to the same port never execute in parallel, so this check is not racy.
+  if (!*is_present_field) {
+    if (env == _lf_worker_env) {
+      // The list of this worker holds all is_present fields, so it does not overflow.
+      lf_present_list_t* list = &env->worker_present_fields[_lf_worker_number];
+      list->fields[list->size++] = is_present_field;
+    } else {
+      int ipfas = lf_atomic_fetch_add32(&env->is_present_fields_abbreviated_size, 1);
+      if (ipfas < env->is_present_fields_size) {
+        env->is_present_fields_abbreviated[ipfas] = is_present_field;
+      }
+    }
   }
   *is_present_field = true;
 
   // Support for sparse destination multiports.
+  if (port->sparse_record && port->destination_channel >= 0) {
+    lf_sparse_io_record_set_present(port->sparse_record, (size_t)port->destination_channel);
+  }
   if (port->sparse_record && port->destination_channel >= 0 && port->sparse_record->size >= 0) {
     size_t next = (size_t)lf_atomic_fetch_add32(&port->sparse_record->size, 1);
     if (next >= port->sparse_record->capacity) {
       // Buffer is full. Have to revert to the classic iteration.
       port->sparse_record->size = -1;
     } else {
-      port->sparse_record->present_channels[next] = port->destination_channel;
+      lf_sparse_io_record_channels(port->sparse_record)[next] = port->destination_channel;
     }
   }
 }
@@ -205,22 +240,25 @@ void lf_set_present(lf_port_base_t* port) {
  * return true even if the a new event was placed on the queue if that event
  * time matches or exceeds the specified time.
  *
- * The mutex lock associated with the condition argument is assumed to be held by
- * the calling thread. This mutex is released while waiting. If the wait time is
- * too small to actually wait (less than MIN_SLEEP_DURATION), then this function
+ * The mutex of the environment is assumed to be held by the calling thread.
+ * This mutex is released while waiting. If the wait time is too small to
+ * actually wait (less than MIN_SLEEP_DURATION), then this function
  * immediately returns true and the mutex is not released.
  *
+ * The wait is on the event_q_changed condition variable, except for the last
+ * spin_wait_threshold of the environment, during which the calling thread spins
+ * on the clock until the wait time is reached or _lf_notify_event_q_changed_locked
+ * is called (see lf_environment_set_spin_wait).
+ *
  * @param env Environment within which we are executing.
  * @param logical_time Logical time to wait until physical time matches it.
- * @param condition A condition variable that can interrupt the wait. The mutex
- * associated with this condition variable will be released during the wait.
  *
  * @return Return false if the wait is interrupted either because of an event
  *  queue signal or if the wait time was interrupted early by reaching
  *  the stop time, if one was specified. Return true if the full wait time
  *  was reached.
  */
-bool wait_until(instant_t logical_time, lf_cond_t* condition) {
+bool wait_until(environment_t* env, instant_t logical_time) {
   LF_PRINT_DEBUG("-------- Waiting until physical time matches logical time " PRINTF_TIME, logical_time);
   interval_t wait_until_time = logical_time;
 #ifdef FEDERATED_DECENTRALIZED // Only apply the STA if coordination is decentralized
@@ -242,26 +280,40 @@ bool wait_until(instant_t logical_time, lf_cond_t* condition) {
       return true;
     }
 
-    // We do the sleep on the cond var so we can be awakened by the
-    // asynchronous scheduling of a physical action. lf_clock_cond_timedwait
-    // returns 0 if it is awakened before the timeout. Hence, we want to run
-    // it repeatedly until either it returns non-zero or the current
-    // physical time matches or exceeds the logical time.
-    if (lf_clock_cond_timedwait(condition, wait_until_time) != LF_TIMEOUT) {
-      LF_PRINT_DEBUG("-------- wait_until interrupted before timeout.");
-
-      // Wait did not time out, which means that there
-      // may have been an asynchronous call to lf_schedule().
-      // Continue waiting.
-      // Do not adjust logical tag here. If there was an asynchronous
-      // call to lf_schedule(), it will have put an event on the event queue,
-      // and logical tag will be set to that time when that event is pulled.
-      return false;
-    } else {
-      // Reached timeout.
-      LF_PRINT_DEBUG("-------- Returned from wait, having waited " PRINTF_TIME " ns.", wait_duration);
-      return true;
+    lf_clock_set_timer_slack(env->timer_slack);
+    interval_t spin_wait_threshold = env->spin_wait_threshold;
+    if (wait_duration > spin_wait_threshold) {
+      // We do the sleep on the cond var so we can be awakened by the
+      // asynchronous scheduling of a physical action. lf_clock_cond_timedwait
+      // returns 0 if it is awakened before the timeout. Hence, we want to run
+      // it repeatedly until either it returns non-zero or the current
+      // physical time matches or exceeds the logical time.
+      // If spinning is enabled, the sleep ends spin_wait_threshold early.
+      if (lf_clock_cond_timedwait(&env->event_q_changed, wait_until_time - spin_wait_threshold) != LF_TIMEOUT) {
+        LF_PRINT_DEBUG("-------- wait_until interrupted before timeout.");
+
+        // Wait did not time out, which means that there
+        // may have been an asynchronous call to lf_schedule().
+        // Continue waiting.
+        // Do not adjust logical tag here. If there was an asynchronous
+        // call to lf_schedule(), it will have put an event on the event queue,
+        // and logical tag will be set to that time when that event is pulled.
+        return false;
+      }
+    }
+    if (spin_wait_threshold > 0) {
+      // Spin on the clock without holding the mutex, so that other threads can change the event queue.
+      int32_t changes = env->event_q_changes;
+      LF_MUTEX_UNLOCK(&env->mutex);
+      int result = lf_clock_spin_until(wait_until_time, &env->event_q_changes, changes);
+      LF_MUTEX_LOCK(&env->mutex);
+      if (result != 0) {
+        LF_PRINT_DEBUG("-------- wait_until interrupted while spinning.");
+        return false;
+      }
     }
+    // Reached timeout.
+    LF_PRINT_DEBUG("-------- Returned from wait, having waited " PRINTF_TIME " ns.", wait_duration);
   }
   return true;
 }
@@ -275,8 +327,13 @@ bool wait_until(instant_t logical_time, lf_cond_t* condition) {
 tag_t get_next_event_tag(environment_t* env) {
   assert(env != GLOBAL_ENVIRONMENT);
 
+  // Physical actions scheduled since the last call may have events that come first.
+  _lf_ingress_drain_locked(env);
+  // So may messages from other environments.
+  _lf_enclave_channels_drain_locked(env);
+
   // Peek at the earliest event in the event queue.
-  event_t* event = (event_t*)pqueue_tag_peek(env->event_q);
+  event_t* event = _lf_peek_next_event(env);
   tag_t next_tag = FOREVER_TAG;
   if (event != NULL) {
     // There is an event in the event queue.
@@ -348,6 +405,12 @@ tag_t send_next_event_tag(environment_t* env, tag_t tag, bool wait_for_reply) {
  */
 void _lf_next_locked(environment_t* env) {
   assert(env != GLOBAL_ENVIRONMENT);
+#ifdef LF_DVFS
+  lf_dvfs_tag_completed(env);
+#endif
+#ifdef LF_TAG_PIPELINING
+  _lf_pipeline_tag_completed_locked(env);
+#endif
 
 #ifdef MODAL_REACTORS
   // Perform mode transitions
@@ -404,13 +467,19 @@ void _lf_next_locked(environment_t* env) {
   // behavior with centralized coordination as with unfederated execution.
 
 #else // not FEDERATED_CENTRALIZED nor LF_ENCLAVES
-  if (pqueue_tag_peek(env->event_q) == NULL && !keepalive_specified) {
+  if (_lf_peek_next_event(env) == NULL && !keepalive_specified) {
     // There is no event on the event queue and keepalive is false.
     // No event in the queue
     // keepalive is not set so we should stop.
     // Note that federated programs with decentralized coordination always have
     // keepalive = true
+#ifdef LF_TAG_PIPELINING
+    // Some reactors may have started a later tag.
+    tag_t latest_tag = lf_pipeline_latest_tag(env);
+    lf_set_stop_tag(env, (tag_t){.time = latest_tag.time, .microstep = latest_tag.microstep + 1});
+#else
     lf_set_stop_tag(env, (tag_t){.time = env->current_tag.time, .microstep = env->current_tag.microstep + 1});
+#endif
 
     // Stop tag has changed. Need to check next_tag again.
     next_tag = get_next_event_tag(env);
@@ -421,7 +490,7 @@ void _lf_next_locked(environment_t* env) {
   // This can be interrupted if a physical action triggers (e.g., a message
   // arrives from an upstream federate or a local physical action triggers).
   LF_PRINT_LOG("Waiting until elapsed time " PRINTF_TIME ".", (next_tag.time - start_time));
-  while (!wait_until(next_tag.time, &env->event_q_changed)) {
+  while (!wait_until(env, next_tag.time)) {
     LF_PRINT_DEBUG("_lf_next_locked(): Wait until time interrupted.");
     // Sleep was interrupted.  Check for a new next_event.
     // The interruption could also have been due to a call to lf_request_stop().
@@ -431,6 +500,12 @@ void _lf_next_locked(environment_t* env) {
     if (lf_is_tag_after_stop_tag(env, next_tag)) {
       return;
     }
+#if defined(FEDERATED) && defined(LF_FEDERATED_OPTIMISTIC)
+    // A straggler arrived, for which execution rolls back before advancing.
+    if (lf_optimistic_rollback_pending_locked()) {
+      return;
+    }
+#endif
   }
   // A wait occurs even if wait_until() returns true, which means that the
   // tag on the head of the event queue may have changed.
@@ -495,23 +570,27 @@ void _lf_next_locked(environment_t* env) {
 }
 
 /**
- * @brief True if stop has been requested so it doesn't get re-requested.
+ * @brief Nonzero if stop has been requested so it doesn't get re-requested.
+ * It is set with an atomic compare-and-swap by lf_request_stop() and, in a federate,
+ * when the RTI requests a stop.
  */
-bool lf_stop_requested = false;
+int32_t lf_stop_requested = 0;
 
 // See reactor.h for docs.
 void lf_request_stop(void) {
   // If a requested stop is pending, return without doing anything.
   LF_PRINT_LOG("lf_request_stop() has been called.");
-  LF_MUTEX_LOCK(&global_mutex);
-  if (lf_stop_requested) {
-    LF_MUTEX_UNLOCK(&global_mutex);
+  if (!lf_atomic_bool_compare_and_swap32(&lf_stop_requested, 0, 1)) {
     LF_PRINT_LOG("Ignoring redundant lf_request_stop() call.");
     return;
   }
-  lf_stop_requested = true;
-  LF_MUTEX_UNLOCK(&global_mutex);
 
+#ifdef FEDERATED
+  // In the federated case, the RTI might grant a later stop tag than the current tag.
+  // The thread listening to the RTI blocks tag advancement in the enclaves and negotiates
+  // the stop tag, so that the caller does not wait on their mutexes or on the socket.
+  lf_hand_off_stop_request();
+#else
   // Iterate over scheduling enclaves to find their maximum current tag
   // and set a barrier for tag advancement for each enclave.
   tag_t max_current_tag = NEVER_TAG;
@@ -519,28 +598,20 @@ void lf_request_stop(void) {
   int num_environments = _lf_get_environments(&env);
   for (int i = 0; i < num_environments; i++) {
     LF_MUTEX_LOCK(&env[i].mutex);
-    if (lf_tag_compare(env[i].current_tag, max_current_tag) > 0) {
-      max_current_tag = env[i].current_tag;
+#ifdef LF_TAG_PIPELINING
+    // Reactions may execute at a later tag than the current one, which the stop follows.
+    tag_t current_tag = lf_pipeline_latest_tag(&env[i]);
+#else
+    tag_t current_tag = env[i].current_tag;
+#endif
+    if (lf_tag_compare(current_tag, max_current_tag) > 0) {
+      max_current_tag = current_tag;
     }
     // Set a barrier to prevent the enclave from advancing past the so-far maximum current tag.
     _lf_increment_tag_barrier_locked(&env[i], max_current_tag);
     LF_MUTEX_UNLOCK(&env[i].mutex);
   }
 
-#ifdef FEDERATED
-  // In the federated case, the RTI might grant a
-  // later stop tag than the current tag. The above code has raised
-  // a barrier no greater than max_current_tag.
-  if (lf_send_stop_request_to_rti(max_current_tag) != 0) {
-    // Message was not sent to the RTI.
-    // Decrement the barriers to reverse our previous increment.
-    for (int i = 0; i < num_environments; i++) {
-      LF_MUTEX_LOCK(&env[i].mutex);
-      _lf_decrement_tag_barrier_locked(&env[i]);
-      LF_MUTEX_UNLOCK(&env[i].mutex);
-    }
-  }
-#else
   // In a non-federated program, the stop_tag will be the next microstep after max_current_tag.
   // Iterate over environments to set their stop tag and release their barrier.
   for (int i = 0; i < num_environments; i++) {
@@ -552,7 +623,7 @@ void lf_request_stop(void) {
     // We signal instead of broadcast under the assumption that only
     // one worker thread can call wait_until at a given time because
     // the call to wait_until is protected by a mutex lock
-    lf_cond_signal(&env->event_q_changed);
+    _lf_notify_event_q_changed_locked(&env[i], false);
     LF_MUTEX_UNLOCK(&env[i].mutex);
   }
 #endif
@@ -574,6 +645,11 @@ void _lf_trigger_reaction(environment_t* env, reaction_t* reaction, int worker_n
 #endif
 }
 
+bool _lf_has_earlier_deadline(environment_t* env, reaction_t* reaction) {
+  assert(env != GLOBAL_ENVIRONMENT);
+  return lf_sched_has_earlier_deadline(env->scheduler, reaction);
+}
+
 /**
  * Perform the necessary operations before tag (0,0) can be processed.
  *
@@ -586,8 +662,16 @@ void _lf_trigger_reaction(environment_t* env, reaction_t* reaction, int worker_n
 void _lf_initialize_start_tag(environment_t* env) {
   assert(env != GLOBAL_ENVIRONMENT);
 
-  // Add reactions invoked at tag (0,0) (including startup reactions) to the reaction queue
-  _lf_trigger_startup_reactions(env);
+#ifdef LF_CHECKPOINT
+  bool restored = _lf_checkpoint_restore(env);
+#else
+  bool restored = false;
+#endif
+  // Add reactions invoked at tag (0,0) (including startup reactions) to the reaction queue,
+  // unless the program resumes from a checkpoint and has already started up.
+  if (!restored) {
+    _lf_trigger_startup_reactions(env);
+  }
 
 #if defined FEDERATED
   // If env is the environment for the top-level enclave, then initialize the federate.
@@ -642,7 +726,7 @@ void _lf_initialize_start_tag(environment_t* env) {
   // Here we wait until the start time and also release the environment mutex.
   // this means that the other worker threads will be allowed to start. We need
   // this to avoid potential deadlock in federated startup.
-  while (!wait_until(start_time, &env->event_q_changed)) {
+  while (!wait_until(env, start_time)) {
   };
   LF_PRINT_DEBUG("Done waiting for start time + STA offset " PRINTF_TIME ".", start_time + lf_fed_STA_offset);
   LF_PRINT_DEBUG("Physical time is ahead of current time by " PRINTF_TIME ". This should be close to the STA offset.",
@@ -667,7 +751,6 @@ void _lf_initialize_start_tag(environment_t* env) {
   // once the complete message has been read. Here, we wait for that barrier
   // to be removed, if appropriate before proceeding to executing tag (0,0).
   _lf_wait_on_tag_barrier(env, (tag_t){.time = start_time, .microstep = 0});
-  lf_spawn_staa_thread();
 
 #else  // NOT FEDERATED_DECENTRALIZED
   // Each federate executes the start tag (which is the current
@@ -680,7 +763,9 @@ void _lf_initialize_start_tag(environment_t* env) {
   _lf_pop_events(env);
 
 #else  // NOT FEDERATED
-  _lf_initialize_timers(env);
+  if (!restored) {
+    _lf_initialize_timers(env);
+  }
 
   // If the stop_tag is (0,0), also insert the shutdown
   // reactions. This can only happen if the timeout time
@@ -690,6 +775,11 @@ void _lf_initialize_start_tag(environment_t* env) {
   }
 #endif // NOT FEDERATED
 
+#ifdef LF_RECORD_REPLAY
+  // The times of the logged events of physical actions are relative to the start time, which is now known.
+  _lf_replay_start();
+#endif
+
   // Set the following boolean so that other thread(s), including federated threads,
   // know that the execution has started
   env->execution_started = true;
@@ -698,6 +788,35 @@ void _lf_initialize_start_tag(environment_t* env) {
 /** For logging and debugging, each worker thread is numbered. */
 int worker_thread_count = 0;
 
+/**
+ * The last reading of the physical clock by the worker that runs on the calling thread,
+ * and the tag of its environment at the time.
+ */
+static thread_local struct {
+  instant_t time;
+  tag_t tag;
+} _lf_worker_clock = {NEVER, NEVER_TAG_INITIALIZER};
+
+/**
+ * @brief Return the physical time for checking a deadline that expires at the specified time.
+ *
+ * If the worker read the clock at the current tag, and that reading leaves more than
+ * LF_DEADLINE_EXACT_SLACK before the deadline, return the reading without reading the
+ * clock again. Hence, a deadline may be found to be met if the reactions that the worker
+ * executed since the reading took longer than LF_DEADLINE_EXACT_SLACK.
+ * @param env The environment.
+ * @param deadline_time The physical time at which the deadline expires.
+ */
+static instant_t _lf_worker_physical_time(environment_t* env, instant_t deadline_time) {
+  if (LF_DEADLINE_EXACT_SLACK != FOREVER && lf_tag_compare(_lf_worker_clock.tag, env->current_tag) == 0 &&
+      deadline_time - _lf_worker_clock.time > LF_DEADLINE_EXACT_SLACK) {
+    return _lf_worker_clock.time;
+  }
+  _lf_worker_clock.time = lf_time_physical();
+  _lf_worker_clock.tag = env->current_tag;
+  return _lf_worker_clock.time;
+}
+
 /**
  * Handle deadline violation for 'reaction'.
  * The mutex should NOT be locked when this function is called. It might acquire
@@ -720,12 +839,12 @@ bool _lf_worker_handle_deadline_violation_for_reaction(environment_t* env, int w
   // same reaction at the current time value, even if at a future superdense time,
   // then the reaction will be invoked and the violation reaction will not be invoked again.
   if (reaction->deadline >= 0LL) {
-    // Get the current physical time.
-    instant_t physical_time = lf_time_physical();
     // Check for deadline violation.
-    if (reaction->deadline == 0 || physical_time > env->current_tag.time + reaction->deadline) {
+    instant_t deadline_time = lf_time_logical(env) + reaction->deadline;
+    if (reaction->deadline == 0 || _lf_worker_physical_time(env, deadline_time) > deadline_time) {
       // Deadline violation has occurred.
       tracepoint_reaction_deadline_missed(env, reaction, worker_number);
+      _lf_record_deadline_miss(env, reaction);
       violation_occurred = true;
       // Invoke the local handler, if there is one.
       tracepoint_reaction_starts(env, reaction, worker_number);
@@ -777,6 +896,7 @@ bool _lf_worker_handle_STP_violation_for_reaction(environment_t* env, int worker
   if (reaction->is_STP_violated == true && !reaction->is_an_input_reaction) {
     reaction_function_t handler = reaction->STP_handler;
     LF_PRINT_LOG("STP violation detected.");
+    tracepoint_dump();
 
     // Invoke the STP handler if there is one.
     if (handler != NULL) {
@@ -839,9 +959,46 @@ bool _lf_worker_handle_violations(environment_t* env, int worker_number, reactio
  * @param worker_number The ID of the worker.
  * @param reaction The reaction to invoke.
  */
+#if LF_DEADLINE_PRIORITIES
+/**
+ * The real-time priority of the worker that runs on the calling thread, or -1 if it does not
+ * follow the deadlines of the reactions.
+ */
+static thread_local int _lf_worker_priority = -1;
+
+/**
+ * @brief Set the priority of the calling worker for invoking the specified reaction.
+ * A reaction without a deadline gets the lowest priority. Otherwise, the priority is the highest
+ * one less one for each doubling of the slack, in microseconds, that the deadline leaves, but
+ * above that of the reactions without a deadline. The priority is only set if it changes.
+ * @param env The environment.
+ * @param reaction The reaction.
+ */
+static void _lf_worker_set_deadline_priority(environment_t* env, reaction_t* reaction) {
+  if (_lf_worker_priority < 0) {
+    return;
+  }
+  int priority = LF_SCHED_MIN_PRIORITY + 1;
+  if (reaction->deadline >= 0LL) {
+    // The deadline check has just read the clock, or found the last reading recent enough.
+    interval_t slack = lf_time_logical(env) + reaction->deadline - _lf_worker_clock.time;
+    priority = LF_SCHED_MAX_PRIORITY;
+    for (interval_t us = slack / USEC(1); us > 0 && priority > LF_SCHED_MIN_PRIORITY + 2; us >>= 1) {
+      priority--;
+    }
+  }
+  if (priority != _lf_worker_priority && lf_thread_set_priority(lf_thread_self(), priority) == 0) {
+    _lf_worker_priority = priority;
+  }
+}
+#endif // LF_DEADLINE_PRIORITIES
+
 void _lf_worker_invoke_reaction(environment_t* env, int worker_number, reaction_t* reaction) {
   LF_PRINT_LOG("Worker %d: Invoking reaction %s at elapsed tag " PRINTF_TAG ".", worker_number, reaction->name,
                env->current_tag.time - start_time, env->current_tag.microstep);
+#if LF_DEADLINE_PRIORITIES
+  _lf_worker_set_deadline_priority(env, reaction);
+#endif
   _lf_invoke_reaction(env, reaction, worker_number);
 
   // If the reaction produced outputs, put the resulting triggered
@@ -851,6 +1008,123 @@ void _lf_worker_invoke_reaction(environment_t* env, int worker_number, reaction_
   reaction->is_STP_violated = false;
 }
 
+#ifdef LF_BATCH_REACTIONS
+/**
+ * @brief Invoke the batch led by the given reaction with one call of its batch function.
+ *
+ * The reactions of the batch that have violations are handled on their own and left out of
+ * the call. Only the leader was handed to a worker by the scheduler, so the others are marked
+ * inactive here rather than by the scheduler.
+ * @param env Environment within which we are executing.
+ * @param worker_number The ID of the worker.
+ * @param leader The reaction that leads the batch.
+ */
+static void _lf_worker_execute_batch(environment_t* env, int worker_number, reaction_t* leader) {
+  reaction_t* members[LF_REACTION_BATCH_SIZE];
+  reaction_t* batch[LF_REACTION_BATCH_SIZE];
+  size_t num_members = 0;
+  size_t count = 0;
+  for (reaction_t* reaction = leader; reaction != NULL; reaction = reaction->next_in_batch) {
+    members[num_members++] = reaction;
+  }
+  for (size_t i = 0; i < num_members; i++) {
+    members[i]->next_in_batch = NULL;
+    if (!_lf_worker_handle_violations(env, worker_number, members[i])) {
+      batch[count++] = members[i];
+    }
+  }
+  if (count > 0) {
+    LF_PRINT_LOG("Worker %d: Invoking a batch of %zu reactions led by %s.", worker_number, count, leader->name);
+#if LF_DEADLINE_PRIORITIES
+    _lf_worker_set_deadline_priority(env, batch[0]);
+#endif
+    _lf_invoke_reaction_batch(env, batch, count, worker_number);
+    for (size_t i = 0; i < count; i++) {
+      schedule_output_reactions(env, batch[i], worker_number);
+      batch[i]->is_STP_violated = false;
+    }
+  }
+  for (size_t i = 1; i < num_members; i++) {
+    lf_atomic_bool_compare_and_swap32((int32_t*)&members[i]->status, queued, inactive);
+  }
+}
+#endif // LF_BATCH_REACTIONS
+
+/**
+ * @brief Handle violations of the reaction and, if there are none, invoke it.
+ * Then tell the scheduler that the worker is done with the reaction.
+ * @param env Environment within which we are executing.
+ * @param worker_number The ID of the worker.
+ * @param reaction The reaction, which the scheduler has handed to a worker.
+ */
+static void _lf_worker_execute_reaction(environment_t* env, int worker_number, reaction_t* reaction) {
+#ifdef LF_BATCH_REACTIONS
+  if (reaction->next_in_batch != NULL) {
+    _lf_worker_execute_batch(env, worker_number, reaction);
+    LF_PRINT_DEBUG("Worker %d: Done with the batch led by %s.", worker_number, reaction->name);
+    lf_sched_done_with_reaction(worker_number, reaction);
+    return;
+  }
+#endif
+#ifdef LF_TAG_PIPELINING
+  _lf_pipeline_reaction_starts(env, reaction);
+#endif
+  bool violation = _lf_worker_handle_violations(env, worker_number, reaction);
+
+  if (!violation) {
+    // Invoke the reaction function.
+    _lf_worker_invoke_reaction(env, worker_number, reaction);
+  }
+#ifdef LF_TAG_PIPELINING
+  _lf_pipeline_reaction_ends();
+#endif
+
+  LF_PRINT_DEBUG("Worker %d: Done with reaction %s.", worker_number, reaction->name);
+
+  lf_sched_done_with_reaction(worker_number, reaction);
+}
+
+#ifdef _PYTHON_TARGET_ENABLED
+/**
+ * @brief Execute the reaction on the worker of the environment that holds the GIL.
+ *
+ * Every reaction of the Python target acquires the GIL, so workers that execute reactions
+ * concurrently mostly hand the GIL back and forth. Instead, the first worker to get a reaction
+ * acquires the GIL and keeps it while it executes the reactions that the other workers get
+ * from the scheduler in the meantime, which they hand over to it rather than waiting for the
+ * GIL. The reaction functions then acquire the GIL without contention. The handed-over
+ * reactions are at the level being executed, because no scheduler advances the level while
+ * a worker is busy.
+ *
+ * @param env Environment within which we are executing.
+ * @param worker_number The ID of the worker.
+ * @param reaction The reaction, which the scheduler has handed to this worker.
+ */
+static void _lf_worker_execute_python_reaction(environment_t* env, int worker_number, reaction_t* reaction) {
+  LF_MUTEX_LOCK(&env->python_mutex);
+  if (env->python_worker_busy) {
+    LF_PRINT_DEBUG("Worker %d: Handing reaction %s to the worker that holds the GIL.", worker_number, reaction->name);
+    vector_push(&env->python_reactions, reaction);
+    LF_MUTEX_UNLOCK(&env->python_mutex);
+    return;
+  }
+  env->python_worker_busy = true;
+  LF_MUTEX_UNLOCK(&env->python_mutex);
+
+  int gil_state = _lf_python_gil_ensure();
+  while (reaction != NULL) {
+    _lf_worker_execute_reaction(env, worker_number, reaction);
+    LF_MUTEX_LOCK(&env->python_mutex);
+    reaction = (reaction_t*)vector_pop(&env->python_reactions);
+    if (reaction == NULL) {
+      env->python_worker_busy = false;
+    }
+    LF_MUTEX_UNLOCK(&env->python_mutex);
+  }
+  _lf_python_gil_release(gil_state);
+}
+#endif // _PYTHON_TARGET_ENABLED
+
 /**
  * @brief The main looping logic of each LF worker thread.
  *
@@ -881,17 +1155,98 @@ void _lf_worker_do_work(environment_t* env, int worker_number) {
                    worker_number, current_reaction_to_execute->name, LF_LEVEL(current_reaction_to_execute->index),
                    current_reaction_to_execute->is_an_input_reaction, current_reaction_to_execute->deadline);
 
-    bool violation = _lf_worker_handle_violations(env, worker_number, current_reaction_to_execute);
+#ifdef _PYTHON_TARGET_ENABLED
+    _lf_worker_execute_python_reaction(env, worker_number, current_reaction_to_execute);
+#else
+    _lf_worker_execute_reaction(env, worker_number, current_reaction_to_execute);
+#endif
+  }
+}
+
+#ifdef LF_SHARED_WORKERS
+/** Whether the workers of all environments have been started, so that each environment can lend reactions. */
+static volatile bool _lf_environments_started = false;
+#endif
 
-    if (!violation) {
-      // Invoke the reaction function.
-      _lf_worker_invoke_reaction(env, worker_number, current_reaction_to_execute);
+bool _lf_worker_execute_lent_reaction(environment_t* env) {
+#if defined(LF_SHARED_WORKERS) && !defined(_PYTHON_TARGET_ENABLED) && !defined(FEDERATED)
+  // The index of the environment that lent the last reaction to the calling thread.
+  static thread_local int _lf_worker_lender = 0;
+  if (!_lf_environments_started) {
+    return false;
+  }
+  environment_t* envs;
+  int num_envs = _lf_get_environments(&envs);
+  for (int i = 1; i <= num_envs; i++) {
+    int index = (_lf_worker_lender + i) % num_envs;
+    environment_t* lender = &envs[index];
+    if (lender == env) {
+      continue;
     }
+    reaction_t* reaction = lf_sched_lend_reaction(lender->scheduler);
+    if (reaction != NULL) {
+      _lf_worker_lender = index;
+      LF_PRINT_DEBUG("Environment %u: Executing reaction %s lent by environment %u.", env->id, reaction->name,
+                     lender->id);
+      // The worker has no number in the environment that lent the reaction.
+      _lf_worker_execute_reaction(lender, -1, reaction);
+      lf_sched_done_with_lent_reaction(lender->scheduler, reaction);
+      return true;
+    }
+  }
+#else
+  (void)env;
+#endif
+  return false;
+}
 
-    LF_PRINT_DEBUG("Worker %d: Done with reaction %s.", worker_number, current_reaction_to_execute->name);
-
-    lf_sched_done_with_reaction(worker_number, current_reaction_to_execute);
+/**
+ * @brief Return the CPU to which the given worker should be pinned, or -1 for no pinning.
+ *
+ * Workers are numbered globally, across all environments, so that the
+ * workers of different enclaves do not end up on the same CPUs.
+ * The policy is given by _lf_worker_pinning (see the --pin command-line argument).
+ * @param env The environment of the worker.
+ * @param worker_number The number of the worker within its environment.
+ */
+static int _lf_worker_cpu(environment_t* env, int worker_number) {
+  if (_lf_worker_pinning == NULL || strcmp(_lf_worker_pinning, "none") == 0) {
+    return -1;
+  }
+  environment_t* envs;
+  int num_envs = _lf_get_environments(&envs);
+  int index = worker_number;
+  int total = 0;
+  for (int i = 0; i < num_envs; i++) {
+    if (&envs[i] < env) {
+      index += envs[i].num_workers;
+    }
+    total += envs[i].num_workers;
+  }
+  int cores = lf_available_cores();
+  if (cores <= 0) {
+    return -1;
+  }
+  if (strcmp(_lf_worker_pinning, "compact") == 0) {
+    return index % cores;
+  } else if (strcmp(_lf_worker_pinning, "scatter") == 0) {
+    // Spread the workers out so that, when there are fewer workers than cores,
+    // they do not share caches or sockets with each other.
+    int stride = (total > 0 && cores / total > 1) ? cores / total : 1;
+    return (index * stride) % cores;
   }
+  // An explicit, comma-separated list of CPUs, assigned round robin.
+  int count = 1;
+  for (const char* c = _lf_worker_pinning; *c != '\0'; c++) {
+    if (*c == ',') {
+      count++;
+    }
+  }
+  const char* entry = _lf_worker_pinning;
+  for (int i = index % count; i > 0; i--) {
+    entry = strchr(entry, ',') + 1;
+  }
+  return atoi(entry);
 }
 
 /**
@@ -909,6 +1264,28 @@ void* worker(void* arg) {
 
   int worker_number = env->worker_thread_count++;
   LF_PRINT_LOG("Environment %u: Worker thread %d started.", env->id, worker_number);
+  _lf_worker_env = env;
+  _lf_worker_number = worker_number;
+
+  int cpu = _lf_worker_cpu(env, worker_number);
+  if (cpu >= 0) {
+    if (lf_thread_set_cpu(lf_thread_self(), (size_t)cpu) != 0) {
+      lf_print_warning("Environment %u: Failed to pin worker thread %d to CPU %d.", env->id, worker_number, cpu);
+    } else {
+      LF_PRINT_LOG("Environment %u: Worker thread %d pinned to CPU %d.", env->id, worker_number, cpu);
+    }
+  }
+
+#if LF_DEADLINE_PRIORITIES
+  lf_scheduling_policy_t policy = {.policy = LF_SCHED_PRIORITY, .priority = LF_SCHED_MIN_PRIORITY + 1};
+  if (lf_thread_set_scheduling_policy(lf_thread_self(), &policy) == 0) {
+    _lf_worker_priority = policy.priority;
+  } else {
+    lf_print_warning("Environment %u: Failed to give worker thread %d a real-time priority. "
+                     "Its priority will not follow the deadlines of reactions.",
+                     env->id, worker_number);
+  }
+#endif
 
 // If we have scheduling enclaves. The first worker will block here until
 // it receives a TAG for tag (0,0) from the local RTI. In federated scheduling
@@ -946,7 +1323,7 @@ void* worker(void* arg) {
 #endif
   }
 
-  lf_cond_signal(&env->event_q_changed);
+  _lf_notify_event_q_changed_locked(env, false);
 
   LF_PRINT_DEBUG("Worker %d: Stop requested. Exiting.", worker_number);
   LF_MUTEX_UNLOCK(&env->mutex);
@@ -979,13 +1356,28 @@ void lf_print_snapshot(environment_t* env) {
 /**
  * @brief Determine the number of workers.
  */
+#ifdef LF_TRACE
+/** Descriptions of the traced numbers of cores available to the program and of workers of each environment. */
+static char _lf_trace_available_cores[] = "Available cores";
+static char _lf_trace_number_of_workers[] = "Number of workers";
+#endif
+
+/** The number of cores that the program can keep busy, which is traced. */
+static inline int _lf_available_cores_for_workers(void) {
+#if defined(PLATFORM_Linux)
+  return lf_cpu_quota_cores();
+#else
+  return lf_available_cores();
+#endif
+}
+
 void determine_number_of_workers(void) {
   // If _lf_number_of_workers is 0, it means that it was not provided on
   // the command-line using the --workers argument.
   if (_lf_number_of_workers == 0u) {
 #if !defined(NUMBER_OF_WORKERS) || NUMBER_OF_WORKERS == 0
-    // Use the number of cores on the host machine.
-    _lf_number_of_workers = lf_available_cores();
+    // Use the number of cores on the host machine, or, on Linux, those that the CPU quota allows.
+    _lf_number_of_workers = _lf_available_cores_for_workers();
 
 // If reaction graph breadth is available. Cap number of workers
 #if defined(LF_REACTION_GRAPH_BREADTH)
@@ -1022,6 +1414,7 @@ int lf_reactor_c_main(int argc, const char* argv[]) {
   if (!(process_args(default_argc, default_argv) && process_args(argc, argv))) {
     return -1;
   }
+  _lf_lock_memory();
 
   // Register the termination function
   if (atexit(termination) != 0) {
@@ -1063,11 +1456,16 @@ int lf_reactor_c_main(int argc, const char* argv[]) {
 #endif // MINIMAL_STDLIB
 
   // Create and initialize the environments for each enclave
+  LF_STARTUP_BEGIN(lf_startup_environments);
   lf_create_environments();
+  LF_STARTUP_END(lf_startup_environments);
 
   // Initialize the one global mutex
   LF_MUTEX_INIT(&global_mutex);
 
+  // Initialize the pool for asynchronous work, whose threads start as work arrives.
+  _lf_async_work_initialize();
+
   // Initialize the global payload and token allocation counts and the trigger table
   // as well as starting tracing subsystem
   initialize_global();
@@ -1075,6 +1473,11 @@ int lf_reactor_c_main(int argc, const char* argv[]) {
   environment_t* envs;
   int num_envs = _lf_get_environments(&envs);
 
+#ifdef LF_TRACE
+  _lf_register_trace_event(_lf_trace_available_cores, NULL, trace_user, _lf_trace_available_cores);
+  _lf_register_trace_event(_lf_trace_number_of_workers, NULL, trace_user, _lf_trace_number_of_workers);
+#endif
+
 #if defined LF_ENCLAVES
   initialize_local_rti(envs, num_envs);
 #endif
@@ -1095,7 +1498,9 @@ int lf_reactor_c_main(int argc, const char* argv[]) {
 
     // Initialize the scheduler
     // FIXME: Why is this called here and in `_lf_initialize_trigger objects`?
+    LF_STARTUP_BEGIN(lf_startup_scheduler);
     lf_sched_init(env, (size_t)env->num_workers, NULL);
+    LF_STARTUP_END(lf_startup_scheduler);
 
     // Lock mutex and spawn threads. This must be done before `_lf_initialize_start_tag` since it is using
     //  a cond var
@@ -1103,10 +1508,17 @@ int lf_reactor_c_main(int argc, const char* argv[]) {
 
     // Initialize start tag
     lf_print("Environment %u: ---- Intializing start tag", env->id);
+    LF_STARTUP_BEGIN(lf_startup_start_tag);
     _lf_initialize_start_tag(env);
+    LF_STARTUP_END(lf_startup_start_tag);
 
     lf_print("Environment %u: ---- Spawning %d workers.", env->id, env->num_workers);
+#ifdef LF_TRACE
+    tracepoint_runtime_value(env, _lf_trace_available_cores, _lf_available_cores_for_workers());
+    tracepoint_runtime_value(env, _lf_trace_number_of_workers, env->num_workers);
+#endif
 
+    LF_STARTUP_BEGIN(lf_startup_workers);
     for (int j = 0; j < env->num_workers; j++) {
       if (i == 0 && j == 0) {
         // The first worker thread of the first environment will be
@@ -1120,11 +1532,18 @@ int lf_reactor_c_main(int argc, const char* argv[]) {
         lf_print_error_and_exit("Could not start thread-%u", j);
       }
     }
+    LF_STARTUP_END(lf_startup_workers);
 
     // Unlock mutex and allow threads proceed
     LF_MUTEX_UNLOCK(&env->mutex);
   }
 
+#ifdef LF_SHARED_WORKERS
+  _lf_environments_started = true;
+#endif
+  LF_STARTUP_PRINT();
+  _lf_memory_startup_complete();
+
   // main thread worker (first worker thread of first environment)
   void* main_thread_exit_status = NULL;
   if (num_envs > 0 && envs[0].num_workers > 0) {
@@ -1167,7 +1586,12 @@ int lf_reactor_c_main(int argc, const char* argv[]) {
  */
 int lf_notify_of_event(environment_t* env) {
   assert(env != GLOBAL_ENVIRONMENT);
-  return lf_cond_broadcast(&env->event_q_changed);
+  return _lf_notify_event_q_changed_locked(env, true);
+}
+
+int _lf_notify_event_q_changed_locked(environment_t* env, bool broadcast) {
+  lf_atomic_fetch_add32(&env->event_q_changes, 1);
+  return broadcast ? lf_cond_broadcast(&env->event_q_changed) : lf_cond_signal(&env->event_q_changed);
 }
 
 /**
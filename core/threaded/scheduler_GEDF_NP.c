@@ -91,15 +91,29 @@ static int advance_tag(lf_scheduler_t* scheduler) {
 }
 
 /**
- * @brief Assuming all other workers are idle, advance to the next level.
+ * @brief Assuming all other workers are idle, advance to the level of the reaction at the head of the queue.
+ *
+ * Only the reaction at the head of the queue can be executed, so the levels before it are skipped.
  * @param scheduler The scheduler.
+ * @param level The level of the reaction at the head of the queue.
  */
-static void advance_level(lf_scheduler_t* scheduler) {
-  if (++scheduler->custom_data->current_level > scheduler->max_reaction_level) {
+static void advance_level(lf_scheduler_t* scheduler, size_t level) {
+#ifdef FEDERATED
+  size_t current_level = scheduler->custom_data->current_level;
+  // Network input reactions can still be triggered at levels whose input statuses are not known,
+  // so advance one level at a time, stalling at each, while such levels would be skipped.
+  // If the level is not above the current level, we cycle back to level 0 through the maximum level.
+  size_t last_skipped_level = level > current_level ? level : scheduler->max_reaction_level;
+  if (last_skipped_level >= lf_max_level_allowed_to_advance_locked()) {
+    level = current_level + 1;
+  }
+#endif
+  if (level > scheduler->max_reaction_level) {
     // Since the reaction queue is not empty, we must be cycling back to level 0 due to deadlines
-    // having been given precedence over levels.  Reset the current level to 1.
-    scheduler->custom_data->current_level = 0;
+    // having been given precedence over levels.  Reset the current level to 0.
+    level = 0;
   }
+  scheduler->custom_data->current_level = level;
   LF_PRINT_DEBUG("Scheduler: Advancing to next reaction level %zu.", scheduler->custom_data->current_level);
 #ifdef FEDERATED
   // In case there are blocking network input reactions at this level, stall.
@@ -193,8 +207,8 @@ reaction_t* lf_sched_get_ready_reaction(lf_scheduler_t* scheduler, int worker_nu
                        LF_LEVEL(reaction_to_return->index), scheduler->custom_data->current_level);
         // We need to wait to advance to the next level or get a new reaction at the current level.
         if (scheduler->number_of_idle_workers == scheduler->number_of_workers - 1) {
-          // All other workers are idle.  Advance to the next level.
-          advance_level(scheduler);
+          // All other workers are idle.  Advance to the level of the reaction.
+          advance_level(scheduler, LF_LEVEL(reaction_to_return->index));
         } else {
           // Some workers are still working on reactions on the current level.
           // Wait for them to finish.
@@ -262,4 +276,34 @@ void lf_scheduler_trigger_reaction(lf_scheduler_t* scheduler, reaction_t* reacti
     LF_MUTEX_UNLOCK(&scheduler->env->mutex);
   }
 }
+
+bool lf_sched_has_earlier_deadline(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  if (!scheduler->custom_data->solo_holds_mutex) {
+    LF_MUTEX_LOCK(&scheduler->env->mutex);
+  }
+  // The reaction queue is sorted by index, which has the deadline in its high-order bits.
+  reaction_t* head = (reaction_t*)pqueue_peek(scheduler->custom_data->reaction_q);
+  bool result = head != NULL && (head->index >> 16) < (reaction->index >> 16);
+  if (!scheduler->custom_data->solo_holds_mutex) {
+    LF_MUTEX_UNLOCK(&scheduler->env->mutex);
+  }
+  return result;
+}
+
+reaction_t* lf_sched_lend_reaction(lf_scheduler_t* scheduler) {
+  (void)scheduler;
+  // This scheduler does not lend reactions to other environments.
+  return NULL;
+}
+
+void lf_sched_done_with_lent_reaction(lf_scheduler_t* scheduler, reaction_t* done_reaction) {
+  (void)scheduler;
+  (void)done_reaction;
+}
+
+void lf_sched_parallel_for(lf_scheduler_t* scheduler, size_t count, lf_sched_loop_body_t body, void* arg) {
+  (void)scheduler;
+  // The loop runs on the calling thread.
+  body(arg, 0, count);
+}
 #endif // SCHEDULER == SCHED_GEDF_NP
@@ -0,0 +1,552 @@
+/**
+ * @file
+ * @brief Sharded global earliest-deadline-first scheduler for the threaded runtime of the C target of Lingua Franca.
+ *
+ * Like the GEDF_NP scheduler (see scheduler_GEDF_NP.c), this scheduler executes the
+ * reactions of each level in the order of their (inferred) deadlines. Instead of one
+ * priority queue protected by the mutex of the environment, every worker owns a shard:
+ * a priority queue with its own mutex, sorted by level and then by deadline. A triggered
+ * reaction goes into the shard of the worker triggering it or, if there is no such
+ * worker, into the shard of the worker that last executed it.
+ *
+ * Workers execute the levels in order, as the NP and work-stealing schedulers do. The key
+ * of the first reaction of each shard is published so that it can be read without locking.
+ * A worker takes its next reaction from its own shard, except that every
+ * LF_SCHED_GEDF_REBALANCE_INTERVAL reactions, and whenever its own shard has no work at
+ * the current level, it takes the reaction with the earliest deadline over the first
+ * reactions of all shards. With an interval of 1, every worker always takes the reaction
+ * with the earliest deadline at the current level, as under global EDF. Larger intervals
+ * trade some of that ordering for less traffic on the shards of other workers.
+ */
+#include "lf_types.h"
+
+#if defined SCHEDULER && SCHEDULER == SCHED_GEDF_SHARDED
+
+#ifndef NUMBER_OF_WORKERS
+#define NUMBER_OF_WORKERS 1
+#endif // NUMBER_OF_WORKERS
+
+#include <assert.h>
+#include <limits.h>
+
+#include "low_level_platform.h"
+#include "environment.h"
+#include "pqueue.h"
+#include "scheduler_instance.h"
+#include "scheduler_sync_tag_advance.h"
+#include "scheduler.h"
+#include "lf_semaphore.h"
+#include "lf_combining_tree.h"
+#include "tracepoint.h"
+#include "util.h"
+#include "reactor_threaded.h"
+
+#ifdef FEDERATED
+#include "federate.h"
+#endif
+
+/**
+ * The number of reactions a worker takes from its own shard before it takes the reaction
+ * with the earliest deadline over all shards.
+ */
+#ifndef LF_SCHED_GEDF_REBALANCE_INTERVAL
+#define LF_SCHED_GEDF_REBALANCE_INTERVAL 4
+#endif
+
+/** The key of the first reaction of a shard without reactions. */
+#define SHARD_EMPTY ((pqueue_pri_t)ULLONG_MAX)
+
+/** The level in a key. */
+#define SHARD_LEVEL(key) ((size_t)((key) >> 48))
+
+/** The deadline in a key, which is the deadline in the index of the reaction. */
+#define SHARD_DEADLINE(key) ((key) & (ULLONG_MAX >> 16))
+
+/** The reactions triggered on one worker. */
+typedef union {
+  struct {
+    lf_mutex_t mutex;           // Protects `reactions` and `count_at_level`.
+    pqueue_t* reactions;        // Sorted by level, then by deadline.
+    size_t* count_at_level;     // The number of reactions in `reactions` at each level.
+    volatile pqueue_pri_t head; // Key of the first reaction or SHARD_EMPTY. Read without holding the mutex.
+    size_t taken;               // Number of reactions that the owner has taken. Only used by the owner.
+  };
+  char padding[128]; // Keep the shards of different workers in different cache lines.
+} gedf_shard_t;
+
+// Data specific to the sharded GEDF scheduler.
+typedef struct custom_scheduler_data_t {
+  gedf_shard_t* shards;              // One per worker.
+  lf_semaphore_t** semaphores;       // One per worker. Idle workers wait on their own semaphore.
+  lf_combining_tree_t* idle_workers; // The workers that are idle.
+  size_t* workers_to_awaken;         // Scratch space for _lf_sched_notify_workers.
+  volatile size_t next_reaction_level;
+} custom_scheduler_data_t;
+
+/////////////////// Scheduler Private API /////////////////////////
+
+/**
+ * @brief Return the key of a reaction in a shard.
+ *
+ * The key has the level in its 16 high-order bits and the deadline in the others,
+ * so that the reactions of a shard are sorted by level first.
+ */
+static pqueue_pri_t _lf_sched_get_key(void* reaction) {
+  index_t index = ((reaction_t*)reaction)->index;
+  return ((pqueue_pri_t)LF_LEVEL(index) << 48) | (pqueue_pri_t)(index >> 16);
+}
+
+/**
+ * @brief Publish the key of the first reaction of the shard. The mutex of the shard must be held.
+ */
+static inline void _lf_sched_update_head(gedf_shard_t* shard) {
+  reaction_t* head = (reaction_t*)pqueue_peek(shard->reactions);
+  shard->head = (head == NULL) ? SHARD_EMPTY : _lf_sched_get_key(head);
+}
+
+/**
+ * @brief Return true if the shard has reactions to execute at `level`.
+ *
+ * Reactions at a lower level, which only network input reactions in federated execution
+ * can be, are executed at the current level rather than left behind.
+ */
+static inline bool _lf_sched_has_work(gedf_shard_t* shard, size_t level) {
+  pqueue_pri_t head = shard->head;
+  return head != SHARD_EMPTY && SHARD_LEVEL(head) <= level;
+}
+
+/**
+ * @brief Insert 'reaction' into the shard of `owner`.
+ */
+static void _lf_sched_insert_reaction(lf_scheduler_t* scheduler, reaction_t* reaction, size_t owner) {
+  size_t level = LF_LEVEL(reaction->index);
+  gedf_shard_t* shard = &scheduler->custom_data->shards[owner];
+  LF_PRINT_DEBUG("Scheduler: Inserting reaction at level %zu of worker %zu.", level, owner);
+  LF_MUTEX_LOCK(&shard->mutex);
+  pqueue_insert(shard->reactions, reaction);
+  shard->count_at_level[level]++;
+  _lf_sched_update_head(shard);
+  LF_MUTEX_UNLOCK(&shard->mutex);
+}
+
+/**
+ * @brief Take the first reaction of the shard of `victim` if it is at `level` or below.
+ *
+ * @return The reaction or NULL if the shard has no work at `level`.
+ */
+static reaction_t* _lf_sched_pop_reaction(lf_scheduler_t* scheduler, size_t victim, size_t level) {
+  gedf_shard_t* shard = &scheduler->custom_data->shards[victim];
+  // Check before locking to avoid contending on the mutex of a shard without work.
+  if (!_lf_sched_has_work(shard, level)) {
+    return NULL;
+  }
+  reaction_t* reaction = NULL;
+  LF_MUTEX_LOCK(&shard->mutex);
+  if (_lf_sched_has_work(shard, level)) {
+    reaction = (reaction_t*)pqueue_pop(shard->reactions);
+    shard->count_at_level[LF_LEVEL(reaction->index)]--;
+    _lf_sched_update_head(shard);
+  }
+  LF_MUTEX_UNLOCK(&shard->mutex);
+  return reaction;
+}
+
+/**
+ * @brief Return the worker whose shard has the reaction with the earliest deadline at `level`,
+ * preferring `worker_number` on ties, or the number of workers if no shard has work at `level`.
+ *
+ * This reads the published keys without locking, so the result can be stale by the time
+ * the shard is locked.
+ */
+static size_t _lf_sched_earliest_shard(lf_scheduler_t* scheduler, size_t level, size_t worker_number) {
+  size_t number_of_workers = scheduler->number_of_workers;
+  size_t result = number_of_workers;
+  pqueue_pri_t earliest = SHARD_EMPTY;
+  for (size_t i = 0; i < number_of_workers; i++) {
+    size_t w = (worker_number + i) % number_of_workers;
+    pqueue_pri_t head = scheduler->custom_data->shards[w].head;
+    if (head != SHARD_EMPTY && SHARD_LEVEL(head) <= level && head < earliest) {
+      earliest = head;
+      result = w;
+    }
+  }
+  return result;
+}
+
+/**
+ * @brief Return the number of reactions waiting at `level` over all shards.
+ *
+ * This assumes that all workers are idle.
+ */
+static size_t _lf_sched_reactions_at_level(lf_scheduler_t* scheduler, size_t level) {
+  size_t count = 0;
+  for (size_t w = 0; w < scheduler->number_of_workers; w++) {
+    count += scheduler->custom_data->shards[w].count_at_level[level];
+  }
+  return count;
+}
+
+/**
+ * @brief Advance `next_reaction_level` up to the first level with triggered reactions.
+ *
+ * @return The number of reactions ready at the new current level, 0 if there are none.
+ */
+static size_t _lf_sched_distribute_ready_reactions(lf_scheduler_t* scheduler) {
+  custom_scheduler_data_t* data = scheduler->custom_data;
+  // Note: All the threads are idle, which means that they are done inserting
+  // reactions. Therefore, the counts can be read without locking a mutex.
+  while (data->next_reaction_level <= scheduler->max_reaction_level) {
+    size_t level = data->next_reaction_level;
+#ifdef FEDERATED
+    lf_stall_advance_level_federation(scheduler->env, level);
+#else
+    // The first reactions of the shards have the lowest levels, so skip to the lowest of them.
+    size_t first_level = scheduler->max_reaction_level + 1;
+    for (size_t w = 0; w < scheduler->number_of_workers; w++) {
+      pqueue_pri_t head = data->shards[w].head;
+      if (head != SHARD_EMPTY) {
+        first_level = LF_MIN(first_level, SHARD_LEVEL(head));
+      }
+    }
+    if (first_level > scheduler->max_reaction_level) {
+      data->next_reaction_level = scheduler->max_reaction_level + 1;
+      return 0;
+    }
+    level = LF_MAX(level, first_level);
+#endif
+    size_t count = _lf_sched_reactions_at_level(scheduler, level);
+    data->next_reaction_level = level + 1;
+    if (count > 0) {
+      return count;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Wake up as many workers as there are ready reactions, preferring the
+ * workers that have work in their own shards.
+ *
+ * This assumes that all workers other than `worker_number` are idle.
+ *
+ * @param ready_reactions The number of reactions ready at the current level.
+ * @param worker_number The worker calling this function. It is not woken up.
+ */
+static void _lf_sched_notify_workers(lf_scheduler_t* scheduler, size_t ready_reactions, size_t worker_number) {
+  size_t workers_to_awaken = LF_MIN(scheduler->number_of_idle_workers, ready_reactions);
+  LF_PRINT_DEBUG("Scheduler: Notifying %zu workers.", workers_to_awaken);
+
+  scheduler->number_of_idle_workers -= workers_to_awaken;
+  LF_PRINT_DEBUG("Scheduler: New number of idle workers: %zu.", scheduler->number_of_idle_workers);
+
+  // The calling worker counts as one of the awakened workers.
+  size_t* awaken = scheduler->custom_data->workers_to_awaken;
+  size_t count = 0;
+  awaken[count++] = worker_number;
+  size_t level = scheduler->custom_data->next_reaction_level - 1;
+  // In the first pass, choose workers that own work. In the second, choose the others.
+  for (int pass = 0; pass < 2 && count < workers_to_awaken; pass++) {
+    for (size_t i = 1; i < scheduler->number_of_workers && count < workers_to_awaken; i++) {
+      size_t w = (worker_number + i) % scheduler->number_of_workers;
+      bool has_work = _lf_sched_has_work(&scheduler->custom_data->shards[w], level);
+      if (has_work == (pass == 0)) {
+        awaken[count++] = w;
+      }
+    }
+  }
+  // Remove all the chosen workers from the idle tree before any of them can go idle again.
+  for (size_t i = 0; i < count; i++) {
+    lf_combining_tree_depart(scheduler->custom_data->idle_workers, awaken[i]);
+  }
+  for (size_t i = 1; i < count; i++) {
+    lf_semaphore_release(scheduler->custom_data->semaphores[awaken[i]], 1);
+  }
+}
+
+/**
+ * @brief Signal all worker threads other than `worker_number` that it is time to stop.
+ */
+static void _lf_sched_signal_stop(lf_scheduler_t* scheduler, size_t worker_number) {
+  scheduler->should_stop = true;
+  for (size_t w = 0; w < scheduler->number_of_workers; w++) {
+    if (w != worker_number) {
+      lf_semaphore_release(scheduler->custom_data->semaphores[w], 1);
+    }
+  }
+}
+
+/**
+ * @brief Advance tag or distribute reactions to worker threads.
+ *
+ * Advance tag if there are no reactions in the shards. If there are such
+ * reactions, wake up worker threads to execute them.
+ *
+ * This function assumes the caller does not hold the 'mutex' lock.
+ */
+static void _lf_scheduler_try_advance_tag_and_distribute(lf_scheduler_t* scheduler, size_t worker_number) {
+  environment_t* env = scheduler->env;
+
+  // Loop until it's time to stop or work has been distributed
+  while (true) {
+    if (scheduler->custom_data->next_reaction_level == (scheduler->max_reaction_level + 1)) {
+      scheduler->custom_data->next_reaction_level = 0;
+      LF_MUTEX_LOCK(&env->mutex);
+      // Nothing more happening at this tag.
+      LF_PRINT_DEBUG("Scheduler: Advancing tag.");
+      // This worker thread will take charge of advancing tag.
+      if (_lf_sched_advance_tag_locked(scheduler)) {
+        LF_PRINT_DEBUG("Scheduler: Reached stop tag.");
+        _lf_sched_signal_stop(scheduler, worker_number);
+        LF_MUTEX_UNLOCK(&env->mutex);
+        break;
+      }
+      LF_MUTEX_UNLOCK(&env->mutex);
+    }
+
+    size_t ready_reactions = _lf_sched_distribute_ready_reactions(scheduler);
+    if (ready_reactions > 0) {
+      _lf_sched_notify_workers(scheduler, ready_reactions, worker_number);
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Wait until the scheduler assigns work.
+ *
+ * If the calling worker thread is the last to become idle, it will call on the
+ * scheduler to distribute work. Otherwise, it will wait on its own semaphore.
+ *
+ * @param worker_number The worker number of the worker thread asking for work
+ * to be assigned to it.
+ */
+static void _lf_sched_wait_for_work(lf_scheduler_t* scheduler, size_t worker_number) {
+  // Record that this worker is idle and check if this is the last
+  // worker thread to become idle.
+  if (lf_combining_tree_arrive(scheduler->custom_data->idle_workers, worker_number)) {
+    // Last thread to go idle
+    LF_PRINT_DEBUG("Scheduler: Worker %zu is the last idle thread.", worker_number);
+    scheduler->number_of_idle_workers = scheduler->number_of_workers;
+    // Call on the scheduler to distribute work or advance tag.
+    _lf_scheduler_try_advance_tag_and_distribute(scheduler, worker_number);
+  } else {
+    // Not the last thread to become idle. Wait for work to be released.
+    LF_PRINT_DEBUG("Scheduler: Worker %zu is trying to acquire its semaphore.", worker_number);
+    lf_semaphore_acquire(scheduler->custom_data->semaphores[worker_number]);
+    LF_PRINT_DEBUG("Scheduler: Worker %zu acquired its semaphore.", worker_number);
+  }
+}
+
+///////////////////// Scheduler Init and Destroy API /////////////////////////
+
+/**
+ * @brief Initialize the scheduler.
+ *
+ * This has to be called before other functions of the scheduler can be used.
+ * If the scheduler is already initialized, this will be a no-op.
+ *
+ * @param env Environment within which we are executing.
+ * @param number_of_workers Indicate how many workers this scheduler will be
+ *  managing.
+ * @param option Pointer to a `sched_params_t` struct containing additional
+ *  scheduler parameters.
+ */
+void lf_sched_init(environment_t* env, size_t number_of_workers, sched_params_t* params) {
+  assert(env != GLOBAL_ENVIRONMENT);
+
+  LF_PRINT_DEBUG("Scheduler: Initializing with %zu workers", number_of_workers);
+
+  // Like the NP scheduler, this scheduler requires `num_reactions_per_level`
+  // to know the number of levels.
+  if (init_sched_instance(env, &env->scheduler, number_of_workers, params)) {
+    // Scheduler has not been initialized before.
+    if (params == NULL || params->num_reactions_per_level == NULL) {
+      lf_print_warning("Scheduler initialized with no reactions");
+      return;
+    }
+  } else {
+    // Already initialized
+    return;
+  }
+
+  lf_scheduler_t* scheduler = env->scheduler;
+  size_t num_levels = scheduler->max_reaction_level + 1;
+  LF_PRINT_DEBUG("Scheduler: Max reaction level: %zu", scheduler->max_reaction_level);
+
+  scheduler->custom_data = (custom_scheduler_data_t*)calloc(1, sizeof(custom_scheduler_data_t));
+  LF_ASSERT_NON_NULL(scheduler->custom_data);
+  custom_scheduler_data_t* data = scheduler->custom_data;
+
+  data->idle_workers = lf_combining_tree_new(number_of_workers);
+  data->workers_to_awaken = (size_t*)calloc(number_of_workers, sizeof(size_t));
+  LF_ASSERT_NON_NULL(data->workers_to_awaken);
+
+  data->semaphores = (lf_semaphore_t**)calloc(number_of_workers, sizeof(lf_semaphore_t*));
+  LF_ASSERT_NON_NULL(data->semaphores);
+  data->shards = (gedf_shard_t*)calloc(number_of_workers, sizeof(gedf_shard_t));
+  LF_ASSERT_NON_NULL(data->shards);
+  for (size_t w = 0; w < number_of_workers; w++) {
+    data->semaphores[w] = lf_semaphore_new(0);
+    gedf_shard_t* shard = &data->shards[w];
+    LF_MUTEX_INIT(&shard->mutex);
+    shard->reactions = pqueue_init(INITIAL_REACT_QUEUE_SIZE, in_reverse_order, _lf_sched_get_key,
+                                   get_reaction_position, set_reaction_position, reaction_matches, print_reaction);
+    shard->count_at_level = (size_t*)calloc(num_levels, sizeof(size_t));
+    LF_ASSERT_NON_NULL(shard->count_at_level);
+    shard->head = SHARD_EMPTY;
+  }
+
+  data->next_reaction_level = 1;
+}
+
+/**
+ * @brief Free the memory used by the scheduler.
+ *
+ * This must be called when the scheduler is no longer needed.
+ */
+void lf_sched_free(lf_scheduler_t* scheduler) {
+  custom_scheduler_data_t* data = scheduler->custom_data;
+  if (data == NULL) {
+    return;
+  }
+  for (size_t w = 0; w < scheduler->number_of_workers; w++) {
+    pqueue_free(data->shards[w].reactions);
+    free(data->shards[w].count_at_level);
+    lf_semaphore_destroy(data->semaphores[w]);
+  }
+  free(data->shards);
+  free(data->semaphores);
+  lf_combining_tree_free(data->idle_workers);
+  free(data->workers_to_awaken);
+  free(data);
+}
+
+///////////////////// Scheduler Worker API (public) /////////////////////////
+/**
+ * @brief Ask the scheduler for one more reaction.
+ *
+ * This function blocks until it can return a ready reaction for worker thread
+ * 'worker_number' or it is time for the worker thread to stop and exit (where a
+ * NULL value would be returned).
+ *
+ * @param worker_number
+ * @return reaction_t* A reaction for the worker to execute. NULL if the calling
+ * worker thread should exit.
+ */
+reaction_t* lf_sched_get_ready_reaction(lf_scheduler_t* scheduler, int worker_number) {
+  size_t number_of_workers = scheduler->number_of_workers;
+  gedf_shard_t* own = &scheduler->custom_data->shards[worker_number];
+  // Iterate until the stop tag is reached or the shards are empty
+  while (!scheduler->should_stop) {
+    // Calculate the current level of reactions to execute
+    size_t current_level = scheduler->custom_data->next_reaction_level - 1;
+    reaction_t* reaction_to_return = NULL;
+    if (++own->taken % LF_SCHED_GEDF_REBALANCE_INTERVAL != 0) {
+      reaction_to_return = _lf_sched_pop_reaction(scheduler, (size_t)worker_number, current_level);
+    }
+    while (reaction_to_return == NULL) {
+      size_t victim = _lf_sched_earliest_shard(scheduler, current_level, (size_t)worker_number);
+      if (victim == number_of_workers) {
+        break;
+      }
+      reaction_to_return = _lf_sched_pop_reaction(scheduler, victim, current_level);
+      if (reaction_to_return != NULL && victim != (size_t)worker_number) {
+        LF_PRINT_DEBUG("Scheduler: Worker %d took a reaction with level %zu from worker %zu.", worker_number,
+                       current_level, victim);
+      }
+    }
+
+    if (reaction_to_return != NULL) {
+      // Got a reaction. Next time, place it where it last executed.
+      reaction_to_return->worker_affinity = (size_t)worker_number;
+      return reaction_to_return;
+    }
+
+    LF_PRINT_DEBUG("Worker %d is out of ready reactions.", worker_number);
+
+    // Ask the scheduler for more work and wait
+    tracepoint_worker_wait_starts(scheduler->env, worker_number);
+    _lf_sched_wait_for_work(scheduler, (size_t)worker_number);
+    tracepoint_worker_wait_ends(scheduler->env, worker_number);
+  }
+
+  // It's time for the worker thread to stop and exit.
+  return NULL;
+}
+
+/**
+ * @brief Inform the scheduler that worker thread 'worker_number' is done
+ * executing the 'done_reaction'.
+ *
+ * @param worker_number The worker number for the worker thread that has
+ * finished executing 'done_reaction'.
+ * @param done_reaction The reaction that is done.
+ */
+void lf_sched_done_with_reaction(size_t worker_number, reaction_t* done_reaction) {
+  (void)worker_number;
+  if (!lf_atomic_bool_compare_and_swap32((int32_t*)&done_reaction->status, queued, inactive)) {
+    lf_print_error_and_exit("Unexpected reaction status: %d. Expected %d.", done_reaction->status, queued);
+  }
+}
+
+/**
+ * @brief Inform the scheduler that worker thread 'worker_number' would like to
+ * trigger 'reaction' at the current tag.
+ *
+ * If a worker number is not available (e.g., this function is not called by a
+ * worker thread), -1 should be passed as the 'worker_number'.
+ *
+ * This scheduler places the reaction in the shard of the calling worker or, if
+ * there is none, in the shard given by its `worker_affinity`.
+ *
+ * The scheduler will ensure that the same reaction is not triggered twice in
+ * the same tag.
+ *
+ * @param reaction The reaction to trigger at the current tag.
+ * @param worker_number The ID of the worker that is making this call. 0 should
+ *  be used if there is only one worker (e.g., when the program is using the
+ *  single-threaded C runtime). -1 is used for an anonymous call in a context where a
+ *  worker number does not make sense (e.g., the caller is not a worker thread).
+ *
+ */
+void lf_scheduler_trigger_reaction(lf_scheduler_t* scheduler, reaction_t* reaction, int worker_number) {
+  if (reaction == NULL || !lf_atomic_bool_compare_and_swap32((int32_t*)&reaction->status, inactive, queued)) {
+    return;
+  }
+  LF_PRINT_DEBUG("Scheduler: Enqueueing reaction %s, which has level %lld.", reaction->name, LF_LEVEL(reaction->index));
+  size_t owner = (worker_number >= 0) ? (size_t)worker_number : reaction->worker_affinity;
+  _lf_sched_insert_reaction(scheduler, reaction, owner % scheduler->number_of_workers);
+}
+
+bool lf_sched_has_earlier_deadline(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  // Only the first reaction of each shard is considered, which is the one with the
+  // earliest deadline at the lowest level of the shard.
+  if (scheduler->custom_data == NULL) {
+    return false;
+  }
+  for (size_t w = 0; w < scheduler->number_of_workers; w++) {
+    pqueue_pri_t head = scheduler->custom_data->shards[w].head;
+    if (head != SHARD_EMPTY && SHARD_DEADLINE(head) < (reaction->index >> 16)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+reaction_t* lf_sched_lend_reaction(lf_scheduler_t* scheduler) {
+  (void)scheduler;
+  // This scheduler does not lend reactions to other environments.
+  return NULL;
+}
+
+void lf_sched_done_with_lent_reaction(lf_scheduler_t* scheduler, reaction_t* done_reaction) {
+  (void)scheduler;
+  (void)done_reaction;
+}
+
+void lf_sched_parallel_for(lf_scheduler_t* scheduler, size_t count, lf_sched_loop_body_t body, void* arg) {
+  (void)scheduler;
+  // The loop runs on the calling thread.
+  body(arg, 0, count);
+}
+#endif // defined SCHEDULER && SCHEDULER == SCHED_GEDF_SHARDED
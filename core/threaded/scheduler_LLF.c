@@ -0,0 +1,424 @@
+/**
+ * @file
+ * @brief Least Laxity First (LLF) non-preemptive scheduler for the threaded runtime of the C target
+ * of Lingua Franca.
+ *
+ * This scheduler is the GEDF_NP scheduler with another order of the reactions of a tag. GEDF_NP orders
+ * them by their (inferred) deadlines, so a reaction with a loose deadline and a long execution time, or
+ * upstream of a long chain of reactions, can miss its deadline while reactions that could wait run first.
+ * This scheduler instead orders them by their latest start times, the times at which they have to start
+ * for all deadlines downstream of them to be met if each reaction takes as long as it usually does:
+ *
+ *   latest_start(R) = min(deadline of R, min over reactions D triggered by R of latest_start(D) - estimate(R))
+ *
+ * where estimate(R) is the moving average of the execution times of R kept by the execution-time
+ * statistics of the runtime (see reaction_profile.h), which are therefore always collected with this
+ * scheduler. The laxity of a reaction, its latest start time minus the current time, gives the same
+ * order, since all queued reactions are at the same tag. As the latest start time of a reaction is
+ * below those of the reactions downstream of it, the order respects precedences as the one of
+ * GEDF_NP does, and ties are broken by levels. Reactions with no deadline downstream come last.
+ *
+ * The latest start times are computed when reactions are triggered, from the estimates at that time,
+ * and kept until the next tag, so each reaction is visited once per tag. As in GEDF_NP, the execution
+ * is non-preemptive and reactions are not prioritized across distinct tags.
+ */
+#include "lf_types.h"
+
+#if defined SCHEDULER && SCHEDULER == SCHED_LLF
+
+#ifndef LF_REACTION_PROFILE
+#error "The LLF scheduler needs the execution-time statistics of LF_REACTION_PROFILE."
+#endif
+
+#ifndef NUMBER_OF_WORKERS
+#define NUMBER_OF_WORKERS 1
+#endif // NUMBER_OF_WORKERS
+
+/** The number of reactions assumed if the scheduler parameters do not give the number per level. */
+#define DEFAULT_NUM_REACTIONS 1024
+
+/** The upper bits of the index of a reaction with no deadline downstream, as set by lf_combine_deadline_and_level. */
+#define NO_DEADLINE (ULLONG_MAX >> 16)
+
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+
+#include "low_level_platform.h"
+#include "environment.h"
+#include "pqueue.h"
+#include "reaction_profile.h"
+#include "reactor_threaded.h"
+#include "scheduler_instance.h"
+#include "scheduler_sync_tag_advance.h"
+#include "scheduler.h"
+#include "tracepoint.h"
+#include "util.h"
+
+#ifdef FEDERATED
+#include "federate.h"
+#endif
+
+#define HASHMAP(token) llf_map##_##token
+#define K void*
+#define V void*
+#define HASH_OF(key) (size_t)(((uintptr_t)(key) >> 4) * 2654435761u)
+#include "core/utils/impl/hashmap.h"
+#undef HASHMAP
+#undef K
+#undef V
+#undef HASH_OF
+
+/** The bookkeeping of a reaction, which is what the reaction queue holds. */
+typedef struct llf_reaction_t {
+  reaction_t* reaction;
+  pqueue_pri_t priority;   // The latest start time in the upper bits and the level in the lower 16 bits.
+  size_t pos;              // The position in the reaction queue.
+  interval_t latest_start; // Relative to the current tag, FOREVER if there is no deadline downstream.
+  size_t epoch;            // The epoch at which latest_start was computed.
+} llf_reaction_t;
+
+// Data specific to the LLF scheduler.
+typedef struct custom_scheduler_data_t {
+  pqueue_t* reaction_q;
+  lf_cond_t reaction_q_changed;
+  size_t current_level;
+  llf_map_t* reactions; // Maps each reaction that has been triggered to its llf_reaction_t.
+  size_t epoch;         // Incremented at each tag, so that the latest start times are computed again.
+  bool solo_holds_mutex; // Indicates sole thread holds the mutex.
+} custom_scheduler_data_t;
+
+/////////////////// Scheduler Private API /////////////////////////
+
+static pqueue_pri_t get_record_priority(void* record) { return ((llf_reaction_t*)record)->priority; }
+
+static size_t get_record_position(void* record) { return ((llf_reaction_t*)record)->pos; }
+
+static void set_record_position(void* record, size_t pos) { ((llf_reaction_t*)record)->pos = pos; }
+
+static int record_matches(void* a, void* b) { return a == b; }
+
+static void print_record(void* record) { print_reaction(((llf_reaction_t*)record)->reaction); }
+
+/** @brief Return the bookkeeping of `reaction`, creating it the first time. */
+static llf_reaction_t* reaction_record(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  llf_map_t* map = scheduler->custom_data->reactions;
+  llf_map_entry_t* entry = llf_map_get_actual_address(map, reaction);
+  if (entry != NULL && entry->key == reaction) {
+    return (llf_reaction_t*)entry->value;
+  }
+  // Keep the map at most half full so that lookups stay short.
+  if (entry == NULL || ++map->num_entries > map->capacity / 2) {
+    lf_print_error_and_exit("LLF scheduler: More reactions than the %zu given to lf_sched_init.", map->capacity / 2);
+  }
+  llf_reaction_t* record = (llf_reaction_t*)calloc(1, sizeof(llf_reaction_t));
+  LF_ASSERT_NON_NULL(record);
+  record->reaction = reaction;
+  entry->key = reaction;
+  entry->value = record;
+  return record;
+}
+
+/**
+ * @brief Return the latest start time of `reaction` relative to the current tag, computing it,
+ * and those of the reactions downstream of it, if this has not been done at the current tag.
+ */
+static interval_t latest_start(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  llf_reaction_t* record = reaction_record(scheduler, reaction);
+  if (record->epoch == scheduler->custom_data->epoch) {
+    return record->latest_start;
+  }
+  interval_t result = reaction->deadline >= 0 ? reaction->deadline : FOREVER;
+  interval_t estimate = lf_reaction_profile_estimate(reaction);
+  for (size_t i = 0; i < reaction->num_outputs; i++) {
+    for (int j = 0; j < reaction->triggered_sizes[i]; j++) {
+      trigger_t* trigger = reaction->triggers[i][j];
+      for (int k = 0; trigger != NULL && k < trigger->number_of_reactions; k++) {
+        reaction_t* downstream = trigger->reactions[k];
+        // Inferred deadlines are in the indexes, so reactions without one have no deadline downstream.
+        if (downstream != NULL && (downstream->index >> 16) != NO_DEADLINE) {
+          interval_t downstream_start = latest_start(scheduler, downstream);
+          if (downstream_start != FOREVER) {
+            result = LF_MIN(result, downstream_start - estimate);
+          }
+        }
+      }
+    }
+  }
+  record->latest_start = result;
+  record->epoch = scheduler->custom_data->epoch;
+  return result;
+}
+
+/** @brief Return the priority of `reaction` in the reaction queue, with its latest start time in the upper bits. */
+static pqueue_pri_t priority_of(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  interval_t start = latest_start(scheduler, reaction);
+  // A reaction that should already have started is as urgent as can be.
+  pqueue_pri_t upper = start == FOREVER ? NO_DEADLINE : LF_MIN((pqueue_pri_t)LF_MAX(start, 0), NO_DEADLINE - 1);
+  return (upper << 16) | LF_LEVEL(reaction->index);
+}
+
+/**
+ * @brief Mark the calling thread idle and wait for notification of change to the reaction queue.
+ * @param scheduler The scheduler.
+ * @param worker_number The number of the worker thread.
+ */
+inline static void wait_for_reaction_queue_updates(lf_scheduler_t* scheduler, int worker_number) {
+  scheduler->number_of_idle_workers++;
+  tracepoint_worker_wait_starts(scheduler->env, worker_number);
+  LF_COND_WAIT(&scheduler->custom_data->reaction_q_changed);
+  tracepoint_worker_wait_ends(scheduler->env, worker_number);
+  scheduler->number_of_idle_workers--;
+}
+
+/**
+ * @brief Assuming this is the last worker to go idle, advance the tag.
+ * @param scheduler The scheduler.
+ * @return Non-zero if the stop tag has been reached.
+ */
+static int advance_tag(lf_scheduler_t* scheduler) {
+  // The estimates may have changed during the last tag.
+  scheduler->custom_data->epoch++;
+  // Set a flag in the scheduler that the lock is held by the sole executing thread.
+  // This prevents acquiring the mutex in lf_scheduler_trigger_reaction.
+  scheduler->custom_data->solo_holds_mutex = true;
+  if (_lf_sched_advance_tag_locked(scheduler)) {
+    LF_PRINT_DEBUG("Scheduler: Reached stop tag.");
+    scheduler->should_stop = true;
+    scheduler->custom_data->solo_holds_mutex = false;
+    // Notify all threads that the stop tag has been reached.
+    LF_COND_BROADCAST(&scheduler->custom_data->reaction_q_changed);
+    return 1;
+  }
+  scheduler->custom_data->solo_holds_mutex = false;
+  // Reset the level to 0.
+  scheduler->custom_data->current_level = 0;
+#ifdef FEDERATED
+  // In case there are blocking network input reactions at this level, stall.
+  lf_stall_advance_level_federation_locked(scheduler->custom_data->current_level);
+#endif
+  return 0;
+}
+
+/**
+ * @brief Assuming all other workers are idle, advance to the level of the reaction at the head of the queue.
+ *
+ * Only the reaction at the head of the queue can be executed, so the levels before it are skipped.
+ * @param scheduler The scheduler.
+ * @param level The level of the reaction at the head of the queue.
+ */
+static void advance_level(lf_scheduler_t* scheduler, size_t level) {
+#ifdef FEDERATED
+  size_t current_level = scheduler->custom_data->current_level;
+  // Network input reactions can still be triggered at levels whose input statuses are not known,
+  // so advance one level at a time, stalling at each, while such levels would be skipped.
+  // If the level is not above the current level, we cycle back to level 0 through the maximum level.
+  size_t last_skipped_level = level > current_level ? level : scheduler->max_reaction_level;
+  if (last_skipped_level >= lf_max_level_allowed_to_advance_locked()) {
+    level = current_level + 1;
+  }
+#endif
+  if (level > scheduler->max_reaction_level) {
+    // Since the reaction queue is not empty, we must be cycling back to level 0 due to latest start
+    // times having been given precedence over levels.  Reset the current level to 0.
+    level = 0;
+  }
+  scheduler->custom_data->current_level = level;
+  LF_PRINT_DEBUG("Scheduler: Advancing to next reaction level %zu.", scheduler->custom_data->current_level);
+#ifdef FEDERATED
+  // In case there are blocking network input reactions at this level, stall.
+  lf_stall_advance_level_federation_locked(scheduler->custom_data->current_level);
+#endif
+}
+///////////////////// Scheduler Init and Destroy API /////////////////////////
+/**
+ * @brief Initialize the scheduler.
+ *
+ * This has to be called before other functions of the scheduler can be used.
+ * If the scheduler is already initialized, this will be a no-op.
+ *
+ * @param env Environment within which we are executing.
+ * @param number_of_workers Indicate how many workers this scheduler will be
+ *  managing.
+ * @param option Pointer to a `sched_params_t` struct containing additional
+ *  scheduler parameters.
+ */
+void lf_sched_init(environment_t* env, size_t number_of_workers, sched_params_t* params) {
+  assert(env != GLOBAL_ENVIRONMENT);
+
+  LF_PRINT_DEBUG("Scheduler: Initializing with %zu workers", number_of_workers);
+  if (!init_sched_instance(env, &env->scheduler, number_of_workers, params)) {
+    // Already initialized
+    return;
+  }
+  lf_scheduler_t* scheduler = env->scheduler;
+
+  scheduler->custom_data = (custom_scheduler_data_t*)calloc(1, sizeof(custom_scheduler_data_t));
+  LF_ASSERT_NON_NULL(scheduler->custom_data);
+
+  size_t num_reactions = DEFAULT_NUM_REACTIONS;
+  if (params != NULL && params->num_reactions_per_level != NULL) {
+    num_reactions = 0;
+    for (size_t i = 0; i < params->num_reactions_per_level_size; i++) {
+      num_reactions += params->num_reactions_per_level[i];
+    }
+  }
+  scheduler->custom_data->reactions = llf_map_new(2 * num_reactions + 1, NULL);
+  // Records are created with epoch 0, so the first tag is epoch 1.
+  scheduler->custom_data->epoch = 1;
+
+  // Initialize the reaction queue.
+  size_t queue_size = INITIAL_REACT_QUEUE_SIZE;
+  scheduler->custom_data->reaction_q =
+      pqueue_init(queue_size, in_reverse_order, get_record_priority, get_record_position, set_record_position,
+                  record_matches, print_record);
+
+  LF_COND_INIT(&scheduler->custom_data->reaction_q_changed, &env->mutex);
+
+  scheduler->custom_data->current_level = 0;
+}
+
+/**
+ * @brief Free the memory used by the scheduler.
+ *
+ * This must be called when the scheduler is no longer needed.
+ */
+void lf_sched_free(lf_scheduler_t* scheduler) {
+  custom_scheduler_data_t* data = scheduler->custom_data;
+  for (size_t i = 0; i < data->reactions->capacity; i++) {
+    if (data->reactions->entries[i].key != NULL) {
+      free(data->reactions->entries[i].value);
+    }
+  }
+  llf_map_free(data->reactions);
+  pqueue_free(data->reaction_q);
+  free(data);
+}
+
+///////////////////// Scheduler Worker API (public) /////////////////////////
+
+reaction_t* lf_sched_get_ready_reaction(lf_scheduler_t* scheduler, int worker_number) {
+  LF_MUTEX_LOCK(&scheduler->env->mutex);
+
+  // Iterate until the stop_tag is reached or the event queue is empty.
+  while (!scheduler->should_stop) {
+    llf_reaction_t* record = (llf_reaction_t*)pqueue_peek(scheduler->custom_data->reaction_q);
+    if (record != NULL) {
+      // Found a reaction.  Check the level.  Notice that because of latest start times, the current
+      // level may advance to the maximum and then back down to 0.
+      if (LF_LEVEL(record->priority) == scheduler->custom_data->current_level) {
+        LF_PRINT_DEBUG("Scheduler: Worker %d found a reaction at level %zu.", worker_number,
+                       scheduler->custom_data->current_level);
+        pqueue_pop(scheduler->custom_data->reaction_q);
+
+        // If there is another reaction at the current level and an idle thread, then
+        // notify an idle thread, which will wake another one if there are more.
+        llf_reaction_t* next = (llf_reaction_t*)pqueue_peek(scheduler->custom_data->reaction_q);
+        if (next != NULL && LF_LEVEL(next->priority) == scheduler->custom_data->current_level &&
+            scheduler->number_of_idle_workers > 0) {
+          LF_COND_SIGNAL(&scheduler->custom_data->reaction_q_changed);
+        }
+        LF_MUTEX_UNLOCK(&scheduler->env->mutex);
+        return record->reaction;
+      } else {
+        LF_PRINT_DEBUG("Scheduler: Worker %d found a reaction at level %lld. Current level is %zu", worker_number,
+                       LF_LEVEL(record->priority), scheduler->custom_data->current_level);
+        // We need to wait to advance to the next level or get a new reaction at the current level.
+        if (scheduler->number_of_idle_workers == scheduler->number_of_workers - 1) {
+          // All other workers are idle.  Advance to the level of the reaction.
+          advance_level(scheduler, LF_LEVEL(record->priority));
+        } else {
+          // Some workers are still working on reactions on the current level.
+          wait_for_reaction_queue_updates(scheduler, worker_number);
+        }
+      }
+    } else {
+      LF_PRINT_DEBUG("Worker %d finds nothing on the reaction queue.", worker_number);
+
+      // If all other workers are idle, then we are done with this tag.
+      if (scheduler->number_of_idle_workers == scheduler->number_of_workers - 1) {
+        // Last thread to go idle
+        LF_PRINT_DEBUG("Scheduler: Worker %d is advancing the tag.", worker_number);
+        if (advance_tag(scheduler)) {
+          // Stop tag has been reached.
+          break;
+        }
+      } else {
+        // Some other workers are still working on reactions on the current level.
+        wait_for_reaction_queue_updates(scheduler, worker_number);
+      }
+    }
+  }
+
+  // It's time for the worker thread to stop and exit.
+  LF_MUTEX_UNLOCK(&scheduler->env->mutex);
+  return NULL;
+}
+
+void lf_sched_done_with_reaction(size_t worker_number, reaction_t* done_reaction) {
+  (void)worker_number; // Suppress unused parameter warning.
+  if (!lf_atomic_bool_compare_and_swap32((int32_t*)&done_reaction->status, queued, inactive)) {
+    lf_print_error_and_exit("Unexpected reaction status: %d. Expected %d.", done_reaction->status, queued);
+  }
+}
+
+void lf_scheduler_trigger_reaction(lf_scheduler_t* scheduler, reaction_t* reaction, int worker_number) {
+  (void)worker_number; // Suppress unused parameter warning.
+  if (reaction == NULL || !lf_atomic_bool_compare_and_swap32((int32_t*)&reaction->status, inactive, queued)) {
+    return;
+  }
+  LF_PRINT_DEBUG("Scheduler: Enqueueing reaction %s, which has level %lld.", reaction->name, LF_LEVEL(reaction->index));
+
+  // Mutex not needed when pulling from the event queue.
+  if (!scheduler->custom_data->solo_holds_mutex) {
+    LF_MUTEX_LOCK(&scheduler->env->mutex);
+  }
+  llf_reaction_t* record = reaction_record(scheduler, reaction);
+  record->priority = priority_of(scheduler, reaction);
+  pqueue_insert(scheduler->custom_data->reaction_q, record);
+  if (!scheduler->custom_data->solo_holds_mutex) {
+    // If this is called from a reaction execution, then the triggered reaction
+    // has one level higher than the current level. No need to notify idle threads.
+    // But in federated execution, it could be called because of message arrival.
+    // Also, in modal models, reset and startup reactions may be triggered.
+#if defined(FEDERATED) || (defined(MODAL) && !defined(LF_SINGLE_THREADED))
+    llf_reaction_t* head = (llf_reaction_t*)pqueue_peek(scheduler->custom_data->reaction_q);
+    if (LF_LEVEL(head->priority) == scheduler->custom_data->current_level) {
+      LF_COND_SIGNAL(&scheduler->custom_data->reaction_q_changed);
+    }
+#endif // FEDERATED || MODAL
+
+    LF_MUTEX_UNLOCK(&scheduler->env->mutex);
+  }
+}
+
+bool lf_sched_has_earlier_deadline(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  if (!scheduler->custom_data->solo_holds_mutex) {
+    LF_MUTEX_LOCK(&scheduler->env->mutex);
+  }
+  // The reaction queue is sorted by priority, which has the latest start time in its high-order bits.
+  llf_reaction_t* head = (llf_reaction_t*)pqueue_peek(scheduler->custom_data->reaction_q);
+  bool result = head != NULL && (head->priority >> 16) < (priority_of(scheduler, reaction) >> 16);
+  if (!scheduler->custom_data->solo_holds_mutex) {
+    LF_MUTEX_UNLOCK(&scheduler->env->mutex);
+  }
+  return result;
+}
+
+reaction_t* lf_sched_lend_reaction(lf_scheduler_t* scheduler) {
+  (void)scheduler;
+  // This scheduler does not lend reactions to other environments.
+  return NULL;
+}
+
+void lf_sched_done_with_lent_reaction(lf_scheduler_t* scheduler, reaction_t* done_reaction) {
+  (void)scheduler;
+  (void)done_reaction;
+}
+
+void lf_sched_parallel_for(lf_scheduler_t* scheduler, size_t count, lf_sched_loop_body_t body, void* arg) {
+  (void)scheduler;
+  // The loop runs on the calling thread.
+  body(arg, 0, count);
+}
+#endif // SCHEDULER == SCHED_LLF
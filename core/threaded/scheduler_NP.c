@@ -15,6 +15,17 @@
 #define NUMBER_OF_WORKERS 1
 #endif // NUMBER_OF_WORKERS
 
+/**
+ * The maximum number of times an idle worker yields the processor after spinning and before blocking.
+ */
+#define LF_SCHED_IDLE_YIELDS 16
+
+/**
+ * The fewest items in a chunk of a loop of lf_sched_parallel_for(), below which waking up a helper costs more
+ * than it saves.
+ */
+#define LF_SCHED_MIN_CHUNK 16
+
 #include <assert.h>
 
 #include "low_level_platform.h"
@@ -25,11 +36,15 @@
 #include "lf_semaphore.h"
 #include "tracepoint.h"
 #include "util.h"
+#include "memory_accounting.h"
 #include "reactor_threaded.h"
 
 #ifdef FEDERATED
 #include "federate.h"
 #endif
+#ifdef LF_TAG_PIPELINING
+#include "pipeline.h"
+#endif
 
 // Data specific to the NP scheduler.
 typedef struct custom_scheduler_data_t {
@@ -37,10 +52,25 @@ typedef struct custom_scheduler_data_t {
   lf_mutex_t* array_of_mutexes;
   reaction_t*** triggered_reactions;
   volatile size_t next_reaction_level;
+  uint64_t* occupied_levels; // The levels at which reactions have been triggered, so that empty levels are skipped.
   lf_semaphore_t* semaphore; // Signal the maximum number of worker threads that should
                              // be executing work at the same time.  Initially 0.
                              // For example, if the scheduler releases the semaphore with a count of 4,
                              // no more than 4 worker threads should wake up to process reactions.
+#ifdef LF_SHARED_WORKERS
+  volatile int32_t lent; // The number of lent reactions that are executing, or -1 while the level cannot be lent.
+#endif
+#ifdef LF_PARALLEL_POP
+  // The loop of lf_sched_parallel_for() that the idle workers help with.
+  lf_sched_loop_body_t loop_body;
+  void* loop_arg;
+  size_t loop_count;
+  size_t loop_chunk;
+  volatile int32_t loop_next;    // The first item that has not been claimed.
+  volatile int32_t loop_open;    // Whether helpers may claim items.
+  volatile int32_t helpers;      // The workers that have woken up to help and have not finished.
+  volatile int32_t help_wakeups; // The permits released to wake up helpers that have not been acquired.
+#endif
 } custom_scheduler_data_t;
 
 /////////////////// Scheduler Private API /////////////////////////
@@ -82,6 +112,7 @@ static inline void _lf_sched_insert_reaction(lf_scheduler_t* scheduler, reaction
   LF_PRINT_DEBUG("Scheduler: Accessing triggered reactions at the level %zu with index %d.", reaction_level,
                  reaction_q_level_index);
   ((reaction_t***)scheduler->custom_data->triggered_reactions)[reaction_level][reaction_q_level_index] = reaction;
+  lf_sched_level_bitmap_set(scheduler->custom_data->occupied_levels, reaction_level);
   LF_PRINT_DEBUG("Scheduler: Index for level %zu is at %d.", reaction_level, reaction_q_level_index);
 #ifdef FEDERATED
   if (reaction_level == current_level) {
@@ -101,15 +132,32 @@ static int _lf_sched_distribute_ready_reactions(lf_scheduler_t* scheduler) {
   // reactions. Therefore, the reaction vectors can be accessed without
   // locking a mutex.
   while (scheduler->custom_data->next_reaction_level <= scheduler->max_reaction_level) {
+    // Skip the levels at which no reaction has been triggered.
+    size_t level = lf_sched_level_bitmap_next(scheduler->custom_data->occupied_levels,
+                                              scheduler->custom_data->next_reaction_level,
+                                              scheduler->max_reaction_level + 1);
 #ifdef FEDERATED
-    lf_stall_advance_level_federation(scheduler->env, scheduler->custom_data->next_reaction_level);
+    // Network input reactions can still be triggered at levels whose input statuses are not known,
+    // so stall at each of those rather than skipping it.
+    LF_MUTEX_LOCK(&scheduler->env->mutex);
+    size_t first_unknown_level =
+        LF_MAX(lf_max_level_allowed_to_advance_locked(), scheduler->custom_data->next_reaction_level);
+    level = LF_MIN(level, first_unknown_level);
+    if (level <= scheduler->max_reaction_level) {
+      lf_stall_advance_level_federation_locked(level);
+    }
+    LF_MUTEX_UNLOCK(&scheduler->env->mutex);
 #endif
-    scheduler->custom_data->executing_reactions =
-        scheduler->custom_data->triggered_reactions[scheduler->custom_data->next_reaction_level];
-    LF_PRINT_DEBUG("Start of rxn queue at %zu is %p", scheduler->custom_data->next_reaction_level,
+    if (level > scheduler->max_reaction_level) {
+      scheduler->custom_data->next_reaction_level = level;
+      break;
+    }
+    lf_sched_level_bitmap_clear(scheduler->custom_data->occupied_levels, level);
+    scheduler->custom_data->executing_reactions = scheduler->custom_data->triggered_reactions[level];
+    LF_PRINT_DEBUG("Start of rxn queue at %zu is %p", level,
                    (void*)((reaction_t**)scheduler->custom_data->executing_reactions)[0]);
 
-    scheduler->custom_data->next_reaction_level++;
+    scheduler->custom_data->next_reaction_level = level + 1;
 
     if (scheduler->custom_data->executing_reactions[0] != NULL) {
       // There is at least one reaction to execute
@@ -153,6 +201,76 @@ static void _lf_sched_signal_stop(lf_scheduler_t* scheduler) {
   lf_semaphore_release(scheduler->custom_data->semaphore, (scheduler->number_of_workers - 1));
 }
 
+#ifndef FEDERATED
+/**
+ * @brief If the tag that has just started triggered a single reaction, take it off its level.
+ *
+ * Many tags trigger a single reaction, such as that of a lone timer or physical action. The
+ * thread that advanced the tag then executes it, and the reactions that it enables inline,
+ * without distributing the level and popping the reaction off it. The level becomes the current
+ * level, so the reactions that the lone reaction triggers at later levels are distributed as usual,
+ * which wakes up other workers only if they can run in parallel. Federates do not take this path,
+ * because they may have to stall at a level before executing its reactions.
+ *
+ * All the workers are idle, so the reaction vectors can be accessed without locking a mutex.
+ * @return The lone reaction, or NULL if the tag triggered none or more than one.
+ */
+static reaction_t* _lf_sched_take_lone_reaction(lf_scheduler_t* scheduler) {
+  custom_scheduler_data_t* data = scheduler->custom_data;
+  size_t limit = scheduler->max_reaction_level + 1;
+  size_t level = lf_sched_level_bitmap_next(data->occupied_levels, 0, limit);
+  if (level == limit || scheduler->indexes[level] != 1 ||
+      lf_sched_level_bitmap_next(data->occupied_levels, level + 1, limit) != limit) {
+    return NULL;
+  }
+  lf_sched_level_bitmap_clear(data->occupied_levels, level);
+  data->executing_reactions = data->triggered_reactions[level];
+  data->next_reaction_level = level + 1;
+  reaction_t* reaction = data->executing_reactions[0];
+  data->executing_reactions[0] = NULL;
+  scheduler->indexes[level] = 0;
+  LF_PRINT_DEBUG("Scheduler: Executing the lone reaction %s at level %zu directly.", reaction->name, level);
+  return reaction;
+}
+#endif // FEDERATED
+
+#ifdef LF_TAG_PIPELINING
+/**
+ * @brief Start the next tag in the components of reactors in which no reaction is triggered at the
+ * levels that remain at the current tag, if the next tag can be started ahead (see pipeline.h).
+ *
+ * The reactions triggered at the next tag go to the levels with the remaining ones, and the
+ * levels are then distributed again from the lowest one. All the workers are idle, so the
+ * reaction vectors can be accessed without locking a mutex.
+ * @return Whether the next tag was started.
+ */
+static bool _lf_sched_start_next_tag(lf_scheduler_t* scheduler) {
+  custom_scheduler_data_t* data = scheduler->custom_data;
+  environment_t* env = scheduler->env;
+  size_t limit = scheduler->max_reaction_level + 1;
+  size_t level = lf_sched_level_bitmap_next(data->occupied_levels, data->next_reaction_level, limit);
+  if (level == limit) {
+    // The current tag is complete, so the tag advances as usual.
+    return false;
+  }
+  bool started = false;
+  LF_MUTEX_LOCK(&env->mutex);
+  if (_lf_pipeline_begin_locked(env)) {
+    for (; level < limit; level = lf_sched_level_bitmap_next(data->occupied_levels, level + 1, limit)) {
+      for (int i = 0; i < scheduler->indexes[level]; i++) {
+        _lf_pipeline_lag(env, data->triggered_reactions[level][i]);
+      }
+    }
+    started = _lf_pipeline_start_locked(env);
+  }
+  LF_MUTEX_UNLOCK(&env->mutex);
+  if (started) {
+    data->next_reaction_level = 0;
+  }
+  return started;
+}
+#endif // LF_TAG_PIPELINING
+
 /**
  * @brief Advance tag or distribute reactions to worker threads.
  *
@@ -160,11 +278,21 @@ static void _lf_sched_signal_stop(lf_scheduler_t* scheduler) {
  * there are such reactions, distribute them to worker threads.
  *
  * This function assumes the caller does not hold the 'mutex' lock.
+ * @return The reaction that the calling worker should execute directly, because it is the only
+ * one triggered at the new tag (see _lf_sched_take_lone_reaction()), or NULL.
  */
-static void _lf_scheduler_try_advance_tag_and_distribute(lf_scheduler_t* scheduler) {
+static reaction_t* _lf_scheduler_try_advance_tag_and_distribute(lf_scheduler_t* scheduler) {
+#ifdef LF_SHARED_WORKERS
+  // Wait for the reactions lent at this level to be done, and stop lending until the next level is distributed.
+  while (!lf_atomic_bool_compare_and_swap32((int32_t*)&scheduler->custom_data->lent, 0, -1) &&
+         scheduler->custom_data->lent != -1) {
+    lf_thread_yield();
+  }
+#endif
   // Reset the index
   environment_t* env = scheduler->env;
   scheduler->indexes[scheduler->custom_data->next_reaction_level - 1] = 0;
+  reaction_t* lone_reaction = NULL;
 
   // Loop until it's time to stop or work has been distributed
   while (true) {
@@ -181,15 +309,104 @@ static void _lf_scheduler_try_advance_tag_and_distribute(lf_scheduler_t* schedul
         break;
       }
       LF_MUTEX_UNLOCK(&env->mutex);
+#ifndef FEDERATED
+      lone_reaction = _lf_sched_take_lone_reaction(scheduler);
+      if (lone_reaction != NULL) {
+        scheduler->number_of_idle_workers--;
+        break;
+      }
+#endif
+    }
+#ifdef LF_TAG_PIPELINING
+    else {
+      _lf_sched_start_next_tag(scheduler);
     }
+#endif
 
     if (_lf_sched_distribute_ready_reactions(scheduler) > 0) {
       _lf_sched_notify_workers(scheduler);
       break;
     }
   }
+#ifdef LF_SHARED_WORKERS
+  lf_atomic_bool_compare_and_swap32((int32_t*)&scheduler->custom_data->lent, -1, 0);
+#endif
+  return lone_reaction;
 }
 
+/**
+ * @brief Acquire the scheduling semaphore, spinning and then yielding before blocking on it.
+ *
+ * Blocking is expensive both for the waiting worker, which has to be woken up by the
+ * operating system, and for the worker releasing the semaphore. A worker that is still
+ * polling when work is released picks it up within a few cycles. The number of polls
+ * is given by `scheduler->idle_spin_budget`.
+ */
+static void _lf_sched_idle_acquire(lf_scheduler_t* scheduler) {
+  lf_semaphore_t* semaphore = scheduler->custom_data->semaphore;
+#ifdef LF_SHARED_WORKERS
+  // Until this environment has work for this worker, help the other environments, polling them
+  // rather than blocking, because the semaphore is not released when they have work.
+  while (!lf_semaphore_try_acquire(semaphore)) {
+    if (!_lf_worker_execute_lent_reaction(scheduler->env)) {
+      lf_sleep(LF_SHARED_WORKERS_POLL);
+    }
+  }
+  return;
+#endif
+  size_t budget = scheduler->idle_spin_budget;
+  for (size_t i = 0; i < budget; i++) {
+    if (lf_semaphore_try_acquire(semaphore)) {
+      return;
+    }
+    LF_CPU_RELAX();
+  }
+  // Give other threads a chance to run before blocking.
+  for (size_t i = 0; i < budget && i < LF_SCHED_IDLE_YIELDS; i++) {
+    if (lf_semaphore_try_acquire(semaphore)) {
+      return;
+    }
+    lf_thread_yield();
+  }
+  lf_semaphore_acquire(semaphore);
+}
+
+#ifdef LF_PARALLEL_POP
+/** @brief Handle chunks of the loop of lf_sched_parallel_for() until none is left. */
+static void _lf_sched_run_loop_chunks(custom_scheduler_data_t* data) {
+  while (true) {
+    size_t begin = (size_t)lf_atomic_fetch_add32((int32_t*)&data->loop_next, (int32_t)data->loop_chunk);
+    if (begin >= data->loop_count) {
+      return;
+    }
+    data->loop_body(data->loop_arg, begin, LF_MIN(begin + data->loop_chunk, data->loop_count));
+  }
+}
+
+/**
+ * @brief If the semaphore was acquired with a permit released to wake up a helper, help with the
+ * loop of lf_sched_parallel_for(), if it is still running, and return true, so that the worker
+ * waits again.
+ */
+static bool _lf_sched_help(lf_scheduler_t* scheduler) {
+  custom_scheduler_data_t* data = scheduler->custom_data;
+  int32_t wakeups = data->help_wakeups;
+  while (wakeups > 0 && !lf_atomic_bool_compare_and_swap32((int32_t*)&data->help_wakeups, wakeups, wakeups - 1)) {
+    wakeups = data->help_wakeups;
+  }
+  if (wakeups <= 0) {
+    return false;
+  }
+  lf_atomic_fetch_add32((int32_t*)&data->helpers, 1);
+  // The atomic read orders the reads of the loop after its opening.
+  if (lf_atomic_fetch_add32((int32_t*)&data->loop_open, 0)) {
+    _lf_sched_run_loop_chunks(data);
+  }
+  lf_atomic_fetch_add32((int32_t*)&data->helpers, -1);
+  return true;
+}
+#endif // LF_PARALLEL_POP
+
 /**
  * @brief Wait until the scheduler assigns work.
  *
@@ -199,21 +416,29 @@ static void _lf_scheduler_try_advance_tag_and_distribute(lf_scheduler_t* schedul
  *
  * @param worker_number The worker number of the worker thread asking for work
  * to be assigned to it.
+ * @return A reaction that the calling worker should execute directly, or NULL.
  */
-static void _lf_sched_wait_for_work(lf_scheduler_t* scheduler, size_t worker_number) {
+static reaction_t* _lf_sched_wait_for_work(lf_scheduler_t* scheduler, size_t worker_number) {
   // Increment the number of idle workers by 1 and check if this is the last
   // worker thread to become idle.
   if (lf_atomic_add_fetch32((int32_t*)&scheduler->number_of_idle_workers, 1) == (int)scheduler->number_of_workers) {
     // Last thread to go idle
     LF_PRINT_DEBUG("Scheduler: Worker %zu is the last idle thread.", worker_number);
     // Call on the scheduler to distribute work or advance tag.
-    _lf_scheduler_try_advance_tag_and_distribute(scheduler);
+    return _lf_scheduler_try_advance_tag_and_distribute(scheduler);
   } else {
     // Not the last thread to become idle. Wait for work to be released.
     LF_PRINT_DEBUG("Scheduler: Worker %zu is trying to acquire the scheduling semaphore.", worker_number);
-    lf_semaphore_acquire(scheduler->custom_data->semaphore);
+#ifdef LF_PARALLEL_POP
+    do {
+      _lf_sched_idle_acquire(scheduler);
+    } while (_lf_sched_help(scheduler));
+#else
+    _lf_sched_idle_acquire(scheduler);
+#endif
     LF_PRINT_DEBUG("Scheduler: Worker %zu acquired the scheduling semaphore.", worker_number);
   }
+  return NULL;
 }
 
 ///////////////////// Scheduler Init and Destroy API /////////////////////////
@@ -260,7 +485,13 @@ void lf_sched_init(environment_t* env, size_t number_of_workers, sched_params_t*
 
   env->scheduler->custom_data->semaphore = lf_semaphore_new(0);
 
+  env->scheduler->custom_data->occupied_levels = lf_sched_level_bitmap_new(env->scheduler->max_reaction_level + 1);
+
   env->scheduler->custom_data->next_reaction_level = 1;
+#ifdef LF_SHARED_WORKERS
+  // The reactions at the start tag are not lent, because with enclaves the start tag may not be granted yet.
+  env->scheduler->custom_data->lent = -1;
+#endif
 
   env->scheduler->indexes = (volatile int*)calloc((env->scheduler->max_reaction_level + 1), sizeof(volatile int));
 
@@ -273,6 +504,9 @@ void lf_sched_init(environment_t* env, size_t number_of_workers, sched_params_t*
     }
     // Initialize the reaction vectors
     env->scheduler->custom_data->triggered_reactions[i] = (reaction_t**)calloc(queue_size, sizeof(reaction_t*));
+#ifdef LF_MEMORY_ACCOUNTING
+    env->scheduler->memory_size += queue_size * sizeof(reaction_t*);
+#endif
 
     LF_PRINT_DEBUG("Scheduler: Initialized vector of reactions for level %zu with size %zu", i, queue_size);
 
@@ -280,6 +514,20 @@ void lf_sched_init(environment_t* env, size_t number_of_workers, sched_params_t*
     LF_MUTEX_INIT(&env->scheduler->custom_data->array_of_mutexes[i]);
   }
   env->scheduler->custom_data->executing_reactions = env->scheduler->custom_data->triggered_reactions[0];
+#ifdef LF_TAG_PIPELINING
+  size_t reactions = 0;
+  for (size_t i = 0; i <= env->scheduler->max_reaction_level; i++) {
+    reactions += params->num_reactions_per_level[i];
+  }
+  lf_pipeline_init(env, reactions);
+#endif
+#ifdef LF_MEMORY_ACCOUNTING
+  size_t levels = env->scheduler->max_reaction_level + 1;
+  env->scheduler->memory_size += sizeof(custom_scheduler_data_t) +
+                                 levels * (sizeof(reaction_t**) + sizeof(lf_mutex_t) + sizeof(volatile int)) +
+                                 (levels / 64 + 1) * sizeof(uint64_t);
+  LF_MEMORY_ALLOCATED(lf_memory_scheduler, env->scheduler->memory_size);
+#endif
 }
 
 /**
@@ -295,8 +543,10 @@ void lf_sched_free(lf_scheduler_t* scheduler) {
     free(scheduler->custom_data->triggered_reactions);
   }
   free(scheduler->custom_data->array_of_mutexes);
+  free(scheduler->custom_data->occupied_levels);
   lf_semaphore_destroy(scheduler->custom_data->semaphore);
   free(scheduler->custom_data);
+  LF_MEMORY_FREED(lf_memory_scheduler, scheduler->memory_size);
 }
 
 ///////////////////// Scheduler Worker API (public) /////////////////////////
@@ -343,8 +593,11 @@ reaction_t* lf_sched_get_ready_reaction(lf_scheduler_t* scheduler, int worker_nu
 
     // Ask the scheduler for more work and wait
     tracepoint_worker_wait_starts(scheduler->env, worker_number);
-    _lf_sched_wait_for_work(scheduler, worker_number);
+    reaction_to_return = _lf_sched_wait_for_work(scheduler, worker_number);
     tracepoint_worker_wait_ends(scheduler->env, worker_number);
+    if (reaction_to_return != NULL) {
+      return reaction_to_return;
+    }
   }
 
   // It's time for the worker thread to stop and exit.
@@ -394,4 +647,90 @@ void lf_scheduler_trigger_reaction(lf_scheduler_t* scheduler, reaction_t* reacti
   LF_PRINT_DEBUG("Scheduler: Enqueueing reaction %s, which has level %lld.", reaction->name, LF_LEVEL(reaction->index));
   _lf_sched_insert_reaction(scheduler, reaction);
 }
+
+bool lf_sched_has_earlier_deadline(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  (void)scheduler;
+  (void)reaction;
+  // This scheduler does not order reactions by deadline.
+  return false;
+}
+
+reaction_t* lf_sched_lend_reaction(lf_scheduler_t* scheduler) {
+#if defined(LF_SHARED_WORKERS) && !defined(FEDERATED)
+  custom_scheduler_data_t* data = scheduler == NULL ? NULL : scheduler->custom_data;
+  if (data == NULL) {
+    return NULL;
+  }
+  int32_t lent = data->lent;
+  if (lent < 0 || scheduler->should_stop || !lf_atomic_bool_compare_and_swap32((int32_t*)&data->lent, lent, lent + 1)) {
+    return NULL;
+  }
+  // The level cannot advance until the count is decremented again.
+  size_t current_level = data->next_reaction_level - 1;
+  reaction_t* reaction = NULL;
+  int index = lf_atomic_add_fetch32((int32_t*)&scheduler->indexes[current_level], -1);
+  if (index >= 0) {
+    reaction = data->executing_reactions[index];
+    data->executing_reactions[index] = NULL;
+  }
+  if (reaction == NULL) {
+    lf_atomic_fetch_add32((int32_t*)&data->lent, -1);
+  } else {
+    LF_PRINT_DEBUG("Scheduler: Lending reaction %s with level %zu.", reaction->name, current_level);
+  }
+  return reaction;
+#else
+  (void)scheduler;
+  return NULL;
+#endif
+}
+
+void lf_sched_done_with_lent_reaction(lf_scheduler_t* scheduler, reaction_t* done_reaction) {
+  (void)done_reaction;
+#if defined(LF_SHARED_WORKERS) && !defined(FEDERATED)
+  lf_atomic_fetch_add32((int32_t*)&scheduler->custom_data->lent, -1);
+#else
+  (void)scheduler;
+#endif
+}
+
+void lf_sched_parallel_for(lf_scheduler_t* scheduler, size_t count, lf_sched_loop_body_t body, void* arg) {
+#ifdef LF_PARALLEL_POP
+  custom_scheduler_data_t* data = scheduler->custom_data;
+  // About four chunks for each worker, so that workers that wake up late still find some.
+  size_t chunk = LF_MAX(LF_SCHED_MIN_CHUNK, (count + 4 * scheduler->number_of_workers - 1) /
+                                                (4 * scheduler->number_of_workers));
+  size_t chunks = (count + chunk - 1) / chunk;
+  // The calling thread is counted as idle while it advances the tag. Before the workers start, none is idle.
+  size_t idle = scheduler->number_of_idle_workers;
+  size_t helpers = idle > 0 ? LF_MIN(idle - 1, chunks > 0 ? chunks - 1 : 0) : 0;
+  if (helpers == 0 || count > INT32_MAX) {
+    body(arg, 0, count);
+    return;
+  }
+  // Helpers woken up for an earlier loop may still be checking whether it is running.
+  while (data->helpers > 0) {
+    LF_CPU_RELAX();
+  }
+  data->loop_body = body;
+  data->loop_arg = arg;
+  data->loop_count = count;
+  data->loop_chunk = chunk;
+  data->loop_next = 0;
+  lf_atomic_bool_compare_and_swap32((int32_t*)&data->loop_open, 0, 1);
+  LF_PRINT_DEBUG("Scheduler: Waking up %zu workers to help with %zu items.", helpers, count);
+  lf_atomic_fetch_add32((int32_t*)&data->help_wakeups, (int32_t)helpers);
+  lf_semaphore_release(data->semaphore, (int)helpers);
+  _lf_sched_run_loop_chunks(data);
+  lf_atomic_bool_compare_and_swap32((int32_t*)&data->loop_open, 1, 0);
+  // The chunks claimed by the helpers are done once they have all finished.
+  while (data->helpers > 0) {
+    LF_CPU_RELAX();
+  }
+#else
+  (void)scheduler;
+  // The loop runs on the calling thread.
+  body(arg, 0, count);
+#endif // LF_PARALLEL_POP
+}
 #endif // SCHEDULER == SCHED_NP || !defined(SCHEDULER)
@@ -14,8 +14,12 @@
 #endif // NUMBER_OF_WORKERS
 
 #include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "environment.h"
+#include "reactor_common.h"
 #include "scheduler_sync_tag_advance.h"
 #include "scheduler.h"
 #include "environment.h"
@@ -29,6 +33,36 @@
 #define MAX_REACTION_LEVEL INITIAL_REACT_QUEUE_SIZE
 #endif
 
+/**
+ * The number of tags between two updates of the numbers of workers used for each level, once the
+ * scheduler has learned from its first tags. The execution times of the levels are measured on one
+ * tag of each period, so larger values make the measurements cheaper and the adaptation slower.
+ */
+#ifndef LF_SCHED_ADAPTIVE_PERIOD
+#define LF_SCHED_ADAPTIVE_PERIOD 130
+#endif
+#if LF_SCHED_ADAPTIVE_PERIOD < 2
+#error "LF_SCHED_ADAPTIVE_PERIOD must be at least 2"
+#endif
+
+/**
+ * Once the execution time of a level with its best number of workers is known, the level is
+ * measured only on one in LF_SCHED_ADAPTIVE_REFRESH of the tags on which times are measured,
+ * so that the scheduler still notices if the level gets slower or faster.
+ */
+#ifndef LF_SCHED_ADAPTIVE_REFRESH
+#define LF_SCHED_ADAPTIVE_REFRESH 8
+#endif
+
+/**
+ * On Linux, idle workers wait on a futex rather than on the condition variables of their groups,
+ * so that the worker that advances the level wakes exactly the workers it needs with one system
+ * call, and the awakened workers do not contend for the mutex of the environment.
+ */
+#if defined(PLATFORM_Linux)
+#define WORKER_STATES_FUTEX
+#endif
+
 /////////////////// Forward declarations /////////////////////////
 extern bool fast;
 static void worker_states_lock(lf_scheduler_t* scheduler, size_t worker);
@@ -39,6 +73,8 @@ static void data_collection_start_level(lf_scheduler_t* scheduler, size_t level)
 static void data_collection_end_level(lf_scheduler_t* scheduler, size_t level, size_t num_workers);
 static void data_collection_end_tag(lf_scheduler_t* scheduler, size_t* num_workers_by_level,
                                     size_t* max_num_workers_by_level);
+static void data_collection_load(lf_scheduler_t* scheduler);
+static void data_collection_save(lf_scheduler_t* scheduler);
 /**
  * The level counter is a number that changes whenever the current level changes.
  *
@@ -49,10 +85,17 @@ static void data_collection_end_tag(lf_scheduler_t* scheduler, size_t* num_worke
 
 /////////////////// Scheduler Variables and Structs /////////////////////////
 typedef struct {
+#ifdef WORKER_STATES_FUTEX
+  /** The futex on which idle workers wait. It is incremented whenever workers are awakened. */
+  volatile uint32_t generation;
+  /** The generation at which each worker was last awakened, or at which it last awakened others. */
+  volatile uint32_t* awakened_at;
+#else
   /** An array of condition variables, each corresponding to a group of workers. */
   lf_cond_t* worker_conds;
   /** The cumsum of the sizes of the groups of workers corresponding to each successive cond. */
   size_t* cumsum_of_worker_group_sizes;
+#endif
   /** The number of non-waiting threads. */
   volatile size_t num_loose_threads;
   /** The number of threads that were awakened for the purpose of executing the current level. */
@@ -72,6 +115,8 @@ typedef struct {
   size_t* num_workers_by_level;
   /** The number of levels. */
   size_t num_levels;
+  /** The levels at which reactions have been triggered, so that empty levels are skipped. */
+  uint64_t* occupied_levels;
   /** The maximum number of workers that can be used to execute any level. */
   size_t max_num_workers;
   /** The following values apply to the current level. */
@@ -82,6 +127,10 @@ typedef struct {
   reaction_t*** reactions_by_worker;
   /** The total number of workers active, including those who have finished their work. */
   size_t num_workers;
+  /** The number of workers that the CPU quota of the process allows, at most max_num_workers. */
+  size_t quota_num_workers;
+  /** The physical time at which the CPU quota was last read. */
+  instant_t quota_read_time;
 } worker_assignments_t;
 
 typedef struct {
@@ -93,6 +142,14 @@ typedef struct {
   bool collecting_data;
   size_t* possible_nums_workers;
   size_t num_levels;
+  /** The number of times each level was measured with its best number of workers, up to SETTLED_SAMPLES. */
+  size_t* samples_by_level;
+  /** The number of tags on which execution times were measured. */
+  size_t num_measured_tags;
+  /** Whether the levels whose execution times are known are measured on the current tag. */
+  bool refreshing;
+  /** Hash of the number of reactions at each level and of the number of workers. */
+  uint64_t graph_hash;
 } data_collection_t;
 
 typedef struct custom_scheduler_data_t {
@@ -106,6 +163,7 @@ typedef struct custom_scheduler_data_t {
 
 ///////////////////////// Scheduler Private Functions ///////////////////////////
 
+#ifndef WORKER_STATES_FUTEX
 /**
  * @brief Return the index of the condition variable used by worker.
  *
@@ -123,6 +181,7 @@ static size_t cond_of(size_t worker) {
   }
   return ret;
 }
+#endif // WORKER_STATES_FUTEX
 
 ///////////////////////// Private Worker Assignments Functions ///////////////////////////
 
@@ -162,12 +221,14 @@ static void worker_assignments_init(lf_scheduler_t* scheduler, size_t number_of_
   worker_assignments_t* worker_assignments = scheduler->custom_data->worker_assignments;
   worker_assignments->num_levels = params->num_reactions_per_level_size;
   worker_assignments->max_num_workers = number_of_workers;
+  worker_assignments->quota_num_workers = number_of_workers;
   worker_assignments->reactions_by_worker_by_level =
       (reaction_t****)malloc(sizeof(reaction_t***) * worker_assignments->num_levels);
   worker_assignments->num_reactions_by_worker_by_level =
       (size_t**)malloc(sizeof(size_t*) * worker_assignments->num_levels);
   worker_assignments->num_workers_by_level = (size_t*)malloc(sizeof(size_t) * worker_assignments->num_levels);
   worker_assignments->max_num_workers_by_level = (size_t*)malloc(sizeof(size_t) * worker_assignments->num_levels);
+  worker_assignments->occupied_levels = lf_sched_level_bitmap_new(worker_assignments->num_levels);
   for (size_t level = 0; level < worker_assignments->num_levels; level++) {
     size_t num_reactions = params->num_reactions_per_level[level];
     size_t num_workers =
@@ -197,6 +258,7 @@ static void worker_assignments_free(lf_scheduler_t* scheduler) {
   }
   free(worker_assignments->max_num_workers_by_level);
   free(worker_assignments->num_workers_by_level);
+  free(worker_assignments->occupied_levels);
 }
 
 /**
@@ -284,17 +346,23 @@ static void worker_assignments_put(lf_scheduler_t* scheduler, reaction_t* reacti
   size_t num_preceding_reactions =
       lf_atomic_fetch_add32((int32_t*)&worker_assignments->num_reactions_by_worker_by_level[level][worker], 1);
   worker_assignments->reactions_by_worker_by_level[level][worker][num_preceding_reactions] = reaction;
+  lf_sched_level_bitmap_set(worker_assignments->occupied_levels, level);
 }
 
 ///////////////////////// Private Worker States Functions ///////////////////////////
 
 static void worker_states_init(lf_scheduler_t* scheduler, size_t number_of_workers) {
   worker_states_t* worker_states = scheduler->custom_data->worker_states;
+  worker_states->mutex_held = (bool*)calloc(number_of_workers, sizeof(bool));
+  worker_states->num_loose_threads = scheduler->number_of_workers;
+#ifdef WORKER_STATES_FUTEX
+  worker_states->awakened_at = (volatile uint32_t*)calloc(number_of_workers, sizeof(uint32_t));
+  LF_ASSERT_NON_NULL(worker_states->awakened_at);
+#else
   size_t greatest_worker_number = number_of_workers - 1;
   size_t num_conds = cond_of(greatest_worker_number) + 1;
   worker_states->worker_conds = (lf_cond_t*)malloc(sizeof(lf_cond_t) * num_conds);
   worker_states->cumsum_of_worker_group_sizes = (size_t*)calloc(num_conds, sizeof(size_t));
-  worker_states->mutex_held = (bool*)calloc(number_of_workers, sizeof(bool));
   for (size_t i = 0; i < number_of_workers; i++) {
     worker_states->cumsum_of_worker_group_sizes[cond_of(i)]++;
   }
@@ -304,16 +372,41 @@ static void worker_states_init(lf_scheduler_t* scheduler, size_t number_of_worke
   for (size_t i = 0; i < num_conds; i++) {
     LF_COND_INIT(worker_states->worker_conds + i, &scheduler->env->mutex);
   }
-  worker_states->num_loose_threads = scheduler->number_of_workers;
+#endif
 }
 
 static void worker_states_free(lf_scheduler_t* scheduler) {
   // FIXME: Why do the condition variables and mutexes not need to be freed?
   worker_states_t* worker_states = scheduler->custom_data->worker_states;
+#ifdef WORKER_STATES_FUTEX
+  free((void*)worker_states->awakened_at);
+#else
   free(worker_states->worker_conds);
+#endif
   free(worker_states->mutex_held);
 }
 
+#ifdef WORKER_STATES_FUTEX
+/**
+ * @brief Return the bit of the futex mask of the given worker. Workers beyond the 31st share the
+ * last bit, so waking one of them wakes all of them, and the others go back to sleep.
+ */
+static uint32_t futex_bit_of(size_t worker) { return (uint32_t)1 << LF_MIN(worker, (size_t)31); }
+#endif
+
+/**
+ * @brief Return a value that the given worker passes to worker_states_sleep_and_unlock() and
+ * that changes when the worker is next awakened.
+ */
+static size_t worker_states_snapshot(lf_scheduler_t* scheduler, size_t worker) {
+#ifdef WORKER_STATES_FUTEX
+  return __atomic_load_n(&scheduler->custom_data->worker_states->awakened_at[worker], __ATOMIC_ACQUIRE);
+#else
+  (void)worker;
+  return scheduler->custom_data->level_counter;
+#endif
+}
+
 /**
  * @brief Awaken the workers scheduled to work on the current level.
  *
@@ -329,6 +422,21 @@ static void worker_states_awaken_locked(lf_scheduler_t* scheduler, size_t worker
     worker_states->num_loose_threads = 1;
     return;
   }
+#ifdef WORKER_STATES_FUTEX
+  // The awakened workers check the generation at which they were awakened, so no lock is needed.
+  // Workers 0 to num_to_awaken - 1 are awakened, and the calling worker carries on.
+  worker_states->num_loose_threads = num_to_awaken + (worker >= num_to_awaken);
+  worker_states->num_awakened = num_to_awaken;
+  uint32_t generation = worker_states->generation + 1;
+  uint32_t mask = 0;
+  for (size_t i = 0; i < num_to_awaken; i++) {
+    __atomic_store_n(&worker_states->awakened_at[i], generation, __ATOMIC_RELEASE);
+    mask |= futex_bit_of(i);
+  }
+  __atomic_store_n(&worker_states->awakened_at[worker], generation, __ATOMIC_RELEASE);
+  __atomic_store_n(&worker_states->generation, generation, __ATOMIC_RELEASE);
+  lf_futex_wake(&worker_states->generation, mask);
+#else
   size_t greatest_worker_number_to_awaken = num_to_awaken - 1;
   size_t max_cond = cond_of(greatest_worker_number_to_awaken);
   if (!worker_states->mutex_held[worker]) {
@@ -344,6 +452,7 @@ static void worker_states_awaken_locked(lf_scheduler_t* scheduler, size_t worker
   for (size_t cond = 0; cond <= max_cond; cond++) {
     lf_cond_broadcast(worker_states->worker_conds + cond);
   }
+#endif
 }
 
 /** Lock the global mutex if needed. */
@@ -394,15 +503,39 @@ static bool worker_states_finished_with_level_locked(lf_scheduler_t* scheduler,
  * This should be called by the given worker when the worker will do nothing for the remainder of
  * the execution of the current level.
  *
+ * With the futex, the worker first polls for its awakening `scheduler->idle_spin_budget` times,
+ * which spares it the system calls if the other workers finish the level soon.
+ *
  * @param worker The number of the calling worker.
- * @param level_counter_snapshot The value of the level counter at the time of the decision to
+ * @param snapshot The value returned by worker_states_snapshot() at the time of the decision to
  * sleep.
  */
-static void worker_states_sleep_and_unlock(lf_scheduler_t* scheduler, size_t worker, size_t level_counter_snapshot) {
+static void worker_states_sleep_and_unlock(lf_scheduler_t* scheduler, size_t worker, size_t snapshot) {
   worker_states_t* worker_states = scheduler->custom_data->worker_states;
   worker_assignments_t* worker_assignments = scheduler->custom_data->worker_assignments;
   LF_ASSERT(worker < worker_assignments->max_num_workers, "Sched: Invalid worker");
   LF_ASSERT(worker_states->num_loose_threads <= worker_assignments->max_num_workers, "Sched: Too many loose threads");
+#ifdef WORKER_STATES_FUTEX
+  if (worker_states->mutex_held[worker]) {
+    worker_states->mutex_held[worker] = false;
+    LF_MUTEX_UNLOCK(&scheduler->env->mutex);
+  }
+  size_t budget = scheduler->idle_spin_budget;
+  while (true) {
+    // Read the generation first, so that an awakening after the check makes the wait return at once.
+    uint32_t generation = __atomic_load_n(&worker_states->generation, __ATOMIC_ACQUIRE);
+    if (worker_states_snapshot(scheduler, worker) != snapshot) {
+      return;
+    }
+    if (budget > 0) {
+      budget--;
+      LF_CPU_RELAX();
+    } else {
+      lf_futex_wait(&worker_states->generation, generation, futex_bit_of(worker));
+    }
+  }
+#else
+  size_t level_counter_snapshot = snapshot;
   if (!worker_states->mutex_held[worker]) {
     LF_MUTEX_LOCK(&scheduler->env->mutex);
   }
@@ -416,6 +549,37 @@ static void worker_states_sleep_and_unlock(lf_scheduler_t* scheduler, size_t wor
   LF_ASSERT(!worker_states->mutex_held[worker],
             "Sched: Worker doesnt hold the mutex"); // This thread holds the mutex, but it did not report that.
   LF_MUTEX_UNLOCK(&scheduler->env->mutex);
+#endif
+}
+
+/** Minimum physical time between two readings of the CPU quota of the process. */
+#define QUOTA_READ_INTERVAL SEC(1)
+
+/**
+ * @brief Limit the number of workers used for each level to the number of cores that the CPU
+ * quota of the process allows, reading the quota at most once per QUOTA_READ_INTERVAL.
+ * Workers beyond the limit stay asleep until the quota grows again. This must be called between
+ * tags, when no reactions are queued, because queued reactions are assigned to workers.
+ */
+static void worker_assignments_update_quota(lf_scheduler_t* scheduler) {
+#if defined(PLATFORM_Linux)
+  worker_assignments_t* worker_assignments = scheduler->custom_data->worker_assignments;
+  instant_t now = lf_time_physical();
+  if (now - worker_assignments->quota_read_time < QUOTA_READ_INTERVAL) {
+    return;
+  }
+  worker_assignments->quota_read_time = now;
+  size_t quota = LF_MIN((size_t)lf_cpu_quota_cores(), worker_assignments->max_num_workers);
+  if (quota != worker_assignments->quota_num_workers) {
+    LF_PRINT_LOG("Scheduler: The CPU quota allows %zu of %zu workers.", quota, worker_assignments->max_num_workers);
+    worker_assignments->quota_num_workers = quota;
+    for (size_t level = 0; level < worker_assignments->num_levels; level++) {
+      worker_assignments->num_workers_by_level[level] = LF_MIN(worker_assignments->num_workers_by_level[level], quota);
+    }
+  }
+#else
+  (void)scheduler;
+#endif
 }
 
 /**
@@ -428,6 +592,7 @@ static void advance_level_and_unlock(lf_scheduler_t* scheduler, size_t worker) {
   size_t total_num_reactions;
   while (true) {
     if (worker_assignments->current_level == max_level) {
+      worker_assignments_update_quota(scheduler);
       data_collection_end_tag(scheduler, worker_assignments->num_workers_by_level,
                               worker_assignments->max_num_workers_by_level);
       set_level(scheduler, 0);
@@ -443,8 +608,16 @@ static void advance_level_and_unlock(lf_scheduler_t* scheduler, size_t worker) {
 #endif
       total_num_reactions = get_num_reactions(scheduler);
       if (!total_num_reactions) {
-        worker_assignments->current_level++;
-        set_level(scheduler, worker_assignments->current_level);
+        // Skip the levels at which no reaction has been triggered, stopping at the maximum level.
+        size_t level = lf_sched_level_bitmap_next(worker_assignments->occupied_levels,
+                                                  worker_assignments->current_level + 1, max_level);
+#ifdef FEDERATED
+        // Network input reactions can still be triggered at levels whose input statuses are not known,
+        // so stall at each of those rather than skipping it.
+        level = LF_MIN(level, LF_MAX(lf_max_level_allowed_to_advance_locked(), worker_assignments->current_level + 1));
+#endif
+        lf_sched_level_bitmap_clear(worker_assignments->occupied_levels, level);
+        set_level(scheduler, level);
       }
     }
     total_num_reactions = get_num_reactions(scheduler);
@@ -469,6 +642,8 @@ static void advance_level_and_unlock(lf_scheduler_t* scheduler, size_t worker) {
 #define START_EXPERIMENTS 8
 #define SLOW_EXPERIMENTS 256
 #define EXECUTION_TIME_MEMORY 15
+/** The number of measurements after which the execution time of a level is considered known. */
+#define SETTLED_SAMPLES (EXECUTION_TIME_MEMORY + 1)
 
 /** @brief Initialize the possible_nums_workers array. */
 static void possible_nums_workers_init(lf_scheduler_t* scheduler) {
@@ -540,12 +715,20 @@ static void data_collection_init(lf_scheduler_t* scheduler, sched_params_t* para
       (interval_t**)calloc(data_collection->num_levels, sizeof(interval_t*));
   data_collection->execution_times_mins = (interval_t*)calloc(data_collection->num_levels, sizeof(interval_t));
   data_collection->execution_times_argmins = (size_t*)calloc(data_collection->num_levels, sizeof(size_t));
+  data_collection->samples_by_level = (size_t*)calloc(data_collection->num_levels, sizeof(size_t));
   for (size_t i = 0; i < data_collection->num_levels; i++) {
     data_collection->execution_times_argmins[i] = worker_assignments->max_num_workers;
     data_collection->execution_times_by_num_workers_by_level[i] =
         (interval_t*)calloc(worker_assignments->max_num_workers + 1, // Add 1 for 1-based indexing
                             sizeof(interval_t));
   }
+  // FNV-1a hash of the shape of the reaction graph, which saved state is only valid for.
+  uint64_t hash = 14695981039346656037ULL;
+  hash = (hash ^ worker_assignments->max_num_workers) * 1099511628211ULL;
+  for (size_t i = 0; i < data_collection->num_levels; i++) {
+    hash = (hash ^ params->num_reactions_per_level[i]) * 1099511628211ULL;
+  }
+  data_collection->graph_hash = hash;
   possible_nums_workers_init(scheduler);
 }
 
@@ -558,13 +741,28 @@ static void data_collection_free(lf_scheduler_t* scheduler) {
   }
   free(data_collection->execution_times_by_num_workers_by_level);
   free(data_collection->possible_nums_workers);
+  free(data_collection->samples_by_level);
+}
+
+/**
+ * @brief Return whether the execution time of the given level with the number of workers that it
+ * uses should be measured on the current tag, which is the case unless that number is the best one
+ * and its execution time is known.
+ */
+static bool data_collection_is_uncertain(lf_scheduler_t* scheduler, size_t level) {
+  data_collection_t* data_collection = scheduler->custom_data->data_collection;
+  size_t num_workers = scheduler->custom_data->worker_assignments->num_workers_by_level[level];
+  return data_collection->refreshing || num_workers != data_collection->execution_times_argmins[level] ||
+         data_collection->samples_by_level[level] < SETTLED_SAMPLES;
 }
 
 /** @brief Record that the execution of the given level is beginning. */
 static void data_collection_start_level(lf_scheduler_t* scheduler, size_t level) {
   data_collection_t* data_collection = scheduler->custom_data->data_collection;
+  // A start time of zero means that the level is not measured.
   if (data_collection->collecting_data)
-    data_collection->start_times_by_level[level] = lf_time_physical();
+    data_collection->start_times_by_level[level] =
+        data_collection_is_uncertain(scheduler, level) ? lf_time_physical() : 0;
 }
 
 /** @brief Record that the execution of the given level has completed. */
@@ -580,6 +778,10 @@ static void data_collection_end_level(lf_scheduler_t* scheduler, size_t level, s
     }
     interval_t* prior_et = &data_collection->execution_times_by_num_workers_by_level[level][num_workers];
     *prior_et = (*prior_et * EXECUTION_TIME_MEMORY + dt) / (EXECUTION_TIME_MEMORY + 1);
+    if (num_workers == data_collection->execution_times_argmins[level] &&
+        data_collection->samples_by_level[level] < SETTLED_SAMPLES) {
+      data_collection->samples_by_level[level]++;
+    }
   }
 }
 
@@ -608,7 +810,8 @@ static void compute_number_of_workers(lf_scheduler_t* scheduler, size_t* num_wor
     interval_t this_execution_time =
         data_collection->execution_times_by_num_workers_by_level[level][num_workers_by_level[level]];
     size_t ideal_number_of_workers;
-    size_t max_reasonable_num_workers = max_num_workers_by_level[level];
+    size_t max_reasonable_num_workers =
+        LF_MIN(max_num_workers_by_level[level], scheduler->custom_data->worker_assignments->quota_num_workers);
     ideal_number_of_workers = data_collection->execution_times_argmins[level];
     if (jitter) {
       ideal_number_of_workers =
@@ -631,6 +834,10 @@ static void compute_costs(lf_scheduler_t* scheduler, size_t* num_workers_by_leve
     interval_t score = data_collection->execution_times_by_num_workers_by_level[level][num_workers_by_level[level]];
     if (!data_collection->execution_times_mins[level] | (score < data_collection->execution_times_mins[level]) |
         (num_workers_by_level[level] == data_collection->execution_times_argmins[level])) {
+      if (num_workers_by_level[level] != data_collection->execution_times_argmins[level]) {
+        // The execution time with the new best number of workers has to be learned anew.
+        data_collection->samples_by_level[level] = 0;
+      }
       data_collection->execution_times_mins[level] = score;
       data_collection->execution_times_argmins[level] = num_workers_by_level[level];
     }
@@ -646,22 +853,136 @@ static void compute_costs(lf_scheduler_t* scheduler, size_t* num_workers_by_leve
 static void data_collection_end_tag(lf_scheduler_t* scheduler, size_t* num_workers_by_level,
                                     size_t* max_num_workers_by_level) {
   data_collection_t* data_collection = scheduler->custom_data->data_collection;
-  if (data_collection->collecting_data && data_collection->start_times_by_level[0]) {
+  if (data_collection->collecting_data) {
     compute_costs(scheduler, num_workers_by_level);
   }
   data_collection->data_collection_counter++;
-  size_t period = 2 + 128 * (data_collection->data_collection_counter > SLOW_EXPERIMENTS);
+  size_t period = (data_collection->data_collection_counter > SLOW_EXPERIMENTS) ? LF_SCHED_ADAPTIVE_PERIOD : 2;
   size_t state = data_collection->data_collection_counter % period;
   if (state == 0) {
     compute_number_of_workers(scheduler, num_workers_by_level, max_num_workers_by_level,
                               data_collection->data_collection_counter > START_EXPERIMENTS);
     data_collection->collecting_data = true;
+    // The current level is about to end, but it started before the measurements did.
+    data_collection->start_times_by_level[scheduler->custom_data->worker_assignments->current_level] = 0;
+    data_collection->refreshing = ++data_collection->num_measured_tags % LF_SCHED_ADAPTIVE_REFRESH == 0;
   } else if (state == 1) {
     compute_number_of_workers(scheduler, num_workers_by_level, max_num_workers_by_level, false);
     data_collection->collecting_data = false;
   }
 }
 
+/////////////////// Persistence of the Learned State /////////////////////////
+/*
+ * If a file is given with the --sched-state command-line argument, the number of workers used for
+ * each level and the execution times measured so far are written to it when the scheduler is freed
+ * and read from it when the scheduler is initialized, so that a restarted program does not have to
+ * learn them again. The file of the environment with ID n > 0 has the suffix ".n". The state is
+ * ignored if the number of workers or the number of reactions at any level has changed.
+ */
+
+#define STATE_FILE_HEADER "lf-adaptive-scheduler-state 1"
+
+/** @brief Write the name of the state file of the environment of the scheduler to `name`. */
+static void state_file_name(lf_scheduler_t* scheduler, char* name, size_t size) {
+  if (scheduler->env->id == 0) {
+    snprintf(name, size, "%s", _lf_sched_state_file);
+  } else {
+    snprintf(name, size, "%s.%d", _lf_sched_state_file, scheduler->env->id);
+  }
+}
+
+/** @brief Replace the learned state by the state in the state file, if it is valid. */
+static void data_collection_load(lf_scheduler_t* scheduler) {
+  if (_lf_sched_state_file == NULL) {
+    return;
+  }
+  data_collection_t* data_collection = scheduler->custom_data->data_collection;
+  worker_assignments_t* worker_assignments = scheduler->custom_data->worker_assignments;
+  char name[256];
+  state_file_name(scheduler, name, sizeof(name));
+  FILE* file = fopen(name, "r");
+  if (file == NULL) {
+    LF_PRINT_LOG("Scheduler: No saved state in %s.", name);
+    return;
+  }
+  char header[64];
+  uint64_t hash;
+  size_t counter;
+  if (fgets(header, sizeof(header), file) == NULL || strncmp(header, STATE_FILE_HEADER, strlen(STATE_FILE_HEADER)) ||
+      fscanf(file, "%" SCNx64 " %zu", &hash, &counter) != 2 || hash != data_collection->graph_hash) {
+    LF_PRINT_LOG("Scheduler: Ignoring the saved state in %s because the program has changed.", name);
+    fclose(file);
+    return;
+  }
+  // Read into temporary arrays so that a truncated file leaves the state untouched.
+  size_t num_levels = data_collection->num_levels;
+  size_t num_times = worker_assignments->max_num_workers + 1;
+  size_t* num_workers = (size_t*)calloc(num_levels * 2, sizeof(size_t));
+  interval_t* times = (interval_t*)calloc(num_levels * (num_times + 1), sizeof(interval_t));
+  LF_ASSERT_NON_NULL(num_workers);
+  LF_ASSERT_NON_NULL(times);
+  bool valid = true;
+  for (size_t level = 0; valid && level < num_levels; level++) {
+    size_t* workers = &num_workers[level * 2];                 // Number of workers and argmin.
+    interval_t* level_times = &times[level * (num_times + 1)]; // Min, then by number of workers.
+    valid = fscanf(file, "%zu %zu %" SCNd64, &workers[0], &workers[1], &level_times[0]) == 3 &&
+            workers[0] <= worker_assignments->max_num_workers_by_level[level] &&
+            workers[1] <= worker_assignments->max_num_workers;
+    for (size_t i = 0; valid && i < num_times; i++) {
+      valid = fscanf(file, "%" SCNd64, &level_times[i + 1]) == 1;
+    }
+  }
+  fclose(file);
+  if (valid) {
+    for (size_t level = 0; level < num_levels; level++) {
+      worker_assignments->num_workers_by_level[level] = num_workers[level * 2];
+      data_collection->execution_times_argmins[level] = num_workers[level * 2 + 1];
+      data_collection->execution_times_mins[level] = times[level * (num_times + 1)];
+      memcpy(data_collection->execution_times_by_num_workers_by_level[level], &times[level * (num_times + 1) + 1],
+             num_times * sizeof(interval_t));
+    }
+    worker_assignments->num_workers = worker_assignments->num_workers_by_level[worker_assignments->current_level];
+    data_collection->data_collection_counter = counter;
+    LF_PRINT_LOG("Scheduler: Restored the state saved in %s.", name);
+  } else {
+    lf_print_warning("Ignoring the malformed adaptive scheduler state in %s.", name);
+  }
+  free(num_workers);
+  free(times);
+}
+
+/** @brief Write the learned state to the state file. */
+static void data_collection_save(lf_scheduler_t* scheduler) {
+  if (_lf_sched_state_file == NULL) {
+    return;
+  }
+  data_collection_t* data_collection = scheduler->custom_data->data_collection;
+  worker_assignments_t* worker_assignments = scheduler->custom_data->worker_assignments;
+  char name[256];
+  state_file_name(scheduler, name, sizeof(name));
+  FILE* file = fopen(name, "w");
+  if (file == NULL) {
+    lf_print_warning("Could not write the adaptive scheduler state to %s.", name);
+    return;
+  }
+  fprintf(file, "%s\n%" PRIx64 " %zu\n", STATE_FILE_HEADER, data_collection->graph_hash,
+          data_collection->data_collection_counter);
+  // One line per level: the number of workers, the best number of workers, its execution
+  // time, and the execution times for each number of workers.
+  for (size_t level = 0; level < data_collection->num_levels; level++) {
+    fprintf(file, "%zu %zu %" PRId64, worker_assignments->num_workers_by_level[level],
+            data_collection->execution_times_argmins[level], data_collection->execution_times_mins[level]);
+    for (size_t i = 0; i <= worker_assignments->max_num_workers; i++) {
+      fprintf(file, " %" PRId64, data_collection->execution_times_by_num_workers_by_level[level][i]);
+    }
+    fprintf(file, "\n");
+  }
+  if (fclose(file) != 0) {
+    lf_print_warning("Could not write the adaptive scheduler state to %s.", name);
+  }
+}
+
 ///////////////////// Scheduler Init and Destroy API /////////////////////////
 void lf_sched_init(environment_t* env, size_t number_of_workers, sched_params_t* params) {
   assert(env != GLOBAL_ENVIRONMENT);
@@ -687,9 +1008,11 @@ void lf_sched_init(environment_t* env, size_t number_of_workers, sched_params_t*
   worker_assignments_init(scheduler, number_of_workers, params);
 
   data_collection_init(scheduler, params);
+  data_collection_load(scheduler);
 }
 
 void lf_sched_free(lf_scheduler_t* scheduler) {
+  data_collection_save(scheduler);
   worker_states_free(scheduler);
   worker_assignments_free(scheduler);
   data_collection_free(scheduler);
@@ -702,14 +1025,14 @@ reaction_t* lf_sched_get_ready_reaction(lf_scheduler_t* scheduler, int worker_nu
   assert(worker_number >= 0);
   reaction_t* ret;
   while (true) {
-    size_t level_counter_snapshot = scheduler->custom_data->level_counter;
+    size_t snapshot = worker_states_snapshot(scheduler, worker_number);
     ret = worker_assignments_get_or_lock(scheduler, worker_number);
     if (ret)
       return ret;
     if (worker_states_finished_with_level_locked(scheduler, worker_number)) {
       advance_level_and_unlock(scheduler, worker_number);
     } else {
-      worker_states_sleep_and_unlock(scheduler, worker_number, level_counter_snapshot);
+      worker_states_sleep_and_unlock(scheduler, worker_number, snapshot);
     }
     if (scheduler->custom_data->should_stop) {
       return NULL;
@@ -730,4 +1053,28 @@ void lf_scheduler_trigger_reaction(lf_scheduler_t* scheduler, reaction_t* reacti
     return;
   worker_assignments_put(scheduler, reaction);
 }
+
+bool lf_sched_has_earlier_deadline(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  (void)scheduler;
+  (void)reaction;
+  // This scheduler does not order reactions by deadline.
+  return false;
+}
+
+reaction_t* lf_sched_lend_reaction(lf_scheduler_t* scheduler) {
+  (void)scheduler;
+  // This scheduler does not lend reactions to other environments.
+  return NULL;
+}
+
+void lf_sched_done_with_lent_reaction(lf_scheduler_t* scheduler, reaction_t* done_reaction) {
+  (void)scheduler;
+  (void)done_reaction;
+}
+
+void lf_sched_parallel_for(lf_scheduler_t* scheduler, size_t count, lf_sched_loop_body_t body, void* arg) {
+  (void)scheduler;
+  // The loop runs on the calling thread.
+  body(arg, 0, count);
+}
 #endif // defined SCHEDULER && SCHEDULER == SCHED_ADAPTIVE
@@ -0,0 +1,601 @@
+/**
+ * @file
+ * @brief Dataflow scheduler for the threaded runtime of the C target of Lingua Franca.
+ *
+ * The other schedulers execute the reactions of a tag level by level, so a slow reaction
+ * holds back every reaction at higher levels, even those that do not depend on it. This
+ * scheduler instead releases a triggered reaction as soon as no reaction that it may depend
+ * on is still queued or executing.
+ *
+ * When a reaction is first triggered, the scheduler computes its blocks from the triggers of
+ * its outputs. A block is a reactor and a threshold level: while the reaction is queued or
+ * executing, the reactions of that reactor at levels above the threshold may not start.
+ * A reaction _R_ blocks the reactions of its own reactor, of the reactors whose ports its
+ * outputs write, and, transitively, everything blocked by the reactions that those ports
+ * trigger, all above the level of _R_. The threshold of a port with no reactions to trigger
+ * is global: it blocks the reactions of all reactors, as does the level barrier of the other
+ * schedulers. A reaction with more than LF_SCHED_DATAFLOW_MAX_BLOCKS blocks also gets a
+ * global threshold instead, which bounds the bookkeeping of long chains.
+ *
+ * Each reactor keeps a count of the thresholds of the reactions that are queued or executing.
+ * When the smallest of them rises, the reactions waiting on the reactor are checked again.
+ * The reaction at the lowest level that is queued or executing is never blocked, so the
+ * execution never deadlocks. The ready reactions are executed in the order of their
+ * (inferred) deadlines, then their levels, as in the GEDF_NP scheduler.
+ *
+ * All bookkeeping is under the mutex of the environment.
+ */
+#include "lf_types.h"
+
+#if defined SCHEDULER && SCHEDULER == SCHED_DATAFLOW
+
+#ifdef FEDERATED
+#error "The dataflow scheduler does not support federated execution."
+#endif
+
+#ifndef NUMBER_OF_WORKERS
+#define NUMBER_OF_WORKERS 1
+#endif // NUMBER_OF_WORKERS
+
+/** The largest number of blocks of a reaction before it blocks all reactors. */
+#ifndef LF_SCHED_DATAFLOW_MAX_BLOCKS
+#define LF_SCHED_DATAFLOW_MAX_BLOCKS 64
+#endif
+
+/** The number of reactions assumed if the scheduler parameters do not give the number per level. */
+#define DEFAULT_NUM_REACTIONS 1024
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "low_level_platform.h"
+#include "environment.h"
+#include "pqueue.h"
+#include "reactor_threaded.h"
+#include "scheduler_instance.h"
+#include "scheduler_sync_tag_advance.h"
+#include "scheduler.h"
+#include "tracepoint.h"
+#include "util.h"
+#include "vector.h"
+
+#define HASHMAP(token) dataflow_map##_##token
+#define K void*
+#define V void*
+#define HASH_OF(key) (size_t)(((uintptr_t)(key) >> 4) * 2654435761u)
+#include "core/utils/impl/hashmap.h"
+#undef HASHMAP
+#undef K
+#undef V
+#undef HASH_OF
+
+/** A threshold of the reactions of a reactor, with the number of reactions that have it. */
+typedef struct dataflow_threshold_t {
+  size_t threshold;
+  size_t count;
+} dataflow_threshold_t;
+
+/** The bookkeeping of a reactor. */
+typedef struct dataflow_reactor_t {
+  dataflow_threshold_t* thresholds; // Sorted by threshold.
+  size_t num_thresholds;
+  size_t capacity;
+  reaction_t* waiting; // Reactions blocked by a threshold of this reactor, linked by `next_queued`.
+} dataflow_reactor_t;
+
+/** A block: the reactions of `reactor` above level `threshold` may not start. */
+typedef struct dataflow_block_t {
+  dataflow_reactor_t* reactor;
+  size_t threshold;
+} dataflow_block_t;
+
+/** The dependencies of a reaction. */
+typedef struct dataflow_reaction_t {
+  dataflow_reactor_t* reactor; // The reactor of the reaction.
+  size_t level;
+  dataflow_block_t* blocks;
+  size_t num_blocks;
+  size_t global_threshold; // SIZE_MAX if the reaction blocks no reactor other than those of `blocks`.
+} dataflow_reaction_t;
+
+// Data specific to the dataflow scheduler.
+typedef struct custom_scheduler_data_t {
+  dataflow_map_t* reactions; // Maps each reaction that has been triggered to its dataflow_reaction_t.
+  dataflow_map_t* reactors;  // Maps the self struct of each reactor to its dataflow_reactor_t.
+  size_t* global_counts;     // The number of global thresholds at each level.
+  uint64_t* global_levels;   // The levels at which global_counts is not zero.
+  reaction_t* waiting;       // Reactions blocked by a global threshold, linked by `next_queued`.
+  vector_t triggered;        // Reactions that have been triggered and not yet checked.
+  pqueue_t* ready;           // Reactions that may start.
+  size_t num_active;         // The number of reactions that have been triggered and are not done.
+  lf_cond_t changed;
+  bool solo_holds_mutex; // Indicates sole thread holds the mutex.
+} custom_scheduler_data_t;
+
+/////////////////// Scheduler Private API /////////////////////////
+
+/** @brief Return the smallest threshold of the reactions of `reactor`, or SIZE_MAX if there is none. */
+static size_t reactor_threshold(dataflow_reactor_t* reactor) {
+  return reactor->num_thresholds > 0 ? reactor->thresholds[0].threshold : SIZE_MAX;
+}
+
+/** @brief Return the smallest global threshold, or a level above all levels if there is none. */
+static size_t global_threshold(lf_scheduler_t* scheduler) {
+  return lf_sched_level_bitmap_next(scheduler->custom_data->global_levels, 0, scheduler->max_reaction_level + 1);
+}
+
+/** @brief Return the level at which the global threshold of `record` is counted, or SIZE_MAX if it has none. */
+static size_t global_level(lf_scheduler_t* scheduler, dataflow_reaction_t* record) {
+  return record->global_threshold == SIZE_MAX ? SIZE_MAX
+                                              : LF_MIN(record->global_threshold, scheduler->max_reaction_level);
+}
+
+/** @brief Add a threshold to the thresholds of `reactor`. */
+static void add_threshold(dataflow_reactor_t* reactor, size_t threshold) {
+  size_t i = 0;
+  while (i < reactor->num_thresholds && reactor->thresholds[i].threshold < threshold) {
+    i++;
+  }
+  if (i < reactor->num_thresholds && reactor->thresholds[i].threshold == threshold) {
+    reactor->thresholds[i].count++;
+    return;
+  }
+  if (reactor->num_thresholds == reactor->capacity) {
+    reactor->capacity = reactor->capacity == 0 ? 4 : 2 * reactor->capacity;
+    reactor->thresholds =
+        (dataflow_threshold_t*)realloc(reactor->thresholds, reactor->capacity * sizeof(dataflow_threshold_t));
+    LF_ASSERT_NON_NULL(reactor->thresholds);
+  }
+  memmove(&reactor->thresholds[i + 1], &reactor->thresholds[i],
+          (reactor->num_thresholds - i) * sizeof(dataflow_threshold_t));
+  reactor->thresholds[i] = (dataflow_threshold_t){.threshold = threshold, .count = 1};
+  reactor->num_thresholds++;
+}
+
+/**
+ * @brief Remove a threshold that was added to the thresholds of `reactor`.
+ * @return Whether the smallest threshold of the reactor rose.
+ */
+static bool remove_threshold(dataflow_reactor_t* reactor, size_t threshold) {
+  size_t i = 0;
+  while (reactor->thresholds[i].threshold != threshold) {
+    i++;
+  }
+  if (--reactor->thresholds[i].count > 0) {
+    return false;
+  }
+  reactor->num_thresholds--;
+  memmove(&reactor->thresholds[i], &reactor->thresholds[i + 1],
+          (reactor->num_thresholds - i) * sizeof(dataflow_threshold_t));
+  return i == 0;
+}
+
+/**
+ * @brief Return the entry of `key` in `map`, which is empty if the key has no entry yet.
+ * Exit with an error if the map is full.
+ */
+static dataflow_map_entry_t* map_entry(dataflow_map_t* map, void* key) {
+  // Keep the map at most half full so that lookups stay short.
+  dataflow_map_entry_t* entry = dataflow_map_get_actual_address(map, key);
+  if (entry == NULL || (entry->key == NULL && ++map->num_entries > map->capacity / 2)) {
+    lf_print_error_and_exit("Dataflow scheduler: More reactions than the %zu given to lf_sched_init.",
+                            map->capacity / 2);
+  }
+  return entry;
+}
+
+/** @brief Return the bookkeeping of the reactor with the given self struct. */
+static dataflow_reactor_t* reactor_record(lf_scheduler_t* scheduler, void* self) {
+  dataflow_map_entry_t* entry = map_entry(scheduler->custom_data->reactors, self);
+  if (entry->key == NULL) {
+    entry->key = self;
+    entry->value = calloc(1, sizeof(dataflow_reactor_t));
+    LF_ASSERT_NON_NULL(entry->value);
+  }
+  return (dataflow_reactor_t*)entry->value;
+}
+
+/** @brief Add a block to `record`, or lower the threshold of the block it already has for the reactor. */
+static void add_block(dataflow_reaction_t* record, dataflow_reactor_t* reactor, size_t threshold) {
+  for (size_t i = 0; i < record->num_blocks; i++) {
+    if (record->blocks[i].reactor == reactor) {
+      record->blocks[i].threshold = LF_MIN(record->blocks[i].threshold, threshold);
+      return;
+    }
+  }
+  if (record->num_blocks == LF_SCHED_DATAFLOW_MAX_BLOCKS) {
+    // Too many reactors to track separately. Block all of them.
+    record->global_threshold = LF_MIN(record->global_threshold, record->level);
+    return;
+  }
+  record->blocks[record->num_blocks++] = (dataflow_block_t){.reactor = reactor, .threshold = threshold};
+}
+
+/**
+ * @brief Return the dependencies of `reaction`, computing them, and those of the reactions downstream
+ * of it, the first time.
+ */
+static dataflow_reaction_t* reaction_record(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  dataflow_map_entry_t* entry = dataflow_map_get_actual_address(scheduler->custom_data->reactions, reaction);
+  if (entry != NULL && entry->key == reaction) {
+    return (dataflow_reaction_t*)entry->value;
+  }
+  dataflow_reaction_t* record = (dataflow_reaction_t*)calloc(1, sizeof(dataflow_reaction_t));
+  LF_ASSERT_NON_NULL(record);
+  record->blocks = (dataflow_block_t*)calloc(LF_SCHED_DATAFLOW_MAX_BLOCKS, sizeof(dataflow_block_t));
+  LF_ASSERT_NON_NULL(record->blocks);
+  record->reactor = reactor_record(scheduler, reaction->self);
+  record->level = LF_LEVEL(reaction->index);
+  record->global_threshold = SIZE_MAX;
+  add_block(record, record->reactor, record->level);
+  for (size_t i = 0; i < reaction->num_outputs; i++) {
+    for (int j = 0; j < reaction->triggered_sizes[i]; j++) {
+      trigger_t* trigger = reaction->triggers[i][j];
+      if (trigger == NULL) {
+        continue;
+      }
+      if (trigger->number_of_reactions == 0) {
+        // The reactor that reads the port is not known.
+        record->global_threshold = LF_MIN(record->global_threshold, record->level);
+      }
+      for (int k = 0; k < trigger->number_of_reactions; k++) {
+        reaction_t* downstream = trigger->reactions[k];
+        if (downstream == NULL) {
+          continue;
+        }
+        // Reactions of the reactor that read the port without being triggered by it are blocked too.
+        add_block(record, reactor_record(scheduler, downstream->self), record->level);
+        dataflow_reaction_t* downstream_record = reaction_record(scheduler, downstream);
+        for (size_t b = 0; b < downstream_record->num_blocks; b++) {
+          add_block(record, downstream_record->blocks[b].reactor, downstream_record->blocks[b].threshold);
+        }
+        record->global_threshold = LF_MIN(record->global_threshold, downstream_record->global_threshold);
+      }
+    }
+  }
+  if (record->global_threshold == record->level) {
+    // The global threshold subsumes all blocks.
+    record->num_blocks = 0;
+  }
+  if (record->num_blocks == 0) {
+    free(record->blocks);
+    record->blocks = NULL;
+  } else {
+    record->blocks = (dataflow_block_t*)realloc(record->blocks, record->num_blocks * sizeof(dataflow_block_t));
+    LF_ASSERT_NON_NULL(record->blocks);
+  }
+  // The recursion may have filled the entry found above.
+  entry = map_entry(scheduler->custom_data->reactions, reaction);
+  entry->key = reaction;
+  entry->value = record;
+  LF_PRINT_DEBUG("Scheduler: Reaction %s has %zu blocks.", reaction->name, record->num_blocks);
+  return record;
+}
+
+/** @brief Return the list on which `reaction` has to wait, or NULL if it may start. */
+static reaction_t** waiting_list(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  dataflow_reaction_t* record = reaction_record(scheduler, reaction);
+  if (global_threshold(scheduler) < record->level) {
+    return &scheduler->custom_data->waiting;
+  }
+  if (reactor_threshold(record->reactor) < record->level) {
+    return &record->reactor->waiting;
+  }
+  return NULL;
+}
+
+/** @brief Put `reaction` on the ready queue or on the list on which it has to wait. */
+static void place(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  reaction_t** list = waiting_list(scheduler, reaction);
+  if (list == NULL) {
+    pqueue_insert(scheduler->custom_data->ready, reaction);
+  } else {
+    reaction->next_queued = *list;
+    *list = reaction;
+  }
+}
+
+/** @brief Place again all reactions that were waiting on `list`. */
+static void release(lf_scheduler_t* scheduler, reaction_t** list) {
+  reaction_t* reaction = *list;
+  *list = NULL;
+  while (reaction != NULL) {
+    reaction_t* next = reaction->next_queued;
+    place(scheduler, reaction);
+    reaction = next;
+  }
+}
+
+/** @brief Add the blocks of a reaction that has been triggered. */
+static void activate(lf_scheduler_t* scheduler, dataflow_reaction_t* record) {
+  for (size_t i = 0; i < record->num_blocks; i++) {
+    add_threshold(record->blocks[i].reactor, record->blocks[i].threshold);
+  }
+  size_t level = global_level(scheduler, record);
+  if (level != SIZE_MAX) {
+    if (scheduler->custom_data->global_counts[level]++ == 0) {
+      lf_sched_level_bitmap_set(scheduler->custom_data->global_levels, level);
+    }
+  }
+  scheduler->custom_data->num_active++;
+}
+
+/** @brief Remove the blocks of a reaction that is done and place the reactions that they no longer block. */
+static void deactivate(lf_scheduler_t* scheduler, dataflow_reaction_t* record) {
+  for (size_t i = 0; i < record->num_blocks; i++) {
+    if (remove_threshold(record->blocks[i].reactor, record->blocks[i].threshold)) {
+      release(scheduler, &record->blocks[i].reactor->waiting);
+    }
+  }
+  size_t level = global_level(scheduler, record);
+  if (level != SIZE_MAX) {
+    bool lowest = global_threshold(scheduler) == level;
+    if (--scheduler->custom_data->global_counts[level] == 0) {
+      lf_sched_level_bitmap_clear(scheduler->custom_data->global_levels, level);
+      if (lowest) {
+        release(scheduler, &scheduler->custom_data->waiting);
+      }
+    }
+  }
+  scheduler->custom_data->num_active--;
+}
+
+/**
+ * @brief Return whether a reaction that is about to execute inline after `root`, without being triggered,
+ * is blocked by a reaction other than `root`.
+ */
+static bool blocked_by_others(lf_scheduler_t* scheduler, dataflow_reaction_t* record, dataflow_reaction_t* root) {
+  size_t limit = record->level;
+  size_t root_level = global_level(scheduler, root);
+  size_t level = lf_sched_level_bitmap_next(scheduler->custom_data->global_levels, 0, limit);
+  while (level < limit) {
+    if (level != root_level || scheduler->custom_data->global_counts[level] > 1) {
+      return true;
+    }
+    level = lf_sched_level_bitmap_next(scheduler->custom_data->global_levels, level + 1, limit);
+  }
+  size_t root_threshold = SIZE_MAX;
+  for (size_t i = 0; i < root->num_blocks; i++) {
+    if (root->blocks[i].reactor == record->reactor) {
+      root_threshold = root->blocks[i].threshold;
+    }
+  }
+  dataflow_reactor_t* reactor = record->reactor;
+  for (size_t i = 0; i < reactor->num_thresholds && reactor->thresholds[i].threshold < limit; i++) {
+    if (reactor->thresholds[i].threshold != root_threshold || reactor->thresholds[i].count > 1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Mark the calling thread idle and wait for notification of a change.
+ * @param scheduler The scheduler.
+ * @param worker_number The number of the worker thread.
+ */
+static void wait_for_changes(lf_scheduler_t* scheduler, int worker_number) {
+  scheduler->number_of_idle_workers++;
+  tracepoint_worker_wait_starts(scheduler->env, worker_number);
+  LF_COND_WAIT(&scheduler->custom_data->changed);
+  tracepoint_worker_wait_ends(scheduler->env, worker_number);
+  scheduler->number_of_idle_workers--;
+}
+
+/**
+ * @brief Assuming this is the last worker to go idle, advance the tag.
+ * @param scheduler The scheduler.
+ * @return Non-zero if the stop tag has been reached.
+ */
+static int advance_tag(lf_scheduler_t* scheduler) {
+  // Set a flag in the scheduler that the lock is held by the sole executing thread.
+  // This prevents acquiring the mutex in lf_scheduler_trigger_reaction.
+  scheduler->custom_data->solo_holds_mutex = true;
+  if (_lf_sched_advance_tag_locked(scheduler)) {
+    LF_PRINT_DEBUG("Scheduler: Reached stop tag.");
+    scheduler->should_stop = true;
+    scheduler->custom_data->solo_holds_mutex = false;
+    // Notify all threads that the stop tag has been reached.
+    LF_COND_BROADCAST(&scheduler->custom_data->changed);
+    return 1;
+  }
+  scheduler->custom_data->solo_holds_mutex = false;
+  return 0;
+}
+
+///////////////////// Scheduler Init and Destroy API /////////////////////////
+/**
+ * @brief Initialize the scheduler.
+ *
+ * This has to be called before other functions of the scheduler can be used.
+ * If the scheduler is already initialized, this will be a no-op.
+ *
+ * @param env Environment within which we are executing.
+ * @param number_of_workers Indicate how many workers this scheduler will be
+ *  managing.
+ * @param option Pointer to a `sched_params_t` struct containing additional
+ *  scheduler parameters.
+ */
+void lf_sched_init(environment_t* env, size_t number_of_workers, sched_params_t* params) {
+  assert(env != GLOBAL_ENVIRONMENT);
+
+  LF_PRINT_DEBUG("Scheduler: Initializing with %zu workers", number_of_workers);
+  if (!init_sched_instance(env, &env->scheduler, number_of_workers, params)) {
+    // Already initialized
+    return;
+  }
+  lf_scheduler_t* scheduler = env->scheduler;
+
+  scheduler->custom_data = (custom_scheduler_data_t*)calloc(1, sizeof(custom_scheduler_data_t));
+  LF_ASSERT_NON_NULL(scheduler->custom_data);
+
+  size_t num_reactions = DEFAULT_NUM_REACTIONS;
+  if (params != NULL && params->num_reactions_per_level != NULL) {
+    num_reactions = 0;
+    for (size_t i = 0; i < params->num_reactions_per_level_size; i++) {
+      num_reactions += params->num_reactions_per_level[i];
+    }
+  }
+  // A reactor has at least one reaction, so both maps have at most num_reactions entries.
+  scheduler->custom_data->reactions = dataflow_map_new(2 * num_reactions + 1, NULL);
+  scheduler->custom_data->reactors = dataflow_map_new(2 * num_reactions + 1, NULL);
+  scheduler->custom_data->global_counts = (size_t*)calloc(scheduler->max_reaction_level + 1, sizeof(size_t));
+  scheduler->custom_data->global_levels = lf_sched_level_bitmap_new(scheduler->max_reaction_level + 1);
+  LF_ASSERT_NON_NULL(scheduler->custom_data->global_counts);
+  LF_ASSERT_NON_NULL(scheduler->custom_data->global_levels);
+  scheduler->custom_data->triggered = vector_new(INITIAL_REACT_QUEUE_SIZE);
+  scheduler->custom_data->ready =
+      pqueue_init(INITIAL_REACT_QUEUE_SIZE, in_reverse_order, get_reaction_index, get_reaction_position,
+                  set_reaction_position, reaction_matches, print_reaction);
+
+  LF_COND_INIT(&scheduler->custom_data->changed, &env->mutex);
+}
+
+/**
+ * @brief Free the memory used by the scheduler.
+ *
+ * This must be called when the scheduler is no longer needed.
+ */
+void lf_sched_free(lf_scheduler_t* scheduler) {
+  custom_scheduler_data_t* data = scheduler->custom_data;
+  for (size_t i = 0; i < data->reactions->capacity; i++) {
+    if (data->reactions->entries[i].key != NULL) {
+      free(((dataflow_reaction_t*)data->reactions->entries[i].value)->blocks);
+      free(data->reactions->entries[i].value);
+    }
+  }
+  for (size_t i = 0; i < data->reactors->capacity; i++) {
+    if (data->reactors->entries[i].key != NULL) {
+      free(((dataflow_reactor_t*)data->reactors->entries[i].value)->thresholds);
+      free(data->reactors->entries[i].value);
+    }
+  }
+  dataflow_map_free(data->reactions);
+  dataflow_map_free(data->reactors);
+  free(data->global_counts);
+  free(data->global_levels);
+  vector_free(&data->triggered);
+  pqueue_free(data->ready);
+  free(data);
+}
+
+///////////////////// Scheduler Worker API (public) /////////////////////////
+
+reaction_t* lf_sched_get_ready_reaction(lf_scheduler_t* scheduler, int worker_number) {
+  custom_scheduler_data_t* data = scheduler->custom_data;
+  LF_MUTEX_LOCK(&scheduler->env->mutex);
+
+  // Iterate until the stop_tag is reached or the event queue is empty.
+  while (!scheduler->should_stop) {
+    // Reactions are checked only here, so that a batch of reactions triggered together, such as
+    // the reactions at the start of a tag, all block each other before any of them may start.
+    reaction_t* reaction;
+    while ((reaction = (reaction_t*)vector_pop(&data->triggered)) != NULL) {
+      place(scheduler, reaction);
+    }
+    reaction = (reaction_t*)pqueue_pop(data->ready);
+    if (reaction != NULL) {
+      LF_PRINT_DEBUG("Scheduler: Worker %d got reaction %s.", worker_number, reaction->name);
+      if (pqueue_size(data->ready) > 0 && scheduler->number_of_idle_workers > 0) {
+        LF_COND_SIGNAL(&data->changed);
+      }
+      LF_MUTEX_UNLOCK(&scheduler->env->mutex);
+      return reaction;
+    }
+    if (data->num_active == 0 && scheduler->number_of_idle_workers == scheduler->number_of_workers - 1) {
+      // Last thread to go idle
+      LF_PRINT_DEBUG("Scheduler: Worker %d is advancing the tag.", worker_number);
+      if (advance_tag(scheduler)) {
+        // Stop tag has been reached.
+        break;
+      }
+    } else {
+      // Other workers are executing reactions, which may trigger or release more.
+      wait_for_changes(scheduler, worker_number);
+    }
+  }
+
+  // It's time for the worker thread to stop and exit.
+  LF_MUTEX_UNLOCK(&scheduler->env->mutex);
+  return NULL;
+}
+
+void lf_sched_done_with_reaction(size_t worker_number, reaction_t* done_reaction) {
+  (void)worker_number; // Suppress unused parameter warning.
+  lf_scheduler_t* scheduler = ((self_base_t*)done_reaction->self)->environment->scheduler;
+  LF_MUTEX_LOCK(&scheduler->env->mutex);
+  deactivate(scheduler, reaction_record(scheduler, done_reaction));
+  if (scheduler->number_of_idle_workers > 0 &&
+      (pqueue_size(scheduler->custom_data->ready) > 0 || vector_size(&scheduler->custom_data->triggered) > 0 ||
+       scheduler->custom_data->num_active == 0)) {
+    LF_COND_SIGNAL(&scheduler->custom_data->changed);
+  }
+  if (!lf_atomic_bool_compare_and_swap32((int32_t*)&done_reaction->status, queued, inactive)) {
+    lf_print_error_and_exit("Unexpected reaction status: %d. Expected %d.", done_reaction->status, queued);
+  }
+  LF_MUTEX_UNLOCK(&scheduler->env->mutex);
+}
+
+void lf_scheduler_trigger_reaction(lf_scheduler_t* scheduler, reaction_t* reaction, int worker_number) {
+  (void)worker_number; // Suppress unused parameter warning.
+  if (reaction == NULL || !lf_atomic_bool_compare_and_swap32((int32_t*)&reaction->status, inactive, queued)) {
+    return;
+  }
+  LF_PRINT_DEBUG("Scheduler: Triggering reaction %s, which has level %lld.", reaction->name,
+                 LF_LEVEL(reaction->index));
+  if (!scheduler->custom_data->solo_holds_mutex) {
+    LF_MUTEX_LOCK(&scheduler->env->mutex);
+  }
+  activate(scheduler, reaction_record(scheduler, reaction));
+  vector_push(&scheduler->custom_data->triggered, reaction);
+  if (!scheduler->custom_data->solo_holds_mutex) {
+    if (scheduler->number_of_idle_workers > 0) {
+      LF_COND_SIGNAL(&scheduler->custom_data->changed);
+    }
+    LF_MUTEX_UNLOCK(&scheduler->env->mutex);
+  }
+}
+
+bool lf_sched_has_earlier_deadline(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  // This is asked before executing `reaction` inline, after the reactions that uniquely enable it,
+  // without triggering it. Find the reaction that was triggered at the start of that chain.
+  reaction_t* root = reaction->last_enabling_reaction;
+  while (root != NULL && root->status != queued) {
+    root = root->last_enabling_reaction;
+  }
+  if (root == NULL) {
+    return true;
+  }
+  if (!scheduler->custom_data->solo_holds_mutex) {
+    LF_MUTEX_LOCK(&scheduler->env->mutex);
+  }
+  // The blocks of the root cover the reactions downstream of it, including `reaction`, but the
+  // reaction may also depend on other reactions that are queued or executing.
+  bool result = blocked_by_others(scheduler, reaction_record(scheduler, reaction), reaction_record(scheduler, root));
+  // The ready queue is sorted by index, which has the deadline in its high-order bits.
+  reaction_t* head = (reaction_t*)pqueue_peek(scheduler->custom_data->ready);
+  result = result || (head != NULL && (head->index >> 16) < (reaction->index >> 16));
+  if (!scheduler->custom_data->solo_holds_mutex) {
+    LF_MUTEX_UNLOCK(&scheduler->env->mutex);
+  }
+  return result;
+}
+
+reaction_t* lf_sched_lend_reaction(lf_scheduler_t* scheduler) {
+  (void)scheduler;
+  // This scheduler does not lend reactions to other environments.
+  return NULL;
+}
+
+void lf_sched_done_with_lent_reaction(lf_scheduler_t* scheduler, reaction_t* done_reaction) {
+  (void)scheduler;
+  (void)done_reaction;
+}
+
+void lf_sched_parallel_for(lf_scheduler_t* scheduler, size_t count, lf_sched_loop_body_t body, void* arg) {
+  (void)scheduler;
+  // The loop runs on the calling thread.
+  body(arg, 0, count);
+}
+#endif // SCHEDULER == SCHED_DATAFLOW
@@ -15,6 +15,7 @@
 #include "reactor.h"
 #include "lf_types.h"
 #include "util.h"
+#include "memory_accounting.h"
 
 bool init_sched_instance(environment_t* env, lf_scheduler_t** instance, size_t number_of_workers,
                          sched_params_t* params) {
@@ -30,6 +31,7 @@ bool init_sched_instance(environment_t* env, lf_scheduler_t** instance, size_t n
     return false;
   } else {
     *instance = (lf_scheduler_t*)calloc(1, sizeof(lf_scheduler_t));
+    LF_MEMORY_ALLOCATED(lf_memory_scheduler, sizeof(lf_scheduler_t));
   }
   LF_MUTEX_UNLOCK(&env->mutex);
 
@@ -37,10 +39,15 @@ bool init_sched_instance(environment_t* env, lf_scheduler_t** instance, size_t n
     (*instance)->max_reaction_level = DEFAULT_MAX_REACTION_LEVEL;
   }
 
+  (*instance)->idle_spin_budget = LF_SCHED_IDLE_SPIN_BUDGET;
+
   if (params != NULL) {
     if (params->num_reactions_per_level != NULL) {
       (*instance)->max_reaction_level = params->num_reactions_per_level_size - 1;
     }
+    if (params->idle_spin_budget != 0) {
+      (*instance)->idle_spin_budget = params->idle_spin_budget;
+    }
   }
 
   (*instance)->number_of_workers = number_of_workers;
@@ -50,3 +57,65 @@ bool init_sched_instance(environment_t* env, lf_scheduler_t** instance, size_t n
 
   return true;
 }
+
+void lf_sched_set_idle_spin_budget(lf_scheduler_t* scheduler, size_t budget) { scheduler->idle_spin_budget = budget; }
+
+/** @brief Return the index of the lowest set bit of `bits`, which is not zero. */
+static size_t lowest_bit(uint64_t bits) {
+#if defined(__GNUC__)
+  return (size_t)__builtin_ctzll(bits);
+#else
+  size_t result = 0;
+  for (; !(bits & 1); bits >>= 1) {
+    result++;
+  }
+  return result;
+#endif
+}
+
+uint64_t* lf_sched_level_bitmap_new(size_t num_levels) {
+  return (uint64_t*)calloc(num_levels / 64 + 1, sizeof(uint64_t));
+}
+
+void lf_sched_level_bitmap_set(volatile uint64_t* bitmap, size_t level) {
+  volatile uint64_t* word = &bitmap[level / 64];
+  uint64_t bit = 1ULL << (level % 64);
+  // Most reactions are triggered at levels that are already set, which needs no atomic operation.
+  uint64_t old = *word;
+  while (!(old & bit)) {
+    uint64_t seen = (uint64_t)lf_atomic_val_compare_and_swap64((int64_t*)word, (int64_t)old, (int64_t)(old | bit));
+    if (seen == old) {
+      break;
+    }
+    old = seen;
+  }
+}
+
+void lf_sched_level_bitmap_clear(volatile uint64_t* bitmap, size_t level) {
+  volatile uint64_t* word = &bitmap[level / 64];
+  uint64_t bit = 1ULL << (level % 64);
+  uint64_t old = *word;
+  while (old & bit) {
+    uint64_t seen = (uint64_t)lf_atomic_val_compare_and_swap64((int64_t*)word, (int64_t)old, (int64_t)(old & ~bit));
+    if (seen == old) {
+      break;
+    }
+    old = seen;
+  }
+}
+
+size_t lf_sched_level_bitmap_next(volatile uint64_t* bitmap, size_t level, size_t limit) {
+  if (level >= limit) {
+    return limit;
+  }
+  size_t index = level / 64;
+  uint64_t bits = bitmap[index] & (~0ULL << (level % 64));
+  while (bits == 0) {
+    if (++index * 64 >= limit) {
+      return limit;
+    }
+    bits = bitmap[index];
+  }
+  size_t result = index * 64 + lowest_bit(bits);
+  return result < limit ? result : limit;
+}
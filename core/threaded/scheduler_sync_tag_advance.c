@@ -15,6 +15,9 @@
 #include "environment.h"
 #include "tracepoint.h"
 #include "util.h"
+#ifdef FEDERATED
+#include "federate.h"
+#endif
 
 // Forward declaration of function defined in reactor_threaded.h
 void _lf_next_locked(struct environment_t* env);
@@ -38,6 +41,10 @@ bool should_stop_locked(lf_scheduler_t* sched) {
 
 bool _lf_sched_advance_tag_locked(lf_scheduler_t* sched) {
   environment_t* env = sched->env;
+#ifdef FEDERATED
+  // Messages sent at this tag must be written before this federate reports completing the tag.
+  lf_flush_outbound_messages();
+#endif
   logical_tag_complete(env->current_tag);
 
 // If we are using scheduling enclaves. Notify the local RTI of the time
@@ -46,7 +53,15 @@ bool _lf_sched_advance_tag_locked(lf_scheduler_t* sched) {
   rti_logical_tag_complete_locked(env->enclave_info, env->current_tag);
 #endif
 
-  if (should_stop_locked(sched)) {
+  bool stop = should_stop_locked(sched);
+#if defined(FEDERATED) && defined(LF_FEDERATED_OPTIMISTIC)
+  // Execution rolls back if a straggler arrived, which it waits for at the stop tag until the
+  // speculative tags are committed.
+  if (lf_optimistic_roll_back_locked(env, stop)) {
+    stop = false;
+  }
+#endif
+  if (stop) {
     return true;
   }
 
@@ -0,0 +1,531 @@
+/**
+ * @file
+ * @author Soroush Bateni
+ * @author Edward A. Lee
+ * @copyright (c) 2020-2024, The University of California at Berkeley.
+ * License: <a href="https://github.com/lf-lang/reactor-c/blob/main/LICENSE.md">BSD 2-clause</a>
+ * @brief Non-preemptive work-stealing scheduler for the threaded runtime of the C target of Lingua Franca.
+ *
+ * This scheduler follows the level-by-level execution strategy of the NP scheduler
+ * (see scheduler_NP.c), but instead of one shared array of triggered reactions per
+ * level, every worker owns one array (deque) per level. A triggered reaction is placed
+ * in the deque of the worker given by the `worker_affinity` of its reactor, which is
+ * updated to the worker that last executed a reaction of the reactor, so that the
+ * reactions that access the state of a reactor stay on one worker across tags. A worker
+ * first drains its own deque for the current level and then steals from the deques of
+ * the other workers.
+ *
+ * Because reactions can only be triggered at a level strictly greater than the level
+ * currently executing (except for network input reactions in federated execution, which
+ * are protected by a per-level mutex as in the NP scheduler), pushes into a deque and
+ * pops from it never overlap in time. Both the owner and thieves can therefore claim
+ * entries with a single atomic decrement of the owner's per-level index. Contention is
+ * thus spread over one counter per worker instead of one counter per level.
+ *
+ * Idle workers wait on their own semaphore so that the worker that advances the level
+ * can wake up, first, the workers that have work in their own deques. Workers going idle
+ * arrive at a combining tree rather than a single counter, so that finding the last
+ * idle worker, which advances the level or the tag, does not contend on one cache line.
+ */
+#include "lf_types.h"
+
+#if defined SCHEDULER && SCHEDULER == SCHED_WORK_STEALING
+
+#ifndef NUMBER_OF_WORKERS
+#define NUMBER_OF_WORKERS 1
+#endif // NUMBER_OF_WORKERS
+
+#include <assert.h>
+
+#include "low_level_platform.h"
+#include "environment.h"
+#include "scheduler_instance.h"
+#include "scheduler_sync_tag_advance.h"
+#include "scheduler.h"
+#include "lf_semaphore.h"
+#include "lf_combining_tree.h"
+#include "tracepoint.h"
+#include "util.h"
+#include "reactor_threaded.h"
+
+#ifdef FEDERATED
+#include "federate.h"
+#endif
+
+/**
+ * @brief Number of per-level indexes that fit in a cache line.
+ *
+ * The indexes of one worker are padded to a multiple of this so that the counters of
+ * different workers do not share a cache line.
+ */
+#define INDEXES_PER_CACHE_LINE (64 / sizeof(int))
+
+// Data specific to the work-stealing scheduler.
+typedef struct custom_scheduler_data_t {
+  reaction_t**** triggered_reactions; // Indexed by worker number, then level.
+  size_t index_stride;                // Distance in `scheduler->indexes` between two workers.
+  lf_mutex_t* array_of_mutexes;       // One per level. Only used in federated execution.
+  lf_semaphore_t** semaphores;        // One per worker. Idle workers wait on their own semaphore.
+  lf_combining_tree_t* idle_workers;  // The workers that are idle.
+  size_t* workers_to_awaken;          // Scratch space for _lf_sched_notify_workers.
+  volatile size_t next_reaction_level;
+} custom_scheduler_data_t;
+
+/////////////////// Scheduler Private API /////////////////////////
+
+/**
+ * @brief Return a pointer to the index of the deque of `worker` at `level`.
+ */
+static inline volatile int* _lf_sched_index(lf_scheduler_t* scheduler, size_t worker, size_t level) {
+  return &scheduler->indexes[worker * scheduler->custom_data->index_stride + level];
+}
+
+/**
+ * @brief Return the worker that 'reaction' has affinity to, which is that of its reactor,
+ * if it has one.
+ */
+static inline size_t _lf_sched_affinity(reaction_t* reaction) {
+  self_base_t* self = (self_base_t*)reaction->self;
+  return (self != NULL) ? self->worker_affinity : reaction->worker_affinity;
+}
+
+/**
+ * @brief Insert 'reaction' into the deque of the worker it has affinity to at the
+ * appropriate level.
+ *
+ * @param reaction The reaction to insert.
+ */
+static inline void _lf_sched_insert_reaction(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  size_t reaction_level = LF_LEVEL(reaction->index);
+  size_t owner = _lf_sched_affinity(reaction) % scheduler->number_of_workers;
+  volatile int* index = _lf_sched_index(scheduler, owner, reaction_level);
+#ifdef FEDERATED
+  // Lock the mutex if federated because a federate can insert reactions with
+  // a level equal to the current level. See scheduler_NP.c for why the race on
+  // `next_reaction_level` is benign.
+  size_t current_level = scheduler->custom_data->next_reaction_level - 1;
+  if (reaction_level == current_level) {
+    LF_MUTEX_LOCK(&scheduler->custom_data->array_of_mutexes[reaction_level]);
+  }
+  // The index for the current level can become negative. Set it back to zero
+  // before adding a reaction (otherwise worker threads will not be able to see
+  // the added reaction).
+  if (*index < 0) {
+    *index = 0;
+  }
+#endif
+  int reaction_q_level_index = lf_atomic_fetch_add32((int32_t*)index, 1);
+  assert(reaction_q_level_index >= 0);
+  LF_PRINT_DEBUG("Scheduler: Inserting reaction at level %zu of worker %zu with index %d.", reaction_level, owner,
+                 reaction_q_level_index);
+  scheduler->custom_data->triggered_reactions[owner][reaction_level][reaction_q_level_index] = reaction;
+#ifdef FEDERATED
+  if (reaction_level == current_level) {
+    LF_MUTEX_UNLOCK(&scheduler->custom_data->array_of_mutexes[reaction_level]);
+  }
+#endif
+}
+
+/**
+ * @brief Try to claim one reaction from the deque of `victim` at `level`.
+ *
+ * @return The claimed reaction or NULL if the deque is empty.
+ */
+static inline reaction_t* _lf_sched_pop_reaction(lf_scheduler_t* scheduler, size_t victim, size_t level) {
+  volatile int* index = _lf_sched_index(scheduler, victim, level);
+  // Check before decrementing to avoid writing to the cache line of an empty deque.
+  if (*index <= 0) {
+    return NULL;
+  }
+  int q_index = lf_atomic_add_fetch32((int32_t*)index, -1);
+  if (q_index < 0) {
+    return NULL;
+  }
+  reaction_t** reactions = scheduler->custom_data->triggered_reactions[victim][level];
+  reaction_t* reaction = reactions[q_index];
+  reactions[q_index] = NULL;
+  return reaction;
+}
+
+/**
+ * @brief Return the number of reactions waiting at `level` over all workers.
+ *
+ * This assumes that all workers are idle.
+ */
+static size_t _lf_sched_reactions_at_level(lf_scheduler_t* scheduler, size_t level) {
+  size_t count = 0;
+  for (size_t w = 0; w < scheduler->number_of_workers; w++) {
+    int index = *_lf_sched_index(scheduler, w, level);
+    if (index > 0) {
+      count += (size_t)index;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Advance `next_reaction_level` up to the first level with triggered reactions.
+ *
+ * @return The number of reactions ready at the new current level, 0 if there are none.
+ */
+static size_t _lf_sched_distribute_ready_reactions(lf_scheduler_t* scheduler) {
+  // Note: All the threads are idle, which means that they are done inserting
+  // reactions. Therefore, the deques can be accessed without locking a mutex.
+  while (scheduler->custom_data->next_reaction_level <= scheduler->max_reaction_level) {
+#ifdef FEDERATED
+    lf_stall_advance_level_federation(scheduler->env, scheduler->custom_data->next_reaction_level);
+#endif
+    size_t count = _lf_sched_reactions_at_level(scheduler, scheduler->custom_data->next_reaction_level);
+    scheduler->custom_data->next_reaction_level++;
+    if (count > 0) {
+      return count;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Wake up as many workers as there are ready reactions, preferring the
+ * workers that have work in their own deques.
+ *
+ * This assumes that all workers other than `worker_number` are idle.
+ *
+ * @param ready_reactions The number of reactions ready at the current level.
+ * @param worker_number The worker calling this function. It is not woken up.
+ */
+static void _lf_sched_notify_workers(lf_scheduler_t* scheduler, size_t ready_reactions, size_t worker_number) {
+  size_t workers_to_awaken = LF_MIN(scheduler->number_of_idle_workers, ready_reactions);
+  LF_PRINT_DEBUG("Scheduler: Notifying %zu workers.", workers_to_awaken);
+
+  scheduler->number_of_idle_workers -= workers_to_awaken;
+  LF_PRINT_DEBUG("Scheduler: New number of idle workers: %zu.", scheduler->number_of_idle_workers);
+
+  // The calling worker counts as one of the awakened workers.
+  size_t* awaken = scheduler->custom_data->workers_to_awaken;
+  size_t count = 0;
+  awaken[count++] = worker_number;
+  size_t level = scheduler->custom_data->next_reaction_level - 1;
+  // In the first pass, choose workers that own work. In the second, choose thieves.
+  for (int pass = 0; pass < 2 && count < workers_to_awaken; pass++) {
+    for (size_t i = 1; i < scheduler->number_of_workers && count < workers_to_awaken; i++) {
+      size_t w = (worker_number + i) % scheduler->number_of_workers;
+      bool has_work = *_lf_sched_index(scheduler, w, level) > 0;
+      if (has_work == (pass == 0)) {
+        awaken[count++] = w;
+      }
+    }
+  }
+  // Remove all the chosen workers from the idle tree before any of them can go idle again.
+  for (size_t i = 0; i < count; i++) {
+    lf_combining_tree_depart(scheduler->custom_data->idle_workers, awaken[i]);
+  }
+  for (size_t i = 1; i < count; i++) {
+    lf_semaphore_release(scheduler->custom_data->semaphores[awaken[i]], 1);
+  }
+}
+
+/**
+ * @brief Signal all worker threads other than `worker_number` that it is time to stop.
+ */
+static void _lf_sched_signal_stop(lf_scheduler_t* scheduler, size_t worker_number) {
+  scheduler->should_stop = true;
+  for (size_t w = 0; w < scheduler->number_of_workers; w++) {
+    if (w != worker_number) {
+      lf_semaphore_release(scheduler->custom_data->semaphores[w], 1);
+    }
+  }
+}
+
+/**
+ * @brief Advance tag or distribute reactions to worker threads.
+ *
+ * Advance tag if there are no reactions in the deques. If there are such
+ * reactions, wake up worker threads to execute them.
+ *
+ * This function assumes the caller does not hold the 'mutex' lock.
+ */
+static void _lf_scheduler_try_advance_tag_and_distribute(lf_scheduler_t* scheduler, size_t worker_number) {
+  environment_t* env = scheduler->env;
+  // Reset the indexes of the level that just completed.
+  for (size_t w = 0; w < scheduler->number_of_workers; w++) {
+    *_lf_sched_index(scheduler, w, scheduler->custom_data->next_reaction_level - 1) = 0;
+  }
+
+  // Loop until it's time to stop or work has been distributed
+  while (true) {
+    if (scheduler->custom_data->next_reaction_level == (scheduler->max_reaction_level + 1)) {
+      scheduler->custom_data->next_reaction_level = 0;
+      LF_MUTEX_LOCK(&env->mutex);
+      // Nothing more happening at this tag.
+      LF_PRINT_DEBUG("Scheduler: Advancing tag.");
+      // This worker thread will take charge of advancing tag.
+      if (_lf_sched_advance_tag_locked(scheduler)) {
+        LF_PRINT_DEBUG("Scheduler: Reached stop tag.");
+        _lf_sched_signal_stop(scheduler, worker_number);
+        LF_MUTEX_UNLOCK(&env->mutex);
+        break;
+      }
+      LF_MUTEX_UNLOCK(&env->mutex);
+    }
+
+    size_t ready_reactions = _lf_sched_distribute_ready_reactions(scheduler);
+    if (ready_reactions > 0) {
+      _lf_sched_notify_workers(scheduler, ready_reactions, worker_number);
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Wait until the scheduler assigns work.
+ *
+ * If the calling worker thread is the last to become idle, it will call on the
+ * scheduler to distribute work. Otherwise, it will wait on its own semaphore.
+ *
+ * @param worker_number The worker number of the worker thread asking for work
+ * to be assigned to it.
+ */
+static void _lf_sched_wait_for_work(lf_scheduler_t* scheduler, size_t worker_number) {
+  // Record that this worker is idle and check if this is the last
+  // worker thread to become idle.
+  if (lf_combining_tree_arrive(scheduler->custom_data->idle_workers, worker_number)) {
+    // Last thread to go idle
+    LF_PRINT_DEBUG("Scheduler: Worker %zu is the last idle thread.", worker_number);
+    scheduler->number_of_idle_workers = scheduler->number_of_workers;
+    // Call on the scheduler to distribute work or advance tag.
+    _lf_scheduler_try_advance_tag_and_distribute(scheduler, worker_number);
+  } else {
+    // Not the last thread to become idle. Wait for work to be released.
+    LF_PRINT_DEBUG("Scheduler: Worker %zu is trying to acquire its semaphore.", worker_number);
+    lf_semaphore_acquire(scheduler->custom_data->semaphores[worker_number]);
+    LF_PRINT_DEBUG("Scheduler: Worker %zu acquired its semaphore.", worker_number);
+  }
+}
+
+///////////////////// Scheduler Init and Destroy API /////////////////////////
+
+/**
+ * @brief Initialize the scheduler.
+ *
+ * This has to be called before other functions of the scheduler can be used.
+ * If the scheduler is already initialized, this will be a no-op.
+ *
+ * @param env Environment within which we are executing.
+ * @param number_of_workers Indicate how many workers this scheduler will be
+ *  managing.
+ * @param option Pointer to a `sched_params_t` struct containing additional
+ *  scheduler parameters.
+ */
+void lf_sched_init(environment_t* env, size_t number_of_workers, sched_params_t* params) {
+  assert(env != GLOBAL_ENVIRONMENT);
+
+  LF_PRINT_DEBUG("Scheduler: Initializing with %zu workers", number_of_workers);
+
+  // Like the NP scheduler, this scheduler requires `num_reactions_per_level`
+  // to work correctly.
+  if (init_sched_instance(env, &env->scheduler, number_of_workers, params)) {
+    // Scheduler has not been initialized before.
+    if (params == NULL || params->num_reactions_per_level == NULL) {
+      lf_print_warning("Scheduler initialized with no reactions");
+      return;
+    }
+  } else {
+    // Already initialized
+    return;
+  }
+
+  lf_scheduler_t* scheduler = env->scheduler;
+  size_t num_levels = scheduler->max_reaction_level + 1;
+  LF_PRINT_DEBUG("Scheduler: Max reaction level: %zu", scheduler->max_reaction_level);
+
+  scheduler->custom_data = (custom_scheduler_data_t*)calloc(1, sizeof(custom_scheduler_data_t));
+  LF_ASSERT_NON_NULL(scheduler->custom_data);
+  custom_scheduler_data_t* data = scheduler->custom_data;
+
+  data->index_stride = ((num_levels + INDEXES_PER_CACHE_LINE - 1) / INDEXES_PER_CACHE_LINE) * INDEXES_PER_CACHE_LINE;
+  scheduler->indexes = (volatile int*)calloc(number_of_workers * data->index_stride, sizeof(volatile int));
+  LF_ASSERT_NON_NULL(scheduler->indexes);
+
+  data->array_of_mutexes = (lf_mutex_t*)calloc(num_levels, sizeof(lf_mutex_t));
+  LF_ASSERT_NON_NULL(data->array_of_mutexes);
+  for (size_t i = 0; i < num_levels; i++) {
+    LF_MUTEX_INIT(&data->array_of_mutexes[i]);
+  }
+
+  data->idle_workers = lf_combining_tree_new(number_of_workers);
+  data->workers_to_awaken = (size_t*)calloc(number_of_workers, sizeof(size_t));
+  LF_ASSERT_NON_NULL(data->workers_to_awaken);
+
+  data->semaphores = (lf_semaphore_t**)calloc(number_of_workers, sizeof(lf_semaphore_t*));
+  LF_ASSERT_NON_NULL(data->semaphores);
+  data->triggered_reactions = (reaction_t****)calloc(number_of_workers, sizeof(reaction_t***));
+  LF_ASSERT_NON_NULL(data->triggered_reactions);
+  for (size_t w = 0; w < number_of_workers; w++) {
+    data->semaphores[w] = lf_semaphore_new(0);
+    data->triggered_reactions[w] = (reaction_t***)calloc(num_levels, sizeof(reaction_t**));
+    LF_ASSERT_NON_NULL(data->triggered_reactions[w]);
+    for (size_t i = 0; i < num_levels; i++) {
+      // Any worker may end up owning all the reactions of a level.
+      size_t queue_size = params->num_reactions_per_level[i];
+      data->triggered_reactions[w][i] = (reaction_t**)calloc(queue_size, sizeof(reaction_t*));
+      LF_PRINT_DEBUG("Scheduler: Initialized deque of worker %zu for level %zu with size %zu", w, i, queue_size);
+    }
+  }
+
+  data->next_reaction_level = 1;
+}
+
+/**
+ * @brief Free the memory used by the scheduler.
+ *
+ * This must be called when the scheduler is no longer needed.
+ */
+void lf_sched_free(lf_scheduler_t* scheduler) {
+  custom_scheduler_data_t* data = scheduler->custom_data;
+  if (data == NULL) {
+    return;
+  }
+  for (size_t w = 0; w < scheduler->number_of_workers; w++) {
+    for (size_t i = 0; i <= scheduler->max_reaction_level; i++) {
+      free(data->triggered_reactions[w][i]);
+    }
+    free(data->triggered_reactions[w]);
+    lf_semaphore_destroy(data->semaphores[w]);
+  }
+  free(data->triggered_reactions);
+  free(data->semaphores);
+  lf_combining_tree_free(data->idle_workers);
+  free(data->workers_to_awaken);
+  free(data->array_of_mutexes);
+  free((void*)scheduler->indexes);
+  free(data);
+}
+
+///////////////////// Scheduler Worker API (public) /////////////////////////
+/**
+ * @brief Ask the scheduler for one more reaction.
+ *
+ * This function blocks until it can return a ready reaction for worker thread
+ * 'worker_number' or it is time for the worker thread to stop and exit (where a
+ * NULL value would be returned).
+ *
+ * @param worker_number
+ * @return reaction_t* A reaction for the worker to execute. NULL if the calling
+ * worker thread should exit.
+ */
+reaction_t* lf_sched_get_ready_reaction(lf_scheduler_t* scheduler, int worker_number) {
+  size_t number_of_workers = scheduler->number_of_workers;
+  // Iterate until the stop tag is reached or the deques are empty
+  while (!scheduler->should_stop) {
+    // Calculate the current level of reactions to execute
+    size_t current_level = scheduler->custom_data->next_reaction_level - 1;
+#ifdef FEDERATED
+    // Need to lock the mutex because federate.c could trigger reactions at
+    // the current level (if there is a causality loop)
+    LF_MUTEX_LOCK(&scheduler->custom_data->array_of_mutexes[current_level]);
+#endif
+    // Drain the own deque first, then steal from the others.
+    reaction_t* reaction_to_return = _lf_sched_pop_reaction(scheduler, (size_t)worker_number, current_level);
+    for (size_t i = 1; reaction_to_return == NULL && i < number_of_workers; i++) {
+      size_t victim = ((size_t)worker_number + i) % number_of_workers;
+      reaction_to_return = _lf_sched_pop_reaction(scheduler, victim, current_level);
+      if (reaction_to_return != NULL) {
+        LF_PRINT_DEBUG("Scheduler: Worker %d stole a reaction with level %zu from worker %zu.", worker_number,
+                       current_level, victim);
+      }
+    }
+#ifdef FEDERATED
+    LF_MUTEX_UNLOCK(&scheduler->custom_data->array_of_mutexes[current_level]);
+#endif
+
+    if (reaction_to_return != NULL) {
+      // Got a reaction. Next time, place it, and the other reactions of its reactor, where it last executed.
+      // The reactions of a reactor never execute in parallel, so there is one writer at a time.
+      reaction_to_return->worker_affinity = (size_t)worker_number;
+      if (reaction_to_return->self != NULL) {
+        ((self_base_t*)reaction_to_return->self)->worker_affinity = (size_t)worker_number;
+      }
+      return reaction_to_return;
+    }
+
+    LF_PRINT_DEBUG("Worker %d is out of ready reactions.", worker_number);
+
+    // Ask the scheduler for more work and wait
+    tracepoint_worker_wait_starts(scheduler->env, worker_number);
+    _lf_sched_wait_for_work(scheduler, (size_t)worker_number);
+    tracepoint_worker_wait_ends(scheduler->env, worker_number);
+  }
+
+  // It's time for the worker thread to stop and exit.
+  return NULL;
+}
+
+/**
+ * @brief Inform the scheduler that worker thread 'worker_number' is done
+ * executing the 'done_reaction'.
+ *
+ * @param worker_number The worker number for the worker thread that has
+ * finished executing 'done_reaction'.
+ * @param done_reaction The reaction that is done.
+ */
+void lf_sched_done_with_reaction(size_t worker_number, reaction_t* done_reaction) {
+  (void)worker_number;
+  if (!lf_atomic_bool_compare_and_swap32((int32_t*)&done_reaction->status, queued, inactive)) {
+    lf_print_error_and_exit("Unexpected reaction status: %d. Expected %d.", done_reaction->status, queued);
+  }
+}
+
+/**
+ * @brief Inform the scheduler that worker thread 'worker_number' would like to
+ * trigger 'reaction' at the current tag.
+ *
+ * If a worker number is not available (e.g., this function is not called by a
+ * worker thread), -1 should be passed as the 'worker_number'.
+ *
+ * This scheduler places the reaction according to the `worker_affinity` of its
+ * reactor and ignores the worker number.
+ *
+ * The scheduler will ensure that the same reaction is not triggered twice in
+ * the same tag.
+ *
+ * @param reaction The reaction to trigger at the current tag.
+ * @param worker_number The ID of the worker that is making this call. 0 should
+ *  be used if there is only one worker (e.g., when the program is using the
+ *  single-threaded C runtime). -1 is used for an anonymous call in a context where a
+ *  worker number does not make sense (e.g., the caller is not a worker thread).
+ *
+ */
+void lf_scheduler_trigger_reaction(lf_scheduler_t* scheduler, reaction_t* reaction, int worker_number) {
+  (void)worker_number;
+
+  if (reaction == NULL || !lf_atomic_bool_compare_and_swap32((int32_t*)&reaction->status, inactive, queued)) {
+    return;
+  }
+  LF_PRINT_DEBUG("Scheduler: Enqueueing reaction %s, which has level %lld.", reaction->name, LF_LEVEL(reaction->index));
+  _lf_sched_insert_reaction(scheduler, reaction);
+}
+
+bool lf_sched_has_earlier_deadline(lf_scheduler_t* scheduler, reaction_t* reaction) {
+  (void)scheduler;
+  (void)reaction;
+  // This scheduler does not order reactions by deadline.
+  return false;
+}
+
+reaction_t* lf_sched_lend_reaction(lf_scheduler_t* scheduler) {
+  (void)scheduler;
+  // This scheduler does not lend reactions to other environments.
+  return NULL;
+}
+
+void lf_sched_done_with_lent_reaction(lf_scheduler_t* scheduler, reaction_t* done_reaction) {
+  (void)scheduler;
+  (void)done_reaction;
+}
+
+void lf_sched_parallel_for(lf_scheduler_t* scheduler, size_t count, lf_sched_loop_body_t body, void* arg) {
+  (void)scheduler;
+  // The loop runs on the calling thread.
+  body(arg, 0, count);
+}
+#endif // defined SCHEDULER && SCHEDULER == SCHED_WORK_STEALING
@@ -6,154 +6,258 @@
  * @copyright (c) 2023, The University of California at Berkeley.
  * License: <a href="https://github.com/lf-lang/reactor-c/blob/main/LICENSE.md">BSD 2-clause</a>
  * @brief Definitions for watchdogs.
+ *
+ * All watchdogs of all environments are served by a single thread, which keeps their
+ * expirations in a timer wheel and sleeps until the earliest one.
+ *
+ * Restarting a watchdog usually only stores its new expiration: a watchdog stays in the wheel
+ * at the expiration it was armed with (`armed`) as long as that is not later than its current
+ * expiration. When the thread takes it out of the wheel and finds that it was restarted since,
+ * it arms it again at its current expiration, without involving the reactor. The service
+ * mutex is taken only to arm a watchdog that is not in the wheel or must expire earlier.
+ * The expiration is stored before `armed` is read, and `armed` is cleared before the
+ * expiration is read, each with a full barrier in between, so a restart either sees that the
+ * watchdog is no longer armed or is seen by the thread.
+ *
+ * The reactions of a reactor with watchdogs and the handlers of its watchdogs exclude each
+ * other through `reactor_state` of the reactor. Taking it is one compare-and-swap if it is
+ * free, as it is unless a handler is running. Otherwise the thread waits on the service
+ * mutex, with `REACTOR_WAITING` telling the one that releases it to wake it up.
  */
 
 #include <assert.h>
+#include <stddef.h>
 #include "watchdog.h"
 #include "environment.h"
 #include "util.h"
 #include "clock.h"
 
+/** Values of `reactor_state` of a reactor with watchdogs. */
+#define REACTOR_FREE 0
+#define REACTOR_TAKEN 1
+#define REACTOR_WAITING 2 // Set with REACTOR_TAKEN when a thread waits for the reactor.
+
+/** The state of the thread that serves the watchdogs. */
+static struct {
+  lf_mutex_t mutex;      // Protects the fields below and the wheel entries of the watchdogs.
+  lf_cond_t changed;     // Signaled when an earlier expiration is inserted and at termination.
+  lf_cond_t idle;        // Broadcast when the thread is done with an expired watchdog.
+  lf_cond_t released;    // Broadcast when a reactor that a thread waits for is released.
+  timer_wheel_t wheel;   // The expirations of the watchdogs that are started.
+  instant_t wakeup;      // The time the thread is sleeping until, or NEVER if it is not sleeping.
+  watchdog_t* handling;  // The expired watchdog the thread is handling, if any.
+  lf_thread_t thread_id; // The thread.
+  int environments;      // The number of environments with watchdogs that are not terminated.
+  bool initialized;      // Whether the thread has been started.
+  bool terminate;        // Whether the thread should terminate.
+} service;
+
 // Forward declarations
-static void _lf_watchdog_terminate(watchdog_t* watchdog);
-static void* watchdog_thread_main(void* arg);
+static void* watchdog_service_main(void* arg);
+
+/** @brief Store `value` in `*ptr` with a full barrier, so that no later load moves before it. */
+static void atomic_store64(int64_t* ptr, int64_t value) {
+  int64_t old = *ptr;
+  while (!lf_atomic_bool_compare_and_swap64(ptr, old, value)) {
+    old = *ptr;
+  }
+}
+
+void _lf_reactor_lock(self_base_t* base) {
+  if (lf_atomic_bool_compare_and_swap32(&base->reactor_state, REACTOR_FREE, REACTOR_TAKEN)) {
+    return;
+  }
+  LF_MUTEX_LOCK(&service.mutex);
+  while (!lf_atomic_bool_compare_and_swap32(&base->reactor_state, REACTOR_FREE, REACTOR_TAKEN)) {
+    // Ask the holder to wake this thread up, unless it has just released the reactor.
+    if (lf_atomic_bool_compare_and_swap32(&base->reactor_state, REACTOR_TAKEN, REACTOR_TAKEN | REACTOR_WAITING) ||
+        base->reactor_state == (REACTOR_TAKEN | REACTOR_WAITING)) {
+      LF_COND_WAIT(&service.released);
+    }
+  }
+  LF_MUTEX_UNLOCK(&service.mutex);
+}
+
+void _lf_reactor_unlock(self_base_t* base) {
+  if (lf_atomic_bool_compare_and_swap32(&base->reactor_state, REACTOR_TAKEN, REACTOR_FREE)) {
+    return;
+  }
+  // A thread is waiting, which it does with the service mutex released.
+  LF_MUTEX_LOCK(&service.mutex);
+  lf_atomic_bool_compare_and_swap32(&base->reactor_state, REACTOR_TAKEN | REACTOR_WAITING, REACTOR_FREE);
+  LF_COND_BROADCAST(&service.released);
+  LF_MUTEX_UNLOCK(&service.mutex);
+}
 
 /**
- * @brief Initialize watchdog mutexes.
+ * @brief Initialize the watchdogs of an environment.
  * For any reactor with one or more watchdogs, the self struct should have a non-NULL
- * `reactor_mutex` field which points to an instance of `lf_mutex_t`.
- * This function initializes those mutexes. It also initializes the condition
- * variable which enables the safe termination of a running watchdog.
- * Finally it starts of a non-termminating thread for each watchdog.
+ * `reactor_mutex` field which points to an instance of `lf_mutex_t`, which marks the
+ * reactor as one whose reactions must take its `reactor_state`.
+ * The first time this is called for an environment that has watchdogs, it also starts the
+ * thread that serves the watchdogs of all environments.
  */
 void _lf_initialize_watchdogs(environment_t* env) {
+  if (env->watchdogs_size <= 0) {
+    return;
+  }
   for (int i = 0; i < env->watchdogs_size; i++) {
     watchdog_t* watchdog = env->watchdogs[i];
-    if (watchdog->base->reactor_mutex != NULL) {
-      LF_MUTEX_INIT((lf_mutex_t*)(watchdog->base->reactor_mutex));
-    }
-    LF_COND_INIT(&watchdog->cond, watchdog->base->reactor_mutex);
-
-    int ret = lf_thread_create(&watchdog->thread_id, watchdog_thread_main, (void*)watchdog);
+    LF_ASSERT(watchdog->base->reactor_mutex, "reactor-mutex not alloc'ed but has watchdogs.");
+    LF_MUTEX_INIT((lf_mutex_t*)(watchdog->base->reactor_mutex));
+    watchdog->entry.scheduled = false;
+    watchdog->armed = NEVER;
+  }
+  if (!service.initialized) {
+    LF_MUTEX_INIT(&service.mutex);
+    LF_COND_INIT(&service.changed, &service.mutex);
+    LF_COND_INIT(&service.idle, &service.mutex);
+    LF_COND_INIT(&service.released, &service.mutex);
+    timer_wheel_init(&service.wheel, lf_time_physical());
+    service.wakeup = NEVER;
+    service.initialized = true;
+    int ret = lf_thread_create(&service.thread_id, watchdog_service_main, NULL);
     LF_ASSERTN(ret, "Could not create watchdog thread");
   }
+  LF_MUTEX_LOCK(&service.mutex);
+  service.environments++;
+  LF_MUTEX_UNLOCK(&service.mutex);
 }
 
 /**
- * @brief Terminate all watchdog threads.
+ * @brief Terminate all watchdogs of the environment.
+ * When this returns, no handler of these watchdogs is running or will run. When the last
+ * environment with watchdogs terminates, the thread that serves the watchdogs terminates too.
  */
 void _lf_watchdog_terminate_all(environment_t* env) {
-  void* thread_ret;
+  if (env->watchdogs_size <= 0 || !service.initialized) {
+    return;
+  }
   for (int i = 0; i < env->watchdogs_size; i++) {
     watchdog_t* watchdog = env->watchdogs[i];
-    LF_MUTEX_LOCK(watchdog->base->reactor_mutex);
-    _lf_watchdog_terminate(watchdog);
-    LF_MUTEX_UNLOCK(watchdog->base->reactor_mutex);
-    lf_thread_join(watchdog->thread_id, &thread_ret);
+    _lf_reactor_lock(watchdog->base);
+    watchdog->terminate = true;
+    lf_watchdog_stop(watchdog);
+    _lf_reactor_unlock(watchdog->base);
+  }
+  LF_MUTEX_LOCK(&service.mutex);
+  // The thread may have taken one of the watchdogs out of the wheel just before it was stopped.
+  while (service.handling != NULL && service.handling->base->environment == env) {
+    LF_COND_WAIT(&service.idle);
   }
+  if (--service.environments > 0) {
+    LF_MUTEX_UNLOCK(&service.mutex);
+    return;
+  }
+  service.terminate = true;
+  LF_COND_SIGNAL(&service.changed);
+  LF_MUTEX_UNLOCK(&service.mutex);
+  void* thread_ret;
+  lf_thread_join(service.thread_id, &thread_ret);
 }
 
-void watchdog_wait(watchdog_t* watchdog) {
-  watchdog->active = true;
-  instant_t physical_time = lf_time_physical();
-  while (watchdog->expiration != NEVER && physical_time < watchdog->expiration && !watchdog->terminate) {
-    // Wait for expiration, or a signal to stop or terminate.
-    lf_clock_cond_timedwait(&watchdog->cond, watchdog->expiration);
-    physical_time = lf_time_physical();
+/**
+ * @brief Invoke the handler of a watchdog that has expired.
+ *
+ * The watchdog may have been restarted or stopped by a reaction since its expiration was read
+ * without the reactor. Its expiration, which is read again with the reactor taken, decides.
+ * If it was restarted, the restart has armed it again. The handler is invoked with the reactor taken.
+ */
+static void handle_expiration(watchdog_t* watchdog) {
+  self_base_t* base = watchdog->base;
+  _lf_reactor_lock(base);
+  if (!watchdog->terminate && watchdog->expiration != NEVER && lf_time_physical() >= watchdog->expiration) {
+    LF_PRINT_DEBUG("Watchdog %p timed out", (void*)watchdog);
+    watchdog_function_t watchdog_func = watchdog->watchdog_function;
+    (*watchdog_func)(base);
+    lf_watchdog_stop(watchdog);
   }
+  _lf_reactor_unlock(base);
 }
 
 /**
- * @brief Thread function for a watchdog.
- *
- * Each watchdog has a thread which sleeps until one out of two scenarios:
- * 1) The watchdog timeout expires and there has not been a renewal of the
- *    watchdog budget.
- * 2) The watchdog is signaled to wake up and stop or terminate.
+ * @brief Thread function of the thread that serves all watchdogs.
  *
- * In normal usage, the expiration time is incremented while the thread is
- * sleeping, so when the thread wakes up, it can go back to sleep again. If the
- * watchdog does expire. It will execute the watchdog handler and wait for next
- * start. To stop a running watchdog, the expiration field is set to NEVER.
- * The watchdog thread can also be terminated, this should only be done at the
- * end of execution as it cannot be restarted after termination.
+ * The thread takes watchdogs out of the timer wheel as their armed expirations pass. It arms
+ * those that have been restarted since again and handles the others, one at a time, if they
+ * have not been stopped. When none is due, it sleeps until the next wakeup time of the wheel,
+ * an earlier expiration is inserted, or termination is requested.
  *
- * @param arg A pointer to the watchdog struct
+ * @param arg Ignored.
  * @return NULL
  */
-static void* watchdog_thread_main(void* arg) {
+static void* watchdog_service_main(void* arg) {
+  (void)arg;
   initialize_lf_thread_id();
-  watchdog_t* watchdog = (watchdog_t*)arg;
-  self_base_t* base = watchdog->base;
-  LF_PRINT_DEBUG("Starting Watchdog %p", (void*)watchdog);
-  LF_ASSERT(base->reactor_mutex, "reactor-mutex not alloc'ed but has watchdogs.");
-
-  // Grab reactor-mutex and start infinite loop.
-  LF_MUTEX_LOCK((lf_mutex_t*)(base->reactor_mutex));
-  while (!watchdog->terminate) {
-
-    // Step 1: Wait for a timeout to start watching for.
-    if (watchdog->expiration == NEVER) {
-      // Watchdog has been stopped.
-      // Let the runtime know that we are in an inactive/stopped state.
-      watchdog->active = false;
-      // Wait here until the watchdog is started and we can enter the active state.
-      LF_COND_WAIT(&watchdog->cond);
+  LF_PRINT_DEBUG("Starting the watchdog thread");
+  LF_MUTEX_LOCK(&service.mutex);
+  while (!service.terminate) {
+    timer_wheel_entry_t* entry = timer_wheel_pop(&service.wheel, lf_time_physical());
+    if (entry == NULL) {
+      service.wakeup = timer_wheel_next_wakeup(&service.wheel);
+      if (service.wakeup == FOREVER) {
+        LF_COND_WAIT(&service.changed);
+      } else {
+        lf_clock_cond_timedwait(&service.changed, service.wakeup);
+      }
+      service.wakeup = NEVER;
       continue;
-    } else {
-      // Watchdog has been started.
-      watchdog_wait(watchdog);
-
-      // At this point we have returned from the watchdog wait. But it could
-      // be that it was to terminate the watchdog.
-      if (watchdog->terminate)
-        break;
-
-      // It could also be that the watchdog was stopped
-      if (watchdog->expiration == NEVER)
-        continue;
-
-      // If we reach here, the watchdog actually timed out. Handle it.
-      LF_PRINT_DEBUG("Watchdog %p timed out", (void*)watchdog);
-      watchdog_function_t watchdog_func = watchdog->watchdog_function;
-      (*watchdog_func)(base);
-      watchdog->expiration = NEVER;
     }
+    watchdog_t* watchdog = (watchdog_t*)((char*)entry - offsetof(watchdog_t, entry));
+    atomic_store64(&watchdog->armed, NEVER);
+    instant_t expiration = lf_atomic_load64(&watchdog->expiration);
+    if (expiration == NEVER) {
+      continue; // Stopped.
+    }
+    if (expiration > lf_time_physical()) {
+      // Restarted since it was armed.
+      timer_wheel_insert(&service.wheel, &watchdog->entry, expiration);
+      atomic_store64(&watchdog->armed, expiration);
+      continue;
+    }
+    service.handling = watchdog;
+    LF_MUTEX_UNLOCK(&service.mutex);
+    handle_expiration(service.handling);
+    LF_MUTEX_LOCK(&service.mutex);
+    service.handling = NULL;
+    LF_COND_BROADCAST(&service.idle);
   }
-
-  // Here the thread terminates.
-  watchdog->active = false;
-  LF_MUTEX_UNLOCK(base->reactor_mutex);
+  LF_MUTEX_UNLOCK(&service.mutex);
   return NULL;
 }
 
 void lf_watchdog_start(watchdog_t* watchdog, interval_t additional_timeout) {
-  // Assumes reactor mutex is already held.
+  // Assumes the reactor is taken.
   self_base_t* base = watchdog->base;
   watchdog->terminate = false;
-  watchdog->expiration = base->environment->current_tag.time + watchdog->min_expiration + additional_timeout;
+  watchdog->active = true;
+  instant_t expiration = base->environment->current_tag.time + watchdog->min_expiration + additional_timeout;
+  atomic_store64(&watchdog->expiration, expiration);
+  instant_t armed = lf_atomic_load64(&watchdog->armed);
+  if (armed != NEVER && armed <= expiration) {
+    return; // The thread arms it again when it takes it out of the wheel.
+  }
 
-  // If the watchdog is inactive, signal it to start waiting.
-  if (!watchdog->active) {
-    LF_COND_SIGNAL(&watchdog->cond);
+  LF_MUTEX_LOCK(&service.mutex);
+  timer_wheel_insert(&service.wheel, &watchdog->entry, expiration);
+  atomic_store64(&watchdog->armed, expiration);
+  // Wake up the thread only if it would otherwise sleep past the new expiration.
+  if (service.wakeup != NEVER && expiration < service.wakeup) {
+    LF_COND_SIGNAL(&service.changed);
   }
+  LF_MUTEX_UNLOCK(&service.mutex);
 }
 
 void lf_watchdog_stop(watchdog_t* watchdog) {
-  // Assumes reactor mutex is already held.
-  watchdog->expiration = NEVER;
-
-  // If lf_watchdog_stop is called very close to lf_watchdog_start, it might
-  // not have had the time to wake up and start sleeping.
-  if (!watchdog->active) {
+  // Assumes the reactor is taken.
+  atomic_store64(&watchdog->expiration, NEVER);
+  watchdog->active = false;
+  if (lf_atomic_load64(&watchdog->armed) == NEVER) {
     return;
   }
 
-  LF_COND_SIGNAL(&watchdog->cond);
-}
-
-static void _lf_watchdog_terminate(watchdog_t* watchdog) {
-  watchdog->terminate = true;
-  watchdog->expiration = NEVER;
-  LF_COND_SIGNAL(&watchdog->cond);
+  LF_MUTEX_LOCK(&service.mutex);
+  timer_wheel_remove(&service.wheel, &watchdog->entry);
+  atomic_store64(&watchdog->armed, NEVER);
+  LF_MUTEX_UNLOCK(&service.mutex);
 }
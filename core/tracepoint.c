@@ -36,6 +36,7 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "low_level_platform.h"
@@ -47,7 +48,119 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "reactor_common.h"
 #include "util.h"
 
-int _lf_register_trace_event(void* pointer1, void* pointer2, _lf_trace_object_t type, char* description) {
+uint64_t _lf_trace_disabled_events[(NUM_EVENT_TYPES + 63) / 64];
+
+/** The list given to _lf_trace_set_filter(), or NULL if all reactions are traced. */
+static const char* trace_filter = NULL;
+
+/** The period given to _lf_trace_set_sample_period(). */
+static int trace_sample_period = 1;
+
+/** The groups of events that can be selected with --trace-events. */
+static const struct {
+  const char* name;
+  int first;
+  int last;
+} trace_event_groups[] = {
+    {"reactions", reaction_starts, reaction_ends},
+    {"deadlines", reaction_deadline_missed, reaction_deadline_missed},
+    {"schedule", schedule_called, schedule_called},
+    {"user", user_event, user_value},
+    {"workers", worker_wait_starts, worker_wait_ends},
+    {"scheduler", scheduler_advancing_time_starts, scheduler_advancing_time_ends},
+    {"locks", mutex_wait_starts, mutex_wait_ends},
+    {"federated", federated, NUM_EVENT_TYPES - 1},
+    {"all", 0, NUM_EVENT_TYPES - 1},
+    {"none", 0, -1},
+};
+
+int _lf_trace_set_events(const char* spec) {
+  uint64_t disabled[(NUM_EVENT_TYPES + 63) / 64];
+  // A list that starts with a removal edits the full set.
+  memset(disabled, spec[0] == '-' ? 0 : 0xff, sizeof(disabled));
+  const char* item = spec;
+  while (true) {
+    size_t length = strcspn(item, ",");
+    bool remove = item[0] == '-';
+    const char* name = item + remove;
+    size_t name_length = length - remove;
+    size_t group = 0;
+    while (group < sizeof(trace_event_groups) / sizeof(trace_event_groups[0]) &&
+           (strlen(trace_event_groups[group].name) != name_length ||
+            strncmp(trace_event_groups[group].name, name, name_length) != 0)) {
+      group++;
+    }
+    if (group == sizeof(trace_event_groups) / sizeof(trace_event_groups[0])) {
+      return 0;
+    }
+    for (int event = trace_event_groups[group].first; event <= trace_event_groups[group].last; event++) {
+      if (remove) {
+        disabled[event >> 6] |= 1ULL << (event & 63);
+      } else {
+        disabled[event >> 6] &= ~(1ULL << (event & 63));
+      }
+    }
+    if (item[length] == '\0') {
+      break;
+    }
+    item += length + 1;
+  }
+  memcpy(_lf_trace_disabled_events, disabled, sizeof(disabled));
+  return 1;
+}
+
+void _lf_trace_set_filter(const char* spec) { trace_filter = spec; }
+
+void _lf_trace_set_sample_period(int period) { trace_sample_period = period; }
+
+/**
+ * Return the reactions of the reactor with the specified full name that the filter selects,
+ * one bit per reaction number, where bit 63 stands for the reactions numbered 63 and above.
+ */
+static uint64_t trace_filter_selected(const char* name) {
+  uint64_t selected = 0;
+  size_t name_length = strlen(name);
+  const char* item = trace_filter;
+  while (true) {
+    size_t length = strcspn(item, ",");
+    if (length == name_length && strncmp(item, name, length) == 0) {
+      selected = UINT64_MAX;
+    } else if (length < name_length && strncmp(item, name, length) == 0 && name[length] == '.') {
+      // The reactor is contained by the listed one.
+      selected = UINT64_MAX;
+    } else if (length > name_length + 1 && strncmp(item, name, name_length) == 0 && item[name_length] == '.' &&
+               strspn(item + name_length + 1, "0123456789") == length - name_length - 1) {
+      int number = atoi(item + name_length + 1);
+      selected |= 1ULL << (number < 63 ? number : 63);
+    }
+    if (item[length] == '\0') {
+      return selected;
+    }
+    item += length + 1;
+  }
+}
+
+bool _lf_trace_reaction_selected(reaction_t* reaction, bool starts) {
+  self_base_t* self = (self_base_t*)reaction->self;
+  if ((self->trace_excluded >> (reaction->number < 63 ? reaction->number : 63)) & 1) {
+    return false;
+  }
+  // The reactions of a reactor never execute in parallel, so the countdown needs no lock.
+  if (starts) {
+    if (self->trace_countdown > 0) {
+      self->trace_countdown--;
+      return false;
+    }
+    self->trace_countdown = trace_sample_period - 1;
+    return true;
+  }
+  return self->trace_countdown == trace_sample_period - 1;
+}
+
+int(_lf_register_trace_event)(void* pointer1, void* pointer2, _lf_trace_object_t type, char* description) {
+  if (type == trace_reactor && trace_filter != NULL && description != NULL) {
+    ((self_base_t*)pointer1)->trace_excluded = ~trace_filter_selected(description);
+  }
   object_description_t desc = {.pointer = pointer1, .trigger = pointer2, .type = type, .description = description};
   lf_tracing_register_trace_event(desc);
   return 1;
@@ -57,11 +170,15 @@ int register_user_trace_event(void* self, char* description) {
   LF_ASSERT(
       self,
       "Need a pointer to a self struct to register a user trace event"); // FIXME: Not needed. self not needed either
-  return _lf_register_trace_event(description, NULL, trace_user, description);
+  // User events keep their description, which also identifies them.
+  return (_lf_register_trace_event)(description, NULL, trace_user, description);
 }
 
 void call_tracepoint(int event_type, void* reactor, tag_t tag, int worker, int src_id, int dst_id,
                      instant_t* physical_time, trigger_t* trigger, interval_t extra_delay) {
+  if (!_lf_trace_event_enabled(event_type)) {
+    return;
+  }
   instant_t local_time;
   if (physical_time == NULL) {
     local_time = lf_time_physical();
@@ -85,6 +202,9 @@ void call_tracepoint(int event_type, void* reactor, tag_t tag, int worker, int s
  * @param extra_delay The extra delay passed to schedule().
  */
 void tracepoint_schedule(environment_t* env, trigger_t* trigger, interval_t extra_delay) {
+  if (!_lf_trace_event_enabled(schedule_called)) {
+    return;
+  }
   // schedule() can only trigger reactions within the same reactor as the action
   // or timer. If there is such a reaction, find its reactor's self struct and
   // put that into the tracepoint. We only have to look at the first reaction.
@@ -147,6 +267,10 @@ void tracepoint_user_value(void* self, char* description, long long value) {
   call_tracepoint(user_value, description, env->current_tag, -1, -1, -1, NULL, NULL, value);
 }
 
+void tracepoint_runtime_value(environment_t* env, char* description, long long value) {
+  call_tracepoint(user_value, description, env->current_tag, -1, -1, -1, NULL, NULL, value);
+}
+
 ////////////////////////////////////////////////////////////
 //// For federated execution
 
@@ -0,0 +1,271 @@
+/**
+ * @file
+ * @brief Counters and histograms with which a program instruments its hot paths.
+ *
+ * See user_metrics.h. A metric is registered under a spin lock, and its name and kind are
+ * written before the count of metrics, so that updates find it without the lock.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "user_metrics.h"
+#include "environment.h"
+#include "low_level_platform.h"
+#include "tracepoint.h"
+#include "util.h"
+
+/** @brief The aggregates of the metrics that a thread has updated. */
+typedef struct shard_t {
+  int64_t count[LF_USER_METRICS_MAX]; // The number of updates of a counter.
+  int64_t total[LF_USER_METRICS_MAX];
+  int64_t max[LF_USER_METRICS_MAX]; // INT64_MIN until a value is recorded in a histogram.
+  int64_t buckets[LF_USER_METRICS_MAX][LF_USER_METRICS_BUCKETS];
+} shard_t;
+
+/** The names and kinds of the metrics, of which the first `num_metrics` are registered. */
+static const char* names[LF_USER_METRICS_MAX];
+static lf_user_metric_kind_t kinds[LF_USER_METRICS_MAX];
+static volatile int32_t num_metrics = 0;
+
+/** Whether a metric is being registered. */
+static int32_t registering = 0;
+
+/** Whether the warning that a metric is not recorded has been printed. */
+static int32_t metrics_warned = 0;
+
+/** The shards of the threads, of which the first `num_shards` are claimed. Each is NULL until it is allocated. */
+static shard_t* volatile shards[LF_USER_METRICS_MAX_THREADS];
+static int32_t num_shards = 0;
+
+/** The shard of the threads that have none of their own, which they update atomically. */
+static shard_t shared_shard;
+
+#if defined(LF_SINGLE_THREADED)
+/** @brief Return the shard of the calling thread, which is the shared one without threads. */
+static shard_t* shard_of_thread(void) { return &shared_shard; }
+#else
+/** The shard of the calling thread, or NULL before its first update. */
+static thread_local shard_t* thread_shard = NULL;
+
+/** @brief Return the shard of the calling thread, which is allocated at its first update. */
+static shard_t* shard_of_thread(void) {
+  if (thread_shard == NULL) {
+    int32_t index = lf_atomic_fetch_add32(&num_shards, 1);
+    shard_t* shard = index < LF_USER_METRICS_MAX_THREADS ? (shard_t*)calloc(1, sizeof(shard_t)) : NULL;
+    if (shard == NULL) {
+      thread_shard = &shared_shard;
+    } else {
+      for (int i = 0; i < LF_USER_METRICS_MAX; i++) {
+        shard->max[i] = INT64_MIN;
+      }
+      shards[index] = shard;
+      thread_shard = shard;
+    }
+  }
+  return thread_shard;
+}
+#endif // LF_SINGLE_THREADED
+
+/**
+ * @brief Register the metric with the given name, unless it exists, and return its index, or -1
+ * if it has another kind or there is no room for it.
+ */
+static int register_metric(const char* name, lf_user_metric_kind_t kind) {
+  while (!lf_atomic_bool_compare_and_swap32(&registering, 0, 1)) {
+    LF_CPU_RELAX();
+  }
+  int i = 0;
+  while (i < num_metrics && strcmp(names[i], name) != 0) {
+    i++;
+  }
+  if (i == num_metrics && i < LF_USER_METRICS_MAX) {
+    names[i] = name;
+    kinds[i] = kind;
+    shared_shard.max[i] = INT64_MIN;
+    // Updates look the metric up without the lock, so it is counted last, with a full barrier.
+    lf_atomic_fetch_add32((int32_t*)&num_metrics, 1);
+  }
+  int result = i < num_metrics && kinds[i] == kind ? i : -1;
+  lf_atomic_bool_compare_and_swap32(&registering, 1, 0);
+  if (result < 0 && lf_atomic_bool_compare_and_swap32(&metrics_warned, 0, 1)) {
+    lf_print_warning("The metric %s is not recorded, because it has another kind or there are more than %d metrics.",
+                     name, LF_USER_METRICS_MAX);
+  }
+  return result;
+}
+
+/** @brief Return the index of the metric with the given name and kind, or -1 if it is not recorded. */
+static int metric_of(const char* name, lf_user_metric_kind_t kind) {
+  int32_t count = num_metrics;
+  for (int i = 0; i < count; i++) {
+    if (names[i] == name) {
+      return kinds[i] == kind ? i : -1;
+    }
+  }
+  return register_metric(name, kind);
+}
+
+/** @brief Return the index of the bucket of the histogram that counts `value`. */
+static int bucket_of(int64_t value) {
+  if (value <= 1) {
+    return 0;
+  }
+  // The bucket is the number of bits of value - 1, which is the least i with value <= 2^i.
+  uint64_t bits = (uint64_t)(value - 1);
+  int bucket = 64;
+#if defined(__GNUC__)
+  bucket -= __builtin_clzll(bits);
+#else
+  for (; !(bits & (1ULL << 63)); bits <<= 1) {
+    bucket--;
+  }
+#endif
+  return LF_MIN(bucket, LF_USER_METRICS_BUCKETS - 1);
+}
+
+void lf_counter_add(const char* name, int64_t amount) {
+  int i = metric_of(name, lf_user_metric_counter);
+  if (i < 0) {
+    return;
+  }
+  shard_t* shard = shard_of_thread();
+  if (shard == &shared_shard) {
+    lf_atomic_fetch_add64(&shard->total[i], amount);
+    lf_atomic_fetch_add64(&shard->count[i], 1);
+  } else {
+    shard->total[i] += amount;
+    shard->count[i]++;
+  }
+}
+
+void lf_histogram_record(const char* name, int64_t value) {
+  int i = metric_of(name, lf_user_metric_histogram);
+  if (i < 0) {
+    return;
+  }
+  shard_t* shard = shard_of_thread();
+  int bucket = bucket_of(value);
+  if (shard == &shared_shard) {
+    lf_atomic_fetch_add64(&shard->total[i], value);
+    int64_t max = shard->max[i];
+    while (value > max && !lf_atomic_bool_compare_and_swap64(&shard->max[i], max, value)) {
+      max = shard->max[i];
+    }
+    lf_atomic_fetch_add64(&shard->buckets[i][bucket], 1);
+  } else {
+    shard->total[i] += value;
+    shard->max[i] = LF_MAX(shard->max[i], value);
+    shard->buckets[i][bucket]++;
+  }
+}
+
+int lf_user_metrics_get(lf_user_metric_t* metrics) {
+  int count = num_metrics;
+  int claimed = LF_MIN(lf_atomic_fetch_add32(&num_shards, 0), LF_USER_METRICS_MAX_THREADS);
+  for (int i = 0; i < count; i++) {
+    lf_user_metric_t* m = &metrics[i];
+    memset(m, 0, sizeof(lf_user_metric_t));
+    m->name = names[i];
+    m->kind = kinds[i];
+    m->max = INT64_MIN;
+    for (int s = -1; s < claimed; s++) {
+      shard_t* shard = s < 0 ? &shared_shard : shards[s];
+      if (shard == NULL) {
+        continue;
+      }
+      m->total += shard->total[i];
+      if (m->kind == lf_user_metric_counter) {
+        m->count += shard->count[i];
+        continue;
+      }
+      m->max = LF_MAX(m->max, shard->max[i]);
+      for (int b = 0; b < LF_USER_METRICS_BUCKETS; b++) {
+        m->buckets[b] += shard->buckets[i][b];
+      }
+    }
+    // The count of a histogram is that of its buckets, which a reader can check.
+    for (int b = 0; b < LF_USER_METRICS_BUCKETS && m->kind == lf_user_metric_histogram; b++) {
+      m->count += m->buckets[b];
+    }
+    if (m->kind == lf_user_metric_counter || m->count == 0) {
+      m->max = 0;
+    }
+  }
+  return count;
+}
+
+#ifdef LF_TRACE
+/** The physical time of the last trace records, which the thread that writes them claims. */
+static int64_t traced_time = 0;
+
+/** Whether each metric has been registered with the tracing module. */
+static bool traced[LF_USER_METRICS_MAX];
+
+/** The count and total of each histogram at its last trace record. */
+static int64_t traced_count[LF_USER_METRICS_MAX];
+static int64_t traced_total[LF_USER_METRICS_MAX];
+#endif // LF_TRACE
+
+void lf_user_metrics_tag_started(environment_t* env) {
+#ifdef LF_TRACE
+  int64_t last = traced_time;
+  instant_t now = lf_time_physical();
+  // With enclaves, the environments start tags at once, so one of them claims the period.
+  if (now - last < LF_USER_METRICS_PERIOD || !lf_atomic_bool_compare_and_swap64(&traced_time, last, now)) {
+    return;
+  }
+  lf_user_metric_t metrics[LF_USER_METRICS_MAX];
+  int count = lf_user_metrics_get(metrics);
+  for (int i = 0; i < count; i++) {
+    lf_user_metric_t* m = &metrics[i];
+    char* description = (char*)m->name;
+    if (!traced[i]) {
+      _lf_register_trace_event(description, NULL, trace_user, description);
+      traced[i] = true;
+    }
+    if (m->kind == lf_user_metric_counter) {
+      tracepoint_runtime_value(env, description, m->total);
+    } else if (m->count > traced_count[i]) {
+      tracepoint_runtime_value(env, description, (m->total - traced_total[i]) / (m->count - traced_count[i]));
+      traced_count[i] = m->count;
+      traced_total[i] = m->total;
+    }
+  }
+#else
+  (void)env;
+#endif // LF_TRACE
+}
+
+/** @brief Return an estimate of the given percentile of the values recorded in a histogram. */
+static int64_t percentile(const lf_user_metric_t* histogram, int percent) {
+  // The rank of the value that is the percentile, counting from 1.
+  int64_t rank = (histogram->count * percent + 99) / 100;
+  int64_t seen = 0;
+  for (int i = 0; i < LF_USER_METRICS_BUCKETS - 1; i++) {
+    seen += histogram->buckets[i];
+    if (seen >= rank) {
+      return LF_MIN(1LL << i, histogram->max);
+    }
+  }
+  return histogram->max;
+}
+
+void lf_user_metrics_print(void) {
+  lf_user_metric_t metrics[LF_USER_METRICS_MAX];
+  int count = lf_user_metrics_get(metrics);
+  if (count == 0) {
+    return;
+  }
+  lf_print("---- User metrics:");
+  for (int i = 0; i < count; i++) {
+    lf_user_metric_t* m = &metrics[i];
+    if (m->kind == lf_user_metric_counter) {
+      lf_print("---- %s: %lld (%lld updates)", m->name, (long long)m->total, (long long)m->count);
+    } else if (m->count > 0) {
+      lf_print("---- %s: count %lld, mean %lld, p50 %lld, p99 %lld, max %lld", m->name, (long long)m->count,
+               (long long)(m->total / m->count), (long long)percentile(m, 50), (long long)percentile(m, 99),
+               (long long)m->max);
+    }
+  }
+}
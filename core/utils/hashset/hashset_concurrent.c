@@ -0,0 +1,186 @@
+/**
+ * @file
+ * @brief Implementation of a set of pointers that threads can update without a lock.
+ *
+ * See hashset_concurrent.h. A slot only goes from empty to an item and from an item
+ * to a tombstone while the set is shared, so the probe sequence of an item never
+ * develops a hole, and two threads adding the same item contend for the same first
+ * empty slot in its probe sequence. Only hashset_concurrent_compact(), which requires
+ * exclusive access, turns tombstones back into empty slots.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "hashset/hashset_concurrent.h"
+#include "platform/lf_atomic.h"
+
+#define TOMBSTONE ((void*)1)
+
+/** Return the first slot of the probe sequence of an item (Fibonacci hashing). */
+static inline size_t hash(hashset_concurrent_t set, void* item) {
+  return (size_t)(((uint64_t)(uintptr_t)item * 0x9E3779B97F4A7C15ULL) >> (64 - set->nbits));
+}
+
+/** Atomically replace the item in slot `ii` with `new_item` if it is `old_item`. */
+static inline bool slot_cas(hashset_concurrent_t set, size_t ii, void* old_item, void* new_item) {
+#if UINTPTR_MAX == UINT64_MAX
+  return lf_atomic_bool_compare_and_swap64((int64_t*)&set->items[ii], (int64_t)(intptr_t)old_item,
+                                           (int64_t)(intptr_t)new_item);
+#else
+  return lf_atomic_bool_compare_and_swap32((int32_t*)&set->items[ii], (int32_t)(intptr_t)old_item,
+                                           (int32_t)(intptr_t)new_item);
+#endif
+}
+
+hashset_concurrent_t hashset_concurrent_create(unsigned short nbits) {
+  if (nbits == 0 || nbits >= 8 * sizeof(size_t) - 1) {
+    return NULL;
+  }
+  hashset_concurrent_t set = (hashset_concurrent_t)calloc(1, sizeof(struct hashset_concurrent_st));
+  if (set == NULL) {
+    return NULL;
+  }
+  set->nbits = nbits;
+  set->capacity = (size_t)1 << nbits;
+  set->items = (void* volatile*)calloc(set->capacity, sizeof(void*));
+  if (set->items == NULL) {
+    free(set);
+    return NULL;
+  }
+  return set;
+}
+
+void hashset_concurrent_destroy(hashset_concurrent_t set) {
+  if (set != NULL) {
+    free((void*)set->items);
+    free(set);
+  }
+}
+
+size_t hashset_concurrent_num_items(hashset_concurrent_t set) { return (size_t)set->nitems; }
+
+int hashset_concurrent_add(hashset_concurrent_t set, void* item) {
+  if (item == NULL || item == TOMBSTONE) {
+    return -1;
+  }
+  size_t mask = set->capacity - 1;
+  size_t ii = hash(set, item);
+  size_t probes = 0;
+  while (probes < set->capacity) {
+    void* current = set->items[ii];
+    if (current == item) {
+      return 0;
+    }
+    if (current == NULL) {
+      if (slot_cas(set, ii, NULL, item)) {
+        lf_atomic_fetch_add32((int32_t*)&set->nitems, 1);
+        lf_atomic_fetch_add32((int32_t*)&set->nused, 1);
+        return 1;
+      }
+      // Another thread took the slot. If it added the same item, the next look at the slot says so.
+      continue;
+    }
+    ii = (ii + 1) & mask;
+    probes++;
+  }
+  return -1;
+}
+
+int hashset_concurrent_remove(hashset_concurrent_t set, void* item) {
+  if (item == NULL || item == TOMBSTONE) {
+    return 0;
+  }
+  size_t mask = set->capacity - 1;
+  size_t ii = hash(set, item);
+  for (size_t probes = 0; probes < set->capacity; probes++) {
+    void* current = set->items[ii];
+    if (current == NULL) {
+      return 0;
+    }
+    if (current == item) {
+      // An item is in at most one slot, so if the swap fails, another thread removed it.
+      if (slot_cas(set, ii, item, TOMBSTONE)) {
+        lf_atomic_fetch_add32((int32_t*)&set->nitems, -1);
+        return 1;
+      }
+      return 0;
+    }
+    ii = (ii + 1) & mask;
+  }
+  return 0;
+}
+
+int hashset_concurrent_is_member(hashset_concurrent_t set, void* item) {
+  if (item == NULL || item == TOMBSTONE) {
+    return 0;
+  }
+  size_t mask = set->capacity - 1;
+  size_t ii = hash(set, item);
+  for (size_t probes = 0; probes < set->capacity; probes++) {
+    void* current = set->items[ii];
+    if (current == NULL) {
+      return 0;
+    }
+    if (current == item) {
+      return 1;
+    }
+    ii = (ii + 1) & mask;
+  }
+  return 0;
+}
+
+int hashset_concurrent_compact(hashset_concurrent_t set) {
+  unsigned short nbits = set->nbits;
+  if ((size_t)set->nitems * 2 > set->capacity) {
+    nbits++;
+  }
+  size_t capacity = (size_t)1 << nbits;
+  void* volatile* items = (void* volatile*)calloc(capacity, sizeof(void*));
+  if (items == NULL) {
+    return -1;
+  }
+  void* volatile* old_items = set->items;
+  size_t old_capacity = set->capacity;
+  set->nbits = nbits;
+  set->capacity = capacity;
+  set->items = items;
+  set->nitems = 0;
+  set->nused = 0;
+  for (size_t ii = 0; ii < old_capacity; ii++) {
+    if (old_items[ii] != NULL && old_items[ii] != TOMBSTONE) {
+      hashset_concurrent_add(set, old_items[ii]);
+    }
+  }
+  free((void*)old_items);
+  return 0;
+}
+
+hashset_concurrent_itr_t hashset_concurrent_iterator(hashset_concurrent_t set) {
+  return (hashset_concurrent_itr_t){.set = set, .index = 0};
+}
+
+void* hashset_concurrent_next(hashset_concurrent_itr_t* itr) {
+  while (itr->index < itr->set->capacity) {
+    void* current = itr->set->items[itr->index++];
+    if (current != NULL && current != TOMBSTONE) {
+      return current;
+    }
+  }
+  return NULL;
+}
+
+void* hashset_concurrent_drain_next(hashset_concurrent_itr_t* itr) {
+  while (itr->index < itr->set->capacity) {
+    size_t ii = itr->index;
+    void* current = itr->set->items[ii];
+    if (current != NULL && current != TOMBSTONE && slot_cas(itr->set, ii, current, TOMBSTONE)) {
+      lf_atomic_fetch_add32((int32_t*)&itr->set->nitems, -1);
+      itr->index++;
+      return current;
+    }
+    // The slot is empty or a tombstone, or another thread removed its item. Tombstones stay tombstones.
+    itr->index++;
+  }
+  return NULL;
+}
@@ -0,0 +1,562 @@
+#if !defined(LF_SINGLE_THREADED)
+/**
+ * @file
+ * @brief Asynchronous backend for the lf_print functions.
+ *
+ * Each thread with an LF thread ID (see lf_thread_id()) owns a ring of records into
+ * which it writes its messages unformatted: the prefix and format pointers, the time,
+ * and the arguments in binary form. Strings passed as arguments are copied into the
+ * record, the format string is not. The thread is the only producer of its ring and
+ * never blocks. If its ring is full, the message is dropped and counted.
+ *
+ * A background thread, started when the first ring is created, takes the records of
+ * all rings in the order of their times, formats them, and writes them like
+ * _lf_message_print() does, to stdout or to the function given to
+ * lf_register_print_function(). lf_async_log_flush() does the same on the calling
+ * thread. Both consume under a mutex, which producers never take, so every ring has a
+ * single consumer at a time. At exit, the remaining records are written out.
+ *
+ * Arguments are encoded by walking the conversion specifications of the format.
+ * A message with a conversion that cannot be encoded (for example, %n or %ls), or whose
+ * arguments do not fit in a record, is formatted by the producer into the record
+ * instead, truncated if necessary.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "low_level_platform.h"
+#include "util.h"
+
+/** Number of records in the ring of each thread. This must be a power of two. */
+#ifndef LF_ASYNC_LOG_RING_CAPACITY
+#define LF_ASYNC_LOG_RING_CAPACITY 256
+#endif
+
+/** Number of bytes available for the arguments of a message in a record. */
+#ifndef LF_ASYNC_LOG_ARGS_SIZE
+#define LF_ASYNC_LOG_ARGS_SIZE 240
+#endif
+
+/** Threads with an LF thread ID at or above this number print synchronously. */
+#ifndef LF_ASYNC_LOG_MAX_THREADS
+#define LF_ASYNC_LOG_MAX_THREADS 64
+#endif
+
+/** Time that the background thread sleeps when it finds all rings empty. */
+#ifndef LF_ASYNC_LOG_POLL_INTERVAL
+#define LF_ASYNC_LOG_POLL_INTERVAL MSEC(1)
+#endif
+
+/** Longest conversion specification, such as "%-+ #08.3lld", that can be encoded. */
+#define MAX_SPEC_LENGTH 24
+
+typedef struct {
+  instant_t time;
+  const char* prefix;
+  const char* format; // NULL if `args` holds the message formatted by the producer.
+  unsigned char args[LF_ASYNC_LOG_ARGS_SIZE];
+} async_log_record_t;
+
+typedef struct {
+  size_t head;     // Position of the next record to consume, written by the consumer.
+  size_t tail;     // Position of the next record to produce, written by the owning thread.
+  size_t dropped;  // Number of messages dropped because the ring was full.
+  size_t reported; // Number of dropped messages reported so far, used by the consumer only.
+  async_log_record_t records[LF_ASYNC_LOG_RING_CAPACITY];
+} async_log_ring_t;
+
+/** Type of the argument consumed by a conversion specification. */
+typedef enum {
+  ARG_NONE, // "%%"
+  ARG_INT,
+  ARG_LONG,
+  ARG_LLONG,
+  ARG_SIZE,
+  ARG_INTMAX,
+  ARG_PTRDIFF,
+  ARG_DOUBLE,
+  ARG_LDOUBLE,
+  ARG_POINTER,
+  ARG_STRING,
+  ARG_INVALID
+} arg_type_t;
+
+/** A parsed conversion specification. */
+typedef struct {
+  const char* end;    // First character after the specification.
+  arg_type_t type;    // Type of the argument.
+  bool width_star;    // Whether the width is an int argument.
+  bool precision_star; // Whether the precision is an int argument.
+  int precision;      // Precision given in the format, or -1.
+} conversion_t;
+
+static async_log_ring_t* rings[LF_ASYNC_LOG_MAX_THREADS];
+
+/** 0 before the background thread is started, 1 while it starts, and 2 once it runs. */
+static int32_t state = 0;
+static volatile bool stop = false;
+static lf_thread_t consumer;
+/** Mutex held by whoever consumes records. */
+static lf_mutex_t consume_mutex;
+/** Whether the current thread holds consume_mutex, so that messages it prints are not consumed recursively. */
+static thread_local bool consuming = false;
+
+/** Buffer for the formatted text of a message, used under consume_mutex only. */
+static char* text = NULL;
+static size_t text_capacity = 0;
+static size_t text_length = 0;
+
+/**
+ * @brief Parse the conversion specification that starts after the '%' at `spec`.
+ */
+static conversion_t parse_conversion(const char* spec) {
+  conversion_t result = {.type = ARG_INVALID, .precision = -1};
+  const char* c = spec;
+  while (*c != '\0' && strchr("-+ #0", *c) != NULL) {
+    c++;
+  }
+  if (*c == '*') {
+    result.width_star = true;
+    c++;
+  } else {
+    while (*c >= '0' && *c <= '9') {
+      c++;
+    }
+  }
+  if (*c == '.') {
+    c++;
+    result.precision = 0;
+    if (*c == '*') {
+      result.precision_star = true;
+      c++;
+    } else {
+      while (*c >= '0' && *c <= '9') {
+        result.precision = result.precision * 10 + (*c++ - '0');
+      }
+    }
+  }
+  arg_type_t integer = ARG_INT;
+  bool long_double = false;
+  bool wide = false;
+  if (c[0] == 'h') {
+    c += (c[1] == 'h') ? 2 : 1;
+  } else if (c[0] == 'l' && c[1] == 'l') {
+    integer = ARG_LLONG;
+    c += 2;
+  } else if (c[0] == 'l') {
+    integer = ARG_LONG;
+    wide = true;
+    c++;
+  } else if (c[0] == 'z') {
+    integer = ARG_SIZE;
+    c++;
+  } else if (c[0] == 'j') {
+    integer = ARG_INTMAX;
+    c++;
+  } else if (c[0] == 't') {
+    integer = ARG_PTRDIFF;
+    c++;
+  } else if (c[0] == 'L') {
+    long_double = true;
+    c++;
+  }
+  if (*c == '\0' || c - spec > MAX_SPEC_LENGTH) {
+    result.end = c;
+    return result;
+  }
+  switch (*c) {
+  case '%':
+    result.type = (c == spec) ? ARG_NONE : ARG_INVALID;
+    break;
+  case 'd':
+  case 'i':
+  case 'u':
+  case 'o':
+  case 'x':
+  case 'X':
+    result.type = integer;
+    break;
+  case 'c':
+    result.type = wide ? ARG_INVALID : ARG_INT;
+    break;
+  case 's':
+    result.type = wide ? ARG_INVALID : ARG_STRING;
+    break;
+  case 'p':
+    result.type = ARG_POINTER;
+    break;
+  case 'f':
+  case 'F':
+  case 'e':
+  case 'E':
+  case 'g':
+  case 'G':
+  case 'a':
+  case 'A':
+    result.type = long_double ? ARG_LDOUBLE : ARG_DOUBLE;
+    break;
+  default:
+    // Including %n, which must not be deferred.
+    break;
+  }
+  result.end = c + 1;
+  return result;
+}
+
+/** Append `size` bytes at `value` to the arguments of a record, returning false if they do not fit. */
+static bool put(async_log_record_t* record, size_t* offset, const void* value, size_t size) {
+  if (*offset + size > LF_ASYNC_LOG_ARGS_SIZE) {
+    return false;
+  }
+  memcpy(record->args + *offset, value, size);
+  *offset += size;
+  return true;
+}
+
+#define PUT_ARG(type)                                                                                                  \
+  do {                                                                                                                 \
+    type value = va_arg(args, type);                                                                                   \
+    fits = put(record, &offset, &value, sizeof(type));                                                                \
+  } while (0)
+
+/**
+ * @brief Encode the arguments of a message into a record.
+ * @return false if a conversion cannot be encoded or the arguments do not fit.
+ */
+static bool encode(async_log_record_t* record, const char* format, va_list args) {
+  size_t offset = 0;
+  for (const char* c = strchr(format, '%'); c != NULL; c = strchr(c, '%')) {
+    conversion_t conversion = parse_conversion(c + 1);
+    c = conversion.end;
+    bool fits = true;
+    int precision = conversion.precision;
+    if (conversion.width_star) {
+      PUT_ARG(int);
+    }
+    if (conversion.precision_star) {
+      precision = va_arg(args, int);
+      fits = fits && put(record, &offset, &precision, sizeof(int));
+    }
+    switch (conversion.type) {
+    case ARG_NONE:
+      break;
+    case ARG_INT:
+      PUT_ARG(int);
+      break;
+    case ARG_LONG:
+      PUT_ARG(long);
+      break;
+    case ARG_LLONG:
+      PUT_ARG(long long);
+      break;
+    case ARG_SIZE:
+      PUT_ARG(size_t);
+      break;
+    case ARG_INTMAX:
+      PUT_ARG(intmax_t);
+      break;
+    case ARG_PTRDIFF:
+      PUT_ARG(ptrdiff_t);
+      break;
+    case ARG_DOUBLE:
+      PUT_ARG(double);
+      break;
+    case ARG_LDOUBLE:
+      PUT_ARG(long double);
+      break;
+    case ARG_POINTER:
+      PUT_ARG(void*);
+      break;
+    case ARG_STRING: {
+      const char* string = va_arg(args, const char*);
+      if (string == NULL) {
+        string = "(null)";
+      }
+      // With a precision, the string need not be null terminated.
+      size_t length = (precision >= 0) ? strnlen(string, (size_t)precision) : strlen(string);
+      const char terminator = '\0';
+      fits = fits && put(record, &offset, string, length) && put(record, &offset, &terminator, 1);
+      break;
+    }
+    case ARG_INVALID:
+      return false;
+    }
+    if (!fits) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Append formatted text to `text`, growing it as needed. */
+static void append(const char* format, ...) ATTRIBUTE_FORMAT_PRINTF(1, 2);
+static void append(const char* format, ...) {
+  va_list args;
+  while (true) {
+    va_start(args, format);
+    int length = vsnprintf(text + text_length, text_capacity - text_length, format, args);
+    va_end(args);
+    if (length < 0) {
+      return;
+    }
+    if (text_length + (size_t)length < text_capacity) {
+      text_length += (size_t)length;
+      return;
+    }
+    size_t capacity = 2 * (text_length + (size_t)length + 1);
+    char* grown = (char*)realloc(text, capacity);
+    if (grown == NULL) {
+      return;
+    }
+    text = grown;
+    text_capacity = capacity;
+  }
+}
+
+/** Take a value of `type` from the arguments of a record and append it formatted with `spec`. */
+#define APPEND_ARG(type)                                                                                               \
+  do {                                                                                                                 \
+    type value;                                                                                                        \
+    memcpy(&value, arg, sizeof(type));                                                                                 \
+    arg += sizeof(type);                                                                                               \
+    append(spec, value);                                                                                               \
+  } while (0)
+
+/**
+ * @brief Format a message from the format and the encoded arguments of a record into `text`.
+ */
+static void decode(async_log_record_t* record) {
+  const unsigned char* arg = record->args;
+  const char* c = record->format;
+  text_length = 0;
+  append("%s", "");
+  while (*c != '\0') {
+    const char* percent = strchr(c, '%');
+    if (percent == NULL) {
+      append("%s", c);
+      return;
+    }
+    append("%.*s", (int)(percent - c), c);
+    conversion_t conversion = parse_conversion(percent + 1);
+    c = conversion.end;
+    if (conversion.type == ARG_NONE) {
+      append("%%");
+      continue;
+    }
+    // Rebuild the specification with the widths and precisions given as arguments written out.
+    // A negative width is a '-' flag, and a negative precision is no precision.
+    char spec[MAX_SPEC_LENGTH + 32];
+    size_t length = 0;
+    for (const char* s = percent; s < conversion.end; s++) {
+      if (*s == '*') {
+        int value;
+        memcpy(&value, arg, sizeof(int));
+        arg += sizeof(int);
+        if (s[-1] == '.' && value < 0) {
+          length--;
+        } else {
+          length += (size_t)snprintf(spec + length, sizeof(spec) - length, "%d", value);
+        }
+      } else {
+        spec[length++] = *s;
+      }
+    }
+    spec[length] = '\0';
+    switch (conversion.type) {
+    case ARG_INT:
+      APPEND_ARG(int);
+      break;
+    case ARG_LONG:
+      APPEND_ARG(long);
+      break;
+    case ARG_LLONG:
+      APPEND_ARG(long long);
+      break;
+    case ARG_SIZE:
+      APPEND_ARG(size_t);
+      break;
+    case ARG_INTMAX:
+      APPEND_ARG(intmax_t);
+      break;
+    case ARG_PTRDIFF:
+      APPEND_ARG(ptrdiff_t);
+      break;
+    case ARG_DOUBLE:
+      APPEND_ARG(double);
+      break;
+    case ARG_LDOUBLE:
+      APPEND_ARG(long double);
+      break;
+    case ARG_POINTER:
+      APPEND_ARG(void*);
+      break;
+    case ARG_STRING: {
+      const char* string = (const char*)arg;
+      arg += strlen(string) + 1;
+      append(spec, string);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+}
+
+/** Write a message with the given prefix as _lf_message_print() would. */
+static void emit(const char* prefix, const char* format, ...) ATTRIBUTE_FORMAT_PRINTF(2, 3);
+static void emit(const char* prefix, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  _lf_message_write(prefix, format, args);
+  va_end(args);
+}
+
+/**
+ * @brief Write out all records in the rings, oldest first, and report dropped messages.
+ * This assumes the caller holds consume_mutex.
+ * @return The number of records written.
+ */
+static size_t consume_locked(void) {
+  size_t count = 0;
+  while (true) {
+    async_log_ring_t* oldest = NULL;
+    instant_t oldest_time = FOREVER;
+    for (int i = 0; i < LF_ASYNC_LOG_MAX_THREADS; i++) {
+      async_log_ring_t* ring = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+      if (ring == NULL) {
+        continue;
+      }
+      size_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+      if (dropped != ring->reported) {
+        emit("WARNING: ", "Dropped %zu log messages of thread %d because its ring was full.", dropped - ring->reported,
+             i);
+        ring->reported = dropped;
+      }
+      size_t head = ring->head;
+      if (head != __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) {
+        async_log_record_t* record = &ring->records[head & (LF_ASYNC_LOG_RING_CAPACITY - 1)];
+        if (oldest == NULL || record->time < oldest_time) {
+          oldest = ring;
+          oldest_time = record->time;
+        }
+      }
+    }
+    if (oldest == NULL) {
+      return count;
+    }
+    async_log_record_t* record = &oldest->records[oldest->head & (LF_ASYNC_LOG_RING_CAPACITY - 1)];
+    if (record->format == NULL) {
+      emit(record->prefix, "%s", (const char*)record->args);
+    } else {
+      decode(record);
+      emit(record->prefix, "%s", (text == NULL) ? "" : text);
+    }
+    // Hand the slot back to the producer.
+    __atomic_store_n(&oldest->head, oldest->head + 1, __ATOMIC_RELEASE);
+    count++;
+  }
+}
+
+/** Consume records under consume_mutex unless the current thread already holds it. */
+static size_t consume(void) {
+  if (consuming || __atomic_load_n(&state, __ATOMIC_ACQUIRE) != 2) {
+    return 0;
+  }
+  LF_MUTEX_LOCK(&consume_mutex);
+  consuming = true;
+  size_t count = consume_locked();
+  consuming = false;
+  LF_MUTEX_UNLOCK(&consume_mutex);
+  return count;
+}
+
+/** Body of the background thread. */
+static void* consume_periodically(void* ignored) {
+  (void)ignored;
+  while (!stop) {
+    if (consume() == 0) {
+      lf_sleep(LF_ASYNC_LOG_POLL_INTERVAL);
+    }
+  }
+  return NULL;
+}
+
+/** Stop the background thread and write out the remaining records. */
+static void stop_at_exit(void) {
+  stop = true;
+  lf_thread_join(consumer, NULL);
+  lf_async_log_flush();
+  fflush(stdout);
+}
+
+/** Start the background thread if no other thread has. */
+static void start(void) {
+  if (!lf_atomic_bool_compare_and_swap32(&state, 0, 1)) {
+    return;
+  }
+  LF_MUTEX_INIT(&consume_mutex);
+  if (lf_thread_create(&consumer, consume_periodically, NULL) != 0) {
+    // Records are then written out by lf_async_log_flush() only.
+    __atomic_store_n(&state, 2, __ATOMIC_RELEASE);
+    return;
+  }
+  __atomic_store_n(&state, 2, __ATOMIC_RELEASE);
+  atexit(stop_at_exit);
+}
+
+bool _lf_async_log_vprint(const char* prefix, const char* format, va_list args) {
+  int id = lf_thread_id();
+  if (id < 0 || id >= LF_ASYNC_LOG_MAX_THREADS) {
+    return false;
+  }
+  async_log_ring_t* ring = rings[id];
+  if (ring == NULL) {
+    // Only this thread creates its ring.
+    ring = (async_log_ring_t*)calloc(1, sizeof(async_log_ring_t));
+    if (ring == NULL) {
+      return false;
+    }
+    start();
+    __atomic_store_n(&rings[id], ring, __ATOMIC_RELEASE);
+  }
+  size_t tail = ring->tail;
+  if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == LF_ASYNC_LOG_RING_CAPACITY) {
+    __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+    return true;
+  }
+  async_log_record_t* record = &ring->records[tail & (LF_ASYNC_LOG_RING_CAPACITY - 1)];
+  record->time = lf_time_physical();
+  record->prefix = prefix;
+  record->format = format;
+  va_list copy;
+  va_copy(copy, args);
+  bool encoded = encode(record, format, copy);
+  va_end(copy);
+  if (!encoded) {
+    record->format = NULL;
+    va_copy(copy, args);
+    vsnprintf((char*)record->args, LF_ASYNC_LOG_ARGS_SIZE, format, copy);
+    va_end(copy);
+  }
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+void lf_async_log_flush(void) { consume(); }
+
+size_t lf_async_log_dropped(void) {
+  size_t dropped = 0;
+  for (int i = 0; i < LF_ASYNC_LOG_MAX_THREADS; i++) {
+    async_log_ring_t* ring = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+    if (ring != NULL) {
+      dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    }
+  }
+  return dropped;
+}
+#endif
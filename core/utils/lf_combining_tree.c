@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @brief A combining tree that detects when all members of a group have arrived.
+ *
+ * Each node counts its children that are complete. A child of a leaf is a
+ * member, which is complete when it has arrived, and any other child is a
+ * node, which is complete when its count equals its capacity (the number of its
+ * children). Only the arrival that completes a node goes on to the parent.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "lf_combining_tree.h"
+#include "low_level_platform.h"
+#include "util.h"
+
+/** The parent of the root. */
+#define NO_PARENT SIZE_MAX
+
+struct lf_combining_tree_node_t {
+  union {
+    struct {
+      volatile int32_t count; // The number of complete children.
+      int32_t capacity;       // The number of children.
+      size_t parent;          // The index of the parent node, or NO_PARENT for the root.
+    };
+    char padding[64]; // Keep the counters of different nodes in different cache lines.
+  };
+};
+
+lf_combining_tree_t* lf_combining_tree_new(size_t number_of_members) {
+  assert(number_of_members > 0);
+  // Count the nodes, level by level.
+  size_t number_of_nodes = 0;
+  size_t width = number_of_members;
+  do {
+    width = (width + LF_COMBINING_TREE_FAN_IN - 1) / LF_COMBINING_TREE_FAN_IN;
+    number_of_nodes += width;
+  } while (width > 1);
+
+  lf_combining_tree_t* tree = (lf_combining_tree_t*)malloc(sizeof(lf_combining_tree_t));
+  LF_ASSERT_NON_NULL(tree);
+  tree->number_of_members = number_of_members;
+  tree->nodes = (lf_combining_tree_node_t*)calloc(number_of_nodes, sizeof(lf_combining_tree_node_t));
+  LF_ASSERT_NON_NULL(tree->nodes);
+
+  // Link each level to the next. `children` is the number of children of the
+  // current level and `first` the index of its first node.
+  size_t children = number_of_members;
+  size_t first = 0;
+  do {
+    width = (children + LF_COMBINING_TREE_FAN_IN - 1) / LF_COMBINING_TREE_FAN_IN;
+    for (size_t i = 0; i < width; i++) {
+      lf_combining_tree_node_t* node = &tree->nodes[first + i];
+      node->capacity = (int32_t)LF_MIN(LF_COMBINING_TREE_FAN_IN, children - i * LF_COMBINING_TREE_FAN_IN);
+      node->parent = (width > 1) ? first + width + i / LF_COMBINING_TREE_FAN_IN : NO_PARENT;
+    }
+    first += width;
+    children = width;
+  } while (width > 1);
+  return tree;
+}
+
+void lf_combining_tree_free(lf_combining_tree_t* tree) {
+  free(tree->nodes);
+  free(tree);
+}
+
+bool lf_combining_tree_arrive(lf_combining_tree_t* tree, size_t member) {
+  assert(member < tree->number_of_members);
+  size_t i = member / LF_COMBINING_TREE_FAN_IN;
+  while (true) {
+    lf_combining_tree_node_t* node = &tree->nodes[i];
+    int32_t count = lf_atomic_add_fetch32((int32_t*)&node->count, 1);
+    assert(count <= node->capacity);
+    if (count < node->capacity) {
+      // Some sibling has not arrived yet. It will carry on to the parent.
+      return false;
+    }
+    if (node->parent == NO_PARENT) {
+      return true;
+    }
+    i = node->parent;
+  }
+}
+
+void lf_combining_tree_depart(lf_combining_tree_t* tree, size_t member) {
+  assert(member < tree->number_of_members);
+  size_t i = member / LF_COMBINING_TREE_FAN_IN;
+  while (i != NO_PARENT) {
+    lf_combining_tree_node_t* node = &tree->nodes[i];
+    assert(node->count > 0);
+    // There is no concurrent arrival, so the count can be changed without an atomic operation.
+    bool was_complete = (node->count == node->capacity);
+    node->count--;
+    if (!was_complete) {
+      // The parent did not count this node as complete.
+      return;
+    }
+    i = node->parent;
+  }
+}
@@ -46,6 +46,7 @@ lf_semaphore_t* lf_semaphore_new(int count) {
   LF_MUTEX_INIT(&semaphore->mutex);
   LF_COND_INIT(&semaphore->cond, &semaphore->mutex);
   semaphore->count = count;
+  semaphore->waiters = 0;
   return semaphore;
 }
 
@@ -59,7 +60,10 @@ void lf_semaphore_release(lf_semaphore_t* semaphore, int i) {
   assert(semaphore != NULL);
   LF_MUTEX_LOCK(&semaphore->mutex);
   semaphore->count += i;
-  lf_cond_broadcast(&semaphore->cond);
+  // Threads that are polling with lf_semaphore_try_acquire do not need to be signaled.
+  if (semaphore->waiters > 0) {
+    lf_cond_broadcast(&semaphore->cond);
+  }
   LF_MUTEX_UNLOCK(&semaphore->mutex);
 }
 
@@ -71,13 +75,37 @@ void lf_semaphore_release(lf_semaphore_t* semaphore, int i) {
 void lf_semaphore_acquire(lf_semaphore_t* semaphore) {
   assert(semaphore != NULL);
   LF_MUTEX_LOCK(&semaphore->mutex);
+  semaphore->waiters++;
   while (semaphore->count == 0) {
     lf_cond_wait(&semaphore->cond);
   }
+  semaphore->waiters--;
   semaphore->count--;
   LF_MUTEX_UNLOCK(&semaphore->mutex);
 }
 
+/**
+ * @brief Acquire the 'semaphore' if its count is not 0, without blocking.
+ *
+ * @param semaphore Instance of a semaphore.
+ * @return true if the semaphore was acquired, false otherwise.
+ */
+bool lf_semaphore_try_acquire(lf_semaphore_t* semaphore) {
+  assert(semaphore != NULL);
+  // Avoid taking the mutex while there is nothing to acquire.
+  if (semaphore->count == 0) {
+    return false;
+  }
+  bool acquired = false;
+  LF_MUTEX_LOCK(&semaphore->mutex);
+  if (semaphore->count > 0) {
+    semaphore->count--;
+    acquired = true;
+  }
+  LF_MUTEX_UNLOCK(&semaphore->mutex);
+  return acquired;
+}
+
 /**
  * @brief Wait on the 'semaphore' if count is 0.
  *
@@ -86,9 +114,11 @@ void lf_semaphore_acquire(lf_semaphore_t* semaphore) {
 void lf_semaphore_wait(lf_semaphore_t* semaphore) {
   assert(semaphore != NULL);
   LF_MUTEX_LOCK(&semaphore->mutex);
+  semaphore->waiters++;
   while (semaphore->count == 0) {
     lf_cond_wait(&semaphore->cond);
   }
+  semaphore->waiters--;
   LF_MUTEX_UNLOCK(&semaphore->mutex);
 }
 
@@ -0,0 +1,276 @@
+/**
+ * @file
+ * @brief Profiling of the contention on the mutexes of the runtime.
+ *
+ * See lock_profile.h. The statistics of each pair of mutex and call site are kept in an
+ * open-addressing hash table with a fixed number of entries, which are claimed under a
+ * mutex the first time the pair is seen and updated with atomic operations afterwards.
+ * Each thread keeps the mutexes that it holds on a small stack, so that the hold time is
+ * attributed to the call site that acquired the mutex.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "environment.h"
+#include "lock_profile.h"
+#include "low_level_platform.h"
+#include "tracepoint.h"
+#include "util.h"
+
+/** Number of pairs of mutex and call site that can be profiled. This must be a power of two. */
+#ifndef LF_LOCK_PROFILE_SITES
+#define LF_LOCK_PROFILE_SITES 512
+#endif
+
+/** Number of call sites that lf_lock_profile_print() reports. */
+#ifndef LF_LOCK_PROFILE_REPORTED_SITES
+#define LF_LOCK_PROFILE_REPORTED_SITES 20
+#endif
+
+/** Number of mutexes that a thread can hold at once and still have their hold times recorded. */
+#define MAX_HELD 8
+
+/** Number of mutexes that can be given a name. */
+#define MAX_NAMES 32
+
+/**
+ * Number of buckets of the histograms of wait times. Bucket 0 counts waits shorter than
+ * 2^(FIRST_BUCKET_BITS + 1) ns, bucket i > 0 waits from 2^(FIRST_BUCKET_BITS + i) ns to twice
+ * that, and the last bucket all longer waits.
+ */
+#define BUCKETS 16
+#define FIRST_BUCKET_BITS 7
+
+/** Statistics of the acquisitions of a mutex at a call site. */
+typedef struct lock_site_t {
+  const void* lock;
+  const char* file;
+  int line;
+  int64_t ready; // Whether lock, file and line have been set.
+  int64_t acquisitions;
+  int64_t waits; // Number of acquisitions whose wait was measured.
+  int64_t total_wait;
+  int64_t max_wait;
+  int64_t total_hold;
+  int64_t max_hold;
+  int64_t histogram[BUCKETS];
+} lock_site_t;
+
+/** A mutex held by the calling thread. */
+typedef struct held_lock_t {
+  const void* lock;
+  lock_site_t* site; // NULL if the site could not be recorded.
+  instant_t acquired;
+} held_lock_t;
+
+static lock_site_t sites[LF_LOCK_PROFILE_SITES];
+static lf_mutex_t sites_mutex; // Held while claiming an entry of `sites`.
+static int64_t sites_mutex_initialized;
+static int64_t dropped; // Number of acquisitions not recorded because the table was full.
+
+static struct {
+  const void* lock;
+  const char* name;
+} names[MAX_NAMES];
+static int32_t num_names;
+
+/** Stands for the global mutex of the critical sections of GLOBAL_ENVIRONMENT, which is private. */
+static const char global_critical_section[] = "global critical section";
+
+static thread_local held_lock_t held[MAX_HELD];
+static thread_local int num_held;
+
+/** @brief Return the bucket of the histogram for a wait of `wait` ns. */
+static int bucket_of(interval_t wait) {
+  int bits = 0;
+  for (uint64_t w = (uint64_t)wait >> (FIRST_BUCKET_BITS + 1); w != 0 && bits < BUCKETS - 1; w >>= 1) {
+    bits++;
+  }
+  return bits;
+}
+
+/** @brief Set `*max` to `value` if that is larger. */
+static void atomic_max(int64_t* max, int64_t value) {
+  int64_t old = *max;
+  while (value > old && !lf_atomic_bool_compare_and_swap64(max, old, value)) {
+    old = *max;
+  }
+}
+
+/** @brief Initialize the mutex that protects the claiming of entries, once. */
+static void init_sites_mutex(void) {
+  static int32_t initializing;
+  if (lf_atomic_bool_compare_and_swap32(&initializing, 0, 1)) {
+    LF_ASSERTN(lf_mutex_init(&sites_mutex), "Mutex init failed.");
+    lf_atomic_fetch_add64(&sites_mutex_initialized, 1);
+  }
+  while (lf_atomic_load64(&sites_mutex_initialized) == 0) {
+    LF_CPU_RELAX();
+  }
+}
+
+/**
+ * @brief Return the entry of the pair of mutex and call site, claiming it if it is new,
+ * or NULL if the table is full.
+ */
+static lock_site_t* site_of(const void* lock, const char* file, int line) {
+  uint64_t hash = ((uint64_t)(uintptr_t)lock * 31 + (uint64_t)(uintptr_t)file) * 31 + (uint64_t)line;
+  size_t start = (size_t)((hash * 0x9e3779b97f4a7c15ULL) >> 40) & (LF_LOCK_PROFILE_SITES - 1);
+  // Look for the pair without the mutex first. If it is not found, it is new, unless
+  // another thread is claiming it, so look again under the mutex and claim it.
+  for (int attempt = 0; attempt < 2; attempt++) {
+    for (size_t i = 0; i < LF_LOCK_PROFILE_SITES; i++) {
+      lock_site_t* site = &sites[(start + i) & (LF_LOCK_PROFILE_SITES - 1)];
+      if (lf_atomic_load64(&site->ready) == 0) {
+        if (attempt == 0) {
+          break;
+        }
+        site->lock = lock;
+        site->file = file;
+        site->line = line;
+        lf_atomic_fetch_add64(&site->ready, 1);
+        lf_mutex_unlock(&sites_mutex);
+        return site;
+      }
+      if (site->lock == lock && site->line == line && site->file == file) {
+        if (attempt == 1) {
+          lf_mutex_unlock(&sites_mutex);
+        }
+        return site;
+      }
+    }
+    if (attempt == 0) {
+      init_sites_mutex();
+      lf_mutex_lock(&sites_mutex);
+    }
+  }
+  lf_mutex_unlock(&sites_mutex);
+  return NULL;
+}
+
+const void* _lf_critical_section_lock(environment_t* env) {
+  return env == GLOBAL_ENVIRONMENT ? (const void*)global_critical_section : (const void*)&env->mutex;
+}
+
+instant_t _lf_lock_profile_start(void) { return lf_time_physical(); }
+
+void _lf_lock_profile_acquired(const void* lock, const char* file, int line, instant_t wait_start) {
+  instant_t now = lf_time_physical();
+  lock_site_t* site = site_of(lock, file, line);
+  if (site == NULL) {
+    lf_atomic_fetch_add64(&dropped, 1);
+  } else {
+    lf_atomic_fetch_add64(&site->acquisitions, 1);
+    if (wait_start != NEVER) {
+      interval_t wait = now - wait_start;
+      lf_atomic_fetch_add64(&site->waits, 1);
+      lf_atomic_fetch_add64(&site->total_wait, wait);
+      lf_atomic_fetch_add64(&site->histogram[bucket_of(wait)], 1);
+      atomic_max(&site->max_wait, wait);
+#ifdef LF_TRACE
+      if (wait >= LF_LOCK_PROFILE_TRACE_MIN_WAIT) {
+        int thread = lf_thread_id();
+        call_tracepoint(mutex_wait_starts, (void*)lock, NEVER_TAG, thread, thread, line, &wait_start, NULL, 0);
+        call_tracepoint(mutex_wait_ends, (void*)lock, NEVER_TAG, thread, thread, line, &now, NULL, 0);
+      }
+#endif
+    }
+  }
+  if (num_held < MAX_HELD) {
+    held[num_held++] = (held_lock_t){.lock = lock, .site = site, .acquired = now};
+  }
+}
+
+void _lf_lock_profile_released(const void* lock) {
+  for (int i = num_held - 1; i >= 0; i--) {
+    if (held[i].lock == lock) {
+      if (held[i].site != NULL) {
+        interval_t hold = lf_time_physical() - held[i].acquired;
+        lf_atomic_fetch_add64(&held[i].site->total_hold, hold);
+        atomic_max(&held[i].site->max_hold, hold);
+      }
+      held[i] = held[--num_held];
+      return;
+    }
+  }
+}
+
+void _lf_lock_profile_name(const void* lock, const char* name) {
+  int32_t i = lf_atomic_fetch_add32(&num_names, 1);
+  if (i < MAX_NAMES) {
+    names[i].lock = lock;
+    names[i].name = name;
+  }
+}
+
+/** @brief Return the name given to the mutex, or NULL if it has none. */
+static const char* name_of(const void* lock) {
+  if (lock == global_critical_section) {
+    return global_critical_section;
+  }
+  int32_t count = num_names < MAX_NAMES ? num_names : MAX_NAMES;
+  for (int32_t i = count - 1; i >= 0; i--) {
+    if (names[i].lock == lock) {
+      return names[i].name;
+    }
+  }
+  return NULL;
+}
+
+/** @brief Return the upper bound of the bucket that contains the given quantile of the waits. */
+static interval_t wait_quantile(const lock_site_t* site, double quantile) {
+  int64_t target = (int64_t)(quantile * (double)site->waits);
+  int64_t count = 0;
+  for (int b = 0; b < BUCKETS - 1; b++) {
+    count += site->histogram[b];
+    if (count > target) {
+      interval_t bound = (interval_t)1 << (FIRST_BUCKET_BITS + 1 + b);
+      return bound < site->max_wait ? bound : site->max_wait;
+    }
+  }
+  return site->max_wait;
+}
+
+static int compare_total_wait(const void* a, const void* b) {
+  int64_t x = (*(lock_site_t* const*)a)->total_wait;
+  int64_t y = (*(lock_site_t* const*)b)->total_wait;
+  return (x < y) - (x > y);
+}
+
+void lf_lock_profile_print(void) {
+  lock_site_t* sorted[LF_LOCK_PROFILE_SITES];
+  int count = 0;
+  for (int i = 0; i < LF_LOCK_PROFILE_SITES; i++) {
+    if (sites[i].ready && sites[i].acquisitions > 0) {
+      sorted[count++] = &sites[i];
+    }
+  }
+  qsort(sorted, count, sizeof(lock_site_t*), compare_total_wait);
+  lf_print("---- Lock profile: %d call sites, ordered by total wait (times in ns).", count);
+  lf_print("---- %-24s %-36s %10s %12s %10s %10s %10s %10s", "mutex", "site", "acquired", "total wait", "p50 wait",
+           "p99 wait", "max wait", "max hold");
+  for (int i = 0; i < count && i < LF_LOCK_PROFILE_REPORTED_SITES; i++) {
+    lock_site_t* site = sorted[i];
+    const char* name = name_of(site->lock);
+    char mutex[32];
+    if (name != NULL) {
+      snprintf(mutex, sizeof(mutex), "%s", name);
+    } else {
+      snprintf(mutex, sizeof(mutex), "%p", site->lock);
+    }
+    const char* file = strrchr(site->file, '/');
+    char where[64];
+    snprintf(where, sizeof(where), "%s:%d", file != NULL ? file + 1 : site->file, site->line);
+    lf_print("---- %-24s %-36s %10lld %12lld %10lld %10lld %10lld %10lld", mutex, where, (long long)site->acquisitions,
+             (long long)site->total_wait, (long long)wait_quantile(site, 0.5), (long long)wait_quantile(site, 0.99),
+             (long long)site->max_wait, (long long)site->max_hold);
+  }
+  if (dropped > 0) {
+    lf_print_warning("---- Lock profile: %lld acquisitions were not recorded. Increase LF_LOCK_PROFILE_SITES.",
+                     (long long)dropped);
+  }
+}
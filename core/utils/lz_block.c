@@ -0,0 +1,162 @@
+/**
+ * @file
+ * @brief Fast compression of byte buffers in the LZ4 block format.
+ *
+ * See lz_block.h.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lz_block.h"
+
+#define HASH_BITS 12
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+/** The last match must start this many bytes before the end of the input. */
+#define MATCH_LIMIT 12
+/** The last bytes of the input are always literals. */
+#define LAST_LITERALS 5
+
+static uint32_t read32(const unsigned char* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static size_t hash(uint32_t value) { return (size_t)((value * 2654435761u) >> (32 - HASH_BITS)); }
+
+/** @brief Write the extra bytes of a length of 15 or more to `out` and return the number of bytes written. */
+static size_t put_length(unsigned char* out, size_t length) {
+  size_t n = 0;
+  for (length -= 15; length >= 255; length -= 255) {
+    out[n++] = 255;
+  }
+  out[n++] = (unsigned char)length;
+  return n;
+}
+
+/**
+ * @brief Write a sequence of `literal_length` literals followed by a match at `offset`, or by
+ * no match if `offset` is 0, to `out` at `*n`.
+ * @return false if the sequence does not fit in `capacity` bytes.
+ */
+static bool put_sequence(unsigned char* out, size_t capacity, size_t* n, const unsigned char* literals,
+                         size_t literal_length, size_t offset, size_t match_length) {
+  size_t needed = 1 + literal_length / 255 + 1 + literal_length + 2 + match_length / 255 + 1;
+  if (*n + needed > capacity) {
+    return false;
+  }
+  unsigned char* token = &out[(*n)++];
+  *token = (unsigned char)((literal_length < 15 ? literal_length : 15) << 4);
+  if (literal_length >= 15) {
+    *n += put_length(&out[*n], literal_length);
+  }
+  memcpy(&out[*n], literals, literal_length);
+  *n += literal_length;
+  if (offset != 0) {
+    out[(*n)++] = (unsigned char)offset;
+    out[(*n)++] = (unsigned char)(offset >> 8);
+    match_length -= MIN_MATCH;
+    *token |= (unsigned char)(match_length < 15 ? match_length : 15);
+    if (match_length >= 15) {
+      *n += put_length(&out[*n], match_length);
+    }
+  }
+  return true;
+}
+
+size_t lz_block_compress(const unsigned char* in, size_t length, unsigned char* out, size_t capacity) {
+  uint32_t table[1 << HASH_BITS];
+  memset(table, 0, sizeof(table));
+  size_t n = 0;
+  size_t anchor = 0;
+  if (length > MATCH_LIMIT) {
+    size_t i = 0;
+    while (i < length - MATCH_LIMIT) {
+      uint32_t value = read32(&in[i]);
+      size_t slot = hash(value);
+      size_t candidate = table[slot];
+      table[slot] = (uint32_t)i;
+      if (candidate >= i || i - candidate > MAX_OFFSET || read32(&in[candidate]) != value) {
+        // Skip faster through data that does not compress.
+        i += 1 + ((i - anchor) >> 6);
+        continue;
+      }
+      size_t match_length = MIN_MATCH;
+      while (i + match_length < length - LAST_LITERALS && in[candidate + match_length] == in[i + match_length]) {
+        match_length++;
+      }
+      if (!put_sequence(out, capacity, &n, &in[anchor], i - anchor, i - candidate, match_length)) {
+        return 0;
+      }
+      i += match_length;
+      anchor = i;
+    }
+  }
+  if (!put_sequence(out, capacity, &n, &in[anchor], length - anchor, 0, 0)) {
+    return 0;
+  }
+  return n;
+}
+
+/** @brief Add the extra bytes of a length at `*i` to `*length` and return false if they run past `end`. */
+static bool get_length(const unsigned char* in, size_t* i, size_t end, size_t* length) {
+  unsigned char byte;
+  do {
+    if (*i >= end) {
+      return false;
+    }
+    byte = in[(*i)++];
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+int lz_block_decompress(const unsigned char* in, size_t length, unsigned char* out, size_t out_length) {
+  size_t i = 0;
+  size_t n = 0;
+  while (i < length) {
+    unsigned char token = in[i++];
+    size_t literal_length = token >> 4;
+    if (literal_length == 15 && !get_length(in, &i, length, &literal_length)) {
+      return -1;
+    }
+    if (literal_length > length - i || literal_length > out_length - n) {
+      return -1;
+    }
+    memcpy(&out[n], &in[i], literal_length);
+    i += literal_length;
+    n += literal_length;
+    if (i == length) {
+      break; // The last sequence has no match.
+    }
+    if (length - i < 2) {
+      return -1;
+    }
+    size_t offset = (size_t)in[i] | ((size_t)in[i + 1] << 8);
+    i += 2;
+    if (offset == 0 || offset > n) {
+      return -1;
+    }
+    size_t match_length = token & 15;
+    if (match_length == 15 && !get_length(in, &i, length, &match_length)) {
+      return -1;
+    }
+    match_length += MIN_MATCH;
+    if (match_length > out_length - n) {
+      return -1;
+    }
+    if (offset >= match_length) {
+      memcpy(&out[n], &out[n - offset], match_length);
+      n += match_length;
+    } else {
+      // The match overlaps the bytes it produces, so it repeats the last `offset` bytes.
+      for (size_t k = 0; k < match_length; k++, n++) {
+        out[n] = out[n - offset];
+      }
+    }
+  }
+  return n == out_length ? 0 : -1;
+}
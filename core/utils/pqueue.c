@@ -17,8 +17,6 @@
 #include "util.h"
 #include "lf_types.h"
 
-int in_reverse_order(pqueue_pri_t thiz, pqueue_pri_t that) { return (thiz > that) ? 1 : (thiz < that) ? -1 : 0; }
-
 int in_no_particular_order(pqueue_pri_t thiz, pqueue_pri_t that) {
   (void)thiz;
   (void)that;
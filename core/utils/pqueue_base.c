@@ -49,6 +49,11 @@
 #include "pqueue_base.h"
 #include "util.h"
 
+int in_reverse_order(pqueue_pri_t thiz, pqueue_pri_t that) { return (thiz > that) ? 1 : (thiz < that) ? -1 : 0; }
+
+// With LF_PQUEUE_ARITY, the queue is implemented in pqueue_base_dary.c.
+#ifndef LF_PQUEUE_ARITY
+
 #define LF_LEFT(i) ((i) << 1)
 #define LF_RIGHT(i) (((i) << 1) + 1)
 #define LF_PARENT(i) ((i) >> 1)
@@ -258,6 +263,57 @@ void* pqueue_pop(pqueue_t* q) {
   return head;
 }
 
+size_t pqueue_pop_all_same_priority(pqueue_t* q, void* e, vector_t* v) {
+  if (!q)
+    return 0;
+
+  // Popping costs O(log n) per entry and rebuilding the heap costs O(n). Pop entries
+  // one at a time until popping the remaining ones could cost more than a rebuild.
+  size_t log_size = 1;
+  for (size_t n = q->size; n > 2; n >>= 1)
+    log_size++;
+  size_t budget = q->size / log_size;
+  size_t count = 0;
+  while (q->size > 1 && q->cmppri(q->getpri(q->d[1]), q->getpri(e)) == 0) {
+    if (count == budget)
+      break;
+    vector_push(v, pqueue_pop(q));
+    count++;
+  }
+  if (q->size == 1 || q->cmppri(q->getpri(q->d[1]), q->getpri(e)) != 0)
+    return count;
+
+  // The remaining matching entries form a subtree at the root. Collect them breadth first,
+  // using the vector itself as the queue of entries whose children remain to be visited.
+  size_t first = vector_size(v);
+  vector_push(v, q->d[1]);
+  for (size_t i = first; i < vector_size(v); i++) {
+    size_t posn = q->getpos(v->start[i]);
+    for (size_t child = LF_LEFT(posn); child <= LF_RIGHT(posn) && child < q->size; child++) {
+      if (q->cmppri(q->getpri(q->d[child]), q->getpri(e)) == 0)
+        vector_push(v, q->d[child]);
+    }
+  }
+  for (size_t i = first; i < vector_size(v); i++)
+    q->d[q->getpos(v->start[i])] = NULL;
+  count += vector_size(v) - first;
+
+  // Remove them all and rebuild the heap bottom up.
+  size_t j = 1;
+  for (size_t i = 1; i < q->size; i++) {
+    if (q->d[i] != NULL) {
+      q->d[j] = q->d[i];
+      q->setpos(q->d[j], j);
+      j++;
+    }
+  }
+  q->size = j;
+  for (size_t i = LF_PARENT(q->size - 1); i >= 1; i--)
+    percolate_down(q, i);
+
+  return count;
+}
+
 void pqueue_empty_into(pqueue_t** dest, pqueue_t** src) {
   assert(src);
   assert(dest);
@@ -351,3 +407,5 @@ static int subtree_is_valid(pqueue_t* q, int pos) {
 }
 
 int pqueue_is_valid(pqueue_t* q) { return subtree_is_valid(q, 1); }
+
+#endif // LF_PQUEUE_ARITY
@@ -0,0 +1,325 @@
+/**
+ * @file pqueue_base_dary.c
+ * @copyright (c) 2025, The University of California at Berkeley
+ * License in [BSD 2-clause](https://github.com/lf-lang/reactor-c/blob/main/LICENSE.md)
+ * @brief Heap with LF_PQUEUE_ARITY children per node that implements pqueue_base.h.
+ *
+ * This file is an alternative to pqueue_base.c that is used when LF_PQUEUE_ARITY is defined.
+ * As there, the entries are at positions 1 to size - 1 of `d`, so that code that iterates
+ * over them works with either implementation. The children of the node at position i are at
+ * positions LF_PQUEUE_ARITY * (i - 1) + 2 to LF_PQUEUE_ARITY * (i - 1) + LF_PQUEUE_ARITY + 1.
+ *
+ * The priority of each entry is kept at the same position of `keys`, so choosing among the
+ * children of a node reads LF_PQUEUE_ARITY adjacent priorities rather than calling `getpri`
+ * on as many entries. For queues whose comparison function is in_reverse_order, such as the
+ * reaction queues, the priorities are compared inline. Other queues, such as those sorted by
+ * tags, still call `cmppri`, with priorities that `getpri` computed when the entries were
+ * inserted.
+ */
+
+#include "pqueue_base.h"
+
+#ifdef LF_PQUEUE_ARITY
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+#define FIRST_CHILD(i) (LF_PQUEUE_ARITY * ((i) - 1) + 2)
+#define PARENT(i) (((i) - 2) / LF_PQUEUE_ARITY + 1)
+
+/** @brief Compare two priorities as the comparison function of the queue does. */
+static inline int compare(pqueue_t* q, pqueue_pri_t next, pqueue_pri_t curr) {
+  if (q->integer_keys) {
+    return (next > curr) - (next < curr);
+  }
+  return q->cmppri(next, curr);
+}
+
+/** @brief Put the entry with the given priority at position i. */
+static inline void place(pqueue_t* q, size_t i, void* entry, pqueue_pri_t key) {
+  q->d[i] = entry;
+  q->keys[i] = key;
+  q->setpos(entry, i);
+}
+
+static void bubble_up(pqueue_t* q, size_t i, void* entry, pqueue_pri_t key) {
+  while (i > 1) {
+    size_t parent = PARENT(i);
+    if (compare(q, q->keys[parent], key) != 1) {
+      break;
+    }
+    place(q, i, q->d[parent], q->keys[parent]);
+    i = parent;
+  }
+  place(q, i, entry, key);
+}
+
+static void percolate_down(pqueue_t* q, size_t i, void* entry, pqueue_pri_t key) {
+  while (true) {
+    size_t first = FIRST_CHILD(i);
+    if (first >= q->size) {
+      break;
+    }
+    size_t end = LF_MIN(first + LF_PQUEUE_ARITY, q->size);
+    size_t best = first;
+    for (size_t child = first + 1; child < end; child++) {
+      if (compare(q, q->keys[best], q->keys[child]) == 1) {
+        best = child;
+      }
+    }
+    if (compare(q, key, q->keys[best]) != 1) {
+      break;
+    }
+    place(q, i, q->d[best], q->keys[best]);
+    i = best;
+  }
+  place(q, i, entry, key);
+}
+
+/**
+ * @brief Return an entry of the subtree at `pos` with the given priority, which, if `e` is not
+ * NULL, also matches `e` according to `eqelem`, or NULL if there is none.
+ */
+static void* find_same_priority(pqueue_t* q, pqueue_pri_t key, void* e, size_t pos) {
+  if (pos >= q->size) {
+    return NULL;
+  }
+  int comparison = compare(q, q->keys[pos], key);
+  if (comparison == 1) {
+    // The entries of the subtree all come after the ones with the priority.
+    return NULL;
+  }
+  if (comparison == 0 && (e == NULL || q->eqelem(q->d[pos], e))) {
+    return q->d[pos];
+  }
+  size_t first = FIRST_CHILD(pos);
+  for (size_t child = first; child < first + LF_PQUEUE_ARITY && child < q->size; child++) {
+    void* found = find_same_priority(q, key, e, child);
+    if (found != NULL) {
+      return found;
+    }
+  }
+  return NULL;
+}
+
+/** @brief Give the arrays of the queue room for `avail` entries, or return false if memory is short. */
+static bool reserve(pqueue_t* q, size_t avail) {
+  void** d = (void**)realloc(q->d, avail * sizeof(void*));
+  if (d == NULL) {
+    return false;
+  }
+  q->d = d;
+  pqueue_pri_t* keys = (pqueue_pri_t*)realloc(q->keys, avail * sizeof(pqueue_pri_t));
+  if (keys == NULL) {
+    return false;
+  }
+  q->keys = keys;
+  q->avail = avail;
+  return true;
+}
+
+pqueue_t* pqueue_init(size_t n, pqueue_cmp_pri_f cmppri, pqueue_get_pri_f getpri, pqueue_get_pos_f getpos,
+                      pqueue_set_pos_f setpos, pqueue_eq_elem_f eqelem, pqueue_print_entry_f prt) {
+  pqueue_t* q = (pqueue_t*)calloc(1, sizeof(pqueue_t));
+  if (q == NULL) {
+    return NULL;
+  }
+  // Position 0 is not used.
+  if (!reserve(q, n + 1)) {
+    pqueue_free(q);
+    return NULL;
+  }
+  q->size = 1;
+  q->step = n + 1;
+  q->cmppri = cmppri;
+  q->getpri = getpri;
+  q->getpos = getpos;
+  q->setpos = setpos;
+  q->eqelem = eqelem;
+  q->prt = prt;
+  q->integer_keys = (cmppri == in_reverse_order);
+  return q;
+}
+
+void pqueue_free(pqueue_t* q) {
+  free(q->d);
+  free(q->keys);
+  free(q);
+}
+
+size_t pqueue_size(pqueue_t* q) {
+  if (!q)
+    return 0;
+  return q->size - 1;
+}
+
+void* pqueue_find_same_priority(pqueue_t* q, void* e) {
+  if (!q)
+    return NULL;
+  return find_same_priority(q, q->getpri(e), NULL, 1);
+}
+
+void* pqueue_find_equal_same_priority(pqueue_t* q, void* e) {
+  if (!q)
+    return NULL;
+  return find_same_priority(q, q->getpri(e), e, 1);
+}
+
+int pqueue_insert(pqueue_t* q, void* d) {
+  if (!q)
+    return 1;
+  if (q->size >= q->avail && !reserve(q, q->size + q->step))
+    return 1;
+  bubble_up(q, q->size++, d, q->getpri(d));
+  return 0;
+}
+
+int pqueue_remove(pqueue_t* q, void* d) {
+  if (q->size == 1)
+    return 0; // Nothing to remove
+  size_t posn = q->getpos(d);
+  size_t last = --q->size;
+  if (posn == last)
+    return 0;
+  if (compare(q, q->keys[posn], q->keys[last]) == 1)
+    bubble_up(q, posn, q->d[last], q->keys[last]);
+  else
+    percolate_down(q, posn, q->d[last], q->keys[last]);
+  return 0;
+}
+
+void* pqueue_pop(pqueue_t* q) {
+  if (!q || q->size == 1)
+    return NULL;
+  void* head = q->d[1];
+  size_t last = --q->size;
+  if (last > 1)
+    percolate_down(q, 1, q->d[last], q->keys[last]);
+  return head;
+}
+
+size_t pqueue_pop_all_same_priority(pqueue_t* q, void* e, vector_t* v) {
+  if (!q)
+    return 0;
+  pqueue_pri_t key = q->getpri(e);
+
+  // As in pqueue_base.c, pop entries one at a time until popping the remaining ones could
+  // cost more than rebuilding the heap.
+  size_t log_size = 1;
+  for (size_t n = q->size; n > 2; n >>= 1)
+    log_size++;
+  size_t budget = q->size / log_size;
+  size_t count = 0;
+  while (q->size > 1 && compare(q, q->keys[1], key) == 0) {
+    if (count == budget)
+      break;
+    vector_push(v, pqueue_pop(q));
+    count++;
+  }
+  if (q->size == 1 || compare(q, q->keys[1], key) != 0)
+    return count;
+
+  // The remaining matching entries form a subtree at the root. Collect them breadth first,
+  // using the vector itself as the queue of entries whose children remain to be visited.
+  size_t first = vector_size(v);
+  vector_push(v, q->d[1]);
+  for (size_t i = first; i < vector_size(v); i++) {
+    size_t child = FIRST_CHILD(q->getpos(v->start[i]));
+    for (size_t end = child + LF_PQUEUE_ARITY; child < end && child < q->size; child++) {
+      if (compare(q, q->keys[child], key) == 0)
+        vector_push(v, q->d[child]);
+    }
+  }
+  for (size_t i = first; i < vector_size(v); i++)
+    q->d[q->getpos(v->start[i])] = NULL;
+  count += vector_size(v) - first;
+
+  // Remove them all and rebuild the heap bottom up.
+  size_t j = 1;
+  for (size_t i = 1; i < q->size; i++) {
+    if (q->d[i] != NULL) {
+      q->d[j] = q->d[i];
+      q->keys[j] = q->keys[i];
+      q->setpos(q->d[j], j);
+      j++;
+    }
+  }
+  q->size = j;
+  if (q->size > 2) {
+    for (size_t i = PARENT(q->size - 1); i >= 1; i--)
+      percolate_down(q, i, q->d[i], q->keys[i]);
+  }
+  return count;
+}
+
+void pqueue_empty_into(pqueue_t** dest, pqueue_t** src) {
+  assert(src);
+  assert(dest);
+  assert(*src);
+  assert(*dest);
+  void* item;
+  if ((*dest)->size >= (*src)->size) {
+    while ((item = pqueue_pop(*src))) {
+      pqueue_insert(*dest, item);
+    }
+  } else {
+    while ((item = pqueue_pop(*dest))) {
+      pqueue_insert(*src, item);
+    }
+    pqueue_t* tmp = *dest;
+    *dest = *src;
+    *src = tmp;
+  }
+}
+
+void* pqueue_peek(pqueue_t* q) {
+  if (!q || q->size == 1)
+    return NULL;
+  return q->d[1];
+}
+
+void pqueue_dump(pqueue_t* q, pqueue_print_entry_f print) {
+  LF_PRINT_DEBUG("posn\tfirst child\tparent\tpriority\t...");
+  for (size_t i = 1; i < q->size; i++) {
+    LF_PRINT_DEBUG("%zu\t%zu\t%zu\t%llu\t", i, (size_t)FIRST_CHILD(i), i > 1 ? (size_t)PARENT(i) : 0,
+                   (unsigned long long)q->keys[i]);
+    print(q->d[i]);
+  }
+}
+
+void pqueue_print(pqueue_t* q, pqueue_print_entry_f print) {
+  pqueue_t* dup = pqueue_init(q->size, q->cmppri, q->getpri, q->getpos, q->setpos, q->eqelem, q->prt);
+  dup->size = q->size;
+  memcpy(dup->d, q->d, q->size * sizeof(void*));
+  memcpy(dup->keys, q->keys, q->size * sizeof(pqueue_pri_t));
+  // Popping from the copy moves the entries, so their positions are restored afterwards.
+  void* e;
+  while ((e = pqueue_pop(dup))) {
+    if (print == NULL) {
+      q->prt(e);
+    } else {
+      print(e);
+    }
+  }
+  pqueue_free(dup);
+  for (size_t i = 1; i < q->size; i++) {
+    q->setpos(q->d[i], i);
+  }
+}
+
+int pqueue_is_valid(pqueue_t* q) {
+  for (size_t i = 1; i < q->size; i++) {
+    if (q->keys[i] != q->getpri(q->d[i]) || q->getpos(q->d[i]) != i) {
+      return 0;
+    }
+    if (i > 1 && compare(q, q->keys[PARENT(i)], q->keys[i]) == 1) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+#endif // LF_PQUEUE_ARITY
@@ -8,10 +8,13 @@
  * @brief Priority queue that uses tags for sorting.
  */
 
+#include "pqueue_tag.h"
+
+#ifndef LF_CALENDAR_QUEUE
+
 #include <stdlib.h>
 #include <stdint.h>
 
-#include "pqueue_tag.h"
 #include "util.h"               // For lf_print
 #include "low_level_platform.h" // For PRINTF_TAG
 
@@ -37,7 +40,7 @@ static pqueue_pri_t pqueue_tag_get_priority(void* element) {
  * @param element2 A pointer to a pqueue_tag_element_t, cast to void*.
  */
 static int pqueue_tag_matches(void* element1, void* element2) {
-  return lf_tag_compare(((pqueue_tag_element_t*)element1)->tag, ((pqueue_tag_element_t*)element2)->tag) == 0;
+  return _lf_tag_compare(((pqueue_tag_element_t*)element1)->tag, ((pqueue_tag_element_t*)element2)->tag) == 0;
 }
 
 /**
@@ -70,7 +73,7 @@ static void pqueue_tag_print_element(void* element) {
 
 int pqueue_tag_compare(pqueue_pri_t priority1, pqueue_pri_t priority2) {
   // Suppress "error: cast from pointer to integer of different size" by casting to uintptr_t first.
-  return (lf_tag_compare(((pqueue_tag_element_t*)(uintptr_t)priority1)->tag,
+  return (_lf_tag_compare(((pqueue_tag_element_t*)(uintptr_t)priority1)->tag,
                          ((pqueue_tag_element_t*)(uintptr_t)priority2)->tag));
 }
 
@@ -136,6 +139,11 @@ tag_t pqueue_tag_peek_tag(pqueue_tag_t* q) {
 
 pqueue_tag_element_t* pqueue_tag_pop(pqueue_tag_t* q) { return (pqueue_tag_element_t*)pqueue_pop((pqueue_t*)q); }
 
+size_t pqueue_tag_pop_all_with_tag(pqueue_tag_t* q, tag_t t, vector_t* v) {
+  pqueue_tag_element_t element = {.tag = t, .pos = 0, .is_dynamic = false};
+  return pqueue_pop_all_same_priority((pqueue_t*)q, (void*)&element, v);
+}
+
 tag_t pqueue_tag_pop_tag(pqueue_tag_t* q) {
   pqueue_tag_element_t* element = (pqueue_tag_element_t*)pqueue_tag_pop(q);
   if (element == NULL)
@@ -152,10 +160,21 @@ void pqueue_tag_remove(pqueue_tag_t* q, pqueue_tag_element_t* e) { pqueue_remove
 
 void pqueue_tag_remove_up_to(pqueue_tag_t* q, tag_t t) {
   tag_t head = pqueue_tag_peek_tag(q);
-  while (lf_tag_compare(head, FOREVER_TAG) < 0 && lf_tag_compare(head, t) <= 0) {
+  while (_lf_tag_compare(head, FOREVER_TAG) < 0 && _lf_tag_compare(head, t) <= 0) {
     pqueue_tag_pop_tag(q);
     head = pqueue_tag_peek_tag(q);
   }
 }
 
+size_t pqueue_tag_elements(pqueue_tag_t* q, pqueue_tag_element_t** elements) {
+  size_t size = pqueue_tag_size(q);
+  // The entries of the heap are at positions 1 to size of its array.
+  for (size_t i = 0; i < size; i++) {
+    elements[i] = (pqueue_tag_element_t*)q->d[i + 1];
+  }
+  return size;
+}
+
 void pqueue_tag_dump(pqueue_tag_t* q) { pqueue_dump((pqueue_t*)q, pqueue_tag_print_element); }
+
+#endif // LF_CALENDAR_QUEUE
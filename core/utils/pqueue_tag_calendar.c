@@ -0,0 +1,488 @@
+/**
+ * @file pqueue_tag_calendar.c
+ * @author Byeonggil Jun
+ * @author Edward A. Lee
+ * @copyright (c) 2023, The University of California at Berkeley
+ * License in [BSD 2-clause](https://github.com/lf-lang/reactor-c/blob/main/LICENSE.md)
+ * @brief Calendar queue implementation of the priority queue that uses tags for sorting.
+ *
+ * This file is an alternative to pqueue_tag.c that is used when LF_CALENDAR_QUEUE is defined.
+ * It implements the calendar queue of R. Brown, "Calendar Queues: A Fast O(1) Priority Queue
+ * Implementation for the Simulation Event Set Problem," CACM 31(10), 1988.
+ *
+ * Time is divided into intervals ("days") of a fixed width, and the days of one "year" map to
+ * the buckets of the calendar. Each bucket holds a list of elements that is sorted using the
+ * comparison function of the queue. Finding the least element scans the buckets starting from
+ * the bucket of the current day and only considers elements that fall in the current year.
+ * When the elements are spread evenly over the buckets, insertion and removal take O(1)
+ * amortized time. The number of buckets follows the size of the queue and the width of a day
+ * is re-estimated from the separation of the least elements when the queue is resized.
+ */
+
+#include "pqueue_tag.h"
+
+#ifdef LF_CALENDAR_QUEUE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "util.h"               // For lf_print
+#include "low_level_platform.h" // For PRINTF_TAG
+
+/** Width of a day in nanoseconds until there are enough elements to estimate it. */
+#ifndef LF_CALENDAR_QUEUE_INITIAL_WIDTH
+#define LF_CALENDAR_QUEUE_INITIAL_WIDTH MSEC(1)
+#endif
+
+/** Minimum number of buckets. Must be a power of two. */
+#define PQUEUE_TAG_MIN_BUCKETS 2
+
+/** Number of least elements sampled to estimate the width of a day. */
+#define PQUEUE_TAG_WIDTH_SAMPLES 25
+
+/** Head and tail of the sorted list of elements in one bucket. */
+typedef struct {
+  pqueue_tag_element_t* head;
+  pqueue_tag_element_t* tail;
+} pqueue_tag_bucket_t;
+
+struct pqueue_tag_t {
+  pqueue_tag_bucket_t* buckets;
+  size_t num_buckets;         // Always a power of two.
+  uint64_t width;             // Width of a day, in nanoseconds.
+  size_t current_bucket;      // Bucket of the current day, where the search for the least element starts.
+  uint64_t current_day_start; // Key of the start of the current day. No element has a smaller key.
+  size_t size;
+  pqueue_tag_element_t* least; // Cached least element, or NULL if it has to be searched.
+  pqueue_cmp_pri_f cmppri;
+  pqueue_eq_elem_f eqelem;
+  pqueue_print_entry_f prt;
+};
+
+//////////////////
+// Local functions, not intended for use outside this file.
+
+/**
+ * @brief Return the time of the tag of an element as an unsigned key that preserves the order
+ * of times, so that NEVER maps to 0.
+ */
+static inline uint64_t pqueue_tag_key(pqueue_tag_element_t* element) {
+  return (uint64_t)element->tag.time ^ ((uint64_t)1 << 63);
+}
+
+static inline size_t pqueue_tag_bucket_of(pqueue_tag_t* q, uint64_t key) {
+  return (size_t)((key / q->width) & (q->num_buckets - 1));
+}
+
+/**
+ * @brief Compare two elements using the comparison function of the queue.
+ */
+static inline int pqueue_tag_cmp(pqueue_tag_t* q, pqueue_tag_element_t* e1, pqueue_tag_element_t* e2) {
+  return q->cmppri((pqueue_pri_t)(uintptr_t)e1, (pqueue_pri_t)(uintptr_t)e2);
+}
+
+/**
+ * @brief Make the day containing `key` the current day.
+ */
+static inline void pqueue_tag_set_current_day(pqueue_tag_t* q, uint64_t key) {
+  q->current_bucket = pqueue_tag_bucket_of(q, key);
+  q->current_day_start = key - (key % q->width);
+}
+
+/**
+ * @brief Insert an element into its bucket, after all elements that do not come after it.
+ * The search starts at the tail because new elements usually come last.
+ */
+static void pqueue_tag_link(pqueue_tag_t* q, pqueue_tag_element_t* e) {
+  pqueue_tag_bucket_t* bucket = &q->buckets[pqueue_tag_bucket_of(q, pqueue_tag_key(e))];
+  pqueue_tag_element_t* before = bucket->tail;
+  while (before != NULL && pqueue_tag_cmp(q, before, e) == 1) {
+    before = before->prev;
+  }
+  e->prev = before;
+  if (before == NULL) {
+    e->next = bucket->head;
+    bucket->head = e;
+  } else {
+    e->next = before->next;
+    before->next = e;
+  }
+  if (e->next == NULL) {
+    bucket->tail = e;
+  } else {
+    e->next->prev = e;
+  }
+}
+
+static void pqueue_tag_unlink(pqueue_tag_t* q, pqueue_tag_element_t* e) {
+  pqueue_tag_bucket_t* bucket = &q->buckets[pqueue_tag_bucket_of(q, pqueue_tag_key(e))];
+  if (e->prev == NULL) {
+    bucket->head = e->next;
+  } else {
+    e->prev->next = e->next;
+  }
+  if (e->next == NULL) {
+    bucket->tail = e->prev;
+  } else {
+    e->next->prev = e->prev;
+  }
+  e->next = NULL;
+  e->prev = NULL;
+}
+
+/**
+ * @brief Estimate the width of a day as three times the average separation of the distinct
+ * times of the least elements, excluding FOREVER. Return the current width if there are
+ * fewer than two such times.
+ */
+static uint64_t pqueue_tag_estimate_width(pqueue_tag_t* q, pqueue_tag_element_t** elements, size_t count) {
+  uint64_t sample[PQUEUE_TAG_WIDTH_SAMPLES];
+  size_t num_samples = 0;
+  // Keep the smallest distinct keys in `sample`, sorted by insertion.
+  for (size_t i = 0; i < count; i++) {
+    if (elements[i]->tag.time == FOREVER) {
+      continue;
+    }
+    uint64_t key = pqueue_tag_key(elements[i]);
+    size_t j = num_samples;
+    while (j > 0 && sample[j - 1] > key) {
+      j--;
+    }
+    if ((j > 0 && sample[j - 1] == key) || j == PQUEUE_TAG_WIDTH_SAMPLES) {
+      continue;
+    }
+    size_t last = (num_samples < PQUEUE_TAG_WIDTH_SAMPLES) ? num_samples++ : num_samples - 1;
+    for (size_t k = last; k > j; k--) {
+      sample[k] = sample[k - 1];
+    }
+    sample[j] = key;
+  }
+  if (num_samples < 2) {
+    return q->width;
+  }
+  uint64_t width = 3 * ((sample[num_samples - 1] - sample[0]) / (num_samples - 1));
+  return (width == 0) ? 1 : width;
+}
+
+/**
+ * @brief Rebuild the calendar with the specified number of buckets and a re-estimated width.
+ * If memory cannot be allocated, the calendar is left unchanged.
+ */
+static void pqueue_tag_resize(pqueue_tag_t* q, size_t num_buckets) {
+  pqueue_tag_element_t** elements = (pqueue_tag_element_t**)malloc(q->size * sizeof(pqueue_tag_element_t*));
+  pqueue_tag_bucket_t* buckets = (pqueue_tag_bucket_t*)calloc(num_buckets, sizeof(pqueue_tag_bucket_t));
+  if (elements == NULL || buckets == NULL) {
+    free(elements);
+    free(buckets);
+    return;
+  }
+  size_t count = 0;
+  for (size_t i = 0; i < q->num_buckets; i++) {
+    for (pqueue_tag_element_t* e = q->buckets[i].head; e != NULL; e = e->next) {
+      elements[count++] = e;
+    }
+  }
+  free(q->buckets);
+  q->buckets = buckets;
+  q->num_buckets = num_buckets;
+  q->width = pqueue_tag_estimate_width(q, elements, count);
+  for (size_t i = 0; i < count; i++) {
+    pqueue_tag_link(q, elements[i]);
+  }
+  free(elements);
+  q->least = NULL;
+  q->current_bucket = 0;
+  q->current_day_start = 0;
+}
+
+/**
+ * @brief Return the least element without removing it or NULL if the queue is empty.
+ */
+static pqueue_tag_element_t* pqueue_tag_find_least(pqueue_tag_t* q) {
+  if (q->least != NULL || q->size == 0) {
+    return q->least;
+  }
+  // Scan the days of the current year.
+  size_t bucket = q->current_bucket;
+  uint64_t day_start = q->current_day_start;
+  for (size_t n = 0; n < q->num_buckets; n++) {
+    pqueue_tag_element_t* head = q->buckets[bucket].head;
+    if (head != NULL && pqueue_tag_key(head) - day_start < q->width) {
+      q->current_bucket = bucket;
+      q->current_day_start = day_start;
+      q->least = head;
+      return head;
+    }
+    bucket = (bucket + 1) & (q->num_buckets - 1);
+    day_start += q->width;
+  }
+  // No element in the current year. Search the heads of all buckets directly.
+  pqueue_tag_element_t* least = NULL;
+  for (size_t i = 0; i < q->num_buckets; i++) {
+    pqueue_tag_element_t* head = q->buckets[i].head;
+    if (head != NULL && (least == NULL || pqueue_tag_key(head) < pqueue_tag_key(least) ||
+                         (pqueue_tag_key(head) == pqueue_tag_key(least) && pqueue_tag_cmp(q, head, least) == -1))) {
+      least = head;
+    }
+  }
+  pqueue_tag_set_current_day(q, pqueue_tag_key(least));
+  q->least = least;
+  return least;
+}
+
+/**
+ * @brief Remove an element that is on the queue and shrink the calendar if it has become sparse.
+ */
+static void pqueue_tag_remove_element(pqueue_tag_t* q, pqueue_tag_element_t* e) {
+  pqueue_tag_unlink(q, e);
+  q->size--;
+  if (q->least == e) {
+    q->least = NULL;
+  }
+  if (q->num_buckets > PQUEUE_TAG_MIN_BUCKETS && q->size < q->num_buckets / 2) {
+    pqueue_tag_resize(q, q->num_buckets / 2);
+  }
+}
+
+/**
+ * @brief Callback function to determine whether two elements are equivalent.
+ * Return 1 if the tags contained by given elements are identical, 0 otherwise.
+ * This function is of type pqueue_eq_elem_f.
+ */
+static int pqueue_tag_matches(void* element1, void* element2) {
+  return _lf_tag_compare(((pqueue_tag_element_t*)element1)->tag, ((pqueue_tag_element_t*)element2)->tag) == 0;
+}
+
+/**
+ * @brief Callback function to print information about an element.
+ * This is a function of type pqueue_print_entry_f.
+ */
+static void pqueue_tag_print_element(void* element) {
+  tag_t tag = ((pqueue_tag_element_t*)element)->tag;
+  lf_print("Element with tag " PRINTF_TAG ".", tag.time, tag.microstep);
+}
+
+//////////////////
+// Functions defined in pqueue_tag.h.
+
+int pqueue_tag_compare(pqueue_pri_t priority1, pqueue_pri_t priority2) {
+  // Suppress "error: cast from pointer to integer of different size" by casting to uintptr_t first.
+  return (_lf_tag_compare(((pqueue_tag_element_t*)(uintptr_t)priority1)->tag,
+                         ((pqueue_tag_element_t*)(uintptr_t)priority2)->tag));
+}
+
+pqueue_tag_t* pqueue_tag_init(size_t initial_size) {
+  return pqueue_tag_init_customize(initial_size, pqueue_tag_compare, pqueue_tag_matches, pqueue_tag_print_element);
+}
+
+pqueue_tag_t* pqueue_tag_init_customize(size_t initial_size, pqueue_cmp_pri_f cmppri, pqueue_eq_elem_f eqelem,
+                                        pqueue_print_entry_f prt) {
+  pqueue_tag_t* q = (pqueue_tag_t*)calloc(1, sizeof(pqueue_tag_t));
+  if (q == NULL) {
+    return NULL;
+  }
+  size_t num_buckets = PQUEUE_TAG_MIN_BUCKETS;
+  while (num_buckets < initial_size) {
+    num_buckets <<= 1;
+  }
+  q->buckets = (pqueue_tag_bucket_t*)calloc(num_buckets, sizeof(pqueue_tag_bucket_t));
+  if (q->buckets == NULL) {
+    free(q);
+    return NULL;
+  }
+  q->num_buckets = num_buckets;
+  q->width = LF_CALENDAR_QUEUE_INITIAL_WIDTH;
+  q->cmppri = cmppri;
+  q->eqelem = eqelem;
+  q->prt = prt;
+  return q;
+}
+
+void pqueue_tag_free(pqueue_tag_t* q) {
+  for (size_t i = 0; i < q->num_buckets; i++) {
+    pqueue_tag_element_t* e = q->buckets[i].head;
+    while (e != NULL) {
+      pqueue_tag_element_t* next = e->next;
+      if (e->is_dynamic) {
+        free(e);
+      }
+      e = next;
+    }
+  }
+  free(q->buckets);
+  free(q);
+}
+
+size_t pqueue_tag_size(pqueue_tag_t* q) { return (q == NULL) ? 0 : q->size; }
+
+int pqueue_tag_insert(pqueue_tag_t* q, pqueue_tag_element_t* d) {
+  if (q == NULL) {
+    return 1;
+  }
+  uint64_t key = pqueue_tag_key(d);
+  if (key < q->current_day_start) {
+    // The element precedes the current day.
+    pqueue_tag_set_current_day(q, key);
+  }
+  pqueue_tag_link(q, d);
+  q->size++;
+  if (q->least != NULL && pqueue_tag_cmp(q, d, q->least) == -1) {
+    q->least = d;
+  }
+  if (q->size > 2 * q->num_buckets) {
+    pqueue_tag_resize(q, 2 * q->num_buckets);
+  }
+  return 0;
+}
+
+int pqueue_tag_insert_tag(pqueue_tag_t* q, tag_t t) {
+  pqueue_tag_element_t* d = (pqueue_tag_element_t*)malloc(sizeof(pqueue_tag_element_t));
+  if (d == NULL) {
+    return 1;
+  }
+  d->is_dynamic = 1;
+  d->tag = t;
+  return pqueue_tag_insert(q, d);
+}
+
+pqueue_tag_element_t* pqueue_tag_find_with_tag(pqueue_tag_t* q, tag_t t) {
+  // Create an element on the stack. This element is only needed during
+  // the duration of this function call, so putting it on the stack is OK.
+  pqueue_tag_element_t element = {.tag = t, .pos = 0, .is_dynamic = false};
+  pqueue_tag_bucket_t* bucket = &q->buckets[pqueue_tag_bucket_of(q, pqueue_tag_key(&element))];
+  for (pqueue_tag_element_t* e = bucket->head; e != NULL; e = e->next) {
+    int cmp = pqueue_tag_cmp(q, e, &element);
+    if (cmp == 0) {
+      return e;
+    } else if (cmp == 1) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+pqueue_tag_element_t* pqueue_tag_find_equal_same_tag(pqueue_tag_t* q, pqueue_tag_element_t* e) {
+  pqueue_tag_bucket_t* bucket = &q->buckets[pqueue_tag_bucket_of(q, pqueue_tag_key(e))];
+  for (pqueue_tag_element_t* curr = bucket->head; curr != NULL; curr = curr->next) {
+    int cmp = pqueue_tag_cmp(q, curr, e);
+    if (cmp == 0 && q->eqelem(curr, e)) {
+      return curr;
+    } else if (cmp == 1) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+int pqueue_tag_insert_if_no_match(pqueue_tag_t* q, tag_t t) {
+  if (pqueue_tag_find_with_tag(q, t) == NULL) {
+    return pqueue_tag_insert_tag(q, t);
+  } else {
+    return 1;
+  }
+}
+
+pqueue_tag_element_t* pqueue_tag_peek(pqueue_tag_t* q) { return (q == NULL) ? NULL : pqueue_tag_find_least(q); }
+
+tag_t pqueue_tag_peek_tag(pqueue_tag_t* q) {
+  pqueue_tag_element_t* element = pqueue_tag_peek(q);
+  if (element == NULL)
+    return FOREVER_TAG;
+  else
+    return element->tag;
+}
+
+pqueue_tag_element_t* pqueue_tag_pop(pqueue_tag_t* q) {
+  pqueue_tag_element_t* element = pqueue_tag_peek(q);
+  if (element != NULL) {
+    pqueue_tag_remove_element(q, element);
+  }
+  return element;
+}
+
+size_t pqueue_tag_pop_all_with_tag(pqueue_tag_t* q, tag_t t, vector_t* v) {
+  pqueue_tag_element_t element = {.tag = t, .pos = 0, .is_dynamic = false};
+  pqueue_tag_element_t* least = pqueue_tag_peek(q);
+  if (least == NULL || pqueue_tag_cmp(q, least, &element) != 0) {
+    return 0;
+  }
+  // The least element is at the head of its bucket, and the sorted list of the bucket
+  // holds all other elements with the same tag right after it. Detach them together.
+  pqueue_tag_bucket_t* bucket = &q->buckets[pqueue_tag_bucket_of(q, pqueue_tag_key(least))];
+  size_t count = 0;
+  pqueue_tag_element_t* e = bucket->head;
+  while (e != NULL && pqueue_tag_cmp(q, e, &element) == 0) {
+    pqueue_tag_element_t* next = e->next;
+    e->next = NULL;
+    e->prev = NULL;
+    vector_push(v, e);
+    count++;
+    e = next;
+  }
+  bucket->head = e;
+  if (e == NULL) {
+    bucket->tail = NULL;
+  } else {
+    e->prev = NULL;
+  }
+  q->size -= count;
+  q->least = NULL;
+  if (q->num_buckets > PQUEUE_TAG_MIN_BUCKETS && q->size < q->num_buckets / 2) {
+    size_t num_buckets = q->num_buckets;
+    while (num_buckets > PQUEUE_TAG_MIN_BUCKETS && q->size < num_buckets / 2) {
+      num_buckets /= 2;
+    }
+    pqueue_tag_resize(q, num_buckets);
+  }
+  return count;
+}
+
+tag_t pqueue_tag_pop_tag(pqueue_tag_t* q) {
+  pqueue_tag_element_t* element = pqueue_tag_pop(q);
+  if (element == NULL)
+    return FOREVER_TAG;
+  else {
+    tag_t result = element->tag;
+    if (element->is_dynamic)
+      free(element);
+    return result;
+  }
+}
+
+void pqueue_tag_remove(pqueue_tag_t* q, pqueue_tag_element_t* e) {
+  if (q->size > 0) {
+    pqueue_tag_remove_element(q, e);
+  }
+}
+
+void pqueue_tag_remove_up_to(pqueue_tag_t* q, tag_t t) {
+  tag_t head = pqueue_tag_peek_tag(q);
+  while (_lf_tag_compare(head, FOREVER_TAG) < 0 && _lf_tag_compare(head, t) <= 0) {
+    pqueue_tag_pop_tag(q);
+    head = pqueue_tag_peek_tag(q);
+  }
+}
+
+size_t pqueue_tag_elements(pqueue_tag_t* q, pqueue_tag_element_t** elements) {
+  size_t count = 0;
+  for (size_t i = 0; q != NULL && i < q->num_buckets; i++) {
+    for (pqueue_tag_element_t* e = q->buckets[i].head; e != NULL; e = e->next) {
+      elements[count++] = e;
+    }
+  }
+  return count;
+}
+
+void pqueue_tag_dump(pqueue_tag_t* q) {
+  LF_PRINT_DEBUG("Calendar queue with %zu elements in %zu buckets of width %llu.", q->size, q->num_buckets,
+                 (unsigned long long)q->width);
+  for (size_t i = 0; i < q->num_buckets; i++) {
+    for (pqueue_tag_element_t* e = q->buckets[i].head; e != NULL; e = e->next) {
+      LF_PRINT_DEBUG("bucket %zu:", i);
+      q->prt(e);
+    }
+  }
+}
+
+#endif // LF_CALENDAR_QUEUE
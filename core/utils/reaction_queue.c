@@ -0,0 +1,114 @@
+/**
+ * @file
+ * @brief Queue of reactions ordered by index, with constant-time operations for reactions without deadlines.
+ *
+ * See reaction_queue.h.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "reaction_queue.h"
+#include "util.h"
+
+/** The high-order bits of the index of a reaction that has no deadline. See lf_combine_deadline_and_level. */
+#define NO_DEADLINE (ULLONG_MAX >> 16)
+
+reaction_queue_t* reaction_queue_init(size_t initial_capacity) {
+  reaction_queue_t* q = (reaction_queue_t*)calloc(1, sizeof(reaction_queue_t));
+  LF_ASSERT_NON_NULL(q);
+  q->with_deadline = pqueue_init(initial_capacity, in_reverse_order, get_reaction_index, get_reaction_position,
+                                 set_reaction_position, reaction_matches, print_reaction);
+  q->number_of_levels = (initial_capacity > 0) ? initial_capacity : 1;
+  q->levels = (reaction_t**)calloc(q->number_of_levels, sizeof(reaction_t*));
+  LF_ASSERT_NON_NULL(q->levels);
+  q->min_level = q->number_of_levels;
+  return q;
+}
+
+void reaction_queue_free(reaction_queue_t* q) {
+  pqueue_free(q->with_deadline);
+  free(q->levels);
+  free(q);
+}
+
+size_t reaction_queue_size(reaction_queue_t* q) { return pqueue_size(q->with_deadline) + q->without_deadline; }
+
+void reaction_queue_insert(reaction_queue_t* q, reaction_t* reaction) {
+  if ((reaction->index >> 16) != NO_DEADLINE) {
+#ifdef LF_STATIC_MEMORY
+    // The queue does not grow. Its capacity is LF_MAX_REACTIONS in the environment.
+    if (pqueue_size(q->with_deadline) + 1 >= q->with_deadline->avail) {
+      lf_print_error_and_exit("The reaction queue is full. Increase LF_MAX_REACTIONS.");
+    }
+#endif
+    if (pqueue_insert(q->with_deadline, reaction) != 0) {
+      lf_print_error_and_exit("Could not insert reaction into the reaction queue.");
+    }
+    return;
+  }
+  size_t level = (size_t)LF_LEVEL(reaction->index);
+  if (level >= q->number_of_levels) {
+#ifdef LF_STATIC_MEMORY
+    lf_print_error_and_exit("A reaction has level %zu, which the reaction queue has no room for. "
+                            "Increase LF_MAX_REACTIONS.",
+                            level);
+#endif
+    size_t number_of_levels = q->number_of_levels;
+    while (number_of_levels <= level) {
+      number_of_levels *= 2;
+    }
+    q->levels = (reaction_t**)realloc(q->levels, number_of_levels * sizeof(reaction_t*));
+    LF_ASSERT_NON_NULL(q->levels);
+    memset(q->levels + q->number_of_levels, 0, (number_of_levels - q->number_of_levels) * sizeof(reaction_t*));
+    if (q->min_level == q->number_of_levels) {
+      q->min_level = number_of_levels;
+    }
+    q->number_of_levels = number_of_levels;
+  }
+  // Reactions at the same level without deadlines have equal indexes, so their order does not matter.
+  reaction->next_queued = q->levels[level];
+  q->levels[level] = reaction;
+  q->without_deadline++;
+  if (level < q->min_level) {
+    q->min_level = level;
+  }
+}
+
+reaction_t* reaction_queue_peek(reaction_queue_t* q) {
+  reaction_t* reaction = (reaction_t*)pqueue_peek(q->with_deadline);
+  if (reaction != NULL || q->without_deadline == 0) {
+    return reaction;
+  }
+  while (q->levels[q->min_level] == NULL) {
+    q->min_level++;
+  }
+  return q->levels[q->min_level];
+}
+
+reaction_t* reaction_queue_pop(reaction_queue_t* q) {
+  if (pqueue_size(q->with_deadline) > 0) {
+    return (reaction_t*)pqueue_pop(q->with_deadline);
+  }
+  reaction_t* reaction = reaction_queue_peek(q);
+  if (reaction != NULL) {
+    q->levels[q->min_level] = reaction->next_queued;
+    reaction->next_queued = NULL;
+    q->without_deadline--;
+    if (q->without_deadline == 0) {
+      q->min_level = q->number_of_levels;
+    }
+  }
+  return reaction;
+}
+
+void reaction_queue_dump(reaction_queue_t* q) {
+  pqueue_dump(q->with_deadline, print_reaction);
+  for (size_t level = 0; level < q->number_of_levels; level++) {
+    for (reaction_t* r = q->levels[level]; r != NULL; r = r->next_queued) {
+      print_reaction(r);
+    }
+  }
+}
@@ -0,0 +1,179 @@
+/**
+ * @file
+ * @brief Hierarchical timer wheel with constant-time insertion and removal of timers.
+ *
+ * See timer_wheel.h.
+ */
+
+#include "timer_wheel.h"
+
+#define SLOT_MASK ((uint64_t)TIMER_WHEEL_SLOTS - 1)
+
+/** @brief Return the index of the most significant set bit of `x`, which is not 0. */
+static int highest_bit(uint64_t x) {
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(x);
+#else
+  int bit = 63;
+  while (!(x & (1ULL << bit))) {
+    bit--;
+  }
+  return bit;
+#endif
+}
+
+/** @brief Return the index of the least significant set bit of `x`, which is not 0. */
+static int lowest_bit(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(x);
+#else
+  int bit = 0;
+  while (!(x & (1ULL << bit))) {
+    bit++;
+  }
+  return bit;
+#endif
+}
+
+static uint64_t tick_of(instant_t time) { return time < 0 ? 0 : (uint64_t)time >> TIMER_WHEEL_TICK_BITS; }
+
+/** @brief Return the digit of `tick` that selects the slot in `level`. */
+static int digit_of(uint64_t tick, int level) { return (int)((tick >> (level * TIMER_WHEEL_SLOT_BITS)) & SLOT_MASK); }
+
+static void unlink_entry(timer_wheel_t* wheel, timer_wheel_entry_t* entry) {
+  if (entry->prev != NULL) {
+    entry->prev->next = entry->next;
+  } else {
+    wheel->slots[entry->level][entry->slot] = entry->next;
+    if (entry->next == NULL) {
+      wheel->occupied[entry->level] &= ~(1ULL << entry->slot);
+    }
+  }
+  if (entry->next != NULL) {
+    entry->next->prev = entry->prev;
+  }
+  entry->next = NULL;
+  entry->prev = NULL;
+}
+
+/** @brief Put an entry that is not linked into the slot for its expiration relative to the current tick. */
+static void place(timer_wheel_t* wheel, timer_wheel_entry_t* entry) {
+  uint64_t tick = tick_of(entry->expiration);
+  if (tick < wheel->now) {
+    tick = wheel->now;
+  }
+  uint64_t difference = tick ^ wheel->now;
+  int level = difference == 0 ? 0 : highest_bit(difference) / TIMER_WHEEL_SLOT_BITS;
+  int slot = digit_of(tick, level);
+  entry->level = (uint8_t)level;
+  entry->slot = (uint8_t)slot;
+  entry->prev = NULL;
+  entry->next = wheel->slots[level][slot];
+  if (entry->next != NULL) {
+    entry->next->prev = entry;
+  }
+  wheel->slots[level][slot] = entry;
+  wheel->occupied[level] |= 1ULL << slot;
+}
+
+/**
+ * @brief Advance the current tick to `tick` and redistribute the entries of the slots that it passes.
+ *
+ * Let `top` be the highest level in which the digits of the old and the new tick differ. Entries
+ * in levels below `top` and in slots of `top` up to and including the new digit are redistributed.
+ * Expired ones go to the current slot of level 0. Entries in other slots stay where they are,
+ * because their position relative to the new tick is the same as relative to the old one.
+ */
+static void advance(timer_wheel_t* wheel, uint64_t tick) {
+  if (tick <= wheel->now) {
+    return;
+  }
+  int top = highest_bit(tick ^ wheel->now) / TIMER_WHEEL_SLOT_BITS;
+  int from = digit_of(wheel->now, top);
+  int to = digit_of(tick, top);
+  wheel->now = tick;
+  for (int level = 0; level <= top; level++) {
+    uint64_t slots = wheel->occupied[level];
+    if (level == top) {
+      // Slots from `from` to `to`, inclusive. `to` is at most TIMER_WHEEL_SLOTS - 1.
+      slots &= ((2ULL << to) - 1) & ~((1ULL << from) - 1);
+    }
+    while (slots != 0) {
+      int slot = lowest_bit(slots);
+      slots &= slots - 1;
+      timer_wheel_entry_t* entry = wheel->slots[level][slot];
+      wheel->slots[level][slot] = NULL;
+      wheel->occupied[level] &= ~(1ULL << slot);
+      while (entry != NULL) {
+        timer_wheel_entry_t* next = entry->next;
+        place(wheel, entry);
+        entry = next;
+      }
+    }
+  }
+}
+
+void timer_wheel_init(timer_wheel_t* wheel, instant_t now) {
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    wheel->occupied[level] = 0;
+    for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+      wheel->slots[level][slot] = NULL;
+    }
+  }
+  wheel->now = tick_of(now);
+  wheel->size = 0;
+}
+
+void timer_wheel_insert(timer_wheel_t* wheel, timer_wheel_entry_t* entry, instant_t expiration) {
+  if (entry->scheduled) {
+    unlink_entry(wheel, entry);
+  } else {
+    entry->scheduled = true;
+    wheel->size++;
+  }
+  entry->expiration = expiration;
+  place(wheel, entry);
+}
+
+void timer_wheel_remove(timer_wheel_t* wheel, timer_wheel_entry_t* entry) {
+  if (entry->scheduled) {
+    unlink_entry(wheel, entry);
+    entry->scheduled = false;
+    wheel->size--;
+  }
+}
+
+timer_wheel_entry_t* timer_wheel_pop(timer_wheel_t* wheel, instant_t now) {
+  advance(wheel, tick_of(now));
+  for (timer_wheel_entry_t* entry = wheel->slots[0][digit_of(wheel->now, 0)]; entry != NULL; entry = entry->next) {
+    if (entry->expiration <= now) {
+      timer_wheel_remove(wheel, entry);
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+instant_t timer_wheel_next_wakeup(timer_wheel_t* wheel) {
+  if (wheel->size == 0) {
+    return FOREVER;
+  }
+  int level = 0;
+  while (wheel->occupied[level] == 0) {
+    level++;
+  }
+  int slot = lowest_bit(wheel->occupied[level]);
+  if (level == 0) {
+    // All entries of the slot are in the same tick, but their expirations differ within it.
+    instant_t earliest = FOREVER;
+    for (timer_wheel_entry_t* entry = wheel->slots[0][slot]; entry != NULL; entry = entry->next) {
+      if (entry->expiration < earliest) {
+        earliest = entry->expiration;
+      }
+    }
+    return earliest;
+  }
+  int shift = (level + 1) * TIMER_WHEEL_SLOT_BITS;
+  uint64_t tick = ((wheel->now >> shift) << shift) | ((uint64_t)slot << (level * TIMER_WHEEL_SLOT_BITS));
+  return (instant_t)(tick << TIMER_WHEEL_TICK_BITS);
+}
@@ -84,6 +84,45 @@ static void lf_vprint_fatal_error(const char* format, va_list args) {
   _lf_message_print("FATAL ERROR: ", format, args, LOG_LEVEL_ERROR);
 }
 
+void _lf_message_write(const char* prefix, const char* format, va_list args) {
+  // Rather than calling printf() multiple times, we need to call it just
+  // once because this function is invoked by multiple threads.
+  // If we make multiple calls to printf(), then the results could be
+  // interleaved between threads.
+  // vprintf() is a version that takes an arg list rather than multiple args.
+  char* message;
+  if (_lf_my_fed_id < 0) {
+    size_t length = strlen(prefix) + strlen(format) + 32;
+    message = (char*)malloc(length + 1);
+    snprintf(message, length, "%s%s\n", prefix, format);
+  } else {
+#if defined STANDALONE_RTI
+    size_t length = strlen(prefix) + strlen(format) + 37;
+    message = (char*)malloc(length + 1);
+    snprintf(message, length, "RTI: %s%s\n", prefix, format);
+#else
+    // Get the federate name from the top-level environment, which by convention is the first.
+    environment_t* envs;
+    _lf_get_environments(&envs);
+    char* name = envs->name;
+    size_t length = strlen(prefix) + strlen(format) + +strlen(name) + 32;
+    message = (char*)malloc(length + 1);
+    // If the name has prefix "federate__", strip that out.
+    if (strncmp(name, "federate__", 10) == 0)
+      name += 10;
+
+    snprintf(message, length, "Fed %d (%s): %s%s\n", _lf_my_fed_id, name, prefix, format);
+#endif // STANDALONE_RTI
+  }
+  if (print_message_function == NULL) {
+    // NOTE: Send all messages to stdout, not to stderr, so that ordering makes sense.
+    vfprintf(stdout, message, args);
+  } else {
+    (*print_message_function)(message, args);
+  }
+  free(message);
+}
+
 /**
  * Internal implementation of the next few reporting functions.
  */
@@ -106,42 +145,14 @@ void _lf_message_print(const char* prefix, const char* format, va_list args,
     print_level = LOG_LEVEL_INFO;
   }
   if (log_level <= print_level) {
-    // Rather than calling printf() multiple times, we need to call it just
-    // once because this function is invoked by multiple threads.
-    // If we make multiple calls to printf(), then the results could be
-    // interleaved between threads.
-    // vprintf() is a version that takes an arg list rather than multiple args.
-    char* message;
-    if (_lf_my_fed_id < 0) {
-      size_t length = strlen(prefix) + strlen(format) + 32;
-      message = (char*)malloc(length + 1);
-      snprintf(message, length, "%s%s\n", prefix, format);
-    } else {
-#if defined STANDALONE_RTI
-      size_t length = strlen(prefix) + strlen(format) + 37;
-      message = (char*)malloc(length + 1);
-      snprintf(message, length, "RTI: %s%s\n", prefix, format);
-#else
-      // Get the federate name from the top-level environment, which by convention is the first.
-      environment_t* envs;
-      _lf_get_environments(&envs);
-      char* name = envs->name;
-      size_t length = strlen(prefix) + strlen(format) + +strlen(name) + 32;
-      message = (char*)malloc(length + 1);
-      // If the name has prefix "federate__", strip that out.
-      if (strncmp(name, "federate__", 10) == 0)
-        name += 10;
-
-      snprintf(message, length, "Fed %d (%s): %s%s\n", _lf_my_fed_id, name, prefix, format);
-#endif // STANDALONE_RTI
-    }
-    if (print_message_function == NULL) {
-      // NOTE: Send all messages to stdout, not to stderr, so that ordering makes sense.
-      vfprintf(stdout, message, args);
-    } else {
-      (*print_message_function)(message, args);
+#if defined(LF_ASYNC_LOG) && !defined(LF_SINGLE_THREADED)
+    // Errors are written right away, after the messages queued before them.
+    if (log_level > LOG_LEVEL_ERROR && _lf_async_log_vprint(prefix, format, args)) {
+      return;
     }
-    free(message);
+    lf_async_log_flush();
+#endif
+    _lf_message_write(prefix, format, args);
   }
 }
 
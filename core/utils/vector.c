@@ -6,6 +6,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <string.h>
 #include "vector.h"
 
 #define REQUIRED_VOTES_TO_SHRINK 15
@@ -28,13 +29,33 @@ vector_t vector_new(size_t initial_capacity) {
                     .votes = 0};
 }
 
+/**
+ * Initialize a vector that stores up to `capacity` elements in `buffer`,
+ * which is provided by the owner of the vector.
+ * @param v The vector to initialize.
+ * @param buffer An array of at least `capacity` pointers.
+ * @param capacity The number of elements that fit in the buffer.
+ */
+void vector_init_with_buffer(vector_t* v, void** buffer, size_t capacity) {
+  assert(buffer && capacity > 0);
+  *v = (vector_t){.start = buffer,
+                  .next = buffer,
+                  .end = buffer + capacity,
+                  .votes_required = REQUIRED_VOTES_TO_SHRINK,
+                  .votes = 0,
+                  .buffer = buffer,
+                  .buffer_capacity = capacity};
+}
+
 /**
  * Free the memory held by the given vector, invalidating it.
  * @param v Any vector.
  */
 void vector_free(vector_t* v) {
   assert(v);
-  free(v->start);
+  if (v->start != v->buffer) {
+    free(v->start);
+  }
 }
 
 /**
@@ -87,6 +108,12 @@ void* vector_pop(vector_t* v) {
   return *(--v->next);
 }
 
+/**
+ * Remove all elements from the vector, keeping its memory for reuse.
+ * @param v Any vector.
+ */
+void vector_clear(vector_t* v) { v->next = v->start; }
+
 /**
  * Return a pointer to where the vector element at 'idx' is stored.
  * This can be used to set the value of the element or to read it.
@@ -153,8 +180,24 @@ static void vector_resize(vector_t* v, size_t new_capacity) {
   }
   size_t size = v->next - v->start;
   assert(size <= new_capacity);
-  void** start = (void**)realloc(v->start, new_capacity * sizeof(void*));
-  assert(start);
+  void** start;
+  if (v->buffer != NULL && new_capacity <= v->buffer_capacity) {
+    // Shrink into the buffer of the owner, and not below it.
+    new_capacity = v->buffer_capacity;
+    start = v->buffer;
+    if (v->start != v->buffer) {
+      memcpy(start, v->start, size * sizeof(void*));
+      free(v->start);
+    }
+  } else if (v->buffer != NULL && v->start == v->buffer) {
+    // Grow out of the buffer of the owner.
+    start = (void**)malloc(new_capacity * sizeof(void*));
+    assert(start);
+    memcpy(start, v->start, size * sizeof(void*));
+  } else {
+    start = (void**)realloc(v->start, new_capacity * sizeof(void*));
+    assert(start);
+  }
   v->votes = 0;
   v->start = start;
   v->next = start + size;
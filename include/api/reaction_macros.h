@@ -110,6 +110,40 @@
   } while (0)
 #endif
 
+/**
+ * @brief Set the specified output (or input of a contained reactor)
+ * to the specified array with the given length, taking ownership of it.
+ *
+ * Like `lf_set_array`, this sends the array without copying it. The array is
+ * released with the specified destructor, rather than the destructor of the port,
+ * once all downstream reactions no longer need it. To send a payload drawn from the
+ * pool of the port with `lf_token_pool_alloc`, give `lf_token_pool_free`.
+ *
+ * @param out The output port (by name).
+ * @param val The array to send (a pointer to the first element).
+ * @param len The length of the array to send.
+ * @param dtor The function that releases the array, or NULL to use the destructor of the port.
+ */
+#ifndef __cplusplus
+#define lf_set_move(out, val, len, dtor)                                                                               \
+  do {                                                                                                                 \
+    lf_set_present(out);                                                                                               \
+    lf_token_t* token = _lf_initialize_token_with_value((token_template_t*)out, val, len);                             \
+    token->destructor = dtor;                                                                                          \
+    out->value = token->value;                                                                                         \
+    out->length = len;                                                                                                 \
+  } while (0)
+#else
+#define lf_set_move(out, val, len, dtor)                                                                               \
+  do {                                                                                                                 \
+    lf_set_present(out);                                                                                               \
+    lf_token_t* token = _lf_initialize_token_with_value((token_template_t*)out, val, len);                             \
+    token->destructor = dtor;                                                                                          \
+    out->value = static_cast<decltype(out->value)>(token->value);                                                      \
+    out->length = len;                                                                                                 \
+  } while (0)
+#endif
+
 /**
  * @brief Set the specified output (or input of a contained reactor)
  * to the specified token value.
@@ -15,6 +15,7 @@
 
 #undef lf_set
 #undef lf_set_token
+#undef lf_set_move
 #undef lf_set_destructor
 #undef lf_set_copy_constructor
 
@@ -106,6 +106,11 @@ trigger_handle_t lf_schedule_int(void* action, interval_t extra_delay, int value
  * properties or on the command line.
  * The third condition is that the trigger argument is null.
  *
+ * In the threaded runtime, the event of a physical action is staged, stamped with the
+ * current physical time, without acquiring the mutex of the environment, and is moved
+ * to the event queue by the workers when they next look for the next tag. The above
+ * conditions are then checked when the event is moved, and this function returns 1.
+ *
  * @param action The action to be triggered (a pointer to an `lf_action_base_t`).
  * @param extra_delay Extra offset of the event release above that in the action.
  * @param token The token to carry the payload or null for no payload.
@@ -113,6 +118,99 @@ trigger_handle_t lf_schedule_int(void* action, interval_t extra_delay, int value
  */
 trigger_handle_t lf_schedule_token(void* action, interval_t extra_delay, lf_token_t* token);
 
+/**
+ * @brief Schedule several events of the specified action at once, as if lf_schedule_token
+ * were called for each of them in order.
+ *
+ * For a logical action, the mutex of the environment is acquired once for all the events,
+ * and the workers are notified once. For a physical action in the threaded runtime, all the
+ * events are stamped with the same physical time and staged with one atomic operation.
+ *
+ * @param action The action to be triggered (a pointer to an `lf_action_base_t`).
+ * @param count The number of events.
+ * @param extra_delays The extra delay of each event.
+ * @param tokens The token of each event, or null for events without payloads. Each may be null.
+ * @param handles If not null, an array of `count` handles, which receives the value that
+ *  lf_schedule_token would have returned for each event. For a physical action in the threaded
+ *  runtime, each is the return value of this function, as the events are staged together.
+ * @return The handle of the last event that was scheduled, 0 if none was, or -1 if scheduling
+ *  any of them failed. For a physical action in the threaded runtime, 1 if there were events.
+ */
+trigger_handle_t lf_schedule_tokens(void* action, size_t count, const interval_t* extra_delays, lf_token_t** tokens,
+                                    trigger_handle_t* handles);
+
+/**
+ * @brief Limit the number of events of a physical action that are staged but not yet on the
+ * event queue, and choose what happens to events beyond that.
+ *
+ * With the `lf_overload_reject` policy, the lf_schedule functions return -1 for an event beyond
+ * the capacity and free its token. With `lf_overload_drop_oldest`, the event is accepted and
+ * the oldest pending events of the action are dropped when the workers next move staged events
+ * to the event queue. With `lf_overload_coalesce`, the newest pending events beyond the capacity
+ * are merged into one, which keeps the tag of the oldest of them and gets the payload of the
+ * newest. See also lf_environment_set_ingress_limits. Limits are only enforced by the threaded
+ * runtime.
+ *
+ * @param action The physical action (a pointer to an `lf_action_base_t`).
+ * @param capacity The number of events allowed, or 0 for no limit.
+ * @param policy What to do with the events beyond the capacity.
+ * @return 0, or -1 if the action is not physical or the runtime is single-threaded.
+ */
+int lf_action_set_capacity(void* action, size_t capacity, lf_overload_policy_t policy);
+
+/**
+ * @brief Deliver events of a physical action that arrive close together as one event.
+ *
+ * An event of the action whose tag would be at most `window` after the tag of the latest
+ * event of the action that is still on the event queue, including one deferred there by the
+ * minimum spacing of the action, is appended to that event instead: its payload is appended
+ * to the array payload of that event, so that the reactions to the action execute once with
+ * all the values, in the order of arrival, rather than once per value at successive tags.
+ * An event is only appended if both events carry payloads of the same type without a
+ * destructor or copy constructor and the payload of the earlier one is not shared, is not
+ * from a pool and has no destructor of its own. Otherwise, it is scheduled as usual.
+ *
+ * @param action The physical action (a pointer to an `lf_action_base_t`).
+ * @param window The largest distance between the tags of events that are batched, 0 for only
+ *  events that would get the same or an earlier tag, or a negative value to stop batching.
+ * @return 0, or -1 if the action is not physical.
+ */
+int lf_action_set_batch_window(void* action, interval_t window);
+
+/**
+ * @brief Give a physical action a ring of fixed size through which an interrupt service
+ * routine schedules its events with lf_schedule_isr().
+ *
+ * In the single-threaded runtime, the lf_schedule functions disable interrupts while they insert
+ * an event into the event queue, which delays every other interrupt. lf_schedule_isr() instead
+ * writes the physical time and the value of the event into the next slot of the ring, in constant
+ * time and without disabling interrupts, and the main loop moves the events of all rings to the
+ * event queue before it looks for the next tag, in the order in which they were pushed. The
+ * events of one ring must be pushed by one interrupt service routine at a time. This is to be
+ * called at startup, before the interrupt is enabled, and allocates the ring.
+ *
+ * The threaded runtime stages the events of physical actions without a lock anyway, so this does
+ * nothing there, and lf_schedule_isr() is lf_schedule_copy().
+ *
+ * @param action The physical action (a pointer to an `lf_action_base_t`).
+ * @param capacity The number of events that may be pushed and not yet moved to the event queue,
+ *  which is rounded up to a power of two. At most 128 on AVR and 65536 elsewhere.
+ * @return 0, or -1 if the action is not physical, already has a ring, the capacity is out of range
+ *  or the ring cannot be allocated.
+ */
+int lf_action_set_isr_ring(void* action, size_t capacity);
+
+/**
+ * @brief Schedule an event of a physical action from an interrupt service routine through the
+ * ring of the action, with no extra delay. See lf_action_set_isr_ring().
+ *
+ * @param action The physical action (a pointer to an `lf_action_base_t`) with a ring.
+ * @param value A pointer to the value of the event, of the size of an element of the payload of
+ *  the action, which is copied into the ring, or NULL for an event without a value.
+ * @return 1, or -1 if the action has no ring or the ring is full, in which case the event is dropped.
+ */
+trigger_handle_t lf_schedule_isr(void* action, const void* value);
+
 /**
  * @brief Schedule an action to occur with the specified value and time offset with a
  * copy of the specified value.
@@ -159,6 +257,31 @@ trigger_handle_t lf_schedule_copy(void* action, interval_t offset, void* value,
  */
 trigger_handle_t lf_schedule_value(void* action, interval_t extra_delay, void* value, int length);
 
+/**
+ * @brief Variant of lf_schedule_value that takes ownership of a buffer with its own destructor.
+ *
+ * The buffer becomes the payload of the event without being copied, as with
+ * lf_schedule_value, but it need not have been allocated with malloc. Once the
+ * payload is no longer needed, it is released with the specified destructor rather
+ * than the destructor of the action. The caller must not use the buffer afterwards.
+ * A buffer obtained with lf_token_pool_alloc() is released with lf_token_pool_free().
+ *
+ * See lf_schedule_token(), which this uses, for details.
+ *
+ * @param action The action to be triggered (a pointer to an `lf_action_base_t`).
+ * @param extra_delay Extra offset of the event release above that in the
+ *  action.
+ * @param value The buffer containing the value to send.
+ * @param length The length of the array, if it is an array, or 1 for a scalar
+ *  and 0 for no payload.
+ * @param destructor The function that releases the buffer, or NULL to use the
+ *  destructor of the action.
+ * @return A handle to the event, or 0 if no event was scheduled, or -1 for
+ *  error.
+ */
+trigger_handle_t lf_schedule_move(void* action, interval_t extra_delay, void* value, size_t length,
+                                  void (*destructor)(void* value));
+
 /**
  * @brief Schedule the specified trigger to execute in the specified environment with given delay and token.
  *
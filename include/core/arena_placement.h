@@ -0,0 +1,67 @@
+/**
+ * @file
+ * @brief Placement of the reactors in the arena by the messages that they exchange.
+ *
+ * With LF_ARENA_ALLOCATION, the reactors and the memory recorded on them, such as the arrays of
+ * their multiports, are carved from the arena in the order in which the program creates them.
+ * Reactors that exchange messages at every tag may then be far apart, and the memory recorded on
+ * a reactor, which is typically allocated after all reactors have been created, is far from its
+ * self struct. When LF_ARENA_PLACEMENT is defined, which implies LF_ARENA_ALLOCATION, the runtime
+ * writes a placement of these allocations to the file LF_ARENA_PLACEMENT_FILE on normal
+ * termination, and the next run of the program lays them out in one block of the arena as the
+ * file gives, so that reactions that run one after another share cache lines and pages.
+ *
+ * The placement puts the memory recorded on a reactor right after its self struct. With
+ * LF_REACTION_PROFILE, it also puts next to each other the reactors whose reactions trigger each
+ * other: starting from the reactor with the most invocations along its edges, it follows the
+ * edges to the reactors that have not been placed yet, heaviest first, depth first. The weight of
+ * an edge between two reactors is the number of invocations of the reactions along it. Reactors
+ * none of whose reactions triggered another keep the order in which they were created.
+ *
+ * An allocation is identified by its order, so the file is only valid for the same build of the
+ * program, run with the same parameters. If an allocation has another size than the file gives,
+ * a warning is printed and the later allocations are carved from the arena as without placement.
+ */
+
+#ifndef ARENA_PLACEMENT_H
+#define ARENA_PLACEMENT_H
+
+#include <stddef.h>
+
+#include "lf_types.h"
+
+/**
+ * The file from which the placement is read at the first allocation and to which it is written
+ * on normal termination.
+ */
+#ifndef LF_ARENA_PLACEMENT_FILE
+#define LF_ARENA_PLACEMENT_FILE "arena_placement.txt"
+#endif
+
+///////////////////// Internal functions /////////////////////
+// The following functions are internal to the runtime and should not be documented by Doxygen.
+/// \cond INTERNAL  // Doxygen conditional.
+
+/**
+ * @brief Allocate zeroed memory recorded on a list, at the place that the placement file gives.
+ * @param bytes The number of bytes, a multiple of sizeof(max_align_t).
+ * @param head The list on which the memory is recorded, which is _lf_reactors_to_free for a self
+ *  struct and the allocations of its self struct for the memory of a reactor.
+ * @param carve The function that carves zeroed memory from the arena, which is used for the block
+ *  of the placement and for the allocations that are not placed.
+ * @return A pointer to the allocated memory.
+ */
+void* _lf_arena_placement_allocate(size_t bytes, struct allocation_record_t** head,
+                                   void* (*carve)(size_t count, size_t size));
+
+/**
+ * @brief Write the placement of the allocations so far to LF_ARENA_PLACEMENT_FILE.
+ * This must be called before the reactors and the environments are freed.
+ * @param envs The environments.
+ * @param num_envs The number of environments.
+ */
+void _lf_arena_placement_write(environment_t* envs, int num_envs);
+
+/// \endcond // INTERNAL
+
+#endif // ARENA_PLACEMENT_H
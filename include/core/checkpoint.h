@@ -0,0 +1,144 @@
+/**
+ * @file
+ * @brief Checkpoints of the state of a running program, from which a new run can resume.
+ *
+ * When LF_CHECKPOINT is defined, a reaction can call lf_checkpoint() to save the state of its
+ * environment to a file at the start of the next tag, when no reaction is executing. A new run
+ * of the same program given the `--restore <file>` command-line argument then resumes from the
+ * checkpoint instead of starting afresh: it neither triggers the startup reactions nor starts
+ * the timers, but restores the state of the reactors and the events that were pending.
+ *
+ * The state of a reactor is saved only if the reactor is registered with
+ * lf_checkpoint_register(), which is done while the reactors are constructed, for example in
+ * `_lf_initialize_trigger_objects()`, so that the registrations of the two runs match. Self
+ * structs hold pointers that are only valid in the run that created them, so the state
+ * variables are saved and restored by functions that the reactor provides. The events on
+ * the event queue are saved with their payloads, which must be plain data, that is, have
+ * neither a destructor nor a copy constructor. The trigger of an event is identified by the
+ * registered reactor whose self struct contains it, so every reactor with an action, a timer,
+ * or an input that can have a pending event has to be registered, even if it has no state.
+ *
+ * The checkpoint is written to a temporary file through a memory mapping and then renamed, so
+ * that a crash while writing leaves the previous checkpoint in place. The tag at which it was
+ * taken becomes the start tag of the new run, and the pending events keep their distance in
+ * logical time from it. The file is only valid for the same build of the program.
+ *
+ * Federated programs and modal reactors are not supported.
+ *
+ * Federates with LF_FEDERATED_OPTIMISTIC (see federate.c) take checkpoints in memory with the
+ * same registrations, from which they roll back. Only the registrations and the functions for
+ * checkpoints in memory are then available, unless LF_CHECKPOINT is also defined.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "environment.h"
+
+#if defined(LF_CHECKPOINT) && !defined(PLATFORM_Linux) && !defined(PLATFORM_Darwin)
+#error "LF_CHECKPOINT is only supported on Linux and macOS"
+#endif
+
+#if defined(LF_CHECKPOINT) && (defined(FEDERATED) || defined(MODAL_REACTORS))
+#error "LF_CHECKPOINT is not supported for federated programs or modal reactors"
+#endif
+
+/**
+ * @brief Function that saves the state of a reactor.
+ * @param self The self struct of the reactor.
+ * @param buffer Where to write the state, or NULL if only its size is wanted.
+ * @param capacity The number of bytes at `buffer`.
+ * @return The number of bytes of the state, which is written only if it fits in `capacity`.
+ */
+typedef size_t (*lf_checkpoint_save_t)(void* self, void* buffer, size_t capacity);
+
+/**
+ * @brief Function that restores the state of a reactor.
+ * @param self The self struct of the reactor.
+ * @param buffer The state written by the lf_checkpoint_save_t function of the reactor.
+ * @param size The number of bytes of the state.
+ * @return 0 on success or -1 if the state is not valid.
+ */
+typedef int (*lf_checkpoint_restore_t)(void* self, const void* buffer, size_t size);
+
+/**
+ * @brief Register a reactor whose state and pending events are saved in checkpoints.
+ * @param self The self struct of the reactor.
+ * @param self_size The size of the self struct.
+ * @param save The function that saves the state, or NULL if the reactor has no state.
+ * @param restore The function that restores the state, or NULL if the reactor has no state.
+ */
+void lf_checkpoint_register(self_base_t* self, size_t self_size, lf_checkpoint_save_t save,
+                            lf_checkpoint_restore_t restore);
+
+#ifdef LF_CHECKPOINT
+/**
+ * @brief Request that the state of the environment be saved to `file` at the start of the next tag.
+ * A later request before then replaces the file.
+ * @param env The environment.
+ * @param file The name of the file, which is copied.
+ */
+void lf_checkpoint(environment_t* env, const char* file);
+
+/**
+ * @brief Save the state of the environment if a checkpoint has been requested.
+ * This is called at the start of a tag, before its events are taken off the event queue.
+ * @param env The environment.
+ */
+void _lf_checkpoint_save_if_requested(environment_t* env);
+
+/**
+ * @brief If the `--restore` command-line argument names a checkpoint of the environment,
+ * restore the state of its reactors and its pending events.
+ * This is called at the start tag, when the startup reactions would be triggered.
+ * @param env The environment.
+ * @return true if the environment was restored, in which case the startup reactions must
+ *  not be triggered and the timers must not be started.
+ */
+bool _lf_checkpoint_restore(environment_t* env);
+#endif // LF_CHECKPOINT
+
+#ifdef LF_FEDERATED_OPTIMISTIC
+/** @brief A checkpoint in memory, whose block is reused by the next checkpoint taken into it. */
+typedef struct lf_checkpoint_memory_t {
+  char* block;
+  size_t size;     // The size of the checkpoint.
+  size_t capacity; // The size of `block`.
+  tag_t tag;       // The tag at which the checkpoint was taken.
+} lf_checkpoint_memory_t;
+
+/**
+ * @brief Save the state of the environment and some of its pending events to memory.
+ * This is called at the start of a tag, before its events are taken off the event queue.
+ * @param env The environment.
+ * @param keep Function that returns whether the pending events of a trigger are saved.
+ * @param checkpoint The checkpoint, which is replaced.
+ * @return 0 on success or -1 if the state cannot be saved, which has been reported.
+ */
+int _lf_checkpoint_to_memory(environment_t* env, bool (*keep)(trigger_t*), lf_checkpoint_memory_t* checkpoint);
+
+/**
+ * @brief Restore the state of the environment from a checkpoint in memory and schedule its events.
+ * The current tag must have been set back before the tag of the checkpoint.
+ * @param env The environment.
+ * @param checkpoint The checkpoint.
+ */
+void _lf_checkpoint_from_memory(environment_t* env, const lf_checkpoint_memory_t* checkpoint);
+
+/**
+ * @brief Free the block of a checkpoint in memory.
+ * @param checkpoint The checkpoint.
+ */
+void _lf_checkpoint_free_memory(lf_checkpoint_memory_t* checkpoint);
+#endif // LF_FEDERATED_OPTIMISTIC
+
+/**
+ * @brief Free the registrations and any pending request of the environment.
+ * @param env The environment.
+ */
+void _lf_checkpoint_free(environment_t* env);
+
+#endif // CHECKPOINT_H
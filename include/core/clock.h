@@ -20,21 +20,51 @@
  * interrupted by an asynchronous scheduling. This is used by the single-threaded
  * runtime. Before calling the appropriate function in the platform API, the
  * wakeup_time will be translated into the correct timescale by removing any
- * clock synchronization offset.
+ * clock synchronization offset. The timer slack and the spin-wait threshold
+ * of the environment are applied (see lf_environment_set_spin_wait).
 
  * @return 0 on success or -1 if interrupted.
  */
 int lf_clock_interruptable_sleep_until_locked(environment_t* env, instant_t wakeup_time);
 
+/**
+ * Set the timer slack of the calling thread, if it differs from the slack last set by this
+ * function on the thread. This does nothing on platforms other than Linux.
+ * @param slack The timer slack, 0 for the default of the operating system, or -1 to leave it unchanged.
+ */
+void lf_clock_set_timer_slack(interval_t slack);
+
+/**
+ * Busy-wait until physical time reaches wakeup_time or, if `changes` is not NULL,
+ * until the value it points to differs from `seen`.
+ * @param wakeup_time The physical time, including any clock synchronization offset, to wait for.
+ * @param changes A counter that is atomically incremented to interrupt the wait, or NULL.
+ * @param seen The value of the counter when the caller decided to wait.
+ * @return 0 if wakeup_time was reached, -1 if the wait was interrupted.
+ */
+int lf_clock_spin_until(instant_t wakeup_time, int32_t* changes, int32_t seen);
+
 /**
  * Retrieve the current physical time from the platform API. This adds any clock synchronization offset
- * and guarantees monotonicity. Specifically, each returned value will be at least one nanosecond larger
- * than any previously returned time.
+ * and guarantees monotonicity. Specifically, each returned value will be no smaller than any time
+ * previously returned to the calling thread and than any time returned by lf_clock_gettime_fenced.
+ * Times read by other threads with this function are not taken into account, so no shared state is
+ * written and concurrent reads do not contend.
  * @param now A pointer to the location in which to store the result.
  * @return 0 on success, -1 on failure to read the platform clock.
  */
 int lf_clock_gettime(instant_t* now);
 
+/**
+ * Retrieve the current physical time like lf_clock_gettime, but also guarantee that
+ * the returned value is no smaller than any time previously returned by this function
+ * in any thread. Use this where times read by different threads must be ordered,
+ * for example when physical time determines a tag.
+ * @param now A pointer to the location in which to store the result.
+ * @return 0 on success, -1 on failure to read the platform clock.
+ */
+int lf_clock_gettime_fenced(instant_t* now);
+
 #if !defined(LF_SINGLE_THREADED)
 /**
  * Block the calling thread on the condition variable until it is
@@ -0,0 +1,63 @@
+/**
+ * @file
+ * @brief Energy-aware scaling of the CPU frequency from the utilization and the deadline slack.
+ *
+ * When LF_DVFS is defined, which is supported on Linux only, the runtime asks the CPUs to run
+ * slower when the program has headroom and faster when it has little, through
+ * lf_cpu_set_performance(), which sets the frequency with the userspace cpufreq governor or
+ * else clamps the utilization that the threads of the program ask of the `schedutil` governor.
+ *
+ * The headroom is measured on the logical timeline. Each environment is busy from the start of
+ * a tag until it looks for the next one, and idle while it waits for physical time to reach the
+ * next tag. Every LF_DVFS_PERIOD (100 ms by default), the performance is set so that the busiest
+ * environment would be busy for LF_DVFS_TARGET_UTILIZATION percent of the time (70 by default),
+ * assuming that busy time scales with the inverse of the performance, but not below
+ * LF_DVFS_MIN_PERFORMANCE percent (30 by default). In fast mode, nothing waits, so the CPUs run
+ * at full speed.
+ *
+ * The deadline slack is measured by the reaction profile (see reaction_profile.h), which LF_DVFS
+ * enables: when a reaction with a deadline ends with less than LF_DVFS_SLACK_LOW percent of its
+ * deadline left (25 by default), the performance is raised to the maximum right away, and it is
+ * not lowered in a period in which a reaction ended with less than twice that slack.
+ *
+ * The performance is set back to the maximum when the program terminates.
+ */
+
+#ifndef DVFS_H
+#define DVFS_H
+
+#include "lf_types.h"
+#include "environment.h"
+
+#if defined(LF_DVFS) && !defined(PLATFORM_Linux)
+#error "LF_DVFS is only supported on Linux"
+#endif
+
+/**
+ * @brief Record that the environment starts processing a tag.
+ * @param env The environment.
+ */
+void lf_dvfs_tag_started(environment_t* env);
+
+/**
+ * @brief Record that the environment is done with its tag and looks for the next one, and
+ * adjust the performance at the end of each period.
+ * @param env The environment.
+ */
+void lf_dvfs_tag_completed(environment_t* env);
+
+/**
+ * @brief Record the slack with which an invocation of a reaction with a deadline ended.
+ * This is called by the worker that executed the reaction, without holding the mutex of the environment.
+ * @param env The environment of the reaction.
+ * @param reaction The reaction, which has a deadline.
+ * @param end The physical time at which the invocation ended.
+ */
+void lf_dvfs_reaction_ended(environment_t* env, reaction_t* reaction, instant_t end);
+
+/**
+ * @brief Set the performance back to the maximum.
+ */
+void lf_dvfs_terminate(void);
+
+#endif // DVFS_H
@@ -19,6 +19,81 @@
 #include "lf_types.h"
 #include "low_level_platform.h"
 #include "tracepoint.h"
+#include "reaction_queue.h"
+#ifdef LF_LATENCY
+#include "latency.h"
+#endif
+
+/**
+ * The default length of the last part of a wait for physical time that is spent spinning
+ * on the clock rather than sleeping. See lf_environment_set_spin_wait.
+ */
+#ifndef LF_SPIN_WAIT_THRESHOLD
+#define LF_SPIN_WAIT_THRESHOLD 0
+#endif
+
+/**
+ * The default timer slack of the threads of an environment, or -1 to leave it unchanged.
+ * See lf_environment_set_timer_slack.
+ */
+#ifndef LF_TIMER_SLACK
+#define LF_TIMER_SLACK -1
+#endif
+
+/**
+ * When LF_STATIC_MEMORY is defined, the single-threaded runtime allocates all the memory of its
+ * event loop when the environment is initialized, with capacities fixed at compile time, and
+ * never grows it afterwards: a pool of LF_MAX_EVENTS events, an event queue that holds them all,
+ * a reaction queue for LF_MAX_REACTIONS reactions (and levels) and LF_MAX_TOKENS tokens. A program
+ * that needs more stops with an error naming the capacity to increase. Payloads of tokens are
+ * still allocated when they are created, unless they are drawn from a pool (see lf_token_pool_enable).
+ */
+#ifdef LF_STATIC_MEMORY
+#if !defined(LF_SINGLE_THREADED) || defined(LF_CALENDAR_QUEUE)
+#error "LF_STATIC_MEMORY requires LF_SINGLE_THREADED and is not supported with LF_CALENDAR_QUEUE"
+#endif
+#ifndef LF_MAX_EVENTS
+#define LF_MAX_EVENTS 32
+#endif
+#ifndef LF_MAX_REACTIONS
+#define LF_MAX_REACTIONS 64
+#endif
+#ifndef LF_MAX_TOKENS
+#define LF_MAX_TOKENS 16
+#endif
+#endif // LF_STATIC_MEMORY
+
+/**
+ * When LF_STATIC_TOPOLOGY is defined, the runtime does not build or allocate the tables that
+ * describe the connections of the program. Instead, the generated code gives them as constant
+ * arrays, which the compiler can fold and which embedded targets keep in flash rather than RAM:
+ * - the `fanout` of each reaction with outputs (see lf_fanout_t), which schedule_output_reactions
+ *   follows instead of the `triggers` and `triggered_sizes` of the reaction, which may be NULL;
+ * - the `reactions` of each trigger, which _lf_pop_events follows;
+ * - the timers, startup, shutdown and reset reactions and is_present fields of each environment,
+ *   given with lf_environment_set_topology instead of being filled in after environment_init.
+ * The levels of the reactions (their `index`) and the offsets and periods of the timers are the
+ * initial values of the self structs. The runtime only reads the tables, so their pointers may
+ * point to const data, cast to the non-const types of the fields.
+ */
+#ifdef LF_STATIC_TOPOLOGY
+/**
+ * @brief The tables of an environment that the generated code gives as constant arrays with
+ * LF_STATIC_TOPOLOGY. Each size must be the one given to environment_init.
+ */
+typedef struct lf_static_topology_t {
+  trigger_t* const* timer_triggers;
+  int timer_triggers_size;
+  reaction_t* const* startup_reactions;
+  int startup_reactions_size;
+  reaction_t* const* shutdown_reactions;
+  int shutdown_reactions_size;
+  reaction_t* const* reset_reactions;
+  int reset_reactions_size;
+  bool* const* is_present_fields;
+  int is_present_fields_size;
+} lf_static_topology_t;
+#endif // LF_STATIC_TOPOLOGY
 
 // Forward declarations so that a pointers can appear in the environment struct.
 typedef struct lf_scheduler_t lf_scheduler_t;
@@ -38,6 +113,78 @@ typedef struct watchdog_t watchdog_t;
  */
 #define GLOBAL_ENVIRONMENT NULL
 
+/**
+ * @brief Number of events popped together at one tag that fit in the environment
+ * without allocating memory. See `events_at_current_tag`.
+ */
+#define LF_EVENTS_AT_CURRENT_TAG_BUFFER_SIZE 16
+
+/**
+ * @brief An event of a physical action, staged by lf_schedule_token, lf_schedule_copy or
+ * lf_schedule_value without holding the mutex of the environment. Staged events are moved
+ * to the event queue by _lf_ingress_drain_locked. See `ingress` and `ingress_pending`.
+ */
+typedef struct lf_ingress_event_t {
+  struct lf_ingress_event_t* next;
+  trigger_t* trigger;
+  interval_t extra_delay;
+  lf_token_t* token;
+  instant_t time;                   // Physical time at which the event was staged.
+  struct lf_ingress_limit_t* limit; // The capacity of the action the event is counted against, or NULL.
+} lf_ingress_event_t;
+
+/**
+ * @brief The type of the indices of the ring of a physical action, whose loads and stores must
+ * not be torn by an interrupt.
+ */
+#if defined(__AVR__)
+typedef uint8_t lf_isr_index_t;
+#else
+typedef uint32_t lf_isr_index_t;
+#endif
+
+/**
+ * @brief A fixed-size ring of events of a physical action, pushed by lf_schedule_isr from an
+ * interrupt service routine and moved to the event queue by _lf_isr_rings_drain_locked, set by
+ * lf_action_set_isr_ring. The interrupt only writes `head` and the main loop only writes `tail`,
+ * each after the slots they publish, so that neither waits for nor disables the other. A slot
+ * holds the physical time of the event, whether it has a value and the value.
+ */
+typedef struct lf_isr_ring_t {
+  struct lf_isr_ring_t* next;   // The next ring of the environment.
+  lf_action_base_t* action;     // The physical action.
+  lf_isr_index_t capacity;      // The number of slots, a power of two.
+  size_t slot_size;             // The size of a slot in bytes.
+  volatile lf_isr_index_t head; // The number of events pushed, modulo the range of the index.
+  volatile lf_isr_index_t tail; // The number of events moved to the event queue, likewise.
+  char* slots;                  // The slots.
+} lf_isr_ring_t;
+
+/**
+ * @brief The capacity of a physical action for events that are staged or pending, set by
+ * lf_action_set_capacity. The limits of an environment are freed with it.
+ */
+typedef struct lf_ingress_limit_t {
+  struct lf_ingress_limit_t* next; // The next limit of the environment.
+  int64_t capacity;
+  lf_overload_policy_t policy;
+  int64_t count;                // Number of staged and pending events of the action.
+  int64_t listed;               // While shedding, the number of pending events of the action.
+  int64_t seen;                 // While shedding, the number of them visited so far.
+  lf_ingress_event_t* survivor; // While coalescing, the event that gets the payload of the newest.
+} lf_ingress_limit_t;
+
+/**
+ * @brief The is_present fields of the ports set present by one worker in the current tag.
+ * Each worker appends to its own list without synchronization. The lists are padded to a
+ * cache line so that workers do not share one. See `worker_present_fields`.
+ */
+typedef struct lf_present_list_t {
+  bool** fields;
+  int size;
+  char padding[64 - sizeof(bool**) - sizeof(int)];
+} lf_present_list_t;
+
 /**
  * @brief Execution environment.
  * This struct contains information about the execution environment.
@@ -49,16 +196,26 @@ typedef struct watchdog_t watchdog_t;
 typedef struct environment_t {
   bool initialized;
   bool execution_started; // Events at the start tag have been pulled from the event queue.
+  void* block;            // The single allocation that holds the arrays below sized at initialization.
   char* name;
   int id;
   tag_t current_tag;
   tag_t stop_tag;
   pqueue_tag_t* event_q;
-  pqueue_tag_t* recycle_q;
+  event_t* free_events;           // LIFO list of unused events, linked through next_free.
+  vector_t event_chunks;          // Blocks of events allocated for the free list, freed with the environment.
+  size_t events_allocated;        // Total number of events in event_chunks.
+  size_t events_free;             // Number of events on free_events.
+  vector_t events_at_current_tag; // Events popped together from event_q by _lf_pop_events.
+  void* events_at_current_tag_buffer[LF_EVENTS_AT_CURRENT_TAG_BUFFER_SIZE]; // Initial storage of the above.
+  vector_t next_microstep_events; // Events at the microstep after the current tag, kept off event_q.
+                                  // See _lf_enqueue_event.
   bool** is_present_fields;
   int is_present_fields_size;
   bool** is_present_fields_abbreviated;
   int is_present_fields_abbreviated_size;
+  int is_present_fields_full_resets; // Number of times the abbreviated list overflowed.
+  vector_t deadline_missed_reactions; // Reactions that have missed their deadline at least once.
   vector_t sparse_io_record_sizes;
   trigger_handle_t _lf_handle;
   trigger_t** timer_triggers;
@@ -73,16 +230,38 @@ typedef struct environment_t {
   int watchdogs_size;
   watchdog_t** watchdogs;
   int worker_thread_count;
+  interval_t spin_wait_threshold; // Length of the last part of waits for physical time spent spinning.
+  interval_t timer_slack;         // Timer slack of the threads that wait for physical time, or -1 for the default.
 #if defined(LF_SINGLE_THREADED)
-  pqueue_t* reaction_q;
+  reaction_queue_t* reaction_q;
+  lf_isr_ring_t* isr_rings; // The rings of physical actions scheduled from interrupts. See lf_action_set_isr_ring.
 #else
   int num_workers;
   lf_thread_t* thread_ids;
   lf_mutex_t mutex;
   lf_cond_t event_q_changed;
+  int32_t event_q_changes; // Number of notifications of event_q_changed. See _lf_notify_event_q_changed_locked.
   lf_scheduler_t* scheduler;
   _lf_tag_advancement_barrier barrier;
   lf_cond_t global_tag_barrier_requestors_reached_zero;
+  lf_ingress_event_t* volatile ingress;     // LIFO stack of staged physical action events. See lf_ingress_event_t.
+  lf_ingress_event_t* ingress_pending;      // Drained events not yet on the event queue, sorted by time.
+  lf_ingress_event_t* ingress_pending_last; // Last of the pending events.
+  int64_t ingress_count;                    // Number of staged and pending events.
+  int64_t ingress_capacity;                 // Number of staged and pending events allowed, or 0 for any.
+  interval_t ingress_max_tag_lag;           // Tag lag beyond which events are shed, or FOREVER.
+  volatile bool ingress_shedding;           // Whether the above limits are exceeded, as of the last drain.
+  volatile bool ingress_overloaded;         // Whether pending events must be dropped or coalesced.
+  lf_ingress_limit_t* ingress_limits;       // The capacities of physical actions. See lf_action_set_capacity.
+  int64_t ingress_rejected;                 // Number of events rejected because of a capacity.
+  int64_t ingress_shed;                     // Number of events dropped or coalesced because of a capacity.
+  lf_present_list_t* worker_present_fields; // Per worker, ports set present. See lf_present_list_t.
+  struct lf_enclave_channel_t* enclave_channels; // Channels of messages into this environment. See enclave_channel.h.
+#ifdef _PYTHON_TARGET_ENABLED
+  lf_mutex_t python_mutex;   // Protects python_worker_busy and python_reactions.
+  bool python_worker_busy;   // Whether a worker holds the GIL to execute reactions. See reactor_threaded.c.
+  vector_t python_reactions; // Reactions handed to that worker by other workers.
+#endif
 #endif // LF_SINGLE_THREADED
 #if defined(FEDERATED)
   tag_t** _lf_intended_tag_fields;
@@ -91,6 +270,33 @@ typedef struct environment_t {
 #ifdef LF_ENCLAVES // TODO: Consider dropping #ifdef
   enclave_info_t* enclave_info;
 #endif
+#ifdef LF_STATIC_SCHEDULE
+  struct lf_static_schedule_t* static_schedule; // See static_schedule.h.
+#endif
+#ifdef LF_REACTION_PROFILE
+  vector_t profiled_reactions; // Reactions that have execution-time statistics. See reaction_profile.h.
+#endif
+#ifdef LF_DVFS
+  instant_t dvfs_busy_since;   // When the current tag started, or NEVER if it is done. See dvfs.h.
+  instant_t dvfs_period_start; // When the current period of the frequency scaling started.
+  interval_t dvfs_busy;        // The time spent on tags in the current period.
+  int dvfs_min_slack;          // The least slack of a reaction in the current period, in percent of its deadline.
+  int dvfs_required;           // The performance, in percent, that the last period required.
+#endif
+#ifdef LF_LATENCY
+  instant_t latency_origin;                                 // The origin of the current tag, or NEVER. See latency.h.
+  lf_latency_chain_t latency_chains[LF_LATENCY_MAX_CHAINS]; // The latency statistics of the chains.
+  int32_t latency_registering;                              // Taken by the thread that adds a chain.
+#endif
+#if defined(LF_CHECKPOINT) || defined(LF_FEDERATED_OPTIMISTIC)
+  vector_t checkpoint_reactors; // Reactors whose state is saved in checkpoints. See checkpoint.h.
+#endif
+#ifdef LF_CHECKPOINT
+  char* checkpoint_file; // The file to save a checkpoint to at the start of the next tag, or NULL.
+#endif
+#ifdef LF_TAG_PIPELINING
+  struct lf_pipeline_t* pipeline; // The components of the reactors and the tag they overlap. See pipeline.h.
+#endif
 } environment_t;
 
 #if defined(MODAL_REACTORS)
@@ -100,6 +306,11 @@ struct mode_environment_t {
   int modal_reactor_states_size;
   mode_state_variable_reset_data_t* state_resets;
   int state_resets_size;
+  bool grouped_by_mode;                                   // Whether the following are set. See modes.c.
+  mode_state_variable_reset_data_t* grouped_state_resets; // The state resets, sorted by mode and merged.
+  int grouped_state_resets_size;
+  trigger_t** one_shot_timers; // The timers in modes with a period of 0, sorted by mode.
+  int one_shot_timers_size;
 };
 #endif
 
@@ -111,17 +322,79 @@ int environment_init(environment_t* env, const char* name, int id, int num_worke
                      int num_is_present_fields, int num_modes, int num_state_resets, int num_watchdogs,
                      const char* trace_file_name);
 
+#ifdef LF_STATIC_TOPOLOGY
+/**
+ * @brief Use the constant tables of the generated code as the timers, startup, shutdown and reset
+ * reactions and is_present fields of the environment. This is called after environment_init, which
+ * does not allocate them with LF_STATIC_TOPOLOGY, and before the execution starts.
+ * @param env The environment.
+ * @param topology The tables, which must outlive the environment.
+ */
+void lf_environment_set_topology(environment_t* env, const lf_static_topology_t* topology);
+#endif
+
 /**
  * @brief Free the dynamically allocated memory on the environment struct.
  * @param env The environment in which we are executing.
  */
 void environment_free(environment_t* env);
 
+/**
+ * @brief Allocate a block of `count` events and put them on the free list of the environment.
+ * The events are freed by environment_free().
+ * @param env The environment in which we are executing.
+ * @param count The number of events to allocate.
+ */
+void environment_allocate_events(environment_t* env, size_t count);
+
 /**
  * @brief Initialize the start and stop tags on the environment struct.
  */
 void environment_init_tags(environment_t* env, instant_t start_time, interval_t duration);
 
+/**
+ * @brief Let waits for physical time in the environment spin on the clock for their last part.
+ * A wait sleeps until `threshold` before the wakeup time and then repeatedly reads the
+ * clock, which avoids the oversleeping of the operating system's timed waits at the cost
+ * of keeping a processor busy. In the threaded runtime, a spinning wait still ends early
+ * when the event queue changes. In the single-threaded runtime, asynchronous events that
+ * arrive while spinning are handled once the wait ends.
+ * The default is LF_SPIN_WAIT_THRESHOLD, which is 0 (never spin) unless defined otherwise.
+ * @param env The environment.
+ * @param threshold The length of the last part of a wait to spend spinning, or 0 to never spin.
+ */
+void lf_environment_set_spin_wait(environment_t* env, interval_t threshold);
+
+/**
+ * @brief Set the timer slack of the threads that wait for physical time in the environment.
+ * The operating system may delay the timed waits of a thread by up to its timer slack to
+ * combine wakeups. This takes effect the next time a thread waits for physical time in the
+ * environment. It is only supported on Linux, where the default slack is 50 microseconds.
+ * The default is LF_TIMER_SLACK, which is -1 (leave the slack unchanged) unless defined otherwise.
+ * @param env The environment.
+ * @param slack The timer slack, 0 to restore the default of the operating system, or -1 to leave it unchanged.
+ */
+void lf_environment_set_timer_slack(environment_t* env, interval_t slack);
+
+/**
+ * @brief Limit the events of physical actions that are staged but not yet on the event queue.
+ * Events of physical actions pile up there when logical time falls behind physical time. When
+ * `capacity` events of all physical actions of the environment are staged or pending, the
+ * lf_schedule functions reject new events, returning -1, except for the actions with an
+ * `lf_overload_drop_oldest` or `lf_overload_coalesce` policy (see lf_action_set_capacity).
+ * While the environment is over its capacity, or its tag lag (physical time minus the current
+ * logical time) exceeds `max_tag_lag`, the environment sheds load: actions with a capacity and
+ * the `lf_overload_reject` policy reject all new events, and the pending events of actions with
+ * the other policies are dropped or coalesced down to one per action.
+ * The limits are only checked approximately, without locks, so concurrent calls to the
+ * lf_schedule functions may exceed them slightly. This has no effect in the single-threaded
+ * runtime, which has no staged events.
+ * @param env The environment.
+ * @param capacity The number of staged and pending events allowed, or 0 for no limit.
+ * @param max_tag_lag The tag lag beyond which the environment sheds load, or FOREVER.
+ */
+void lf_environment_set_ingress_limits(environment_t* env, size_t capacity, interval_t max_tag_lag);
+
 /**
  * @brief Will update the argument to point to the beginning of the array of environments in this program
  * @note Is code-generated by the compiler
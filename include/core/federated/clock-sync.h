@@ -63,6 +63,31 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define _LF_CLOCK_SYNC_COLLECT_STATS true
 #endif
 
+/**
+ * Sources of the times at which the federate receives and sends the UDP clock synchronization
+ * messages (T2, T3, and the receive times of T4 and of the coded probe).
+ * By default, the physical clock is read after a message has been received or sent.
+ * With LF_CLOCK_SYNC_TIMESTAMPING_SOFTWARE, the times are those at which the kernel received
+ * or sent the datagram (SO_TIMESTAMPING), which excludes the scheduling delays of the thread.
+ * With LF_CLOCK_SYNC_TIMESTAMPING_HARDWARE, they are those at which the network interface did,
+ * in the time base of its PTP hardware clock. These are consistent with the physical clock only
+ * if LF_CLOCK_PHC_INDEX selects that clock, and hardware timestamping must have been enabled on
+ * the interface (for example by ptp4l). Kernel timestamps are only supported on Linux.
+ * If a timestamp is missing, the physical clock is read instead. As the UDP messages are only
+ * exchanged with LF_CLOCK_SYNC_ON, the timestamping has no effect with the other settings.
+ */
+#define LF_CLOCK_SYNC_TIMESTAMPING_OFF 0
+#define LF_CLOCK_SYNC_TIMESTAMPING_SOFTWARE 1
+#define LF_CLOCK_SYNC_TIMESTAMPING_HARDWARE 2
+
+#ifndef LF_CLOCK_SYNC_TIMESTAMPING
+#define LF_CLOCK_SYNC_TIMESTAMPING LF_CLOCK_SYNC_TIMESTAMPING_OFF
+#endif
+
+#if LF_CLOCK_SYNC_TIMESTAMPING != LF_CLOCK_SYNC_TIMESTAMPING_OFF && !defined(PLATFORM_Linux)
+#error "Kernel timestamping of clock synchronization messages is only supported on Linux."
+#endif
+
 /**
  * Define a guard band to filter clock synchronization
  * messages based on discrepancies in the network delay.
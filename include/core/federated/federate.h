@@ -109,6 +109,26 @@ typedef struct federate_instance_t {
    */
   int server_socket;
 
+  /**
+   * A socket descriptor for the Unix domain socket server through which federates
+   * on the same host connect in place of server_socket, or -1 if there is none.
+   * This is assigned in lf_create_server() and closed once all inbound connections
+   * have been accepted. Defining LF_FEDERATED_TCP_ONLY disables it.
+   */
+  int local_server_socket;
+
+  /**
+   * A UDP socket on which messages on physical connections are received as datagrams
+   * (@see P2P_OPTION_DATAGRAMS), or -1 if no federate has asked to send them.
+   * This is created by lf_handle_p2p_connections_from_federates().
+   */
+  int datagram_socket;
+
+  /**
+   * Thread listening for datagrams on datagram_socket, if it exists.
+   */
+  lf_thread_t datagram_listener;
+
   /**
    * The port used for the server socket to listen for messages from other federates.
    * The federate informs the RTI of this port once it has created its socket server by
@@ -149,6 +169,13 @@ typedef struct federate_instance_t {
    */
   bool received_stop_request_from_rti;
 
+  /**
+   * A pipe through which lf_hand_off_stop_request() wakes the thread listening to the RTI,
+   * which then negotiates a stop requested by this federate. Both ends are -1 until that
+   * thread is started.
+   */
+  int stop_request_pipe[2];
+
   /**
    * A record of the most recently sent LTC (latest tag complete) message.
    * In some situations, federates can send logical_tag_complete for
@@ -165,9 +192,24 @@ typedef struct federate_instance_t {
 
   /**
    * A record of the most recently sent NET (next event tag) message.
+   * This is NEVER if the RTI may have changed its record of the NET since then.
    */
   tag_t last_sent_NET;
 
+  /**
+   * The physical time at which last_sent_NET was sent.
+   */
+  instant_t last_sent_NET_physical_time;
+
+  /**
+   * Counts of NETs sent to the RTI, held back and replaced by a later NET because they
+   * followed the previous one within LF_FEDERATED_NET_INTERVAL, and not sent because
+   * the RTI already had them.
+   */
+  size_t NETs_sent;
+  size_t NETs_coalesced;
+  size_t NETs_suppressed;
+
   /**
    * For use in federates with centralized coordination, the minimum
    * time delay between a physical action within this federate and an
@@ -176,12 +218,21 @@ typedef struct federate_instance_t {
    */
   instant_t min_delay_from_physical_action_to_federate_output;
 
-#ifdef FEDERATED_DECENTRALIZED
+#ifdef LF_TIME_TRIGGERED
   /**
-   * Thread responsible for setting ports to absent by an STAA offset if they
-   * aren't already known.
+   * The time after each of time_triggered_slots by which all messages with that time have
+   * reached this federate, or a negative number if the federation is not time triggered,
+   * in which case this federate waits for tag advance grants as usual.
    */
-  lf_thread_t staaSetter;
+  interval_t time_triggered_window;
+
+  /**
+   * The times within each hyperperiod of time_triggered_hyperperiod, sorted, at which messages
+   * may be sent to this federate in a time-triggered federation.
+   */
+  interval_t time_triggered_hyperperiod;
+  interval_t* time_triggered_slots;
+  size_t time_triggered_number_of_slots;
 #endif
 } federate_instance_t;
 
@@ -238,6 +289,18 @@ extern lf_cond_t lf_current_tag_changed;
  */
 void lf_connect_to_federate(uint16_t);
 
+/**
+ * @brief Connect to the federates with the specified ids.
+ *
+ * This has the same effect as calling lf_connect_to_federate() for each of them, but it sends
+ * the MSG_TYPE_ADDRESS_QUERY messages for all of them to the RTI before reading any reply, and
+ * then connects to up to LF_FEDERATED_CONNECT_THREADS of them at the same time, which makes the
+ * startup of large federations faster. It logs how long each of these phases took.
+ * @param remote_federate_ids The IDs of the remote federates.
+ * @param num_federates The number of remote federates.
+ */
+void lf_connect_to_federates(const uint16_t* remote_federate_ids, size_t num_federates);
+
 /**
  * @brief Connect to the RTI at the specified host and port.
  *
@@ -290,6 +353,21 @@ void lf_enqueue_port_absent_reactions(environment_t* env);
  */
 void* lf_handle_p2p_connections_from_federates(void*);
 
+/**
+ * @brief Write the tagged messages that have been batched but not yet written to their sockets.
+ *
+ * Tagged messages are only batched if LF_FEDERATED_BATCH_SIZE is defined, in which case
+ * it is the maximum number of bytes of messages that are batched for each destination.
+ * This is called at the end of each tag. Otherwise, this does nothing.
+ * This function acquires the lf_outbound_socket_mutex.
+ *
+ * If LF_FEDERATED_SEND_QUEUE is defined instead, the messages to each peer federate are
+ * appended to a queue of that many bytes, and a thread of its own writes the queue to the
+ * socket of that federate, so that reactions that send to different federates do not contend
+ * for the lf_outbound_socket_mutex. Messages to the RTI are still written under that mutex.
+ */
+void lf_flush_outbound_messages(void);
+
 /**
  * @brief Send a latest tag complete (LTC) signal to the RTI.
  *
@@ -302,6 +380,57 @@ void* lf_handle_p2p_connections_from_federates(void*);
  */
 void lf_latest_tag_complete(tag_t);
 
+/**
+ * @brief Return the max level allowed to advance (MLAA) as a level.
+ *
+ * Input statuses are known at all levels below it, so the scheduler can skip the empty ones
+ * without calling lf_stall_advance_level_federation(). The caller must hold the mutex lock.
+ */
+size_t lf_max_level_allowed_to_advance_locked(void);
+
+#ifdef LF_FEDERATED_OPTIMISTIC
+/**
+ * @brief Record a handled event for optimistic execution (LF_FEDERATED_OPTIMISTIC).
+ *
+ * An event of a physical action or a network input port that is handled at a tag that may be
+ * rolled back is recorded, so that it is handled again after a rollback. This is called by
+ * _lf_pop_events(). The caller must hold the mutex of the top-level environment.
+ * @param env The top-level environment.
+ * @param event The event.
+ */
+void lf_optimistic_event_popped_locked(environment_t* env, event_t* event);
+
+/**
+ * @brief Roll back to before the earliest straggler that has arrived, if any (see LF_FEDERATED_OPTIMISTIC).
+ *
+ * This restores the state saved at the start of the earliest speculative tag that is later than
+ * the straggler, and replaces the event queue, so that execution continues from the tag before it.
+ * This is called by the scheduler when a tag completes. The caller must hold the mutex of the
+ * top-level environment.
+ * @param env The top-level environment.
+ * @param settle Whether execution is to stop, in which case this first waits until the speculative
+ *  tags are committed or a straggler arrives.
+ * @return true if execution rolled back.
+ */
+bool lf_optimistic_roll_back_locked(environment_t* env, bool settle);
+
+/**
+ * @brief Return whether a straggler has arrived, for which execution rolls back before it advances.
+ * The caller must hold the mutex of the top-level environment.
+ */
+bool lf_optimistic_rollback_pending_locked(void);
+
+/**
+ * @brief Start a tag for optimistic execution (LF_FEDERATED_OPTIMISTIC).
+ *
+ * This commits the speculative tags that can be, and, if the status of a network input port is not
+ * known at the tag, saves the state of the federate so that the tag is executed speculatively.
+ * This is called by _lf_start_time_step(). The caller must hold the mutex of the top-level environment.
+ * @param env The top-level environment.
+ */
+void lf_optimistic_tag_started_locked(environment_t* env);
+#endif // LF_FEDERATED_OPTIMISTIC
+
 /**
  * @brief Parse the address of the RTI and store them into the global federation_metadata struct.
  * @return a parse_rti_code_t indicating the result of the parse.
@@ -424,6 +553,16 @@ tag_t lf_send_next_event_tag(environment_t* env, tag_t tag, bool wait_for_reply)
 void lf_send_port_absent_to_federate(environment_t* env, interval_t additional_delay, unsigned short port_ID,
                                      unsigned short fed_ID);
 
+/**
+ * @brief Hand a stop requested by lf_request_stop() to the thread that listens to the RTI.
+ *
+ * That thread sets a barrier at the current tag of every environment and sends the RTI a
+ * MSG_TYPE_STOP_REQUEST message, so the caller neither takes the mutex of each environment
+ * nor waits for the socket. The stop tag is set at the next tag boundary after the RTI replies
+ * with MSG_TYPE_STOP_GRANTED. If that thread is not running, the caller does the work itself.
+ */
+void lf_hand_off_stop_request(void);
+
 /**
  * @brief Send a MSG_TYPE_STOP_REQUEST message to the RTI.
  *
@@ -470,27 +609,78 @@ int lf_send_tagged_message(environment_t* env, interval_t additional_delay, int
                            unsigned short federate, const char* next_destination_str, size_t length,
                            unsigned char* message);
 
+/**
+ * @brief Send a tagged message with the specified value as its payload.
+ *
+ * This is like lf_send_tagged_message(), but if the type has serialization functions
+ * (@see token_type_t), the value is serialized straight into the buffer from which it is
+ * written to the socket, rather than into a temporary buffer that is then copied.
+ * Otherwise, the payload is the element_size * length bytes of the value.
+ *
+ * @param env The environment from which to get the current tag.
+ * @param additional_delay The after delay on the connection or NEVER is there is none.
+ * @param message_type MSG_TYPE_TAGGED_MESSAGE or MSG_TYPE_P2P_TAGGED_MESSAGE.
+ * @param port The ID of the destination port.
+ * @param federate The ID of the destination federate.
+ * @param next_destination_str The next destination in string format (RTI or federate)
+ *  (used for reporting errors).
+ * @param type The type of the value.
+ * @param value The value.
+ * @param length The number of elements of the value, which is ignored if the type serializes it.
+ * @return 0 if the message has been sent, -1 otherwise.
+ */
+int lf_send_tagged_value(environment_t* env, interval_t additional_delay, int message_type, unsigned short port,
+                         unsigned short federate, const char* next_destination_str, token_type_t* type, void* value,
+                         size_t length);
+
+/**
+ * @brief Send a tagged message with the same payload to several destination ports.
+ *
+ * This is equivalent to calling lf_send_tagged_message() for each destination, but the payload,
+ * which the caller serializes once, is handled once for all of them. With MSG_TYPE_TAGGED_MESSAGE,
+ * it is sent to the RTI once, with the list of destinations, and the RTI forwards it to each of
+ * them. With MSG_TYPE_P2P_TAGGED_MESSAGE, it is compressed at most once and the copies are written
+ * to the connections to the destination federates while the lf_outbound_socket_mutex is held once.
+ *
+ * This method assumes that the caller does not hold the lf_outbound_socket_mutex lock.
+ *
+ * @param env The environment from which to get the current tag.
+ * @param additional_delay The after delay on the connections or NEVER is there is none.
+ * @param message_type MSG_TYPE_TAGGED_MESSAGE or MSG_TYPE_P2P_TAGGED_MESSAGE.
+ * @param num_destinations The number of destinations, which is at most UINT16_MAX.
+ * @param ports The IDs of the destination ports.
+ * @param federates The IDs of the federates of the destination ports.
+ * @param length The message length.
+ * @param message The message.
+ * @return 0 if the message has been sent to all destinations, -1 otherwise.
+ */
+int lf_send_tagged_message_to_many(environment_t* env, interval_t additional_delay, int message_type,
+                                   size_t num_destinations, const unsigned short* ports,
+                                   const unsigned short* federates, size_t length, unsigned char* message);
+
 /**
  * @brief Set the federation_id of this federate.
  * @param fid The federation ID.
  */
 void lf_set_federation_id(const char* fid);
 
-#ifdef FEDERATED_DECENTRALIZED
 /**
- * @brief Spawn a thread to iterate through STAA structs.
+ * @brief Pin the threads that listen to the RTI and to other federates to the specified CPUs.
  *
- * This will set their associated ports absent
- * at an offset if the port is not present with a value by a certain physical time.
+ * The thread that listens to the RTI is pinned to the first CPU of the list, and the thread
+ * that listens to federate i to entry 1 + i, round robin. This is meant for dedicated cores,
+ * especially with LF_FEDERATED_SPIN_RECEIVE (see net_util.h). It must be called before the
+ * threads start. See the --pin-listeners command-line argument.
+ * @param cpus A comma-separated list of CPU numbers, which must remain valid.
  */
-void lf_spawn_staa_thread(void);
-#endif
+void lf_set_listener_pinning(const char* cpus);
 
 /**
  * @brief Wait until inputs statuses are known up to and including the specified level.
  *
  * Specifically, wait until the specified level is less that the max level allowed to
- * advance (MLAA).
+ * advance (MLAA). With decentralized coordination, while waiting, input ports whose
+ * status is still unknown when their STAA offset expires are set absent.
  * @param env The environment (which should always be the top-level environment).
  * @param level The level to which we would like to advance.
  */
@@ -156,6 +156,10 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * `MSG_TYPE_TIMESTAMP`. The RTI broadcasts the maximum of these readings plus
  * `DELAY_START` to all federates as the start time, again on a `MSG_TYPE_TIMESTAMP`.
  *
+ * A federate compiled with LF_TIME_TRIGGERED first sends a `MSG_TYPE_TIME_TRIGGERED_SCHEDULE`
+ * with the times at which its timers fire, and the RTI follows the start time with a
+ * `MSG_TYPE_TIME_TRIGGERED_SLOTS` telling it whether the federation is time triggered.
+ *
  * The next step depends on the coordination type.
  *
  * Under centralized coordination, each federate will send a
@@ -670,6 +674,141 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #define MSG_TYPE_FAILED 25
 
+/**
+ * Byte identifying a variant of @see MSG_TYPE_P2P_SENDING_FED_ID by which the sending
+ * federate also asks for options of the connection. The message is followed by one byte
+ * with the requested options, a combination of the P2P_OPTION_ flags below. If it requests
+ * P2P_OPTION_RDMA, the next P2P_RDMA_ENDPOINT_LENGTH bytes describe its end of the channel.
+ * A federate that accepts the connection replies with MSG_TYPE_ACK followed by one byte
+ * with the options it accepts, which are a subset of those requested. If it accepts
+ * P2P_OPTION_DATAGRAMS, the next two bytes are the UDP port to which to send them.
+ * If it accepts P2P_OPTION_RDMA, the next P2P_RDMA_ENDPOINT_LENGTH bytes describe its end of
+ * the channel, and the sending federate then replies with one byte, which is 1 if the channel
+ * works and 0 if the connection uses TCP after all.
+ * A federate that does not know this message type replies with MSG_TYPE_REJECT and
+ * WRONG_SERVER, in which case the sending federate connects again with
+ * MSG_TYPE_P2P_SENDING_FED_ID and uses no options.
+ */
+#define MSG_TYPE_P2P_SENDING_FED_ID_WITH_OPTIONS 26
+
+/**
+ * Option of a connection between federates by which the sending federate may send
+ * messages of type @see MSG_TYPE_P2P_COMPRESSED_TAGGED_MESSAGE.
+ */
+#define P2P_OPTION_COMPRESSION 1
+
+/**
+ * Option of a connection between federates by which the sending federate may send
+ * messages of type MSG_TYPE_P2P_MESSAGE (on physical connections) as UDP datagrams,
+ * which are dropped rather than retransmitted if they are lost. A datagram starts with
+ * two bytes with the ID of the sending federate and four bytes with a sequence number,
+ * which starts at 1 and increases by one for each datagram sent to the same federate.
+ * The rest of the datagram is the message, including its message type. The receiving
+ * federate drops datagrams that are not newer than the last one it received from the
+ * same federate.
+ */
+#define P2P_OPTION_DATAGRAMS 2
+
+/** Length of the prefix of a datagram carrying a message between federates. */
+#define P2P_DATAGRAM_HEADER_LENGTH (sizeof(uint16_t) + sizeof(uint32_t))
+
+/**
+ * Option of a connection between federates by which all bytes that the sending federate
+ * sends after the handshake are carried by an RDMA reliable connected queue pair rather
+ * than the TCP socket (see rdma.h). The TCP socket stays open, and the sending federate
+ * closes it after the last byte has been delivered. Before it uses the channel, the sending
+ * federate sends an empty message on it to check that the federates are on the same fabric.
+ */
+#define P2P_OPTION_RDMA 4
+
+/**
+ * Length of the description of an end of an RDMA channel between federates: the number of
+ * its queue pair (four bytes), the LID of its port (two bytes), the GID of its port (16 bytes),
+ * and the size of its receive buffers, which is 0 for the sending end (four bytes).
+ */
+#define P2P_RDMA_ENDPOINT_LENGTH (sizeof(uint32_t) + sizeof(uint16_t) + 16 + sizeof(uint32_t))
+
+/**
+ * Byte identifying a variant of @see MSG_TYPE_P2P_TAGGED_MESSAGE whose payload is compressed
+ * in the LZ4 block format (see lz_block.h).
+ *
+ * The header is that of MSG_TYPE_P2P_TAGGED_MESSAGE, where the length is that of the
+ * uncompressed payload. The next four bytes are the length of the compressed payload.
+ * The remaining bytes are the compressed payload.
+ */
+#define MSG_TYPE_P2P_COMPRESSED_TAGGED_MESSAGE 27
+
+/**
+ * A port absent message for many ports at once, informing the receiver that none of the
+ * given ports will have an event at the given tag. It stands for a sequence of
+ * MSG_TYPE_PORT_ABSENT messages with the same destination and tag, and the RTI forwards it
+ * as it forwards those.
+ *
+ * The next 2 bytes will be the federate id of the destination federate.
+ * The next 8 bytes are the intended time of the absent message.
+ * The next 4 bytes are the intended microstep of the absent message.
+ * The next 2 bytes are the number of ranges of port ids, which is at most PORT_ABSENT_MAX_RANGES.
+ * Each range is 2 bytes with the first port id followed by 2 bytes with the number of ports.
+ */
+#define MSG_TYPE_PORT_ABSENT_RANGES 28
+#define MSG_TYPE_PORT_ABSENT_RANGES_HEADER_SIZE 17
+
+/** The maximum number of ranges of port ids in a MSG_TYPE_PORT_ABSENT_RANGES message. */
+#define PORT_ABSENT_MAX_RANGES 256
+
+/** The length of a range of port ids in a MSG_TYPE_PORT_ABSENT_RANGES message. */
+#define PORT_ABSENT_RANGE_SIZE (2 * sizeof(uint16_t))
+
+/**
+ * Byte identifying the message with which a federate compiled with LF_TIME_TRIGGERED tells
+ * the RTI, before its MSG_TYPE_TIMESTAMP, at what times its periodic timers fire.
+ *
+ * The next 8 bytes are the hyperperiod of the timers, which is 0 if there are none, and negative
+ * if the federate cannot be time triggered (for example, because it runs in fast mode or because
+ * a physical action may lead to one of its outputs).
+ * The next 4 bytes are the number of times, which is at most TIME_TRIGGERED_MAX_SLOTS.
+ * Each time is 8 bytes with its offset from the start of the hyperperiod.
+ */
+#define MSG_TYPE_TIME_TRIGGERED_SCHEDULE 29
+#define MSG_TYPE_TIME_TRIGGERED_SCHEDULE_HEADER_SIZE (1 + sizeof(int64_t) + sizeof(uint32_t))
+
+/**
+ * Byte identifying the reply of the RTI to a MSG_TYPE_TIME_TRIGGERED_SCHEDULE, which it sends
+ * right after the start time.
+ *
+ * The next 8 bytes are the window, which is the time after a tag by which all messages with
+ * that tag have been received, or a negative number if the federation is not time triggered,
+ * in which case the federate uses MSG_TYPE_NEXT_EVENT_TAG and MSG_TYPE_TAG_ADVANCE_GRANT as usual.
+ * The next 8 bytes are the hyperperiod of the federation.
+ * The next 4 bytes are the number of slots, which is at most TIME_TRIGGERED_MAX_SLOTS.
+ * Each slot is 8 bytes with the offset from the start of a hyperperiod of a time at which
+ * a message may be sent to the federate.
+ */
+#define MSG_TYPE_TIME_TRIGGERED_SLOTS 30
+#define MSG_TYPE_TIME_TRIGGERED_SLOTS_HEADER_SIZE (1 + 2 * sizeof(int64_t) + sizeof(uint32_t))
+
+/** The maximum number of times in a hyperperiod in the messages of a time-triggered federation. */
+#define TIME_TRIGGERED_MAX_SLOTS 4096
+
+/**
+ * Byte identifying a tagged message with the same payload for several destination ports, which
+ * a federate sends to the RTI once rather than once per destination. The RTI forwards it to each
+ * destination as a MSG_TYPE_TAGGED_MESSAGE.
+ *
+ * The next 2 bytes are the number of destinations.
+ * The next 4 bytes are the length of the payload.
+ * The next 8 bytes are the intended time of the message.
+ * The next 4 bytes are the intended microstep of the message.
+ * Each destination is 2 bytes with the ID of the port followed by 2 bytes with the ID of its federate.
+ * The payload follows the destinations.
+ */
+#define MSG_TYPE_MULTICAST_TAGGED_MESSAGE 31
+#define MSG_TYPE_MULTICAST_TAGGED_MESSAGE_HEADER_SIZE                                                                  \
+  (1 + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(int64_t) + sizeof(uint32_t))
+
+/** The length of a destination in a MSG_TYPE_MULTICAST_TAGGED_MESSAGE message. */
+#define MULTICAST_DESTINATION_SIZE (2 * sizeof(uint16_t))
+
 /////////////////////////////////////////////
 //// Rejection codes
 
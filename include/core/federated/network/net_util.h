@@ -33,6 +33,8 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * and one thread receives on each socket (these two can be the same thread)
  * or that the caller handles mutual exclusion to prevent more than one thread
  * from accessing the socket at a time.
+ * With LF_FEDERATED_RDMA, the reads and writes of a socket that has an RDMA channel
+ * go through the channel instead (see rdma.h).
  */
 
 #ifndef NET_UTIL_H
@@ -42,18 +44,30 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #error To be implemented. No support for federation on Arduino yet.
 #else
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
 #include <regex.h>
 #endif
 
 #include <sys/types.h>
 #include <stdbool.h>
 
+#ifdef LF_FEDERATED_IO_URING
+#include <linux/io_uring.h>
+#endif
+
 #include "low_level_platform.h"
 #include "tag.h"
 
 #define NUM_SOCKET_RETRIES 10
+
+/** The path of the Unix domain socket server of a federate, given the port of its TCP socket server. */
+#define LOCAL_SOCKET_PATH_FORMAT "/tmp/lf-federate-%u.sock"
 #define DELAY_BETWEEN_SOCKET_RETRIES MSEC(100)
 
+/** The number of bytes that a buffered read from a socket takes at most. */
+#define SOCKET_RECEIVE_BUFFER_SIZE 16384
+
 #define HOST_LITTLE_ENDIAN 1
 #define HOST_BIG_ENDIAN 2
 
@@ -75,10 +89,96 @@ extern lf_mutex_t socket_mutex;
  * (TCP_NODELAY) and Delayed ACKs disabled (TCP_QUICKACK). Exits application
  * on any error.
  *
+ * The socket is further tuned by the following options, which the sockets that a server
+ * socket accepts inherit. Failing to apply them only prints a warning.
+ * - LF_FEDERATED_BUSY_POLL: on Linux, the number of microseconds for which a blocking read
+ *   busy polls the device queue before sleeping (SO_BUSY_POLL), preferring busy polling to
+ *   interrupts where the kernel supports it (SO_PREFER_BUSY_POLL). Values above the
+ *   net.core.busy_read setting need the CAP_NET_ADMIN capability.
+ * - LF_FEDERATED_SEND_BUFFER_SIZE and LF_FEDERATED_RECEIVE_BUFFER_SIZE: the sizes in bytes of
+ *   the kernel buffers of the socket (SO_SNDBUF and SO_RCVBUF).
+ *
  * @return The socket ID (a file descriptor).
  */
 int create_real_time_tcp_socket_errexit();
 
+/**
+ * @brief Create an IPv4 UDP socket bound to a port on all interfaces that is chosen by the
+ * operating system.
+ * @param port Where to store the port of the socket.
+ * @return The socket ID, or -1 if the socket could not be created or bound.
+ */
+int create_UDP_socket(uint16_t* port);
+
+/**
+ * @brief Return whether the specified IPv4 address belongs to this host, that is,
+ * whether it is a loopback address or the address of one of its network interfaces.
+ * @param address The address in network byte order.
+ */
+bool is_local_address(struct in_addr address);
+
+/**
+ * @brief Create a Unix domain socket server that federates on the same host can connect to
+ * in place of the TCP socket server bound to the specified port. The path of the socket
+ * is LOCAL_SOCKET_PATH_FORMAT with the port number, which is unique on the host
+ * as long as the TCP socket server exists.
+ * @param port The port of the TCP socket server.
+ * @return The socket ID, or -1 if the socket server could not be created.
+ */
+int create_local_server_socket(uint16_t port);
+
+/**
+ * @brief Connect to the Unix domain socket server created by create_local_server_socket().
+ * @param port The port of the TCP socket server of the remote federate.
+ * @return The socket ID, or -1 if the connection failed.
+ */
+int connect_to_local_server_socket(uint16_t port);
+
+/**
+ * @brief Close a socket server created by create_local_server_socket() and remove its path.
+ * @param socket The socket ID.
+ * @param port The port of the TCP socket server.
+ */
+void close_local_server_socket(int socket, uint16_t port);
+
+/**
+ * @brief Bytes read from a socket before they are needed.
+ * @see start_buffered_reads_from_socket()
+ */
+typedef struct socket_receive_buffer_t {
+  int socket;   // The socket from which the bytes were read.
+  size_t start; // The index of the first byte not yet consumed.
+  size_t end;   // The index after the last byte read.
+  unsigned char bytes[SOCKET_RECEIVE_BUFFER_SIZE];
+} socket_receive_buffer_t;
+
+/**
+ * @brief Have the calling thread read from the specified socket through the specified buffer.
+ *
+ * From now on, when this thread reads from the socket with read_from_socket() or the functions
+ * that use it, each system call takes as many bytes as are available, up to
+ * SOCKET_RECEIVE_BUFFER_SIZE, and the bytes not yet requested serve subsequent reads and
+ * peek_from_socket(). A header and its payload usually take one system call instead of several.
+ * Reads from other sockets or by other threads are not affected. No other thread may read from
+ * the socket until this thread calls end_buffered_reads_from_socket(), which discards any bytes
+ * still in the buffer. A thread can buffer one socket at a time.
+ *
+ * If LF_FEDERATED_SPIN_RECEIVE is defined, the thread busy waits for bytes to arrive when the
+ * buffer is empty rather than sleeping in the kernel, which takes the wakeup out of the latency
+ * of each message but keeps a core busy. The threads that listen to the RTI and to other
+ * federates read this way, so they should then be pinned to dedicated cores (see the
+ * --pin-listeners command-line argument).
+ * @param socket The socket ID.
+ * @param buffer The buffer, which must remain valid until end_buffered_reads_from_socket() is called
+ *  or the thread exits.
+ */
+void start_buffered_reads_from_socket(int socket, socket_receive_buffer_t* buffer);
+
+/**
+ * @brief Stop reading through the buffer given to start_buffered_reads_from_socket() by the calling thread.
+ */
+void end_buffered_reads_from_socket(void);
+
 /**
  * Read the specified number of bytes from the specified socket into the specified buffer.
  * If an error occurs during this reading, return -1 and set errno to indicate
@@ -95,6 +195,17 @@ int create_real_time_tcp_socket_errexit();
  */
 int read_from_socket(int socket, size_t num_bytes, unsigned char* buffer);
 
+/**
+ * @brief Consume the specified number of bytes from the specified socket without copying them,
+ * if the calling thread reads from it through a buffer (@see start_buffered_reads_from_socket())
+ * that already holds all of them.
+ * @param socket The socket ID.
+ * @param num_bytes The number of bytes.
+ * @return A pointer to the bytes, which remain valid until the next read from the socket, or NULL
+ *  if they are not all in the buffer, in which case nothing is consumed.
+ */
+unsigned char* take_buffered_bytes_from_socket(int socket, size_t num_bytes);
+
 /**
  * Read the specified number of bytes to the specified socket using read_from_socket
  * and close the socket if an error occurs. If an error occurs, this will change the
@@ -129,7 +240,8 @@ void read_from_socket_fail_on_error(int* socket, size_t num_bytes, unsigned char
  * Without blocking, peek at the specified socket and, if there is
  * anything on the queue, put its first byte at the specified address and return 1.
  * If there is nothing on the queue, return 0, and if an error occurs,
- * return -1.
+ * return -1. If the calling thread buffers reads from the socket, its buffer
+ * is the front of the queue.
  * @param socket The socket ID.
  * @param result Pointer to where to put the first byte available on the socket.
  */
@@ -151,6 +263,28 @@ ssize_t peek_from_socket(int socket, unsigned char* result);
  */
 int write_to_socket(int socket, size_t num_bytes, unsigned char* buffer);
 
+/**
+ * Write the contents of the specified buffers to the specified socket with as
+ * few system calls as possible, usually one. This is otherwise like write_to_socket.
+ * The buffer descriptions are modified to track the progress of partial writes.
+ * @param socket The socket ID.
+ * @param buffers The descriptions of the buffers, in the order in which to write them.
+ * @param num_buffers The number of buffers.
+ * @return 0 for success, -1 for failure.
+ */
+int writev_to_socket(int socket, struct iovec* buffers, int num_buffers);
+
+/**
+ * Write the contents of the specified buffers to the specified socket using
+ * writev_to_socket and close the socket if an error occurs. If an error occurs,
+ * this will change the socket ID pointed to by the first argument to -1 and will return -1.
+ * @param socket Pointer to the socket ID.
+ * @param buffers The descriptions of the buffers, in the order in which to write them.
+ * @param num_buffers The number of buffers.
+ * @return 0 for success, -1 for failure.
+ */
+int writev_to_socket_close_on_error(int* socket, struct iovec* buffers, int num_buffers);
+
 /**
  * Write the specified number of bytes to the specified socket using write_to_socket
  * and close the socket if an error occurs. If an error occurs, this will change the
@@ -180,6 +314,87 @@ int write_to_socket_close_on_error(int* socket, size_t num_bytes, unsigned char*
 void write_to_socket_fail_on_error(int* socket, size_t num_bytes, unsigned char* buffer, lf_mutex_t* mutex,
                                    char* format, ...);
 
+/**
+ * Move the specified number of bytes from one socket to another. Bytes that the calling thread
+ * has buffered from the source (see start_buffered_reads_from_socket()) are written first. On
+ * Linux, the rest go through a pipe of the calling thread with splice(), so that they are not
+ * copied to user space. Elsewhere, or if a socket does not support splicing, they are copied
+ * through a buffer. Errors are handled as by read_from_socket() and
+ * write_to_socket(). If an error occurs, the number of bytes moved is unknown.
+ * @param source The socket to read from.
+ * @param destination The socket to write to.
+ * @param num_bytes The number of bytes to move.
+ * @return 0 for success, 1 for EOF on the source, and -1 for an error.
+ */
+int forward_between_sockets(int source, int destination, size_t num_bytes);
+
+#ifdef LF_FEDERATED_IO_URING
+#if !defined(PLATFORM_Linux)
+#error "LF_FEDERATED_IO_URING is only supported on Linux."
+#endif
+
+/**
+ * @brief A Linux io_uring through which writes of registered buffers to several sockets are
+ * submitted to the kernel with one system call. The buffers are registered once, when the ring
+ * is created, so the kernel does not map them again for each write.
+ */
+typedef struct socket_write_ring_t {
+  int fd;                      // The file descriptor of the ring.
+  unsigned entries;            // The number of entries of the submission queue.
+  unsigned* sq_head;           // The head of the submission queue, advanced by the kernel.
+  unsigned* sq_tail;           // The tail of the submission queue, advanced by this process.
+  unsigned* sq_mask;           // The mask of indices in the submission queue.
+  unsigned* sq_array;          // The indices of the submitted entries in sqes.
+  struct io_uring_sqe* sqes;   // The submission queue entries.
+  unsigned* cq_head;           // The head of the completion queue, advanced by this process.
+  unsigned* cq_tail;           // The tail of the completion queue, advanced by the kernel.
+  unsigned* cq_mask;           // The mask of indices in the completion queue.
+  struct io_uring_cqe* cqes;   // The completion queue entries.
+  void* sq_ring;               // The mapping of the submission queue.
+  size_t sq_ring_size;         // The size of that mapping.
+  void* cq_ring;               // The mapping of the completion queue, which may be sq_ring.
+  size_t cq_ring_size;         // The size of that mapping.
+  size_t sqes_size;            // The size of the mapping of sqes.
+} socket_write_ring_t;
+
+/** @brief A write of bytes of a registered buffer to a socket through a socket_write_ring_t. */
+typedef struct socket_write_t {
+  int socket;            // The socket to write to.
+  unsigned buffer_index; // The index of the registered buffer that holds the bytes.
+  unsigned char* bytes;  // The bytes to write, which are in the registered buffer.
+  size_t length;         // The number of bytes to write.
+  int error;             // Set to 0 if all bytes were written and to the error number otherwise.
+} socket_write_t;
+
+/**
+ * @brief Create an io_uring for writes to sockets and register the specified buffers with it.
+ * This fails if the kernel does not support io_uring or does not allow it, for example under a
+ * seccomp policy, or if the buffers exceed the limit of locked memory.
+ * @param ring The ring to initialize.
+ * @param entries The number of writes that can be in flight at once.
+ * @param buffers The buffers that writes may refer to, by index.
+ * @param num_buffers The number of buffers.
+ * @return 0 for success, -1 for failure, in which case errno is set.
+ */
+int socket_write_ring_init(socket_write_ring_t* ring, unsigned entries, struct iovec* buffers, unsigned num_buffers);
+
+/**
+ * @brief Perform the specified writes to distinct sockets, submitting them together and waiting
+ * until all have completed. Writes that complete partially are submitted again for the rest.
+ * The error of each write is stored in it. The sockets are not closed on errors.
+ * @param ring The ring.
+ * @param writes The writes.
+ * @param num_writes The number of writes.
+ */
+void socket_write_ring_write_all(socket_write_ring_t* ring, socket_write_t* writes, size_t num_writes);
+
+/**
+ * @brief Unregister the buffers of a ring created by socket_write_ring_init() and destroy it.
+ * @param ring The ring.
+ */
+void socket_write_ring_free(socket_write_ring_t* ring);
+#endif // LF_FEDERATED_IO_URING
+
 #endif // FEDERATED
 
 /**
@@ -263,6 +478,13 @@ uint16_t swap_bytes_if_big_endian_uint16(uint16_t src);
  */
 int32_t extract_int32(unsigned char* bytes);
 
+/**
+ * Extract an uint32_t from the specified byte sequence.
+ * This will swap the order of the bytes if this machine is big endian.
+ * @param bytes The address of the start of the sequence of bytes.
+ */
+uint32_t extract_uint32(unsigned char* bytes);
+
 /**
  * This will swap the order of the bytes if this machine is big endian.
  * @param bytes The address of the start of the sequence of bytes.
@@ -278,6 +500,21 @@ uint16_t extract_uint16(unsigned char* bytes);
 
 #ifdef FEDERATED
 
+/**
+ * The layout of the timed header of timed messages between federates,
+ * without padding, so that the header is read or written with one copy.
+ * The fields are little endian, like all integers sent between federates.
+ */
+#pragma pack(push, 1)
+typedef struct lf_timed_header_t {
+  uint16_t port_id;
+  uint16_t federate_id;
+  uint32_t length;
+  int64_t time;
+  uint32_t microstep;
+} lf_timed_header_t;
+#pragma pack(pop)
+
 /**
  * Extract the core header information that all messages between
  * federates share. The core header information is two bytes with
@@ -304,6 +541,17 @@ void extract_header(unsigned char* buffer, uint16_t* port_id, uint16_t* federate
  */
 void extract_timed_header(unsigned char* buffer, uint16_t* port_id, uint16_t* federate_id, size_t* length, tag_t* tag);
 
+/**
+ * Write the timed header information for timed messages between federates,
+ * as read by extract_timed_header().
+ * @param buffer The buffer to write to, which must have room for sizeof(lf_timed_header_t) bytes.
+ * @param port_id The ID of the destination port.
+ * @param federate_id The ID of the destination federate.
+ * @param length The length of the message.
+ * @param tag The tag of the message.
+ */
+void encode_timed_header(unsigned char* buffer, uint16_t port_id, uint16_t federate_id, uint32_t length, tag_t tag);
+
 /**
  * Extract tag information from buffer.
  *
@@ -0,0 +1,137 @@
+/**
+ * @file
+ * @brief Connections between federates whose bytes are carried by RDMA (ibverbs) rather than TCP.
+ *
+ * When LF_FEDERATED_RDMA is defined, a federate that connects to another federate asks for
+ * P2P_OPTION_RDMA, and if both have an RDMA device, the stream of bytes that it sends on the
+ * connection is carried by a reliable connected queue pair instead of the TCP socket. The bytes
+ * are copied into registered send buffers and sent into a pool of registered receive buffers of
+ * the other federate, which reads them through read_from_socket() as before, so that the framing
+ * of the messages and the order of all of them on the connection are unchanged. The TCP socket
+ * stays open and still signals the end of the stream when the sending federate closes it.
+ *
+ * A channel is attached to the socket of the connection, and read_from_socket(),
+ * write_to_socket() and writev_to_socket() divert the I/O of attached sockets to it.
+ * Channels only carry bytes in one direction, from the federate that connected to the one
+ * that accepted, which is the only direction in which federates send messages to each other.
+ * Channels are only freed by rdma_free_channels(), after the threads that may use them have
+ * exited, so that closing a socket never frees a channel that another thread is waiting on.
+ * The caller serializes the calls to rdma_channel_create(), rdma_channel_attach(),
+ * rdma_channel_free() and rdma_free_channels().
+ */
+
+#ifndef RDMA_H
+#define RDMA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "net_common.h"
+
+/** @brief One end of a connection between federates that is carried by RDMA. */
+typedef struct rdma_channel_t rdma_channel_t;
+
+/**
+ * @brief Create the local end of a channel, opening the RDMA device if it has not been opened.
+ * The receiving end posts all of its receive buffers.
+ * @param receiver Whether this end receives the bytes rather than sending them.
+ * @param endpoint Where to store the description of this end, of P2P_RDMA_ENDPOINT_LENGTH bytes,
+ *  to send to the other federate.
+ * @return The channel, or NULL if there is no usable RDMA device or resources are exhausted.
+ */
+rdma_channel_t* rdma_channel_create(bool receiver, unsigned char* endpoint);
+
+/**
+ * @brief Connect the channel to the other end, described by the endpoint received from the other federate.
+ * @param channel The channel.
+ * @param socket The socket of the connection, which is watched while waiting for completions.
+ * @param endpoint The description of the other end.
+ * @return 0 for success, -1 for failure, including a socket ID that is too large to be looked up.
+ */
+int rdma_channel_connect(rdma_channel_t* channel, int socket, const unsigned char* endpoint);
+
+/**
+ * @brief Check that bytes reach the other end, which may not be on the same RDMA fabric.
+ * The sending end sends an empty message and waits until it has been delivered or has failed.
+ * The receiving end waits for that message, which it calls once the sending end has reported success.
+ * @param channel The channel, which is connected.
+ * @return 0 if the message was delivered, -1 otherwise.
+ */
+int rdma_channel_probe(rdma_channel_t* channel);
+
+/**
+ * @brief Divert the I/O of the socket of a channel to it. The channel must be connected and probed.
+ * @param channel The channel.
+ */
+void rdma_channel_attach(rdma_channel_t* channel);
+
+/**
+ * @brief Free a channel that is not attached to a socket.
+ * @param channel The channel, or NULL.
+ */
+void rdma_channel_free(rdma_channel_t* channel);
+
+/**
+ * @brief Return the channel attached to the specified socket, or NULL if there is none.
+ * This costs one load, so that it can be called on every read and write.
+ * @param socket The socket.
+ */
+rdma_channel_t* rdma_channel_of_socket(int socket);
+
+/**
+ * @brief Detach the channel from the socket, if there is one, before the socket is closed.
+ * A thread that is waiting for bytes on the channel returns with EOF. The channel is freed
+ * by rdma_free_channels().
+ * @param socket The socket.
+ */
+void rdma_detach_socket(int socket);
+
+/**
+ * @brief Read at least one and at most the specified number of bytes from the receiving end
+ * of a channel, waiting until they arrive. While waiting, this also watches the socket of the
+ * connection, on which the sending federate signals the end of the stream.
+ * @param channel The channel.
+ * @param max_bytes The maximum number of bytes to read.
+ * @param buffer Where to store the bytes.
+ * @return The number of bytes read, 0 for EOF, and -1 for an error.
+ */
+ssize_t rdma_channel_read(rdma_channel_t* channel, size_t max_bytes, unsigned char* buffer);
+
+/**
+ * @brief Return the next byte that can be read from the receiving end of a channel without waiting, if any,
+ * without consuming it.
+ * @param channel The channel.
+ * @param result Where to store the byte.
+ * @return 1 if there is such a byte, 0 if there is none, and -1 for an error.
+ */
+ssize_t rdma_channel_peek(rdma_channel_t* channel, unsigned char* result);
+
+/**
+ * @brief Send the bytes of the specified buffers on the sending end of a channel.
+ * The bytes are copied, so the buffers can be reused when this returns. This waits only if all
+ * send buffers are in flight, which bounds the bytes that have not yet been delivered.
+ * The caller must ensure that only one thread writes to the channel at a time.
+ * @param channel The channel.
+ * @param buffers The buffers.
+ * @param num_buffers The number of buffers.
+ * @return 0 for success, -1 for an error, after which the channel is unusable.
+ */
+int rdma_channel_write(rdma_channel_t* channel, const struct iovec* buffers, int num_buffers);
+
+/**
+ * @brief Wait until all bytes sent on the sending end of a channel have been delivered.
+ * This is called before the socket is shut down so that the end of the stream follows them.
+ * @param channel The channel.
+ * @return 0 for success, -1 for an error.
+ */
+int rdma_channel_flush(rdma_channel_t* channel);
+
+/**
+ * @brief Free all channels and close the RDMA device.
+ * This must only be called once no thread reads from or writes to a socket with a channel.
+ */
+void rdma_free_channels(void);
+
+#endif // RDMA_H
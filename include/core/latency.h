@@ -0,0 +1,83 @@
+/**
+ * @file
+ * @brief End-to-end latency from the arrival of events of physical actions to the reactions that act on them.
+ *
+ * When LF_LATENCY is defined, each event carries its origin, which is the physical time at which
+ * the chain of events that led to it started. The origin of an event of a physical action is the
+ * physical time at which it was scheduled, its arrival. The origin of a tag is the earliest origin
+ * of the events of that tag, and an event scheduled by a reaction, on a logical action or through a
+ * delayed connection, inherits the origin of the tag in which it was scheduled. Ports are present
+ * in the tag of the events that triggered their writers, so the origin follows a chain of
+ * reactions through ports, actions and delays until the tag of its last reaction. Origins are not
+ * carried between enclaves or federates, and events of timers have none.
+ *
+ * A reaction at the end of a chain, such as one that drives an actuator, designates itself as a
+ * sink by calling lf_latency_record() with the name of the chain, which records the physical time
+ * elapsed since the origin of the current tag in the histogram of the chain. Each environment has
+ * up to LF_LATENCY_MAX_CHAINS chains. The histograms are printed on normal termination, written to
+ * the profile file with LF_REACTION_PROFILE_WRITE (see reaction_profile.h), and published in the
+ * metrics block with LF_METRICS (see metrics.h).
+ *
+ * When events that arrived at different times share a tag, the latency recorded at a sink in that
+ * tag is that of the earliest, which is the worst case for the chain.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+
+#include "lf_types.h"
+
+/** The number of chains of an environment whose latency is recorded. Later chains are not recorded. */
+#define LF_LATENCY_MAX_CHAINS 8
+
+/**
+ * The number of buckets of the histogram of a chain. Bucket `i` counts the latencies of at most
+ * 2^i microseconds that are not counted in an earlier bucket, and the last bucket counts the rest.
+ */
+#define LF_LATENCY_BUCKETS 24
+
+/** @brief The latency statistics of a chain, which sinks update without a lock. */
+typedef struct lf_latency_chain_t {
+  const char* name;                    // The name of the chain, or NULL if this entry is unused.
+  int64_t count;                       // The number of latencies recorded.
+  int64_t total;                       // Their sum in nanoseconds.
+  int64_t max;                         // The largest of them.
+  int64_t buckets[LF_LATENCY_BUCKETS]; // The histogram.
+} lf_latency_chain_t;
+
+/**
+ * @brief Record the latency of the chain that ends with the calling reaction.
+ *
+ * This is to be called in the body of a reaction, which becomes a sink of the chain. If the
+ * current tag has no origin, because none of the events that led to it came from a physical
+ * action, nothing is recorded.
+ * @param self The self struct of the reactor of the reaction.
+ * @param chain The name of the chain, such as a string literal, which must remain valid until termination.
+ * Sinks that give the same name share a histogram.
+ * @return The latency, which is the physical time elapsed since the origin of the current tag,
+ * or NEVER if the tag has no origin.
+ */
+interval_t lf_latency_record(void* self, const char* chain);
+
+///////////////////// Internal functions /////////////////////
+// The following functions are internal to the runtime and should not be documented by Doxygen.
+/// \cond INTERNAL  // Doxygen conditional.
+
+/**
+ * @brief Print the latency statistics of the chains of the environment that have been recorded.
+ * @param env The environment.
+ */
+void lf_latency_print(environment_t* env);
+
+/**
+ * @brief Write a line `latency,chain,count,mean,p50,p99,max` for each chain of the environment.
+ * @param env The environment.
+ * @param file The file to write to.
+ */
+void lf_latency_write(environment_t* env, FILE* file);
+
+/// \endcond // INTERNAL
+
+#endif // LATENCY_H
@@ -17,7 +17,9 @@
  * length 1). The type also optionally has function pointers to a destructor
  * and copy constructor. These must be specified if the payload (value) is a complex
  * struct that cannot be freed by a simple call to free() or copied by a call
- * to memcpy().
+ * to memcpy(). Likewise, it optionally has functions that serialize and deserialize
+ * the value if it is not sent to other federates as its bytes, which the network layer
+ * calls on its own send and receive buffers.
  *
  * An instance of a port struct and trigger_t struct (an action or an input port)
  * can be cast to token_template_t, which has a token_type_t field called type
@@ -40,10 +42,13 @@
 #ifndef LF_TOKEN_H
 #define LF_TOKEN_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h> // Defines size_t
 
 // Forward declarations
 struct environment_t;
+typedef struct lf_token_pool_t lf_token_pool_t;
 
 //////////////////////////////////////////////////////////
 //// Constants and enums
@@ -56,6 +61,12 @@ typedef enum token_freed {
   TOKEN_AND_VALUE_FREED // Both were freed
 } token_freed;
 
+/**
+ * Number of length classes of a token payload pool.
+ * Length class k holds payloads of up to 2^k elements.
+ */
+#define LF_TOKEN_POOL_NUM_CLASSES 16
+
 //////////////////////////////////////////////////////////
 //// Data structures
 
@@ -71,6 +82,22 @@ typedef struct token_type_t {
   void (*destructor)(void* value);
   /** The copy constructor or NULL to use memcpy. */
   void* (*copy_constructor)(void* value);
+  /** Pool from which payloads allocated by the runtime are drawn or NULL to use malloc(). */
+  lf_token_pool_t* pool;
+  /**
+   * The number of bytes that serialize_into() writes for a value or NULL to send the
+   * element_size * length bytes of the value on network connections. A type with the
+   * serialization functions has values of one element.
+   */
+  size_t (*serialized_size)(void* value);
+  /** Write the serialized_size() bytes of a value into a buffer or NULL if serialized_size is NULL. */
+  void (*serialize_into)(void* value, unsigned char* buffer);
+  /**
+   * Set a value, which has element_size bytes, from the specified number of bytes received from the
+   * network, which remain valid only during the call, and return 0, or -1 if they are malformed.
+   * NULL if serialized_size is NULL.
+   */
+  int (*deserialize_from)(const unsigned char* buffer, size_t size, void* value);
 } token_type_t;
 
 /**
@@ -98,21 +125,57 @@ typedef struct lf_token_t {
   size_t length;
   /** Pointer to the port or action defining the type of the data carried. */
   token_type_t* type;
-  /** The number of times this token is on the event queue. */
+  /** The number of holders of this token, such as events and templates. Changed atomically. */
   size_t ref_count;
   /** Convenience for constructing a temporary list of tokens. */
   struct lf_token_t* next;
+  /** Whether the value was drawn from the pool of the token's type. */
+  bool value_from_pool;
+  /** Destructor of the value that is used instead of that of the type, or NULL. See lf_schedule_move. */
+  void (*destructor)(void* value);
+#ifdef LF_MEMORY_ACCOUNTING
+  /** Bytes of the value that are counted as payload memory, or 0. See memory_accounting.h. */
+  size_t payload_size;
+#endif
 } lf_token_t;
 
+/**
+ * @brief Statistics of a token payload pool.
+ */
+typedef struct lf_token_pool_stats_t {
+  /** Number of payloads drawn from the pool. */
+  size_t allocations;
+  /** Number of those that reused a previously returned payload. */
+  size_t hits;
+  /** Number of payloads currently drawn from the pool and not returned. */
+  size_t in_use;
+  /** Maximum value that in_use has reached. */
+  size_t high_watermark;
+  /** Number of returned payloads held for reuse. */
+  size_t cached;
+} lf_token_pool_stats_t;
+
 /**
  * A record of the subset of channels of a multiport that have present inputs.
  */
 typedef struct lf_sparse_io_record_t {
-  int size;                  // -1 if overflowed. 0 if empty.
+  int size;                  // -1 if overflowed. 0 if empty. Must be the first field. See _lf_start_time_step.
   size_t capacity;           // Max number of writes to be considered sparse.
+  size_t* channels;          // Channels that are present if the capacity has grown, or NULL to use present_channels.
+  int window_tags;           // Number of tags in the current window for counting overflows.
+  int window_overflows;      // Number of those tags at which the record overflowed.
+  int width;                 // Number of channels covered by present_bits.
+  uint64_t* present_bits;    // Bitmap of the present channels, or NULL. Allocated at the start of the tag after
+                             // the first iteration over the record once it overflowed.
+                             // See lf_sparse_io_record_set_present.
   size_t present_channels[]; // Array of channel indices that are present.
 } lf_sparse_io_record_t;
 
+/** @brief Return the array of channels of the record that are present. */
+static inline size_t* lf_sparse_io_record_channels(lf_sparse_io_record_t* record) {
+  return record->channels != NULL ? record->channels : record->present_channels;
+}
+
 /**
  * @brief Base type for ports (lf_port_base_t) and actions (trigger_t), which can carry tokens.
  * The structs lf_port_base_t and trigger_t should start with an instance of this struct
@@ -146,6 +209,10 @@ typedef struct lf_port_base_t {
   self_base_t* source_reactor;          // Pointer to the self struct of the reactor that provides data to this port.
                                         // If this is an input, that reactor will normally be the container of the
                                         // output port that sends it data.
+#ifdef _PYTHON_TARGET_ENABLED
+  void* py_capsule;           // The port_capsule of this port, created when it is first passed to Python.
+  void* py_multiport_capsule; // If this is the first channel of a multiport, the port_capsule of the multiport.
+#endif
 } lf_port_base_t;
 
 //////////////////////////////////////////////////////////
@@ -174,6 +241,22 @@ extern lf_token_t* _lf_tokens_allocated_in_reactions;
  */
 extern int _lf_count_token_allocations;
 
+/**
+ * @brief Count `delta` payload allocations (or frees, if negative) by the calling thread.
+ * The threads of the threaded runtime count on their own counters, which are summed by
+ * _lf_get_unfreed_allocations. This exists only if NDEBUG is not defined.
+ * @param delta The number of allocations.
+ */
+void _lf_count_payload_allocation(int delta);
+
+/**
+ * @brief Get the numbers of tokens and payloads that have been allocated and not freed.
+ * This exists only if NDEBUG is not defined.
+ * @param tokens Where to store the number of tokens.
+ * @param payloads Where to store the number of payloads.
+ */
+void _lf_get_unfreed_allocations(int* tokens, int* payloads);
+
 //////////////////////////////////////////////////////////
 //// Functions that users may call
 
@@ -213,6 +296,77 @@ lf_token_t* lf_new_token(void* port_or_action, void* val, size_t len);
  */
 lf_token_t* lf_writable_copy(lf_port_base_t* port);
 
+/**
+ * Return a writable copy of the token in the specified template, like
+ * lf_writable_copy, for a reaction that modifies only the elements from
+ * `offset` to `offset + length` of the payload.
+ * On Linux, if the payload was allocated with lf_cow_alloc() and sent with
+ * lf_cow_free() as its destructor (see lf_set_move), the copy shares the pages
+ * of the payload, and only the pages overlapping the region are duplicated.
+ * Any other page is duplicated only if it is written after all.
+ * Otherwise, the whole payload is copied, as with lf_writable_copy.
+ * @param port An input port, cast to (lf_port_base_t*).
+ * @param offset The index of the first element of the region.
+ * @param length The number of elements in the region.
+ * @return A pointer to a writable copy of the token, or NULL if the type is primitive
+ *  or the region exceeds the payload.
+ */
+lf_token_t* lf_writable_region(lf_port_base_t* port, size_t offset, size_t length);
+
+/**
+ * @brief Share the specified token with `count` more holders, such as the destinations of a
+ * fan-out to other environments, by adding `count` references in one atomic step.
+ * Each holder releases its reference with a single atomic decrement, and the last one frees
+ * the token. Holders must treat the payload as immutable; one that modifies it must use
+ * lf_writable_copy.
+ * @param token The token.
+ * @param count The number of references to add.
+ */
+void lf_token_broadcast(lf_token_t* token, size_t count);
+
+/**
+ * @brief Draw payloads for tokens of the specified port or action from a pool.
+ * Payloads that the runtime allocates for this port or action (see `lf_schedule_copy`,
+ * `lf_writable_copy`, and `_lf_initialize_token`) are then drawn from per-length-class
+ * free lists, and are returned to them instead of being freed once the last token referring
+ * to them is released. Payloads of more than 2^(LF_TOKEN_POOL_NUM_CLASSES - 1) elements
+ * still use malloc().
+ * This should be called before the port or action is used, e.g. in a startup reaction.
+ * It is a no-op if the port or action already has a pool.
+ * @param port_or_action A port or action whose type has no destructor or copy constructor.
+ * @param max_cached_per_class The maximum number of returned payloads kept for each length class.
+ * @return 0 on success, -1 if the type has a destructor or copy constructor or has no element size.
+ */
+int lf_token_pool_enable(void* port_or_action, size_t max_cached_per_class);
+
+/**
+ * @brief Get the statistics of the pool of the specified port or action.
+ * All statistics are zero if the port or action has no pool.
+ * @param port_or_action A port or action.
+ * @param stats Where to store the statistics.
+ */
+void lf_token_pool_get_stats(void* port_or_action, lf_token_pool_stats_t* stats);
+
+/**
+ * @brief Draw an uninitialized payload for `length` elements from the pool of the specified
+ * port or action. The caller fills it and hands it over without copying with `lf_schedule_move`
+ * or `lf_set_move`, giving `lf_token_pool_free` as the destructor, so that the payload returns
+ * to the pool once the last token referring to it is released.
+ * @param port_or_action A port or action with a pool (see lf_token_pool_enable).
+ * @param length The number of elements.
+ * @return The payload, or NULL if the port or action has no pool or the length is zero or
+ *  exceeds the largest length class, in which case the caller should use malloc() instead.
+ */
+void* lf_token_pool_alloc(void* port_or_action, size_t length);
+
+/**
+ * @brief Return a payload drawn with `lf_token_pool_alloc` to its pool.
+ * This is normally not called directly, but given as the destructor to `lf_schedule_move`
+ * or `lf_set_move`.
+ * @param value The payload.
+ */
+void lf_token_pool_free(void* value);
+
 //////////////////////////////////////////////////////////
 //// Functions not intended to be used by users
 
@@ -221,9 +375,9 @@ lf_token_t* lf_writable_copy(lf_port_base_t* port);
  * If the reference count is greater than 0, then do not free
  * anything. Otherwise, the token value (payload) will be freed,
  * if there is one. Then the token itself will be freed.
- * The freed token will be put on the recycling bin unless that
- * bin has reached the designated capacity, in which case free()
- * will be used.
+ * The freed token will be put on the recycling bin of the calling
+ * thread or, if that is full, on a global lock-free overflow stack.
+ * If that has also reached the designated capacity, free() will be used.
  *
  * @param token Pointer to a token.
  * @return NOT_FREED if nothing was freed, VALUE_FREED if the value
@@ -234,8 +388,9 @@ token_freed _lf_free_token(lf_token_t* token);
 
 /**
  * @brief Return a new token with the specified type, value, and length.
- * This will attempt to get one from the recyling bin, and, if the
- * recycling bin is empty, will allocate a new token using calloc
+ * This will attempt to get one from the recyling bin of the calling
+ * thread, refilled from the global overflow stack, and, if both are empty,
+ * will allocate a new token using calloc
  * and set its type to point to the specified type. The returned token
  * will indicate that it is not a template token, and its reference count
  * will be 0.
@@ -247,6 +402,16 @@ token_freed _lf_free_token(lf_token_t* token);
  */
 lf_token_t* _lf_new_token(token_type_t* type, void* value, size_t length);
 
+/**
+ * @brief Return a new token as _lf_new_token does, with an uninitialized payload
+ * of `length` bytes into which the caller writes the value.
+ * If the type has a pool (see lf_token_pool_enable), the payload is drawn from it.
+ * @param type The type of the token.
+ * @param length The size of the payload in bytes, which is also the length of the token.
+ * @return A token whose value is NULL if the length is zero.
+ */
+lf_token_t* _lf_new_token_with_payload(token_type_t* type, size_t length);
+
 /**
  * Get a token for the specified template.
  * If the template already has a token and the reference count is 1,
@@ -309,11 +474,27 @@ lf_token_t* _lf_initialize_token(token_template_t* tmplt, size_t length);
 
 /**
  * @brief Free all tokens.
- * Free tokens on the _lf_token_recycling_bin hashset and all
- * template tokens.
+ * Free tokens on the per-thread recycling bins, the global overflow
+ * stack, and all template tokens. Then log the statistics of, and free,
+ * all token payload pools.
  */
 void _lf_free_all_tokens();
 
+/**
+ * @brief Get statistics about token recycling.
+ * A hit is a token allocation that was served from a recycling bin and a miss
+ * is one that required allocating new memory.
+ * @param hits Where to store the number of hits since the start of execution.
+ * @param misses Where to store the number of misses since the start of execution.
+ */
+void _lf_get_token_recycling_stats(size_t* hits, size_t* misses);
+
+/**
+ * @brief Return the number of tokens in the recycling bins.
+ * Bins that other threads are updating may be counted before or after the update.
+ */
+size_t _lf_token_recycling_bin_size(void);
+
 /**
  * @brief Replace the token in the specified template, if there is one,
  * with a new one. If the new token is the same as the token in the template,
@@ -324,7 +505,13 @@ void _lf_free_all_tokens();
 void _lf_replace_template_token(token_template_t* tmplt, lf_token_t* newtoken);
 
 /**
- * Decrement the reference count of the specified token.
+ * @brief Atomically increment the reference count of the specified token.
+ * @param token Pointer to a token.
+ */
+void _lf_token_add_reference(lf_token_t* token);
+
+/**
+ * Atomically decrement the reference count of the specified token, without a lock.
  * If the reference count hits 0, free the memory for the value
  * carried by the token, and, if the token is not also the template
  * token of its trigger, free the token.
@@ -339,6 +526,9 @@ token_freed _lf_done_using(lf_token_t* token);
  * @brief Free token copies made for mutable inputs.
  * This function should be called at the beginning of each time step
  * to avoid memory leaks.
+ * If LF_ASYNC_TOKEN_RELEASE is defined in the threaded runtime, this only
+ * releases the references, and the copies that are no longer referenced are
+ * freed, and their destructors invoked, by a background thread.
  * @param env Environment in which we are executing.
  */
 void _lf_free_token_copies(void);
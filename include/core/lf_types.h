@@ -47,6 +47,10 @@ typedef unsigned short int ushort;
 #define SCHED_ADAPTIVE 1
 #define SCHED_GEDF_NP 2
 #define SCHED_NP 3
+#define SCHED_WORK_STEALING 4
+#define SCHED_GEDF_SHARDED 5
+#define SCHED_DATAFLOW 6
+#define SCHED_LLF 7
 
 /*
  * A struct representing a barrier in threaded
@@ -80,6 +84,16 @@ typedef struct _lf_tag_advancement_barrier {
  */
 typedef enum { defer, drop, replace } lf_spacing_policy_t;
 
+/**
+ * Policy for handling the events of a physical action beyond its capacity, or beyond the
+ * capacity of its environment. See lf_action_set_capacity.
+ * The `lf_overload_reject` policy makes the lf_schedule functions return -1 for the new event.
+ * The `lf_overload_drop_oldest` policy drops the oldest events of the action that are not
+ * yet on the event queue. The `lf_overload_coalesce` policy merges the newest of them into
+ * the oldest one that is kept, which gets the payload of the newest.
+ */
+typedef enum { lf_overload_reject, lf_overload_drop_oldest, lf_overload_coalesce } lf_overload_policy_t;
+
 /**
  * Status of a given port at a given logical time.
  *
@@ -138,6 +152,13 @@ typedef pqueue_pri_t index_t;
  */
 typedef void (*reaction_function_t)(void*);
 
+/**
+ * Batch reaction function type. It does the work of the reaction function for each of
+ * the `count` self structs in `selves`, which belong to reactors of the same class,
+ * typically the members of a bank. Each self struct has its bank index.
+ */
+typedef void (*reaction_batch_function_t)(void** selves, size_t count);
+
 /** Trigger struct representing an output, timer, action, or input. See below. */
 typedef struct trigger_t trigger_t;
 
@@ -150,45 +171,89 @@ typedef struct trigger_t trigger_t;
  * The fields marked RUNTIME have values that change
  * during execution.
  * Instances of this struct are put onto the reaction queue by the scheduler.
+ *
+ * The fields are ordered by how often the runtime accesses them. On a 64-bit platform, the
+ * first 64 bytes hold what queueing and dispatching a reaction needs and the next 64 bytes
+ * what executing it and propagating its outputs needs, so that the fields that are only used
+ * for reporting, deadline violations and STP violations stay out of those two cache lines.
+ * If LF_REACTION_ALIGNMENT is defined, for example to 64, the struct is aligned to that many
+ * bytes, so that these groups of fields are also aligned to cache lines, at the cost of padding
+ * in the self structs.
  */
+#ifdef LF_REACTION_ALIGNMENT
+#define LF_REACTION_ALIGNED __attribute__((aligned(LF_REACTION_ALIGNMENT)))
+#else
+#define LF_REACTION_ALIGNED
+#endif
 typedef struct reaction_t reaction_t;
-struct reaction_t {
-  reaction_function_t function; // The reaction function. COMMON.
+struct LF_REACTION_ALIGNED reaction_t {
+  // Queueing and dispatching.
+  index_t index;             // Inverse priority determined by dependency analysis. INSTANCE.
+  reaction_status_t status;  // Indicator of whether the reaction is inactive, queued, or running. RUNTIME.
+  bool is_STP_violated;      // Indicator of STP violation in one of the input triggers to this reaction.
+                             // default = false. Value of True indicates to the runtime that this reaction
+                             // contains trigger(s) that are triggered at a later logical time that was
+                             // originally anticipated. Currently, this is only possible if logical
+                             // connections are used in a decentralized federated
+                             // execution. COMMON.
+  bool is_an_input_reaction; // Indicates whether this reaction is a network input reaction of a federate. Default is
+                             // false.
+  size_t pos;                // Current position in the priority queue. RUNTIME.
+  reaction_t* next_queued;   // Next reaction at the same level of the reaction queue. RUNTIME.
+  reaction_t* next_in_batch; // Next reaction of the batch that this reaction leads. RUNTIME.
   void* self;                   // Pointer to a struct with the reactor's state. INSTANCE.
-  int number;                   // The number of the reaction in the reactor (0 is the first reaction).
-  index_t index;                // Inverse priority determined by dependency analysis. INSTANCE.
-  size_t pos;                   // Current position in the priority queue. RUNTIME.
+  reaction_function_t function; // The reaction function. COMMON.
+  reactor_mode_t* mode;         // The enclosing mode of this reaction (if exists).
+                                // If enclosed in multiple, this will point to the innermost mode.
+  // Execution and propagation of outputs.
+  interval_t deadline; // Deadline relative to the time stamp for invocation of the reaction. INSTANCE.
   reaction_t*
       last_enabling_reaction; // The last enabling reaction, or NULL if there is none. Used for optimization. INSTANCE.
+  size_t worker_affinity;     // The worker number of the thread that last executed this reaction. Used
+                              // as a suggestion to the schedulers that have per-worker queues.
+  // If not NULL, the threaded runtime may invoke this once for several triggered reactions with
+  // the same batch function and level instead of invoking their functions one by one. COMMON.
+  reaction_batch_function_t batch_function;
   size_t num_outputs;         // Number of outputs that may possibly be produced by this function. COMMON.
   bool** output_produced;     // Array of pointers to booleans indicating whether outputs were produced. COMMON.
+  const struct lf_fanout_t* fanout; // The downstream reactions of each output in one array, built the first time
+                                    // the outputs are propagated, or NULL. With LF_STATIC_TOPOLOGY, a table
+                                    // given by the generated code. See lf_fanout_t. RUNTIME.
   int* triggered_sizes;       // Pointer to array of ints with number of triggers per output. INSTANCE.
-  trigger_t*** triggers;      // Array of pointers to arrays of pointers to triggers triggered by each output. INSTANCE.
-  reaction_status_t status;   // Indicator of whether the reaction is inactive, queued, or running. RUNTIME.
-  interval_t deadline;        // Deadline relative to the time stamp for invocation of the reaction. INSTANCE.
-  bool is_STP_violated; // Indicator of STP violation in one of the input triggers to this reaction. default = false.
-                        // Value of True indicates to the runtime that this reaction contains trigger(s)
-                        // that are triggered at a later logical time that was originally anticipated.
-                        // Currently, this is only possible if logical
-                        // connections are used in a decentralized federated
-                        // execution. COMMON.
+  trigger_t*** triggers;      // Array of pointers to arrays of pointers to triggers triggered by each output.
+                              // INSTANCE.
+  // Rarely used.
+  int number;                                     // The number of the reaction in the reactor (0 is the first).
+  size_t deadline_misses;                         // Number of times the deadline has been missed. RUNTIME.
   reaction_function_t deadline_violation_handler; // Deadline violation handler. COMMON.
   reaction_function_t STP_handler;                // STP handler. Invoked when a trigger to this reaction
                                                   // was triggered at a later logical time than originally
                                                   // intended. Currently, this is only possible if logical
                                                   // connections are used in a decentralized federated
                                                   // execution. COMMON.
-  bool is_an_input_reaction; // Indicates whether this reaction is a network input reaction of a federate. Default is
-                             // false.
-  size_t worker_affinity;    // The worker number of the thread that scheduled this reaction. Used
-                             // as a suggestion to the scheduler.
-  const char* name;          // If logging is set to LOG or higher, then this will
-                             // point to the full name of the reactor followed by
-                             // the reaction number.
-  reactor_mode_t* mode;      // The enclosing mode of this reaction (if exists).
-                             // If enclosed in multiple, this will point to the innermost mode.
+  const char* name;                               // If logging is set to LOG or higher, then this will
+                                                  // point to the full name of the reactor followed by
+                                                  // the reaction number. It is NULL with LF_MINIMAL_FOOTPRINT.
+#ifdef LF_REACTION_PROFILE
+  struct lf_reaction_profile_t* profile; // Execution-time statistics. See reaction_profile.h. RUNTIME.
+#endif
+#ifdef LF_TAG_PIPELINING
+  bool pipeline_explored; // Whether the component of the reactor is known. See pipeline.h. RUNTIME.
+#endif
 };
 
+/**
+ * The downstream reactions of the outputs of a reaction, in one array. The downstream reactions
+ * of output `i` are `reactions[offsets[i]]` to `reactions[offsets[i + 1] - 1]`, in the order in
+ * which `triggers[i][j]->reactions[k]` lists them, without the NULL entries. The runtime builds it
+ * the first time the outputs of the reaction are propagated, except with LF_STATIC_TOPOLOGY, where
+ * the generated code gives it as a constant table (see environment.h).
+ */
+typedef struct lf_fanout_t {
+  const int* offsets;            // num_outputs + 1 offsets into reactions.
+  reaction_t* const* reactions;  // The downstream reactions.
+} lf_fanout_t;
+
 /** Typedef for event_t struct, used for storing activation records. */
 typedef struct event_t event_t;
 
@@ -197,28 +262,29 @@ struct event_t {
   pqueue_tag_element_t base; // Elements of pqueue_tag. It contains tag of release and position in the priority queue.
   trigger_t* trigger;        // Associated trigger, NULL if this is a dummy event.
   lf_token_t* token;         // Pointer to the token wrapping the value.
+  event_t* next_free;        // Next event on the free list of the environment, if this event is unused.
+  event_t* earlier_pending;  // Event with the same trigger on the event queue before this one in tag order, or NULL.
+  event_t* later_pending;    // Event with the same trigger on the event queue after this one in tag order, or NULL.
 #ifdef FEDERATED
   tag_t intended_tag; // The intended tag.
 #endif
+#ifdef LF_LATENCY
+  instant_t origin; // Physical time at which the chain of events that led to this one started, or NEVER. See latency.h.
+#endif
 };
 
 /**
  * Trigger struct representing an output, timer, action, or input.
+ * The fields that propagating a present output needs come right after the template, which
+ * has to be first, so that on a 64-bit platform they are in the first cache line.
  */
 struct trigger_t {
   token_template_t tmplt;  // Type and token information (template is a C++ keyword).
   reaction_t** reactions;  // Array of pointers to reactions sensitive to this trigger.
   int number_of_reactions; // Number of reactions sensitive to this trigger.
-  bool is_timer;           // True if this is a timer (a special kind of action), false otherwise.
-  interval_t offset;       // Minimum delay of an action. For a timer, this is also the maximum delay.
-  interval_t period; // Minimum interarrival time of an action. For a timer, this is also the maximal interarrival time.
-  bool is_physical;  // Indicator that this denotes a physical action.
-  tag_t last_tag;    // Tag of the last event that was scheduled for this action.
-                     // This is only used for actions and will otherwise be NEVER.
-  lf_spacing_policy_t policy; // Indicates which policy to use when an event is scheduled too early.
-  port_status_t status;       // Determines the status of the port at the current logical time. Therefore, this
-                              // value needs to be reset at the beginning of each logical time.
-                              //
+  port_status_t status;    // Determines the status of the port at the current logical time. Therefore, this
+                           // value needs to be reset at the beginning of each logical time.
+                           //
   // This status is especially needed for the distributed execution because the receiver logic
   // will need to know what it should do if it receives a message with 'intended tag = current
   // tag' from another federate.
@@ -232,8 +298,27 @@ struct trigger_t {
   //   the decentralized coordination.
   // - Finally, if status is 'present', then this is an error since multiple
   //   downstream messages have been produced for the same port for the same logical time.
+  bool is_timer;           // True if this is a timer (a special kind of action), false otherwise.
+  interval_t offset;       // Minimum delay of an action. For a timer, this is also the maximum delay.
+  interval_t period; // Minimum interarrival time of an action. For a timer, this is also the maximal interarrival time.
+  bool is_physical;  // Indicator that this denotes a physical action.
+  tag_t last_tag;    // Tag of the last event that was scheduled for this action.
+                     // This is only used for actions and will otherwise be NEVER.
+  lf_spacing_policy_t policy; // Indicates which policy to use when an event is scheduled too early.
+  event_t* last_pending;      // The event for this trigger on the event queue with the largest tag, or NULL.
+                              // See _lf_find_pending_event.
+  struct lf_ingress_limit_t* ingress_limit; // The capacity of a physical action, or NULL. See lf_action_set_capacity.
+  bool batches;            // Whether events of this physical action are batched. See lf_action_set_batch_window.
+  interval_t batch_window; // If so, how much later than the last pending event an event may be to be appended to it.
+  struct lf_isr_ring_t* isr_ring; // The ring of a physical action scheduled from interrupts, or NULL.
+                                 // See lf_action_set_isr_ring.
+  trigger_t* next_in_timer_group; // The next timer with the same offset and period, which fires along with this
+                                  // one, or NULL. See _lf_initialize_timers.
   reactor_mode_t* mode; // The enclosing mode of this reaction (if exists).
                         // If enclosed in multiple, this will point to the innermost mode.
+#ifdef _PYTHON_TARGET_ENABLED
+  void* py_capsule; // The action_capsule of the action, created when it is first passed to Python.
+#endif
 #ifdef FEDERATED
   tag_t last_known_status_tag; // Last known status of the port, either via a timed message, a port absent, or a
                                // TAG from the RTI.
@@ -257,6 +342,9 @@ struct trigger_t {
 typedef struct allocation_record_t {
   void* allocated;
   struct allocation_record_t* next;
+#ifdef LF_MEMORY_ACCOUNTING
+  size_t size; // Bytes of the allocated memory and the record, counted as reactor memory.
+#endif
 } allocation_record_t;
 
 typedef struct environment_t environment_t;
@@ -278,12 +366,22 @@ typedef struct self_base_t {
   struct reaction_t* executing_reaction; // The currently executing reaction of the reactor.
   environment_t* environment;
 #if !defined(LF_SINGLE_THREADED)
-  void* reactor_mutex; // If not null, this is expected to point to an lf_mutex_t.
-                       // It is not declared as such to avoid a dependence on platform.h.
+  void* reactor_mutex;    // If not null, this is expected to point to an lf_mutex_t.
+                          // It is not declared as such to avoid a dependence on platform.h.
+  int32_t reactor_state;  // If reactor_mutex is not null, whether the reactor is taken. See watchdog.h.
+  size_t worker_affinity; // The worker number of the thread that last executed a reaction of this reactor.
+#endif
+#if defined(LF_TRACE)
+  uint64_t trace_excluded; // Bit n is set if reaction n is filtered out of the trace. Bit 63 covers reactions 63 and up.
+  int trace_countdown;     // Reaction invocations to skip before the next one is sampled into the trace.
 #endif
 #if defined(MODAL_REACTORS)
   reactor_mode_state_t _lf__mode_state; // The current mode (for modal models).
 #endif
+#if defined(LF_TAG_PIPELINING)
+  struct self_base_t* pipeline_parent; // The next reactor towards the root of the component, or NULL. See pipeline.h.
+  uint64_t pipeline_lag;               // If this is a root, the last epoch in which the component lagged.
+#endif
 } self_base_t;
 
 /**
@@ -318,6 +416,10 @@ typedef struct {
   self_base_t* source_reactor;          // Pointer to the self struct of the reactor that provides data to this port.
                                         // If this is an input, that reactor will normally be the container of the
                                         // output port that sends it data.
+#ifdef _PYTHON_TARGET_ENABLED
+  void* py_capsule;           // The port_capsule of this port, created when it is first passed to Python.
+  void* py_multiport_capsule; // If this is the first channel of a multiport, the port_capsule of the multiport.
+#endif
 } lf_port_internal_t;
 
 #endif
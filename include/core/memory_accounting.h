@@ -0,0 +1,97 @@
+/**
+ * @file
+ * @brief Accounting of the memory that the runtime allocates, by subsystem.
+ *
+ * When LF_MEMORY_ACCOUNTING is defined, the runtime counts the bytes that it allocates and frees
+ * on the allocation paths of each subsystem:
+ *
+ * - events: the blocks of events of the free lists of the environments (see lf_get_new_event),
+ * - tokens: the tokens themselves (see _lf_new_token),
+ * - payloads: the values carried by tokens, whether allocated by the runtime, by a copy
+ *   (see lf_writable_copy), drawn from a pool or handed over by the program,
+ * - reactors: the memory that lf_allocate() records, including the reactors of lf_new_reactor()
+ *   and the blocks of the arena with LF_ARENA_ALLOCATION,
+ * - trace: the buffers of the tracing module, as reported by lf_tracing_memory_size(),
+ * - scheduler: the scheduler instances and their queues,
+ * - network: the buffers of the messages that a federate sends and receives.
+ *
+ * Memory that is kept for reuse, such as the events on a free list and the tokens in the
+ * recycling bins, remains live. For each subsystem, the live bytes, their high-water mark and the
+ * number and bytes of allocations are printed on normal termination, with the allocation rates
+ * over the elapsed physical time, and published in the metrics block with LF_METRICS (see
+ * metrics.h), from which the rates over any interval follow.
+ *
+ * The counters are updated atomically, so the accounting costs a few atomic additions per
+ * allocation, which is why it is optional.
+ */
+
+#ifndef MEMORY_ACCOUNTING_H
+#define MEMORY_ACCOUNTING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief The subsystems whose memory is accounted for. */
+typedef enum {
+  lf_memory_events,
+  lf_memory_tokens,
+  lf_memory_payloads,
+  lf_memory_reactors,
+  lf_memory_trace,
+  lf_memory_scheduler,
+  lf_memory_network,
+  lf_memory_num_subsystems
+} lf_memory_subsystem_t;
+
+/** @brief The memory statistics of a subsystem. */
+typedef struct lf_memory_account_t {
+  int64_t live;        // Bytes allocated and not freed.
+  int64_t high_water;  // The most bytes that were live at once.
+  int64_t allocations; // Number of allocations.
+  int64_t allocated;   // Bytes allocated in total, including those freed since.
+} lf_memory_account_t;
+
+#ifdef LF_MEMORY_ACCOUNTING
+
+/**
+ * @brief Get the memory statistics of the subsystems.
+ * @param accounts An array of lf_memory_num_subsystems statistics, indexed by lf_memory_subsystem_t.
+ */
+void lf_memory_get_accounts(lf_memory_account_t* accounts);
+
+///////////////////// Internal functions /////////////////////
+// The following functions are internal to the runtime and should not be documented by Doxygen.
+/// \cond INTERNAL  // Doxygen conditional.
+
+/**
+ * @brief Count an allocation of memory by a subsystem.
+ * @param subsystem The subsystem.
+ * @param bytes The number of bytes allocated.
+ */
+void _lf_memory_allocated(lf_memory_subsystem_t subsystem, size_t bytes);
+
+/**
+ * @brief Count memory that a subsystem frees, which was counted by _lf_memory_allocated().
+ * @param subsystem The subsystem.
+ * @param bytes The number of bytes freed.
+ */
+void _lf_memory_freed(lf_memory_subsystem_t subsystem, size_t bytes);
+
+/**
+ * @brief Print the memory statistics of the subsystems.
+ */
+void _lf_memory_print(void);
+
+/// \endcond // INTERNAL
+
+#define LF_MEMORY_ALLOCATED(subsystem, bytes) _lf_memory_allocated(subsystem, bytes)
+#define LF_MEMORY_FREED(subsystem, bytes) _lf_memory_freed(subsystem, bytes)
+
+#else
+
+#define LF_MEMORY_ALLOCATED(subsystem, bytes)
+#define LF_MEMORY_FREED(subsystem, bytes)
+
+#endif // LF_MEMORY_ACCOUNTING
+
+#endif // MEMORY_ACCOUNTING_H
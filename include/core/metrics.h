@@ -0,0 +1,158 @@
+/**
+ * @file
+ * @brief Live metrics of the health of a running program, published in shared memory.
+ *
+ * When LF_METRICS is defined, the runtime publishes statistics in a block of POSIX shared
+ * memory named `/lf-metrics-<pid>` (on Linux, the file `/dev/shm/lf-metrics-<pid>`), which
+ * other processes can map read-only while the program runs. The utility in util/metrics
+ * prints them in the Prometheus text format. The block is removed on termination.
+ *
+ * The block is updated without locks or system calls. Each worker counts the reactions it
+ * invokes and the time it spends in their bodies, which takes two clock readings per
+ * reaction, in a cache line of its own. The thread that starts a tag of an environment
+ * records the size of the event queue, the number of free events and the tag lag, which is
+ * physical time minus logical time at the start of the tag, as well as the events of physical
+ * actions that are staged, rejected or shed (see lf_environment_set_ingress_limits). The statistics of the token
+ * recycling bins, which are spread over all threads, are only gathered every
+ * LF_METRICS_PERIOD, as are the histograms of end-to-end latency of an environment when
+ * LF_LATENCY is defined (see latency.h), at the start of its tags, and the memory of each
+ * subsystem when LF_MEMORY_ACCOUNTING is defined (see memory_accounting.h), and the counters and
+ * histograms of the program when LF_USER_METRICS is defined (see user_metrics.h). A federate also
+ * records the time from sending a NET to the RTI to receiving the TAG that grants it.
+ *
+ * Totals only ever grow, so that rates, such as the reactions per second and the busy ratio
+ * of a worker, are the difference between two readings divided by the time between them.
+ * A reader may see a statistic that is being updated, but not a torn value, on platforms
+ * with 64-bit stores.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#include "environment.h"
+#include "latency.h"
+#include "memory_accounting.h"
+#include "user_metrics.h"
+
+#if defined(LF_METRICS) && !defined(PLATFORM_Linux) && !defined(PLATFORM_Darwin)
+#error "LF_METRICS is only supported on Linux and macOS"
+#endif
+
+/**
+ * The minimum time between two updates of the statistics of the token recycling bins.
+ */
+#ifndef LF_METRICS_PERIOD
+#define LF_METRICS_PERIOD MSEC(100)
+#endif
+
+/** The first field of a metrics block ("LFM4"), which readers check. */
+#define LF_METRICS_MAGIC 0x344d464c
+
+/** The number of workers of each environment that have statistics. Later workers are not counted. */
+#define LF_METRICS_MAX_WORKERS 64
+
+/** The length of the name of an environment in the block, including the terminating null. */
+#define LF_METRICS_NAME_LENGTH 32
+
+/** @brief The statistics of a worker, which fill a cache line. */
+typedef struct lf_metrics_worker_t {
+  int64_t reactions; // Number of reactions invoked.
+  int64_t busy;      // Nanoseconds spent in the bodies of reactions.
+  char padding[64 - 2 * sizeof(int64_t)];
+} lf_metrics_worker_t;
+
+/** @brief The end-to-end latency statistics of a chain of an environment. See lf_latency_chain_t. */
+typedef struct lf_metrics_latency_t {
+  char chain[LF_METRICS_NAME_LENGTH]; // The name of the chain, or empty if this entry is unused.
+  int64_t count;                      // Number of latencies recorded.
+  int64_t total;                      // Their sum in nanoseconds.
+  int64_t max;                        // The largest of them.
+  int64_t buckets[LF_LATENCY_BUCKETS];
+} lf_metrics_latency_t;
+
+/** @brief A counter or histogram of the program. See lf_user_metric_t. */
+typedef struct lf_metrics_user_t {
+  char name[LF_METRICS_NAME_LENGTH]; // The name of the metric, or empty if this entry is unused.
+  int64_t kind;                      // An lf_user_metric_kind_t.
+  int64_t count;                     // Number of updates.
+  int64_t total;                     // Sum of the amounts or values.
+  int64_t max;                       // Largest value of a histogram.
+  int64_t buckets[LF_USER_METRICS_BUCKETS];
+} lf_metrics_user_t;
+
+/** @brief The statistics of an environment. */
+typedef struct lf_metrics_environment_t {
+  char name[LF_METRICS_NAME_LENGTH];
+  int32_t id;
+  int32_t num_workers;
+  int64_t tags;             // Number of tags started.
+  int64_t tag_lag;          // Physical minus logical time at the start of the last tag.
+  int64_t max_tag_lag;      // Largest tag lag.
+  int64_t event_q_size;     // Number of events on the event queue at the start of the last tag.
+  int64_t free_events;      // Number of events in the pool of free events at the start of the last tag.
+  int64_t events_allocated; // Number of events allocated for the pool.
+  int64_t ingress_count;    // Number of staged and pending events of physical actions at the start of the last tag.
+  int64_t ingress_rejected; // Number of events of physical actions rejected because of a capacity.
+  int64_t ingress_shed;     // Number of events of physical actions dropped or coalesced because of a capacity.
+  char padding[128 - 9 * sizeof(int64_t)];
+  lf_metrics_worker_t workers[LF_METRICS_MAX_WORKERS];
+  int64_t latency_time; // Physical time at which the latency statistics were last gathered.
+  lf_metrics_latency_t latency[LF_LATENCY_MAX_CHAINS];
+} lf_metrics_environment_t;
+
+/** @brief The layout of a metrics block. */
+typedef struct lf_metrics_t {
+  uint32_t magic;               // LF_METRICS_MAGIC once the block is initialized.
+  int32_t num_environments;     // Number of entries of environments.
+  int64_t token_bin_size;       // Number of tokens in the recycling bins.
+  int64_t token_hits;           // Number of token allocations served from the recycling bins.
+  int64_t token_misses;         // Number of token allocations that needed calloc().
+  int64_t net_round_trips;      // Number of NETs that were granted by a TAG.
+  int64_t net_round_trip_total; // Sum of the times from sending those NETs to receiving their TAGs.
+  int64_t net_round_trip_last;  // The time for the last of them.
+  int64_t net_round_trip_max;   // The largest time.
+  int64_t memory_time;          // Physical time at which the memory statistics were last gathered, or 0.
+  lf_memory_account_t memory[lf_memory_num_subsystems]; // Indexed by lf_memory_subsystem_t.
+  int64_t user_time;                                    // Physical time at which the user metrics were last gathered.
+  lf_metrics_user_t user[LF_USER_METRICS_MAX];
+  lf_metrics_environment_t environments[];
+} lf_metrics_t;
+
+/**
+ * @brief Create the metrics block of the environments of the program.
+ *
+ * If the block cannot be created, a warning is printed and no statistics are kept.
+ * @param envs The environments.
+ * @param num_envs The number of environments.
+ */
+void lf_metrics_init(environment_t* envs, int num_envs);
+
+/**
+ * @brief Remove the metrics block.
+ */
+void lf_metrics_free(void);
+
+/**
+ * @brief Record the invocation of a reaction body that has just ended.
+ * @param env The environment of the reaction.
+ * @param worker The number of the worker that invoked it.
+ * @param start The physical time at which the invocation started.
+ */
+void lf_metrics_reaction_invoked(environment_t* env, int worker, instant_t start);
+
+/**
+ * @brief Record the start of a tag. This assumes that the caller holds the mutex of the environment.
+ * @param env The environment.
+ */
+void lf_metrics_tag_started(environment_t* env);
+
+/**
+ * @brief Record the receipt of a TAG that grants the last NET sent to the RTI.
+ * Grants of a NET after the first are ignored.
+ * @param net_time The physical time at which the NET was sent.
+ */
+void lf_metrics_net_granted(instant_t net_time);
+
+#endif // METRICS_H
@@ -88,11 +88,26 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  If you increment it 24 times, it will cover all possible value
  (albeit in a strange order because of the permutation) and return
  to the original value with digits 0, 0, 0.
+
+ Code that iterates often over the same nested banks can instead
+ precompute the values of all the numbers once, at startup:
+ ```
+    mixed_radix_table_t* table = mixed_radix_table_new(&x);
+    int position = mixed_radix_table_position_of(table, &x);
+    ...
+    position = mixed_radix_table_incr(table, position);
+    int parent = mixed_radix_table_parent(table, position, 1);
+ ```
+ Each of these calls is then a lookup in a table rather than a loop
+ over the digits.
  */
 
 #ifndef MIXED_RADIX_H
 #define MIXED_RADIX_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 /**
  * Representation of a permuted mixed radix integer.
  * The three arrays (digits, radixes, and permutation) are all
@@ -127,4 +142,69 @@ int mixed_radix_parent(mixed_radix_int_t* mixed, int n);
  */
 int mixed_radix_to_int(mixed_radix_int_t* mixed);
 
+/**
+ * Precomputed values of all the permuted mixed-radix numbers with the same radixes and permutation.
+ * A position is the number of increments from the number whose digits are all zero, which is less
+ * than count, the product of the radixes. For each position and each n less than size, the table
+ * holds the value of the number after dropping the first n digits (@see mixed_radix_parent), and
+ * for each value, the position at which the number has that value. The entries are 16 bits wide
+ * if count is at most 65536, and 32 bits wide otherwise.
+ */
+typedef struct mixed_radix_table_t {
+  int size;         // The number of digits.
+  int count;        // The number of positions, which is also the number of values.
+  uint16_t* narrow; // The size * count values by n and position, then the count positions by value, or NULL.
+  uint32_t* wide;   // The same entries as narrow if narrow is NULL.
+} mixed_radix_table_t;
+
+/**
+ * Create the table of the mixed-radix numbers with the radixes and permutation of the given number.
+ * The digits of the given number do not matter.
+ * @param mixed A pointer to the mixed-radix number.
+ * @return The table, to be freed with mixed_radix_table_free, or NULL if it could not be allocated.
+ */
+mixed_radix_table_t* mixed_radix_table_new(mixed_radix_int_t* mixed);
+
+/**
+ * Free a table created by mixed_radix_table_new.
+ * @param table The table, or NULL.
+ */
+void mixed_radix_table_free(mixed_radix_table_t* table);
+
+/** Return the entry at the given index of the table. */
+static inline int mixed_radix_table_entry(const mixed_radix_table_t* table, size_t index) {
+  return (table->narrow != NULL) ? (int)table->narrow[index] : (int)table->wide[index];
+}
+
+/**
+ * Return the position that follows the given one, which wraps around to 0 after the last one,
+ * as mixed_radix_incr does.
+ */
+static inline int mixed_radix_table_incr(const mixed_radix_table_t* table, int position) {
+  return (position + 1 < table->count) ? position + 1 : 0;
+}
+
+/**
+ * Return the int value at the given position after dropping the first n digits,
+ * as mixed_radix_parent does.
+ */
+static inline int mixed_radix_table_parent(const mixed_radix_table_t* table, int position, int n) {
+  return (n < table->size) ? mixed_radix_table_entry(table, (size_t)n * table->count + position) : 0;
+}
+
+/** Return the int value at the given position, as mixed_radix_to_int does. */
+static inline int mixed_radix_table_to_int(const mixed_radix_table_t* table, int position) {
+  return mixed_radix_table_entry(table, (size_t)position);
+}
+
+/** Return the position at which the int value of the number is the given value. */
+static inline int mixed_radix_table_position(const mixed_radix_table_t* table, int value) {
+  return mixed_radix_table_entry(table, (size_t)table->size * table->count + value);
+}
+
+/** Return the position of the given number, which must have the radixes and permutation of the table. */
+static inline int mixed_radix_table_position_of(const mixed_radix_table_t* table, mixed_radix_int_t* mixed) {
+  return mixed_radix_table_position(table, mixed_radix_to_int(mixed));
+}
+
 #endif /* MIXED_RADIX_H */
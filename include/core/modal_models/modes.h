@@ -84,6 +84,12 @@ typedef struct reactor_mode_state_t reactor_mode_state_t;
  * modes. */
 typedef struct mode_state_variable_reset_data_t mode_state_variable_reset_data_t;
 
+// Bit masks for the internally used flags on modes
+#define _LF_MODE_FLAG_MASK_ACTIVE (1 << 0)
+#define _LF_MODE_FLAG_MASK_NEEDS_STARTUP (1 << 1)
+#define _LF_MODE_FLAG_MASK_HAD_STARTUP (1 << 2)
+#define _LF_MODE_FLAG_MASK_NEEDS_RESET (1 << 3)
+
 /** Type of the mode change. */
 typedef enum { no_transition, reset_transition, history_transition } lf_mode_change_type_t;
 
@@ -93,6 +99,7 @@ struct reactor_mode_t {
   char* name;                  // Name of this mode.
   instant_t deactivation_time; // Time when the mode was left.
   uint8_t flags;               // Bit vector for several internal flags related to the mode.
+  struct _lf_suspended_event* suspended_events; // Suspended events of triggers in this mode.
 };
 
 /** A struct to store state of the modes in a reactor instance and/or its relation to enclosing modes. */
@@ -120,7 +127,21 @@ typedef struct environment_t environment_t;
 void _lf_initialize_modes(environment_t* env);
 void _lf_handle_mode_changes(environment_t* env);
 void _lf_handle_mode_triggered_reactions(environment_t* env);
-bool _lf_mode_is_active(reactor_mode_t* mode);
+
+/**
+ * Return true if the given mode is active.
+ * This includes checking all enclosing modes.
+ * If any of those is inactive, then so is this one.
+ * This uses the activity flag cached in the mode, which accounts for the enclosing
+ * modes and is only recomputed by _lf_initialize_mode_states() and
+ * _lf_process_mode_changes(). See _lf_mode_is_active_fallback() for the uncached check.
+ *
+ * @param mode The mode instance to check.
+ */
+static inline bool _lf_mode_is_active(reactor_mode_t* mode) {
+  return mode == NULL || (mode->flags & _LF_MODE_FLAG_MASK_ACTIVE);
+}
+
 void _lf_initialize_mode_states(environment_t* env, reactor_mode_state_t* states[], int states_size);
 void _lf_process_mode_changes(environment_t* env, reactor_mode_state_t* states[], int states_size,
                               mode_state_variable_reset_data_t reset_data[], int reset_data_size,
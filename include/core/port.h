@@ -78,6 +78,29 @@
  */
 #define LF_SPARSE_CAPACITY_DIVIDER 10
 
+/**
+ * Maximum number of present channels of a sparse input record that are sorted
+ * by insertion. More are sorted using a bitmap.
+ */
+#define LF_SPARSE_INSERTION_SORT_THRESHOLD 16
+
+/**
+ * Maximum width of a multiport for which the present channels of its sparse input
+ * record are sorted using a bitmap on the stack. Wider multiports use qsort().
+ */
+#define LF_SPARSE_BITMAP_MAX_WIDTH 16384
+
+/**
+ * Number of tags over which the overflows of a sparse input record are counted.
+ */
+#define LF_SPARSE_OVERFLOW_WINDOW 64
+
+/**
+ * Number of tags within LF_SPARSE_OVERFLOW_WINDOW at which a sparse input record has to
+ * overflow for its capacity to be doubled.
+ */
+#define LF_SPARSE_OVERFLOWS_TO_GROW 4
+
 /**
  * An iterator over a record of the subset of channels of a multiport that
  * have present inputs.  To use this, create an iterator using the function
@@ -117,5 +140,36 @@ lf_multiport_iterator_t _lf_multiport_iterator_impl(lf_port_base_t** port, int w
  */
 int lf_multiport_next(lf_multiport_iterator_t* iterator);
 
+/**
+ * @brief Record in the bitmap of a sparse input record, if it has one, that `channel` is present.
+ *
+ * Iteration over a multiport whose sparse record overflowed does not need to check every
+ * channel if the record has a bitmap of the present channels, which it gets at the start of the
+ * tag after the first iteration over it once it overflowed. The bitmap is kept up to date at every tag,
+ * including those at which the record does not overflow, and is cleared by
+ * lf_sparse_io_record_start_tag(). In the threaded runtime, the bits are set atomically.
+ * @param record The sparse record.
+ * @param channel The channel that is present.
+ */
+void lf_sparse_io_record_set_present(lf_sparse_io_record_t* record, size_t channel);
+
+/**
+ * @brief Empty a sparse input record at the start of a tag.
+ *
+ * If the record overflowed at LF_SPARSE_OVERFLOWS_TO_GROW of the last LF_SPARSE_OVERFLOW_WINDOW
+ * tags, its capacity is doubled, so that iteration over a multiport whose number of present
+ * channels varies falls back to checking every channel only at the tags where it is large.
+ * This also clears or allocates the bitmap of the present channels of the record.
+ * No reaction may be writing to the multiport.
+ * @param record The sparse record.
+ */
+void lf_sparse_io_record_start_tag(lf_sparse_io_record_t* record);
+
+/**
+ * @brief Free the memory allocated by the runtime for a sparse input record.
+ * @param record The sparse record, which is not freed.
+ */
+void lf_sparse_io_record_free(lf_sparse_io_record_t* record);
+
 #endif /* PORT_H */
 /** @} */
@@ -0,0 +1,114 @@
+/**
+ * @file
+ * @brief Execution-time statistics of reactions, collected by the runtime.
+ *
+ * When LF_REACTION_PROFILE is defined, the runtime measures the physical time that each
+ * invocation of a reaction body takes and, for reactions with a deadline, the slack, which
+ * is the time left until the deadline when the invocation starts. For each reaction, it
+ * keeps the number of invocations, the minimum, mean and maximum time, a histogram from
+ * which percentiles are estimated, the minimum and mean slack, and an exponentially weighted
+ * moving average of the time, which follows changes in the execution time and which the LLF
+ * scheduler uses to order reactions. The statistics are printed on normal termination.
+ *
+ * When LF_REACTION_PROFILE_COUNTERS is also defined, which is supported on Linux only, each
+ * worker opens a group of hardware performance counters, which it reads with one system call
+ * before and after each invocation. For each reaction, the profile then also holds the mean
+ * number of CPU cycles, instructions per cycle, last-level cache misses and branch misses of
+ * its invocations, which tells reactions that are bound by memory or by branch prediction
+ * apart. If the counters are not available, for example in a virtual machine or because of
+ * perf_event_paranoid, a warning is printed and only the times are recorded.
+ *
+ * When LF_REACTION_PROFILE_WRITE is also defined, the statistics of each environment are also
+ * written on normal termination to a file, `<environment name>_profile.csv`, together with the
+ * graph of the reactions, for tools such as util/tracing/enclave_partition. Each line is either
+ * `reaction,index,reactor,number,name,count,mean,p99`, where the reactor is the address of its
+ * self struct, which the object table of a trace file of the same execution also records, or
+ * `edge,from,to,invocations` for a reaction `from` whose outputs trigger the reaction `to`, where
+ * the invocations are those of `from`, which bound the number of messages along the edge. When
+ * LF_LATENCY is also defined, a line `latency,chain,count,mean,p50,p99,max` follows for each chain
+ * whose end-to-end latency has been recorded (see latency.h).
+ *
+ * A reaction is never executed by two workers at once, so its statistics are updated
+ * without any lock. They are kept with the reaction rather than per worker, so that no
+ * merging is needed to print them.
+ */
+
+#ifndef REACTION_PROFILE_H
+#define REACTION_PROFILE_H
+
+#include "lf_types.h"
+#include "environment.h"
+#include "low_level_platform.h"
+
+#if defined(LF_REACTION_PROFILE_COUNTERS) && !defined(PLATFORM_Linux)
+#error "LF_REACTION_PROFILE_COUNTERS is only supported on Linux"
+#endif
+
+/** @brief The measurements taken when an invocation of a reaction body starts. */
+typedef struct lf_reaction_profile_sample_t {
+  instant_t start; // The physical time.
+#ifdef LF_REACTION_PROFILE_COUNTERS
+  bool counted;                        // Whether the counters were read.
+  uint64_t counters[LF_PERF_COUNTERS]; // The hardware counters of the worker.
+#endif
+} lf_reaction_profile_sample_t;
+
+/**
+ * @brief Take the measurements for an invocation of a reaction body that is about to start.
+ * @param sample Where to store the measurements.
+ */
+void lf_reaction_profile_start(lf_reaction_profile_sample_t* sample);
+
+/**
+ * @brief Record an invocation of the body of a reaction that has just ended.
+ *
+ * This is called by the worker that executes the reaction, without holding the mutex of
+ * the environment.
+ * @param env The environment of the reaction.
+ * @param reaction The reaction.
+ * @param sample The measurements taken by lf_reaction_profile_start() when the invocation started.
+ */
+void lf_reaction_profile_record(environment_t* env, reaction_t* reaction, const lf_reaction_profile_sample_t* sample);
+
+/**
+ * @brief Return the estimate of the execution time of the body of a reaction.
+ *
+ * This is the exponentially weighted moving average of the execution times of its invocations,
+ * in which each new invocation has a weight of 2^-LF_REACTION_PROFILE_EWMA_SHIFT (1/8 by default).
+ * It may be called by any thread, while the reaction is executing.
+ * @param reaction The reaction.
+ * @return The estimate, or 0 if the reaction has not been invoked yet.
+ */
+interval_t lf_reaction_profile_estimate(reaction_t* reaction);
+
+/**
+ * @brief Return the number of invocations of the body of a reaction.
+ * @param reaction The reaction.
+ * @return The number of invocations, or 0 if the reaction has not been invoked yet.
+ */
+size_t lf_reaction_profile_count(reaction_t* reaction);
+
+/**
+ * @brief Print the statistics of all reactions of the environment that have been invoked.
+ *
+ * This can be called at any time. If workers are executing reactions, the statistics of
+ * those reactions may be printed in the middle of an update.
+ * @param env The environment.
+ */
+void lf_reaction_profile_print(environment_t* env);
+
+/**
+ * @brief Write the statistics and the graph of the reactions of the environment that have been
+ * invoked to a file, in the format described above. Reactions that have not been invoked are left out.
+ * @param env The environment.
+ * @param path The path of the file.
+ */
+void lf_reaction_profile_write(environment_t* env, const char* path);
+
+/**
+ * @brief Free the statistics of the reactions of the environment.
+ * @param env The environment.
+ */
+void lf_reaction_profile_free(environment_t* env);
+
+#endif // REACTION_PROFILE_H
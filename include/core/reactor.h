@@ -24,6 +24,7 @@
 #include "tag.h"   // Time-related functions.
 #include "clock.h" // Time-related functions.
 #include "tracepoint.h"
+#include "user_metrics.h"
 #include "util.h"
 
 /**
@@ -93,6 +94,11 @@ void lf_request_stop(void);
  * and record the allocated memory on the specified self struct so that
  * it will be freed when calling {@link free_reactor(self_base_t)}.
  *
+ * If LF_ARENA_ALLOCATION is defined, recorded memory is instead carved from large
+ * blocks (of LF_ARENA_BLOCK_SIZE bytes, 64 KiB by default) that are only freed, all at
+ * once, by {@link lf_free_all_reactors()}. Memory that is not recorded is still
+ * allocated with calloc.
+ *
  * @param count The number of items of size 'size' to accomodate.
  * @param size The size of each item.
  * @param head Pointer to the head of a list on which to record
@@ -109,6 +115,10 @@ void* lf_allocate(size_t count, size_t size, struct allocation_record_t** head);
  * termination of the program, use
  * {@link lf_allocate(size_t, size_t, allocation_record_t**)}
  * with a null last argument instead.
+ * If LF_ARENA_ALLOCATION is defined, the reactor is allocated from the arena
+ * (see {@link lf_allocate(size_t, size_t, allocation_record_t**)}), so reactors
+ * created one after another sit next to each other in memory. If LF_ARENA_PLACEMENT is
+ * also defined, they are instead placed as a previous run found best (see arena_placement.h).
  *
  * @param size The size of the self struct, obtained with sizeof().
  */
@@ -44,12 +44,43 @@
  */
 #define MIN_SLEEP_DURATION USEC(10)
 
+/**
+ * Triggered reactions that have a batch function (see reaction_t) are grouped into batches in
+ * the threaded runtime, except with the dataflow scheduler, which needs every reaction that
+ * executes to have been triggered through it, and with LF_TAG_PIPELINING, with which the
+ * reactions of a batch could execute at different tags.
+ */
+#if !defined(LF_SINGLE_THREADED) && !(defined SCHEDULER && SCHEDULER == SCHED_DATAFLOW) && !defined(LF_TAG_PIPELINING)
+#define LF_BATCH_REACTIONS
+#endif
+
+/** The maximum number of reactions in a batch. */
+#ifndef LF_REACTION_BATCH_SIZE
+#define LF_REACTION_BATCH_SIZE 64
+#endif
+
+/**
+ * With LF_PARALLEL_POP=<n>, the threaded runtime handles the events of a tag with the help of the
+ * idle workers when there are at least n of them. The thread that advances the tag takes them off
+ * the event queue at once, then it and the idle workers mark the triggers present and insert the
+ * reactions into the queues of the scheduler, each for a chunk of the events (see
+ * lf_sched_parallel_for()), and finally it reschedules the periodic timers and hands the payloads
+ * to the triggers. Only the NP scheduler lends this work to its idle workers.
+ */
+
 //////////////////////  Global Variables  //////////////////////
 
 // The following variables are defined in reactor_common.c and used in reactor.c,
 // reactor_threaded.c, modes.c, and by the code generator.
 extern bool _lf_normal_termination;
 extern unsigned int _lf_number_of_workers;
+extern const char* _lf_worker_pinning;
+extern const char* _lf_sched_state_file;
+extern const char* _lf_checkpoint_restore_file;
+extern const char* _lf_replay_record_file;
+extern const char* _lf_replay_file;
+extern size_t _lf_memory_lock_budget;
+extern bool _lf_huge_pages;
 extern int default_argc;
 extern const char** default_argv;
 extern instant_t duration;
@@ -92,8 +123,8 @@ void lf_create_environments(void);
 void lf_free(struct allocation_record_t** head);
 
 /**
- * Get a new event. If there is a recycled event available, use that.
- * If not, allocate a new one. In either case, all fields will be zero'ed out.
+ * Get a new event from the free list of the environment. If the free list is empty,
+ * allocate a block of new events first. In either case, all fields will be zero'ed out.
  * @param env Environment in which we are executing.
  */
 event_t* lf_get_new_event(environment_t* env);
@@ -101,12 +132,54 @@ event_t* lf_get_new_event(environment_t* env);
 /**
  * @brief Recycle the given event.
  *
- * This will zero out the event and push it onto the recycle queue.
+ * This will zero out the event and push it onto the free list of the environment.
  * @param env Environment in which we are executing.
  * @param e The event to recycle.
  */
 void lf_recycle_event(environment_t* env, event_t* e);
 
+/**
+ * @brief Put the specified event on the event queue of the environment.
+ *
+ * An event with a trigger is also put on the list of pending events of the trigger,
+ * which is in tag order, so that _lf_find_pending_event() finds it without searching
+ * the event queue. Events with a trigger must be put on the event queue with this
+ * function and taken off it with _lf_forget_pending_event().
+ *
+ * An event at the microstep after the current tag, such as one of a zero-delay logical
+ * action, goes into `next_microstep_events` of the environment instead of `event_q`.
+ * No other event can come before it, so it is taken from there without any heap operation.
+ * Use _lf_peek_next_event() rather than peeking at `event_q` to find the next event.
+ * With modal reactors, all events go into `event_q`, where mode changes look for them.
+ * @param env Environment in which we are executing.
+ * @param e The event.
+ */
+void _lf_enqueue_event(environment_t* env, event_t* e);
+
+/**
+ * @brief Return the event with the smallest tag that is waiting to be processed, or NULL if there is none.
+ * @param env Environment in which we are executing.
+ */
+event_t* _lf_peek_next_event(environment_t* env);
+
+/**
+ * @brief Take an event that has been removed from the event queue off the list of
+ * pending events of its trigger.
+ * @param e The event.
+ */
+void _lf_forget_pending_event(event_t* e);
+
+/**
+ * @brief Return the event for the specified trigger with the specified tag on the event
+ * queue, or NULL if there is none.
+ *
+ * This searches the pending events of the trigger from the one with the largest tag, so it
+ * takes constant time when events are scheduled in tag order, however long the event queue.
+ * @param trigger The trigger.
+ * @param tag The tag.
+ */
+event_t* _lf_find_pending_event(trigger_t* trigger, tag_t tag);
+
 /**
  * Replace the token on the specified event with the specified
  * token and free the old token.
@@ -152,6 +225,12 @@ void _lf_initialize_trigger_objects();
  * This function will be registered to execute on exit.
  * It reports elapsed logical and physical times and reports if any
  * memory allocated for tokens has not been freed.
+ *
+ * If LF_FAST_EXIT is defined in a build with NDEBUG, then on normal termination this only
+ * flushes the traces and reports, and leaves the tokens, reactors and environments to be
+ * reclaimed when the process exits rather than freeing them one by one. The shutdown
+ * reactions have executed before this is called. Builds without NDEBUG still free
+ * everything, so that they can check for leaks.
  */
 void termination(void);
 
@@ -166,9 +245,27 @@ void termination(void);
  */
 void _lf_trigger_reaction(environment_t* env, reaction_t* reaction, int worker_number);
 
+/**
+ * @brief Return true if a queued reaction in the specified environment has an earlier deadline
+ * than the specified reaction and would therefore be executed before it under EDF scheduling.
+ * @param env Environment in which we are executing.
+ * @param reaction The reaction.
+ */
+bool _lf_has_earlier_deadline(environment_t* env, reaction_t* reaction);
+
+/**
+ * @brief Record that the specified reaction has missed its deadline.
+ * The number of misses of each reaction that has missed its deadline is reported on termination.
+ * This should be called without holding the mutex of the environment.
+ * @param env Environment in which we are executing.
+ * @param reaction The reaction.
+ */
+void _lf_record_deadline_miss(environment_t* env, reaction_t* reaction);
+
 /**
  * @brief Initialize the given timer.
- * If this timer has a zero offset, enqueue the reactions it triggers.
+ * If this timer has a zero offset, enqueue the reactions it triggers,
+ * and those of the timers grouped with it (see `next_in_timer_group`).
  * If this timer is to trigger reactions at a _future_ tag as well,
  * schedule it accordingly.
  * @param env Environment in which we are executing.
@@ -178,6 +275,10 @@ void _lf_initialize_timer(environment_t* env, trigger_t* timer);
 
 /**
  * @brief Initialize all the timers in the environment
+ *
+ * Periodic timers that are not in a mode and have the same offset and period are grouped,
+ * and only the first timer of each group has events on the event queue. When such an event
+ * is popped, the reactions of all the timers of the group are triggered.
  * @param env Environment in which we are executing.
  */
 void _lf_initialize_timers(environment_t* env);
@@ -254,7 +355,7 @@ trigger_handle_t _lf_insert_reactions_for_trigger(environment_t* env, trigger_t*
 void _lf_advance_tag(environment_t* env, tag_t next_tag);
 
 /**
- * @brief Pop all events from event_q with tag equal to current tag.
+ * @brief Pop all events from event_q, and from the events at the next microstep, with tag equal to current tag.
  *
  * This will extract all the reactions triggered by these events and stick them onto the
  * reaction queue.
@@ -263,10 +364,76 @@ void _lf_advance_tag(environment_t* env, tag_t next_tag);
  */
 void _lf_pop_events(environment_t* env);
 
+#ifdef LF_TAG_PIPELINING
+/**
+ * @brief Pop the events at the specified tag, which is the next tag, and trigger the reactions of
+ * those that no lagging component handles (see pipeline.h). The others are left on the event queue.
+ * @param env The environment in which we are executing
+ * @param tag The next tag.
+ * @return The number of events popped.
+ */
+size_t _lf_pop_events_ahead(environment_t* env, tag_t tag);
+#endif
+
 void _lf_invoke_reaction(environment_t* env, reaction_t* reaction, int worker);
+
+/**
+ * @brief Invoke the batch function of the given reactions once for all of them.
+ *
+ * The reactions have the same batch function and no reactor mutex.
+ * @param env Environment in which we are executing.
+ * @param reactions The reactions, of which there are at most LF_REACTION_BATCH_SIZE.
+ * @param count The number of reactions.
+ * @param worker The thread number of the worker thread (for tracing).
+ */
+void _lf_invoke_reaction_batch(environment_t* env, reaction_t** reactions, size_t count, int worker);
+
 void schedule_output_reactions(environment_t* env, reaction_t* reaction, int worker);
 int process_args(int argc, const char* argv[]);
 
+/**
+ * @brief If requested by the --lock-memory command-line argument, lock the memory of the
+ * process and prefault a heap of the requested size. This is called after the command-line
+ * arguments are processed, so that the allocations made during startup are served from that heap.
+ */
+void _lf_lock_memory(void);
+
+/**
+ * @brief Record that startup is complete, so that termination can report the page faults
+ * taken afterwards if memory was locked.
+ */
+void _lf_memory_startup_complete(void);
+
+#if !defined(LF_SINGLE_THREADED)
+/**
+ * @brief Take the physical action events staged by lf_schedule_token, lf_schedule_copy and
+ * lf_schedule_value and move them, in the order of the physical times at which they were staged,
+ * to the event queue of the environment. Events that cannot come before the head of the event
+ * queue are kept pending until a later call. The mutex of the environment must be held.
+ */
+void _lf_ingress_drain_locked(environment_t* env);
+
+/**
+ * @brief Stage an event of a physical action as if it had been scheduled at the given physical time.
+ * This does not acquire the mutex of the environment. See _lf_ingress_drain_locked.
+ * @param env The environment.
+ * @param trigger The trigger of the physical action.
+ * @param extra_delay The extra delay of the event.
+ * @param token The payload of the event, or NULL if it has none.
+ * @param time The physical time, which determines the tag of the event.
+ */
+void _lf_ingress_push_at(environment_t* env, trigger_t* trigger, interval_t extra_delay, lf_token_t* token,
+                         instant_t time);
+#endif
+
+#if defined(LF_SINGLE_THREADED)
+/**
+ * @brief Move the events pushed into the rings of physical actions by lf_schedule_isr to the
+ * event queue of the environment. This must be called in a critical section of the environment.
+ */
+void _lf_isr_rings_drain_locked(environment_t* env);
+#endif
+
 /**
  * @brief Initialize global variables and start tracing before calling the `_lf_initialize_trigger_objects` function.
  */
@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @brief Recording of the events of physical actions and their deterministic replay.
+ *
+ * When LF_RECORD_REPLAY is defined, the `--record <file>` command-line argument logs every event
+ * that lf_schedule_token, lf_schedule_copy, lf_schedule_value or lf_schedule_move stages for a
+ * physical action to a compact binary file: the action, the physical time at which the event was
+ * staged relative to the start time, the extra delay and the payload. A later run of the same
+ * program given the `--replay <file>` command-line argument stages the logged events instead,
+ * at the same times relative to its own start time, so that their tags are the same as in the
+ * recorded run. Without `-f`, each event is staged when physical time reaches its time, so the
+ * program runs at the pace of the recorded run. With `-f`, all events are staged before the first
+ * tag and the program runs as fast as it can. Either way, physical actions scheduled by the
+ * program itself during a replay are ignored.
+ *
+ * An action is identified by the order in which its reactor was created with lf_new_reactor()
+ * and by its offset in the self struct, so the log is only valid for the same build of the
+ * program. Payloads must be plain data, that is, have neither a destructor nor a copy
+ * constructor. Events staged before the start time are not recorded.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+
+#include "environment.h"
+
+#if defined(LF_RECORD_REPLAY) && defined(LF_SINGLE_THREADED)
+#error "LF_RECORD_REPLAY is not supported by the single-threaded runtime"
+#endif
+
+/**
+ * @brief Register a reactor created with lf_new_reactor(), so that the actions in its self
+ * struct can be identified in the log.
+ * @param self The self struct of the reactor.
+ * @param self_size The size of the self struct.
+ */
+void _lf_replay_register_reactor(self_base_t* self, size_t self_size);
+
+/**
+ * @brief Log an event staged for a physical action if the `--record` command-line argument was given.
+ * @param action The physical action.
+ * @param time The physical time at which the event was staged.
+ * @param extra_delay The extra delay of the event.
+ * @param token The payload of the event, or NULL if it has none.
+ */
+void _lf_replay_record(lf_action_base_t* action, instant_t time, interval_t extra_delay, lf_token_t* token);
+
+/**
+ * @brief Open the file given by the `--record` or `--replay` command-line argument and, for the
+ * latter, start the thread that stages the logged events.
+ * This is called by every environment once its start time is known. Only the first call has an effect.
+ */
+void _lf_replay_start(void);
+
+/**
+ * @brief Stop the replay thread, if any, close the log and free the registered reactors.
+ */
+void _lf_replay_terminate(void);
+
+#endif // REPLAY_H
@@ -0,0 +1,63 @@
+/**
+ * @file
+ * @brief A report of the time spent in each phase of the startup of the program.
+ *
+ * When LF_STARTUP_REPORT is defined, the runtime measures the physical time spent by the main
+ * thread in each phase of startup, from the creation of the environments until the workers have
+ * been spawned, and prints it once execution starts. The time of a phase excludes the time of
+ * the phases that start within it, so that the creation of the reactors, which usually connects a
+ * federate to the RTI, is reported apart from the federation handshake.
+ *
+ * Code-generated functions can report phases of their own with LF_STARTUP_BEGIN() and
+ * LF_STARTUP_END(), such as lf_startup_connections for the code that connects ports. Otherwise,
+ * the connections are counted with the reactors.
+ */
+
+#ifndef STARTUP_REPORT_H
+#define STARTUP_REPORT_H
+
+/** @brief The phases of startup. */
+typedef enum {
+  lf_startup_environments, // lf_create_environments(), which initializes the environments.
+  lf_startup_reactors,     // _lf_initialize_trigger_objects(), which creates the reactors.
+  lf_startup_connections,  // The code that connects the ports of the reactors.
+  lf_startup_scheduler,    // lf_sched_init().
+  lf_startup_tracing,      // lf_tracing_global_init().
+  lf_startup_federation,   // Connecting to the RTI and the other federates and agreeing on a start time.
+  lf_startup_start_tag,    // Triggering the startup reactions and initializing the timers.
+  lf_startup_workers,      // Spawning the workers.
+  lf_startup_num_phases
+} lf_startup_phase_t;
+
+#ifdef LF_STARTUP_REPORT
+
+/**
+ * @brief Record that the main thread starts the given phase of startup.
+ * @param phase The phase.
+ */
+void lf_startup_begin(lf_startup_phase_t phase);
+
+/**
+ * @brief Record that the main thread ends the given phase of startup, which is the last that began.
+ * @param phase The phase.
+ */
+void lf_startup_end(lf_startup_phase_t phase);
+
+/**
+ * @brief Print the time spent in each phase of startup that was measured, once.
+ */
+void lf_startup_report(void);
+
+#define LF_STARTUP_BEGIN(phase) lf_startup_begin(phase)
+#define LF_STARTUP_END(phase) lf_startup_end(phase)
+#define LF_STARTUP_PRINT() lf_startup_report()
+
+#else
+
+#define LF_STARTUP_BEGIN(phase)
+#define LF_STARTUP_END(phase)
+#define LF_STARTUP_PRINT()
+
+#endif // LF_STARTUP_REPORT
+
+#endif // STARTUP_REPORT_H
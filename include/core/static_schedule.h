@@ -0,0 +1,81 @@
+/**
+ * @file
+ * @brief Precomputed schedule of the periodic timers of an environment.
+ *
+ * When LF_STATIC_SCHEDULE is defined, the periodic timers of an environment are not put on
+ * the event queue one by one. Instead, at startup, the firings of all periodic timers over
+ * one hyperperiod (the least common multiple of their periods) are computed and grouped by
+ * time into slots. A single event on the event queue then stands for the next slot. When it
+ * is popped, the reactions of all the timers in the slot are triggered, and the event is
+ * put back at the time of the following slot.
+ *
+ * This costs one event queue operation per tag with timers instead of one per timer firing.
+ * Everything else (actions, one-shot timers, network messages) goes through the event queue
+ * as usual. If the schedule would be too large (see LF_STATIC_SCHEDULE_MAX_FIRINGS), or if
+ * timers can be suspended by modes, the timers also go through the event queue as usual.
+ */
+
+#ifndef STATIC_SCHEDULE_H
+#define STATIC_SCHEDULE_H
+
+#include <stdbool.h>
+
+#include "lf_types.h"
+#include "environment.h"
+
+/**
+ * The maximum number of timer firings in one hyperperiod for which a static schedule is built.
+ */
+#ifndef LF_STATIC_SCHEDULE_MAX_FIRINGS
+#define LF_STATIC_SCHEDULE_MAX_FIRINGS 4096
+#endif
+
+/**
+ * @brief Build the static schedule of the periodic timers of the environment and trigger
+ * the reactions of those that fire at the current tag.
+ *
+ * This is called at startup, in place of _lf_initialize_timer, for the timers for which
+ * lf_static_schedule_covers returns true afterwards.
+ * @param env The environment.
+ */
+void lf_static_schedule_init(environment_t* env);
+
+/**
+ * @brief Return the times within a hyperperiod at which the periodic timers of the environment fire.
+ *
+ * This does not need the static schedule to have been built. A time-triggered federate (see
+ * LF_TIME_TRIGGERED in federate.h) sends these times to the RTI before the start time is known.
+ * @param env The environment.
+ * @param hyperperiod Where to store the hyperperiod, which is 0 if there are no periodic timers
+ * and -1 if their firings cannot be described by a static schedule.
+ * @param number_of_offsets Where to store the number of times.
+ * @return The distinct times, sorted, relative to the start of a hyperperiod, in memory that the
+ * caller frees, or NULL if the hyperperiod is not positive.
+ */
+interval_t* lf_static_schedule_offsets(environment_t* env, interval_t* hyperperiod, size_t* number_of_offsets);
+
+/**
+ * @brief Return true if the timer is handled by the static schedule of the environment.
+ * @param env The environment.
+ * @param timer A timer of the environment.
+ */
+bool lf_static_schedule_covers(environment_t* env, trigger_t* timer);
+
+/**
+ * @brief If the event stands for a slot of the static schedule, trigger the reactions of
+ * the timers in the slot and put the event back on the event queue for the next slot.
+ *
+ * This is called for each event popped from the event queue.
+ * @param env The environment.
+ * @param event An event popped from the event queue of the environment at the current tag.
+ * @return true if the event has been handled, false if it is an ordinary event.
+ */
+bool lf_static_schedule_handle_event(environment_t* env, event_t* event);
+
+/**
+ * @brief Free the static schedule of the environment, if any.
+ * @param env The environment.
+ */
+void lf_static_schedule_free(environment_t* env);
+
+#endif // STATIC_SCHEDULE_H
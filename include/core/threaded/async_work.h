@@ -0,0 +1,76 @@
+/**
+ * @file
+ * @copyright (c) 2024, The University of California at Berkeley.
+ * License: <a href="https://github.com/lf-lang/reactor-c/blob/main/LICENSE.md">BSD 2-clause</a>
+ * @brief Work that reactions start and that finishes in a reaction to a physical action.
+ *
+ * A reaction that calls blocking I/O or a long computation holds its worker for the whole call,
+ * which stalls the other reactions at its level when workers are few. Instead, the reaction can
+ * start the call with lf_async_start() and return. The call runs in a thread of a pool managed by
+ * the runtime and, when it returns, its result is scheduled on a physical action, so that a
+ * reaction to the action continues with the result at a tag determined by the physical time at
+ * which the call finished. The reaction that starts the work and the one that continues it are the
+ * two halves of one logical operation, whose state is kept in the argument of the work, the
+ * result or the reactor.
+ *
+ * The pool has up to LF_ASYNC_WORKERS threads (4 by default), which are started as work arrives.
+ * Work that arrives while all of them are busy waits in order.
+ */
+
+#ifndef ASYNC_WORK_H
+#define ASYNC_WORK_H 1
+
+#include "lf_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Function that does the work started with lf_async_start(). It runs in a thread of the pool,
+ * not in a reaction, so it must not access the ports, actions or state of reactors except
+ * through lf_schedule functions on physical actions.
+ * @param arg The argument given to lf_async_start().
+ * @return A value allocated with malloc, with the size of the payload of the action, that becomes
+ * the payload of the event of the action, or NULL for an event without a payload.
+ */
+typedef void* (*lf_async_work_t)(void* arg);
+
+/**
+ * @brief Start work in a thread of the pool of the runtime whose result triggers a physical action.
+ *
+ * When `work` returns, its result is scheduled on `action` as with lf_schedule_value() with no
+ * extra delay, so that the action is present at a tag after the physical time at which the work
+ * finished. Work that has not finished when the program terminates is waited for, if it has
+ * started, or else dropped, and its result is not scheduled but freed. Work that may block
+ * forever should therefore have a timeout.
+ *
+ * @param action The physical action to trigger (a pointer to an `lf_action_base_t`).
+ * @param work The function that does the work.
+ * @param arg The argument to pass to `work`, which must remain valid until it has returned.
+ * @return 0 on success, or -1 if the action is not physical or the program is terminating.
+ */
+int lf_async_start(void* action, lf_async_work_t work, void* arg);
+
+///////////////////// Internal functions /////////////////////
+// The following functions are internal to the runtime and should not be documented by Doxygen.
+/// \cond INTERNAL  // Doxygen conditional.
+
+/**
+ * Initialize the pool without starting its threads. This is called once at startup, before the workers start.
+ */
+void _lf_async_work_initialize(void);
+
+/**
+ * Drop the work that has not started, wait for the work that has, and stop the threads of the pool.
+ * This is called once at termination, before the environments are freed.
+ */
+void _lf_async_work_terminate(void);
+
+/// \endcond // INTERNAL
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
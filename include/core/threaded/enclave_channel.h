@@ -0,0 +1,103 @@
+/**
+ * @file
+ * @brief Declarations for channels that carry messages between environments.
+ *
+ * A channel carries the messages of one connection from a reactor in one environment (such as
+ * a scheduling enclave) to a trigger in another. The sending reactions append (tag, token)
+ * messages to a ring without taking the mutex of the destination, and the destination moves
+ * them to its event queue when it looks for its next event. Reactions that write the same
+ * connection never execute in parallel, so each channel has a single producer.
+ */
+
+#ifndef ENCLAVE_CHANNEL_H
+#define ENCLAVE_CHANNEL_H
+
+#include "lf_types.h"
+#include "environment.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** A message on a channel. */
+typedef struct lf_enclave_message_t {
+  tag_t tag;
+  lf_token_t* token; // The payload, of which the channel holds a reference, or NULL.
+} lf_enclave_message_t;
+
+/**
+ * @brief A single-producer, single-consumer ring of messages into the event queue of an environment.
+ * The indices of the producer and the consumer are on separate cache lines.
+ */
+typedef struct lf_enclave_channel_t {
+  int64_t tail; // Number of messages sent. Only accessed by the producer.
+  char tail_padding[64 - sizeof(int64_t)];
+  int64_t head; // Number of messages moved to the event queue. Written by the consumer.
+  char head_padding[64 - sizeof(int64_t)];
+  int32_t pending; // Number of messages sent and not yet moved. The producer notifies when it was 0.
+  size_t capacity; // A power of two.
+  lf_enclave_message_t* messages;
+  environment_t* source;
+  environment_t* destination;
+  trigger_t* trigger;
+  struct lf_enclave_channel_t* next; // Next channel into the destination.
+} lf_enclave_channel_t;
+
+/**
+ * @brief Create a channel from the specified environment to a trigger in another.
+ * This must be done before execution starts. The channel is freed with the destination.
+ * @param source The environment of the sending reactor.
+ * @param destination The environment of the trigger.
+ * @param trigger The trigger of the messages.
+ * @param capacity The number of messages that the ring holds, which is rounded up to a
+ *  power of two. Messages beyond it are scheduled directly, under the mutex of the destination.
+ * @return The channel.
+ */
+lf_enclave_channel_t* lf_enclave_channel_create(environment_t* source, environment_t* destination,
+                                                trigger_t* trigger, size_t capacity);
+
+/**
+ * @brief Send a message on the specified channel, to be scheduled at the specified tag in
+ * the destination. The tags of the messages on a channel must not decrease.
+ *
+ * The mutex of the destination is only taken if the channel was empty, in which case the
+ * destination is notified (and, with scheduling enclaves, its next event tag is lowered in
+ * the local RTI), or if the channel is full.
+ *
+ * @param channel The channel.
+ * @param tag The tag of the message.
+ * @param token The payload, or NULL. The channel takes a reference to it.
+ */
+void lf_enclave_channel_send(lf_enclave_channel_t* channel, tag_t tag, lf_token_t* token);
+
+/**
+ * @brief Send the same message on each of the specified channels, such as those of a fan-out
+ * to a bank of reactors in other environments.
+ * The token is broadcast (see lf_token_broadcast): its reference count is incremented once for
+ * all channels, and each destination releases its reference with a single atomic decrement.
+ * Destinations must therefore not modify the payload without lf_writable_copy.
+ * @param channels The channels.
+ * @param count The number of channels.
+ * @param tag The tag of the message.
+ * @param token The payload, or NULL.
+ */
+void lf_enclave_channel_broadcast(lf_enclave_channel_t** channels, size_t count, tag_t tag, lf_token_t* token);
+
+/**
+ * @brief Move the messages on the channels into the specified environment to its event queue.
+ * The mutex of the environment must be held.
+ * @param env The environment.
+ */
+void _lf_enclave_channels_drain_locked(environment_t* env);
+
+/**
+ * @brief Free the channels into the specified environment, with the messages still on them.
+ * @param env The environment.
+ */
+void _lf_enclave_channels_free(environment_t* env);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ENCLAVE_CHANNEL_H
@@ -0,0 +1,188 @@
+/**
+ * @file
+ * @brief Overlap of consecutive tags in reactors that do not depend on each other.
+ *
+ * When LF_TAG_PIPELINING is defined, the NP scheduler may start the next tag before the current
+ * one is complete, for the reactors that are proven independent of the work that remains at the
+ * current tag. The reactors of an environment are partitioned into components: two reactors are
+ * in the same component if a reaction of one may trigger a reaction of the other, through the
+ * outputs that it may set (its `triggers`), or if they are declared dependent with
+ * lf_pipeline_depend(). Reactions only affect other components through the logical time, which
+ * is shared, so a component in which no reaction is queued at the current tag is done with it.
+ *
+ * The components are found by exploring the reaction graph from the reactions that are
+ * triggered: those of the events that are popped and the startup, shutdown and reset reactions
+ * and the reactions of the timers. Until the exploration has reached as many reactions as the
+ * levels of the scheduler count, which may never happen for reactions that are only triggered
+ * by a physical action, no tag is overlapped. The generated code can add those reactions with
+ * lf_pipeline_add_reaction().
+ *
+ * When the scheduler is done with a level and reactions remain queued at the current tag at
+ * later levels, it looks at the next tag. If that tag is not the stop tag, does not have to be
+ * waited for in physical time and no barrier holds the tag back, the components of the queued
+ * reactions are marked lagging, and the events of the next tag that only trigger reactions of
+ * other components are popped and their reactions are triggered, to execute with the remaining
+ * ones. The reactions of lagging components see the current tag, the others the next one (see
+ * lf_pipeline_tag()). The other events of the next tag stay on the event queue, and everything
+ * else falls back to the ordinary advancement of the tag once the current tag is complete: a
+ * component only starts a tag once it is done with the previous one, and a single tag is
+ * overlapped at a time.
+ *
+ * The reactions execute as without the overlap, except that:
+ * - a stop requested while a tag is overlapped takes effect after that tag, as a stop requested
+ *   in one enclave takes effect after the latest tag of all enclaves;
+ * - the trace records the reactions executed ahead at the current tag.
+ *
+ * A reaction that reads a port that does not trigger it, or otherwise shares state with a
+ * reactor that is not in its component, must be declared dependent on that reactor. The mode is
+ * not supported with environments that have watchdogs or sparse multiports, in which case tags
+ * are never overlapped, and not with the features rejected below.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "lf_types.h"
+#include "low_level_platform.h"
+#include "environment.h"
+
+#if defined(LF_SINGLE_THREADED) || defined(FEDERATED) || defined(LF_ENCLAVES) || defined(MODAL_REACTORS)
+#error "LF_TAG_PIPELINING is not supported for single-threaded or federated programs, enclaves or modal reactors"
+#endif
+#if defined(LF_STATIC_SCHEDULE) || defined(LF_CHECKPOINT)
+#error "LF_TAG_PIPELINING is not supported with LF_STATIC_SCHEDULE or LF_CHECKPOINT"
+#endif
+#if defined(SCHEDULER) && SCHEDULER != SCHED_NP
+#error "LF_TAG_PIPELINING requires the NP scheduler"
+#endif
+
+/** The components of the reactors of an environment and the tag that they overlap. */
+typedef struct lf_pipeline_t {
+  size_t reactions;  // Number of reactions of the environment, or 0 if unknown.
+  size_t explored;   // Number of reactions whose component is known.
+  bool seeded;       // Whether the startup, shutdown and reset reactions and the timers were explored.
+  bool complete;     // Whether all the reactions were explored.
+  vector_t found;    // The reactions explored.
+  vector_t frontier; // The reactions to explore.
+  uint64_t epoch;    // Incremented for each tag started ahead. The roots of lagging components hold it.
+  tag_t next_tag;    // The tag that _lf_pipeline_begin_locked() found.
+  tag_t tag;         // The latest tag started ahead, or NEVER_TAG.
+  bool overlap;      // Whether the reactions of components that do not lag execute at `tag`.
+  size_t overlapped; // Number of tags started ahead.
+} lf_pipeline_t;
+
+/**
+ * @brief Give the number of reactions of the environment, which the scheduler counts from its levels.
+ * @param env The environment.
+ * @param reactions The number of reactions.
+ */
+void lf_pipeline_init(environment_t* env, size_t reactions);
+
+/**
+ * @brief Free the components of the environment.
+ * @param env The environment.
+ */
+void lf_pipeline_free(environment_t* env);
+
+/**
+ * @brief Add the specified reaction, and those that it may trigger, to the components of its
+ * environment. This must be done before execution starts or with the mutex held.
+ * @param env The environment.
+ * @param reaction The reaction.
+ */
+void lf_pipeline_add_reaction(environment_t* env, reaction_t* reaction);
+
+/**
+ * @brief Declare that the reactions of one reactor depend on the state of another, such as a port
+ * that they read without being triggered by it. This must be done before execution starts.
+ * @param reactor The reactor.
+ * @param other The reactor it depends on.
+ */
+void lf_pipeline_depend(self_base_t* reactor, self_base_t* other);
+
+/**
+ * @brief Add the reactions of the specified trigger, and of the timers grouped with it, to the
+ * components of the environment. The mutex must be held.
+ * @param env The environment.
+ * @param trigger The trigger of a popped event, or NULL.
+ */
+void _lf_pipeline_explore_trigger_locked(environment_t* env, trigger_t* trigger);
+
+/**
+ * @brief Return whether the next tag can be started ahead, and if so, start marking the lagging
+ * components with _lf_pipeline_lag(). The mutex must be held and all workers must be idle.
+ * @param env The environment.
+ */
+bool _lf_pipeline_begin_locked(environment_t* env);
+
+/**
+ * @brief Mark the component of a reaction that is queued at the current tag as lagging.
+ * @param env The environment.
+ * @param reaction The reaction.
+ */
+void _lf_pipeline_lag(environment_t* env, reaction_t* reaction);
+
+/**
+ * @brief Trigger the reactions of the events at the next tag that do not trigger reactions of
+ * lagging components, and reset the ports of the other components.
+ * The mutex must be held and all workers must be idle.
+ * @param env The environment.
+ * @return Whether any reaction was triggered, in which case the next tag is overlapped.
+ */
+bool _lf_pipeline_start_locked(environment_t* env);
+
+/**
+ * @brief Return whether the specified event at the next tag triggers no reaction of a lagging
+ * component, so that it can be handled ahead.
+ * @param env The environment.
+ * @param event The event.
+ */
+bool _lf_pipeline_event_is_ahead(environment_t* env, event_t* event);
+
+/**
+ * @brief End the overlap of the tags, which happens when the current tag is complete.
+ * The mutex must be held.
+ * @param env The environment.
+ */
+void _lf_pipeline_tag_completed_locked(environment_t* env);
+
+/**
+ * @brief Set the tag of the reactions that the calling worker executes to that of the specified
+ * reaction, which is the overlapped tag if the reaction is in a component that does not lag.
+ * @param env The environment.
+ * @param reaction The reaction.
+ */
+void _lf_pipeline_reaction_starts(environment_t* env, reaction_t* reaction);
+
+/** @brief Set the tag of the reactions that the calling worker executes back to the current tag. */
+void _lf_pipeline_reaction_ends(void);
+
+/**
+ * The tag of the reaction that the calling thread executes, or NEVER_TAG if it is the current
+ * tag of the environment. Defined in tag.c, so that lf_tag() does not depend on the scheduler.
+ */
+extern thread_local tag_t _lf_pipeline_reaction_tag;
+
+/**
+ * @brief Return the tag of the reaction that the calling thread executes, or the current tag of
+ * the environment. See lf_tag().
+ * @param env The environment.
+ */
+static inline tag_t lf_pipeline_tag(environment_t* env) {
+  return (_lf_pipeline_reaction_tag.time == NEVER) ? env->current_tag : _lf_pipeline_reaction_tag;
+}
+
+/**
+ * @brief Return the latest tag that reactions of the environment have started, which is later
+ * than the current tag while a tag is overlapped or until the current tag reaches it.
+ * @param env The environment.
+ */
+static inline tag_t lf_pipeline_latest_tag(environment_t* env) {
+  lf_pipeline_t* pipeline = env->pipeline;
+  if (pipeline != NULL && lf_tag_compare(pipeline->tag, env->current_tag) > 0) {
+    return pipeline->tag;
+  }
+  return env->current_tag;
+}
+
+#endif // PIPELINE_H
@@ -12,6 +12,49 @@
 
 #include "lf_types.h"
 
+/**
+ * If 1, the workers run with the real-time LF_SCHED_PRIORITY policy, and before invoking a reaction,
+ * a worker sets its priority from the slack that the deadline of the reaction leaves, so that the
+ * operating system preempts the reactions with the least slack last. This requires the privilege
+ * to use real-time policies (CAP_SYS_NICE on Linux). Without it, the priorities are left unchanged.
+ */
+#ifndef LF_DEADLINE_PRIORITIES
+#define LF_DEADLINE_PRIORITIES 0
+#endif
+
+/**
+ * Reactions whose deadline leaves more than this slack after the last time that their worker
+ * read the physical clock at the current tag are taken to meet the deadline without reading the
+ * clock again. The default, FOREVER, reads the clock before every reaction with a deadline.
+ */
+#ifndef LF_DEADLINE_EXACT_SLACK
+#define LF_DEADLINE_EXACT_SLACK FOREVER
+#endif
+
+/**
+ * The period at which an idle worker polls for work with LF_SHARED_WORKERS.
+ */
+#ifndef LF_SHARED_WORKERS_POLL
+#define LF_SHARED_WORKERS_POLL USEC(100)
+#endif
+
+/**
+ * @brief Execute a reaction lent by another environment than `env`, if one has a reaction ready.
+ *
+ * With LF_SHARED_WORKERS, a worker with no work in its own environment executes reactions that
+ * are ready at the current level of other environments (enclaves) before it waits for work, so
+ * that the workers of a lightly loaded enclave help a busy one. An environment lends reactions
+ * only while its level is not advancing, and its level does not advance while a reaction that it
+ * lent is executing, so the tags of each enclave are processed as without lending. Only the NP
+ * scheduler lends reactions, and not in federated programs. An idle worker then polls the other
+ * environments and its own for work every LF_SHARED_WORKERS_POLL rather than blocking.
+ *
+ * The environments are tried in turn, starting after the one that lent the last reaction to the calling thread.
+ * @param env The environment of the calling worker.
+ * @return Whether a reaction was executed.
+ */
+bool _lf_worker_execute_lent_reaction(environment_t* env);
+
 /**
  * Enqueue port absent reactions that will send a PORT_ABSENT
  * message to downstream federates if a given network output port is not present.
@@ -80,8 +123,50 @@ void _lf_decrement_tag_barrier_locked(environment_t* env);
 
 int _lf_wait_on_tag_barrier(environment_t* env, tag_t proposed_tag);
 void lf_synchronize_with_other_federates(void);
-bool wait_until(instant_t logical_time_ns, lf_cond_t* condition);
+bool wait_until(environment_t* env, instant_t logical_time_ns);
+
+/**
+ * Notify the threads waiting on event_q_changed of the environment that the event queue
+ * may have changed. This also interrupts a wait_until that is spinning on the clock.
+ *
+ * This function assumes that the caller already holds the mutex lock on env.
+ *
+ * @param env The environment in which we are executing.
+ * @param broadcast Whether to wake up all waiting threads rather than one.
+ * @return 0 on success, platform-specific error number otherwise.
+ */
+int _lf_notify_event_q_changed_locked(environment_t* env, bool broadcast);
 tag_t get_next_event_tag(environment_t* env);
 tag_t send_next_event_tag(environment_t* env, tag_t tag, bool wait_for_reply);
+
+/**
+ * @brief Advance the current tag of the environment to the tag of its next event, waiting for
+ * physical time and, with enclaves or federation, for a grant if necessary.
+ *
+ * This is called by the scheduler when every reaction of the current tag has completed. With
+ * LF_TAG_PIPELINING, the reactors that do not depend on the reactions that remain at the current
+ * tag may have started the next tag before then (see pipeline.h), and the others start it here.
+ * Stages of a pipeline that are connected can also be put in separate enclaves, which advance
+ * their tags independently as far as their connections allow, and with LF_SHARED_WORKERS share
+ * their workers.
+ * This assumes that the caller holds the mutex of the environment.
+ * @param env The environment.
+ */
 void _lf_next_locked(environment_t* env);
+#ifdef _PYTHON_TARGET_ENABLED
+/**
+ * @brief Acquire the GIL for the calling worker, which may already hold it.
+ * This is defined by the Python target.
+ * @return The state to pass to _lf_python_gil_release.
+ */
+int _lf_python_gil_ensure(void);
+
+/**
+ * @brief Release the GIL acquired by the matching call of _lf_python_gil_ensure.
+ * This is defined by the Python target.
+ * @param state The value returned by _lf_python_gil_ensure.
+ */
+void _lf_python_gil_release(int state);
+#endif // _PYTHON_TARGET_ENABLED
+
 #endif // REACTOR_THREADED_H
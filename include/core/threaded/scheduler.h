@@ -84,4 +84,57 @@ void lf_sched_done_with_reaction(size_t worker_number, reaction_t* done_reaction
  */
 void lf_scheduler_trigger_reaction(lf_scheduler_t* scheduler, reaction_t* reaction, int worker_number);
 
+/**
+ * @brief Return true if the scheduler has queued a reaction with an earlier deadline than 'reaction'.
+ *
+ * A worker uses this to decide whether it may execute 'reaction' immediately, bypassing the
+ * scheduler, without violating earliest-deadline-first order. Schedulers that do not order
+ * reactions by deadline always return false.
+ * This function assumes that the environment mutex is not locked.
+ *
+ * @param scheduler The scheduler
+ * @param reaction The reaction that the calling worker would like to execute now.
+ */
+bool lf_sched_has_earlier_deadline(lf_scheduler_t* scheduler, reaction_t* reaction);
+
+/**
+ * @brief Lend a reaction that is ready at the current level to a worker of another environment.
+ *
+ * The level does not advance until the reaction is returned with lf_sched_done_with_lent_reaction.
+ * This never blocks. Schedulers that do not lend reactions always return NULL.
+ *
+ * @param scheduler The scheduler
+ * @return A reaction for the worker of another environment to execute, or NULL if none is ready.
+ */
+reaction_t* lf_sched_lend_reaction(lf_scheduler_t* scheduler);
+
+/**
+ * @brief Inform the scheduler that a reaction it lent is done, after lf_sched_done_with_reaction.
+ *
+ * @param scheduler The scheduler
+ * @param done_reaction The reaction that is done.
+ */
+void lf_sched_done_with_lent_reaction(lf_scheduler_t* scheduler, reaction_t* done_reaction);
+
+/**
+ * @brief The body of a loop run by lf_sched_parallel_for(), which handles the items from `begin` to `end`.
+ * @param arg The argument given to lf_sched_parallel_for().
+ */
+typedef void (*lf_sched_loop_body_t)(void* arg, size_t begin, size_t end);
+
+/**
+ * @brief Run a loop over `count` items with the help of the idle workers.
+ *
+ * The items are split into chunks that the calling thread and the idle workers handle at the same
+ * time, so the body must be safe to run on distinct chunks at once. This returns once every item
+ * has been handled. It is called by the thread that advances the tag, while the other workers are
+ * idle. Schedulers that do not lend work to their idle workers run the loop on the calling thread.
+ *
+ * @param scheduler The scheduler
+ * @param count The number of items.
+ * @param body The body of the loop.
+ * @param arg The argument to pass to `body`.
+ */
+void lf_sched_parallel_for(lf_scheduler_t* scheduler, size_t count, lf_sched_loop_body_t body, void* arg);
+
 #endif // LF_SCHEDULER_H
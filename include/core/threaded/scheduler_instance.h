@@ -18,9 +18,18 @@
 
 #include <stdbool.h>
 #include <stddef.h> // for size_t
+#include <stdint.h>
 
 #define DEFAULT_MAX_REACTION_LEVEL 100
 
+/**
+ * The default number of times an idle worker polls for work before blocking.
+ * See `idle_spin_budget` in `lf_scheduler_t`.
+ */
+#ifndef LF_SCHED_IDLE_SPIN_BUDGET
+#define LF_SCHED_IDLE_SPIN_BUDGET 0
+#endif
+
 // Forward declarations
 typedef struct environment_t environment_t;
 typedef struct custom_scheduler_data_t custom_scheduler_data_t;
@@ -68,10 +77,27 @@ typedef struct lf_scheduler_t {
    */
   volatile size_t number_of_idle_workers;
 
+  /**
+   * @brief Number of times an idle worker polls for work, pausing between polls,
+   * before it yields the processor and finally blocks.
+   * A value of 0 makes idle workers block right away.
+   * This can be changed at any time with `lf_sched_set_idle_spin_budget`.
+   * It is currently used only by the NP scheduler.
+   */
+  volatile size_t idle_spin_budget;
+
   // Pointer to an optional custom data structure that each scheduler can define.
   // The type is forward declared here and must be declared again in the scheduler source file
   // Is not touched by `init_sched_instance` and must be initialized by each scheduler that needs it
   custom_scheduler_data_t* custom_data;
+
+#ifdef LF_MEMORY_ACCOUNTING
+  /**
+   * @brief Bytes of the queues of the scheduler, which the scheduler counts as it allocates them
+   * so that lf_sched_free() can count them as freed.
+   */
+  size_t memory_size;
+#endif
 } lf_scheduler_t;
 
 /**
@@ -88,10 +114,13 @@ typedef struct lf_scheduler_t {
  * `num_reactions_per_level` array if it is not NULL. If set, it should be the
  * maximum level over all reactions in the program plus 1. If not set,
  * `DEFAULT_MAX_REACTION_LEVEL` will be used.
+ * @param idle_spin_budget Optional. The initial value of the scheduler's
+ * `idle_spin_budget`. If 0, `LF_SCHED_IDLE_SPIN_BUDGET` will be used.
  */
 typedef struct {
   size_t* num_reactions_per_level;
   size_t num_reactions_per_level_size;
+  size_t idle_spin_budget;
 } sched_params_t;
 
 /**
@@ -110,4 +139,43 @@ typedef struct {
 bool init_sched_instance(struct environment_t* env, lf_scheduler_t** instance, size_t number_of_workers,
                          sched_params_t* params);
 
+/**
+ * @brief Set the number of times an idle worker of the scheduler polls for work before blocking.
+ *
+ * Larger values reduce the latency of waking up workers at the cost of CPU time.
+ * This can be called at any time, including while workers are running.
+ *
+ * @param scheduler The scheduler.
+ * @param budget The new spin budget. 0 makes idle workers block right away.
+ */
+void lf_sched_set_idle_spin_budget(lf_scheduler_t* scheduler, size_t budget);
+
+/**
+ * @brief Return a bitmap of `num_levels` reaction levels, none of which is set.
+ *
+ * Schedulers mark the levels at which reactions have been triggered in such a bitmap
+ * so that they can skip the empty levels a word at a time. Free it with `free`.
+ */
+uint64_t* lf_sched_level_bitmap_new(size_t num_levels);
+
+/**
+ * @brief Set `level` in `bitmap`.
+ *
+ * This may be called by several threads at once, and while another thread clears other levels.
+ */
+void lf_sched_level_bitmap_set(volatile uint64_t* bitmap, size_t level);
+
+/**
+ * @brief Clear `level` in `bitmap`.
+ *
+ * This may be called while other threads set other levels.
+ */
+void lf_sched_level_bitmap_clear(volatile uint64_t* bitmap, size_t level);
+
+/**
+ * @brief Return the lowest level that is set in `bitmap`, is at least `level`, and is less than `limit`,
+ * or `limit` if there is none.
+ */
+size_t lf_sched_level_bitmap_next(volatile uint64_t* bitmap, size_t level, size_t limit);
+
 #endif // LF_SCHEDULER_PARAMS_H
@@ -12,7 +12,7 @@
 
 #include "lf_types.h"
 #include "environment.h"
-#include "platform.h" // For lf_thread_t.
+#include "timer_wheel.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -31,11 +31,11 @@ typedef struct watchdog_t {
   trigger_t* trigger;                    // The trigger associated with this watchdog.
   instant_t expiration;                  // The expiration instant for the watchdog. (Initialized to NEVER)
   interval_t min_expiration;             // The minimum expiration interval for the watchdog.
-  lf_thread_t thread_id;                 // The thread that the watchdog is meant to run on.
-  lf_cond_t cond;                        // Condition variable used for sleeping and termination.
-  bool active;                           // Boolean indicating whether or not thread is active.
-  bool terminate;                        // Boolean indicating whether termination of the thread has been requested.
+  bool active;                           // Whether the watchdog is started and has not expired or been stopped.
+  bool terminate;                        // Whether termination of the watchdog has been requested.
   watchdog_function_t watchdog_function; // The function/handler for the watchdog.
+  timer_wheel_entry_t entry;             // The entry of the watchdog in the timer wheel of the watchdog thread.
+  instant_t armed;                       // The expiration of the entry, or NEVER if it is not in the wheel.
 } watchdog_t;
 
 /**
@@ -43,9 +43,10 @@ typedef struct watchdog_t {
  *
  * This function sets the expiration time of the watchdog to the current logical time
  * plus the minimum timeout of the watchdog plus the specified `additional_timeout`.
- * This function assumes the reactor mutex is held when it is called; this assumption
+ * This function assumes the reactor is taken when it is called; this assumption
  * is satisfied whenever this function is called from within a reaction that declares
- * the watchdog as an effect.
+ * the watchdog as an effect. Restarting a watchdog that is already started with an
+ * expiration that is not earlier takes no lock and does not wake up the watchdog thread.
  *
  * @param watchdog The watchdog to be started
  * @param additional_timeout Additional timeout to be added to the watchdog's
@@ -66,7 +67,16 @@ void lf_watchdog_stop(watchdog_t* watchdog);
 /// \cond INTERNAL  // Doxygen conditional.
 
 /**
- * Function to initialize mutexes for watchdogs
+ * Take a reactor with watchdogs, so that none of its reactions and none of the handlers of
+ * its watchdogs run at the same time. This is a single compare-and-swap unless a handler is running.
+ */
+void _lf_reactor_lock(struct self_base_t* base);
+
+/** Release a reactor taken with _lf_reactor_lock. */
+void _lf_reactor_unlock(struct self_base_t* base);
+
+/**
+ * Function to initialize watchdogs
  */
 void _lf_initialize_watchdogs(environment_t* env);
 
@@ -87,6 +87,17 @@ void call_tracepoint(int event_type, void* reactor, tag_t tag, int worker, int s
  */
 int _lf_register_trace_event(void* pointer1, void* pointer2, _lf_trace_object_t type, char* description);
 
+#if defined(LF_MINIMAL_FOOTPRINT)
+/**
+ * With LF_MINIMAL_FOOTPRINT defined, the descriptions that generated code passes are
+ * dropped before they reach the binary, and objects are identified in the trace file
+ * by their index in the object table, which is the order in which they are registered.
+ * Tracing tools take their names from an offline name table (see util/tracing/README.md).
+ */
+#define _lf_register_trace_event(pointer1, pointer2, type, description)                                                \
+  (_lf_register_trace_event)(pointer1, pointer2, type, NULL)
+#endif
+
 /**
  * Register a user trace event. This should be called once, providing a pointer to a string
  * that describes a phenomenon being traced. Use the same pointer as the first argument to
@@ -96,6 +107,52 @@ int _lf_register_trace_event(void* pointer1, void* pointer2, _lf_trace_object_t
  */
 int register_user_trace_event(void* self, char* description);
 
+/**
+ * Events that are not traced, one bit per trace_event_t. Set with _lf_trace_set_events().
+ */
+extern uint64_t _lf_trace_disabled_events[(NUM_EVENT_TYPES + 63) / 64];
+
+/**
+ * Whether events of the specified type are traced. For a constant event type,
+ * this is a single load and test.
+ */
+#define _lf_trace_event_enabled(event_type)                                                                            \
+  (!((_lf_trace_disabled_events[(event_type) >> 6] >> ((event_type) & 63)) & 1))
+
+/**
+ * @brief Select the traced events from a comma-separated list of groups, which are
+ * reactions, deadlines, schedule, user, workers, scheduler, locks, federated, all and none.
+ * A group prefixed with '-' is removed. If the list starts with such a group, the others
+ * are kept; otherwise, only the listed groups are traced.
+ * @param spec The list, as given to --trace-events.
+ * @return 1 if the list is valid, 0 otherwise.
+ */
+int _lf_trace_set_events(const char* spec);
+
+/**
+ * @brief Restrict the tracing of reactions to those of the reactors in a comma-separated
+ * list of full names, such as "Main.a", which also covers the reactors that Main.a contains.
+ * A name followed by a reaction number, such as "Main.a.2", selects one reaction.
+ * The names are matched when the reactors are registered, which must be after this call.
+ * @param spec The list, as given to --trace-filter. It must remain valid.
+ */
+void _lf_trace_set_filter(const char* spec);
+
+/**
+ * @brief Trace one in every specified number of invocations of each reactor's reactions.
+ * @param period The sampling period, which is at least 1.
+ */
+void _lf_trace_set_sample_period(int period);
+
+/**
+ * @brief Return whether the start or end of an invocation of the specified reaction is
+ * traced, given the filter and the sampling period. This must be called for the start
+ * before the end of each invocation.
+ * @param reaction The reaction.
+ * @param starts True for the start of the invocation, false for its end.
+ */
+bool _lf_trace_reaction_selected(reaction_t* reaction, bool starts);
+
 /**
  * Trace the start of a reaction execution.
  * @param env The environment in which we are executing
@@ -103,8 +160,11 @@ int register_user_trace_event(void* self, char* description);
  * @param worker The thread number of the worker thread or 0 for single-threaded execution.
  */
 #define tracepoint_reaction_starts(env, reaction, worker)                                                              \
-  call_tracepoint(reaction_starts, reaction->self, env->current_tag, worker, worker, reaction->number, NULL, NULL,     \
-                  reaction->deadline)
+  do {                                                                                                                 \
+    if (_lf_trace_event_enabled(reaction_starts) && _lf_trace_reaction_selected(reaction, true))                       \
+      call_tracepoint(reaction_starts, reaction->self, env->current_tag, worker, worker, reaction->number, NULL, NULL, \
+                      reaction->deadline);                                                                             \
+  } while (0)
 
 /**
  * Trace the end of a reaction execution.
@@ -113,8 +173,11 @@ int register_user_trace_event(void* self, char* description);
  * @param worker The thread number of the worker thread or 0 for single-threaded execution.
  */
 #define tracepoint_reaction_ends(env, reaction, worker)                                                                \
-  call_tracepoint(reaction_ends, reaction->self, env->current_tag, worker, worker, reaction->number, NULL, NULL,       \
-                  reaction->deadline)
+  do {                                                                                                                 \
+    if (_lf_trace_event_enabled(reaction_ends) && _lf_trace_reaction_selected(reaction, false))                        \
+      call_tracepoint(reaction_ends, reaction->self, env->current_tag, worker, worker, reaction->number, NULL, NULL,   \
+                      reaction->deadline);                                                                             \
+  } while (0)
 
 /**
  * Trace a call to schedule.
@@ -150,13 +213,26 @@ void tracepoint_user_event(void* self, char* description);
  */
 void tracepoint_user_value(void* self, char* description, long long value);
 
+/**
+ * Trace a value that the runtime has determined, such as the number of workers, as a user
+ * event with a value at the current tag of the specified environment. Before calling this,
+ * the runtime must register the description as a trace object of type trace_user.
+ * @param env The environment.
+ * @param description Pointer to the description string.
+ * @param value The value.
+ */
+void tracepoint_runtime_value(environment_t* env, char* description, long long value);
+
 /**
  * Trace the start of a worker waiting for something to change on the reaction queue.
  * @param trace The trace object.
  * @param worker The thread number of the worker thread or 0 for single-threaded execution.
  */
 #define tracepoint_worker_wait_starts(env, worker)                                                                     \
-  call_tracepoint(worker_wait_starts, NULL, env->current_tag, worker, worker, -1, NULL, NULL, 0)
+  do {                                                                                                                 \
+    if (_lf_trace_event_enabled(worker_wait_starts))                                                                   \
+      call_tracepoint(worker_wait_starts, NULL, env->current_tag, worker, worker, -1, NULL, NULL, 0);                  \
+  } while (0)
 
 /**
  * Trace the end of a worker waiting for something to change on the event or reaction queue.
@@ -164,7 +240,10 @@ void tracepoint_user_value(void* self, char* description, long long value);
  * @param worker The thread number of the worker thread or 0 for single-threaded execution.
  */
 #define tracepoint_worker_wait_ends(env, worker)                                                                       \
-  call_tracepoint(worker_wait_ends, NULL, env->current_tag, worker, worker, -1, NULL, NULL, 0)
+  do {                                                                                                                 \
+    if (_lf_trace_event_enabled(worker_wait_ends))                                                                     \
+      call_tracepoint(worker_wait_ends, NULL, env->current_tag, worker, worker, -1, NULL, NULL, 0);                    \
+  } while (0)
 
 /**
  * Trace the start of the scheduler waiting for logical time to advance or an event to
@@ -172,7 +251,10 @@ void tracepoint_user_value(void* self, char* description, long long value);
  * @param trace The trace object.
  */
 #define tracepoint_scheduler_advancing_time_starts(env)                                                                \
-  call_tracepoint(scheduler_advancing_time_starts, NULL, env->current_tag, -1, -1, -1, NULL, NULL, 0);
+  do {                                                                                                                 \
+    if (_lf_trace_event_enabled(scheduler_advancing_time_starts))                                                      \
+      call_tracepoint(scheduler_advancing_time_starts, NULL, env->current_tag, -1, -1, -1, NULL, NULL, 0);             \
+  } while (0)
 
 /**
  * Trace the end of the scheduler waiting for logical time to advance or an event to
@@ -180,7 +262,10 @@ void tracepoint_user_value(void* self, char* description, long long value);
  * @param trace The trace object.
  */
 #define tracepoint_scheduler_advancing_time_ends(env)                                                                  \
-  call_tracepoint(scheduler_advancing_time_ends, NULL, env->current_tag, -1, -1, -1, NULL, NULL, 0)
+  do {                                                                                                                 \
+    if (_lf_trace_event_enabled(scheduler_advancing_time_ends))                                                        \
+      call_tracepoint(scheduler_advancing_time_ends, NULL, env->current_tag, -1, -1, -1, NULL, NULL, 0);               \
+  } while (0)
 
 /**
  * Trace the occurrence of a deadline miss.
@@ -189,8 +274,21 @@ void tracepoint_user_value(void* self, char* description, long long value);
  * @param worker The thread number of the worker thread or 0 for single-threaded execution.
  */
 #define tracepoint_reaction_deadline_missed(env, reaction, worker)                                                     \
-  call_tracepoint(reaction_deadline_missed, reaction->self, env->current_tag, worker, worker, reaction->number, NULL,  \
-                  NULL, 0)
+  do {                                                                                                                 \
+    if (_lf_trace_event_enabled(reaction_deadline_missed))                                                             \
+      call_tracepoint(reaction_deadline_missed, reaction->self, env->current_tag, worker, worker, reaction->number,    \
+                      NULL, NULL, 0);                                                                                  \
+  } while (0)
+
+/**
+ * Write out the trace records that the tracing module keeps in memory. The default implementation
+ * does so if it is built with LF_TRACE_FLIGHT_RECORDER, in which case it also does so when a deadline
+ * is missed, when an STP violation is detected, and when the process receives SIGUSR1.
+ */
+#define tracepoint_dump() lf_tracing_dump()
+
+/** The number of bytes of memory that the tracing module holds, such as its buffers. */
+#define tracepoint_memory_size() lf_tracing_memory_size()
 
 /**
  * @brief Check if the tracing library is compatible with the current version
@@ -323,6 +421,11 @@ static inline void tracepoint_user_value(void* self, char* description, long lon
   (void)description;
   (void)value;
 }
+static inline void tracepoint_runtime_value(environment_t* env, char* description, long long value) {
+  (void)env;
+  (void)description;
+  (void)value;
+}
 static inline void tracepoint_rti_to_federate(trace_event_t event_type, int fed_id, tag_t* tag) {
   (void)event_type;
   (void)fed_id;
@@ -363,6 +466,8 @@ static inline void lf_tracing_global_init(char* process_name, char* process_name
   (void)max_num_local_threads;
 }
 static inline void lf_tracing_global_shutdown() {}
+static inline void tracepoint_dump() {}
+static inline size_t tracepoint_memory_size() { return 0; }
 static inline void lf_tracing_set_start_time(int64_t start_time) { (void)start_time; }
 
 #define tracepoint_reaction_starts(env, reaction, worker)                                                              \
@@ -0,0 +1,122 @@
+/**
+ * @file
+ * @brief Counters and histograms with which a program instruments its hot paths.
+ *
+ * tracepoint_user_value() writes a trace record at each call, which is too costly for values
+ * that change in every iteration of a loop, such as the depth of a queue or the latency of an
+ * item. When LF_USER_METRICS is defined, lf_counter_add() and lf_histogram_record() aggregate
+ * such values instead, at a cost of a few nanoseconds per update. Each thread that updates a
+ * metric gets a shard of the aggregates of its own, which only it writes, so an update takes
+ * neither a lock nor an atomic operation. Threads beyond the first LF_USER_METRICS_MAX_THREADS
+ * share a shard, which they update atomically, as do all threads of the single-threaded runtime,
+ * where reactions may race with the threads that schedule physical actions.
+ *
+ * A metric is identified by its name, such as a string literal, which must remain valid until
+ * termination. Its first update registers it, and later updates that pass the same pointer find
+ * it with a few comparisons. The program has up to LF_USER_METRICS_MAX metrics.
+ *
+ * The thread that starts a tag merges the shards at most every LF_USER_METRICS_PERIOD. With
+ * tracing, it writes one trace record per metric at that tag, which is the total of a counter or
+ * the mean of the values recorded in a histogram since the previous record. With LF_METRICS, it
+ * publishes the totals and histograms in the metrics block (see metrics.h). They are also
+ * printed on normal termination.
+ */
+
+#ifndef USER_METRICS_H
+#define USER_METRICS_H
+
+#include <stdint.h>
+
+/** The number of metrics of the program. Later metrics are not recorded. */
+#define LF_USER_METRICS_MAX 16
+
+/** The number of threads with a shard of their own. */
+#define LF_USER_METRICS_MAX_THREADS 64
+
+/**
+ * The number of buckets of a histogram. Bucket `i` counts the values of at most 2^i that are not
+ * counted in an earlier bucket, so the first bucket also counts the values below 1, and the last
+ * bucket counts the rest.
+ */
+#define LF_USER_METRICS_BUCKETS 32
+
+/**
+ * The minimum time between two merges of the shards at the start of a tag.
+ */
+#ifndef LF_USER_METRICS_PERIOD
+#define LF_USER_METRICS_PERIOD MSEC(100)
+#endif
+
+/** @brief The kinds of metrics. */
+typedef enum { lf_user_metric_counter = 1, lf_user_metric_histogram } lf_user_metric_kind_t;
+
+/** @brief The aggregates of a metric, merged over the threads. */
+typedef struct lf_user_metric_t {
+  const char* name;                         // The name of the metric.
+  lf_user_metric_kind_t kind;               // Its kind.
+  int64_t count;                            // The number of updates.
+  int64_t total;                            // The sum of the amounts or values.
+  int64_t max;                              // The largest value, for a histogram.
+  int64_t buckets[LF_USER_METRICS_BUCKETS]; // The histogram.
+} lf_user_metric_t;
+
+#ifdef LF_USER_METRICS
+
+/**
+ * @brief Add to a counter.
+ * @param name The name of the counter.
+ * @param amount The amount to add.
+ */
+void lf_counter_add(const char* name, int64_t amount);
+
+/**
+ * @brief Record a value in a histogram.
+ * @param name The name of the histogram.
+ * @param value The value.
+ */
+void lf_histogram_record(const char* name, int64_t value);
+
+/**
+ * @brief Get the aggregates of the metrics, merged over the threads.
+ *
+ * Updates that are in progress may be missed.
+ * @param metrics An array of LF_USER_METRICS_MAX aggregates.
+ * @return The number of metrics, which are the first entries of the array.
+ */
+int lf_user_metrics_get(lf_user_metric_t* metrics);
+
+///////////////////// Internal functions /////////////////////
+// The following functions are internal to the runtime and should not be documented by Doxygen.
+/// \cond INTERNAL  // Doxygen conditional.
+
+typedef struct environment_t environment_t;
+
+/**
+ * @brief Write the trace records of the metrics if the period has elapsed.
+ * This is called at the start of each tag of an environment.
+ * @param env The environment.
+ */
+void lf_user_metrics_tag_started(environment_t* env);
+
+/**
+ * @brief Print the metrics that have been updated.
+ */
+void lf_user_metrics_print(void);
+
+/// \endcond // INTERNAL
+
+#else
+
+static inline void lf_counter_add(const char* name, int64_t amount) {
+  (void)name;
+  (void)amount;
+}
+
+static inline void lf_histogram_record(const char* name, int64_t value) {
+  (void)name;
+  (void)value;
+}
+
+#endif // LF_USER_METRICS
+
+#endif // USER_METRICS_H
@@ -0,0 +1,120 @@
+/**
+ * @file
+ * @brief A set of pointers that threads can add to and remove from without a lock.
+ *
+ * Unlike the hashset in hashset.h, which needs external locking, this set uses
+ * compare-and-swap on the slots of an open-addressing table with linear probing.
+ * A slot goes from empty to holding an item, and a removed item leaves a tombstone,
+ * so that the probe sequences of other items are not broken. Concurrent adds of the
+ * same item race for the same empty slot, so an item is never in the set twice.
+ *
+ * The table does not grow while it is shared. Adding to a full table fails, and
+ * tombstones are not reused, so a set with many removals must be compacted from time
+ * to time with hashset_concurrent_compact() at a point where no other thread uses it,
+ * for example while the environment mutex is held at a tag boundary. Compacting
+ * drops the tombstones and doubles the capacity if the set is more than half full.
+ *
+ * Items can be iterated over, or drained, with an iterator that lives on the stack
+ * of the caller, so unlike hashset_iterator(), iterating does not allocate memory:
+ * ```
+ *   hashset_concurrent_itr_t iterator = hashset_concurrent_iterator(set);
+ *   void* item;
+ *   while ((item = hashset_concurrent_drain_next(&iterator)) != NULL) {
+ *     ...
+ *   }
+ * ```
+ * As in hashset.h, the pointer values 0 and 1 cannot be stored in the set.
+ */
+
+#ifndef HASHSET_CONCURRENT_H
+#define HASHSET_CONCURRENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct hashset_concurrent_st {
+  unsigned short nbits;
+  size_t capacity;
+  void* volatile* items;   // NULL for an empty slot, (void*)1 for a tombstone.
+  volatile int32_t nitems; // Number of items in the set.
+  volatile int32_t nused;  // Number of slots that are not empty, including tombstones.
+} * hashset_concurrent_t;
+
+/**
+ * @brief An iterator over a concurrent hashset, which the caller allocates, usually on the stack.
+ */
+typedef struct {
+  hashset_concurrent_t set;
+  size_t index; // Index of the next slot to look at.
+} hashset_concurrent_itr_t;
+
+/**
+ * @brief Create a concurrent hashset, or return NULL if there is not enough memory.
+ * The caller must call hashset_concurrent_destroy() to free allocated memory.
+ * @param nbits The log base 2 of the capacity of the hashset.
+ */
+hashset_concurrent_t hashset_concurrent_create(unsigned short nbits);
+
+/**
+ * @brief Destroy the hashset instance, freeing allocated memory.
+ * No other thread may be using the set.
+ */
+void hashset_concurrent_destroy(hashset_concurrent_t set);
+
+/**
+ * @brief Return the number of items in the hashset.
+ */
+size_t hashset_concurrent_num_items(hashset_concurrent_t set);
+
+/**
+ * @brief Add a pointer to the hashset.
+ * Return 1 if the item was added, 0 if it is already in the set, and -1 if the item
+ * is 0 or 1 or the set has no empty slot left in the probe sequence of the item.
+ */
+int hashset_concurrent_add(hashset_concurrent_t set, void* item);
+
+/**
+ * @brief Remove an item from the hashset.
+ * Return 1 if the item was removed and 0 if the item is not in the set.
+ */
+int hashset_concurrent_remove(hashset_concurrent_t set, void* item);
+
+/**
+ * @brief Return 1 if the item is in the hashset and 0 otherwise.
+ */
+int hashset_concurrent_is_member(hashset_concurrent_t set, void* item);
+
+/**
+ * @brief Drop the tombstones of the hashset and double its capacity if it is more than half full.
+ * No other thread may be using the set. Items removed by hashset_concurrent_drain_next() leave
+ * tombstones too, so this is the way to make their slots available again.
+ * Return 0 on success and -1 if there is not enough memory, in which case the set is unchanged.
+ */
+int hashset_concurrent_compact(hashset_concurrent_t set);
+
+/**
+ * @brief Return an iterator positioned before the first item of the hashset.
+ */
+hashset_concurrent_itr_t hashset_concurrent_iterator(hashset_concurrent_t set);
+
+/**
+ * @brief Return the next item of the hashset, or NULL if there is none.
+ * Items added or removed by other threads during the iteration may or may not be seen.
+ */
+void* hashset_concurrent_next(hashset_concurrent_itr_t* itr);
+
+/**
+ * @brief Remove the next item from the hashset and return it, or return NULL if there is none.
+ * Each item is returned to exactly one of the threads that drain or remove it concurrently.
+ */
+void* hashset_concurrent_drain_next(hashset_concurrent_itr_t* itr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HASHSET_CONCURRENT_H
@@ -65,6 +65,11 @@ void HASHMAP(put)(HASHMAP(t) * hashmap, K key, V value);
  */
 V HASHMAP(get)(HASHMAP(t) * hashmap, K key);
 
+/**
+ * @brief Get the value associated with the given key, or `otherwise` if the key is not present.
+ */
+V HASHMAP(get_or)(HASHMAP(t) * hashmap, K key, V otherwise);
+
 /////////////////////////// Private helpers ///////////////////////////
 
 static HASHMAP(entry_t) * HASHMAP(get_ideal_address)(HASHMAP(t) * hashmap, K key) {
@@ -135,3 +140,9 @@ V HASHMAP(get)(HASHMAP(t) * hashmap, K key) {
   HASHMAP(entry_t)* read_from = HASHMAP(get_actual_address)(hashmap, key);
   return read_from->value; // Crash the program if the key cannot be found
 }
+
+V HASHMAP(get_or)(HASHMAP(t) * hashmap, K key, V otherwise) {
+  assert(key != hashmap->nothing);
+  HASHMAP(entry_t)* read_from = HASHMAP(get_actual_address)(hashmap, key);
+  return (read_from == NULL || read_from->key != key) ? otherwise : read_from->value;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file
+ * @brief A combining tree that detects when all members of a group have arrived.
+ *
+ * This is a counter with one slot per member (e.g., per worker thread) whose
+ * arrivals are combined in a tree of small counters, so that each counter is
+ * shared by at most `LF_COMBINING_TREE_FAN_IN` threads and lives in its own
+ * cache line. Detecting that the last member has arrived then costs
+ * O(log members) atomic operations with little contention, instead of one
+ * atomic operation on a counter shared by all members.
+ *
+ * Unlike a barrier, members do not wait in the tree. The last member to arrive
+ * is told so, and it is then responsible for removing the members it lets go
+ * (including itself) with `lf_combining_tree_depart` before they may arrive again.
+ */
+
+#ifndef LF_COMBINING_TREE_H
+#define LF_COMBINING_TREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** The maximum number of children of a node of the tree. */
+#define LF_COMBINING_TREE_FAN_IN 4
+
+typedef struct lf_combining_tree_node_t lf_combining_tree_node_t;
+
+typedef struct lf_combining_tree_t {
+  size_t number_of_members;
+  lf_combining_tree_node_t* nodes; // The leaves come first and the root comes last.
+} lf_combining_tree_t;
+
+/**
+ * @brief Create a new tree for the given number of members, none of which has arrived.
+ *
+ * @param number_of_members The number of members. Must be more than 0.
+ * @return The new tree, to be freed with `lf_combining_tree_free`.
+ */
+lf_combining_tree_t* lf_combining_tree_new(size_t number_of_members);
+
+/**
+ * @brief Free the memory used by the tree.
+ *
+ * @param tree The tree.
+ */
+void lf_combining_tree_free(lf_combining_tree_t* tree);
+
+/**
+ * @brief Record the arrival of `member`.
+ *
+ * This may be called concurrently by different members. A member must not
+ * arrive again until it has departed.
+ *
+ * @param tree The tree.
+ * @param member The number of the member, from 0 to the number of members minus 1.
+ * @return true if this was the last member to arrive, false otherwise.
+ */
+bool lf_combining_tree_arrive(lf_combining_tree_t* tree, size_t member);
+
+/**
+ * @brief Remove `member`, which must have arrived, from the tree.
+ *
+ * This must not be called concurrently with `lf_combining_tree_arrive` or
+ * with itself. This is the case, for example, if it is called only by the
+ * last member to arrive, before it lets any other member go.
+ *
+ * @param tree The tree.
+ * @param member The number of the member.
+ */
+void lf_combining_tree_depart(lf_combining_tree_t* tree, size_t member);
+
+#endif // LF_COMBINING_TREE_H
@@ -38,10 +38,12 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #endif // NUMBER_OF_WORKERS
 
 #include "low_level_platform.h"
+#include <stdbool.h>
 #include <stdlib.h>
 
 typedef struct {
-  int count;
+  volatile int count;
+  int waiters; // Number of threads blocked in lf_semaphore_acquire or lf_semaphore_wait.
   lf_mutex_t mutex;
   lf_cond_t cond;
 } lf_semaphore_t;
@@ -69,6 +71,16 @@ void lf_semaphore_release(lf_semaphore_t* semaphore, int i);
  */
 void lf_semaphore_acquire(lf_semaphore_t* semaphore);
 
+/**
+ * @brief Acquire the 'semaphore' if its count is not 0, without blocking.
+ *
+ * This is cheap when the count is 0, so it can be polled in a spin loop.
+ *
+ * @param semaphore Instance of a semaphore.
+ * @return true if the semaphore was acquired, false otherwise.
+ */
+bool lf_semaphore_try_acquire(lf_semaphore_t* semaphore);
+
 /**
  * @brief Wait on the 'semaphore' if count is 0.
  *
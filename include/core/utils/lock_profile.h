@@ -0,0 +1,69 @@
+/**
+ * @file
+ * @brief Profiling of the contention on the mutexes of the runtime.
+ *
+ * When LF_LOCK_PROFILE is defined, LF_MUTEX_LOCK, LF_MUTEX_UNLOCK, LF_COND_WAIT,
+ * LF_CRITICAL_SECTION_ENTER and LF_CRITICAL_SECTION_EXIT (see util.h), as well as
+ * lf_clock_cond_timedwait, record for each call site and mutex how often the mutex was
+ * acquired there, a histogram of the times spent waiting for it, and how long it was held
+ * afterwards. Waits of at least LF_LOCK_PROFILE_TRACE_MIN_WAIT are also traced as
+ * mutex_wait_starts and mutex_wait_ends events, whose pointer is the mutex and whose
+ * destination ID is the line of the call site.
+ *
+ * At termination, lf_lock_profile_print() reports the call sites with the largest total
+ * waits. Mutexes given a name with LF_LOCK_PROFILE_NAME are reported by name.
+ *
+ * Mutexes acquired by calling lf_mutex_lock() or lf_critical_section_enter() directly are
+ * not profiled. A wait on a condition variable releases its mutex, which ends the hold, and
+ * reacquires it, which counts as an acquisition without a wait. This requires lf_cond_t to
+ * record its mutex, as it does on POSIX platforms.
+ */
+
+#ifndef LOCK_PROFILE_H
+#define LOCK_PROFILE_H
+
+#include "tag.h"
+
+#if defined(LF_LOCK_PROFILE) && defined(LF_SINGLE_THREADED)
+#error "LF_LOCK_PROFILE is not supported by the single-threaded runtime"
+#endif
+
+/** Waits for a mutex that are at least this long are traced. */
+#ifndef LF_LOCK_PROFILE_TRACE_MIN_WAIT
+#define LF_LOCK_PROFILE_TRACE_MIN_WAIT USEC(10)
+#endif
+
+/**
+ * @brief Return the time at which a thread starts to acquire a mutex.
+ */
+instant_t _lf_lock_profile_start(void);
+
+/**
+ * @brief Record that the calling thread acquired a mutex.
+ * @param lock The mutex.
+ * @param file The file of the call site.
+ * @param line The line of the call site.
+ * @param wait_start The time returned by _lf_lock_profile_start() before the mutex was
+ *  requested, or NEVER if the acquisition did not wait for the mutex to be free.
+ */
+void _lf_lock_profile_acquired(const void* lock, const char* file, int line, instant_t wait_start);
+
+/**
+ * @brief Record that the calling thread released a mutex.
+ * @param lock The mutex.
+ */
+void _lf_lock_profile_released(const void* lock);
+
+/**
+ * @brief Give a mutex a name under which lf_lock_profile_print() reports it.
+ * @param lock The mutex.
+ * @param name The name, which must remain valid.
+ */
+void _lf_lock_profile_name(const void* lock, const char* name);
+
+/**
+ * @brief Print the call sites with the largest total waits for a mutex.
+ */
+void lf_lock_profile_print(void);
+
+#endif // LOCK_PROFILE_H
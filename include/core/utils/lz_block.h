@@ -0,0 +1,33 @@
+/**
+ * @file
+ * @brief Fast compression of byte buffers in the LZ4 block format.
+ *
+ * A compressed block is a sequence of sequences, each of which is a token byte, the literals,
+ * and a match given by a two-byte little-endian offset back into the output. The high four bits
+ * of the token are the number of literals and the low four bits are the length of the match
+ * minus four, where 15 means that more bytes of the length follow, each added to it, until one
+ * is less than 255. The last sequence has only literals. The compressor finds matches with a
+ * hash table of the last position of each four-byte prefix, so it runs in linear time and
+ * uses no memory other than the stack.
+ *
+ * The uncompressed length is not part of the block; it is sent along with it.
+ */
+
+#ifndef LZ_BLOCK_H
+#define LZ_BLOCK_H
+
+#include <stddef.h>
+
+/**
+ * @brief Compress `length` bytes into `out`, which has room for `capacity` bytes.
+ * @return The length of the compressed block, or 0 if it does not fit in `capacity` bytes.
+ */
+size_t lz_block_compress(const unsigned char* in, size_t length, unsigned char* out, size_t capacity);
+
+/**
+ * @brief Decompress a block of `length` bytes into `out`, which must receive exactly `out_length` bytes.
+ * @return 0 on success, or -1 if the block is malformed or does not decompress to `out_length` bytes.
+ */
+int lz_block_decompress(const unsigned char* in, size_t length, unsigned char* out, size_t out_length);
+
+#endif // LZ_BLOCK_H
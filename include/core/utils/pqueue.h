@@ -17,13 +17,6 @@
 
 #include "pqueue_base.h"
 
-/**
- * Return 1 if the first argument is greater than the second and zero otherwise.
- * @param thiz First argument.
- * @param that Second argument.
- */
-int in_reverse_order(pqueue_pri_t thiz, pqueue_pri_t that);
-
 /**
  * Return 0 regardless of argument order.
  * @param thiz First argument.
@@ -40,14 +40,29 @@
  *
  * @brief Priority Queue function declarations used as a base for Lingua Franca priority queues.
  *
+ * By default, the queue is a binary heap. If LF_PQUEUE_ARITY is defined, it is instead a heap
+ * in which each node has LF_PQUEUE_ARITY children (see pqueue_base_dary.c), which is shallower,
+ * so fewer entries move on each insertion and removal, and whose children are adjacent in
+ * memory. That heap keeps the priority of each entry in an array next to the entries, so that
+ * comparing two entries calls no `getpri` callback, and if the comparison function is
+ * in_reverse_order, it compares the priorities inline rather than calling `cmppri`.
+ * The priority of an entry must then not change while the entry is in the queue.
+ *
  * @{
  */
 
 #ifndef PQUEUE_BASE_H
 #define PQUEUE_BASE_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
+#include "vector.h"
+
+#if defined(LF_PQUEUE_ARITY) && LF_PQUEUE_ARITY < 2
+#error "LF_PQUEUE_ARITY must be at least 2"
+#endif
+
 /** Priority data type. */
 typedef unsigned long long pqueue_pri_t;
 
@@ -81,8 +96,19 @@ typedef struct pqueue_t {
   pqueue_eq_elem_f eqelem;  /**< callback to compare elements */
   pqueue_print_entry_f prt; /**< callback to print elements */
   void** d;                 /**< The actual queue in binary heap form */
+#ifdef LF_PQUEUE_ARITY
+  pqueue_pri_t* keys; /**< The priorities of the entries of d, at the same positions */
+  bool integer_keys;  /**< Whether cmppri is in_reverse_order, so keys are compared inline */
+#endif
 } pqueue_t;
 
+/**
+ * Return 1 if the first argument is greater than the second, -1 if it is less and zero otherwise.
+ * @param thiz First argument.
+ * @param that Second argument.
+ */
+int in_reverse_order(pqueue_pri_t thiz, pqueue_pri_t that);
+
 /**
  * @brief Allocate and initialize a priority queue.
  *
@@ -156,6 +182,19 @@ void* pqueue_find_same_priority(pqueue_t* q, void* e);
  */
 void* pqueue_find_equal_same_priority(pqueue_t* q, void* e);
 
+/**
+ * Pop all entries with the same priority as the specified entry, provided that
+ * they are the highest-ranking entries in the queue, and append them to `v` in no
+ * particular order. If the highest-ranking entry has a different priority, nothing
+ * is popped. When many entries are popped, the heap is rebuilt once rather than
+ * percolating once per entry.
+ * @param q the queue
+ * @param e the entry to compare against
+ * @param v the vector to which to append the popped entries
+ * @return the number of entries popped
+ */
+size_t pqueue_pop_all_same_priority(pqueue_t* q, void* e, vector_t* v);
+
 /**
  * Remove an item from the queue.
  * @param q the queue
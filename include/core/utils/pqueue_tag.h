@@ -11,6 +11,13 @@
  * pqueue_tag_element_t or a derived struct, as explained below. What you put onto the
  * queue is a pointer to a tagged_element_t struct. That pointer, when cast to pqueue_pri_t,
  * an alias for long long, also serves as the "priority" for the queue.
+ *
+ * By default, the queue is a binary heap (see pqueue_base.h). If LF_CALENDAR_QUEUE is
+ * defined, it is instead a calendar queue (see pqueue_tag_calendar.c), which has O(1)
+ * amortized cost for inserting and popping elements with nearby tags. The calendar
+ * queue orders elements first by the time of their tag and then by the comparison
+ * function of the queue, so a custom comparison function has to be consistent with
+ * the order of times.
  */
 
 #ifndef PQUEUE_TAG_H
@@ -49,16 +56,24 @@
  * to (pqueue_tag_element_t*).  When accessing your struct from the queue,
  * simply cast the result to (my_element_type_t*);
  */
-typedef struct {
+typedef struct pqueue_tag_element_t {
   tag_t tag;
   size_t pos;     // Needed by any pqueue element.
   int is_dynamic; // Non-zero to free this struct when the queue is freed.
+#ifdef LF_CALENDAR_QUEUE
+  struct pqueue_tag_element_t* next; // Next element in the same bucket of the calendar queue.
+  struct pqueue_tag_element_t* prev; // Previous element in the same bucket of the calendar queue.
+#endif
 } pqueue_tag_element_t;
 
 /**
  * @brief Type of a priority queue sorted by tags.
  */
+#ifdef LF_CALENDAR_QUEUE
+typedef struct pqueue_tag_t pqueue_tag_t;
+#else
 typedef pqueue_t pqueue_tag_t;
+#endif
 
 /**
  * @brief Callback comparison function for the tag-based priority queue.
@@ -181,6 +196,21 @@ tag_t pqueue_tag_peek_tag(pqueue_tag_t* q);
  */
 pqueue_tag_element_t* pqueue_tag_pop(pqueue_tag_t* q);
 
+/**
+ * @brief Pop all elements with the specified tag, provided that it is the least tag in the queue.
+ *
+ * The popped elements are appended to the vector `v` in no particular order. If the least
+ * tag in the queue is not `t`, then nothing is popped. This is equivalent to calling
+ * pqueue_tag_pop() while pqueue_tag_peek_tag() returns `t`, but the queue is reorganized once
+ * rather than once per element. As with pqueue_tag_pop(), the caller becomes responsible for
+ * freeing dynamically allocated elements.
+ * @param q The queue.
+ * @param t The tag.
+ * @param v The vector to which to append the popped elements.
+ * @return The number of elements popped.
+ */
+size_t pqueue_tag_pop_all_with_tag(pqueue_tag_t* q, tag_t t, vector_t* v);
+
 /**
  * @brief Pop the least-tag element from the queue and return its tag.
  *
@@ -191,6 +221,17 @@ pqueue_tag_element_t* pqueue_tag_pop(pqueue_tag_t* q);
  */
 tag_t pqueue_tag_pop_tag(pqueue_tag_t* q);
 
+/**
+ * @brief Copy pointers to all elements of the queue, in no particular order, into an array.
+ *
+ * This lets the caller visit the elements without depending on how the queue stores them.
+ * The queue is not changed.
+ * @param q The queue.
+ * @param elements An array of at least pqueue_tag_size(q) entries.
+ * @return The number of elements copied, which is pqueue_tag_size(q).
+ */
+size_t pqueue_tag_elements(pqueue_tag_t* q, pqueue_tag_element_t** elements);
+
 /**
  * @brief Remove an item from the queue.
  *
@@ -0,0 +1,75 @@
+/**
+ * @file
+ * @brief Queue of reactions ordered by index, with constant-time operations for reactions without deadlines.
+ *
+ * Reactions are popped in the order of their index, which holds the (inferred) deadline in its
+ * high-order bits and the level in its low-order bits. Reactions that have no deadline all have
+ * the same high-order bits, so among them the order is just the order of levels. This queue keeps
+ * them in one bucket per level, a list linked through `next_queued`, so that inserting and popping
+ * them takes constant time. Only reactions that have a deadline go into a priority queue.
+ * Since any reaction with a deadline has a smaller index than any reaction without one, these are
+ * popped first, which gives the same order as a single priority queue sorted by index.
+ */
+
+#ifndef REACTION_QUEUE_H
+#define REACTION_QUEUE_H
+
+#include <stddef.h>
+
+#include "lf_types.h"
+#include "pqueue.h"
+
+typedef struct reaction_queue_t {
+  pqueue_t* with_deadline; // Reactions with a deadline, sorted by index.
+  reaction_t** levels;     // For each level, the list of queued reactions without a deadline.
+  size_t number_of_levels; // The number of entries in `levels`.
+  size_t min_level;        // No reaction without a deadline has a lower level than this.
+  size_t without_deadline; // The number of reactions without a deadline.
+} reaction_queue_t;
+
+/**
+ * @brief Create a new, empty reaction queue.
+ * @param initial_capacity The number of reactions with deadlines and the number of levels
+ * to allocate room for. Both grow as needed, except with LF_STATIC_MEMORY, where a
+ * reaction that does not fit is an error.
+ */
+reaction_queue_t* reaction_queue_init(size_t initial_capacity);
+
+/**
+ * @brief Free the memory used by the queue, but not the reactions in it.
+ * @param q The queue.
+ */
+void reaction_queue_free(reaction_queue_t* q);
+
+/**
+ * @brief Return the number of reactions in the queue.
+ * @param q The queue.
+ */
+size_t reaction_queue_size(reaction_queue_t* q);
+
+/**
+ * @brief Insert a reaction that is not already in the queue.
+ * @param q The queue.
+ * @param reaction The reaction.
+ */
+void reaction_queue_insert(reaction_queue_t* q, reaction_t* reaction);
+
+/**
+ * @brief Return a reaction with the smallest index without removing it, or NULL if the queue is empty.
+ * @param q The queue.
+ */
+reaction_t* reaction_queue_peek(reaction_queue_t* q);
+
+/**
+ * @brief Remove and return a reaction with the smallest index, or NULL if the queue is empty.
+ * @param q The queue.
+ */
+reaction_t* reaction_queue_pop(reaction_queue_t* q);
+
+/**
+ * @brief Print the contents of the queue if logging is set to DEBUG.
+ * @param q The queue.
+ */
+void reaction_queue_dump(reaction_queue_t* q);
+
+#endif // REACTION_QUEUE_H
@@ -0,0 +1,92 @@
+/**
+ * @file
+ * @brief Hierarchical timer wheel with constant-time insertion and removal of timers.
+ *
+ * Physical time is divided into ticks of 2^TIMER_WHEEL_TICK_BITS nanoseconds. The wheel has
+ * TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots, and each slot is a doubly linked list of
+ * entries. An entry whose tick first differs from the current tick of the wheel in the digit of
+ * level L (in base TIMER_WHEEL_SLOTS) is in level L, in the slot given by that digit. Hence an
+ * entry in a lower level, or in a lower slot of the same level, always expires earlier. When the
+ * wheel advances, the entries of the slots it passes are redistributed to lower levels, so each
+ * entry is moved at most TIMER_WHEEL_LEVELS times. All expired entries end up in the slot of the
+ * current tick in level 0.
+ *
+ * The wheel does not allocate memory: entries are embedded in the structs that use them.
+ * It is not thread safe.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tag.h"
+
+/** The length of a tick is 2^TIMER_WHEEL_TICK_BITS nanoseconds (about 66 usec). */
+#define TIMER_WHEEL_TICK_BITS 16
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+/** Enough levels to cover any non-negative instant_t. */
+#define TIMER_WHEEL_LEVELS ((64 - TIMER_WHEEL_TICK_BITS + TIMER_WHEEL_SLOT_BITS - 1) / TIMER_WHEEL_SLOT_BITS)
+
+/** @brief A timer in the wheel. */
+typedef struct timer_wheel_entry_t {
+  struct timer_wheel_entry_t* next; // The next entry in the same slot.
+  struct timer_wheel_entry_t* prev; // The previous entry in the same slot.
+  instant_t expiration;             // The physical time at which the timer expires.
+  uint8_t level;                    // The level of the slot the entry is in.
+  uint8_t slot;                     // The slot the entry is in.
+  bool scheduled;                   // Whether the entry is in the wheel.
+} timer_wheel_entry_t;
+
+typedef struct timer_wheel_t {
+  uint64_t now;                                                      // The current tick.
+  uint64_t occupied[TIMER_WHEEL_LEVELS];                             // For each level, a bitmap of non-empty slots.
+  timer_wheel_entry_t* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; // The first entry of each slot.
+  size_t size;                                                       // The number of entries in the wheel.
+} timer_wheel_t;
+
+/**
+ * @brief Initialize an empty wheel.
+ * @param wheel The wheel.
+ * @param now The current physical time.
+ */
+void timer_wheel_init(timer_wheel_t* wheel, instant_t now);
+
+/**
+ * @brief Schedule an entry, or reschedule it if it is already in the wheel.
+ * An expiration earlier than the current time of the wheel is treated as the current time.
+ * @param wheel The wheel.
+ * @param entry The entry.
+ * @param expiration The physical time at which the entry expires.
+ */
+void timer_wheel_insert(timer_wheel_t* wheel, timer_wheel_entry_t* entry, instant_t expiration);
+
+/**
+ * @brief Remove an entry from the wheel. Do nothing if it is not in the wheel.
+ * @param wheel The wheel.
+ * @param entry The entry.
+ */
+void timer_wheel_remove(timer_wheel_t* wheel, timer_wheel_entry_t* entry);
+
+/**
+ * @brief Advance the wheel to `now`, then remove and return an entry that expires at or before `now`.
+ * Entries are not necessarily returned in the order of their expiration.
+ * @param wheel The wheel.
+ * @param now The current physical time, which must not be earlier than in previous calls.
+ * @return An expired entry, or NULL if there is none.
+ */
+timer_wheel_entry_t* timer_wheel_pop(timer_wheel_t* wheel, instant_t now);
+
+/**
+ * @brief Return the time until which there is nothing to pop.
+ * This is the earliest expiration in the wheel if level 0 is not empty and otherwise the start of
+ * the earliest non-empty slot, at which timer_wheel_pop should be called to redistribute it.
+ * @param wheel The wheel.
+ * @return The time, or FOREVER if the wheel is empty.
+ */
+instant_t timer_wheel_next_wakeup(timer_wheel_t* wheel);
+
+#endif // TIMER_WHEEL_H
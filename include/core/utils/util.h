@@ -35,6 +35,7 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdarg.h> // Defines va_list
 #include <stdbool.h>
+#include <stddef.h> // Defines size_t
 #include <stdint.h> // Defines int64_t
 
 #include "logging_macros.h"
@@ -80,6 +81,24 @@ typedef struct lf_stat_ll {
 #define LF_MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
 #endif
 
+/** Hint to the processor that the caller is busy waiting, so that it can save power and yield to hyperthreads. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LF_CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define LF_CPU_RELAX() __asm__ __volatile__("yield")
+#else
+#define LF_CPU_RELAX()                                                                                                 \
+  do {                                                                                                                 \
+  } while (0)
+#endif
+
+/** Hint to the processor that the memory at `address` is about to be written, so that it can fetch it early. */
+#if defined(__GNUC__)
+#define LF_PREFETCH_FOR_WRITE(address) __builtin_prefetch(address, 1)
+#else
+#define LF_PREFETCH_FOR_WRITE(address) ((void)(address))
+#endif
+
 /**
  * The ID of this federate. For a non-federated execution, this will
  * be -1.  For a federated execution, it will be assigned when the generated function
@@ -130,6 +149,50 @@ void lf_vprint_warning(const char* format, va_list args) ATTRIBUTE_FORMAT_PRINTF
  */
 void lf_vprint_error_and_exit(const char* format, va_list args) ATTRIBUTE_FORMAT_PRINTF(1, 0);
 
+/**
+ * Write a message with the given prefix, and the federate or RTI identification, to stdout
+ * or to the function registered with lf_register_print_function(), without checking its
+ * log level. Internal function.
+ */
+void _lf_message_write(const char* prefix, const char* format, va_list args) ATTRIBUTE_FORMAT_PRINTF(2, 0);
+
+#if !defined(LF_SINGLE_THREADED)
+/**
+ * Queue a message in the ring of the current thread, to be formatted and written by
+ * a background thread. If the ring is full, the message is dropped and counted.
+ * The prefix and format strings must remain valid until the message is written,
+ * which holds for string literals. This is used by the lf_print functions when
+ * LF_ASYNC_LOG is defined. Internal function.
+ * @return false if the current thread has no ring, in which case the caller
+ *  should call lf_async_log_flush() and then print the message itself.
+ */
+bool _lf_async_log_vprint(const char* prefix, const char* format, va_list args) ATTRIBUTE_FORMAT_PRINTF(2, 0);
+
+/**
+ * Format and write all messages queued by _lf_async_log_vprint() on the calling thread.
+ * This is done at exit, and before an error is printed.
+ */
+void lf_async_log_flush(void);
+
+/**
+ * Return the number of messages dropped so far because the ring of their thread was full.
+ */
+size_t lf_async_log_dropped(void);
+#endif // !defined(LF_SINGLE_THREADED)
+
+#ifdef LF_LOCK_PROFILE
+#include "lock_profile.h"
+
+struct environment_t;
+
+/**
+ * Return the pointer that identifies the critical section of the environment in the lock
+ * profile, which is the mutex of the environment, or a stand-in for the global mutex of
+ * GLOBAL_ENVIRONMENT. Internal function, defined in lock_profile.c.
+ */
+const void* _lf_critical_section_lock(struct environment_t* env);
+#endif
+
 /**
  * Initialize mutex with error checking.
  * This is optimized away if the NDEBUG flag is defined.
@@ -142,14 +205,31 @@ void lf_vprint_error_and_exit(const char* format, va_list args) ATTRIBUTE_FORMAT
  * This is optimized away if the NDEBUG flag is defined.
  * @param mutex Pointer to the mutex to lock.
  */
+#ifdef LF_LOCK_PROFILE
+#define LF_MUTEX_LOCK(mutex)                                                                                           \
+  do {                                                                                                                 \
+    instant_t _lf_wait_start = _lf_lock_profile_start();                                                               \
+    LF_ASSERTN(lf_mutex_lock(mutex), "Mutex lock failed.");                                                            \
+    _lf_lock_profile_acquired(mutex, __FILE__, __LINE__, _lf_wait_start);                                              \
+  } while (0)
+#else
 #define LF_MUTEX_LOCK(mutex) LF_ASSERTN(lf_mutex_lock(mutex), "Mutex lock failed.")
+#endif
 
 /**
  * Unlock mutex with error checking.
  * This is optimized away if the NDEBUG flag is defined.
  * @param mutex Pointer to the mutex to unlock.
  */
+#ifdef LF_LOCK_PROFILE
+#define LF_MUTEX_UNLOCK(mutex)                                                                                         \
+  do {                                                                                                                 \
+    _lf_lock_profile_released(mutex);                                                                                  \
+    LF_ASSERTN(lf_mutex_unlock(mutex), "Mutex unlock failed.");                                                        \
+  } while (0)
+#else
 #define LF_MUTEX_UNLOCK(mutex) LF_ASSERTN(lf_mutex_unlock(mutex), "Mutex unlock failed.")
+#endif
 
 /**
  * Initialize condition variable with error checking.
@@ -178,20 +258,59 @@ void lf_vprint_error_and_exit(const char* format, va_list args) ATTRIBUTE_FORMAT
  * This is optimized away if the NDEBUG flag is defined.
  * @param cond Pointer to the condition variable.
  */
+#ifdef LF_LOCK_PROFILE
+#define LF_COND_WAIT(cond)                                                                                             \
+  do {                                                                                                                 \
+    _lf_lock_profile_released((cond)->mutex);                                                                          \
+    LF_ASSERTN(lf_cond_wait(cond), "Condition variable wait failed.");                                                 \
+    _lf_lock_profile_acquired((cond)->mutex, __FILE__, __LINE__, NEVER);                                               \
+  } while (0)
+#else
 #define LF_COND_WAIT(cond) LF_ASSERTN(lf_cond_wait(cond), "Condition variable wait failed.")
+#endif
 
 /**
  * Enter critical section with error checking.
  * This is optimized away if the NDEBUG flag is defined.
  * @param env Pointer to the environment.
  */
+#ifdef LF_LOCK_PROFILE
+#define LF_CRITICAL_SECTION_ENTER(env)                                                                                 \
+  do {                                                                                                                 \
+    instant_t _lf_wait_start = _lf_lock_profile_start();                                                               \
+    LF_ASSERT(!lf_critical_section_enter(env), "Could not enter critical section");                                    \
+    _lf_lock_profile_acquired(_lf_critical_section_lock(env), __FILE__, __LINE__, _lf_wait_start);                     \
+  } while (0)
+#else
 #define LF_CRITICAL_SECTION_ENTER(env) LF_ASSERT(!lf_critical_section_enter(env), "Could not enter critical section")
+#endif
 
 /**
  * Exit critical section with error checking.
  * This is optimized away if the NDEBUG flag is defined.
  * @param env Pointer to the environment.
  */
+#ifdef LF_LOCK_PROFILE
+#define LF_CRITICAL_SECTION_EXIT(env)                                                                                  \
+  do {                                                                                                                 \
+    _lf_lock_profile_released(_lf_critical_section_lock(env));                                                         \
+    LF_ASSERT(!lf_critical_section_exit(env), "Could not exit critical section");                                      \
+  } while (0)
+#else
 #define LF_CRITICAL_SECTION_EXIT(env) LF_ASSERT(!lf_critical_section_exit(env), "Could not exit critical section")
+#endif
+
+/**
+ * Give a mutex a name under which the lock profile reports it (see lock_profile.h).
+ * This does nothing unless LF_LOCK_PROFILE is defined.
+ * @param mutex Pointer to the mutex.
+ * @param name The name, which must remain valid.
+ */
+#ifdef LF_LOCK_PROFILE
+#define LF_LOCK_PROFILE_NAME(mutex, name) _lf_lock_profile_name(mutex, name)
+#else
+#define LF_LOCK_PROFILE_NAME(mutex, name) ((void)(mutex), (void)(name))
+#endif
+
 
 #endif /* UTIL_H */
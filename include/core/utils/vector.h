@@ -14,14 +14,28 @@
 #include <stdlib.h>
 
 typedef struct vector_t {
-  void** start;       /* The start of the underlying array. */
-  void** next;        /* The element after the last element in the underlying array.
-                            start <= next <= end. */
-  void** end;         /* The end of the underlying array. */
-  int votes_required; /* The number of votes required to shrink this vector. */
-  int votes;          /* The number of votes to shrink this vector. */
+  void** start;           /* The start of the underlying array. */
+  void** next;            /* The element after the last element in the underlying array.
+                                start <= next <= end. */
+  void** end;             /* The end of the underlying array. */
+  int votes_required;     /* The number of votes required to shrink this vector. */
+  int votes;              /* The number of votes to shrink this vector. */
+  void** buffer;          /* Storage provided by the owner of the vector, or NULL. See vector_init_with_buffer. */
+  size_t buffer_capacity; /* The number of elements that fit in buffer. */
 } vector_t;
 
+/**
+ * Return the element at 'idx', converted to `type`, without the bounds check
+ * and resizing of vector_at. 'idx' must be less than the size of the vector.
+ */
+#define VECTOR_GET(v, idx, type) ((type)((v)->start[(idx)]))
+
+/**
+ * Set the element at 'idx' to `value`, without the bounds check and resizing
+ * of vector_at. 'idx' must be less than the size of the vector.
+ */
+#define VECTOR_SET(v, idx, value) ((v)->start[(idx)] = (void*)(value))
+
 /**
  * Allocate and initialize a new vector.
  * @param initial_capacity The desired initial capacity to allocate.
@@ -29,6 +43,18 @@ typedef struct vector_t {
  */
 vector_t vector_new(size_t initial_capacity);
 
+/**
+ * Initialize a vector that stores up to `capacity` elements in `buffer`, which
+ * is provided by the owner of the vector (typically an array in the same struct)
+ * and must remain valid as long as the vector is used. No memory is allocated
+ * until the vector grows beyond the buffer, and a vector that has grown moves
+ * back into the buffer rather than shrinking below it.
+ * @param v The vector to initialize.
+ * @param buffer An array of at least `capacity` pointers.
+ * @param capacity The number of elements that fit in the buffer. Must be more than 0.
+ */
+void vector_init_with_buffer(vector_t* v, void** buffer, size_t capacity);
+
 /**
  * Free the memory held by the given vector, invalidating it.
  * @param v Any vector.
@@ -59,6 +85,13 @@ void vector_pushall(vector_t* v, void** array, size_t size);
  */
 void* vector_pop(vector_t* v);
 
+/**
+ * Remove all elements from the vector, keeping its memory for reuse.
+ * Unlike popping all elements, this never shrinks the vector.
+ * @param v Any vector.
+ */
+void vector_clear(vector_t* v);
+
 /**
  * Return a pointer to where the vector element at 'idx' is stored.
  * This can be used to set the value of the element or to read it.
@@ -14,6 +14,212 @@
 #include <assert.h>
 #include <string.h> // Defines memcpy.
 
+#ifdef LF_RECORD_REPLAY
+#include "replay.h"
+#endif
+#ifdef LF_TAG_PIPELINING
+#include "pipeline.h"
+#endif
+
+#if !defined(LF_SINGLE_THREADED)
+/** Return whether the action is a physical action, whose events are staged rather than scheduled directly. */
+static inline bool is_physical(void* action) {
+  trigger_t* trigger = ((lf_action_base_t*)action)->trigger;
+  return trigger != NULL && trigger->is_physical;
+}
+
+/**
+ * Atomically replace the staged events of the environment if they are equal to `old_head`.
+ */
+static inline bool ingress_cas(environment_t* env, lf_ingress_event_t* old_head, lf_ingress_event_t* new_head) {
+#if UINTPTR_MAX == UINT64_MAX
+  return lf_atomic_bool_compare_and_swap64((int64_t*)&env->ingress, (int64_t)(intptr_t)old_head,
+                                           (int64_t)(intptr_t)new_head);
+#else
+  return lf_atomic_bool_compare_and_swap32((int32_t*)&env->ingress, (int32_t)(intptr_t)old_head,
+                                           (int32_t)(intptr_t)new_head);
+#endif
+}
+
+/** Return a new staged event, not yet linked to the others. */
+static lf_ingress_event_t* ingress_event_new(trigger_t* trigger, interval_t extra_delay, lf_token_t* token,
+                                             instant_t time, lf_ingress_limit_t* limit) {
+  lf_ingress_event_t* staged = (lf_ingress_event_t*)malloc(sizeof(lf_ingress_event_t));
+  LF_ASSERT_NON_NULL(staged);
+  staged->trigger = trigger;
+  staged->extra_delay = extra_delay;
+  staged->token = token;
+  staged->time = time;
+  staged->limit = limit;
+  return staged;
+}
+
+/**
+ * Count `count` events of the trigger that are about to be staged against the capacities of
+ * the trigger and the environment, unless they must be rejected. See lf_action_set_capacity.
+ * @return Whether the events are accepted.
+ */
+static bool ingress_admit(environment_t* env, trigger_t* trigger, size_t count) {
+  lf_ingress_limit_t* limit = trigger->ingress_limit;
+  bool rejects = (limit == NULL || limit->policy == lf_overload_reject);
+  if (rejects) {
+    bool full =
+        env->ingress_capacity > 0 && lf_atomic_load64(&env->ingress_count) + (int64_t)count > env->ingress_capacity;
+    if (limit != NULL) {
+      full = full || env->ingress_shedding || lf_atomic_load64(&limit->count) + (int64_t)count > limit->capacity;
+    }
+    if (full) {
+      lf_atomic_fetch_add64(&env->ingress_rejected, (int64_t)count);
+      return false;
+    }
+  }
+  int64_t total = lf_atomic_add_fetch64(&env->ingress_count, (int64_t)count);
+  if (limit != NULL) {
+    int64_t pending = lf_atomic_add_fetch64(&limit->count, (int64_t)count);
+    if (!rejects && (pending > limit->capacity || env->ingress_shedding ||
+                     (env->ingress_capacity > 0 && total > env->ingress_capacity))) {
+      env->ingress_overloaded = true;
+    }
+  }
+  return true;
+}
+
+/** Uncount a staged event that is moved to the event queue or dropped. */
+static void ingress_release(environment_t* env, lf_ingress_event_t* staged) {
+  lf_atomic_fetch_add64(&env->ingress_count, -1);
+  if (staged->limit != NULL) {
+    lf_atomic_fetch_add64(&staged->limit->count, -1);
+  }
+}
+
+/**
+ * Stage the events linked from `first` through `next` to `last` at once. Like the stack of
+ * staged events, the chain must start with the event staged last.
+ */
+static void ingress_push_chain(environment_t* env, lf_ingress_event_t* first, lf_ingress_event_t* last) {
+  lf_ingress_event_t* head;
+  do {
+    head = env->ingress;
+    last->next = head;
+  } while (!ingress_cas(env, head, first));
+  if (head == NULL) {
+    // Notify the main thread in case it is waiting for physical time to elapse.
+    // Holding the mutex ensures that a worker is either waiting or has yet to drain the events.
+    LF_CRITICAL_SECTION_ENTER(env);
+    lf_notify_of_event(env);
+    LF_CRITICAL_SECTION_EXIT(env);
+  }
+}
+
+void _lf_ingress_push_at(environment_t* env, trigger_t* trigger, interval_t extra_delay, lf_token_t* token,
+                         instant_t time) {
+  lf_atomic_fetch_add64(&env->ingress_count, 1);
+  lf_ingress_event_t* staged = ingress_event_new(trigger, extra_delay, token, time, NULL);
+  ingress_push_chain(env, staged, staged);
+}
+
+/**
+ * Stage an event of a physical action, stamped with the current physical time, without
+ * acquiring the mutex of the environment. The workers move it to the event queue when they
+ * next look for the next tag. Only the thread that stages an event while there are none
+ * takes the mutex, to wake up the workers, so threads that schedule physical actions at a
+ * high rate rarely contend with the workers.
+ * @return 1, because the handle of the event is not known until it is moved to the event queue,
+ *  0 if the event is ignored because the events of physical actions are replayed from a log,
+ *  or -1 if it is rejected because of a capacity. See lf_action_set_capacity.
+ */
+static trigger_handle_t ingress_push(environment_t* env, lf_action_base_t* action, interval_t extra_delay,
+                                     lf_token_t* token) {
+#ifdef LF_RECORD_REPLAY
+  if (_lf_replay_file != NULL) {
+    _lf_free_token(token);
+    return 0;
+  }
+#endif
+  if (!ingress_admit(env, action->trigger, 1)) {
+    _lf_free_token(token);
+    return -1;
+  }
+  // Physical actions scheduled by different threads must get ordered tags.
+  instant_t time;
+  LF_ASSERTN(lf_clock_gettime_fenced(&time), "Failed to read physical clock.");
+#ifdef LF_RECORD_REPLAY
+  _lf_replay_record(action, time, extra_delay, token);
+#endif
+  lf_ingress_event_t* staged =
+      ingress_event_new(action->trigger, extra_delay, token, time, action->trigger->ingress_limit);
+  ingress_push_chain(env, staged, staged);
+  return 1;
+}
+
+/**
+ * Stage events of a physical action as ingress_push does, all stamped with the same physical
+ * time and in the given order, with one atomic operation. The events are accepted or rejected together.
+ * @return 1, 0 if there are no events or they are ignored because they are replayed from a log,
+ *  or -1 if they are rejected because of a capacity.
+ */
+static trigger_handle_t ingress_push_many(environment_t* env, lf_action_base_t* action, size_t count,
+                                          const interval_t* extra_delays, lf_token_t** tokens) {
+#ifdef LF_RECORD_REPLAY
+  if (_lf_replay_file != NULL) {
+    for (size_t i = 0; tokens != NULL && i < count; i++) {
+      _lf_free_token(tokens[i]);
+    }
+    return 0;
+  }
+#endif
+  if (count == 0) {
+    return 0;
+  }
+  if (!ingress_admit(env, action->trigger, count)) {
+    for (size_t i = 0; tokens != NULL && i < count; i++) {
+      _lf_free_token(tokens[i]);
+    }
+    return -1;
+  }
+  instant_t time;
+  LF_ASSERTN(lf_clock_gettime_fenced(&time), "Failed to read physical clock.");
+  lf_ingress_event_t* first = NULL;
+  lf_ingress_event_t* last = NULL;
+  for (size_t i = 0; i < count; i++) {
+    lf_token_t* token = (tokens == NULL) ? NULL : tokens[i];
+#ifdef LF_RECORD_REPLAY
+    _lf_replay_record(action, time, extra_delays[i], token);
+#endif
+    lf_ingress_event_t* staged =
+        ingress_event_new(action->trigger, extra_delays[i], token, time, action->trigger->ingress_limit);
+    staged->next = first;
+    first = staged;
+    if (last == NULL) {
+      last = staged;
+    }
+  }
+  ingress_push_chain(env, first, last);
+  return 1;
+}
+#endif // !defined(LF_SINGLE_THREADED)
+
+#if defined(LF_SINGLE_THREADED)
+/** Order the accesses to a slot of a ring and to the index that publishes or frees it. */
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ISR_RING_FENCE() _ReadWriteBarrier()
+#else
+#define ISR_RING_FENCE() __sync_synchronize()
+#endif
+
+/** The start of a slot of the ring of a physical action, which the value follows. See lf_isr_ring_t. */
+typedef struct isr_slot_t {
+  instant_t time;
+  bool has_value;
+} isr_slot_t;
+
+/** Return the slot of the ring with the given index. */
+static inline isr_slot_t* isr_slot(lf_isr_ring_t* ring, lf_isr_index_t index) {
+  return (isr_slot_t*)(ring->slots + (size_t)(index & (lf_isr_index_t)(ring->capacity - 1)) * ring->slot_size);
+}
+#endif // defined(LF_SINGLE_THREADED)
+
 trigger_handle_t lf_schedule(void* action, interval_t offset) {
   return lf_schedule_token((lf_action_base_t*)action, offset, NULL);
 }
@@ -35,6 +241,11 @@ trigger_handle_t lf_schedule_int(void* action, interval_t extra_delay, int value
 
 trigger_handle_t lf_schedule_token(void* action, interval_t extra_delay, lf_token_t* token) {
   environment_t* env = ((lf_action_base_t*)action)->parent->environment;
+#if !defined(LF_SINGLE_THREADED)
+  if (is_physical(action)) {
+    return ingress_push(env, (lf_action_base_t*)action, extra_delay, token);
+  }
+#endif
 
   LF_CRITICAL_SECTION_ENTER(env);
   int return_value = lf_schedule_trigger(env, ((lf_action_base_t*)action)->trigger, extra_delay, token);
@@ -44,6 +255,157 @@ trigger_handle_t lf_schedule_token(void* action, interval_t extra_delay, lf_toke
   return return_value;
 }
 
+trigger_handle_t lf_schedule_tokens(void* action, size_t count, const interval_t* extra_delays, lf_token_t** tokens,
+                                    trigger_handle_t* handles) {
+  environment_t* env = ((lf_action_base_t*)action)->parent->environment;
+#if !defined(LF_SINGLE_THREADED)
+  if (is_physical(action)) {
+    trigger_handle_t result = ingress_push_many(env, (lf_action_base_t*)action, count, extra_delays, tokens);
+    for (size_t i = 0; handles != NULL && i < count; i++) {
+      handles[i] = result;
+    }
+    return result;
+  }
+#endif
+  trigger_handle_t return_value = 0;
+  LF_CRITICAL_SECTION_ENTER(env);
+  for (size_t i = 0; i < count; i++) {
+    trigger_handle_t handle = lf_schedule_trigger(env, ((lf_action_base_t*)action)->trigger, extra_delays[i],
+                                                  (tokens == NULL) ? NULL : tokens[i]);
+    if (handles != NULL) {
+      handles[i] = handle;
+    }
+    if (handle != 0 && return_value >= 0) {
+      return_value = handle;
+    }
+  }
+  // Notify the main thread in case it is waiting for physical time to elapse.
+  if (count > 0) {
+    lf_notify_of_event(env);
+  }
+  LF_CRITICAL_SECTION_EXIT(env);
+  return return_value;
+}
+
+int lf_action_set_capacity(void* action, size_t capacity, lf_overload_policy_t policy) {
+  trigger_t* trigger = ((lf_action_base_t*)action)->trigger;
+  if (trigger == NULL || !trigger->is_physical) {
+    lf_print_error("lf_action_set_capacity: The action is not physical.");
+    return -1;
+  }
+#if !defined(LF_SINGLE_THREADED)
+  environment_t* env = ((lf_action_base_t*)action)->parent->environment;
+  LF_CRITICAL_SECTION_ENTER(env);
+  lf_ingress_limit_t* limit = trigger->ingress_limit;
+  if (limit == NULL) {
+    // Staged events may point to the limit, so it is kept until the environment is freed.
+    limit = (lf_ingress_limit_t*)calloc(1, sizeof(lf_ingress_limit_t));
+    LF_ASSERT_NON_NULL(limit);
+    limit->next = env->ingress_limits;
+    env->ingress_limits = limit;
+    trigger->ingress_limit = limit;
+  }
+  limit->capacity = (capacity == 0) ? INT64_MAX : (int64_t)capacity;
+  limit->policy = policy;
+  LF_CRITICAL_SECTION_EXIT(env);
+  return 0;
+#else
+  (void)capacity;
+  (void)policy;
+  lf_print_warning("lf_action_set_capacity: Capacities are not enforced by the single-threaded runtime.");
+  return -1;
+#endif
+}
+
+int lf_action_set_batch_window(void* action, interval_t window) {
+  trigger_t* trigger = ((lf_action_base_t*)action)->trigger;
+  if (trigger == NULL || !trigger->is_physical) {
+    lf_print_error("lf_action_set_batch_window: The action is not physical.");
+    return -1;
+  }
+  environment_t* env = ((lf_action_base_t*)action)->parent->environment;
+  LF_CRITICAL_SECTION_ENTER(env);
+  trigger->batches = window >= 0;
+  trigger->batch_window = window;
+  LF_CRITICAL_SECTION_EXIT(env);
+  return 0;
+}
+
+int lf_action_set_isr_ring(void* action, size_t capacity) {
+  trigger_t* trigger = ((lf_action_base_t*)action)->trigger;
+  if (trigger == NULL || !trigger->is_physical) {
+    lf_print_error("lf_action_set_isr_ring: The action is not physical.");
+    return -1;
+  }
+#if defined(LF_SINGLE_THREADED)
+  // The indices wrap around, so the ring may only use half of their range.
+  size_t max_capacity = LF_MIN(((size_t)(lf_isr_index_t)~(lf_isr_index_t)0 >> 1) + 1, (size_t)65536);
+  if (trigger->isr_ring != NULL || capacity == 0 || capacity > max_capacity) {
+    lf_print_error("lf_action_set_isr_ring: The action already has a ring or the capacity %zu is out of range.",
+                   capacity);
+    return -1;
+  }
+  size_t rounded = 1;
+  while (rounded < capacity) {
+    rounded <<= 1;
+  }
+  // Keep the time of each slot aligned.
+  size_t element_size = ((token_template_t*)action)->type.element_size;
+  size_t slot_size = (sizeof(isr_slot_t) + element_size + sizeof(instant_t) - 1) / sizeof(instant_t);
+  slot_size *= sizeof(instant_t);
+  lf_isr_ring_t* ring = (lf_isr_ring_t*)malloc(sizeof(lf_isr_ring_t));
+  char* slots = (char*)malloc(rounded * slot_size);
+  if (ring == NULL || slots == NULL) {
+    free(ring);
+    free(slots);
+    lf_print_error("lf_action_set_isr_ring: Out of memory.");
+    return -1;
+  }
+  ring->action = (lf_action_base_t*)action;
+  ring->capacity = (lf_isr_index_t)rounded;
+  ring->slot_size = slot_size;
+  ring->head = 0;
+  ring->tail = 0;
+  ring->slots = slots;
+  environment_t* env = ((lf_action_base_t*)action)->parent->environment;
+  LF_CRITICAL_SECTION_ENTER(env);
+  ring->next = env->isr_rings;
+  env->isr_rings = ring;
+  trigger->isr_ring = ring;
+  LF_CRITICAL_SECTION_EXIT(env);
+#else
+  (void)capacity;
+#endif
+  return 0;
+}
+
+trigger_handle_t lf_schedule_isr(void* action, const void* value) {
+#if defined(LF_SINGLE_THREADED)
+  lf_isr_ring_t* ring = ((lf_action_base_t*)action)->trigger->isr_ring;
+  if (ring == NULL) {
+    return -1;
+  }
+  lf_isr_index_t head = ring->head;
+  if ((lf_isr_index_t)(head - ring->tail) == ring->capacity) {
+    return -1;
+  }
+  isr_slot_t* slot = isr_slot(ring, head);
+  // The platform clock, unlike lf_clock_gettime, keeps no state. The main loop orders the events.
+  _lf_clock_gettime(&slot->time);
+  slot->has_value = (value != NULL);
+  if (value != NULL) {
+    memcpy(slot + 1, value, ((token_template_t*)action)->type.element_size);
+  }
+  ISR_RING_FENCE();
+  ring->head = (lf_isr_index_t)(head + 1);
+  // Interrupt the sleep of the main loop.
+  lf_notify_of_event(ring->action->parent->environment);
+  return 1;
+#else
+  return lf_schedule_copy(action, 0, (void*)value, (value == NULL) ? 0 : 1);
+#endif
+}
+
 trigger_handle_t lf_schedule_copy(void* action, interval_t offset, void* value, size_t length) {
   if (value == NULL) {
     return lf_schedule_token(action, offset, NULL);
@@ -54,6 +416,15 @@ trigger_handle_t lf_schedule_copy(void* action, interval_t offset, void* value,
     lf_print_error("schedule: Invalid element size.");
     return -1;
   }
+#if !defined(LF_SINGLE_THREADED)
+  if (is_physical(action)) {
+    // The template token can only be reused under the mutex, so the copy gets a new token.
+    lf_token_t* token = _lf_new_token_with_payload(&template->type, template->type.element_size * length);
+    token->length = length;
+    memcpy(token->value, value, template->type.element_size * length);
+    return ingress_push(env, (lf_action_base_t*)action, offset, token);
+  }
+#endif
   LF_CRITICAL_SECTION_ENTER(env);
   // Initialize token with an array size of length and a reference count of 0.
   lf_token_t* token = _lf_initialize_token(template, length);
@@ -76,8 +447,47 @@ trigger_handle_t lf_schedule_value(void* action, interval_t extra_delay, void* v
   }
   token_template_t* template = (token_template_t*)action;
   environment_t* env = ((lf_action_base_t*)action)->parent->environment;
+#if !defined(LF_SINGLE_THREADED)
+  if (is_physical(action)) {
+    lf_token_t* token = _lf_new_token(&template->type, value, (size_t)length);
+#if !defined NDEBUG
+    if (value != NULL) {
+      _lf_count_payload_allocation(1);
+    }
+#endif
+    return ingress_push(env, (lf_action_base_t*)action, extra_delay, token);
+  }
+#endif
+  LF_CRITICAL_SECTION_ENTER(env);
+  lf_token_t* token = _lf_initialize_token_with_value(template, value, length);
+  int return_value = lf_schedule_trigger(env, ((lf_action_base_t*)action)->trigger, extra_delay, token);
+  // Notify the main thread in case it is waiting for physical time to elapse.
+  lf_notify_of_event(env);
+  LF_CRITICAL_SECTION_EXIT(env);
+  return return_value;
+}
+
+trigger_handle_t lf_schedule_move(void* action, interval_t extra_delay, void* value, size_t length,
+                                  void (*destructor)(void* value)) {
+  if (value == NULL) {
+    return lf_schedule_token(action, extra_delay, NULL);
+  }
+  token_template_t* template = (token_template_t*)action;
+  environment_t* env = ((lf_action_base_t*)action)->parent->environment;
+#if !defined(LF_SINGLE_THREADED)
+  if (is_physical(action)) {
+    lf_token_t* token = _lf_new_token(&template->type, value, length);
+    token->destructor = destructor;
+#if !defined NDEBUG
+    _lf_count_payload_allocation(1);
+#endif
+    return ingress_push(env, (lf_action_base_t*)action, extra_delay, token);
+  }
+#endif
   LF_CRITICAL_SECTION_ENTER(env);
+  // The buffer becomes the payload of the token as is, so it is released with the given destructor.
   lf_token_t* token = _lf_initialize_token_with_value(template, value, length);
+  token->destructor = destructor;
   int return_value = lf_schedule_trigger(env, ((lf_action_base_t*)action)->trigger, extra_delay, token);
   // Notify the main thread in case it is waiting for physical time to elapse.
   lf_notify_of_event(env);
@@ -107,10 +517,50 @@ bool lf_check_deadline(void* self, bool invoke_deadline_handler) {
   return false;
 }
 
-trigger_handle_t lf_schedule_trigger(environment_t* env, trigger_t* trigger, interval_t extra_delay,
-                                     lf_token_t* token) {
+/**
+ * Return the pending event of a batching physical action that an event of it at `time` would
+ * be appended to, or NULL if there is none. See lf_action_set_batch_window.
+ */
+static event_t* batch_event_of(trigger_t* trigger, instant_t time) {
+  event_t* last = trigger->last_pending;
+  if (!trigger->batches || last == NULL || last->base.tag.time < time - trigger->batch_window) {
+    return NULL;
+  }
+  return last;
+}
+
+/**
+ * Append the payload of `token` to that of a pending event of the trigger, as described for
+ * lf_action_set_batch_window.
+ * @return Whether the payload was appended, after which the caller is done with `token`.
+ */
+static bool append_to_batch(trigger_t* trigger, event_t* batch_event, lf_token_t* token) {
+  lf_token_t* batch = batch_event->token;
+  if (token == NULL || batch == NULL || batch == trigger->tmplt.token || batch->ref_count != 1 ||
+      batch->value_from_pool || batch->destructor != NULL || token->destructor != NULL || batch->type != token->type ||
+      batch->type->destructor != NULL || batch->type->copy_constructor != NULL) {
+    return false;
+  }
+  size_t element_size = batch->type->element_size;
+  void* value = realloc(batch->value, (batch->length + token->length) * element_size);
+  LF_ASSERT_NON_NULL(value);
+  memcpy((char*)value + batch->length * element_size, token->value, token->length * element_size);
+  batch->value = value;
+  batch->length += token->length;
+  return true;
+}
+
+/**
+ * Schedule the trigger as lf_schedule_trigger does. If the trigger is physical and
+ * `physical_time` is not NEVER, it is the physical time at which the event was staged,
+ * which is used instead of the current physical time.
+ */
+static trigger_handle_t schedule_trigger_at(environment_t* env, trigger_t* trigger, interval_t extra_delay,
+                                            lf_token_t* token, instant_t physical_time) {
   assert(env != GLOBAL_ENVIRONMENT);
-  if (lf_is_tag_after_stop_tag(env, env->current_tag)) {
+  // The tag of the calling reaction, which is later than that of the environment if it executes ahead.
+  tag_t current_tag = lf_tag(env);
+  if (lf_is_tag_after_stop_tag(env, current_tag)) {
     // If schedule is called after stop_tag
     // This is a critical condition.
     _lf_done_using(token);
@@ -128,7 +578,7 @@ trigger_handle_t lf_schedule_trigger(environment_t* env, trigger_t* trigger, int
 
   // Increment the reference count of the token.
   if (token != NULL) {
-    token->ref_count++;
+    _lf_token_add_reference(token);
     LF_PRINT_DEBUG("lf_schedule_trigger: Incremented ref_count of %p to %zu.", (void*)token, token->ref_count);
   }
 
@@ -149,10 +599,10 @@ trigger_handle_t lf_schedule_trigger(environment_t* env, trigger_t* trigger, int
   if (!trigger->is_timer) {
     delay += trigger->offset;
   }
-  tag_t intended_tag = lf_delay_tag(env->current_tag, delay);
+  tag_t intended_tag = lf_delay_tag(current_tag, delay);
 
-  LF_PRINT_DEBUG("lf_schedule_trigger: env->current_tag = " PRINTF_TAG ". Total logical delay = " PRINTF_TIME "",
-                 env->current_tag.time, env->current_tag.microstep, delay);
+  LF_PRINT_DEBUG("lf_schedule_trigger: current_tag = " PRINTF_TAG ". Total logical delay = " PRINTF_TIME "",
+                 current_tag.time, current_tag.microstep, delay);
   interval_t min_spacing = trigger->period;
 
   event_t* e = lf_get_new_event(env);
@@ -164,13 +614,43 @@ trigger_handle_t lf_schedule_trigger(environment_t* env, trigger_t* trigger, int
   // dequeued, it will trigger this trigger.
   e->trigger = trigger;
 
+#ifdef LF_LATENCY
+  // An event inherits the origin of the tag in which it is scheduled, unless it arrives now.
+  e->origin = env->latency_origin;
+#endif
+
   // If the trigger is physical, then we need to check whether
   // physical time is larger than the intended time and, if so,
   // modify the intended time.
   if (trigger->is_physical) {
     // Get the current physical time and assign it as the intended time.
-    intended_tag.time = lf_time_physical() + delay;
+    // Physical actions scheduled by different threads must get ordered tags.
+    instant_t now = physical_time;
+    if (now == NEVER) {
+      LF_ASSERTN(lf_clock_gettime_fenced(&now), "Failed to read physical clock.");
+    }
+    intended_tag.time = now + delay;
     intended_tag.microstep = 0;
+#ifdef LF_LATENCY
+    e->origin = now;
+#endif
+    // A staged event may be moved to the event queue after the tag has passed the time it was staged.
+    // It then gets the next microstep before the conflicts are resolved, so that events that
+    // were staged together do not all get that microstep.
+#ifdef LF_TAG_PIPELINING
+    // Nor may it get a tag that reactions have already started.
+    current_tag = lf_pipeline_latest_tag(env);
+#endif
+    if (lf_tag_compare(intended_tag, current_tag) <= 0) {
+      intended_tag = lf_delay_tag(current_tag, 0);
+    }
+    event_t* batch_event = batch_event_of(trigger, intended_tag.time);
+    if (batch_event != NULL && append_to_batch(trigger, batch_event, token)) {
+      LF_PRINT_DEBUG("lf_schedule_trigger: Appended the payload to the pending event of the batch.");
+      _lf_done_using(token);
+      lf_recycle_event(env, e);
+      return 0;
+    }
   } else {
 // FIXME: We need to verify that we are executing within a reaction?
 // See reactor_threaded.
@@ -181,11 +661,11 @@ trigger_handle_t lf_schedule_trigger(environment_t* env, trigger_t* trigger, int
 // - we have eliminated the possibility to have a negative additional delay; and
 // - we detect the asynchronous use of logical actions
 #ifndef NDEBUG
-    if (intended_tag.time < env->current_tag.time) {
+    if (intended_tag.time < current_tag.time) {
       lf_print_warning("Attempting to schedule an event earlier than current time by " PRINTF_TIME " nsec! "
                        "Revising to the current time " PRINTF_TIME ".",
-                       env->current_tag.time - intended_tag.time, env->current_tag.time);
-      intended_tag.time = env->current_tag.time;
+                       current_tag.time - intended_tag.time, current_tag.time);
+      intended_tag.time = current_tag.time;
     }
 #endif
   }
@@ -200,13 +680,13 @@ trigger_handle_t lf_schedule_trigger(environment_t* env, trigger_t* trigger, int
   if (min_spacing <= 0) {
     // No minimum spacing defined.
     e->base.tag = intended_tag;
-    event_t* found = (event_t*)pqueue_tag_find_equal_same_tag(env->event_q, (pqueue_tag_element_t*)e);
+    event_t* found = _lf_find_pending_event(trigger, intended_tag);
     // Check for conflicts. Let events pile up in super dense time.
     if (found != NULL) {
       while (found != NULL) {
         intended_tag.microstep++;
         e->base.tag = intended_tag;
-        found = (event_t*)pqueue_tag_find_equal_same_tag(env->event_q, (pqueue_tag_element_t*)e);
+        found = _lf_find_pending_event(trigger, intended_tag);
       }
       if (lf_is_tag_after_stop_tag(env, intended_tag)) {
         LF_PRINT_DEBUG("Attempt to schedule an event after stop_tag was rejected.");
@@ -216,7 +696,7 @@ trigger_handle_t lf_schedule_trigger(environment_t* env, trigger_t* trigger, int
         return 0;
       }
       trigger->last_tag = intended_tag;
-      pqueue_tag_insert(env->event_q, (pqueue_tag_element_t*)e);
+      _lf_enqueue_event(env, e);
       return (0); // FIXME: return value
     }
     // If there are not conflicts, schedule as usual. If intended time is
@@ -234,7 +714,7 @@ trigger_handle_t lf_schedule_trigger(environment_t* env, trigger_t* trigger, int
     // If the event is early, see which policy applies.
     if (earliest_time > intended_tag.time) {
       LF_PRINT_DEBUG("Event is early.");
-      event_t *dummy, *found;
+      event_t* found;
       switch (trigger->policy) {
       case drop:
         LF_PRINT_DEBUG("Policy is drop. Dropping the event.");
@@ -246,23 +726,17 @@ trigger_handle_t lf_schedule_trigger(environment_t* env, trigger_t* trigger, int
       case replace:
         LF_PRINT_DEBUG("Policy is replace. Replacing the previous event.");
         // If the event with the previous tag is still on the event
-        // queue, then replace the token.  To find this event, we have
-        // to construct a dummy event_t struct.
-        dummy = lf_get_new_event(env);
-        dummy->trigger = trigger;
-        dummy->base.tag = trigger->last_tag;
-        found = (event_t*)pqueue_tag_find_equal_same_tag(env->event_q, (pqueue_tag_element_t*)dummy);
+        // queue, then replace the token.
+        found = _lf_find_pending_event(trigger, trigger->last_tag);
 
         if (found != NULL) {
           // Recycle the existing token and the new event
           // and update the token of the existing event.
           lf_replace_token(found, token);
           lf_recycle_event(env, e);
-          lf_recycle_event(env, dummy);
           // Leave the last_tag the same.
           return (0);
         }
-        lf_recycle_event(env, dummy);
 
         // If the preceding event _has_ been handled, then adjust
         // the tag to defer the event.
@@ -281,14 +755,14 @@ trigger_handle_t lf_schedule_trigger(environment_t* env, trigger_t* trigger, int
 // FIXME: This is a development assertion and might
 // not be necessary for end-user LF programs
 #ifndef NDEBUG
-  if (intended_tag.time < env->current_tag.time) {
+  if (intended_tag.time < current_tag.time) {
     lf_print_error("Attempting to schedule an event earlier than current time by " PRINTF_TIME " nsec! "
                    "Revising to the current time " PRINTF_TIME ".",
-                   env->current_tag.time - intended_tag.time, env->current_tag.time);
-    intended_tag.time = env->current_tag.time;
+                   current_tag.time - intended_tag.time, current_tag.time);
+    intended_tag.time = current_tag.time;
   }
 #endif
-  if (lf_tag_compare(intended_tag, env->current_tag) == 0) {
+  if (lf_tag_compare(intended_tag, current_tag) == 0) {
     // Increment microstep.
     intended_tag.microstep++;
   }
@@ -314,9 +788,9 @@ trigger_handle_t lf_schedule_trigger(environment_t* env, trigger_t* trigger, int
   // Queue the event.
   LF_PRINT_LOG("Inserting event in the event queue with elapsed tag " PRINTF_TAG ".",
                e->base.tag.time - lf_time_start(), e->base.tag.microstep);
-  pqueue_tag_insert(env->event_q, (pqueue_tag_element_t*)e);
+  _lf_enqueue_event(env, e);
 
-  tracepoint_schedule(env, trigger, e->base.tag.time - env->current_tag.time);
+  tracepoint_schedule(env, trigger, e->base.tag.time - current_tag.time);
 
   // FIXME: make a record of handle and implement unschedule.
   // NOTE: Rather than wrapping around to get a negative number,
@@ -328,3 +802,155 @@ trigger_handle_t lf_schedule_trigger(environment_t* env, trigger_t* trigger, int
   }
   return return_value;
 }
+
+#if !defined(LF_SINGLE_THREADED)
+/**
+ * Drop or coalesce the pending events of the actions with an `lf_overload_drop_oldest` or
+ * `lf_overload_coalesce` policy beyond their capacity, or beyond one event while the
+ * environment sheds load. See lf_action_set_capacity.
+ */
+static void ingress_shed_locked(environment_t* env) {
+  for (lf_ingress_event_t* staged = env->ingress_pending; staged != NULL; staged = staged->next) {
+    if (staged->limit != NULL) {
+      staged->limit->listed = 0;
+      staged->limit->seen = 0;
+      staged->limit->survivor = NULL;
+    }
+  }
+  for (lf_ingress_event_t* staged = env->ingress_pending; staged != NULL; staged = staged->next) {
+    if (staged->limit != NULL) {
+      staged->limit->listed++;
+    }
+  }
+  lf_ingress_event_t** position = &env->ingress_pending;
+  lf_ingress_event_t* previous = NULL;
+  while (*position != NULL) {
+    lf_ingress_event_t* staged = *position;
+    lf_ingress_limit_t* limit = staged->limit;
+    bool dropped = false;
+    if (limit != NULL && limit->policy != lf_overload_reject) {
+      int64_t keep = env->ingress_shedding ? 1 : limit->capacity;
+      int64_t index = limit->seen++;
+      if (limit->policy == lf_overload_drop_oldest) {
+        dropped = index < limit->listed - keep;
+      } else if (limit->listed > keep) {
+        // Keep the first `keep` events, the last of which gets the payloads of the later ones in turn.
+        if (index == keep - 1) {
+          limit->survivor = staged;
+        } else if (index >= keep) {
+          lf_token_t* token = limit->survivor->token;
+          limit->survivor->token = staged->token;
+          staged->token = token;
+          dropped = true;
+        }
+      }
+    }
+    if (dropped) {
+      *position = staged->next;
+      if (staged == env->ingress_pending_last) {
+        env->ingress_pending_last = previous;
+      }
+      ingress_release(env, staged);
+      _lf_free_token(staged->token);
+      free(staged);
+      env->ingress_shed++;
+    } else {
+      previous = staged;
+      position = &staged->next;
+    }
+  }
+}
+
+void _lf_ingress_drain_locked(environment_t* env) {
+  lf_ingress_event_t* head;
+  do {
+    head = env->ingress;
+  } while (head != NULL && !ingress_cas(env, head, NULL));
+  // The last staged event is first. Sort the events by time, keeping the order in which
+  // they were staged for equal times. Events staged by one thread are already in order.
+  lf_ingress_event_t* sorted = NULL;
+  while (head != NULL) {
+    lf_ingress_event_t* staged = head;
+    head = head->next;
+    lf_ingress_event_t** position = &sorted;
+    while (*position != NULL && (*position)->time < staged->time) {
+      position = &(*position)->next;
+    }
+    staged->next = *position;
+    *position = staged;
+  }
+  // Merge them into the pending events, which are usually all earlier.
+  lf_ingress_event_t** position = &env->ingress_pending;
+  if (sorted != NULL && env->ingress_pending != NULL && env->ingress_pending_last->time <= sorted->time) {
+    position = &env->ingress_pending_last->next;
+  }
+  while (sorted != NULL) {
+    while (*position != NULL && (*position)->time <= sorted->time) {
+      position = &(*position)->next;
+    }
+    lf_ingress_event_t* staged = sorted;
+    sorted = staged->next;
+    staged->next = *position;
+    *position = staged;
+    if (staged->next == NULL) {
+      env->ingress_pending_last = staged;
+    }
+    position = &staged->next;
+  }
+  if (env->ingress_capacity > 0 || env->ingress_max_tag_lag != FOREVER) {
+    bool full = env->ingress_capacity > 0 && lf_atomic_load64(&env->ingress_count) > env->ingress_capacity;
+    env->ingress_shedding = full || (env->ingress_max_tag_lag != FOREVER &&
+                                     lf_time_physical() - env->current_tag.time > env->ingress_max_tag_lag);
+    if (env->ingress_shedding) {
+      env->ingress_overloaded = true;
+    }
+  }
+  if (env->ingress_overloaded) {
+    env->ingress_overloaded = false;
+    ingress_shed_locked(env);
+  }
+  // An event gets a tag no earlier than the time at which it was staged. Schedule the pending
+  // events only until the first of them can come after the head of the event queue, so that
+  // the event queue stays small, and searching it for conflicting events fast, when many events
+  // are pending, unless the event is appended to a pending event of a batching action.
+  while (env->ingress_pending != NULL) {
+    event_t* next = (event_t*)pqueue_tag_peek(env->event_q);
+    lf_ingress_event_t* staged = env->ingress_pending;
+    if (next != NULL && staged->time > next->base.tag.time &&
+        batch_event_of(staged->trigger, staged->time + staged->trigger->offset + staged->extra_delay) == NULL) {
+      break;
+    }
+    env->ingress_pending = staged->next;
+    ingress_release(env, staged);
+    schedule_trigger_at(env, staged->trigger, staged->extra_delay, staged->token, staged->time);
+    free(staged);
+  }
+}
+#endif // !defined(LF_SINGLE_THREADED)
+
+#if defined(LF_SINGLE_THREADED)
+void _lf_isr_rings_drain_locked(environment_t* env) {
+  for (lf_isr_ring_t* ring = env->isr_rings; ring != NULL; ring = ring->next) {
+    lf_isr_index_t head = ring->head;
+    ISR_RING_FENCE();
+    for (lf_isr_index_t tail = ring->tail; tail != head; tail++) {
+      isr_slot_t* slot = isr_slot(ring, tail);
+      lf_token_t* token = NULL;
+      if (slot->has_value) {
+        token_template_t* template = (token_template_t*)ring->action;
+        token = _lf_initialize_token(template, 1);
+        memcpy(token->value, slot + 1, template->type.element_size);
+      }
+      schedule_trigger_at(env, ring->action->trigger, 0, token, slot->time);
+      // Free the slot only after it has been read.
+      ISR_RING_FENCE();
+      ring->tail = (lf_isr_index_t)(tail + 1);
+    }
+  }
+}
+#endif // defined(LF_SINGLE_THREADED)
+
+trigger_handle_t lf_schedule_trigger(environment_t* env, trigger_t* trigger, interval_t extra_delay,
+                                     lf_token_t* token) {
+  return schedule_trigger_at(env, trigger, extra_delay, token, NEVER);
+}
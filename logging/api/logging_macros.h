@@ -12,6 +12,16 @@
 #define LOG_LEVEL LOG_LEVEL_INFO
 #endif
 
+/**
+ * With LF_MINIMAL_FOOTPRINT defined, LF_PRINT_LOG and LF_PRINT_DEBUG compile to
+ * nothing, whatever LOG_LEVEL and the optimization level are, so that neither their
+ * format strings nor the code that formats their arguments end up in the binary.
+ * This is meant for embedded targets where flash is scarce. The call is kept as
+ * the operand of sizeof, which is not evaluated, so that the compiler still checks
+ * it and variables used only in log messages do not become unused.
+ */
+#define LF_DISCARD_PRINT(call) ((void)sizeof((call), 0))
+
 /**
  * A macro used to print useful logging information. It can be enabled
  * by setting the target property 'logging' to 'LOG' or
@@ -29,12 +39,16 @@
  * (e.g., -O2 for gcc) is used as long as the arguments passed to
  * it do not themselves incur significant overhead to evaluate.
  */
+#if defined(LF_MINIMAL_FOOTPRINT)
+#define LF_PRINT_LOG(format, ...) LF_DISCARD_PRINT(lf_print_log(format, ##__VA_ARGS__))
+#else
 #define LF_PRINT_LOG(format, ...)                                                                                      \
   do {                                                                                                                 \
     if (LOG_LEVEL >= LOG_LEVEL_LOG) {                                                                                  \
       lf_print_log(format, ##__VA_ARGS__);                                                                             \
     }                                                                                                                  \
   } while (0)
+#endif // LF_MINIMAL_FOOTPRINT
 
 /**
  * A macro used to print useful debug information. It can be enabled
@@ -52,12 +66,16 @@
  * (e.g., -O2 for gcc) is used as long as the arguments passed to
  * it do not themselves incur significant overhead to evaluate.
  */
+#if defined(LF_MINIMAL_FOOTPRINT)
+#define LF_PRINT_DEBUG(format, ...) LF_DISCARD_PRINT(lf_print_debug(format, ##__VA_ARGS__))
+#else
 #define LF_PRINT_DEBUG(format, ...)                                                                                    \
   do {                                                                                                                 \
     if (LOG_LEVEL >= LOG_LEVEL_DEBUG) {                                                                                \
       lf_print_debug(format, ##__VA_ARGS__);                                                                           \
     }                                                                                                                  \
   } while (0)
+#endif // LF_MINIMAL_FOOTPRINT
 
 /**
  * Assertion handling. LF_ASSERT can be used as a shorthand for verifying
@@ -77,6 +95,26 @@
 #define LF_ASSERT(condition, format, ...) (void)(condition)
 #define LF_ASSERTN(condition, format, ...) (void)(condition)
 #define LF_ASSERT_NON_NULL(pointer) (void)(pointer)
+#elif defined(LF_MINIMAL_FOOTPRINT)
+// The condition is still checked, but the message, the condition, and the file name are not kept.
+#define LF_ASSERT(condition, format, ...)                                                                              \
+  do {                                                                                                                 \
+    if (!(condition)) {                                                                                                \
+      lf_print_error_and_exit("Failed assertion on line %d.", __LINE__);                                               \
+    }                                                                                                                  \
+  } while (0)
+#define LF_ASSERTN(condition, format, ...)                                                                             \
+  do {                                                                                                                 \
+    if (condition) {                                                                                                   \
+      lf_print_error_and_exit("Failed assertion on line %d.", __LINE__);                                               \
+    }                                                                                                                  \
+  } while (0)
+#define LF_ASSERT_NON_NULL(pointer)                                                                                    \
+  do {                                                                                                                 \
+    if (!(pointer)) {                                                                                                  \
+      lf_print_error_and_exit("Out of memory on line %d.", __LINE__);                                                  \
+    }                                                                                                                  \
+  } while (0)
 #else
 #define LF_ASSERT(condition, format, ...)                                                                              \
   do {                                                                                                                 \
@@ -142,6 +142,13 @@ int lf_thread_create(lf_thread_t* thread, void* (*lf_thread)(void*), void* argum
  */
 int lf_thread_join(lf_thread_t thread, void** thread_return);
 
+/**
+ * @brief Yield the processor to other threads that are ready to run.
+ *
+ * @return 0 on success, platform-specific error number otherwise.
+ */
+int lf_thread_yield(void);
+
 /**
  * @brief The thread scheduling policies.
  */
@@ -279,6 +286,52 @@ int lf_thread_id();
 void initialize_lf_thread_id();
 #endif // !defined(LF_SINGLE_THREADED)
 
+#ifdef LF_LOW_POWER_SLEEP
+/*
+ * Low-power sleep, which the nRF52, RP2040 and Arduino platforms support. When the runtime sleeps
+ * until the tag of the next event and the sleep is at least LF_LOW_POWER_SLEEP_THRESHOLD, the chip
+ * stops its high-frequency clocks until a low-power timer, or the interrupt of an asynchronous
+ * event, wakes it. On Arduino, the CPU idles instead, until the tick of the timer of the Arduino
+ * core or another interrupt wakes it. It is woken early by the wake-up latency, which is
+ * calibrated on every wake-up, and waits out the rest of the sleep as usual.
+ */
+#if !defined(PLATFORM_NRF52) && !defined(PLATFORM_RP2040) && !defined(PLATFORM_ARDUINO)
+#error "LF_LOW_POWER_SLEEP is only supported on nRF52, RP2040 and Arduino"
+#endif
+#if !defined(LF_SINGLE_THREADED)
+#error "LF_LOW_POWER_SLEEP requires the single-threaded runtime"
+#endif
+
+/** The shortest sleep for which the chip enters its low-power state. */
+#ifndef LF_LOW_POWER_SLEEP_THRESHOLD
+#define LF_LOW_POWER_SLEEP_THRESHOLD MSEC(2)
+#endif
+
+/** The estimate of the wake-up latency before the first wake-up has been measured. */
+#ifndef LF_LOW_POWER_SLEEP_INITIAL_LATENCY
+#if defined(PLATFORM_ARDUINO)
+// The tick of the Arduino core comes about every millisecond, 1.024 ms on AVR boards.
+#define LF_LOW_POWER_SLEEP_INITIAL_LATENCY USEC(1100)
+#else
+#define LF_LOW_POWER_SLEEP_INITIAL_LATENCY USEC(200)
+#endif
+#endif
+
+/**
+ * @brief Return the current estimate of the time from the end of a low-power sleep to the
+ * moment the program runs again with its clock.
+ */
+interval_t lf_low_power_sleep_latency(void);
+
+/**
+ * @brief Update the estimate of the wake-up latency with a measurement. The estimate rises
+ * quickly and falls slowly, so that few sleeps end late.
+ * @param measured The time from the intended end of a low-power sleep to the moment the
+ * program ran again.
+ */
+void _lf_low_power_sleep_calibrate(interval_t measured);
+#endif // LF_LOW_POWER_SLEEP
+
 /**
  * Initialize the LF clock. Must be called before using other clock-related APIs.
  */
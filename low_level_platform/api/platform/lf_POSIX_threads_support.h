@@ -37,6 +37,24 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <pthread.h>
 
+/*
+ * Options for the mutexes and condition variables of the threaded runtime:
+ *
+ * LF_MUTEX_NORMAL: Mutexes are normal rather than recursive, which makes them cheaper to lock
+ * and unlock. The runtime itself never locks a mutex that it already holds, but reactions
+ * or platform code that do so would deadlock. Unless NDEBUG is defined, the mutexes check for
+ * such relocking instead, and lf_mutex_lock returns EDEADLK.
+ *
+ * LF_MUTEX_PRIORITY_INHERIT: A thread that holds a mutex runs at the highest priority of the
+ * threads waiting for it, so that a worker given a real-time priority with
+ * lf_thread_set_priority is not held up by a lower priority thread holding the mutex of the
+ * environment. Contended locks then always go through the kernel.
+ *
+ * LF_COND_MONOTONIC: Timed waits on condition variables are measured with CLOCK_MONOTONIC,
+ * so that they are not lengthened or shortened when the system clock is set. This is
+ * ignored on macOS, which does not support it.
+ */
+
 typedef pthread_mutex_t lf_mutex_t;
 typedef struct {
   lf_mutex_t* mutex;
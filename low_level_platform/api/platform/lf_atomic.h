@@ -20,6 +20,16 @@
  */
 int32_t lf_atomic_fetch_add32(int32_t* ptr, int32_t val);
 
+/**
+ * @brief Atomically load a 64-bit integer from memory without writing to it.
+ * Unlike lf_atomic_fetch_add64 with a value of 0, this does not take exclusive
+ * ownership of the cache line, so it does not slow down other threads reading it.
+ *
+ * @param ptr A pointer to the memory location.
+ * @return The value in memory.
+ */
+int64_t lf_atomic_load64(int64_t* ptr);
+
 /**
  * @brief Atomically fetch 64-bit integer from memory and add a value to it.
  * Return the value that was previously in memory.
@@ -57,6 +57,19 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //     printf("Tag is " PRINTF_TAG "\n", time_value, microstep);
 #define PRINTF_TAG "(%" PRId64 ", %" PRIu32 ")"
 
+/**
+ * Bit i of LF_FLEXPRET_SOFT_THREADS selects whether the i-th thread created by lf_thread_create,
+ * which for the workers is worker i, runs as a soft real-time thread (SRTT), which also uses the
+ * slots that other threads leave idle, rather than a hard real-time thread (HRTT), which runs
+ * only in its own slots and so has cycle-predictable timing. By default, all threads are hard.
+ *
+ * If LF_FLEXPRET_SLOTS is defined, it is written to the slots CSR before the first thread is
+ * created, to allocate the scheduling slots of the core to the hardware threads.
+ */
+#ifndef LF_FLEXPRET_SOFT_THREADS
+#define LF_FLEXPRET_SOFT_THREADS 0
+#endif
+
 #if !defined(LF_SINGLE_THREADED)
 typedef fp_lock_t lf_mutex_t;
 typedef fp_thread_t lf_thread_t;
@@ -32,6 +32,8 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef LF_LINUX_SUPPORT_H
 #define LF_LINUX_SUPPORT_H
 
+#include <stdbool.h>
+#include <stddef.h> // For size_t
 #include <stdint.h> // For fixed-width integral types
 #include <time.h>   // For CLOCK_MONOTONIC
 #include <unistd.h> // _POSIX_TIMERS _POSIX_CLOCK_MONOTONIC
@@ -47,4 +49,125 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #error Linux platform misses clock support
 #endif
 
+/**
+ * @brief Set the timer slack of the calling thread, by which the kernel may delay
+ * its timed waits to combine wakeups.
+ * @param slack The timer slack in nanoseconds, or 0 to restore the default slack of the thread.
+ * @return 0 on success, -1 otherwise.
+ */
+int lf_thread_set_timer_slack(int64_t slack);
+
+/**
+ * @brief Lock the pages of the process in memory, including those it maps in the future,
+ * and prefault a heap of the given size so that later allocations up to that size take
+ * no page faults. The allocator is configured to neither return the heap to the system
+ * nor serve large allocations with separate mappings.
+ * @param budget The number of bytes of heap to prefault.
+ * @param huge_pages Whether to ask for the heap to be backed by transparent huge pages.
+ * @return 0 on success, -1 if the pages could not be locked or the heap could not be allocated.
+ */
+int lf_memory_lock(size_t budget, bool huge_pages);
+
+/**
+ * @brief Return the number of page faults taken by the process so far, or -1 if unknown.
+ */
+long lf_page_faults(void);
+
+/**
+ * @brief Return the number of cores that the process can keep busy, which is the number of
+ * online cores, limited by the CPU affinity of the process and by the CPU bandwidth quota of
+ * its cgroup (v2 or v1), rounded up. The quota is read anew on each call, so it may change.
+ * @return The number of cores, at least 1.
+ */
+int lf_cpu_quota_cores(void);
+
+/**
+ * @brief Allocate a buffer of the given size whose pages can be shared copy-on-write with
+ * copies made by lf_cow_clone(). The buffer is backed by an anonymous file and preceded by
+ * a page of bookkeeping, so it only pays off for large buffers. Its pages must not be
+ * modified while any clone of it is alive.
+ * @param size The size of the buffer in bytes.
+ * @return The buffer, or NULL if it could not be allocated.
+ */
+void* lf_cow_alloc(size_t size);
+
+/**
+ * @brief Return a private copy of a buffer allocated with lf_cow_alloc() that shares its
+ * pages until they are written, or a full copy if the buffer is itself a clone.
+ * @param value The buffer to copy.
+ * @return The copy, to be released with lf_cow_free(), or NULL if it could not be made.
+ */
+void* lf_cow_clone(void* value);
+
+/**
+ * @brief Duplicate the pages of a clone that overlap the given range, so that writing
+ * it takes no page faults.
+ * @param value A buffer returned by lf_cow_clone().
+ * @param offset The offset of the range in bytes.
+ * @param size The size of the range in bytes.
+ */
+void lf_cow_unshare(void* value, size_t offset, size_t size);
+
+/**
+ * @brief Release a buffer returned by lf_cow_alloc() or lf_cow_clone().
+ */
+void lf_cow_free(void* value);
+
+/**
+ * The number of hardware counters read by lf_perf_counters_read(), which are, in order,
+ * CPU cycles, retired instructions, last-level cache misses and branch misses.
+ */
+#define LF_PERF_COUNTERS 4
+
+/**
+ * @brief Open a group of hardware performance counters that count the user-space execution
+ * of the calling thread, on whichever CPU it runs. The group is pinned, so the counters are
+ * never multiplexed with other events.
+ * @return A descriptor of the group to pass to lf_perf_counters_read(), or -1 if the CPU
+ * or the kernel does not provide all counters or perf_event_paranoid does not permit them.
+ */
+int lf_perf_counters_open(void);
+
+/**
+ * @brief Read all counters of a group opened by the calling thread with one system call.
+ * @param group The descriptor returned by lf_perf_counters_open().
+ * @param values Where to store the LF_PERF_COUNTERS values.
+ * @return 0 on success, -1 if the counters could not be read.
+ */
+int lf_perf_counters_read(int group, uint64_t* values);
+
+/**
+ * @brief Block the calling thread, if the word at `address` holds `expected`, until lf_futex_wake()
+ * is called on the same word with a mask that shares a bit with `mask`. The thread may also wake
+ * spuriously, so the caller must check the condition it waits for again.
+ * @param address The word, shared by the threads of the process.
+ * @param expected The value that the word must hold for the thread to block.
+ * @param mask The nonzero set of bits that selects which calls to lf_futex_wake() wake the thread.
+ * @return 0 when woken, or -1 if the word did not hold `expected` or the wait was interrupted.
+ */
+int lf_futex_wait(volatile uint32_t* address, uint32_t expected, uint32_t mask);
+
+/**
+ * @brief Wake, with one system call, all the threads blocked in lf_futex_wait() on the word at
+ * `address` whose mask shares a bit with `mask`.
+ * @param address The word.
+ * @param mask The nonzero set of bits that selects the threads to wake.
+ * @return The number of threads woken, or -1 on error.
+ */
+int lf_futex_wake(volatile uint32_t* address, uint32_t mask);
+
+/**
+ * @brief Ask the CPUs to run the program at a fraction of their maximum performance.
+ *
+ * If the cpufreq governor of the first CPU is `userspace`, the frequency of each CPU is set
+ * through `scaling_setspeed` to the given fraction of the way from its minimum to its maximum
+ * frequency, which requires write access to sysfs. Otherwise, the maximum utilization clamp
+ * of each thread of the process is set to the fraction, which the `schedutil` governor takes
+ * as the highest utilization that those threads ask of the CPU, and which threads started
+ * later inherit from the thread that starts them.
+ * @param percent The fraction of the maximum performance, from 1 to 100 percent.
+ * @return 0 on success, -1 if neither way is available.
+ */
+int lf_cpu_set_performance(int percent);
+
 #endif // LF_LINUX_SUPPORT_H
@@ -16,3 +16,24 @@ instant_t convert_timespec_to_ns(struct timespec tp);
  * @return _lf_time_spec_t representation of 't'.
  */
 struct timespec convert_ns_to_timespec(instant_t t);
+
+/**
+ * @brief Convert a time of the physical clock to a time of CLOCK_REALTIME.
+ *
+ * These differ only if the physical clock is a PTP hardware clock (see LF_CLOCK_PHC_INDEX),
+ * in which case the result uses the current difference between the two clocks. This is
+ * needed for absolute timeouts of functions that measure time with CLOCK_REALTIME.
+ *
+ * @return The time of CLOCK_REALTIME that corresponds to 't'.
+ */
+instant_t convert_clock_to_realtime(instant_t t);
+
+/**
+ * @brief Convert a time of the physical clock to a time of CLOCK_MONOTONIC.
+ *
+ * The result uses the current difference between the two clocks. This is needed for absolute
+ * timeouts of condition variables that measure time with CLOCK_MONOTONIC (see LF_COND_MONOTONIC).
+ *
+ * @return The time of CLOCK_MONOTONIC that corresponds to 't'.
+ */
+instant_t convert_clock_to_monotonic(instant_t t);
@@ -4,10 +4,18 @@
 #include "platform/lf_unix_clock_support.h"
 
 #include <pthread.h>
+#include <sched.h>
 #include <errno.h>
 #include <stdint.h> // For fixed-width integral types
 #include <unistd.h>
 
+// Whether condition variables measure timed waits with CLOCK_MONOTONIC. See LF_COND_MONOTONIC.
+#if defined(LF_COND_MONOTONIC) && !defined(PLATFORM_Darwin)
+#define COND_MONOTONIC 1
+#else
+#define COND_MONOTONIC 0
+#endif
+
 int lf_available_cores() { return (int)sysconf(_SC_NPROCESSORS_ONLN); }
 
 int lf_thread_create(lf_thread_t* thread, void* (*lf_thread)(void*), void* arguments) {
@@ -18,10 +26,17 @@ lf_thread_t lf_thread_self() { return pthread_self(); }
 
 int lf_thread_join(lf_thread_t thread, void** thread_return) { return pthread_join((pthread_t)thread, thread_return); }
 
+int lf_thread_yield(void) { return sched_yield(); }
+
 int lf_mutex_init(lf_mutex_t* mutex) {
-  // Set up a recursive mutex
   pthread_mutexattr_t attr;
   pthread_mutexattr_init(&attr);
+#if defined(LF_MUTEX_NORMAL) && defined(NDEBUG)
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_NORMAL);
+#elif defined(LF_MUTEX_NORMAL)
+  // Report relocking by the thread that holds the mutex rather than deadlocking.
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#else
   // Initialize the mutex to be recursive, meaning that it is OK
   // for the same thread to lock and unlock the mutex even if it already holds
   // the lock.
@@ -34,7 +49,16 @@ int lf_mutex_init(lf_mutex_t* mutex) {
   // of the predicate.”  This seems like a bug in the implementation of
   // pthreads. Maybe it has been fixed?
   pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
-  return pthread_mutex_init((pthread_mutex_t*)mutex, &attr);
+#endif
+  int result = 0;
+#ifdef LF_MUTEX_PRIORITY_INHERIT
+  result = pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+#endif
+  if (result == 0) {
+    result = pthread_mutex_init((pthread_mutex_t*)mutex, &attr);
+  }
+  pthread_mutexattr_destroy(&attr);
+  return result;
 }
 
 int lf_mutex_lock(lf_mutex_t* mutex) { return pthread_mutex_lock((pthread_mutex_t*)mutex); }
@@ -47,7 +71,12 @@ int lf_cond_init(lf_cond_t* cond, lf_mutex_t* mutex) {
   pthread_condattr_init(&cond_attr);
   // Limit the scope of the condition variable to this process (default)
   pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_PRIVATE);
-  return pthread_cond_init(&cond->condition, &cond_attr);
+#if COND_MONOTONIC
+  pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+#endif
+  int result = pthread_cond_init(&cond->condition, &cond_attr);
+  pthread_condattr_destroy(&cond_attr);
+  return result;
 }
 
 int lf_cond_broadcast(lf_cond_t* cond) { return pthread_cond_broadcast((pthread_cond_t*)&cond->condition); }
@@ -59,7 +88,11 @@ int lf_cond_wait(lf_cond_t* cond) {
 }
 
 int _lf_cond_timedwait(lf_cond_t* cond, instant_t wakeup_time) {
-  struct timespec timespec_absolute_time = convert_ns_to_timespec(wakeup_time);
+#if COND_MONOTONIC
+  struct timespec timespec_absolute_time = convert_ns_to_timespec(convert_clock_to_monotonic(wakeup_time));
+#else
+  struct timespec timespec_absolute_time = convert_ns_to_timespec(convert_clock_to_realtime(wakeup_time));
+#endif
   int return_value =
       pthread_cond_timedwait((pthread_cond_t*)&cond->condition, (pthread_mutex_t*)cond->mutex, &timespec_absolute_time);
   switch (return_value) {
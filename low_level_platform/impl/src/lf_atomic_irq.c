@@ -17,77 +17,103 @@
 int lf_disable_interrupts_nested();
 int lf_enable_interrupts_nested();
 
+#if defined(PLATFORM_FLEXPRET) && !defined(LF_SINGLE_THREADED)
+// Disabling interrupts only excludes the calling hardware thread, so the operations of the other
+// hardware threads of FlexPRET are excluded with a hardware lock of the core.
+static fp_lock_t atomic_lock = FP_LOCK_INITIALIZER;
+#define ATOMIC_BEGIN()                                                                                                 \
+  do {                                                                                                                 \
+    lf_disable_interrupts_nested();                                                                                    \
+    fp_lock_acquire(&atomic_lock);                                                                                     \
+  } while (0)
+#define ATOMIC_END()                                                                                                   \
+  do {                                                                                                                 \
+    fp_lock_release(&atomic_lock);                                                                                     \
+    lf_enable_interrupts_nested();                                                                                     \
+  } while (0)
+#else
+#define ATOMIC_BEGIN() lf_disable_interrupts_nested()
+#define ATOMIC_END() lf_enable_interrupts_nested()
+#endif
+
 int32_t lf_atomic_fetch_add32(int32_t* ptr, int32_t value) {
-  lf_disable_interrupts_nested();
+  ATOMIC_BEGIN();
   int32_t res = *ptr;
   *ptr += value;
-  lf_enable_interrupts_nested();
+  ATOMIC_END();
+  return res;
+}
+
+int64_t lf_atomic_load64(int64_t* ptr) {
+  ATOMIC_BEGIN();
+  int64_t res = *ptr;
+  ATOMIC_END();
   return res;
 }
 
 int64_t lf_atomic_fetch_add64(int64_t* ptr, int64_t value) {
-  lf_disable_interrupts_nested();
+  ATOMIC_BEGIN();
   int64_t res = *ptr;
   *ptr += value;
-  lf_enable_interrupts_nested();
+  ATOMIC_END();
   return res;
 }
 
 int32_t lf_atomic_add_fetch32(int32_t* ptr, int32_t value) {
-  lf_disable_interrupts_nested();
+  ATOMIC_BEGIN();
   int res = *ptr + value;
   *ptr = res;
-  lf_enable_interrupts_nested();
+  ATOMIC_END();
   return res;
 }
 
 int64_t lf_atomic_add_fetch64(int64_t* ptr, int64_t value) {
-  lf_disable_interrupts_nested();
+  ATOMIC_BEGIN();
   int64_t res = *ptr + value;
   *ptr = res;
-  lf_enable_interrupts_nested();
+  ATOMIC_END();
   return res;
 }
 
 bool lf_atomic_bool_compare_and_swap32(int32_t* ptr, int32_t oldval, int32_t newval) {
-  lf_disable_interrupts_nested();
+  ATOMIC_BEGIN();
   bool res = false;
   if ((*ptr) == oldval) {
     *ptr = newval;
     res = true;
   }
-  lf_enable_interrupts_nested();
+  ATOMIC_END();
   return res;
 }
 
 bool lf_atomic_bool_compare_and_swap64(int64_t* ptr, int64_t oldval, int64_t newval) {
-  lf_disable_interrupts_nested();
+  ATOMIC_BEGIN();
   bool res = false;
   if ((*ptr) == oldval) {
     *ptr = newval;
     res = true;
   }
-  lf_enable_interrupts_nested();
+  ATOMIC_END();
   return res;
 }
 
 int32_t lf_atomic_val_compare_and_swap32(int32_t* ptr, int32_t oldval, int32_t newval) {
-  lf_disable_interrupts_nested();
+  ATOMIC_BEGIN();
   int res = *ptr;
   if ((*ptr) == oldval) {
     *ptr = newval;
   }
-  lf_enable_interrupts_nested();
+  ATOMIC_END();
   return res;
 }
 
 int64_t lf_atomic_val_compare_and_swap64(int64_t* ptr, int64_t oldval, int64_t newval) {
-  lf_disable_interrupts_nested();
+  ATOMIC_BEGIN();
   int64_t res = *ptr;
   if ((*ptr) == oldval) {
     *ptr = newval;
   }
-  lf_enable_interrupts_nested();
+  ATOMIC_END();
   return res;
 }
 
@@ -11,6 +11,14 @@
 #include <windows.h>
 
 int32_t lf_atomic_fetch_add32(int32_t* ptr, int32_t value) { return InterlockedExchangeAdd(ptr, value); }
+int64_t lf_atomic_load64(int64_t* ptr) {
+#if defined(_WIN64)
+  // Aligned 64-bit reads are atomic on 64-bit Windows.
+  return *(volatile int64_t*)ptr;
+#else
+  return InterlockedCompareExchange64(ptr, 0, 0);
+#endif
+}
 int64_t lf_atomic_fetch_add64(int64_t* ptr, int64_t value) { return InterlockedExchangeAdd64(ptr, value); }
 int32_t lf_atomic_add_fetch32(int32_t* ptr, int32_t value) { return InterlockedAdd(ptr, value); }
 int64_t lf_atomic_add_fetch64(int64_t* ptr, int64_t value) { return InterlockedAdd64(ptr, value); }
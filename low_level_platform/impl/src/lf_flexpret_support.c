@@ -184,15 +184,31 @@ lf_thread_t lf_thread_self() {
 }
 
 int lf_thread_create(lf_thread_t* thread, void* (*lf_thread)(void*), void* arguments) {
-  /**
-   * Need to select between HRTT or SRTT; see
-   * https://github.com/lf-lang/reactor-c/issues/421
-   */
-  return fp_thread_create(HRTT, thread, lf_thread, arguments);
+  // Threads are numbered in the order of their creation, which for the workers is their order.
+  static int threads_created = 0;
+#ifdef LF_FLEXPRET_SLOTS
+  if (threads_created == 0) {
+    write_csr(CSR_SLOTS, LF_FLEXPRET_SLOTS);
+  }
+#endif
+  bool hard = ((LF_FLEXPRET_SOFT_THREADS >> threads_created) & 1) == 0;
+  threads_created++;
+  return fp_thread_create(hard ? HRTT : SRTT, thread, lf_thread, arguments);
 }
 
 int lf_thread_join(lf_thread_t thread, void** thread_return) { return fp_thread_join(thread, thread_return); }
 
+int lf_thread_set_cpu(lf_thread_t thread, size_t cpu_number) {
+  // Each thread runs on the hardware thread that fp_thread_create assigned to it for its
+  // whole life, and its ID is the number of that hardware thread.
+  return ((size_t)thread == cpu_number) ? 0 : -1;
+}
+
+int lf_thread_yield(void) {
+  // Not implemented.
+  return 0;
+}
+
 int lf_mutex_init(lf_mutex_t* mutex) {
   *mutex = (lf_mutex_t)FP_LOCK_INITIALIZER;
   return 0;
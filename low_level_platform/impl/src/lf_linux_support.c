@@ -40,6 +40,20 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "platform/lf_unix_clock_support.h"
 
+#include <malloc.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <linux/futex.h>
+#include <linux/perf_event.h>
+
 #if defined LF_SINGLE_THREADED
 #include "lf_os_single_threaded_support.c"
 #else
@@ -153,4 +167,316 @@ int _lf_interruptable_sleep_until_locked(environment_t* env, instant_t wakeup_ti
 }
 
 int lf_nanosleep(interval_t sleep_duration) { return lf_sleep(sleep_duration); }
+
+int lf_thread_set_timer_slack(interval_t slack) {
+  return prctl(PR_SET_TIMERSLACK, (unsigned long)(slack > 0 ? slack : 0), 0, 0, 0) == 0 ? 0 : -1;
+}
+
+int lf_memory_lock(size_t budget, bool huge_pages) {
+  // Keep freed memory in the heap, and serve large allocations from it, so that the
+  // prefaulted pages are reused. A single arena keeps all threads on those pages.
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_MMAP_MAX, 0);
+  mallopt(M_ARENA_MAX, 1);
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    return -1;
+  }
+  if (budget == 0) {
+    return 0;
+  }
+  char* heap = (char*)malloc(budget);
+  if (heap == NULL) {
+    return -1;
+  }
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (huge_pages) {
+    // madvise needs an aligned range, so only the huge pages that lie entirely inside the heap are advised.
+    const uintptr_t huge_page_size = 2 * 1024 * 1024;
+    uintptr_t start = ((uintptr_t)heap + huge_page_size - 1) & ~(huge_page_size - 1);
+    uintptr_t end = ((uintptr_t)heap + budget) & ~(huge_page_size - 1);
+    if (end > start) {
+      madvise((void*)start, end - start, MADV_HUGEPAGE);
+    }
+  }
+  // With MCL_FUTURE, the pages are normally faulted in by malloc already. Touch them in case they are not.
+  for (size_t i = 0; i < budget; i += (size_t)page_size) {
+    ((volatile char*)heap)[i] = 0;
+  }
+  free(heap);
+  return 0;
+}
+
+long lf_page_faults(void) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return -1;
+  }
+  return usage.ru_minflt + usage.ru_majflt;
+}
+
+/**
+ * Read the CPU bandwidth limit of the cgroup of the process, from cgroup v2 or, failing that, v1.
+ * Return false if there is no limit.
+ */
+static bool lf_cgroup_cpu_limit(long long* quota, long long* period) {
+  FILE* file = fopen("/sys/fs/cgroup/cpu.max", "r");
+  if (file != NULL) {
+    char max[32];
+    bool limited = fscanf(file, "%31s %lld", max, period) == 2 && strcmp(max, "max") != 0;
+    fclose(file);
+    *quota = limited ? atoll(max) : -1;
+    return limited;
+  }
+  file = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r");
+  if (file == NULL) {
+    return false;
+  }
+  bool limited = fscanf(file, "%lld", quota) == 1 && *quota > 0;
+  fclose(file);
+  file = fopen("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r");
+  if (file == NULL) {
+    return false;
+  }
+  limited = fscanf(file, "%lld", period) == 1 && limited;
+  fclose(file);
+  return limited;
+}
+
+int lf_cpu_quota_cores(void) {
+  int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  cpu_set_t cpu_set;
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0 && CPU_COUNT(&cpu_set) < cores) {
+    cores = CPU_COUNT(&cpu_set);
+  }
+  long long quota, period;
+  if (lf_cgroup_cpu_limit(&quota, &period) && quota > 0 && period > 0) {
+    // A quota of 1.5 periods keeps two cores partly busy.
+    long long quota_cores = (quota + period - 1) / period;
+    if (quota_cores < cores) {
+      cores = (int)quota_cores;
+    }
+  }
+  return cores > 0 ? cores : 1;
+}
+
+/** Bookkeeping in the page that precedes a copy-on-write buffer. */
+typedef struct {
+  /** The file that backs the buffer, or -1 if the buffer is a private clone. */
+  int fd;
+  /** The size of the buffer in bytes. */
+  size_t size;
+} lf_cow_header_t;
+
+static lf_cow_header_t* lf_cow_header(void* value) { return (lf_cow_header_t*)((char*)value - sysconf(_SC_PAGESIZE)); }
+
+void* lf_cow_alloc(size_t size) {
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  int fd = memfd_create("lf_cow", MFD_CLOEXEC);
+  if (fd < 0) {
+    return NULL;
+  }
+  char* base = MAP_FAILED;
+  if (ftruncate(fd, (off_t)(page_size + size)) == 0) {
+    base = (char*)mmap(NULL, page_size + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  if (base == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+  lf_cow_header_t* header = (lf_cow_header_t*)base;
+  header->fd = fd;
+  header->size = size;
+  return base + page_size;
+}
+
+void* lf_cow_clone(void* value) {
+  lf_cow_header_t* header = lf_cow_header(value);
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  if (header->fd < 0) {
+    // The pages of a clone that were written are not in the file, so a clone of it is a full copy.
+    void* copy = lf_cow_alloc(header->size);
+    if (copy != NULL) {
+      memcpy(copy, value, header->size);
+    }
+    return copy;
+  }
+  char* base = (char*)mmap(NULL, page_size + header->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, header->fd, 0);
+  if (base == MAP_FAILED) {
+    return NULL;
+  }
+  // This duplicates the page of bookkeeping only.
+  ((lf_cow_header_t*)base)->fd = -1;
+  return base + page_size;
+}
+
+void lf_cow_unshare(void* value, size_t offset, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  volatile char* bytes = (volatile char*)value;
+  // Rewriting a byte of each page makes the kernel duplicate it.
+  for (size_t i = offset - (offset % page_size); i < offset + size; i += page_size) {
+    size_t index = i > offset ? i : offset;
+    bytes[index] = bytes[index];
+  }
+}
+
+void lf_cow_free(void* value) {
+  lf_cow_header_t* header = lf_cow_header(value);
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  // Clones that share the pages keep the file alive after it is closed.
+  if (header->fd >= 0) {
+    close(header->fd);
+  }
+  munmap(header, page_size + header->size);
+}
+
+int lf_perf_counters_open(void) {
+  static const uint64_t configs[LF_PERF_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                     PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+  int fds[LF_PERF_COUNTERS];
+  for (int i = 0; i < LF_PERF_COUNTERS; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[i];
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // The leader is pinned, so the group is either counting as a whole or reads fail.
+    attr.pinned = (i == 0);
+    // There is no glibc wrapper for perf_event_open.
+    fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0UL);
+    if (fds[i] < 0) {
+      while (i-- > 0) {
+        close(fds[i]);
+      }
+      return -1;
+    }
+  }
+  // The siblings stay open for as long as the thread lives and are only reached through the leader.
+  return fds[0];
+}
+
+int lf_perf_counters_read(int group, uint64_t* values) {
+  // With PERF_FORMAT_GROUP, reading the leader yields the number of counters followed by their values.
+  struct {
+    uint64_t count;
+    uint64_t values[LF_PERF_COUNTERS];
+  } data;
+  if (read(group, &data, sizeof(data)) != (ssize_t)sizeof(data) || data.count != LF_PERF_COUNTERS) {
+    return -1;
+  }
+  memcpy(values, data.values, sizeof(data.values));
+  return 0;
+}
+
+int lf_futex_wait(volatile uint32_t* address, uint32_t expected, uint32_t mask) {
+  return (int)syscall(SYS_futex, address, FUTEX_WAIT_BITSET_PRIVATE, expected, NULL, NULL, mask);
+}
+
+int lf_futex_wake(volatile uint32_t* address, uint32_t mask) {
+  return (int)syscall(SYS_futex, address, FUTEX_WAKE_BITSET_PRIVATE, INT32_MAX, NULL, NULL, mask);
+}
+/** The attributes of sched_setattr, which glibc may not declare, up to the utilization clamps. */
+struct lf_sched_attr {
+  uint32_t size;
+  uint32_t sched_policy;
+  uint64_t sched_flags;
+  int32_t sched_nice;
+  uint32_t sched_priority;
+  uint64_t sched_runtime;
+  uint64_t sched_deadline;
+  uint64_t sched_period;
+  uint32_t sched_util_min;
+  uint32_t sched_util_max;
+};
+
+/** Flags of sched_setattr that change only the maximum utilization clamp. */
+#define LF_SCHED_FLAG_KEEP_ALL 0x18
+#define LF_SCHED_FLAG_UTIL_CLAMP_MAX 0x40
+
+/** The largest utilization of a thread for the utilization clamps. */
+#define LF_SCHED_CAPACITY 1024
+
+/**
+ * @brief Set the frequency of each CPU through the userspace cpufreq governor.
+ * @return 0 on success, -1 if the first CPU does not use that governor or its frequency cannot be set.
+ */
+static int lf_cpufreq_set_performance(int percent) {
+  char path[128];
+  char value[64];
+  long cpus = sysconf(_SC_NPROCESSORS_CONF);
+  for (long cpu = 0; cpu < cpus; cpu++) {
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%ld/cpufreq/scaling_governor", cpu);
+    FILE* file = fopen(path, "r");
+    bool userspace = file != NULL && fgets(value, sizeof(value), file) != NULL && strncmp(value, "userspace", 9) == 0;
+    if (file != NULL) {
+      fclose(file);
+    }
+    if (!userspace) {
+      // CPUs that are offline or have another governor are left alone, but the first one decides.
+      if (cpu == 0) {
+        return -1;
+      }
+      continue;
+    }
+    long frequencies[2]; // The minimum and maximum frequency in kHz.
+    const char* names[2] = {"cpuinfo_min_freq", "cpuinfo_max_freq"};
+    for (int i = 0; i < 2; i++) {
+      snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%ld/cpufreq/%s", cpu, names[i]);
+      file = fopen(path, "r");
+      if (file == NULL || fscanf(file, "%ld", &frequencies[i]) != 1) {
+        frequencies[i] = -1;
+      }
+      if (file != NULL) {
+        fclose(file);
+      }
+    }
+    if (frequencies[0] < 0 || frequencies[1] < frequencies[0]) {
+      return -1;
+    }
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%ld/cpufreq/scaling_setspeed", cpu);
+    file = fopen(path, "w");
+    if (file == NULL) {
+      return -1;
+    }
+    int written = fprintf(file, "%ld\n", frequencies[0] + (frequencies[1] - frequencies[0]) * percent / 100);
+    if (fclose(file) != 0 || written < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int lf_cpu_set_performance(int percent) {
+  percent = percent < 1 ? 1 : (percent > 100 ? 100 : percent);
+  if (lf_cpufreq_set_performance(percent) == 0) {
+    return 0;
+  }
+  struct lf_sched_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.sched_flags = LF_SCHED_FLAG_KEEP_ALL | LF_SCHED_FLAG_UTIL_CLAMP_MAX;
+  attr.sched_util_max = (uint32_t)(LF_SCHED_CAPACITY * percent / 100);
+  DIR* tasks = opendir("/proc/self/task");
+  if (tasks == NULL) {
+    return -1;
+  }
+  int result = -1;
+  struct dirent* entry;
+  while ((entry = readdir(tasks)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    // There is no glibc wrapper for sched_setattr. One thread that accepts the clamp is success.
+    if (syscall(SYS_sched_setattr, atoi(entry->d_name), &attr, 0) == 0) {
+      result = 0;
+    }
+  }
+  closedir(tasks);
+  return result;
+}
 #endif
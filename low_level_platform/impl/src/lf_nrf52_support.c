@@ -77,6 +77,48 @@ static volatile uint32_t _lf_time_us_high = 0;
  */
 static volatile uint8_t _lf_nested_count = 0;
 
+#ifdef LF_LOW_POWER_SLEEP
+/**
+ * In low-power sleep, TIMER3 is paused, which lets the high-frequency clock stop, and RTC2, which
+ * runs from the 32.768 kHz low-frequency clock, wakes the chip. The time slept is counted in
+ * RTC ticks and added to the time of TIMER3. The low-frequency clock must be running, which it
+ * is when the SoftDevice is enabled. RTC2_IRQHandler is defined here, so the application must not
+ * use RTC2.
+ */
+#define LF_RTC_FREQUENCY 32768
+#define LF_RTC_COUNTER_MASK 0xFFFFFF
+
+// Convert RTC ticks to nanoseconds without overflow for years of ticks (10^9 / 32768 = 1953125 / 64).
+#define LF_RTC_TICKS_TO_NS(ticks) ((instant_t)((uint64_t)(ticks) * 1953125 / 64))
+
+// Longest low-power sleep, half the period of the 24-bit counter, so that the counter cannot wrap
+// around before the sleep is over.
+#define LF_RTC_MAX_SLEEP_NS SEC(256)
+
+/**
+ * Number of RTC ticks slept in low-power sleep, during which TIMER3 was paused.
+ */
+static volatile uint64_t _lf_rtc_ticks_slept = 0;
+
+/**
+ * True during low-power sleep, which started at RTC counter value _lf_rtc_sleep_start.
+ */
+static volatile bool _lf_rtc_sleeping = false;
+static volatile uint32_t _lf_rtc_sleep_start = 0;
+
+/**
+ * True when the RTC compare event that ends a low-power sleep has occurred.
+ */
+static volatile bool _lf_rtc_fired = false;
+
+void RTC2_IRQHandler(void) {
+  if (NRF_RTC2->EVENTS_COMPARE[0]) {
+    NRF_RTC2->EVENTS_COMPARE[0] = 0;
+    _lf_rtc_fired = true;
+  }
+}
+#endif // LF_LOW_POWER_SLEEP
+
 /**
  * @brief Handle LF timer interrupts
  * Using lf_timer instance -> id = 3
@@ -122,6 +164,14 @@ void _lf_initialize_clock() {
   // when the timer reaches its maximum value and is about to overflow.
   nrfx_timer_compare(&g_lf_timer_inst, NRF_TIMER_CC_CHANNEL3, 0x0, true);
   nrfx_timer_enable(&g_lf_timer_inst);
+
+#ifdef LF_LOW_POWER_SLEEP
+  _lf_rtc_ticks_slept = 0;
+  NRF_RTC2->PRESCALER = 0;
+  NRF_RTC2->TASKS_START = 1;
+  sd_nvic_SetPriority(RTC2_IRQn, 7);
+  sd_nvic_EnableIRQ(RTC2_IRQn);
+#endif // LF_LOW_POWER_SLEEP
 }
 
 /**
@@ -153,7 +203,16 @@ int _lf_clock_gettime(instant_t* t) {
   }
   uint64_t now_us = COMBINE_HI_LO(now_us_hi_post, now_us_low);
 
+#ifdef LF_LOW_POWER_SLEEP
+  // Add the time during which TIMER3 was paused, including that of a sleep that an interrupt interrupts.
+  uint64_t ticks = _lf_rtc_ticks_slept;
+  if (_lf_rtc_sleeping) {
+    ticks += (NRF_RTC2->COUNTER - _lf_rtc_sleep_start) & LF_RTC_COUNTER_MASK;
+  }
+  *t = ((instant_t)now_us) * 1000 + LF_RTC_TICKS_TO_NS(ticks);
+#else
   *t = ((instant_t)now_us) * 1000;
+#endif
   return 0;
 }
 
@@ -191,6 +250,74 @@ static void lf_busy_wait_until(instant_t wakeup_time) {
   } while (now < wakeup_time);
 }
 
+#ifdef LF_LOW_POWER_SLEEP
+/**
+ * @brief Wait for the next tick of the RTC and return the value of its counter.
+ */
+static uint32_t lf_rtc_next_tick() {
+  uint32_t counter = NRF_RTC2->COUNTER;
+  while (NRF_RTC2->COUNTER == counter) {
+  }
+  return NRF_RTC2->COUNTER;
+}
+
+/**
+ * @brief Sleep in the low-power state until the given time minus the wake-up latency, or until
+ * an asynchronous event occurs, whichever comes first.
+ *
+ * TIMER3 is paused and resumed right after a tick of the RTC, so that the ticks slept are
+ * exactly the time for which it was paused and the clock does not drift over many sleeps.
+ *
+ * This assumes the caller is in a critical section. It leaves the critical section while waiting.
+ * @return false if the sleep was too short to enter the low-power state.
+ */
+static bool lf_low_power_sleep_until(instant_t wakeup_time) {
+  instant_t now;
+  _lf_clock_gettime(&now);
+  interval_t duration = wakeup_time - lf_low_power_sleep_latency() - now;
+  if (duration > LF_RTC_MAX_SLEEP_NS) {
+    duration = LF_RTC_MAX_SLEEP_NS;
+  }
+  // The RTC cannot trigger a compare event less than two ticks ahead, and one tick goes to
+  // waiting for the first.
+  uint32_t ticks = duration > 0 ? (uint32_t)(duration * LF_RTC_FREQUENCY / SEC(1)) : 0;
+  if (ticks < 3) {
+    return false;
+  }
+  ticks--;
+
+  // Pause TIMER3 so that nothing requests the high-frequency clock.
+  uint32_t start = lf_rtc_next_tick();
+  nrfx_timer_pause(&g_lf_timer_inst);
+  _lf_rtc_sleep_start = start;
+  _lf_rtc_sleeping = true;
+  _lf_rtc_fired = false;
+  NRF_RTC2->EVENTS_COMPARE[0] = 0;
+  NRF_RTC2->CC[0] = (start + ticks) & LF_RTC_COUNTER_MASK;
+  NRF_RTC2->INTENSET = RTC_INTENSET_COMPARE0_Msk;
+
+  while (!_lf_rtc_fired && !_lf_async_event) {
+    lf_enable_interrupts_nested();
+    __WFE();
+    lf_disable_interrupts_nested();
+  }
+
+  NRF_RTC2->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
+  uint32_t end = lf_rtc_next_tick();
+  nrfx_timer_resume(&g_lf_timer_inst);
+  uint32_t slept = (end - start) & LF_RTC_COUNTER_MASK;
+  _lf_rtc_ticks_slept += slept;
+  _lf_rtc_sleeping = false;
+
+  if (_lf_rtc_fired) {
+    // The ticks slept beyond those requested are the wake-up latency, including the tick
+    // waited for before resuming TIMER3.
+    _lf_low_power_sleep_calibrate(LF_RTC_TICKS_TO_NS(slept - ticks));
+  }
+  return true;
+}
+#endif // LF_LOW_POWER_SLEEP
+
 /**
  * @brief Sleep until the given wakeup time.
  *
@@ -203,6 +330,9 @@ static void lf_busy_wait_until(instant_t wakeup_time) {
  * It may exit the critical section while waiting for an event, but it will re-enter the
  * critical section before returning.
  *
+ * With LF_LOW_POWER_SLEEP, a long sleep is first spent in the low-power state, and only its
+ * end, which covers the wake-up latency, is timed with TIMER3.
+ *
  * @param wakeup_time The time instant at which to wake up.
  * @return 0 if sleep completed, or -1 if it was interrupted.
  */
@@ -217,12 +347,26 @@ int _lf_interruptable_sleep_until_locked(environment_t* env, instant_t wakeup_ti
     return 0;
   }
 
+  _lf_async_event = false;
+#ifdef LF_LOW_POWER_SLEEP
+  // Sleeps longer than the RTC can time take several rounds.
+  while (duration >= LF_LOW_POWER_SLEEP_THRESHOLD && lf_low_power_sleep_until(wakeup_time)) {
+    if (_lf_async_event) {
+      return -1;
+    }
+    _lf_clock_gettime(&now);
+    duration = wakeup_time - now;
+  }
+  if (duration <= 0) {
+    return 0;
+  }
+#endif // LF_LOW_POWER_SLEEP
+
   // The sleeping while loop continues until either:
   // 1) A physical action is scheduled, resulting in a new event on the event queue
   // 2) Sleep has completed successfully
   bool sleep_next = true;
   _lf_sleep_interrupted = false;
-  _lf_async_event = false;
 
   do {
     // Schedule a new timer interrupt unless we already have one pending
@@ -234,7 +378,12 @@ int _lf_interruptable_sleep_until_locked(environment_t* env, instant_t wakeup_ti
         target_timer_val = curr_timer_val - 1;
         duration -= LF_MAX_SLEEP_NS;
       } else {
+#ifdef LF_LOW_POWER_SLEEP
+        // TIMER3 does not count the time slept in low-power sleep.
+        target_timer_val = (uint32_t)((wakeup_time - LF_RTC_TICKS_TO_NS(_lf_rtc_ticks_slept)) / 1000);
+#else
         target_timer_val = (uint32_t)(wakeup_time / 1000);
+#endif
         sleep_next = false;
       }
       // init timer interrupt for sleep time
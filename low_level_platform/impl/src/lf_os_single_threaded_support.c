@@ -26,6 +26,9 @@ int lf_disable_interrupts_nested() { return 0; }
 
 int lf_enable_interrupts_nested() { return 0; }
 
+// Windows can interrupt sleeps and notifies of events in lf_windows_support.c.
+#if !defined(PLATFORM_Windows)
 int _lf_single_threaded_notify_of_event() { return 0; }
+#endif
 
 #endif
@@ -13,6 +13,21 @@ int map_priorities(int priority, int dest_min, int dest_max) {
                      (LF_SCHED_MAX_PRIORITY - LF_SCHED_MIN_PRIORITY));
 }
 
+#ifdef LF_LOW_POWER_SLEEP
+/** The estimate of the wake-up latency of low-power sleep. */
+static interval_t _lf_low_power_sleep_latency = LF_LOW_POWER_SLEEP_INITIAL_LATENCY;
+
+interval_t lf_low_power_sleep_latency(void) { return _lf_low_power_sleep_latency; }
+
+void _lf_low_power_sleep_calibrate(interval_t measured) {
+  if (measured > _lf_low_power_sleep_latency) {
+    _lf_low_power_sleep_latency += (measured - _lf_low_power_sleep_latency + 1) / 2;
+  } else {
+    _lf_low_power_sleep_latency -= (_lf_low_power_sleep_latency - measured) / 16;
+  }
+}
+#endif // LF_LOW_POWER_SLEEP
+
 #ifndef PLATFORM_ZEPHYR // on Zephyr, this is handled separately
 #ifndef LF_SINGLE_THREADED
 static int _lf_worker_thread_count = 0;
@@ -38,6 +38,12 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <pico/stdlib.h>
 #include <pico/multicore.h>
 #include <pico/sync.h>
+#ifdef LF_LOW_POWER_SLEEP
+#include <hardware/clocks.h>
+#include <hardware/structs/scb.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
+#endif
 
 /**
  * critical section struct
@@ -56,6 +62,31 @@ static semaphore_t _lf_sem_irq_event;
 // nested critical section counter
 static uint32_t _lf_num_nested_crit_sec = 0;
 
+#ifdef LF_LOW_POWER_SLEEP
+/**
+ * In low-power sleep, the cores enter deep sleep with the clocks of all peripherals gated except
+ * those of the timer, which keeps counting and wakes them with an alarm, of the watchdog, which
+ * makes the timer tick, and of the GPIOs, whose interrupts report asynchronous events. USB and
+ * UART are not clocked while sleeping, so stdio output may be delayed until the next wake-up.
+ */
+#define LF_SLEEP_EN0 (CLOCKS_SLEEP_EN0_CLK_SYS_BUSFABRIC_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_CLOCKS_BITS | \
+                      CLOCKS_SLEEP_EN0_CLK_SYS_IO_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_PADS_BITS |          \
+                      CLOCKS_SLEEP_EN0_CLK_SYS_PLL_SYS_BITS)
+#define LF_SLEEP_EN1 \
+  (CLOCKS_SLEEP_EN1_CLK_SYS_TIMER_BITS | CLOCKS_SLEEP_EN1_CLK_SYS_WATCHDOG_BITS | CLOCKS_SLEEP_EN1_CLK_SYS_XOSC_BITS)
+
+/** The hardware alarm that ends a low-power sleep, or -1 if none was available. */
+static int _lf_sleep_alarm = -1;
+
+/** True when the alarm that ends a low-power sleep has fired. */
+static volatile bool _lf_sleep_alarm_fired = false;
+
+static void _lf_sleep_alarm_callback(uint alarm_num) {
+  (void)alarm_num;
+  _lf_sleep_alarm_fired = true;
+}
+#endif // LF_LOW_POWER_SLEEP
+
 /**
  * Initialize basic runtime infrastructure and
  * synchronization structs for an single-threaded runtime.
@@ -68,6 +99,13 @@ void _lf_initialize_clock(void) {
   // init sync structs
   critical_section_init(&_lf_crit_sec);
   sem_init(&_lf_sem_irq_event, 0, 1);
+#ifdef LF_LOW_POWER_SLEEP
+  // Without a free alarm, sleeps are not low-power.
+  _lf_sleep_alarm = hardware_alarm_claim_unused(false);
+  if (_lf_sleep_alarm >= 0) {
+    hardware_alarm_set_callback((uint)_lf_sleep_alarm, _lf_sleep_alarm_callback);
+  }
+#endif
 }
 
 /**
@@ -109,6 +147,49 @@ int lf_sleep(interval_t sleep_duration) {
   return 0;
 }
 
+#ifdef LF_LOW_POWER_SLEEP
+/**
+ * Sleep in the low-power state until the given time minus the wake-up latency, or until
+ * the _lf_sem_irq_event semaphore is released, whichever comes first.
+ * This assumes the caller is not in a critical section.
+ *
+ * @param  wakeup_time  time in nanoseconds since boot to sleep until.
+ */
+static void lf_low_power_sleep_until(instant_t wakeup_time) {
+  instant_t target = wakeup_time - lf_low_power_sleep_latency();
+  _lf_sleep_alarm_fired = false;
+  // Returns true if the target has already passed.
+  if (hardware_alarm_set_target((uint)_lf_sleep_alarm, from_us_since_boot((uint64_t)(target / 1000)))) {
+    return;
+  }
+  uint32_t sleep_en0 = clocks_hw->sleep_en0;
+  uint32_t sleep_en1 = clocks_hw->sleep_en1;
+  clocks_hw->sleep_en0 = LF_SLEEP_EN0;
+  clocks_hw->sleep_en1 = LF_SLEEP_EN1;
+  scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+  // With interrupts disabled, a pending interrupt still ends __wfi, but cannot be handled
+  // between the check of the flags and __wfi.
+  uint32_t interrupts = save_and_disable_interrupts();
+  while (!_lf_sleep_alarm_fired && sem_available(&_lf_sem_irq_event) == 0) {
+    __wfi();
+    // Let the interrupt that woke the core run.
+    restore_interrupts(interrupts);
+    interrupts = save_and_disable_interrupts();
+  }
+  restore_interrupts(interrupts);
+  scb_hw->scr &= ~M0PLUS_SCR_SLEEPDEEP_BITS;
+  clocks_hw->sleep_en0 = sleep_en0;
+  clocks_hw->sleep_en1 = sleep_en1;
+  hardware_alarm_cancel((uint)_lf_sleep_alarm);
+
+  if (_lf_sleep_alarm_fired) {
+    instant_t now;
+    _lf_clock_gettime(&now);
+    _lf_low_power_sleep_calibrate(now - target);
+  }
+}
+#endif // LF_LOW_POWER_SLEEP
+
 /**
  * Sleep until the target time since boot in nanoseconds provided
  * by the argument or return early if the binary
@@ -117,6 +198,8 @@ int lf_sleep(interval_t sleep_duration) {
  * The semaphore is released using the _lf_single_threaded_notify_of_event
  * which is called by lf_schedule in the single_threaded runtime for physical actions.
  *
+ * With LF_LOW_POWER_SLEEP, a long sleep is first spent in the low-power state.
+ *
  * @param  env  pointer to environment struct this runs in.
  * @param  wakeup_time  time in nanoseconds since boot to sleep until.
  * @return -1 when interrupted or 0 on successful timeout
@@ -136,6 +219,13 @@ int _lf_interruptable_sleep_until_locked(environment_t* env, instant_t wakeup_ti
   target = from_us_since_boot((uint64_t)(wakeup_time / 1000));
   // Enable interrupts.
   lf_critical_section_exit(env);
+#ifdef LF_LOW_POWER_SLEEP
+  instant_t now;
+  _lf_clock_gettime(&now);
+  if (_lf_sleep_alarm >= 0 && wakeup_time - now >= LF_LOW_POWER_SLEEP_THRESHOLD) {
+    lf_low_power_sleep_until(wakeup_time);
+  }
+#endif
   // blocked sleep
   // return on timeout or on processor event
   if (sem_acquire_block_until(&_lf_sem_irq_event, target)) {
@@ -257,6 +347,17 @@ int lf_thread_join(lf_thread_t thread, void** thread_return) {
   return 0;
 }
 
+int lf_thread_set_cpu(lf_thread_t thread, size_t cpu_number) {
+  (void)thread;
+  (void)cpu_number;
+  return -1;
+}
+
+int lf_thread_yield(void) {
+  // Not implemented.
+  return 0;
+}
+
 int lf_mutex_init(lf_mutex_t* mutex) {
   recursive_mutex_init(mutex);
   return 0;
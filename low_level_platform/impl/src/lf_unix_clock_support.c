@@ -1,11 +1,26 @@
 #if defined(PLATFORM_Linux) || defined(PLATFORM_Darwin)
 #include <time.h>
 #include <errno.h>
+#include <string.h>
 
 #include "low_level_platform.h"
 #include "logging.h"
 #include "platform/lf_unix_clock_support.h"
 
+#if defined(PLATFORM_Linux) && defined(LF_CLOCK_PHC_INDEX)
+#include <fcntl.h>
+#include <stdio.h>
+
+// The dynamic POSIX clock of an open file descriptor of a PTP hardware clock device.
+#define FD_TO_CLOCKID(fd) ((clockid_t)((((unsigned int)~(fd)) << 3) | 3))
+#endif
+
+/**
+ * The clock that provides physical time, which is CLOCK_REALTIME unless LF_CLOCK_PHC_INDEX
+ * selects the PTP hardware clock /dev/ptp<LF_CLOCK_PHC_INDEX> on Linux.
+ */
+static clockid_t physical_clock = CLOCK_REALTIME;
+
 instant_t convert_timespec_to_ns(struct timespec tp) { return ((instant_t)tp.tv_sec) * BILLION + tp.tv_nsec; }
 
 struct timespec convert_ns_to_timespec(instant_t t) {
@@ -16,28 +31,53 @@ struct timespec convert_ns_to_timespec(instant_t t) {
 }
 
 void _lf_initialize_clock() {
+#if defined(PLATFORM_Linux) && defined(LF_CLOCK_PHC_INDEX)
+  char device[32];
+  snprintf(device, sizeof(device), "/dev/ptp%d", LF_CLOCK_PHC_INDEX);
+  int fd = open(device, O_RDONLY);
+  if (fd < 0) {
+    lf_print_error_and_exit("Could not open the PTP hardware clock %s: %s", device, strerror(errno));
+  }
+  physical_clock = FD_TO_CLOCKID(fd);
+  lf_print("---- Using PTP hardware clock %s", device);
+#endif
   struct timespec res;
-  int return_value = clock_getres(CLOCK_REALTIME, (struct timespec*)&res);
+  int return_value = clock_getres(physical_clock, (struct timespec*)&res);
   if (return_value < 0) {
-    lf_print_error_and_exit("Could not obtain resolution for CLOCK_REALTIME");
+    lf_print_error_and_exit("Could not obtain resolution for the physical clock");
   }
 
   lf_print("---- System clock resolution: %ld nsec", res.tv_nsec);
 }
 
 /**
- * Fetch the value of CLOCK_REALTIME and store it in t.
+ * Fetch the value of the physical clock (by default CLOCK_REALTIME) and store it in t.
  * @return 0 for success, or -1 for failure.
  */
 int _lf_clock_gettime(instant_t* t) {
   if (t == NULL)
     return -1;
   struct timespec tp;
-  if (clock_gettime(CLOCK_REALTIME, (struct timespec*)&tp) != 0) {
+  if (clock_gettime(physical_clock, (struct timespec*)&tp) != 0) {
     return -1;
   }
   *t = convert_timespec_to_ns(tp);
   return 0;
 }
 
+/** @brief Convert a time of the physical clock to a time of `clock`, using their current difference. */
+static instant_t convert_clock_to(clockid_t clock, instant_t t) {
+  if (physical_clock == clock) {
+    return t;
+  }
+  struct timespec physical, other;
+  clock_gettime(physical_clock, &physical);
+  clock_gettime(clock, &other);
+  return t - (convert_timespec_to_ns(physical) - convert_timespec_to_ns(other));
+}
+
+instant_t convert_clock_to_realtime(instant_t t) { return convert_clock_to(CLOCK_REALTIME, t); }
+
+instant_t convert_clock_to_monotonic(instant_t t) { return convert_clock_to(CLOCK_MONOTONIC, t); }
+
 #endif
@@ -67,6 +67,13 @@ void _lf_initialize_clock() {
     lf_print_error("High resolution performance counter is not supported on this machine.");
     _lf_frequency_to_ns = 0.01;
   }
+#if defined(LF_SINGLE_THREADED)
+  // An auto-reset event, so that each notification interrupts at most one sleep.
+  _lf_sleep_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+  if (_lf_sleep_event == NULL) {
+    lf_print_error_and_exit("Failed to create the event that interrupts sleeps.");
+  }
+#endif
 }
 
 /**
@@ -105,54 +112,118 @@ int _lf_clock_gettime(instant_t* t) {
   return (0);
 }
 
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+#if defined(_MSC_VER)
+#define LF_THREAD_LOCAL __declspec(thread)
+#else
+#define LF_THREAD_LOCAL __thread
+#endif
+
+/**
+ * The waitable timer on which the calling thread sleeps, created on its first sleep
+ * and reused for all later ones.
+ */
+static LF_THREAD_LOCAL HANDLE _lf_sleep_timer = NULL;
+
+#if defined(LF_SINGLE_THREADED)
+/**
+ * The event that _lf_single_threaded_notify_of_event signals to interrupt a sleep.
+ * It resets when a sleep returns because of it.
+ */
+static HANDLE _lf_sleep_event = NULL;
+#endif
+
+/**
+ * Arm the waitable timer of the calling thread to expire after the given duration,
+ * creating the timer if needed. High-resolution timers, which are not limited to the
+ * period of the system timer interrupt, are used from Windows 10 version 1803 onward.
+ *
+ * @return The timer, or NULL if it could not be created or armed.
+ */
+static HANDLE _lf_arm_sleep_timer(interval_t sleep_duration) {
+  if (_lf_sleep_timer == NULL) {
+    _lf_sleep_timer = CreateWaitableTimerExW(
+        NULL, NULL, CREATE_WAITABLE_TIMER_MANUAL_RESET | CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (_lf_sleep_timer == NULL) {
+      _lf_sleep_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_MANUAL_RESET, TIMER_ALL_ACCESS);
+    }
+    if (_lf_sleep_timer == NULL) {
+      return NULL;
+    }
+  }
+  /**
+   * A negative due time is relative to now, in units of 100 nanoseconds.
+   * Round up so as not to wake up early.
+   */
+  LARGE_INTEGER due_time;
+  due_time.QuadPart = -1 * ((sleep_duration + 99) / 100);
+  if (!SetWaitableTimer(_lf_sleep_timer, &due_time, 0, NULL, NULL, FALSE)) {
+    return NULL;
+  }
+  return _lf_sleep_timer;
+}
+
 /**
  * Pause execution for a number of nanoseconds.
  *
  * @return 0 for success, or -1 for failure. In case of failure, errno will be
- *  set to
- *   - EINTR: The sleep was interrupted by a signal handler
- *   - EINVAL: All other errors
+ *  set to EINVAL.
  */
 int lf_sleep(interval_t sleep_duration) {
-  /* Declarations */
-  HANDLE timer;     /* Timer handle */
-  LARGE_INTEGER li; /* Time defintion */
-  /* Create timer */
-  if (!(timer = CreateWaitableTimer(NULL, TRUE, NULL))) {
-    return FALSE;
+  if (sleep_duration <= 0) {
+    return 0;
   }
-  /**
-   * Set timer properties.
-   * A negative number indicates relative time to wait.
-   * The requested sleep duration must be in number of 100 nanoseconds.
-   */
-  li.QuadPart = -1 * (sleep_duration / 100);
-  if (!SetWaitableTimer(timer, &li, 0, NULL, NULL, FALSE)) {
-    CloseHandle(timer);
-    return FALSE;
+  HANDLE timer = _lf_arm_sleep_timer(sleep_duration);
+  if (timer == NULL || WaitForSingleObject(timer, INFINITE) != WAIT_OBJECT_0) {
+    errno = EINVAL;
+    return -1;
   }
-  /* Start & wait for timer */
-  WaitForSingleObject(timer, INFINITE);
-  /* Clean resources */
-  CloseHandle(timer);
-  /* Slept without problems */
-  return TRUE;
+  return 0;
 }
 
+/**
+ * Sleep until the wakeup time. In the single-threaded runtime, the sleep is cut short
+ * by _lf_single_threaded_notify_of_event, in which case -1 is returned.
+ */
 int _lf_interruptable_sleep_until_locked(environment_t* env, instant_t wakeup_time) {
+  (void)env;
   interval_t sleep_duration = wakeup_time - lf_time_physical();
 
   if (sleep_duration <= 0) {
     return 0;
-  } else {
-    return lf_sleep(sleep_duration);
   }
+#if defined(LF_SINGLE_THREADED)
+  HANDLE timer = _lf_arm_sleep_timer(sleep_duration);
+  if (timer == NULL) {
+    return -1;
+  }
+  HANDLE handles[2] = {timer, _lf_sleep_event};
+  DWORD result = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+  if (result != WAIT_OBJECT_0) {
+    // Interrupted by an event, or failed.
+    CancelWaitableTimer(timer);
+    return -1;
+  }
+  return 0;
+#else
+  return lf_sleep(sleep_duration);
+#endif
 }
 
 int lf_nanosleep(interval_t sleep_duration) { return lf_sleep(sleep_duration); }
 
 #if defined(LF_SINGLE_THREADED)
 #include "lf_os_single_threaded_support.c"
+
+int _lf_single_threaded_notify_of_event() {
+  if (!SetEvent(_lf_sleep_event)) {
+    return -1;
+  }
+  return 0;
+}
 #endif
 
 #if !defined(LF_SINGLE_THREADED)
@@ -189,6 +260,11 @@ int lf_thread_join(lf_thread_t thread, void** thread_return) {
   return 0;
 }
 
+int lf_thread_yield(void) {
+  SwitchToThread();
+  return 0;
+}
+
 /**
  * Real-time scheduling API not implemented for Windows.
  */
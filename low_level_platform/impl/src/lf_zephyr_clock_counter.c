@@ -40,23 +40,72 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "low_level_platform.h"
 #include "logging_macros.h"
 
-static int64_t epoch_duration_nsec;
-static int64_t epoch_duration_usec;
-static volatile int64_t last_epoch_nsec = 0;
 static uint32_t counter_freq;
 static volatile bool async_event = false;
 
+/**
+ * The clock is the number of ticks of the counter since it started, which is converted to
+ * nanoseconds only when it is read, so that no resolution is lost. The counter wraps around
+ * every epoch_ticks ticks, and overflow_callback adds an epoch to epoch_start_ticks.
+ *
+ * If interrupts are disabled when the counter wraps around, the callback runs late, and a read
+ * of the clock in between sees the counter wrapped but not the epoch. A read detects this
+ * because the tick count would fall below the last one read, and adds the epoch itself. This
+ * is exact as long as the clock is read at least once per epoch, which sleeps ensure by never
+ * programming an alarm more than half an epoch ahead. The state is updated under clock_lock,
+ * which is held for a few instructions and can be taken in ISRs.
+ */
+static uint64_t epoch_ticks;
+static uint64_t epoch_start_ticks = 0;
+static uint64_t last_ticks = 0;
+static struct k_spinlock clock_lock;
+
 K_SEM_DEFINE(semaphore, 0, 1)
 
 static struct counter_alarm_cfg alarm_cfg;
 const struct device* const counter_dev = DEVICE_DT_GET(LF_TIMER);
 static volatile bool alarm_fired;
 
+/**
+ * Convert a number of ticks of the counter to nanoseconds without rounding to microseconds
+ * and without overflow.
+ */
+static instant_t ticks_to_nsec(uint64_t ticks) {
+  return (instant_t)((ticks / counter_freq) * NSEC_PER_SEC + (ticks % counter_freq) * NSEC_PER_SEC / counter_freq);
+}
+
+/**
+ * Convert a duration in nanoseconds to a number of ticks of the counter, rounding down.
+ */
+static uint64_t nsec_to_ticks(interval_t nsec) {
+  uint64_t n = (uint64_t)nsec;
+  return (n / NSEC_PER_SEC) * counter_freq + (n % NSEC_PER_SEC) * counter_freq / NSEC_PER_SEC;
+}
+
+/**
+ * Return the number of ticks since the counter started. This assumes clock_lock is held.
+ */
+static uint64_t read_ticks_locked() {
+  uint32_t now_cycles;
+  counter_get_value(counter_dev, &now_cycles);
+  uint64_t ticks = epoch_start_ticks + now_cycles;
+  if (ticks < last_ticks) {
+    // The counter wrapped around, but overflow_callback has not run yet.
+    ticks += epoch_ticks;
+  }
+  last_ticks = ticks;
+  return ticks;
+}
+
 /**
  * This callback is invoked when the underlying Timer peripheral overflows.
  * Handled by incrementing the epoch variable.
  */
-static void overflow_callback(const struct device* dev, void* user_data) { last_epoch_nsec += epoch_duration_nsec; }
+static void overflow_callback(const struct device* dev, void* user_data) {
+  k_spinlock_key_t key = k_spin_lock(&clock_lock);
+  epoch_start_ticks += epoch_ticks;
+  k_spin_unlock(&clock_lock, key);
+}
 
 /**
  * This callback is invoked when the alarm configured for sleeping expires.
@@ -89,11 +138,9 @@ void _lf_initialize_clock() {
   // Get the frequency of the timer
   counter_freq = counter_get_frequency(counter_dev);
 
-  // Calculate the duration of an epoch. Compute both
-  //  nsec and usec now at boot to avoid these computations later
+  // The counter counts from 0 to the top value, so an epoch is one tick longer.
   counter_max_ticks = counter_get_max_top_value(counter_dev);
-  epoch_duration_usec = counter_ticks_to_us(counter_dev, counter_max_ticks);
-  epoch_duration_nsec = epoch_duration_usec * 1000LL;
+  epoch_ticks = (uint64_t)counter_max_ticks + 1;
 
   // Set the max_top value to be the maximum
   counter_top_cfg.ticks = counter_max_ticks;
@@ -106,8 +153,9 @@ void _lf_initialize_clock() {
   LF_PRINT_LOG("--- Using LF Zephyr Counter Clock with a frequency of %u Hz and wraps every %u sec\n", counter_freq,
                counter_max_ticks / counter_freq);
 
-  // Prepare the alarm config
-  alarm_cfg.flags = 0;
+  // Prepare the alarm config. Alarms are set at an absolute counter value, and fire at once if it
+  // has passed.
+  alarm_cfg.flags = COUNTER_ALARM_CFG_ABSOLUTE | COUNTER_ALARM_CFG_EXPIRE_WHEN_LATE;
   alarm_cfg.ticks = 0;
   alarm_cfg.callback = alarm_callback;
   alarm_cfg.user_data = &alarm_cfg;
@@ -121,29 +169,30 @@ void _lf_initialize_clock() {
  * ISR.
  */
 int _lf_clock_gettime(instant_t* t) {
-  static uint64_t last_nsec = 0;
-  uint32_t now_cycles;
-  int res;
-  uint64_t now_nsec;
-
-  res = counter_get_value(counter_dev, &now_cycles);
-  now_nsec = counter_ticks_to_us(counter_dev, now_cycles) * 1000ULL + last_epoch_nsec;
-
-  // Make sure that the clock is monotonic. We might have had a wrap but the
-  // epoch has not been updated because interrupts are disabled.
-  if (now_nsec < last_nsec) {
-    now_nsec = last_nsec + 1;
-  }
-
-  *t = now_nsec;
-  last_nsec = now_nsec;
+  k_spinlock_key_t key = k_spin_lock(&clock_lock);
+  uint64_t ticks = read_ticks_locked();
+  k_spin_unlock(&clock_lock, key);
+  *t = ticks_to_nsec(ticks);
   return 0;
 }
 
+/**
+ * Busy-wait until the given number of ticks since the counter started.
+ */
+static void busy_wait_until_ticks(uint64_t target) {
+  uint64_t ticks;
+  do {
+    k_spinlock_key_t key = k_spin_lock(&clock_lock);
+    ticks = read_ticks_locked();
+    k_spin_unlock(&clock_lock, key);
+  } while (ticks < target && !async_event);
+}
+
 /**
  * Handle interruptable sleep by configuring a future alarm callback and waiting
  * on a semaphore. Make sure we can handle sleeps that exceed an entire epoch
- * of the Counter.
+ * of the Counter. The alarm is set at the tick at which to wake up, less the wake-up
+ * overhead, and the rest of the sleep is a busy-wait on the counter.
  */
 int _lf_interruptable_sleep_until_locked(environment_t* env, instant_t wakeup) {
   // Reset flags
@@ -151,21 +200,26 @@ int _lf_interruptable_sleep_until_locked(environment_t* env, instant_t wakeup) {
   async_event = false;
   k_sem_reset(&semaphore);
 
-  // Calculate the sleep duration
-  uint32_t now_cycles, sleep_duration_ticks;
-  counter_get_value(counter_dev, &now_cycles);
-  instant_t now;
-  _lf_clock_gettime(&now);
-  interval_t sleep_for_us = (wakeup - now) / 1000;
-
-  while (!async_event && sleep_for_us > (LF_WAKEUP_OVERHEAD_US + LF_MIN_SLEEP_US)) {
-    if (sleep_for_us < epoch_duration_usec) {
-      sleep_duration_ticks = counter_us_to_ticks(counter_dev, ((uint64_t)sleep_for_us) - LF_WAKEUP_OVERHEAD_US);
-    } else {
-      sleep_duration_ticks = UINT32_MAX;
+  // The tick at which to wake up, which is the first one at or after the wakeup time, and the
+  // ticks by which to wake up earlier.
+  uint64_t wakeup_ticks = wakeup > 0 ? nsec_to_ticks(wakeup) : 0;
+  if (wakeup > 0 && ticks_to_nsec(wakeup_ticks) < wakeup) {
+    wakeup_ticks++;
+  }
+  uint64_t overhead_ticks = nsec_to_ticks(USEC(LF_WAKEUP_OVERHEAD_US));
+  uint64_t min_sleep_ticks = nsec_to_ticks(USEC(LF_MIN_SLEEP_US));
+
+  k_spinlock_key_t key = k_spin_lock(&clock_lock);
+  uint64_t now_ticks = read_ticks_locked();
+  k_spin_unlock(&clock_lock, key);
+
+  while (!async_event && now_ticks + overhead_ticks + min_sleep_ticks < wakeup_ticks) {
+    // Never more than half an epoch ahead, so that the clock is read once per epoch.
+    uint64_t alarm_ticks = wakeup_ticks - overhead_ticks;
+    if (alarm_ticks > now_ticks + epoch_ticks / 2) {
+      alarm_ticks = now_ticks + epoch_ticks / 2;
     }
-
-    alarm_cfg.ticks = sleep_duration_ticks;
+    alarm_cfg.ticks = (uint32_t)(alarm_ticks % epoch_ticks);
     int err = counter_set_channel_alarm(counter_dev, LF_TIMER_ALARM_CHANNEL, &alarm_cfg);
 
     if (err != 0) {
@@ -180,16 +234,15 @@ int _lf_interruptable_sleep_until_locked(environment_t* env, instant_t wakeup) {
       lf_print_error_and_exit("Failed to enter critical section.");
     }
 
-    // Then calculating remaining sleep, unless we got woken up by an event
-    if (!async_event) {
-      _lf_clock_gettime(&now);
-      sleep_for_us = (wakeup - now) / 1000;
-    }
+    key = k_spin_lock(&clock_lock);
+    now_ticks = read_ticks_locked();
+    k_spin_unlock(&clock_lock, key);
   }
 
   // Do remaining sleep in busy_wait
-  if (!async_event && sleep_for_us > LF_RUNTIME_OVERHEAD_US) {
-    k_busy_wait((uint32_t)(sleep_for_us - LF_RUNTIME_OVERHEAD_US));
+  uint64_t runtime_overhead_ticks = nsec_to_ticks(USEC(LF_RUNTIME_OVERHEAD_US));
+  if (!async_event && now_ticks + runtime_overhead_ticks < wakeup_ticks) {
+    busy_wait_until_ticks(wakeup_ticks - runtime_overhead_ticks);
   }
 
   if (async_event) {
@@ -89,14 +89,15 @@ int lf_enable_interrupts_nested() {
 #define USER_THREADS 0
 #endif
 
-// If we have watchdogs, set aside threads for them also
+// If we have watchdogs, set aside a thread for them also. All watchdogs share one thread.
 #if !defined(NUMBER_OF_WATCHDOGS)
 #define NUMBER_OF_WATCHDOGS 0
 #endif
+#define WATCHDOG_THREADS (NUMBER_OF_WATCHDOGS > 0 ? 1 : 0)
 
 // Number of additional threads that will be created
 // One worker will run on the main thread, so for N workers, only (N - 1) worker threads should be created
-#define NUMBER_OF_THREADS ((NUMBER_OF_WORKERS - 1) + USER_THREADS + NUMBER_OF_WATCHDOGS)
+#define NUMBER_OF_THREADS ((NUMBER_OF_WORKERS - 1) + USER_THREADS + WATCHDOG_THREADS)
 
 K_MUTEX_DEFINE(thread_mutex);
 
@@ -148,6 +149,11 @@ int lf_thread_create(lf_thread_t* thread, void* (*lf_thread)(void*), void* argum
 
 int lf_thread_join(lf_thread_t thread, void** thread_return) { return k_thread_join(thread, K_FOREVER); }
 
+int lf_thread_yield(void) {
+  k_yield();
+  return 0;
+}
+
 void initialize_lf_thread_id() {
   static int _lf_worker_thread_count = 0;
   int* thread_id = (int*)malloc(sizeof(int));
@@ -9,6 +9,9 @@
  * @copyright Copyright (c) 2024
  */
 
+#ifndef PLATFORM_API_H
+#define PLATFORM_API_H
+
 /**
  * @brief Pointer to the platform-specific implementation of a mutex.
  */
@@ -34,8 +37,61 @@ int lf_platform_mutex_lock(lf_platform_mutex_ptr_t mutex);
  */
 int lf_platform_mutex_unlock(lf_platform_mutex_ptr_t mutex);
 
+/**
+ * @brief Pointer to the platform-specific implementation of a condition variable.
+ */
+typedef void* lf_platform_cond_ptr_t;
+/**
+ * @brief Create a new condition variable associated with the given mutex and return (a pointer to) it.
+ *
+ * @return NULL if the platform does not support threads or if out of memory.
+ */
+lf_platform_cond_ptr_t lf_platform_cond_new(lf_platform_mutex_ptr_t mutex);
+/**
+ * @brief Free all resources associated with the provided condition variable.
+ */
+void lf_platform_cond_free(lf_platform_cond_ptr_t cond);
+/**
+ * @brief Wait on the given condition variable. The associated mutex must be held.
+ *
+ * @return 0 on success, platform-specific error number otherwise.
+ */
+int lf_platform_cond_wait(lf_platform_cond_ptr_t cond);
+/**
+ * @brief Wake up one thread waiting on the given condition variable.
+ *
+ * @return 0 on success, platform-specific error number otherwise.
+ */
+int lf_platform_cond_signal(lf_platform_cond_ptr_t cond);
+/**
+ * @brief Wake up all threads waiting on the given condition variable.
+ *
+ * @return 0 on success, platform-specific error number otherwise.
+ */
+int lf_platform_cond_broadcast(lf_platform_cond_ptr_t cond);
+
+/**
+ * @brief Pointer to the platform-specific implementation of a thread.
+ */
+typedef void* lf_platform_thread_ptr_t;
+/**
+ * @brief Start a new thread that calls the given function with the given arguments and return (a pointer to) it.
+ *
+ * The thread does not get an ID from lf_thread_id().
+ * @return NULL if the platform does not support threads or if the thread could not be created.
+ */
+lf_platform_thread_ptr_t lf_platform_thread_new(void* (*function)(void*), void* arguments);
+/**
+ * @brief Wait for the given thread to return and free all resources associated with it.
+ *
+ * @return 0 on success, platform-specific error number otherwise.
+ */
+int lf_platform_thread_join(lf_platform_thread_ptr_t thread);
+
 /**
  * @brief The ID of the current thread. The only guarantee is that these IDs will be a contiguous range of numbers
  * starting at 0.
  */
 int lf_thread_id();
+
+#endif // PLATFORM_API_H
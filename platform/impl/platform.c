@@ -25,3 +25,72 @@ lf_platform_mutex_ptr_t lf_platform_mutex_new() {
 void lf_platform_mutex_free(lf_platform_mutex_ptr_t mutex) { free((void*)mutex); }
 int lf_platform_mutex_lock(lf_platform_mutex_ptr_t mutex) { return lf_mutex_lock((lf_mutex_t*)mutex); }
 int lf_platform_mutex_unlock(lf_platform_mutex_ptr_t mutex) { return lf_mutex_unlock((lf_mutex_t*)mutex); }
+
+#if !defined(LF_SINGLE_THREADED)
+
+// CONDITION VARIABLES *********************************************************
+
+lf_platform_cond_ptr_t lf_platform_cond_new(lf_platform_mutex_ptr_t mutex) {
+  lf_platform_cond_ptr_t cond = (lf_platform_cond_ptr_t)malloc(sizeof(lf_cond_t));
+  if (cond && lf_cond_init((lf_cond_t*)cond, (lf_mutex_t*)mutex) != 0) {
+    free(cond);
+    cond = NULL;
+  }
+  return cond;
+}
+
+void lf_platform_cond_free(lf_platform_cond_ptr_t cond) { free((void*)cond); }
+int lf_platform_cond_wait(lf_platform_cond_ptr_t cond) { return lf_cond_wait((lf_cond_t*)cond); }
+int lf_platform_cond_signal(lf_platform_cond_ptr_t cond) { return lf_cond_signal((lf_cond_t*)cond); }
+int lf_platform_cond_broadcast(lf_platform_cond_ptr_t cond) { return lf_cond_broadcast((lf_cond_t*)cond); }
+
+// THREADS *********************************************************************
+
+lf_platform_thread_ptr_t lf_platform_thread_new(void* (*function)(void*), void* arguments) {
+  lf_platform_thread_ptr_t thread = (lf_platform_thread_ptr_t)malloc(sizeof(lf_thread_t));
+  if (thread && lf_thread_create((lf_thread_t*)thread, function, arguments) != 0) {
+    free(thread);
+    thread = NULL;
+  }
+  return thread;
+}
+
+int lf_platform_thread_join(lf_platform_thread_ptr_t thread) {
+  int result = lf_thread_join(*(lf_thread_t*)thread, NULL);
+  free(thread);
+  return result;
+}
+
+#else
+
+lf_platform_cond_ptr_t lf_platform_cond_new(lf_platform_mutex_ptr_t mutex) {
+  (void)mutex;
+  return NULL;
+}
+
+void lf_platform_cond_free(lf_platform_cond_ptr_t cond) { (void)cond; }
+int lf_platform_cond_wait(lf_platform_cond_ptr_t cond) {
+  (void)cond;
+  return -1;
+}
+int lf_platform_cond_signal(lf_platform_cond_ptr_t cond) {
+  (void)cond;
+  return -1;
+}
+int lf_platform_cond_broadcast(lf_platform_cond_ptr_t cond) {
+  (void)cond;
+  return -1;
+}
+
+lf_platform_thread_ptr_t lf_platform_thread_new(void* (*function)(void*), void* arguments) {
+  (void)function;
+  (void)arguments;
+  return NULL;
+}
+
+int lf_platform_thread_join(lf_platform_thread_ptr_t thread) {
+  (void)thread;
+  return -1;
+}
+
+#endif // !defined(LF_SINGLE_THREADED)
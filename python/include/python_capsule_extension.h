@@ -52,6 +52,7 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define FEDERATED_ASSIGN_FIELDS(py_port, c_port)                                                                       \
   do {                                                                                                                 \
+    Py_XDECREF(py_port->intended_tag);                                                                                 \
     py_port->intended_tag = convert_C_tag_to_py(c_port->intended_tag);                                                 \
     py_port->physical_time_of_arrival = c_port->physical_time_of_arrival;                                              \
   } while (0)
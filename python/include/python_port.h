@@ -58,6 +58,7 @@ typedef struct {
   size_t element_size;                    // token_type_t
   void (*destructor)(void* value);        // token_type_t
   void* (*copy_constructor)(void* value); // token_type_t
+  lf_token_pool_t* pool;                  // token_type_t
   lf_token_t* token;                      // token_template_t
   size_t length;                          // token_template_t
   bool is_present;                        // lf_port_base_t
@@ -66,6 +67,36 @@ typedef struct {
   FEDERATED_GENERIC_EXTENSION
 } generic_port_instance_struct;
 
+/**
+ * The value of a port that carries a C scalar instead of a PyObject*.
+ * @see scalar_port_instance_struct
+ */
+typedef union {
+  int64_t int64;  // Format 'q'.
+  double float64; // Format 'd'.
+  bool boolean;   // Format '?'.
+} python_scalar_t;
+
+/**
+ * The struct of a port that carries an int64_t, a double or a bool, which is stored as it is
+ * rather than as a Python object. Setting the port neither allocates a token nor changes reference
+ * counts, and the Python object of the value is created only when it is read in Python.
+ * NOTE: Like generic_port_instance_struct, this must follow exactly the structure of lf_port_base_t.
+ * @see convert_C_scalar_port_to_py
+ */
+typedef struct {
+  size_t element_size;                    // token_type_t
+  void (*destructor)(void* value);        // token_type_t
+  void* (*copy_constructor)(void* value); // token_type_t
+  lf_token_pool_t* pool;                  // token_type_t
+  lf_token_t* token;                      // token_template_t
+  size_t length;                          // token_template_t
+  bool is_present;                        // lf_port_base_t
+  lf_port_internal_t _base;               // lf_port_internal_t
+  python_scalar_t value;
+  FEDERATED_GENERIC_EXTENSION
+} scalar_port_instance_struct;
+
 /**
  * The struct used to represent ports in Python
  * This template is used as a blueprint to create
@@ -85,8 +116,15 @@ typedef struct {
  *        in Python code.
  * is_present: Indicates if the value of the singular port is present
  *             at the current logical time
+ *        For ports that carry C scalars, value is NULL until it is read, and is then kept as long as the C
+ *        value does not change.
+ * is_present: Indicates if the value of the singular port is present
+ *             at the current logical time
  * width: Indicates the width of the multiport. This is set to -2 for non-multiports.
  * current_index: Used to facilitate iterative functions (@see port_iter)
+ * buffer_format: The format of the elements of the C arrays carried by the port, or NULL.
+ * scalar_format: The format of the C scalar carried by the port ('q', 'd' or '?'), or 0.
+ * scalar: The C value of which value is the Python object, if scalar_format is not 0.
  **/
 typedef struct {
   PyObject_HEAD PyObject* port;
@@ -94,8 +132,81 @@ typedef struct {
   bool is_present;
   int width;
   long current_index;
+  const char* buffer_format;
+  char scalar_format;
+  python_scalar_t scalar;
   FEDERATED_CAPSULE_EXTENSION
 } generic_port_capsule_struct;
 
+/**
+ * The struct used to expose the payload of a C token to Python without copying it.
+ * The resulting Python object has the type py_token_buffer_t in C
+ * (LinguaFranca.token_buffer in Python) and supports the buffer protocol, so
+ * memoryview(value) and numpy.asarray(value) use the payload in place.
+ * The payload is read only, because the token may be shared by several reactions.
+ *
+ * token: The token, of which the buffer holds a reference until it is deallocated.
+ * shape: The number of elements.
+ * itemsize: The size of an element.
+ * format: The format of an element in the syntax of the struct module.
+ **/
+typedef struct {
+  PyObject_HEAD lf_token_t* token;
+  Py_ssize_t shape;
+  Py_ssize_t itemsize;
+  const char* format;
+} py_token_buffer_struct;
+
+extern PyTypeObject py_token_buffer_t;
+
 void python_count_decrement(void* py_object);
+
+/**
+ * Return the port_capsule of a port that is not a multiport (or of a channel of a multiport),
+ * updated with the current value and presence of the port.
+ * The capsule is created the first time and kept by the port, so no capsule is allocated per tag.
+ * @param cport The C port.
+ * @param buffer_format NULL if the port carries Python objects, otherwise the format of an
+ *  element of the arrays that it carries (@see convert_C_token_to_py_buffer).
+ * @return A new reference to the capsule.
+ */
+PyObject* py_port_capsule_of(generic_port_instance_struct* cport, const char* buffer_format);
+
+/**
+ * Return the port_capsule of a multiport, of which the value is None and is_present is false.
+ * The capsule is kept by the first channel as long as it is used with the same array of channels.
+ * @param cport The array of channels.
+ * @param width The width of the multiport.
+ * @param buffer_format As in py_port_capsule_of, used for the channels.
+ * @return A new reference to the capsule.
+ */
+PyObject* py_multiport_capsule_of(generic_port_instance_struct** cport, int width, const char* buffer_format);
+
+/**
+ * Like py_port_capsule_of, but for a port that carries a C scalar.
+ * @param cport The C port.
+ * @param format The format of the scalar: 'q' for int64_t, 'd' for double or '?' for bool.
+ * @return A new reference to the capsule.
+ */
+PyObject* py_scalar_port_capsule_of(scalar_port_instance_struct* cport, char format);
+
+/**
+ * Like py_multiport_capsule_of, but for a multiport that carries C scalars.
+ * @param cport The array of channels.
+ * @param width The width of the multiport.
+ * @param format As in py_scalar_port_capsule_of, used for the channels.
+ * @return A new reference to the capsule.
+ */
+PyObject* py_scalar_multiport_capsule_of(scalar_port_instance_struct** cport, int width, char format);
+
+/**
+ * Return a LinguaFranca.token_buffer that exposes the payload of the token, which is an
+ * array of token->length elements of token->type->element_size bytes, without copying it.
+ * The token stays allocated at least as long as the buffer and any memoryview of it.
+ * @param token The token, or NULL.
+ * @param format The format of an element in the syntax of the struct module, for example "d"
+ *  for double, or NULL to expose the payload as unsigned bytes.
+ * @return A new reference to the buffer, or to None if the token or its value is NULL.
+ */
+PyObject* convert_C_token_to_py_buffer(lf_token_t* token, const char* format);
 #endif
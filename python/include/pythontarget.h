@@ -87,6 +87,18 @@ extern environment_t* top_level_environment;
  **/
 PyObject* py_schedule(PyObject* self, PyObject* args);
 
+/**
+ * Schedule several events of an action at once, as action.schedule_many([(offset, value), ...]).
+ * The value of each tuple is optional, as for schedule(). The events are scheduled in order
+ * with lf_schedule_tokens(), which acquires the mutex of the environment once for all of them,
+ * or stages them at once if the action is physical. If any tuple is invalid, none is scheduled.
+ * @param self The action capsule.
+ * @param args contains:
+ *      - events: A sequence of (offset, value) tuples.
+ * @return A list with the handle of each event, in the order of the tuples (see lf_schedule_tokens()).
+ **/
+PyObject* py_schedule_many(PyObject* self, PyObject* args);
+
 /**
  * Schedule an action to occur with the specified value and time offset
  * with a copy of the specified value.
@@ -142,6 +154,29 @@ PyObject* py_main(PyObject* self, PyObject* args);
  */
 PyObject* convert_C_port_to_py(void* port, int width);
 
+/**
+ * Like convert_C_port_to_py, but for a port that carries an array of C values instead of a
+ * PyObject*. The value of the port_capsule is a LinguaFranca.token_buffer that exposes the
+ * payload of the token without copying it (@see convert_C_token_to_py_buffer) or None if the
+ * port is absent. Each port[idx] of a multiport is converted in the same way.
+ * @param port The C port.
+ * @param width The width of the multiport, or -2 if it is not a multiport.
+ * @param format The format of an element in the syntax of the struct module, for example "d"
+ *  for double, or NULL to expose the payload as unsigned bytes.
+ */
+PyObject* convert_C_buffer_port_to_py(void* port, int width, const char* format);
+
+/**
+ * Like convert_C_port_to_py, but for a port that carries an int64_t, a double or a bool instead of
+ * a PyObject* (@see scalar_port_instance_struct). Setting the port stores the C value, and the
+ * Python object of the value is created only when port.value is read. It is kept for later reads
+ * as long as the C value does not change. Each port[idx] of a multiport is converted in the same way.
+ * @param port The C port.
+ * @param width The width of the multiport, or -2 if it is not a multiport.
+ * @param format 'q' for int64_t, 'd' for double or '?' for bool.
+ */
+PyObject* convert_C_scalar_port_to_py(void* port, int width, char format);
+
 /**
  * A helper function to convert C actions to Python action capsules
  * @see xtext/org.icyphy.linguafranca/src/org/icyphy/generator/CGenerator.xtend for details about C actions
@@ -174,8 +209,10 @@ PyObject* convert_C_action_to_py(void* action);
  *
  * This function would thus call classs[0] to access the first instance in a bank and so on.
  *
- * Possible optimizations include: - Not loading the module each time (by storing it in global memory),
- *                                 - Keeping a persistent argument table
+ * The module is imported once and each list of classes is looked up once, so loading the
+ * functions of a bank costs little more per instance than getting the attribute of the function.
+ *
+ * Possible optimizations include: - Keeping a persistent argument table
  * @param module The Python module to load the function from. In embedded mode, it should
  *               be set to "__main__"
  * @param class The name of the list of classes in the generated Python code
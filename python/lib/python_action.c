@@ -125,6 +125,8 @@ PyMemberDef py_action_capsule_members[] = {
  */
 PyMethodDef py_action_capsule_methods[] = {
     {"schedule", (PyCFunction)py_schedule, METH_VARARGS, "Schedule the action with the given offset"},
+    {"schedule_many", (PyCFunction)py_schedule_many, METH_VARARGS,
+     "Schedule the action once for each (offset, value) tuple of the given sequence and return the handles"},
     {NULL} /* Sentinel */
 };
 
@@ -32,6 +32,7 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
 #include <stddef.h>
+#include <string.h>
 #include <Python.h>
 
 #include "python_port.h"
@@ -40,6 +41,7 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "api/reaction_macros.h"
 
 PyTypeObject py_port_capsule_t;
+PyTypeObject py_token_buffer_t;
 
 //////////// destructor Function(s) /////////////
 /**
@@ -49,6 +51,69 @@ PyTypeObject py_port_capsule_t;
  */
 void python_count_decrement(void* py_object) { Py_XDECREF((PyObject*)py_object); }
 
+//////////// C scalars /////////////
+/**
+ * Return whether two C scalars of the specified format are the same.
+ * Doubles are compared bit by bit, so that 0.0 and -0.0 differ and a NaN equals itself.
+ */
+static bool scalar_equals(char format, python_scalar_t a, python_scalar_t b) {
+  switch (format) {
+  case 'q':
+    return a.int64 == b.int64;
+  case 'd':
+    return memcmp(&a.float64, &b.float64, sizeof(double)) == 0;
+  default:
+    return a.boolean == b.boolean;
+  }
+}
+
+/**
+ * Return a new reference to the Python object of a C scalar of the specified format.
+ * Small integers, True and False are objects cached by Python, so they are not allocated.
+ */
+static PyObject* scalar_to_py(char format, python_scalar_t scalar) {
+  switch (format) {
+  case 'q':
+    return PyLong_FromLongLong(scalar.int64);
+  case 'd':
+    return PyFloat_FromDouble(scalar.float64);
+  default:
+    return PyBool_FromLong(scalar.boolean);
+  }
+}
+
+/**
+ * Convert a Python object to a C scalar of the specified format.
+ * @return Whether the conversion succeeded. If not, a Python exception is set.
+ */
+static bool py_to_scalar(char format, PyObject* value, python_scalar_t* scalar) {
+  switch (format) {
+  case 'q':
+    scalar->int64 = (int64_t)PyLong_AsLongLong(value);
+    return scalar->int64 != -1 || !PyErr_Occurred();
+  case 'd':
+    scalar->float64 = PyFloat_AsDouble(value);
+    return scalar->float64 != -1.0 || !PyErr_Occurred();
+  default: {
+    int truth = PyObject_IsTrue(value);
+    scalar->boolean = truth > 0;
+    return truth >= 0;
+  }
+  }
+}
+
+/** Return whether a Python object is exactly what scalar_to_py returns for its C value. */
+static bool is_exact_scalar(char format, PyObject* value) {
+  switch (format) {
+  case 'q':
+    return PyLong_CheckExact(value);
+  case 'd':
+    return PyFloat_CheckExact(value);
+  default:
+    return PyBool_Check(value);
+  }
+}
+
 //////////// set Function(s) /////////////
 /**
  * Set the value and is_present field of self which is of type
@@ -87,6 +152,30 @@ PyObject* py_port_set(PyObject* self, PyObject* args) {
     return NULL;
   }
 
+  if (p->scalar_format != 0) {
+    scalar_port_instance_struct* port = PyCapsule_GetPointer(p->port, "port");
+    if (port == NULL) {
+      lf_print_error_and_exit("Null pointer received.");
+    }
+    python_scalar_t scalar;
+    if (!py_to_scalar(p->scalar_format, val, &scalar)) {
+      return NULL;
+    }
+    port->value = scalar;
+    lf_set_present(port);
+    // Keep the object if it is what reading the value would create.
+    if (is_exact_scalar(p->scalar_format, val)) {
+      Py_INCREF(val);
+      Py_XSETREF(p->value, val);
+      p->scalar = scalar;
+    } else {
+      Py_CLEAR(p->value);
+    }
+    p->is_present = true;
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
   generic_port_instance_struct* port = PyCapsule_GetPointer(p->port, "port");
   if (port == NULL) {
     lf_print_error("Null pointer received.");
@@ -104,7 +193,8 @@ PyObject* py_port_set(PyObject* self, PyObject* args) {
     Py_INCREF(val);
 
     // Also set the values for the port capsule.
-    p->value = val;
+    Py_INCREF(val);
+    Py_XSETREF(p->value, val);
     p->is_present = true;
   }
 
@@ -153,10 +243,129 @@ PyObject* py_port_capsule_new(PyTypeObject* type, PyObject* args, PyObject* kwds
     self->is_present = false;
     self->current_index = 0;
     self->width = -2;
+    self->buffer_format = NULL;
+    self->scalar_format = 0;
   }
   return (PyObject*)self;
 }
 
+/**
+ * Return a new reference to the value of a C port as it is stored in a port_capsule.
+ * @param cport The C port.
+ * @param buffer_format NULL if the port carries Python objects. Otherwise, the port carries
+ *  C arrays, which are exposed without copying them (@see convert_C_token_to_py_buffer),
+ *  and this is the format of an element.
+ */
+static PyObject* py_port_value(generic_port_instance_struct* cport, const char* buffer_format) {
+  if (buffer_format != NULL) {
+    return convert_C_token_to_py_buffer(cport->is_present ? cport->token : NULL, buffer_format);
+  }
+  PyObject* value = (cport->value != NULL) ? cport->value : Py_None;
+  Py_INCREF(value);
+  return value;
+}
+
+/**
+ * Return the port_capsule kept by a C port, creating it the first time, as a borrowed reference.
+ * @param cport The C port.
+ * @param base The internal fields of the C port.
+ */
+static generic_port_capsule_struct* kept_port_capsule(void* cport, lf_port_internal_t* base) {
+  generic_port_capsule_struct* pyport = (generic_port_capsule_struct*)base->py_capsule;
+  if (pyport == NULL) {
+    pyport = (generic_port_capsule_struct*)py_port_capsule_new(&py_port_capsule_t, NULL, NULL);
+    if (pyport == NULL) {
+      lf_print_error_and_exit("Failed to convert port.");
+    }
+    // Create the capsule to hold the void* port
+    pyport->port = PyCapsule_New(cport, "port", NULL);
+    if (pyport->port == NULL) {
+      lf_print_error_and_exit("Failed to convert port.");
+    }
+    // The C port keeps this reference for as long as the program runs.
+    base->py_capsule = pyport;
+  }
+  return pyport;
+}
+
+PyObject* py_port_capsule_of(generic_port_instance_struct* cport, const char* buffer_format) {
+  generic_port_capsule_struct* pyport = kept_port_capsule(cport, &cport->_base);
+  pyport->is_present = cport->is_present;
+  pyport->buffer_format = buffer_format;
+  FEDERATED_ASSIGN_FIELDS(pyport, cport);
+  Py_XSETREF(pyport->value, py_port_value(cport, buffer_format));
+  Py_INCREF(pyport);
+  return (PyObject*)pyport;
+}
+
+PyObject* py_scalar_port_capsule_of(scalar_port_instance_struct* cport, char format) {
+  generic_port_capsule_struct* pyport = kept_port_capsule(cport, &cport->_base);
+  if (pyport->scalar_format != format) {
+    // The value is created when it is read. See py_port_capsule_get_value.
+    pyport->scalar_format = format;
+    Py_CLEAR(pyport->value);
+  }
+  pyport->is_present = cport->is_present;
+  FEDERATED_ASSIGN_FIELDS(pyport, cport);
+  Py_INCREF(pyport);
+  return (PyObject*)pyport;
+}
+
+PyObject* py_multiport_capsule_of(generic_port_instance_struct** cport, int width, const char* buffer_format) {
+  generic_port_capsule_struct* pyport = NULL;
+  // The capsule is kept by the first channel. It is only valid for the same array of channels.
+  if (width > 0 && cport[0]->_base.py_multiport_capsule != NULL) {
+    pyport = (generic_port_capsule_struct*)cport[0]->_base.py_multiport_capsule;
+    if (PyCapsule_GetPointer(pyport->port, "port") != (void*)cport || pyport->width != width) {
+      pyport = NULL;
+    }
+  }
+  if (pyport == NULL) {
+    pyport = (generic_port_capsule_struct*)py_port_capsule_new(&py_port_capsule_t, NULL, NULL);
+    if (pyport == NULL) {
+      lf_print_error_and_exit("Failed to convert port.");
+    }
+    pyport->port = PyCapsule_New(cport, "port", NULL);
+    if (pyport->port == NULL) {
+      lf_print_error_and_exit("Failed to convert port.");
+    }
+    pyport->width = width;
+    if (width > 0 && cport[0]->_base.py_multiport_capsule == NULL) {
+      cport[0]->_base.py_multiport_capsule = pyport;
+      Py_INCREF(pyport);
+    }
+  } else {
+    Py_INCREF(pyport);
+  }
+  // The value of the multiport itself cannot be accessed; its value is None and is_present is false.
+  pyport->buffer_format = buffer_format;
+  return (PyObject*)pyport;
+}
+
+PyObject* py_scalar_multiport_capsule_of(scalar_port_instance_struct** cport, int width, char format) {
+  // Only the internal fields of the channels are used, which are the same as those of generic ports.
+  generic_port_capsule_struct* pyport =
+      (generic_port_capsule_struct*)py_multiport_capsule_of((generic_port_instance_struct**)cport, width, NULL);
+  pyport->scalar_format = format;
+  return (PyObject*)pyport;
+}
+
+/**
+ * Return a new reference to the port_capsule of a channel of a multiport.
+ * @param multiport The port_capsule of the multiport.
+ * @param index The index of the channel.
+ */
+static PyObject* py_channel_capsule_of(generic_port_capsule_struct* multiport, long index) {
+  void** cport = (void**)PyCapsule_GetPointer(multiport->port, "port");
+  if (cport == NULL) {
+    lf_print_error_and_exit("Null pointer received.");
+  }
+  if (multiport->scalar_format != 0) {
+    return py_scalar_port_capsule_of((scalar_port_instance_struct*)cport[index], multiport->scalar_format);
+  }
+  return py_port_capsule_of((generic_port_instance_struct*)cport[index], multiport->buffer_format);
+}
+
 /**
  * Return an iterator for self, which is a port.
  * This function just have to exist to tell Python that ports are iterable.
@@ -182,7 +391,6 @@ PyObject* py_port_iter(PyObject* self) {
  */
 PyObject* py_port_iter_next(PyObject* self) {
   generic_port_capsule_struct* port = (generic_port_capsule_struct*)self;
-  generic_port_capsule_struct* pyport = (generic_port_capsule_struct*)self->ob_type->tp_new(self->ob_type, NULL, NULL);
 
   if (port->width < 1) {
     PyErr_Format(PyExc_TypeError, "Non-multiport type is not iteratable.");
@@ -194,27 +402,7 @@ PyObject* py_port_iter_next(PyObject* self) {
     return NULL;
   }
 
-  generic_port_instance_struct** cport = (generic_port_instance_struct**)PyCapsule_GetPointer(port->port, "port");
-  if (cport == NULL) {
-    lf_print_error_and_exit("Null pointer received.");
-  }
-
-  // Py_XINCREF(cport[index]->value);
-  pyport->port = PyCapsule_New(cport[port->current_index], "port", NULL);
-  pyport->value = cport[port->current_index]->value;
-  pyport->is_present = cport[port->current_index]->is_present;
-  pyport->width = -2;
-  FEDERATED_ASSIGN_FIELDS(pyport, cport[port->current_index]);
-
-  port->current_index++;
-
-  if (pyport->value == NULL) {
-    Py_INCREF(Py_None);
-    pyport->value = Py_None;
-  }
-
-  Py_XINCREF(pyport);
-  return (PyObject*)pyport;
+  return py_channel_capsule_of(port, port->current_index++);
 }
 /**
  * Get an item from a Linugua Franca port capsule type.
@@ -243,7 +431,6 @@ PyObject* py_port_capsule_get_item(PyObject* self, PyObject* key) {
     return NULL;
   }
 
-  generic_port_capsule_struct* pyport = (generic_port_capsule_struct*)self->ob_type->tp_new(self->ob_type, NULL, NULL);
   long long index = -3;
 
   index = PyLong_AsLong(key);
@@ -252,29 +439,9 @@ PyObject* py_port_capsule_get_item(PyObject* self, PyObject* key) {
     return NULL;
   }
 
-  generic_port_instance_struct** cport = (generic_port_instance_struct**)PyCapsule_GetPointer(port->port, "port");
-  if (cport == NULL) {
-    lf_print_error_and_exit("Null pointer received.");
-  }
-
-  // Py_INCREF(cport[index]->value);
-  pyport->port = PyCapsule_New(cport[index], "port", NULL);
-  pyport->value = cport[index]->value;
-  pyport->is_present = cport[index]->is_present;
-  pyport->width = -2;
-  FEDERATED_ASSIGN_FIELDS(pyport, cport[index]);
-
-  LF_PRINT_LOG("Getting item index %lld. Is present is %d.", index, pyport->is_present);
-
-  if (pyport->value == NULL) {
-    Py_INCREF(Py_None);
-    pyport->value = Py_None;
-  }
+  LF_PRINT_LOG("Getting item index %lld.", index);
 
-  // Py_INCREF(((generic_port_capsule_struct*)port)->value);
-  Py_XINCREF(pyport);
-  // Py_INCREF(self);
-  return (PyObject*)pyport;
+  return py_channel_capsule_of(port, (long)index);
 }
 
 /**
@@ -348,24 +515,61 @@ int py_port_capsule_init(generic_port_capsule_struct* self, PyObject* args, PyOb
   return 0;
 }
 
+/**
+ * Return the value of a port_capsule, which is None if it is absent.
+ * For ports that carry C scalars, the Python object of the C value is created here, and kept
+ * by the capsule for later reads as long as the C value does not change.
+ * @param self A port of type LinguaFranca.port_capsule
+ * @param closure Not used.
+ */
+PyObject* py_port_capsule_get_value(generic_port_capsule_struct* self, void* closure) {
+  if (self->scalar_format != 0 && self->is_present) {
+    scalar_port_instance_struct* cport = PyCapsule_GetPointer(self->port, "port");
+    if (cport == NULL) {
+      lf_print_error_and_exit("Null pointer received.");
+    }
+    if (self->value == NULL || !scalar_equals(self->scalar_format, self->scalar, cport->value)) {
+      PyObject* value = scalar_to_py(self->scalar_format, cport->value);
+      if (value == NULL) {
+        return NULL;
+      }
+      Py_XSETREF(self->value, value);
+      self->scalar = cport->value;
+    }
+  } else if (self->scalar_format != 0 || self->value == NULL) {
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+  Py_INCREF(self->value);
+  return self->value;
+}
+
 ////// Ports //////
 /*
  * The members of a port_capsule, used to define
  * a native Python type.
  * port contains the port capsule, which holds a void* pointer to the underlying C port.
- * value contains the copied value of the C port. The type is always PyObject*.
  * is_present contains the copied value of the is_present field of the C port.
  * width indicates the width of a multiport or -2 if not a multiport.
+ * The value of the port is an attribute with a getter (@see py_port_capsule_getset).
  */
 PyMemberDef py_port_capsule_members[] = {
     {"port", T_OBJECT, offsetof(generic_port_capsule_struct, port), READONLY, ""},
-    {"value", T_OBJECT, offsetof(generic_port_capsule_struct, value), READONLY, "Value of the port"},
     {"is_present", T_BOOL, offsetof(generic_port_capsule_struct, is_present), READONLY,
      "Check if value is present at current logical time"},
     {"width", T_INT, offsetof(generic_port_capsule_struct, width), READONLY, "Width of the multiport"},
     FEDERATED_CAPSULE_MEMBER{NULL} /* Sentinel */
 };
 
+/*
+ * The attributes of port_capsule that are computed when they are read.
+ * value is the value of the port, which is None if it is absent.
+ */
+PyGetSetDef py_port_capsule_getset[] = {
+    {"value", (getter)py_port_capsule_get_value, NULL, "Value of the port", NULL},
+    {NULL} /* Sentinel */
+};
+
 /*
  * The function members of port_capsule
  * __getitem__ is used to reference a multiport with an index (e.g., foo[2])
@@ -395,4 +599,95 @@ PyTypeObject py_port_capsule_t = {
     .tp_dealloc = (destructor)py_port_capsule_dealloc,
     .tp_members = py_port_capsule_members,
     .tp_methods = py_port_capsule_methods,
+    .tp_getset = py_port_capsule_getset,
+};
+
+////// Token buffers //////
+PyObject* convert_C_token_to_py_buffer(lf_token_t* token, const char* format) {
+  if (token == NULL || token->value == NULL) {
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+  py_token_buffer_struct* self = PyObject_New(py_token_buffer_struct, &py_token_buffer_t);
+  if (self == NULL) {
+    return NULL;
+  }
+  size_t element_size = token->type->element_size;
+  if (format == NULL || element_size == 0) {
+    self->shape = (Py_ssize_t)(token->length * element_size);
+    self->itemsize = 1;
+    self->format = "B";
+  } else {
+    self->shape = (Py_ssize_t)token->length;
+    self->itemsize = (Py_ssize_t)element_size;
+    self->format = format;
+  }
+  // Keep the token, and hence its value, from being freed at the end of the tag.
+  LF_CRITICAL_SECTION_ENTER(top_level_environment);
+  token->ref_count++;
+  LF_CRITICAL_SECTION_EXIT(top_level_environment);
+  self->token = token;
+  return (PyObject*)self;
+}
+
+/**
+ * Release the reference to the token, which frees it if no port or action still refers to it.
+ * This is called when neither the buffer nor any memoryview of it is used any more.
+ * @param self An instance of py_token_buffer_struct*
+ */
+void py_token_buffer_dealloc(py_token_buffer_struct* self) {
+  LF_CRITICAL_SECTION_ENTER(top_level_environment);
+  _lf_done_using(self->token);
+  LF_CRITICAL_SECTION_EXIT(top_level_environment);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+/**
+ * Fill in a read-only, one-dimensional, contiguous view of the payload.
+ * @see https://docs.python.org/3/c-api/typeobj.html#c.PyBufferProcs.bf_getbuffer
+ */
+int py_token_buffer_get_buffer(py_token_buffer_struct* self, Py_buffer* view, int flags) {
+  if (flags & PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "The payload of a token is read only. Copy it to modify it.");
+    view->obj = NULL;
+    return -1;
+  }
+  view->obj = (PyObject*)self;
+  Py_INCREF(self);
+  view->buf = self->token->value;
+  view->len = self->shape * self->itemsize;
+  view->readonly = 1;
+  view->itemsize = self->itemsize;
+  view->format = (flags & PyBUF_FORMAT) ? (char*)self->format : NULL;
+  view->ndim = 1;
+  view->shape = (flags & PyBUF_ND) ? &self->shape : NULL;
+  view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? &self->itemsize : NULL;
+  view->suboffsets = NULL;
+  view->internal = NULL;
+  return 0;
+}
+
+/**
+ * A function that allows the invocation of len() on a token buffer, which is the number of elements.
+ * @param self A buffer of type LinguaFranca.token_buffer
+ */
+Py_ssize_t py_token_buffer_length(PyObject* self) { return ((py_token_buffer_struct*)self)->shape; }
+
+PyBufferProcs py_token_buffer_as_buffer = {(getbufferproc)py_token_buffer_get_buffer, NULL};
+
+PySequenceMethods py_token_buffer_as_sequence = {.sq_length = py_token_buffer_length};
+
+/*
+ * The definition of token_buffer type object, which is
+ * used to describe how token_buffer behaves.
+ */
+PyTypeObject py_token_buffer_t = {
+    PyVarObject_HEAD_INIT(NULL, 0).tp_name = "LinguaFranca.token_buffer",
+    .tp_doc = "Read-only view of the payload of a token",
+    .tp_basicsize = sizeof(py_token_buffer_struct),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_as_buffer = &py_token_buffer_as_buffer,
+    .tp_as_sequence = &py_token_buffer_as_sequence,
+    .tp_dealloc = (destructor)py_token_buffer_dealloc,
 };
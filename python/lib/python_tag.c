@@ -36,17 +36,32 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 PyTypeObject PyTagType;
 
 /**
- * Return the current tag object.
+ * The most recently converted tag. Tags are immutable in Python, so reactions
+ * that ask for the same tag share this object instead of allocating one each time.
  */
-PyObject* py_lf_tag(PyObject* self, PyObject* args) {
-  py_tag_t* t = (py_tag_t*)PyType_GenericNew(&PyTagType, NULL, NULL);
-  if (t == NULL) {
-    return NULL;
+static py_tag_t* last_tag = NULL;
+
+/**
+ * Return a new reference to a Tag object for the given tag, or NULL on failure.
+ */
+static py_tag_t* py_tag_of(tag_t c_tag) {
+  if (last_tag == NULL || lf_tag_compare(last_tag->tag, c_tag) != 0) {
+    py_tag_t* t = (py_tag_t*)PyType_GenericNew(&PyTagType, NULL, NULL);
+    if (t == NULL) {
+      return NULL;
+    }
+    t->tag = c_tag;
+    Py_XSETREF(last_tag, t);
   }
-  t->tag = lf_tag(top_level_environment);
-  return (PyObject*)t;
+  Py_INCREF(last_tag);
+  return last_tag;
 }
 
+/**
+ * Return the current tag object.
+ */
+PyObject* py_lf_tag(PyObject* self, PyObject* args) { return (PyObject*)py_tag_of(lf_tag(top_level_environment)); }
+
 /**
  * Compare two tags. Return -1 if the first is less than
  * the second, 0 if they are equal, and +1 if the first is
@@ -191,10 +206,9 @@ PyTypeObject PyTagType = {
  * @return PyObject* The tag in Python.
  */
 py_tag_t* convert_C_tag_to_py(tag_t c_tag) {
-  py_tag_t* py_tag = PyObject_GC_New(py_tag_t, &PyTagType);
+  py_tag_t* py_tag = py_tag_of(c_tag);
   if (py_tag == NULL) {
     lf_print_error_and_exit("Failed to convert tag from C to Python.");
   }
-  py_tag->tag = c_tag;
   return py_tag;
 }
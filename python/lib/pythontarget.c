@@ -112,6 +112,106 @@ PyObject* py_schedule(PyObject* self, PyObject* args) {
   return Py_None;
 }
 
+/**
+ * Schedule an action once for each (offset, value) tuple of a sequence.
+ * This function is callable in Python by calling action_name.schedule_many(events).
+ * Some examples include:
+ *  action_name.schedule_many([(0, "a"), (MSEC(1), "b")])
+ * It returns the list of the handles of the events, as lf_schedule_tokens() gives them.
+ * See lf_schedule_tokens(), which this uses, for details.
+ **/
+PyObject* py_schedule_many(PyObject* self, PyObject* args) {
+  generic_action_capsule_struct* act = (generic_action_capsule_struct*)self;
+  PyObject* events = NULL;
+
+  if (!PyArg_ParseTuple(args, "O", &events))
+    return NULL;
+
+  lf_action_base_t* action = (lf_action_base_t*)PyCapsule_GetPointer(act->action, "action");
+  if (action == NULL) {
+    lf_print_error("Null pointer received.");
+    exit(1);
+  }
+
+  PyObject* sequence = PySequence_Fast(events, "schedule_many() expects a sequence of (offset, value) tuples.");
+  if (sequence == NULL)
+    return NULL;
+  size_t count = (size_t)PySequence_Fast_GET_SIZE(sequence);
+  PyObject** items = PySequence_Fast_ITEMS(sequence);
+  if (count == 0) {
+    Py_DECREF(sequence);
+    return PyList_New(0);
+  }
+
+  // Parse all the events before scheduling any of them, so that none is scheduled if one is invalid.
+  interval_t* offsets = (interval_t*)malloc(count * sizeof(interval_t));
+  PyObject** values = (PyObject**)malloc(count * sizeof(PyObject*));
+  lf_token_t** tokens = (lf_token_t**)calloc(count, sizeof(lf_token_t*));
+  trigger_handle_t* handles = (trigger_handle_t*)malloc(count * sizeof(trigger_handle_t));
+  if (offsets == NULL || values == NULL || tokens == NULL || handles == NULL) {
+    free(offsets);
+    free(values);
+    free(tokens);
+    free(handles);
+    Py_DECREF(sequence);
+    return PyErr_NoMemory();
+  }
+  for (size_t i = 0; i < count; i++) {
+    long long offset;
+    values[i] = NULL;
+    if (!PyTuple_Check(items[i]) || !PyArg_ParseTuple(items[i], "L|O", &offset, &values[i])) {
+      if (!PyErr_Occurred()) {
+        PyErr_SetString(PyExc_TypeError, "schedule_many() expects a sequence of (offset, value) tuples.");
+      }
+      free(offsets);
+      free(values);
+      free(tokens);
+      free(handles);
+      Py_DECREF(sequence);
+      return NULL;
+    }
+    offsets[i] = (interval_t)offset;
+  }
+
+  trigger_t* trigger = action->trigger;
+  if (trigger->tmplt.token != NULL) {
+    // Each event needs a token of its own, because the token of the template is reused after it is scheduled.
+    trigger->tmplt.token->type->element_size = sizeof(PyObject*);
+    trigger->tmplt.type.element_size = sizeof(PyObject*);
+    for (size_t i = 0; i < count; i++) {
+      PyObject* value = values[i];
+      if (value != NULL) {
+        // The token holds a reference to the value until the destructor of the action releases it.
+        Py_INCREF(value);
+        tokens[i] = _lf_new_token((token_type_t*)&trigger->tmplt, value, 1);
+        // Also give the last value back to the Python action itself.
+        Py_INCREF(value);
+        Py_XSETREF(act->value, value);
+      }
+    }
+  }
+
+  // Pass the tokens along, with the mutex acquired once.
+  lf_schedule_tokens(action, count, offsets, tokens, handles);
+
+  free(offsets);
+  free(values);
+  free(tokens);
+  Py_DECREF(sequence);
+
+  PyObject* result = PyList_New((Py_ssize_t)count);
+  for (size_t i = 0; result != NULL && i < count; i++) {
+    PyObject* handle = PyLong_FromLongLong((long long)handles[i]);
+    if (handle == NULL) {
+      Py_CLEAR(result);
+    } else {
+      PyList_SET_ITEM(result, (Py_ssize_t)i, handle);
+    }
+  }
+  free(handles);
+  return result;
+}
+
 /**
  * Schedule an action to occur with the specified value and time offset
  * with a copy of the specified value.
@@ -151,6 +251,19 @@ int lf_reactor_c_main(int argc, const char* argv[]);
  */
 void lf_request_stop(void);
 
+/**
+ * Acquire the GIL for a worker that is about to execute reactions.
+ * The runtime calls this so that the GIL is acquired once for consecutive reactions.
+ * @see reactor_threaded.h
+ */
+int _lf_python_gil_ensure(void) { return (int)PyGILState_Ensure(); }
+
+/**
+ * Release the GIL acquired by _lf_python_gil_ensure().
+ * @see reactor_threaded.h
+ */
+void _lf_python_gil_release(int state) { PyGILState_Release((PyGILState_STATE)state); }
+
 ///////////////// Other useful functions /////////////////////
 /**
  * Stop execution at the conclusion of the current logical time.
@@ -361,6 +474,11 @@ PyMODINIT_FUNC GEN_NAME(PyInit_, MODULE_NAME)(void) {
     return NULL;
   }
 
+  // Initialize the token_buffer type
+  if (PyType_Ready(&py_token_buffer_t) < 0) {
+    return NULL;
+  }
+
   // Initialize the action_capsule type
   if (PyType_Ready(&py_action_capsule_t) < 0) {
     return NULL;
@@ -392,6 +510,14 @@ PyMODINIT_FUNC GEN_NAME(PyInit_, MODULE_NAME)(void) {
     return NULL;
   }
 
+  // Add the token_buffer type to the module's dictionary
+  Py_INCREF(&py_token_buffer_t);
+  if (PyModule_AddObject(m, "token_buffer", (PyObject*)&py_token_buffer_t) < 0) {
+    Py_DECREF(&py_token_buffer_t);
+    Py_DECREF(m);
+    return NULL;
+  }
+
   // Add the action_capsule type to the module's dictionary
   Py_INCREF(&py_action_capsule_t);
   if (PyModule_AddObject(m, "action_capsule_t", (PyObject*)&py_action_capsule_t) < 0) {
@@ -433,6 +559,9 @@ void destroy_action_capsule(PyObject* capsule) { free(PyCapsule_GetPointer(capsu
  * ports as inputs and outputs. This function converts ports that are
  * either a multiport or a non-multiport into a port_capsule.
  *
+ * The port_capsule is created the first time the port is passed to Python and
+ * is updated in place on later calls, so no capsule is allocated per tag.
+ *
  * First, the void* pointer is stored in a PyCapsule. If the port is not
  * a multiport, the value and is_present fields are copied verbatim. These
  * feilds then can be accessed from the Python code as port.value and
@@ -444,46 +573,25 @@ void destroy_action_capsule(PyObject* capsule) { free(PyCapsule_GetPointer(capsu
  * Individual ports can then later be accessed in Python code as port[idx].
  */
 PyObject* convert_C_port_to_py(void* port, int width) {
-  // Create the port struct in Python
-  PyObject* cap = (PyObject*)PyObject_GC_New(generic_port_capsule_struct, &py_port_capsule_t);
-  if (cap == NULL) {
-    lf_print_error_and_exit("Failed to convert port.");
+  if (width == -2) {
+    return py_port_capsule_of((generic_port_instance_struct*)port, NULL);
   }
+  return py_multiport_capsule_of((generic_port_instance_struct**)port, width, NULL);
+}
 
-  // Create the capsule to hold the void* port
-  PyObject* capsule = PyCapsule_New(port, "port", NULL);
-  if (capsule == NULL) {
-    lf_print_error_and_exit("Failed to convert port.");
+PyObject* convert_C_buffer_port_to_py(void* port, int width, const char* format) {
+  // Multiports create the buffers of their channels on access.
+  if (width == -2) {
+    return py_port_capsule_of((generic_port_instance_struct*)port, format);
   }
+  return py_multiport_capsule_of((generic_port_instance_struct**)port, width, format);
+}
 
-  // Fill in the Python port struct
-  ((generic_port_capsule_struct*)cap)->port = capsule;
-  ((generic_port_capsule_struct*)cap)->width = width;
-
+PyObject* convert_C_scalar_port_to_py(void* port, int width, char format) {
   if (width == -2) {
-    generic_port_instance_struct* cport = (generic_port_instance_struct*)port;
-    FEDERATED_ASSIGN_FIELDS(((generic_port_capsule_struct*)cap), cport);
-
-    ((generic_port_capsule_struct*)cap)->is_present = cport->is_present;
-
-    if (cport->value == NULL) {
-      // Value is absent
-      Py_INCREF(Py_None);
-      ((generic_port_capsule_struct*)cap)->value = Py_None;
-      return cap;
-    }
-
-    // Py_INCREF(cport->value);
-    ((generic_port_capsule_struct*)cap)->value = cport->value;
-  } else {
-    // Multiport. Value of the multiport itself cannot be accessed, so we set it to
-    // None.
-    Py_INCREF(Py_None);
-    ((generic_port_capsule_struct*)cap)->value = Py_None;
-    ((generic_port_capsule_struct*)cap)->is_present = false;
+    return py_scalar_port_capsule_of((scalar_port_instance_struct*)port, format);
   }
-
-  return cap;
+  return py_scalar_multiport_capsule_of((scalar_port_instance_struct**)port, width, format);
 }
 
 /**
@@ -511,40 +619,89 @@ PyObject* convert_C_action_to_py(void* action) {
   // Convert to trigger_t
   trigger_t* trigger = ((lf_action_base_t*)action)->trigger;
 
-  // Create the action struct in Python
-  PyObject* cap = (PyObject*)PyObject_GC_New(generic_action_capsule_struct, &py_action_capsule_t);
+  // The action struct in Python is created the first time and updated in place afterwards.
+  generic_action_capsule_struct* cap = (generic_action_capsule_struct*)trigger->py_capsule;
   if (cap == NULL) {
-    lf_print_error_and_exit("Failed to convert action.");
-  }
+    cap = (generic_action_capsule_struct*)py_action_capsule_t.tp_new(&py_action_capsule_t, NULL, NULL);
+    if (cap == NULL) {
+      lf_print_error_and_exit("Failed to convert action.");
+    }
 
-  // Create the capsule to hold the void* action
-  PyObject* capsule = PyCapsule_New(action, "action", NULL);
-  if (capsule == NULL) {
-    lf_print_error_and_exit("Failed to convert action.");
+    // Create the capsule to hold the void* action
+    cap->action = PyCapsule_New(action, "action", NULL);
+    if (cap->action == NULL) {
+      lf_print_error_and_exit("Failed to convert action.");
+    }
+    // The trigger keeps this reference for as long as the program runs.
+    trigger->py_capsule = cap;
   }
 
   // Fill in the Python action struct
-  ((generic_action_capsule_struct*)cap)->action = capsule;
-  ((generic_action_capsule_struct*)cap)->is_present = trigger->status;
+  cap->is_present = trigger->status;
   FEDERATED_ASSIGN_FIELDS(((generic_port_capsule_struct*)cap), ((generic_action_instance_struct*)action));
 
-  // If token is not initialized, that is all we need to set
-  if (trigger->tmplt.token == NULL) {
-    Py_INCREF(Py_None);
-    ((generic_action_capsule_struct*)cap)->value = Py_None;
-    return cap;
+  PyObject* value = Py_None;
+  if (trigger->tmplt.token != NULL) {
+    // Default value is None
+    if (trigger->tmplt.token->value == NULL) {
+      Py_INCREF(Py_None);
+      trigger->tmplt.token->value = Py_None;
+    }
+    // Actions in Python always use token type
+    value = (PyObject*)trigger->tmplt.token->value;
   }
+  Py_INCREF(value);
+  Py_XSETREF(cap->value, value);
 
-  // Default value is None
-  if (trigger->tmplt.token->value == NULL) {
-    Py_INCREF(Py_None);
-    trigger->tmplt.token->value = Py_None;
-  }
+  Py_INCREF(cap);
+  return (PyObject*)cap;
+}
 
-  // Actions in Python always use token type
-  ((generic_action_capsule_struct*)cap)->value = trigger->tmplt.token->value;
+/** A list of the instances of a class in the Python module. See get_python_class_list(). */
+typedef struct python_class_list_t {
+  char* name;          // The name of the list in the module.
+  PyObject* instances; // A strong reference to the list.
+} python_class_list_t;
 
-  return cap;
+/** The lists of instances looked up so far. Only accessed while holding the GIL. */
+static python_class_list_t* python_class_lists = NULL;
+static size_t python_class_lists_size = 0;
+static size_t python_class_lists_last = 0; // Index of the list most recently looked up.
+
+/**
+ * Return the list of instances of the specified name in globalPythonModuleDict as a borrowed
+ * reference, or NULL if there is none. Each list is looked up in the dictionary only once, so
+ * that loading the functions of a bank of reactors costs one lookup per class rather than per
+ * instance. The functions of the instances of a class are usually loaded one after another,
+ * so the list most recently looked up is checked first. The caller must hold the GIL.
+ * @param class The name of the list.
+ */
+static PyObject* get_python_class_list(string class) {
+  if (python_class_lists_last < python_class_lists_size &&
+      strcmp(python_class_lists[python_class_lists_last].name, class) == 0) {
+    return python_class_lists[python_class_lists_last].instances;
+  }
+  for (size_t i = 0; i < python_class_lists_size; i++) {
+    if (strcmp(python_class_lists[i].name, class) == 0) {
+      python_class_lists_last = i;
+      return python_class_lists[i].instances;
+    }
+  }
+  PyObject* instances = PyDict_GetItemString(globalPythonModuleDict, class);
+  if (instances == NULL) {
+    return NULL;
+  }
+  python_class_list_t* lists =
+      (python_class_list_t*)realloc(python_class_lists, (python_class_lists_size + 1) * sizeof(python_class_list_t));
+  char* name = strdup(class);
+  if (lists == NULL || name == NULL) {
+    lf_print_error_and_exit("Out of memory.");
+  }
+  Py_INCREF(instances);
+  python_class_lists = lists;
+  python_class_lists_last = python_class_lists_size++;
+  python_class_lists[python_class_lists_last] = (python_class_list_t){.name = name, .instances = instances};
+  return instances;
 }
 
 /**
@@ -556,8 +713,10 @@ PyObject* convert_C_action_to_py(void* action) {
  *
  * This function would thus call classs[0] to access the first instance in a bank and so on.
  *
- * Possible optimizations include: - Not loading the module each time (by storing it in global memory),
- *                                 - Keeping a persistent argument table
+ * The module is imported once and each list of classes is looked up once, so loading the
+ * functions of a bank costs little more per instance than getting the attribute of the function.
+ *
+ * Possible optimizations include: - Keeping a persistent argument table
  * @param module The Python module to load the function from. In embedded mode, it should
  *               be set to "__main__"
  * @param class The name of the list of classes in the generated Python code
@@ -633,13 +792,8 @@ PyObject* get_python_function(string module, string class, int instance_id, stri
   }
 
   if (globalPythonModule != NULL && globalPythonModuleDict != NULL) {
-    Py_INCREF(globalPythonModule);
-    // Convert the class name to a PyObject
-    PyObject* list_name = PyUnicode_DecodeFSDefault(class);
-
     // Get the class list
-    Py_INCREF(globalPythonModuleDict);
-    pClasses = PyDict_GetItem(globalPythonModuleDict, list_name);
+    pClasses = get_python_class_list(class);
     if (pClasses == NULL) {
       PyErr_Print();
       lf_print_error("Failed to load class list \"%s\" in module %s.", class, module);
@@ -648,8 +802,6 @@ PyObject* get_python_function(string module, string class, int instance_id, stri
       return NULL;
     }
 
-    Py_DECREF(globalPythonModuleDict);
-
     pClass = PyList_GetItem(pClasses, instance_id);
     if (pClass == NULL) {
       PyErr_Print();
@@ -682,7 +834,6 @@ PyObject* get_python_function(string module, string class, int instance_id, stri
       lf_print_error("Function %s was not found or is not callable.", func);
     }
     Py_XDECREF(pFunc);
-    Py_DECREF(globalPythonModule);
   } else {
     PyErr_Print();
     lf_print_error("Failed to load \"%s\".", module);
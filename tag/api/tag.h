@@ -53,6 +53,7 @@
 // Convenience for converting times
 #define BILLION ((instant_t)1000000000LL)
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <limits.h>
@@ -162,6 +163,60 @@ tag_t lf_delay_tag(tag_t tag, interval_t interval);
  */
 tag_t lf_delay_strict(tag_t tag, interval_t interval);
 
+////////////////  Inline versions
+
+// The functions below are the implementations of lf_time_add(), lf_tag_add(), lf_tag_compare(),
+// and lf_delay_tag(), which call them. They are defined here so that the event queues and the
+// RTI, which call them for every comparison, can have them inlined. They handle NEVER, FOREVER,
+// and overflow by selecting among results rather than by returning early, which compilers turn
+// into conditional moves instead of branches.
+
+/** Inline version of lf_time_add(). */
+static inline instant_t _lf_time_add(instant_t a, interval_t b) {
+  // Unsigned addition wraps instead of being undefined. It overflowed if both operands
+  // have a sign different from that of the sum.
+  instant_t sum = (instant_t)((uint64_t)a + (uint64_t)b);
+  bool overflow = ((a ^ sum) & (b ^ sum)) < 0;
+  sum = overflow ? ((b > 0) ? FOREVER : NEVER) : sum;
+  sum = (a == FOREVER || b == FOREVER) ? FOREVER : sum;
+  return (a == NEVER || b == NEVER) ? NEVER : sum;
+}
+
+/** Inline version of lf_tag_add(). */
+static inline tag_t _lf_tag_add(tag_t a, tag_t b) {
+  instant_t time = _lf_time_add(a.time, b.time);
+  // A positive time resets the microstep of the first tag.
+  microstep_t base = (b.time > 0) ? 0u : a.microstep;
+  microstep_t microstep = base + b.microstep;
+  bool forever = time == FOREVER || (microstep < base && time != NEVER);
+  microstep = (time == NEVER) ? NEVER_MICROSTEP : microstep;
+  tag_t result;
+  result.time = forever ? FOREVER : time;
+  result.microstep = forever ? FOREVER_MICROSTEP : microstep;
+  return result;
+}
+
+/** Inline version of lf_tag_compare(). */
+static inline int _lf_tag_compare(tag_t tag1, tag_t tag2) {
+  int time = (tag1.time > tag2.time) - (tag1.time < tag2.time);
+  int microstep = (tag1.microstep > tag2.microstep) - (tag1.microstep < tag2.microstep);
+  // The time decides unless it is equal, in which case the microstep does.
+  int order = 2 * time + microstep;
+  return (order > 0) - (order < 0);
+}
+
+/** Inline version of lf_delay_tag(). */
+static inline tag_t _lf_delay_tag(tag_t tag, interval_t interval) {
+  bool unchanged = tag.time == NEVER || interval < 0;
+  interval_t delay = (interval < 0) ? 0 : interval;
+  bool forever = !unchanged && tag.time >= FOREVER - delay;
+  // A zero delay increments the microstep, which wraps on overflow.
+  tag_t delayed;
+  delayed.time = forever ? FOREVER : (instant_t)((uint64_t)tag.time + (uint64_t)delay);
+  delayed.microstep = forever ? FOREVER_MICROSTEP : ((delay == 0) ? tag.microstep + 1 : 0u);
+  return unchanged ? tag : delayed;
+}
+
 /**
  * Return the current logical time in nanoseconds.
  * On many platforms, this is the number of nanoseconds
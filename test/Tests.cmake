@@ -40,7 +40,254 @@ foreach(FILE ${TEST_FILES})
         ${NAME} PRIVATE
         ${CoreLib} ${Lib}
     )
+    # The platform implementation uses the clock of the core library, which the linker
+    # only finds if the core library is scanned again after it.
+    target_link_libraries(${NAME} PRIVATE lf::low-level-platform-impl ${CoreLib})
     target_include_directories(${NAME} PRIVATE ${TEST_DIR})
     # Warnings as errors
     lf_enable_compiler_warnings(${NAME})
 endforeach(FILE ${TEST_FILES})
+
+# End-to-end tests in the runtime directory build their reaction graph as the generated code would (see
+# benchmark/benchmark.h), so they are not linked with the stub of the generated code. The schedule test is also run in
+# a build with each option that changes lib/schedule.c, in runtime_tests/<variant>, so that the functions of lib are
+# tested with the definitions of the runtime they are linked with.
+if(NOT DEFINED FEDERATED)
+    add_executable(runtime_schedule_test ${TEST_DIR}/runtime/schedule_test.c)
+    target_link_libraries(runtime_schedule_test PRIVATE lf::low-level-platform-impl)
+    target_link_libraries(runtime_schedule_test PRIVATE ${CoreLib} ${Lib})
+    target_include_directories(runtime_schedule_test PRIVATE ${TEST_DIR}/benchmark)
+    lf_enable_compiler_warnings(runtime_schedule_test)
+    add_test(NAME runtime_schedule_test COMMAND runtime_schedule_test -f true)
+
+    set(RUNTIME_TEST_DIR ${CMAKE_BINARY_DIR}/runtime_tests)
+    foreach(VARIANT calendar calendar_single_threaded latency record_replay pipelining)
+        set(VARIANT_RECORD)
+        if(${VARIANT} STREQUAL "calendar")
+            set(VARIANT_OPTIONS -DLF_CALENDAR_QUEUE=1)
+        elseif(${VARIANT} STREQUAL "calendar_single_threaded")
+            set(VARIANT_OPTIONS -DLF_CALENDAR_QUEUE=1 -DLF_SINGLE_THREADED=1)
+        elseif(${VARIANT} STREQUAL "latency")
+            set(VARIANT_OPTIONS -DLF_LATENCY=1)
+        elseif(${VARIANT} STREQUAL "record_replay")
+            set(VARIANT_OPTIONS -DLF_RECORD_REPLAY=1)
+            set(VARIANT_RECORD -DRECORD=${RUNTIME_TEST_DIR}/${VARIANT}/arrivals.log)
+        elseif(${VARIANT} STREQUAL "pipelining")
+            set(VARIANT_OPTIONS -DLF_TAG_PIPELINING=1)
+        endif()
+        add_test(
+            NAME runtime_schedule_test_${VARIANT}
+            COMMAND ${CMAKE_COMMAND} -DLF_ROOT=${LF_ROOT} -DBUILD_DIR=${RUNTIME_TEST_DIR}/${VARIANT}
+                "-DOPTIONS=${VARIANT_OPTIONS}" -DTEST=runtime_schedule_test -DARGS=-f\;true ${VARIANT_RECORD}
+                -P ${TEST_DIR}/runtime/run_in_build.cmake
+        )
+    endforeach(VARIANT)
+endif()
+
+# Benchmarks in the benchmark directory are built but not run as tests.
+# The benchmark of the tag-sorted priority queue is built once for each implementation.
+set(PQUEUE_TAG_BENCHMARK_SRCS
+    ${TEST_DIR}/benchmark/pqueue_tag_benchmark.c
+    ${LF_ROOT}/core/utils/vector.c
+    ${LF_ROOT}/core/utils/pqueue_base.c
+    ${LF_ROOT}/core/utils/pqueue_base_dary.c
+    ${LF_ROOT}/core/utils/pqueue_tag.c
+    ${LF_ROOT}/core/utils/pqueue_tag_calendar.c
+    ${LF_ROOT}/core/utils/util.c
+    ${LF_ROOT}/core/tag.c
+    ${LF_ROOT}/core/clock.c
+    ${TEST_MOCK_SRCS}
+)
+foreach(VARIANT heap calendar dary4 dary8)
+    set(NAME pqueue_tag_benchmark_${VARIANT})
+    add_executable(${NAME} ${PQUEUE_TAG_BENCHMARK_SRCS})
+    if(${VARIANT} STREQUAL "calendar")
+        target_compile_definitions(${NAME} PRIVATE LF_CALENDAR_QUEUE)
+    elseif(${VARIANT} MATCHES "^dary([0-9]+)$")
+        target_compile_definitions(${NAME} PRIVATE LF_PQUEUE_ARITY=${CMAKE_MATCH_1})
+    endif()
+    target_link_libraries(
+        ${NAME} PRIVATE
+        lf::low-level-platform-api lf::low-level-platform-impl lf::logging-api lf::tag-api
+        lf::trace-api-types lf::version-api lf::platform-api
+    )
+    target_include_directories(${NAME} PRIVATE ${TEST_DIR})
+endforeach(VARIANT)
+
+# Micro-benchmarks of the runtime data structures, linked against the runtime as configured.
+# They are run by the benchmarks target, which writes the results to micro_benchmark.json.
+add_executable(micro_benchmark ${TEST_DIR}/benchmark/micro_benchmark.c ${TEST_MOCK_SRCS})
+target_link_libraries(micro_benchmark PRIVATE lf::low-level-platform-impl)
+target_link_libraries(micro_benchmark PRIVATE ${CoreLib} ${Lib})
+target_include_directories(micro_benchmark PRIVATE ${TEST_DIR})
+lf_enable_compiler_warnings(micro_benchmark)
+add_custom_target(
+    benchmarks
+    COMMAND micro_benchmark 11 ${CMAKE_BINARY_DIR}/micro_benchmark.json
+    COMMAND ${CMAKE_COMMAND} -E cat ${CMAKE_BINARY_DIR}/micro_benchmark.json
+    DEPENDS micro_benchmark
+    COMMENT "Running micro-benchmarks"
+)
+
+# Synthetic workload for the scheduler of the threaded runtime, linked against the runtime as configured
+# (except for federated builds, which need code generated for the federate).
+# The scheduler_benchmarks target builds it for each scheduler in a separate build directory and runs it
+# on each shape of reaction graph with one worker per core, writing <scheduler>_<shape>.json files to scheduler_benchmarks/.
+if(NOT DEFINED LF_SINGLE_THREADED AND NOT DEFINED FEDERATED)
+    add_executable(scheduler_benchmark ${TEST_DIR}/benchmark/scheduler_benchmark.c)
+    target_link_libraries(scheduler_benchmark PRIVATE lf::low-level-platform-impl)
+    target_link_libraries(scheduler_benchmark PRIVATE ${CoreLib} ${Lib})
+    lf_enable_compiler_warnings(scheduler_benchmark)
+
+    set(SCHEDULER_BENCHMARK_DIR ${CMAKE_BINARY_DIR}/scheduler_benchmarks)
+    cmake_host_system_information(RESULT SCHEDULER_BENCHMARK_WORKERS QUERY NUMBER_OF_LOGICAL_CORES)
+    set(SCHEDULER_BENCHMARK_COMMANDS)
+    foreach(SCHED NP GEDF_NP ADAPTIVE WORK_STEALING GEDF_SHARDED DATAFLOW LLF)
+        set(BUILD_DIR ${SCHEDULER_BENCHMARK_DIR}/${SCHED})
+        list(APPEND SCHEDULER_BENCHMARK_COMMANDS
+            COMMAND ${CMAKE_COMMAND} -S ${LF_ROOT} -B ${BUILD_DIR} -DCMAKE_BUILD_TYPE=Release -DSCHEDULER=SCHED_${SCHED}
+            COMMAND ${CMAKE_COMMAND} --build ${BUILD_DIR} --target scheduler_benchmark
+        )
+        foreach(SHAPE chain fanout wide deadline sparse timers)
+            list(APPEND SCHEDULER_BENCHMARK_COMMANDS
+                COMMAND ${BUILD_DIR}/scheduler_benchmark -s ${SHAPE} -w ${SCHEDULER_BENCHMARK_WORKERS} -j ${SCHEDULER_BENCHMARK_DIR}/${SCHED}_${SHAPE}.json
+            )
+        endforeach(SHAPE)
+    endforeach(SCHED)
+    add_custom_target(
+        scheduler_benchmarks
+        ${SCHEDULER_BENCHMARK_COMMANDS}
+        COMMENT "Running the scheduler benchmarks"
+    )
+endif()
+
+# Synthetic workload for the event loop of the single-threaded runtime, linked against the runtime as configured.
+# The event_loop_benchmarks target builds it with neither, with LF_STATIC_MEMORY and with both LF_STATIC_MEMORY and
+# LF_STATIC_TOPOLOGY (the topology variant) in separate build directories,
+# prints the sizes of the sections of the executables and runs them, writing <variant>.json files to
+# event_loop_benchmarks/.
+if(DEFINED LF_SINGLE_THREADED AND NOT DEFINED FEDERATED)
+    add_executable(event_loop_benchmark ${TEST_DIR}/benchmark/event_loop_benchmark.c)
+    target_link_libraries(event_loop_benchmark PRIVATE lf::low-level-platform-impl)
+    target_link_libraries(event_loop_benchmark PRIVATE ${CoreLib} ${Lib})
+    lf_enable_compiler_warnings(event_loop_benchmark)
+endif()
+if(NOT DEFINED FEDERATED)
+    set(EVENT_LOOP_BENCHMARK_DIR ${CMAKE_BINARY_DIR}/event_loop_benchmarks)
+    set(EVENT_LOOP_BENCHMARK_COMMANDS)
+    foreach(VARIANT dynamic static topology)
+        set(BUILD_DIR ${EVENT_LOOP_BENCHMARK_DIR}/${VARIANT})
+        set(VARIANT_OPTIONS -DLF_SINGLE_THREADED=1)
+        if(${VARIANT} STREQUAL "static")
+            list(APPEND VARIANT_OPTIONS -DLF_STATIC_MEMORY=1)
+        elseif(${VARIANT} STREQUAL "topology")
+            list(APPEND VARIANT_OPTIONS -DLF_STATIC_MEMORY=1 -DLF_STATIC_TOPOLOGY=1)
+        endif()
+        list(APPEND EVENT_LOOP_BENCHMARK_COMMANDS
+            COMMAND ${CMAKE_COMMAND} -S ${LF_ROOT} -B ${BUILD_DIR} -DCMAKE_BUILD_TYPE=MinSizeRel ${VARIANT_OPTIONS}
+            COMMAND ${CMAKE_COMMAND} --build ${BUILD_DIR} --target event_loop_benchmark
+            COMMAND size ${BUILD_DIR}/event_loop_benchmark
+            COMMAND ${BUILD_DIR}/event_loop_benchmark -j ${EVENT_LOOP_BENCHMARK_DIR}/${VARIANT}.json
+        )
+    endforeach(VARIANT)
+    add_custom_target(
+        event_loop_benchmarks
+        ${EVENT_LOOP_BENCHMARK_COMMANDS}
+        COMMENT "Running the event loop benchmarks"
+    )
+endif()
+
+# Savina-style workloads, linked against the runtime as configured (except for federated builds).
+# The workload_benchmarks target builds it for each scheduler and for the single-threaded runtime in separate build
+# directories and runs each workload there with one worker per core, writing <runtime>_<workload>.json files to
+# workload_benchmarks/. The options in WORKLOAD_BENCHMARK_OPTIONS, such as -DLF_PARALLEL_POP=1, are given to every
+# build, so that a feature is measured against a baseline by running the target in two build directories. They apply to
+# the whole runtime, including lib, and the target fails if a workload does not execute the reactions that it should.
+if(NOT DEFINED FEDERATED)
+    add_executable(workload_benchmark ${TEST_DIR}/benchmark/workload_benchmark.c)
+    target_link_libraries(workload_benchmark PRIVATE lf::low-level-platform-impl)
+    target_link_libraries(workload_benchmark PRIVATE ${CoreLib} ${Lib})
+    lf_enable_compiler_warnings(workload_benchmark)
+
+    set(WORKLOAD_BENCHMARK_OPTIONS "" CACHE STRING "Options of the builds of the workload benchmarks")
+    set(WORKLOAD_BENCHMARK_DIR ${CMAKE_BINARY_DIR}/workload_benchmarks)
+    cmake_host_system_information(RESULT WORKLOAD_BENCHMARK_WORKERS QUERY NUMBER_OF_LOGICAL_CORES)
+    set(WORKLOAD_BENCHMARK_COMMANDS)
+    foreach(RUNTIME NP GEDF_NP ADAPTIVE WORK_STEALING GEDF_SHARDED DATAFLOW LLF single_threaded)
+        set(BUILD_DIR ${WORKLOAD_BENCHMARK_DIR}/${RUNTIME})
+        if(${RUNTIME} STREQUAL "single_threaded")
+            set(RUNTIME_OPTIONS -DLF_SINGLE_THREADED=1)
+            set(WORKERS_OPTION)
+        else()
+            set(RUNTIME_OPTIONS -DSCHEDULER=SCHED_${RUNTIME})
+            set(WORKERS_OPTION -w ${WORKLOAD_BENCHMARK_WORKERS})
+        endif()
+        list(APPEND WORKLOAD_BENCHMARK_COMMANDS
+            COMMAND ${CMAKE_COMMAND} -S ${LF_ROOT} -B ${BUILD_DIR} -DCMAKE_BUILD_TYPE=Release ${RUNTIME_OPTIONS}
+                ${WORKLOAD_BENCHMARK_OPTIONS}
+            COMMAND ${CMAKE_COMMAND} --build ${BUILD_DIR} --target workload_benchmark
+        )
+        foreach(WORKLOAD pingpong ring pipeline forkjoin bank timers chains)
+            list(APPEND WORKLOAD_BENCHMARK_COMMANDS
+                COMMAND ${BUILD_DIR}/workload_benchmark -s ${WORKLOAD} ${WORKERS_OPTION}
+                    -j ${WORKLOAD_BENCHMARK_DIR}/${RUNTIME}_${WORKLOAD}.json
+            )
+        endforeach(WORKLOAD)
+    endforeach(RUNTIME)
+    add_custom_target(
+        workload_benchmarks
+        ${WORKLOAD_BENCHMARK_COMMANDS}
+        COMMENT "Running the workload benchmarks"
+    )
+endif()
+
+# Benchmark of the cost of a tracepoint, linked against the runtime as configured.
+# The tracing_benchmarks target builds it without tracing and with each trace plugin in a separate build directory
+# and runs it there, writing <variant>.json files to tracing_benchmarks/.
+if(NOT DEFINED LF_SINGLE_THREADED AND NOT DEFINED FEDERATED)
+    add_executable(tracing_benchmark ${TEST_DIR}/benchmark/tracing_benchmark.c ${TEST_MOCK_SRCS})
+    target_link_libraries(tracing_benchmark PRIVATE lf::low-level-platform-impl)
+    target_link_libraries(tracing_benchmark PRIVATE ${CoreLib} ${Lib})
+    target_include_directories(tracing_benchmark PRIVATE ${TEST_DIR})
+    lf_enable_compiler_warnings(tracing_benchmark)
+
+    set(TRACING_BENCHMARK_DIR ${CMAKE_BINARY_DIR}/tracing_benchmarks)
+    file(MAKE_DIRECTORY ${TRACING_BENCHMARK_DIR})
+    set(TRACING_BENCHMARK_COMMANDS)
+    foreach(VARIANT off default flight_recorder perfetto)
+        set(BUILD_DIR ${TRACING_BENCHMARK_DIR}/${VARIANT})
+        set(VARIANT_OPTIONS)
+        if(${VARIANT} STREQUAL "default")
+            set(VARIANT_OPTIONS -DLF_TRACE=1 -DLOG_LEVEL=2)
+        elseif(${VARIANT} STREQUAL "flight_recorder")
+            set(VARIANT_OPTIONS -DLF_TRACE=1 -DLOG_LEVEL=2 -DLF_TRACE_FLIGHT_RECORDER=1000000000)
+        elseif(${VARIANT} STREQUAL "perfetto")
+            set(VARIANT_OPTIONS -DLF_TRACE=1 -DLOG_LEVEL=2 -DLF_TRACE_PLUGIN=perfetto)
+        endif()
+        list(APPEND TRACING_BENCHMARK_COMMANDS
+            COMMAND ${CMAKE_COMMAND} -S ${LF_ROOT} -B ${BUILD_DIR} -DCMAKE_BUILD_TYPE=Release ${VARIANT_OPTIONS}
+            COMMAND ${CMAKE_COMMAND} --build ${BUILD_DIR} --target tracing_benchmark
+            COMMAND ${BUILD_DIR}/tracing_benchmark -v ${VARIANT} -j ${TRACING_BENCHMARK_DIR}/${VARIANT}.json
+        )
+    endforeach(VARIANT)
+    add_custom_target(
+        tracing_benchmarks
+        ${TRACING_BENCHMARK_COMMANDS}
+        WORKING_DIRECTORY ${TRACING_BENCHMARK_DIR}
+        COMMENT "Running the tracing benchmarks"
+    )
+endif()
+
+# Without LF_TRACE, tracepoints must compile to nothing. The tracepoints_disabled test compiles functions that
+# differ only by tracepoints with optimization and checks that they have the same size.
+if(NOT DEFINED LF_TRACE AND CMAKE_NM AND CMAKE_C_COMPILER_ID MATCHES "GNU|Clang")
+    add_library(tracepoints_disabled OBJECT ${TEST_DIR}/check/tracepoints_disabled.c)
+    target_link_libraries(tracepoints_disabled PRIVATE ${CoreLib})
+    target_compile_options(tracepoints_disabled PRIVATE -O2)
+    lf_enable_compiler_warnings(tracepoints_disabled)
+    add_test(
+        NAME tracepoints_disabled
+        COMMAND ${CMAKE_COMMAND} -DNM=${CMAKE_NM} -DOBJECT=$<TARGET_OBJECTS:tracepoints_disabled>
+            -P ${TEST_DIR}/check/symbol_sizes.cmake
+    )
+endif()
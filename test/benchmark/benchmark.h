@@ -0,0 +1,99 @@
+/**
+ * @file benchmark.h
+ * @brief Functions shared by the benchmark programs.
+ *
+ * A benchmark takes its options from the command line with benchmark_option_value() and writes
+ * its results as JSON to the file that benchmark_open_output() opens.
+ *
+ * Some benchmarks play the role of the code generated for a Lingua Franca program, like
+ * test/src_gen_stub.c, with a reaction graph that they build by hand in a single environment.
+ * Such a benchmark defines BENCHMARK_GENERATED_CODE before it includes this header, which then
+ * defines that environment, `env`, and the functions of the generated code other than
+ * lf_create_environments and _lf_initialize_trigger_objects, which the benchmark defines to build
+ * its reaction graph. It runs the program by passing the arguments that benchmark_runtime_argv()
+ * collects to lf_reactor_c_main(). The end-to-end tests in test/runtime use it in the same way.
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tag.h"
+#include "util.h"
+
+/** Return the value of the option at `argv[i]`, or exit if it is missing. */
+static inline const char* benchmark_option_value(int argc, const char* argv[], int i) {
+  if (i + 1 >= argc) {
+    lf_print_error_and_exit("Option %s needs a value.", argv[i]);
+  }
+  return argv[i + 1];
+}
+
+/** Compare two intervals for qsort(). */
+static inline int benchmark_compare_intervals(const void* a, const void* b) {
+  interval_t x = *(const interval_t*)a;
+  interval_t y = *(const interval_t*)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Open the file to which the results are written, or exit if it cannot be opened.
+ * @param json_file The name of the file, or NULL for the standard output.
+ */
+static inline FILE* benchmark_open_output(const char* json_file) {
+  FILE* output = (json_file == NULL) ? stdout : fopen(json_file, "w");
+  if (output == NULL) {
+    lf_print_error_and_exit("Could not open %s.", json_file);
+  }
+  return output;
+}
+
+/** Close the file that benchmark_open_output() returned. */
+static inline void benchmark_close_output(FILE* output) {
+  if (output != stdout) {
+    fclose(output);
+  }
+}
+
+#ifdef BENCHMARK_GENERATED_CODE
+
+#include "environment.h"
+
+// Defined by the runtime, and normally called by the generated main function.
+int lf_reactor_c_main(int argc, const char* argv[]);
+
+/** The environment in which the benchmark builds its reaction graph. */
+static environment_t env;
+
+int _lf_get_environments(environment_t** envs) {
+  *envs = &env;
+  return 1;
+}
+
+void lf_terminate_execution(environment_t* e) { (void)e; }
+void lf_set_default_command_line_options(void) {}
+void logical_tag_complete(tag_t tag_to_send) { (void)tag_to_send; }
+
+/**
+ * Return the arguments for the runtime, which run the program in fast mode, with room for
+ * `argc` - 1 more, which the benchmark appends for the options that it does not take itself.
+ * @param argc The number of arguments of the benchmark.
+ * @param argv The arguments of the benchmark, of which the first is the name of the program.
+ * @param runtime_argc Where to put the number of arguments returned.
+ * @return The arguments, which the caller frees.
+ */
+static inline const char** benchmark_runtime_argv(int argc, const char* argv[], int* runtime_argc) {
+  const char** runtime_argv = (const char**)calloc(argc + 2, sizeof(char*));
+  LF_ASSERT_NON_NULL(runtime_argv);
+  runtime_argv[0] = argv[0];
+  runtime_argv[1] = "--fast";
+  runtime_argv[2] = "true";
+  *runtime_argc = 3;
+  return runtime_argv;
+}
+
+#endif // BENCHMARK_GENERATED_CODE
+
+#endif // BENCHMARK_H
@@ -0,0 +1,278 @@
+/**
+ * @file event_loop_benchmark.c
+ * @brief Synthetic workload for measuring the event loop of the single-threaded runtime.
+ *
+ * The program builds its reaction graph as the generated code would (see benchmark.h), like
+ * scheduler_benchmark.c, but for the single-threaded runtime. A timer triggers a source
+ * reaction, which triggers a chain of `depth` reactions through ports and schedules
+ * `events` logical actions at different times within the period of the timer. Each action
+ * triggers a reaction of its own. The reactions do nothing else, so the time per tag is
+ * the overhead of the event loop.
+ *
+ * The program runs `tags` periods of the timer in fast mode and writes JSON with the
+ * nanoseconds per tag and, with the GNU C library, the number of bytes that the heap grew
+ * by between the first and the last tag, which is zero if the event loop allocates no memory
+ * after the first tag, as with LF_STATIC_MEMORY.
+ *
+ * With LF_STATIC_TOPOLOGY, the program gives the fanout of each reaction and the tables of the
+ * environment as the generated code would, instead of the triggers of the reactions.
+ *
+ * The `event_loop_benchmarks` target builds this program with neither, with LF_STATIC_MEMORY
+ * and with both LF_STATIC_MEMORY and LF_STATIC_TOPOLOGY in separate build directories, prints
+ * the sizes of their sections and runs them.
+ *
+ * Usage: event_loop_benchmark [-d depth] [-e events] [-t tags] [-j json_file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#define BENCHMARK_GENERATED_CODE
+#include "benchmark.h"
+#include "reactor.h"
+#include "reactor_common.h"
+#include "util.h"
+
+#ifdef LF_STATIC_MEMORY
+#define STATIC_MEMORY "true"
+#else
+#define STATIC_MEMORY "false"
+#endif
+
+#ifdef LF_STATIC_TOPOLOGY
+#define STATIC_TOPOLOGY "true"
+#else
+#define STATIC_TOPOLOGY "false"
+#endif
+
+/** Logical period of the timer. */
+#define PERIOD MSEC(1)
+
+/** Upper bits of the index of reactions without a deadline. */
+#define NO_DEADLINE_INDEX 0xFFFFFFFFFFFFULL
+
+/** The maximum number of actions scheduled at each period. */
+#define MAX_EVENTS 64
+
+/** The maximum depth of the chain with LF_STATIC_TOPOLOGY, where its nodes are not allocated. */
+#define MAX_DEPTH 256
+
+/** A reactor with one reaction and at most one output, which triggers the next reaction of the chain. */
+typedef struct {
+  self_base_t base;
+  reaction_t reaction;
+  reaction_t* reaction_pointer;
+  lf_port_base_t output;
+  trigger_t output_trigger;
+  bool* output_produced[1];
+  int triggered_sizes[1];
+  trigger_t* triggered[1];
+  trigger_t** triggers[1];
+#ifdef LF_STATIC_TOPOLOGY
+  lf_fanout_t fanout;
+#endif
+} node_t;
+
+static int depth = 4;
+static int events = 4;
+static int tags = 100000;
+static const char* json_file = NULL;
+
+static trigger_t timer;
+static trigger_t actions[MAX_EVENTS];
+static node_t source;
+static node_t* chain; // `depth` nodes.
+static node_t ticks[MAX_EVENTS];
+
+#ifdef LF_STATIC_TOPOLOGY
+static node_t chain_nodes[MAX_DEPTH];
+static const int output_offsets[] = {0, 1}; // The one output of a node triggers one reaction.
+static trigger_t* const timer_triggers[] = {&timer};
+static bool* is_present_fields[1 + MAX_DEPTH]; // Only the fields of the first `depth` nodes are used.
+#endif
+
+static int periods_completed;
+static size_t tags_completed;
+static instant_t first_tag_start;
+static instant_t last_tag_end;
+static long heap_at_first_tag;
+static long heap_at_last_tag;
+
+/** Return the number of bytes allocated on the heap, or 0 if it is not known. */
+static long heap_in_use(void) {
+#ifdef __GLIBC__
+  return (long)mallinfo2().uordblks;
+#else
+  return 0;
+#endif
+}
+
+////////////////// Reactions
+
+static void source_reaction(void* self) {
+  if (periods_completed == 0) {
+    heap_at_first_tag = heap_in_use();
+    first_tag_start = lf_time_physical();
+  }
+  tag_t now = env.current_tag;
+  for (int i = 0; i < events; i++) {
+    tag_t tag = {.time = now.time + (PERIOD * (i + 1)) / (events + 1), .microstep = 0};
+    _lf_schedule_at_tag(&env, &actions[i], tag, NULL);
+  }
+  lf_set_present(&((node_t*)self)->output);
+  tags_completed++;
+}
+
+static void chain_reaction(void* self) {
+  node_t* node = (node_t*)self;
+  if (node->output_trigger.number_of_reactions > 0) {
+    lf_set_present(&node->output);
+    return;
+  }
+  // The last reaction of the chain.
+  if (++periods_completed == tags) {
+    heap_at_last_tag = heap_in_use();
+    last_tag_end = lf_time_physical();
+    lf_request_stop();
+  }
+}
+
+static void tick_reaction(void* self) {
+  (void)self;
+  tags_completed++;
+}
+
+////////////////// Reaction graph
+
+/** Initialize the node of a reaction at `level` whose output triggers `downstream`, if it is not NULL. */
+static void init_node(node_t* node, reaction_function_t function, const char* name, int level,
+                      reaction_t** downstream) {
+  node->base.environment = &env;
+  node->reaction_pointer = &node->reaction;
+  node->reaction.function = function;
+  node->reaction.self = node;
+  node->reaction.name = name;
+  node->reaction.deadline = NEVER;
+  node->reaction.index = (NO_DEADLINE_INDEX << 16) | (index_t)level;
+  node->output.source_reactor = &node->base;
+  node->output.destination_channel = -1;
+  node->output_trigger.last_tag = NEVER_TAG;
+  if (downstream != NULL) {
+    node->output_trigger.reactions = downstream;
+    node->output_trigger.number_of_reactions = 1;
+    node->output_produced[0] = &node->output.is_present;
+    node->reaction.num_outputs = 1;
+    node->reaction.output_produced = node->output_produced;
+#ifdef LF_STATIC_TOPOLOGY
+    node->fanout = (lf_fanout_t){.offsets = output_offsets, .reactions = downstream};
+    node->reaction.fanout = &node->fanout;
+#else
+    node->triggered_sizes[0] = 1;
+    node->triggered[0] = &node->output_trigger;
+    node->triggers[0] = node->triggered;
+    node->reaction.triggered_sizes = node->triggered_sizes;
+    node->reaction.triggers = node->triggers;
+#endif
+  }
+}
+
+void lf_create_environments(void) { environment_init(&env, "main", 0, 1, 1, 0, 0, 0, 1 + depth, 0, 0, 0, NULL); }
+
+void _lf_initialize_trigger_objects(void) {
+#ifdef LF_STATIC_TOPOLOGY
+  chain = chain_nodes;
+#else
+  chain = (node_t*)calloc(depth, sizeof(node_t));
+  LF_ASSERT_NON_NULL(chain);
+#endif
+  init_node(&source, source_reaction, "source", 0, &chain[0].reaction_pointer);
+  for (int i = 0; i < depth; i++) {
+    init_node(&chain[i], chain_reaction, "chain", i + 1, (i + 1 < depth) ? &chain[i + 1].reaction_pointer : NULL);
+  }
+  for (int i = 0; i < events; i++) {
+    init_node(&ticks[i], tick_reaction, "tick", 0, NULL);
+    actions[i].reactions = &ticks[i].reaction_pointer;
+    actions[i].number_of_reactions = 1;
+    actions[i].last_tag = NEVER_TAG;
+  }
+
+  timer.is_timer = true;
+  timer.offset = 0;
+  timer.period = PERIOD;
+  timer.last_tag = NEVER_TAG;
+  timer.reactions = &source.reaction_pointer;
+  timer.number_of_reactions = 1;
+
+#ifdef LF_STATIC_TOPOLOGY
+  // The depth is only known at runtime, so the fields are filled in here rather than by an initializer.
+  is_present_fields[0] = &source.output.is_present;
+  for (int i = 0; i < depth; i++) {
+    is_present_fields[1 + i] = &chain[i].output.is_present;
+  }
+  lf_static_topology_t topology = {.timer_triggers = timer_triggers,
+                                   .timer_triggers_size = 1,
+                                   .is_present_fields = is_present_fields,
+                                   .is_present_fields_size = 1 + depth};
+  lf_environment_set_topology(&env, &topology);
+#else
+  env.timer_triggers[0] = &timer;
+
+  env.is_present_fields[0] = &source.output.is_present;
+  for (int i = 0; i < depth; i++) {
+    env.is_present_fields[1 + i] = &chain[i].output.is_present;
+  }
+#endif
+}
+
+////////////////// Main
+
+#ifndef LF_STATIC_TOPOLOGY
+/** Free the nodes of the chain. */
+static void free_chain(void) { free(chain); }
+#endif
+
+int main(int argc, const char* argv[]) {
+  int runtime_argc;
+  const char** runtime_argv = benchmark_runtime_argv(argc, argv, &runtime_argc);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-d") == 0) {
+      depth = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-e") == 0) {
+      events = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-t") == 0) {
+      tags = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-j") == 0) {
+      json_file = benchmark_option_value(argc, argv, i++);
+    } else {
+      lf_print_error_and_exit("Usage: event_loop_benchmark [-d depth] [-e events] [-t tags] [-j json_file]");
+    }
+  }
+  if (depth < 1 || events < 0 || events > MAX_EVENTS || tags < 2) {
+    lf_print_error_and_exit("The depth must be positive, the events at most %d and the tags at least 2.", MAX_EVENTS);
+  }
+#ifdef LF_STATIC_TOPOLOGY
+  if (depth > MAX_DEPTH) {
+    lf_print_error_and_exit("The depth must be at most %d.", MAX_DEPTH);
+  }
+#endif
+
+#ifndef LF_STATIC_TOPOLOGY
+  // The runtime terminates after main returns, so the chain is freed after that.
+  atexit(free_chain);
+#endif
+  int result = lf_reactor_c_main(runtime_argc, runtime_argv);
+  if (result == 0 && periods_completed == tags) {
+    FILE* output = benchmark_open_output(json_file);
+    fprintf(output, "{\"static_memory\": %s, \"static_topology\": %s, \"depth\": %d, \"events\": %d, \"tags\": %zu, ",
+            STATIC_MEMORY, STATIC_TOPOLOGY, depth, events, tags_completed);
+    fprintf(output, "\"ns_per_tag\": %.1f, \"heap_growth_bytes\": %ld}\n",
+            (double)(last_tag_end - first_tag_start) / (double)tags_completed, heap_at_last_tag - heap_at_first_tag);
+    benchmark_close_output(output);
+  }
+  free(runtime_argv);
+  return result;
+}
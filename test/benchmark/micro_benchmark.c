@@ -0,0 +1,336 @@
+/**
+ * @file micro_benchmark.c
+ * @brief Micro-benchmarks of the data structures on the hot paths of the runtime.
+ *
+ * Each benchmark performs a fixed sequence of operations, generated from a fixed seed,
+ * and is repeated a number of times. The minimum and the median time per operation
+ * over the repetitions are written as JSON, so that results can be tracked over time:
+ *
+ *   {"pqueue_tag": "heap", "pqueue_arity": 2, "repetitions": 11, "benchmarks": [
+ *     {"name": "pqueue_tag_insert_pop", "operations": 1048576, "min_ns_per_op": 41.2, "median_ns_per_op": 42.0},
+ *     ...
+ *   ]}
+ *
+ * The `benchmarks` target runs this program and writes micro_benchmark.json in the build directory.
+ *
+ * Usage: micro_benchmark [repetitions [output_file]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "environment.h"
+#include "hashset/hashset.h"
+#include "hashset/hashset_concurrent.h"
+#include "lf_token.h"
+#include "port.h"
+#include "pqueue_base.h"
+#include "pqueue_tag.h"
+#include "tag.h"
+#include "vector.h"
+
+#ifdef LF_CALENDAR_QUEUE
+#define PQUEUE_TAG_VARIANT "calendar"
+#else
+#define PQUEUE_TAG_VARIANT "heap"
+#endif
+
+#ifdef LF_PQUEUE_ARITY
+#define PQUEUE_ARITY LF_PQUEUE_ARITY
+#else
+#define PQUEUE_ARITY 2
+#endif
+
+#define RANDOM_SEED 1614
+
+/** Number of elements in the queue and the set. */
+#define QUEUE_SIZE 4096
+/** Number of operations of each repetition of most benchmarks. */
+#define OPERATIONS (1 << 20)
+/** Width of the multiports and number of present channels of the sparse one. */
+#define MULTIPORT_WIDTH 256
+#define MULTIPORT_PRESENT 16
+
+/** Sink for results, so that the compiler does not optimize the operations away. */
+static volatile size_t sink;
+
+/**
+ * The benchmarks run on a single thread, so the critical sections of the token
+ * functions need no lock. Defining them here keeps the scheduler out of the link.
+ */
+int lf_critical_section_enter(environment_t* env) {
+  (void)env;
+  return 0;
+}
+int lf_critical_section_exit(environment_t* env) {
+  (void)env;
+  return 0;
+}
+
+/** Function that performs the operations of one repetition of a benchmark and returns their number. */
+typedef size_t (*benchmark_t)(void);
+
+////////////////// pqueue_tag
+
+static pqueue_tag_element_t queue_elements[QUEUE_SIZE];
+static interval_t queue_increments[QUEUE_SIZE];
+
+/** Pop the element with the least tag and reinsert it later, as the event queue does with timers. */
+static size_t pqueue_tag_insert_pop(void) {
+  pqueue_tag_t* q = pqueue_tag_init(QUEUE_SIZE);
+  srand(RANDOM_SEED);
+  for (size_t i = 0; i < QUEUE_SIZE; i++) {
+    queue_elements[i].tag = (tag_t){.time = rand() % MSEC(1), .microstep = 0};
+    queue_increments[i] = USEC(1 + rand() % 1000);
+    pqueue_tag_insert(q, &queue_elements[i]);
+  }
+  for (size_t i = 0; i < OPERATIONS; i++) {
+    pqueue_tag_element_t* e = pqueue_tag_pop(q);
+    e->tag.time += queue_increments[e - queue_elements];
+    pqueue_tag_insert(q, e);
+  }
+  sink += pqueue_tag_size(q);
+  pqueue_tag_free(q);
+  return OPERATIONS;
+}
+
+////////////////// pqueue
+
+/** Entry of a queue with integer priorities, as the reaction queues have. */
+typedef struct {
+  pqueue_pri_t priority;
+  size_t pos;
+} queue_entry_t;
+
+static queue_entry_t queue_entries[QUEUE_SIZE];
+
+static pqueue_pri_t get_entry_priority(void* entry) { return ((queue_entry_t*)entry)->priority; }
+static size_t get_entry_pos(void* entry) { return ((queue_entry_t*)entry)->pos; }
+static void set_entry_pos(void* entry, size_t pos) { ((queue_entry_t*)entry)->pos = pos; }
+static int entries_equal(void* a, void* b) { return a == b; }
+
+/** Pop the entry with the least priority and reinsert it with a greater one. */
+static size_t pqueue_insert_pop(void) {
+  pqueue_t* q = pqueue_init(QUEUE_SIZE, in_reverse_order, get_entry_priority, get_entry_pos, set_entry_pos,
+                            entries_equal, NULL);
+  srand(RANDOM_SEED);
+  for (size_t i = 0; i < QUEUE_SIZE; i++) {
+    queue_entries[i].priority = (pqueue_pri_t)(rand() % 1000);
+    pqueue_insert(q, &queue_entries[i]);
+  }
+  for (size_t i = 0; i < OPERATIONS; i++) {
+    queue_entry_t* e = (queue_entry_t*)pqueue_pop(q);
+    e->priority += (pqueue_pri_t)(1 + (e - queue_entries) % 1000);
+    pqueue_insert(q, e);
+  }
+  sink += pqueue_size(q);
+  pqueue_free(q);
+  return OPERATIONS;
+}
+
+////////////////// hashset
+
+static size_t set_items[QUEUE_SIZE];
+
+/** Add and remove items, keeping the set at half of QUEUE_SIZE items. */
+static size_t hashset_add_remove(void) {
+  hashset_t set = hashset_create(8);
+  for (size_t i = 0; i < QUEUE_SIZE / 2; i++) {
+    hashset_add(set, &set_items[i]);
+  }
+  size_t count = 0;
+  for (size_t i = 0; i < OPERATIONS / 2; i++) {
+    count += hashset_add(set, &set_items[(i + QUEUE_SIZE / 2) % QUEUE_SIZE]);
+    count += hashset_remove(set, &set_items[i % QUEUE_SIZE]);
+  }
+  sink += count;
+  hashset_destroy(set);
+  return OPERATIONS;
+}
+
+/** Same as hashset_add_remove, compacting the set when a quarter of its slots are tombstones. */
+static size_t hashset_concurrent_add_remove(void) {
+  hashset_concurrent_t set = hashset_concurrent_create(13);
+  for (size_t i = 0; i < QUEUE_SIZE / 2; i++) {
+    hashset_concurrent_add(set, &set_items[i]);
+  }
+  size_t count = 0;
+  for (size_t i = 0; i < OPERATIONS / 2; i++) {
+    count += hashset_concurrent_add(set, &set_items[(i + QUEUE_SIZE / 2) % QUEUE_SIZE]);
+    count += hashset_concurrent_remove(set, &set_items[i % QUEUE_SIZE]);
+    if ((size_t)(set->nused - set->nitems) > set->capacity / 4) {
+      hashset_concurrent_compact(set);
+    }
+  }
+  sink += count;
+  hashset_concurrent_destroy(set);
+  return OPERATIONS;
+}
+
+////////////////// vector
+
+/** Push elements onto a vector that starts small, and empty it every QUEUE_SIZE elements. */
+static size_t vector_push_pop(void) {
+  vector_t v = vector_new(2);
+  for (size_t i = 0; i < OPERATIONS; i++) {
+    vector_push(&v, &set_items[i % QUEUE_SIZE]);
+    if (vector_size(&v) == QUEUE_SIZE) {
+      while (vector_pop(&v) != NULL) {
+      }
+    }
+  }
+  sink += vector_size(&v);
+  vector_free(&v);
+  return OPERATIONS;
+}
+
+////////////////// tokens
+
+static token_template_t token_template = {.type = {.element_size = sizeof(int)}};
+static lf_token_t* live_tokens[16];
+
+/** Create and free tokens without payload, with a few tokens alive at a time. */
+static size_t token_new_free(void) {
+  for (size_t i = 0; i < OPERATIONS; i++) {
+    size_t slot = i % 16;
+    if (live_tokens[slot] != NULL) {
+      _lf_free_token(live_tokens[slot]);
+    }
+    live_tokens[slot] = lf_new_token(&token_template, NULL, 0);
+  }
+  for (size_t slot = 0; slot < 16; slot++) {
+    _lf_free_token(live_tokens[slot]);
+    live_tokens[slot] = NULL;
+  }
+  return OPERATIONS;
+}
+
+////////////////// multiports
+
+static lf_port_base_t ports[MULTIPORT_WIDTH];
+static lf_port_base_t* port_pointers[MULTIPORT_WIDTH];
+static lf_sparse_io_record_t* sparse_record;
+
+/** Iterate over the present channels of the multiport, returning the number of calls to lf_multiport_next. */
+static size_t iterate_multiport(size_t iterations) {
+  size_t calls = 0;
+  for (size_t i = 0; i < iterations; i++) {
+    lf_multiport_iterator_t iterator = _lf_multiport_iterator_impl(port_pointers, MULTIPORT_WIDTH);
+    int channel;
+    do {
+      channel = lf_multiport_next(&iterator);
+      calls++;
+    } while (channel >= 0);
+    sink += calls;
+  }
+  return calls;
+}
+
+/** Set MULTIPORT_PRESENT channels present and, if `sparse`, record them in a sparse record. */
+static void set_multiport(bool sparse) {
+  srand(RANDOM_SEED);
+  for (int i = 0; i < MULTIPORT_WIDTH; i++) {
+    ports[i] = (lf_port_base_t){.sparse_record = sparse ? sparse_record : NULL};
+    port_pointers[i] = &ports[i];
+  }
+  sparse_record->size = 0;
+  for (int i = 0; i < MULTIPORT_PRESENT; i++) {
+    int channel = rand() % MULTIPORT_WIDTH;
+    if (!ports[channel].is_present) {
+      ports[channel].is_present = true;
+      sparse_record->present_channels[sparse_record->size++] = channel;
+    }
+  }
+}
+
+static size_t multiport_next_sparse(void) {
+  set_multiport(true);
+  return iterate_multiport(OPERATIONS / (MULTIPORT_PRESENT + 1));
+}
+
+static size_t multiport_next_dense(void) {
+  set_multiport(false);
+  return iterate_multiport(OPERATIONS / (MULTIPORT_PRESENT + 1));
+}
+
+////////////////// tags
+
+/** Add tags with and without overflow to a running tag. */
+static size_t tag_add(void) {
+  tag_t sum = ZERO_TAG;
+  tag_t increments[4] = {
+      {.time = 0, .microstep = 1}, {.time = USEC(1), .microstep = 0}, {.time = 1, .microstep = 2}, FOREVER_TAG};
+  for (size_t i = 0; i < OPERATIONS; i++) {
+    sum = lf_tag_add(sum, increments[i % 3]);
+    sink += lf_tag_add(sum, increments[3]).microstep;
+  }
+  sink += sum.microstep;
+  return 2 * (size_t)OPERATIONS;
+}
+
+////////////////// Driver
+
+typedef struct {
+  const char* name;
+  benchmark_t run;
+} benchmark_entry_t;
+
+static const benchmark_entry_t benchmarks[] = {
+    {"pqueue_tag_insert_pop", pqueue_tag_insert_pop},
+    {"pqueue_insert_pop", pqueue_insert_pop},
+    {"hashset_add_remove", hashset_add_remove},
+    {"hashset_concurrent_add_remove", hashset_concurrent_add_remove},
+    {"vector_push", vector_push_pop},
+    {"token_new_free", token_new_free},
+    {"multiport_next_sparse", multiport_next_sparse},
+    {"multiport_next_dense", multiport_next_dense},
+    {"tag_add", tag_add},
+};
+
+static int compare_doubles(const void* a, const void* b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char* argv[]) {
+  int repetitions = (argc > 1) ? atoi(argv[1]) : 11;
+  FILE* output = (argc > 2) ? fopen(argv[2], "w") : stdout;
+  if (repetitions < 1 || output == NULL) {
+    fprintf(stderr, "Usage: micro_benchmark [repetitions [output_file]]\n");
+    return 1;
+  }
+  sparse_record = (lf_sparse_io_record_t*)calloc(1, sizeof(lf_sparse_io_record_t) + MULTIPORT_WIDTH * sizeof(size_t));
+  double* ns_per_op = (double*)malloc(repetitions * sizeof(double));
+  if (sparse_record == NULL || ns_per_op == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    return 1;
+  }
+  sparse_record->capacity = MULTIPORT_WIDTH;
+
+  size_t count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+  fprintf(output, "{\"pqueue_tag\": \"%s\", \"pqueue_arity\": %d, \"repetitions\": %d, \"benchmarks\": [\n",
+          PQUEUE_TAG_VARIANT, PQUEUE_ARITY, repetitions);
+  for (size_t b = 0; b < count; b++) {
+    size_t operations = 0;
+    // The first run warms up caches and allocators and is not measured.
+    benchmarks[b].run();
+    for (int r = 0; r < repetitions; r++) {
+      instant_t start = lf_time_physical();
+      operations = benchmarks[b].run();
+      ns_per_op[r] = (double)(lf_time_physical() - start) / (double)operations;
+    }
+    qsort(ns_per_op, repetitions, sizeof(double), compare_doubles);
+    fprintf(output,
+            "  {\"name\": \"%s\", \"operations\": %zu, \"min_ns_per_op\": %.2f, \"median_ns_per_op\": %.2f}%s\n",
+            benchmarks[b].name, operations, ns_per_op[0], ns_per_op[repetitions / 2], (b + 1 < count) ? "," : "");
+  }
+  fprintf(output, "]}\n");
+
+  if (output != stdout) {
+    fclose(output);
+  }
+  free(ns_per_op);
+  free(sparse_record);
+  return 0;
+}
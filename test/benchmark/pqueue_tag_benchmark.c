@@ -0,0 +1,85 @@
+/**
+ * @file pqueue_tag_benchmark.c
+ * @brief Benchmark of the tag-sorted priority queue under a timer-heavy load.
+ *
+ * This program simulates a set of periodic timers in the way the event queue sees them:
+ * all events at the least tag are popped together, and each is reinserted one period later.
+ * It is built once for the binary heap (pqueue_tag_benchmark_heap) and once for the
+ * calendar queue (pqueue_tag_benchmark_calendar, with LF_CALENDAR_QUEUE defined), and
+ * once for each heap with more children per node (pqueue_tag_benchmark_dary4 and
+ * pqueue_tag_benchmark_dary8, with LF_PQUEUE_ARITY defined), so that running them with
+ * the same arguments compares the implementations.
+ *
+ * Usage: pqueue_tag_benchmark_<variant> [number_of_timers [number_of_events]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pqueue_tag.h"
+#include "tag.h"
+#include "vector.h"
+
+#ifdef LF_CALENDAR_QUEUE
+#define VARIANT "calendar"
+#elif LF_PQUEUE_ARITY == 4
+#define VARIANT "dary4"
+#elif LF_PQUEUE_ARITY == 8
+#define VARIANT "dary8"
+#else
+#define VARIANT "heap"
+#endif
+
+/** Number of distinct timer periods. Periods are 1 ms to NUMBER_OF_PERIODS ms. */
+#define NUMBER_OF_PERIODS 10
+
+typedef struct {
+  pqueue_tag_element_t base;
+  interval_t period;
+} timer_event_t;
+
+int main(int argc, char* argv[]) {
+  size_t number_of_timers = (argc > 1) ? (size_t)atol(argv[1]) : 100000;
+  size_t number_of_events = (argc > 2) ? (size_t)atol(argv[2]) : 10000000;
+  if (number_of_timers == 0) {
+    fprintf(stderr, "At least one timer is needed.\n");
+    return 1;
+  }
+
+  timer_event_t* timers = (timer_event_t*)calloc(number_of_timers, sizeof(timer_event_t));
+  pqueue_tag_t* q = pqueue_tag_init(number_of_timers);
+  if (timers == NULL || q == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    return 1;
+  }
+  srand(0);
+  for (size_t i = 0; i < number_of_timers; i++) {
+    timers[i].period = MSEC(1 + rand() % NUMBER_OF_PERIODS);
+    // Timers with the same period and offset share tags, as timers in generated programs do.
+    timers[i].base.tag = (tag_t){.time = MSEC(rand() % NUMBER_OF_PERIODS), .microstep = 0};
+    pqueue_tag_insert(q, (pqueue_tag_element_t*)&timers[i]);
+  }
+
+  vector_t popped = vector_new(number_of_timers);
+  size_t events = 0;
+  size_t tags = 0;
+  instant_t start = lf_time_physical();
+  while (events < number_of_events) {
+    pqueue_tag_pop_all_with_tag(q, pqueue_tag_peek_tag(q), &popped);
+    tags++;
+    timer_event_t* timer;
+    while ((timer = (timer_event_t*)vector_pop(&popped)) != NULL) {
+      timer->base.tag.time += timer->period;
+      pqueue_tag_insert(q, (pqueue_tag_element_t*)timer);
+      events++;
+    }
+  }
+  interval_t elapsed = lf_time_physical() - start;
+
+  printf("%s: %zu timers, %zu tags, %zu events, %.1f ns per event.\n", VARIANT, number_of_timers, tags, events,
+         (double)elapsed / (double)events);
+  vector_free(&popped);
+  pqueue_tag_free(q);
+  free(timers);
+  return 0;
+}
@@ -0,0 +1,377 @@
+/**
+ * @file scheduler_benchmark.c
+ * @brief Synthetic workload for measuring the overhead of the scheduler of the threaded runtime.
+ *
+ * The program builds its reaction graph as the generated code would (see benchmark.h):
+ * a timer triggers a source reaction,
+ * the source fans out to a grid of `width` columns and `depth` levels of reactions,
+ * each reaction triggering the one in the next level of its column, and the last
+ * level triggers a sink reaction. The shapes are:
+ *
+ *   chain     A single column of `size` reactions (width 1, depth `size`).
+ *   fanout    A single level of `size` reactions (width `size`, depth 1).
+ *   wide      A grid of `size` columns and `levels` levels.
+ *   deadline  Like wide, but the reactions have deadlines that do not follow the columns.
+ *   sparse    Like wide, but the first level triggers the sink, so the other levels are empty at every tag.
+ *   timers    Like fanout, but each reaction is triggered by a timer of its own with the period of the
+ *             source, so that every tag starts with `size` + 1 events (see LF_PARALLEL_POP).
+ *
+ * With `-b`, the grid reactions have a batch function, so that the reactions of a level that
+ * are triggered together may be invoked with one call.
+ *
+ * Every reaction busy-waits for `work` nanoseconds of physical time. The program runs
+ * `tags` tags in fast mode and writes JSON with the reactions executed per second,
+ * percentiles of the tag-advance latency (the time from the end of the sink reaction
+ * at one tag to the start of the source reaction at the next tag), and the time the
+ * workers spent idle, that is, not executing reactions. It fails instead if the reactions of
+ * some tag were not all executed, which happens if the runtime is broken in the configuration
+ * measured.
+ *
+ * The scheduler is chosen when the runtime is compiled. The `scheduler_benchmarks`
+ * target builds this program for each scheduler and runs it on each shape.
+ *
+ * Usage: scheduler_benchmark [-s chain|fanout|wide|deadline|sparse|timers] [-n size] [-l levels] [-t tags]
+ *                            [-c work] [-b] [-j json_file] [runtime options such as -w workers]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCHMARK_GENERATED_CODE
+#include "benchmark.h"
+#include "reactor.h"
+#include "reactor_common.h"
+#include "scheduler.h"
+#include "util.h"
+
+#if SCHEDULER == SCHED_ADAPTIVE
+#define SCHEDULER_NAME "adaptive"
+#elif SCHEDULER == SCHED_GEDF_NP
+#define SCHEDULER_NAME "GEDF_NP"
+#elif SCHEDULER == SCHED_WORK_STEALING
+#define SCHEDULER_NAME "work_stealing"
+#elif SCHEDULER == SCHED_GEDF_SHARDED
+#define SCHEDULER_NAME "GEDF_sharded"
+#elif SCHEDULER == SCHED_DATAFLOW
+#define SCHEDULER_NAME "dataflow"
+#elif SCHEDULER == SCHED_LLF
+#define SCHEDULER_NAME "LLF"
+#else
+#define SCHEDULER_NAME "NP"
+#endif
+
+#define RANDOM_SEED 1614
+
+/** Logical period of the timer. The program runs in fast mode, so this affects only the deadlines. */
+#define PERIOD MSEC(1)
+
+/** Upper bits of the index of reactions without a deadline, which sort after all deadlines. */
+#define NO_DEADLINE_INDEX 0xFFFFFFFFFFFFULL
+
+/**
+ * A reactor with one reaction and at most one output, which triggers the reactions of the next level.
+ * A reaction never executes in parallel with itself, so the statistics need no synchronization.
+ */
+typedef struct {
+  self_base_t base;
+  reaction_t reaction;
+  reaction_t* reaction_pointer;
+  lf_port_base_t output;
+  trigger_t output_trigger;
+  bool* output_produced[1];
+  int triggered_sizes[1];
+  trigger_t* triggered[1];
+  trigger_t** triggers[1];
+  size_t executions;
+  interval_t busy;
+} node_t;
+
+static const char* shape = "wide";
+static int size = 8;
+static int levels = 4;
+static int tags = 10000;
+static interval_t work = 0;
+static const char* json_file = NULL;
+static bool batch = false;
+
+static int width;
+static int depth;
+static bool deadlines;
+static bool sparse;
+static bool timer_bank;
+
+static trigger_t timer;
+static trigger_t* bank; // With the timers shape, the timers of the first level.
+static node_t source;
+static node_t* grid; // depth levels of width nodes.
+static node_t sink;
+static reaction_t** sink_triggers_reactions;
+
+static instant_t* tag_starts;
+static instant_t* tag_ends;
+static int tags_completed;
+
+////////////////// Reactions
+
+/** Busy-wait for the work of one reaction and update the statistics of its node. */
+static void run_node(node_t* node) {
+  instant_t start = lf_time_physical();
+  instant_t end = start;
+  while (end - start < work) {
+    end = lf_time_physical();
+  }
+  if (node->output_trigger.number_of_reactions > 0) {
+    lf_set_present(&node->output);
+  }
+  node->executions++;
+  node->busy += lf_time_physical() - start;
+}
+
+static void source_reaction(void* self) {
+  tag_starts[tags_completed] = lf_time_physical();
+  run_node((node_t*)self);
+}
+
+static void grid_reaction(void* self) { run_node((node_t*)self); }
+
+static void grid_batch(void** selves, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    run_node((node_t*)selves[i]);
+  }
+}
+
+static void sink_reaction(void* self) {
+  run_node((node_t*)self);
+  tag_ends[tags_completed++] = lf_time_physical();
+  if (tags_completed == tags) {
+    lf_request_stop();
+  }
+}
+
+////////////////// Reaction graph
+
+/** Initialize the node of a reaction at `level` whose output triggers `count` reactions. */
+static void init_node(node_t* node, reaction_function_t function, const char* name, int level, interval_t deadline,
+                      reaction_t** downstream, int count) {
+  node->base.environment = &env;
+  node->reaction_pointer = &node->reaction;
+  node->reaction.function = function;
+  node->reaction.self = node;
+  node->reaction.name = name;
+  node->reaction.deadline = deadline;
+  index_t deadline_index = (deadline == NEVER) ? NO_DEADLINE_INDEX : (index_t)deadline;
+  node->reaction.index = (deadline_index << 16) | (index_t)level;
+  node->output.source_reactor = &node->base;
+  node->output.destination_channel = -1;
+  node->output_trigger.reactions = downstream;
+  node->output_trigger.number_of_reactions = count;
+  node->output_trigger.last_tag = NEVER_TAG;
+  if (count > 0) {
+    node->output_produced[0] = &node->output.is_present;
+    node->triggered_sizes[0] = 1;
+    node->triggered[0] = &node->output_trigger;
+    node->triggers[0] = node->triggered;
+    node->reaction.num_outputs = 1;
+    node->reaction.output_produced = node->output_produced;
+    node->reaction.triggered_sizes = node->triggered_sizes;
+    node->reaction.triggers = node->triggers;
+  }
+}
+
+/** Return the node at `level` (1 to depth) and `column` of the grid. */
+static node_t* grid_node(int level, int column) { return &grid[(level - 1) * width + column]; }
+
+void lf_create_environments(void) {
+  environment_init(&env, "main", 0, _lf_number_of_workers, 1 + (timer_bank ? width : 0), 0, 0, 0, 1 + width * depth, 0,
+                   0, 0, NULL);
+}
+
+void _lf_initialize_trigger_objects(void) {
+  grid = (node_t*)calloc(width * depth, sizeof(node_t));
+  reaction_t** first_level = (reaction_t**)calloc(width, sizeof(reaction_t*));
+  sink_triggers_reactions = (reaction_t**)calloc(width, sizeof(reaction_t*));
+  tag_starts = (instant_t*)calloc(tags, sizeof(instant_t));
+  tag_ends = (instant_t*)calloc(tags, sizeof(instant_t));
+  if (grid == NULL || first_level == NULL || sink_triggers_reactions == NULL || tag_starts == NULL ||
+      tag_ends == NULL) {
+    lf_print_error_and_exit("Out of memory.");
+  }
+
+  srand(RANDOM_SEED);
+  for (int column = 0; column < width; column++) {
+    first_level[column] = &grid_node(1, column)->reaction;
+    sink_triggers_reactions[column] = &sink.reaction;
+  }
+  init_node(&source, source_reaction, "source", 0, NEVER, first_level, timer_bank ? 0 : width);
+  for (int level = depth; level >= 1; level--) {
+    for (int column = 0; column < width; column++) {
+      node_t* node = grid_node(level, column);
+      interval_t deadline = deadlines ? (interval_t)(1 + rand() % 100) * PERIOD : NEVER;
+      if (level < depth && !sparse) {
+        node_t* next = grid_node(level + 1, column);
+        init_node(node, grid_reaction, "grid", level, deadline, &next->reaction_pointer, 1);
+        next->reaction.last_enabling_reaction = &node->reaction;
+      } else {
+        init_node(node, grid_reaction, "grid", level, deadline, &sink_triggers_reactions[column], 1);
+      }
+    }
+  }
+  init_node(&sink, sink_reaction, "sink", depth + 1, NEVER, NULL, 0);
+  if (batch) {
+    for (int i = 0; i < width * depth; i++) {
+      grid[i].reaction.batch_function = grid_batch;
+    }
+  }
+  // Reactions enabled by a single reaction may execute right after it on the same worker.
+  for (int column = 0; column < width && !timer_bank; column++) {
+    grid_node(1, column)->reaction.last_enabling_reaction = &source.reaction;
+  }
+  if (width == 1) {
+    sink.reaction.last_enabling_reaction = &grid_node(sparse ? 1 : depth, 0)->reaction;
+  }
+
+  timer.is_timer = true;
+  timer.offset = 0;
+  timer.period = PERIOD;
+  timer.last_tag = NEVER_TAG;
+  timer.reactions = &source.reaction_pointer;
+  timer.number_of_reactions = 1;
+  env.timer_triggers[0] = &timer;
+  if (timer_bank) {
+    bank = (trigger_t*)calloc(width, sizeof(trigger_t));
+    LF_ASSERT_NON_NULL(bank);
+    for (int column = 0; column < width; column++) {
+      bank[column] = timer;
+      bank[column].reactions = &grid_node(1, column)->reaction_pointer;
+      env.timer_triggers[1 + column] = &bank[column];
+    }
+  }
+
+  env.is_present_fields[0] = &source.output.is_present;
+  for (int i = 0; i < width * depth; i++) {
+    env.is_present_fields[1 + i] = &grid[i].output.is_present;
+  }
+
+  size_t* num_reactions_per_level = (size_t*)calloc(depth + 2, sizeof(size_t));
+  LF_ASSERT_NON_NULL(num_reactions_per_level);
+  num_reactions_per_level[0] = 1;
+  for (int level = 1; level <= depth; level++) {
+    num_reactions_per_level[level] = width;
+  }
+  num_reactions_per_level[depth + 1] = 1;
+  sched_params_t params = {.num_reactions_per_level = num_reactions_per_level,
+                           .num_reactions_per_level_size = depth + 2};
+  lf_sched_init(&env, env.num_workers, &params);
+}
+
+////////////////// Report
+
+/** Return the number of reactions executed. */
+static size_t executions(void) {
+  size_t count = source.executions + sink.executions;
+  for (int i = 0; i < width * depth; i++) {
+    count += grid[i].executions;
+  }
+  return count;
+}
+
+/** Return the number of reactions that the shape executes: at each tag, the source, the sink and the grid. */
+static size_t expected_executions(void) { return (size_t)tags * (2 + (size_t)width * (sparse ? 1 : depth)); }
+
+/** Write the results as JSON. */
+static void report(FILE* output) {
+  size_t executed = executions();
+  interval_t busy = source.busy + sink.busy;
+  size_t deadline_misses = 0;
+  for (int i = 0; i < width * depth; i++) {
+    busy += grid[i].busy;
+    deadline_misses += grid[i].reaction.deadline_misses;
+  }
+  interval_t elapsed = tag_ends[tags_completed - 1] - tag_starts[0];
+  interval_t capacity = elapsed * (interval_t)env.num_workers;
+
+  // Latency of the advances between the measured tags.
+  int advances = tags_completed - 1;
+  interval_t* latencies = (interval_t*)calloc(advances > 0 ? advances : 1, sizeof(interval_t));
+  LF_ASSERT_NON_NULL(latencies);
+  for (int i = 0; i < advances; i++) {
+    latencies[i] = tag_starts[i + 1] - tag_ends[i];
+  }
+  qsort(latencies, advances, sizeof(interval_t), benchmark_compare_intervals);
+#define PERCENTILE(p) (advances > 0 ? latencies[(int)((p) * (advances - 1))] : 0)
+
+  fprintf(output, "{\"scheduler\": \"%s\", \"shape\": \"%s\", \"batch\": %s, \"workers\": %d, ",
+          SCHEDULER_NAME, shape, batch ? "true" : "false", env.num_workers);
+  fprintf(output, "\"width\": %d, \"depth\": %d, ", width, depth);
+  fprintf(output, "\"work_ns\": " PRINTF_TIME ", \"tags\": %d, \"reactions\": %zu, \"elapsed_ns\": " PRINTF_TIME ",\n",
+          work, tags_completed, executed, elapsed);
+  fprintf(output, " \"reactions_per_second\": %.0f, \"deadline_misses\": %zu,\n",
+          elapsed > 0 ? (double)executed * BILLION / elapsed : 0.0, deadline_misses);
+  fprintf(output,
+          " \"tag_advance_latency_ns\": {\"p50\": " PRINTF_TIME ", \"p90\": " PRINTF_TIME ", \"p99\": " PRINTF_TIME
+          ", \"max\": " PRINTF_TIME "},\n",
+          PERCENTILE(0.5), PERCENTILE(0.9), PERCENTILE(0.99), PERCENTILE(1.0));
+  fprintf(output, " \"worker_idle_ns\": " PRINTF_TIME ", \"worker_idle_fraction\": %.4f}\n", capacity - busy,
+          capacity > 0 ? (double)(capacity - busy) / capacity : 0.0);
+#undef PERCENTILE
+  free(latencies);
+}
+
+////////////////// Main
+
+int main(int argc, const char* argv[]) {
+  // Options of the benchmark are removed, and the others are passed to the runtime.
+  int runtime_argc;
+  const char** runtime_argv = benchmark_runtime_argv(argc, argv, &runtime_argc);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0) {
+      shape = benchmark_option_value(argc, argv, i++);
+    } else if (strcmp(argv[i], "-n") == 0) {
+      size = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-l") == 0) {
+      levels = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-t") == 0) {
+      tags = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-c") == 0) {
+      work = atoll(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-b") == 0) {
+      batch = true;
+    } else if (strcmp(argv[i], "-j") == 0) {
+      json_file = benchmark_option_value(argc, argv, i++);
+    } else {
+      runtime_argv[runtime_argc++] = argv[i];
+    }
+  }
+
+  if (strcmp(shape, "chain") == 0) {
+    width = 1;
+    depth = size;
+  } else if (strcmp(shape, "fanout") == 0 || strcmp(shape, "timers") == 0) {
+    width = size;
+    depth = 1;
+    timer_bank = strcmp(shape, "timers") == 0;
+  } else if (strcmp(shape, "wide") == 0 || strcmp(shape, "deadline") == 0 || strcmp(shape, "sparse") == 0) {
+    width = size;
+    depth = levels;
+    deadlines = strcmp(shape, "deadline") == 0;
+    sparse = strcmp(shape, "sparse") == 0;
+  } else {
+    lf_print_error_and_exit("Unknown shape %s. Use chain, fanout, wide, deadline, sparse or timers.", shape);
+  }
+  if (width < 1 || depth < 1 || tags < 1 || work < 0) {
+    lf_print_error_and_exit("The size, number of levels and tags must be positive and the work not negative.");
+  }
+
+  int result = lf_reactor_c_main(runtime_argc, runtime_argv);
+  if (result == 0 && executions() != expected_executions()) {
+    lf_print_error("The %s shape executed %zu reactions instead of %zu.", shape, executions(), expected_executions());
+    result = 1;
+  } else if (result == 0 && tags_completed > 0) {
+    FILE* output = benchmark_open_output(json_file);
+    report(output);
+    benchmark_close_output(output);
+  }
+  free(runtime_argv);
+  return result;
+}
@@ -0,0 +1,192 @@
+/**
+ * @file tracing_benchmark.c
+ * @brief Benchmark of the cost of a tracepoint, linked against the runtime as configured.
+ *
+ * Each benchmark reaches a tracepoint a fixed number of times and is repeated a number of
+ * times, both on a thread that has a runtime thread ID, as the workers do, and on a thread
+ * created by the user, whose records go to the ring shared by such threads. The minimum and
+ * the median time per event over the repetitions are written as JSON:
+ *
+ *   {"tracing": true, "variant": "default", "repetitions": 11, "benchmarks": [
+ *     {"name": "reaction_starts_ends", "thread": "worker", "events": 1048576, "min_ns_per_event": 9.1, ...},
+ *     ...
+ *   ]}
+ *
+ * The benchmarks are:
+ * - reaction_starts_ends: the tracepoint_reaction_starts and tracepoint_reaction_ends macros,
+ *   which check that the event type is traced and that the reaction is selected by the filter
+ *   and the sampling period before calling call_tracepoint(), which reads the clock, builds
+ *   the record and passes it to lf_tracing_tracepoint() of the plugin. That looks up the
+ *   thread ID, checks for room in the buffer of the thread and copies the record into it.
+ * - user_event: tracepoint_user_event(), which takes the same path without the checks of
+ *   the reaction.
+ * - reaction_not_traced: the two macros when the reactions are excluded with
+ *   _lf_trace_set_events(), which costs only the check of the event type.
+ * Without LF_TRACE, the tracepoints compile to nothing and the times are those of an empty loop.
+ * The time per event includes the writing of full buffers to the trace file.
+ *
+ * The `tracing_benchmarks` target builds this program without tracing and with each trace
+ * plugin in separate build directories and runs them.
+ *
+ * Usage: tracing_benchmark [-r repetitions] [-e events] [-v variant] [-j json_file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchmark.h"
+#include "environment.h"
+#include "low_level_platform.h"
+#include "tracepoint.h"
+#include "util.h"
+
+#ifdef LF_TRACE
+#define TRACING "true"
+#define DEFAULT_VARIANT "default"
+#else
+#define TRACING "false"
+#define DEFAULT_VARIANT "off"
+#endif
+
+static int repetitions = 11;
+static size_t events = 1 << 20;
+static const char* variant = DEFAULT_VARIANT;
+static const char* json_file = NULL;
+
+static environment_t env;
+static self_base_t self;
+static reaction_t reaction;
+static char description[] = "tracing benchmark";
+
+/** Function that reaches tracepoints `events` times in total. */
+typedef void (*benchmark_t)(void);
+
+static void trace_reactions(void) {
+  environment_t* e = &env;
+  reaction_t* r = &reaction;
+  for (size_t i = 0; i < events; i += 2) {
+    tracepoint_reaction_starts(e, r, 0);
+    tracepoint_reaction_ends(e, r, 0);
+  }
+}
+
+static void trace_user_events(void) {
+  for (size_t i = 0; i < events; i++) {
+    tracepoint_user_event(&self, description);
+  }
+}
+
+static void trace_excluded_reactions(void) {
+#ifdef LF_TRACE
+  _lf_trace_set_events("-reactions");
+#endif
+  trace_reactions();
+#ifdef LF_TRACE
+  _lf_trace_set_events("all");
+#endif
+}
+
+typedef struct {
+  const char* name;
+  benchmark_t run;
+} benchmark_entry_t;
+
+static const benchmark_entry_t benchmarks[] = {
+    {"reaction_starts_ends", trace_reactions},
+    {"user_event", trace_user_events},
+    {"reaction_not_traced", trace_excluded_reactions},
+};
+#define NUM_BENCHMARKS (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+/** The kinds of threads, in the order in which they are measured. */
+static const char* const threads[] = {"worker", "user"};
+#define NUM_THREADS (sizeof(threads) / sizeof(threads[0]))
+
+/** Nanoseconds per event of each repetition of each benchmark on each kind of thread. */
+static double* results;
+
+static double* results_of(size_t thread, size_t benchmark) {
+  return &results[(thread * NUM_BENCHMARKS + benchmark) * repetitions];
+}
+
+/** @brief Run the benchmarks on the calling thread, whose kind is given by its index. */
+static void* run_benchmarks(void* thread) {
+  size_t t = (size_t)(intptr_t)thread;
+  if (strcmp(threads[t], "worker") == 0) {
+    // Worker threads have a thread ID, which selects their own trace buffer.
+    initialize_lf_thread_id();
+  }
+  for (size_t b = 0; b < NUM_BENCHMARKS; b++) {
+    double* ns_per_event = results_of(t, b);
+    for (int r = 0; r < repetitions; r++) {
+      instant_t start = lf_time_physical();
+      benchmarks[b].run();
+      ns_per_event[r] = (double)(lf_time_physical() - start) / (double)events;
+    }
+  }
+  return NULL;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, const char* argv[]) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-r") == 0) {
+      repetitions = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-e") == 0) {
+      events = (size_t)atol(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-v") == 0) {
+      variant = benchmark_option_value(argc, argv, i++);
+    } else if (strcmp(argv[i], "-j") == 0) {
+      json_file = benchmark_option_value(argc, argv, i++);
+    } else {
+      lf_print_error_and_exit("Usage: tracing_benchmark [-r repetitions] [-e events] [-v variant] [-j json_file]");
+    }
+  }
+  if (repetitions < 1 || events < 2) {
+    lf_print_error_and_exit("The repetitions must be positive and the events at least 2.");
+  }
+  results = (double*)calloc(NUM_THREADS * NUM_BENCHMARKS * repetitions, sizeof(double));
+  LF_ASSERT_NON_NULL(results);
+
+  self.environment = &env;
+  reaction.self = &self;
+  reaction.name = "reaction";
+  reaction.deadline = NEVER;
+  env.current_tag = (tag_t){.time = 0, .microstep = 0};
+  // One trace buffer, for the worker thread.
+  lf_tracing_global_init("tracing_benchmark", NULL, 0, 1);
+  register_user_trace_event(&self, description);
+
+  // Each kind of thread runs the benchmarks in turn.
+  for (size_t t = 0; t < NUM_THREADS; t++) {
+    lf_thread_t thread;
+    lf_thread_create(&thread, run_benchmarks, (void*)(intptr_t)t);
+    lf_thread_join(thread, NULL);
+  }
+  lf_tracing_global_shutdown();
+
+  FILE* output = benchmark_open_output(json_file);
+  fprintf(output, "{\"tracing\": %s, \"variant\": \"%s\", \"repetitions\": %d, \"benchmarks\": [\n", TRACING, variant,
+          repetitions);
+  for (size_t t = 0; t < NUM_THREADS; t++) {
+    for (size_t b = 0; b < NUM_BENCHMARKS; b++) {
+      double* ns_per_event = results_of(t, b);
+      qsort(ns_per_event, repetitions, sizeof(double), compare_doubles);
+      bool last = t == NUM_THREADS - 1 && b == NUM_BENCHMARKS - 1;
+      fprintf(output,
+              "  {\"name\": \"%s\", \"thread\": \"%s\", \"events\": %zu, \"min_ns_per_event\": %.2f, "
+              "\"median_ns_per_event\": %.2f}%s\n",
+              benchmarks[b].name, threads[t], events, ns_per_event[0], ns_per_event[repetitions / 2], last ? "" : ",");
+    }
+  }
+  fprintf(output, "]}\n");
+  benchmark_close_output(output);
+  free(results);
+  return 0;
+}
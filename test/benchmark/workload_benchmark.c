@@ -0,0 +1,506 @@
+/**
+ * @file workload_benchmark.c
+ * @brief Savina-style workloads for measuring the runtime as a whole.
+ *
+ * The program builds the reaction graph of one of the following workloads as the generated
+ * code would (see benchmark.h):
+ *
+ *   pingpong  A ping reactor, triggered by a logical action, sends a message to a pong reactor,
+ *             whose reply schedules the action again, so that each round is one microstep.
+ *   ring      A ring of `size` reactors, each of which schedules the logical action of the next,
+ *             so that each hop is one microstep (Savina's ThreadRing).
+ *   pipeline  A timer triggers a source, which feeds a chain of `size` stages.
+ *   forkjoin  A timer triggers a source, which forks to `size` workers that all trigger a join.
+ *   bank      A timer triggers a source, which feeds a bank of `size` columns of `levels` reactors,
+ *             all of which trigger a sink.
+ *   timers    `size` timers, with periods from one to eight periods of the clock and four
+ *             different offsets, each trigger a reaction of their own, and a clock timer
+ *             triggers a reaction that counts the iterations.
+ *   chains    `size` independent chains of `levels` reactors, the first of each triggered by a
+ *             timer of its own, with four different offsets, and a clock timer triggers a
+ *             reaction that counts the iterations. With LF_TAG_PIPELINING, chains that are done
+ *             with a tag can start the next one while the others finish (see pipeline.h).
+ *
+ * Every reaction busy-waits for `work` nanoseconds of physical time. The program runs
+ * `iterations` iterations in fast mode, each of which is a round of the ping-pong or of the
+ * ring or a period of the timer of the source or the clock, and writes JSON with the iterations
+ * and reactions per second, percentiles of the time of an iteration and the peak resident set
+ * size of the process. It fails instead if the workload did not execute as many reactions as it
+ * should, which happens if the runtime is broken in the configuration measured.
+ *
+ * It is linked against the runtime as configured, either threaded or single-threaded. The
+ * `workload_benchmarks` target builds it for each scheduler and for the single-threaded runtime
+ * in separate build directories and runs each workload. A federated ring is measured by the
+ * `federation_benchmarks` target of the RTI (see core/federated/RTI/test/federation_benchmark.c).
+ *
+ * Usage: workload_benchmark [-s pingpong|ring|pipeline|forkjoin|bank|timers|chains] [-n size] [-l levels]
+ *                           [-i iterations] [-c work] [-j json_file] [runtime options such as -w workers]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "api/schedule.h"
+#define BENCHMARK_GENERATED_CODE
+#include "benchmark.h"
+#include "reactor.h"
+#include "reactor_common.h"
+#include "util.h"
+#if !defined(LF_SINGLE_THREADED)
+#include "scheduler.h"
+#endif
+
+#if defined(LF_SINGLE_THREADED)
+#define RUNTIME_NAME "single_threaded"
+#elif SCHEDULER == SCHED_ADAPTIVE
+#define RUNTIME_NAME "adaptive"
+#elif SCHEDULER == SCHED_GEDF_NP
+#define RUNTIME_NAME "GEDF_NP"
+#elif SCHEDULER == SCHED_WORK_STEALING
+#define RUNTIME_NAME "work_stealing"
+#elif SCHEDULER == SCHED_GEDF_SHARDED
+#define RUNTIME_NAME "GEDF_sharded"
+#elif SCHEDULER == SCHED_DATAFLOW
+#define RUNTIME_NAME "dataflow"
+#elif SCHEDULER == SCHED_LLF
+#define RUNTIME_NAME "LLF"
+#else
+#define RUNTIME_NAME "NP"
+#endif
+
+#if defined(LF_SINGLE_THREADED)
+#define NUM_WORKERS 1
+#else
+#define NUM_WORKERS ((int)env.num_workers)
+#endif
+
+/** Logical period of the timers. The program runs in fast mode, so this only orders their events. */
+#define PERIOD MSEC(1)
+
+/** Upper bits of the index of reactions without a deadline. */
+#define NO_DEADLINE_INDEX 0xFFFFFFFFFFFFULL
+
+/**
+ * A reactor with one reaction, at most one output, which triggers `count` reactions, and a logical
+ * action or a timer of its own. A reaction never executes in parallel with itself, so the count of
+ * its executions needs no synchronization.
+ */
+typedef struct {
+  self_base_t base;
+  reaction_t reaction;
+  reaction_t* reaction_pointer;
+  lf_port_base_t output;
+  trigger_t output_trigger;
+  bool* output_produced[1];
+  int triggered_sizes[1];
+  trigger_t* triggered[1];
+  trigger_t** triggers[1];
+  trigger_t trigger; // The action or timer that triggers the reaction, if any.
+  trigger_t* next;   // The action that the reaction schedules, if any.
+  size_t executions;
+} node_t;
+
+static const char* workload = "pipeline";
+static int size = 8;
+static int levels = 4;
+static int iterations = 10000;
+static interval_t work = 0;
+static const char* json_file = NULL;
+
+static trigger_t kickoff; // A timer that starts the first round of pingpong and ring.
+static node_t* nodes;
+static int num_nodes;
+static int num_levels;
+static int num_timers;
+static int num_present_fields;
+
+static instant_t* iteration_starts; // The physical times at which the iterations started.
+static int iterations_started;
+
+////////////////// Reactions
+
+/** Busy-wait for the work of one reaction and produce its output, if it has one. */
+static void run_node(node_t* node) {
+  instant_t start = lf_time_physical();
+  while (lf_time_physical() - start < work) {
+  }
+  if (node->output_trigger.number_of_reactions > 0) {
+    lf_set_present(&node->output);
+  }
+  if (node->next != NULL) {
+    LF_CRITICAL_SECTION_ENTER(&env);
+    lf_schedule_trigger(&env, node->next, 0, NULL);
+    LF_CRITICAL_SECTION_EXIT(&env);
+  }
+  node->executions++;
+}
+
+/** Run a node that starts an iteration, and request to stop after the last one. */
+static void start_iteration(void* self) {
+  if (iterations_started <= iterations) {
+    iteration_starts[iterations_started++] = lf_time_physical();
+    if (iterations_started == iterations + 1) {
+      lf_request_stop();
+    }
+  }
+  run_node((node_t*)self);
+}
+
+static void node_reaction(void* self) { run_node((node_t*)self); }
+
+////////////////// Reaction graph
+
+/**
+ * Initialize the next node, with a reaction at `level` whose output triggers `count` reactions.
+ * @return The node.
+ */
+static node_t* add_node(reaction_function_t function, const char* name, int level, reaction_t** downstream,
+                        int count) {
+  node_t* node = &nodes[num_nodes++];
+  node->base.environment = &env;
+  node->reaction_pointer = &node->reaction;
+  node->reaction.function = function;
+  node->reaction.self = node;
+  node->reaction.name = name;
+  node->reaction.deadline = NEVER;
+  node->reaction.index = (NO_DEADLINE_INDEX << 16) | (index_t)level;
+  node->output.source_reactor = &node->base;
+  node->output.destination_channel = -1;
+  node->output_trigger.last_tag = NEVER_TAG;
+  node->trigger.last_tag = NEVER_TAG;
+  node->trigger.reactions = &node->reaction_pointer;
+  node->trigger.number_of_reactions = 1;
+  if (count > 0) {
+    node->output_trigger.reactions = downstream;
+    node->output_trigger.number_of_reactions = count;
+    node->output_produced[0] = &node->output.is_present;
+    node->triggered_sizes[0] = 1;
+    node->triggered[0] = &node->output_trigger;
+    node->triggers[0] = node->triggered;
+    node->reaction.num_outputs = 1;
+    node->reaction.output_produced = node->output_produced;
+    node->reaction.triggered_sizes = node->triggered_sizes;
+    node->reaction.triggers = node->triggers;
+    env.is_present_fields[num_present_fields++] = &node->output.is_present;
+  }
+  return node;
+}
+
+/** Make the trigger of a node a timer with the given offset and period. */
+static void set_timer(node_t* node, interval_t offset, interval_t period) {
+  node->trigger.is_timer = true;
+  node->trigger.offset = offset;
+  node->trigger.period = period;
+  env.timer_triggers[num_timers++] = &node->trigger;
+}
+
+/** Let a timer that fires once at the start tag trigger the reaction of a node. */
+static void kick_off(node_t* node) {
+  kickoff.is_timer = true;
+  kickoff.last_tag = NEVER_TAG;
+  kickoff.reactions = &node->reaction_pointer;
+  kickoff.number_of_reactions = 1;
+  env.timer_triggers[num_timers++] = &kickoff;
+}
+
+/** Return an array of `count` pointers to the reactions of the nodes from `first` on, `stride` apart. */
+static reaction_t** reactions_of(int first, int count, int stride) {
+  reaction_t** reactions = (reaction_t**)calloc(count, sizeof(reaction_t*));
+  LF_ASSERT_NON_NULL(reactions);
+  for (int i = 0; i < count; i++) {
+    reactions[i] = &nodes[first + i * stride].reaction;
+  }
+  return reactions;
+}
+
+/** Return an array of `count` pointers to the same reaction. */
+static reaction_t** repeat(reaction_t* reaction, int count) {
+  reaction_t** reactions = (reaction_t**)calloc(count, sizeof(reaction_t*));
+  LF_ASSERT_NON_NULL(reactions);
+  for (int i = 0; i < count; i++) {
+    reactions[i] = reaction;
+  }
+  return reactions;
+}
+
+/** Set the number of nodes, timers, output ports and levels of the workload. */
+static void count_nodes(int* timers, int* outputs) {
+  if (strcmp(workload, "pingpong") == 0) {
+    num_nodes = 3;
+    *timers = 1;
+    *outputs = 2;
+    num_levels = 3;
+  } else if (strcmp(workload, "ring") == 0) {
+    num_nodes = size;
+    *timers = 1;
+    *outputs = 0;
+    num_levels = 1;
+  } else if (strcmp(workload, "pipeline") == 0) {
+    num_nodes = 1 + size;
+    *timers = 1;
+    *outputs = size;
+    num_levels = 1 + size;
+  } else if (strcmp(workload, "forkjoin") == 0) {
+    num_nodes = 2 + size;
+    *timers = 1;
+    *outputs = 1 + size;
+    num_levels = 3;
+  } else if (strcmp(workload, "bank") == 0) {
+    num_nodes = 2 + size * levels;
+    *timers = 1;
+    *outputs = 1 + size * levels;
+    num_levels = 2 + levels;
+  } else if (strcmp(workload, "timers") == 0) {
+    num_nodes = 1 + size;
+    *timers = 1 + size;
+    *outputs = 0;
+    num_levels = 1;
+  } else if (strcmp(workload, "chains") == 0) {
+    num_nodes = 1 + size * levels;
+    *timers = 1 + size;
+    *outputs = size * (levels - 1);
+    num_levels = levels;
+  } else {
+    lf_print_error_and_exit("Unknown workload %s. Use pingpong, ring, pipeline, forkjoin, bank, timers or chains.",
+                            workload);
+  }
+}
+
+void lf_create_environments(void) {
+  int timers = 0, outputs = 0;
+  count_nodes(&timers, &outputs);
+#if defined(LF_SINGLE_THREADED)
+  int workers = 1;
+#else
+  int workers = (int)_lf_number_of_workers;
+#endif
+  environment_init(&env, "main", 0, workers, timers, 0, 0, 0, outputs, 0, 0, 0, NULL);
+}
+
+void _lf_initialize_trigger_objects(void) {
+  int count = num_nodes;
+  nodes = (node_t*)calloc(count, sizeof(node_t));
+  iteration_starts = (instant_t*)calloc(iterations + 1, sizeof(instant_t));
+  if (nodes == NULL || iteration_starts == NULL) {
+    lf_print_error_and_exit("Out of memory.");
+  }
+  num_nodes = 0;
+  size_t* num_reactions_per_level = (size_t*)calloc(num_levels, sizeof(size_t));
+  LF_ASSERT_NON_NULL(num_reactions_per_level);
+
+  if (strcmp(workload, "pingpong") == 0) {
+    // The serve action of ping triggers ping, whose message triggers pong, whose reply triggers receive.
+    node_t* ping = add_node(start_iteration, "ping", 0, reactions_of(1, 1, 1), 1);
+    add_node(node_reaction, "pong", 1, reactions_of(2, 1, 1), 1);
+    node_t* receive = add_node(node_reaction, "receive", 2, NULL, 0);
+    receive->next = &ping->trigger;
+    for (int level = 0; level < 3; level++) {
+      num_reactions_per_level[level] = 1;
+    }
+    kick_off(ping);
+  } else if (strcmp(workload, "ring") == 0) {
+    for (int i = 0; i < size; i++) {
+      add_node(i == 0 ? start_iteration : node_reaction, "hop", 0, NULL, 0);
+    }
+    for (int i = 0; i < size; i++) {
+      nodes[i].next = &nodes[(i + 1) % size].trigger;
+    }
+    num_reactions_per_level[0] = size;
+    kick_off(&nodes[0]);
+  } else if (strcmp(workload, "pipeline") == 0) {
+    set_timer(add_node(start_iteration, "source", 0, reactions_of(1, 1, 1), 1), 0, PERIOD);
+    num_reactions_per_level[0] = 1;
+    for (int i = 1; i <= size; i++) {
+      add_node(node_reaction, "stage", i, i < size ? reactions_of(i + 1, 1, 1) : NULL, i < size ? 1 : 0);
+      num_reactions_per_level[i] = 1;
+    }
+  } else if (strcmp(workload, "forkjoin") == 0) {
+    set_timer(add_node(start_iteration, "source", 0, reactions_of(1, size, 1), size), 0, PERIOD);
+    reaction_t** join = reactions_of(1 + size, 1, 1);
+    for (int i = 0; i < size; i++) {
+      add_node(node_reaction, "worker", 1, join, 1);
+    }
+    add_node(node_reaction, "join", 2, NULL, 0);
+    num_reactions_per_level[0] = 1;
+    num_reactions_per_level[1] = size;
+    num_reactions_per_level[2] = 1;
+  } else if (strcmp(workload, "bank") == 0) {
+    // The nodes of level l (1 to levels) of the bank are 1 + (l - 1) * size to l * size.
+    set_timer(add_node(start_iteration, "source", 0, reactions_of(1, size, 1), size), 0, PERIOD);
+    reaction_t** sink = repeat(&nodes[1 + size * levels].reaction, 1);
+    num_reactions_per_level[0] = 1;
+    for (int level = 1; level <= levels; level++) {
+      for (int column = 0; column < size; column++) {
+        int first = 1 + level * size + column;
+        add_node(node_reaction, "member", level, level < levels ? reactions_of(first, 1, 1) : sink, 1);
+      }
+      num_reactions_per_level[level] = size;
+    }
+    add_node(node_reaction, "sink", 1 + levels, NULL, 0);
+    num_reactions_per_level[1 + levels] = 1;
+  } else if (strcmp(workload, "timers") == 0) {
+    set_timer(add_node(start_iteration, "clock", 0, NULL, 0), 0, PERIOD);
+    for (int i = 0; i < size; i++) {
+      set_timer(add_node(node_reaction, "timer", 0, NULL, 0), (i % 4) * (PERIOD / 4), (1 + i % 8) * PERIOD);
+    }
+    num_reactions_per_level[0] = 1 + size;
+  } else {
+    // The nodes of chain c are 1 + c * levels to (c + 1) * levels.
+    set_timer(add_node(start_iteration, "clock", 0, NULL, 0), 0, PERIOD);
+    for (int c = 0; c < size; c++) {
+      for (int level = 0; level < levels; level++) {
+        int next = 2 + c * levels + level;
+        node_t* node = add_node(node_reaction, "link", level, level + 1 < levels ? reactions_of(next, 1, 1) : NULL,
+                                level + 1 < levels ? 1 : 0);
+        if (level == 0) {
+          set_timer(node, (c % 4) * (PERIOD / 4), PERIOD);
+        }
+      }
+    }
+    num_reactions_per_level[0] = 1 + size;
+    for (int level = 1; level < levels; level++) {
+      num_reactions_per_level[level] = size;
+    }
+  }
+
+#if !defined(LF_SINGLE_THREADED)
+  sched_params_t params = {.num_reactions_per_level = num_reactions_per_level,
+                           .num_reactions_per_level_size = num_levels};
+  lf_sched_init(&env, env.num_workers, &params);
+#else
+  free(num_reactions_per_level);
+#endif
+}
+
+////////////////// Report
+
+/** Return the peak resident set size of the process in KiB, or 0 if it is not known. */
+static long peak_rss(void) {
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return usage.ru_maxrss / 1024; // In bytes on macOS.
+#else
+  return usage.ru_maxrss;
+#endif
+#else
+  return 0;
+#endif
+}
+
+/** Return the number of reactions executed. */
+static size_t executions(void) {
+  size_t count = 0;
+  for (int i = 0; i < num_nodes; i++) {
+    count += nodes[i].executions;
+  }
+  return count;
+}
+
+/** Return the number of times that the timer of a node fires until the tag at which the last iteration starts. */
+static size_t firings(node_t* node) {
+  instant_t last = (instant_t)iterations * PERIOD;
+  return node->trigger.offset > last ? 0 : (size_t)((last - node->trigger.offset) / node->trigger.period) + 1;
+}
+
+/**
+ * Return the number of reactions that the workload executes. The stop is requested when the last
+ * iteration starts and takes effect one microstep later, so in pingpong another round and in ring
+ * another hop execute at the stop tag.
+ */
+static size_t expected_executions(void) {
+  if (strcmp(workload, "pingpong") == 0) {
+    return 3 * ((size_t)iterations + 2);
+  } else if (strcmp(workload, "ring") == 0) {
+    return (size_t)size * iterations + 2;
+  } else if (strcmp(workload, "timers") == 0 || strcmp(workload, "chains") == 0) {
+    // The first node is the clock. The timers of the others trigger a node or a chain of `levels` nodes.
+    size_t count = firings(&nodes[0]);
+    for (int i = 1; i < num_nodes; i++) {
+      if (nodes[i].trigger.is_timer) {
+        count += firings(&nodes[i]) * (strcmp(workload, "chains") == 0 ? levels : 1);
+      }
+    }
+    return count;
+  }
+  // Every node reacts once to each firing of the timer of the source.
+  return (size_t)num_nodes * firings(&nodes[0]);
+}
+
+/** Write the results as JSON. */
+static void report(FILE* output) {
+  size_t executed = executions();
+  // The iterations measured are those between the first and the last start.
+  int measured = iterations_started - 1;
+  interval_t elapsed = iteration_starts[measured] - iteration_starts[0];
+  interval_t* times = (interval_t*)calloc(measured > 0 ? measured : 1, sizeof(interval_t));
+  LF_ASSERT_NON_NULL(times);
+  for (int i = 0; i < measured; i++) {
+    times[i] = iteration_starts[i + 1] - iteration_starts[i];
+  }
+  qsort(times, measured, sizeof(interval_t), benchmark_compare_intervals);
+#define PERCENTILE(p) (measured > 0 ? times[(int)((p) * (measured - 1))] : 0)
+
+  fprintf(output, "{\"runtime\": \"%s\", \"workload\": \"%s\", \"workers\": %d, \"size\": %d, \"levels\": %d, ",
+          RUNTIME_NAME, workload, NUM_WORKERS, size, levels);
+  fprintf(output, "\"work_ns\": " PRINTF_TIME ", \"iterations\": %d, \"reactions\": %zu, \"elapsed_ns\": " PRINTF_TIME
+          ",\n", work, measured, executed, elapsed);
+  fprintf(output, " \"iterations_per_second\": %.0f, \"reactions_per_second\": %.0f,\n",
+          elapsed > 0 ? (double)measured * BILLION / elapsed : 0.0,
+          elapsed > 0 ? (double)executed * BILLION / elapsed : 0.0);
+  fprintf(output,
+          " \"iteration_ns\": {\"p50\": " PRINTF_TIME ", \"p90\": " PRINTF_TIME ", \"p99\": " PRINTF_TIME
+          ", \"max\": " PRINTF_TIME "},\n",
+          PERCENTILE(0.5), PERCENTILE(0.9), PERCENTILE(0.99), PERCENTILE(1.0));
+  fprintf(output, " \"peak_rss_kib\": %ld}\n", peak_rss());
+#undef PERCENTILE
+  free(times);
+}
+
+////////////////// Main
+
+int main(int argc, const char* argv[]) {
+  // Options of the benchmark are removed, and the others are passed to the runtime.
+  int runtime_argc;
+  const char** runtime_argv = benchmark_runtime_argv(argc, argv, &runtime_argc);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0) {
+      workload = benchmark_option_value(argc, argv, i++);
+    } else if (strcmp(argv[i], "-n") == 0) {
+      size = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-l") == 0) {
+      levels = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-i") == 0) {
+      iterations = atoi(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-c") == 0) {
+      work = atoll(benchmark_option_value(argc, argv, i++));
+    } else if (strcmp(argv[i], "-j") == 0) {
+      json_file = benchmark_option_value(argc, argv, i++);
+    } else {
+      runtime_argv[runtime_argc++] = argv[i];
+    }
+  }
+  if (size < 1 || levels < 1 || iterations < 1 || work < 0) {
+    lf_print_error_and_exit("The size, number of levels and iterations must be positive and the work not negative.");
+  }
+
+  int result = lf_reactor_c_main(runtime_argc, runtime_argv);
+  if (result == 0 && executions() != expected_executions()) {
+    lf_print_error("The %s workload executed %zu reactions instead of %zu.", workload, executions(),
+                   expected_executions());
+    result = 1;
+  } else if (result == 0 && iterations_started > 1) {
+    FILE* output = benchmark_open_output(json_file);
+    report(output);
+    benchmark_close_output(output);
+  }
+  free(runtime_argv);
+  return result;
+}
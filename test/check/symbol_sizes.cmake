@@ -0,0 +1,21 @@
+# Check that the functions without_tracepoints and with_tracepoints of the object file OBJECT have the same size,
+# according to the nm program NM.
+execute_process(
+    COMMAND ${NM} -S --defined-only ${OBJECT}
+    OUTPUT_VARIABLE SYMBOLS
+    RESULT_VARIABLE RESULT
+)
+if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "${NM} failed on ${OBJECT}.")
+endif()
+foreach(FUNCTION without_tracepoints with_tracepoints)
+    if(NOT SYMBOLS MATCHES "[0-9a-fA-F]+ ([0-9a-fA-F]+) [Tt] ${FUNCTION}\n")
+        message(FATAL_ERROR "No size for ${FUNCTION} in ${OBJECT}.")
+    endif()
+    set(SIZE_${FUNCTION} ${CMAKE_MATCH_1})
+endforeach()
+if(NOT SIZE_without_tracepoints STREQUAL SIZE_with_tracepoints)
+    message(FATAL_ERROR "Disabled tracepoints add code: with_tracepoints has 0x${SIZE_with_tracepoints} bytes, "
+                        "without_tracepoints 0x${SIZE_without_tracepoints}.")
+endif()
+message(STATUS "Disabled tracepoints add no code (0x${SIZE_with_tracepoints} bytes).")
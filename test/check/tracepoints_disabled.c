@@ -0,0 +1,45 @@
+/**
+ * @file tracepoints_disabled.c
+ * @brief Functions that differ only by tracepoints, which must compile to nothing without LF_TRACE.
+ *
+ * The tracepoints_disabled test compiles this file with optimization and checks with
+ * symbol_sizes.cmake that both functions have the same size.
+ */
+
+#include "environment.h"
+#include "tracepoint.h"
+
+/** Stores that the compiler cannot remove, around which the tracepoints are placed. */
+volatile int tracepoints_disabled_sink;
+
+void without_tracepoints(environment_t* env, reaction_t* reaction, trigger_t* trigger) {
+  (void)env;
+  (void)reaction;
+  (void)trigger;
+  tracepoints_disabled_sink = 1;
+  tracepoints_disabled_sink = 2;
+}
+
+void with_tracepoints(environment_t* env, reaction_t* reaction, trigger_t* trigger) {
+  tag_t tag = env->current_tag;
+  tracepoints_disabled_sink = 1;
+  tracepoint_reaction_starts(env, reaction, 0);
+  tracepoint_schedule(env, trigger, 0);
+  tracepoint_user_event(reaction->self, "event");
+  tracepoint_user_value(reaction->self, "value", 1);
+  tracepoint_runtime_value(env, "value", 1);
+  tracepoint_reaction_deadline_missed(env, reaction, 0);
+  tracepoint_reaction_ends(env, reaction, 0);
+  tracepoint_worker_wait_starts(env, 0);
+  tracepoint_worker_wait_ends(env, 0);
+  tracepoint_scheduler_advancing_time_starts(env);
+  tracepoint_scheduler_advancing_time_ends(env);
+  tracepoint_federate_to_rti(send_TAG, 0, &tag);
+  tracepoint_federate_from_rti(receive_TAG, 0, &tag);
+  tracepoint_federate_to_federate(send_TAGGED_MSG, 0, 1, &tag);
+  tracepoint_federate_from_federate(receive_TAGGED_MSG, 0, 1, &tag);
+  tracepoint_rti_to_federate(send_TAG, 0, &tag);
+  tracepoint_rti_from_federate(receive_TAG, 0, &tag);
+  tracepoint_dump();
+  tracepoints_disabled_sink = 2;
+}
@@ -0,0 +1,59 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "mixed_radix.h"
+
+/**
+ * Check that the table of the mixed-radix numbers of the given radixes and permutation
+ * agrees with incrementing a number and computing its values digit by digit.
+ */
+static void check_table(int size, int* radixes, int* permutation) {
+  int digits[8] = {0};
+  mixed_radix_int_t x = {size, digits, radixes, permutation};
+  mixed_radix_table_t* table = mixed_radix_table_new(&x);
+  assert(table != NULL);
+  int count = 1;
+  for (int i = 0; i < size; i++) {
+    count *= radixes[i];
+  }
+  assert(table->count == count);
+  assert((table->narrow != NULL) == (count <= 65536));
+
+  // Start from a number that is not zero and go around twice, past the wrap-around.
+  for (int i = 0; i < 5; i++) {
+    mixed_radix_incr(&x);
+  }
+  int position = mixed_radix_table_position_of(table, &x);
+  assert(position == 5 % count);
+  for (int i = 0; i < 2 * count; i++) {
+    assert(mixed_radix_table_to_int(table, position) == mixed_radix_to_int(&x));
+    for (int n = 0; n <= size; n++) {
+      assert(mixed_radix_table_parent(table, position, n) == mixed_radix_parent(&x, n));
+    }
+    assert(mixed_radix_table_position(table, mixed_radix_to_int(&x)) == position);
+    mixed_radix_incr(&x);
+    position = mixed_radix_table_incr(table, position);
+  }
+  mixed_radix_table_free(table);
+}
+
+int main() {
+  int radixes[] = {2, 3, 4};
+  int permutation[] = {1, 0, 2};
+  check_table(3, radixes, permutation);
+
+  int identity[] = {0, 1, 2};
+  check_table(3, radixes, identity);
+
+  int single_radix[] = {7};
+  int single_permutation[] = {0};
+  check_table(1, single_radix, single_permutation);
+
+  // Too many numbers for 16-bit entries.
+  int large_radixes[] = {300, 250};
+  int large_permutation[] = {1, 0};
+  check_table(2, large_radixes, large_permutation);
+
+  printf("Tables of mixed-radix numbers agree with the digits.\n");
+  return 0;
+}
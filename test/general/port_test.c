@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+#include "port.h"
+#include "util.h"
+
+#define RANDOM_SEED 1614
+
+/**
+ * @brief Set `size` random channels present, some of them repeatedly, and check that iterating
+ * over the sparse record yields each present channel once in increasing order, twice in a row.
+ */
+static void test_iteration(int width, int size) {
+  lf_port_base_t* ports = (lf_port_base_t*)calloc(width, sizeof(lf_port_base_t));
+  lf_port_base_t** port = (lf_port_base_t**)calloc(width, sizeof(lf_port_base_t*));
+  lf_sparse_io_record_t* record =
+      (lf_sparse_io_record_t*)calloc(1, sizeof(lf_sparse_io_record_t) + size * sizeof(size_t));
+  record->size = size;
+  record->capacity = size;
+  for (int i = 0; i < width; i++) {
+    port[i] = &ports[i];
+    ports[i].sparse_record = record;
+  }
+  for (int i = 0; i < size; i++) {
+    // Set every fourth channel twice.
+    size_t channel = (i % 4 == 3) ? record->present_channels[i - 1] : (size_t)(rand() % width);
+    record->present_channels[i] = channel;
+    ports[channel].is_present = true;
+  }
+  for (int k = 0; k < 2; k++) {
+    lf_multiport_iterator_t iterator = _lf_multiport_iterator_impl(port, width);
+    int channel = lf_multiport_next(&iterator);
+    for (int expected = 0; expected < width; expected++) {
+      if (ports[expected].is_present) {
+        if (channel != expected) {
+          lf_print_error_and_exit("Width %d: expected channel %d but got %d.", width, expected, channel);
+        }
+        channel = lf_multiport_next(&iterator);
+      }
+    }
+    if (channel != -1) {
+      lf_print_error_and_exit("Width %d: unexpected channel %d.", width, channel);
+    }
+  }
+  free(record);
+  free(port);
+  free(ports);
+}
+
+/**
+ * @brief Check that a sparse record grows when it overflows often, and that iteration over
+ * the grown record yields the present channels.
+ */
+static void test_growth() {
+  int width = 100;
+  lf_port_base_t ports[100] = {0};
+  lf_port_base_t* port[100];
+  lf_sparse_io_record_t* record = (lf_sparse_io_record_t*)calloc(1, sizeof(lf_sparse_io_record_t) + 2 * sizeof(size_t));
+  record->capacity = 2;
+  for (int i = 0; i < width; i++) {
+    port[i] = &ports[i];
+    ports[i].sparse_record = record;
+  }
+  // Occasional overflows do not change the capacity.
+  for (int tag = 0; tag < 10 * LF_SPARSE_OVERFLOW_WINDOW; tag++) {
+    record->size = (tag % LF_SPARSE_OVERFLOW_WINDOW == 0) ? -1 : 1;
+    lf_sparse_io_record_start_tag(record);
+  }
+  if (record->capacity != 2 || record->size != 0) {
+    lf_print_error_and_exit("Capacity changed to %zu without frequent overflows.", record->capacity);
+  }
+  for (int tag = 0; tag < LF_SPARSE_OVERFLOWS_TO_GROW; tag++) {
+    record->size = -1;
+    lf_sparse_io_record_start_tag(record);
+  }
+  if (record->capacity != 4 || record->channels == NULL) {
+    lf_print_error_and_exit("Capacity is %zu instead of 4 after frequent overflows.", record->capacity);
+  }
+  for (int i = 0; i < 4; i++) {
+    size_t channel = (size_t)(97 - 31 * i);
+    lf_sparse_io_record_channels(record)[record->size++] = channel;
+    ports[channel].is_present = true;
+  }
+  lf_multiport_iterator_t iterator = _lf_multiport_iterator_impl(port, width);
+  int expected[] = {4, 35, 66, 97, -1};
+  for (int i = 0; i < 5; i++) {
+    int channel = lf_multiport_next(&iterator);
+    if (channel != expected[i]) {
+      lf_print_error_and_exit("Expected channel %d but got %d.", expected[i], channel);
+    }
+  }
+  lf_sparse_io_record_free(record);
+  free(record);
+}
+
+/**
+ * @brief Check that iteration over a sparse record that overflows uses a bitmap of the present
+ * channels from the tag after the first iteration over it.
+ */
+static void test_bitmap() {
+  int width = 200;
+  lf_port_base_t ports[200] = {0};
+  lf_port_base_t* port[200];
+  lf_sparse_io_record_t* record = (lf_sparse_io_record_t*)calloc(1, sizeof(lf_sparse_io_record_t) + 2 * sizeof(size_t));
+  record->capacity = 2;
+  for (int i = 0; i < width; i++) {
+    port[i] = &ports[i];
+    ports[i].sparse_record = record;
+  }
+  int expected[] = {3, 64, 65, 127, 199, -1};
+  for (int tag = 0; tag < 3; tag++) {
+    lf_sparse_io_record_start_tag(record);
+    memset(ports, 0, sizeof(ports));
+    for (int i = 0; i < width; i++) {
+      ports[i].sparse_record = record;
+    }
+    for (int i = 4; i >= 0; i--) {
+      ports[expected[i]].is_present = true;
+      lf_sparse_io_record_set_present(record, (size_t)expected[i]);
+    }
+    // The record overflows.
+    record->size = -1;
+    lf_multiport_iterator_t iterator = _lf_multiport_iterator_impl(port, width);
+    for (int i = 0; i < 6; i++) {
+      int channel = lf_multiport_next(&iterator);
+      if (channel != expected[i]) {
+        lf_print_error_and_exit("Tag %d: expected channel %d but got %d.", tag, expected[i], channel);
+      }
+    }
+    if ((tag > 0) != (record->present_bits != NULL)) {
+      lf_print_error_and_exit("Tag %d: the record unexpectedly has %s bitmap.", tag, tag > 0 ? "no" : "a");
+    }
+  }
+  lf_sparse_io_record_free(record);
+  free(record);
+}
+
+int main() {
+  srand(RANDOM_SEED);
+  for (int i = 0; i < 100; i++) {
+    test_iteration(20, 2 + rand() % 15);
+    test_iteration(1024, 17 + rand() % 100);
+    test_iteration(LF_SPARSE_BITMAP_MAX_WIDTH + 10, 17 + rand() % 100);
+  }
+  test_growth();
+  test_bitmap();
+  return 0;
+}
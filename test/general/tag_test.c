@@ -1,10 +1,116 @@
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "lf_types.h"
 
+// The implementations of the tag functions before they were made branch-free, for reference.
+
+static instant_t reference_time_add(instant_t a, interval_t b) {
+  if (a == NEVER || b == NEVER) {
+    return NEVER;
+  }
+  if (a == FOREVER || b == FOREVER) {
+    return FOREVER;
+  }
+  instant_t res = a + b;
+  // Check for overflow
+  if (res < a && b > 0) {
+    return FOREVER;
+  }
+  // Check for underflow
+  if (res > a && b < 0) {
+    return NEVER;
+  }
+  return res;
+}
+
+static tag_t reference_tag_add(tag_t a, tag_t b) {
+  instant_t res = reference_time_add(a.time, b.time);
+  if (res == FOREVER) {
+    return FOREVER_TAG;
+  }
+  if (res == NEVER) {
+    return NEVER_TAG;
+  }
+
+  if (b.time > 0) {
+    // NOTE: The reason for handling this case is to "reset" the microstep counter at each after delay.
+    a.microstep = 0; // Ignore microstep of first arg if time of second is > 0.
+  }
+  tag_t result = {.time = res, .microstep = a.microstep + b.microstep};
+
+  // If microsteps overflows
+  // FIXME: What should be the resulting tag in case of microstep overflow.
+  //  see https://github.com/lf-lang/reactor-c/issues/430
+  if (result.microstep < a.microstep) {
+    return FOREVER_TAG;
+  }
+  return result;
+}
+
+static int reference_tag_compare(tag_t tag1, tag_t tag2) {
+  if (tag1.time < tag2.time) {
+    return -1;
+  } else if (tag1.time > tag2.time) {
+    return 1;
+  } else if (tag1.microstep < tag2.microstep) {
+    return -1;
+  } else if (tag1.microstep > tag2.microstep) {
+    return 1;
+  } else {
+    return 0;
+  }
+}
+
+static tag_t reference_delay_tag(tag_t tag, interval_t interval) {
+  if (tag.time == NEVER || interval < 0LL)
+    return tag;
+  // Note that overflow in C is undefined for signed variables.
+  if (tag.time >= FOREVER - interval)
+    return FOREVER_TAG; // Overflow.
+  tag_t result = tag;
+  if (interval == 0LL) {
+    // Note that unsigned variables will wrap on overflow.
+    // This is probably the only reasonable thing to do with overflowing
+    // microsteps.
+    result.microstep++;
+  } else {
+    result.time += interval;
+    result.microstep = 0;
+  }
+  return result;
+}
+
+static const instant_t times[] = {NEVER, NEVER + 1, -SEC(1), -1, 0, 1, SEC(1), FOREVER - SEC(1), FOREVER - 1, FOREVER};
+static const microstep_t microsteps[] = {0, 1, 2, UINT_MAX - 1, UINT_MAX};
+
+#define NUM_TIMES (sizeof(times) / sizeof(times[0]))
+#define NUM_MICROSTEPS (sizeof(microsteps) / sizeof(microsteps[0]))
+
+static void assert_same_tag(tag_t expected, tag_t actual) {
+  assert(expected.time == actual.time && expected.microstep == actual.microstep);
+  (void)expected;
+  (void)actual;
+}
+
+/** Check the tag functions against their reference implementations on the corner cases. */
+static void test_tag_functions(void) {
+  for (size_t i = 0; i < NUM_TIMES * NUM_MICROSTEPS; i++) {
+    tag_t a = {.time = times[i / NUM_MICROSTEPS], .microstep = microsteps[i % NUM_MICROSTEPS]};
+    for (size_t j = 0; j < NUM_TIMES * NUM_MICROSTEPS; j++) {
+      tag_t b = {.time = times[j / NUM_MICROSTEPS], .microstep = microsteps[j % NUM_MICROSTEPS]};
+      assert(lf_time_add(a.time, b.time) == reference_time_add(a.time, b.time));
+      assert(lf_tag_compare(a, b) == reference_tag_compare(a, b));
+      assert_same_tag(reference_tag_add(a, b), lf_tag_add(a, b));
+      assert_same_tag(reference_delay_tag(a, b.time), lf_delay_tag(a, b.time));
+    }
+  }
+}
+
 int main() {
   char* buf = malloc(sizeof(char) * 128);
   lf_readable_time(buf, 0);
   printf("%s", buf);
+  test_tag_functions();
   return 0;
 }
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include "lf_token.h"
+#include "environment.h"
+#include "low_level_platform.h"
+
+/**
+ * The tests run on a single thread, so the critical sections of the token
+ * functions need no lock. Defining them here keeps the scheduler out of the link.
+ */
+int lf_critical_section_enter(environment_t* env) {
+  (void)env;
+  return 0;
+}
+int lf_critical_section_exit(environment_t* env) {
+  (void)env;
+  return 0;
+}
+
+static int destructor_calls = 0;
+
+static void count_and_free(void* value) {
+  destructor_calls++;
+  free(value);
+}
+
+/** A moved value is released once, with its own destructor, and the next value uses that of the type. */
+static void test_move_destructor(void) {
+  token_template_t template = {.type = {.element_size = sizeof(int)}};
+  int* value = (int*)malloc(4 * sizeof(int));
+  lf_token_t* token = _lf_initialize_token_with_value(&template, value, 4);
+  token->destructor = count_and_free;
+  _lf_replace_template_token(&template, NULL);
+  assert(destructor_calls == 1);
+
+  token = _lf_initialize_token_with_value(&template, malloc(sizeof(int)), 1);
+  assert(token->destructor == NULL);
+  _lf_replace_template_token(&template, NULL);
+  assert(destructor_calls == 1);
+}
+
+/** A payload drawn from the pool and moved into a token returns to the pool when the token is released. */
+static void test_move_pooled(void) {
+  // The pool outlives the test, until _lf_free_all_tokens().
+  static token_template_t template = {.type = {.element_size = sizeof(int)}};
+  assert(lf_token_pool_alloc(&template, 8) == NULL);
+  assert(lf_token_pool_enable(&template, 4) == 0);
+
+  lf_token_pool_stats_t stats;
+  for (int i = 0; i < 2; i++) {
+    int* value = (int*)lf_token_pool_alloc(&template, 8);
+    assert(value != NULL);
+    lf_token_t* token = _lf_new_token(&template.type, value, 8);
+    token->destructor = lf_token_pool_free;
+    // Hold a reference, as an event on the event queue would.
+    token->ref_count = 1;
+    lf_token_pool_get_stats(&template, &stats);
+    assert(stats.in_use == 1);
+    _lf_done_using(token);
+  }
+  lf_token_pool_get_stats(&template, &stats);
+  assert(stats.allocations == 2);
+  assert(stats.hits == 1);
+  assert(stats.in_use == 0);
+}
+
+#ifdef PLATFORM_Linux
+#define COW_SIZE (1 << 16)
+
+/** A writable copy of a copy-on-write payload has the same content, and writing it leaves the payload as it was. */
+static void test_copy_on_write(void) {
+  self_base_t self = {0};
+  lf_port_base_t port = {.tmplt = {.type = {.element_size = 1}}, .num_destinations = 2, .source_reactor = &self};
+  char* value = (char*)lf_cow_alloc(COW_SIZE);
+  assert(value != NULL);
+  memset(value, 'a', COW_SIZE);
+  lf_token_t* token = _lf_initialize_token_with_value(&port.tmplt, value, COW_SIZE);
+  token->destructor = lf_cow_free;
+
+  assert(lf_writable_region(&port, COW_SIZE - 1, 2) == NULL);
+  lf_token_t* copy = lf_writable_region(&port, 100, 10);
+  assert(copy != NULL && copy != token && copy->destructor == lf_cow_free);
+  char* bytes = (char*)copy->value;
+  assert(bytes != value && bytes[0] == 'a' && bytes[COW_SIZE - 1] == 'a');
+  memset(bytes + 100, 'b', 10);
+  bytes[COW_SIZE - 1] = 'c';
+  assert(value[100] == 'a' && value[COW_SIZE - 1] == 'a');
+
+  // A copy of the copy has its modifications.
+  char* again = (char*)lf_cow_clone(bytes);
+  assert(again[100] == 'b' && again[COW_SIZE - 1] == 'c' && again[0] == 'a');
+  lf_cow_free(again);
+
+  _lf_free_token_copies();
+  _lf_replace_template_token(&port.tmplt, NULL);
+}
+#endif // PLATFORM_Linux
+
+/** Copies made for mutable inputs are freed once, with the destructor of their type, after the tag. */
+static void test_free_token_copies(void) {
+  self_base_t self = {0};
+  lf_port_base_t port = {.tmplt = {.type = {.element_size = sizeof(int), .destructor = count_and_free}},
+                         .num_destinations = 2,
+                         .source_reactor = &self};
+  _lf_initialize_token_with_value(&port.tmplt, malloc(sizeof(int)), 1);
+  destructor_calls = 0;
+  for (int i = 0; i < 3; i++) {
+    assert(lf_writable_copy(&port) != port.tmplt.token);
+  }
+  _lf_free_token_copies();
+  // Wait for the copies to be freed, which may be done by a background thread.
+  _lf_free_all_tokens();
+  assert(destructor_calls == 3);
+  _lf_replace_template_token(&port.tmplt, NULL);
+  assert(destructor_calls == 4);
+}
+
+/** A broadcast token is freed once, when the last of its destinations and its template release it. */
+static void test_broadcast(void) {
+  token_template_t template = {.type = {.element_size = sizeof(int), .destructor = count_and_free}};
+  lf_token_t* token = _lf_initialize_token_with_value(&template, malloc(sizeof(int)), 1);
+  destructor_calls = 0;
+  lf_token_broadcast(token, 3);
+  assert(token->ref_count == 4);
+  _lf_replace_template_token(&template, NULL);
+  for (int i = 0; i < 3; i++) {
+    assert(destructor_calls == 0);
+    _lf_done_using(token);
+  }
+  assert(destructor_calls == 1);
+}
+
+int main(void) {
+  test_move_destructor();
+  test_move_pooled();
+#ifdef PLATFORM_Linux
+  test_copy_on_write();
+#endif
+  test_free_token_copies();
+  test_broadcast();
+  printf("Token tests passed.\n");
+  return 0;
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "low_level_platform.h"
+#include "util.h"
+
+#if !defined(LF_SINGLE_THREADED)
+#define MAX_LINES 4096
+#define THREADS 4
+#define MESSAGES 1000
+#define MAX_THREAD_ID 64
+
+static char* lines[MAX_LINES];
+static int num_lines = 0;
+
+/** Print function that records the messages. Messages are written by one thread at a time. */
+static void capture(const char* format, va_list args) {
+  char line[1024];
+  vsnprintf(line, sizeof(line), format, args);
+  assert(num_lines < MAX_LINES);
+  lines[num_lines++] = strdup(line);
+}
+
+static void clear_lines(void) {
+  for (int i = 0; i < num_lines; i++) {
+    free(lines[i]);
+  }
+  num_lines = 0;
+}
+
+static void queue(const char* format, ...) ATTRIBUTE_FORMAT_PRINTF(1, 2);
+static void queue(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  assert(_lf_async_log_vprint("LOG: ", format, args));
+  va_end(args);
+}
+
+/** Queue a message and check that it is written out as printf would format it. */
+#define CHECK(...)                                                                                                     \
+  do {                                                                                                                 \
+    char expected[1024];                                                                                               \
+    int length = snprintf(expected, sizeof(expected), "LOG: " __VA_ARGS__);                                            \
+    snprintf(expected + length, sizeof(expected) - length, "\n");                                                      \
+    queue(__VA_ARGS__);                                                                                                \
+    lf_async_log_flush();                                                                                              \
+    assert(num_lines == 1);                                                                                            \
+    if (strcmp(lines[0], expected) != 0) {                                                                             \
+      printf("Expected \"%s\" but got \"%s\".\n", expected, lines[0]);                                                 \
+      exit(1);                                                                                                         \
+    }                                                                                                                  \
+    clear_lines();                                                                                                     \
+  } while (0)
+
+static void test_formats(void) {
+  char long_string[1000];
+  memset(long_string, 'x', sizeof(long_string) - 1);
+  long_string[sizeof(long_string) - 1] = '\0';
+  char unterminated[3] = {'a', 'b', 'c'};
+
+  CHECK("No arguments, 100%% sure.");
+  CHECK("Integers %d %i %u %x %X %o %hhd %hd.", -1, 2, 3u, 0xab, 0xcd, 8, 127, -300);
+  CHECK("Long integers %ld %lld %zu %jd %td %llx.", -1L, 1LL << 40, (size_t)7, (intmax_t)-9, (ptrdiff_t)3,
+        0xdeadbeefcafeULL);
+  CHECK("Floats %f %.3e %g %10.2f %Lf %a.", 1.5, 12345.678, 0.0001, -2.25, (long double)3.5, 1.0);
+  CHECK("Strings [%s] [%-6s] [%.2s] [%c] [%.*s].", "abc", "de", "fgh", 'z', 3, unterminated);
+  CHECK("Stars [%*d] [%-*d] [%*d] [%.*f] [%.*f].", 5, 1, 5, 2, -5, 3, 2, 1.23456, -1, 1.5);
+  CHECK("Flags [%+d] [% d] [%#x] [%05d] [%-5d].", 1, 2, 255, 42, 7);
+  CHECK("Pointer %p.", (void*)long_string);
+
+  // A message whose arguments do not fit in a record is formatted by the caller and truncated.
+  queue("Long %s.", long_string);
+  lf_async_log_flush();
+  assert(num_lines == 1);
+  assert(strncmp(lines[0], "LOG: Long xxx", 13) == 0);
+  assert(strlen(lines[0]) < sizeof(long_string));
+  clear_lines();
+}
+
+static void test_order(void) {
+  for (int i = 0; i < 100; i++) {
+    queue("%d", i);
+  }
+  lf_async_log_flush();
+  assert(num_lines == 100);
+  for (int i = 0; i < 100; i++) {
+    assert(atoi(lines[i] + strlen("LOG: ")) == i);
+  }
+  clear_lines();
+}
+
+static void* produce(void* arg) {
+  (void)arg;
+  initialize_lf_thread_id();
+  for (int i = 0; i < MESSAGES; i++) {
+    queue("Message %d of thread %d.", i, lf_thread_id());
+  }
+  return NULL;
+}
+
+static void test_threads(void) {
+  size_t dropped_before = lf_async_log_dropped();
+  lf_thread_t threads[THREADS];
+  for (int t = 0; t < THREADS; t++) {
+    assert(lf_thread_create(&threads[t], produce, NULL) == 0);
+  }
+  for (int t = 0; t < THREADS; t++) {
+    lf_thread_join(threads[t], NULL);
+  }
+  lf_async_log_flush();
+
+  // Every message is either written or counted as dropped, and drops are reported.
+  int written = 0;
+  int reported = 0;
+  int last[MAX_THREAD_ID];
+  memset(last, -1, sizeof(last));
+  for (int i = 0; i < num_lines; i++) {
+    int message, thread;
+    if (sscanf(lines[i], "LOG: Message %d of thread %d.", &message, &thread) == 2) {
+      // The messages of each thread are in order.
+      assert(thread < MAX_THREAD_ID && message > last[thread]);
+      last[thread] = message;
+      written++;
+    } else {
+      int count;
+      assert(sscanf(lines[i], "WARNING: Dropped %d log messages", &count) == 1);
+      reported += count;
+    }
+  }
+  size_t dropped = lf_async_log_dropped() - dropped_before;
+  assert(written + (int)dropped == THREADS * MESSAGES);
+  assert(reported == (int)dropped);
+  clear_lines();
+}
+#endif // !defined(LF_SINGLE_THREADED)
+
+int main(void) {
+#if !defined(LF_SINGLE_THREADED)
+  lf_register_print_function(capture, LOG_LEVEL_ALL);
+  initialize_lf_thread_id();
+  test_formats();
+  test_order();
+  test_threads();
+#endif
+  printf("Asynchronous log tests passed.\n");
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include "lf_combining_tree.h"
+#include "util.h"
+
+#define MAX_MEMBERS 70
+#define ROUNDS 200
+#define RANDOM_SEED 1614
+
+/**
+ * @brief Let all members arrive in a random order and check that only the last one is told so.
+ *
+ * @param tree The tree.
+ * @param arrived Which members have arrived already. All are set on return.
+ * @param n The number of members.
+ */
+static void arrive_all(lf_combining_tree_t* tree, bool* arrived, size_t n) {
+  size_t missing = 0;
+  for (size_t m = 0; m < n; m++) {
+    if (!arrived[m]) {
+      missing++;
+    }
+  }
+  while (missing > 0) {
+    size_t m = (size_t)rand() % n;
+    if (arrived[m]) {
+      continue;
+    }
+    arrived[m] = true;
+    missing--;
+    bool last = lf_combining_tree_arrive(tree, m);
+    if (last != (missing == 0)) {
+      lf_print_error_and_exit("Member %zu of %zu: expected last to be %d but got %d.", m, n, missing == 0, last);
+    }
+  }
+}
+
+int main() {
+  srand(RANDOM_SEED);
+  bool arrived[MAX_MEMBERS];
+  for (size_t n = 1; n <= MAX_MEMBERS; n++) {
+    lf_combining_tree_t* tree = lf_combining_tree_new(n);
+    for (size_t m = 0; m < n; m++) {
+      arrived[m] = false;
+    }
+    arrive_all(tree, arrived, n);
+    for (int round = 0; round < ROUNDS; round++) {
+      // The last member to arrive lets a random subset go, as a scheduler would.
+      size_t departures = 1 + (size_t)rand() % n;
+      for (size_t i = 0; i < departures; i++) {
+        size_t m = (size_t)rand() % n;
+        if (arrived[m]) {
+          lf_combining_tree_depart(tree, m);
+          arrived[m] = false;
+        }
+      }
+      arrive_all(tree, arrived, n);
+    }
+    lf_combining_tree_free(tree);
+  }
+  return 0;
+}
@@ -1,4 +1,5 @@
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include "core/utils/impl/pointer_hashmap.h"
@@ -26,11 +27,18 @@ void test_put(hashmap_object2int_t* h) {
 }
 
 void test_get(hashmap_object2int_t* h) {
+  int* absent = (int*)(uintptr_t)(CAPACITY * sizeof(int)); // test_put never generates this key.
+  if (hashmap_object2int_get_or(h, absent, -1) != -1) {
+    lf_print_error_and_exit("Found a key that was never put in a hashmap.\n");
+  }
   if (!mock_size)
     return;
   size_t r = rand() % mock_size;
   hashmap_object2int_entry_t desired = mock[r];
   int found = hashmap_object2int_get(h, desired.key);
+  if (hashmap_object2int_get_or(h, desired.key, ~found) != found) {
+    lf_print_error_and_exit("Expected %d but got a default when getting from a hashmap.\n", found);
+  }
   // printf("Getting (%p, %d) from %d.\n", desired.key, desired.value, r);
   if (desired.value != found) {
     // It is possible that two distinct values were associated with the same key. Search the
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "hashset/hashset_concurrent.h"
+#include "low_level_platform.h"
+
+#define ITEMS 1000
+#define THREADS 4
+
+static char items[ITEMS];
+
+static void test_add_remove(void) {
+  hashset_concurrent_t set = hashset_concurrent_create(3);
+  assert(set != NULL);
+
+  assert(hashset_concurrent_add(set, NULL) == -1);
+  assert(hashset_concurrent_add(set, (void*)1) == -1);
+
+  for (int i = 0; i < 4; i++) {
+    assert(hashset_concurrent_add(set, &items[i]) == 1);
+  }
+  for (int i = 0; i < 4; i++) {
+    assert(hashset_concurrent_add(set, &items[i]) == 0);
+    assert(hashset_concurrent_is_member(set, &items[i]));
+  }
+  assert(!hashset_concurrent_is_member(set, &items[4]));
+  assert(hashset_concurrent_num_items(set) == 4);
+
+  assert(hashset_concurrent_remove(set, &items[1]) == 1);
+  assert(hashset_concurrent_remove(set, &items[1]) == 0);
+  assert(!hashset_concurrent_is_member(set, &items[1]));
+  assert(hashset_concurrent_num_items(set) == 3);
+
+  // Items behind the tombstone are still reachable, and the removed item can be added again.
+  for (int i = 2; i < 4; i++) {
+    assert(hashset_concurrent_is_member(set, &items[i]));
+  }
+  assert(hashset_concurrent_add(set, &items[1]) == 1);
+  assert(hashset_concurrent_num_items(set) == 4);
+
+  hashset_concurrent_destroy(set);
+}
+
+static void test_full_and_compact(void) {
+  hashset_concurrent_t set = hashset_concurrent_create(3);
+
+  // Tombstones are not reused, so adding and removing distinct items fills the table.
+  for (int i = 0; i < 8; i++) {
+    assert(hashset_concurrent_add(set, &items[i]) == 1);
+    assert(hashset_concurrent_remove(set, &items[i]) == 1);
+  }
+  assert(hashset_concurrent_add(set, &items[8]) == -1);
+  // This should not cause an infinite loop.
+  assert(!hashset_concurrent_is_member(set, &items[8]));
+
+  assert(hashset_concurrent_compact(set) == 0);
+  assert(set->capacity == 8);
+  for (int i = 8; i < 13; i++) {
+    assert(hashset_concurrent_add(set, &items[i]) == 1);
+  }
+  // Compacting a set that is more than half full doubles its capacity.
+  assert(hashset_concurrent_compact(set) == 0);
+  assert(set->capacity == 16);
+  assert(hashset_concurrent_num_items(set) == 5);
+  for (int i = 8; i < 13; i++) {
+    assert(hashset_concurrent_is_member(set, &items[i]));
+  }
+
+  hashset_concurrent_destroy(set);
+}
+
+static void test_iterate_and_drain(void) {
+  hashset_concurrent_t set = hashset_concurrent_create(8);
+  for (int i = 0; i < 100; i++) {
+    hashset_concurrent_add(set, &items[i]);
+  }
+  for (int i = 0; i < 100; i += 2) {
+    hashset_concurrent_remove(set, &items[i]);
+  }
+
+  int seen[100] = {0};
+  hashset_concurrent_itr_t iterator = hashset_concurrent_iterator(set);
+  char* item;
+  while ((item = (char*)hashset_concurrent_next(&iterator)) != NULL) {
+    seen[item - items]++;
+  }
+  for (int i = 0; i < 100; i++) {
+    assert(seen[i] == i % 2);
+  }
+  assert(hashset_concurrent_num_items(set) == 50);
+
+  iterator = hashset_concurrent_iterator(set);
+  while ((item = (char*)hashset_concurrent_drain_next(&iterator)) != NULL) {
+    seen[item - items]--;
+  }
+  for (int i = 0; i < 100; i++) {
+    assert(seen[i] == 0);
+  }
+  assert(hashset_concurrent_num_items(set) == 0);
+  assert(!hashset_concurrent_is_member(set, &items[1]));
+
+  hashset_concurrent_destroy(set);
+}
+
+#if !defined(LF_SINGLE_THREADED)
+static hashset_concurrent_t shared_set;
+static int added[THREADS];
+static int removed[THREADS];
+
+/** Add all items, counting the successful calls. Threads start at different items. */
+static void* add_all(void* arg) {
+  int id = (int)(intptr_t)arg;
+  for (int i = 0; i < ITEMS; i++) {
+    int result = hashset_concurrent_add(shared_set, &items[(i + id * ITEMS / THREADS) % ITEMS]);
+    assert(result >= 0);
+    added[id] += result;
+  }
+  return NULL;
+}
+
+/** Remove all items, counting the successful calls. */
+static void* remove_all(void* arg) {
+  int id = (int)(intptr_t)arg;
+  for (int i = 0; i < ITEMS; i++) {
+    removed[id] += hashset_concurrent_remove(shared_set, &items[(i + id * 7) % ITEMS]);
+  }
+  return NULL;
+}
+
+/** Drain the set, counting the items that this thread got. */
+static void* drain(void* arg) {
+  int id = (int)(intptr_t)arg;
+  hashset_concurrent_itr_t iterator = hashset_concurrent_iterator(shared_set);
+  while (hashset_concurrent_drain_next(&iterator) != NULL) {
+    removed[id]++;
+  }
+  return NULL;
+}
+
+/** Run `function` in THREADS threads and return the sum of the counts in `counts`. */
+static int run_threads(void* (*function)(void*), int* counts) {
+  lf_thread_t threads[THREADS];
+  for (int t = 0; t < THREADS; t++) {
+    counts[t] = 0;
+    assert(lf_thread_create(&threads[t], function, (void*)(intptr_t)t) == 0);
+  }
+  int total = 0;
+  for (int t = 0; t < THREADS; t++) {
+    lf_thread_join(threads[t], NULL);
+    total += counts[t];
+  }
+  return total;
+}
+
+static void test_concurrent(void) {
+  shared_set = hashset_concurrent_create(11);
+
+  // Each item is added by exactly one thread and removed by exactly one thread.
+  assert(run_threads(add_all, added) == ITEMS);
+  assert(hashset_concurrent_num_items(shared_set) == ITEMS);
+  assert(run_threads(remove_all, removed) == ITEMS);
+  assert(hashset_concurrent_num_items(shared_set) == 0);
+
+  // Each item is drained by exactly one thread.
+  assert(hashset_concurrent_compact(shared_set) == 0);
+  for (int i = 0; i < ITEMS; i++) {
+    assert(hashset_concurrent_add(shared_set, &items[i]) == 1);
+  }
+  assert(run_threads(drain, removed) == ITEMS);
+  assert(hashset_concurrent_num_items(shared_set) == 0);
+
+  hashset_concurrent_destroy(shared_set);
+}
+#endif // !defined(LF_SINGLE_THREADED)
+
+int main(void) {
+  test_add_remove();
+  test_full_and_compact();
+  test_iterate_and_drain();
+#if !defined(LF_SINGLE_THREADED)
+  test_concurrent();
+#endif
+  printf("Concurrent hashset tests passed.\n");
+  return 0;
+}
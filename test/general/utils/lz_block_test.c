@@ -0,0 +1,73 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lz_block.h"
+#include "util.h"
+
+#define MAX_LENGTH 100000
+#define ROUNDS 200
+#define RANDOM_SEED 1614
+
+static unsigned char input[MAX_LENGTH];
+static unsigned char compressed[2 * MAX_LENGTH];
+static unsigned char output[MAX_LENGTH];
+
+/** @brief Fill the input with `length` bytes that are random, repetitive, or a mix of both. */
+static void fill_input(size_t length) {
+  int kind = rand() % 3;
+  size_t period = 1 + (size_t)(rand() % 300);
+  for (size_t i = 0; i < length; i++) {
+    if (kind == 0 || (kind == 2 && rand() % 8 == 0)) {
+      input[i] = (unsigned char)rand();
+    } else {
+      input[i] = i < period ? (unsigned char)rand() : input[i - period];
+    }
+  }
+}
+
+/** @brief Check that `length` bytes of input survive compression and decompression. */
+static size_t test_round_trip(size_t length) {
+  size_t compressed_length = lz_block_compress(input, length, compressed, sizeof(compressed));
+  if (compressed_length == 0) {
+    lf_print_error_and_exit("Failed to compress %zu bytes.", length);
+  }
+  if (lz_block_decompress(compressed, compressed_length, output, length) != 0 || memcmp(input, output, length) != 0) {
+    lf_print_error_and_exit("%zu bytes did not survive compression.", length);
+  }
+  if (length > 0 && lz_block_decompress(compressed, compressed_length, output, length - 1) == 0) {
+    lf_print_error_and_exit("Decompressed into a buffer that is too short.");
+  }
+  // Compressing into a buffer that is too small must fail rather than overflow.
+  if (compressed_length > 1 && lz_block_compress(input, length, compressed, compressed_length - 1) != 0) {
+    lf_print_error_and_exit("Compressed %zu bytes into less room than needed.", length);
+  }
+  return compressed_length;
+}
+
+int main() {
+  srand(RANDOM_SEED);
+  for (size_t length = 0; length < 40; length++) {
+    fill_input(length);
+    test_round_trip(length);
+  }
+  for (int i = 0; i < ROUNDS; i++) {
+    size_t length = (size_t)rand() % MAX_LENGTH;
+    fill_input(length);
+    test_round_trip(length);
+  }
+  // Repetitive data must actually get smaller.
+  memset(input, 'x', MAX_LENGTH);
+  if (test_round_trip(MAX_LENGTH) > MAX_LENGTH / 100) {
+    lf_print_error_and_exit("Failed to compress repetitive data.");
+  }
+  // Random changes to a block must not make the decompressor read or write out of bounds.
+  fill_input(MAX_LENGTH);
+  size_t compressed_length = lz_block_compress(input, 1000, compressed, sizeof(compressed));
+  for (int i = 0; i < ROUNDS; i++) {
+    unsigned char saved[2000];
+    memcpy(saved, compressed, compressed_length);
+    compressed[(size_t)rand() % compressed_length] = (unsigned char)rand();
+    lz_block_decompress(compressed, compressed_length, output, 1000);
+    memcpy(compressed, saved, compressed_length);
+  }
+  return 0;
+}
@@ -9,8 +9,11 @@ static void trivial(void) {
   // Create an event queue.
   pqueue_tag_t* q = pqueue_tag_init(1);
   assert(q != NULL);
+#ifndef LF_CALENDAR_QUEUE
+  // The calendar queue is not a pqueue_t.
   assert(pqueue_is_valid((pqueue_t*)q));
   pqueue_print((pqueue_t*)q, NULL);
+#endif
   pqueue_tag_free(q);
 }
 
@@ -26,8 +29,10 @@ static void insert_on_queue(pqueue_tag_t* q) {
   assert(!pqueue_tag_insert_if_no_match(q, t4));
   assert(pqueue_tag_insert_if_no_match(q, t1));
   assert(pqueue_tag_insert_if_no_match(q, t4));
+#ifndef LF_CALENDAR_QUEUE
   printf("======== Contents of the queue:\n");
   pqueue_print((pqueue_t*)q, NULL);
+#endif
   assert(pqueue_tag_size(q) == 4);
 }
 
@@ -84,6 +89,66 @@ static void remove_from_queue(pqueue_tag_t* q, pqueue_tag_element_t* e1, pqueue_
   assert(pqueue_tag_size(q) == 1);
 }
 
+static void pop_all_with_tag(void) {
+  // Enough elements with the same tag that the heap is rebuilt rather than popped one by one.
+  pqueue_tag_element_t elements[300];
+  tag_t t1 = {.time = USEC(1), .microstep = 0};
+  tag_t t2 = {.time = USEC(1), .microstep = 1};
+  pqueue_tag_t* q = pqueue_tag_init(2);
+  for (int i = 0; i < 300; i++) {
+    instant_t time = USEC(1) + USEC(1) * (i % 3);
+    elements[i] = (pqueue_tag_element_t){.tag = {.time = time, .microstep = 0}, .pos = 0, .is_dynamic = 0};
+    assert(pqueue_tag_insert(q, &elements[i]) == 0);
+  }
+  assert(pqueue_tag_insert_tag(q, t2) == 0);
+  vector_t v = vector_new(1);
+  // Nothing is popped unless the tag is the least one.
+  assert(pqueue_tag_pop_all_with_tag(q, t2, &v) == 0);
+  assert(vector_size(&v) == 0);
+  assert(pqueue_tag_pop_all_with_tag(q, t1, &v) == 100);
+  assert(vector_size(&v) == 100);
+  for (size_t i = 0; i < vector_size(&v); i++) {
+    assert(lf_tag_compare((*(pqueue_tag_element_t**)vector_at(&v, i))->tag, t1) == 0);
+  }
+  assert(pqueue_tag_size(q) == 201);
+#ifndef LF_CALENDAR_QUEUE
+  assert(pqueue_is_valid((pqueue_t*)q));
+#endif
+  // A single element.
+  assert(pqueue_tag_pop_all_with_tag(q, t2, &v) == 1);
+  assert(vector_size(&v) == 101);
+  free(vector_pop(&v));
+  assert(pqueue_tag_peek_tag(q).time == USEC(2));
+  assert(pqueue_tag_size(q) == 200);
+  vector_free(&v);
+  pqueue_tag_free(q);
+}
+
+static void elements_of_queue(void) {
+  pqueue_tag_element_t elements[50];
+  pqueue_tag_element_t* copied[50];
+  pqueue_tag_t* q = pqueue_tag_init(2);
+  for (int i = 0; i < 50; i++) {
+    elements[i] = (pqueue_tag_element_t){.tag = {.time = USEC(i % 7), .microstep = i % 2}, .pos = 0, .is_dynamic = 0};
+    assert(pqueue_tag_insert(q, &elements[i]) == 0);
+  }
+  pqueue_tag_pop(q);
+  assert(pqueue_tag_elements(q, copied) == 49);
+  // Each element that is still on the queue is copied once.
+  int seen[50] = {0};
+  for (int i = 0; i < 49; i++) {
+    seen[copied[i] - elements]++;
+  }
+  int total = 0;
+  for (int i = 0; i < 50; i++) {
+    assert(seen[i] <= 1);
+    total += seen[i];
+  }
+  assert(total == 49);
+  assert(pqueue_tag_size(q) == 49);
+  pqueue_tag_free(q);
+}
+
 int main() {
   trivial();
   // Create an event queue.
@@ -100,5 +165,8 @@ int main() {
 
   remove_from_queue(q, &e1, &e2);
 
+  pop_all_with_tag();
+  elements_of_queue();
+
   pqueue_tag_free(q);
 }
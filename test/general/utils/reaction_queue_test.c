@@ -0,0 +1,75 @@
+#include <limits.h>
+#include <stdlib.h>
+#include "reaction_queue.h"
+#include "util.h"
+
+#define NUMBER_OF_REACTIONS 200
+#define MAX_LEVEL 40
+#define ROUNDS 100
+#define RANDOM_SEED 1614
+
+static reaction_t reactions[NUMBER_OF_REACTIONS];
+
+/**
+ * @brief Pop everything in `q` and check that indexes come out in order.
+ *
+ * @param q The queue.
+ * @param expected The number of reactions in the queue.
+ */
+static void check_drain(reaction_queue_t* q, size_t expected) {
+  if (reaction_queue_size(q) != expected) {
+    lf_print_error_and_exit("Expected %zu reactions but the queue has %zu.", expected, reaction_queue_size(q));
+  }
+  index_t previous = 0;
+  for (size_t i = 0; i < expected; i++) {
+    reaction_t* peeked = reaction_queue_peek(q);
+    reaction_t* r = reaction_queue_pop(q);
+    if (r == NULL || r != peeked || r->index < previous) {
+      lf_print_error_and_exit("Reaction %zu popped out of order.", i);
+    }
+    previous = r->index;
+    r->status = inactive;
+  }
+  if (reaction_queue_pop(q) != NULL || reaction_queue_size(q) != 0) {
+    lf_print_error_and_exit("Expected the queue to be empty.");
+  }
+}
+
+int main() {
+  srand(RANDOM_SEED);
+#ifdef LF_STATIC_MEMORY
+  // The queue does not grow, so it has room for all the reactions from the start.
+  reaction_queue_t* q = reaction_queue_init(NUMBER_OF_REACTIONS);
+#else
+  // Start small so that the levels have to grow.
+  reaction_queue_t* q = reaction_queue_init(2);
+#endif
+  for (int round = 0; round < ROUNDS; round++) {
+    // Every fourth round has no deadlines at all. Otherwise, about a third of the reactions have one.
+    for (int i = 0; i < NUMBER_OF_REACTIONS; i++) {
+      // The index holds the deadline in the 48 most significant bits. All ones means no deadline.
+      index_t deadline = (round % 4 != 0 && rand() % 3 == 0) ? (index_t)MSEC(rand() % 10) : (ULLONG_MAX >> 16);
+      reactions[i].index = (deadline << 16) | (index_t)(rand() % MAX_LEVEL);
+      reactions[i].status = inactive;
+    }
+    // Insert some, pop a few, insert the rest, as a reaction triggering downstream reactions would.
+    size_t inserted = 0;
+    for (int i = 0; i < NUMBER_OF_REACTIONS / 2; i++) {
+      reaction_queue_insert(q, &reactions[i]);
+      reactions[i].status = queued;
+      inserted++;
+    }
+    for (int i = 0; i < 10; i++) {
+      reaction_queue_pop(q)->status = inactive;
+      inserted--;
+    }
+    for (int i = NUMBER_OF_REACTIONS / 2; i < NUMBER_OF_REACTIONS; i++) {
+      reaction_queue_insert(q, &reactions[i]);
+      reactions[i].status = queued;
+      inserted++;
+    }
+    check_drain(q, inserted);
+  }
+  reaction_queue_free(q);
+  return 0;
+}
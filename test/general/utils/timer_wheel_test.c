@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include "low_level_platform.h"
+#include "timer_wheel.h"
+#include "util.h"
+
+#define NUMBER_OF_ENTRIES 500
+#define ROUNDS 20
+#define RANDOM_SEED 1614
+
+static timer_wheel_entry_t entries[NUMBER_OF_ENTRIES];
+
+/** @brief Return a random expiration after `now`, at one of several scales. */
+static instant_t random_expiration(instant_t now) {
+  switch (rand() % 4) {
+  case 0:
+    return now + rand() % USEC(100);
+  case 1:
+    return now + rand() % MSEC(50);
+  case 2:
+    return now + (instant_t)(rand() % 1000) * MSEC(100);
+  default:
+    return now + (instant_t)(rand() % 1000) * HOURS(1);
+  }
+}
+
+/**
+ * @brief Schedule, reschedule, and remove random entries, then advance a simulated clock from
+ * wakeup to wakeup, checking that every entry pops exactly at its expiration.
+ */
+static void test_round(timer_wheel_t* wheel, instant_t now) {
+  for (int i = 0; i < NUMBER_OF_ENTRIES; i++) {
+    timer_wheel_insert(wheel, &entries[i], random_expiration(now));
+  }
+  int remaining = NUMBER_OF_ENTRIES;
+  for (int i = 0; i < NUMBER_OF_ENTRIES; i++) {
+    switch (rand() % 3) {
+    case 0:
+      timer_wheel_insert(wheel, &entries[i], random_expiration(now));
+      break;
+    case 1:
+      timer_wheel_remove(wheel, &entries[i]);
+      remaining--;
+      break;
+    }
+  }
+  if ((int)wheel->size != remaining) {
+    lf_print_error_and_exit("Expected %d entries but the wheel has %zu.", remaining, wheel->size);
+  }
+  while (remaining > 0) {
+    instant_t wakeup = timer_wheel_next_wakeup(wheel);
+    if (wakeup == FOREVER) {
+      lf_print_error_and_exit("The wheel has %d entries but no wakeup.", remaining);
+    }
+    if (wakeup > now) {
+      now = wakeup;
+    }
+    timer_wheel_entry_t* entry;
+    while ((entry = timer_wheel_pop(wheel, now)) != NULL) {
+      if (entry->expiration != now) {
+        lf_print_error_and_exit("Entry expiring at " PRINTF_TIME " popped at " PRINTF_TIME ".", entry->expiration, now);
+      }
+      if (entry->scheduled) {
+        lf_print_error_and_exit("A popped entry is still scheduled.");
+      }
+      remaining--;
+    }
+  }
+  if (wheel->size != 0 || timer_wheel_next_wakeup(wheel) != FOREVER) {
+    lf_print_error_and_exit("The wheel is not empty.");
+  }
+}
+
+int main() {
+  srand(RANDOM_SEED);
+  timer_wheel_t wheel;
+  timer_wheel_init(&wheel, SEC(1));
+  for (int i = 0; i < ROUNDS; i++) {
+    test_round(&wheel, SEC(1) + (instant_t)i * HOURS(2000));
+  }
+  return 0;
+}
@@ -108,6 +108,48 @@ int run_test(vector_t* v, int* distribution) {
   return result;
 }
 
+/**
+ * @brief Check that a vector with a buffer uses it until it grows beyond it,
+ * returns to it when it shrinks, and keeps its memory when cleared.
+ */
+void test_buffer() {
+  void* buffer[4];
+  vector_t v;
+  vector_init_with_buffer(&v, buffer, 4);
+  for (int i = 0; i < 4; i++) {
+    vector_push(&v, mock + i);
+  }
+  if (v.start != buffer || VECTOR_GET(&v, 3, void**) != mock + 3) {
+    lf_print_error_and_exit("Expected the elements of a small vector in its buffer.");
+  }
+  vector_push(&v, mock + 4);
+  if (v.start == buffer || vector_size(&v) != 5 || VECTOR_GET(&v, 0, void**) != mock) {
+    lf_print_error_and_exit("Expected a vector to move out of its buffer when it grows.");
+  }
+  VECTOR_SET(&v, 1, mock + 10);
+  if (*vector_at(&v, 1) != mock + 10) {
+    lf_print_error_and_exit("Expected VECTOR_SET to set the element that vector_at returns.");
+  }
+
+  void** start = v.start;
+  vector_clear(&v);
+  if (vector_size(&v) != 0 || v.start != start) {
+    lf_print_error_and_exit("Expected clearing a vector to keep its memory.");
+  }
+
+  // Vote for shrinking until the vector is back in its buffer.
+  for (int i = 0; i < 100 && v.start != buffer; i++) {
+    vector_push(&v, mock);
+    vector_vote(&v);
+    vector_pop(&v);
+    vector_pop(&v);
+  }
+  if (v.start != buffer || v.end != buffer + 4) {
+    lf_print_error_and_exit("Expected a vector to shrink back into its buffer, and not below it.");
+  }
+  vector_free(&v);
+}
+
 int main() {
   srand(RANDOM_SEED);
   for (int i = 0; i < N; i++) {
@@ -124,5 +166,20 @@ int main() {
     }
     vector_free(&v);
   }
+  test_buffer();
+  // The same random operations on vectors that start in a buffer of their owner.
+  void* buffer[CAPACITY];
+  for (int i = 0; i < N; i++) {
+    int perturbed[4];
+    perturb(distribution, 4, perturbed);
+    vector_t v;
+    vector_init_with_buffer(&v, buffer, rand() % CAPACITY + 1);
+    mock_size = 0;
+    int j = 0;
+    while (j < CAPACITY) {
+      j += run_test(&v, perturbed);
+    }
+    vector_free(&v);
+  }
   return 0;
 }
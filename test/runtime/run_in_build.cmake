@@ -0,0 +1,49 @@
+# Configure the runtime in LF_ROOT with the options OPTIONS in the build directory BUILD_DIR, build the target TEST
+# there and run it with the arguments ARGS. With RECORD, the test is then run again with --record RECORD and then with
+# --replay RECORD and ARGS, and the lines about arrivals that the two runs print must be the same.
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -S ${LF_ROOT} -B ${BUILD_DIR} -DCMAKE_BUILD_TYPE=Debug ${OPTIONS}
+    RESULT_VARIABLE RESULT
+)
+if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "Configuring ${BUILD_DIR} with ${OPTIONS} failed.")
+endif()
+execute_process(COMMAND ${CMAKE_COMMAND} --build ${BUILD_DIR} --target ${TEST} RESULT_VARIABLE RESULT)
+if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "Building ${TEST} in ${BUILD_DIR} failed.")
+endif()
+execute_process(COMMAND ${BUILD_DIR}/${TEST} ${ARGS} RESULT_VARIABLE RESULT)
+if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "${TEST} failed with ${OPTIONS}.")
+endif()
+
+if(DEFINED RECORD)
+    # The recorded run waits for physical time, so that the events of physical actions are staged after their tags.
+    execute_process(
+        COMMAND ${BUILD_DIR}/${TEST} --record ${RECORD}
+        OUTPUT_VARIABLE RECORDED
+        RESULT_VARIABLE RESULT
+    )
+    if(NOT RESULT EQUAL 0)
+        message(FATAL_ERROR "${TEST} failed with --record ${RECORD}:\n${RECORDED}")
+    endif()
+    execute_process(
+        COMMAND ${BUILD_DIR}/${TEST} --replay ${RECORD} ${ARGS}
+        OUTPUT_VARIABLE REPLAYED
+        RESULT_VARIABLE RESULT
+    )
+    if(NOT RESULT EQUAL 0)
+        message(FATAL_ERROR "${TEST} failed with --replay ${RECORD}:\n${REPLAYED}")
+    endif()
+    string(REGEX MATCHALL "arrival [^\n]*" RECORDED_ARRIVALS "${RECORDED}")
+    string(REGEX MATCHALL "arrival [^\n]*" REPLAYED_ARRIVALS "${REPLAYED}")
+    if(NOT RECORDED_ARRIVALS)
+        message(FATAL_ERROR "${TEST} printed no arrivals with --record ${RECORD}:\n${RECORDED}")
+    endif()
+    if(NOT RECORDED_ARRIVALS STREQUAL REPLAYED_ARRIVALS)
+        message(FATAL_ERROR "The replay differs from the recording.\nRecorded: ${RECORDED_ARRIVALS}\n"
+                            "Replayed: ${REPLAYED_ARRIVALS}")
+    endif()
+    list(LENGTH RECORDED_ARRIVALS COUNT)
+    message(STATUS "Replayed the ${COUNT} recorded arrivals.")
+endif()
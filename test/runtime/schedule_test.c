@@ -0,0 +1,254 @@
+/**
+ * @file schedule_test.c
+ * @brief End-to-end test of the scheduling of actions through the functions of lib/schedule.c.
+ *
+ * The program builds its reaction graph as the generated code would (see benchmark.h). A clock
+ * reactor has two reactions at the levels 0 and 1, triggered by a timer with period PERIOD. A
+ * source reactor has a timer with the same period and an offset of half of it, whose reaction
+ * schedules a logical action with a delay of DELAY and a physical action, both with the number
+ * of the firing, with lf_schedule_int(). The reactions of the actions check their tags and
+ * values. The program runs for TICKS periods. With LF_LATENCY, the reaction of the physical
+ * action records the latency of its chain, which must have a sample for each event. With
+ * LF_RECORD_REPLAY, it prints the value and tag of each event of the physical action, which a
+ * run given `--replay` with the log of a run given `--record` must print as well (see
+ * run_in_build.cmake). With LF_TAG_PIPELINING, the clock and the source are independent, so the
+ * source fires at the next tag while the second reaction of the clock is pending at the current
+ * one, and the actions that it schedules then must get tags after the one it runs at (see
+ * pipeline.h).
+ *
+ * The functions of lib/schedule.c are compiled separately from the runtime, so this is built and
+ * run with the options that change what they do, such as LF_CALENDAR_QUEUE, which changes the
+ * layout of events (see Tests.cmake).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/schedule.h"
+#define BENCHMARK_GENERATED_CODE
+#include "benchmark.h"
+#include "reactor.h"
+#include "reactor_common.h"
+#include "util.h"
+#ifdef LF_LATENCY
+#include "latency.h"
+#endif
+#if !defined(LF_SINGLE_THREADED)
+#include "scheduler.h"
+#endif
+#ifdef LF_TAG_PIPELINING
+#include "pipeline.h"
+#endif
+
+#define PERIOD MSEC(1)
+#define DELAY (PERIOD / 4)
+#define TICKS 20
+
+/** Upper bits of the index of reactions without a deadline. */
+#define NO_DEADLINE_INDEX 0xFFFFFFFFFFFFULL
+
+/** A reactor with a timer and up to three reactions, and, for the source, the actions. */
+typedef struct {
+  self_base_t base;
+  reaction_t reactions[3];
+  reaction_t* reaction_pointers[3];
+  trigger_t timer;
+  lf_action_base_t delayed;
+  trigger_t delayed_trigger;
+  lf_action_base_t arrival;
+  trigger_t arrival_trigger;
+} test_reactor_t;
+
+static test_reactor_t* clock_reactor;
+static test_reactor_t* source;
+
+// The reactions are counted here rather than in the reactors, which are freed at termination.
+static int clock_ticks;
+static int firings;
+static int delayed_count;
+static int arrival_count;
+#ifdef LF_LATENCY
+static int latency_samples;
+#endif
+#ifdef LF_TAG_PIPELINING
+static int firings_ahead; // The firings at a tag later than the current tag of the environment.
+#endif
+static tag_t scheduled_tags[TICKS]; // The tags at which the source scheduled the actions.
+
+////////////////// Reactions
+
+/** Return the value of an action that is present. */
+static int value_of(trigger_t* trigger) {
+  lf_token_t* token = trigger->tmplt.token;
+  if (token == NULL || token->value == NULL) {
+    lf_print_error_and_exit("An action is present without a value.");
+  }
+  return *(int*)token->value;
+}
+
+static void tick(void* self) {
+  (void)self;
+  clock_ticks++;
+}
+
+static void tock(void* self) { (void)self; }
+
+static void fire(void* self) {
+  test_reactor_t* reactor = (test_reactor_t*)self;
+  if (firings >= TICKS) {
+    lf_print_error_and_exit("The source fired more than %d times.", TICKS);
+  }
+  scheduled_tags[firings] = lf_tag(&env);
+#ifdef LF_TAG_PIPELINING
+  if (lf_tag_compare(scheduled_tags[firings], env.current_tag) > 0) {
+    firings_ahead++;
+  }
+#endif
+  lf_schedule_int(&reactor->delayed, DELAY, firings);
+  lf_schedule_int(&reactor->arrival, 0, firings);
+  firings++;
+}
+
+static void on_delayed(void* self) {
+  test_reactor_t* reactor = (test_reactor_t*)self;
+  int value = value_of(&reactor->delayed_trigger);
+  if (value != delayed_count) {
+    lf_print_error_and_exit("The logical action has the value %d instead of %d.", value, delayed_count);
+  }
+  tag_t expected = lf_delay_tag(scheduled_tags[value], DELAY);
+  if (lf_tag_compare(lf_tag(&env), expected) != 0) {
+    lf_print_error_and_exit("The logical action %d is present at " PRINTF_TAG " instead of " PRINTF_TAG ".", value,
+                            lf_tag(&env).time - lf_time_start(), lf_tag(&env).microstep,
+                            expected.time - lf_time_start(), expected.microstep);
+  }
+  delayed_count++;
+}
+
+static void on_arrival(void* self) {
+  test_reactor_t* reactor = (test_reactor_t*)self;
+  int value = value_of(&reactor->arrival_trigger);
+  if (value != arrival_count) {
+    lf_print_error_and_exit("The physical action has the value %d instead of %d.", value, arrival_count);
+  }
+  if (lf_tag_compare(lf_tag(&env), scheduled_tags[value]) <= 0) {
+    lf_print_error_and_exit("The physical action %d is present at " PRINTF_TAG ", not after it was scheduled.", value,
+                            lf_tag(&env).time - lf_time_start(), lf_tag(&env).microstep);
+  }
+#ifdef LF_LATENCY
+  // The origin of the tag is the time at which the physical action was scheduled.
+  if (lf_latency_record(self, "arrival") == NEVER) {
+    lf_print_error_and_exit("The physical action %d has no origin.", value);
+  }
+  latency_samples++;
+#endif
+#ifdef LF_RECORD_REPLAY
+  printf("arrival %d at " PRINTF_TAG "\n", value, lf_tag(&env).time - lf_time_start(), lf_tag(&env).microstep);
+#endif
+  arrival_count++;
+}
+
+////////////////// Reaction graph
+
+/** Make reaction `i` of a reactor, at `level`. */
+static void init_reaction(test_reactor_t* reactor, int i, reaction_function_t function, const char* name, int level) {
+  reaction_t* reaction = &reactor->reactions[i];
+  reactor->reaction_pointers[i] = reaction;
+  reaction->function = function;
+  reaction->self = reactor;
+  reaction->name = name;
+  reaction->deadline = NEVER;
+  reaction->index = (NO_DEADLINE_INDEX << 16) | (index_t)level;
+}
+
+/** Make the timer of a reactor, which triggers its first `count` reactions. */
+static void init_timer(test_reactor_t* reactor, interval_t offset, int count, int i) {
+  reactor->timer.is_timer = true;
+  reactor->timer.offset = offset;
+  reactor->timer.period = PERIOD;
+  reactor->timer.last_tag = NEVER_TAG;
+  reactor->timer.reactions = reactor->reaction_pointers;
+  reactor->timer.number_of_reactions = count;
+  env.timer_triggers[i] = &reactor->timer;
+}
+
+/** Make an action of integers of a reactor, which triggers its reaction `i`. */
+static void init_action(test_reactor_t* reactor, lf_action_base_t* action, trigger_t* trigger, bool physical, int i) {
+  _lf_initialize_template((token_template_t*)trigger, sizeof(int));
+  trigger->reactions = &reactor->reaction_pointers[i];
+  trigger->number_of_reactions = 1;
+  trigger->last_tag = NEVER_TAG;
+  trigger->is_physical = physical;
+  _lf_initialize_template((token_template_t*)action, sizeof(int));
+  action->trigger = trigger;
+  action->parent = &reactor->base;
+}
+
+void lf_create_environments(void) {
+#if defined(LF_SINGLE_THREADED)
+  int workers = 1;
+#else
+  int workers = (int)_lf_number_of_workers;
+#endif
+  environment_init(&env, "main", 0, workers, 2, 0, 0, 0, 0, 0, 0, 0, NULL);
+}
+
+void _lf_initialize_trigger_objects(void) {
+  clock_reactor = (test_reactor_t*)lf_new_reactor(sizeof(test_reactor_t));
+  clock_reactor->base.environment = &env;
+  init_reaction(clock_reactor, 0, tick, "tick", 0);
+  init_reaction(clock_reactor, 1, tock, "tock", 1);
+  init_timer(clock_reactor, 0, 2, 0);
+
+  source = (test_reactor_t*)lf_new_reactor(sizeof(test_reactor_t));
+  source->base.environment = &env;
+  init_reaction(source, 0, fire, "fire", 0);
+  init_reaction(source, 1, on_delayed, "on_delayed", 1);
+  init_reaction(source, 2, on_arrival, "on_arrival", 2);
+  init_timer(source, PERIOD / 2, 1, 1);
+  init_action(source, &source->delayed, &source->delayed_trigger, false, 1);
+  init_action(source, &source->arrival, &source->arrival_trigger, true, 2);
+
+#if !defined(LF_SINGLE_THREADED)
+  size_t num_reactions_per_level[] = {2, 2, 1};
+  sched_params_t params = {.num_reactions_per_level = num_reactions_per_level, .num_reactions_per_level_size = 3};
+  lf_sched_init(&env, env.num_workers, &params);
+#endif
+}
+
+////////////////// Main
+
+int main(int argc, const char* argv[]) {
+  // The program runs for TICKS periods. Other arguments, such as -f true, are passed to the runtime.
+  const char** runtime_argv = (const char**)calloc(argc + 3, sizeof(char*));
+  LF_ASSERT_NON_NULL(runtime_argv);
+  char timeout[16];
+  snprintf(timeout, sizeof(timeout), "%d", TICKS);
+  runtime_argv[0] = argv[0];
+  runtime_argv[1] = "-o";
+  runtime_argv[2] = timeout;
+  runtime_argv[3] = "msec";
+  for (int i = 1; i < argc; i++) {
+    runtime_argv[3 + i] = argv[i];
+  }
+  int result = lf_reactor_c_main(argc + 3, runtime_argv);
+  free(runtime_argv);
+  if (result != 0) {
+    return result;
+  }
+  if (clock_ticks != TICKS + 1 || firings != TICKS || delayed_count != TICKS || arrival_count != TICKS) {
+    lf_print_error_and_exit("Got %d ticks, %d firings, %d logical and %d physical actions, not %d and %d of each.",
+                            clock_ticks, firings, delayed_count, arrival_count, TICKS + 1, TICKS);
+  }
+#ifdef LF_TAG_PIPELINING
+  if (firings_ahead == 0) {
+    lf_print_error_and_exit("The source never fired ahead of the clock.");
+  }
+#endif
+#ifdef LF_LATENCY
+  if (latency_samples != TICKS) {
+    lf_print_error_and_exit("Got %d latency samples instead of %d.", latency_samples, TICKS);
+  }
+#endif
+  return 0;
+}
@@ -5,6 +5,7 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -80,6 +81,17 @@ void lf_tracing_set_start_time(int64_t start_time);
  * @brief Submit a tracepoint from the given worker to the tracing module.
  */
 void lf_tracing_tracepoint(int worker, trace_record_nodeps_t* tr);
+/**
+ * @brief Ask the tracing module to write out the records that it keeps in memory rather than
+ * writing them all, such as the records of the default implementation in flight-recorder mode.
+ * Modules that write all records may do nothing.
+ */
+void lf_tracing_dump();
+/**
+ * @brief Return the number of bytes of memory that the tracing module holds for records, such as
+ * its buffers, for the accounting of the memory of the runtime.
+ */
+size_t lf_tracing_memory_size();
 /**
  * @brief Shut down the tracing module. Calling other API functions after
  * calling this procedure is undefined behavior.
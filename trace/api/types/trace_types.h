@@ -26,6 +26,8 @@ typedef enum {
   worker_wait_ends,
   scheduler_advancing_time_starts,
   scheduler_advancing_time_ends,
+  mutex_wait_starts,
+  mutex_wait_ends,
   federated, // Everything below this is for tracing federated interactions.
   // Sending messages
   send_ACK,
@@ -89,6 +91,8 @@ static const char* trace_event_names[] = {
     "Worker wait ends",
     "Scheduler advancing time starts",
     "Scheduler advancing time ends",
+    "Mutex wait starts",
+    "Mutex wait ends",
     "Federated marker",
     // Sending messages
     "Sending ACK",
@@ -0,0 +1,97 @@
+/**
+ * @file
+ * @brief Compressed chunks of trace records and the index at the end of a trace file.
+ *
+ * Each buffer of records that is flushed to the trace file is written as one chunk, and
+ * each buffer holds the records of one thread. A record starts with a byte whose bits tell
+ * which fields differ from the same field of the previous record of the chunk, followed by
+ * the event type and those fields as varints, so that fields an event does not use, such as
+ * the pointer and trigger of worker_wait_starts, usually take no space. Times and microsteps
+ * are stored as zigzag-encoded differences from the previous record, which for the physical
+ * time is the previous record of the same thread. Pointers and triggers are stored as small
+ * IDs of a dictionary of the chunk, to which a value that is not yet in it is added by
+ * storing it in full once. A record usually takes a few bytes instead of
+ * sizeof(trace_record_nodeps_t). Chunks are decoded independently.
+ *
+ * After the object table, a trace file is a sequence of chunks, each of which is
+ * TRACE_COMPACT_CHUNK_MARKER (int), a trace_chunk_header_t, and the payload. When tracing stops,
+ * the index is appended, which is TRACE_INDEX_MARKER (int), the number of entries (int64_t),
+ * the entries (trace_chunk_entry_t), the offset of TRACE_INDEX_MARKER (int64_t), and
+ * TRACE_INDEX_MAGIC. A file without an index, for example because the program crashed,
+ * can still be read chunk by chunk.
+ *
+ * Files written by earlier versions have chunks marked by TRACE_CHUNK_MARKER, in which
+ * every field of every record is stored as a varint, or, before chunks were introduced, the
+ * number of records (a positive int) in place of the marker, followed by the uncompressed
+ * records.
+ */
+
+#ifndef TRACE_CHUNK_H
+#define TRACE_CHUNK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "trace.h"
+
+/** Marker of a compressed chunk. */
+#define TRACE_CHUNK_MARKER -1
+
+/** Marker of the index, which follows the last chunk. */
+#define TRACE_INDEX_MARKER -2
+
+/** Marker of a compressed chunk whose records omit unchanged fields. */
+#define TRACE_COMPACT_CHUNK_MARKER -3
+
+/** The last bytes of a file that has an index. */
+#define TRACE_INDEX_MAGIC "LFTINDEX"
+#define TRACE_INDEX_MAGIC_SIZE 8
+
+/**
+ * Upper bound on the size of an encoded record: the byte of changed fields and nine varints
+ * of at most ten bytes, two of which can be followed by a value added to the dictionary.
+ */
+#define TRACE_CHUNK_MAX_RECORD_SIZE 111
+
+/** Number of pointers and triggers that the dictionary of a chunk holds. Later values are stored in full. */
+#define TRACE_CHUNK_DICTIONARY_SIZE 256
+
+/** @brief The header of a chunk. */
+typedef struct trace_chunk_header_t {
+  uint32_t number_of_records; // Number of records in the chunk.
+  uint32_t payload_size;      // Size in bytes of the encoded records that follow the header.
+  int64_t min_logical_time;   // Smallest logical time of a record in the chunk.
+  int64_t max_logical_time;   // Largest logical time of a record in the chunk.
+} trace_chunk_header_t;
+
+/** @brief An entry of the index, which locates one chunk. */
+typedef struct trace_chunk_entry_t {
+  int64_t offset;           // Offset in the file of the marker of the chunk.
+  int64_t min_logical_time; // Smallest logical time of a record in the chunk.
+  int64_t max_logical_time; // Largest logical time of a record in the chunk.
+} trace_chunk_entry_t;
+
+/**
+ * @brief Encode records into a chunk to be marked by TRACE_COMPACT_CHUNK_MARKER.
+ * @param records The records.
+ * @param size The number of records.
+ * @param header The header to fill in.
+ * @param payload Where to put the encoded records, which must have room for
+ * size * TRACE_CHUNK_MAX_RECORD_SIZE bytes.
+ */
+void trace_chunk_encode(const trace_record_nodeps_t* records, size_t size, trace_chunk_header_t* header,
+                        uint8_t* payload);
+
+/**
+ * @brief Decode the records of a chunk.
+ * @param marker The marker of the chunk, TRACE_COMPACT_CHUNK_MARKER or TRACE_CHUNK_MARKER.
+ * @param header The header of the chunk.
+ * @param payload The encoded records.
+ * @param records Where to put the records, which must have room for header->number_of_records.
+ * @return false if the payload is garbled.
+ */
+bool trace_chunk_decode(int marker, const trace_chunk_header_t* header, const uint8_t* payload,
+                        trace_record_nodeps_t* records);
+
+#endif // TRACE_CHUNK_H
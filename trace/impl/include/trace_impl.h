@@ -1,4 +1,6 @@
 #include "trace.h"
+#include "platform.h"
+#include "trace_chunk.h"
 
 // FIXME: Target property should specify the capacity of the trace buffer.
 #define TRACE_BUFFER_CAPACITY 2048
@@ -9,8 +11,38 @@
 /** Max length of trace file name*/
 #define TRACE_MAX_FILENAME_LENGTH 128
 
+/** Capacity of the ring of records from threads not created by LF. Must be a power of two. */
+#define TRACE_USER_RING_CAPACITY 4096
+
+#ifdef LF_TRACE_FLIGHT_RECORDER
+/**
+ * Number of records that each thread keeps in flight-recorder mode. Must be a power of two.
+ * LF_TRACE_FLIGHT_RECORDER itself is the length in nanoseconds of the window of records that
+ * is written when a dump is triggered, or 0 to write all the records kept.
+ */
+#ifndef LF_TRACE_FLIGHT_RECORDER_CAPACITY
+#define LF_TRACE_FLIGHT_RECORDER_CAPACITY 16384
+#endif
+#endif // LF_TRACE_FLIGHT_RECORDER
+
 // TYPE DEFINITIONS **********************************************************
 
+/**
+ * @brief A slot of the ring of records from threads not created by LF.
+ * The slot at position p holds a record if its sequence is p + 1, and is free for
+ * position p if its sequence is p.
+ */
+typedef struct trace_ring_slot_t {
+  size_t sequence;
+  trace_record_nodeps_t record;
+} trace_ring_slot_t;
+
+/** @brief A full buffer waiting for the writer thread. */
+typedef struct trace_pending_buffer_t {
+  trace_record_nodeps_t* records;
+  size_t size;
+} trace_pending_buffer_t;
+
 /**
  * @brief This struct holds all the state associated with tracing in a single environment.
  * Each environment which has tracing enabled will have such a struct on its environment struct.
@@ -25,6 +57,49 @@ typedef struct trace_t {
   trace_record_nodeps_t** _lf_trace_buffer;
   size_t* _lf_trace_buffer_size;
 
+  /**
+   * In flight-recorder mode, the buffers are rings of LF_TRACE_FLIGHT_RECORDER_CAPACITY records that are
+   * only written to the file when a dump is triggered. Then _lf_trace_buffer_size counts the records written
+   * to each ring so far, and _lf_trace_dumped counts those that are in the file or too old to be.
+   */
+  size_t* _lf_trace_dumped;
+  trace_record_nodeps_t* _lf_trace_dump_scratch; // Records being copied from a ring to the file.
+
+  /**
+   * Bounded ring into which threads not created by LF write their records without locking.
+   * It is drained into the buffer at index -1 by whichever thread next flushes a buffer.
+   */
+  trace_ring_slot_t* _lf_trace_user_ring;
+  size_t _lf_trace_user_ring_head; // Position of the next record to drain. Only accessed with the mutex held.
+  size_t _lf_trace_user_ring_tail; // Position of the next record to write.
+
+  /**
+   * Thread that writes full buffers to the file so that the threads that fill them do not
+   * wait for the disk. NULL if the platform does not support threads, in which case
+   * buffers are written by the threads that fill them.
+   */
+  lf_platform_thread_ptr_t _lf_trace_writer;
+  lf_platform_cond_ptr_t _lf_trace_writer_cond; // Signaled when a buffer is pending or the writer should stop.
+  lf_platform_cond_ptr_t _lf_trace_free_cond;   // Signaled when a buffer is freed or the writer has stopped.
+  bool _lf_trace_writer_running;                // Whether full buffers are handed to the writer thread.
+  bool _lf_trace_writer_stop;                   // Whether the writer should return once nothing is pending.
+
+  /** Buffers that can replace a full buffer handed to the writer thread. */
+  trace_record_nodeps_t** _lf_trace_free_buffers;
+  size_t _lf_trace_free_buffers_size;
+
+  /** Queue of full buffers waiting for the writer thread, in the order in which they were filled. */
+  trace_pending_buffer_t* _lf_trace_pending;
+  size_t _lf_trace_pending_head;
+  size_t _lf_trace_pending_size;
+  size_t _lf_trace_pending_capacity;
+
+  /** Number of records dropped because no free buffer was available (if LF_TRACE_DROP_WHEN_BEHIND is defined). */
+  size_t _lf_trace_dropped_records;
+
+  /** Number of times a thread waited for a free buffer (unless LF_TRACE_DROP_WHEN_BEHIND is defined). */
+  size_t _lf_trace_stalls;
+
   /** The number of trace buffers allocated when tracing starts. */
   size_t _lf_number_of_trace_buffers;
 
@@ -34,6 +109,19 @@ typedef struct trace_t {
   /** The file into which traces are written. */
   FILE* _lf_trace_file;
 
+  /**
+   * State of the file, which is only accessed by the writer thread while it is running
+   * and otherwise with the trace mutex held.
+   */
+  int64_t _lf_trace_file_offset;         // Offset at which the next chunk is written.
+  uint8_t* _lf_trace_chunk_payload;      // The encoded records of the chunk being written.
+  trace_chunk_entry_t* _lf_trace_index;  // The chunks written so far, or NULL if memory ran out.
+  size_t _lf_trace_index_size;           // The number of entries in the index.
+  size_t _lf_trace_index_capacity;       // The number of entries allocated.
+
+  /** Number of bytes allocated for the buffers and the index. See lf_tracing_memory_size(). */
+  size_t _lf_trace_memory_size;
+
   /** The file name where the traces are written*/
   char filename[TRACE_MAX_FILENAME_LENGTH];
 
@@ -0,0 +1,232 @@
+/**
+ * @file
+ * @brief Compressed chunks of trace records.
+ *
+ * See trace_chunk.h.
+ */
+
+#include <string.h>
+
+#include "trace_chunk.h"
+
+/** @brief Map a signed difference to an unsigned value that is small if the difference is small. */
+static uint64_t zigzag(uint64_t difference) { return (difference << 1) ^ (uint64_t)((int64_t)difference >> 63); }
+
+static uint64_t unzigzag(uint64_t value) { return (value >> 1) ^ (~(value & 1) + 1); }
+
+/** @brief Write a varint to `out` and return the number of bytes written. */
+static size_t put_varint(uint8_t* out, uint64_t value) {
+  size_t n = 0;
+  while (value >= 0x80) {
+    out[n++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = (uint8_t)value;
+  return n;
+}
+
+/** @brief Read a varint at `*position`, which must be before `end`, and advance `*position`. */
+static bool get_varint(const uint8_t** position, const uint8_t* end, uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && *position < end; shift += 7) {
+    uint8_t byte = *(*position)++;
+    *value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/** @brief The fields of a record as unsigned integers, in the order in which they are encoded. */
+static void fields_of(const trace_record_nodeps_t* r, uint64_t fields[9]) {
+  fields[0] = (uint64_t)(int64_t)r->event_type;
+  fields[1] = (uint64_t)(uintptr_t)r->pointer;
+  fields[2] = (uint64_t)(int64_t)r->src_id;
+  fields[3] = (uint64_t)(int64_t)r->dst_id;
+  fields[4] = (uint64_t)r->logical_time;
+  fields[5] = (uint64_t)r->microstep;
+  fields[6] = (uint64_t)r->physical_time;
+  fields[7] = (uint64_t)(uintptr_t)r->trigger;
+  fields[8] = (uint64_t)r->extra_delay;
+}
+
+/** Whether the field is stored as the difference from the same field of the previous record. */
+static const bool delta_coded[9] = {false, true, false, false, true, true, true, true, false};
+
+/** @brief How a field of a compact record is stored. */
+typedef enum { VALUE, DIFFERENCE, DICTIONARY } compact_coding_t;
+
+/** How each field of a compact record other than the event type is stored. */
+static const compact_coding_t compact_coding[9] = {VALUE,      DICTIONARY, VALUE,      VALUE,
+                                                   DIFFERENCE, DIFFERENCE, DIFFERENCE, DICTIONARY, VALUE};
+
+/** Number of slots of the hash table that finds the IDs of the dictionary while encoding. */
+#define DICTIONARY_TABLE_SIZE (2 * TRACE_CHUNK_DICTIONARY_SIZE)
+
+/** @brief The dictionary of pointers and triggers of a chunk that is being encoded. */
+typedef struct dictionary_t {
+  uint64_t values[DICTIONARY_TABLE_SIZE];
+  uint16_t ids[DICTIONARY_TABLE_SIZE]; // One more than the ID of the value in the slot, or 0 if the slot is free.
+  size_t size;
+} dictionary_t;
+
+/**
+ * @brief Write the ID of a pointer or trigger, followed by the value if it is not in the
+ * dictionary yet, and return the number of bytes written.
+ */
+static size_t put_id(uint8_t* out, dictionary_t* dictionary, uint64_t value) {
+  size_t slot = (size_t)((value * 0x9E3779B97F4A7C15ULL) >> 32) & (DICTIONARY_TABLE_SIZE - 1);
+  while (dictionary->ids[slot] != 0) {
+    if (dictionary->values[slot] == value) {
+      return put_varint(out, dictionary->ids[slot] - 1);
+    }
+    slot = (slot + 1) & (DICTIONARY_TABLE_SIZE - 1);
+  }
+  size_t n = put_varint(out, dictionary->size);
+  n += put_varint(out + n, value);
+  if (dictionary->size < TRACE_CHUNK_DICTIONARY_SIZE) {
+    dictionary->values[slot] = value;
+    dictionary->ids[slot] = (uint16_t)++dictionary->size;
+  }
+  return n;
+}
+
+void trace_chunk_encode(const trace_record_nodeps_t* records, size_t size, trace_chunk_header_t* header,
+                        uint8_t* payload) {
+  dictionary_t dictionary;
+  memset(dictionary.ids, 0, sizeof(dictionary.ids));
+  dictionary.size = 0;
+  uint64_t previous[9] = {0};
+  size_t n = 0;
+  header->number_of_records = (uint32_t)size;
+  header->min_logical_time = size > 0 ? records[0].logical_time : 0;
+  header->max_logical_time = header->min_logical_time;
+  for (size_t i = 0; i < size; i++) {
+    uint64_t fields[9];
+    fields_of(&records[i], fields);
+    // The byte of changed fields goes first, so it is filled in last.
+    uint8_t* changed = &payload[n++];
+    *changed = 0;
+    n += put_varint(payload + n, zigzag(fields[0]));
+    for (int f = 1; f < 9; f++) {
+      if (fields[f] == previous[f]) {
+        continue;
+      }
+      *changed |= (uint8_t)(1 << (f - 1));
+      switch (compact_coding[f]) {
+      case VALUE:
+        n += put_varint(payload + n, zigzag(fields[f]));
+        break;
+      case DIFFERENCE:
+        n += put_varint(payload + n, zigzag(fields[f] - previous[f]));
+        break;
+      case DICTIONARY:
+        n += put_id(payload + n, &dictionary, fields[f]);
+        break;
+      }
+      previous[f] = fields[f];
+    }
+    if (records[i].logical_time < header->min_logical_time) {
+      header->min_logical_time = records[i].logical_time;
+    }
+    if (records[i].logical_time > header->max_logical_time) {
+      header->max_logical_time = records[i].logical_time;
+    }
+  }
+  header->payload_size = (uint32_t)n;
+}
+
+/** @brief Set a record from its fields as unsigned integers. */
+static void set_fields(trace_record_nodeps_t* r, const uint64_t fields[9]) {
+  r->event_type = (int)(int64_t)fields[0];
+  r->pointer = (void*)(uintptr_t)fields[1];
+  r->src_id = (int)(int64_t)fields[2];
+  r->dst_id = (int)(int64_t)fields[3];
+  r->logical_time = (int64_t)fields[4];
+  r->microstep = (int64_t)fields[5];
+  r->physical_time = (int64_t)fields[6];
+  r->trigger = (void*)(uintptr_t)fields[7];
+  r->extra_delay = (int64_t)fields[8];
+}
+
+/** @brief Decode the records of a chunk marked by TRACE_CHUNK_MARKER. */
+static bool decode_full(const trace_chunk_header_t* header, const uint8_t* payload, trace_record_nodeps_t* records) {
+  const uint8_t* position = payload;
+  const uint8_t* end = payload + header->payload_size;
+  uint64_t previous[9] = {0};
+  for (uint32_t i = 0; i < header->number_of_records; i++) {
+    uint64_t fields[9];
+    for (int f = 0; f < 9; f++) {
+      uint64_t value;
+      if (!get_varint(&position, end, &value)) {
+        return false;
+      }
+      fields[f] = delta_coded[f] ? previous[f] + unzigzag(value) : unzigzag(value);
+      previous[f] = fields[f];
+    }
+    set_fields(&records[i], fields);
+  }
+  return position == end;
+}
+
+/** @brief Decode the records of a chunk marked by TRACE_COMPACT_CHUNK_MARKER. */
+static bool decode_compact(const trace_chunk_header_t* header, const uint8_t* payload,
+                           trace_record_nodeps_t* records) {
+  const uint8_t* position = payload;
+  const uint8_t* end = payload + header->payload_size;
+  uint64_t dictionary[TRACE_CHUNK_DICTIONARY_SIZE];
+  size_t dictionary_size = 0;
+  uint64_t fields[9] = {0};
+  for (uint32_t i = 0; i < header->number_of_records; i++) {
+    if (position == end) {
+      return false;
+    }
+    uint8_t changed = *position++;
+    uint64_t value;
+    if (!get_varint(&position, end, &value)) {
+      return false;
+    }
+    fields[0] = unzigzag(value);
+    for (int f = 1; f < 9; f++) {
+      if (!(changed & (1 << (f - 1)))) {
+        continue;
+      }
+      if (!get_varint(&position, end, &value)) {
+        return false;
+      }
+      switch (compact_coding[f]) {
+      case VALUE:
+        fields[f] = unzigzag(value);
+        break;
+      case DIFFERENCE:
+        fields[f] += unzigzag(value);
+        break;
+      case DICTIONARY:
+        if (value < dictionary_size) {
+          fields[f] = dictionary[value];
+        } else if (value == dictionary_size || dictionary_size == TRACE_CHUNK_DICTIONARY_SIZE) {
+          if (!get_varint(&position, end, &fields[f])) {
+            return false;
+          }
+          if (dictionary_size < TRACE_CHUNK_DICTIONARY_SIZE) {
+            dictionary[dictionary_size++] = fields[f];
+          }
+        } else {
+          return false;
+        }
+        break;
+      }
+    }
+    set_fields(&records[i], fields);
+  }
+  return position == end;
+}
+
+bool trace_chunk_decode(int marker, const trace_chunk_header_t* header, const uint8_t* payload,
+                        trace_record_nodeps_t* records) {
+  if (marker == TRACE_COMPACT_CHUNK_MARKER) {
+    return decode_compact(header, payload, records);
+  }
+  return decode_full(header, payload, records);
+}
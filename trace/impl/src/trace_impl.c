@@ -3,8 +3,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <signal.h>
 
 #include "trace.h"
+#include "trace_types.h"
 #include "platform.h"
 #include "logging_macros.h"
 #include "trace_impl.h"
@@ -36,6 +38,23 @@ static version_t version = {.build_config =
                                 },
                             .core_version_name = NULL};
 
+#ifdef LF_TRACE_FLIGHT_RECORDER
+/** Capacity of the buffer of each thread, which is a ring in flight-recorder mode. */
+#define TRACE_THREAD_BUFFER_CAPACITY LF_TRACE_FLIGHT_RECORDER_CAPACITY
+
+/** Set when the process receives SIGUSR1. The next tracepoint then triggers a dump. */
+static volatile sig_atomic_t dump_requested = 0;
+
+#ifdef SIGUSR1
+static void request_dump(int signal_number) {
+  (void)signal_number;
+  dump_requested = 1;
+}
+#endif // SIGUSR1
+#else
+#define TRACE_THREAD_BUFFER_CAPACITY TRACE_BUFFER_CAPACITY
+#endif // LF_TRACE_FLIGHT_RECORDER
+
 // PRIVATE HELPERS ***********************************************************
 
 /**
@@ -73,9 +92,13 @@ static int write_trace_header(trace_t* trace) {
       if (items_written != 1)
         _LF_TRACE_FAILURE(trace);
 
-      // Write the description.
-      size_t description_size = strlen(trace->_lf_trace_object_descriptions[i].description);
-      items_written = fwrite(trace->_lf_trace_object_descriptions[i].description, sizeof(char),
+      // Write the description, which is empty if the runtime was built without names.
+      const char* description = trace->_lf_trace_object_descriptions[i].description;
+      if (description == NULL) {
+        description = "";
+      }
+      size_t description_size = strlen(description);
+      items_written = fwrite(description, sizeof(char),
                              description_size + 1, // Include null terminator.
                              trace->_lf_trace_file);
       if (items_written != description_size + 1)
@@ -85,44 +108,318 @@ static int write_trace_header(trace_t* trace) {
   return trace->_lf_trace_object_descriptions_size;
 }
 
+/**
+ * @brief Write the trace header if it has not been written yet.
+ * This is deferred to the first write so that user trace objects can be
+ * registered in startup reactions. This assumes the caller holds the trace mutex.
+ * @return false if the file is not available.
+ */
+static bool write_trace_header_once_locked(trace_t* trace) {
+  if (trace->_lf_trace_file != NULL && !trace->_lf_trace_header_written) {
+    if (write_trace_header(trace) < 0) {
+      lf_print_error("Failed to write trace header. Trace file will be incomplete.");
+      return false;
+    }
+    trace->_lf_trace_header_written = true;
+    // The header is small, so a long offset suffices. Later offsets are counted.
+    trace->_lf_trace_file_offset = (int64_t)ftell(trace->_lf_trace_file);
+  }
+  return trace->_lf_trace_file != NULL;
+}
+
+/**
+ * @brief Compress an array of records and write it to the file as a chunk.
+ * This assumes the caller owns the file, see trace_t.
+ * @return false if access to the file failed.
+ */
+static bool write_records(trace_t* trace, FILE* file, trace_record_nodeps_t* records, size_t size) {
+  trace_chunk_header_t header;
+  trace_chunk_encode(records, size, &header, trace->_lf_trace_chunk_payload);
+  int marker = TRACE_COMPACT_CHUNK_MARKER;
+  if (fwrite(&marker, sizeof(int), 1, file) != 1 || fwrite(&header, sizeof(header), 1, file) != 1 ||
+      fwrite(trace->_lf_trace_chunk_payload, 1, header.payload_size, file) != header.payload_size) {
+    return false;
+  }
+  if (trace->_lf_trace_index != NULL && trace->_lf_trace_index_size == trace->_lf_trace_index_capacity) {
+    trace->_lf_trace_index_capacity *= 2;
+    trace_chunk_entry_t* index = (trace_chunk_entry_t*)realloc(
+        trace->_lf_trace_index, sizeof(trace_chunk_entry_t) * trace->_lf_trace_index_capacity);
+    if (index == NULL) {
+      // Without an index, readers read the chunks one by one.
+      free(trace->_lf_trace_index);
+      trace->_lf_trace_memory_size -= sizeof(trace_chunk_entry_t) * trace->_lf_trace_index_capacity / 2;
+    } else {
+      trace->_lf_trace_memory_size += sizeof(trace_chunk_entry_t) * trace->_lf_trace_index_capacity / 2;
+    }
+    trace->_lf_trace_index = index;
+  }
+  if (trace->_lf_trace_index != NULL) {
+    trace->_lf_trace_index[trace->_lf_trace_index_size++] = (trace_chunk_entry_t){
+        .offset = trace->_lf_trace_file_offset,
+        .min_logical_time = header.min_logical_time,
+        .max_logical_time = header.max_logical_time,
+    };
+  }
+  trace->_lf_trace_file_offset += (int64_t)(sizeof(int) + sizeof(header) + header.payload_size);
+  return true;
+}
+
+/**
+ * @brief Append the index of the chunks to the file. This assumes the caller owns the file.
+ * @return false if access to the file failed.
+ */
+static bool write_index(trace_t* trace, FILE* file) {
+  if (trace->_lf_trace_index == NULL) {
+    return true;
+  }
+  int marker = TRACE_INDEX_MARKER;
+  int64_t size = (int64_t)trace->_lf_trace_index_size;
+  return fwrite(&marker, sizeof(int), 1, file) == 1 && fwrite(&size, sizeof(int64_t), 1, file) == 1 &&
+         fwrite(trace->_lf_trace_index, sizeof(trace_chunk_entry_t), trace->_lf_trace_index_size, file) ==
+             trace->_lf_trace_index_size &&
+         fwrite(&trace->_lf_trace_file_offset, sizeof(int64_t), 1, file) == 1 &&
+         fwrite(TRACE_INDEX_MAGIC, 1, TRACE_INDEX_MAGIC_SIZE, file) == TRACE_INDEX_MAGIC_SIZE;
+}
+
+/**
+ * @brief Close the file after a failed access. This assumes the caller holds the trace mutex.
+ */
+static void trace_file_failed_locked(trace_t* trace) {
+  fprintf(stderr, "WARNING: Access to trace file failed.\n");
+  fclose(trace->_lf_trace_file);
+  trace->_lf_trace_file = NULL;
+}
+
+#ifndef LF_TRACE_FLIGHT_RECORDER
 /**
  * @brief Flush the specified buffer to a file.
- * This assumes the caller has entered a critical section.
+ * If the writer thread is running, the buffer is handed to it and replaced by a free buffer.
+ * If there is no free buffer, the writer thread has fallen behind. Then the caller waits
+ * for a free buffer or, if LF_TRACE_DROP_WHEN_BEHIND is defined, the records are dropped.
+ * This assumes the caller has entered a critical section. Waiting leaves it temporarily.
  * @param worker Index specifying the trace to flush.
  */
 static void flush_trace_locked(trace_t* trace, int worker) {
-  if (trace->_lf_trace_stop == 0 && trace->_lf_trace_file != NULL && trace->_lf_trace_buffer_size[worker] > 0) {
-    // If the trace header has not been written, write it now.
-    // This is deferred to here so that user trace objects can be
-    // registered in startup reactions.
-    if (!trace->_lf_trace_header_written) {
-      if (write_trace_header(trace) < 0) {
-        lf_print_error("Failed to write trace header. Trace file will be incomplete.");
-        return;
+  if (trace->_lf_trace_buffer_size[worker] == 0) {
+    return;
+  }
+#ifndef LF_TRACE_DROP_WHEN_BEHIND
+  if (trace->_lf_trace_writer_running && trace->_lf_trace_free_buffers_size == 0) {
+    trace->_lf_trace_stalls++;
+    do {
+      lf_platform_cond_wait(trace->_lf_trace_free_cond);
+    } while (trace->_lf_trace_writer_running && trace->_lf_trace_free_buffers_size == 0);
+  }
+#endif
+  // Another thread may have flushed the same buffer while this one was waiting.
+  size_t size = trace->_lf_trace_buffer_size[worker];
+  if (size == 0) {
+    return;
+  }
+  if (trace->_lf_trace_stop == 0 && trace->_lf_trace_file != NULL) {
+    if (!trace->_lf_trace_writer_running) {
+      if (write_trace_header_once_locked(trace) &&
+          !write_records(trace, trace->_lf_trace_file, trace->_lf_trace_buffer[worker], size)) {
+        trace_file_failed_locked(trace);
       }
-      trace->_lf_trace_header_written = true;
+    } else if (trace->_lf_trace_free_buffers_size == 0) {
+      // Drop the records rather than stall the worker on disk I/O.
+      trace->_lf_trace_dropped_records += size;
+    } else {
+      size_t tail = (trace->_lf_trace_pending_head + trace->_lf_trace_pending_size) % trace->_lf_trace_pending_capacity;
+      trace->_lf_trace_pending[tail] = (trace_pending_buffer_t){.records = trace->_lf_trace_buffer[worker], .size = size};
+      trace->_lf_trace_pending_size++;
+      trace->_lf_trace_buffer[worker] = trace->_lf_trace_free_buffers[--trace->_lf_trace_free_buffers_size];
+      lf_platform_cond_signal(trace->_lf_trace_writer_cond);
     }
+  }
+  // If the trace has stopped or the file has failed, the records are dropped.
+  trace->_lf_trace_buffer_size[worker] = 0;
+}
 
-    // Write first the length of the array.
-    size_t items_written = fwrite(&trace->_lf_trace_buffer_size[worker], sizeof(int), 1, trace->_lf_trace_file);
-    if (items_written != 1) {
-      fprintf(stderr, "WARNING: Access to trace file failed.\n");
-      fclose(trace->_lf_trace_file);
-      trace->_lf_trace_file = NULL;
-    } else {
-      // Write the contents.
-      items_written = fwrite(trace->_lf_trace_buffer[worker], sizeof(trace_record_nodeps_t),
-                             trace->_lf_trace_buffer_size[worker], trace->_lf_trace_file);
-      if (items_written != trace->_lf_trace_buffer_size[worker]) {
-        fprintf(stderr, "WARNING: Access to trace file failed.\n");
-        fclose(trace->_lf_trace_file);
-        trace->_lf_trace_file = NULL;
+/**
+ * @brief The writer thread, which writes the buffers handed to it by flush_trace_locked in order.
+ * It owns the file while it is running, so it writes without holding the trace mutex.
+ */
+static void* trace_writer(void* arg) {
+  trace_t* trace = (trace_t*)arg;
+  lf_platform_mutex_lock(trace_mutex);
+  while (true) {
+    while (trace->_lf_trace_pending_size == 0 && !trace->_lf_trace_writer_stop) {
+      lf_platform_cond_wait(trace->_lf_trace_writer_cond);
+    }
+    if (trace->_lf_trace_pending_size == 0) {
+      break;
+    }
+    trace_pending_buffer_t pending = trace->_lf_trace_pending[trace->_lf_trace_pending_head];
+    trace->_lf_trace_pending_head = (trace->_lf_trace_pending_head + 1) % trace->_lf_trace_pending_capacity;
+    trace->_lf_trace_pending_size--;
+    FILE* file = write_trace_header_once_locked(trace) ? trace->_lf_trace_file : NULL;
+
+    lf_platform_mutex_unlock(trace_mutex);
+    bool written = file == NULL || write_records(trace, file, pending.records, pending.size);
+    lf_platform_mutex_lock(trace_mutex);
+
+    if (!written) {
+      trace_file_failed_locked(trace);
+    }
+    trace->_lf_trace_free_buffers[trace->_lf_trace_free_buffers_size++] = pending.records;
+    lf_platform_cond_signal(trace->_lf_trace_free_cond);
+  }
+  // From now on, buffers are written by the threads that fill them.
+  trace->_lf_trace_writer_running = false;
+  lf_platform_cond_broadcast(trace->_lf_trace_free_cond);
+  lf_platform_mutex_unlock(trace_mutex);
+  return NULL;
+}
+
+/**
+ * @brief Start the writer thread. If this fails, buffers are written by the threads that fill them.
+ */
+static void start_trace_writer(trace_t* trace) {
+  trace->_lf_trace_writer_running = false;
+  trace->_lf_trace_writer_stop = false;
+  trace->_lf_trace_dropped_records = 0;
+  trace->_lf_trace_stalls = 0;
+  if (trace->_lf_trace_file == NULL) {
+    return;
+  }
+  trace->_lf_trace_writer_cond = lf_platform_cond_new(trace_mutex);
+  trace->_lf_trace_free_cond = lf_platform_cond_new(trace_mutex);
+  if (trace->_lf_trace_writer_cond == NULL || trace->_lf_trace_free_cond == NULL) {
+    LF_PRINT_DEBUG("No trace writer thread. Buffers are written by the threads that fill them.");
+    lf_platform_cond_free(trace->_lf_trace_writer_cond);
+    lf_platform_cond_free(trace->_lf_trace_free_cond);
+    return;
+  }
+  // One spare buffer for each buffer, so that every thread can keep tracing while its previous
+  // buffer is being written.
+  size_t number_of_buffers = trace->_lf_number_of_trace_buffers + 1;
+  trace->_lf_trace_free_buffers = (trace_record_nodeps_t**)malloc(sizeof(trace_record_nodeps_t*) * number_of_buffers);
+  for (size_t i = 0; i < number_of_buffers; i++) {
+    trace->_lf_trace_free_buffers[i] =
+        (trace_record_nodeps_t*)malloc(sizeof(trace_record_nodeps_t) * TRACE_BUFFER_CAPACITY);
+  }
+  trace->_lf_trace_free_buffers_size = number_of_buffers;
+  trace->_lf_trace_pending_capacity = 2 * number_of_buffers;
+  trace->_lf_trace_pending =
+      (trace_pending_buffer_t*)malloc(sizeof(trace_pending_buffer_t) * trace->_lf_trace_pending_capacity);
+  trace->_lf_trace_pending_head = 0;
+  trace->_lf_trace_pending_size = 0;
+  trace->_lf_trace_memory_size += number_of_buffers * (sizeof(trace_record_nodeps_t*) +
+                                                       sizeof(trace_record_nodeps_t) * TRACE_BUFFER_CAPACITY) +
+                                  sizeof(trace_pending_buffer_t) * trace->_lf_trace_pending_capacity;
+
+  trace->_lf_trace_writer_running = true;
+  trace->_lf_trace_writer = lf_platform_thread_new(trace_writer, trace);
+  if (trace->_lf_trace_writer == NULL) {
+    trace->_lf_trace_writer_running = false;
+    lf_platform_cond_free(trace->_lf_trace_writer_cond);
+    lf_platform_cond_free(trace->_lf_trace_free_cond);
+  }
+}
+#endif // LF_TRACE_FLIGHT_RECORDER
+
+/**
+ * @brief Let the writer thread write what has been handed to it and wait for it to return.
+ * This assumes the caller does not hold the trace mutex.
+ */
+static void stop_trace_writer(trace_t* trace) {
+  if (trace->_lf_trace_writer == NULL) {
+    return;
+  }
+  lf_platform_mutex_lock(trace_mutex);
+  trace->_lf_trace_writer_stop = true;
+  lf_platform_cond_signal(trace->_lf_trace_writer_cond);
+  lf_platform_mutex_unlock(trace_mutex);
+  lf_platform_thread_join(trace->_lf_trace_writer);
+  trace->_lf_trace_writer = NULL;
+  lf_platform_cond_free(trace->_lf_trace_writer_cond);
+  lf_platform_cond_free(trace->_lf_trace_free_cond);
+  if (trace->_lf_trace_dropped_records > 0) {
+    fprintf(stderr, "WARNING: Dropped %zu trace records because the trace file could not be written fast enough.\n",
+            trace->_lf_trace_dropped_records);
+  }
+  if (trace->_lf_trace_stalls > 0) {
+    fprintf(stderr, "WARNING: Threads waited %zu times for the trace file to be written.\n", trace->_lf_trace_stalls);
+  }
+}
+
+/**
+ * @brief Append a record to the buffer of the specified thread, which must have room for it
+ * unless it is a ring (in flight-recorder mode). Only the thread that owns the buffer, or
+ * for the buffer at index -1, the holder of the trace mutex, may call this.
+ */
+static void append_record(trace_t* trace, int tid, trace_record_nodeps_t* tr) {
+  size_t size = trace->_lf_trace_buffer_size[tid];
+#ifdef LF_TRACE_FLIGHT_RECORDER
+  trace->_lf_trace_buffer[tid][size & (LF_TRACE_FLIGHT_RECORDER_CAPACITY - 1)] = *tr;
+  // Publish the record to a dump that copies the ring concurrently.
+  __atomic_store_n(&trace->_lf_trace_buffer_size[tid], size + 1, __ATOMIC_RELEASE);
+#else
+  trace->_lf_trace_buffer[tid][size] = *tr;
+  trace->_lf_trace_buffer_size[tid] = size + 1;
+#endif
+}
+
+/**
+ * @brief Move the records in the ring of threads not created by LF into the buffer at
+ * index -1, flushing that buffer to the file whenever it is full.
+ * This assumes the caller holds the trace mutex, which makes it the only consumer.
+ */
+static void drain_user_ring_locked(trace_t* trace) {
+  if (trace->_lf_trace_user_ring == NULL) {
+    return;
+  }
+  while (true) {
+#ifndef LF_TRACE_FLIGHT_RECORDER
+    // Flush first, since flushing can leave the critical section and let another thread drain.
+    if (trace->_lf_trace_buffer_size[-1] >= TRACE_BUFFER_CAPACITY) {
+      flush_trace_locked(trace, -1);
+    }
+#endif
+    size_t position = trace->_lf_trace_user_ring_head;
+    trace_ring_slot_t* slot = &trace->_lf_trace_user_ring[position & (TRACE_USER_RING_CAPACITY - 1)];
+    // Stop at a slot that is empty or that a producer is still writing.
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != position + 1) {
+      return;
+    }
+    append_record(trace, -1, &slot->record);
+    // Hand the slot to the producer of the position one lap later.
+    __atomic_store_n(&slot->sequence, position + TRACE_USER_RING_CAPACITY, __ATOMIC_RELEASE);
+    trace->_lf_trace_user_ring_head = position + 1;
+  }
+}
+
+/**
+ * @brief Write a record from a thread not created by LF into the ring without locking.
+ * @return false if the ring is full.
+ */
+static bool push_user_ring(trace_t* trace, trace_record_nodeps_t* tr) {
+  size_t position = __atomic_load_n(&trace->_lf_trace_user_ring_tail, __ATOMIC_RELAXED);
+  while (true) {
+    trace_ring_slot_t* slot = &trace->_lf_trace_user_ring[position & (TRACE_USER_RING_CAPACITY - 1)];
+    intptr_t lag = (intptr_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - position);
+    if (lag < 0) {
+      // The slot still holds the record written one lap earlier.
+      return false;
+    }
+    if (lag == 0) {
+      if (__atomic_compare_exchange_n(&trace->_lf_trace_user_ring_tail, &position, position + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        slot->record = *tr;
+        __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+        return true;
       }
+      // On failure, `position` has been updated to the current tail.
+    } else {
+      // Another producer has claimed this position.
+      position = __atomic_load_n(&trace->_lf_trace_user_ring_tail, __ATOMIC_RELAXED);
     }
-    trace->_lf_trace_buffer_size[worker] = 0;
   }
 }
 
+#ifndef LF_TRACE_FLIGHT_RECORDER
 /**
  * @brief Flush the specified buffer to a file.
  * @param worker Index specifying the trace to flush.
@@ -132,8 +429,64 @@ static void flush_trace(trace_t* trace, int worker) {
   // enter a critical section.
   lf_platform_mutex_lock(trace_mutex);
   flush_trace_locked(trace, worker);
+  // Also write out what threads not created by LF have traced so far.
+  drain_user_ring_locked(trace);
   lf_platform_mutex_unlock(trace_mutex);
 }
+#else
+/**
+ * @brief Write the records of the rings that have not been dumped yet and that are at most
+ * LF_TRACE_FLIGHT_RECORDER nanoseconds older than the latest record.
+ * The threads keep writing their rings while they are copied. Records that may have been
+ * overwritten during the copy are dropped. This assumes the caller holds the trace mutex.
+ */
+static void dump_flight_recorder_locked(trace_t* trace) {
+  if (trace->_lf_trace_stop || !write_trace_header_once_locked(trace)) {
+    return;
+  }
+  drain_user_ring_locked(trace);
+  int64_t latest = INT64_MIN;
+  for (int i = -1; i < (int)trace->_lf_number_of_trace_buffers; i++) {
+    size_t end = __atomic_load_n(&trace->_lf_trace_buffer_size[i], __ATOMIC_ACQUIRE);
+    if (end > trace->_lf_trace_dumped[i]) {
+      int64_t time = trace->_lf_trace_buffer[i][(end - 1) & (LF_TRACE_FLIGHT_RECORDER_CAPACITY - 1)].physical_time;
+      latest = time > latest ? time : latest;
+    }
+  }
+  int64_t cutoff = (LF_TRACE_FLIGHT_RECORDER > 0 && latest != INT64_MIN) ? latest - LF_TRACE_FLIGHT_RECORDER : INT64_MIN;
+
+  for (int i = -1; i < (int)trace->_lf_number_of_trace_buffers; i++) {
+    size_t end = __atomic_load_n(&trace->_lf_trace_buffer_size[i], __ATOMIC_ACQUIRE);
+    // The record at position end may be being written over the one at end - CAPACITY.
+    size_t oldest = end + 1 > LF_TRACE_FLIGHT_RECORDER_CAPACITY ? end + 1 - LF_TRACE_FLIGHT_RECORDER_CAPACITY : 0;
+    size_t position = trace->_lf_trace_dumped[i] > oldest ? trace->_lf_trace_dumped[i] : oldest;
+    while (position < end) {
+      size_t batch = end - position < TRACE_BUFFER_CAPACITY ? end - position : TRACE_BUFFER_CAPACITY;
+      for (size_t k = 0; k < batch; k++) {
+        trace->_lf_trace_dump_scratch[k] =
+            trace->_lf_trace_buffer[i][(position + k) & (LF_TRACE_FLIGHT_RECORDER_CAPACITY - 1)];
+      }
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      size_t now = __atomic_load_n(&trace->_lf_trace_buffer_size[i], __ATOMIC_RELAXED);
+      oldest = now + 1 > LF_TRACE_FLIGHT_RECORDER_CAPACITY ? now + 1 - LF_TRACE_FLIGHT_RECORDER_CAPACITY : 0;
+      size_t size = 0;
+      for (size_t k = 0; k < batch; k++) {
+        if (position + k >= oldest && trace->_lf_trace_dump_scratch[k].physical_time >= cutoff) {
+          trace->_lf_trace_dump_scratch[size++] = trace->_lf_trace_dump_scratch[k];
+        }
+      }
+      if (size > 0 && !write_records(trace, trace->_lf_trace_file, trace->_lf_trace_dump_scratch, size)) {
+        trace_file_failed_locked(trace);
+        return;
+      }
+      position += batch;
+    }
+    trace->_lf_trace_dumped[i] = end;
+  }
+  // Keep the dump if the program crashes later.
+  fflush(trace->_lf_trace_file);
+}
+#endif // LF_TRACE_FLIGHT_RECORDER
 
 static void start_trace(trace_t* trace, int max_num_local_threads) {
   // Do not write the trace header information to the file yet
@@ -149,11 +502,41 @@ static void start_trace(trace_t* trace, int max_num_local_threads) {
       (trace_record_nodeps_t**)malloc(sizeof(trace_record_nodeps_t*) * (trace->_lf_number_of_trace_buffers + 1));
   trace->_lf_trace_buffer++; // the buffer at index -1 is a fallback for user threads.
   for (int i = -1; i < (int)trace->_lf_number_of_trace_buffers; i++) {
-    trace->_lf_trace_buffer[i] = (trace_record_nodeps_t*)malloc(sizeof(trace_record_nodeps_t) * TRACE_BUFFER_CAPACITY);
+    trace->_lf_trace_buffer[i] =
+        (trace_record_nodeps_t*)malloc(sizeof(trace_record_nodeps_t) * TRACE_THREAD_BUFFER_CAPACITY);
   }
   // Array of counters that track the size of each trace record (per thread).
   trace->_lf_trace_buffer_size = (size_t*)calloc(sizeof(size_t), trace->_lf_number_of_trace_buffers + 1);
   trace->_lf_trace_buffer_size++;
+#ifdef LF_TRACE_FLIGHT_RECORDER
+  trace->_lf_trace_dumped = (size_t*)calloc(sizeof(size_t), trace->_lf_number_of_trace_buffers + 1);
+  trace->_lf_trace_dumped++;
+  trace->_lf_trace_dump_scratch = (trace_record_nodeps_t*)malloc(sizeof(trace_record_nodeps_t) * TRACE_BUFFER_CAPACITY);
+#endif
+
+  trace->_lf_trace_user_ring = (trace_ring_slot_t*)malloc(sizeof(trace_ring_slot_t) * TRACE_USER_RING_CAPACITY);
+  for (size_t i = 0; i < TRACE_USER_RING_CAPACITY; i++) {
+    trace->_lf_trace_user_ring[i].sequence = i;
+  }
+  trace->_lf_trace_user_ring_head = 0;
+  trace->_lf_trace_user_ring_tail = 0;
+
+  trace->_lf_trace_file_offset = 0;
+  trace->_lf_trace_chunk_payload = (uint8_t*)malloc(TRACE_BUFFER_CAPACITY * TRACE_CHUNK_MAX_RECORD_SIZE);
+  trace->_lf_trace_index_size = 0;
+  trace->_lf_trace_index_capacity = 64;
+  trace->_lf_trace_index = (trace_chunk_entry_t*)malloc(sizeof(trace_chunk_entry_t) * trace->_lf_trace_index_capacity);
+
+  size_t number_of_buffers = trace->_lf_number_of_trace_buffers + 1;
+  trace->_lf_trace_memory_size =
+      number_of_buffers * (sizeof(trace_record_nodeps_t*) +
+                           sizeof(trace_record_nodeps_t) * TRACE_THREAD_BUFFER_CAPACITY + sizeof(size_t)) +
+      sizeof(trace_ring_slot_t) * TRACE_USER_RING_CAPACITY + TRACE_BUFFER_CAPACITY * TRACE_CHUNK_MAX_RECORD_SIZE +
+      sizeof(trace_chunk_entry_t) * trace->_lf_trace_index_capacity;
+#ifdef LF_TRACE_FLIGHT_RECORDER
+  trace->_lf_trace_memory_size +=
+      number_of_buffers * sizeof(size_t) + sizeof(trace_record_nodeps_t) * TRACE_BUFFER_CAPACITY;
+#endif
 
   trace->_lf_trace_stop = 0;
   LF_PRINT_DEBUG("Started tracing.");
@@ -180,6 +563,9 @@ static void stop_trace_locked(trace_t* trace) {
     // Trace was already stopped. Nothing to do.
     return;
   }
+#ifndef LF_TRACE_FLIGHT_RECORDER
+  // In flight-recorder mode, the records are only written when a dump is triggered.
+  drain_user_ring_locked(trace);
   for (int i = -1; i < (int)trace->_lf_number_of_trace_buffers; i++) {
     // Flush the buffer if it has data.
     LF_PRINT_DEBUG("Trace buffer %d has %zu records.", i, trace->_lf_trace_buffer_size[i]);
@@ -187,15 +573,25 @@ static void stop_trace_locked(trace_t* trace) {
       flush_trace_locked(trace, i);
     }
   }
+#endif
   trace->_lf_trace_stop = 1;
   if (trace->_lf_trace_file != NULL) {
+    if (trace->_lf_trace_header_written && !write_index(trace, trace->_lf_trace_file)) {
+      fprintf(stderr, "WARNING: Failed to write the index of the trace file.\n");
+    }
     fclose(trace->_lf_trace_file);
     trace->_lf_trace_file = NULL;
   }
+  if (trace->_lf_trace_index != NULL) {
+    free(trace->_lf_trace_index);
+    trace->_lf_trace_memory_size -= sizeof(trace_chunk_entry_t) * trace->_lf_trace_index_capacity;
+    trace->_lf_trace_index = NULL;
+  }
   LF_PRINT_DEBUG("Stopped tracing.");
 }
 
 static void stop_trace(trace_t* trace) {
+  stop_trace_writer(trace);
   lf_platform_mutex_lock(trace_mutex);
   stop_trace_locked(trace);
   lf_platform_mutex_unlock(trace_mutex);
@@ -225,14 +621,26 @@ void lf_tracing_tracepoint(int worker, trace_record_nodeps_t* tr) {
   if (tid < 0) {
     // The current thread was created by the user. It is not managed by LF, its ID is not known,
     // and most importantly it does not count toward the limit on the total number of threads.
-    // Therefore we should fall back to using a mutex.
-    lf_platform_mutex_lock(trace_mutex);
+    // Therefore it writes to the ring shared by such threads, which the next flush drains.
+    while (!push_user_ring(&trace, tr)) {
+      // The ring is full. Drain it here.
+      lf_platform_mutex_lock(trace_mutex);
+      drain_user_ring_locked(&trace);
+      lf_platform_mutex_unlock(trace_mutex);
+    }
+    return;
   }
   if (tid > (int)trace._lf_number_of_trace_buffers) {
     lf_print_error_and_exit("the thread id (%d) exceeds the number of trace buffers (%zu)", tid,
                             trace._lf_number_of_trace_buffers);
   }
 
+#ifdef LF_TRACE_FLIGHT_RECORDER
+  append_record(&trace, tid, tr);
+  if (tr->event_type == reaction_deadline_missed || dump_requested) {
+    lf_tracing_dump();
+  }
+#else
   // Flush the buffer if it is full.
   if (trace._lf_trace_buffer_size[tid] >= TRACE_BUFFER_CAPACITY) {
     // No more room in the buffer. Write the buffer to the file.
@@ -245,9 +653,7 @@ void lf_tracing_tracepoint(int worker, trace_record_nodeps_t* tr) {
 
   trace._lf_trace_buffer[tid][i] = *tr;
   trace._lf_trace_buffer_size[tid]++;
-  if (tid < 0) {
-    lf_platform_mutex_unlock(trace_mutex);
-  }
+#endif // LF_TRACE_FLIGHT_RECORDER
 }
 
 void lf_tracing_global_init(char* process_name, char* process_names, int fedid, int max_num_local_threads) {
@@ -266,7 +672,24 @@ void lf_tracing_global_init(char* process_name, char* process_names, int fedid,
   }
   trace_new(filename);
   start_trace(&trace, max_num_local_threads);
+#ifdef LF_TRACE_FLIGHT_RECORDER
+  // Dumps are rare and written by the thread that triggers them.
+#ifdef SIGUSR1
+  signal(SIGUSR1, request_dump);
+#endif
+#else
+  start_trace_writer(&trace);
+#endif
+}
+void lf_tracing_dump() {
+#ifdef LF_TRACE_FLIGHT_RECORDER
+  dump_requested = 0;
+  lf_platform_mutex_lock(trace_mutex);
+  dump_flight_recorder_locked(&trace);
+  lf_platform_mutex_unlock(trace_mutex);
+#endif
 }
+size_t lf_tracing_memory_size() { return trace._lf_trace_memory_size; }
 void lf_tracing_set_start_time(int64_t time) { start_time = time; }
 void lf_tracing_global_shutdown() {
   stop_trace(&trace);
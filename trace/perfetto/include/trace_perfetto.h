@@ -0,0 +1,67 @@
+/**
+ * @file
+ * @brief Declarations for the tracing module that writes the Perfetto trace format.
+ *
+ * Each process writes a file named like the .lft file of the default implementation, but
+ * with the extension .pftrace, which holds a perfetto.protos.Trace message that the Perfetto
+ * UI (https://ui.perfetto.dev) and trace_processor load without conversion.
+ *
+ * Each thread encodes its tracepoints as a packet sequence of its own, with the names of
+ * reactions, triggers and events interned on that sequence. The threads are tracks of the
+ * process, on which reactions and waits are slices. Deadline misses, calls to schedule and
+ * user events are instants on tracks of their own, and user values are counters. Federated
+ * messages are instants connected by flows from the sender to the receiver, which are
+ * matched by tag, so the files of a federation can be concatenated into one trace:
+ * `cat *.pftrace > federation.pftrace`.
+ */
+
+#ifndef TRACE_PERFETTO_H
+#define TRACE_PERFETTO_H
+
+#include "trace.h"
+#include "platform.h"
+
+/** Number of bytes of packets that a thread encodes before it writes them to the file. */
+#define PERFETTO_BUFFER_CAPACITY 65536
+
+/** Number of slots of the table of trace objects. Must be a power of two. It is kept at most half full. */
+#define PERFETTO_OBJECT_TABLE_SIZE 4096
+
+/** Max length of trace file name. */
+#define PERFETTO_MAX_FILENAME_LENGTH 128
+
+// TYPE DEFINITIONS **********************************************************
+
+/** @brief A growable array of bytes. */
+typedef struct pf_bytes_t {
+  uint8_t* data;
+  size_t size;
+  size_t capacity;
+} pf_bytes_t;
+
+/** @brief A registered trace object, identified by its pointer and trigger. */
+typedef struct pf_object_t {
+  void* pointer;
+  void* trigger;
+  _lf_trace_object_t type;
+  char* description;
+  int index;              // The order of registration.
+  int used;               // Set, with release semantics, once the other fields are valid.
+  int counter_described;  // Set once the descriptor of the counter track of a user value is written.
+} pf_object_t;
+
+/**
+ * @brief The packets of one thread, which form a packet sequence.
+ * The sequence at index -1 is shared by the threads not created by LF, which hold the trace mutex.
+ */
+typedef struct pf_sequence_t {
+  pf_bytes_t out;            // Encoded packets that have not been written to the file.
+  pf_bytes_t packet;         // The packet being encoded.
+  pf_bytes_t event;          // The track event of the packet being encoded.
+  pf_bytes_t interned;       // The interned data of the packet being encoded.
+  pf_bytes_t entry;          // An entry of the interned data or a debug annotation.
+  uint8_t* interned_objects; // One bit per name of an object that is interned on this sequence.
+  bool started;              // Whether the first packet, which clears the interned data, has been written.
+} pf_sequence_t;
+
+#endif // TRACE_PERFETTO_H
@@ -0,0 +1,549 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+#include "trace_types.h"
+#include "platform.h"
+#include "trace_perfetto.h"
+
+// PROTOCOL BUFFER ENCODING **************************************************
+
+// Field numbers of the perfetto.protos messages that are written.
+#define PF_TRACE_PACKET 1
+#define PF_PACKET_TIMESTAMP 8
+#define PF_PACKET_SEQUENCE_ID 10
+#define PF_PACKET_TRACK_EVENT 11
+#define PF_PACKET_INTERNED_DATA 12
+#define PF_PACKET_SEQUENCE_FLAGS 13
+#define PF_PACKET_TRACK_DESCRIPTOR 60
+#define PF_EVENT_DEBUG_ANNOTATIONS 4
+#define PF_EVENT_TYPE 9
+#define PF_EVENT_NAME_IID 10
+#define PF_EVENT_TRACK_UUID 11
+#define PF_EVENT_COUNTER_VALUE 30
+#define PF_EVENT_FLOW_IDS 47
+#define PF_EVENT_TERMINATING_FLOW_IDS 48
+#define PF_INTERNED_EVENT_NAMES 2
+#define PF_INTERNED_ANNOTATION_NAMES 3
+#define PF_NAME_IID 1
+#define PF_NAME_NAME 2
+#define PF_ANNOTATION_NAME_IID 1
+#define PF_ANNOTATION_INT_VALUE 4
+#define PF_TRACK_UUID 1
+#define PF_TRACK_NAME 2
+#define PF_TRACK_PROCESS 3
+#define PF_TRACK_PARENT_UUID 5
+#define PF_TRACK_COUNTER 8
+#define PF_PROCESS_PID 1
+#define PF_PROCESS_NAME 6
+
+// Wire types.
+#define PF_VARINT 0
+#define PF_FIXED64 1
+#define PF_LENGTH_DELIMITED 2
+
+// Values of TrackEvent.Type and of TracePacket.SequenceFlags.
+#define PF_SLICE_BEGIN 1
+#define PF_SLICE_END 2
+#define PF_INSTANT 3
+#define PF_COUNTER 4
+#define PF_SEQ_INCREMENTAL_STATE_CLEARED 1
+#define PF_SEQ_NEEDS_INCREMENTAL_STATE 2
+
+/** Interned name of an event type. The names of objects follow, 64 per object, one per reaction number. */
+#define PF_EVENT_TYPE_IID(event_type) ((uint64_t)(event_type) + 1)
+#define PF_FIRST_OBJECT_IID 128
+#define PF_OBJECT_IID(index, number) (PF_FIRST_OBJECT_IID + (uint64_t)(index) * 64 + ((number) < 63 ? (number) : 63))
+_Static_assert(NUM_EVENT_TYPES < PF_FIRST_OBJECT_IID, "The names of event types overlap those of objects.");
+
+/** Interned names of the debug annotations. */
+#define PF_LOGICAL_TIME_IID 1
+#define PF_MICROSTEP_IID 2
+#define PF_EXTRA_DELAY_IID 3
+
+/** Tracks of the process, whose UUIDs are offsets from that of the process. */
+#define PF_THREAD_TRACK(tid) (process_uuid + 2 + (tid))
+#define PF_SCHEDULER_TRACK (process_uuid + 0x10000001)
+#define PF_DEADLINES_TRACK (process_uuid + 0x10000002)
+#define PF_SCHEDULE_TRACK (process_uuid + 0x10000003)
+#define PF_USER_TRACK (process_uuid + 0x10000004)
+#define PF_COUNTER_TRACK(index) (process_uuid + 0x20000000 + (index))
+
+// PRIVATE DATA STRUCTURES ***************************************************
+
+static lf_platform_mutex_ptr_t trace_mutex;
+static FILE* trace_file;
+static pf_sequence_t* sequences;
+static int number_of_sequences;
+static pf_object_t objects[PERFETTO_OBJECT_TABLE_SIZE];
+static int objects_size;
+static int process_id;
+static uint64_t process_uuid;
+static int64_t start_time;
+static bool stopped;
+static version_t version = {.build_config =
+                                {
+                                    .single_threaded = TRIBOOL_DOES_NOT_MATTER,
+#ifdef NDEBUG
+                                    .build_type_is_debug = TRIBOOL_FALSE,
+#else
+                                    .build_type_is_debug = TRIBOOL_TRUE,
+#endif
+                                    .log_level = LOG_LEVEL,
+                                },
+                            .core_version_name = NULL};
+
+static void pf_reserve(pf_bytes_t* bytes, size_t size) {
+  if (bytes->size + size <= bytes->capacity) {
+    return;
+  }
+  size_t capacity = bytes->capacity < 256 ? 256 : 2 * bytes->capacity;
+  while (capacity < bytes->size + size) {
+    capacity *= 2;
+  }
+  uint8_t* data = (uint8_t*)realloc(bytes->data, capacity);
+  if (data == NULL) {
+    fprintf(stderr, "WARNING: Out of memory for the trace.\n");
+    exit(1);
+  }
+  bytes->data = data;
+  bytes->capacity = capacity;
+}
+
+static void pf_varint(pf_bytes_t* bytes, uint64_t value) {
+  pf_reserve(bytes, 10);
+  while (value >= 0x80) {
+    bytes->data[bytes->size++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  bytes->data[bytes->size++] = (uint8_t)value;
+}
+
+static void pf_append(pf_bytes_t* bytes, const void* data, size_t size) {
+  if (size > 0) {
+    pf_reserve(bytes, size);
+    memcpy(bytes->data + bytes->size, data, size);
+    bytes->size += size;
+  }
+}
+
+static void pf_key(pf_bytes_t* bytes, int field, int wire_type) {
+  pf_varint(bytes, ((uint64_t)field << 3) | (uint64_t)wire_type);
+}
+
+static void pf_uint(pf_bytes_t* bytes, int field, uint64_t value) {
+  pf_key(bytes, field, PF_VARINT);
+  pf_varint(bytes, value);
+}
+
+static void pf_fixed64(pf_bytes_t* bytes, int field, uint64_t value) {
+  pf_key(bytes, field, PF_FIXED64);
+  pf_reserve(bytes, 8);
+  for (int i = 0; i < 8; i++) {
+    bytes->data[bytes->size++] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static void pf_string(pf_bytes_t* bytes, int field, const char* string) {
+  size_t size = strlen(string);
+  pf_key(bytes, field, PF_LENGTH_DELIMITED);
+  pf_varint(bytes, size);
+  pf_append(bytes, string, size);
+}
+
+/** Append the specified message as a field and clear it. */
+static void pf_message(pf_bytes_t* bytes, int field, pf_bytes_t* message) {
+  pf_key(bytes, field, PF_LENGTH_DELIMITED);
+  pf_varint(bytes, message->size);
+  pf_append(bytes, message->data, message->size);
+  message->size = 0;
+}
+
+// TRACE OBJECTS *************************************************************
+
+static size_t pf_hash(void* pointer, void* trigger) {
+  uint64_t hash = ((uint64_t)(uintptr_t)pointer ^ ((uint64_t)(uintptr_t)trigger * 0x9E3779B97F4A7C15ULL)) *
+                  0x9E3779B97F4A7C15ULL;
+  return (size_t)(hash >> 32) & (PERFETTO_OBJECT_TABLE_SIZE - 1);
+}
+
+/** Return the registered object with the specified pointer and trigger, or NULL if there is none. */
+static pf_object_t* pf_lookup(void* pointer, void* trigger) {
+  for (size_t slot = pf_hash(pointer, trigger); __atomic_load_n(&objects[slot].used, __ATOMIC_ACQUIRE);
+       slot = (slot + 1) & (PERFETTO_OBJECT_TABLE_SIZE - 1)) {
+    if (objects[slot].pointer == pointer && objects[slot].trigger == trigger) {
+      return &objects[slot];
+    }
+  }
+  return NULL;
+}
+
+// PACKET SEQUENCES **********************************************************
+
+static uint64_t pf_sequence_id(int tid) { return ((uint64_t)(process_id + 2) << 16) | (uint64_t)(tid + 1); }
+
+/** Add an interned name, which is the concatenation of the parts, to the packet being encoded. */
+static void pf_intern(pf_sequence_t* seq, int field, uint64_t iid, const char* prefix, const char* suffix) {
+  size_t prefix_size = strlen(prefix);
+  size_t suffix_size = strlen(suffix);
+  seq->entry.size = 0;
+  pf_uint(&seq->entry, PF_NAME_IID, iid);
+  pf_key(&seq->entry, PF_NAME_NAME, PF_LENGTH_DELIMITED);
+  pf_varint(&seq->entry, prefix_size + suffix_size);
+  pf_append(&seq->entry, prefix, prefix_size);
+  pf_append(&seq->entry, suffix, suffix_size);
+  pf_message(&seq->interned, field, &seq->entry);
+}
+
+/**
+ * Return the interned name of the specified object, or for a reactor, of its reaction with the
+ * specified number, interning it on the sequence if needed. If the object is not registered,
+ * return the name of the event type.
+ */
+static uint64_t pf_object_iid(pf_sequence_t* seq, int event_type, void* pointer, void* trigger, int number) {
+  pf_object_t* object = pf_lookup(pointer, trigger);
+  if (object == NULL) {
+    return PF_EVENT_TYPE_IID(event_type);
+  }
+  if (object->type != trace_reactor || number < 0) {
+    number = 0;
+  }
+  uint64_t iid = PF_OBJECT_IID(object->index, number);
+  size_t bit = (size_t)(iid - PF_FIRST_OBJECT_IID);
+  if (!(seq->interned_objects[bit >> 3] & (1 << (bit & 7)))) {
+    seq->interned_objects[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+    char index_name[24];
+    const char* name = object->description;
+    if (name == NULL) {
+      // The runtime was built without names. See util/tracing/README.md.
+      snprintf(index_name, sizeof(index_name), "#%d", object->index);
+      name = index_name;
+    }
+    char suffix[32] = "";
+    if (object->type == trace_reactor) {
+      snprintf(suffix, sizeof(suffix), number < 63 ? " reaction %d" : " reaction %d or later", number);
+    }
+    pf_intern(seq, PF_INTERNED_EVENT_NAMES, iid, name, suffix);
+  }
+  return iid;
+}
+
+/** Add a debug annotation with an integer value to the event being encoded. */
+static void pf_annotate(pf_sequence_t* seq, uint64_t name_iid, int64_t value) {
+  seq->entry.size = 0;
+  pf_uint(&seq->entry, PF_ANNOTATION_NAME_IID, name_iid);
+  pf_uint(&seq->entry, PF_ANNOTATION_INT_VALUE, (uint64_t)value);
+  pf_message(&seq->event, PF_EVENT_DEBUG_ANNOTATIONS, &seq->entry);
+}
+
+/**
+ * Encode a packet with the specified data and the interned data added so far, and append it
+ * to the packets of the sequence. The first packet with a track event clears the interned
+ * data of the sequence and interns the names of event types and debug annotations.
+ */
+static void pf_finish_packet(pf_sequence_t* seq, int tid, int64_t timestamp, int data_field, pf_bytes_t* data) {
+  if (timestamp != INT64_MIN) {
+    pf_uint(&seq->packet, PF_PACKET_TIMESTAMP, (uint64_t)timestamp);
+  }
+  pf_uint(&seq->packet, PF_PACKET_SEQUENCE_ID, pf_sequence_id(tid));
+  if (data_field == PF_PACKET_TRACK_EVENT) {
+    uint64_t flags = PF_SEQ_NEEDS_INCREMENTAL_STATE;
+    if (!seq->started) {
+      flags |= PF_SEQ_INCREMENTAL_STATE_CLEARED;
+      for (int event_type = 0; event_type < NUM_EVENT_TYPES; event_type++) {
+        pf_intern(seq, PF_INTERNED_EVENT_NAMES, PF_EVENT_TYPE_IID(event_type), trace_event_names[event_type], "");
+      }
+      pf_intern(seq, PF_INTERNED_ANNOTATION_NAMES, PF_LOGICAL_TIME_IID, "elapsed_logical_time", "");
+      pf_intern(seq, PF_INTERNED_ANNOTATION_NAMES, PF_MICROSTEP_IID, "microstep", "");
+      pf_intern(seq, PF_INTERNED_ANNOTATION_NAMES, PF_EXTRA_DELAY_IID, "extra_delay", "");
+      seq->started = true;
+    }
+    pf_uint(&seq->packet, PF_PACKET_SEQUENCE_FLAGS, flags);
+  }
+  if (seq->interned.size > 0) {
+    pf_message(&seq->packet, PF_PACKET_INTERNED_DATA, &seq->interned);
+  }
+  pf_message(&seq->packet, data_field, data);
+  pf_message(&seq->out, PF_TRACE_PACKET, &seq->packet);
+}
+
+/** Write the packets of the sequence to the file. This assumes the caller holds the trace mutex. */
+static void pf_flush_locked(pf_sequence_t* seq) {
+  if (trace_file != NULL && seq->out.size > 0 && fwrite(seq->out.data, 1, seq->out.size, trace_file) != seq->out.size) {
+    fprintf(stderr, "WARNING: Access to trace file failed.\n");
+    fclose(trace_file);
+    trace_file = NULL;
+  }
+  seq->out.size = 0;
+}
+
+/** Append the descriptor of a track of the process to the sequence. */
+static void pf_describe_track(pf_sequence_t* seq, int tid, uint64_t uuid, const char* name, bool counter) {
+  pf_bytes_t* descriptor = &seq->event;
+  descriptor->size = 0;
+  pf_uint(descriptor, PF_TRACK_UUID, uuid);
+  pf_uint(descriptor, PF_TRACK_PARENT_UUID, process_uuid);
+  pf_string(descriptor, PF_TRACK_NAME, name);
+  if (counter) {
+    // An empty CounterDescriptor.
+    pf_key(descriptor, PF_TRACK_COUNTER, PF_LENGTH_DELIMITED);
+    pf_varint(descriptor, 0);
+  }
+  pf_finish_packet(seq, tid, INT64_MIN, PF_PACKET_TRACK_DESCRIPTOR, descriptor);
+}
+
+/**
+ * Return an ID for the flow of a federated message that both its sender and its receiver compute.
+ * @param message The type of message, counted from send_ACK or receive_ACK.
+ */
+static uint64_t pf_flow_id(int message, int sender, int receiver, int64_t time, int64_t microstep) {
+  uint64_t words[] = {(uint64_t)message, (uint64_t)sender, (uint64_t)receiver, (uint64_t)time, (uint64_t)microstep};
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+    hash = (hash ^ words[i]) * 0x100000001b3ULL;
+  }
+  return hash == 0 ? 1 : hash;
+}
+
+/** Encode a record as a packet of the sequence of the specified thread. */
+static void pf_encode_record(pf_sequence_t* seq, int tid, trace_record_nodeps_t* tr) {
+  int type = PF_INSTANT;
+  uint64_t track = PF_THREAD_TRACK(tid);
+  uint64_t name_iid = PF_EVENT_TYPE_IID(tr->event_type);
+  bool has_tag = tr->logical_time != INT64_MIN;
+  seq->event.size = 0;
+  switch (tr->event_type) {
+  case reaction_starts:
+    type = PF_SLICE_BEGIN;
+    name_iid = pf_object_iid(seq, tr->event_type, tr->pointer, NULL, tr->dst_id);
+    break;
+  case worker_wait_starts:
+  case mutex_wait_starts:
+    type = PF_SLICE_BEGIN;
+    break;
+  case scheduler_advancing_time_starts:
+    type = PF_SLICE_BEGIN;
+    track = PF_SCHEDULER_TRACK;
+    break;
+  case reaction_ends:
+  case worker_wait_ends:
+  case mutex_wait_ends:
+  case scheduler_advancing_time_ends:
+    type = PF_SLICE_END;
+    track = tr->event_type == scheduler_advancing_time_ends ? PF_SCHEDULER_TRACK : track;
+    name_iid = 0;
+    has_tag = false;
+    break;
+  case reaction_deadline_missed:
+    track = PF_DEADLINES_TRACK;
+    name_iid = pf_object_iid(seq, tr->event_type, tr->pointer, NULL, tr->dst_id);
+    break;
+  case schedule_called:
+    track = PF_SCHEDULE_TRACK;
+    name_iid = pf_object_iid(seq, tr->event_type, tr->pointer, tr->trigger, 0);
+    break;
+  case user_event:
+    track = PF_USER_TRACK;
+    name_iid = pf_object_iid(seq, tr->event_type, tr->pointer, NULL, 0);
+    break;
+  case user_value: {
+    pf_object_t* object = pf_lookup(tr->pointer, NULL);
+    if (object == NULL) {
+      track = PF_USER_TRACK;
+      break;
+    }
+    type = PF_COUNTER;
+    track = PF_COUNTER_TRACK(object->index);
+    name_iid = 0;
+    has_tag = false;
+    if (!__atomic_exchange_n(&object->counter_described, 1, __ATOMIC_RELAXED)) {
+      pf_describe_track(seq, tid, track, object->description != NULL ? object->description : "User value", true);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+  pf_uint(&seq->event, PF_EVENT_TYPE, (uint64_t)type);
+  pf_uint(&seq->event, PF_EVENT_TRACK_UUID, track);
+  if (name_iid != 0) {
+    pf_uint(&seq->event, PF_EVENT_NAME_IID, name_iid);
+  }
+  if (type == PF_COUNTER) {
+    pf_uint(&seq->event, PF_EVENT_COUNTER_VALUE, (uint64_t)tr->extra_delay);
+  }
+  if (has_tag) {
+    pf_annotate(seq, PF_LOGICAL_TIME_IID, tr->logical_time - start_time);
+    pf_annotate(seq, PF_MICROSTEP_IID, tr->microstep);
+  }
+  if (tr->event_type == schedule_called) {
+    pf_annotate(seq, PF_EXTRA_DELAY_IID, tr->extra_delay);
+  }
+  // A message is sent from src_id to dst_id, and received by src_id from dst_id, where -1 is the RTI.
+  if (has_tag && tr->event_type >= send_ACK && tr->event_type <= send_ADR_QR) {
+    pf_fixed64(&seq->event, PF_EVENT_FLOW_IDS,
+               pf_flow_id(tr->event_type - send_ACK, tr->src_id, tr->dst_id, tr->logical_time, tr->microstep));
+  } else if (has_tag && tr->event_type >= receive_ACK && tr->event_type <= receive_ADR_QR) {
+    pf_fixed64(&seq->event, PF_EVENT_TERMINATING_FLOW_IDS,
+               pf_flow_id(tr->event_type - receive_ACK, tr->dst_id, tr->src_id, tr->logical_time, tr->microstep));
+  }
+  pf_finish_packet(seq, tid, tr->physical_time, PF_PACKET_TRACK_EVENT, &seq->event);
+}
+
+// IMPLEMENTATION OF VERSION API *********************************************
+
+const version_t* lf_version_tracing() { return &version; }
+
+// IMPLEMENTATION OF TRACE API ***********************************************
+
+void lf_tracing_register_trace_event(object_description_t description) {
+  lf_platform_mutex_lock(trace_mutex);
+  if (objects_size >= PERFETTO_OBJECT_TABLE_SIZE / 2) {
+    lf_platform_mutex_unlock(trace_mutex);
+    fprintf(stderr, "WARNING: Exceeded trace object table size. Trace file will be incomplete.\n");
+    return;
+  }
+  size_t slot = pf_hash(description.pointer, description.trigger);
+  while (objects[slot].used) {
+    if (objects[slot].pointer == description.pointer && objects[slot].trigger == description.trigger) {
+      // Already registered.
+      lf_platform_mutex_unlock(trace_mutex);
+      return;
+    }
+    slot = (slot + 1) & (PERFETTO_OBJECT_TABLE_SIZE - 1);
+  }
+  objects[slot].pointer = description.pointer;
+  objects[slot].trigger = description.trigger;
+  objects[slot].type = description.type;
+  objects[slot].description = description.description;
+  objects[slot].index = objects_size++;
+  // Threads that are tracing look up objects without the mutex.
+  __atomic_store_n(&objects[slot].used, 1, __ATOMIC_RELEASE);
+  lf_platform_mutex_unlock(trace_mutex);
+}
+
+void lf_tracing_tracepoint(int worker, trace_record_nodeps_t* tr) {
+  (void)worker;
+  // Each thread created by LF encodes into its own sequence. Other threads share one.
+  int tid = lf_thread_id();
+  if (tid < 0) {
+    lf_platform_mutex_lock(trace_mutex);
+    if (!stopped) {
+      pf_encode_record(&sequences[-1], -1, tr);
+      if (sequences[-1].out.size >= PERFETTO_BUFFER_CAPACITY) {
+        pf_flush_locked(&sequences[-1]);
+      }
+    }
+    lf_platform_mutex_unlock(trace_mutex);
+    return;
+  }
+  if (tid >= number_of_sequences) {
+    fprintf(stderr, "ERROR: The thread id (%d) exceeds the number of trace sequences (%d).\n", tid,
+            number_of_sequences);
+    exit(1);
+  }
+  if (stopped) {
+    return;
+  }
+  pf_sequence_t* seq = &sequences[tid];
+  pf_encode_record(seq, tid, tr);
+  if (seq->out.size >= PERFETTO_BUFFER_CAPACITY) {
+    lf_platform_mutex_lock(trace_mutex);
+    pf_flush_locked(seq);
+    lf_platform_mutex_unlock(trace_mutex);
+  }
+}
+
+void lf_tracing_global_init(char* process_name, char* process_names, int fedid, int max_num_local_threads) {
+  (void)process_names;
+  trace_mutex = lf_platform_mutex_new();
+  if (!trace_mutex) {
+    fprintf(stderr, "WARNING: Failed to initialize trace mutex.\n");
+    exit(1);
+  }
+  process_id = fedid;
+  process_uuid = (uint64_t)(fedid + 2) << 32;
+  char filename[PERFETTO_MAX_FILENAME_LENGTH];
+  if (strcmp(process_name, "rti") == 0) {
+    snprintf(filename, sizeof(filename), "%s.pftrace", process_name);
+  } else {
+    snprintf(filename, sizeof(filename), "%s_%d.pftrace", process_name, process_id);
+  }
+  trace_file = fopen(filename, "wb");
+  if (trace_file == NULL) {
+    fprintf(stderr,
+            "WARNING: Failed to open log file with error code %d."
+            "No log will be written.\n",
+            errno);
+  }
+  number_of_sequences = max_num_local_threads;
+  sequences = (pf_sequence_t*)calloc(number_of_sequences + 1, sizeof(pf_sequence_t));
+  sequences++; // The sequence at index -1 is shared by threads not created by LF.
+  for (int i = -1; i < number_of_sequences; i++) {
+    sequences[i].interned_objects = (uint8_t*)calloc(PERFETTO_OBJECT_TABLE_SIZE / 2 * 64 / 8, 1);
+  }
+
+  // Describe the process and its tracks.
+  pf_sequence_t* seq = &sequences[-1];
+  pf_bytes_t* descriptor = &seq->event;
+  pf_uint(descriptor, PF_TRACK_UUID, process_uuid);
+  seq->entry.size = 0;
+  pf_uint(&seq->entry, PF_PROCESS_PID, (uint64_t)(fedid + 2));
+  pf_string(&seq->entry, PF_PROCESS_NAME, process_name);
+  pf_message(descriptor, PF_TRACK_PROCESS, &seq->entry);
+  pf_finish_packet(seq, -1, INT64_MIN, PF_PACKET_TRACK_DESCRIPTOR, descriptor);
+  pf_describe_track(seq, -1, PF_SCHEDULER_TRACK, "Scheduler advancing time", false);
+  pf_describe_track(seq, -1, PF_DEADLINES_TRACK, "Deadline misses", false);
+  pf_describe_track(seq, -1, PF_SCHEDULE_TRACK, "Schedule calls", false);
+  pf_describe_track(seq, -1, PF_USER_TRACK, "User events", false);
+  pf_describe_track(seq, -1, PF_THREAD_TRACK(-1), "Other threads", false);
+  for (int i = 0; i < number_of_sequences; i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "Thread %d", i);
+    pf_describe_track(seq, -1, PF_THREAD_TRACK(i), name, false);
+  }
+}
+
+void lf_tracing_dump() {
+  // All records are written.
+}
+
+size_t lf_tracing_memory_size() {
+  if (sequences == NULL) {
+    return 0;
+  }
+  // The capacities may be read while they grow, which only makes the size approximate.
+  size_t size = (size_t)(number_of_sequences + 1) * (sizeof(pf_sequence_t) + PERFETTO_OBJECT_TABLE_SIZE / 2 * 64 / 8);
+  for (int i = -1; i < number_of_sequences; i++) {
+    pf_sequence_t* seq = &sequences[i];
+    size += seq->out.capacity + seq->packet.capacity + seq->event.capacity + seq->interned.capacity +
+            seq->entry.capacity;
+  }
+  return size;
+}
+
+void lf_tracing_set_start_time(int64_t time) { start_time = time; }
+
+void lf_tracing_global_shutdown() {
+  lf_platform_mutex_lock(trace_mutex);
+  stopped = true;
+  for (int i = -1; i < number_of_sequences; i++) {
+    pf_flush_locked(&sequences[i]);
+    free(sequences[i].out.data);
+    free(sequences[i].packet.data);
+    free(sequences[i].event.data);
+    free(sequences[i].interned.data);
+    free(sequences[i].entry.data);
+    free(sequences[i].interned_objects);
+  }
+  free(sequences - 1);
+  sequences = NULL;
+  if (trace_file != NULL) {
+    fclose(trace_file);
+    trace_file = NULL;
+  }
+  lf_platform_mutex_unlock(trace_mutex);
+  lf_platform_mutex_free(trace_mutex);
+}
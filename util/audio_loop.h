@@ -12,7 +12,9 @@
  * you would like the loop to start.  To play a waveform,
  * call `lf_play_audio_waveform()`.  A waveform may be
  * synthesized or read from a .wav file using
- * `read_wave_file()` (see wave_file_reader.h).
+ * `read_wave_file()` or `map_wave_file()` (see wave_file_reader.h).
+ * To play a large .wav file without loading it, open it with
+ * `open_wave_stream()` and call `lf_play_audio_stream()`.
  *
  * To use this, include the following in your target properties:
  * <pre>
@@ -50,6 +52,14 @@
 
 #define NUM_NOTES 8 // Maximum number of notes that can play simultaneously.
 
+/**
+ * Counters of audio glitches since the audio loop started.
+ */
+typedef struct lf_audio_loop_stats_t {
+  uint64_t underruns; // The number of times the audio hardware ran out of samples.
+  uint64_t overruns;  // The number of notes dropped because too many were pending.
+} lf_audio_loop_stats_t;
+
 /**
  * Start an audio loop thread that becomes ready to receive
  * audio amplitude samples via add_to_sound(). If there is
@@ -74,7 +84,8 @@ void lf_stop_audio_loop();
  * (beyond the window of the current audio write buffer), then
  * block until the audio output catches up. If the audio playback
  * has already passed the specified point, then play the waveform
- * as soon as possible and return 1.
+ * as soon as possible and return 1. If too many notes are pending
+ * for the audio loop to take them, drop the note and return -1.
  * Otherwise, return 0.
  *
  * @param waveform The waveform to play or NULL to just play a tick.
@@ -83,4 +94,24 @@ void lf_stop_audio_loop();
  */
 int lf_play_audio_waveform(lf_waveform_t* waveform, float emphasis, instant_t start_time);
 
+/**
+ * Play a wave file that is read in chunks with the specified emphasis
+ * at the specified time, as lf_play_audio_waveform() does for a waveform.
+ * The audio loop reads a chunk from the stream whenever it has played the
+ * previous one, so the file never needs to be in memory as a whole.
+ * The chunks should hold at least AUDIO_BUFFER_SIZE frames. The stream
+ * must not be closed until it has been played or replaced by another note.
+ *
+ * @param stream The stream returned by open_wave_stream().
+ * @param emphasis The emphasis (0.0 for silence, 1.0 for waveform volume).
+ * @param start_time The time to start playing the stream.
+ * @return 1 if the audio playback has already passed the start time, -1 if the note was dropped, and 0 otherwise.
+ */
+int lf_play_audio_stream(lf_wave_stream_t* stream, float emphasis, instant_t start_time);
+
+/**
+ * Return the counters of audio glitches. This may be called from any thread.
+ */
+lf_audio_loop_stats_t lf_audio_loop_stats();
+
 #endif // AUDIO_LOOP_H
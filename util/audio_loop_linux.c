@@ -26,24 +26,28 @@
 // Audio device to use for playback
 #define AUDIO_DEVICE "default"
 
+// Serializes the callers of lf_play_audio_waveform(), so that there is a single producer of
+// note requests. The audio thread never acquires it.
 pthread_mutex_t lf_audio_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t lf_audio_cond = PTHREAD_COND_INITIALIZER;
 
-// Pointer to the buffer into which to currently write.
-// This is null before the buffer is ready.
+// Pointer to the buffer into which the audio thread currently mixes.
 int16_t* next_buffer = NULL;
+// The logical time that aligns with the start of next_buffer. Written only by the audio thread.
 instant_t next_buffer_start_time = NEVER;
 
 snd_pcm_t* playback_handle;
 snd_async_handler_t* pcm_callback;
 
 struct note {
-  lf_waveform_t* waveform;
-  int position;  // Starts at 0 when note starts.
-  double volume; // 0.0 for not active.
+  lf_waveform_t* waveform;  // NULL for a tick.
+  int position;             // Starts at 0 when note starts.
+  double volume;            // 0.0 for not active.
+  lf_wave_stream_t* stream; // If not NULL, the waveform is the current chunk of this stream.
+  bool active;              // Whether the note is waiting to start or playing.
+  long offset;              // The index in the next buffer at which the note starts, or 0 once it has started.
 };
 
-// Array keeping track of notes being played.
+// Array keeping track of notes being played. Accessed only by the audio thread.
 struct note notes[NUM_NOTES] = {0};
 
 // Notes are added sequentially.
@@ -52,6 +56,29 @@ struct note notes[NUM_NOTES] = {0};
 // yet finished playing, it will be replaced by the new note.
 int note_counter = 0;
 
+/** The number of note requests that can be pending until the audio thread takes them (a power of 2). */
+#define NOTE_REQUEST_QUEUE_SIZE 64
+
+/** A request to play a note, passed from lf_play_audio_waveform() to the audio thread. */
+typedef struct {
+  lf_waveform_t* waveform;
+  lf_wave_stream_t* stream;
+  float emphasis;
+  instant_t start_time;
+} note_request_t;
+
+// Single-producer single-consumer ring of preallocated note requests. Positions increase
+// monotonically and are taken modulo NOTE_REQUEST_QUEUE_SIZE. The producer publishes
+// a request by storing note_requests_tail with release semantics, and the audio thread
+// frees its slot by storing note_requests_head with release semantics.
+note_request_t note_requests[NOTE_REQUEST_QUEUE_SIZE];
+size_t note_requests_head = 0; // The next request to take. Written only by the audio thread.
+size_t note_requests_tail = 0; // The next slot to fill. Written only under lf_audio_mutex.
+
+// Counters reported by lf_audio_loop_stats().
+uint64_t audio_underruns = 0;
+uint64_t audio_overruns = 0;
+
 /**
  * Add the given value to the current write buffer at the specified index.
  * If the resulting value is larger than what can be represented in
@@ -69,64 +96,125 @@ void add_to_sound(int index_offset, double value) {
   next_buffer[index_offset] = (int16_t)sample_value;
 }
 
+/**
+ * Advance the note to its next frame. If the note is played from a stream and
+ * the current chunk has been played, read the next chunk. If the note has
+ * finished, reset it.
+ * @param note_instance The note.
+ * @return true if the note has more frames to play.
+ */
+static bool advance_note(struct note* note_instance) {
+  note_instance->position += note_instance->waveform->num_channels;
+  if (note_instance->stream != NULL) {
+    if (note_instance->position < note_instance->waveform->length) {
+      return true;
+    }
+    // With chunks of at least AUDIO_BUFFER_SIZE frames, this reads the file at most once per buffer.
+    note_instance->waveform = read_wave_stream(note_instance->stream);
+    note_instance->position = 0;
+    if (note_instance->waveform->length > 0) {
+      return true;
+    }
+  } else if (note_instance->position < note_instance->waveform->length - note_instance->waveform->num_channels) {
+    return true;
+  }
+  // Reached the end of the note. Reset the note.
+  note_instance->volume = 0.0;
+  note_instance->position = 0;
+  note_instance->waveform = NULL;
+  note_instance->stream = NULL;
+  return false;
+}
+
+/**
+ * Turn the pending note requests into notes. Called only by the audio thread.
+ */
+static void take_note_requests() {
+  size_t head = note_requests_head;
+  size_t tail = __atomic_load_n(&note_requests_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++) {
+    note_request_t* request = &note_requests[head % NOTE_REQUEST_QUEUE_SIZE];
+    instant_t time_offset = request->start_time - next_buffer_start_time;
+    if (request->waveform != NULL && request->waveform->length == 0) {
+      // Play nothing.
+      continue;
+    }
+    struct note* note_instance = &notes[note_counter++]; // Increment so that the next note uses a new slot.
+    if (note_counter >= NUM_NOTES) {
+      note_counter = 0; // Wrap around.
+    }
+    note_instance->waveform = request->waveform;
+    note_instance->stream = request->stream;
+    note_instance->volume = request->emphasis;
+    note_instance->position = 0;
+    note_instance->active = true;
+    // If the audio has passed the requested time, play the note as soon as possible.
+    note_instance->offset = time_offset > 0 ? (long)((time_offset * SAMPLE_RATE) / BILLION) : 0;
+  }
+  __atomic_store_n(&note_requests_head, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * Add as much of a note into next_buffer as will fit.
+ * @param note_instance The note.
+ */
+static void mix_note(struct note* note_instance) {
+  if (note_instance->offset >= AUDIO_BUFFER_SIZE) {
+    // The note starts in a later buffer.
+    note_instance->offset -= AUDIO_BUFFER_SIZE;
+    return;
+  }
+  int i = (int)note_instance->offset;
+  note_instance->offset = 0;
+  if (note_instance->waveform == NULL) {
+    add_to_sound(i, MAX_AMPLITUDE * note_instance->volume);
+    note_instance->active = false;
+    return;
+  }
+  for (; i < AUDIO_BUFFER_SIZE; i++) {
+    // Calculate the value to add to the sound by averaging all the channels.
+    int value = 0;
+    for (int channel = 0; channel < note_instance->waveform->num_channels; channel++) {
+      value += note_instance->waveform->waveform[note_instance->position + channel];
+    }
+    value = value / note_instance->waveform->num_channels;
+    add_to_sound(i, value * note_instance->volume);
+
+    if (!advance_note(note_instance)) {
+      note_instance->active = false;
+      break;
+    }
+  }
+}
+
 /**
  * Function that is called by the audio loop to fill the audio buffer
- * with the next batch of audio data.  When this callback occurs,
- * this grabs the mutex lock, copies the buffer that the main program
- * has been filling into the destination buffer, clears the next
- * buffer, and updates the start time of the next buffer.
+ * with the next batch of audio data. This updates the start time of
+ * the buffer, takes the pending note requests, mixes the notes into the
+ * buffer, and writes it to the hardware. It neither locks nor allocates.
  * @param playback_handle Handle for the audio interface
  * @param buffer_ref Reference to the buffer of size AUDIO_BUFFER_SIZE to be copied to the hardware
  */
 int callback(snd_pcm_t* playback_handle, int16_t buf_ref[]) {
   int error_number;
-  pthread_mutex_lock(&lf_audio_mutex);
 
-  // next_buffer = buf_ref;
   next_buffer = buf_ref;
-  // memset(next_buffer, 0, AUDIO_BUFFER_SIZE * sizeof(int16_t));
-
-  // Clear out the next buffer.
-  next_buffer_start_time += BUFFER_DURATION_NS;
+  // Callers read the start time to pace themselves and to detect late notes.
+  __atomic_store_n(&next_buffer_start_time, next_buffer_start_time + BUFFER_DURATION_NS, __ATOMIC_RELEASE);
 
-  // Fill the buffer with any trailing sample data that
-  // didn't fit in the previous buffer.
+  take_note_requests();
   for (int note_to_use = 0; note_to_use < NUM_NOTES; note_to_use++) {
-    struct note* note_instance = &(notes[note_to_use]);
-
-    // Add as much of the note instance into the buffer as will fit.
-    for (int i = 0; i < AUDIO_BUFFER_SIZE; i++) {
-      if (note_instance->waveform == NULL || note_instance->volume == 0.0) {
-        continue;
-      }
-      // Calculate the value to add to the sound by averaging all the channels.
-      int value = 0;
-      for (int channel = 0; channel < note_instance->waveform->num_channels; channel++) {
-        value += note_instance->waveform->waveform[note_instance->position + channel];
-      }
-      value = value / note_instance->waveform->num_channels;
-      add_to_sound(i, value * note_instance->volume);
-
-      note_instance->position += note_instance->waveform->num_channels;
-      if (note_instance->position >= note_instance->waveform->length - note_instance->waveform->num_channels) {
-        // Reached the end of the note. Reset the note.
-        note_instance->volume = 0.0;
-        note_instance->position = 0;
-        note_instance->waveform = NULL;
-        break;
-      }
+    if (notes[note_to_use].active) {
+      mix_note(&notes[note_to_use]);
     }
   }
 
   // Reinsert this same audio buffer at the end of the queue.
   if ((error_number = snd_pcm_writei(playback_handle, buf_ref, AUDIO_BUFFER_SIZE)) < 0) {
-    lf_print_error("Writing to sound buffer failed: %s", snd_strerror(error_number));
+    // The hardware ran out of data before this buffer arrived. Recover without blocking.
+    __atomic_add_fetch(&audio_underruns, 1, __ATOMIC_RELAXED);
+    snd_pcm_prepare(playback_handle);
   }
-
-  // In case the other thread is waiting for this event, notify
-  // (the other thread should not be waiting).
-  pthread_cond_signal(&lf_audio_cond);
-  pthread_mutex_unlock(&lf_audio_mutex);
   return error_number;
 }
 
@@ -221,7 +309,7 @@ void* run_audio_loop(void* ignored) {
   int16_t buffer[buffer_size_bytes];
   memset(buffer, 0, buffer_size_bytes * sizeof(int16_t));
   int head = 0;
-  while (!stop_audio) {
+  while (!__atomic_load_n(&stop_audio, __ATOMIC_ACQUIRE)) {
     /*
      * Wait until the interface is ready for data, or BUFFER_DURATION_NS
      * has elapsed.
@@ -236,7 +324,9 @@ void* run_audio_loop(void* ignored) {
 
     if ((frames_to_deliver = snd_pcm_avail_update(playback_handle)) < 0) {
       if (frames_to_deliver == -EPIPE) {
-        lf_print_error("An xrun occured\n");
+        // An xrun occurred.
+        __atomic_add_fetch(&audio_underruns, 1, __ATOMIC_RELAXED);
+        snd_pcm_prepare(playback_handle);
         continue;
       } else {
         lf_print_error("Unknown ALSA avail update return value (%d)\n", frames_to_deliver);
@@ -258,7 +348,6 @@ void* run_audio_loop(void* ignored) {
     }
     // Clear out the next buffer.
     memset(&(buffer[head]), 0, AUDIO_BUFFER_SIZE * sizeof(int16_t));
-    next_buffer = &(buffer[head]);
   }
 
   snd_pcm_close(playback_handle);
@@ -291,81 +380,54 @@ void lf_start_audio_loop(instant_t start_time) {
   pthread_create(&loop_thread_id, NULL, &run_audio_loop, NULL);
 }
 
-void lf_stop_audio_loop() { stop_audio = true; }
-
-int lf_play_audio_waveform(lf_waveform_t* waveform, float emphasis, instant_t start_time) {
-  int result = 0;
-  pthread_mutex_lock(&lf_audio_mutex);
-
-  // If the buffer into which to write has not yet been set up, wait.
-  while (next_buffer == NULL) {
-    pthread_cond_wait(&lf_audio_cond, &lf_audio_mutex);
-  }
-  instant_t time_offset = start_time - next_buffer_start_time;
+void lf_stop_audio_loop() { __atomic_store_n(&stop_audio, true, __ATOMIC_RELEASE); }
 
-  // If this is late, then tick right away.
-  if (time_offset < 0) {
-    // printf("WARNING: audio has passed the specified time by %lld.\n", time_offset);
-    time_offset = 0;
-    result = 1;
-  }
-  // Calculate the index of the tick.
-  size_t index_offset = (time_offset * SAMPLE_RATE) / BILLION;
-
-  // If the offset is beyond the end of the audio buffer, then the program
-  // has gotten ahead of the audio. Wait for audio to catch up.
-  // This happens when a timestamp is at or close to the start time
-  // for the buffer because the audio system has not yet invoked the
-  // callback to swap buffers.  Here, we wait for the callback to
-  // occur.
-  while (index_offset >= AUDIO_BUFFER_SIZE) {
-    pthread_cond_wait(&lf_audio_cond, &lf_audio_mutex);
-    // next_buffer_start_time has been incremented by BUFFER_DURATION_NS.
-    time_offset = start_time - next_buffer_start_time;
-    // time_offset should be >= 0, but just in case:
-    if (time_offset < 0) {
-      time_offset = 0;
-      result = 1;
-    }
-    index_offset = (time_offset * SAMPLE_RATE) / BILLION;
+/**
+ * Pass a request to play a note at the specified time to the audio thread,
+ * as described for lf_play_audio_waveform().
+ * @param waveform The waveform to play or NULL to just play a tick.
+ * @param stream If not NULL, the stream of which waveform is the first chunk.
+ * @param emphasis The emphasis (0.0 for silence, 1.0 for waveform volume).
+ * @param start_time The time to start playing the waveform.
+ */
+static int play_note(lf_waveform_t* waveform, lf_wave_stream_t* stream, float emphasis, instant_t start_time) {
+  // If the audio loop has not started or the time is beyond the buffer after the one
+  // being played, then the program has gotten ahead of the audio. Wait for audio to
+  // catch up. The audio thread does not signal, so that it never has to lock.
+  instant_t buffer_start_time = __atomic_load_n(&next_buffer_start_time, __ATOMIC_ACQUIRE);
+  while (buffer_start_time == NEVER || start_time - buffer_start_time >= 2 * BUFFER_DURATION_NS) {
+    usleep(BUFFER_DURATION_NS / 10000); // A tenth of the buffer duration.
+    buffer_start_time = __atomic_load_n(&next_buffer_start_time, __ATOMIC_ACQUIRE);
   }
 
-  if (waveform == NULL) {
-    // Waveform ID is out of range. Just emit a tick.
-    add_to_sound(index_offset, MAX_AMPLITUDE * emphasis);
-  } else {
-    int note_to_use = note_counter++; // Increment so that the next note uses a new slot.
-    if (note_counter >= NUM_NOTES) {
-      note_counter = 0; // Wrap around.
-    }
-    // Initialize the note instance to start playing.
-    struct note* note_instance = &notes[note_to_use];
-    note_instance->waveform = waveform;
-    // If the waveform length is 0, do not play anything.
-    if (waveform->length > 0) {
-      note_instance->volume = emphasis;
-      note_instance->position = 0;
-
-      // Add as much of the note instance into the buffer as will fit.
-      for (int i = index_offset; i < AUDIO_BUFFER_SIZE; i++) {
-        // Calculate the value to add to the sound by averaging all the channels.
-        int value = 0;
-        for (int channel = 0; channel < waveform->num_channels; channel++) {
-          value += waveform->waveform[note_instance->position + channel];
-        }
-        value = value / waveform->num_channels;
-        add_to_sound(i, value * emphasis);
-
-        note_instance->position += note_instance->waveform->num_channels;
-        if (note_instance->position >= note_instance->waveform->length - note_instance->waveform->num_channels) {
-          // Reached the end of the note. Reset the note.
-          note_instance->volume = 0.0;
-          note_instance->position = 0;
-          break;
-        }
-      }
-    }
+  pthread_mutex_lock(&lf_audio_mutex);
+  size_t tail = note_requests_tail;
+  if (tail - __atomic_load_n(&note_requests_head, __ATOMIC_ACQUIRE) >= NOTE_REQUEST_QUEUE_SIZE) {
+    // The audio thread has not taken the pending requests. Drop this one.
+    pthread_mutex_unlock(&lf_audio_mutex);
+    __atomic_add_fetch(&audio_overruns, 1, __ATOMIC_RELAXED);
+    return -1;
   }
+  note_requests[tail % NOTE_REQUEST_QUEUE_SIZE] = (note_request_t){waveform, stream, emphasis, start_time};
+  __atomic_store_n(&note_requests_tail, tail + 1, __ATOMIC_RELEASE);
   pthread_mutex_unlock(&lf_audio_mutex);
-  return result;
+
+  // The buffer starting at buffer_start_time has already been mixed.
+  return start_time < buffer_start_time + BUFFER_DURATION_NS ? 1 : 0;
+}
+
+int lf_play_audio_waveform(lf_waveform_t* waveform, float emphasis, instant_t start_time) {
+  return play_note(waveform, NULL, emphasis, start_time);
+}
+
+int lf_play_audio_stream(lf_wave_stream_t* stream, float emphasis, instant_t start_time) {
+  // Read the first chunk in the calling thread.
+  return play_note(read_wave_stream(stream), stream, emphasis, start_time);
+}
+
+lf_audio_loop_stats_t lf_audio_loop_stats() {
+  lf_audio_loop_stats_t stats;
+  stats.underruns = __atomic_load_n(&audio_underruns, __ATOMIC_RELAXED);
+  stats.overruns = __atomic_load_n(&audio_overruns, __ATOMIC_RELAXED);
+  return stats;
 }
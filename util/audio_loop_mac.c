@@ -14,6 +14,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <stdbool.h>
 #include "audio_loop.h"
 #include <unistd.h>
 #include "AudioToolbox/AudioToolbox.h"
@@ -28,8 +29,9 @@ instant_t next_buffer_start_time = NEVER;
 
 struct note {
   lf_waveform_t* waveform;
-  int position;  // Starts at 0 when note starts.
-  double volume; // 0.0 for not active.
+  int position;             // Starts at 0 when note starts.
+  double volume;            // 0.0 for not active.
+  lf_wave_stream_t* stream; // If not NULL, the waveform is the current chunk of this stream.
 };
 
 // Array keeping track of notes being played.
@@ -58,6 +60,36 @@ void add_to_sound(int index_offset, double value) {
   next_buffer[index_offset] = (int16_t)sample_value;
 }
 
+/**
+ * Advance the note to its next frame. If the note is played from a stream and
+ * the current chunk has been played, read the next chunk. If the note has
+ * finished, reset it.
+ * @param note_instance The note.
+ * @return true if the note has more frames to play.
+ */
+static bool advance_note(struct note* note_instance) {
+  note_instance->position += note_instance->waveform->num_channels;
+  if (note_instance->stream != NULL) {
+    if (note_instance->position < note_instance->waveform->length) {
+      return true;
+    }
+    // With chunks of at least AUDIO_BUFFER_SIZE frames, this reads the file at most once per buffer.
+    note_instance->waveform = read_wave_stream(note_instance->stream);
+    note_instance->position = 0;
+    if (note_instance->waveform->length > 0) {
+      return true;
+    }
+  } else if (note_instance->position < note_instance->waveform->length - note_instance->waveform->num_channels) {
+    return true;
+  }
+  // Reached the end of the note. Reset the note.
+  note_instance->volume = 0.0;
+  note_instance->position = 0;
+  note_instance->waveform = NULL;
+  note_instance->stream = NULL;
+  return false;
+}
+
 /**
  * Function that is called by the audio loop to fill the audio buffer
  * with the next batch of audio data.  When this callback occurs,
@@ -97,12 +129,7 @@ void callback(void* ignored, AudioQueueRef queue, AudioQueueBufferRef buf_ref) {
       value = value / note_instance->waveform->num_channels;
       add_to_sound(i, value * note_instance->volume);
 
-      note_instance->position += note_instance->waveform->num_channels;
-      if (note_instance->position >= note_instance->waveform->length - note_instance->waveform->num_channels) {
-        // Reached the end of the note. Reset the note.
-        note_instance->volume = 0.0;
-        note_instance->position = 0;
-        note_instance->waveform = NULL;
+      if (!advance_note(note_instance)) {
         break;
       }
     }
@@ -215,23 +242,13 @@ void lf_start_audio_loop(instant_t start_time) {
 void lf_stop_audio_loop() { CFRunLoopStop(CFRunLoopGetCurrent()); }
 
 /**
- * Play the specified waveform with the specified emphasis at
- * the specified time. If the waveform is null, play a simple tick
- * (an impulse). If the waveform has length zero or volume 0,
- * play nothing.
- *
- * If the time is too far in the future
- * (beyond the window of the current audio write buffer), then
- * block until the audio output catches up. If the audio playback
- * has already passed the specified point, then play the waveform
- * as soon as possible and return 1.
- * Otherwise, return 0.
- *
+ * Start playing a note at the specified time, as described for lf_play_audio_waveform().
  * @param waveform The waveform to play or NULL to just play a tick.
+ * @param stream If not NULL, the stream of which waveform is the first chunk.
  * @param emphasis The emphasis (0.0 for silence, 1.0 for waveform volume).
  * @param start_time The time to start playing the waveform.
  */
-int lf_play_audio_waveform(lf_waveform_t* waveform, float emphasis, instant_t start_time) {
+static int play_note(lf_waveform_t* waveform, lf_wave_stream_t* stream, float emphasis, instant_t start_time) {
   int result = 0;
   pthread_mutex_lock(&lf_audio_mutex);
 
@@ -279,6 +296,7 @@ int lf_play_audio_waveform(lf_waveform_t* waveform, float emphasis, instant_t st
     // Initialize the note instance to start playing.
     struct note* note_instance = &notes[note_to_use];
     note_instance->waveform = waveform;
+    note_instance->stream = stream;
     // If the waveform length is 0, do not play anything.
     if (waveform->length > 0) {
       note_instance->volume = emphasis;
@@ -288,22 +306,53 @@ int lf_play_audio_waveform(lf_waveform_t* waveform, float emphasis, instant_t st
       for (int i = index_offset; i < AUDIO_BUFFER_SIZE; i++) {
         // Calculate the value to add to the sound by averaging all the channels.
         int value = 0;
-        for (int channel = 0; channel < waveform->num_channels; channel++) {
-          value += waveform->waveform[note_instance->position + channel];
+        for (int channel = 0; channel < note_instance->waveform->num_channels; channel++) {
+          value += note_instance->waveform->waveform[note_instance->position + channel];
         }
-        value = value / waveform->num_channels;
+        value = value / note_instance->waveform->num_channels;
         add_to_sound(i, value * emphasis);
 
-        note_instance->position += note_instance->waveform->num_channels;
-        if (note_instance->position >= note_instance->waveform->length - note_instance->waveform->num_channels) {
-          // Reached the end of the note. Reset the note.
-          note_instance->volume = 0.0;
-          note_instance->position = 0;
+        if (!advance_note(note_instance)) {
           break;
         }
       }
+    } else {
+      // Do not keep playing a note that was replaced.
+      note_instance->volume = 0.0;
     }
   }
   pthread_mutex_unlock(&lf_audio_mutex);
   return result;
 }
+
+/**
+ * Play the specified waveform with the specified emphasis at
+ * the specified time. If the waveform is null, play a simple tick
+ * (an impulse). If the waveform has length zero or volume 0,
+ * play nothing.
+ *
+ * If the time is too far in the future
+ * (beyond the window of the current audio write buffer), then
+ * block until the audio output catches up. If the audio playback
+ * has already passed the specified point, then play the waveform
+ * as soon as possible and return 1.
+ * Otherwise, return 0.
+ *
+ * @param waveform The waveform to play or NULL to just play a tick.
+ * @param emphasis The emphasis (0.0 for silence, 1.0 for waveform volume).
+ * @param start_time The time to start playing the waveform.
+ */
+int lf_play_audio_waveform(lf_waveform_t* waveform, float emphasis, instant_t start_time) {
+  return play_note(waveform, NULL, emphasis, start_time);
+}
+
+int lf_play_audio_stream(lf_wave_stream_t* stream, float emphasis, instant_t start_time) {
+  // Read the first chunk before acquiring the mutex.
+  return play_note(read_wave_stream(stream), stream, emphasis, start_time);
+}
+
+lf_audio_loop_stats_t lf_audio_loop_stats() {
+  // Notes are never dropped here, and the audio queue does not report underruns.
+  lf_audio_loop_stats_t stats = {0, 0};
+  return stats;
+}
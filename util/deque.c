@@ -29,9 +29,9 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 @section DESCRIPTION
 
 This provides an implementation of a double-ended queue.
-Each node contains a void* pointer.
+Each element is a void* pointer, stored in a circular array that doubles
+in length when it is full.
 
-To use this, include the following in your target properties:
 To use this, include the following in your target properties:
 <pre>
 target C {
@@ -57,16 +57,26 @@ Alternatively, you can call initialize:
 </pre>
 */
 
+#include <string.h> // Defines memcpy
+
 #include "deque.h"
 
+/** Initial length of the array of a deque. */
+#define DEQUE_INITIAL_CAPACITY 16
+
 /**
- * A node in the queue.
+ * Return the index in the array of the element at the specified position from the front.
  */
-typedef struct deque_node_t {
-  struct deque_node_t* next;
-  struct deque_node_t* prev;
-  void* value;
-} deque_node_t;
+static inline size_t _deque_index(deque_t* d, size_t position) { return (d->front + position) & (d->capacity - 1); }
+
+/**
+ * Make room for one more element, aborting if memory cannot be allocated.
+ */
+static void _deque_grow_for_push(deque_t* d) {
+  if (d->size == d->capacity && !deque_reserve(d, d->size + 1)) {
+    abort();
+  }
+}
 
 /**
  * Initialize the specified deque to an empty deque.
@@ -74,19 +84,65 @@ typedef struct deque_node_t {
  */
 void deque_initialize(deque_t* d) {
   if (d != NULL) {
-    d->front = NULL;
-    d->back = NULL;
+    d->items = NULL;
+    d->capacity = 0;
+    d->front = 0;
     d->size = 0;
   }
 }
 
+/**
+ * Release the array of the specified deque and make it empty.
+ * @param d The deque.
+ */
+void deque_free(deque_t* d) {
+  if (d != NULL) {
+    free(d->items);
+    deque_initialize(d);
+  }
+}
+
+/**
+ * Make sure that the specified deque can hold `capacity` elements without allocating memory.
+ * @param d The deque.
+ * @param capacity The number of elements.
+ * @return true on success, or false if memory could not be allocated, in which case the deque is unchanged.
+ */
+bool deque_reserve(deque_t* d, size_t capacity) {
+  if (capacity <= d->capacity) {
+    return true;
+  }
+  size_t new_capacity = d->capacity == 0 ? DEQUE_INITIAL_CAPACITY : d->capacity;
+  while (new_capacity < capacity) {
+    new_capacity *= 2;
+  }
+  void** items = (void**)malloc(new_capacity * sizeof(void*));
+  if (items == NULL) {
+    return false;
+  }
+  // Unwrap the elements to the start of the new array.
+  size_t first = d->capacity - d->front;
+  if (first > d->size) {
+    first = d->size;
+  }
+  if (d->size > 0) {
+    memcpy(items, d->items + d->front, first * sizeof(void*));
+    memcpy(items + first, d->items, (d->size - first) * sizeof(void*));
+  }
+  free(d->items);
+  d->items = items;
+  d->capacity = new_capacity;
+  d->front = 0;
+  return true;
+}
+
 /**
  * Return true if the queue is empty.
  * @param d The deque.
  */
 bool deque_is_empty(deque_t* d) {
   if (d != NULL) {
-    return (d->front == NULL);
+    return (d->size == 0);
   }
   return true;
 }
@@ -98,35 +154,16 @@ bool deque_is_empty(deque_t* d) {
  */
 size_t deque_size(deque_t* d) { return d->size; }
 
-/**
- * Internal function to create a node to insert in the deque.
- * Users should not call this function. It is used internally
- * by deque_push_front and deque_push_back. It allocates memory
- * that is freed in popped using deque_pop_back and deque_pop_front.
- * @param value The payload of the node.
- */
-deque_node_t* _deque_create_node(void* value) {
-  deque_node_t* new_node = (deque_node_t*)calloc(1, sizeof(deque_node_t));
-  new_node->value = value;
-  return new_node;
-}
-
 /**
  * Push a value to the front of the queue.
  * @param d The queue.
  * @param value The value to push.
  */
 void deque_push_front(deque_t* d, void* value) {
-  deque_node_t* n = _deque_create_node(value);
-  if (d->front == NULL) {
-    d->back = d->front = n;
-    d->size = 1;
-  } else {
-    d->front->prev = n;
-    n->next = d->front;
-    d->front = n;
-    d->size++;
-  }
+  _deque_grow_for_push(d);
+  d->front = (d->front - 1) & (d->capacity - 1);
+  d->items[d->front] = value;
+  d->size++;
 }
 
 /**
@@ -135,16 +172,33 @@ void deque_push_front(deque_t* d, void* value) {
  * @param value The value to push.
  */
 void deque_push_back(deque_t* d, void* value) {
-  deque_node_t* n = _deque_create_node(value);
-  if (d->back == NULL) {
-    d->back = d->front = n;
-    d->size++;
-  } else {
-    d->back->next = n;
-    n->prev = d->back;
-    d->back = n;
-    d->size++;
+  _deque_grow_for_push(d);
+  d->items[_deque_index(d, d->size)] = value;
+  d->size++;
+}
+
+/**
+ * Push the specified values, in order, to the back of the queue.
+ * @param d The queue.
+ * @param values The values to push.
+ * @param count The number of values.
+ */
+void deque_push_back_n(deque_t* d, void* const* values, size_t count) {
+  if (count == 0) {
+    return;
   }
+  if (!deque_reserve(d, d->size + count)) {
+    abort();
+  }
+  // Copy in at most two runs, up to the end of the array and then from its start.
+  size_t back = _deque_index(d, d->size);
+  size_t first = d->capacity - back;
+  if (first > count) {
+    first = count;
+  }
+  memcpy(d->items + back, values, first * sizeof(void*));
+  memcpy(d->items, values + first, (count - first) * sizeof(void*));
+  d->size += count;
 }
 
 /**
@@ -153,20 +207,11 @@ void deque_push_back(deque_t* d, void* value) {
  * @return The value on the front of the queue or NULL if the queue is empty.
  */
 void* deque_pop_front(deque_t* d) {
-  if (d == NULL || d->front == NULL) {
+  if (d == NULL || d->size == 0) {
     return NULL;
   }
-
-  void* value = d->front->value;
-  deque_node_t* temp = d->front; // temporary pointer for freeing up memory
-
-  if (d->front == d->back) {
-    // popping last element in deque
-    d->front = d->back = NULL;
-  } else {
-    d->front = d->front->next;
-  }
-  free(temp); // free memory for popped node
+  void* value = d->items[d->front];
+  d->front = (d->front + 1) & (d->capacity - 1);
   d->size--;
   return value;
 }
@@ -177,21 +222,36 @@ void* deque_pop_front(deque_t* d) {
  * @return The value on the back of the queue or NULL if the queue is empty.
  */
 void* deque_pop_back(deque_t* d) {
-  if (d == NULL || d->back == NULL) {
+  if (d == NULL || d->size == 0) {
     return NULL;
   }
+  d->size--;
+  return d->items[_deque_index(d, d->size)];
+}
 
-  void* value = d->back->value;
-  deque_node_t* temp = d->back; // temporary pointer for freeing up memory
-  if (d->front == d->back) {
-    // popping last element in deque
-    d->front = d->back = NULL;
-  } else {
-    d->back = d->back->prev;
+/**
+ * Pop up to `count` values from the front of the queue, removing them from the queue.
+ * @param d The queue.
+ * @param values Where to store the values, in order from the front.
+ * @param count The maximum number of values to pop.
+ * @return The number of values popped.
+ */
+size_t deque_pop_front_n(deque_t* d, void** values, size_t count) {
+  if (d == NULL || d->size == 0) {
+    return 0;
   }
-  free(temp);
-  d->size--;
-  return value;
+  if (count > d->size) {
+    count = d->size;
+  }
+  size_t first = d->capacity - d->front;
+  if (first > count) {
+    first = count;
+  }
+  memcpy(values, d->items + d->front, first * sizeof(void*));
+  memcpy(values + first, d->items, (count - first) * sizeof(void*));
+  d->front = (d->front + count) & (d->capacity - 1);
+  d->size -= count;
+  return count;
 }
 
 /**
@@ -200,20 +260,20 @@ void* deque_pop_back(deque_t* d) {
  * @return The value on the front of the queue or NULL if the queue is empty.
  */
 void* deque_peek_back(deque_t* d) {
-  if (d == NULL || d->back == NULL) {
+  if (d == NULL || d->size == 0) {
     return NULL;
   }
-  return d->back->value;
+  return d->items[_deque_index(d, d->size - 1)];
 }
 
 /**
  * Peek at the value on the back of the queue, leaving it on the queue.
  * @param d The queue.
- * @return The value on the back of the queue or NULL if the queue is empty.
+ * @return The value on the front of the queue or NULL if the queue is empty.
  */
 void* deque_peek_front(deque_t* d) {
-  if (d == NULL || d->front == NULL) {
+  if (d == NULL || d->size == 0) {
     return NULL;
   }
-  return d->front->value;
+  return d->items[d->front];
 }
@@ -29,8 +29,9 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 @section DESCRIPTION
 
 This is the header file for an implementation of a double-ended queue.
-Each node in the queue contains a void* pointer.
-
+Each element of the queue is a void* pointer. The elements are stored in
+a circular array that grows as needed, so pushing does not allocate memory
+once the array is large enough, and the elements are contiguous in memory.
 To use this, include the following in your target properties:
 <pre>
 target C {
@@ -54,6 +55,8 @@ Alternatively, you can call initialize:
     deque my_deque;
     deque_initialize(&my_deque);
 </pre>
+The array is kept when the deque becomes empty, so that it can be reused.
+Call deque_free to release it.
 */
 
 #ifndef DEQUE_H
@@ -67,9 +70,10 @@ Alternatively, you can call initialize:
  * A double-ended queue data structure.
  */
 typedef struct deque_t {
-  struct deque_node_t* front;
-  struct deque_node_t* back;
-  size_t size;
+  void** items;    // Circular array of the elements, or NULL if none has been allocated.
+  size_t capacity; // Length of the array, which is zero or a power of two.
+  size_t front;    // Index of the front element in the array.
+  size_t size;     // Number of elements in the queue.
 } deque_t;
 
 /**
@@ -78,6 +82,20 @@ typedef struct deque_t {
  */
 void deque_initialize(deque_t* d);
 
+/**
+ * Release the array of the specified deque and make it empty.
+ * @param d The deque.
+ */
+void deque_free(deque_t* d);
+
+/**
+ * Make sure that the specified deque can hold `capacity` elements without allocating memory.
+ * @param d The deque.
+ * @param capacity The number of elements.
+ * @return true on success, or false if memory could not be allocated, in which case the deque is unchanged.
+ */
+bool deque_reserve(deque_t* d, size_t capacity);
+
 /**
  * Return true if the queue is empty.
  * @param d The deque.
@@ -105,6 +123,14 @@ void deque_push_front(deque_t* d, void* value);
  */
 void deque_push_back(deque_t* d, void* value);
 
+/**
+ * Push the specified values, in order, to the back of the queue.
+ * @param d The queue.
+ * @param values The values to push.
+ * @param count The number of values.
+ */
+void deque_push_back_n(deque_t* d, void* const* values, size_t count);
+
 /**
  * Pop a value from the front of the queue, removing it from the queue.
  * @param d The queue.
@@ -119,6 +145,15 @@ void* deque_pop_front(deque_t* d);
  */
 void* deque_pop_back(deque_t* d);
 
+/**
+ * Pop up to `count` values from the front of the queue, removing them from the queue.
+ * @param d The queue.
+ * @param values Where to store the values, in order from the front.
+ * @param count The maximum number of values to pop.
+ * @return The number of values popped.
+ */
+size_t deque_pop_front_n(deque_t* d, void** values, size_t count);
+
 /**
  * Peek at the value on the front of the queue, leaving it on the queue.
  * @param d The queue.
@@ -0,0 +1,293 @@
+/**
+ * @file
+ * @brief Print the live metrics of a running program in the Prometheus text format.
+ *
+ * Usage: lf_metrics <pid> [-i <seconds>]
+ *
+ * The program must be built with LF_METRICS defined (see include/core/metrics.h). Totals are
+ * printed as counters. The utility reads the metrics block twice, the given number of seconds
+ * apart (1 by default), and also prints the reactions per second and busy ratio of each worker
+ * over that interval. With `-i 0`, it reads the block once and prints the totals only.
+ * The end-to-end latencies of a program built with LF_LATENCY are printed as histograms, and the
+ * memory of each subsystem of a program built with LF_MEMORY_ACCOUNTING is printed with the
+ * allocation rates over the interval. The counters and histograms of a program built with
+ * LF_USER_METRICS are printed as counters and histograms labeled with their names.
+ */
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+/** The names of the subsystems whose memory is accounted for, indexed by lf_memory_subsystem_t. */
+static const char* subsystem_names[lf_memory_num_subsystems] = {"events",  "tokens",    "payloads", "reactors",
+                                                                "trace",   "scheduler", "network"};
+
+/** @brief Print the usage of the utility. */
+static void usage(void) {
+  fprintf(stderr, "Usage: lf_metrics <pid> [-i <seconds>]\n");
+  fprintf(stderr, "Print the metrics of a running program built with LF_METRICS in the Prometheus text format.\n");
+  fprintf(stderr, "  -i <seconds>  Interval over which rates are computed (default 1, 0 for totals only).\n");
+}
+
+/** @brief Return the time of the monotonic clock in nanoseconds. */
+static int64_t now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (int64_t)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/** @brief Print the header of a metric. */
+static void header(const char* name, const char* type, const char* help) {
+  printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/** @brief Print a statistic of each environment. */
+static void per_environment(lf_metrics_t* m, const char* name, const char* type, const char* help, size_t offset,
+                            double scale) {
+  header(name, type, help);
+  for (int i = 0; i < m->num_environments; i++) {
+    lf_metrics_environment_t* e = &m->environments[i];
+    printf("%s{environment=\"%s\",id=\"%d\"} %.9g\n", name, e->name, (int)e->id,
+           (double)*(int64_t*)((char*)e + offset) * scale);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    usage();
+    return 1;
+  }
+  double interval = 1.0;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+      interval = atof(argv[++i]);
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  char name[64];
+  snprintf(name, sizeof(name), "/lf-metrics-%s", argv[1]);
+  int fd = shm_open(name, O_RDONLY, 0);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(lf_metrics_t)) {
+    fprintf(stderr, "No metrics block %s. Is the program running and built with LF_METRICS?\n", name);
+    return 1;
+  }
+  size_t size = (size_t)st.st_size;
+  lf_metrics_t* block = (lf_metrics_t*)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (block == MAP_FAILED || block->magic != LF_METRICS_MAGIC ||
+      sizeof(lf_metrics_t) + (size_t)block->num_environments * sizeof(lf_metrics_environment_t) > size) {
+    fprintf(stderr, "%s is not a valid metrics block.\n", name);
+    return 1;
+  }
+
+  // Copy the block, so that the printed statistics are consistent with the rates.
+  lf_metrics_t* first = (lf_metrics_t*)malloc(size);
+  lf_metrics_t* m = (lf_metrics_t*)malloc(size);
+  if (first == NULL || m == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    return 1;
+  }
+  memcpy(first, block, size);
+  int64_t start = now();
+  if (interval > 0) {
+    struct timespec t = {(time_t)interval, (long)((interval - (double)(time_t)interval) * 1e9)};
+    nanosleep(&t, NULL);
+  }
+  memcpy(m, block, size);
+  double elapsed = (double)(now() - start) * 1e-9;
+
+  per_environment(m, "lf_tags_total", "counter", "Number of tags started.", offsetof(lf_metrics_environment_t, tags),
+                  1.0);
+  per_environment(m, "lf_tag_lag_seconds", "gauge", "Physical minus logical time at the start of the last tag.",
+                  offsetof(lf_metrics_environment_t, tag_lag), 1e-9);
+  per_environment(m, "lf_tag_lag_max_seconds", "gauge", "Largest physical minus logical time at the start of a tag.",
+                  offsetof(lf_metrics_environment_t, max_tag_lag), 1e-9);
+  per_environment(m, "lf_event_queue_size", "gauge", "Number of events on the event queue.",
+                  offsetof(lf_metrics_environment_t, event_q_size), 1.0);
+  per_environment(m, "lf_free_events", "gauge", "Number of events in the pool of free events.",
+                  offsetof(lf_metrics_environment_t, free_events), 1.0);
+  per_environment(m, "lf_events_allocated", "gauge", "Number of events allocated for the pool.",
+                  offsetof(lf_metrics_environment_t, events_allocated), 1.0);
+  per_environment(m, "lf_ingress_events", "gauge", "Number of events of physical actions not yet on the event queue.",
+                  offsetof(lf_metrics_environment_t, ingress_count), 1.0);
+  per_environment(m, "lf_ingress_rejected_total", "counter",
+                  "Number of events of physical actions rejected because of a capacity.",
+                  offsetof(lf_metrics_environment_t, ingress_rejected), 1.0);
+  per_environment(m, "lf_ingress_shed_total", "counter",
+                  "Number of events of physical actions dropped or coalesced because of a capacity.",
+                  offsetof(lf_metrics_environment_t, ingress_shed), 1.0);
+
+  header("lf_reactions_total", "counter", "Number of reactions invoked by a worker.");
+  for (int i = 0; i < m->num_environments; i++) {
+    lf_metrics_environment_t* e = &m->environments[i];
+    for (int w = 0; w < e->num_workers; w++) {
+      printf("lf_reactions_total{environment=\"%s\",id=\"%d\",worker=\"%d\"} %lld\n", e->name, (int)e->id, w,
+             (long long)e->workers[w].reactions);
+    }
+  }
+  header("lf_worker_busy_seconds_total", "counter", "Time a worker spent in the bodies of reactions.");
+  for (int i = 0; i < m->num_environments; i++) {
+    lf_metrics_environment_t* e = &m->environments[i];
+    for (int w = 0; w < e->num_workers; w++) {
+      printf("lf_worker_busy_seconds_total{environment=\"%s\",id=\"%d\",worker=\"%d\"} %.9f\n", e->name, (int)e->id,
+             w, (double)e->workers[w].busy * 1e-9);
+    }
+  }
+  if (interval > 0) {
+    header("lf_reactions_per_second", "gauge", "Reactions invoked by a worker per second over the last interval.");
+    for (int i = 0; i < m->num_environments; i++) {
+      lf_metrics_environment_t* e = &m->environments[i];
+      for (int w = 0; w < e->num_workers; w++) {
+        int64_t reactions = e->workers[w].reactions - first->environments[i].workers[w].reactions;
+        printf("lf_reactions_per_second{environment=\"%s\",id=\"%d\",worker=\"%d\"} %.3f\n", e->name, (int)e->id, w,
+               (double)reactions / elapsed);
+      }
+    }
+    header("lf_worker_busy_ratio", "gauge", "Fraction of the last interval a worker spent in the bodies of reactions.");
+    for (int i = 0; i < m->num_environments; i++) {
+      lf_metrics_environment_t* e = &m->environments[i];
+      for (int w = 0; w < e->num_workers; w++) {
+        int64_t busy = e->workers[w].busy - first->environments[i].workers[w].busy;
+        printf("lf_worker_busy_ratio{environment=\"%s\",id=\"%d\",worker=\"%d\"} %.4f\n", e->name, (int)e->id, w,
+               (double)busy * 1e-9 / elapsed);
+      }
+    }
+  }
+
+  bool latency = false;
+  for (int i = 0; i < m->num_environments; i++) {
+    latency = latency || m->environments[i].latency[0].chain[0] != '\0';
+  }
+  if (latency) {
+    header("lf_latency_seconds", "histogram",
+           "Time from the arrival of an event of a physical action to a sink of its chain.");
+    for (int i = 0; i < m->num_environments; i++) {
+      lf_metrics_environment_t* e = &m->environments[i];
+      for (int c = 0; c < LF_LATENCY_MAX_CHAINS && e->latency[c].chain[0] != '\0'; c++) {
+        lf_metrics_latency_t* l = &e->latency[c];
+        long long cumulative = 0;
+        for (int b = 0; b < LF_LATENCY_BUCKETS - 1; b++) {
+          cumulative += l->buckets[b];
+          printf("lf_latency_seconds_bucket{environment=\"%s\",id=\"%d\",chain=\"%s\",le=\"%.6g\"} %lld\n", e->name,
+                 (int)e->id, l->chain, (double)(1LL << b) * 1e-6, cumulative);
+        }
+        cumulative += l->buckets[LF_LATENCY_BUCKETS - 1];
+        printf("lf_latency_seconds_bucket{environment=\"%s\",id=\"%d\",chain=\"%s\",le=\"+Inf\"} %lld\n", e->name,
+               (int)e->id, l->chain, cumulative);
+        printf("lf_latency_seconds_sum{environment=\"%s\",id=\"%d\",chain=\"%s\"} %.9f\n", e->name, (int)e->id,
+               l->chain, (double)l->total * 1e-9);
+        printf("lf_latency_seconds_count{environment=\"%s\",id=\"%d\",chain=\"%s\"} %lld\n", e->name, (int)e->id,
+               l->chain, cumulative);
+      }
+    }
+    header("lf_latency_max_seconds", "gauge", "Largest time from the arrival of an event to a sink of its chain.");
+    for (int i = 0; i < m->num_environments; i++) {
+      lf_metrics_environment_t* e = &m->environments[i];
+      for (int c = 0; c < LF_LATENCY_MAX_CHAINS && e->latency[c].chain[0] != '\0'; c++) {
+        printf("lf_latency_max_seconds{environment=\"%s\",id=\"%d\",chain=\"%s\"} %.9f\n", e->name, (int)e->id,
+               e->latency[c].chain, (double)e->latency[c].max * 1e-9);
+      }
+    }
+  }
+
+  header("lf_token_recycling_bin_size", "gauge", "Number of tokens in the recycling bins.");
+  printf("lf_token_recycling_bin_size %lld\n", (long long)m->token_bin_size);
+  header("lf_token_recycling_hits_total", "counter", "Number of token allocations served from the recycling bins.");
+  printf("lf_token_recycling_hits_total %lld\n", (long long)m->token_hits);
+  header("lf_token_recycling_misses_total", "counter", "Number of token allocations that needed new memory.");
+  printf("lf_token_recycling_misses_total %lld\n", (long long)m->token_misses);
+
+  if (m->net_round_trips > 0) {
+    header("lf_net_tag_round_trip_seconds", "summary", "Time from sending a NET to the RTI to receiving its TAG.");
+    printf("lf_net_tag_round_trip_seconds_sum %.9f\n", (double)m->net_round_trip_total * 1e-9);
+    printf("lf_net_tag_round_trip_seconds_count %lld\n", (long long)m->net_round_trips);
+    header("lf_net_tag_round_trip_last_seconds", "gauge", "Time from sending the last granted NET to receiving its TAG.");
+    printf("lf_net_tag_round_trip_last_seconds %.9f\n", (double)m->net_round_trip_last * 1e-9);
+    header("lf_net_tag_round_trip_max_seconds", "gauge", "Largest time from sending a NET to receiving its TAG.");
+    printf("lf_net_tag_round_trip_max_seconds %.9f\n", (double)m->net_round_trip_max * 1e-9);
+  }
+
+  if (m->memory_time != 0) {
+    header("lf_memory_live_bytes", "gauge", "Bytes allocated by a subsystem and not freed.");
+    for (int i = 0; i < lf_memory_num_subsystems; i++) {
+      printf("lf_memory_live_bytes{subsystem=\"%s\"} %lld\n", subsystem_names[i], (long long)m->memory[i].live);
+    }
+    header("lf_memory_high_water_bytes", "gauge", "The most bytes that a subsystem had allocated at once.");
+    for (int i = 0; i < lf_memory_num_subsystems; i++) {
+      printf("lf_memory_high_water_bytes{subsystem=\"%s\"} %lld\n", subsystem_names[i],
+             (long long)m->memory[i].high_water);
+    }
+    header("lf_memory_allocations_total", "counter", "Number of allocations by a subsystem.");
+    for (int i = 0; i < lf_memory_num_subsystems; i++) {
+      printf("lf_memory_allocations_total{subsystem=\"%s\"} %lld\n", subsystem_names[i],
+             (long long)m->memory[i].allocations);
+    }
+    header("lf_memory_allocated_bytes_total", "counter",
+           "Bytes allocated by a subsystem, including those freed since.");
+    for (int i = 0; i < lf_memory_num_subsystems; i++) {
+      printf("lf_memory_allocated_bytes_total{subsystem=\"%s\"} %lld\n", subsystem_names[i],
+             (long long)m->memory[i].allocated);
+    }
+    // The statistics are gathered periodically, so the rates are over the times at which they were.
+    double memory_elapsed = (double)(m->memory_time - first->memory_time) * 1e-9;
+    if (interval > 0 && first->memory_time != 0 && memory_elapsed > 0) {
+      header("lf_memory_allocations_per_second", "gauge",
+             "Allocations by a subsystem per second over the last interval.");
+      for (int i = 0; i < lf_memory_num_subsystems; i++) {
+        printf("lf_memory_allocations_per_second{subsystem=\"%s\"} %.3f\n", subsystem_names[i],
+               (double)(m->memory[i].allocations - first->memory[i].allocations) / memory_elapsed);
+      }
+      header("lf_memory_allocated_bytes_per_second", "gauge",
+             "Bytes allocated by a subsystem per second over the last interval.");
+      for (int i = 0; i < lf_memory_num_subsystems; i++) {
+        printf("lf_memory_allocated_bytes_per_second{subsystem=\"%s\"} %.3f\n", subsystem_names[i],
+               (double)(m->memory[i].allocated - first->memory[i].allocated) / memory_elapsed);
+      }
+    }
+  }
+  if (m->user_time != 0) {
+    header("lf_user_counter_total", "counter", "A counter of the program.");
+    for (int i = 0; i < LF_USER_METRICS_MAX && m->user[i].name[0] != '\0'; i++) {
+      if (m->user[i].kind == lf_user_metric_counter) {
+        printf("lf_user_counter_total{metric=\"%s\"} %lld\n", m->user[i].name, (long long)m->user[i].total);
+      }
+    }
+    header("lf_user_histogram", "histogram", "A histogram of the program.");
+    for (int i = 0; i < LF_USER_METRICS_MAX && m->user[i].name[0] != '\0'; i++) {
+      lf_metrics_user_t* u = &m->user[i];
+      if (u->kind != lf_user_metric_histogram) {
+        continue;
+      }
+      long long cumulative = 0;
+      for (int b = 0; b < LF_USER_METRICS_BUCKETS - 1; b++) {
+        cumulative += u->buckets[b];
+        printf("lf_user_histogram_bucket{metric=\"%s\",le=\"%lld\"} %lld\n", u->name, 1LL << b, cumulative);
+      }
+      cumulative += u->buckets[LF_USER_METRICS_BUCKETS - 1];
+      printf("lf_user_histogram_bucket{metric=\"%s\",le=\"+Inf\"} %lld\n", u->name, cumulative);
+      printf("lf_user_histogram_sum{metric=\"%s\"} %lld\n", u->name, (long long)u->total);
+      printf("lf_user_histogram_count{metric=\"%s\"} %lld\n", u->name, cumulative);
+    }
+    header("lf_user_histogram_max", "gauge", "The largest value recorded in a histogram of the program.");
+    for (int i = 0; i < LF_USER_METRICS_MAX && m->user[i].name[0] != '\0'; i++) {
+      if (m->user[i].kind == lf_user_metric_histogram) {
+        printf("lf_user_histogram_max{metric=\"%s\"} %lld\n", m->user[i].name, (long long)m->user[i].max);
+      }
+    }
+  }
+  free(first);
+  free(m);
+  munmap(block, size);
+  return 0;
+}
@@ -10,16 +10,20 @@
 
 #include <pthread.h>
 #include <ncurses.h>
+#include <errno.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "sensor_simulator.h"
 #include "include/api/schedule.h"
+#include "reactor_common.h"
 #include "util.h"
 #include "low_level_platform.h"
 
-// Maximum number of milliseconds that wgetchr will block for.
-#define WGETCHR_TIMEOUT 1000
+// Maximum number of keys that are scheduled together, which is also the maximum length of a replayed line.
+#define LF_SENSOR_MAX_KEYS 256
 
 // Support ASCII characters SPACE (32) through DEL (127).
 #define LF_SENSOR_TRIGGER_TABLE_SIZE 96
@@ -87,6 +91,13 @@ struct {
 
   /** The width of the tick window. */
   int tick_window_width;
+
+  /** Whether input is replayed from replay_fd rather than read from the keyboard. */
+  bool replaying;
+  int replay_fd;
+
+  /** Pipe that wakes up the input thread when the simulator ends. */
+  int wake_pipe[2];
 } _lf_sensor;
 
 /**
@@ -214,37 +225,177 @@ void _lf_print_message_function(const char* format, va_list args) {
 }
 
 /**
- * Thread to read input characters until an EOF is received.
- * For each character received, if there is a registered trigger
- * for that character, schedule that trigger with a payload
- * equal to the character that was typed.
- * Otherwise, the character is ignored.
+ * Return the action registered for the specified key, not counting the any key trigger, or NULL if there is none.
+ * A table entry, once assigned a value, becomes immutable, so this needs no lock.
  */
-void* _lf_sensor_read_input(void* ignored) {
-  while (_lf_sensor.thread_created != 0) {
-    int c = wgetch(_lf_sensor.default_window);
-    if (c == EOF) {
-      // End of file received. Exit thread.
-      break;
-    } else if (c != ERR) {
-      // wgetch returns ERR if it times out, in which case, we continue
-      // and check whether _lf_sensor.thread_created has been set to 0.
-      // So here, ERR was not returned.
-      // It is imperative that we not hold the _lf_sensor_mutex when
-      // calling schedule(), because schedule() acquires another mutex.
-      // We would create a deadlock risk.  The following code is correct
-      // because a _lf_sensor_trigger_table entry, once assigned a value, becomes
-      // immutable.
-      if (c == '\n' && _lf_sensor_sensor_newline_trigger != NULL) {
-        lf_schedule_copy(_lf_sensor_sensor_newline_trigger, 0, &c, 1);
-      } else if (c - 32 >= 0 && c - 32 < LF_SENSOR_TRIGGER_TABLE_SIZE && _lf_sensor_trigger_table[c - 32] != NULL) {
-        lf_schedule_copy(_lf_sensor_trigger_table[c - 32], 0, &c, 1);
+static lf_action_base_t* _lf_sensor_trigger_for(int c) {
+  if (c == '\n') {
+    return _lf_sensor_sensor_newline_trigger;
+  } else if (c - 32 >= 0 && c - 32 < LF_SENSOR_TRIGGER_TABLE_SIZE) {
+    return _lf_sensor_trigger_table[c - 32];
+  }
+  return NULL;
+}
+
+/**
+ * Schedule the specified action with a payload that is the array of the specified keys.
+ * If `time` is NEVER, the action is scheduled as usual. Otherwise, it is scheduled at the
+ * tag (time, 0) relative to the start time, or at the next microstep if that has passed.
+ */
+static void _lf_sensor_schedule(lf_action_base_t* action, const char* keys, int length, instant_t time) {
+  size_t element_size = ((token_template_t*)action)->type.element_size;
+  if (element_size == 0 || element_size > sizeof(int)) {
+    lf_print_error("sensor_simulator: The type of an action for keys must be a char or an int.");
+    return;
+  }
+  // Each element holds the key as the payload of a single key always has.
+  char* payload = (char*)malloc(length * element_size);
+  LF_ASSERT_NON_NULL(payload);
+  for (int i = 0; i < length; i++) {
+    int c = keys[i];
+    memcpy(payload + i * element_size, &c, element_size);
+  }
+  if (time == NEVER) {
+    lf_schedule_value(action, 0, payload, length);
+    return;
+  }
+  environment_t* env = action->parent->environment;
+  LF_CRITICAL_SECTION_ENTER(env);
+  tag_t tag = {.time = lf_time_start() + time, .microstep = 0};
+  if (lf_tag_compare(tag, env->current_tag) <= 0) {
+    lf_print_warning("sensor_simulator: Input for time " PRINTF_TIME " arrived late.", time);
+    tag = lf_delay_tag(env->current_tag, 0);
+  }
+  lf_token_t* token = _lf_initialize_token_with_value((token_template_t*)action, payload, length);
+  _lf_schedule_at_tag(env, action->trigger, tag, token);
+  lf_notify_of_event(env);
+  LF_CRITICAL_SECTION_EXIT(env);
+}
+
+/**
+ * Schedule the triggers of the specified keys, which arrived together, with one event for each
+ * registered action whose payload is the array of its keys, followed by the any key trigger with
+ * all of them. See _lf_sensor_schedule() for `time`.
+ * It is imperative that we not hold the _lf_sensor_mutex when calling this, because
+ * scheduling acquires another mutex. We would create a deadlock risk.
+ */
+static void _lf_sensor_deliver(const char* keys, int length, instant_t time) {
+  char batch[LF_SENSOR_MAX_KEYS];
+  for (int i = 0; i < length; i++) {
+    lf_action_base_t* action = _lf_sensor_trigger_for(keys[i]);
+    if (action == NULL) {
+      continue;
+    }
+    // Collect the keys of the action, unless an earlier key already did.
+    bool first = true;
+    for (int j = 0; j < i && first; j++) {
+      first = _lf_sensor_trigger_for(keys[j]) != action;
+    }
+    if (!first) {
+      continue;
+    }
+    int batch_length = 0;
+    for (int j = i; j < length; j++) {
+      if (_lf_sensor_trigger_for(keys[j]) == action) {
+        batch[batch_length++] = keys[j];
       }
-      // Any key trigger triggers after specific keys.
-      if (_lf_sensor_any_key_trigger != NULL) {
-        lf_schedule_copy(_lf_sensor_any_key_trigger, 0, &c, 1);
+    }
+    _lf_sensor_schedule(action, batch, batch_length, time);
+  }
+  // Any key trigger triggers after specific keys.
+  if (_lf_sensor_any_key_trigger != NULL) {
+    _lf_sensor_schedule(_lf_sensor_any_key_trigger, keys, length, time);
+  }
+}
+
+/**
+ * Wait until the specified descriptor is readable or the simulator ends.
+ * Return false if the simulator ends or the wait fails.
+ */
+static bool _lf_sensor_wait_for_input(int fd) {
+  struct pollfd fds[2] = {{.fd = fd, .events = POLLIN}, {.fd = _lf_sensor.wake_pipe[0], .events = POLLIN}};
+  while (poll(fds, 2, -1) < 0) {
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+  return fds[1].revents == 0;
+}
+
+/**
+ * Thread to read input characters until the simulator ends.
+ * The thread sleeps in poll() until a key is pressed. Then it takes all
+ * keys that have arrived and, for each registered trigger, schedules it
+ * with a payload that is the array of its keys.
+ * Other characters are ignored.
+ */
+void* _lf_sensor_read_input(void* ignored) {
+  char keys[LF_SENSOR_MAX_KEYS];
+  while (_lf_sensor.thread_created != 0 && _lf_sensor_wait_for_input(STDIN_FILENO)) {
+    // The window does not block (see nodelay()), so wgetch returns ERR once all keys are taken.
+    int length = 0;
+    int c;
+    while (length < LF_SENSOR_MAX_KEYS && (c = wgetch(_lf_sensor.default_window)) != ERR) {
+      if (c < 128) {
+        keys[length++] = (char)c;
       }
     }
+    _lf_sensor_deliver(keys, length, NEVER);
+  }
+  return NULL;
+}
+
+/**
+ * Deliver the keys of a replayed line of the form `<time> <keys>`, which is not terminated by a newline.
+ */
+static void _lf_sensor_replay_line(char* line) {
+  char* keys;
+  long long time = strtoll(line, &keys, 10);
+  if (keys == line || (*keys != ' ' && *keys != '\0') || time < 0) {
+    lf_print_warning("sensor_simulator: Ignoring replayed line without a valid time: %s", line);
+    return;
+  }
+  if (*keys == ' ') {
+    keys++;
+  }
+  int length = (int)strlen(keys);
+  if (length == 0) {
+    _lf_sensor_deliver("\n", 1, (instant_t)time);
+  } else {
+    _lf_sensor_deliver(keys, length, (instant_t)time);
+  }
+}
+
+/**
+ * Thread to replay the lines of input from _lf_sensor.replay_fd until its end or until the simulator ends.
+ */
+void* _lf_sensor_replay_input(void* ignored) {
+  // Room for the time, the keys, and the terminating null character.
+  char buffer[LF_SENSOR_MAX_KEYS + 32];
+  size_t used = 0;
+  while (_lf_sensor_wait_for_input(_lf_sensor.replay_fd)) {
+    ssize_t received = read(_lf_sensor.replay_fd, buffer + used, sizeof(buffer) - 1 - used);
+    if (received < 0 && errno == EINTR) {
+      continue;
+    } else if (received <= 0) {
+      // End of the input.
+      break;
+    }
+    used += (size_t)received;
+    // Deliver each complete line.
+    char* line = buffer;
+    char* newline;
+    while ((newline = memchr(line, '\n', buffer + used - line)) != NULL) {
+      *newline = '\0';
+      _lf_sensor_replay_line(line);
+      line = newline + 1;
+    }
+    used -= (size_t)(line - buffer);
+    memmove(buffer, line, used);
+    if (used == sizeof(buffer) - 1) {
+      lf_print_warning("sensor_simulator: Ignoring a replayed line that is too long.");
+      used = 0;
+    }
   }
   return NULL;
 }
@@ -263,12 +414,11 @@ void* _lf_sensor_simulator_thread(void* ignored) {
   // Initialize ncurses.
   LF_PRINT_DEBUG("Initializing ncurses.");
   initscr();
-  start_color();                     // Allow colors.
-  noecho();                          // Don't echo input
-  cbreak();                          // Don't wait for Return or Enter
-  wtimeout(stdscr, WGETCHR_TIMEOUT); // Don't wait longer than this for input.
-  keypad(stdscr, TRUE);              // Enable keypad input.
-  refresh();                         // Not documented, but needed?
+  start_color();         // Allow colors.
+  noecho();              // Don't echo input
+  cbreak();              // Don't wait for Return or Enter
+  keypad(stdscr, TRUE);  // Enable keypad input.
+  refresh();             // Not documented, but needed?
 
   _lf_sensor.default_window = stdscr;
   if (_lf_sensor.welcome_message != NULL && _lf_sensor.welcome_message_length > 0) {
@@ -279,12 +429,16 @@ void* _lf_sensor_simulator_thread(void* ignored) {
     _lf_start_tick_window(_lf_sensor.tick_window_width);
   }
   _lf_start_print_window(_lf_sensor.welcome_message_length + 2, _lf_sensor.tick_window_width + 2);
+  // The input thread waits for keys with poll(), so wgetch() need not block.
+  nodelay(_lf_sensor.default_window, TRUE);
 
   // ncurses is not thread safe, but since the wtimeout option does not work,
   // there is no way to simultaneously listen for inputs and produce outputs.
-  // Here, we create a thread that produces no output and just listens for input.
+  // Here, we create a thread that produces no output and just listens for input,
+  // or replays it from a file descriptor.
   // This thread is exclusively responsible for producing output.
-  int result = lf_thread_create(&_lf_sensor.input_thread_id, &_lf_sensor_read_input, NULL);
+  int result = lf_thread_create(&_lf_sensor.input_thread_id,
+                                _lf_sensor.replaying ? &_lf_sensor_replay_input : &_lf_sensor_read_input, NULL);
   if (result != 0) {
     lf_print_error("Failed to start sensor simulator input listener!");
   }
@@ -350,10 +504,11 @@ void end_sensor_simulator() {
   void* thread_return;
   lf_thread_join(_lf_sensor.output_thread_id, &thread_return);
 
-  // Timeout mode should result in the input thread exiting on its own.
-  // pthread_kill(_lf_sensor.input_thread_id, SIGINT);
-
+  // Wake up the input thread, which then exits on its own.
   _lf_sensor.thread_created = 0;
+  if (_lf_sensor.wake_pipe[1] >= 0 && write(_lf_sensor.wake_pipe[1], "", 1) < 0) {
+    lf_print_warning("sensor_simulator: Failed to stop the input thread.");
+  }
   if (_lf_sensor.log_file != NULL) {
     fclose(_lf_sensor.log_file);
   }
@@ -368,6 +523,10 @@ int start_sensor_simulator(const char* message_lines[], int number_of_lines, int
   _lf_sensor.message_q = NULL;
   _lf_sensor.message_recycle_q = NULL;
   _lf_sensor.thread_created = 0;
+  if (pipe(_lf_sensor.wake_pipe) != 0) {
+    lf_print_error("Failed to create a pipe for the sensor simulator!");
+    _lf_sensor.wake_pipe[0] = _lf_sensor.wake_pipe[1] = -1;
+  }
   LF_COND_INIT(&_lf_sensor_simulator_cond_var, &_lf_sensor_mutex);
   if (_lf_sensor.thread_created == 0) {
     // Thread has not been created.
@@ -403,6 +562,11 @@ int start_sensor_simulator(const char* message_lines[], int number_of_lines, int
   return result;
 }
 
+void sensor_simulator_replay(int fd) {
+  _lf_sensor.replaying = true;
+  _lf_sensor.replay_fd = fd;
+}
+
 void show_tick(const char* character) {
   if (character != NULL) {
     char* copy;
@@ -63,6 +63,21 @@
 int start_sensor_simulator(const char* message_lines[], int number_of_lines, int tick_window_width, char* log_file,
                            int log_level);
 
+/**
+ * Replay input from the specified file descriptor instead of reading keys from the keyboard.
+ * The descriptor can refer to a file, a pipe, or a connected socket, and it is waited on with
+ * poll(), so the input thread sleeps until input arrives. Each line of input has the form
+ * `<time> <keys>`, where `<time>` is the logical time, in nanoseconds after the start time,
+ * at which the keys were pressed, and `<keys>` are the characters up to the end of the line,
+ * or a newline if there are none. The keys of a line are scheduled at exactly that time, with
+ * one event per registered action, as when several keys are read from the keyboard at once,
+ * so that a replay is deterministic. Keys that arrive after that time has passed are scheduled
+ * at the next microstep, with a warning.
+ * This must be called before start_sensor_simulator(). The descriptor is not closed.
+ * @param fd The file descriptor.
+ */
+void sensor_simulator_replay(int fd);
+
 /**
  * End ncurses control of the terminal.
  */
@@ -76,6 +91,9 @@ void show_tick(const char* character);
 
 /**
  * Register a keyboard key to trigger the specified action.
+ * The payload of the action is an array of the keys that it is registered for
+ * among those read at once, which is usually a single key. Its elements hold
+ * the keys as characters or as ints, depending on the type of the action.
  * Printable ASCII characters (codes 32 to 127) are supported
  * plus '\n' and '\0', where the latter registers a trigger
  * to invoked when any key is pressed. If a specific key is
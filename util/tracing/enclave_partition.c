@@ -0,0 +1,427 @@
+/**
+ * @file
+ * @brief Standalone program that proposes a partitioning of the reactors of a program into
+ * enclaves from the execution times of its reactions and the connections between them.
+ *
+ * The input is the reaction profile written by a program built with LF_REACTION_PROFILE and
+ * LF_REACTION_PROFILE_WRITE (see reaction_profile.h), which holds the execution times of the
+ * reactions and the graph of the reactions that trigger each other. The reactors in it are
+ * identified by the addresses of their self structs. The object table of a trace file of the
+ * same execution, given with `-t`, names them. Without it, a reactor is named after its first
+ * reaction, if reactions have names, and otherwise after its address.
+ *
+ * Reactors are grouped into the units that are assigned to enclaves: with `-l level`, the
+ * reactors whose names have the same first `level` components below the top-level reactor
+ * (1 by default, which groups the reactors in each instance of the top-level reactor) form
+ * one unit, since an enclave takes the reactors it contains along. The load of a unit is the
+ * total execution time of its reactions, and the weight of the connection between two units
+ * is the number of invocations of the reactions of one that trigger reactions of the other.
+ *
+ * The units are partitioned into `-k` enclaves (2 by default) so that the weight of the
+ * connections between enclaves, which become connections between timelines, is small, while
+ * the load of each enclave is at most (1 + `-b`) times the mean load (`-b` is 0.1 by default).
+ * Units are first assigned from the heaviest to the enclave to which they are most connected
+ * among those with room for them, and then moved one at a time between enclaves while this
+ * reduces the weight of the connections between enclaves without exceeding the bound, as in
+ * the refinement of Fiduccia and Mattheyses. A unit that is heavier than the bound gets an
+ * enclave of its own. The result is a heuristic, not an optimum.
+ *
+ * The proposal is printed, with the load of each enclave, and written, one line
+ * `unit,enclave` per unit, to the file given with `-o` (partition.csv by default). The units
+ * of each enclave but the one with the top-level reactor are the instances to mark with
+ * `@enclave` in the Lingua Franca program.
+ */
+#define LF_TRACE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reactor.h"
+#include "trace.h"
+#include "trace_util.h"
+
+/** The maximum length of a line of the reaction profile. */
+#define MAX_LINE 4096
+
+/** The maximum number of passes of the refinement. */
+#define MAX_PASSES 32
+
+/** File containing the trace binary data, if the reactors are named from a trace. */
+FILE* trace_file = NULL;
+
+/** File for writing the partitioning. */
+FILE* output_file = NULL;
+
+/** Unused, but declared by trace_util.h. */
+FILE* summary_file = NULL;
+
+/**
+ * Print a usage message.
+ */
+void usage() {
+  printf("\nUsage: enclave_partition [options] profile_file (with .csv extension)\n");
+  printf("The profile file is written by a program built with LF_REACTION_PROFILE and LF_REACTION_PROFILE_WRITE.\n");
+  printf("Options: \n");
+  printf("  -t, --trace [file]\n");
+  printf("   A trace file (with .lft extension) of the same execution, which names the reactors.\n");
+  printf("  -k, --enclaves [number]\n");
+  printf("   The number of enclaves (default: 2).\n");
+  printf("  -b, --imbalance [fraction]\n");
+  printf("   How much the load of an enclave may exceed the mean load (default: 0.1).\n");
+  printf("  -l, --level [number]\n");
+  printf("   The depth below the top-level reactor of the reactors assigned to enclaves (default: 1).\n");
+  printf("  -o, --output [file]\n");
+  printf("   The file to write the partitioning to (default: partition.csv).\n");
+  printf("\n");
+}
+
+/** @brief A reaction of the profile. */
+typedef struct profiled_reaction_t {
+  int unit;         // The index of the unit of its reactor.
+  interval_t load;  // The total execution time of its invocations.
+} profiled_reaction_t;
+
+/** @brief A group of reactors that is assigned to an enclave as a whole. */
+typedef struct unit_t {
+  char* name;
+  interval_t load;
+  int enclave;
+  size_t first_edge; // The index in `edges` of its first connection. Its last one precedes that of the next unit.
+} unit_t;
+
+/** @brief A connection of a unit with another one. */
+typedef struct edge_t {
+  int from;
+  int to;
+  int64_t weight;
+} edge_t;
+
+static profiled_reaction_t* reactions = NULL;
+static size_t num_reactions = 0;
+static unit_t* units = NULL;
+static int num_units = 0;
+static edge_t* edges = NULL;
+static size_t num_edges = 0;
+
+/** The load of each enclave. */
+static interval_t* enclave_loads = NULL;
+
+/** Exit if the given pointer is NULL because memory could not be allocated. */
+static void* check_allocated(void* pointer) {
+  if (pointer == NULL) {
+    fprintf(stderr, "ERROR: Out of memory.\n");
+    exit(3);
+  }
+  return pointer;
+}
+
+/**
+ * Return the name of the unit of a reactor with the given name: its first `level` components
+ * below the top-level reactor, in memory that the caller frees.
+ */
+static char* unit_name(const char* name, int level) {
+  const char* end = name;
+  for (int i = 0; i <= level && end != NULL; i++) {
+    end = strchr(end + (i > 0 ? 1 : 0), '.');
+  }
+  size_t length = end == NULL ? strlen(name) : (size_t)(end - name);
+  char* result = (char*)check_allocated(malloc(length + 1));
+  memcpy(result, name, length);
+  result[length] = '\0';
+  return result;
+}
+
+/** Return the index of the unit with the given name, adding it if there is none. */
+static int unit_index(char* name) {
+  for (int i = 0; i < num_units; i++) {
+    if (strcmp(units[i].name, name) == 0) {
+      free(name);
+      return i;
+    }
+  }
+  units = (unit_t*)check_allocated(realloc(units, (num_units + 1) * sizeof(unit_t)));
+  units[num_units] = (unit_t){.name = name, .load = 0, .enclave = -1};
+  return num_units++;
+}
+
+/**
+ * Return the name of the reactor with the self struct at the given address, in memory that the
+ * caller frees: its description in the object table of the trace, if there is one, or else the
+ * name of its reaction without the last word, or else the address.
+ */
+static char* reactor_name(void* self, const char* address, const char* reaction_name) {
+  char* description = object_table_size > 0 ? get_object_description(self, NULL) : NULL;
+  if (description != NULL) {
+    return strdup(description);
+  }
+  const char* end = strrchr(reaction_name, ' ');
+  if (end != NULL && end > reaction_name) {
+    return strndup(reaction_name, (size_t)(end - reaction_name));
+  }
+  return strdup(address);
+}
+
+/** Split a line of the profile at commas into at most `max` fields and return their number. */
+static int split(char* line, char** fields, int max) {
+  int n = 0;
+  line[strcspn(line, "\r\n")] = '\0';
+  while (n < max && line != NULL) {
+    fields[n++] = strsep(&line, ",");
+  }
+  return n;
+}
+
+/** Read the reactions and edges of the profile into `reactions`, `units` and `edges`. */
+static void read_profile(FILE* file, int level) {
+  char line[MAX_LINE];
+  char* fields[8];
+  size_t capacity = 0;
+  size_t edges_capacity = 0;
+  while (fgets(line, MAX_LINE, file) != NULL) {
+    if (line[0] == '#') {
+      continue;
+    }
+    int n = split(line, fields, 8);
+    if (n == 8 && strcmp(fields[0], "reaction") == 0) {
+      size_t index = strtoull(fields[1], NULL, 10);
+      if (index >= capacity) {
+        capacity = index + 1 > 2 * capacity ? index + 1 : 2 * capacity;
+        reactions = (profiled_reaction_t*)check_allocated(realloc(reactions, capacity * sizeof(profiled_reaction_t)));
+      }
+      void* self = (void*)(uintptr_t)strtoull(fields[2], NULL, 16);
+      int unit = unit_index(unit_name(reactor_name(self, fields[2], fields[4]), level));
+      interval_t load = (interval_t)strtoll(fields[5], NULL, 10) * strtoll(fields[6], NULL, 10);
+      reactions[index] = (profiled_reaction_t){.unit = unit, .load = load};
+      units[unit].load += load;
+      num_reactions = index + 1 > num_reactions ? index + 1 : num_reactions;
+    } else if (n == 4 && strcmp(fields[0], "edge") == 0) {
+      size_t from = strtoull(fields[1], NULL, 10);
+      size_t to = strtoull(fields[2], NULL, 10);
+      if (from >= num_reactions || to >= num_reactions || reactions[from].unit == reactions[to].unit) {
+        continue;
+      }
+      // Connections are undirected, so each is recorded at both units.
+      if (num_edges + 2 > edges_capacity) {
+        edges_capacity = edges_capacity == 0 ? 64 : 2 * edges_capacity;
+        edges = (edge_t*)check_allocated(realloc(edges, edges_capacity * sizeof(edge_t)));
+      }
+      int64_t weight = strtoll(fields[3], NULL, 10);
+      edges[num_edges++] = (edge_t){.from = reactions[from].unit, .to = reactions[to].unit, .weight = weight};
+      edges[num_edges++] = (edge_t){.from = reactions[to].unit, .to = reactions[from].unit, .weight = weight};
+    }
+  }
+}
+
+/** Compare edges by their units for qsort. */
+static int compare_edges(const void* a, const void* b) {
+  const edge_t* x = (const edge_t*)a;
+  const edge_t* y = (const edge_t*)b;
+  if (x->from != y->from) {
+    return x->from < y->from ? -1 : 1;
+  }
+  return (x->to > y->to) - (x->to < y->to);
+}
+
+/** Sort the edges by unit and merge those between the same units, and index them by unit. */
+static void index_edges() {
+  qsort(edges, num_edges, sizeof(edge_t), compare_edges);
+  size_t merged = 0;
+  for (size_t i = 0; i < num_edges; i++) {
+    if (merged > 0 && edges[merged - 1].from == edges[i].from && edges[merged - 1].to == edges[i].to) {
+      edges[merged - 1].weight += edges[i].weight;
+    } else {
+      edges[merged++] = edges[i];
+    }
+  }
+  num_edges = merged;
+  size_t e = 0;
+  for (int u = 0; u < num_units; u++) {
+    units[u].first_edge = e;
+    while (e < num_edges && edges[e].from == u) {
+      e++;
+    }
+  }
+}
+
+/** Return the index one past the last edge of a unit. */
+static size_t end_edge(int u) { return u + 1 < num_units ? units[u + 1].first_edge : num_edges; }
+
+/** Store in `weights` the weight of the connections of a unit with each enclave. */
+static void connection_weights(int u, int64_t* weights, int k) {
+  memset(weights, 0, k * sizeof(int64_t));
+  for (size_t e = units[u].first_edge; e < end_edge(u); e++) {
+    int enclave = units[edges[e].to].enclave;
+    if (enclave >= 0) {
+      weights[enclave] += edges[e].weight;
+    }
+  }
+}
+
+/** Compare units by decreasing load for qsort on their indices. */
+static int compare_loads(const void* a, const void* b) {
+  interval_t x = units[*(const int*)a].load;
+  interval_t y = units[*(const int*)b].load;
+  return (x < y) - (x > y);
+}
+
+/** Assign the units to `k` enclaves, with loads of at most `bound` where possible. */
+static void partition(int k, interval_t bound) {
+  int64_t* weights = (int64_t*)check_allocated(calloc(k, sizeof(int64_t)));
+  int* order = (int*)check_allocated(malloc(num_units * sizeof(int)));
+  for (int u = 0; u < num_units; u++) {
+    order[u] = u;
+  }
+  qsort(order, num_units, sizeof(int), compare_loads);
+
+  // Assign the units from the heaviest to the most connected enclave with room, or else the least loaded one.
+  for (int i = 0; i < num_units; i++) {
+    int u = order[i];
+    connection_weights(u, weights, k);
+    int best = -1;
+    int least_loaded = 0;
+    for (int p = 0; p < k; p++) {
+      if (enclave_loads[p] < enclave_loads[least_loaded]) {
+        least_loaded = p;
+      }
+      if (enclave_loads[p] + units[u].load <= bound &&
+          (best < 0 || weights[p] > weights[best] ||
+           (weights[p] == weights[best] && enclave_loads[p] < enclave_loads[best]))) {
+        best = p;
+      }
+    }
+    units[u].enclave = best >= 0 ? best : least_loaded;
+    enclave_loads[units[u].enclave] += units[u].load;
+  }
+
+  // Move units to the enclave with which they are most connected while that reduces the cut.
+  for (int pass = 0; pass < MAX_PASSES; pass++) {
+    bool moved = false;
+    for (int i = 0; i < num_units; i++) {
+      int u = order[i];
+      int from = units[u].enclave;
+      connection_weights(u, weights, k);
+      int best = from;
+      for (int p = 0; p < k; p++) {
+        if (p != from && weights[p] > weights[best] && enclave_loads[p] + units[u].load <= bound) {
+          best = p;
+        }
+      }
+      if (best != from) {
+        enclave_loads[from] -= units[u].load;
+        enclave_loads[best] += units[u].load;
+        units[u].enclave = best;
+        moved = true;
+      }
+    }
+    if (!moved) {
+      break;
+    }
+  }
+  free(weights);
+  free(order);
+}
+
+int main(int argc, const char* argv[]) {
+  const char* profile_path = NULL;
+  const char* trace_path = NULL;
+  const char* output_path = "partition.csv";
+  int k = 2;
+  double imbalance = 0.1;
+  int level = 1;
+  int i = 1;
+  while (i < argc) {
+    const char* arg = argv[i++];
+    bool has_value = i < argc;
+    if ((strcmp(arg, "-t") == 0 || strcmp(arg, "--trace") == 0) && has_value) {
+      trace_path = argv[i++];
+    } else if ((strcmp(arg, "-k") == 0 || strcmp(arg, "--enclaves") == 0) && has_value) {
+      k = atoi(argv[i++]);
+    } else if ((strcmp(arg, "-b") == 0 || strcmp(arg, "--imbalance") == 0) && has_value) {
+      imbalance = atof(argv[i++]);
+    } else if ((strcmp(arg, "-l") == 0 || strcmp(arg, "--level") == 0) && has_value) {
+      level = atoi(argv[i++]);
+    } else if ((strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) && has_value) {
+      output_path = argv[i++];
+    } else if (arg[0] != '-' && profile_path == NULL) {
+      profile_path = arg;
+    } else {
+      usage();
+      return -1;
+    }
+  }
+  if (profile_path == NULL || k < 1 || imbalance < 0 || level < 0) {
+    usage();
+    return -1;
+  }
+
+  if (trace_path != NULL) {
+    trace_file = open_file(trace_path, "r");
+    if (trace_file == NULL) {
+      return 1;
+    }
+    set_name_table(trace_path);
+    if (read_header() == (size_t)-1) {
+      return 1;
+    }
+  }
+  FILE* profile = open_file(profile_path, "r");
+  if (profile == NULL) {
+    return 1;
+  }
+  read_profile(profile, level);
+  if (num_units == 0) {
+    fprintf(stderr, "ERROR: No reactions in %s.\n", profile_path);
+    return 1;
+  }
+  index_edges();
+
+  interval_t total = 0;
+  for (int u = 0; u < num_units; u++) {
+    total += units[u].load;
+  }
+  interval_t bound = (interval_t)((double)total / k * (1.0 + imbalance));
+  enclave_loads = (interval_t*)check_allocated(calloc(k, sizeof(interval_t)));
+  partition(k, bound);
+
+  int64_t cut = 0;
+  int64_t all = 0;
+  for (size_t e = 0; e < num_edges; e++) {
+    all += edges[e].weight;
+    if (units[edges[e].from].enclave != units[edges[e].to].enclave) {
+      cut += edges[e].weight;
+    }
+  }
+  // Each connection is counted at both of its units.
+  printf("Partitioned %d units with a total load of " PRINTF_TIME " ns into %d enclaves.\n", num_units, total, k);
+  printf("Invocations that trigger reactions in another enclave: %lld of %lld.\n", (long long)cut / 2,
+         (long long)all / 2);
+  output_file = open_file(output_path, "w");
+  if (output_file == NULL) {
+    return 1;
+  }
+  fprintf(output_file, "unit,enclave\n");
+  for (int p = 0; p < k; p++) {
+    printf("Enclave %d: load " PRINTF_TIME " ns (%.1f%%)\n", p, enclave_loads[p],
+           total > 0 ? 100.0 * enclave_loads[p] / total : 0.0);
+    for (int u = 0; u < num_units; u++) {
+      if (units[u].enclave == p) {
+        printf("  %s\n", units[u].name);
+        fprintf(output_file, "%s,%d\n", units[u].name, p);
+      }
+    }
+  }
+  for (int p = 0; p < k; p++) {
+    if (enclave_loads[p] > bound) {
+      printf("WARNING: Enclave %d exceeds the bound on its load because of a unit that is too heavy. "
+             "Use a larger -l to split it.\n",
+             p);
+    }
+  }
+  for (int u = 0; u < num_units; u++) {
+    free(units[u].name);
+  }
+  free(units);
+  free(reactions);
+  free(edges);
+  free(enclave_loads);
+  return 0;
+}
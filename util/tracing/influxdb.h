@@ -8,7 +8,10 @@
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <stdlib.h>
+#include <pthread.h>
 #include <curl/curl.h>
+#include <zlib.h>
 
 /*
   Usage:
@@ -23,6 +26,13 @@
 
             INFLUX_END);
 
+  To send many points, use an influx_v2_writer_t instead, which sends them in batches:
+    influx_v2_writer_t w;
+    influx_v2_writer_open(&w, c, 5000, 1 << 20, 1);
+    influx_v2_writer_add(&w, INFLUX_MEAS("foo"), INFLUX_F_INT("i", 1), INFLUX_END);
+    ...
+    influx_v2_writer_close(&w);
+
   **NOTICE**: For best performance you should sort tags by key before sending them to the database.
               The sort should match the results from the [Go bytes.Compare
   function](https://golang.org/pkg/bytes/#Compare).
@@ -57,6 +67,47 @@ typedef struct _influx_v2_client_t {
   char* token; // http only
 } influx_v2_client_t;
 
+/** The number of batches that can wait for the sender thread of an influx_v2_writer_t. */
+#define INFLUX_V2_WRITER_QUEUE_SIZE 4
+
+/** A batch of points in line protocol. */
+typedef struct _influx_batch_t {
+  char* data;
+  size_t used;
+  size_t len;
+} influx_batch_t;
+
+/**
+ * Writer that sends points to InfluxDB v2 in batches of up to max_points points or
+ * max_bytes bytes. Full batches are handed to a sender thread, which compresses them
+ * with gzip if requested and posts them over one keep-alive connection, so that
+ * formatting the next batch overlaps with sending the previous ones.
+ */
+typedef struct _influx_v2_writer_t {
+  influx_v2_client_t* client;
+  size_t max_points;
+  size_t max_bytes;
+  int gzip;
+  influx_batch_t batch; // The batch being filled.
+  size_t points;        // The number of points in the batch being filled.
+  char* line;           // Buffer for formatting one point.
+  size_t line_len;
+  pthread_t sender;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  influx_batch_t queue[INFLUX_V2_WRITER_QUEUE_SIZE]; // Batches waiting for the sender.
+  int queue_head;
+  int queue_count;
+  int closing;
+  int error; // The first error of the sender, or 0.
+} influx_v2_writer_t;
+
+int influx_v2_writer_open(influx_v2_writer_t* w, influx_v2_client_t* c, size_t max_points, size_t max_bytes,
+                          int gzip);
+int influx_v2_writer_add(influx_v2_writer_t* w, ...);
+int influx_v2_writer_flush(influx_v2_writer_t* w);
+int influx_v2_writer_close(influx_v2_writer_t* w);
+
 int format_line(char** buf, int* len, size_t used, ...);
 int post_http(influx_client_t* c, ...);
 int send_udp(influx_client_t* c, ...);
@@ -311,6 +362,197 @@ int post_curl(influx_v2_client_t* c, ...) {
   return res;
 }
 
+/**
+ * Compress src into a gzip stream in dest, growing dest as needed.
+ * Return the size of the compressed data, or -1 on failure.
+ */
+static long _influx_gzip(z_stream* zs, const char* src, size_t size, influx_batch_t* dest) {
+  if (deflateReset(zs) != Z_OK)
+    return -1;
+  size_t bound = deflateBound(zs, size);
+  if (dest->len < bound) {
+    char* data = (char*)realloc(dest->data, bound);
+    if (!data)
+      return -1;
+    dest->data = data;
+    dest->len = bound;
+  }
+  zs->next_in = (Bytef*)src;
+  zs->avail_in = size;
+  zs->next_out = (Bytef*)dest->data;
+  zs->avail_out = dest->len;
+  if (deflate(zs, Z_FINISH) != Z_STREAM_END)
+    return -1;
+  return (long)zs->total_out;
+}
+
+/**
+ * Body of the sender thread of an influx_v2_writer_t.
+ * It has its own curl handle, so that libcurl keeps the connection alive between batches.
+ */
+static void* _influx_v2_writer_send(void* arg) {
+  influx_v2_writer_t* w = (influx_v2_writer_t*)arg;
+  influx_v2_client_t* c = w->client;
+  influx_batch_t compressed = {NULL, 0, 0};
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  int error = 0;
+
+  CURL* curl = curl_easy_init();
+  if (!curl)
+    error = CURLE_FAILED_INIT;
+  if (w->gzip && deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    error = -1;
+
+  char url_string[512];
+  snprintf(url_string, sizeof(url_string), "http://%s:%d/api/v2/write?org=%s&bucket=%s&precision=%s",
+           c->host ? c->host : "localhost", c->port ? c->port : 8086, c->org, c->bucket,
+           c->precision ? c->precision : "ns");
+  char token_string[512];
+  snprintf(token_string, sizeof(token_string), "Authorization: Token %s", c->token ? c->token : "");
+  struct curl_slist* list = NULL;
+  list = curl_slist_append(list, token_string);
+  list = curl_slist_append(list, "Content-Type: text/plain; charset=utf-8");
+  if (w->gzip)
+    list = curl_slist_append(list, "Content-Encoding: gzip");
+  if (curl) {
+    curl_easy_setopt(curl, CURLOPT_URL, url_string);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+  }
+
+  pthread_mutex_lock(&w->mutex);
+  for (;;) {
+    while (w->queue_count == 0 && !w->closing)
+      pthread_cond_wait(&w->cond, &w->mutex);
+    if (w->queue_count == 0)
+      break;
+    influx_batch_t* batch = &w->queue[w->queue_head];
+    pthread_mutex_unlock(&w->mutex);
+
+    if (!error) {
+      const char* body = batch->data;
+      long size = (long)batch->used;
+      if (w->gzip) {
+        size = _influx_gzip(&zs, batch->data, batch->used, &compressed);
+        body = compressed.data;
+      }
+      if (size < 0) {
+        error = -1;
+      } else {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, size);
+        CURLcode res = curl_easy_perform(curl);
+        long status = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+        if (res != CURLE_OK) {
+          fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
+          error = res;
+        } else if (status / 100 != 2) {
+          fprintf(stderr, "InfluxDB rejected a batch with HTTP status %ld.\n", status);
+          error = (int)status;
+        }
+      }
+    }
+
+    pthread_mutex_lock(&w->mutex);
+    // Keep the buffer of the batch for reuse by the writer.
+    batch->used = 0;
+    w->queue_head = (w->queue_head + 1) % INFLUX_V2_WRITER_QUEUE_SIZE;
+    w->queue_count--;
+    if (error && !w->error)
+      w->error = error;
+    pthread_cond_broadcast(&w->cond);
+  }
+  pthread_mutex_unlock(&w->mutex);
+
+  if (w->gzip)
+    deflateEnd(&zs);
+  free(compressed.data);
+  curl_slist_free_all(list);
+  if (curl)
+    curl_easy_cleanup(curl);
+  return NULL;
+}
+
+int influx_v2_writer_open(influx_v2_writer_t* w, influx_v2_client_t* c, size_t max_points, size_t max_bytes,
+                          int gzip) {
+  memset(w, 0, sizeof(*w));
+  w->client = c;
+  w->max_points = max_points > 0 ? max_points : 1;
+  w->max_bytes = max_bytes;
+  w->gzip = gzip;
+  curl_global_init(CURL_GLOBAL_ALL);
+  pthread_mutex_init(&w->mutex, NULL);
+  pthread_cond_init(&w->cond, NULL);
+  if (pthread_create(&w->sender, NULL, _influx_v2_writer_send, w) != 0)
+    return -1;
+  return 0;
+}
+
+int influx_v2_writer_flush(influx_v2_writer_t* w) {
+  pthread_mutex_lock(&w->mutex);
+  if (w->points > 0) {
+    // Wait for a free slot. Its buffer is swapped with the one of the batch being filled.
+    while (w->queue_count == INFLUX_V2_WRITER_QUEUE_SIZE)
+      pthread_cond_wait(&w->cond, &w->mutex);
+    influx_batch_t* slot = &w->queue[(w->queue_head + w->queue_count) % INFLUX_V2_WRITER_QUEUE_SIZE];
+    influx_batch_t empty = *slot;
+    *slot = w->batch;
+    w->batch = empty;
+    w->points = 0;
+    w->queue_count++;
+    pthread_cond_broadcast(&w->cond);
+  }
+  int error = w->error;
+  pthread_mutex_unlock(&w->mutex);
+  return error;
+}
+
+int influx_v2_writer_add(influx_v2_writer_t* w, ...) {
+  va_list ap;
+  va_start(ap, w);
+  int len = _format_line2(&w->line, ap, &w->line_len, 0);
+  va_end(ap);
+  if (len < 0) {
+    w->line_len = 0;
+    return -1;
+  }
+  if (w->batch.used + len > w->batch.len) {
+    size_t new_len = w->batch.len ? w->batch.len : 0x1000;
+    while (new_len < w->batch.used + len)
+      new_len *= 2;
+    char* data = (char*)realloc(w->batch.data, new_len);
+    if (!data)
+      return -2;
+    w->batch.data = data;
+    w->batch.len = new_len;
+  }
+  memcpy(w->batch.data + w->batch.used, w->line, len);
+  w->batch.used += len;
+  if (++w->points >= w->max_points || (w->max_bytes > 0 && w->batch.used >= w->max_bytes))
+    return influx_v2_writer_flush(w);
+  return 0;
+}
+
+int influx_v2_writer_close(influx_v2_writer_t* w) {
+  influx_v2_writer_flush(w);
+  pthread_mutex_lock(&w->mutex);
+  w->closing = 1;
+  pthread_cond_broadcast(&w->cond);
+  pthread_mutex_unlock(&w->mutex);
+  pthread_join(w->sender, NULL);
+  for (int i = 0; i < INFLUX_V2_WRITER_QUEUE_SIZE; i++)
+    free(w->queue[i].data);
+  free(w->batch.data);
+  free(w->line);
+  pthread_mutex_destroy(&w->mutex);
+  pthread_cond_destroy(&w->cond);
+  curl_global_cleanup();
+  return w->error;
+}
+
 int format_line(char** buf, int* len, size_t used, ...) {
   va_list ap;
   va_start(ap, used);
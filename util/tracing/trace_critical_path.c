@@ -0,0 +1,973 @@
+/**
+ * @file
+ * @brief Standalone program that finds the critical paths of the tags of a Lingua Franca program
+ * in its trace files.
+ *
+ * The trace files of all federates of a federation, and of the RTI, can be analyzed together.
+ * The trace files have no dependency graph, so the dependencies of each reaction invocation
+ * are inferred from the physical times of the records. Its predecessor is whichever became
+ * ready last before it started: either the invocation at the same tag in the same process
+ * that ended last before it started, which it waited for because of a dependency, a level
+ * barrier or a busy worker, or the invocation that sent the last tagged message that the
+ * process received at the same tag before it started. A message is matched to its sender
+ * through the records of the RTI, if its trace file is given, and by tag and time otherwise.
+ *
+ * The critical path of a tag ends at the invocation at that tag that ended last in any
+ * process and follows the predecessors back, across messages to earlier tags and other
+ * federates. The slack of an invocation is how much later it could have ended without
+ * delaying the last invocation at its tag in its process. While the reactions at a tag
+ * execute, workers that are idle wait at a level barrier or for a dependency. That idle
+ * time is charged to the worker and, in equal parts, to the reactions that are executing,
+ * which are the ones to optimize or to split so that the work of the level is spread better.
+ *
+ * The report is written to a text file, critical_path.txt unless given with -o.
+ */
+#define LF_TRACE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reactor.h"
+#include "trace.h"
+#include "trace_util.h"
+
+/** Index of no invocation or message. */
+#define NONE ((size_t)-1)
+
+/** Number of longest critical paths printed by default. */
+#define DEFAULT_NUMBER_OF_PATHS 5
+
+/** File containing the trace binary data. */
+FILE* trace_file = NULL;
+
+/** File for writing the report. */
+FILE* output_file = NULL;
+
+/** Unused, but declared by trace_util.h. */
+FILE* summary_file = NULL;
+
+/**
+ * Print a usage message.
+ */
+void usage() {
+  printf("\nUsage: trace_critical_path [options] trace_file ... (with .lft extension)\n");
+  printf("Give the trace files of all federates and of the RTI to analyze a federation.\n");
+  printf("Options: \n");
+  printf("  -o, --output [file]\n");
+  printf("   The file to write the report to (default: critical_path.txt).\n");
+  printf("  -n, --paths [number]\n");
+  printf("   The number of longest critical paths to print (default: %d).\n", DEFAULT_NUMBER_OF_PATHS);
+  printf("  -s, --start [time_spec] [units]\n");
+  printf("   The elapsed logical time at which to begin the analysis.\n");
+  printf("  -e, --end [time_spec] [units]\n");
+  printf("   The elapsed logical time at which to end the analysis.\n");
+  printf("\n");
+}
+
+/** @brief A trace file. */
+typedef struct process_t {
+  char* name;           // The root name of the trace file.
+  int fed_id;           // The ID of the federate, or -1 if unknown or the process is the RTI.
+  bool is_rti;          // Whether the trace file was written by the RTI.
+  int num_workers;      // One more than the largest worker number of a reaction.
+  instant_t start_time; // The start time in the header of the trace file.
+  interval_t* busy;     // Per worker, the time spent executing reactions.
+  interval_t* idle;     // Per worker, the time spent idle while other workers executed reactions at the same tag.
+} process_t;
+
+/** @brief A reaction of a process. */
+typedef struct reaction_info_t {
+  int process;
+  void* reactor;
+  int number;
+  char* name;
+  size_t invocations;
+  size_t critical;          // Number of critical paths on which it is.
+  interval_t total_time;    // Sum of the execution times.
+  interval_t critical_time; // Sum of the execution times of the invocations on critical paths.
+  interval_t total_slack;   // Sum of the slacks.
+  interval_t min_slack;     // Minimum slack.
+  interval_t idle_caused;   // Worker idle time while it was executing.
+} reaction_info_t;
+
+/** @brief An invocation of a reaction. */
+typedef struct invocation_t {
+  size_t reaction; // Index in reactions.
+  int process;
+  int worker;
+  tag_t tag;
+  instant_t start;
+  instant_t end;
+  size_t predecessor; // Index in invocations, or NONE.
+  size_t message;     // Index in messages of the message through which the predecessor is reached, or NONE.
+  instant_t latest_end;
+} invocation_t;
+
+/** @brief A record of a tagged message. */
+typedef struct message_record_t {
+  int process;
+  int event_type;
+  int src_id;
+  int dst_id;
+  tag_t tag;
+  instant_t time;
+  bool matched;
+} message_record_t;
+
+/** @brief A tagged message between federates. */
+typedef struct message_t {
+  int sender;                // Sending process, or -1 if unknown.
+  int receiver;              // Receiving process.
+  tag_t tag;                 // The intended tag.
+  instant_t sent;            // Physical time of sending, or NEVER if unknown.
+  instant_t rti_received;    // Physical time of receipt by the RTI, or NEVER.
+  instant_t rti_sent;        // Physical time of forwarding by the RTI, or NEVER.
+  instant_t received;        // Physical time of receipt.
+  size_t sending_invocation; // Index in invocations, or NONE.
+} message_t;
+
+/** @brief The critical path of a tag. */
+typedef struct path_t {
+  tag_t tag;
+  size_t sink; // Index in invocations of the last invocation of the path.
+  interval_t length;
+} path_t;
+
+// Growable arrays.
+static process_t* processes = NULL;
+static int num_processes = 0;
+static reaction_info_t* reactions = NULL;
+static size_t num_reactions = 0, reactions_capacity = 0;
+static invocation_t* invocations = NULL;
+static size_t num_invocations = 0, invocations_capacity = 0;
+static message_record_t* message_records = NULL;
+static size_t num_message_records = 0, message_records_capacity = 0;
+static message_t* messages = NULL;
+static size_t num_messages = 0, messages_capacity = 0;
+
+/** Open-addressing hash table from (process, reactor, number) to index in reactions + 1. */
+static size_t* reaction_table = NULL;
+static size_t reaction_table_size = 0;
+
+/** The earliest start time of the trace files, relative to which times are printed. */
+static instant_t global_start_time = FOREVER;
+
+/**
+ * Make room for one more element in a growable array.
+ */
+static void* grow(void* array, size_t size, size_t* capacity, size_t element_size) {
+  if (size < *capacity) {
+    return array;
+  }
+  *capacity = (*capacity == 0) ? 1024 : *capacity * 2;
+  void* result = realloc(array, *capacity * element_size);
+  if (result == NULL) {
+    fprintf(stderr, "ERROR: Out of memory.\n");
+    exit(3);
+  }
+  return result;
+}
+
+/** Compare two tags, like lf_tag_compare, which is not linked into the tools. */
+static int compare_tags(tag_t a, tag_t b) {
+  if (a.time != b.time) {
+    return (a.time > b.time) - (a.time < b.time);
+  }
+  return (a.microstep > b.microstep) - (a.microstep < b.microstep);
+}
+
+/** Return the hash of a reaction. */
+static size_t reaction_hash(int process, void* reactor, int number) {
+  uint64_t h = (uint64_t)(uintptr_t)reactor * 0x9E3779B97F4A7C15ULL;
+  h ^= ((uint64_t)(uint32_t)process << 32) ^ (uint64_t)(uint32_t)number;
+  h *= 0xBF58476D1CE4E5B9ULL;
+  return (size_t)(h ^ (h >> 31));
+}
+
+/**
+ * Return the index in reactions of the given reaction, adding it if it is new.
+ */
+static size_t find_reaction(int process, void* reactor, int number) {
+  if (2 * (num_reactions + 1) > reaction_table_size) {
+    // Rehash into a table twice as large.
+    size_t old_size = reaction_table_size;
+    size_t* old_table = reaction_table;
+    reaction_table_size = (old_size == 0) ? 1024 : old_size * 2;
+    reaction_table = (size_t*)calloc(reaction_table_size, sizeof(size_t));
+    if (reaction_table == NULL) {
+      fprintf(stderr, "ERROR: Out of memory.\n");
+      exit(3);
+    }
+    for (size_t i = 0; i < old_size; i++) {
+      if (old_table[i] != 0) {
+        reaction_info_t* r = &reactions[old_table[i] - 1];
+        size_t slot = reaction_hash(r->process, r->reactor, r->number) & (reaction_table_size - 1);
+        while (reaction_table[slot] != 0) {
+          slot = (slot + 1) & (reaction_table_size - 1);
+        }
+        reaction_table[slot] = old_table[i];
+      }
+    }
+    free(old_table);
+  }
+  size_t slot = reaction_hash(process, reactor, number) & (reaction_table_size - 1);
+  while (reaction_table[slot] != 0) {
+    reaction_info_t* r = &reactions[reaction_table[slot] - 1];
+    if (r->process == process && r->reactor == reactor && r->number == number) {
+      return reaction_table[slot] - 1;
+    }
+    slot = (slot + 1) & (reaction_table_size - 1);
+  }
+  reactions = grow(reactions, num_reactions, &reactions_capacity, sizeof(reaction_info_t));
+  reaction_info_t* r = &reactions[num_reactions];
+  memset(r, 0, sizeof(*r));
+  r->process = process;
+  r->reactor = reactor;
+  r->number = number;
+  r->min_slack = FOREVER;
+  char* reactor_name = get_object_description(reactor, NULL);
+  size_t length = strlen(processes[process].name) + (reactor_name == NULL ? 7 : strlen(reactor_name)) + 32;
+  r->name = (char*)malloc(length);
+  if (r->name == NULL) {
+    fprintf(stderr, "ERROR: Out of memory.\n");
+    exit(3);
+  }
+  if (num_processes > 1) {
+    snprintf(r->name, length, "%s: %s reaction %d", processes[process].name,
+             reactor_name == NULL ? "UNKNOWN" : reactor_name, number);
+  } else {
+    snprintf(r->name, length, "%s reaction %d", reactor_name == NULL ? "UNKNOWN" : reactor_name, number);
+  }
+  reaction_table[slot] = ++num_reactions;
+  return num_reactions - 1;
+}
+
+/**
+ * Read the trace file of the given process, whose header has been read, and collect its
+ * reaction invocations and the records of its tagged messages.
+ */
+static void read_process(int process) {
+  process_t* p = &processes[process];
+  // The invocation being executed by each worker.
+  size_t* executing = NULL;
+  int executing_size = 0;
+  int length;
+  while ((length = read_trace()) > 0) {
+    for (int i = 0; i < length; i++) {
+      trace_record_t* record = &trace[i];
+      switch (record->event_type) {
+      case reaction_starts:
+      case reaction_ends: {
+        int worker = record->src_id < 0 ? 0 : record->src_id;
+        if (worker >= executing_size) {
+          int size = worker + 1;
+          executing = (size_t*)realloc(executing, size * sizeof(size_t));
+          if (executing == NULL) {
+            fprintf(stderr, "ERROR: Out of memory.\n");
+            exit(3);
+          }
+          for (int w = executing_size; w < size; w++) {
+            executing[w] = NONE;
+          }
+          executing_size = size;
+        }
+        if (record->event_type == reaction_starts) {
+          invocations = grow(invocations, num_invocations, &invocations_capacity, sizeof(invocation_t));
+          invocation_t* inv = &invocations[num_invocations];
+          inv->reaction = find_reaction(process, record->pointer, record->dst_id);
+          inv->process = process;
+          inv->worker = worker;
+          inv->tag = (tag_t){.time = record->logical_time, .microstep = (microstep_t)record->microstep};
+          inv->start = record->physical_time;
+          inv->end = NEVER;
+          inv->predecessor = NONE;
+          inv->message = NONE;
+          executing[worker] = num_invocations++;
+        } else if (executing[worker] != NONE) {
+          invocations[executing[worker]].end = record->physical_time;
+          executing[worker] = NONE;
+        }
+        if (worker >= p->num_workers) {
+          p->num_workers = worker + 1;
+        }
+        break;
+      }
+      case send_TAGGED_MSG:
+      case receive_TAGGED_MSG:
+      case send_P2P_TAGGED_MSG:
+      case receive_P2P_TAGGED_MSG:
+        message_records = grow(message_records, num_message_records, &message_records_capacity,
+                               sizeof(message_record_t));
+        message_records[num_message_records++] = (message_record_t){
+            .process = process,
+            .event_type = record->event_type,
+            .src_id = record->src_id,
+            .dst_id = record->dst_id,
+            .tag = {.time = record->logical_time, .microstep = (microstep_t)record->microstep},
+            .time = record->physical_time,
+            .matched = false};
+        // Fall through.
+      default:
+        if (record->event_type > federated) {
+          // The RTI is the source of its records. A federate is the source of its own.
+          if (record->src_id == -1 && record->pointer == NULL) {
+            p->is_rti = true;
+          } else if (p->fed_id < 0 && record->src_id >= 0) {
+            p->fed_id = record->src_id;
+          }
+        }
+        break;
+      }
+    }
+  }
+  free(executing);
+}
+
+/** Compare tags, then physical times, of message records. */
+static int compare_message_records(const void* a, const void* b) {
+  const message_record_t* x = (const message_record_t*)a;
+  const message_record_t* y = (const message_record_t*)b;
+  int c = compare_tags(x->tag, y->tag);
+  if (c != 0) {
+    return c;
+  }
+  return (x->time > y->time) - (x->time < y->time);
+}
+
+/** Return the process of the federate with the given ID, or -1 if its trace file was not given. */
+static int process_of_federate(int fed_id) {
+  for (int i = 0; i < num_processes; i++) {
+    if (!processes[i].is_rti && processes[i].fed_id == fed_id) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Among the unmatched records from `from` to `to` with the given event type, process and,
+ * unless -2, source and destination IDs, return the index of the latest one no later than
+ * `time`, or of the earliest one if there is none, or NONE.
+ */
+static size_t find_record(size_t from, size_t to, int event_type, int process, int src_id, int dst_id, instant_t time) {
+  size_t latest = NONE, earliest = NONE;
+  for (size_t i = from; i < to; i++) {
+    message_record_t* m = &message_records[i];
+    if (m->matched || m->event_type != event_type || (process >= 0 && m->process != process) ||
+        (src_id != -2 && m->src_id != src_id) || (dst_id != -2 && m->dst_id != dst_id)) {
+      continue;
+    }
+    if (earliest == NONE) {
+      earliest = i;
+    }
+    if (m->time <= time) {
+      latest = i;
+    }
+  }
+  return latest != NONE ? latest : earliest;
+}
+
+/**
+ * Match the receipts of tagged messages to their sending, within each group of records
+ * with the same tag.
+ */
+static void match_messages() {
+  qsort(message_records, num_message_records, sizeof(message_record_t), compare_message_records);
+  int rti = -1;
+  for (int i = 0; i < num_processes; i++) {
+    if (processes[i].is_rti) {
+      rti = i;
+    }
+  }
+  size_t from = 0;
+  while (from < num_message_records) {
+    size_t to = from;
+    while (to < num_message_records && compare_tags(message_records[to].tag, message_records[from].tag) == 0) {
+      to++;
+    }
+    for (size_t i = from; i < to; i++) {
+      message_record_t* r = &message_records[i];
+      if (processes[r->process].is_rti ||
+          (r->event_type != receive_TAGGED_MSG && r->event_type != receive_P2P_TAGGED_MSG)) {
+        continue;
+      }
+      messages = grow(messages, num_messages, &messages_capacity, sizeof(message_t));
+      message_t* m = &messages[num_messages++];
+      *m = (message_t){.sender = -1,
+                       .receiver = r->process,
+                       .tag = r->tag,
+                       .sent = NEVER,
+                       .rti_received = NEVER,
+                       .rti_sent = NEVER,
+                       .received = r->time,
+                       .sending_invocation = NONE};
+      size_t sent = NONE;
+      if (r->event_type == receive_P2P_TAGGED_MSG) {
+        // The partner of a receipt is the sender and the partner of a sending is the receiver.
+        sent = find_record(from, to, send_P2P_TAGGED_MSG, process_of_federate(r->dst_id), -2,
+                           processes[r->process].fed_id, r->time);
+      } else if (rti >= 0) {
+        size_t forwarded = find_record(from, to, send_TAGGED_MSG, rti, -2, processes[r->process].fed_id, r->time);
+        if (forwarded != NONE) {
+          message_records[forwarded].matched = true;
+          m->rti_sent = message_records[forwarded].time;
+          size_t arrived = find_record(from, to, receive_TAGGED_MSG, rti, -2, -2, m->rti_sent);
+          if (arrived != NONE) {
+            message_records[arrived].matched = true;
+            m->rti_received = message_records[arrived].time;
+            int sender = process_of_federate(message_records[arrived].dst_id);
+            if (sender >= 0) {
+              sent = find_record(from, to, send_TAGGED_MSG, sender, -2, -2, m->rti_received);
+            }
+          }
+        }
+      } else {
+        // Without the trace of the RTI, take the latest message sent by another federate at the tag.
+        for (size_t j = from; j < to; j++) {
+          message_record_t* s = &message_records[j];
+          if (!s->matched && s->event_type == send_TAGGED_MSG && s->process != r->process &&
+              !processes[s->process].is_rti && (sent == NONE || s->time <= r->time)) {
+            sent = j;
+          }
+        }
+      }
+      if (sent != NONE) {
+        message_records[sent].matched = true;
+        m->sender = message_records[sent].process;
+        m->sent = message_records[sent].time;
+      }
+    }
+    from = to;
+  }
+}
+
+/** Compare invocations by process, tag and start time. */
+static int compare_by_start(const void* a, const void* b) {
+  const invocation_t* x = &invocations[*(const size_t*)a];
+  const invocation_t* y = &invocations[*(const size_t*)b];
+  if (x->process != y->process) {
+    return x->process - y->process;
+  }
+  int c = compare_tags(x->tag, y->tag);
+  if (c != 0) {
+    return c;
+  }
+  return (x->start > y->start) - (x->start < y->start);
+}
+
+/** Compare invocations by end time. */
+static int compare_by_end(const void* a, const void* b) {
+  const invocation_t* x = &invocations[*(const size_t*)a];
+  const invocation_t* y = &invocations[*(const size_t*)b];
+  return (x->end > y->end) - (x->end < y->end);
+}
+
+/** Compare messages by receiver, tag and time of receipt. */
+static int compare_messages(const void* a, const void* b) {
+  const message_t* x = (const message_t*)a;
+  const message_t* y = (const message_t*)b;
+  if (x->receiver != y->receiver) {
+    return x->receiver - y->receiver;
+  }
+  int c = compare_tags(x->tag, y->tag);
+  if (c != 0) {
+    return c;
+  }
+  return (x->received > y->received) - (x->received < y->received);
+}
+
+/**
+ * Return the invocation of a process that executed at the given physical time, preferring
+ * the one that started last, or else the last one that started before it, or NONE.
+ * @param by_time The invocations of the process sorted by start time.
+ * @param count The number of invocations.
+ * @param time The physical time.
+ */
+static size_t executing_at(size_t* by_time, size_t count, instant_t time) {
+  // Find the last invocation that started no later than the time.
+  size_t low = 0, high = count;
+  while (low < high) {
+    size_t mid = (low + high) / 2;
+    if (invocations[by_time[mid]].start <= time) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  // Look back over the invocations that may still execute on other workers.
+  for (size_t i = low, checked = 0; i > 0 && checked < 256; i--, checked++) {
+    invocation_t* inv = &invocations[by_time[i - 1]];
+    if (inv->end >= time) {
+      return by_time[i - 1];
+    }
+  }
+  return low > 0 ? by_time[low - 1] : NONE;
+}
+
+/** Compare invocations by start time only. */
+static int compare_by_start_time(const void* a, const void* b) {
+  const invocation_t* x = &invocations[*(const size_t*)a];
+  const invocation_t* y = &invocations[*(const size_t*)b];
+  return (x->start > y->start) - (x->start < y->start);
+}
+
+/**
+ * Find the sending invocation of each message.
+ */
+static void find_senders() {
+  for (int p = 0; p < num_processes; p++) {
+    size_t count = 0;
+    for (size_t i = 0; i < num_invocations; i++) {
+      count += (invocations[i].process == p);
+    }
+    if (count == 0) {
+      continue;
+    }
+    size_t* by_time = (size_t*)malloc(count * sizeof(size_t));
+    if (by_time == NULL) {
+      fprintf(stderr, "ERROR: Out of memory.\n");
+      exit(3);
+    }
+    count = 0;
+    for (size_t i = 0; i < num_invocations; i++) {
+      if (invocations[i].process == p) {
+        by_time[count++] = i;
+      }
+    }
+    qsort(by_time, count, sizeof(size_t), compare_by_start_time);
+    for (size_t m = 0; m < num_messages; m++) {
+      if (messages[m].sender == p && messages[m].sent != NEVER) {
+        messages[m].sending_invocation = executing_at(by_time, count, messages[m].sent);
+      }
+    }
+    free(by_time);
+  }
+}
+
+/** A change in the number of busy workers of a process at a tag. */
+typedef struct sweep_event_t {
+  instant_t time;
+  size_t invocation;
+  bool starts;
+} sweep_event_t;
+
+/** Compare sweep events by time, with ends before starts. */
+static int compare_sweep_events(const void* a, const void* b) {
+  const sweep_event_t* x = (const sweep_event_t*)a;
+  const sweep_event_t* y = (const sweep_event_t*)b;
+  if (x->time != y->time) {
+    return (x->time > y->time) - (x->time < y->time);
+  }
+  return (int)x->starts - (int)y->starts;
+}
+
+/**
+ * Charge the idle time of the workers of a process during the execution of the invocations
+ * at a tag to the workers and to the executing reactions.
+ * @param group The invocations of the process at the tag.
+ * @param count The number of invocations.
+ */
+static void sweep_idle(size_t* group, size_t count, sweep_event_t* events, size_t* executing) {
+  process_t* p = &processes[invocations[group[0]].process];
+  int workers = p->num_workers;
+  for (size_t i = 0; i < count; i++) {
+    invocation_t* inv = &invocations[group[i]];
+    events[2 * i] = (sweep_event_t){.time = inv->start, .invocation = group[i], .starts = true};
+    events[2 * i + 1] = (sweep_event_t){.time = inv->end, .invocation = group[i], .starts = false};
+    p->busy[inv->worker] += inv->end - inv->start;
+  }
+  qsort(events, 2 * count, sizeof(sweep_event_t), compare_sweep_events);
+  for (int w = 0; w < workers; w++) {
+    executing[w] = NONE;
+  }
+  int busy = 0;
+  for (size_t e = 0; e < 2 * count; e++) {
+    if (e > 0 && busy > 0 && busy < workers) {
+      interval_t duration = events[e].time - events[e - 1].time;
+      interval_t share = duration * (workers - busy) / busy;
+      for (int w = 0; w < workers; w++) {
+        if (executing[w] == NONE) {
+          p->idle[w] += duration;
+        } else {
+          reactions[invocations[executing[w]].reaction].idle_caused += share;
+        }
+      }
+    }
+    invocation_t* inv = &invocations[events[e].invocation];
+    if (events[e].starts) {
+      busy += (executing[inv->worker] == NONE);
+      executing[inv->worker] = events[e].invocation;
+    } else if (executing[inv->worker] == events[e].invocation) {
+      busy--;
+      executing[inv->worker] = NONE;
+    }
+  }
+}
+
+/**
+ * Find the predecessor and the slack of each invocation, and the idle time of the workers.
+ */
+static void analyze_processes() {
+  size_t* by_start = (size_t*)malloc(num_invocations * sizeof(size_t));
+  size_t* by_end = (size_t*)malloc(num_invocations * sizeof(size_t));
+  sweep_event_t* events = (sweep_event_t*)malloc(2 * num_invocations * sizeof(sweep_event_t));
+  int max_workers = 1;
+  for (int p = 0; p < num_processes; p++) {
+    max_workers = LF_MAX(max_workers, processes[p].num_workers);
+  }
+  size_t* executing = (size_t*)malloc((size_t)max_workers * sizeof(size_t));
+  if (by_start == NULL || by_end == NULL || events == NULL || executing == NULL) {
+    fprintf(stderr, "ERROR: Out of memory.\n");
+    exit(3);
+  }
+  for (size_t i = 0; i < num_invocations; i++) {
+    by_start[i] = i;
+  }
+  qsort(by_start, num_invocations, sizeof(size_t), compare_by_start);
+  qsort(messages, num_messages, sizeof(message_t), compare_messages);
+
+  size_t next_message = 0;
+  size_t from = 0;
+  while (from < num_invocations) {
+    // The group of invocations of a process at a tag.
+    invocation_t* first = &invocations[by_start[from]];
+    size_t to = from;
+    while (to < num_invocations && invocations[by_start[to]].process == first->process &&
+           compare_tags(invocations[by_start[to]].tag, first->tag) == 0) {
+      to++;
+    }
+    size_t count = to - from;
+    memcpy(by_end, &by_start[from], count * sizeof(size_t));
+    qsort(by_end, count, sizeof(size_t), compare_by_end);
+
+    // The messages received by the process at the tag.
+    while (next_message < num_messages &&
+           (messages[next_message].receiver < first->process ||
+            (messages[next_message].receiver == first->process &&
+             compare_tags(messages[next_message].tag, first->tag) < 0))) {
+      next_message++;
+    }
+    size_t message = next_message;
+
+    // The predecessor is whichever ended, or arrived, last before the start.
+    size_t ended = 0;
+    for (size_t i = from; i < to; i++) {
+      invocation_t* inv = &invocations[by_start[i]];
+      while (ended < count && invocations[by_end[ended]].end <= inv->start) {
+        ended++;
+      }
+      while (message < num_messages && messages[message].receiver == inv->process &&
+             compare_tags(messages[message].tag, inv->tag) == 0 && messages[message].received <= inv->start) {
+        message++;
+      }
+      instant_t ready = NEVER;
+      for (size_t e = ended; e > 0; e--) {
+        if (by_end[e - 1] != by_start[i]) {
+          inv->predecessor = by_end[e - 1];
+          ready = invocations[by_end[e - 1]].end;
+          break;
+        }
+      }
+      if (message > next_message) {
+        message_t* m = &messages[message - 1];
+        if (m->received > ready && m->sending_invocation != NONE) {
+          inv->predecessor = m->sending_invocation;
+          inv->message = message - 1;
+        }
+      }
+    }
+
+    // Propagate the latest end times back from the last end at the tag.
+    instant_t tag_end = invocations[by_end[count - 1]].end;
+    for (size_t i = 0; i < count; i++) {
+      invocations[by_end[i]].latest_end = tag_end;
+    }
+    for (size_t i = count; i > 0; i--) {
+      invocation_t* inv = &invocations[by_end[i - 1]];
+      reaction_info_t* r = &reactions[inv->reaction];
+      interval_t slack = inv->latest_end - inv->end;
+      r->invocations++;
+      r->total_time += inv->end - inv->start;
+      r->total_slack += slack;
+      r->min_slack = LF_MIN(r->min_slack, slack);
+      if (inv->predecessor != NONE && inv->message == NONE) {
+        invocation_t* pred = &invocations[inv->predecessor];
+        pred->latest_end = LF_MIN(pred->latest_end, inv->latest_end - (inv->end - inv->start));
+      }
+    }
+    sweep_idle(&by_start[from], count, events, executing);
+    from = to;
+  }
+  free(by_start);
+  free(by_end);
+  free(events);
+  free(executing);
+}
+
+/** Compare tags of invocations. */
+static int compare_by_tag(const void* a, const void* b) {
+  const invocation_t* x = &invocations[*(const size_t*)a];
+  const invocation_t* y = &invocations[*(const size_t*)b];
+  return compare_tags(x->tag, y->tag);
+}
+
+/** Compare paths by decreasing length. */
+static int compare_paths(const void* a, const void* b) {
+  const path_t* x = (const path_t*)a;
+  const path_t* y = (const path_t*)b;
+  return (x->length < y->length) - (x->length > y->length);
+}
+
+/**
+ * Return the predecessor of an invocation on a critical path, or NONE. Predecessors that
+ * do not start earlier, which clock offsets between machines can produce, are not followed.
+ */
+static size_t path_predecessor(size_t i) {
+  size_t pred = invocations[i].predecessor;
+  return (pred != NONE && invocations[pred].start < invocations[i].start) ? pred : NONE;
+}
+
+/**
+ * Print the critical path that ends with the given invocation.
+ */
+static void print_path(path_t* path) {
+  fprintf(output_file, "\nTag (" PRINTF_TIME ", " PRINTF_MICROSTEP "): critical path of " PRINTF_TIME " ns\n",
+          path->tag.time - global_start_time, path->tag.microstep, path->length);
+  fprintf(output_file, "  %14s %12s %12s %6s  %s\n", "start", "duration", "waited", "worker", "reaction");
+  // Collect the path from the sink back, then print it from the start.
+  size_t length = 0;
+  for (size_t i = path->sink; i != NONE; i = path_predecessor(i)) {
+    length++;
+  }
+  size_t* steps = (size_t*)malloc(length * sizeof(size_t));
+  if (steps == NULL) {
+    return;
+  }
+  size_t n = length;
+  for (size_t i = path->sink; i != NONE; i = path_predecessor(i)) {
+    steps[--n] = i;
+  }
+  for (size_t s = 0; s < length; s++) {
+    invocation_t* inv = &invocations[steps[s]];
+    interval_t waited = (s == 0) ? 0 : inv->start - invocations[steps[s - 1]].end;
+    if (inv->message != NONE) {
+      message_t* m = &messages[inv->message];
+      if (m->rti_received != NEVER && m->rti_sent != NEVER && m->sent != NEVER) {
+        fprintf(output_file,
+                "  %14s message at tag (" PRINTF_TIME ", " PRINTF_MICROSTEP "): " PRINTF_TIME
+                " ns to the RTI, " PRINTF_TIME " ns in the RTI, " PRINTF_TIME " ns to the receiver\n",
+                "", m->tag.time - global_start_time, m->tag.microstep, m->rti_received - m->sent,
+                m->rti_sent - m->rti_received, m->received - m->rti_sent);
+      } else {
+        fprintf(output_file, "  %14s message at tag (" PRINTF_TIME ", " PRINTF_MICROSTEP "): " PRINTF_TIME " ns\n", "",
+                m->tag.time - global_start_time, m->tag.microstep, m->received - m->sent);
+      }
+    }
+    fprintf(output_file, "  %14" PRId64 " %12" PRId64 " %12" PRId64 " %6d  %s\n",
+            (int64_t)(inv->start - global_start_time), (int64_t)(inv->end - inv->start), (int64_t)waited, inv->worker,
+            reactions[inv->reaction].name);
+  }
+  free(steps);
+}
+
+/**
+ * Find the critical path of each tag and write the report.
+ */
+static void write_report(int number_of_paths) {
+  size_t* by_tag = (size_t*)malloc(num_invocations * sizeof(size_t));
+  path_t* paths = (path_t*)malloc(num_invocations * sizeof(path_t));
+  if (by_tag == NULL || paths == NULL) {
+    fprintf(stderr, "ERROR: Out of memory.\n");
+    exit(3);
+  }
+  for (size_t i = 0; i < num_invocations; i++) {
+    by_tag[i] = i;
+  }
+  qsort(by_tag, num_invocations, sizeof(size_t), compare_by_tag);
+  size_t num_paths = 0;
+  interval_t total_length = 0;
+  size_t from = 0;
+  while (from < num_invocations) {
+    size_t to = from;
+    size_t sink = by_tag[from];
+    while (to < num_invocations && compare_tags(invocations[by_tag[to]].tag, invocations[sink].tag) == 0) {
+      if (invocations[by_tag[to]].end > invocations[sink].end) {
+        sink = by_tag[to];
+      }
+      to++;
+    }
+    size_t root = sink;
+    for (size_t i = sink; i != NONE; i = path_predecessor(i)) {
+      root = i;
+      reaction_info_t* r = &reactions[invocations[i].reaction];
+      r->critical++;
+      r->critical_time += invocations[i].end - invocations[i].start;
+    }
+    paths[num_paths++] = (path_t){
+        .tag = invocations[sink].tag, .sink = sink, .length = invocations[sink].end - invocations[root].start};
+    total_length += paths[num_paths - 1].length;
+    from = to;
+  }
+  free(by_tag);
+
+  int federates = 0;
+  bool rti = false;
+  for (int p = 0; p < num_processes; p++) {
+    rti |= processes[p].is_rti;
+    federates += (!processes[p].is_rti && processes[p].fed_id >= 0);
+  }
+  if (federates > 0 || rti) {
+    fprintf(output_file, "Critical path analysis of %d trace files (%d federates%s).\n", num_processes, federates,
+            rti ? " and the RTI" : "");
+  } else {
+    fprintf(output_file, "Critical path analysis of %d trace files.\n", num_processes);
+  }
+  fprintf(output_file, "Times are in nanoseconds, and physical times are elapsed since the start.\n");
+  qsort(paths, num_paths, sizeof(path_t), compare_paths);
+  if (num_paths > 0) {
+    fprintf(output_file, "%zu tags, critical path mean " PRINTF_TIME ", max " PRINTF_TIME ".\n", num_paths,
+            total_length / (interval_t)num_paths, paths[0].length);
+    fprintf(output_file, "\nThe %d longest critical paths:\n", (int)LF_MIN((size_t)number_of_paths, num_paths));
+    for (size_t i = 0; i < num_paths && i < (size_t)number_of_paths; i++) {
+      print_path(&paths[i]);
+    }
+  }
+  free(paths);
+
+  // Sort the reactions by their time on critical paths.
+  size_t* order = (size_t*)malloc(num_reactions * sizeof(size_t));
+  if (order == NULL) {
+    fprintf(stderr, "ERROR: Out of memory.\n");
+    exit(3);
+  }
+  for (size_t i = 0; i < num_reactions; i++) {
+    order[i] = i;
+  }
+  for (size_t i = 1; i < num_reactions; i++) {
+    size_t r = order[i];
+    size_t j = i;
+    while (j > 0 && reactions[order[j - 1]].critical_time < reactions[r].critical_time) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = r;
+  }
+  fprintf(output_file, "\nReactions by execution time on critical paths:\n");
+  fprintf(output_file, "  %12s %12s %14s %12s %12s %12s %14s  %s\n", "invocations", "critical", "critical time",
+          "mean time", "mean slack", "min slack", "idle caused", "reaction");
+  for (size_t i = 0; i < num_reactions; i++) {
+    reaction_info_t* r = &reactions[order[i]];
+    if (r->invocations == 0) {
+      continue;
+    }
+    fprintf(output_file, "  %12zu %12zu %14" PRId64 " %12" PRId64 " %12" PRId64 " %12" PRId64 " %14" PRId64 "  %s\n",
+            r->invocations, r->critical, (int64_t)r->critical_time,
+            (int64_t)(r->total_time / (interval_t)r->invocations),
+            (int64_t)(r->total_slack / (interval_t)r->invocations), (int64_t)r->min_slack, (int64_t)r->idle_caused,
+            r->name);
+  }
+  free(order);
+
+  fprintf(output_file, "\nIdle time of the workers while other workers execute reactions at the same tag,\n"
+                       "which are waits at level barriers or for dependencies:\n");
+  fprintf(output_file, "  %-24s %6s %14s %14s %8s\n", "process", "worker", "busy", "idle", "idle %");
+  for (int p = 0; p < num_processes; p++) {
+    for (int w = 0; w < processes[p].num_workers; w++) {
+      interval_t busy = processes[p].busy[w];
+      interval_t idle = processes[p].idle[w];
+      fprintf(output_file, "  %-24s %6d %14" PRId64 " %14" PRId64 " %8.1f\n", processes[p].name, w, (int64_t)busy,
+              (int64_t)idle, (busy + idle) > 0 ? 100.0 * (double)idle / (double)(busy + idle) : 0.0);
+    }
+  }
+}
+
+int main(int argc, const char* argv[]) {
+  instant_t window_start = NEVER;
+  instant_t window_end = FOREVER;
+  const char* output_path = "critical_path.txt";
+  int number_of_paths = DEFAULT_NUMBER_OF_PATHS;
+  const char** paths = (const char**)calloc(argc, sizeof(char*));
+  if (paths == NULL) {
+    return 3;
+  }
+  int i = 1;
+  while (i < argc) {
+    const char* arg = argv[i++];
+    size_t length = strlen(arg);
+    if (length > 4 && strcmp(arg + length - 4, ".lft") == 0) {
+      paths[num_processes++] = arg;
+    } else if ((strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) && i < argc) {
+      output_path = argv[i++];
+    } else if ((strcmp(arg, "-n") == 0 || strcmp(arg, "--paths") == 0) && i < argc) {
+      number_of_paths = atoi(argv[i++]);
+    } else if ((strcmp(arg, "-s") == 0 || strcmp(arg, "--start") == 0) && i + 1 < argc) {
+      window_start = string_to_instant(argv[i], argv[i + 1]);
+      i += 2;
+      if (window_start == -1) {
+        usage();
+        return -1;
+      }
+    } else if ((strcmp(arg, "-e") == 0 || strcmp(arg, "--end") == 0) && i + 1 < argc) {
+      window_end = string_to_instant(argv[i], argv[i + 1]);
+      i += 2;
+      if (window_end == -1) {
+        usage();
+        return -1;
+      }
+    } else {
+      usage();
+      return 0;
+    }
+  }
+  if (num_processes == 0) {
+    usage();
+    return -1;
+  }
+  set_trace_window(window_start, window_end);
+
+  processes = (process_t*)calloc(num_processes, sizeof(process_t));
+  if (processes == NULL) {
+    return 3;
+  }
+  for (int p = 0; p < num_processes; p++) {
+    processes[p].name = root_name(paths[p]);
+    processes[p].fed_id = -1;
+  }
+  for (int p = 0; p < num_processes; p++) {
+    trace_file = open_file(paths[p], "r");
+    set_name_table(paths[p]);
+    if (read_header() < 0) {
+      return 1;
+    }
+    processes[p].start_time = start_time;
+    global_start_time = LF_MIN(global_start_time, start_time);
+    read_process(p);
+    if (processes[p].is_rti) {
+      processes[p].fed_id = -1;
+    }
+  }
+  // Drop the invocations that did not end within the trace.
+  size_t kept = 0;
+  for (size_t j = 0; j < num_invocations; j++) {
+    if (invocations[j].end != NEVER) {
+      invocations[kept++] = invocations[j];
+    }
+  }
+  num_invocations = kept;
+  for (int p = 0; p < num_processes; p++) {
+    int workers = LF_MAX(processes[p].num_workers, 1);
+    processes[p].busy = (interval_t*)calloc(workers, sizeof(interval_t));
+    processes[p].idle = (interval_t*)calloc(workers, sizeof(interval_t));
+    if (processes[p].busy == NULL || processes[p].idle == NULL) {
+      return 3;
+    }
+  }
+
+  match_messages();
+  find_senders();
+  analyze_processes();
+
+  output_file = open_file(output_path, "w");
+  write_report(number_of_paths);
+  printf("Wrote the report to %s.\n", output_path);
+  return 0;
+}
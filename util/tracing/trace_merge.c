@@ -0,0 +1,607 @@
+/**
+ * @file
+ * @brief Standalone program that merges the trace files of the RTI and of the federates of a
+ * federation into one file of their interactions, ordered by physical time, for fedsd.
+ *
+ * The trace files are streamed rather than loaded. A trace file is a sequence of blocks, each
+ * with the records of one thread in the order of their physical times, and the blocks of the
+ * threads of a process are interleaved. For each trace file, the program holds the records of
+ * the interactions (messages and the advancement of logical time) of its next `-b` blocks, as
+ * sorted runs, and merges the runs of all trace files by physical time with a heap. The memory
+ * used thus grows with the number of trace files, not with their length. A record that is
+ * earlier than one already written, because its block comes more than `-b` blocks after the
+ * blocks of other threads of its process, is written late, and the number of such records is
+ * reported.
+ *
+ * The clock of each federate may be offset from the clock of the RTI. The offset is estimated
+ * from the exchange of the start time: if the federate sends its MSG_TYPE_TIMESTAMP at t1,
+ * the RTI receives it at t2 and sends the start time at t3, and the federate receives it at
+ * t4, the offset is ((t1 - t2) + (t4 - t3)) / 2, as in NTP. It can also be given with `-c`.
+ * The offset is subtracted from the physical times of the federate.
+ *
+ * With `-w`, the records are aggregated over windows of physical time: the records in a window
+ * that have the same event, source and destination are written as one line, with the tag and
+ * the physical time of the first of them and their number, so that fedsd draws one arrow.
+ *
+ * The output file, trace_merge.csv unless given with `-o`, starts with a line
+ * `# actor,<id>,<name>` for each trace file, which names the actor of the sequence diagram
+ * with the given ID (-1 for the RTI) after the trace file. A header line follows, and then a
+ * line for each record or aggregate with the columns
+ * `event,self_id,partner_id,inout,logical_time,microstep,physical_time,count`, where the event
+ * has the short name used by fedsd, e.g. T_MSG, and the times are elapsed since the start time.
+ * fedsd draws it with `fedsd -m trace_merge.csv`.
+ */
+#define LF_TRACE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reactor.h"
+#include "trace.h"
+#include "trace_util.h"
+
+/** Default number of blocks of each trace file whose records are held to be merged. */
+#define DEFAULT_LOOKAHEAD 64
+
+/** Number of records at the start of a trace file that are searched for the exchange of the start time. */
+#define MAX_RECORDS_SCANNED 100000
+
+/** Unused, but declared by trace_util.h. */
+FILE* trace_file = NULL;
+
+/** File for writing the merged records. */
+FILE* output_file = NULL;
+
+/** Unused, but declared by trace_util.h. */
+FILE* summary_file = NULL;
+
+/**
+ * Print a usage message.
+ */
+void usage() {
+  printf("\nUsage: trace_merge [options] trace_file ... (with .lft extension)\n");
+  printf("Give the trace files of the federates and, with -r, of the RTI.\n");
+  printf("Options: \n");
+  printf("  -r, --rti [file]\n");
+  printf("   The trace file of the RTI.\n");
+  printf("  -o, --output [file]\n");
+  printf("   The file to write the merged records to (default: trace_merge.csv).\n");
+  printf("  -w, --window [time_spec] [units]\n");
+  printf("   Aggregate the records over windows of physical time of the given length.\n");
+  printf("  -c, --clock-offset [trace_file] [time_spec] [units]\n");
+  printf("   The offset of the clock of the federate of the trace file from the clock of the RTI.\n");
+  printf("  -b, --blocks [number]\n");
+  printf("   The number of blocks of each trace file to merge at once (default: %d).\n", DEFAULT_LOOKAHEAD);
+  printf("  -s, --start [time_spec] [units]\n");
+  printf("   The elapsed logical time at which to begin.\n");
+  printf("  -e, --end [time_spec] [units]\n");
+  printf("   The elapsed logical time at which to end.\n");
+  printf("\n");
+}
+
+/** @brief A record of an interaction, with elapsed times. */
+typedef struct merged_record_t {
+  trace_event_t event_type;
+  int self_id;             // The ID of the federate that wrote the record, or -1 for the RTI.
+  int partner_id;          // The ID of the federate or RTI it interacts with.
+  instant_t logical_time;  // The elapsed logical time, or NEVER if the record has no tag.
+  microstep_t microstep;   // The microstep.
+  instant_t physical_time; // The elapsed physical time, corrected for the clock offset.
+} merged_record_t;
+
+/** @brief The records of the interactions of one block of a trace file, sorted by physical time. */
+typedef struct run_t {
+  int source;
+  merged_record_t* records;
+  size_t size;
+  size_t next; // The index of the next record to write.
+} run_t;
+
+/** @brief A trace file. */
+typedef struct source_t {
+  trace_reader_t reader;
+  const char* path;
+  char* name;            // The root name of the trace file.
+  bool is_rti;           // Whether the trace file was written by the RTI.
+  int self_id;           // The ID of the federate, -1 for the RTI, or -2 if it has no interactions.
+  interval_t offset;     // The offset of its clock from the clock of the RTI.
+  bool offset_given;     // Whether the offset was given with -c.
+  int runs;              // The number of its runs in the heap.
+  bool done;             // Whether all of its blocks have been read.
+  instant_t sent;        // When the federate sent its MSG_TYPE_TIMESTAMP (t1).
+  instant_t rti_sent;    // When the RTI sent the start time to the federate (t3).
+  instant_t received;    // When the federate received the start time (t4).
+  instant_t rti_received; // When the RTI received the MSG_TYPE_TIMESTAMP of the federate (t2).
+} source_t;
+
+static source_t* sources = NULL;
+static int num_sources = 0;
+
+/** The start time of the federation. */
+static instant_t federation_start_time = FOREVER;
+
+/** The window of elapsed logical times of the records written. */
+static instant_t window_start = NEVER;
+static instant_t window_end = FOREVER;
+
+/** The number of blocks of each trace file whose records are held to be merged. */
+static int lookahead = DEFAULT_LOOKAHEAD;
+
+/** The block into which the trace files are read. */
+static trace_block_t block;
+
+/** Binary min-heap of the runs, ordered by the physical time of their next record. */
+static run_t** heap = NULL;
+static size_t heap_size = 0;
+static size_t heap_capacity = 0;
+
+/** The physical time of the last record written, and the number of records written late. */
+static instant_t last_written = NEVER;
+static size_t written = 0;
+static size_t late = 0;
+
+/** The length of the windows of physical time over which records are aggregated, or 0. */
+static interval_t aggregation_window = 0;
+
+/** @brief Records with the same event, source and destination in the current window. */
+typedef struct aggregate_t {
+  merged_record_t first;
+  size_t count;
+} aggregate_t;
+
+/** The aggregates of the current window, in the order of their first records. */
+static aggregate_t* aggregates = NULL;
+static size_t num_aggregates = 0;
+static size_t aggregates_capacity = 0;
+
+/** Open-addressing hash table of indices into `aggregates` plus one, or 0 for an empty slot. */
+static size_t* aggregate_table = NULL;
+static size_t aggregate_table_capacity = 0;
+
+/** The index of the current window. */
+static int64_t current_window = 0;
+
+/** Exit if the given pointer is NULL because memory could not be allocated. */
+static void* check_allocated(void* pointer) {
+  if (pointer == NULL) {
+    fprintf(stderr, "ERROR: Out of memory.\n");
+    exit(3);
+  }
+  return pointer;
+}
+
+/** Return whether a record is written: it is an interaction, which fedsd draws. */
+static bool is_interaction(trace_event_t event_type) {
+  return event_type > federated || event_type == scheduler_advancing_time_ends;
+}
+
+/** Return the short name of an event that fedsd uses, e.g. T_MSG for "Sending TAGGED_MSG". */
+static const char* short_event_name(trace_event_t event_type) {
+  if (event_type == scheduler_advancing_time_ends) {
+    return "AdvLT";
+  }
+  const char* name = trace_event_names[event_type];
+  if (strncmp(name, "Sending ", 8) == 0) {
+    name += 8;
+  } else if (strncmp(name, "Receiving ", 10) == 0) {
+    name += 10;
+  }
+  if (strcmp(name, "PORT_ABS") == 0) {
+    return "ABS";
+  } else if (strcmp(name, "TAGGED_MSG") == 0) {
+    return "T_MSG";
+  } else if (strcmp(name, "P2P_TAGGED_MSG") == 0) {
+    return "P2P_T_MSG";
+  }
+  return name;
+}
+
+/**
+ * Find the ID of the federate of a trace file and the times at which it exchanged the start
+ * time with the RTI, in the first MAX_RECORDS_SCANNED records, and go back to the start.
+ */
+static void scan_federate(source_t* s) {
+  size_t scanned = 0;
+  int length;
+  while (scanned < MAX_RECORDS_SCANNED && (s->self_id == -2 || s->sent == NEVER || s->received == NEVER) &&
+         (length = trace_reader_read(&s->reader, &block)) >= 0) {
+    for (int i = 0; i < length; i++) {
+      trace_record_t* record = &block.records[i];
+      if (record->event_type > federated && s->self_id == -2) {
+        s->self_id = record->src_id;
+      }
+      if (record->event_type == send_TIMESTAMP && s->sent == NEVER) {
+        s->sent = record->physical_time;
+      } else if (record->event_type == receive_TIMESTAMP && s->received == NEVER) {
+        s->received = record->physical_time;
+      }
+    }
+    scanned += (size_t)length;
+  }
+  trace_reader_rewind(&s->reader);
+}
+
+/** Return the source of the federate with the given ID, or NULL if there is none. */
+static source_t* source_of_federate(int fed_id) {
+  for (int i = 0; i < num_sources; i++) {
+    if (!sources[i].is_rti && sources[i].self_id == fed_id) {
+      return &sources[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Find the times at which the RTI exchanged the start time with the federates, in the first
+ * MAX_RECORDS_SCANNED records of its trace file, and go back to the start.
+ */
+static void scan_rti(source_t* rti) {
+  size_t scanned = 0;
+  int length;
+  while (scanned < MAX_RECORDS_SCANNED && (length = trace_reader_read(&rti->reader, &block)) >= 0) {
+    for (int i = 0; i < length; i++) {
+      trace_record_t* record = &block.records[i];
+      source_t* fed = source_of_federate(record->dst_id);
+      if (fed == NULL) {
+        continue;
+      }
+      if (record->event_type == receive_TIMESTAMP && fed->rti_received == NEVER) {
+        fed->rti_received = record->physical_time;
+      } else if (record->event_type == send_TIMESTAMP && fed->rti_sent == NEVER) {
+        fed->rti_sent = record->physical_time;
+      }
+    }
+    scanned += (size_t)length;
+  }
+  trace_reader_rewind(&rti->reader);
+}
+
+/** Return whether run a has a later next record than run b. */
+static bool run_is_later(run_t* a, run_t* b) {
+  instant_t time_a = a->records[a->next].physical_time;
+  instant_t time_b = b->records[b->next].physical_time;
+  return time_a > time_b || (time_a == time_b && a->source > b->source);
+}
+
+/** Move the run at the given position of the heap down to its place. */
+static void sift_down(size_t i) {
+  while (true) {
+    size_t smallest = i;
+    size_t left = 2 * i + 1;
+    size_t right = left + 1;
+    if (left < heap_size && run_is_later(heap[smallest], heap[left])) {
+      smallest = left;
+    }
+    if (right < heap_size && run_is_later(heap[smallest], heap[right])) {
+      smallest = right;
+    }
+    if (smallest == i) {
+      return;
+    }
+    run_t* tmp = heap[i];
+    heap[i] = heap[smallest];
+    heap[smallest] = tmp;
+    i = smallest;
+  }
+}
+
+/** Add a run to the heap. */
+static void push_run(run_t* run) {
+  if (heap_size == heap_capacity) {
+    heap_capacity = heap_capacity == 0 ? 64 : 2 * heap_capacity;
+    heap = (run_t**)check_allocated(realloc(heap, heap_capacity * sizeof(run_t*)));
+  }
+  size_t i = heap_size++;
+  heap[i] = run;
+  while (i > 0 && run_is_later(heap[(i - 1) / 2], heap[i])) {
+    run_t* tmp = heap[i];
+    heap[i] = heap[(i - 1) / 2];
+    heap[(i - 1) / 2] = tmp;
+    i = (i - 1) / 2;
+  }
+}
+
+/** Compare merged records by physical time for qsort. */
+static int compare_by_physical_time(const void* a, const void* b) {
+  instant_t time_a = ((const merged_record_t*)a)->physical_time;
+  instant_t time_b = ((const merged_record_t*)b)->physical_time;
+  return (time_a > time_b) - (time_a < time_b);
+}
+
+/**
+ * Read the blocks of a trace file until one has interactions in the window of logical time,
+ * and add them to the heap as a run.
+ * @return False if the trace file has no more blocks.
+ */
+static bool read_run(int source) {
+  source_t* s = &sources[source];
+  while (true) {
+    int length = trace_reader_read(&s->reader, &block);
+    if (length < 0) {
+      s->done = true;
+      return false;
+    }
+    merged_record_t* records = NULL;
+    size_t size = 0;
+    bool sorted = true;
+    for (int i = 0; i < length; i++) {
+      trace_record_t* record = &block.records[i];
+      if (!is_interaction(record->event_type) || record->logical_time - federation_start_time < window_start ||
+          record->logical_time - federation_start_time >= window_end) {
+        continue;
+      }
+      if (records == NULL) {
+        records = (merged_record_t*)check_allocated(malloc((size_t)(length - i) * sizeof(merged_record_t)));
+      }
+      merged_record_t* r = &records[size];
+      r->event_type = record->event_type;
+      r->self_id = s->self_id;
+      r->partner_id = record->dst_id;
+      r->logical_time = record->logical_time == NEVER ? NEVER : record->logical_time - federation_start_time;
+      r->microstep = record->microstep;
+      r->physical_time = record->physical_time - s->offset - federation_start_time;
+      if (size > 0 && r->physical_time < records[size - 1].physical_time) {
+        sorted = false;
+      }
+      size++;
+    }
+    if (size == 0) {
+      continue;
+    }
+    if (!sorted) {
+      qsort(records, size, sizeof(merged_record_t), compare_by_physical_time);
+    }
+    run_t* run = (run_t*)check_allocated(malloc(sizeof(run_t)));
+    *run = (run_t){.source = source, .records = records, .size = size, .next = 0};
+    push_run(run);
+    s->runs++;
+    return true;
+  }
+}
+
+/** Read runs of a trace file until it has `lookahead` runs in the heap or no more blocks. */
+static void fill_runs(int source) {
+  while (!sources[source].done && sources[source].runs < lookahead) {
+    read_run(source);
+  }
+}
+
+/** Write a line for a record or an aggregate of `count` records. */
+static void write_line(merged_record_t* r, size_t count) {
+  fprintf(output_file, "%s,%d,%d,%s,%lld,%u,%lld,%zu\n", short_event_name(r->event_type), r->self_id, r->partner_id,
+          r->event_type >= receive_ACK ? "in" : "out", (long long)r->logical_time, (unsigned)r->microstep,
+          (long long)r->physical_time, count);
+}
+
+/** Write the aggregates of the current window and start a new window. */
+static void flush_window() {
+  for (size_t i = 0; i < num_aggregates; i++) {
+    write_line(&aggregates[i].first, aggregates[i].count);
+  }
+  num_aggregates = 0;
+  if (aggregate_table != NULL) {
+    memset(aggregate_table, 0, aggregate_table_capacity * sizeof(size_t));
+  }
+}
+
+/** Return the slot of the hash table of aggregates for the given record. */
+static size_t aggregate_slot(merged_record_t* r) {
+  size_t hash = ((size_t)r->event_type * 31 + (size_t)(r->self_id + 1)) * 1000003 + (size_t)(r->partner_id + 1);
+  size_t slot = hash & (aggregate_table_capacity - 1);
+  while (aggregate_table[slot] != 0) {
+    merged_record_t* first = &aggregates[aggregate_table[slot] - 1].first;
+    if (first->event_type == r->event_type && first->self_id == r->self_id && first->partner_id == r->partner_id) {
+      break;
+    }
+    slot = (slot + 1) & (aggregate_table_capacity - 1);
+  }
+  return slot;
+}
+
+/** Add a record to the aggregates of its window. */
+static void aggregate(merged_record_t* r) {
+  instant_t time = r->physical_time;
+  int64_t window = (time >= 0 ? time : time - aggregation_window + 1) / aggregation_window;
+  if (window != current_window) {
+    flush_window();
+    current_window = window;
+  }
+  if (2 * (num_aggregates + 1) > aggregate_table_capacity) {
+    // Grow the hash table and reinsert the aggregates.
+    aggregate_table_capacity = aggregate_table_capacity == 0 ? 64 : 2 * aggregate_table_capacity;
+    free(aggregate_table);
+    aggregate_table = (size_t*)check_allocated(calloc(aggregate_table_capacity, sizeof(size_t)));
+    for (size_t i = 0; i < num_aggregates; i++) {
+      aggregate_table[aggregate_slot(&aggregates[i].first)] = i + 1;
+    }
+  }
+  size_t slot = aggregate_slot(r);
+  if (aggregate_table[slot] != 0) {
+    aggregates[aggregate_table[slot] - 1].count++;
+    return;
+  }
+  if (num_aggregates == aggregates_capacity) {
+    aggregates_capacity = aggregates_capacity == 0 ? 64 : 2 * aggregates_capacity;
+    aggregates = (aggregate_t*)check_allocated(realloc(aggregates, aggregates_capacity * sizeof(aggregate_t)));
+  }
+  aggregates[num_aggregates] = (aggregate_t){.first = *r, .count = 1};
+  aggregate_table[slot] = ++num_aggregates;
+}
+
+/** Write the records of the runs in the heap in the order of their physical times. */
+static void merge() {
+  for (int i = 0; i < num_sources; i++) {
+    fill_runs(i);
+  }
+  while (heap_size > 0) {
+    run_t* run = heap[0];
+    merged_record_t* r = &run->records[run->next++];
+    if (r->physical_time < last_written) {
+      late++;
+    } else {
+      last_written = r->physical_time;
+    }
+    written++;
+    if (aggregation_window > 0) {
+      aggregate(r);
+    } else {
+      write_line(r, 1);
+    }
+    if (run->next < run->size) {
+      sift_down(0);
+      continue;
+    }
+    // The run is exhausted. Replace it with the next run of its trace file, if any.
+    heap[0] = heap[--heap_size];
+    sift_down(0);
+    int source = run->source;
+    sources[source].runs--;
+    free(run->records);
+    free(run);
+    fill_runs(source);
+  }
+  if (aggregation_window > 0) {
+    flush_window();
+  }
+}
+
+/**
+ * Parse a time value and units at the given position of the arguments.
+ * @return The time, or -1 after printing the usage if it is invalid.
+ */
+static instant_t parse_time(int argc, const char* argv[], int* i) {
+  if (*i + 1 >= argc) {
+    usage();
+    return -1;
+  }
+  instant_t time = string_to_instant(argv[*i], argv[*i + 1]);
+  *i += 2;
+  if (time == -1) {
+    usage();
+  }
+  return time;
+}
+
+int main(int argc, const char* argv[]) {
+  const char* output_path = "trace_merge.csv";
+  const char* rti_path = NULL;
+  const char* paths[argc];
+  int num_paths = 0;
+  // The offsets given with -c, as the root name of the trace file, the time value and the units.
+  const char* offsets[argc];
+  int num_offsets = 0;
+
+  int i = 1;
+  while (i < argc) {
+    const char* arg = argv[i++];
+    if (strlen(arg) > 4 && strcmp(strrchr(arg, '\0') - 4, ".lft") == 0) {
+      paths[num_paths++] = arg;
+    } else if ((strcmp(arg, "-r") == 0 || strcmp(arg, "--rti") == 0) && i < argc) {
+      rti_path = argv[i++];
+    } else if ((strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) && i < argc) {
+      output_path = argv[i++];
+    } else if ((strcmp(arg, "-b") == 0 || strcmp(arg, "--blocks") == 0) && i < argc) {
+      lookahead = atoi(argv[i++]);
+      if (lookahead < 1) {
+        usage();
+        return -1;
+      }
+    } else if ((strcmp(arg, "-c") == 0 || strcmp(arg, "--clock-offset") == 0) && i + 2 < argc) {
+      offsets[num_offsets++] = argv[i];
+      offsets[num_offsets++] = argv[i + 1];
+      offsets[num_offsets++] = argv[i + 2];
+      i += 3;
+    } else if (strcmp(arg, "-w") == 0 || strcmp(arg, "--window") == 0) {
+      if ((aggregation_window = parse_time(argc, argv, &i)) <= 0) {
+        return -1;
+      }
+    } else if (strcmp(arg, "-s") == 0 || strcmp(arg, "--start") == 0) {
+      if ((window_start = parse_time(argc, argv, &i)) == -1) {
+        return -1;
+      }
+    } else if (strcmp(arg, "-e") == 0 || strcmp(arg, "--end") == 0) {
+      if ((window_end = parse_time(argc, argv, &i)) == -1) {
+        return -1;
+      }
+    } else {
+      usage();
+      return 0;
+    }
+  }
+  if (num_paths == 0 && rti_path == NULL) {
+    usage();
+    return -1;
+  }
+
+  num_sources = num_paths + (rti_path != NULL ? 1 : 0);
+  sources = (source_t*)check_allocated(calloc(num_sources, sizeof(source_t)));
+  for (int s = 0; s < num_sources; s++) {
+    source_t* source = &sources[s];
+    source->is_rti = (s == num_paths);
+    source->path = source->is_rti ? rti_path : paths[s];
+    source->name = root_name(source->path);
+    source->self_id = source->is_rti ? -1 : -2;
+    source->sent = source->received = source->rti_sent = source->rti_received = NEVER;
+    trace_reader_open(&source->reader, source->path);
+    if (source->is_rti || rti_path == NULL) {
+      federation_start_time = LF_MIN(federation_start_time, source->reader.start_time);
+    }
+    if (!source->is_rti) {
+      scan_federate(source);
+    }
+  }
+  if (rti_path != NULL) {
+    scan_rti(&sources[num_paths]);
+  }
+
+  // Find the clock offsets of the federates.
+  for (int j = 0; j < num_offsets; j += 3) {
+    instant_t offset = string_to_instant(offsets[j + 1], offsets[j + 2]);
+    char* name = root_name(offsets[j]);
+    bool found = false;
+    for (int s = 0; s < num_paths; s++) {
+      if (strcmp(sources[s].name, name) == 0) {
+        sources[s].offset = offset;
+        sources[s].offset_given = found = true;
+      }
+    }
+    if (!found) {
+      fprintf(stderr, "WARNING: No trace file %s for the clock offset.\n", offsets[j]);
+    }
+    free(name);
+  }
+  for (int s = 0; s < num_paths; s++) {
+    source_t* source = &sources[s];
+    if (source->offset_given) {
+      continue;
+    }
+    if (source->sent != NEVER && source->received != NEVER && source->rti_sent != NEVER &&
+        source->rti_received != NEVER) {
+      source->offset = ((source->sent - source->rti_received) + (source->received - source->rti_sent)) / 2;
+      printf("Clock offset of %s: " PRINTF_TIME " ns.\n", source->name, source->offset);
+    } else if (rti_path != NULL) {
+      printf("No exchange of the start time with the RTI in %s. Assuming no clock offset.\n", source->name);
+    }
+  }
+
+  output_file = open_file(output_path, "w");
+  for (int s = 0; s < num_sources; s++) {
+    if (sources[s].self_id != -2) {
+      fprintf(output_file, "# actor,%d,%s\n", sources[s].self_id, sources[s].name);
+    }
+  }
+  fprintf(output_file, "event,self_id,partner_id,inout,logical_time,microstep,physical_time,count\n");
+  merge();
+  fclose(output_file);
+  printf("Merged %zu records of %d trace files into %s.\n", written, num_sources, output_path);
+  if (late > 0) {
+    printf("WARNING: %zu records were written after later records. Use a larger -b to order them.\n", late);
+  }
+  for (int s = 0; s < num_sources; s++) {
+    free(sources[s].name);
+  }
+  free(sources);
+  free(heap);
+  free(aggregates);
+  free(aggregate_table);
+  return 0;
+}
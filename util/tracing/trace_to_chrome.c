@@ -60,6 +60,12 @@ void usage() {
   printf("Options: \n");
   printf("  -p, --physical\n");
   printf("   Use only physical time, not logical time, for all horizontal axes.\n");
+  printf("  -s, --start [time_spec] [units]\n");
+  printf("   The elapsed logical time at which to begin the trace.\n");
+  printf("  -e, --end [time_spec] [units]\n");
+  printf("   The elapsed logical time at which to end the trace.\n");
+  printf("  -j, --jobs [number]\n");
+  printf("   The number of threads that convert the trace (default: number of processors).\n");
   printf("\n");
 }
 
@@ -70,31 +76,36 @@ int max_reaction_number = 0;
 bool physical_time_only = false;
 
 /**
- * Read a trace in the trace_file and write it to the output_file in json.
- * @return The number of records read or 0 upon seeing an EOF.
+ * Return the description of the object with the given index in object_table,
+ * as found by convert_trace, or NULL if there is none.
  */
-size_t read_and_write_trace() {
-  int trace_length = read_trace();
-  if (trace_length == 0)
-    return 0;
-  // Write each line.
-  for (int i = 0; i < trace_length; i++) {
+static char* description_at(int index) { return index < 0 ? NULL : object_table[index].description; }
+
+/**
+ * Convert the records of a block into json events.
+ */
+void format_block(trace_block_t* block) {
+  trace_record_t* trace = block->records;
+  for (int i = 0; i < block->length; i++) {
     char* reaction_name = "\"UNKNOWN\"";
+    char reaction_number[12];
 
     // Ignore federated trace events.
     if (trace[i].event_type > federated)
       continue;
 
     if (trace[i].dst_id >= 0) {
-      reaction_name = (char*)malloc(4);
-      snprintf(reaction_name, 4, "%d", trace[i].dst_id);
+      snprintf(reaction_number, sizeof(reaction_number), "%d", trace[i].dst_id);
+      reaction_name = reaction_number;
     }
-    // printf("DEBUG: Reactor's self struct pointer: %p\n", trace[i].pointer);
-    int reactor_index;
-    char* reactor_name = get_object_description(trace[i].pointer, &reactor_index);
+    // As in get_object_description, records without an object use the index of the first one.
+    int reactor_index = block->object_index[i] < 0 ? 0 : block->object_index[i];
+    char* reactor_name = description_at(block->object_index[i]);
     if (reactor_name == NULL) {
       if (trace[i].event_type == worker_wait_starts || trace[i].event_type == worker_wait_ends) {
         reactor_name = "WAIT";
+      } else if (trace[i].event_type == mutex_wait_starts || trace[i].event_type == mutex_wait_ends) {
+        reactor_name = "MUTEX WAIT";
       } else if (trace[i].event_type == scheduler_advancing_time_starts ||
                  trace[i].event_type == scheduler_advancing_time_starts) {
         reactor_name = "ADVANCE TIME";
@@ -105,8 +116,8 @@ size_t read_and_write_trace() {
     // Default name is the reactor name.
     char* name = reactor_name;
 
-    int trigger_index;
-    char* trigger_name = get_trigger_name(trace[i].trigger, &trigger_index);
+    int trigger_index = block->trigger_index[i] < 0 ? 0 : block->trigger_index[i];
+    char* trigger_name = description_at(block->trigger_index[i]);
     if (trigger_name == NULL) {
       trigger_name = "NONE";
     }
@@ -187,6 +198,14 @@ size_t read_and_write_trace() {
       pid = PID_FOR_WORKER_WAIT;
       phase = "E";
       break;
+    case mutex_wait_starts:
+      pid = PID_FOR_WORKER_WAIT;
+      phase = "B";
+      break;
+    case mutex_wait_ends:
+      pid = PID_FOR_WORKER_WAIT;
+      phase = "E";
+      break;
     case scheduler_advancing_time_starts:
       pid = PID_FOR_WORKER_ADVANCING_TIME;
       phase = "B";
@@ -201,56 +220,67 @@ size_t read_and_write_trace() {
       pid = PID_FOR_UNKNOWN_EVENT;
       phase = "i";
     }
-    fprintf(output_file,
-            "{"
-            "\"name\": \"%s\", " // name is the reactor or trigger name.
-            "\"cat\": \"%s\", "  // category is the type of event.
-            "\"ph\": \"%s\", "   // phase is "B" (begin), "E" (end), or "X" (complete).
-            "\"tid\": %d, "      // thread ID.
-            "\"pid\": %d, "      // process ID is required.
-            "\"ts\": %lld, "     // timestamp in microseconds
-            "\"args\": %s"       // additional arguments from above.
-            "},\n",
-            name, trace_event_names[trace[i].event_type], phase, thread_id, pid, (long long int)timestamp, args);
+    block_printf(block,
+                 "{"
+                 "\"name\": \"%s\", " // name is the reactor or trigger name.
+                 "\"cat\": \"%s\", "  // category is the type of event.
+                 "\"ph\": \"%s\", "   // phase is "B" (begin), "E" (end), or "X" (complete).
+                 "\"tid\": %d, "      // thread ID.
+                 "\"pid\": %d, "      // process ID is required.
+                 "\"ts\": %lld, "     // timestamp in microseconds
+                 "\"args\": %s"       // additional arguments from above.
+                 "},\n",
+                 name, trace_event_names[trace[i].event_type], phase, thread_id, pid, (long long int)timestamp, args);
     free(args);
 
-    if (trace[i].src_id > max_thread_id) {
-      max_thread_id = trace[i].src_id;
-    }
     // If the event is reaction_starts and physical_time_only is not set,
     // then also generate an instantaneous
     // event to be shown in the reactor's section, along with timers and actions.
     if (trace[i].event_type == reaction_starts && !physical_time_only) {
       phase = "i";
       pid = reactor_index + 1;
-      reaction_name = (char*)malloc(4);
-      char name[13];
-      snprintf(name, 13, "reaction %d", trace[i].dst_id);
+      char name[24];
+      snprintf(name, sizeof(name), "reaction %d", trace[i].dst_id);
 
       // NOTE: If the reactor has more than 1024 timers and actions, then
       // there will be a collision of thread IDs here.
       thread_id = 1024 + trace[i].dst_id;
-      if (trace[i].dst_id > max_reaction_number) {
-        max_reaction_number = trace[i].dst_id;
-      }
 
-      fprintf(output_file,
-              "{"
-              "\"name\": \"%s\", " // name is the reactor or trigger name.
-              "\"cat\": \"%s\", "  // category is the type of event.
-              "\"ph\": \"%s\", "   // phase is "B" (begin), "E" (end), or "X" (complete).
-              "\"tid\": %d, "      // thread ID.
-              "\"pid\": %d, "      // process ID is required.
-              "\"ts\": %lld, "     // timestamp in microseconds
-              "\"args\": {"
-              "\"microstep\": %d, "     // microstep.
-              "\"physical time\": %lld" // physical time.
-              "}},\n",
-              name, "Reaction", phase, thread_id, pid, (long long int)elapsed_logical_time, trace[i].microstep,
-              (long long int)elapsed_physical_time);
+      block_printf(block,
+                   "{"
+                   "\"name\": \"%s\", " // name is the reactor or trigger name.
+                   "\"cat\": \"%s\", "  // category is the type of event.
+                   "\"ph\": \"%s\", "   // phase is "B" (begin), "E" (end), or "X" (complete).
+                   "\"tid\": %d, "      // thread ID.
+                   "\"pid\": %d, "      // process ID is required.
+                   "\"ts\": %lld, "     // timestamp in microseconds
+                   "\"args\": {"
+                   "\"microstep\": %d, "     // microstep.
+                   "\"physical time\": %lld" // physical time.
+                   "}},\n",
+                   name, "Reaction", phase, thread_id, pid, (long long int)elapsed_logical_time, trace[i].microstep,
+                   (long long int)elapsed_physical_time);
+    }
+  }
+}
+
+/**
+ * Update the largest thread ID and reaction number seen with the records of a block.
+ */
+void update_maxima(trace_block_t* block) {
+  for (int i = 0; i < block->length; i++) {
+    trace_record_t* record = &block->records[i];
+    // Skip the records that format_block skips.
+    if (record->event_type > federated || (record->physical_time - start_time) / 1000 < 0 ||
+        (record->logical_time - start_time) / 1000 < 0)
+      continue;
+    if (record->src_id > max_thread_id) {
+      max_thread_id = record->src_id;
+    }
+    if (record->event_type == reaction_starts && !physical_time_only && record->dst_id > max_reaction_number) {
+      max_reaction_number = record->dst_id;
     }
   }
-  return trace_length;
 }
 
 /**
@@ -410,9 +440,34 @@ void write_metadata_events(FILE* output_file) {
 
 int main(int argc, char* argv[]) {
   char* filename = NULL;
+  instant_t window_start = NEVER;
+  instant_t window_end = FOREVER;
+  int num_threads = default_num_threads();
   for (int i = 1; i < argc; i++) {
     if (strncmp(argv[i], "-p", 2) == 0 || strncmp(argv[i], "--physical", 10) == 0) {
       physical_time_only = true;
+    } else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--start") == 0 || strcmp(argv[i], "-e") == 0 ||
+               strcmp(argv[i], "--end") == 0) {
+      if (i + 2 >= argc) {
+        usage();
+        return (1);
+      }
+      instant_t time = string_to_instant(argv[i + 1], argv[i + 2]);
+      if (time == -1) {
+        usage();
+        return (1);
+      }
+      if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--start") == 0) {
+        window_start = time;
+      } else {
+        window_end = time;
+      }
+      i += 2;
+    } else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) {
+      if (i + 1 >= argc || (num_threads = atoi(argv[++i])) < 1) {
+        usage();
+        return (1);
+      }
     } else if (argv[i][0] == '-') {
       usage();
       return (1);
@@ -424,9 +479,11 @@ int main(int argc, char* argv[]) {
     usage();
     exit(0);
   }
+  set_trace_window(window_start, window_end);
 
   // Open the trace file.
   trace_file = open_file(filename, "r");
+  set_name_table(filename);
 
   // Construct the name of the csv output file and open it.
   char* root = root_name(filename);
@@ -438,8 +495,7 @@ int main(int argc, char* argv[]) {
   if (read_header() >= 0) {
     // Write the opening bracket into the json file.
     fprintf(output_file, "{ \"traceEvents\": [\n");
-    while (read_and_write_trace() != 0) {
-    };
+    convert_trace(output_file, num_threads, format_block, update_maxima);
     write_metadata_events(output_file);
     fprintf(output_file, "]}\n");
   }
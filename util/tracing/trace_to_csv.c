@@ -35,7 +35,6 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "reactor.h"
 #include "trace.h"
 #include "trace_util.h"
-#include "trace_impl.h"
 
 #define MAX_NUM_REACTIONS 64 // Maximum number of reactions reported in summary stats.
 #define MAX_NUM_WORKERS 64
@@ -62,6 +61,8 @@ void usage() {
   printf("   The target time to begin tracing.\n\n");
   printf("  -e, --end [time_spec] [units]\n");
   printf("   The target time to stop tracing.\n\n");
+  printf("  -j, --jobs [number]\n");
+  printf("   The number of threads that convert the trace (default: number of processors).\n\n");
   printf("\n\n");
 }
 
@@ -74,6 +75,7 @@ typedef struct reaction_stats_t {
   interval_t total_exec_time;
   interval_t max_exec_time;
   interval_t min_exec_time;
+  histogram_t* histogram; // Histogram of the exec times, for percentiles, or NULL.
 } reaction_stats_t;
 
 /**
@@ -94,179 +96,226 @@ typedef struct summary_stats_t {
  */
 summary_stats_t** summary_stats;
 
+/** Quantiles of the exec times and lags reported in the summary file. */
+static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
 /** Largest timestamp seen. */
 instant_t latest_time = 0LL;
 
 /**
- * Read a trace in the trace_file and write it to the output_file as CSV.
- * @return The number of records read or 0 upon seeing an EOF.
+ * Return the description of the object with the given index in object_table,
+ * as found by convert_trace, or NULL if there is none.
  */
-size_t read_and_write_trace(instant_t trace_start_time, instant_t trace_end_time) {
-  int trace_length = read_trace();
-  if (trace_length == 0)
-    return 0;
-  // Write each line.
-  for (int i = 0; i < trace_length; i++) {
-    // printf("DEBUG: reactor self struct pointer: %p\n", trace[i].pointer);
-    int object_instance = -1;
-    char* reactor_name = get_object_description(trace[i].pointer, &object_instance);
+static char* description_at(int index) { return index < 0 ? NULL : object_table[index].description; }
+
+/**
+ * Convert the records of a block into lines of CSV.
+ */
+void format_block(trace_block_t* block) {
+  trace_record_t* trace = block->records;
+  for (int i = 0; i < block->length; i++) {
+    char* reactor_name = description_at(block->object_index[i]);
     if (reactor_name == NULL) {
       reactor_name = "NO REACTOR";
     }
-    int trigger_instance = -1;
-    char* trigger_name = get_trigger_name(trace[i].trigger, &trigger_instance);
+    char* trigger_name = description_at(block->trigger_index[i]);
     if (trigger_name == NULL) {
       trigger_name = "NO TRIGGER";
     }
-    if ((trace[i].logical_time - start_time) >= trace_start_time &&
-        (trace[i].logical_time - start_time) < trace_end_time) {
-      fprintf(output_file, "%s, %s, %d, %d, " PRINTF_TIME ", %d, " PRINTF_TIME ", %s, " PRINTF_TIME "\n",
-              trace_event_names[trace[i].event_type], reactor_name, trace[i].src_id, trace[i].dst_id,
-              trace[i].logical_time - start_time, trace[i].microstep, trace[i].physical_time - start_time, trigger_name,
-              trace[i].extra_delay);
-      // Update summary statistics.
-      if (trace[i].physical_time > latest_time) {
-        latest_time = trace[i].physical_time;
-      }
-      if (object_instance >= 0 && summary_stats[NUM_EVENT_TYPES + object_instance] == NULL) {
-        summary_stats[NUM_EVENT_TYPES + object_instance] = (summary_stats_t*)calloc(1, sizeof(summary_stats_t));
-      }
-      if (trigger_instance >= 0 && summary_stats[NUM_EVENT_TYPES + trigger_instance] == NULL) {
-        summary_stats[NUM_EVENT_TYPES + trigger_instance] = (summary_stats_t*)calloc(1, sizeof(summary_stats_t));
-      }
+    block_printf(block, "%s, %s, %d, %d, " PRINTF_TIME ", %d, " PRINTF_TIME ", %s, " PRINTF_TIME "\n",
+                 trace_event_names[trace[i].event_type], reactor_name, trace[i].src_id, trace[i].dst_id,
+                 trace[i].logical_time - start_time, trace[i].microstep, trace[i].physical_time - start_time,
+                 trigger_name, trace[i].extra_delay);
+  }
+}
+
+/**
+ * Update the summary statistics with the records of a block.
+ * Blocks are passed to this function in the order of the trace file.
+ */
+void update_summary_stats(trace_block_t* block) {
+  trace_record_t* trace = block->records;
+  for (int i = 0; i < block->length; i++) {
+    // As in get_object_description, records without an object count towards the first one.
+    int object_instance = block->object_index[i] < 0 ? 0 : block->object_index[i];
+    char* reactor_name = description_at(block->object_index[i]);
+    if (reactor_name == NULL) {
+      reactor_name = "NO REACTOR";
+    }
+    int trigger_instance = block->trigger_index[i] < 0 ? 0 : block->trigger_index[i];
+    char* trigger_name = description_at(block->trigger_index[i]);
+    if (trigger_name == NULL) {
+      trigger_name = "NO TRIGGER";
+    }
+    // Update summary statistics.
+    if (trace[i].physical_time > latest_time) {
+      latest_time = trace[i].physical_time;
+    }
+    if (object_instance >= 0 && summary_stats[NUM_EVENT_TYPES + object_instance] == NULL) {
+      summary_stats[NUM_EVENT_TYPES + object_instance] = (summary_stats_t*)calloc(1, sizeof(summary_stats_t));
+    }
+    if (trigger_instance >= 0 && summary_stats[NUM_EVENT_TYPES + trigger_instance] == NULL) {
+      summary_stats[NUM_EVENT_TYPES + trigger_instance] = (summary_stats_t*)calloc(1, sizeof(summary_stats_t));
+    }
 
-      summary_stats_t* stats = NULL;
-      interval_t exec_time;
-      reaction_stats_t* rstats;
-      int index;
+    summary_stats_t* stats = NULL;
+    interval_t exec_time;
+    reaction_stats_t* rstats;
+    int index;
 
-      // Count of event type.
-      if (summary_stats[trace[i].event_type] == NULL) {
-        summary_stats[trace[i].event_type] = (summary_stats_t*)calloc(1, sizeof(summary_stats_t));
+    // Count of event type.
+    if (summary_stats[trace[i].event_type] == NULL) {
+      summary_stats[trace[i].event_type] = (summary_stats_t*)calloc(1, sizeof(summary_stats_t));
+    }
+    summary_stats[trace[i].event_type]->event_type = trace[i].event_type;
+    summary_stats[trace[i].event_type]->description = trace_event_names[trace[i].event_type];
+    summary_stats[trace[i].event_type]->occurrences++;
+
+    switch (trace[i].event_type) {
+    case reaction_starts:
+    case reaction_ends:
+      // This code relies on the mutual exclusion of reactions in a reactor
+      // and the ordering of reaction_starts and reaction_ends events.
+      if (trace[i].dst_id >= MAX_NUM_REACTIONS) {
+        fprintf(stderr, "WARNING: Too many reactions. Not all will be shown in summary file.\n");
+        continue;
       }
-      summary_stats[trace[i].event_type]->event_type = trace[i].event_type;
-      summary_stats[trace[i].event_type]->description = trace_event_names[trace[i].event_type];
-      summary_stats[trace[i].event_type]->occurrences++;
-
-      switch (trace[i].event_type) {
-      case reaction_starts:
-      case reaction_ends:
-        // This code relies on the mutual exclusion of reactions in a reactor
-        // and the ordering of reaction_starts and reaction_ends events.
-        if (trace[i].dst_id >= MAX_NUM_REACTIONS) {
-          fprintf(stderr, "WARNING: Too many reactions. Not all will be shown in summary file.\n");
-          continue;
-        }
-        stats = summary_stats[NUM_EVENT_TYPES + object_instance];
-        stats->description = reactor_name;
-        if (trace[i].dst_id >= stats->num_reactions_seen) {
-          stats->num_reactions_seen = trace[i].dst_id + 1;
-        }
-        rstats = &stats->reactions[trace[i].dst_id];
-        if (trace[i].event_type == reaction_starts) {
-          rstats->latest_start_time = trace[i].physical_time;
-        } else {
-          rstats->occurrences++;
-          exec_time = trace[i].physical_time - rstats->latest_start_time;
-          rstats->latest_start_time = 0LL;
-          rstats->total_exec_time += exec_time;
-          if (exec_time > rstats->max_exec_time) {
-            rstats->max_exec_time = exec_time;
-          }
-          if (exec_time < rstats->min_exec_time || rstats->min_exec_time == 0LL) {
-            rstats->min_exec_time = exec_time;
-          }
-        }
-        break;
-      case schedule_called:
-        if (trigger_instance < 0) {
-          // No trigger. Do not report.
-          continue;
-        }
-        stats = summary_stats[NUM_EVENT_TYPES + trigger_instance];
-        stats->description = trigger_name;
-        break;
-      case user_event:
-        // Although these are not exec times and not reactions,
-        // commandeer the first entry in the reactions array to track values.
-        stats = summary_stats[NUM_EVENT_TYPES + object_instance];
-        stats->description = reactor_name;
-        break;
-      case user_value:
-        // Although these are not exec times and not reactions,
-        // commandeer the first entry in the reactions array to track values.
-        stats = summary_stats[NUM_EVENT_TYPES + object_instance];
-        stats->description = reactor_name;
-        rstats = &stats->reactions[0];
+      stats = summary_stats[NUM_EVENT_TYPES + object_instance];
+      stats->description = reactor_name;
+      if (trace[i].dst_id >= stats->num_reactions_seen) {
+        stats->num_reactions_seen = trace[i].dst_id + 1;
+      }
+      rstats = &stats->reactions[trace[i].dst_id];
+      if (trace[i].event_type == reaction_starts) {
+        rstats->latest_start_time = trace[i].physical_time;
+      } else {
         rstats->occurrences++;
-        // User values are stored in the "extra_delay" field, which is an interval_t.
-        interval_t value = trace[i].extra_delay;
-        rstats->total_exec_time += value;
-        if (value > rstats->max_exec_time) {
-          rstats->max_exec_time = value;
+        exec_time = trace[i].physical_time - rstats->latest_start_time;
+        rstats->latest_start_time = 0LL;
+        rstats->total_exec_time += exec_time;
+        if (exec_time > rstats->max_exec_time) {
+          rstats->max_exec_time = exec_time;
         }
-        if (value < rstats->min_exec_time || rstats->min_exec_time == 0LL) {
-          rstats->min_exec_time = value;
+        if (exec_time < rstats->min_exec_time || rstats->min_exec_time == 0LL) {
+          rstats->min_exec_time = exec_time;
         }
+        rstats->histogram = histogram_record(rstats->histogram, exec_time);
+      }
+      break;
+    case schedule_called:
+      if (trigger_instance < 0) {
+        // No trigger. Do not report.
+        continue;
+      }
+      stats = summary_stats[NUM_EVENT_TYPES + trigger_instance];
+      stats->description = trigger_name;
+      break;
+    case user_event:
+      // Although these are not exec times and not reactions,
+      // commandeer the first entry in the reactions array to track values.
+      stats = summary_stats[NUM_EVENT_TYPES + object_instance];
+      stats->description = reactor_name;
+      break;
+    case user_value:
+      // Although these are not exec times and not reactions,
+      // commandeer the first entry in the reactions array to track values.
+      stats = summary_stats[NUM_EVENT_TYPES + object_instance];
+      stats->description = reactor_name;
+      rstats = &stats->reactions[0];
+      rstats->occurrences++;
+      // User values are stored in the "extra_delay" field, which is an interval_t.
+      interval_t value = trace[i].extra_delay;
+      rstats->total_exec_time += value;
+      if (value > rstats->max_exec_time) {
+        rstats->max_exec_time = value;
+      }
+      if (value < rstats->min_exec_time || rstats->min_exec_time == 0LL) {
+        rstats->min_exec_time = value;
+      }
+      break;
+    case worker_wait_starts:
+    case worker_wait_ends:
+    case scheduler_advancing_time_starts:
+    case scheduler_advancing_time_ends:
+      // Use the reactions array to store data.
+      // There will be two entries per worker, one for waits on the
+      // reaction queue and one for waits while advancing time.
+      if (trace[i].src_id < 0) {
+        // Some schedulers advance time without recording which worker does it.
         break;
-      case worker_wait_starts:
-      case worker_wait_ends:
-      case scheduler_advancing_time_starts:
-      case scheduler_advancing_time_ends:
-        // Use the reactions array to store data.
-        // There will be two entries per worker, one for waits on the
-        // reaction queue and one for waits while advancing time.
-        index = trace[i].src_id * 2;
-        // Even numbered indices are used for waits on reaction queue.
-        // Odd numbered indices for waits for time advancement.
-        if (trace[i].event_type == scheduler_advancing_time_starts ||
-            trace[i].event_type == scheduler_advancing_time_ends) {
-          index++;
-        }
-        if (object_table_size + index >= table_size) {
-          fprintf(stderr, "WARNING: Too many workers. Not all will be shown in summary file.\n");
-          continue;
+      }
+      index = trace[i].src_id * 2;
+      // Even numbered indices are used for waits on reaction queue.
+      // Odd numbered indices for waits for time advancement.
+      if (trace[i].event_type == scheduler_advancing_time_starts ||
+          trace[i].event_type == scheduler_advancing_time_ends) {
+        index++;
+      }
+      if (object_table_size + index >= table_size) {
+        fprintf(stderr, "WARNING: Too many workers. Not all will be shown in summary file.\n");
+        continue;
+      }
+      stats = summary_stats[NUM_EVENT_TYPES + object_table_size + index];
+      if (stats == NULL) {
+        stats = (summary_stats_t*)calloc(1, sizeof(summary_stats_t));
+        summary_stats[NUM_EVENT_TYPES + object_table_size + index] = stats;
+      }
+      // num_reactions_seen here will be used to store the number of
+      // entries in the reactions array, which is twice the number of workers.
+      if (index >= stats->num_reactions_seen) {
+        stats->num_reactions_seen = index;
+      }
+      rstats = &stats->reactions[index];
+      if (trace[i].event_type == worker_wait_starts || trace[i].event_type == scheduler_advancing_time_starts) {
+        rstats->latest_start_time = trace[i].physical_time;
+      } else {
+        rstats->occurrences++;
+        exec_time = trace[i].physical_time - rstats->latest_start_time;
+        rstats->latest_start_time = 0LL;
+        rstats->total_exec_time += exec_time;
+        if (exec_time > rstats->max_exec_time) {
+          rstats->max_exec_time = exec_time;
         }
-        stats = summary_stats[NUM_EVENT_TYPES + object_table_size + index];
-        if (stats == NULL) {
-          stats = (summary_stats_t*)calloc(1, sizeof(summary_stats_t));
-          summary_stats[NUM_EVENT_TYPES + object_table_size + index] = stats;
+        if (exec_time < rstats->min_exec_time || rstats->min_exec_time == 0LL) {
+          rstats->min_exec_time = exec_time;
         }
-        // num_reactions_seen here will be used to store the number of
-        // entries in the reactions array, which is twice the number of workers.
-        if (index >= stats->num_reactions_seen) {
-          stats->num_reactions_seen = index;
+      }
+      break;
+    default:
+      if (trace[i].event_type > federated && trace[i].logical_time != NEVER) {
+        // For tagged messages, commandeer the first entry in the reactions array of the
+        // event type to track the lag of the physical time behind the tag.
+        rstats = &summary_stats[trace[i].event_type]->reactions[0];
+        rstats->occurrences++;
+        interval_t lag = trace[i].physical_time - trace[i].logical_time;
+        rstats->total_exec_time += lag;
+        if (lag > rstats->max_exec_time || rstats->occurrences == 1) {
+          rstats->max_exec_time = lag;
         }
-        rstats = &stats->reactions[index];
-        if (trace[i].event_type == worker_wait_starts || trace[i].event_type == scheduler_advancing_time_starts) {
-          rstats->latest_start_time = trace[i].physical_time;
-        } else {
-          rstats->occurrences++;
-          exec_time = trace[i].physical_time - rstats->latest_start_time;
-          rstats->latest_start_time = 0LL;
-          rstats->total_exec_time += exec_time;
-          if (exec_time > rstats->max_exec_time) {
-            rstats->max_exec_time = exec_time;
-          }
-          if (exec_time < rstats->min_exec_time || rstats->min_exec_time == 0LL) {
-            rstats->min_exec_time = exec_time;
-          }
+        if (lag < rstats->min_exec_time || rstats->occurrences == 1) {
+          rstats->min_exec_time = lag;
         }
-        break;
-      default:
-        // No special summary statistics for the rest.
-        break;
-      }
-      // Common stats across event types.
-      if (stats != NULL) {
-        stats->occurrences++;
-        stats->event_type = trace[i].event_type;
+        rstats->histogram = histogram_record(rstats->histogram, lag);
       }
-    } else {
-      // Out of scope.
+      // No special summary statistics for the rest.
+      break;
+    }
+    // Common stats across event types.
+    if (stats != NULL) {
+      stats->occurrences++;
+      stats->event_type = trace[i].event_type;
     }
   }
-  return trace_length;
+}
+
+/**
+ * Write the quantiles of a histogram at the end of a line of the summary file.
+ */
+static void write_quantiles(histogram_t* histogram) {
+  for (size_t k = 0; k < sizeof(quantiles) / sizeof(quantiles[0]); k++) {
+    fprintf(summary_file, ", " PRINTF_TIME, histogram_quantile(histogram, quantiles[k]));
+  }
+  fprintf(summary_file, "\n");
 }
 
 /**
@@ -289,26 +338,47 @@ void write_summary_file() {
   // First pass looks for reaction invocations.
   // First print a header.
   fprintf(summary_file, "\nReaction Executions\n");
-  fprintf(summary_file, "Reactor, Reaction, Occurrences, Total Time, Pct Total Time, Avg Time, Max Time, Min Time\n");
+  fprintf(summary_file, "Reactor, Reaction, Occurrences, Total Time, Pct Total Time, Avg Time, Max Time, Min Time, "
+                        "P50 Time, P90 Time, P99 Time, P99.9 Time\n");
   for (int i = NUM_EVENT_TYPES; i < table_size; i++) {
     summary_stats_t* stats = summary_stats[i];
     if (stats != NULL && stats->num_reactions_seen > 0) {
       for (int j = 0; j < stats->num_reactions_seen; j++) {
         reaction_stats_t* rstats = &stats->reactions[j];
         if (rstats->occurrences > 0) {
-          fprintf(summary_file, "%s, %d, %d, " PRINTF_TIME ", %f, " PRINTF_TIME ", " PRINTF_TIME ", " PRINTF_TIME "\n",
+          fprintf(summary_file, "%s, %d, %d, " PRINTF_TIME ", %f, " PRINTF_TIME ", " PRINTF_TIME ", " PRINTF_TIME,
                   stats->description,
                   j, // Reaction number.
                   rstats->occurrences, rstats->total_exec_time,
                   rstats->total_exec_time * 100.0 / (latest_time - start_time),
                   rstats->total_exec_time / rstats->occurrences, rstats->max_exec_time, rstats->min_exec_time);
+          write_quantiles(rstats->histogram);
         }
       }
     }
   }
 
-  // Next pass looks for calls to schedule.
+  // Next pass looks for tagged federated messages.
   bool first = true;
+  for (int i = federated + 1; i < NUM_EVENT_TYPES; i++) {
+    summary_stats_t* stats = summary_stats[i];
+    if (stats != NULL && stats->reactions[0].occurrences > 0) {
+      if (first) {
+        first = false;
+        fprintf(summary_file, "\nFederated Message Lag (Physical Time Minus Tag)\n");
+        fprintf(summary_file,
+                "Message, Occurrences, Avg Lag, Max Lag, Min Lag, P50 Lag, P90 Lag, P99 Lag, P99.9 Lag\n");
+      }
+      reaction_stats_t* rstats = &stats->reactions[0];
+      fprintf(summary_file, "%s, %d, " PRINTF_TIME ", " PRINTF_TIME ", " PRINTF_TIME, stats->description,
+              rstats->occurrences, rstats->total_exec_time / rstats->occurrences, rstats->max_exec_time,
+              rstats->min_exec_time);
+      write_quantiles(rstats->histogram);
+    }
+  }
+
+  // Next pass looks for calls to schedule.
+  first = true;
   for (int i = NUM_EVENT_TYPES; i < table_size; i++) {
     summary_stats_t* stats = summary_stats[i];
     if (stats != NULL && stats->event_type == schedule_called && stats->occurrences > 0) {
@@ -374,50 +444,15 @@ void write_summary_file() {
   }
 }
 
-instant_t string_to_instant(const char* time_spec, const char* units) {
-  instant_t duration;
-#if defined(PLATFORM_ARDUINO)
-  duration = atol(time_spec);
-#else
-  duration = atoll(time_spec);
-#endif
-  // A parse error returns 0LL, so check to see whether that is what is meant.
-  if (duration == 0LL && strncmp(time_spec, "0", 1) != 0) {
-    // Parse error.
-    printf("Invalid time value: %s", time_spec);
-    return -1;
-  }
-  if (strncmp(units, "sec", 3) == 0) {
-    duration = SEC(duration);
-  } else if (strncmp(units, "msec", 4) == 0) {
-    duration = MSEC(duration);
-  } else if (strncmp(units, "usec", 4) == 0) {
-    duration = USEC(duration);
-  } else if (strncmp(units, "nsec", 4) == 0) {
-    duration = NSEC(duration);
-  } else if (strncmp(units, "min", 3) == 0) {
-    duration = MINUTE(duration);
-  } else if (strncmp(units, "hour", 4) == 0) {
-    duration = HOUR(duration);
-  } else if (strncmp(units, "day", 3) == 0) {
-    duration = DAY(duration);
-  } else if (strncmp(units, "week", 4) == 0) {
-    duration = WEEK(duration);
-  } else {
-    // Invalid units.
-    printf("Invalid time units: %s", units);
-    return -1;
-  }
-  return duration;
-}
-
-int process_args(int argc, const char* argv[], char** root, instant_t* start_time, instant_t* end_time) {
+int process_args(int argc, const char* argv[], char** root, instant_t* start_time, instant_t* end_time,
+                 int* num_threads) {
   int i = 1;
   while (i < argc) {
     const char* arg = argv[i++];
     if (strcmp(strrchr(arg, '\0') - 4, ".lft") == 0) {
       // Open the trace file.
       trace_file = open_file(arg, "r");
+      set_name_table(arg);
       if (trace_file == NULL)
         exit(1);
       *root = root_name(arg);
@@ -448,6 +483,12 @@ int process_args(int argc, const char* argv[], char** root, instant_t* start_tim
         usage();
         return -1;
       }
+    } else if (strcmp(arg, "-j") == 0 || strcmp(arg, "--jobs") == 0) {
+      if (argc < i + 1 || (*num_threads = atoi(argv[i++])) < 1) {
+        printf("-j needs a positive number of threads.");
+        usage();
+        return -1;
+      }
     } else {
       usage();
       exit(0);
@@ -459,11 +500,13 @@ int process_args(int argc, const char* argv[], char** root, instant_t* start_tim
 int main(int argc, const char* argv[]) {
   instant_t trace_start_time = NEVER;
   instant_t trace_end_time = FOREVER;
+  int num_threads = default_num_threads();
   char* root;
 
-  if (process_args(argc, argv, &root, &trace_start_time, &trace_end_time) != 0) {
+  if (process_args(argc, argv, &root, &trace_start_time, &trace_end_time, &num_threads) != 0) {
     return -1;
   }
+  set_trace_window(trace_start_time, trace_end_time);
 
   // Construct the name of the csv output file and open it.
   char csv_filename[strlen(root) + 5];
@@ -491,8 +534,7 @@ int main(int argc, const char* argv[]) {
     // Write a header line into the CSV file.
     fprintf(output_file, "Event, Reactor, Source, Destination, Elapsed Logical Time, Microstep, Elapsed Physical Time, "
                          "Trigger, Extra Delay\n");
-    while (read_and_write_trace(trace_start_time, trace_end_time) != 0) {
-    };
+    convert_trace(output_file, num_threads, format_block, update_summary_stats);
 
     write_summary_file();
 
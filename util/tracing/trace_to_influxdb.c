@@ -103,6 +103,8 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * * -h, --host: The host name running InfluxDB. If not given, this defaults to "localhost".
  * * -p, --port: The port for accessing InfluxDB. This defaults to 8086. If you used 8087, as shown above, then you have
 to give this option.
+ * * -n, --batch-points, -m, --batch-bytes: The maximum number of records and bytes sent in one request.
+ *   The records are sent in batches over one connection by a background thread, compressed unless --no-gzip is given.
  *
  * The data can then be viewed in the InfluxDB browser, or you can configure an external
  * tool such as Grafana to visualize it (see https://grafana.com/docs/grafana/latest/datasources/influxdb/).
@@ -123,6 +125,9 @@ FILE* trace_file = NULL;
 /** Struct identifying the influx client. */
 influx_client_t influx_client;
 influx_v2_client_t influx_v2_client;
+
+/** Writer that sends the records to InfluxDB in batches. */
+influx_v2_writer_t influx_writer;
 /**
  * Print a usage message.
  */
@@ -139,6 +144,12 @@ void usage() {
   printf("   The organization for access to InfluxDB (default is 'iCyPhy').\n\n");
   printf("   -b, --bucket BUCKET\n");
   printf("   The bucket into which to put the data (default is 'test').\n\n");
+  printf("   -n, --batch-points N\n");
+  printf("   The maximum number of records sent in one request (default is 5000).\n\n");
+  printf("   -m, --batch-bytes M\n");
+  printf("   The maximum size in bytes of the records sent in one request (default is 1048576).\n\n");
+  printf("   --no-gzip\n");
+  printf("   Send the records uncompressed.\n\n");
   printf("\n\n");
 }
 
@@ -161,9 +172,10 @@ size_t read_and_write_trace() {
       continue;
 
     char* reaction_name = "none";
+    char reaction_number[12];
     if (trace[i].dst_id >= 0) {
-      reaction_name = (char*)malloc(4);
-      snprintf(reaction_name, 4, "%d", trace[i].dst_id);
+      snprintf(reaction_number, sizeof(reaction_number), "%d", trace[i].dst_id);
+      reaction_name = reaction_number;
     }
     // printf("DEBUG: reactor self struct pointer: %p\n", trace[i].pointer);
     int object_instance = -1;
@@ -182,11 +194,12 @@ size_t read_and_write_trace() {
     // Presumably, the HTTP post is formatted as a "line protocol" command. See:
     // https://docs.influxdata.com/influxdb/v2.0/reference/syntax/line-protocol/
     int response_code =
-        post_curl(&influx_v2_client, INFLUX_MEAS(trace_event_names[trace[i].event_type]),
-                  INFLUX_TAG("Reactor", reactor_name), INFLUX_TAG("Reaction", reaction_name),
-                  INFLUX_F_INT("Worker", trace[i].src_id), INFLUX_F_INT("Logical Time", trace[i].logical_time),
-                  INFLUX_F_INT("Microstep", trace[i].microstep), INFLUX_F_STR("Trigger Name", trigger_name),
-                  INFLUX_F_INT("Extra Delay", trace[i].extra_delay), INFLUX_TS(trace[i].physical_time), INFLUX_END);
+        influx_v2_writer_add(&influx_writer, INFLUX_MEAS(trace_event_names[trace[i].event_type]),
+                             INFLUX_TAG("Reactor", reactor_name), INFLUX_TAG("Reaction", reaction_name),
+                             INFLUX_F_INT("Worker", trace[i].src_id), INFLUX_F_INT("Logical Time", trace[i].logical_time),
+                             INFLUX_F_INT("Microstep", trace[i].microstep), INFLUX_F_STR("Trigger Name", trigger_name),
+                             INFLUX_F_INT("Extra Delay", trace[i].extra_delay), INFLUX_TS(trace[i].physical_time),
+                             INFLUX_END);
     if (response_code != 0) {
       fprintf(stderr, "****** response code: %d\n", response_code);
       return 0;
@@ -207,6 +220,10 @@ int main(int argc, char* argv[]) {
   influx_v2_client.org = "iCyPhy";
   influx_v2_client.bucket = "test";
 
+  size_t batch_points = 5000;
+  size_t batch_bytes = 1 << 20;
+  int gzip = 1;
+
   char* filename = NULL;
 
   for (int i = 1; i < argc; i++) {
@@ -248,6 +265,22 @@ int main(int argc, char* argv[]) {
         exit(1);
       }
       influx_v2_client.bucket = argv[i];
+    } else if (strcmp("-n", argv[i]) == 0 || strcmp("--batch-points", argv[i]) == 0) {
+      if (i++ == argc - 1) {
+        usage();
+        fprintf(stderr, "No batch size specified.\n");
+        exit(1);
+      }
+      batch_points = (size_t)atol(argv[i]);
+    } else if (strcmp("-m", argv[i]) == 0 || strcmp("--batch-bytes", argv[i]) == 0) {
+      if (i++ == argc - 1) {
+        usage();
+        fprintf(stderr, "No batch size specified.\n");
+        exit(1);
+      }
+      batch_bytes = (size_t)atol(argv[i]);
+    } else if (strcmp("--no-gzip", argv[i]) == 0) {
+      gzip = 0;
     } else {
       // Must be the filename.
       filename = argv[i];
@@ -264,12 +297,22 @@ int main(int argc, char* argv[]) {
 
   // Open the trace file.
   trace_file = open_file(filename, "r");
+  set_name_table(filename);
 
   if (read_header() >= 0) {
+    if (influx_v2_writer_open(&influx_writer, &influx_v2_client, batch_points, batch_bytes, gzip) != 0) {
+      fprintf(stderr, "Failed to start sending to InfluxDB.\n");
+      exit(1);
+    }
     size_t num_records = 0, result;
     while ((result = read_and_write_trace()) != 0) {
-      num_records = result;
+      num_records += result;
     };
+    int response_code = influx_v2_writer_close(&influx_writer);
+    if (response_code != 0) {
+      fprintf(stderr, "****** response code: %d\n", response_code);
+      exit(1);
+    }
     printf("***** %zu records written to InfluxDB.\n", num_records);
     // File closing is handled by termination function.
   }
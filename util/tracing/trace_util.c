@@ -30,13 +30,29 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * text file.
  */
 #define LF_TRACE
+#define _FILE_OFFSET_BITS 64
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <stdarg.h>
+#include <pthread.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 #include "reactor.h"
 #include "trace.h"
 #include "trace_util.h"
-#include "trace_impl.h"
+#include "core/utils/impl/pointer_hashmap.h"
+
+// Offsets in trace files can exceed the range of long.
+#ifdef _WIN32
+#define trace_fseek _fseeki64
+#define trace_ftell _ftelli64
+#else
+#define trace_fseek fseeko
+#define trace_ftell ftello
+#endif
 
 /** Buffer for reading object descriptions. Size limit is BUFFER_SIZE bytes. */
 char buffer[BUFFER_SIZE];
@@ -44,6 +60,16 @@ char buffer[BUFFER_SIZE];
 /** Buffer for reading trace records. */
 trace_record_t trace[TRACE_BUFFER_CAPACITY];
 
+/** The window of elapsed logical times of the records returned by read_trace. */
+static instant_t window_start = NEVER;
+static instant_t window_end = FOREVER;
+
+/** The index of the chunks of the trace file, or NULL if the file has none or it is not used. */
+static trace_chunk_entry_t* trace_index = NULL;
+static size_t trace_index_size = 0;
+static size_t next_chunk = 0; // The entry of the index of the next chunk to read.
+static bool index_read = false;
+
 /** The start time read from the trace file. */
 instant_t start_time;
 
@@ -51,10 +77,18 @@ instant_t start_time;
 char* top_level = NULL;
 
 /** Table of pointers to the self struct of a reactor. */
-// FIXME: Replace with hash table implementation.
 object_description_t* object_table;
 int object_table_size = 0;
 
+/**
+ * Indexes of the first entry of object_table with each pointer and of the first entry of type
+ * trace_trigger with each trigger, built by read_header(). They are keyed by pointer, which may
+ * be NULL, so their key for empty entries is one that is never an address of an object.
+ */
+static hashmap_object2int_t* pointer_index = NULL;
+static hashmap_object2int_t* trigger_index = NULL;
+#define NO_OBJECT ((void*)UINTPTR_MAX)
+
 typedef struct open_file_t open_file_t;
 typedef struct open_file_t {
   FILE* file;
@@ -67,6 +101,11 @@ open_file_t* _open_files = NULL;
  */
 void termination() {
   // Free memory in object description table.
+  free(trace_index);
+  if (pointer_index != NULL) {
+    hashmap_object2int_free(pointer_index);
+    hashmap_object2int_free(trigger_index);
+  }
   for (int i = 0; i < object_table_size; i++) {
     free(object_table[i].description);
   }
@@ -125,6 +164,40 @@ FILE* open_file(const char* path, const char* mode) {
   return result;
 }
 
+/**
+ * Build the indexes of the object table, keeping the first entry for each key, as a search of
+ * the table in order would find.
+ */
+static void index_objects() {
+  if (pointer_index != NULL) {
+    hashmap_object2int_free(pointer_index);
+    hashmap_object2int_free(trigger_index);
+  }
+  // Twice as many entries as objects keep the chains of linear probing short.
+  size_t capacity = 2 * (size_t)object_table_size + 1;
+  pointer_index = hashmap_object2int_new(capacity, NO_OBJECT);
+  trigger_index = hashmap_object2int_new(capacity, NO_OBJECT);
+  for (int i = 0; i < object_table_size; i++) {
+    if (hashmap_object2int_get_or(pointer_index, object_table[i].pointer, -1) < 0) {
+      hashmap_object2int_put(pointer_index, object_table[i].pointer, i);
+    }
+    if (object_table[i].type == trace_trigger &&
+        hashmap_object2int_get_or(trigger_index, object_table[i].trigger, -1) < 0) {
+      hashmap_object2int_put(trigger_index, object_table[i].trigger, i);
+    }
+  }
+}
+
+/** Return the index of the first entry of the object table with the given pointer, or -1 if there is none. */
+static int object_index_of(void* pointer) {
+  return (pointer_index == NULL || pointer == NO_OBJECT) ? -1 : hashmap_object2int_get_or(pointer_index, pointer, -1);
+}
+
+/** Return the index of the first trigger of the object table with the given pointer, or -1 if there is none. */
+static int trigger_index_of(void* trigger) {
+  return (trigger_index == NULL || trigger == NO_OBJECT) ? -1 : hashmap_object2int_get_or(trigger_index, trigger, -1);
+}
+
 /**
  * Get the description of the object pointed to by the specified pointer.
  * For example, this can be the name of a reactor (pointer points to
@@ -137,19 +210,11 @@ FILE* open_file(const char* path, const char* mode) {
  * @param index An optional pointer into which to write the index.
  */
 char* get_object_description(void* pointer, int* index) {
-  // FIXME: Replace with a hash table implementation.
-  for (int i = 0; i < object_table_size; i++) {
-    if (object_table[i].pointer == pointer) {
-      if (index != NULL) {
-        *index = i;
-      }
-      return object_table[i].description;
-    }
-  }
+  int i = object_index_of(pointer);
   if (index != NULL) {
-    *index = 0;
+    *index = i < 0 ? 0 : i;
   }
-  return NULL;
+  return i < 0 ? NULL : object_table[i].description;
 }
 
 /**
@@ -162,19 +227,11 @@ char* get_object_description(void* pointer, int* index) {
  * @param index An optional pointer into which to write the index.
  */
 char* get_trigger_name(void* trigger, int* index) {
-  // FIXME: Replace with a hash table implementation.
-  for (int i = 0; i < object_table_size; i++) {
-    if (object_table[i].trigger == trigger && object_table[i].type == trace_trigger) {
-      if (index != NULL) {
-        *index = i;
-      }
-      return object_table[i].description;
-    }
-  }
+  int i = trigger_index_of(trigger);
   if (index != NULL) {
-    *index = 0;
+    *index = i < 0 ? 0 : i;
   }
-  return NULL;
+  return i < 0 ? NULL : object_table[i].description;
 }
 
 /**
@@ -199,6 +256,52 @@ void print_table() {
   printf("-------\n");
 }
 
+/** Path of the offline name table, or NULL if there is none. */
+static char* name_table_path = NULL;
+
+void set_name_table(const char* trace_path) {
+  free(name_table_path);
+  const char* last_period = strrchr(trace_path, '.');
+  size_t length = (last_period == NULL) ? strlen(trace_path) : (size_t)(last_period - trace_path);
+  name_table_path = (char*)malloc(length + strlen(".names") + 1);
+  if (name_table_path == NULL) {
+    return;
+  }
+  memcpy(name_table_path, trace_path, length);
+  strcpy(name_table_path + length, ".names");
+}
+
+/**
+ * Name the objects that have no description after the offline name table, if there is one,
+ * or after their index in the object table.
+ */
+static void name_objects() {
+  FILE* names = (name_table_path == NULL) ? NULL : fopen(name_table_path, "r");
+  for (int i = 0; i < object_table_size; i++) {
+    char* line = (names == NULL) ? NULL : fgets(buffer, BUFFER_SIZE, names);
+    if (object_table[i].description[0] != '\0') {
+      continue;
+    }
+    if (line == NULL) {
+      snprintf(buffer, BUFFER_SIZE, "#%d", i);
+    } else {
+      buffer[strcspn(buffer, "\r\n")] = '\0';
+    }
+    char* name = strdup(buffer);
+    if (name == NULL) {
+      break;
+    }
+    free(object_table[i].description);
+    object_table[i].description = name;
+  }
+  if (names != NULL) {
+    fclose(names);
+  }
+  if (object_table_size > 0) {
+    top_level = object_table[0].description;
+  }
+}
+
 size_t read_header() {
   // Read the start time.
   int items_read = fread(&start_time, sizeof(instant_t), 1, trace_file);
@@ -265,30 +368,493 @@ size_t read_header() {
       top_level = object_table[i].description;
     }
   }
+  name_objects();
+  index_objects();
   print_table();
   return object_table_size;
 }
 
+/**
+ * Read the index at the end of the trace file into `trace_index`, if there is one.
+ * The position in the file is restored.
+ */
+static void read_index() {
+  int64_t position = trace_ftell(trace_file);
+  int64_t index_offset;
+  char magic[TRACE_INDEX_MAGIC_SIZE];
+  int marker;
+  int64_t size;
+  if (trace_fseek(trace_file, -(int64_t)(sizeof(int64_t) + TRACE_INDEX_MAGIC_SIZE), SEEK_END) == 0 &&
+      fread(&index_offset, sizeof(int64_t), 1, trace_file) == 1 &&
+      fread(magic, 1, TRACE_INDEX_MAGIC_SIZE, trace_file) == TRACE_INDEX_MAGIC_SIZE &&
+      memcmp(magic, TRACE_INDEX_MAGIC, TRACE_INDEX_MAGIC_SIZE) == 0 &&
+      trace_fseek(trace_file, index_offset, SEEK_SET) == 0 && fread(&marker, sizeof(int), 1, trace_file) == 1 &&
+      marker == TRACE_INDEX_MARKER && fread(&size, sizeof(int64_t), 1, trace_file) == 1 && size >= 0) {
+    trace_index = (trace_chunk_entry_t*)malloc(sizeof(trace_chunk_entry_t) * (size_t)size);
+    if (trace_index != NULL &&
+        fread(trace_index, sizeof(trace_chunk_entry_t), (size_t)size, trace_file) == (size_t)size) {
+      trace_index_size = (size_t)size;
+    } else {
+      free(trace_index);
+      trace_index = NULL;
+    }
+  }
+  trace_fseek(trace_file, position, SEEK_SET);
+}
+
+void set_trace_window(instant_t start, instant_t end) {
+  window_start = start;
+  window_end = end;
+}
+
+/** Return whether records with logical times from `min` to `max` can be in the window. */
+static bool overlaps_window(instant_t min, instant_t max) {
+  return max - start_time >= window_start && min - start_time < window_end;
+}
+
+/**
+ * Read the block at the current position of a trace file into `block` without decoding it.
+ * @param file The trace file.
+ * @param block The block.
+ * @param windowed Whether to skip the chunks outside the window given to set_trace_window().
+ * @return False upon seeing an EOF or the index of the trace file.
+ */
+static bool read_block_from(FILE* file, trace_block_t* block, bool windowed) {
+  while (true) {
+    // Read first the int giving the length of the trace or marking a chunk.
+    int trace_length;
+    int items_read = fread(&trace_length, sizeof(int), 1, file);
+    if (items_read != 1) {
+      if (feof(file))
+        return false;
+      fprintf(stderr, "Failed to read trace length.\n");
+      exit(3);
+    }
+    if (trace_length == TRACE_INDEX_MARKER) {
+      return false;
+    }
+    block->raw_length = trace_length;
+    if (trace_length >= 0) {
+      // Uncompressed records, as written by older versions.
+      if (trace_length > TRACE_BUFFER_CAPACITY) {
+        fprintf(stderr, "ERROR: Trace length %d exceeds capacity. File is garbled.\n", trace_length);
+        exit(4);
+      }
+      items_read = fread(block->records, sizeof(trace_record_t), trace_length, file);
+      if (items_read != trace_length) {
+        fprintf(stderr, "Failed to read trace of length %d.\n", trace_length);
+        exit(5);
+      }
+      return true;
+    }
+    trace_chunk_header_t* header = &block->header;
+    if ((trace_length != TRACE_COMPACT_CHUNK_MARKER && trace_length != TRACE_CHUNK_MARKER) ||
+        fread(header, sizeof(*header), 1, file) != 1 || header->number_of_records > TRACE_BUFFER_CAPACITY ||
+        header->payload_size > TRACE_BUFFER_CAPACITY * TRACE_CHUNK_MAX_RECORD_SIZE) {
+      fprintf(stderr, "ERROR: Invalid trace chunk. File is garbled.\n");
+      exit(4);
+    }
+    if (windowed && !overlaps_window(header->min_logical_time, header->max_logical_time)) {
+      // Skip the chunk without reading it.
+      trace_fseek(file, header->payload_size, SEEK_CUR);
+      continue;
+    }
+    if (fread(block->payload, 1, header->payload_size, file) != header->payload_size) {
+      fprintf(stderr, "Failed to read trace chunk of length %u.\n", (unsigned)header->number_of_records);
+      exit(5);
+    }
+    return true;
+  }
+}
+
+/**
+ * Read the next block in the window from the trace_file into `block` without decoding it.
+ * Chunks outside the window are skipped.
+ * @return False upon seeing an EOF or the index of the trace file.
+ */
+static bool read_block(trace_block_t* block) {
+  if (!index_read) {
+    index_read = true;
+    // Without a window, reading the chunks in order is just as fast.
+    if (window_start != NEVER || window_end != FOREVER) {
+      read_index();
+    }
+  }
+  if (trace_index != NULL) {
+    // Go to the next chunk in the window.
+    while (next_chunk < trace_index_size &&
+           !overlaps_window(trace_index[next_chunk].min_logical_time, trace_index[next_chunk].max_logical_time)) {
+      next_chunk++;
+    }
+    if (next_chunk == trace_index_size) {
+      return false;
+    }
+    if (trace_fseek(trace_file, trace_index[next_chunk++].offset, SEEK_SET) != 0) {
+      fprintf(stderr, "Failed to seek to trace chunk.\n");
+      exit(3);
+    }
+  }
+  return read_block_from(trace_file, block, true);
+}
+
+/**
+ * Decode the records of a block read by read_block and keep only those in the window.
+ * This only reads global state, so blocks can be decoded in parallel.
+ * @return The number of records in the window.
+ */
+static int decode_block(trace_block_t* block) {
+  int trace_length = block->raw_length;
+  if (trace_length < 0) {
+    if (!trace_chunk_decode(trace_length, &block->header, block->payload, (trace_record_nodeps_t*)block->records)) {
+      fprintf(stderr, "Failed to decode trace chunk of length %u.\n", (unsigned)block->header.number_of_records);
+      exit(5);
+    }
+    trace_length = (int)block->header.number_of_records;
+  }
+  // Keep only the records in the window.
+  int length = 0;
+  for (int i = 0; i < trace_length; i++) {
+    if (overlaps_window(block->records[i].logical_time, block->records[i].logical_time)) {
+      block->records[length++] = block->records[i];
+    }
+  }
+  block->length = length;
+  return length;
+}
+
 int read_trace() {
-  // Read first the int giving the length of the trace.
-  int trace_length;
-  int items_read = fread(&trace_length, sizeof(int), 1, trace_file);
-  if (items_read != 1) {
-    if (feof(trace_file))
-      return 0;
-    fprintf(stderr, "Failed to read trace length.\n");
-    exit(3);
+  static trace_block_t block;
+  while (read_block(&block)) {
+    int length = decode_block(&block);
+    if (length > 0) {
+      memcpy(trace, block.records, sizeof(trace_record_t) * length);
+      return length;
+    }
   }
-  if (trace_length > TRACE_BUFFER_CAPACITY) {
-    fprintf(stderr, "ERROR: Trace length %d exceeds capacity. File is garbled.\n", trace_length);
-    exit(4);
+  return 0;
+}
+
+void trace_reader_open(trace_reader_t* reader, const char* path) {
+  FILE* file = open_file(path, "r");
+  reader->file = file;
+  int size;
+  if (fread(&reader->start_time, sizeof(instant_t), 1, file) != 1 || fread(&size, sizeof(int), 1, file) != 1)
+    _LF_TRACE_FAILURE(file);
+  // Skip the object table.
+  for (int i = 0; i < size; i++) {
+    void* pointer;
+    trigger_t* trigger;
+    _lf_trace_object_t type;
+    if (fread(&pointer, sizeof(void*), 1, file) != 1 || fread(&trigger, sizeof(trigger_t*), 1, file) != 1 ||
+        fread(&type, sizeof(_lf_trace_object_t), 1, file) != 1)
+      _LF_TRACE_FAILURE(file);
+    int character;
+    do {
+      character = fgetc(file);
+    } while (character != 0 && character != EOF);
+    if (character == EOF)
+      _LF_TRACE_FAILURE(file);
   }
-  // printf("DEBUG: Trace of length %d being converted.\n", trace_length);
+  reader->records_offset = trace_ftell(file);
+}
 
-  items_read = fread(&trace, sizeof(trace_record_t), trace_length, trace_file);
-  if (items_read != trace_length) {
-    fprintf(stderr, "Failed to read trace of length %d.\n", trace_length);
+int trace_reader_read(trace_reader_t* reader, trace_block_t* block) {
+  if (!read_block_from(reader->file, block, false)) {
+    return -1;
+  }
+  if (block->raw_length >= 0) {
+    return block->raw_length;
+  }
+  if (!trace_chunk_decode(block->raw_length, &block->header, block->payload, (trace_record_nodeps_t*)block->records)) {
+    fprintf(stderr, "Failed to decode trace chunk of length %u.\n", (unsigned)block->header.number_of_records);
     exit(5);
   }
-  return trace_length;
+  return (int)block->header.number_of_records;
+}
+
+void trace_reader_rewind(trace_reader_t* reader) {
+  if (trace_fseek(reader->file, reader->records_offset, SEEK_SET) != 0) {
+    fprintf(stderr, "Failed to seek in trace file.\n");
+    exit(3);
+  }
+}
+
+void block_printf(trace_block_t* block, const char* format, ...) {
+  va_list args;
+  while (true) {
+    size_t available = block->text_capacity - block->text_size;
+    va_start(args, format);
+    int length = vsnprintf(block->text + block->text_size, available, format, args);
+    va_end(args);
+    if (length < 0) {
+      fprintf(stderr, "ERROR: Failed to format trace record.\n");
+      exit(3);
+    }
+    if ((size_t)length < available) {
+      block->text_size += length;
+      return;
+    }
+    size_t capacity = block->text_capacity * 2 + length + 1;
+    char* text = (char*)realloc(block->text, capacity);
+    if (text == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(3);
+    }
+    block->text = text;
+    block->text_capacity = capacity;
+  }
+}
+
+/**
+ * State shared by convert_trace and the threads that convert blocks.
+ * Blocks are used as a ring. The calling thread reads blocks into it, the
+ * converting threads take them in the same order, and the calling thread
+ * writes them in the same order once they are converted.
+ */
+typedef struct converter_t {
+  trace_block_t** blocks;
+  bool* converted; // Whether each block in the ring is converted.
+  size_t capacity; // Number of blocks in the ring.
+  size_t read;     // Number of blocks read so far.
+  size_t taken;    // Number of blocks taken by converting threads so far.
+  bool done;       // Whether all blocks have been read.
+  trace_formatter_t format;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} converter_t;
+
+/**
+ * A thread that decodes and converts blocks until all blocks have been read.
+ */
+static void* converter_thread(void* arg) {
+  converter_t* c = (converter_t*)arg;
+  pthread_mutex_lock(&c->mutex);
+  while (true) {
+    while (c->taken == c->read && !c->done) {
+      pthread_cond_wait(&c->cond, &c->mutex);
+    }
+    if (c->taken == c->read) {
+      break;
+    }
+    size_t slot = c->taken++ % c->capacity;
+    trace_block_t* block = c->blocks[slot];
+    pthread_mutex_unlock(&c->mutex);
+
+    block->text_size = 0;
+    decode_block(block);
+    for (int i = 0; i < block->length; i++) {
+      block->object_index[i] = object_index_of(block->records[i].pointer);
+      block->trigger_index[i] = trigger_index_of(block->records[i].trigger);
+    }
+    c->format(block);
+
+    pthread_mutex_lock(&c->mutex);
+    c->converted[slot] = true;
+    pthread_cond_broadcast(&c->cond);
+  }
+  pthread_mutex_unlock(&c->mutex);
+  return NULL;
+}
+
+size_t convert_trace(FILE* output, int num_threads, trace_formatter_t format, trace_merger_t merge) {
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+  converter_t c = {.capacity = 2 * num_threads, .format = format};
+  c.blocks = (trace_block_t**)calloc(c.capacity, sizeof(trace_block_t*));
+  c.converted = (bool*)calloc(c.capacity, sizeof(bool));
+  pthread_t* threads = (pthread_t*)calloc(num_threads, sizeof(pthread_t));
+  if (c.blocks == NULL || c.converted == NULL || threads == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(3);
+  }
+  pthread_mutex_init(&c.mutex, NULL);
+  pthread_cond_init(&c.cond, NULL);
+  for (int i = 0; i < num_threads; i++) {
+    if (pthread_create(&threads[i], NULL, converter_thread, &c) != 0) {
+      fprintf(stderr, "ERROR: Failed to create converter thread.\n");
+      exit(3);
+    }
+  }
+
+  size_t records = 0;
+  size_t written = 0;
+  bool eof = false;
+  while (true) {
+    // Read blocks until the ring is full.
+    while (!eof && c.read - written < c.capacity) {
+      size_t slot = c.read % c.capacity;
+      if (c.blocks[slot] == NULL) {
+        c.blocks[slot] = (trace_block_t*)calloc(1, sizeof(trace_block_t));
+        if (c.blocks[slot] != NULL) {
+          c.blocks[slot]->text_capacity = TRACE_BUFFER_CAPACITY * 64;
+          c.blocks[slot]->text = (char*)malloc(c.blocks[slot]->text_capacity);
+        }
+        if (c.blocks[slot] == NULL || c.blocks[slot]->text == NULL) {
+          fprintf(stderr, "Out of memory.\n");
+          exit(3);
+        }
+      }
+      // Blocks not yet read are not accessed by the converting threads.
+      eof = !read_block(c.blocks[slot]);
+      pthread_mutex_lock(&c.mutex);
+      if (eof) {
+        c.done = true;
+      } else {
+        c.converted[slot] = false;
+        c.read++;
+      }
+      pthread_cond_broadcast(&c.cond);
+      pthread_mutex_unlock(&c.mutex);
+    }
+    if (written == c.read) {
+      break;
+    }
+    // Write the oldest block once it is converted.
+    size_t slot = written % c.capacity;
+    pthread_mutex_lock(&c.mutex);
+    while (!c.converted[slot]) {
+      pthread_cond_wait(&c.cond, &c.mutex);
+    }
+    pthread_mutex_unlock(&c.mutex);
+    trace_block_t* block = c.blocks[slot];
+    if (merge != NULL) {
+      merge(block);
+    }
+    if (block->text_size > 0 && fwrite(block->text, 1, block->text_size, output) != block->text_size) {
+      fprintf(stderr, "ERROR: Failed to write output file.\n");
+      exit(3);
+    }
+    records += block->length;
+    written++;
+  }
+
+  for (int i = 0; i < num_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  pthread_mutex_destroy(&c.mutex);
+  pthread_cond_destroy(&c.cond);
+  for (size_t i = 0; i < c.capacity; i++) {
+    if (c.blocks[i] != NULL) {
+      free(c.blocks[i]->text);
+      free(c.blocks[i]);
+    }
+  }
+  free(c.blocks);
+  free(c.converted);
+  free(threads);
+  return records;
+}
+
+/** Return the index of the bucket of a histogram for a nonnegative value. */
+static int histogram_bucket(interval_t value) {
+  if (value < (1 << HISTOGRAM_SUB_BUCKET_BITS)) {
+    return (int)value;
+  }
+  int exponent = 63 - __builtin_clzll((unsigned long long)value);
+  int shift = exponent - HISTOGRAM_SUB_BUCKET_BITS;
+  // The leading bit and the next HISTOGRAM_SUB_BUCKET_BITS bits select the bucket.
+  return ((shift + 1) << HISTOGRAM_SUB_BUCKET_BITS) + (int)((value >> shift) - (1 << HISTOGRAM_SUB_BUCKET_BITS));
+}
+
+/** Return the middle of the range of values of a bucket of a histogram. */
+static interval_t histogram_bucket_value(int bucket) {
+  if (bucket < (1 << HISTOGRAM_SUB_BUCKET_BITS)) {
+    return bucket;
+  }
+  int shift = (bucket >> HISTOGRAM_SUB_BUCKET_BITS) - 1;
+  interval_t lowest = (interval_t)((1 << HISTOGRAM_SUB_BUCKET_BITS) + (bucket & ((1 << HISTOGRAM_SUB_BUCKET_BITS) - 1)))
+                      << shift;
+  return lowest + ((1LL << shift) >> 1);
+}
+
+histogram_t* histogram_record(histogram_t* histogram, interval_t value) {
+  if (histogram == NULL) {
+    histogram = (histogram_t*)calloc(1, sizeof(histogram_t));
+    if (histogram == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(1);
+    }
+  }
+  if (value < 0) {
+    value = 0;
+  }
+  if (histogram->count == 0 || value < histogram->min) {
+    histogram->min = value;
+  }
+  if (histogram->count == 0 || value > histogram->max) {
+    histogram->max = value;
+  }
+  histogram->count++;
+  histogram->buckets[histogram_bucket(value)]++;
+  return histogram;
+}
+
+interval_t histogram_quantile(histogram_t* histogram, double q) {
+  if (histogram == NULL || histogram->count == 0) {
+    return 0;
+  }
+  // The rank of the value, rounded up.
+  int64_t rank = (int64_t)(q * histogram->count);
+  if ((double)rank < q * histogram->count) {
+    rank++;
+  }
+  if (rank < 1) {
+    rank = 1;
+  }
+  int64_t seen = 0;
+  for (int i = 0; i < HISTOGRAM_NUM_BUCKETS; i++) {
+    seen += histogram->buckets[i];
+    if (seen >= rank) {
+      // The extreme values are known exactly.
+      interval_t value = histogram_bucket_value(i);
+      return value < histogram->min ? histogram->min : value > histogram->max ? histogram->max : value;
+    }
+  }
+  return histogram->max;
+}
+
+int default_num_threads() {
+#ifdef _WIN32
+  return 4;
+#else
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  return processors > 0 ? (int)processors : 1;
+#endif
+}
+instant_t string_to_instant(const char* time_spec, const char* units) {
+  instant_t duration;
+#if defined(PLATFORM_ARDUINO)
+  duration = atol(time_spec);
+#else
+  duration = atoll(time_spec);
+#endif
+  // A parse error returns 0LL, so check to see whether that is what is meant.
+  if (duration == 0LL && strncmp(time_spec, "0", 1) != 0) {
+    // Parse error.
+    printf("Invalid time value: %s", time_spec);
+    return -1;
+  }
+  if (strncmp(units, "sec", 3) == 0) {
+    duration = SEC(duration);
+  } else if (strncmp(units, "msec", 4) == 0) {
+    duration = MSEC(duration);
+  } else if (strncmp(units, "usec", 4) == 0) {
+    duration = USEC(duration);
+  } else if (strncmp(units, "nsec", 4) == 0) {
+    duration = NSEC(duration);
+  } else if (strncmp(units, "min", 3) == 0) {
+    duration = MINUTE(duration);
+  } else if (strncmp(units, "hour", 4) == 0) {
+    duration = HOUR(duration);
+  } else if (strncmp(units, "day", 3) == 0) {
+    duration = DAY(duration);
+  } else if (strncmp(units, "week", 4) == 0) {
+    duration = WEEK(duration);
+  } else {
+    // Invalid units.
+    printf("Invalid time units: %s", units);
+    return -1;
+  }
+  return duration;
 }
@@ -32,6 +32,8 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define LF_TRACE
 #include "reactor.h"
 #include "trace.h"
+#include "trace_impl.h"
+#include "trace_chunk.h"
 
 /**
  * String description of event types.
@@ -125,15 +127,156 @@ char* get_trigger_name(void* trigger, int* index);
  */
 void print_table();
 
+/**
+ * Set the path of the trace file so that read_header() can find its offline name table.
+ * The name table of `Foo.lft` is `Foo.names`, a text file whose line i is the name of the
+ * object at index i of the object table. It is used for objects that have no description
+ * in the trace file, because the program was built with LF_MINIMAL_FOOTPRINT.
+ */
+void set_name_table(const char* trace_path);
+
 /**
  * Read header information.
+ * Objects without a description are named from the name table given to set_name_table(),
+ * if there is one, and are otherwise named by their index, e.g. "#3".
  * @return The number of objects in the object table or -1 for failure.
  */
 size_t read_header();
 
+/**
+ * Restrict the records returned by read_trace to those whose elapsed
+ * logical time is at least `start` and less than `end`. Chunks of the trace
+ * file that lie outside this window are skipped without being decoded
+ * and, if the file has an index, without being read.
+ * @param start The start of the window (elapsed logical time).
+ * @param end The end of the window (elapsed logical time).
+ */
+void set_trace_window(instant_t start, instant_t end);
+
 /**
  * Read the trace from the trace_file and put it in the trace global
  * variable. Return the length of the trace.
  * @return The number of trace record read or 0 upon seeing an EOF.
  */
 int read_trace();
+
+/**
+ * A block of the trace file as flushed by the runtime, together with the text it is converted to.
+ * Blocks are converted by convert_trace.
+ */
+typedef struct trace_block_t {
+  int raw_length;              // The length read before the block, or the marker of a chunk.
+  trace_chunk_header_t header; // The header of the chunk, if the block is a chunk.
+  uint8_t payload[TRACE_BUFFER_CAPACITY * TRACE_CHUNK_MAX_RECORD_SIZE]; // The encoded records of a chunk.
+  int length;                                   // The number of decoded records in the window.
+  trace_record_t records[TRACE_BUFFER_CAPACITY]; // The decoded records in the window.
+  int object_index[TRACE_BUFFER_CAPACITY];       // Index in object_table of the pointer of each record, or -1.
+  int trigger_index[TRACE_BUFFER_CAPACITY];      // Index in object_table of the trigger of each record, or -1.
+  char* text;                                    // The text converted from the records.
+  size_t text_size;
+  size_t text_capacity;
+} trace_block_t;
+
+/**
+ * Function that converts the records of a block into text using block_printf.
+ * It is called in several threads at once on different blocks, so it must not
+ * modify state other than the block.
+ */
+typedef void (*trace_formatter_t)(trace_block_t* block);
+
+/**
+ * Function that is called on each converted block in the order of the trace file,
+ * just before its text is written. It runs in the calling thread of convert_trace,
+ * so it can update state such as summary statistics.
+ */
+typedef void (*trace_merger_t)(trace_block_t* block);
+
+/**
+ * A trace file that is read block by block independently of trace_file, so that several
+ * trace files can be read at once. The window given to set_trace_window() does not apply.
+ */
+typedef struct trace_reader_t {
+  FILE* file;
+  instant_t start_time;   // The start time read from the trace file.
+  int64_t records_offset; // The position in the file of the first block.
+} trace_reader_t;
+
+/**
+ * Open the specified trace file for reading with trace_reader_read() and read its header,
+ * skipping its object table. The file is closed at termination. This exits on failure.
+ * @param reader The reader to initialize.
+ * @param path The path to the trace file.
+ */
+void trace_reader_open(trace_reader_t* reader, const char* path);
+
+/**
+ * Read and decode the next block of records of a trace file into `block->records`.
+ * @return The number of records, which may be 0, or -1 upon seeing the end of the records.
+ */
+int trace_reader_read(trace_reader_t* reader, trace_block_t* block);
+
+/**
+ * Go back to the first block of records of a trace file.
+ */
+void trace_reader_rewind(trace_reader_t* reader);
+
+/**
+ * Append text to the text of a block, with the arguments of printf.
+ */
+void block_printf(trace_block_t* block, const char* format, ...);
+
+/**
+ * Read the rest of the trace from the trace_file and write its text to the given file.
+ * Blocks are read in order, decoded and converted by `format` in `num_threads` threads,
+ * and passed to `merge` (if it is not NULL) and written in order.
+ * @param output The file to write the text to.
+ * @param num_threads The number of threads that convert blocks.
+ * @param format The function that converts a block into text.
+ * @param merge The function to call on each block before its text is written, or NULL.
+ * @return The number of trace records converted.
+ */
+size_t convert_trace(FILE* output, int num_threads, trace_formatter_t format, trace_merger_t merge);
+
+/**
+ * Return the number of threads to use by default to convert a trace.
+ */
+int default_num_threads();
+
+/** Log2 of the number of buckets per power of two of a histogram_t. */
+#define HISTOGRAM_SUB_BUCKET_BITS 5
+
+/** Number of buckets of a histogram_t, enough for all nonnegative 64-bit values. */
+#define HISTOGRAM_NUM_BUCKETS ((64 - HISTOGRAM_SUB_BUCKET_BITS) << HISTOGRAM_SUB_BUCKET_BITS)
+
+/**
+ * A histogram of time values with buckets whose width grows with the values, as in an HDR
+ * histogram, so that the quantiles computed from it have a relative error of at most
+ * 2^-HISTOGRAM_SUB_BUCKET_BITS (about 3%) while its size is fixed however many values it has.
+ * Values below 2^HISTOGRAM_SUB_BUCKET_BITS have a bucket each; negative values count as 0.
+ */
+typedef struct histogram_t {
+  int64_t count;
+  interval_t min;
+  interval_t max;
+  int64_t buckets[HISTOGRAM_NUM_BUCKETS];
+} histogram_t;
+
+/**
+ * Add a value to a histogram, which is allocated with calloc on the first value if it is NULL.
+ * @return The histogram.
+ */
+histogram_t* histogram_record(histogram_t* histogram, interval_t value);
+
+/**
+ * Return the smallest value of the histogram such that a fraction `q` of its values are at most
+ * that value, within the error of the histogram, or 0 if the histogram is NULL or empty.
+ * @param histogram The histogram.
+ * @param q The quantile, between 0 and 1, e.g. 0.99 for the 99th percentile.
+ */
+interval_t histogram_quantile(histogram_t* histogram, double q);
+
+/**
+ * Convert a time value and units, such as "10" and "msec", to an interval.
+ * @return The interval or -1 if the time value or units are invalid.
+ */
+instant_t string_to_instant(const char* time_spec, const char* units);
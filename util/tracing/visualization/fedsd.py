@@ -106,6 +106,8 @@ parser.add_argument('-s', '--start', type=str, nargs=2,
                     help='Start time of visualization in elapsed logical time. [time_value time_unit]')
 parser.add_argument('-e', '--end', type=str, nargs=2,
                     help='End time of visualization in elapsed logical time. [time_value time_unit]')
+parser.add_argument('-m', '--merged', type=str,
+                    help='Merged trace file written by trace_merge, instead of lft trace files.')
 
 # Events matching at the sender and receiver ends depend on whether they are tagged
 # (the elapsed logical time and microstep have to be the same) or not. 
@@ -356,6 +358,28 @@ def load_and_process_csv_file(csv_file) :
     df['event'] = df['event'].apply(lambda e: prune_event_name[e])
     return df
 
+def load_merged_csv_file(csv_file) :
+    '''
+    Loads the entries of a trace file written by trace_merge, which are already
+    pruned and merged, and the names of its actors.
+
+    Args:
+     * csv_file: String file name
+    Returns:
+     * The dataframe.
+     * Dict: the names of the actors, by id, in the order of the file.
+    '''
+    names = {}
+    with open(csv_file, encoding='utf-8') as f:
+        for line in f:
+            if (not line.startswith('# actor,')):
+                break
+            id, name = line.strip()[len('# actor,'):].split(',', 1)
+            names[int(id)] = name
+    df = pd.read_csv(csv_file, comment='#')
+    df = df.astype({'self_id': 'int', 'partner_id': 'int'})
+    return df, names
+
 def command_is_in_path(command):
     '''
     Checks if a command is in the PATH.
@@ -465,14 +489,18 @@ def get_and_convert_lft_files(rti_lft_file, federates_lft_files, start_time, end
 if __name__ == '__main__':
     args = parser.parse_args()
 
-    # Check that trace_to_csv is in PATH
-    if (not command_is_in_path('trace_to_csv')):
-        print('Fedsd: Error: trace_to_csv utility is not in PATH. Abort!')
-        sys.exit(1)
-
-    # Look up the lft files and transform them to csv files
+    if (args.merged):
+        # The trace files were already merged by trace_merge
+        merged_df, merged_names = load_merged_csv_file(args.merged)
+        rti_csv_file, federates_csv_files = '', []
+    else:
+        # Check that trace_to_csv is in PATH
+        if (not command_is_in_path('trace_to_csv')):
+            print('Fedsd: Error: trace_to_csv utility is not in PATH. Abort!')
+            sys.exit(1)
 
-    rti_csv_file, federates_csv_files = get_and_convert_lft_files(args.rti, args.federates, args.start, args.end)
+        # Look up the lft files and transform them to csv files
+        rti_csv_file, federates_csv_files = get_and_convert_lft_files(args.rti, args.federates, args.start, args.end)
     
     # The RTI and each of the federates have a fixed x coordinate. They will be
     # saved in a dict
@@ -512,12 +540,23 @@ if __name__ == '__main__':
                 fed_df['x1'] = x_coor[fed_id]
                 trace_df = pd.concat([trace_df, fed_df])
                 fed_df = fed_df[0:0]
+
+    if (args.merged):
+        for fed_id, name in merged_names.items():
+            if (fed_id != -1):
+                actors.append(fed_id)
+                actors_names[fed_id] = name
+                x_coor[fed_id] = (padding * 2) + (spacing * (len(actors) - 1))
+        merged_df['x1'] = merged_df['self_id'].apply(lambda e: x_coor[int(e)])
+        trace_df = merged_df[merged_df['self_id'] != -1]
     
         
     ############################################################################
     #### RTI trace processing, if any
     ############################################################################
-    if (rti_csv_file):
+    if (args.merged and (merged_df['self_id'] == -1).any()):
+        rti_df = merged_df[merged_df['self_id'] == -1]
+    elif (rti_csv_file):
         rti_df = load_and_process_csv_file(rti_csv_file)
         rti_df['x1'] = x_coor[-1]
     else:
@@ -531,6 +570,8 @@ if __name__ == '__main__':
         rti_df.columns = ['event', 'partner_id', 'self_id', 'logical_time', 'microstep', 'physical_time', 'inout']
         rti_df['inout'] = rti_df['inout'].apply(lambda e: 'in' if 'out' in e else 'out')
         rti_df['x1'] = rti_df['self_id'].apply(lambda e: x_coor[int(e)])
+        if ('count' in trace_df):
+            rti_df['count'] = trace_df['count']
 
     trace_df = pd.concat([trace_df, rti_df])
 
@@ -676,6 +717,9 @@ if __name__ == '__main__':
                 label = row['event']
             else:
                 label = row['event'] + '(' + f'{int(row["logical_time"]):,}' + ', ' + str(row['microstep']) + ')'
+            # Records aggregated by trace_merge are drawn once, with their number
+            if ('count' in row and row['count'] > 1):
+                label = label + ' x' + str(int(row['count']))
             
             if (row['arrow'] == 'arrow'): 
                 f.write(svg_string_draw_arrow(row['x1'], row['y1'], row['x2'], row['y2'], label, row['event']))
@@ -32,6 +32,16 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * as long as they follow the convention for naming their conversion functions this macro will work
  *
  * Convention: toType convert__fromType_to__toType(fromType x)
+ *
+ * It also provides kernels that convert whole arrays, such as the samples of an audio
+ * buffer or the elements of an array-valued port, in one pass over contiguous memory
+ * without temporaries: int16_t and int32_t to and from float with a scale factor,
+ * scaling of float arrays, and byte swapping for changing the endianness. They use
+ * AVX2, SSE2 or AArch64 NEON when the compiler targets them and scalar code otherwise,
+ * with the same results. The macro `DO_CONVERT_ARRAY(fromType, toType, in, out, length)`
+ * resolves array converters that follow the convention
+ *
+ * Convention: void convert_array__fromType_to__toType(const fromType* in, toType* out, size_t length)
  */
 
 #ifndef TYPE_CONVERTER_H_
@@ -51,4 +61,339 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ///         <br> <code> toType convert__fromType_to__toType(fromType x) </code>
 #define DO_CONVERT(fromType, toType, value) RESOLVE(fromType, toType, value)
 
+#define RESOLVE_ARRAY(i, o, in, out, length) PASTE(convert_array__##i, _to__##o)(in, out, length)
+
+/// @name DO_CONVERT_ARRAY
+/// @param fromType Typename of the elements of <code> in </code>
+/// @param toType Typename of the elements of <code> out </code>
+/// @param in Array of <code> length </code> elements of type <code> fromType </code>
+/// @param out Array of <code> length </code> elements of type <code> toType </code>
+/// @param length Number of elements
+/// @brief  Like <code> DO_CONVERT </code>, but for whole arrays
+/// @attention Converter library functions must follow this convention
+///         <br> <code> void convert_array__fromType_to__toType(const fromType* in, toType* out, size_t length) </code>
+#define DO_CONVERT_ARRAY(fromType, toType, in, out, length) RESOLVE_ARRAY(fromType, toType, in, out, length)
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+/// Number of elements of 32 bits that the array kernels convert at once
+#define LF_CONVERT_LANES 8
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define LF_CONVERT_LANES 4
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define LF_CONVERT_LANES 4
+#else
+#include <math.h>
+#define LF_CONVERT_LANES 1
+#endif
+
+/// Number of bytes that the byte swapping kernels swap at once
+#define LF_CONVERT_BYTES (LF_CONVERT_LANES * 4 < 8 ? 8 : LF_CONVERT_LANES * 4)
+
+/// Largest float that converts to int32_t without overflow
+#define LF_CONVERT_INT32_MAX_FLOAT 2147483520.0f
+
+/// @name Blocks
+/// @brief Convert or swap one block of <code> LF_CONVERT_LANES </code> elements or <code> LF_CONVERT_BYTES </code>
+///        bytes. Floats are rounded to the nearest integer, ties to even, and saturated to the range of the
+///        integer type. NaN converts to an unspecified value.
+/// @{
+#if defined(__AVX2__)
+
+static inline void lf_convert_block_int16_to_float(const int16_t* in, float* out, float scale) {
+  __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)in));
+  _mm256_storeu_ps(out, _mm256_mul_ps(_mm256_cvtepi32_ps(x), _mm256_set1_ps(scale)));
+}
+
+static inline void lf_convert_block_float_to_int16(const float* in, int16_t* out, float scale) {
+  __m256 x = _mm256_mul_ps(_mm256_loadu_ps(in), _mm256_set1_ps(scale));
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-32768.0f)), _mm256_set1_ps(32767.0f));
+  __m256i y = _mm256_cvtps_epi32(x);
+  // Packing works within 128-bit lanes, so the low halves of the lanes are gathered afterwards.
+  y = _mm256_permute4x64_epi64(_mm256_packs_epi32(y, y), 0xD8);
+  _mm_storeu_si128((__m128i*)out, _mm256_castsi256_si128(y));
+}
+
+static inline void lf_convert_block_int32_to_float(const int32_t* in, float* out, float scale) {
+  __m256i x = _mm256_loadu_si256((const __m256i*)in);
+  _mm256_storeu_ps(out, _mm256_mul_ps(_mm256_cvtepi32_ps(x), _mm256_set1_ps(scale)));
+}
+
+static inline void lf_convert_block_float_to_int32(const float* in, int32_t* out, float scale) {
+  __m256 x = _mm256_mul_ps(_mm256_loadu_ps(in), _mm256_set1_ps(scale));
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-2147483648.0f)), _mm256_set1_ps(LF_CONVERT_INT32_MAX_FLOAT));
+  _mm256_storeu_si256((__m256i*)out, _mm256_cvtps_epi32(x));
+}
+
+static inline void lf_convert_block_scale_float(const float* in, float* out, float scale) {
+  _mm256_storeu_ps(out, _mm256_mul_ps(_mm256_loadu_ps(in), _mm256_set1_ps(scale)));
+}
+
+static inline void lf_convert_block_swap(const void* in, void* out, __m256i order) {
+  __m256i x = _mm256_loadu_si256((const __m256i*)in);
+  _mm256_storeu_si256((__m256i*)out, _mm256_shuffle_epi8(x, order));
+}
+
+static inline void lf_convert_block_swap16(const void* in, void* out) {
+  lf_convert_block_swap(in, out,
+                        _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6,
+                                         9, 8, 11, 10, 13, 12, 15, 14));
+}
+
+static inline void lf_convert_block_swap32(const void* in, void* out) {
+  lf_convert_block_swap(in, out,
+                        _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4,
+                                         11, 10, 9, 8, 15, 14, 13, 12));
+}
+
+static inline void lf_convert_block_swap64(const void* in, void* out) {
+  lf_convert_block_swap(in, out,
+                        _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                         15, 14, 13, 12, 11, 10, 9, 8));
+}
+
+#elif defined(__SSE2__)
+
+static inline void lf_convert_block_int16_to_float(const int16_t* in, float* out, float scale) {
+  __m128i x = _mm_loadl_epi64((const __m128i*)in);
+  // Sign-extend by placing each element in the upper half of a 32-bit lane and shifting it down.
+  x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+  _mm_storeu_ps(out, _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(scale)));
+}
+
+static inline void lf_convert_block_float_to_int16(const float* in, int16_t* out, float scale) {
+  __m128 x = _mm_mul_ps(_mm_loadu_ps(in), _mm_set1_ps(scale));
+  x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+  __m128i y = _mm_cvtps_epi32(x);
+  _mm_storel_epi64((__m128i*)out, _mm_packs_epi32(y, y));
+}
+
+static inline void lf_convert_block_int32_to_float(const int32_t* in, float* out, float scale) {
+  __m128i x = _mm_loadu_si128((const __m128i*)in);
+  _mm_storeu_ps(out, _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(scale)));
+}
+
+static inline void lf_convert_block_float_to_int32(const float* in, int32_t* out, float scale) {
+  __m128 x = _mm_mul_ps(_mm_loadu_ps(in), _mm_set1_ps(scale));
+  x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-2147483648.0f)), _mm_set1_ps(LF_CONVERT_INT32_MAX_FLOAT));
+  _mm_storeu_si128((__m128i*)out, _mm_cvtps_epi32(x));
+}
+
+static inline void lf_convert_block_scale_float(const float* in, float* out, float scale) {
+  _mm_storeu_ps(out, _mm_mul_ps(_mm_loadu_ps(in), _mm_set1_ps(scale)));
+}
+
+static inline __m128i lf_convert_swap16(__m128i x) { return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)); }
+
+static inline void lf_convert_block_swap16(const void* in, void* out) {
+  _mm_storeu_si128((__m128i*)out, lf_convert_swap16(_mm_loadu_si128((const __m128i*)in)));
+}
+
+static inline void lf_convert_block_swap32(const void* in, void* out) {
+  // Swap the bytes of each 16-bit word, then the two words of each element.
+  __m128i x = lf_convert_swap16(_mm_loadu_si128((const __m128i*)in));
+  x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xB1), 0xB1);
+  _mm_storeu_si128((__m128i*)out, x);
+}
+
+static inline void lf_convert_block_swap64(const void* in, void* out) {
+  // Swap the bytes of each 16-bit word, then reverse the four words of each element.
+  __m128i x = lf_convert_swap16(_mm_loadu_si128((const __m128i*)in));
+  x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0x1B), 0x1B);
+  _mm_storeu_si128((__m128i*)out, x);
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+static inline void lf_convert_block_int16_to_float(const int16_t* in, float* out, float scale) {
+  vst1q_f32(out, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vld1_s16(in))), scale));
+}
+
+static inline void lf_convert_block_float_to_int16(const float* in, int16_t* out, float scale) {
+  // The conversion to 32 bits saturates, and so does the narrowing to 16 bits.
+  vst1_s16(out, vqmovn_s32(vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in), scale))));
+}
+
+static inline void lf_convert_block_int32_to_float(const int32_t* in, float* out, float scale) {
+  vst1q_f32(out, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(in)), scale));
+}
+
+static inline void lf_convert_block_float_to_int32(const float* in, int32_t* out, float scale) {
+  vst1q_s32(out, vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in), scale)));
+}
+
+static inline void lf_convert_block_scale_float(const float* in, float* out, float scale) {
+  vst1q_f32(out, vmulq_n_f32(vld1q_f32(in), scale));
+}
+
+static inline void lf_convert_block_swap16(const void* in, void* out) {
+  vst1q_u8((uint8_t*)out, vrev16q_u8(vld1q_u8((const uint8_t*)in)));
+}
+
+static inline void lf_convert_block_swap32(const void* in, void* out) {
+  vst1q_u8((uint8_t*)out, vrev32q_u8(vld1q_u8((const uint8_t*)in)));
+}
+
+static inline void lf_convert_block_swap64(const void* in, void* out) {
+  vst1q_u8((uint8_t*)out, vrev64q_u8(vld1q_u8((const uint8_t*)in)));
+}
+
+#else // Scalar
+
+static inline void lf_convert_block_int16_to_float(const int16_t* in, float* out, float scale) {
+  *out = (float)*in * scale;
+}
+
+static inline void lf_convert_block_float_to_int16(const float* in, int16_t* out, float scale) {
+  float x = *in * scale;
+  x = x < -32768.0f ? -32768.0f : (x > 32767.0f ? 32767.0f : x);
+  *out = (int16_t)lrintf(x);
+}
+
+static inline void lf_convert_block_int32_to_float(const int32_t* in, float* out, float scale) {
+  *out = (float)*in * scale;
+}
+
+static inline void lf_convert_block_float_to_int32(const float* in, int32_t* out, float scale) {
+  float x = *in * scale;
+  x = x < -2147483648.0f ? -2147483648.0f : (x > LF_CONVERT_INT32_MAX_FLOAT ? LF_CONVERT_INT32_MAX_FLOAT : x);
+  *out = (int32_t)lrintf(x);
+}
+
+static inline void lf_convert_block_scale_float(const float* in, float* out, float scale) { *out = *in * scale; }
+
+static inline void lf_convert_block_swap16(const void* in, void* out) {
+  uint16_t x[4];
+  memcpy(x, in, sizeof(x));
+  for (int i = 0; i < 4; i++) {
+    x[i] = (uint16_t)((x[i] << 8) | (x[i] >> 8));
+  }
+  memcpy(out, x, sizeof(x));
+}
+
+static inline void lf_convert_block_swap32(const void* in, void* out) {
+  uint32_t x[2];
+  memcpy(x, in, sizeof(x));
+  for (int i = 0; i < 2; i++) {
+    x[i] = (x[i] << 24) | ((x[i] << 8) & 0xFF0000u) | ((x[i] >> 8) & 0xFF00u) | (x[i] >> 24);
+  }
+  memcpy(out, x, sizeof(x));
+}
+
+static inline void lf_convert_block_swap64(const void* in, void* out) {
+  uint32_t x[2];
+  memcpy(x, in, sizeof(x));
+  uint32_t y[2] = {x[1], x[0]};
+  lf_convert_block_swap32(y, out);
+}
+
+#endif
+/// @}
+
+/// Convert the whole blocks of an array with <code> block </code> and the rest through a zero-padded block
+#define LF_CONVERT_ARRAY(fromType, toType, block, in, out, length, scale)                                              \
+  do {                                                                                                                 \
+    size_t i = 0;                                                                                                      \
+    for (; i + LF_CONVERT_LANES <= (length); i += LF_CONVERT_LANES) {                                                  \
+      block((in) + i, (out) + i, scale);                                                                               \
+    }                                                                                                                  \
+    if (i < (length)) {                                                                                                \
+      fromType rest_in[LF_CONVERT_LANES] = {0};                                                                        \
+      toType rest_out[LF_CONVERT_LANES];                                                                               \
+      memcpy(rest_in, (in) + i, ((length)-i) * sizeof(fromType));                                                      \
+      block(rest_in, rest_out, scale);                                                                                 \
+      memcpy((out) + i, rest_out, ((length)-i) * sizeof(toType));                                                      \
+    }                                                                                                                  \
+  } while (0)
+
+/// @brief Convert <code> length </code> elements of <code> in </code> to float and multiply them by
+///        <code> scale </code>, for example <code> 1.0f / 32768 </code> to get audio samples in [-1, 1)
+static inline void lf_convert_int16_to_float(const int16_t* in, float* out, size_t length, float scale) {
+  LF_CONVERT_ARRAY(int16_t, float, lf_convert_block_int16_to_float, in, out, length, scale);
+}
+
+/// @brief Multiply <code> length </code> elements of <code> in </code> by <code> scale </code>, for example
+///        <code> 32768.0f </code> for audio samples in [-1, 1), and convert them to int16_t
+static inline void lf_convert_float_to_int16(const float* in, int16_t* out, size_t length, float scale) {
+  LF_CONVERT_ARRAY(float, int16_t, lf_convert_block_float_to_int16, in, out, length, scale);
+}
+
+/// @brief Convert <code> length </code> elements of <code> in </code> to float and multiply them by
+///        <code> scale </code>
+static inline void lf_convert_int32_to_float(const int32_t* in, float* out, size_t length, float scale) {
+  LF_CONVERT_ARRAY(int32_t, float, lf_convert_block_int32_to_float, in, out, length, scale);
+}
+
+/// @brief Multiply <code> length </code> elements of <code> in </code> by <code> scale </code> and convert
+///        them to int32_t
+static inline void lf_convert_float_to_int32(const float* in, int32_t* out, size_t length, float scale) {
+  LF_CONVERT_ARRAY(float, int32_t, lf_convert_block_float_to_int32, in, out, length, scale);
+}
+
+/// @brief Multiply <code> length </code> elements of <code> in </code> by <code> scale </code>.
+///        <code> out </code> may be <code> in </code>.
+static inline void lf_scale_float(const float* in, float* out, size_t length, float scale) {
+  LF_CONVERT_ARRAY(float, float, lf_convert_block_scale_float, in, out, length, scale);
+}
+
+/// Swap the bytes of the elements of an array with <code> block </code> and the rest through a padded block
+#define LF_SWAP_BYTES(block, in, out, length, size)                                                                    \
+  do {                                                                                                                 \
+    size_t bytes = (length) * (size);                                                                                  \
+    size_t i = 0;                                                                                                      \
+    for (; i + LF_CONVERT_BYTES <= bytes; i += LF_CONVERT_BYTES) {                                                     \
+      block((const char*)(in) + i, (char*)(out) + i);                                                                  \
+    }                                                                                                                  \
+    if (i < bytes) {                                                                                                   \
+      uint64_t rest[LF_CONVERT_BYTES / 8] = {0};                                                                       \
+      memcpy(rest, (const char*)(in) + i, bytes - i);                                                                  \
+      block(rest, rest);                                                                                               \
+      memcpy((char*)(out) + i, rest, bytes - i);                                                                       \
+    }                                                                                                                  \
+  } while (0)
+
+/// @brief Swap the bytes of <code> length </code> 16-bit elements of <code> in </code>, for example to convert
+///        between big-endian and little-endian data. <code> out </code> may be <code> in </code>.
+static inline void lf_swap_bytes16(const void* in, void* out, size_t length) {
+  LF_SWAP_BYTES(lf_convert_block_swap16, in, out, length, 2);
+}
+
+/// @brief Swap the bytes of <code> length </code> 32-bit elements of <code> in </code>.
+///        <code> out </code> may be <code> in </code>.
+static inline void lf_swap_bytes32(const void* in, void* out, size_t length) {
+  LF_SWAP_BYTES(lf_convert_block_swap32, in, out, length, 4);
+}
+
+/// @brief Swap the bytes of <code> length </code> 64-bit elements of <code> in </code>.
+///        <code> out </code> may be <code> in </code>.
+static inline void lf_swap_bytes64(const void* in, void* out, size_t length) {
+  LF_SWAP_BYTES(lf_convert_block_swap64, in, out, length, 8);
+}
+
+/// @name Array converters
+/// @brief Converters for <code> DO_CONVERT_ARRAY </code> that do not scale
+/// @{
+static inline void convert_array__int16_t_to__float(const int16_t* in, float* out, size_t length) {
+  lf_convert_int16_to_float(in, out, length, 1.0f);
+}
+
+static inline void convert_array__float_to__int16_t(const float* in, int16_t* out, size_t length) {
+  lf_convert_float_to_int16(in, out, length, 1.0f);
+}
+
+static inline void convert_array__int32_t_to__float(const int32_t* in, float* out, size_t length) {
+  lf_convert_int32_to_float(in, out, length, 1.0f);
+}
+
+static inline void convert_array__float_to__int32_t(const float* in, int32_t* out, size_t length) {
+  lf_convert_float_to_int32(in, out, length, 1.0f);
+}
+/// @}
+
 #endif // TYPE_CONVERTER_H_
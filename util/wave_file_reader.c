@@ -13,6 +13,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include "wave_file_reader.h"
+#include "type_converter.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define WAVE_FILE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#define WAVE_FILE_MMAP 0
+#endif
 
 #if _WIN32 || WIN32
 #define FILE_PATH_SEPARATOR '\\';
@@ -66,7 +75,15 @@ typedef struct {
   lf_wav_data_t data;
 } lf_wav_t;
 
-lf_waveform_t* read_wave_file(const char* path) {
+/**
+ * Open a wave file, check that the format is supported, and skip to the
+ * start of the sample data.
+ * @param path The path to the file.
+ * @param num_channels Where to store the number of channels.
+ * @param data_size Where to store the size of the sample data in bytes.
+ * @return The file, positioned at the start of the sample data, or NULL if it can't be opened.
+ */
+static FILE* open_wave_data(const char* path, uint16_t* num_channels, uint32_t* data_size) {
   FILE* fp = NULL;
 
   lf_wav_t wav;
@@ -114,39 +131,161 @@ lf_waveform_t* read_wave_file(const char* path) {
   // Apparently, Apple software sometimes inserts junk here.
   uint32_t expected_data_id = (uint32_t)'atad'; // Little-endian version of 'data'.
   while (*(uint32_t*)data.subchunk_id != expected_data_id) {
-    char junk[data.subchunk_size];
-    size_t bytes_read = fread(junk, 1, data.subchunk_size, fp);
-    if (bytes_read != data.subchunk_size) {
+    if (fseek(fp, data.subchunk_size, SEEK_CUR) != 0) {
       fprintf(stderr, "Intermediate junk chunk '%c%c%c%c' could not be read. Giving up.\n", data.subchunk_id[0],
               data.subchunk_id[1], data.subchunk_id[2], data.subchunk_id[3]);
       break;
     }
-    bytes_read = fread(&data, 1, sizeof(lf_wav_data_t), fp);
+    size_t bytes_read = fread(&data, 1, sizeof(lf_wav_data_t), fp);
     if (bytes_read != sizeof(lf_wav_data_t)) {
       fprintf(stderr, "Missing 'data' chunk in file %s.\n", path);
       break;
     }
   }
 
-  uint16_t num_channels = fmt.num_channels;
+  *num_channels = fmt.num_channels;
+  *data_size = data.subchunk_size;
 
   // Ignoring the following fields. Should we?
   // printf("byte_rate \t%d\n", fmt.byte_rate);
   // printf("BlockAlign \t%d\n", fmt.BlockAlign);
+  return fp;
+}
+
+lf_waveform_t* read_wave_file(const char* path) {
+  uint16_t num_channels;
+  uint32_t data_size;
+  FILE* fp = open_wave_data(path, &num_channels, &data_size);
+  if (!fp) {
+    return NULL;
+  }
 
-  // printf("Data subchunk size \t%d\n", data.subchunk_size);
+  // printf("Data subchunk size \t%d\n", data_size);
 
   lf_waveform_t* result = (lf_waveform_t*)malloc(sizeof(lf_waveform_t));
   // printf("Size of lf_waveform_t %d", sizeof(lf_waveform_t));
-  result->length = data.subchunk_size / 2; // Subchunk size is in bytes, but length is number of samples.
+  result->length = data_size / 2; // Subchunk size is in bytes, but length is number of samples.
   result->num_channels = num_channels;
-  result->waveform = (int16_t*)calloc(data.subchunk_size / 2, sizeof(int16_t));
+  result->waveform = (int16_t*)calloc(data_size / 2, sizeof(int16_t));
+  result->mapping = NULL;
+  result->mapping_size = 0;
+
+  size_t bytes_read = fread(result->waveform, sizeof(int16_t), data_size / 2, fp);
+  if (bytes_read != data_size / 2) {
+    fprintf(stderr, "WARNING: Expected %d bytes, but got %zu.\n", data_size, bytes_read);
+  }
+  fclose(fp);
+
+  // printf("duration \t%f\n", (data_size * 1.0) / fmt.byte_rate);
+  return result;
+}
 
-  size_t bytes_read = fread(result->waveform, sizeof(int16_t), data.subchunk_size / 2, fp);
-  if (bytes_read != data.subchunk_size / 2) {
-    fprintf(stderr, "WARNING: Expected %d bytes, but got %zu.\n", data.subchunk_size, bytes_read);
+lf_waveform_t* map_wave_file(const char* path) {
+#if WAVE_FILE_MMAP
+  uint16_t num_channels;
+  uint32_t data_size;
+  FILE* fp = open_wave_data(path, &num_channels, &data_size);
+  if (!fp) {
+    return NULL;
+  }
+  long offset = ftell(fp);
+  struct stat file_status;
+  if (offset < 0 || offset % sizeof(int16_t) != 0 || fstat(fileno(fp), &file_status) != 0) {
+    // The samples could not be accessed in place.
+    fclose(fp);
+    return read_wave_file(path);
+  }
+  size_t mapping_size = (size_t)file_status.st_size;
+  if ((size_t)offset + data_size > mapping_size) {
+    fprintf(stderr, "WARNING: Expected %d bytes, but got %zu.\n", data_size, mapping_size - (size_t)offset);
+    data_size = (uint32_t)(mapping_size - (size_t)offset);
+  }
+  void* mapping = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+  // The mapping stays valid after the file is closed.
+  fclose(fp);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "WARNING: Failed to map waveform sample file: %s\n", path);
+    return NULL;
   }
+  // Waveforms are usually played from start to end.
+  madvise(mapping, mapping_size, MADV_SEQUENTIAL);
 
-  // printf("duration \t%f\n", (data.subchunk_size * 1.0) / fmt.byte_rate);
+  lf_waveform_t* result = (lf_waveform_t*)malloc(sizeof(lf_waveform_t));
+  result->length = data_size / 2;
+  result->num_channels = num_channels;
+  result->waveform = (int16_t*)((char*)mapping + offset);
+  result->mapping = mapping;
+  result->mapping_size = mapping_size;
   return result;
+#else
+  return read_wave_file(path);
+#endif // WAVE_FILE_MMAP
+}
+
+void free_wave_file(lf_waveform_t* waveform) {
+  if (waveform == NULL) {
+    return;
+  }
+#if WAVE_FILE_MMAP
+  if (waveform->mapping != NULL) {
+    munmap(waveform->mapping, waveform->mapping_size);
+    free(waveform);
+    return;
+  }
+#endif // WAVE_FILE_MMAP
+  free(waveform->waveform);
+  free(waveform);
+}
+
+lf_wave_stream_t* open_wave_stream(const char* path, size_t chunk_length) {
+  uint16_t num_channels;
+  uint32_t data_size;
+  FILE* fp = open_wave_data(path, &num_channels, &data_size);
+  if (!fp) {
+    return NULL;
+  }
+  if (num_channels == 0 || chunk_length < num_channels) {
+    fprintf(stderr, "WARNING: Chunks of %zu samples cannot hold the %d channels of %s.\n", chunk_length, num_channels,
+            path);
+    fclose(fp);
+    return NULL;
+  }
+  lf_wave_stream_t* stream = (lf_wave_stream_t*)malloc(sizeof(lf_wave_stream_t));
+  stream->file = fp;
+  stream->remaining = data_size / 2;
+  stream->capacity = chunk_length - chunk_length % num_channels;
+  stream->chunk.length = 0;
+  stream->chunk.num_channels = num_channels;
+  stream->chunk.waveform = (int16_t*)malloc(stream->capacity * sizeof(int16_t));
+  stream->chunk.mapping = NULL;
+  stream->chunk.mapping_size = 0;
+  return stream;
+}
+
+lf_waveform_t* read_wave_stream(lf_wave_stream_t* stream) {
+  size_t length = stream->remaining < stream->capacity ? stream->remaining : stream->capacity;
+  size_t samples_read = fread(stream->chunk.waveform, sizeof(int16_t), length, stream->file);
+  if (samples_read != length) {
+    fprintf(stderr, "WARNING: Expected %zu samples, but got %zu.\n", length, samples_read);
+    // Do not try to read past the end again.
+    stream->remaining = 0;
+  } else {
+    stream->remaining -= (uint32_t)samples_read;
+  }
+  // Only play whole frames.
+  stream->chunk.length = (uint32_t)(samples_read - samples_read % stream->chunk.num_channels);
+  return &stream->chunk;
+}
+
+void close_wave_stream(lf_wave_stream_t* stream) {
+  if (stream == NULL) {
+    return;
+  }
+  fclose(stream->file);
+  free(stream->chunk.waveform);
+  free(stream);
+}
+
+void waveform_to_float(const lf_waveform_t* waveform, float* samples) {
+  lf_convert_int16_to_float(waveform->waveform, samples, waveform->length, 1.0f / 32768);
 }
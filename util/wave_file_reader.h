@@ -11,6 +11,11 @@
  * supported, returns an lf_waveform_t struct, which contains the raw
  * audio data in 16-bit linear PCM form.
  *
+ * For large files, map_wave_file() maps the file into memory instead of
+ * reading it, so that the samples are only read from disk when they are used,
+ * and open_wave_stream() reads the samples in chunks of fixed size.
+ * waveform_to_float() converts samples to floats in [-1, 1) for processing.
+ *
  * This code has few dependencies, so it should run on just about any platform.
  *
  * To use this, include the following flags in your target properties:
@@ -18,7 +23,8 @@
 target C {
     files: [
         "/lib/c/reactor-c/util/wave_file_reader.c",
-        "/lib/c/reactor-c/util/wave_file_reader.h"
+        "/lib/c/reactor-c/util/wave_file_reader.h",
+        "/lib/c/reactor-c/util/type_converter.h"
     ],
     cmake-include: [
         "/lib/c/reactor-c/util/wave_file_reader.cmake"
@@ -37,19 +43,39 @@ target C {
 #ifndef WAVE_FILE_READER_H
 #define WAVE_FILE_READER_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
 /**
  * Waveform in 16-bit linear-PCM format.
  * The waveform element is an array containing audio samples.
  * If there are two channels, then they are interleaved
  * left and right channel. The length is the total number
  * of samples, a multiple of the number of channels.
+ * If the waveform was returned by map_wave_file(), the mapping
+ * element is the start of the mapped file, which is mapping_size
+ * bytes long. Otherwise, it is NULL.
  */
 typedef struct lf_waveform_t {
   uint32_t length;
   uint16_t num_channels;
   int16_t* waveform;
+  void* mapping;
+  size_t mapping_size;
 } lf_waveform_t;
 
+/**
+ * A wave file that is read in chunks.
+ * The chunk element holds the samples most recently read by read_wave_stream().
+ */
+typedef struct lf_wave_stream_t {
+  FILE* file;
+  uint32_t remaining; // The number of samples that have not been read yet.
+  size_t capacity;    // The maximum number of samples in a chunk, a multiple of the number of channels.
+  lf_waveform_t chunk;
+} lf_wave_stream_t;
+
 /**
  * Open a wave file, check that the format is supported,
  * allocate memory for the sample data, and fill the memory
@@ -66,4 +92,62 @@ typedef struct lf_waveform_t {
  */
 lf_waveform_t* read_wave_file(const char* path);
 
+/**
+ * Open a wave file like read_wave_file(), but map the sample data into
+ * memory instead of reading it. This takes constant time regardless
+ * of the size of the file, and the pages of the file are only read
+ * when the samples are accessed. Use free_wave_file() to release the
+ * returned waveform. The samples must not be modified.
+ * On platforms without mmap, or if the sample data is not aligned,
+ * this falls back to read_wave_file().
+ *
+ * @param path The path to the file.
+ * @return The waveform or NULL if the file can't be opened or mapped.
+ */
+lf_waveform_t* map_wave_file(const char* path);
+
+/**
+ * Free a waveform returned by read_wave_file() or map_wave_file().
+ * @param waveform The waveform or NULL.
+ */
+void free_wave_file(lf_waveform_t* waveform);
+
+/**
+ * Open a wave file for reading its sample data in chunks, without
+ * reading the data yet. Use read_wave_stream() to read the chunks
+ * and close_wave_stream() when done.
+ *
+ * @param path The path to the file.
+ * @param chunk_length The maximum number of samples in a chunk. It is
+ *  rounded down to a multiple of the number of channels.
+ * @return The stream or NULL if the file can't be opened, has an
+ *  unsupported format, or has more channels than chunk_length.
+ */
+lf_wave_stream_t* open_wave_stream(const char* path, size_t chunk_length);
+
+/**
+ * Read the next chunk of sample data of the stream. The returned
+ * waveform is owned by the stream and is overwritten by the next call.
+ *
+ * @param stream The stream.
+ * @return The chunk, which has length 0 if all samples have been read.
+ */
+lf_waveform_t* read_wave_stream(lf_wave_stream_t* stream);
+
+/**
+ * Close a stream returned by open_wave_stream() and free its memory.
+ * @param stream The stream or NULL.
+ */
+void close_wave_stream(lf_wave_stream_t* stream);
+
+/**
+ * Convert the samples of a waveform, such as a chunk returned by
+ * read_wave_stream(), to floats in the range [-1, 1), in one pass
+ * that uses the SIMD instructions of the platform if available.
+ *
+ * @param waveform The waveform.
+ * @param samples Where to put the waveform->length converted samples.
+ */
+void waveform_to_float(const lf_waveform_t* waveform, float* samples);
+
 #endif // WAVE_FILE_READER_H
\ No newline at end of file